@@ -11,13 +11,24 @@
 #include <logger.h>
 #include <cstring>
 #include <stdexcept>
+#include <algorithm>
+#include <rapidjson/reader.h>
+#include <rapidjson/writer.h>
+#include <rapidjson/stringbuffer.h>
 
 using namespace std;
 using namespace rapidjson;
 
+/**
+ * Create a JSONPath, the path is parsed when it is created
+ * rather than on each search
+ *
+ * @param path	The path to search for
+ */
 JSONPath::JSONPath(const string& path) : m_path(path)
 {
 	m_logger = Logger::getLogger();
+	parse();
 }
 
 /**
@@ -27,6 +38,10 @@ JSONPath::JSONPath(const string& path) : m_path(path)
  */
 JSONPath::~JSONPath()
 {
+	for (auto component : m_parsed)
+	{
+		delete component;
+	}
 }
 
 /**
@@ -36,13 +51,8 @@ JSONPath::~JSONPath()
  * @return the matching node. Throws an exception if there was no match
  */
 
-Value *JSONPath::findNode(Value& root)
+Value *JSONPath::findNode(Value& root) const
 {
-	if (m_parsed.size() == 0)
-	{
-		parse();
-	}
-
 	Value *node = &root;
 
 	for (int i = 0; i < m_parsed.size(); i++)
@@ -52,6 +62,23 @@ Value *JSONPath::findNode(Value& root)
 	return node;
 }
 
+/**
+ * Return true if the path can be matched against the events of a
+ * SAX parse, i.e. it has no matching predicates
+ */
+bool JSONPath::isStreamable() const
+{
+	vector<Step> steps;
+	for (auto component : m_parsed)
+	{
+		if (!component->steps(steps))
+		{
+			return false;
+		}
+	}
+	return true;
+}
+
 /**
  * Parse the m_path JSON path. Throws an exception if there
  * was a parse error.
@@ -143,7 +170,7 @@ JSONPath::LiteralPathComponent::LiteralPathComponent(string& name) : m_name(name
  * @param node	The node to match
  * @return pointer to the matching node
  */
-rapidjson::Value *JSONPath::LiteralPathComponent::match(rapidjson::Value *node)
+rapidjson::Value *JSONPath::LiteralPathComponent::match(rapidjson::Value *node) const
 {
 	if (node->IsObject() && node->HasMember(m_name.c_str()))
 	{
@@ -152,6 +179,18 @@ rapidjson::Value *JSONPath::LiteralPathComponent::match(rapidjson::Value *node)
 	throw runtime_error("Document has no member " + m_name);
 }
 
+/**
+ * Add the step of the literal component, a member of an object
+ *
+ * @param steps	The steps to add to
+ * @return true as a literal may be streamed
+ */
+bool JSONPath::LiteralPathComponent::steps(vector<Step>& steps) const
+{
+	steps.push_back(Step(m_name));
+	return true;
+}
+
 /**
  * A match against an array index
  */
@@ -165,12 +204,12 @@ JSONPath::IndexPathComponent::IndexPathComponent(string& name, int index) : m_na
  * @param node	The node to match
  * @return pointer to the matching node
  */
-rapidjson::Value *JSONPath::IndexPathComponent::match(rapidjson::Value *node)
+rapidjson::Value *JSONPath::IndexPathComponent::match(rapidjson::Value *node) const
 {
 	if (node->IsObject() && node->HasMember(m_name.c_str()))
 	{
 		Value& n  = (*node)[m_name.c_str()];
-		if (n.IsArray())
+		if (n.IsArray() && m_index >= 0 && (SizeType)m_index < n.Size())
 		{
 			return &n[m_index];
 		}
@@ -178,6 +217,20 @@ rapidjson::Value *JSONPath::IndexPathComponent::match(rapidjson::Value *node)
 	throw runtime_error("Document has no member " + m_name + " or it is not an array");
 }
 
+/**
+ * Add the steps of the index component, a member of an object
+ * followed by an element of the array it holds
+ *
+ * @param steps	The steps to add to
+ * @return true as an index may be streamed
+ */
+bool JSONPath::IndexPathComponent::steps(vector<Step>& steps) const
+{
+	steps.push_back(Step(m_name));
+	steps.push_back(Step(m_index));
+	return true;
+}
+
 /**
  * Amatch against an object that hase a particular name/value pair
  */
@@ -191,7 +244,7 @@ JSONPath::MatchPathComponent::MatchPathComponent(string& name, string& property,
  * @param node	The node to match
  * @return pointer to the matching node
  */
-rapidjson::Value *JSONPath::MatchPathComponent::match(rapidjson::Value *node)
+rapidjson::Value *JSONPath::MatchPathComponent::match(rapidjson::Value *node) const
 {
 	if (node->IsObject() && node->HasMember(m_name.c_str()))
 	{
@@ -236,3 +289,459 @@ rapidjson::Value *JSONPath::MatchPathComponent::match(rapidjson::Value *node)
 	}
 	throw runtime_error(string("Document has no member ") + m_name + string(" or it does not have a ") + m_property + " property");
 }
+
+/**
+ * A matching predicate needs the whole of the array it selects from
+ * so can not be streamed
+ *
+ * @param steps	The steps to add to
+ * @return false
+ */
+bool JSONPath::MatchPathComponent::steps(vector<Step>& steps) const
+{
+	return false;
+}
+
+/**
+ * A node of the tree of the streamed paths of a JSONPathSet. The paths
+ * that share their leading steps share the nodes of those steps, the
+ * node reached by the last step of a path records the path.
+ */
+class JSONPathSet::Node {
+	public:
+		~Node()
+		{
+			for (auto& member : m_members)
+				delete member.second;
+			for (auto& element : m_elements)
+				delete element.second;
+		}
+
+		/**
+		 * Return the child node for a step, adding it if required
+		 */
+		Node *add(const JSONPath::Step& step)
+		{
+			if (step.isIndex())
+			{
+				auto it = lower_bound(m_elements.begin(), m_elements.end(), step.m_index,
+						[](const pair<int, Node *>& e, int index) { return e.first < index; });
+				if (it == m_elements.end() || it->first != step.m_index)
+					it = m_elements.insert(it, make_pair(step.m_index, new Node()));
+				return it->second;
+			}
+			auto it = lower_bound(m_members.begin(), m_members.end(), step.m_name,
+					[](const pair<string, Node *>& m, const string& name) { return m.first < name; });
+			if (it == m_members.end() || it->first != step.m_name)
+				it = m_members.insert(it, make_pair(step.m_name, new Node()));
+			return it->second;
+		}
+
+		/**
+		 * Return the child node for a member of an object or
+		 * NULL if no path selects the member
+		 */
+		const Node *member(const char *name, size_t length) const
+		{
+			size_t low = 0, high = m_members.size();
+			while (low < high)
+			{
+				size_t mid = (low + high) / 2;
+				const string& key = m_members[mid].first;
+				int cmp = memcmp(key.data(), name, min(key.length(), length));
+				if (cmp == 0)
+				{
+					if (key.length() == length)
+						return m_members[mid].second;
+					cmp = key.length() < length ? -1 : 1;
+				}
+				if (cmp < 0)
+					low = mid + 1;
+				else
+					high = mid;
+			}
+			return NULL;
+		}
+
+		/**
+		 * Return the child node for an element of an array or
+		 * NULL if no path selects the element
+		 */
+		const Node *element(int index) const
+		{
+			for (auto& element : m_elements)
+			{
+				if (element.first == index)
+					return element.second;
+			}
+			return NULL;
+		}
+
+		vector< pair<string, Node *> >	m_members;	// Sorted by name
+		vector< pair<int, Node *> >	m_elements;	// Sorted by index
+		vector<size_t>			m_paths;	// The paths that end at the node
+};
+
+/**
+ * The SAX handler that matches the paths of a JSONPathSet against the
+ * events of the parse of a document.
+ *
+ * A frame is kept for each open object and array with the node of the
+ * paths that match its location, if there is one. A scalar that a path
+ * selects is stored in the results as it is read, an object or array
+ * is written out as JSON as it is read and parsed into the results
+ * when it ends.
+ */
+class JSONPathSet::Handler : public BaseReaderHandler<UTF8<>, JSONPathSet::Handler> {
+	public:
+		Handler(const JSONPathSet& set, Document& results) :
+			m_set(set), m_results(results), m_allocator(results.GetAllocator()),
+			m_found(set.m_paths.size(), false), m_remaining(set.m_paths.size())
+		{
+			m_stack.reserve(16);
+		}
+		~Handler()
+		{
+			for (auto capture : m_captures)
+				delete capture;
+		}
+
+		bool	complete() const { return m_remaining == 0 && m_captures.empty(); };
+
+		bool Null()
+		{
+			const Node *node = value();
+			if (node && !node->m_paths.empty())
+				store(node, Value());
+			for (auto capture : m_captures)
+				capture->m_writer.Null();
+			return more();
+		}
+		bool Bool(bool b)
+		{
+			const Node *node = value();
+			if (node && !node->m_paths.empty())
+				store(node, Value(b));
+			for (auto capture : m_captures)
+				capture->m_writer.Bool(b);
+			return more();
+		}
+		bool Int(int i)
+		{
+			const Node *node = value();
+			if (node && !node->m_paths.empty())
+				store(node, Value(i));
+			for (auto capture : m_captures)
+				capture->m_writer.Int(i);
+			return more();
+		}
+		bool Uint(unsigned u)
+		{
+			const Node *node = value();
+			if (node && !node->m_paths.empty())
+				store(node, Value(u));
+			for (auto capture : m_captures)
+				capture->m_writer.Uint(u);
+			return more();
+		}
+		bool Int64(int64_t i)
+		{
+			const Node *node = value();
+			if (node && !node->m_paths.empty())
+				store(node, Value(i));
+			for (auto capture : m_captures)
+				capture->m_writer.Int64(i);
+			return more();
+		}
+		bool Uint64(uint64_t u)
+		{
+			const Node *node = value();
+			if (node && !node->m_paths.empty())
+				store(node, Value(u));
+			for (auto capture : m_captures)
+				capture->m_writer.Uint64(u);
+			return more();
+		}
+		bool Double(double d)
+		{
+			const Node *node = value();
+			if (node && !node->m_paths.empty())
+				store(node, Value(d));
+			for (auto capture : m_captures)
+				capture->m_writer.Double(d);
+			return more();
+		}
+		bool String(const char *str, SizeType length, bool copy)
+		{
+			const Node *node = value();
+			if (node && !node->m_paths.empty())
+				store(node, Value(StringRef(str, length)));
+			for (auto capture : m_captures)
+				capture->m_writer.String(str, length);
+			return more();
+		}
+		bool StartObject()
+		{
+			start(false);
+			for (auto capture : m_captures)
+				capture->m_writer.StartObject();
+			return true;
+		}
+		bool Key(const char *str, SizeType length, bool copy)
+		{
+			for (auto capture : m_captures)
+				capture->m_writer.Key(str, length);
+			Frame& frame = m_stack.back();
+			frame.m_next = frame.m_node ? frame.m_node->member(str, length) : NULL;
+			return true;
+		}
+		bool EndObject(SizeType)
+		{
+			for (auto capture : m_captures)
+				capture->m_writer.EndObject();
+			return end();
+		}
+		bool StartArray()
+		{
+			start(true);
+			for (auto capture : m_captures)
+				capture->m_writer.StartArray();
+			return true;
+		}
+		bool EndArray(SizeType)
+		{
+			for (auto capture : m_captures)
+				capture->m_writer.EndArray();
+			return end();
+		}
+	private:
+		/**
+		 * An open object or array, with the node of the paths that
+		 * select values within it and, for an object, the node of
+		 * the key of the value being read
+		 */
+		struct Frame {
+			const Node	*m_node;
+			const Node	*m_next;
+			int		m_index;
+		};
+		/**
+		 * An object or array selected by a path that is being
+		 * written out as JSON
+		 */
+		struct Capture {
+			Capture(size_t path, size_t depth) : m_path(path), m_depth(depth), m_writer(m_buffer) {};
+			size_t			m_path;
+			size_t			m_depth;
+			StringBuffer		m_buffer;
+			Writer<StringBuffer>	m_writer;
+		};
+
+		/**
+		 * Return false, to stop the parse, once all the paths
+		 * have been found
+		 */
+		bool		more() const { return !complete(); };
+
+		/**
+		 * Return the node of the paths that match the location of
+		 * the value that is starting, or NULL if there are none
+		 */
+		const Node *value()
+		{
+			if (m_stack.empty())
+			{
+				return m_set.m_root;
+			}
+			Frame& frame = m_stack.back();
+			if (frame.m_next)
+			{
+				const Node *node = frame.m_next;
+				frame.m_next = NULL;
+				return node;
+			}
+			if (frame.m_index >= 0 && frame.m_node)
+			{
+				return frame.m_node->element(frame.m_index++);
+			}
+			return NULL;
+		}
+
+		/**
+		 * Store a copy of a scalar value in the results of the paths
+		 * that select it
+		 */
+		void store(const Node *node, const Value& value)
+		{
+			for (auto path : node->m_paths)
+			{
+				if (!m_found[path])
+				{
+					m_results[path].CopyFrom(value, m_allocator, true);
+					m_found[path] = true;
+					m_remaining--;
+				}
+			}
+		}
+
+		/**
+		 * Start an object or array, capturing it for the paths that
+		 * select it and opening a frame for the paths that select
+		 * values within it
+		 */
+		void start(bool array)
+		{
+			const Node *node = value();
+			Frame frame;
+			frame.m_node = NULL;
+			frame.m_next = NULL;
+			frame.m_index = array ? 0 : -1;
+			if (node)
+			{
+				for (auto path : node->m_paths)
+				{
+					if (!m_found[path])
+					{
+						m_captures.push_back(new Capture(path, m_stack.size()));
+						m_found[path] = true;
+					}
+				}
+				if (array ? !node->m_elements.empty() : !node->m_members.empty())
+				{
+					frame.m_node = node;
+				}
+			}
+			m_stack.push_back(frame);
+		}
+
+		/**
+		 * End an object or array, storing the results of the captures
+		 * of it
+		 */
+		bool end()
+		{
+			m_stack.pop_back();
+			size_t depth = m_stack.size();
+			for (auto it = m_captures.begin(); it != m_captures.end(); )
+			{
+				Capture *capture = *it;
+				if (capture->m_depth == depth)
+				{
+					Document doc;
+					doc.Parse(capture->m_buffer.GetString(), capture->m_buffer.GetSize());
+					m_results[capture->m_path].CopyFrom(doc, m_allocator);
+					m_remaining--;
+					delete capture;
+					it = m_captures.erase(it);
+				}
+				else
+				{
+					++it;
+				}
+			}
+			return more();
+		}
+
+		const JSONPathSet&	m_set;
+		Document&		m_results;
+		Document::AllocatorType&
+					m_allocator;
+		vector<bool>		m_found;
+		size_t			m_remaining;
+		vector<Frame>		m_stack;
+		vector<Capture *>	m_captures;
+};
+
+/**
+ * Create a set of paths to evaluate together
+ *
+ * @param paths	The paths of the set
+ */
+JSONPathSet::JSONPathSet(const vector<string>& paths) : m_root(new Node()), m_streamable(true)
+{
+	for (auto& path : paths)
+	{
+		JSONPath *jpath = new JSONPath(path);
+		vector<JSONPath::Step> steps;
+		for (auto component : jpath->m_parsed)
+		{
+			if (!component->steps(steps))
+			{
+				m_streamable = false;
+				break;
+			}
+		}
+		if (m_streamable)
+		{
+			Node *node = m_root;
+			for (auto& step : steps)
+			{
+				node = node->add(step);
+			}
+			node->m_paths.push_back(m_paths.size());
+		}
+		m_paths.push_back(jpath);
+	}
+}
+
+/**
+ * Destructor for the set of paths
+ */
+JSONPathSet::~JSONPathSet()
+{
+	for (auto path : m_paths)
+	{
+		delete path;
+	}
+	delete m_root;
+}
+
+/**
+ * Evaluate the paths of the set against a document
+ *
+ * The results are returned as an array with an element for each path,
+ * in the order the paths were given. The element of a path that does
+ * not match the document is null. As the parse stops once every path
+ * has been found, an error later in the document is not reported.
+ *
+ * If any of the paths has a matching predicate the document is parsed
+ * into a DOM once and all of the paths are searched for in it.
+ *
+ * @param json		The JSON document to evaluate the paths against
+ * @param results	The document to return the array of results in
+ * @return true if the document could be parsed
+ */
+bool JSONPathSet::evaluate(const char *json, Document& results) const
+{
+	results.SetArray();
+	results.Reserve(m_paths.size(), results.GetAllocator());
+	for (size_t i = 0; i < m_paths.size(); i++)
+	{
+		results.PushBack(Value(), results.GetAllocator());
+	}
+
+	if (m_streamable)
+	{
+		Handler handler(*this, results);
+		Reader reader;
+		StringStream stream(json);
+		ParseResult result = reader.Parse(stream, handler);
+		return !result.IsError() || (result.Code() == kParseErrorTermination && handler.complete());
+	}
+
+	Document doc;
+	doc.Parse(json);
+	if (doc.HasParseError())
+	{
+		return false;
+	}
+	for (size_t i = 0; i < m_paths.size(); i++)
+	{
+		try {
+			results[i].CopyFrom(*m_paths[i]->findNode(doc), results.GetAllocator());
+		} catch (runtime_error& e) {
+			// No match, the result is left as null
+		}
+	}
+	return true;
+}
@@ -9,20 +9,19 @@
  */
 #include <aggregate.h>
 #include <string>
-#include <sstream>
-#include <iostream>
 
 using namespace std;
 
 
 /**
- * Return the JSON payload for a where clause
+ * Return the JSON payload for an aggregate clause
  */
-string Aggregate::toJSON()
+const string& Aggregate::toJSON() const
 {
-ostringstream json;
-
-	json << "{ \"column\" : \"" << m_column << "\",";
-	json << " \"operation\" : \"" << m_operation << "\" }";
-	return json.str();
+	if (m_json.empty())
+	{
+		m_json = "{ \"column\" : \"" + m_column + "\",";
+		m_json += " \"operation\" : \"" + m_operation + "\" }";
+	}
+	return m_json;
 }
@@ -0,0 +1,229 @@
+/*
+ * Fledge counting of the allocations of the data path.
+ *
+ * Copyright (c) 2026 Dianomic Systems
+ *
+ * Released under the Apache 2.0 Licence
+ *
+ * Author: agent
+ */
+#include <alloc_profiler.h>
+#include <atomic>
+#include <new>
+#include <sstream>
+#include <stdlib.h>
+
+using namespace std;
+
+/*
+ * The counters are plain statics so that they may be used by the first
+ * allocations of the process, before any constructors have been run
+ */
+static atomic<unsigned long>	allocations[ALLOC_STAGES];
+static atomic<unsigned long>	allocatedBytes[ALLOC_STAGES];
+static atomic<unsigned long>	frees[ALLOC_STAGES];
+static atomic<unsigned long>	stageReadings[ALLOC_STAGES];
+static thread_local AllocStage	currentStage = ALLOC_UNTAGGED;
+
+static const char *stageNames[ALLOC_STAGES] = {
+	"untagged", "southIngest", "filterPipeline", "storageAppend", "northSend"
+};
+
+/**
+ * Return true if the allocations are counted, that is the service was
+ * built with the FLEDGE_ALLOC_PROFILING option
+ */
+bool AllocProfiler::isEnabled()
+{
+#ifdef FLEDGE_ALLOC_PROFILING
+	return true;
+#else
+	return false;
+#endif
+}
+
+/**
+ * Set the stage the allocations of the calling thread are counted against
+ *
+ * @param stage		The stage of the data path
+ * @return AllocStage	The previous stage of the thread
+ */
+AllocStage AllocProfiler::setStage(AllocStage stage)
+{
+	AllocStage previous = currentStage;
+	currentStage = stage;
+	return previous;
+}
+
+/**
+ * Count the readings processed by a stage
+ *
+ * @param stage	The stage of the data path
+ * @param count	The number of readings
+ */
+void AllocProfiler::readings(AllocStage stage, unsigned long count)
+{
+	stageReadings[stage].fetch_add(count, memory_order_relaxed);
+}
+
+/**
+ * Set all the counters back to zero
+ */
+void AllocProfiler::reset()
+{
+	for (int i = 0; i < ALLOC_STAGES; i++)
+	{
+		allocations[i] = 0;
+		allocatedBytes[i] = 0;
+		frees[i] = 0;
+		stageReadings[i] = 0;
+	}
+}
+
+/**
+ * Return the allocations counted against a stage
+ */
+unsigned long AllocProfiler::getAllocations(AllocStage stage)
+{
+	return allocations[stage].load(memory_order_relaxed);
+}
+
+/**
+ * Return the readings counted by a stage
+ */
+unsigned long AllocProfiler::getReadings(AllocStage stage)
+{
+	return stageReadings[stage].load(memory_order_relaxed);
+}
+
+/**
+ * Return the name of a stage as reported in the JSON document
+ */
+const char *AllocProfiler::stageName(AllocStage stage)
+{
+	return stageNames[stage];
+}
+
+/**
+ * Return the counters of each stage and the allocations per reading
+ * as a JSON object
+ *
+ * @param json	The string to return the JSON object in
+ */
+void AllocProfiler::asJSON(string& json)
+{
+	ostringstream convert;
+	convert << "{ \"enabled\" : " << (isEnabled() ? "true" : "false");
+	convert << ", \"stages\" : [ ";
+	for (int i = 0; i < ALLOC_STAGES; i++)
+	{
+		unsigned long count = allocations[i].load(memory_order_relaxed);
+		unsigned long bytes = allocatedBytes[i].load(memory_order_relaxed);
+		unsigned long readings = stageReadings[i].load(memory_order_relaxed);
+		if (i)
+			convert << ", ";
+		convert << "{ \"stage\" : \"" << stageNames[i] << "\"";
+		convert << ", \"allocations\" : " << count;
+		convert << ", \"bytes\" : " << bytes;
+		convert << ", \"frees\" : " << frees[i].load(memory_order_relaxed);
+		convert << ", \"readings\" : " << readings;
+		if (readings)
+		{
+			convert << ", \"allocationsPerReading\" : " << (double)count / readings;
+			convert << ", \"bytesPerReading\" : " << (double)bytes / readings;
+		}
+		convert << " }";
+	}
+	convert << " ] }";
+	json = convert.str();
+}
+
+#ifdef FLEDGE_ALLOC_PROFILING
+/*
+ * The replacements of the global allocation functions. They are defined
+ * in the common library so that they are used by the services and every
+ * plugin loaded by them.
+ */
+
+/**
+ * Allocate memory and count the allocation against the stage of the
+ * calling thread
+ */
+static void *countedAlloc(size_t size)
+{
+	AllocStage stage = currentStage;
+	allocations[stage].fetch_add(1, memory_order_relaxed);
+	allocatedBytes[stage].fetch_add(size, memory_order_relaxed);
+	if (size == 0)
+		size = 1;
+	void *ptr;
+	while ((ptr = malloc(size)) == NULL)
+	{
+		new_handler handler = get_new_handler();
+		if (!handler)
+			throw bad_alloc();
+		handler();
+	}
+	return ptr;
+}
+
+/**
+ * Free memory and count the free against the stage of the calling thread
+ */
+static void countedFree(void *ptr)
+{
+	if (ptr)
+	{
+		frees[currentStage].fetch_add(1, memory_order_relaxed);
+		free(ptr);
+	}
+}
+
+void *operator new(size_t size)
+{
+	return countedAlloc(size);
+}
+
+void *operator new[](size_t size)
+{
+	return countedAlloc(size);
+}
+
+void *operator new(size_t size, const nothrow_t&) noexcept
+{
+	try {
+		return countedAlloc(size);
+	} catch (...) {
+		return NULL;
+	}
+}
+
+void *operator new[](size_t size, const nothrow_t&) noexcept
+{
+	try {
+		return countedAlloc(size);
+	} catch (...) {
+		return NULL;
+	}
+}
+
+void operator delete(void *ptr) noexcept
+{
+	countedFree(ptr);
+}
+
+void operator delete[](void *ptr) noexcept
+{
+	countedFree(ptr);
+}
+
+void operator delete(void *ptr, const nothrow_t&) noexcept
+{
+	countedFree(ptr);
+}
+
+void operator delete[](void *ptr, const nothrow_t&) noexcept
+{
+	countedFree(ptr);
+}
+#endif
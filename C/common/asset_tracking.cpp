@@ -33,11 +33,24 @@ AssetTracker *AssetTracker::getAssetTracker()
  * @param service  		Service name
  */
 AssetTracker::AssetTracker(ManagementClient *mgtClient, string service) 
-	: m_mgtClient(mgtClient), m_service(service)
+	: m_mgtClient(mgtClient), m_service(service), m_populated(false)
 {
 	instance = this;
 }
 
+/**
+ * AssetTracker class destructor, any tuples that have not been
+ * sent to the core are sent
+ */
+AssetTracker::~AssetTracker()
+{
+	flush(true);
+	if (instance == this)
+	{
+		instance = NULL;
+	}
+}
+
 /**
  * Fetch all asset tracking tuples from DB and populate local cache
  *
@@ -46,13 +59,14 @@ AssetTracker::AssetTracker(ManagementClient *mgtClient, string service)
  */
 void AssetTracker::populateAssetTrackingCache(string /*plugin*/, string /*event*/)
 {
+	if (m_populated)
+	{
+		// Already populated from the bootstrap of the service
+		return;
+	}
 	try {
 		std::vector<AssetTrackingTuple*>& vec = m_mgtClient->getAssetTrackingTuples(m_service);
-		for (AssetTrackingTuple* & rec : vec)
-		{
-			assetTrackerTuplesCache.insert(rec);
-			//Logger::getLogger()->info("Added asset tracker tuple to cache: '%s'", rec->assetToString().c_str());
-		}
+		populateAssetTrackingCache(vec);
 		delete (&vec);
 	}
 	catch (...)
@@ -62,6 +76,27 @@ void AssetTracker::populateAssetTrackingCache(string /*plugin*/, string /*event*
 	}
 }
 
+/**
+ * Populate the local cache with asset tracking tuples already fetched
+ * from the core. The cache takes ownership of the tuples and the vector
+ * is emptied.
+ *
+ * @param tuples	The asset tracking tuples of the service
+ */
+void AssetTracker::populateAssetTrackingCache(std::vector<AssetTrackingTuple *>& tuples)
+{
+	lock_guard<mutex> guard(m_mutex);
+	for (AssetTrackingTuple *rec : tuples)
+	{
+		if (!assetTrackerTuplesCache.insert(rec).second)
+		{
+			delete rec;
+		}
+	}
+	tuples.clear();
+	m_populated = true;
+}
+
 
 /**
  * Check local cache for a given asset tracking tuple
@@ -72,6 +107,7 @@ void AssetTracker::populateAssetTrackingCache(string /*plugin*/, string /*event*
 bool AssetTracker::checkAssetTrackingCache(AssetTrackingTuple& tuple)	
 {
 	AssetTrackingTuple *ptr = &tuple;
+	lock_guard<mutex> guard(m_mutex);
 	std::unordered_set<AssetTrackingTuple*>::const_iterator it = assetTrackerTuplesCache.find(ptr);
 	if (it == assetTrackerTuplesCache.end())
 	{
@@ -83,24 +119,65 @@ bool AssetTracker::checkAssetTrackingCache(AssetTrackingTuple& tuple)
 
 
 /**
- * Add asset tracking tuple via microservice management API and in cache
+ * Add asset tracking tuple to the cache and queue it to be sent to
+ * the core by the next call to flush
  *
  * @param tuple		New tuple to add in DB and in cache
  */
 void AssetTracker::addAssetTrackingTuple(AssetTrackingTuple& tuple)
 {
+	lock_guard<mutex> guard(m_mutex);
 	std::unordered_set<AssetTrackingTuple*>::const_iterator it = assetTrackerTuplesCache.find(&tuple);
 	if (it == assetTrackerTuplesCache.end())
 	{
-		bool rv = m_mgtClient->addAssetTrackingTuple(tuple.m_serviceName, tuple.m_pluginName, tuple.m_assetName, tuple.m_eventName);
-		if (rv) // insert into cache only if DB operation succeeded
+		AssetTrackingTuple *ptr = new AssetTrackingTuple(tuple);
+		assetTrackerTuplesCache.insert(ptr);
+		m_pending.push_back(ptr);
+	}
+}
+
+/**
+ * Send the tuples added since the last flush to the core in a single
+ * asynchronous request and collect the results of earlier requests.
+ * If a request failed its tuples are removed from the cache so that
+ * they are added again when the asset is next seen.
+ *
+ * @param wait	Wait for all the requests to complete
+ */
+void AssetTracker::flush(bool wait)
+{
+	lock_guard<mutex> guard(m_mutex);
+	if (!m_pending.empty())
+	{
+		m_sending.emplace_back(m_mgtClient->addAssetTrackingTuplesAsync(m_pending), m_pending);
+		m_pending.clear();
+	}
+	while (!m_sending.empty())
+	{
+		future<bool>& result = m_sending.front().first;
+		if (!wait && result.wait_for(chrono::seconds(0)) != future_status::ready)
+		{
+			break;
+		}
+		bool added = false;
+		try {
+			added = result.get();
+		} catch (...) {
+		}
+		for (auto tuple : m_sending.front().second)
 		{
-			AssetTrackingTuple *ptr = new AssetTrackingTuple(tuple);
-			assetTrackerTuplesCache.insert(ptr);
-			Logger::getLogger()->info("addAssetTrackingTuple(): Added tuple to cache: '%s'", tuple.assetToString().c_str());
+			if (added)
+			{
+				Logger::getLogger()->info("addAssetTrackingTuple(): Added tuple to cache: '%s'", tuple->assetToString().c_str());
+			}
+			else
+			{
+				Logger::getLogger()->error("addAssetTrackingTuple(): Failed to insert asset tracking tuple into DB: '%s'", tuple->assetToString().c_str());
+				assetTrackerTuplesCache.erase(tuple);
+				delete tuple;
+			}
 		}
-		else
-			Logger::getLogger()->error("addAssetTrackingTuple(): Failed to insert asset tracking tuple into DB: '%s'", tuple.assetToString().c_str());
+		m_sending.pop_front();
 	}
 }
 
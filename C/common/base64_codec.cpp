@@ -0,0 +1,407 @@
+/*
+ * Fledge Base64 encoding and decoding of binary data
+ *
+ * Copyright (c) 2026 Dianomic Systems
+ *
+ * Released under the Apache 2.0 Licence
+ *
+ * Author: agent
+ */
+#include <base64_codec.h>
+#include <cstdint>
+#include <cstring>
+#include <base64.h>
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define BASE64_X86
+#endif
+
+using namespace std;
+
+/**
+ * The functions that encode and decode the bulk of the data a block at
+ * a time. The encoder returns the number of bytes it has encoded, a
+ * multiple of 3, and the decoder the number of characters it has decoded,
+ * a multiple of 4. The table driven code completes the work, including
+ * any padding and the detection of invalid characters.
+ */
+typedef size_t (*EncodeBlocks)(const uint8_t *data, size_t length, char *out);
+typedef size_t (*DecodeBlocks)(const char *encoded, size_t length, uint8_t *out);
+
+/**
+ * The decoding table with the padding character marked as invalid, the
+ * shared table decodes it as zero
+ */
+static struct StrictDecodingTable {
+	StrictDecodingTable()
+	{
+		memcpy(m_table, decodingTable, sizeof(m_table));
+		m_table[(uint8_t)'='] = 64;
+	}
+	uint8_t	m_table[256];
+} strict;
+
+/**
+ * Table driven encoding of the data, including the padding
+ */
+static void encodeTable(const uint8_t *data, size_t length, char *out)
+{
+	size_t i = 0;
+	for (; i + 2 < length; i += 3)
+	{
+		uint32_t triple = (data[i] << 16) | (data[i + 1] << 8) | data[i + 2];
+		*out++ = encodingTable[(triple >> 18) & 0x3F];
+		*out++ = encodingTable[(triple >> 12) & 0x3F];
+		*out++ = encodingTable[(triple >> 6) & 0x3F];
+		*out++ = encodingTable[triple & 0x3F];
+	}
+	if (i < length)
+	{
+		uint32_t triple = data[i] << 16;
+		if (i + 1 < length)
+			triple |= data[i + 1] << 8;
+		*out++ = encodingTable[(triple >> 18) & 0x3F];
+		*out++ = encodingTable[(triple >> 12) & 0x3F];
+		*out++ = i + 1 < length ? encodingTable[(triple >> 6) & 0x3F] : '=';
+		*out++ = '=';
+	}
+}
+
+/**
+ * Table driven decoding of the encoded data, padding is only accepted
+ * at the end of the data
+ *
+ * @return false if the data contains an invalid character
+ */
+static bool decodeTable(const char *encoded, size_t length, uint8_t *out)
+{
+	const uint8_t *table = strict.m_table;
+	for (size_t i = 0; i < length; i += 4)
+	{
+		uint32_t a = table[(uint8_t)encoded[i]];
+		uint32_t b = table[(uint8_t)encoded[i + 1]];
+		if (i + 4 == length && encoded[i + 3] == '=')
+		{
+			if ((a | b) > 63)
+				return false;
+			*out++ = (a << 2) | (b >> 4);
+			if (encoded[i + 2] == '=')
+				return true;
+			uint32_t c = table[(uint8_t)encoded[i + 2]];
+			if (c > 63)
+				return false;
+			*out++ = (b << 4) | (c >> 2);
+			return true;
+		}
+		uint32_t c = table[(uint8_t)encoded[i + 2]];
+		uint32_t d = table[(uint8_t)encoded[i + 3]];
+		if ((a | b | c | d) > 63)
+			return false;
+		uint32_t triple = (a << 18) | (b << 12) | (c << 6) | d;
+		*out++ = (triple >> 16) & 0xFF;
+		*out++ = (triple >> 8) & 0xFF;
+		*out++ = triple & 0xFF;
+	}
+	return true;
+}
+
+static size_t encodeNone(const uint8_t *, size_t, char *)
+{
+	return 0;
+}
+
+static size_t decodeNone(const char *, size_t, uint8_t *)
+{
+	return 0;
+}
+
+#ifdef BASE64_X86
+/*
+ * The vector implementations follow the methods of Wojciech Mula and
+ * Daniel Lemire, "Faster Base64 Encoding and Decoding using AVX2
+ * Instructions", ACM Transactions on the Web 12(3), 2018.
+ *
+ * Encoding shuffles each group of 3 bytes into a 32 bit lane, separates
+ * the four 6 bit values with multiplies and translates them to the
+ * alphabet with a lookup of the offset of each range of the alphabet.
+ *
+ * Decoding classifies each character by its high and low nibbles to
+ * find invalid characters, translates the characters with a lookup of
+ * the offset for their high nibble and packs the 6 bit values with
+ * multiply adds.
+ */
+
+/**
+ * Translate 16 values of 0 to 63 to the Base64 alphabet
+ */
+__attribute__((target("sse4.1")))
+static inline __m128i translateSSE(__m128i in)
+{
+	const __m128i lut = _mm_setr_epi8(65, 71, -4, -4, -4, -4, -4, -4,
+					-4, -4, -4, -4, -19, -16, 0, 0);
+	__m128i indices = _mm_subs_epu8(in, _mm_set1_epi8(51));
+	__m128i mask = _mm_cmpgt_epi8(in, _mm_set1_epi8(25));
+	indices = _mm_sub_epi8(indices, mask);
+	return _mm_add_epi8(in, _mm_shuffle_epi8(lut, indices));
+}
+
+/**
+ * Encode 12 bytes at a time, reading 16 bytes
+ */
+__attribute__((target("sse4.1")))
+static size_t encodeSSE(const uint8_t *data, size_t length, char *out)
+{
+	size_t done = 0;
+	while (length - done >= 16)
+	{
+		__m128i in = _mm_loadu_si128((const __m128i *)(data + done));
+		in = _mm_shuffle_epi8(in, _mm_set_epi8(10, 11, 9, 10, 7, 8, 6, 7,
+							4, 5, 3, 4, 1, 2, 0, 1));
+		__m128i t0 = _mm_and_si128(in, _mm_set1_epi32(0x0FC0FC00));
+		__m128i t1 = _mm_mulhi_epu16(t0, _mm_set1_epi32(0x04000040));
+		__m128i t2 = _mm_and_si128(in, _mm_set1_epi32(0x003F03F0));
+		__m128i t3 = _mm_mullo_epi16(t2, _mm_set1_epi32(0x01000010));
+		_mm_storeu_si128((__m128i *)out, translateSSE(_mm_or_si128(t1, t3)));
+		out += 16;
+		done += 12;
+	}
+	return done;
+}
+
+/**
+ * Decode 16 characters at a time, stopping at a block with an invalid
+ * character. The final 4 characters, which may be padding, are left
+ * for the table driven decoder.
+ */
+__attribute__((target("sse4.1")))
+static size_t decodeSSE(const char *encoded, size_t length, uint8_t *out)
+{
+	const __m128i lutLo = _mm_setr_epi8(0x15, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11,
+					0x11, 0x11, 0x13, 0x1A, 0x1B, 0x1B, 0x1B, 0x1A);
+	const __m128i lutHi = _mm_setr_epi8(0x10, 0x10, 0x01, 0x02, 0x04, 0x08, 0x04, 0x08,
+					0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10);
+	const __m128i lutRoll = _mm_setr_epi8(0, 16, 19, 4, -65, -65, -71, -71,
+					0, 0, 0, 0, 0, 0, 0, 0);
+	const __m128i mask2F = _mm_set1_epi8(0x2F);
+	size_t done = 0;
+	while (length - done >= 20)
+	{
+		__m128i str = _mm_loadu_si128((const __m128i *)(encoded + done));
+		__m128i hiNibbles = _mm_and_si128(_mm_srli_epi32(str, 4), mask2F);
+		__m128i loNibbles = _mm_and_si128(str, mask2F);
+		__m128i hi = _mm_shuffle_epi8(lutHi, hiNibbles);
+		__m128i lo = _mm_shuffle_epi8(lutLo, loNibbles);
+		if (!_mm_testz_si128(lo, hi))
+			break;
+		__m128i eq2F = _mm_cmpeq_epi8(str, mask2F);
+		str = _mm_add_epi8(str, _mm_shuffle_epi8(lutRoll, _mm_add_epi8(eq2F, hiNibbles)));
+		__m128i merged = _mm_maddubs_epi16(str, _mm_set1_epi32(0x01400140));
+		__m128i packed = _mm_madd_epi16(merged, _mm_set1_epi32(0x00011000));
+		packed = _mm_shuffle_epi8(packed, _mm_setr_epi8(2, 1, 0, 6, 5, 4, 10, 9,
+							8, 14, 13, 12, -1, -1, -1, -1));
+		_mm_storel_epi64((__m128i *)out, packed);
+		uint32_t last = _mm_extract_epi32(packed, 2);
+		memcpy(out + 8, &last, sizeof(last));
+		out += 12;
+		done += 16;
+	}
+	return done;
+}
+
+/**
+ * Encode 24 bytes at a time, reading 28 bytes, the rest of the data
+ * is encoded 12 bytes at a time
+ */
+__attribute__((target("avx2")))
+static size_t encodeAVX2(const uint8_t *data, size_t length, char *out)
+{
+	const __m256i lut = _mm256_setr_epi8(65, 71, -4, -4, -4, -4, -4, -4,
+					-4, -4, -4, -4, -19, -16, 0, 0,
+					65, 71, -4, -4, -4, -4, -4, -4,
+					-4, -4, -4, -4, -19, -16, 0, 0);
+	size_t done = 0;
+	while (length - done >= 28)
+	{
+		// The low lane holds bytes 0 to 11 in its top 12 bytes,
+		// the high lane bytes 12 to 23 in its bottom 12 bytes
+		__m128i lo = _mm_slli_si128(_mm_loadu_si128((const __m128i *)(data + done)), 4);
+		__m128i hi = _mm_loadu_si128((const __m128i *)(data + done + 12));
+		__m256i in = _mm256_inserti128_si256(_mm256_castsi128_si256(lo), hi, 1);
+		in = _mm256_shuffle_epi8(in, _mm256_set_epi8(10, 11, 9, 10, 7, 8, 6, 7,
+							4, 5, 3, 4, 1, 2, 0, 1,
+							14, 15, 13, 14, 11, 12, 10, 11,
+							8, 9, 7, 8, 5, 6, 4, 5));
+		__m256i t0 = _mm256_and_si256(in, _mm256_set1_epi32(0x0FC0FC00));
+		__m256i t1 = _mm256_mulhi_epu16(t0, _mm256_set1_epi32(0x04000040));
+		__m256i t2 = _mm256_and_si256(in, _mm256_set1_epi32(0x003F03F0));
+		__m256i t3 = _mm256_mullo_epi16(t2, _mm256_set1_epi32(0x01000010));
+		__m256i indices = _mm256_or_si256(t1, t3);
+		__m256i offsets = _mm256_subs_epu8(indices, _mm256_set1_epi8(51));
+		offsets = _mm256_sub_epi8(offsets, _mm256_cmpgt_epi8(indices, _mm256_set1_epi8(25)));
+		_mm256_storeu_si256((__m256i *)out, _mm256_add_epi8(indices, _mm256_shuffle_epi8(lut, offsets)));
+		out += 32;
+		done += 24;
+	}
+	return done + encodeSSE(data + done, length - done, out);
+}
+
+/**
+ * Decode 32 characters at a time, the rest of the data is decoded
+ * 16 characters at a time
+ */
+__attribute__((target("avx2")))
+static size_t decodeAVX2(const char *encoded, size_t length, uint8_t *out)
+{
+	const __m256i lutLo = _mm256_setr_epi8(0x15, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11,
+					0x11, 0x11, 0x13, 0x1A, 0x1B, 0x1B, 0x1B, 0x1A,
+					0x15, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11,
+					0x11, 0x11, 0x13, 0x1A, 0x1B, 0x1B, 0x1B, 0x1A);
+	const __m256i lutHi = _mm256_setr_epi8(0x10, 0x10, 0x01, 0x02, 0x04, 0x08, 0x04, 0x08,
+					0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10,
+					0x10, 0x10, 0x01, 0x02, 0x04, 0x08, 0x04, 0x08,
+					0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10);
+	const __m256i lutRoll = _mm256_setr_epi8(0, 16, 19, 4, -65, -65, -71, -71,
+					0, 0, 0, 0, 0, 0, 0, 0,
+					0, 16, 19, 4, -65, -65, -71, -71,
+					0, 0, 0, 0, 0, 0, 0, 0);
+	const __m256i mask2F = _mm256_set1_epi8(0x2F);
+	size_t done = 0;
+	while (length - done >= 36)
+	{
+		__m256i str = _mm256_loadu_si256((const __m256i *)(encoded + done));
+		__m256i hiNibbles = _mm256_and_si256(_mm256_srli_epi32(str, 4), mask2F);
+		__m256i loNibbles = _mm256_and_si256(str, mask2F);
+		__m256i hi = _mm256_shuffle_epi8(lutHi, hiNibbles);
+		__m256i lo = _mm256_shuffle_epi8(lutLo, loNibbles);
+		if (!_mm256_testz_si256(lo, hi))
+			break;
+		__m256i eq2F = _mm256_cmpeq_epi8(str, mask2F);
+		str = _mm256_add_epi8(str, _mm256_shuffle_epi8(lutRoll, _mm256_add_epi8(eq2F, hiNibbles)));
+		__m256i merged = _mm256_maddubs_epi16(str, _mm256_set1_epi32(0x01400140));
+		__m256i packed = _mm256_madd_epi16(merged, _mm256_set1_epi32(0x00011000));
+		packed = _mm256_shuffle_epi8(packed, _mm256_setr_epi8(2, 1, 0, 6, 5, 4, 10, 9,
+							8, 14, 13, 12, -1, -1, -1, -1,
+							2, 1, 0, 6, 5, 4, 10, 9,
+							8, 14, 13, 12, -1, -1, -1, -1));
+		packed = _mm256_permutevar8x32_epi32(packed, _mm256_setr_epi32(0, 1, 2, 4, 5, 6, 3, 7));
+		_mm_storeu_si128((__m128i *)out, _mm256_castsi256_si128(packed));
+		_mm_storel_epi64((__m128i *)(out + 16), _mm256_extracti128_si256(packed, 1));
+		out += 24;
+		done += 32;
+	}
+	return done + decodeSSE(encoded + done, length - done, out);
+}
+#endif
+
+/**
+ * The block coders for the processor
+ */
+struct Base64Implementation {
+	const char	*m_name;
+	EncodeBlocks	m_encode;
+	DecodeBlocks	m_decode;
+};
+
+/**
+ * Choose the block coders supported by the processor
+ */
+static Base64Implementation selectImplementation()
+{
+	Base64Implementation impl = { "table", encodeNone, decodeNone };
+#ifdef BASE64_X86
+	__builtin_cpu_init();
+	if (__builtin_cpu_supports("avx2"))
+	{
+		impl = { "avx2", encodeAVX2, decodeAVX2 };
+	}
+	else if (__builtin_cpu_supports("sse4.1"))
+	{
+		impl = { "sse4.1", encodeSSE, decodeSSE };
+	}
+#endif
+	return impl;
+}
+
+static const Base64Implementation& implementation()
+{
+	static const Base64Implementation impl = selectImplementation();
+	return impl;
+}
+
+/**
+ * Encode data in Base64
+ *
+ * @param data		The data to encode
+ * @param length	The number of bytes of data
+ * @param out		The buffer for the base64EncodedLength characters
+ *			of the encoding, no null terminator is added
+ */
+void base64Encode(const void *data, size_t length, char *out)
+{
+	const uint8_t *bytes = (const uint8_t *)data;
+	size_t done = implementation().m_encode(bytes, length, out);
+	encodeTable(bytes + done, length - done, out + done / 3 * 4);
+}
+
+/**
+ * Append the Base64 encoding of data to a string
+ *
+ * @param out		The string to append to
+ * @param data		The data to encode
+ * @param length	The number of bytes of data
+ */
+void base64Append(string& out, const void *data, size_t length)
+{
+	size_t pos = out.length();
+	out.resize(pos + base64EncodedLength(length));
+	base64Encode(data, length, &out[pos]);
+}
+
+/**
+ * Return the number of bytes of data Base64 encoded data decodes to
+ *
+ * @param encoded	The encoded data
+ * @param length	The number of characters of encoded data
+ * @return The number of bytes or -1 if the length is not a multiple of 4
+ */
+size_t base64DecodedLength(const char *encoded, size_t length)
+{
+	if (length % 4 != 0)
+	{
+		return (size_t)-1;
+	}
+	size_t decoded = length / 4 * 3;
+	if (length && encoded[length - 1] == '=')
+		decoded--;
+	if (length && encoded[length - 2] == '=')
+		decoded--;
+	return decoded;
+}
+
+/**
+ * Decode Base64 encoded data
+ *
+ * @param encoded	The encoded data, a multiple of 4 characters
+ * @param length	The number of characters of encoded data
+ * @param data		The buffer for the base64DecodedLength bytes of data
+ * @return false if the encoded data is not valid Base64
+ */
+bool base64Decode(const char *encoded, size_t length, void *data)
+{
+	if (length % 4 != 0)
+	{
+		return false;
+	}
+	uint8_t *bytes = (uint8_t *)data;
+	size_t done = implementation().m_decode(encoded, length, bytes);
+	return decodeTable(encoded + done, length - done, bytes + done / 4 * 3);
+}
+
+/**
+ * Return the name of the implementation used for the bulk of the data,
+ * avx2, sse4.1 or table
+ */
+const char *base64Implementation()
+{
+	return implementation().m_name;
+}
@@ -19,84 +19,76 @@ using namespace std;
  */
 Base64DPImage::Base64DPImage(const string& data)
 {
-	sscanf(data.c_str(), "%d,%d,%d_", &m_width, &m_height, &m_depth);
-	m_byteSize = m_width * m_height * (m_depth / 8);
-	size_t pos = data.find_first_of("_");
-	string encoded;
-	if (pos != string::npos)
+	decode(data.data(), data.length());
+}
+
+/**
+ * Construct a DPImage by decoding a Base64 encoded buffer held in
+ * part of a larger string, such as a JSON document
+ *
+ * @param data		The image header followed by the encoded pixels
+ * @param length	The length of the encoded buffer
+ */
+Base64DPImage::Base64DPImage(const char *data, size_t length)
+{
+	decode(data, length);
+}
+
+/**
+ * Decode the header of the image and the pixels, which are decoded
+ * straight into the memory of the image
+ */
+void Base64DPImage::decode(const char *data, size_t length)
+{
+	const char *end = data + length;
+	const char *sep = (const char *)memchr(data, '_', length);
+	if (sep == NULL || sscanf(string(data, sep - data).c_str(), "%d,%d,%d", &m_width, &m_height, &m_depth) != 3)
 	{
-		encoded = data.substr(pos + 1);
+		throw runtime_error("Base64DPImage image header is not valid");
 	}
-	size_t in_len = encoded.size();
-	if (in_len % 4 != 0)
+	m_byteSize = m_width * m_height * (m_depth / 8);
+	const char *encoded = sep + 1;
+	size_t in_len = end - encoded;
+	size_t decoded = base64DecodedLength(encoded, in_len);
+	if (decoded == (size_t)-1)
 	{
 		throw runtime_error("Base64DataBuffer string is incorrect length");
 	}
-	if ((m_pixels = malloc(m_byteSize)) == NULL)
+	if (decoded != (size_t)m_byteSize)
 	{
-		throw runtime_error("Base64DataBuffer insufficient memory to store data");
+		throw runtime_error("Base64DPImage encoded data does not match the image size");
 	}
-	uint8_t *ptr = (uint8_t *)m_pixels;
-
-	for (size_t i = 0, j = 0; i < in_len;)
+	allocate();
+	if (!base64Decode(encoded, in_len, m_pixels))
 	{
-		uint32_t a = encoded[i] == '=' ? 0 & i++ : decodingTable[(uint8_t)(encoded[i++])];
-		uint32_t b = encoded[i] == '=' ? 0 & i++ : decodingTable[(uint8_t)(encoded[i++])];
-		uint32_t c = encoded[i] == '=' ? 0 & i++ : decodingTable[(uint8_t)(encoded[i++])];
-		uint32_t d = encoded[i] == '=' ? 0 & i++ : decodingTable[(uint8_t)(encoded[i++])];
-
-		uint32_t triple = (a << 3 * 6) + (b << 2 * 6) + (c << 1 * 6) + (d << 0 * 6);
-
-		if (j < m_byteSize)
-			ptr[j++] = (triple >> 2 * 8) & 0xFF;
-		if (j < m_byteSize)
-			ptr[j++] = (triple >> 1 * 8) & 0xFF;
-		if (j < m_byteSize)
-			ptr[j++] = (triple >> 0 * 8) & 0xFF;
+		m_buffer.reset();
+		m_pixels = NULL;
+		throw runtime_error("Base64DPImage image data is not valid Base64");
 	}
 }
 
 /**
- * Base 64 encode the DPImage. Note the first character is
- * not the data itself but an unencoded value for itemSize
+ * Base 64 encode the DPImage. Note the encoded pixels are
+ * preceded by a header of the width, height and depth
  */
 string Base64DPImage::encode()
+{
+	string rstr;
+	appendEncoded(rstr);
+	return rstr;
+}
+
+/**
+ * Append the Base 64 encoding of the DPImage to a string, as
+ * returned by encode
+ *
+ * @param out	The string to append to
+ */
+void Base64DPImage::appendEncoded(string& out) const
 {
 	char buf[80];
 	int hlen = snprintf(buf, sizeof(buf), "%d,%d,%d_", m_width, m_height, m_depth);
-	size_t nBytes = m_byteSize;
-	size_t encoded = 4 * ((nBytes + 2) / 3);
-	uint8_t *ret = (uint8_t *)malloc(hlen + encoded + 1);
-	strcpy((char *)ret, buf);
-	register uint8_t *p = ret + hlen;
-	register uint8_t *data = (uint8_t *)m_pixels;
-	int i;
-	for (i = 0; i < m_byteSize - 2; i += 3)
-	{
-		*p++ = encodingTable[(*data >> 2) & 0x3F];
-		*p++ = encodingTable[((*data & 0x3) << 4) | ((unsigned int) (*(data + 1) & 0xF0) >> 4)];
-		*p++ = encodingTable[((*(data + 1) & 0xF) << 2) | ((unsigned int) (*(data + 2) & 0xC0) >> 6)];
-		*p++ = encodingTable[*(data + 2) & 0x3F];
-		data += 3;
-	}
-	if (i < nBytes)
-	{
-		*p++ = encodingTable[(*data >> 2) & 0x3F];
-		if (i == (nBytes - 1))
-		{
-			*p++ = encodingTable[((*data & 0x3) << 4)];
-			*p++ = '=';
-		}
-		else
-		{
-			*p++ = encodingTable[((*data & 0x3) << 4) | ((unsigned int) (*(data + 1) & 0xF0) >> 4)];
-			*p++ = encodingTable[((*(data + 1) & 0xF) << 2)];
-		}
-		*p++ = '=';
-	}
-	*p = '\0';
-	string rstr((char *)ret);
-	free(ret);
-	
-	return rstr;
+	out.reserve(out.length() + hlen + base64EncodedLength(m_byteSize));
+	out.append(buf, hlen);
+	base64Append(out, m_pixels, m_byteSize);
 }
@@ -0,0 +1,457 @@
+/*
+ * Fledge evaluation of an expression over batches of values
+ *
+ * Copyright (c) 2026 Dianomic Systems
+ *
+ * Released under the Apache 2.0 Licence
+ *
+ * Author: agent
+ */
+#define exprtk_disable_string_capabilities
+#define exprtk_disable_rtl_io_file
+#include <exprtk.hpp>
+#include <batch_expression.h>
+#include <stdexcept>
+#include <cmath>
+#include <ctype.h>
+#include <stdlib.h>
+#include <string.h>
+
+using namespace std;
+
+/**
+ * An expression compiled by exprtk with the variables bound to an array
+ * that holds the values of a row
+ */
+class ExprtkExpression {
+	public:
+		ExprtkExpression(const vector<string>& variables) : m_values(variables.size(), 0.0)
+		{
+			for (size_t i = 0; i < variables.size(); i++)
+			{
+				m_symbols.add_variable(variables[i], m_values[i]);
+			}
+			m_symbols.add_constants();
+			m_expression.register_symbol_table(m_symbols);
+		};
+		vector<double>			m_values;
+		exprtk::symbol_table<double>	m_symbols;
+		exprtk::expression<double>	m_expression;
+};
+
+/**
+ * Compile an expression. A runtime_error is thrown if the expression is
+ * not valid.
+ *
+ * @param expression	The expression
+ * @param variables	The names of the variables of the expression, the
+ *			columns passed to evaluate are in the same order
+ */
+BatchExpression::BatchExpression(const string& expression, const vector<string>& variables) :
+		m_variables(variables), m_maxDepth(0), m_exprtk(NULL)
+{
+	bool compiled = compile(expression);
+	m_tokens.clear();
+	if (compiled)
+	{
+		m_stack.resize(m_maxDepth * BATCH_EXPRESSION_BLOCK);
+		return;
+	}
+	m_program.clear();
+	m_exprtk = new ExprtkExpression(variables);
+	exprtk::parser<double> parser;
+	if (!parser.compile(expression, m_exprtk->m_expression))
+	{
+		string error = parser.error();
+		delete m_exprtk;
+		m_exprtk = NULL;
+		throw runtime_error("Invalid expression '" + expression + "': " + error);
+	}
+}
+
+/**
+ * Destructor for the expression
+ */
+BatchExpression::~BatchExpression()
+{
+	delete m_exprtk;
+}
+
+/**
+ * Evaluate the expression for each row of the columns
+ *
+ * @param columns	The values of each variable, in the order of the variables
+ * @param rows		The number of rows in each column
+ * @param results	The result of each row
+ */
+void BatchExpression::evaluate(const vector<const double *>& columns, size_t rows, double *results)
+{
+	if (columns.size() != m_variables.size())
+	{
+		throw runtime_error("Expression evaluated with the wrong number of columns");
+	}
+	if (m_exprtk)
+	{
+		for (size_t row = 0; row < rows; row++)
+		{
+			for (size_t i = 0; i < columns.size(); i++)
+			{
+				m_exprtk->m_values[i] = columns[i][row];
+			}
+			results[row] = m_exprtk->m_expression.value();
+		}
+		return;
+	}
+	for (size_t offset = 0; offset < rows; offset += BATCH_EXPRESSION_BLOCK)
+	{
+		size_t block = rows - offset;
+		if (block > BATCH_EXPRESSION_BLOCK)
+		{
+			block = BATCH_EXPRESSION_BLOCK;
+		}
+		run(columns, offset, block, results + offset);
+	}
+}
+
+/**
+ * Evaluate the expression for each reading of an asset, the variables
+ * are the datapoints of the asset. The result of a reading that does not
+ * have all the datapoints is NaN.
+ *
+ * @param asset		The columns of the readings of the asset
+ * @param results	Set to the result of each reading
+ * @return bool		False if a variable is not a numeric datapoint of the asset
+ */
+bool BatchExpression::evaluate(AssetColumns& asset, vector<double>& results)
+{
+	size_t rows = asset.getRows();
+	vector<vector<double> > converted(m_variables.size());
+	vector<const double *> columns;
+	vector<ReadingColumn *> sources;
+	for (size_t i = 0; i < m_variables.size(); i++)
+	{
+		ReadingColumn *column = asset.getColumn(m_variables[i]);
+		if (!column)
+		{
+			return false;
+		}
+		if (column->getType() == ReadingColumn::COL_FLOAT)
+		{
+			columns.push_back(column->getFloats().data());
+		}
+		else if (column->getType() == ReadingColumn::COL_INTEGER)
+		{
+			vector<long>& integers = column->getIntegers();
+			converted[i].assign(integers.begin(), integers.end());
+			columns.push_back(converted[i].data());
+		}
+		else
+		{
+			return false;
+		}
+		sources.push_back(column);
+	}
+	results.resize(rows);
+	evaluate(columns, rows, results.data());
+	for (auto column : sources)
+	{
+		for (size_t row = 0; row < rows; row++)
+		{
+			if (!column->isPresent(row))
+			{
+				results[row] = NAN;
+			}
+		}
+	}
+	return true;
+}
+
+/**
+ * Run the program over a block of rows. Each instruction is applied to
+ * the whole block before the next, the stack holds a block of values
+ * at each depth.
+ *
+ * @param columns	The values of each variable
+ * @param offset	The first row of the block
+ * @param rows		The number of rows in the block
+ * @param results	The results of the block
+ */
+void BatchExpression::run(const vector<const double *>& columns, size_t offset,
+			  size_t rows, double *results)
+{
+	int depth = 0;
+	for (auto& instruction : m_program)
+	{
+		double *top = &m_stack[depth * BATCH_EXPRESSION_BLOCK];
+		double *next = top - BATCH_EXPRESSION_BLOCK;
+		switch (instruction.m_op)
+		{
+		case OP_VARIABLE:
+		{
+			const double *values = columns[instruction.m_variable] + offset;
+			for (size_t i = 0; i < rows; i++)
+				top[i] = values[i];
+			depth++;
+			break;
+		}
+		case OP_CONSTANT:
+		{
+			double constant = instruction.m_constant;
+			for (size_t i = 0; i < rows; i++)
+				top[i] = constant;
+			depth++;
+			break;
+		}
+		case OP_NEGATE:
+			for (size_t i = 0; i < rows; i++)
+				next[i] = -next[i];
+			break;
+		case OP_ADD:
+			next -= BATCH_EXPRESSION_BLOCK;
+			for (size_t i = 0; i < rows; i++)
+				next[i] += next[i + BATCH_EXPRESSION_BLOCK];
+			depth--;
+			break;
+		case OP_SUBTRACT:
+			next -= BATCH_EXPRESSION_BLOCK;
+			for (size_t i = 0; i < rows; i++)
+				next[i] -= next[i + BATCH_EXPRESSION_BLOCK];
+			depth--;
+			break;
+		case OP_MULTIPLY:
+			next -= BATCH_EXPRESSION_BLOCK;
+			for (size_t i = 0; i < rows; i++)
+				next[i] *= next[i + BATCH_EXPRESSION_BLOCK];
+			depth--;
+			break;
+		case OP_DIVIDE:
+			next -= BATCH_EXPRESSION_BLOCK;
+			for (size_t i = 0; i < rows; i++)
+				next[i] /= next[i + BATCH_EXPRESSION_BLOCK];
+			depth--;
+			break;
+		}
+	}
+	for (size_t i = 0; i < rows; i++)
+		results[i] = m_stack[i];
+}
+
+/**
+ * Compile the expression into a program if it only uses the operations
+ * that can be evaluated a block at a time
+ *
+ * @param expression	The expression
+ * @return bool		False if the expression must be evaluated by exprtk
+ */
+bool BatchExpression::compile(const string& expression)
+{
+	if (!tokenise(expression))
+	{
+		return false;
+	}
+	size_t pos = 0;
+	int depth = 0;
+	if (!parseSum(pos, depth))
+	{
+		return false;
+	}
+	return m_tokens[pos].m_type == Token::END && depth == 1;
+}
+
+/**
+ * Split the expression into numbers, identifiers and single character
+ * operators
+ *
+ * @param expression	The expression
+ * @return bool		False if the expression has characters the program
+ *			does not support
+ */
+bool BatchExpression::tokenise(const string& expression)
+{
+	const char *p = expression.c_str();
+	m_tokens.clear();
+	while (*p)
+	{
+		Token token;
+		if (isspace(*p))
+		{
+			p++;
+			continue;
+		}
+		if (isdigit(*p) || (*p == '.' && isdigit(p[1])))
+		{
+			char *end;
+			token.m_type = Token::NUMBER;
+			token.m_number = strtod(p, &end);
+			// Numbers such as 2x are implicit multiplications in exprtk
+			if (isalpha(*end) || *end == '_')
+			{
+				return false;
+			}
+			p = end;
+		}
+		else if (isalpha(*p) || *p == '_')
+		{
+			const char *start = p;
+			while (isalnum(*p) || *p == '_')
+				p++;
+			token.m_type = Token::IDENTIFIER;
+			token.m_text.assign(start, p - start);
+		}
+		else if (strchr("+-*/()", *p))
+		{
+			token.m_type = Token::OPERATOR;
+			token.m_text.assign(p, 1);
+			p++;
+		}
+		else
+		{
+			return false;
+		}
+		m_tokens.push_back(token);
+	}
+	Token end;
+	end.m_type = Token::END;
+	m_tokens.push_back(end);
+	return true;
+}
+
+/**
+ * Parse a sum, products separated by + or -
+ */
+bool BatchExpression::parseSum(size_t& pos, int& depth)
+{
+	if (!parseProduct(pos, depth))
+	{
+		return false;
+	}
+	while (m_tokens[pos].m_type == Token::OPERATOR &&
+			(m_tokens[pos].m_text == "+" || m_tokens[pos].m_text == "-"))
+	{
+		OpCode op = m_tokens[pos].m_text == "+" ? OP_ADD : OP_SUBTRACT;
+		pos++;
+		if (!parseProduct(pos, depth))
+		{
+			return false;
+		}
+		emit(Instruction(op), depth);
+	}
+	return true;
+}
+
+/**
+ * Parse a product, unary terms separated by * or /
+ */
+bool BatchExpression::parseProduct(size_t& pos, int& depth)
+{
+	if (!parseUnary(pos, depth))
+	{
+		return false;
+	}
+	while (m_tokens[pos].m_type == Token::OPERATOR &&
+			(m_tokens[pos].m_text == "*" || m_tokens[pos].m_text == "/"))
+	{
+		OpCode op = m_tokens[pos].m_text == "*" ? OP_MULTIPLY : OP_DIVIDE;
+		pos++;
+		if (!parseUnary(pos, depth))
+		{
+			return false;
+		}
+		emit(Instruction(op), depth);
+	}
+	return true;
+}
+
+/**
+ * Parse a term with an optional leading sign
+ */
+bool BatchExpression::parseUnary(size_t& pos, int& depth)
+{
+	if (m_tokens[pos].m_type == Token::OPERATOR && m_tokens[pos].m_text == "-")
+	{
+		pos++;
+		if (!parseUnary(pos, depth))
+		{
+			return false;
+		}
+		emit(Instruction(OP_NEGATE), depth);
+		return true;
+	}
+	if (m_tokens[pos].m_type == Token::OPERATOR && m_tokens[pos].m_text == "+")
+	{
+		pos++;
+		return parseUnary(pos, depth);
+	}
+	return parsePrimary(pos, depth);
+}
+
+/**
+ * Parse a number, a variable or a parenthesised sum. Any other
+ * identifier, such as a function or a constant of exprtk, is left to
+ * exprtk.
+ */
+bool BatchExpression::parsePrimary(size_t& pos, int& depth)
+{
+	const Token& token = m_tokens[pos];
+	if (token.m_type == Token::NUMBER)
+	{
+		pos++;
+		emit(Instruction(OP_CONSTANT, 0, token.m_number), depth);
+		return true;
+	}
+	if (token.m_type == Token::IDENTIFIER)
+	{
+		for (size_t i = 0; i < m_variables.size(); i++)
+		{
+			if (m_variables[i] == token.m_text)
+			{
+				pos++;
+				emit(Instruction(OP_VARIABLE, i), depth);
+				return true;
+			}
+		}
+		return false;
+	}
+	if (token.m_type == Token::OPERATOR && token.m_text == "(")
+	{
+		pos++;
+		if (!parseSum(pos, depth))
+		{
+			return false;
+		}
+		if (m_tokens[pos].m_type != Token::OPERATOR || m_tokens[pos].m_text != ")")
+		{
+			return false;
+		}
+		pos++;
+		return true;
+	}
+	return false;
+}
+
+/**
+ * Add an instruction to the program and track the depth of the stack
+ *
+ * @param instruction	The instruction
+ * @param depth		The depth of the stack after the previous instruction
+ */
+void BatchExpression::emit(const Instruction& instruction, int& depth)
+{
+	m_program.push_back(instruction);
+	switch (instruction.m_op)
+	{
+	case OP_VARIABLE:
+	case OP_CONSTANT:
+		depth++;
+		break;
+	case OP_NEGATE:
+		break;
+	default:
+		depth--;
+		break;
+	}
+	if (depth > m_maxDepth)
+	{
+		m_maxDepth = depth;
+	}
+}
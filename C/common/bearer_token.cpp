@@ -11,6 +11,8 @@
 #include "bearer_token.h"
 #include <rapidjson/document.h>
 #include <logger.h>
+#include <stdint.h>
+#include <base64.h>
 
 using namespace rapidjson;
 using namespace std;
@@ -141,3 +143,57 @@ bool BearerToken::verify(const string& response)
 
 	return m_verified;
 }
+
+/**
+ * Return the expiration claimed in the payload of the token, without
+ * verifying the token. This allows a token that has expired to be
+ * rejected without asking the core to verify it.
+ *
+ * @return	The expiration time or 0 if the token payload could not be read
+ */
+unsigned long BearerToken::getClaimedExpiration() const
+{
+	// A JWT is the base64url encoded header, payload and signature separated by '.'
+	size_t start = m_bearer_token.find('.');
+	if (start == string::npos)
+	{
+		return 0;
+	}
+	size_t end = m_bearer_token.find('.', ++start);
+	if (end == string::npos)
+	{
+		return 0;
+	}
+
+	string payload;
+	uint32_t bits = 0;
+	int nbits = 0;
+	for (size_t i = start; i < end; i++)
+	{
+		char c = m_bearer_token[i];
+		if (c == '-')
+			c = '+';
+		else if (c == '_')
+			c = '/';
+		uint8_t value = decodingTable[(uint8_t)c];
+		if (value == 64 || c == '=')
+		{
+			return 0;
+		}
+		bits = (bits << 6) | value;
+		nbits += 6;
+		if (nbits >= 8)
+		{
+			nbits -= 8;
+			payload += (char)((bits >> nbits) & 0xff);
+		}
+	}
+
+	Document doc;
+	doc.Parse(payload.c_str());
+	if (doc.HasParseError() || !doc.IsObject() || !doc.HasMember("exp") || !doc["exp"].IsUint64())
+	{
+		return 0;
+	}
+	return (unsigned long)doc["exp"].GetUint64();
+}
@@ -0,0 +1,239 @@
+/*
+ * Fledge numeric operations on columns of datapoint values
+ *
+ * Copyright (c) 2026 Dianomic Systems
+ *
+ * Released under the Apache 2.0 Licence
+ *
+ * Author: agent
+ */
+#include <column_kernels.h>
+#include <cmath>
+
+using namespace std;
+
+/**
+ * Multiply each value by a scale factor and add an offset
+ *
+ * @param values	The values, modified in place
+ * @param count		The number of values
+ * @param scale		The scale factor
+ * @param offset	The offset added after scaling
+ */
+void ColumnKernels::scaleOffset(double *values, size_t count, double scale, double offset)
+{
+	for (size_t i = 0; i < count; i++)
+		values[i] = values[i] * scale + offset;
+}
+
+/**
+ * Limit each value to a range
+ *
+ * @param values	The values, modified in place
+ * @param count		The number of values
+ * @param minimum	The lowest value allowed
+ * @param maximum	The highest value allowed
+ */
+void ColumnKernels::clamp(double *values, size_t count, double minimum, double maximum)
+{
+	for (size_t i = 0; i < count; i++)
+	{
+		double value = values[i] < minimum ? minimum : values[i];
+		values[i] = value > maximum ? maximum : value;
+	}
+}
+
+/**
+ * Calculate the rate of change per second of each value from the
+ * previous value. The rate of the first value is calculated from the
+ * last value of the previous call, it is NaN if there is none. The
+ * rate is also NaN if the time has not advanced.
+ *
+ * @param values	The values
+ * @param times		The time of each value in seconds
+ * @param count		The number of values
+ * @param rates		The rate of change of each value
+ * @param state		The last value and time, updated with the last value
+ */
+void ColumnKernels::rateOfChange(const double *values, const double *times, size_t count,
+				 double *rates, ColumnState& state)
+{
+	if (count == 0)
+	{
+		return;
+	}
+	rates[0] = state.m_valid && times[0] > state.m_time ?
+			(values[0] - state.m_value) / (times[0] - state.m_time) : NAN;
+	for (size_t i = 1; i < count; i++)
+	{
+		double interval = times[i] - times[i - 1];
+		rates[i] = interval > 0.0 ? (values[i] - values[i - 1]) / interval : NAN;
+	}
+	state.m_valid = true;
+	state.m_value = values[count - 1];
+	state.m_time = times[count - 1];
+}
+
+/**
+ * Mark the values that differ from the last value passed by more than
+ * a deadband. The first value ever seen is always passed.
+ *
+ * @param values	The values
+ * @param count		The number of values
+ * @param band		The deadband
+ * @param pass		Set to true for each value that is passed
+ * @param state		The last value passed, updated with the last value passed
+ */
+void ColumnKernels::deadband(const double *values, size_t count, double band,
+			     vector<bool>& pass, ColumnState& state)
+{
+	pass.assign(count, false);
+	for (size_t i = 0; i < count; i++)
+	{
+		if (!state.m_valid || fabs(values[i] - state.m_value) > band)
+		{
+			pass[i] = true;
+			state.m_valid = true;
+			state.m_value = values[i];
+		}
+	}
+}
+
+/**
+ * Scale and offset a floating point column. The values of the rows
+ * without the datapoint are not used.
+ *
+ * @param column	The column
+ * @param scale		The scale factor
+ * @param offset	The offset added after scaling
+ * @return bool		False if the column is not a floating point column
+ */
+bool ColumnKernels::scaleOffset(ReadingColumn& column, double scale, double offset)
+{
+	if (column.getType() != ReadingColumn::COL_FLOAT)
+	{
+		return false;
+	}
+	vector<double>& values = column.getFloats();
+	scaleOffset(values.data(), values.size(), scale, offset);
+	return true;
+}
+
+/**
+ * Limit the values of a floating point column to a range
+ *
+ * @param column	The column
+ * @param minimum	The lowest value allowed
+ * @param maximum	The highest value allowed
+ * @return bool		False if the column is not a floating point column
+ */
+bool ColumnKernels::clamp(ReadingColumn& column, double minimum, double maximum)
+{
+	if (column.getType() != ReadingColumn::COL_FLOAT)
+	{
+		return false;
+	}
+	vector<double>& values = column.getFloats();
+	clamp(values.data(), values.size(), minimum, maximum);
+	return true;
+}
+
+/**
+ * Calculate the rate of change of a floating point column of an asset
+ * using the user timestamps of the readings. The rate of a row without
+ * the datapoint is NaN and the row is skipped.
+ *
+ * @param asset		The columns of the asset
+ * @param column	The column of the asset
+ * @param rates		Set to the rate of change of each row
+ * @param state		The last value and time of the previous block
+ * @return bool		False if the column is not a floating point column
+ */
+bool ColumnKernels::rateOfChange(AssetColumns& asset, ReadingColumn& column,
+				 vector<double>& rates, ColumnState& state)
+{
+	if (column.getType() != ReadingColumn::COL_FLOAT)
+	{
+		return false;
+	}
+	size_t rows = column.getRows();
+	vector<double> times;
+	userTimes(asset, times);
+	vector<double> values;
+	vector<size_t> present;
+	for (size_t row = 0; row < rows; row++)
+	{
+		if (column.isPresent(row))
+		{
+			present.push_back(row);
+		}
+	}
+	rates.assign(rows, NAN);
+	if (present.size() == rows)
+	{
+		rateOfChange(column.getFloats().data(), times.data(), rows, rates.data(), state);
+		return true;
+	}
+	// Gather the rows that have the datapoint
+	vector<double> presentTimes, presentRates(present.size());
+	for (auto row : present)
+	{
+		values.push_back(column.getFloats()[row]);
+		presentTimes.push_back(times[row]);
+	}
+	rateOfChange(values.data(), presentTimes.data(), values.size(), presentRates.data(), state);
+	for (size_t i = 0; i < present.size(); i++)
+	{
+		rates[present[i]] = presentRates[i];
+	}
+	return true;
+}
+
+/**
+ * Apply a deadband to a floating point column. A row without the
+ * datapoint is not passed.
+ *
+ * @param column	The column
+ * @param band		The deadband
+ * @param pass		Set to true for each row whose value is passed
+ * @param state		The last value passed in the previous block
+ * @return bool		False if the column is not a floating point column
+ */
+bool ColumnKernels::deadband(ReadingColumn& column, double band,
+			     vector<bool>& pass, ColumnState& state)
+{
+	if (column.getType() != ReadingColumn::COL_FLOAT)
+	{
+		return false;
+	}
+	size_t rows = column.getRows();
+	vector<double>& values = column.getFloats();
+	pass.assign(rows, false);
+	for (size_t row = 0; row < rows; row++)
+	{
+		if (column.isPresent(row) &&
+			(!state.m_valid || fabs(values[row] - state.m_value) > band))
+		{
+			pass[row] = true;
+			state.m_valid = true;
+			state.m_value = values[row];
+		}
+	}
+	return true;
+}
+
+/**
+ * Return the user timestamps of the readings of an asset in seconds
+ *
+ * @param asset		The columns of the asset
+ * @param times		Set to the user timestamp of each row
+ */
+void ColumnKernels::userTimes(AssetColumns& asset, vector<double>& times)
+{
+	vector<struct timeval>& timestamps = asset.getUserTimestamps();
+	times.resize(timestamps.size());
+	for (size_t i = 0; i < timestamps.size(); i++)
+	{
+		times[i] = timestamps[i].tv_sec + timestamps[i].tv_usec / 1000000.0;
+	}
+}
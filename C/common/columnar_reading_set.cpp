@@ -0,0 +1,389 @@
+/*
+ * Fledge columnar representation of a set of readings
+ *
+ * Copyright (c) 2026 Dianomic Systems
+ *
+ * Released under the Apache 2.0 Licence
+ *
+ * Author: agent
+ */
+#include <columnar_reading_set.h>
+
+using namespace std;
+
+/**
+ * Construct a column, the type of the column is determined by
+ * the type of the first value that will be added to it.
+ *
+ * @param name	The datapoint name
+ * @param type	The type of the datapoint values
+ */
+ReadingColumn::ReadingColumn(const string& name, DatapointValue::dataTagType type) : m_name(name)
+{
+	switch (type)
+	{
+		case DatapointValue::T_INTEGER:
+			m_type = COL_INTEGER;
+			break;
+		case DatapointValue::T_FLOAT:
+			m_type = COL_FLOAT;
+			break;
+		case DatapointValue::T_STRING:
+			m_type = COL_STRING;
+			break;
+		default:
+			m_type = COL_VALUE;
+			break;
+	}
+}
+
+/**
+ * Destructor for a column
+ */
+ReadingColumn::~ReadingColumn()
+{
+	for (auto value : m_values)
+	{
+		delete value;
+	}
+}
+
+/**
+ * Append a value to the column. If the value does not match the
+ * type of the column the column is converted to hold DatapointValues.
+ *
+ * @param value	The value to append
+ */
+void ReadingColumn::append(const DatapointValue& value)
+{
+	DatapointValue::dataTagType type = value.getType();
+
+	if ((m_type == COL_INTEGER && type != DatapointValue::T_INTEGER)
+			|| (m_type == COL_FLOAT && type != DatapointValue::T_FLOAT)
+			|| (m_type == COL_STRING && type != DatapointValue::T_STRING))
+	{
+		convertToValues();
+	}
+	switch (m_type)
+	{
+		case COL_INTEGER:
+			m_integers.push_back(value.toInt());
+			break;
+		case COL_FLOAT:
+			m_floats.push_back(value.toDouble());
+			break;
+		case COL_STRING:
+			m_strings.push_back(value.toStringValue());
+			break;
+		case COL_VALUE:
+			m_values.push_back(new DatapointValue(value));
+			break;
+	}
+	m_present.push_back(true);
+}
+
+/**
+ * Append a row for a reading that does not contain this datapoint
+ */
+void ReadingColumn::appendAbsent()
+{
+	switch (m_type)
+	{
+		case COL_INTEGER:
+			m_integers.push_back(0);
+			break;
+		case COL_FLOAT:
+			m_floats.push_back(0.0);
+			break;
+		case COL_STRING:
+			m_strings.push_back("");
+			break;
+		case COL_VALUE:
+			m_values.push_back(NULL);
+			break;
+	}
+	m_present.push_back(false);
+}
+
+/**
+ * Convert a natively typed column into a column of DatapointValues
+ */
+void ReadingColumn::convertToValues()
+{
+	size_t rows = m_present.size();
+	m_values.reserve(rows);
+	for (size_t row = 0; row < rows; row++)
+	{
+		m_values.push_back(toDatapointValue(row));
+	}
+	m_integers.clear();
+	m_floats.clear();
+	m_strings.clear();
+	m_type = COL_VALUE;
+}
+
+/**
+ * Return a new DatapointValue for a row of the column. The caller
+ * is responsible for freeing the value.
+ *
+ * @param row	The row to return
+ * @return DatapointValue*	The value or NULL if the row has no value
+ */
+DatapointValue *ReadingColumn::toDatapointValue(size_t row) const
+{
+	if (!m_present[row])
+	{
+		return NULL;
+	}
+	switch (m_type)
+	{
+		case COL_INTEGER:
+			return new DatapointValue(m_integers[row]);
+		case COL_FLOAT:
+			return new DatapointValue(m_floats[row]);
+		case COL_STRING:
+			return new DatapointValue(m_strings[row]);
+		default:
+			return new DatapointValue(*m_values[row]);
+	}
+}
+
+/**
+ * Destructor for the columns of an asset
+ */
+AssetColumns::~AssetColumns()
+{
+	for (auto column : m_columns)
+	{
+		delete column;
+	}
+}
+
+/**
+ * Return the column for a named datapoint
+ *
+ * @param name	The datapoint name
+ * @return ReadingColumn*	The column or NULL if no reading has the datapoint
+ */
+ReadingColumn *AssetColumns::getColumn(const string& name) const
+{
+	auto it = m_index.find(name);
+	if (it == m_index.end())
+	{
+		return NULL;
+	}
+	return it->second;
+}
+
+/**
+ * Append a reading to the columns of the asset
+ *
+ * @param reading	The reading to append
+ * @return size_t	The row the reading was added as
+ */
+size_t AssetColumns::append(Reading *reading)
+{
+	struct timeval tm;
+	size_t row = m_rows;
+
+	m_ids.push_back(reading->getId());
+	reading->getUserTimestamp(&tm);
+	m_userTimestamps.push_back(tm);
+	reading->getTimestamp(&tm);
+	m_timestamps.push_back(tm);
+
+	vector<Datapoint *>& datapoints = reading->getReadingData();
+	for (auto dp : datapoints)
+	{
+		const DatapointValue& value = dp->getData();
+		ReadingColumn *column;
+		auto it = m_index.find(dp->getName());
+		if (it == m_index.end())
+		{
+			column = new ReadingColumn(dp->getName(), value.getType());
+			for (size_t i = 0; i < row; i++)
+			{
+				column->appendAbsent();
+			}
+			m_columns.push_back(column);
+			m_index[dp->getName()] = column;
+		}
+		else
+		{
+			column = it->second;
+		}
+		if (column->getRows() == row)
+		{
+			column->append(value);
+		}
+	}
+	m_rows++;
+	for (auto column : m_columns)
+	{
+		if (column->getRows() < m_rows)
+		{
+			column->appendAbsent();
+		}
+	}
+	return row;
+}
+
+/**
+ * Create a new reading from a row of the columns. The caller is
+ * responsible for freeing the reading.
+ *
+ * @param row	The row to create the reading from
+ * @return Reading*	The new reading
+ */
+Reading *AssetColumns::toReading(size_t row) const
+{
+	vector<Datapoint *> datapoints;
+	for (auto column : m_columns)
+	{
+		DatapointValue *value = column->toDatapointValue(row);
+		if (value)
+		{
+			datapoints.push_back(new Datapoint(column->getName(), *value));
+			delete value;
+		}
+	}
+	Reading *reading = new Reading(m_asset, datapoints);
+	reading->setId(m_ids[row]);
+	reading->setUserTimestamp(m_userTimestamps[row]);
+	reading->setTimestamp(m_timestamps[row]);
+	return reading;
+}
+
+/**
+ * Construct a columnar view of a vector of readings. The pointers to
+ * the readings are copied, the columns are not built until they are
+ * first accessed and the readings must not be freed before then.
+ *
+ * @param readings	The readings to create the view of
+ */
+ColumnarReadingSet::ColumnarReadingSet(const vector<Reading *>& readings) :
+	m_readings(readings), m_built(false)
+{
+}
+
+/**
+ * Construct a columnar view of a reading set. The pointers to the
+ * readings are copied, the columns are not built until they are
+ * first accessed and the readings must not be freed before then.
+ *
+ * @param readings	The reading set to create the view of
+ */
+ColumnarReadingSet::ColumnarReadingSet(const ReadingSet& readings) :
+	m_readings(readings.getAllReadings()), m_built(false)
+{
+}
+
+/**
+ * Destructor for the columnar reading set. The readings the
+ * set was created from are not affected.
+ */
+ColumnarReadingSet::~ColumnarReadingSet()
+{
+	for (auto asset : m_assets)
+	{
+		delete asset;
+	}
+}
+
+/**
+ * Build the columns from the readings
+ */
+void ColumnarReadingSet::build()
+{
+	AssetColumns *last = NULL;
+
+	m_order.reserve(m_readings.size());
+	for (auto reading : m_readings)
+	{
+		const string& name = reading->getAssetName();
+		// Readings for the same asset tend to be adjacent
+		if (!last || last->getAssetName().compare(name))
+		{
+			auto it = m_index.find(name);
+			if (it == m_index.end())
+			{
+				last = new AssetColumns(name);
+				m_assets.push_back(last);
+				m_index[name] = last;
+			}
+			else
+			{
+				last = it->second;
+			}
+		}
+		m_order.push_back(make_pair(last, last->append(reading)));
+	}
+	m_built = true;
+}
+
+/**
+ * Return the columns for each asset in the set, in the order
+ * in which the assets first appear.
+ */
+const vector<AssetColumns *>& ColumnarReadingSet::getAssets()
+{
+	if (!m_built)
+	{
+		build();
+	}
+	return m_assets;
+}
+
+/**
+ * Return the columns for a single asset
+ *
+ * @param asset	The asset name
+ * @return AssetColumns*	The columns or NULL if there are no readings for the asset
+ */
+AssetColumns *ColumnarReadingSet::getAsset(const string& asset)
+{
+	if (!m_built)
+	{
+		build();
+	}
+	auto it = m_index.find(asset);
+	if (it == m_index.end())
+	{
+		return NULL;
+	}
+	return it->second;
+}
+
+/**
+ * Create new readings from the columns, in the order of the original
+ * readings. Any changes made to the columns are reflected in the new
+ * readings. The caller is responsible for freeing the readings.
+ *
+ * @param readings	The vector to append the new readings to
+ */
+void ColumnarReadingSet::toReadings(vector<Reading *>& readings)
+{
+	if (!m_built)
+	{
+		build();
+	}
+	readings.reserve(readings.size() + m_order.size());
+	for (auto& entry : m_order)
+	{
+		readings.push_back(entry.first->toReading(entry.second));
+	}
+}
+
+/**
+ * Create a new ReadingSet from the columns
+ *
+ * @return ReadingSet*	The new reading set, the caller must free this
+ */
+ReadingSet *ColumnarReadingSet::toReadingSet()
+{
+	ReadingSet *set = new ReadingSet();
+	vector<Reading *> readings;
+	toReadings(readings);
+	set->append(readings);
+	return set;
+}
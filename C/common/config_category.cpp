@@ -98,12 +98,21 @@ void ConfigCategories::addCategoryDescription(ConfigCategoryDescription* elem)
  */
 string ConfigCategoryDescription::toJSON() const
 {
-	ostringstream convert;
+	JSONWriter writer;
 
-	convert << "{\"key\": \"" << JSONescape(m_name) << "\", ";
-	convert << "\"description\" : \"" << JSONescape(m_description) << "\"}";
+	toJSON(writer);
+	return writer.str();
+}
 
-	return convert.str();
+/**
+ * Append the JSON of a ConfigCategoryDescription element to a document
+ *
+ * @param writer	The JSON document
+ */
+void ConfigCategoryDescription::toJSON(JSONWriter& writer) const
+{
+	writer.append("{\"key\": ").appendString(m_name);
+	writer.append(", \"description\" : ").appendString(m_description).append("}");
 }
 
 /**
@@ -112,20 +121,20 @@ string ConfigCategoryDescription::toJSON() const
  */
 string ConfigCategories::toJSON() const
 {
-	ostringstream convert;
+	JSONWriter writer;
 
-	convert << "[";
+	writer.append("[");
 	for (auto it = m_categories.cbegin(); it != m_categories.cend(); it++)
 	{
-		convert << (*it)->toJSON();
+		(*it)->toJSON(writer);
 		if (it + 1 != m_categories.cend() )
 		{
-                        convert << ", ";
+			writer.append(", ");
 		}
 	}
-	convert << "]";
+	writer.append("]");
 
-	return convert.str();
+	return writer.str();
 }
 
 /**
@@ -167,6 +176,7 @@ ConfigCategory::ConfigCategory(const string& name, const string& json) : m_name(
 			throw;
 		}
 	}
+	indexItems();
 }
 
 /**
@@ -181,6 +191,7 @@ ConfigCategory::ConfigCategory(ConfigCategory const& rhs)
 	{
 		m_items.push_back(new CategoryItem(**it));
 	}
+	indexItems();
 }
 
 /**
@@ -211,6 +222,7 @@ ConfigCategory& ConfigCategory::operator=(ConfigCategory const& rhs)
 	{
 		m_items.push_back(new CategoryItem(**it));
 	}
+	indexItems();
 	return *this;
 }
 
@@ -226,6 +238,7 @@ ConfigCategory& ConfigCategory::operator+=(ConfigCategory const& rhs)
 	{
 		m_items.push_back(new CategoryItem(**it));
 	}
+	indexItems();
 	return *this;
 }
 
@@ -265,6 +278,7 @@ void ConfigCategory::addItem(const std::string& name, const std::string descript
                              const std::string& value)
 {
 	m_items.push_back(new CategoryItem(name, description, type, def, value));
+	m_index.emplace(name, m_items.back());
 }
 
 /**
@@ -275,6 +289,7 @@ void ConfigCategory::addItem(const std::string& name, const std::string descript
 			     const vector<string> options)
 {
 	m_items.push_back(new CategoryItem(name, description, def, value, options));
+	m_index.emplace(name, m_items.back());
 }
 
 /**
@@ -286,13 +301,11 @@ void ConfigCategory::addItem(const std::string& name, const std::string descript
  */
 bool ConfigCategory::setItemDisplayName(const std::string& name, const std::string& displayName)
 {
-	for (unsigned int i = 0; i < m_items.size(); i++)
+	CategoryItem *item = findItem(name);
+	if (item)
 	{
-		if (name.compare(m_items[i]->m_name) == 0)
-		{
-			m_items[i]->m_displayName = displayName;
-			return true;
-		}
+		item->m_displayName = displayName;
+		return true;
 	}
 	return false;
 }
@@ -316,6 +329,7 @@ void ConfigCategory::removeItemsType(ConfigCategory::ItemType type)
 			++it;
 		}
 	}
+	indexItems();
 }
 
 /**
@@ -329,6 +343,7 @@ void ConfigCategory::removeItems()
 		delete *it;
 		m_items.erase(it);
 	}
+	indexItems();
 }
 
 /**
@@ -351,6 +366,7 @@ void ConfigCategory::keepItemsType(ConfigCategory::ItemType type)
 			++it;
 		}
 	}
+	indexItems();
 }
 
 /**
@@ -390,6 +406,8 @@ bool ConfigCategory::extractSubcategory(ConfigCategory &subCategories)
 		// Removes the element just processed
 		delete *it;
 		subCategories.m_items.erase(it);
+		subCategories.indexItems();
+		indexItems();
 		extracted = true;
 	}
 	else
@@ -408,14 +426,77 @@ bool ConfigCategory::extractSubcategory(ConfigCategory &subCategories)
  */
 bool ConfigCategory::itemExists(const string& name) const
 {
-	for (unsigned int i = 0; i < m_items.size(); i++)
+	return findItem(name) != NULL;
+}
+
+/**
+ * Find an item of the configuration category by name
+ *
+ * @param name	The name of the item
+ * @return	The item or NULL if there is no item with the name
+ */
+ConfigCategory::CategoryItem *ConfigCategory::findItem(const string& name) const
+{
+	if (m_index.size() != m_items.size())
 	{
-		if (name.compare(m_items[i]->m_name) == 0)
+		// Duplicate item names, the first item with the name is returned
+		for (auto it = m_items.cbegin(); it != m_items.cend(); it++)
 		{
-			return true;
+			if (name.compare((*it)->m_name) == 0)
+			{
+				return *it;
+			}
 		}
+		return NULL;
 	}
-	return false;
+	auto it = m_index.find(name);
+	if (it != m_index.end())
+	{
+		return it->second;
+	}
+	return NULL;
+}
+
+/**
+ * Rebuild the index of the items by name after items have been
+ * added to or removed from the category
+ */
+void ConfigCategory::indexItems()
+{
+	m_index.clear();
+	m_index.reserve(m_items.size());
+	for (auto it = m_items.cbegin(); it != m_items.cend(); it++)
+	{
+		m_index.emplace((*it)->m_name, *it);
+	}
+}
+
+/**
+ * Return a version of the values of the configuration category. The
+ * version is derived from the names and values of the items, so two
+ * categories with the same items and values have the same version and
+ * a service may compare the version of a changed category with the one
+ * it is using to skip a change that does not alter any value.
+ *
+ * @return uint64_t	The version of the category values
+ */
+uint64_t ConfigCategory::getVersion() const
+{
+	uint64_t hash = 14695981039346656037ULL;
+	for (auto it = m_items.cbegin(); it != m_items.cend(); it++)
+	{
+		const string *parts[] = { &(*it)->m_name, &(*it)->m_value };
+		for (int i = 0; i < 2; i++)
+		{
+			for (unsigned char c : *parts[i])
+			{
+				hash = (hash ^ c) * 1099511628211ULL;
+			}
+			// Separate the parts so that moving characters between them changes the version
+			hash = (hash ^ 0xff) * 1099511628211ULL;
+		}
+	}
+	return hash;
 }
 
 /**
@@ -427,12 +508,10 @@ bool ConfigCategory::itemExists(const string& name) const
  */
 string ConfigCategory::getValue(const string& name) const
 {
-	for (unsigned int i = 0; i < m_items.size(); i++)
+	CategoryItem *item = findItem(name);
+	if (item)
 	{
-		if (name.compare(m_items[i]->m_name) == 0)
-		{
-			return m_items[i]->m_value;
-		}
+		return item->m_value;
 	}
 	throw new ConfigItemNotFound();
 }
@@ -450,23 +529,21 @@ string ConfigCategory::getValue(const string& name) const
 string ConfigCategory::getItemAttribute(const string& itemName,
 					const ItemAttribute itemAttribute) const
 {
-	for (unsigned int i = 0; i < m_items.size(); i++)
+	CategoryItem *item = findItem(itemName);
+	if (item)
 	{
-		if (itemName.compare(m_items[i]->m_name) == 0)
+		switch (itemAttribute)
 		{
-			switch (itemAttribute)
-			{
-				case ORDER_ATTR:
-					return m_items[i]->m_order;
-				case READONLY_ATTR:
-					return m_items[i]->m_readonly;
-				case MANDATORY_ATTR:
-				    return m_items[i]->m_mandatory;
-				case FILE_ATTR:
-					return m_items[i]->m_file;
-				default:
-					throw new ConfigItemAttributeNotFound();
-			}
+			case ORDER_ATTR:
+				return item->m_order;
+			case READONLY_ATTR:
+				return item->m_readonly;
+			case MANDATORY_ATTR:
+			    return item->m_mandatory;
+			case FILE_ATTR:
+				return item->m_file;
+			default:
+				throw new ConfigItemAttributeNotFound();
 		}
 	}
 	throw new ConfigItemNotFound();
@@ -481,12 +558,10 @@ string ConfigCategory::getItemAttribute(const string& itemName,
  */
 string ConfigCategory::getType(const string& name) const
 {
-	for (unsigned int i = 0; i < m_items.size(); i++)
+	CategoryItem *item = findItem(name);
+	if (item)
 	{
-		if (name.compare(m_items[i]->m_name) == 0)
-		{
-			return m_items[i]->m_type;
-		}
+		return item->m_type;
 	}
 	throw new ConfigItemNotFound();
 }
@@ -500,12 +575,10 @@ string ConfigCategory::getType(const string& name) const
  */
 string ConfigCategory::getDescription(const string& name) const
 {
-	for (unsigned int i = 0; i < m_items.size(); i++)
+	CategoryItem *item = findItem(name);
+	if (item)
 	{
-		if (name.compare(m_items[i]->m_name) == 0)
-		{
-			return m_items[i]->m_description;
-		}
+		return item->m_description;
 	}
 	throw new ConfigItemNotFound();
 }
@@ -519,12 +592,10 @@ string ConfigCategory::getDescription(const string& name) const
  */
 string ConfigCategory::getDefault(const string& name) const
 {
-	for (unsigned int i = 0; i < m_items.size(); i++)
+	CategoryItem *item = findItem(name);
+	if (item)
 	{
-		if (name.compare(m_items[i]->m_name) == 0)
-		{
-			return m_items[i]->m_default;
-		}
+		return item->m_default;
 	}
 	throw new ConfigItemNotFound();
 }
@@ -538,13 +609,11 @@ string ConfigCategory::getDefault(const string& name) const
  */
 bool ConfigCategory::setDefault(const string& name, const string& value)
 {
-	for (unsigned int i = 0; i < m_items.size(); i++)
+	CategoryItem *item = findItem(name);
+	if (item)
 	{
-		if (name.compare(m_items[i]->m_name) == 0)
-		{
-			m_items[i]->m_default = value;
-			return true;
-		}
+		item->m_default = value;
+		return true;
 	}
 	return false;
 }
@@ -558,13 +627,11 @@ bool ConfigCategory::setDefault(const string& name, const string& value)
  */
 bool ConfigCategory::setValue(const string& name, const string& value)
 {
-	for (unsigned int i = 0; i < m_items.size(); i++)
+	CategoryItem *item = findItem(name);
+	if (item)
 	{
-		if (name.compare(m_items[i]->m_name) == 0)
-		{
-			m_items[i]->m_value = value;
-			return true;
-		}
+		item->m_value = value;
+		return true;
 	}
 	return false;
 }
@@ -579,12 +646,10 @@ bool ConfigCategory::setValue(const string& name, const string& value)
  */
 string ConfigCategory::getDisplayName(const string& name) const
 {
-	for (unsigned int i = 0; i < m_items.size(); i++)
+	CategoryItem *item = findItem(name);
+	if (item)
 	{
-		if (name.compare(m_items[i]->m_name) == 0)
-		{
-			return m_items[i]->m_displayName;
-		}
+		return item->m_displayName;
 	}
 	throw new ConfigItemNotFound();
 }
@@ -598,12 +663,10 @@ string ConfigCategory::getDisplayName(const string& name) const
  */
 string ConfigCategory::getLength(const string& name) const
 {
-	for (unsigned int i = 0; i < m_items.size(); i++)
+	CategoryItem *item = findItem(name);
+	if (item)
 	{
-		if (name.compare(m_items[i]->m_name) == 0)
-		{
-			return m_items[i]->m_length;
-		}
+		return item->m_length;
 	}
 	throw new ConfigItemNotFound();
 }
@@ -617,12 +680,10 @@ string ConfigCategory::getLength(const string& name) const
  */
 string ConfigCategory::getMinimum(const string& name) const
 {
-	for (unsigned int i = 0; i < m_items.size(); i++)
+	CategoryItem *item = findItem(name);
+	if (item)
 	{
-		if (name.compare(m_items[i]->m_name) == 0)
-		{
-			return m_items[i]->m_minimum;
-		}
+		return item->m_minimum;
 	}
 	throw new ConfigItemNotFound();
 }
@@ -636,12 +697,10 @@ string ConfigCategory::getMinimum(const string& name) const
  */
 string ConfigCategory::getMaximum(const string& name) const
 {
-	for (unsigned int i = 0; i < m_items.size(); i++)
+	CategoryItem *item = findItem(name);
+	if (item)
 	{
-		if (name.compare(m_items[i]->m_name) == 0)
-		{
-			return m_items[i]->m_maximum;
-		}
+		return item->m_maximum;
 	}
 	throw new ConfigItemNotFound();
 }
@@ -657,12 +716,10 @@ string ConfigCategory::getMaximum(const string& name) const
  */
 vector<string> ConfigCategory::getOptions(const string& name) const
 {
-	for (unsigned int i = 0; i < m_items.size(); i++)
+	CategoryItem *item = findItem(name);
+	if (item)
 	{
-		if (name.compare(m_items[i]->m_name) == 0)
-		{
-			return m_items[i]->m_options;
-		}
+		return item->m_options;
 	}
 	throw new ConfigItemNotFound();
 }
@@ -676,12 +733,10 @@ vector<string> ConfigCategory::getOptions(const string& name) const
  */
 bool ConfigCategory::isString(const string& name) const
 {
-	for (unsigned int i = 0; i < m_items.size(); i++)
+	CategoryItem *item = findItem(name);
+	if (item)
 	{
-		if (name.compare(m_items[i]->m_name) == 0)
-		{
-			return m_items[i]->m_itemType == StringItem;
-		}
+		return item->m_itemType == StringItem;
 	}
 	throw new ConfigItemNotFound();
 }
@@ -695,12 +750,10 @@ bool ConfigCategory::isString(const string& name) const
  */
 bool ConfigCategory::isEnumeration(const string& name) const
 {
-	for (unsigned int i = 0; i < m_items.size(); i++)
+	CategoryItem *item = findItem(name);
+	if (item)
 	{
-		if (name.compare(m_items[i]->m_name) == 0)
-		{
-			return m_items[i]->m_itemType == EnumerationItem;
-		}
+		return item->m_itemType == EnumerationItem;
 	}
 	throw new ConfigItemNotFound();
 }
@@ -714,12 +767,10 @@ bool ConfigCategory::isEnumeration(const string& name) const
  */
 bool ConfigCategory::isJSON(const string& name) const
 {
-	for (unsigned int i = 0; i < m_items.size(); i++)
+	CategoryItem *item = findItem(name);
+	if (item)
 	{
-		if (name.compare(m_items[i]->m_name) == 0)
-		{
-			return m_items[i]->m_itemType == JsonItem;
-		}
+		return item->m_itemType == JsonItem;
 	}
 	throw new ConfigItemNotFound();
 }
@@ -733,12 +784,10 @@ bool ConfigCategory::isJSON(const string& name) const
  */
 bool ConfigCategory::isBool(const string& name) const
 {
-	for (unsigned int i = 0; i < m_items.size(); i++)
+	CategoryItem *item = findItem(name);
+	if (item)
 	{
-		if (name.compare(m_items[i]->m_name) == 0)
-		{
-			return m_items[i]->m_itemType == BoolItem;
-		}
+		return item->m_itemType == BoolItem;
 	}
 	throw new ConfigItemNotFound();
 }
@@ -752,12 +801,10 @@ bool ConfigCategory::isBool(const string& name) const
  */
 bool ConfigCategory::isNumber(const string& name) const
 {
-	for (unsigned int i = 0; i < m_items.size(); i++)
+	CategoryItem *item = findItem(name);
+	if (item)
 	{
-		if (name.compare(m_items[i]->m_name) == 0)
-		{
-			return m_items[i]->m_itemType == NumberItem;
-		}
+		return item->m_itemType == NumberItem;
 	}
 	throw new ConfigItemNotFound();
 }
@@ -771,12 +818,10 @@ bool ConfigCategory::isNumber(const string& name) const
  */
 bool ConfigCategory::isDouble(const string& name) const
 {
-	for (unsigned int i = 0; i < m_items.size(); i++)
+	CategoryItem *item = findItem(name);
+	if (item)
 	{
-		if (name.compare(m_items[i]->m_name) == 0)
-		{
-			return m_items[i]->m_itemType == DoubleItem;
-		}
+		return item->m_itemType == DoubleItem;
 	}
 	throw new ConfigItemNotFound();
 }
@@ -790,12 +835,10 @@ bool ConfigCategory::isDouble(const string& name) const
  */
 bool ConfigCategory::isDeprecated(const string& name) const
 {
-	for (unsigned int i = 0; i < m_items.size(); i++)
+	CategoryItem *item = findItem(name);
+	if (item)
 	{
-		if (name.compare(m_items[i]->m_name) == 0)
-		{
-			return ! m_items[i]->m_deprecated.empty();
-		}
+		return ! item->m_deprecated.empty();
 	}
 	throw new ConfigItemNotFound();
 }
@@ -818,15 +861,16 @@ void ConfigCategory::setDescription(const string& description)
  */
 string ConfigCategory::toJSON(const bool full) const
 {
-ostringstream convert;
+JSONWriter writer;
 
-	convert << "{ \"key\" : \"" << JSONescape(m_name) << "\", ";
-	convert << "\"description\" : \"" << JSONescape(m_description) << "\", \"value\" : ";
+	writer.append("{ \"key\" : ").appendString(m_name);
+	writer.append(", \"description\" : ").appendString(m_description);
+	writer.append(", \"value\" : ");
 	// Add items
-	convert << ConfigCategory::itemsToJSON(full);
-	convert << " }";
+	ConfigCategory::itemsToJSON(writer, full);
+	writer.append(" }");
 
-	return convert.str();
+	return writer.str();
 }
 
 /**
@@ -837,20 +881,30 @@ ostringstream convert;
  */
 string ConfigCategory::itemsToJSON(const bool full) const
 {
-ostringstream convert;
+JSONWriter writer;
 
-	convert << "{";
+	ConfigCategory::itemsToJSON(writer, full);
+	return writer.str();
+}
+
+/**
+ * Append the JSON of the category items to a document
+ *
+ * @param writer	The JSON document
+ * @param full		false is the deafult, true evaluates all the members of the CategoryItems
+ */
+void ConfigCategory::itemsToJSON(JSONWriter& writer, const bool full) const
+{
+	writer.append("{");
 	for (auto it = m_items.cbegin(); it != m_items.cend(); it++)
 	{
-		convert << (*it)->toJSON(full);
+		(*it)->toJSON(writer, full);
 		if (it + 1 != m_items.cend() )
 		{
-			convert << ", ";
+			writer.append(", ");
 		}
 	}
-	convert << "}";
-
-	return convert.str();
+	writer.append("}");
 }
 
 /**
@@ -1270,33 +1324,40 @@ ConfigCategory::CategoryItem::CategoryItem(const CategoryItem& rhs)
  */
 string ConfigCategory::CategoryItem::toJSON(const bool full) const
 {
-ostringstream convert;
+JSONWriter writer;
+
+	toJSON(writer, full);
+	return writer.str();
+}
 
-	convert << "\"" << JSONescape(m_name) << "\" : { ";
-	convert << "\"description\" : \"" << JSONescape(m_description) << "\", ";
+/**
+ * Append the JSON of the configuration item to a document
+ *
+ * @param writer	The JSON document
+ * @param full		false is the deafult, true evaluates all the members of the CategoryItem
+ */
+void ConfigCategory::CategoryItem::toJSON(JSONWriter& writer, const bool full) const
+{
+	writer.appendString(m_name).append(" : { ");
+	writer.append("\"description\" : ").appendString(m_description).append(", ");
 	if (! m_displayName.empty())
 	{
-		convert << "\"displayName\" : \"" << m_displayName << "\", ";
+		writer.append("\"displayName\" : ").appendString(m_displayName).append(", ");
 	}
-	convert << "\"type\" : \"" << m_type << "\", ";
+	writer.append("\"type\" : ").appendString(m_type).append(", ");
 	if (m_options.size() > 0)
 	{
-		convert << "\"options\" : [ ";
-		for (int i = 0; i < m_options.size(); i++)
-		{
-			if (i > 0)
-				convert << ",";
-			convert << "\"" << m_options[i] << "\"";
-		}
-		convert << "], ";
+		writer.append("\"options\" : [ ");
+		optionsToJSON(writer);
+		writer.append("], ");
 	}
 
 	if (m_itemType == StringItem ||
 	    m_itemType == BoolItem ||
 	    m_itemType == EnumerationItem)
 	{
-		convert << "\"value\" : \"" << JSONescape(m_value) << "\", ";
-		convert << "\"default\" : \"" << JSONescape(m_default) << "\"";
+		writer.append("\"value\" : ").appendString(m_value).append(", ");
+		writer.append("\"default\" : ").appendString(m_default);
 	}
 	else if (m_itemType == JsonItem ||
 		 m_itemType == NumberItem ||
@@ -1304,134 +1365,115 @@ ostringstream convert;
 		 m_itemType == ScriptItem ||
 		 m_itemType == CodeItem)
 	{
-		convert << "\"value\" : " << m_value << ", ";
-		convert << "\"default\" : " << m_default;
+		writer.append("\"value\" : ").append(m_value).append(", ");
+		writer.append("\"default\" : ").append(m_default);
 	}
 
 	if (full)
 	{
-		if (!m_order.empty())
-		{
-			convert << ", \"order\" : \"" << m_order << "\"";
-		}
-
-        if (!m_length.empty())
-		{
-			convert << ", \"length\" : \"" << m_length << "\"";
-		}
-
-		if (!m_minimum.empty())
-		{
-			convert << ", \"minimum\" : \"" << m_minimum << "\"";
-		}
-
-		if (!m_maximum.empty())
-		{
-			convert << ", \"maximum\" : \"" << m_maximum << "\"";
-		}
-
-		if (!m_readonly.empty())
-		{
-			convert << ", \"readonly\" : \"" << m_readonly << "\"";
-		}
-
-        if (!m_mandatory.empty())
-        {
-            convert << ", \"mandatory\" : \"" << m_mandatory << "\"";
-        }
-
-		if (!m_file.empty())
-		{
-			convert << ", \"file\" : \"" << m_file << "\"";
-		}
+		attributesToJSON(writer, false);
 		if (m_options.size() > 0)
 		{
-			convert << ", \"options\" : [ ";
-			for (int i = 0; i < m_options.size(); i++)
-			{
-				if (i > 0)
-					convert << ",";
-				convert << "\"" << m_options[i] << "\"";
-			}
-			convert << "]";
+			writer.append(", \"options\" : [ ");
+			optionsToJSON(writer);
+			writer.append("]");
 		}
 	}
-	convert << " }";
-
-	return convert.str();
+	writer.append(" }");
 }
 
 /**
- * Return only "default" item values
+ * Append the optional attributes of the configuration item that are set
+ * to a document, each one after a comma
+ *
+ * @param writer	The JSON document
+ * @param displayName	Add the displayName after the order
  */
-string ConfigCategory::CategoryItem::defaultToJSON() const
+void ConfigCategory::CategoryItem::attributesToJSON(JSONWriter& writer, bool displayName) const
 {
-ostringstream convert;
-
-	convert << "\"" << JSONescape(m_name) << "\" : { ";
-	convert << "\"description\" : \"" << JSONescape(m_description) << "\", ";
-	convert << "\"type\" : \"" << m_type << "\"";
-
 	if (!m_order.empty())
 	{
-		convert << ", \"order\" : \"" << m_order << "\"";
+		writer.append(", \"order\" : ").appendString(m_order);
 	}
-
-	if (!m_displayName.empty())
+	if (displayName && !m_displayName.empty())
 	{
-		convert << ", \"displayName\" : \"" << m_displayName << "\"";
+		writer.append(", \"displayName\" : ").appendString(m_displayName);
 	}
-
-    if (!m_length.empty())
+	if (!m_length.empty())
 	{
-		convert << ", \"length\" : \"" << m_length << "\"";
+		writer.append(", \"length\" : ").appendString(m_length);
 	}
-
 	if (!m_minimum.empty())
 	{
-		convert << ", \"minimum\" : \"" << m_minimum << "\"";
+		writer.append(", \"minimum\" : ").appendString(m_minimum);
 	}
-
 	if (!m_maximum.empty())
 	{
-		convert << ", \"maximum\" : \"" << m_maximum << "\"";
+		writer.append(", \"maximum\" : ").appendString(m_maximum);
 	}
-
 	if (!m_readonly.empty())
 	{
-		convert << ", \"readonly\" : \"" << m_readonly << "\"";
+		writer.append(", \"readonly\" : ").appendString(m_readonly);
+	}
+	if (!m_mandatory.empty())
+	{
+		writer.append(", \"mandatory\" : ").appendString(m_mandatory);
 	}
-
-    if (!m_mandatory.empty())
-    {
-        convert << ", \"mandatory\" : \"" << m_mandatory << "\"";
-    }
-
 	if (!m_file.empty())
 	{
-		convert << ", \"file\" : \"" << m_file << "\"";
+		writer.append(", \"file\" : ").appendString(m_file);
 	}
-	if (m_options.size() > 0)
+}
+
+/**
+ * Append the options of an enumeration item to a document, without
+ * the brackets of the array
+ *
+ * @param writer	The JSON document
+ */
+void ConfigCategory::CategoryItem::optionsToJSON(JSONWriter& writer) const
+{
+	for (size_t i = 0; i < m_options.size(); i++)
 	{
-		convert << ", \"options\" : [ ";
-		for (int i = 0; i < m_options.size(); i++)
-		{
-			if (i > 0)
-				convert << ",";
-			convert << "\"" << m_options[i] << "\"";
-		}
-		convert << "]";
+		if (i > 0)
+			writer.append(",");
+		writer.appendString(m_options[i]);
 	}
+}
 
-	if (m_itemType == StringItem ||
-	    m_itemType == EnumerationItem ||
-	    m_itemType == BoolItem)
+/**
+ * Return only "default" item values
+ */
+string ConfigCategory::CategoryItem::defaultToJSON() const
+{
+JSONWriter writer;
+
+	defaultToJSON(writer);
+	return writer.str();
+}
+
+/**
+ * Append only the "default" item values to a document
+ *
+ * @param writer	The JSON document
+ */
+void ConfigCategory::CategoryItem::defaultToJSON(JSONWriter& writer) const
+{
+	writer.appendString(m_name).append(" : { ");
+	writer.append("\"description\" : ").appendString(m_description).append(", ");
+	writer.append("\"type\" : ").appendString(m_type);
+
+	attributesToJSON(writer, true);
+	if (m_options.size() > 0)
 	{
-		convert << ", \"default\" : \"" << JSONescape(m_default) << "\" }";
+		writer.append(", \"options\" : [ ");
+		optionsToJSON(writer);
+		writer.append("]");
 	}
+
 	/**
 	 * NOTE:
-	 * These data types must be all escaped.
+	 * All the data types must be escaped.
 	 * "default" items in the DefaultConfigCategory class are sent to
 	 * ConfigurationManager interface which requires string values only:
 	 *
@@ -1440,15 +1482,17 @@ ostringstream convert;
 	 * and for JSON
 	 * "{\"pipeline\":[\"scale\"]}" not {"pipeline":["scale"]}
 	 */
-	else if (m_itemType == JsonItem ||
-		 m_itemType == NumberItem ||
-		 m_itemType == DoubleItem ||
-		 m_itemType == ScriptItem ||
-		 m_itemType == CodeItem)
+	if (m_itemType == StringItem ||
+	    m_itemType == EnumerationItem ||
+	    m_itemType == BoolItem ||
+	    m_itemType == JsonItem ||
+	    m_itemType == NumberItem ||
+	    m_itemType == DoubleItem ||
+	    m_itemType == ScriptItem ||
+	    m_itemType == CodeItem)
 	{
-		convert << ", \"default\" : \"" << JSONescape(m_default) << "\" }";
+		writer.append(", \"default\" : ").appendString(m_default).append(" }");
 	}
-	return convert.str();
 }
 
 // DefaultConfigCategory constructor
@@ -1472,16 +1516,17 @@ DefaultConfigCategory::~DefaultConfigCategory()
  */
 string DefaultConfigCategory::toJSON() const
 {
-ostringstream convert;
+JSONWriter writer;
 
-	convert << "{ ";
-	convert << "\"key\" : \"" << JSONescape(m_name) << "\", ";
-	convert << "\"description\" : \"" << JSONescape(m_description) << "\", \"value\" : ";
+	writer.append("{ ");
+	writer.append("\"key\" : ").appendString(m_name);
+	writer.append(", \"description\" : ").appendString(m_description);
+	writer.append(", \"value\" : ");
 	// Add items
-	convert << DefaultConfigCategory::itemsToJSON();
-	convert << " }";
+	DefaultConfigCategory::itemsToJSON(writer);
+	writer.append(" }");
 
-	return convert.str();
+	return writer.str();
 }
 
 /**
@@ -1489,20 +1534,29 @@ ostringstream convert;
  */
 string DefaultConfigCategory::itemsToJSON() const
 {
-ostringstream convert;
-        
-	convert << "{";
+JSONWriter writer;
+
+	DefaultConfigCategory::itemsToJSON(writer);
+	return writer.str();
+}
+
+/**
+ * Append the DefaultConfigCategory "default" items to a document
+ *
+ * @param writer	The JSON document
+ */
+void DefaultConfigCategory::itemsToJSON(JSONWriter& writer) const
+{
+	writer.append("{");
 	for (auto it = m_items.cbegin(); it != m_items.cend(); it++)
-	{       
-		convert << (*it)->defaultToJSON();
+	{
+		(*it)->defaultToJSON(writer);
 		if (it + 1 != m_items.cend() )
-		{       
-			convert << ", ";
+		{
+			writer.append(", ");
 		}
 	}
-	convert << "}";
-
-	return convert.str();
+	writer.append("}");
 }
 
 /**
@@ -1513,19 +1567,19 @@ ostringstream convert;
  */
 string ConfigCategory::itemToJSON(const string& itemName) const
 {
-	ostringstream convert;
-        
-        convert << "{";
-        for (auto it = m_items.cbegin(); it != m_items.cend(); it++)
-        {
+JSONWriter writer;
+
+	writer.append("{");
+	for (auto it = m_items.cbegin(); it != m_items.cend(); it++)
+	{
 		if ((*it)->m_name.compare(itemName) == 0)
 		{
-                	convert << (*it)->toJSON();
+			(*it)->toJSON(writer);
 		}
 	}
-	convert << "}";
-        
-	return convert.str();
+	writer.append("}");
+
+	return writer.str();
 }
 
 /**
@@ -1589,4 +1643,5 @@ ConfigCategoryChange::ConfigCategoryChange(const string& json)
 			throw;
 		}
 	}
+	indexItems();
 }
@@ -0,0 +1,313 @@
+/*
+ * Fledge sampling CPU profiler.
+ *
+ * Copyright (c) 2026 Dianomic Systems
+ *
+ * Released under the Apache 2.0 Licence
+ *
+ * Author: agent
+ */
+#include <cpu_profiler.h>
+#include <logger.h>
+#include <execinfo.h>
+#include <dlfcn.h>
+#include <cxxabi.h>
+#include <errno.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/time.h>
+#include <sys/syscall.h>
+#include <fstream>
+#include <sstream>
+#include <map>
+#include <unordered_map>
+#include <vector>
+#include <chrono>
+#include <thread>
+
+#define PROFILE_SKIP_FRAMES	2	// The signal handler and the signal trampoline
+
+using namespace std;
+
+/*
+ * The profiler the signal handler records samples for, set before the
+ * handler is installed
+ */
+static CpuProfiler *profiler = NULL;
+
+/**
+ * Return the singleton profiler
+ */
+CpuProfiler *CpuProfiler::getInstance()
+{
+	static CpuProfiler *instance = new CpuProfiler();
+	return instance;
+}
+
+/**
+ * Construct the profiler. The first call of backtrace loads the unwinder,
+ * which is not safe in a signal handler, so it is called here once.
+ */
+CpuProfiler::CpuProfiler() : m_running(false), m_sampling(false), m_inHandler(0),
+	m_next(0), m_samples(NULL), m_capacity(0), m_cancelled(false)
+{
+	void *frames[2];
+	backtrace(frames, 2);
+	profiler = this;
+}
+
+/**
+ * Profile the process for a number of seconds. Only one profile may
+ * run at a time.
+ *
+ * @param seconds	The number of seconds to profile for
+ * @param frequency	The samples to take per second of CPU time
+ * @param folded	Set to the sampled stacks in the folded format
+ * @return bool		False if a profile was already running or the
+ *			timer could not be started
+ */
+bool CpuProfiler::profile(unsigned int seconds, unsigned int frequency, string& folded)
+{
+	bool running = false;
+	if (!m_running.compare_exchange_strong(running, true))
+	{
+		return false;
+	}
+	unsigned long capacity = (unsigned long)seconds * frequency;
+	if (capacity > PROFILE_MAX_SAMPLES)
+	{
+		capacity = PROFILE_MAX_SAMPLES;
+	}
+	if (!start(frequency, capacity))
+	{
+		m_running = false;
+		return false;
+	}
+	{
+		unique_lock<mutex> lck(m_mutex);
+		m_cv.wait_for(lck, chrono::seconds(seconds), [this] { return m_cancelled; });
+		m_cancelled = false;
+	}
+	stop();
+	fold(folded);
+	delete[] m_samples;
+	m_samples = NULL;
+	m_running = false;
+	return true;
+}
+
+/**
+ * End a running profile early, the samples taken so far are returned
+ */
+void CpuProfiler::cancel()
+{
+	lock_guard<mutex> guard(m_mutex);
+	if (m_running)
+	{
+		m_cancelled = true;
+		m_cv.notify_all();
+	}
+}
+
+/**
+ * Install the signal handler and start the profiling timer
+ *
+ * @param frequency	The samples to take per second of CPU time
+ * @param capacity	The number of samples to keep
+ * @return bool		True if the timer was started
+ */
+bool CpuProfiler::start(unsigned int frequency, unsigned int capacity)
+{
+	m_samples = new Sample[capacity];
+	for (unsigned int i = 0; i < capacity; i++)
+	{
+		m_samples[i].depth.store(0, memory_order_relaxed);
+	}
+	m_capacity = capacity;
+	m_next = 0;
+	m_sampling = true;
+
+	struct sigaction action;
+	memset(&action, 0, sizeof(action));
+	action.sa_sigaction = sample;
+	action.sa_flags = SA_RESTART | SA_SIGINFO;
+	sigemptyset(&action.sa_mask);
+	if (sigaction(SIGPROF, &action, &m_previous) != 0)
+	{
+		Logger::getLogger()->error("Unable to install the profiler signal handler: %s", strerror(errno));
+		m_sampling = false;
+		delete[] m_samples;
+		m_samples = NULL;
+		return false;
+	}
+
+	struct itimerval timer;
+	long period = 1000000 / frequency;
+	timer.it_interval.tv_sec = period / 1000000;
+	timer.it_interval.tv_usec = period % 1000000;
+	timer.it_value = timer.it_interval;
+	if (setitimer(ITIMER_PROF, &timer, NULL) != 0)
+	{
+		Logger::getLogger()->error("Unable to start the profiler timer: %s", strerror(errno));
+		sigaction(SIGPROF, &m_previous, NULL);
+		m_sampling = false;
+		delete[] m_samples;
+		m_samples = NULL;
+		return false;
+	}
+	return true;
+}
+
+/**
+ * Stop the profiling timer and wait for any handler that is still
+ * recording a sample before the previous handler is restored. A SIGPROF
+ * may still be pending once the timer is disarmed, the default action
+ * would terminate the service so the signal is ignored instead.
+ */
+void CpuProfiler::stop()
+{
+	struct itimerval timer;
+	memset(&timer, 0, sizeof(timer));
+	setitimer(ITIMER_PROF, &timer, NULL);
+	m_sampling = false;
+	while (m_inHandler.load() > 0)
+	{
+		this_thread::yield();
+	}
+	struct sigaction previous = m_previous;
+	if (!(previous.sa_flags & SA_SIGINFO) && previous.sa_handler == SIG_DFL)
+	{
+		previous.sa_handler = SIG_IGN;
+	}
+	sigaction(SIGPROF, &previous, NULL);
+}
+
+/**
+ * The SIGPROF handler, records the stack of the thread that was running.
+ * Only async signal safe calls are made, backtrace is safe once it has
+ * been called outside the handler.
+ */
+void CpuProfiler::sample(int sig, siginfo_t *info, void *context)
+{
+	(void)sig;
+	(void)info;
+	(void)context;
+	int savedErrno = errno;
+	CpuProfiler *p = profiler;
+	p->m_inHandler.fetch_add(1);
+	if (p->m_sampling.load())
+	{
+		unsigned int index = p->m_next.fetch_add(1, memory_order_relaxed);
+		if (index < p->m_capacity)
+		{
+			Sample& sample = p->m_samples[index];
+			sample.tid = (pid_t)syscall(SYS_gettid);
+			int depth = backtrace(sample.frames, PROFILE_MAX_DEPTH);
+			sample.depth.store(depth, memory_order_release);
+		}
+	}
+	p->m_inHandler.fetch_sub(1);
+	errno = savedErrno;
+}
+
+/**
+ * Return the name of the thread from the proc file system
+ *
+ * @param tid	The thread
+ */
+static string threadName(pid_t tid)
+{
+	ostringstream path;
+	path << "/proc/self/task/" << tid << "/comm";
+	ifstream comm(path.str());
+	string name;
+	if (!getline(comm, name) || name.empty())
+	{
+		name = "thread-" + to_string(tid);
+	}
+	return name;
+}
+
+/**
+ * Return the name of the function that contains an address, or the
+ * module if the function is not exported
+ *
+ * @param address	The address of the instruction
+ */
+static string frameName(void *address)
+{
+	Dl_info info;
+	if (!dladdr(address, &info))
+	{
+		return "[unknown]";
+	}
+	if (info.dli_sname)
+	{
+		int status = -1;
+		char *demangled = abi::__cxa_demangle(info.dli_sname, NULL, 0, &status);
+		string name = status == 0 ? demangled : info.dli_sname;
+		free(demangled);
+		return name;
+	}
+	if (info.dli_fname)
+	{
+		const char *module = strrchr(info.dli_fname, '/');
+		return string("[") + (module ? module + 1 : info.dli_fname) + "]";
+	}
+	return "[unknown]";
+}
+
+/**
+ * Fold the recorded samples into the count of each distinct stack
+ *
+ * @param folded	Set to the stacks in the folded format
+ */
+void CpuProfiler::fold(string& folded)
+{
+	unsigned int taken = m_next.load();
+	unsigned int count = taken < m_capacity ? taken : m_capacity;
+	unordered_map<void *, string> names;
+	unordered_map<pid_t, string> threads;
+	map<string, unsigned long> stacks;
+	for (unsigned int i = 0; i < count; i++)
+	{
+		Sample& sample = m_samples[i];
+		int depth = sample.depth.load(memory_order_acquire);
+		if (depth <= PROFILE_SKIP_FRAMES)
+		{
+			continue;
+		}
+		auto thread = threads.find(sample.tid);
+		if (thread == threads.end())
+		{
+			thread = threads.emplace(sample.tid, threadName(sample.tid)).first;
+		}
+		string stack = thread->second;
+		for (int j = depth - 1; j >= PROFILE_SKIP_FRAMES; j--)
+		{
+			// Return addresses are named by the call instruction before them
+			void *address = j == PROFILE_SKIP_FRAMES ? sample.frames[j]
+					: (void *)((char *)sample.frames[j] - 1);
+			auto name = names.find(address);
+			if (name == names.end())
+			{
+				name = names.emplace(address, frameName(address)).first;
+			}
+			stack += ";";
+			stack += name->second;
+		}
+		stacks[stack]++;
+	}
+	if (taken > m_capacity)
+	{
+		Logger::getLogger()->warn("The CPU profile dropped %u samples, only %u are kept",
+				taken - m_capacity, m_capacity);
+	}
+
+	ostringstream convert;
+	for (auto& stack : stacks)
+	{
+		convert << stack.first << " " << stack.second << "\n";
+	}
+	folded = convert.str();
+}
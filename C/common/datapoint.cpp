@@ -13,8 +13,10 @@
 #include <iomanip>
 #include <cfloat>
 #include <vector>
+#include <cstring>
 #include <logger.h>
 #include <datapoint.h>
+#include <json_utils.h>
 #include <exception>
 #include <base64databuffer.h>
 #include <base64dpimage.h>
@@ -26,102 +28,133 @@
  */
 std::string DatapointValue::toString() const
 {
-	std::ostringstream ss;
+	std::string rval;
+	appendJSON(rval);
+	return rval;
+}
+
+/**
+ * Append a double to a string with ten decimal places and the
+ * trailing zeros removed
+ */
+static void appendFloat(std::string& out, double value)
+{
+	char buf[100];
+	int len = snprintf(buf, sizeof(buf), "%.10f", value);
+	if (len > 0 && buf[len - 1] == '0')
+	{
+		while (len > 0 && buf[len - 1] == '0')
+			len--;
+		if (buf[len - 1] == '.')
+			buf[len++] = '0';
+	}
+	out.append(buf, len);
+}
+
+/**
+ * Append an element of an array, formatted as a stream formats
+ * a double by default
+ */
+static void appendArrayElement(std::string& out, double value)
+{
+	char buf[32];
+	int len = snprintf(buf, sizeof(buf), "%g", value);
+	out.append(buf, len);
+}
 
+/**
+ * Append the value to a string in the form returned by toString.
+ * The value is written straight into the string, so a reading is
+ * serialised into one buffer without a string for each value.
+ *
+ * @param out	The string to append the value to
+ */
+void DatapointValue::appendJSON(std::string& out) const
+{
 	switch (m_type)
 	{
 	case T_INTEGER:
-		ss << m_value.i;
-		return ss.str();
-	case T_FLOAT:
 		{
-			char tmpBuffer[100];
-			std::string s;
-
-			snprintf(tmpBuffer, sizeof(tmpBuffer), "%.10f", m_value.f);
-			s= tmpBuffer;
-
-			// remove trailing 0's
-			if (s[s.size()-1]== '0') {
-				s.erase(s.find_last_not_of('0') + 1, std::string::npos);
-
-				// add '0' i
-				if (s[s.size()-1]== '.')
-					s.append("0");
-
-			}
-
-			return s;
+			char buf[24];
+			int len = snprintf(buf, sizeof(buf), "%ld", m_value.i);
+			out.append(buf, len);
+			break;
 		}
+	case T_FLOAT:
+		appendFloat(out, m_value.f);
+		break;
 	case T_FLOAT_ARRAY:
-		ss << "[";
+		out += '[';
 		for (auto it = m_value.a->begin();
 		     it != m_value.a->end();
 		     ++it)
 		{
 			if (it != m_value.a->begin())
 			{
-				ss << ", ";
+				out += ", ";
 			}
-			ss << *it;
+			appendArrayElement(out, *it);
 		}
-		ss << "]";
-		return ss.str();
+		out += ']';
+		break;
 	case T_DP_DICT:
 	case T_DP_LIST:
-		ss << ((m_type==T_DP_DICT)?'{':'[');
+		out += (m_type==T_DP_DICT)?'{':'[';
 		for (auto it = m_value.dpa->begin(); // std::vector<Datapoint *>*	dpa;
 		     it != m_value.dpa->end();
 		     ++it)
 		{
 			if (it != m_value.dpa->begin())
 			{
-				ss << ", ";
+				out += ", ";
 			}
-			ss << ((m_type==T_DP_DICT)?(*it)->toJSONProperty():(*it)->getData().toString());
+			if (m_type==T_DP_DICT)
+				(*it)->appendJSONProperty(out);
+			else
+				(*it)->getData().appendJSON(out);
 		}
-		ss << ((m_type==T_DP_DICT)?'}':']');
-		return ss.str();
+		out += (m_type==T_DP_DICT)?'}':']';
+		break;
 	case T_STRING:
-		ss << "\"";
-		ss << escape(*m_value.str);
-		ss << "\"";
-		return ss.str();
+		out += '"';
+		JSONappendEscaped(out, getStringData(), getStringLength());
+		out += '"';
+		break;
 	case T_DATABUFFER:
-		ss << "\"__DATABUFFER:" 
-			<< ((Base64DataBuffer *)m_value.dataBuffer)->encode()
-			<< "\"";
-		return ss.str();
+		out += "\"__DATABUFFER:";
+		((const Base64DataBuffer *)m_value.shared.dataBuffer)->appendEncoded(out);
+		out += '"';
+		break;
 	case T_IMAGE:
-		ss << "\"__DPIMAGE:" 
-			<< ((Base64DPImage *)m_value.image)->encode()
-			<< "\"";
-		return ss.str();
+		out += "\"__DPIMAGE:";
+		((const Base64DPImage *)m_value.shared.image)->appendEncoded(out);
+		out += '"';
+		break;
 	case T_2D_FLOAT_ARRAY:
 		{
-		ss << "[ ";
+		out += "[ ";
 		bool first = true;
-		for (auto row : *(m_value.a2d))
+		for (auto row : *(m_value.shared.a2d))
 		{
 			if (first)
 				first = false;
 			else
-				ss << ", ";
-			ss << "[";
+				out += ", ";
+			out += '[';
 			for (auto it = row->begin();
 			     it != row->end();
 			     ++it)
 			{
 				if (it != row->begin())
 				{
-					ss << ", ";
+					out += ", ";
 				}
-				ss << *it;
+				appendArrayElement(out, *it);
 			}
-			ss << "]";
+			out += ']';
 		}
-		ss << " ]";
-		return ss.str();
+		out += " ]";
+		break;
 		}
 	default:
 		throw std::runtime_error("No string representation for datapoint type");
@@ -133,34 +166,21 @@ std::string DatapointValue::toString() const
  */
 void DatapointValue::deleteNestedDPV()
 {
-	if (m_type == T_STRING)
-	{
-		delete m_value.str;
-		m_value.str = NULL;
-	}
-	else if (m_type == T_FLOAT_ARRAY)
+	switch (m_type)
 	{
+	case T_STRING:
+		if (m_inlineLength == DPV_HEAP_STRING)
+		{
+			delete m_value.str;
+			m_value.str = NULL;
+		}
+		break;
+	case T_FLOAT_ARRAY:
 		delete m_value.a;
 		m_value.a = NULL;
-	}
-	else if (m_type == T_IMAGE)
-	{
-		delete m_value.image;
-		m_value.a = NULL;
-	}
-	else if (m_type == T_DATABUFFER)
-	{
-		delete m_value.dataBuffer;
-		m_value.dataBuffer = NULL;
-	}
-	else if (m_type == T_IMAGE)
-	{
-		delete m_value.image;
-		m_value.image = NULL;
-	}
-	else if (m_type == T_DP_DICT ||
-		 m_type == T_DP_LIST)
-	{
+		break;
+	case T_DP_DICT:
+	case T_DP_LIST:
 		if (m_value.dpa) {
 			for (auto it = m_value.dpa->begin();
 				 it != m_value.dpa->end();
@@ -174,12 +194,187 @@ void DatapointValue::deleteNestedDPV()
 			delete m_value.dpa;
 			m_value.dpa = NULL;
 		}
+		break;
+	case T_IMAGE:
+	case T_DATABUFFER:
+	case T_2D_FLOAT_ARRAY:
+		releaseShared();
+		m_value.shared.image = NULL;
+		m_value.shared.refs = NULL;
+		break;
+	default:
+		break;
+	}
+}
+
+/**
+ * Set the value to a string, short strings are held within the value
+ *
+ * @param value		The characters of the string
+ * @param length	The length of the string
+ */
+void DatapointValue::setString(const char *value, size_t length)
+{
+	m_type = T_STRING;
+	if (length <= DPV_INLINE_STRING)
+	{
+		memcpy(m_value.inl, value, length);
+		m_value.inl[length] = 0;
+		m_inlineLength = (unsigned char)length;
+	}
+	else
+	{
+		m_value.str = new std::string(value, length);
+		m_inlineLength = DPV_HEAP_STRING;
+	}
+}
+
+/**
+ * Release the reference of the value to a shared image, data buffer or
+ * two dimensional array, deleting it if there are no other references
+ */
+void DatapointValue::releaseShared()
+{
+	if (m_value.shared.refs->fetch_sub(1, std::memory_order_acq_rel) != 1)
+	{
+		return;
+	}
+	switch (m_type)
+	{
+	case T_IMAGE:
+		delete m_value.shared.image;
+		break;
+	case T_DATABUFFER:
+		delete m_value.shared.dataBuffer;
+		break;
+	case T_2D_FLOAT_ARRAY:
+		for (auto row : *m_value.shared.a2d)
+		{
+			delete row;
+		}
+		delete m_value.shared.a2d;
+		break;
+	default:
+		break;
+	}
+	delete m_value.shared.refs;
+}
+
+/**
+ * Take a copy of a shared image, data buffer or two dimensional array
+ * before it is returned for update, so that the update is not seen by
+ * the other values that share it
+ */
+void DatapointValue::unshare()
+{
+	if ((m_type != T_IMAGE && m_type != T_DATABUFFER && m_type != T_2D_FLOAT_ARRAY)
+			|| m_value.shared.refs->load(std::memory_order_acquire) == 1)
+	{
+		return;
+	}
+	shared_t copy;
+	switch (m_type)
+	{
+	case T_IMAGE:
+		copy.image = new DPImage(*m_value.shared.image);
+		break;
+	case T_DATABUFFER:
+		copy.dataBuffer = new DataBuffer(*m_value.shared.dataBuffer);
+		break;
+	default:
+		copy.a2d = copy2DArray(*m_value.shared.a2d);
+		break;
+	}
+	copy.refs = new std::atomic<unsigned int>(1);
+	releaseShared();
+	m_value.shared = copy;
+}
+
+/**
+ * Return a copy of a two dimensional array
+ *
+ * @param values	The rows of the array
+ */
+std::vector< std::vector<double>* > *DatapointValue::copy2DArray(const std::vector< std::vector<double>* >& values)
+{
+	std::vector< std::vector<double>* > *a2d = new std::vector< std::vector<double>* >;
+	a2d->reserve(values.size());
+	for (auto row : values)
+	{
+		a2d->push_back(new std::vector<double>(*row));
+	}
+	return a2d;
+}
+
+/**
+ * Return the approximate number of bytes of memory used by the value,
+ * including the memory it owns. Allocator overheads are not included.
+ *
+ * @return size_t	The bytes used by the value
+ */
+size_t DatapointValue::getMemorySize() const
+{
+	size_t size = sizeof(DatapointValue);
+	switch (m_type)
+	{
+		case T_STRING:
+			if (m_inlineLength == DPV_HEAP_STRING)
+			{
+				size += sizeof(std::string) + m_value.str->capacity();
+			}
+			break;
+		case T_FLOAT_ARRAY:
+			size += sizeof(std::vector<double>) + m_value.a->capacity() * sizeof(double);
+			break;
+		case T_DP_DICT:
+		case T_DP_LIST:
+			size += sizeof(std::vector<Datapoint *>) + m_value.dpa->capacity() * sizeof(Datapoint *);
+			for (auto dp : *m_value.dpa)
+			{
+				size += dp->getMemorySize();
+			}
+			break;
+		case T_IMAGE:
+			size += sizeof(DPImage) + (size_t)m_value.shared.image->getWidth()
+				* m_value.shared.image->getHeight() * (m_value.shared.image->getDepth() / 8);
+			break;
+		case T_DATABUFFER:
+			size += sizeof(DataBuffer) + m_value.shared.dataBuffer->getItemSize()
+				* m_value.shared.dataBuffer->getItemCount();
+			break;
+		case T_2D_FLOAT_ARRAY:
+			size += sizeof(std::vector<std::vector<double> *>)
+				+ m_value.shared.a2d->capacity() * sizeof(std::vector<double> *);
+			for (auto row : *m_value.shared.a2d)
+			{
+				size += sizeof(std::vector<double>) + row->capacity() * sizeof(double);
+			}
+			break;
+		default:
+			break;
 	}
-	else if (m_type == T_2D_FLOAT_ARRAY)
+	return size;
+}
+
+/**
+ * DatapointValue move assignment operator. The current value is
+ * deleted and the value of rhs is taken, rhs is left as an integer
+ * value of zero.
+ *
+ * @param rhs	The value to take
+ */
+DatapointValue& DatapointValue::operator=(DatapointValue&& rhs)
+{
+	if (this != &rhs)
 	{
-		delete m_value.a2d;
-		m_value.a2d = NULL;
+		deleteNestedDPV();
+		m_value = rhs.m_value;
+		m_type = rhs.m_type;
+		m_inlineLength = rhs.m_inlineLength;
+		rhs.m_value.i = 0;
+		rhs.m_type = T_INTEGER;
 	}
+	return *this;
 }
 
 /**
@@ -193,7 +388,8 @@ DatapointValue::~DatapointValue()
 }
 
 /**
- * Copy constructor
+ * Copy constructor, images, data buffers and two dimensional
+ * arrays are shared with obj rather than copied
  */
 DatapointValue::DatapointValue(const DatapointValue& obj)
 {
@@ -201,7 +397,7 @@ DatapointValue::DatapointValue(const DatapointValue& obj)
 	switch (m_type)
 	{
 		case T_STRING:
-			m_value.str = new std::string(*(obj.m_value.str));
+			setString(obj.getStringData(), obj.getStringLength());
 			break;
 		case T_FLOAT_ARRAY:
 			m_value.a = new std::vector<double>(*(obj.m_value.a));
@@ -221,23 +417,10 @@ DatapointValue::DatapointValue(const DatapointValue& obj)
 
 			break;
 		case T_IMAGE:
-			m_value.image = new DPImage(*(obj.m_value.image));
-			break;
 		case T_DATABUFFER:
-			m_value.dataBuffer = new DataBuffer(*(obj.m_value.dataBuffer));
-			break;
 		case T_2D_FLOAT_ARRAY:
-			m_value.a2d = new std::vector< std::vector<double>* >;
-			for (auto row : *obj.m_value.a2d)
-			{
-				std::vector<double> *nrow = new std::vector<double>;
-				for (auto& d : *row)
-				{
-					nrow->push_back(d);
-				}
-				m_value.a2d->push_back(nrow);
-			}
-			m_type = T_2D_FLOAT_ARRAY;
+			m_value.shared = obj.m_value.shared;
+			m_value.shared.refs->fetch_add(1, std::memory_order_relaxed);
 			break;
 		default:
 			m_value = obj.m_value;
@@ -250,72 +433,10 @@ DatapointValue::DatapointValue(const DatapointValue& obj)
  */
 DatapointValue& DatapointValue::operator=(const DatapointValue& rhs)
 {
-	if (m_type == T_STRING)
-	{
-		// Remove previous value
-		delete m_value.str;
-	}
-	if (m_type == T_FLOAT_ARRAY)
-	{
-		// Remove previous value
-		delete m_value.a;
-	}
-	if (m_type == T_DP_DICT || m_type == T_DP_LIST)
-	{
-		// Remove previous value
-		delete m_value.dpa;
-	}
-	if (m_type == T_IMAGE)
+	if (this != &rhs)
 	{
-		delete m_value.image;
+		*this = DatapointValue(rhs);
 	}
-	if (m_type == T_DATABUFFER)
-	{
-		delete m_value.dataBuffer;
-	}
-	if (m_type == T_2D_FLOAT_ARRAY)
-	{
-		delete m_value.a2d;
-	}
-
-	m_type = rhs.m_type;
-
-	switch (m_type)
-	{
-	case T_STRING:
-		m_value.str = new std::string(*(rhs.m_value.str));
-		break;
-	case T_FLOAT_ARRAY:
-		m_value.a = new std::vector<double>(*(rhs.m_value.a));
-		break;
-	case T_DP_DICT:
-	case T_DP_LIST:
-		m_value.dpa = new std::vector<Datapoint*>(*(rhs.m_value.dpa));
-		break;
-	case T_IMAGE:
-		m_value.image = new DPImage(*(rhs.m_value.image));
-		break;
-	case T_DATABUFFER:
-		m_value.dataBuffer = new DataBuffer(*(rhs.m_value.dataBuffer));
-		break;
-	case T_2D_FLOAT_ARRAY:
-		m_value.a2d = new std::vector< std::vector<double>* >;
-		for (auto row : *(rhs.m_value.a2d))
-		{
-			std::vector<double> *nrow = new std::vector<double>;
-			for (auto& d : *row)
-			{
-				nrow->push_back(d);
-			}
-			m_value.a2d->push_back(nrow);
-		}
-		m_type = T_2D_FLOAT_ARRAY;
-		break;
-	default:
-		m_value = rhs.m_value;
-		break;
-	}
-
 	return *this;
 }
 
@@ -329,27 +450,33 @@ DatapointValue& DatapointValue::operator=(const DatapointValue& rhs)
 const std::string DatapointValue::escape(const std::string& str) const
 {
 std::string rval;
-int bscount = 0;
 
-	for (size_t i = 0; i < str.length(); i++)
-	{
-		if (str[i] == '\\')
-		{
-			bscount++;
-		}
-		else if (str[i] == '\"')
-		{
-			if ((bscount & 1) == 0)	// not already escaped
-			{
-				rval += "\\";	// Add escape of "
-			}
-			bscount = 0;
-		}
-		else
-		{
-			bscount = 0;
-		}
-		rval += str[i];
-	}
+	JSONappendEscaped(rval, str.data(), str.length());
 	return rval;
 }
+
+/**
+ * Return the slab allocator used for Datapoint objects
+ */
+SlabAllocator *Datapoint::getAllocator()
+{
+	// Never destroyed, datapoints may outlive static destructors
+	static SlabAllocator *allocator = new SlabAllocator(sizeof(Datapoint));
+	return allocator;
+}
+
+/**
+ * Allocate a datapoint, from the slab allocator if enabled
+ */
+void *Datapoint::operator new(size_t size)
+{
+	return getAllocator()->allocate(size);
+}
+
+/**
+ * Free a datapoint allocated via the slab allocator
+ */
+void Datapoint::operator delete(void *ptr)
+{
+	SlabAllocator::release(ptr);
+}
@@ -19,6 +19,12 @@
 
 using namespace std;
 
+/**
+ * The output of the partition being passed through the pipeline by the
+ * calling thread, NULL if the thread is not running a partition
+ */
+static thread_local vector<Reading *> *partitionOutput = NULL;
+
 /**
  * FilterPipeline class constructor
  *
@@ -29,7 +35,8 @@ using namespace std;
  * @param serviceName	Name of the service to which this pipeline applies
  */
 FilterPipeline::FilterPipeline(ManagementClient* mgtClient, StorageClient& storage, string serviceName) : 
-			mgtClient(mgtClient), storage(storage), serviceName(serviceName), m_ready(false)
+			mgtClient(mgtClient), storage(storage), serviceName(serviceName), m_ready(false),
+			m_outstanding(0), m_shutdown(false)
 {
 }
 
@@ -38,6 +45,7 @@ FilterPipeline::FilterPipeline(ManagementClient* mgtClient, StorageClient& stora
  */
 FilterPipeline::~FilterPipeline()
 {
+	stopPartitionWorkers();
 }
 
 /**
@@ -270,6 +278,7 @@ bool FilterPipeline::setupFiltersPipeline(void *passToOnwardFilter, void *useFil
 			m_serviceHandler = (ServiceHandler *)ingest;
 			
 			m_filterCategories[filterCategoryName] = (*it);
+			m_filterVersions[filterCategoryName] = updatedCfg.getVersion();
 		}
 		// TODO catch specific exceptions
 		catch (...)
@@ -280,6 +289,9 @@ bool FilterPipeline::setupFiltersPipeline(void *passToOnwardFilter, void *useFil
 		// Iterate the load filters set in the Ingest class m_filters member 
 		if ((it + 1) != m_filters.end())
 		{
+			// Allow a run of in place filters to be called in turn
+			(*it)->setNext(*(it + 1));
+
 			// Set next filter pointer as OUTPUT_HANDLE
 			if (!(*it)->init(updatedCfg,
 					(OUTPUT_HANDLE *)(*(it + 1)),
@@ -326,6 +338,8 @@ bool FilterPipeline::setupFiltersPipeline(void *passToOnwardFilter, void *useFil
 		return false;
 	}
 
+	startPartitionWorkers();
+
 	// Set filter pipeline is ready for data ingest
 	m_ready = true;
 
@@ -343,6 +357,8 @@ bool FilterPipeline::setupFiltersPipeline(void *passToOnwardFilter, void *useFil
  */
 void FilterPipeline::cleanupFilters(const string& categoryName)
 {
+	stopPartitionWorkers();
+
 	// Cleanup filters, in reverse order
 	for (auto it = m_filters.rbegin(); it != m_filters.rend(); ++it)
 	{
@@ -408,7 +424,240 @@ void FilterPipeline::configChange(const string& category, const string& newConfi
 	auto it = m_filterCategories.find(category);
 	if (it != m_filterCategories.end())
 	{
+		try
+		{
+			// Skip a change that leaves the filter configuration unchanged
+			ConfigCategory config(category, newConfig);
+			uint64_t version = config.getVersion();
+			if (m_filterVersions[category] == version)
+			{
+				Logger::getLogger()->info("Configuration of filter %s is unchanged", category.c_str());
+				return;
+			}
+			m_filterVersions[category] = version;
+		}
+		catch (ConfigMalformed *e)
+		{
+			// Let the filter deal with a malformed configuration
+			delete e;
+		}
+		catch (...)
+		{
+		}
 		it->second->reconfigure(newConfig);
 	}
 }
 
+
+/**
+ * Return true if any of the filters of the pipeline is a Python filter.
+ * The instances of a Python filter share the Python module of the
+ * filter, so a pipeline with Python filters must be shutdown before a
+ * new pipeline with the same filters is setup.
+ */
+bool FilterPipeline::hasPythonFilters()
+{
+	PluginManager *pluginManager = PluginManager::getInstance();
+	for (auto& filter : m_filters)
+	{
+		if (pluginManager->getPluginImplType(filter->getHandle()) == PYTHON_PLUGIN)
+		{
+			return true;
+		}
+	}
+	return false;
+}
+
+/**
+ * Return the statistics of each filter of the pipeline as a JSON array
+ *
+ * @param json	Set to the JSON array
+ */
+void FilterPipeline::getStatistics(string& json)
+{
+	json = "[ ";
+	for (auto it = m_filters.begin(); it != m_filters.end(); ++it)
+	{
+		string statistics;
+		(*it)->getStatistics().toJSON(statistics);
+		if (it != m_filters.begin())
+		{
+			json += ", ";
+		}
+		json += "{ \"name\" : \"" + (*it)->getName() + "\", \"statistics\" : " + statistics + " }";
+	}
+	json += " ]";
+}
+
+/**
+ * Start the worker threads that pass partitions of the readings through
+ * the pipeline if every filter in the pipeline is stateless
+ */
+void FilterPipeline::startPartitionWorkers()
+{
+	if (m_filters.empty() || !m_workers.empty())
+	{
+		return;
+	}
+	for (auto& filter : m_filters)
+	{
+		if (!filter->isStateless())
+		{
+			return;
+		}
+	}
+	unsigned int partitions = thread::hardware_concurrency();
+	if (partitions > MAX_FILTER_PARTITIONS)
+	{
+		partitions = MAX_FILTER_PARTITIONS;
+	}
+	m_shutdown = false;
+	// The calling thread runs the first partition itself
+	for (unsigned int i = 1; i < partitions; i++)
+	{
+		m_workers.push_back(thread(&FilterPipeline::partitionWorker, this));
+	}
+	if (!m_workers.empty())
+	{
+		Logger::getLogger()->info("The filters of %s are stateless, readings will be "
+					  "filtered in up to %d partitions in parallel",
+					  serviceName.c_str(), m_workers.size() + 1);
+	}
+}
+
+/**
+ * Stop the worker threads of the pipeline
+ */
+void FilterPipeline::stopPartitionWorkers()
+{
+	{
+		lock_guard<mutex> guard(m_workMutex);
+		m_shutdown = true;
+	}
+	m_workCV.notify_all();
+	for (auto& worker : m_workers)
+	{
+		worker.join();
+	}
+	m_workers.clear();
+}
+
+/**
+ * The worker thread that passes partitions of the readings through
+ * the pipeline
+ */
+void FilterPipeline::partitionWorker()
+{
+	unique_lock<mutex> lock(m_workMutex);
+	while (true)
+	{
+		m_workCV.wait(lock, [this]{ return m_shutdown || !m_partitions.empty(); });
+		if (m_shutdown)
+		{
+			return;
+		}
+		FilterPartition *partition = m_partitions.front();
+		m_partitions.pop();
+		lock.unlock();
+		runPartition(*partition);
+		lock.lock();
+		if (--m_outstanding == 0)
+		{
+			m_doneCV.notify_all();
+		}
+	}
+}
+
+/**
+ * Pass a partition of the readings through the pipeline, the last
+ * filter passes the output to collectPartition
+ *
+ * @param partition	The partition to filter
+ */
+void FilterPipeline::runPartition(FilterPartition& partition)
+{
+	partitionOutput = &partition.m_output;
+	ReadingSet *readingSet = new ReadingSet(&partition.m_input);
+	partition.m_input.clear();
+	try {
+		getFirstFilterPlugin()->ingest(readingSet);
+	} catch (exception& e) {
+		Logger::getLogger()->error("Filter pipeline of %s failed to filter a partition "
+					   "of the readings: %s", serviceName.c_str(), e.what());
+	}
+	partitionOutput = NULL;
+}
+
+/**
+ * Pass a block of readings through the pipeline in partitions that
+ * are filtered in parallel. The block is left to the caller to filter
+ * if the filters are not all stateless or the block is too small to
+ * be worth splitting.
+ *
+ * @param readings	The readings to filter, replaced by the filtered readings
+ * @return bool		True if the readings have been filtered
+ */
+bool FilterPipeline::ingestPartitioned(vector<Reading *> *readings)
+{
+	if (m_workers.empty() || readings->size() < 2 * MIN_PARTITION_READINGS)
+	{
+		return false;
+	}
+	size_t count = m_workers.size() + 1;
+	if (count > readings->size() / MIN_PARTITION_READINGS)
+	{
+		count = readings->size() / MIN_PARTITION_READINGS;
+	}
+	size_t size = (readings->size() + count - 1) / count;
+	vector<FilterPartition> partitions(count);
+	for (size_t i = 0; i < readings->size(); i++)
+	{
+		partitions[i / size].m_input.push_back((*readings)[i]);
+	}
+	readings->clear();
+
+	{
+		lock_guard<mutex> guard(m_workMutex);
+		for (size_t i = 1; i < count; i++)
+		{
+			m_partitions.push(&partitions[i]);
+		}
+		m_outstanding = count - 1;
+	}
+	m_workCV.notify_all();
+
+	runPartition(partitions[0]);
+
+	{
+		unique_lock<mutex> lock(m_workMutex);
+		m_doneCV.wait(lock, [this]{ return m_outstanding == 0; });
+	}
+
+	for (auto& partition : partitions)
+	{
+		readings->insert(readings->end(), partition.m_output.begin(), partition.m_output.end());
+	}
+	return true;
+}
+
+/**
+ * Called by the function that receives the output of the last filter
+ * of the pipeline. If the calling thread is filtering a partition the
+ * readings are added to the output of the partition and the reading
+ * set is deleted.
+ *
+ * @param readingSet	The output of the last filter
+ * @return bool		True if the readings were the output of a partition
+ */
+bool FilterPipeline::collectPartition(READINGSET *readingSet)
+{
+	if (!partitionOutput)
+	{
+		return false;
+	}
+	vector<Reading *> *readings = readingSet->getAllReadingsPtr();
+	partitionOutput->insert(partitionOutput->end(), readings->begin(), readings->end());
+	readingSet->clear();
+	delete readingSet;
+	return true;
+}
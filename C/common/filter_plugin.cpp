@@ -9,6 +9,9 @@
  */
 
 #include <filter_plugin.h>
+#include <tracer.h>
+#include <alloc_profiler.h>
+#include <chrono>
 #include "rapidjson/writer.h"
 #include "rapidjson/stringbuffer.h"
 
@@ -16,6 +19,17 @@
 #define JSON_CONFIG_PIPELINE_ELEM "pipeline"
 
 using namespace std;
+using namespace std::chrono;
+
+/**
+ * The microseconds the readings output by the filter being called by
+ * the thread have spent in the rest of the pipeline
+ */
+static thread_local unsigned long downstreamTime = 0;
+
+static const char *latencyBuckets[FILTER_LATENCY_BUCKETS] = {
+	"<10us", "<100us", "<1ms", "<10ms", "<100ms", "<1s", ">=1s"
+};
 
 /**
  * FilterPlugin class constructor
@@ -53,9 +67,15 @@ FilterPlugin::FilterPlugin(const std::string& name,
   	pluginReconfigurePtr = (void (*)(PLUGIN_HANDLE, const string&))
 				      manager->resolveSymbol(handle,
 							     "plugin_reconfigure");
+	pluginIngestInplacePtr = (void (*)(PLUGIN_HANDLE, READINGSET *))
+				      manager->resolveSymbol(handle,
+							     "plugin_ingest_inplace");
 
 	// Set m_instance default value
 	m_instance = NULL;
+	m_outHandle = NULL;
+	m_output = NULL;
+	m_next = NULL;
 
 	// Persist data initialised
 	m_plugin_data = NULL;	
@@ -83,9 +103,13 @@ PLUGIN_HANDLE FilterPlugin::init(const ConfigCategory& config,
 				 OUTPUT_HANDLE *outHandle,
 				 OUTPUT_STREAM outputFunc)
 {
+	// The filter outputs through this class so that the output can be
+	// measured
+	m_outHandle = outHandle;
+	m_output = outputFunc;
 	m_instance = this->pluginInit(&config,
-				      outHandle,
-				      outputFunc);
+				      (OUTPUT_HANDLE *)this,
+				      FilterPlugin::output);
 	return (m_instance ? &m_instance : NULL);
 }
 
@@ -163,13 +187,164 @@ void FilterPlugin::startData(const string& storedData)
  *
  * This call ingest the readings through the filters chain
  *
+ * A plugin with a "plugin_ingest_inplace" method modifies the readings
+ * of the reading set rather than passing a new reading set to its
+ * output. The in place methods of a run of such filters are called in
+ * turn on the same reading set, which is then passed to the output of
+ * the last filter of the run.
+ *
  * @param readings	The reading set to ingest
  */
 void FilterPlugin::ingest(READINGSET* readings)
 {
+	TRACE_SPAN("filter", "FilterPlugin::ingest");
+	ALLOC_SCOPE(ALLOC_FILTER_PIPELINE);
+	if (this->pluginIngestInplacePtr)
+	{
+		FilterPlugin *filter = this;
+		while (true)
+		{
+			size_t count = readings->getAllReadingsPtr()->size();
+			size_t datapoints = FilterStatistics::countDatapoints(readings);
+			auto start = steady_clock::now();
+			filter->pluginIngestInplacePtr(filter->m_instance, readings);
+			filter->m_statistics.recordCall(duration_cast<microseconds>(steady_clock::now() - start).count(),
+							count, datapoints);
+			filter->m_statistics.recordOutput(readings->getAllReadingsPtr()->size(),
+							  FilterStatistics::countDatapoints(readings));
+			if (!filter->m_next || !filter->m_next->pluginIngestInplacePtr)
+			{
+				break;
+			}
+			filter = filter->m_next;
+		}
+		(*filter->m_output)(filter->m_outHandle, readings);
+		return;
+	}
 	if (this->pluginIngestPtr)
 	{
-        	return this->pluginIngestPtr(m_instance, readings);
+		size_t count = readings->getAllReadingsPtr()->size();
+		size_t datapoints = FilterStatistics::countDatapoints(readings);
+		unsigned long saved = downstreamTime;
+		downstreamTime = 0;
+		auto start = steady_clock::now();
+        	this->pluginIngestPtr(m_instance, readings);
+		unsigned long elapsed = duration_cast<microseconds>(steady_clock::now() - start).count();
+		m_statistics.recordCall(elapsed > downstreamTime ? elapsed - downstreamTime : 0,
+					count, datapoints);
+		downstreamTime = saved;
+	}
+}
+
+/**
+ * The output stream passed to the plugin. Record the readings output
+ * by the filter and the time they take in the rest of the pipeline and
+ * pass them to the output stream of the filter.
+ *
+ * @param outHandle	The FilterPlugin
+ * @param readings	The readings output by the filter
+ */
+void FilterPlugin::output(OUTPUT_HANDLE *outHandle, READINGSET *readings)
+{
+	FilterPlugin *filter = (FilterPlugin *)outHandle;
+	filter->m_statistics.recordOutput(readings->getAllReadingsPtr()->size(),
+					  FilterStatistics::countDatapoints(readings));
+	auto start = steady_clock::now();
+	(*filter->m_output)(filter->m_outHandle, readings);
+	downstreamTime += duration_cast<microseconds>(steady_clock::now() - start).count();
+}
+
+/**
+ * Constructor for the statistics of a filter
+ */
+FilterStatistics::FilterStatistics() : m_calls(0), m_time(0), m_maxTime(0),
+	m_readingsIn(0), m_readingsOut(0), m_datapointsIn(0), m_datapointsOut(0)
+{
+	for (int i = 0; i < FILTER_LATENCY_BUCKETS; i++)
+	{
+		m_latency[i] = 0;
+	}
+}
+
+/**
+ * Record a call to the filter
+ *
+ * @param usec		The microseconds the filter took
+ * @param readings	The number of readings passed to the filter
+ * @param datapoints	The number of datapoints in the readings
+ */
+void FilterStatistics::recordCall(unsigned long usec, size_t readings, size_t datapoints)
+{
+	int bucket = 0;
+	for (unsigned long limit = 10; bucket < FILTER_LATENCY_BUCKETS - 1 && usec >= limit; limit *= 10)
+	{
+		bucket++;
+	}
+	lock_guard<mutex> guard(m_mutex);
+	m_calls++;
+	m_time += usec;
+	if (usec > m_maxTime)
+	{
+		m_maxTime = usec;
+	}
+	m_readingsIn += readings;
+	m_datapointsIn += datapoints;
+	m_latency[bucket]++;
+}
+
+/**
+ * Record readings output by the filter
+ *
+ * @param readings	The number of readings
+ * @param datapoints	The number of datapoints in the readings
+ */
+void FilterStatistics::recordOutput(size_t readings, size_t datapoints)
+{
+	lock_guard<mutex> guard(m_mutex);
+	m_readingsOut += readings;
+	m_datapointsOut += datapoints;
+}
+
+/**
+ * Return the statistics as a JSON object
+ *
+ * @param json	Set to the JSON object
+ */
+void FilterStatistics::toJSON(string& json)
+{
+	lock_guard<mutex> guard(m_mutex);
+	json = "{ \"calls\" : " + to_string(m_calls);
+	json += ", \"readingsIn\" : " + to_string(m_readingsIn);
+	json += ", \"readingsOut\" : " + to_string(m_readingsOut);
+	json += ", \"datapointsIn\" : " + to_string(m_datapointsIn);
+	json += ", \"datapointsOut\" : " + to_string(m_datapointsOut);
+	json += ", \"totalTime\" : " + to_string(m_time);
+	json += ", \"maxTime\" : " + to_string(m_maxTime);
+	json += ", \"latency\" : { ";
+	for (int i = 0; i < FILTER_LATENCY_BUCKETS; i++)
+	{
+		if (i)
+		{
+			json += ", ";
+		}
+		json += "\"" + string(latencyBuckets[i]) + "\" : " + to_string(m_latency[i]);
+	}
+	json += " } }";
+}
+
+/**
+ * Count the datapoints in a set of readings
+ *
+ * @param readings	The readings
+ * @return size_t	The number of datapoints
+ */
+size_t FilterStatistics::countDatapoints(READINGSET *readings)
+{
+	size_t count = 0;
+	for (auto reading : *readings->getAllReadingsPtr())
+	{
+		count += reading->getDatapointCount();
 	}
+	return count;
 }
 
@@ -10,6 +10,7 @@
  */
 
 #include <form_data.h>
+#include <multipart_parser.h>
 #include <errno.h>
 
 using namespace std;
@@ -410,3 +411,38 @@ bool FormData::saveFile(FormData::FieldValue& v, const string& fileName)
 	return true;
 }
 
+
+/**
+ * Save an uploaded file without searching the content for the field
+ * first. The content is given to a multipart parser a piece at a time
+ * and the file is written as it is parsed, the content may be binary.
+ *
+ * @param field		The field name (filename type) to save
+ * @param fileName	The file to save the content to
+ * @return		Returns true if the file was succesfully saved
+ */
+bool FormData::saveUploadedFile(const string& field, const string& fileName)
+{
+	MultipartParser parser(m_boundary.substr(2));
+	parser.saveFile(field, fileName);
+	for (size_t offset = 0; offset < m_size && !parser.isComplete(); offset += FORM_DATA_PARSE_SIZE)
+	{
+		if (!parser.parse(m_buffer + offset, min((size_t)FORM_DATA_PARSE_SIZE, m_size - offset)))
+		{
+			return false;
+		}
+	}
+	if (!parser.isComplete())
+	{
+		Logger::getLogger()->error("Closing boundary not found for file content");
+		return false;
+	}
+	if (!parser.hasField(field))
+	{
+		Logger::getLogger()->error("The uploaded content has no field '%s'", field.c_str());
+		return false;
+	}
+	Logger::getLogger()->debug("Saved uploaded file '%s' as '%s'",
+				parser.getFilename(field).c_str(), fileName.c_str());
+	return true;
+}
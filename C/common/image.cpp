@@ -12,9 +12,13 @@
 #include <string.h>
 #include <exception>
 #include <stdexcept>
+#include <stdlib.h>
+#include <sys/mman.h>
 
 using namespace std;
 
+std::atomic<size_t> DPImage::m_mmapThreshold(0);
+
 /**
  * DPImage constructor
  *
@@ -27,73 +31,108 @@ DPImage::DPImage(int width, int height, int depth, void *data) : m_width(width),
 	m_height(height), m_depth(depth)
 {
 	m_byteSize = width * height * (depth / 8);
-	m_pixels = (void *)malloc(m_byteSize);
-	if (m_pixels)
-	{
-		memcpy(m_pixels, data, m_byteSize);
-	}
-	else
+	allocate();
+	memcpy(m_pixels, data, m_byteSize);
+}
+
+/**
+ * DPImage constructor for an image whose pixels are written
+ * in place by the caller, the pixels are initially zero
+ *
+ * @param width		The image width
+ * @param height	The image height
+ * @param depth		The image depth
+ */
+DPImage::DPImage(int width, int height, int depth) : m_width(width),
+	m_height(height), m_depth(depth)
+{
+	m_byteSize = width * height * (depth / 8);
+	if (!allocate())
 	{
-		throw runtime_error("Insufficient memory to store image");
+		memset(m_pixels, 0, m_byteSize);
 	}
 }
 
 /**
- * Copy constructor
+ * Copy constructor, the copy shares the pixels of the image
  *
  * @param DPImage		The image to copy
  */
-DPImage::DPImage(const DPImage& rhs)
+DPImage::DPImage(const DPImage& rhs) : m_width(rhs.m_width), m_height(rhs.m_height),
+	m_depth(rhs.m_depth), m_pixels(rhs.m_pixels), m_byteSize(rhs.m_byteSize),
+	m_buffer(rhs.m_buffer)
 {
-	m_width = rhs.m_width;
-	m_height = rhs.m_height;
-	m_depth = rhs.m_depth;
-
-	m_byteSize = m_width * m_height * (m_depth / 8);
-	m_pixels = (void *)malloc(m_byteSize);
-	if (m_pixels)
-	{
-		memcpy(m_pixels, rhs.m_pixels, m_byteSize);
-	}
-	else
-	{
-		throw runtime_error("Insufficient memory to store image");
-	}
 }
 
 /**
- * Assignment operator
+ * Assignment operator, the image shares the pixels of the
+ * right hand side
+ *
  * @param rhs	Righthand side of equals operator
  */
 DPImage& DPImage::operator=(const DPImage& rhs)
 {
-	// Free any old data
-	if (m_pixels)
-		free(m_pixels);
-    
 	m_width = rhs.m_width;
 	m_height = rhs.m_height;
 	m_depth = rhs.m_depth;
+	m_byteSize = rhs.m_byteSize;
+	m_buffer = rhs.m_buffer;
+	m_pixels = rhs.m_pixels;
+	return *this;
+}
 
-	m_byteSize = m_width * m_height * (m_depth / 8);
-	m_pixels = (void *)malloc(m_byteSize);
-	if (m_pixels)
+/**
+ * Destructor for the image, the pixels are freed once
+ * no image shares them
+ */
+DPImage::~DPImage()
+{
+	m_pixels = NULL;
+}
+
+/**
+ * Allocate the memory for m_byteSize bytes of pixels, from mapped
+ * pages if the image is at least as large as the mmap threshold
+ *
+ * @return bool	True if the pixels are mapped pages, which are zero
+ */
+bool DPImage::allocate()
+{
+	size_t size = m_byteSize;
+	size_t threshold = m_mmapThreshold;
+	if (threshold && size >= threshold)
 	{
-		memcpy(m_pixels, rhs.m_pixels, m_byteSize);
+		void *pages = mmap(NULL, size, PROT_READ | PROT_WRITE,
+					MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+		if (pages == MAP_FAILED)
+		{
+			throw runtime_error("Insufficient memory to store image");
+		}
+		m_buffer.reset(pages, [size](void *p) { munmap(p, size); });
+		m_pixels = pages;
+		return true;
 	}
-	else
+	void *pixels = malloc(size);
+	if (!pixels)
 	{
 		throw runtime_error("Insufficient memory to store image");
 	}
-	return *this;
+	m_buffer.reset(pixels, free);
+	m_pixels = pixels;
+	return false;
 }
 
 /**
- * Destructor for the image
+ * Take a copy of the pixels if they are shared with another image,
+ * so that they may be modified without changing the other image
  */
-DPImage::~DPImage()
+void DPImage::unshare()
 {
-	if (m_pixels)
-		free(m_pixels);
-	m_pixels = NULL;
+	if (!m_pixels || !isShared())
+	{
+		return;
+	}
+	void *shared = m_pixels;
+	allocate();
+	memcpy(m_pixels, shared, m_byteSize);
 }
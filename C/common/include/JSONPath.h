@@ -18,28 +18,50 @@
 /**
  * A simple implementation of a JSON Path search mechanism to use
  * alongside RapidJSON
+ *
+ * The path is parsed once when the JSONPath is created, after which
+ * it may be used to search any number of documents, from any number
+ * of threads.
  */
 class JSONPath {
 	public:
 		JSONPath(const std::string& path);
 		~JSONPath();
-		rapidjson::Value *findNode(rapidjson::Value& root);
+		rapidjson::Value *findNode(rapidjson::Value& root) const;
+		bool		isStreamable() const;
 	private:
+		/**
+		 * A step of a path that can be matched against the events
+		 * of a SAX parser, either a member of an object or an
+		 * element of an array
+		 */
+		class Step {
+			public:
+				Step(const std::string& name) : m_name(name), m_index(-1) {};
+				Step(int index) : m_index(index) {};
+				bool		isIndex() const { return m_index >= 0; };
+				std::string	m_name;
+				int		m_index;
+		};
 		class PathComponent {
 			public:
-				virtual rapidjson::Value *match(rapidjson::Value *node) = 0;
+				virtual ~PathComponent() {};
+				virtual rapidjson::Value *match(rapidjson::Value *node) const = 0;
+				virtual bool	steps(std::vector<Step>& steps) const = 0;
 		};
 		class LiteralPathComponent : public PathComponent {
 			public:
 				LiteralPathComponent(std::string& name);
-				rapidjson::Value *match(rapidjson::Value *node);
+				rapidjson::Value *match(rapidjson::Value *node) const;
+				bool	steps(std::vector<Step>& steps) const;
 			private:
 				std::string	m_name;
 		};
 		class IndexPathComponent : public PathComponent {
 			public:
 				IndexPathComponent(std::string& name, int index);
-				rapidjson::Value *match(rapidjson::Value *node);
+				rapidjson::Value *match(rapidjson::Value *node) const;
+				bool	steps(std::vector<Step>& steps) const;
 			private:
 				std::string	m_name;
 				int		m_index;
@@ -47,7 +69,8 @@ class JSONPath {
 		class MatchPathComponent : public PathComponent {
 			public:
 				MatchPathComponent(std::string& name, std::string& property, std::string& value);
-				rapidjson::Value *match(rapidjson::Value *node);
+				rapidjson::Value *match(rapidjson::Value *node) const;
+				bool	steps(std::vector<Step>& steps) const;
 			private:
 				std::string	m_name;
 				std::string	m_property;
@@ -58,6 +81,33 @@ class JSONPath {
 		std::vector<PathComponent *>
 				m_parsed;
 		Logger		*m_logger;
+		friend class	JSONPathSet;
+};
+
+/**
+ * A set of JSON paths that are evaluated against a document together.
+ *
+ * Paths that consist only of object members and array indexes are
+ * matched against the events of a SAX parse of the document, in a
+ * single pass and without building a DOM; the parse stops as soon as
+ * all of these paths have been found. A DOM is only built if the set
+ * contains a path with a matching predicate.
+ *
+ * The set holds no state between evaluations and may be shared by
+ * threads.
+ */
+class JSONPathSet {
+	public:
+		JSONPathSet(const std::vector<std::string>& paths);
+		~JSONPathSet();
+		size_t		size() const { return m_paths.size(); };
+		bool		evaluate(const char *json, rapidjson::Document& results) const;
+	private:
+		class Node;
+		class Handler;
+		std::vector<JSONPath *>	m_paths;
+		Node			*m_root;
+		bool			m_streamable;
 };
 
 #endif
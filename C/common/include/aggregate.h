@@ -20,10 +20,11 @@ class Aggregate {
 		Aggregate(const std::string& operation, const std::string& column) :
 				m_column(column), m_operation(operation) {};
 		~Aggregate() {};
-		std::string	toJSON();
+		const std::string&	toJSON() const;
 	private:
 		const std::string	m_column;
 		const std::string	m_operation;
+		mutable std::string	m_json;
 };
 #endif
 
@@ -0,0 +1,72 @@
+#ifndef _ALLOC_PROFILER_H
+#define _ALLOC_PROFILER_H
+/*
+ * Fledge counting of the allocations of the data path.
+ *
+ * Copyright (c) 2026 Dianomic Systems
+ *
+ * Released under the Apache 2.0 Licence
+ *
+ * Author: agent
+ */
+#include <string>
+#include <stddef.h>
+
+/**
+ * The stages of the data path the allocations are counted against
+ */
+enum AllocStage {
+	ALLOC_UNTAGGED = 0,
+	ALLOC_SOUTH_INGEST,
+	ALLOC_FILTER_PIPELINE,
+	ALLOC_STORAGE_APPEND,
+	ALLOC_NORTH_SEND,
+	ALLOC_STAGES
+};
+
+/**
+ * The counts of the allocations made by each stage of the data path.
+ *
+ * When the FLEDGE_ALLOC_PROFILING build option is on the global
+ * operator new and delete are replaced by versions that count each
+ * allocation against the stage the calling thread is in. A thread
+ * enters a stage with ALLOC_SCOPE and each stage counts the readings
+ * it processes with ALLOC_READINGS, so that the allocations per
+ * reading of each stage can be reported. Without the build option
+ * the macros generate no code and nothing is counted.
+ */
+class AllocProfiler {
+	public:
+		static bool		isEnabled();
+		static AllocStage	setStage(AllocStage stage);
+		static void		readings(AllocStage stage, unsigned long count);
+		static void		reset();
+		static void		asJSON(std::string& json);
+		static unsigned long	getAllocations(AllocStage stage);
+		static unsigned long	getReadings(AllocStage stage);
+		static const char	*stageName(AllocStage stage);
+};
+
+/**
+ * Count the allocations of the calling thread against a stage until
+ * the object goes out of scope, when the previous stage is restored
+ */
+class AllocScope {
+	public:
+		AllocScope(AllocStage stage) : m_previous(AllocProfiler::setStage(stage)) {};
+		~AllocScope() { AllocProfiler::setStage(m_previous); };
+	private:
+		AllocStage	m_previous;
+};
+
+#define ALLOC_CONCAT_(a, b)	a##b
+#define ALLOC_CONCAT(a, b)	ALLOC_CONCAT_(a, b)
+#ifdef FLEDGE_ALLOC_PROFILING
+#define ALLOC_SCOPE(stage)		AllocScope ALLOC_CONCAT(allocScope_, __LINE__)(stage)
+#define ALLOC_READINGS(stage, count)	AllocProfiler::readings(stage, count)
+#else
+#define ALLOC_SCOPE(stage)
+#define ALLOC_READINGS(stage, count)
+#endif
+
+#endif
@@ -13,13 +13,17 @@
 #include <vector>
 #include <sstream>
 #include <unordered_set>
+#include <mutex>
+#include <deque>
+#include <future>
 #include <management_client.h>
 
 /**
  * The AssetTrackingTuple class is used to represent an asset
  * tracking tuple. Hash function and '==' operator are defined for
  * this class and pointer to this class that would be required
- * to create an unordered_set of this class.
+ * to create an unordered_set of this class. The hash is calculated
+ * once when the tuple is created.
  */
 class AssetTrackingTuple {
 
@@ -28,6 +32,7 @@ public:
 	std::string 		m_pluginName;
 	std::string 		m_assetName;
 	std::string 		m_eventName;
+	size_t			m_hash;
 
 	std::string assetToString()
 	{
@@ -38,14 +43,30 @@ public:
 
 	inline bool operator==(const AssetTrackingTuple& x) const
 	{
-		return ( x.m_serviceName==m_serviceName && x.m_pluginName==m_pluginName && x.m_assetName==m_assetName && x.m_eventName==m_eventName);
+		return ( x.m_hash==m_hash && x.m_serviceName==m_serviceName && x.m_pluginName==m_pluginName && x.m_assetName==m_assetName && x.m_eventName==m_eventName);
 	}
 
 	AssetTrackingTuple(const std::string& service, const std::string& plugin, 
 								 const std::string& asset, const std::string& event) :
 									m_serviceName(service), m_pluginName(plugin), 
-									m_assetName(asset), m_eventName(event)
+									m_assetName(asset), m_eventName(event),
+									m_hash(hashOf(service, plugin, asset, event))
 	{}
+
+	/**
+	 * Combine the hashes of the four names of a tuple without
+	 * concatenating them
+	 */
+	static size_t hashOf(const std::string& service, const std::string& plugin,
+				const std::string& asset, const std::string& event)
+	{
+		std::hash<std::string> hasher;
+		size_t h = hasher(service);
+		h ^= hasher(plugin) + 0x9e3779b9 + (h << 6) + (h >> 2);
+		h ^= hasher(asset) + 0x9e3779b9 + (h << 6) + (h >> 2);
+		h ^= hasher(event) + 0x9e3779b9 + (h << 6) + (h >> 2);
+		return h;
+	}
 };
 
 struct AssetTrackingTuplePtrEqual {
@@ -61,7 +82,7 @@ namespace std
     {
         size_t operator()(const AssetTrackingTuple& t) const
         {
-            return (std::hash<std::string>()(t.m_serviceName + t.m_pluginName + t.m_assetName + t.m_eventName));
+            return t.m_hash;
         }
     };
 
@@ -70,7 +91,7 @@ namespace std
     {
         size_t operator()(AssetTrackingTuple* t) const
         {
-            return (std::hash<std::string>()(t->m_serviceName + t->m_pluginName + t->m_assetName + t->m_eventName));
+            return t->m_hash;
         }
     };
 }
@@ -80,18 +101,26 @@ class ManagementClient;
 /**
  * The AssetTracker class provides the asset tracking functionality.
  * There are methods to populate asset tracking cache from asset_tracker DB table,
- * and methods to check/add asset tracking tuples to DB and to cache
+ * and methods to check/add asset tracking tuples to DB and to cache.
+ *
+ * New tuples are added to the cache immediately and are sent to the core
+ * in a single request when flush is called, rather than with a request
+ * for each tuple. The request is made by the asynchronous request thread
+ * of the management client, so that flush does not wait for the core,
+ * and its result is collected by a later call to flush.
  */
 class AssetTracker {
 
 public:
 	AssetTracker(ManagementClient *mgtClient, std::string service);
-	~AssetTracker() {}
+	~AssetTracker();
 	static AssetTracker *getAssetTracker();
 	void	populateAssetTrackingCache(std::string plugin, std::string event);
+	void	populateAssetTrackingCache(std::vector<AssetTrackingTuple *>& tuples);
 	bool	checkAssetTrackingCache(AssetTrackingTuple& tuple);
 	void	addAssetTrackingTuple(AssetTrackingTuple& tuple);
 	void	addAssetTrackingTuple(std::string plugin, std::string asset, std::string event);
+	void	flush(bool wait = false);
 	std::string
 		getIngestService(const std::string& asset)
 		{
@@ -112,6 +141,11 @@ private:
 	ManagementClient	*m_mgtClient;
 	std::string		m_service;
 	std::unordered_set<AssetTrackingTuple*, std::hash<AssetTrackingTuple*>, AssetTrackingTuplePtrEqual>	assetTrackerTuplesCache;
+	std::vector<AssetTrackingTuple *>	m_pending;	// Tuples in the cache not yet sent to the core
+	std::deque<std::pair<std::future<bool>, std::vector<AssetTrackingTuple *> > >
+				m_sending;	// Requests to the core not yet completed
+	std::mutex		m_mutex;
+	bool			m_populated;	// The cache has been populated from the core
 };
 
 #endif
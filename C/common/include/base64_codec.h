@@ -0,0 +1,37 @@
+#ifndef _BASE64_CODEC_H_
+#define _BASE64_CODEC_H_
+/*
+ * Fledge Base64 encoding and decoding of binary data
+ *
+ * Copyright (c) 2026 Dianomic Systems
+ *
+ * Released under the Apache 2.0 Licence
+ *
+ * Author: agent
+ */
+#include <string>
+#include <cstddef>
+
+/**
+ * Base64 encoding and decoding of the data of images and data buffers.
+ *
+ * The bulk of the data is encoded and decoded with AVX2 or SSE4.1
+ * instructions when the processor supports them, the choice is made
+ * at run time when the functions are first called. Other processors,
+ * and the final bytes of the data, use a table driven implementation.
+ */
+
+/**
+ * Return the number of characters the encoding of length bytes occupies
+ */
+inline size_t base64EncodedLength(size_t length)
+{
+	return 4 * ((length + 2) / 3);
+}
+
+extern void		base64Encode(const void *data, size_t length, char *out);
+extern void		base64Append(std::string& out, const void *data, size_t length);
+extern size_t		base64DecodedLength(const char *encoded, size_t length);
+extern bool		base64Decode(const char *encoded, size_t length, void *data);
+extern const char	*base64Implementation();
+#endif
@@ -12,7 +12,7 @@
 #include <databuffer.h>
 #include <string>
 #include <stdexcept>
-#include <base64.h>
+#include <base64_codec.h>
 
 /**
  * The Base64DataBuffer class provide functionality on top of the
@@ -23,6 +23,10 @@ class Base64DataBuffer : public DataBuffer {
 
 	public:
 		Base64DataBuffer(const std::string& encoded);
+		Base64DataBuffer(const char *encoded, size_t length);
   		std::string 		encode();
+		void			appendEncoded(std::string& out) const;
+	private:
+		void			decode(const char *encoded, size_t length);
 };
 #endif
@@ -12,7 +12,7 @@
 #include <dpimage.h>
 #include <string>
 #include <stdexcept>
-#include <base64.h>
+#include <base64_codec.h>
 
 /**
  * The Base64DPImage provide functionality on top of the 
@@ -22,6 +22,10 @@
 class Base64DPImage : public DPImage {
 	public:
 		Base64DPImage(const std::string& encoded);
+		Base64DPImage(const char *encoded, size_t length);
   		std::string 		encode();
+		void			appendEncoded(std::string& out) const;
+	private:
+		void			decode(const char *encoded, size_t length);
 };
 #endif
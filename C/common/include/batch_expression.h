@@ -0,0 +1,82 @@
+#ifndef _BATCH_EXPRESSION_H
+#define _BATCH_EXPRESSION_H
+/*
+ * Fledge evaluation of an expression over batches of values
+ *
+ * Copyright (c) 2026 Dianomic Systems
+ *
+ * Released under the Apache 2.0 Licence
+ *
+ * Author: agent
+ */
+#include <string>
+#include <vector>
+#include <columnar_reading_set.h>
+
+#define BATCH_EXPRESSION_BLOCK	256	// Rows evaluated by each pass of the program
+
+class ExprtkExpression;
+
+/**
+ * An expression compiled once and then evaluated over columns of values,
+ * for example the columns of the datapoints of an asset, rather than a
+ * reading at a time.
+ *
+ * Expressions that only use the variables, numeric constants, the
+ * arithmetic operators + - * / and parentheses are compiled into a
+ * program that applies each operator to a block of rows at a time in
+ * a loop over contiguous doubles, which the compiler vectorises. Any
+ * other expression is evaluated row by row by exprtk.
+ */
+class BatchExpression {
+	public:
+		BatchExpression(const std::string& expression,
+				const std::vector<std::string>& variables);
+		~BatchExpression();
+		bool		isVectorised() const { return m_exprtk == NULL; };
+		const std::vector<std::string>&
+				getVariables() const { return m_variables; };
+		void		evaluate(const std::vector<const double *>& columns,
+					 size_t rows, double *results);
+		bool		evaluate(AssetColumns& asset, std::vector<double>& results);
+	private:
+		typedef enum {
+			OP_VARIABLE, OP_CONSTANT, OP_ADD, OP_SUBTRACT,
+			OP_MULTIPLY, OP_DIVIDE, OP_NEGATE
+		} OpCode;
+		class Instruction {
+			public:
+				Instruction(OpCode op, int variable = 0, double constant = 0.0) :
+					m_op(op), m_variable(variable), m_constant(constant) {};
+				OpCode	m_op;
+				int	m_variable;
+				double	m_constant;
+		};
+		class Token {
+			public:
+				typedef enum { NUMBER, IDENTIFIER, OPERATOR, END } Type;
+				Type		m_type;
+				std::string	m_text;
+				double		m_number;
+		};
+	private:
+		BatchExpression(const BatchExpression&);
+		BatchExpression&	operator=(const BatchExpression&);
+		bool		compile(const std::string& expression);
+		bool		tokenise(const std::string& expression);
+		bool		parseSum(size_t& pos, int& depth);
+		bool		parseProduct(size_t& pos, int& depth);
+		bool		parseUnary(size_t& pos, int& depth);
+		bool		parsePrimary(size_t& pos, int& depth);
+		void		emit(const Instruction& instruction, int& depth);
+		void		run(const std::vector<const double *>& columns,
+				    size_t offset, size_t rows, double *results);
+	private:
+		std::vector<std::string>	m_variables;
+		std::vector<Token>		m_tokens;
+		std::vector<Instruction>	m_program;
+		int				m_maxDepth;
+		std::vector<double>		m_stack;	// m_maxDepth blocks of rows
+		ExprtkExpression		*m_exprtk;
+};
+#endif
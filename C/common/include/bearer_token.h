@@ -36,6 +36,7 @@ class BearerToken
 				token() { return m_bearer_token; };
 		bool		verify(const std::string& serverResponse);
 		unsigned long	getExpiration() { return m_expiration; };
+		unsigned long	getClaimedExpiration() const;
 		// Return string references
 		const std::string&
 				getAudience() { return m_audience; };
@@ -0,0 +1,54 @@
+#ifndef _COLUMN_KERNELS_H
+#define _COLUMN_KERNELS_H
+/*
+ * Fledge numeric operations on columns of datapoint values
+ *
+ * Copyright (c) 2026 Dianomic Systems
+ *
+ * Released under the Apache 2.0 Licence
+ *
+ * Author: agent
+ */
+#include <columnar_reading_set.h>
+#include <vector>
+
+/**
+ * The state of a deadband or rate of change operation carried from one
+ * block of readings to the next
+ */
+class ColumnState {
+	public:
+		ColumnState() : m_valid(false), m_value(0.0), m_time(0.0) {};
+		bool		m_valid;	// False until the first value is seen
+		double		m_value;	// The last value passed on
+		double		m_time;		// The user timestamp of the last value
+};
+
+/**
+ * Numeric operations applied to a column of values rather than to each
+ * datapoint of each reading in turn. The operations on contiguous
+ * arrays of doubles are written as simple loops the compiler vectorises,
+ * the operations on the columns of a ColumnarReadingSet apply these to
+ * floating point columns and skip the rows that do not have the
+ * datapoint.
+ */
+class ColumnKernels {
+	public:
+		// Operations on contiguous values
+		static void	scaleOffset(double *values, size_t count, double scale, double offset);
+		static void	clamp(double *values, size_t count, double minimum, double maximum);
+		static void	rateOfChange(const double *values, const double *times, size_t count,
+					     double *rates, ColumnState& state);
+		static void	deadband(const double *values, size_t count, double band,
+					 std::vector<bool>& pass, ColumnState& state);
+
+		// Operations on the columns of an asset
+		static bool	scaleOffset(ReadingColumn& column, double scale, double offset);
+		static bool	clamp(ReadingColumn& column, double minimum, double maximum);
+		static bool	rateOfChange(AssetColumns& asset, ReadingColumn& column,
+					     std::vector<double>& rates, ColumnState& state);
+		static bool	deadband(ReadingColumn& column, double band,
+					 std::vector<bool>& pass, ColumnState& state);
+		static void	userTimes(AssetColumns& asset, std::vector<double>& times);
+};
+#endif
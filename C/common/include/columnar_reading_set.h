@@ -0,0 +1,126 @@
+#ifndef _COLUMNAR_READING_SET_H
+#define _COLUMNAR_READING_SET_H
+/*
+ * Fledge columnar representation of a set of readings
+ *
+ * Copyright (c) 2026 Dianomic Systems
+ *
+ * Released under the Apache 2.0 Licence
+ *
+ * Author: agent
+ */
+#include <reading_set.h>
+#include <string>
+#include <vector>
+#include <map>
+#include <sys/time.h>
+
+/**
+ * A single column of datapoint values for one asset. The column is
+ * typed by the first value added to it; integer, floating point and
+ * string values are held natively in contiguous storage, any other
+ * type, or a column with mixed types, holds copies of the DatapointValue.
+ *
+ * Not every reading of an asset need contain every datapoint, a
+ * presence flag is held for each row of the column.
+ */
+class ReadingColumn {
+	public:
+		typedef enum { COL_INTEGER, COL_FLOAT, COL_STRING, COL_VALUE } ColumnType;
+
+		ReadingColumn(const std::string& name, DatapointValue::dataTagType type);
+		~ReadingColumn();
+		const std::string&		getName() const { return m_name; };
+		ColumnType			getType() const { return m_type; };
+		size_t				getRows() const { return m_present.size(); };
+		bool				isPresent(size_t row) const { return m_present[row]; };
+		std::vector<long>&		getIntegers() { return m_integers; };
+		std::vector<double>&		getFloats() { return m_floats; };
+		std::vector<std::string>&	getStrings() { return m_strings; };
+		DatapointValue			*getValue(size_t row) const { return m_values[row]; };
+		void				append(const DatapointValue& value);
+		void				appendAbsent();
+		DatapointValue			*toDatapointValue(size_t row) const;
+	private:
+		ReadingColumn(const ReadingColumn&);
+		ReadingColumn&			operator=(const ReadingColumn&);
+		void				convertToValues();
+		std::string			m_name;
+		ColumnType			m_type;
+		std::vector<bool>		m_present;
+		std::vector<long>		m_integers;
+		std::vector<double>		m_floats;
+		std::vector<std::string>	m_strings;
+		std::vector<DatapointValue *>	m_values;
+};
+
+/**
+ * The readings for a single asset held as columns. There is a
+ * column of reading ids, a column of user timestamps, a column of
+ * system timestamps and one column per datapoint name, all with the
+ * same number of rows.
+ */
+class AssetColumns {
+	public:
+		AssetColumns(const std::string& asset) : m_asset(asset), m_rows(0) {};
+		~AssetColumns();
+		const std::string&		getAssetName() const { return m_asset; };
+		size_t				getRows() const { return m_rows; };
+		std::vector<unsigned long>&	getIds() { return m_ids; };
+		std::vector<struct timeval>&	getUserTimestamps() { return m_userTimestamps; };
+		std::vector<struct timeval>&	getTimestamps() { return m_timestamps; };
+		const std::vector<ReadingColumn *>&
+						getColumns() const { return m_columns; };
+		ReadingColumn			*getColumn(const std::string& name) const;
+		size_t				append(Reading *reading);
+		Reading				*toReading(size_t row) const;
+	private:
+		AssetColumns(const AssetColumns&);
+		AssetColumns&			operator=(const AssetColumns&);
+		std::string			m_asset;
+		size_t				m_rows;
+		std::vector<unsigned long>	m_ids;
+		std::vector<struct timeval>	m_userTimestamps;
+		std::vector<struct timeval>	m_timestamps;
+		std::vector<ReadingColumn *>	m_columns;
+		std::map<std::string, ReadingColumn *>
+						m_index;
+};
+
+/**
+ * An optional columnar view of a set of readings that allows filters,
+ * north plugins and storage to process a block of readings one
+ * datapoint at a time rather than one reading at a time.
+ *
+ * The columns are built lazily from the readings the first time they
+ * are accessed and converted back to readings on request. The order of
+ * the readings is preserved across the conversion. The set keeps a copy
+ * of the pointers to the readings, the vector or reading set it is
+ * created from may be released but the readings themselves are not
+ * owned and must remain until the columns have been built.
+ */
+class ColumnarReadingSet {
+	public:
+		ColumnarReadingSet(const std::vector<Reading *>& readings);
+		ColumnarReadingSet(const ReadingSet& readings);
+		~ColumnarReadingSet();
+		size_t				getCount() const { return m_readings.size(); };
+		const std::vector<AssetColumns *>&
+						getAssets();
+		AssetColumns			*getAsset(const std::string& asset);
+		void				toReadings(std::vector<Reading *>& readings);
+		ReadingSet			*toReadingSet();
+	private:
+		ColumnarReadingSet(const ColumnarReadingSet&);
+		ColumnarReadingSet&		operator=(const ColumnarReadingSet&);
+		void				build();
+		std::vector<Reading *>		m_readings;	// Not owned, copied from the source
+		bool				m_built;
+		std::vector<AssetColumns *>	m_assets;
+		std::map<std::string, AssetColumns *>
+						m_index;
+		// The asset and row of each reading in the original order
+		std::vector<std::pair<AssetColumns *, size_t> >
+						m_order;
+};
+#endif
@@ -13,6 +13,8 @@
 
 #include <string>
 #include <vector>
+#include <unordered_map>
+#include <stdint.h>
 #include <rapidjson/document.h>
 #include <json_utils.h>
 
@@ -27,6 +29,7 @@ class ConfigCategoryDescription {
 		std::string	getDescription() const { return m_description; };
 		// JSON string with m_name and m_description
 		std::string 	toJSON() const;
+		void		toJSON(JSONWriter& writer) const;
 	private:
 		const std::string	m_name;
 		const std::string	m_displayName;
@@ -112,6 +115,7 @@ class ConfigCategory {
 		bool				isDeprecated(const std::string& name) const;
 		std::string			toJSON(const bool full=false) const;
 		std::string			itemsToJSON(const bool full=false) const;
+		void				itemsToJSON(JSONWriter& writer, const bool full=false) const;
 		ConfigCategory& 		operator=(ConfigCategory const& rhs);
 		ConfigCategory& 		operator+=(ConfigCategory const& rhs);
 		void				setItemsValueFromDefault();
@@ -124,6 +128,7 @@ class ConfigCategory {
 					FILE_ATTR};
 		std::string			getItemAttribute(const std::string& itemName,
 								 ItemAttribute itemAttribute) const;
+		uint64_t			getVersion() const;
 
 	protected:
 		class CategoryItem {
@@ -138,8 +143,12 @@ class ConfigCategory {
 				CategoryItem(const CategoryItem& rhs);
 				// Return both "value" and "default" items
 				std::string	toJSON(const bool full=false) const;
+				void		toJSON(JSONWriter& writer, const bool full=false) const;
 				// Return only "default" items
 				std::string	defaultToJSON() const;
+				void		defaultToJSON(JSONWriter& writer) const;
+				void		attributesToJSON(JSONWriter& writer, bool displayName) const;
+				void		optionsToJSON(JSONWriter& writer) const;
 
 			public:
 				std::string 	m_name;
@@ -161,7 +170,11 @@ class ConfigCategory {
 				std::string 	m_file;
 				ItemType	m_itemType;
 		};
+		CategoryItem			*findItem(const std::string& name) const;
+		void				indexItems();
 		std::vector<CategoryItem *>	m_items;
+		std::unordered_map<std::string, CategoryItem *>
+						m_index;
 		std::string			m_name;
 		std::string         m_parent_name;
 		std::string			m_description;
@@ -198,6 +211,7 @@ class DefaultConfigCategory : public ConfigCategory
 		~DefaultConfigCategory();
 		std::string	toJSON() const;
 		std::string	itemsToJSON() const;
+		void		itemsToJSON(JSONWriter& writer) const;
 };
 
 class ConfigCategoryChange : public ConfigCategory
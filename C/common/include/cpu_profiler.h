@@ -0,0 +1,72 @@
+#ifndef _CPU_PROFILER_H
+#define _CPU_PROFILER_H
+/*
+ * Fledge sampling CPU profiler.
+ *
+ * Copyright (c) 2026 Dianomic Systems
+ *
+ * Released under the Apache 2.0 Licence
+ *
+ * Author: agent
+ */
+#include <string>
+#include <atomic>
+#include <mutex>
+#include <condition_variable>
+#include <signal.h>
+#include <sys/types.h>
+
+#define PROFILE_MAX_DEPTH		64	// Frames kept of each sampled stack
+#define PROFILE_MAX_SAMPLES		20000	// Samples kept by a profile
+#define PROFILE_DEFAULT_SECONDS		10
+#define PROFILE_MAX_SECONDS		120
+#define PROFILE_DEFAULT_FREQUENCY	99	// Samples per second of CPU time
+#define PROFILE_MAX_FREQUENCY		1000
+
+/**
+ * A sampling CPU profiler of the process it runs in. While a profile
+ * is running the profiling interval timer sends SIGPROF for each
+ * period of CPU time used by the process, the signal is handled by
+ * the thread that was running and the handler records the stack of
+ * that thread. The stacks are returned in the folded format read by
+ * flamegraph.pl and speedscope, one line for each distinct stack with
+ * the frames from the thread name to the innermost function separated
+ * by semicolons, followed by the number of samples.
+ *
+ * The profiler needs no tools on the host, the stacks are unwound with
+ * backtrace and named with dladdr, so functions that are not exported
+ * are named by the module that contains them.
+ */
+class CpuProfiler {
+	public:
+		static CpuProfiler	*getInstance();
+		bool			profile(unsigned int seconds, unsigned int frequency,
+						std::string& folded);
+		void			cancel();
+		bool			isRunning() const { return m_running.load(); };
+	private:
+		CpuProfiler();
+		bool			start(unsigned int frequency, unsigned int capacity);
+		void			stop();
+		void			fold(std::string& folded);
+		static void		sample(int sig, siginfo_t *info, void *context);
+	private:
+		struct Sample {
+			std::atomic<int>	depth;	// Set once the frames are written
+			pid_t			tid;
+			void			*frames[PROFILE_MAX_DEPTH];
+		};
+		std::atomic<bool>	m_running;	// A profile has been requested
+		std::atomic<bool>	m_sampling;	// The signal handler records samples
+		std::atomic<int>	m_inHandler;
+		std::atomic<unsigned int>
+					m_next;
+		Sample			*m_samples;
+		unsigned int		m_capacity;
+		struct sigaction	m_previous;
+		bool			m_cancelled;
+		std::mutex		m_mutex;
+		std::condition_variable	m_cv;
+};
+
+#endif
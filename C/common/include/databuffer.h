@@ -26,15 +26,16 @@ class DataBuffer {
 		/**
 		 * Return the size of each item in the buffer
 		 */
-		size_t		getItemSize() { return m_itemSize; };
+		size_t		getItemSize() const { return m_itemSize; };
 		/**
 		 * Return the number of items in the buffer
 		 */
-		size_t		getItemCount() { return m_len; };
+		size_t		getItemCount() const { return m_len; };
 		/**
 		 * Return a pointer to the raw data in the data buffer
 		 */
 		void		*getData() { return m_data; };
+		const void	*getData() const { return m_data; };
 	protected:
 		DataBuffer()	{};
 		size_t		m_itemSize;
@@ -14,9 +14,15 @@
 #include <iomanip>
 #include <cfloat>
 #include <vector>
+#include <atomic>
 #include <logger.h>
 #include <dpimage.h>
 #include <databuffer.h>
+#include <slab_allocator.h>
+#include <interned_string.h>
+
+#define DPV_INLINE_STRING	15	// Longest string held within the value
+#define DPV_HEAP_STRING		0xff	// The string is held in a std::string
 
 class Datapoint;
 /**
@@ -24,6 +30,12 @@ class Datapoint;
  * The class is simply a tagged union that also contains
  * methods to return the value as a string for encoding
  * in a JSON document.
+ *
+ * Short strings are held within the value rather than allocated.
+ * Images, data buffers and two dimensional arrays are shared by
+ * the copies of a value and only copied when one of the copies
+ * is accessed through a non const method, so that copying a
+ * reading does not copy its images.
  */
 class DatapointValue {
 	public:
@@ -32,8 +44,32 @@ class DatapointValue {
 		 */
 		DatapointValue(const std::string& value)
 		{
-			m_value.str = new std::string(value);
+			setString(value.data(), value.length());
+		};
+		/**
+		 * Construct with a string, taking the content
+		 * of the string rather than copying it
+		 */
+		DatapointValue(std::string&& value)
+		{
 			m_type = T_STRING;
+			if (value.length() <= DPV_INLINE_STRING)
+			{
+				setString(value.data(), value.length());
+			}
+			else
+			{
+				m_value.str = new std::string(std::move(value));
+				m_inlineLength = DPV_HEAP_STRING;
+			}
+		};
+		/**
+		 * Construct with a string that is not null terminated,
+		 * such as part of a buffer received by a plugin
+		 */
+		DatapointValue(const char *value, size_t length)
+		{
+			setString(value, length);
 		};
 		/**
  		 * Construct with an integer value
@@ -59,6 +95,15 @@ class DatapointValue {
 			m_value.a = new std::vector<double>(values);
 			m_type = T_FLOAT_ARRAY;
 		};
+		/**
+		 * Construct with an array of floating point values,
+		 * taking the content of the vector rather than copying it
+		 */
+		DatapointValue(std::vector<double>&& values)
+		{
+			m_value.a = new std::vector<double>(std::move(values));
+			m_type = T_FLOAT_ARRAY;
+		};
 
 		/**
 		 * Construct with an array of Datapoints
@@ -74,7 +119,8 @@ class DatapointValue {
 		 */
 		DatapointValue(const DPImage& value)
 		{
-			m_value.image = new DPImage(value);
+			m_value.shared.image = new DPImage(value);
+			m_value.shared.refs = new std::atomic<unsigned int>(1);
 			m_type = T_IMAGE;
 		}
 
@@ -83,7 +129,8 @@ class DatapointValue {
 		 */
 		DatapointValue(const DataBuffer& value)
 		{
-			m_value.dataBuffer = new DataBuffer(value);
+			m_value.shared.dataBuffer = new DataBuffer(value);
+			m_value.shared.refs = new std::atomic<unsigned int>(1);
 			m_type = T_DATABUFFER;
 		}
 
@@ -93,7 +140,8 @@ class DatapointValue {
 		 */
 		DatapointValue(DPImage *value)
 		{
-			m_value.image = value;
+			m_value.shared.image = value;
+			m_value.shared.refs = new std::atomic<unsigned int>(1);
 			m_type = T_IMAGE;
 		}
 
@@ -102,7 +150,8 @@ class DatapointValue {
 		 */
 		DatapointValue(DataBuffer *value)
 		{
-			m_value.dataBuffer = value;
+			m_value.shared.dataBuffer = value;
+			m_value.shared.refs = new std::atomic<unsigned int>(1);
 			m_type = T_DATABUFFER;
 		}
 
@@ -111,16 +160,8 @@ class DatapointValue {
 		 */
 		DatapointValue(const std::vector< std::vector<double> *>& values)
 		{
-			m_value.a2d = new std::vector< std::vector<double>* >;
-			for (auto row : values)
-			{
-				std::vector<double> *nrow = new std::vector<double>;
-				for (auto& d : *row)
-				{
-					nrow->push_back(d);
-				}
-				m_value.a2d->push_back(nrow);
-			}
+			m_value.shared.a2d = copy2DArray(values);
+			m_value.shared.refs = new std::atomic<unsigned int>(1);
 			m_type = T_2D_FLOAT_ARRAY;
 		};
 
@@ -129,11 +170,27 @@ class DatapointValue {
 		 */
 		DatapointValue(const DatapointValue& obj);
 
+		/**
+		 * Move constructor, the value is taken from obj
+		 * and obj is left as an integer value of zero
+		 */
+		DatapointValue(DatapointValue&& obj) : m_value(obj.m_value), m_type(obj.m_type),
+			m_inlineLength(obj.m_inlineLength)
+		{
+			obj.m_value.i = 0;
+			obj.m_type = T_INTEGER;
+		};
+
 		/**
 		 * Assignment Operator
 		 */
 		DatapointValue& operator=(const DatapointValue& rhs);
 
+		/**
+		 * Move assignment Operator
+		 */
+		DatapointValue& operator=(DatapointValue&& rhs);
+
 		/**
 		 * Destructor
 		 */
@@ -167,7 +224,10 @@ class DatapointValue {
 		 */
 		void setValue(const DPImage& value)
 		{
-			m_value.image = new DPImage(value);
+			DPImage *image = new DPImage(value);
+			deleteNestedDPV();
+			m_value.shared.image = image;
+			m_value.shared.refs = new std::atomic<unsigned int>(1);
 			m_type = T_IMAGE;
 		}
 
@@ -176,10 +236,37 @@ class DatapointValue {
 		 */
 		std::string	toString() const;
 
+		/**
+		 * Append the value to a string as toString returns it
+		 */
+		void		appendJSON(std::string& out) const;
+
 		/**
 		 * Return string value without trailing/leading quotes
 		 */
-		std::string	toStringValue() const { return *m_value.str; };
+		std::string	toStringValue() const { return std::string(getStringData(), getStringLength()); };
+
+		/**
+		 * Return the length of a string value without copying it
+		 */
+		size_t		getStringLength() const
+				{
+					return m_inlineLength == DPV_HEAP_STRING ? m_value.str->length() : m_inlineLength;
+				};
+
+		/**
+		 * Return the characters of a string value, which are
+		 * not null terminated
+		 */
+		const char	*getStringData() const
+				{
+					return m_inlineLength == DPV_HEAP_STRING ? m_value.str->data() : m_value.inl;
+				};
+
+		/**
+		 * Return the approximate memory used by the value
+		 */
+		size_t		getMemorySize() const;
 
 		/**
 		 * Return long value
@@ -237,6 +324,14 @@ class DatapointValue {
 			return m_value.dpa;
 		}
 
+		/**
+		 * Return array of datapoints for reading
+		 */
+		const std::vector<Datapoint*> *getDpVec() const
+		{
+			return m_value.dpa;
+		}
+
 		/**
 		 * Return array of float
 		 */
@@ -246,32 +341,89 @@ class DatapointValue {
 		}
 
 		/**
-		 * Return 2D array of float
+		 * Return array of float for reading
+		 */
+		const std::vector<double> *getDpArr() const
+		{
+			return m_value.a;
+		}
+
+		/**
+		 * Return 2D array of float, the array is copied
+		 * first if it is shared with another value
 		 */
 		std::vector<std::vector<double>* >*& getDp2DArr()
 		{
-			return m_value.a2d;
+			unshare();
+			return m_value.shared.a2d;
+		}
+
+		/**
+		 * Return 2D array of float for reading
+		 */
+		const std::vector<std::vector<double>* > *getDp2DArr() const
+		{
+			return m_value.shared.a2d;
 		}
 
 		/**
-		 * Return the Image
+		 * Return the Image, the image is copied first
+		 * if it is shared with another value
 		 */
 		DPImage *getImage()
 		{
-			return m_value.image;
+			unshare();
+			return m_value.shared.image;
+		}
+
+		/**
+		 * Return the Image for reading
+		 */
+		const DPImage *getImage() const
+		{
+			return m_value.shared.image;
 		}
 
 		/**
-		 * Return the DataBuffer
+		 * Return the DataBuffer, the buffer is copied
+		 * first if it is shared with another value
 		 */
 		DataBuffer *getDataBuffer()
 		{
-			return m_value.dataBuffer;
+			unshare();
+			return m_value.shared.dataBuffer;
+		}
+
+		/**
+		 * Return the DataBuffer for reading
+		 */
+		const DataBuffer *getDataBuffer() const
+		{
+			return m_value.shared.dataBuffer;
 		}
 
 	private:
 		void deleteNestedDPV();
+		void setString(const char *value, size_t length);
+		void releaseShared();
+		void unshare();
+		static std::vector< std::vector<double>* >
+			*copy2DArray(const std::vector< std::vector<double>* >& values);
 		const std::string	escape(const std::string& str) const;
+		/**
+		 * A value shared by copies of the DatapointValue and
+		 * the count of the copies that share it
+		 */
+		struct shared_t {
+			union {
+				DPImage		*image;
+				DataBuffer	*dataBuffer;
+				std::vector< std::vector<double>* >
+						*a2d;
+			};
+			std::atomic<unsigned int>
+					*refs;
+		};
 		union data_t {
 			std::string*		str;
 			long			i;
@@ -279,12 +431,11 @@ class DatapointValue {
 			std::vector<double>*	a;
 			std::vector<Datapoint*>
 						*dpa;
-			DPImage			*image;
-			DataBuffer		*dataBuffer;
-			std::vector< std::vector<double>* >
-						*a2d;
+			shared_t		shared;
+			char			inl[DPV_INLINE_STRING + 1];
 			} m_value;
 		DatapointTag	m_type;
+		unsigned char	m_inlineLength = 0;	// Length of a string in inl or DPV_HEAP_STRING
 };
 
 /**
@@ -300,9 +451,22 @@ class Datapoint {
 		{
 		}
 
+		/**
+		 * Construct with a data point value, taking the
+		 * value rather than copying it
+		 */
+		Datapoint(const std::string& name, DatapointValue&& value) : m_name(name), m_value(std::move(value))
+		{
+		}
+
 		~Datapoint()
 		{
 		}
+
+		static void	*operator new(size_t size);
+		static void	operator delete(void *ptr);
+		static SlabAllocator
+				*getAllocator();
 		/**
 		 * Return asset reading data point as a JSON
 		 * property that can be included within a JSON
@@ -310,16 +474,35 @@ class Datapoint {
 		 */
 		std::string	toJSONProperty()
 		{
-			std::string rval = "\"" + m_name + "\":";
-			rval += m_value.toString();
+			std::string rval;
+			appendJSONProperty(rval);
 
 			return rval;
 		}
 
+		/**
+		 * Append the datapoint to a string as a JSON property
+		 */
+		void		appendJSONProperty(std::string& out) const
+		{
+			out += '"';
+			out += m_name.str();
+			out += "\":";
+			m_value.appendJSON(out);
+		}
+
 		/**
 		 * Return the Datapoint name
 		 */
-		const std::string getName() const
+		const std::string& getName() const
+		{
+			return m_name.str();
+		}
+
+		/**
+		 * Return the interned Datapoint name
+		 */
+		const InternedString& getInternedName() const
 		{
 			return m_name;
 		}
@@ -347,8 +530,16 @@ class Datapoint {
 		{
 			return m_value;
 		}
+
+		/**
+		 * Return the approximate memory used by the datapoint
+		 */
+		size_t getMemorySize() const
+		{
+			return sizeof(Datapoint) - sizeof(DatapointValue) + m_value.getMemorySize();
+		}
 	private:
-		std::string		m_name;
+		InternedString		m_name;
 		DatapointValue		m_value;
 };
 #endif
@@ -10,6 +10,10 @@
  * Author: Mark Riddoch
  */
 
+#include <memory>
+#include <atomic>
+#include <stddef.h>
+
 /**
  * Simple Image class that will be used within data points to store image data.
  *
@@ -17,36 +21,61 @@
  * complex functionality will be supported elsewhere. Images within the class
  * are stored as a simple, single area of memory the size of which is defined
  * by the width, hieght and depth of the image.
+ *
+ * Copies of an image share the memory of the pixels, the pixels are only
+ * copied when the non-const getData is called on an image whose pixels are
+ * shared, i.e. copy on write. Images at least as large as the mmap threshold
+ * have their pixels in anonymous memory mapped pages rather than the heap.
  */
 class DPImage {
 	public:
 		DPImage() : m_width(0), m_height(0), m_depth(0), m_pixels(0), m_byteSize(0) {};
 		DPImage(int width, int height, int depth, void *data);
+		DPImage(int width, int height, int depth);
 		DPImage(const DPImage& rhs);
 		DPImage& operator=(const DPImage& rhs);
 		~DPImage();
 		/**
 		 * Return the height of the image
 		 */
-		int		getHeight() { return m_height; };
+		int		getHeight() const { return m_height; };
 		/**
 		 * Return the width of the image
 		 */
-		int		getWidth() { return m_width; };
+		int		getWidth() const { return m_width; };
 		/**
 		 * Return the depth of the image in bits
 		 */
-		int		getDepth() { return m_depth; };
+		int		getDepth() const { return m_depth; };
+		/**
+		 * Return a pointer to the raw data of the image that may be
+		 * used to modify the pixels in place. The pixels are copied
+		 * first if they are shared with another image.
+		 */
+		void		*getData() { unshare(); return m_pixels; };
 		/**
-		 * Return a pointer to the raw data of the image
+		 * Return a pointer to the raw data of the image, the pixels
+		 * are never copied
 		 */
-		void		*getData() { return m_pixels; };
+		const void	*getData() const { return m_pixels; };
+		/**
+		 * Return if the pixels are shared with another image
+		 */
+		bool		isShared() const { return m_buffer.use_count() > 1; };
+		static void	setMmapThreshold(size_t bytes) { m_mmapThreshold = bytes; };
+	protected:
+		bool		allocate();
+		void		unshare();
 	protected:
 		int		m_width;
 		int		m_height;
 		int		m_depth;
 		void		*m_pixels;
 		int		m_byteSize;
+		std::shared_ptr<void>
+				m_buffer;	// Owns the pixels, shared by the copies of the image
+		static std::atomic<size_t>
+				m_mmapThreshold; // Size from which the pixels are mapped, 0 for never
 };
 
 #endif
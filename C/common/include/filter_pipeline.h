@@ -17,13 +17,36 @@
 #include <reading_set.h>
 #include <filter_plugin.h>
 #include <service_handler.h>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <queue>
+
+#define MAX_FILTER_PARTITIONS	4	// Maximum number of partitions run in parallel
+#define MIN_PARTITION_READINGS	50	// Minimum number of readings in a partition
 
 typedef void (*filterReadingSetFn)(OUTPUT_HANDLE *outHandle, READINGSET* readings);
 
+/**
+ * A contiguous partition of a block of readings passed through the
+ * filter pipeline, with the readings that come out of the pipeline
+ */
+class FilterPartition {
+	public:
+		std::vector<Reading *>	m_input;
+		std::vector<Reading *>	m_output;
+};
+
 /**
  * The FilterPipeline class is used to represent a pipeline of filters 
  * applicable to a task/service. Methods are provided to load filters, 
  * setup filtering pipeline and for pipeline/filters cleanup.
+ *
+ * When every filter of the pipeline is stateless a block of readings
+ * may be split into contiguous partitions that are passed through the
+ * pipeline in parallel by a pool of worker threads. The output of the
+ * partitions is joined in the order of the partitions, so the order of
+ * the readings is preserved.
  */
 class FilterPipeline
 {
@@ -52,9 +75,18 @@ public:
 	// Check FilterPipeline is ready for data ingest
 	bool		isReady() { return m_ready; };
 	bool		hasChanged(const std::string pipeline) const { return m_pipeline != pipeline; }
+	bool		hasPythonFilters();
+	void		getStatistics(std::string& json);
+	// Pass a block of readings through the pipeline in parallel partitions
+	bool		ingestPartitioned(std::vector<Reading *> *readings);
+	static bool	collectPartition(READINGSET *readingSet);
 
 private:
 	PLUGIN_HANDLE	loadFilterPlugin(const std::string& filterName);
+	void		startPartitionWorkers();
+	void		stopPartitionWorkers();
+	void		partitionWorker();
+	void		runPartition(FilterPartition& partition);
 
 protected:
 	ManagementClient*	mgtClient;
@@ -64,9 +96,22 @@ protected:
 				m_filters;
 	std::map<std::string, FilterPlugin *>
 				m_filterCategories;
+	std::map<std::string, uint64_t>
+				m_filterVersions;
 	std::string		m_pipeline;
 	bool		m_ready;
 	ServiceHandler		*m_serviceHandler;
+
+private:
+	std::vector<std::thread>
+				m_workers;
+	std::queue<FilterPartition *>
+				m_partitions;
+	unsigned int		m_outstanding;
+	bool			m_shutdown;
+	std::mutex		m_workMutex;
+	std::condition_variable	m_workCV;
+	std::condition_variable	m_doneCV;
 };
 
 #endif
@@ -15,6 +15,9 @@
 #include <management_client.h>
 #include <plugin_data.h>
 #include <reading_set.h>
+#include <mutex>
+
+#define FILTER_LATENCY_BUCKETS	7	// Decades of microseconds from <10uS to >=1S
 
 // This is a C++ ReadingSet class instance passed through
 typedef ReadingSet READINGSET;
@@ -23,6 +26,31 @@ typedef void OUTPUT_HANDLE;
 // Function pointer called by "plugin_ingest" plugin method
 typedef void (*OUTPUT_STREAM)(OUTPUT_HANDLE *, READINGSET *);
 
+/**
+ * The time a filter takes to process the readings it is passed, the
+ * time the readings it outputs take in the rest of the pipeline is
+ * not included, and the number of readings and datapoints it is passed
+ * and outputs.
+ */
+class FilterStatistics {
+	public:
+		FilterStatistics();
+		void		recordCall(unsigned long usec, size_t readings, size_t datapoints);
+		void		recordOutput(size_t readings, size_t datapoints);
+		void		toJSON(std::string& json);
+		static size_t	countDatapoints(READINGSET *readings);
+	private:
+		std::mutex	m_mutex;
+		unsigned long	m_calls;
+		unsigned long	m_time;		// Total microseconds
+		unsigned long	m_maxTime;
+		unsigned long	m_readingsIn;
+		unsigned long	m_readingsOut;
+		unsigned long	m_datapointsIn;
+		unsigned long	m_datapointsOut;
+		unsigned long	m_latency[FILTER_LATENCY_BUCKETS];
+};
+
 // FilterPlugin class
 class FilterPlugin : public Plugin
 {
@@ -38,7 +66,11 @@ public:
 				     OUTPUT_STREAM outputFunc);
         void			shutdown();
         void			ingest(READINGSET *);
+	bool			hasIngestInplace() { return pluginIngestInplacePtr != NULL; };
+	void			setNext(FilterPlugin *next) { m_next = next; };
+	FilterStatistics&	getStatistics() { return m_statistics; };
 	bool			persistData() { return info->options & SP_PERSIST_DATA; };
+	bool			isStateless() { return info->options & SP_STATELESS; };
 	void			startData(const std::string& pluginData);
 	std::string		shutdownSaveData();
 	void			start();
@@ -52,10 +84,13 @@ private:
         void            (*pluginReconfigurePtr)(PLUGIN_HANDLE, const std::string&);
         void            (*pluginIngestPtr)(PLUGIN_HANDLE,
 					   READINGSET *);
+	void		(*pluginIngestInplacePtr)(PLUGIN_HANDLE,
+						  READINGSET *);
 	std::string	(*pluginShutdownDataPtr)(const PLUGIN_HANDLE);
 	void		(*pluginStartDataPtr)(PLUGIN_HANDLE,
 					      const std::string& pluginData);
 	void		(*pluginStartPtr)(PLUGIN_HANDLE);
+	static void	output(OUTPUT_HANDLE *outHandle, READINGSET *readings);
 
 public:
 	// Persist plugin data
@@ -64,6 +99,11 @@ public:
 private:
 	std::string	m_name;
         PLUGIN_HANDLE   m_instance;
+	OUTPUT_HANDLE	*m_outHandle;
+	OUTPUT_STREAM	m_output;
+	FilterPlugin	*m_next;	// The next filter in the pipeline
+	FilterStatistics
+			m_statistics;
 };
 
 #endif
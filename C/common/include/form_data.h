@@ -17,6 +17,8 @@
 #define CR '\r'
 #define LF '\n'
 
+#define FORM_DATA_PARSE_SIZE	65536	// Content given to the multipart parser at a time
+
 /**
  * This class represents a parsed HTTP form data uploaded
  * to SimpleWeb::Server<SimpleWeb::HTTP
@@ -48,6 +50,7 @@ class FormData {
 		void		getUploadedData(const std::string& field, FieldValue& data);
 		void		getUploadedFile(const std::string& field, FieldValue& data);
 		bool		saveFile(FieldValue& b, const std::string& fileName);
+		bool		saveUploadedFile(const std::string& field, const std::string& fileName);
 
 	private:
 		uint8_t*	skipSeparator(uint8_t *b);
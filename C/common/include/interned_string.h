@@ -0,0 +1,140 @@
+#ifndef _INTERNED_STRING_H
+#define _INTERNED_STRING_H
+/*
+ * Fledge process wide string interning
+ *
+ * Copyright (c) 2026 Dianomic Systems
+ *
+ * Released under the Apache 2.0 Licence
+ *
+ * Author: agent
+ */
+#include <string>
+#include <unordered_map>
+#include <mutex>
+#include <functional>
+#include <stdint.h>
+
+#define STRING_TABLE_MAX	65536	// Strings held in the table before strings are no longer interned
+
+/**
+ * A process wide table of immutable strings. Each distinct string is
+ * stored once and given a unique, non-zero, integer id. Entries are
+ * never removed, the table is intended for the relatively small set of
+ * asset and datapoint names that are repeated in every reading. The
+ * table is bounded, once it is full new strings are not interned so
+ * that names from a source with an unbounded set of names do not grow
+ * it for the life of the process.
+ */
+class StringTable {
+	public:
+		typedef std::pair<const std::string, uint32_t>	Entry;
+
+		static StringTable	*getInstance();
+		const Entry		*intern(const std::string& str);
+		const Entry		*empty() const { return m_empty; };
+		size_t			size();
+		void			setLimit(size_t limit);
+	private:
+		StringTable();
+		const Entry		*m_empty;
+		std::mutex		m_mutex;
+		std::unordered_map<std::string, uint32_t>
+					m_table;
+		size_t			m_limit;
+		bool			m_full;
+};
+
+/**
+ * A reference to a string held in the process wide string table.
+ * Copying and comparing interned strings does not touch the string
+ * data; two interned strings are equal if and only if they refer to
+ * the same table entry.
+ *
+ * A string that could not be interned, because the table is full, is
+ * held in an entry owned by the InternedString with an id of 0. These
+ * are copied and compared as strings.
+ */
+class InternedString {
+	public:
+		InternedString() : m_entry(StringTable::getInstance()->empty()) {};
+		InternedString(const std::string& str) : m_entry(lookup(str)) {};
+		InternedString(const char *str) : m_entry(lookup(std::string(str))) {};
+		InternedString(const InternedString& rhs) : m_entry(share(rhs.m_entry)) {};
+		InternedString(InternedString&& rhs) : m_entry(rhs.m_entry)
+					{
+						rhs.m_entry = StringTable::getInstance()->empty();
+					};
+		~InternedString() { release(); };
+		InternedString&		operator=(const InternedString& rhs)
+					{
+						if (m_entry != rhs.m_entry)
+						{
+							release();
+							m_entry = share(rhs.m_entry);
+						}
+						return *this;
+					};
+		InternedString&		operator=(InternedString&& rhs)
+					{
+						std::swap(m_entry, rhs.m_entry);
+						return *this;
+					};
+		InternedString&		operator=(const std::string& str)
+					{
+						release();
+						m_entry = lookup(str);
+						return *this;
+					};
+		InternedString&		operator=(const char *str)
+					{
+						release();
+						m_entry = lookup(std::string(str));
+						return *this;
+					};
+		const std::string&	str() const { return m_entry->first; };
+		operator const std::string&() const { return m_entry->first; };
+		const char		*c_str() const { return m_entry->first.c_str(); };
+		size_t			length() const { return m_entry->first.length(); };
+		bool			empty() const { return m_entry->first.empty(); };
+		uint32_t		id() const { return m_entry->second; };
+		bool			interned() const { return m_entry->second != 0; };
+		bool			operator==(const InternedString& rhs) const
+					{
+						return m_entry == rhs.m_entry
+							|| (!interned() && !rhs.interned() && m_entry->first == rhs.m_entry->first);
+					};
+		bool			operator!=(const InternedString& rhs) const { return !(*this == rhs); };
+	private:
+		static const StringTable::Entry
+					*lookup(const std::string& str)
+					{
+						const StringTable::Entry *entry = StringTable::getInstance()->intern(str);
+						return entry ? entry : new StringTable::Entry(str, 0);
+					};
+		static const StringTable::Entry
+					*share(const StringTable::Entry *entry)
+					{
+						return entry->second ? entry : new StringTable::Entry(*entry);
+					};
+		void			release()
+					{
+						if (m_entry->second == 0)
+							delete m_entry;
+					};
+		const StringTable::Entry	*m_entry;
+};
+
+namespace std {
+/**
+ * Hash an interned string by its id, a string that is not interned
+ * by its content
+ */
+template<> struct hash<InternedString> {
+	size_t operator()(const InternedString& str) const
+	{
+		return str.interned() ? str.id() : hash<string>()(str.str());
+	}
+};
+}
+#endif
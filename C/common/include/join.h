@@ -28,6 +28,7 @@ class Join {
 		};
 		~Join();
 		const std::string	toJSON() const;
+		bool			isCached() const;
 	private:
 		Join(const Join&);
 		Join&			operator=(Join const&);
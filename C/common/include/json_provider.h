@@ -14,6 +14,7 @@
 class JSONProvider
 {
 	public:
+		virtual ~JSONProvider() {};
 		virtual void	asJSON(std::string &) const = 0;
 };
 #endif
@@ -9,6 +9,12 @@
  *
  * Author: Stefano Simonelli
  */
+#include <string>
+#include <vector>
+#include <rapidjson/stringbuffer.h>
+#include <rapidjson/writer.h>
+
+#define JSON_WRITER_CAPACITY	1024	// Initial size of the buffer of a JSONWriter
 
 bool JSONStringToVectorString(std::vector<std::string>& vectorString,
                               const std::string& JSONString,
@@ -16,5 +22,41 @@ bool JSONStringToVectorString(std::vector<std::string>& vectorString,
 
 std::string JSONescape(const std::string& subject);
 std::string JSONunescape(const std::string& subject);
+void JSONappendEscaped(std::string& out, const char *str, size_t length);
+
+/**
+ * A writer of JSON text into a single buffer, that may be cleared and
+ * reused for further documents.
+ *
+ * The punctuation of the document is appended as given, so that the
+ * layout of the toJSON methods is kept, and the strings are quoted and
+ * escaped by a RapidJSON Writer. Unlike JSONescape this also escapes
+ * backslashes and control characters.
+ */
+class JSONWriter {
+	public:
+		JSONWriter(size_t capacity = JSON_WRITER_CAPACITY);
+		JSONWriter&	append(const char *text);
+		JSONWriter&	append(const std::string& text);
+		JSONWriter&	append(long value);
+		JSONWriter&	appendString(const char *value, size_t length);
+		JSONWriter&	appendString(const std::string& value)
+				{
+					return appendString(value.c_str(), value.length());
+				};
+		const char	*c_str() const { return m_buffer.GetString(); };
+		size_t		length() const { return m_buffer.GetSize(); };
+		std::string	str() const { return std::string(m_buffer.GetString(), m_buffer.GetSize()); };
+		void		clear() { m_buffer.Clear(); };
+
+	private:
+		JSONWriter(const JSONWriter&) = delete;
+		JSONWriter&	operator=(const JSONWriter&) = delete;
+
+	private:
+		rapidjson::StringBuffer	m_buffer;
+		rapidjson::Writer<rapidjson::StringBuffer>
+					m_writer;
+};
 
 #endif
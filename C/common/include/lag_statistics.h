@@ -0,0 +1,81 @@
+#ifndef _LAG_STATISTICS_H
+#define _LAG_STATISTICS_H
+/*
+ * Fledge statistics of the age of readings in the data path.
+ *
+ * Copyright (c) 2026 Dianomic Systems
+ *
+ * Released under the Apache 2.0 Licence
+ *
+ * Author: agent
+ */
+#include <reading.h>
+#include <interned_string.h>
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <mutex>
+#include <sys/time.h>
+
+#define LAG_BUCKETS	14	// Buckets of the lag histogram, the last is unbounded
+#define LAG_TOP_ASSETS	10	// Assets with the largest lag that are reported
+#define LAG_WINDOW	60	// Seconds of each window of the recent lag
+
+/**
+ * The lag of the readings of an asset within a window
+ */
+struct AssetLag {
+	unsigned long	count;
+	double		sum;		// Milliseconds
+	unsigned long	max;		// Milliseconds
+	unsigned long	last;		// Milliseconds
+};
+
+/**
+ * The statistics of the lag of readings at a point in the data path,
+ * the time in milliseconds from a timestamp of each reading to the
+ * time the reading passed that point.
+ *
+ * A histogram of every reading recorded is kept for export, the counts
+ * of its buckets only increase. The percentiles and the assets with the
+ * largest lag are reported over the recent readings, those recorded in
+ * the current and the previous window, so that a backlog cleared when
+ * a service starts does not hide the current lag.
+ */
+class LagStatistics {
+	public:
+		LagStatistics(unsigned int topAssets = LAG_TOP_ASSETS,
+				unsigned int window = LAG_WINDOW);
+		void		record(std::vector<Reading *>::const_iterator first,
+					std::vector<Reading *>::const_iterator last,
+					bool userTimestamp, const struct timeval& now);
+		void		record(const InternedString& asset, unsigned long lag,
+					time_t now);
+		unsigned long	getCount() const;
+		unsigned long	percentile(double p) const;
+		void		asJSON(std::string& json) const;
+		static const unsigned long
+				bounds[LAG_BUCKETS - 1];	// Upper bound of each bucket in milliseconds
+	private:
+		void		add(const InternedString& asset, unsigned long lag);
+		void		roll(time_t now);
+		unsigned long	windowPercentile(double p) const;
+	private:
+		const unsigned int	m_topAssets;
+		const unsigned int	m_window;
+		mutable std::mutex	m_mutex;
+		unsigned long		m_buckets[LAG_BUCKETS];
+		unsigned long		m_count;
+		double			m_sum;		// Milliseconds
+		time_t			m_windowStart;
+		unsigned long		m_current[LAG_BUCKETS];
+		unsigned long		m_previous[LAG_BUCKETS];
+		unsigned long		m_currentMax;
+		unsigned long		m_previousMax;
+		std::unordered_map<InternedString, AssetLag>
+					m_currentAssets;
+		std::unordered_map<InternedString, AssetLag>
+					m_previousAssets;
+};
+
+#endif
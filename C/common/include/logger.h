@@ -11,6 +11,24 @@
  */
 
 #include <string>
+#include <atomic>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <stdarg.h>
+#include <syslog.h>
+#include <stdint.h>
+#include <time.h>
+
+#define LOGGER_MESSAGE_SIZE	1000	// Longest formatted message, longer messages are truncated
+#define LOGGER_QUEUE_SIZE	1024	// Messages queued for the writer of an asynchronous logger
+#define LOGGER_WRITER_WAIT	100	// Milliseconds between checks of the queue by the writer
+#define LOGGER_RATE_MESSAGES	10	// Messages from one call site allowed in each interval
+#define LOGGER_RATE_INTERVAL	10	// Seconds over which messages are rate limited
+#define LOGGER_RATE_SITES	128	// Call sites tracked by the rate limiter, a power of 2
+#define LOGGER_RATE_FORMAT	120	// Length of the format kept to summarise suppressed messages
+
+template <typename T> class MPSCQueue;
 
 #define PRINT_FUNC	Logger::getLogger()->info("%s:%d", __FUNCTION__, __LINE__);
 
@@ -22,6 +40,23 @@
  * call debug, info, warn etc. using the instance
  * of the class. TO get that instance call the static
  * method getLogger.
+ *
+ * Messages below the minimum level are discarded before they are
+ * formatted. Callers that build expensive arguments for a debug or info
+ * message should test isDebugEnabled or isInfoEnabled first, as the
+ * arguments are evaluated before the level is checked.
+ *
+ * The logger may be made asynchronous, in which case messages are
+ * formatted by the caller and passed through a lock free queue to a
+ * writer thread that sends them to syslog. If the queue is full the
+ * message is written directly. Fatal messages are always written directly.
+ *
+ * Messages other than debug and fatal messages are rate limited by call
+ * site, identified by the format of the message. Once a call site has
+ * logged the permitted number of messages in an interval further
+ * messages are discarded, before they are formatted, and a single
+ * message reporting how many were suppressed is logged when the
+ * interval ends.
  */
 class Logger {
 	public:
@@ -29,17 +64,73 @@ class Logger {
 		~Logger();
 		static Logger *getLogger();
 		void debug(const std::string& msg, ...);
+		void debug(const char *msg, ...);
 		void printLongString(const std::string&);
 		void info(const std::string& msg, ...);
+		void info(const char *msg, ...);
 		void warn(const std::string& msg, ...);
+		void warn(const char *msg, ...);
 		void error(const std::string& msg, ...);
+		void error(const char *msg, ...);
 		void fatal(const std::string& msg, ...);
+		void fatal(const char *msg, ...);
 		void setMinLevel(const std::string& level);
 		std::string& getMinLevel() { return levelString; }
+		bool isEnabled(int priority) const
+		{
+			return priority <= m_minPriority.load(std::memory_order_relaxed);
+		}
+		bool isDebugEnabled() const { return isEnabled(LOG_DEBUG); }
+		bool isInfoEnabled() const { return isEnabled(LOG_INFO); }
+		void setAsynchronous(bool async);
+		bool isAsynchronous() const { return m_async.load(std::memory_order_relaxed); }
+		void setRateLimit(unsigned int messages, unsigned int interval);
+		unsigned long getSuppressed() const { return m_suppressed.load(std::memory_order_relaxed); }
 	private:
-		std::string 	*format(const std::string& msg, va_list ap);
+		/**
+		 * A formatted message waiting for the writer thread
+		 */
+		typedef struct {
+			int	priority;
+			char	text[LOGGER_MESSAGE_SIZE];
+		} Message;
+		/**
+		 * The messages logged by a call site in the current interval
+		 */
+		typedef struct {
+			uint32_t	hash;
+			int		priority;
+			const char	*prefix;
+			time_t		start;
+			unsigned int	count;
+			unsigned int	suppressed;
+			char		format[LOGGER_RATE_FORMAT];
+		} RateSite;
+		void		log(int priority, const char *prefix, const char *msg, va_list ap);
+		bool		rateLimited(int priority, const char *prefix, const char *msg);
+		void		summarise(RateSite& site);
+		void		write(Message& message);
+		void		writer();
 		static Logger   *instance;
 		std::string     levelString;
+		std::atomic<int>
+				m_minPriority;
+		std::atomic<bool>
+				m_async;
+		MPSCQueue<Message>
+				*m_queue;
+		std::thread	*m_writer;
+		bool		m_running;
+		std::mutex	m_writerMutex;
+		std::condition_variable
+				m_writerCV;
+		unsigned int	m_rateMessages;
+		unsigned int	m_rateInterval;
+		time_t		m_rateSweep;
+		std::mutex	m_rateMutex;
+		RateSite	m_rateSites[LOGGER_RATE_SITES];
+		std::atomic<unsigned long>
+				m_suppressed;
 };
 
 #endif
@@ -22,13 +22,77 @@
 #include <asset_tracking.h>
 #include <json_utils.h>
 #include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <set>
+#include <deque>
+#include <future>
+#include <functional>
+#include <chrono>
+#include <memory>
 #include <bearer_token.h>
 
+#define BEARER_TOKEN_REVERIFY	60	// Seconds before expiry that a verified token is checked again with the core
+#define MANAGEMENT_CLIENT_POOL	8	// Maximum number of HTTP clients, and connections, to the core
+#define AUDIT_BATCH_SIZE	100	// Maximum number of buffered audit entries sent with a single request
+#define AUDIT_FLUSH_INTERVAL	500	// Maximum milliseconds an audit entry is buffered before it is sent
+#define SERVICE_CACHE_TTL	60	// Seconds a service record returned by the core is reused
+
 using HttpClient = SimpleWeb::Client<SimpleWeb::HTTP>;
 using HttpServer = SimpleWeb::Server<SimpleWeb::HTTP>;
 using namespace rapidjson;
 
 class AssetTrackingTuple;
+class ManagementClient;
+
+/**
+ * A HTTP client taken from the pool of a management client for a
+ * request to the core. The client, and the connection it keeps alive,
+ * is returned to the pool when the lease is destroyed, normally at
+ * the end of the statement that makes the request.
+ */
+class HttpClientLease {
+	public:
+		HttpClientLease(ManagementClient *owner, HttpClient *client) :
+					m_owner(owner), m_client(client) {};
+		HttpClientLease(HttpClientLease&& rhs) :
+					m_owner(rhs.m_owner), m_client(rhs.m_client)
+		{
+			rhs.m_client = NULL;
+		};
+		~HttpClientLease();
+		HttpClient		*operator->() const { return m_client; };
+	private:
+		HttpClientLease(const HttpClientLease&) = delete;
+		HttpClientLease&	operator=(const HttpClientLease&) = delete;
+		ManagementClient	*m_owner;
+		HttpClient		*m_client;
+};
+
+/**
+ * The configuration categories, storage service record and asset tracking
+ * tuples that a service fetches from the core as it starts, returned by
+ * a single call to the bootstrap entry point of the core.
+ */
+class ServiceBootstrap {
+	public:
+		ServiceBootstrap() : m_storage("Fledge Storage"), m_hasStorage(false) {};
+		~ServiceBootstrap();
+		bool			getCategory(const std::string& name, ConfigCategory& category) const;
+		bool			getStorage(ServiceRecord& storage) const;
+		std::vector<AssetTrackingTuple *>&
+					getAssetTrackingTuples() { return m_tuples; };
+	private:
+		ServiceBootstrap(const ServiceBootstrap&);
+		ServiceBootstrap&	operator=(const ServiceBootstrap&);
+		friend class ManagementClient;
+		std::map<std::string, ConfigCategory>
+					m_categories;
+		ServiceRecord		m_storage;
+		bool			m_hasStorage;
+		std::vector<AssetTrackingTuple *>
+					m_tuples;	// Tuples not yet taken by the asset tracker
+};
 
 /**
  * The management client class used by services and tasks to communicate
@@ -44,6 +108,11 @@ class ManagementClient {
 		bool 			registerService(const ServiceRecord& service);
 		bool 			unregisterService();
 		bool 			getService(ServiceRecord& service);
+		void			invalidateService(const std::string& name);
+		void			setServiceCacheTTL(unsigned int ttl);
+		bool			getBootstrap(const std::string& serviceName,
+						const std::vector<std::string>& categories,
+						ServiceBootstrap& bootstrap);
 		bool			getServices(std::vector<ServiceRecord *>& services);
 		bool			getServices(std::vector<ServiceRecord *>& services, const std::string& type);
 		bool 			registerCategory(const std::string& categoryName);
@@ -51,6 +120,8 @@ class ManagementClient {
 		bool 			unregisterCategory(const std::string& categoryName);
 		ConfigCategories	getCategories();
 		ConfigCategory		getCategory(const std::string& categoryName);
+		std::future<ConfigCategory>
+					getCategoryAsync(const std::string& categoryName);
                 std::string             setCategoryItemValue(const std::string& categoryName,
                                                              const std::string& itemName,
                                                              const std::string& itemValue);
@@ -62,11 +133,17 @@ class ManagementClient {
 					   const std::string& plugin, 
 					   const std::string& asset, 
 					   const std::string& event);
+		bool			addAssetTrackingTuples(const std::vector<AssetTrackingTuple *>& tuples);
+		std::future<bool>	addAssetTrackingTuplesAsync(const std::vector<AssetTrackingTuple *>& tuples);
 		ConfigCategories	getChildCategories(const std::string& categoryName);
-		HttpClient		*getHttpClient();
+		HttpClientLease		getHttpClient();
 		bool			addAuditEntry(const std::string& serviceName,
 						      const std::string& severity,
 						      const std::string& details);
+		std::future<bool>	addAuditEntryAsync(const std::string& serviceName,
+						      const std::string& severity,
+						      const std::string& details);
+		void			setAuditBatching(unsigned int size, unsigned int interval);
 		std::string&		getRegistrationBearerToken()
 		{
 					std::lock_guard<std::mutex> guard(m_bearer_token_mtx);
@@ -93,9 +170,42 @@ class ManagementClient {
 		bool			deleteProxy(const std::string& serviceName);
 
 	private:
+		friend class HttpClientLease;
+		void			releaseHttpClient(HttpClient *client);
+		void			queueRequest(std::function<void ()> request);
+		void			asyncRequests();
+		bool			postAssetTrackingTuples(const std::string& payload);
+		void			startAsyncThread();
+		/**
+		 * An audit entry buffered to be sent in a batch and
+		 * the promise of whether it was added
+		 */
+		class AuditEntry {
+			public:
+				std::string				payload;
+				std::shared_ptr<std::promise<bool> >	result;
+		};
+		void			postAuditEntries(std::vector<AuditEntry>& entries);
+		/**
+		 * The location of a service returned by the core and
+		 * when it should be fetched again
+		 */
+		class CachedService {
+			public:
+				std::string				address;
+				unsigned short				port;
+				std::string				protocol;
+				unsigned short				managementPort;
+				std::chrono::steady_clock::time_point	expires;
+		};
+		bool			verifyTokenWithCore(BearerToken& bearerToken);
+		void			reverifyToken(const std::string& token);
+
 		std::ostringstream 			m_urlbase;
-		std::map<std::thread::id, HttpClient *> m_client_map;
-		HttpClient				*m_client;
+		// Pool of HTTP clients not in use and the number created
+		std::vector<HttpClient *>		m_idle_clients;
+		unsigned int				m_clients;
+		std::condition_variable			m_client_cv;
 		std::string				*m_uuid;
 		Logger					*m_logger;
 		std::map<std::string, std::string>	m_categories;
@@ -106,10 +216,27 @@ class ManagementClient {
 		std::map<std::string, BearerToken> 	m_received_tokens;
 		// m_received_tokens lock
 		std::mutex 				m_mtx_rTokens;
-		// m_client_map lock
-		std::mutex				m_mtx_client_map;
+		// HTTP client pool lock
+		std::mutex				m_mtx_clients;
 		// Get and set bearer token mutex
 		std::mutex				m_bearer_token_mtx;
+		// Verified tokens close to expiry that are checked again with the core
+		std::set<std::string>			m_reverified;
+		// Requests made to the core by the asynchronous request thread
+		std::deque<std::function<void ()> >	m_async_queue;
+		std::mutex				m_mtx_async;
+		std::condition_variable			m_async_cv;
+		std::thread				*m_async_thread;
+		bool					m_async_running;
+		// Audit entries waiting to be sent by the asynchronous request thread
+		std::vector<AuditEntry>			m_audit_batch;
+		std::chrono::steady_clock::time_point	m_audit_deadline;
+		unsigned int				m_audit_batch_size;
+		unsigned int				m_audit_interval;
+		// Service records returned by the core, by name or by "type:" and type
+		std::map<std::string, CachedService>	m_service_cache;
+		std::mutex				m_service_cache_mtx;
+		unsigned int				m_service_cache_ttl;
   
 	public:
 		// member template must be here and not in .cpp file
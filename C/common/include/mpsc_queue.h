@@ -0,0 +1,146 @@
+#ifndef _MPSC_QUEUE_H
+#define _MPSC_QUEUE_H
+/*
+ * Fledge bounded multi-producer, single consumer queue
+ *
+ * Copyright (c) 2026 Dianomic Systems
+ *
+ * Released under the Apache 2.0 Licence
+ *
+ * Author: agent
+ */
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+/**
+ * A bounded, lock free queue that allows multiple threads to add
+ * items to the queue whilst a single thread removes them.
+ *
+ * The queue is a ring buffer of cells, each of which carries a sequence
+ * number. Producers claim a cell by advancing the tail with a compare
+ * and swap and publish the item by updating the sequence number of the
+ * cell. The consumer only ever reads cells that have been published.
+ *
+ * When the ring is full push returns false, the caller is expected to
+ * fall back to some other, locked, mechanism rather than wait.
+ */
+template <typename T> class MPSCQueue {
+	public:
+		/**
+		 * Construct the queue
+		 *
+		 * @param capacity	The minimum number of items the queue
+		 *			can hold, rounded up to a power of 2
+		 */
+		MPSCQueue(size_t capacity) : m_head(0), m_tail(0), m_count(0)
+		{
+			size_t size = 2;
+			while (size < capacity)
+				size <<= 1;
+			m_mask = size - 1;
+			m_cells = new Cell[size];
+			for (size_t i = 0; i < size; i++)
+				m_cells[i].m_sequence.store(i, std::memory_order_relaxed);
+		};
+		~MPSCQueue()
+		{
+			delete[] m_cells;
+		};
+
+		/**
+		 * Add an item to the queue. May be called from any thread.
+		 *
+		 * @param item	The item to add
+		 * @param count	Set to the number of items in the queue
+		 *		once this item has been added
+		 * @return bool	False if the queue is full
+		 */
+		bool push(const T& item, size_t& count)
+		{
+			Cell *cell;
+			size_t pos = m_tail.load(std::memory_order_relaxed);
+			for (;;)
+			{
+				cell = &m_cells[pos & m_mask];
+				size_t seq = cell->m_sequence.load(std::memory_order_acquire);
+				intptr_t diff = (intptr_t)seq - (intptr_t)pos;
+				if (diff == 0)
+				{
+					if (m_tail.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+						break;
+				}
+				else if (diff < 0)
+				{
+					return false;
+				}
+				else
+				{
+					pos = m_tail.load(std::memory_order_relaxed);
+				}
+			}
+			cell->m_item = item;
+			cell->m_sequence.store(pos + 1, std::memory_order_release);
+			count = m_count.fetch_add(1, std::memory_order_relaxed) + 1;
+			return true;
+		};
+
+		/**
+		 * Remove the oldest item from the queue. Must only be
+		 * called from the consumer thread.
+		 *
+		 * @param item	The item removed from the queue
+		 * @return bool	False if the queue is empty
+		 */
+		bool pop(T& item)
+		{
+			Cell *cell = &m_cells[m_head & m_mask];
+			size_t seq = cell->m_sequence.load(std::memory_order_acquire);
+			if ((intptr_t)seq - (intptr_t)(m_head + 1) < 0)
+				return false;
+			item = cell->m_item;
+			cell->m_sequence.store(m_head + m_mask + 1, std::memory_order_release);
+			m_head++;
+			m_count.fetch_sub(1, std::memory_order_relaxed);
+			return true;
+		};
+
+		/**
+		 * Return the oldest item in the queue without removing it.
+		 * Must only be called from the consumer thread.
+		 *
+		 * @param item	The oldest item in the queue
+		 * @return bool	False if the queue is empty
+		 */
+		bool peek(T& item)
+		{
+			Cell *cell = &m_cells[m_head & m_mask];
+			size_t seq = cell->m_sequence.load(std::memory_order_acquire);
+			if ((intptr_t)seq - (intptr_t)(m_head + 1) < 0)
+				return false;
+			item = cell->m_item;
+			return true;
+		};
+
+		/**
+		 * Return the approximate number of items in the queue
+		 */
+		size_t size() const
+		{
+			return m_count.load(std::memory_order_relaxed);
+		};
+	private:
+		MPSCQueue(const MPSCQueue&);
+		MPSCQueue&	operator=(const MPSCQueue&);
+		class Cell {
+			public:
+				std::atomic<size_t>	m_sequence;
+				T			m_item;
+		};
+		Cell			*m_cells;
+		size_t			m_mask;
+		size_t			m_head;		// Only accessed by the consumer
+		std::atomic<size_t>	m_tail;
+		std::atomic<size_t>	m_count;
+};
+#endif
@@ -0,0 +1,66 @@
+#ifndef _MULTIPART_PARSER_H
+#define _MULTIPART_PARSER_H
+/*
+ * Fledge utilities functions for handling HTTP form data upload
+ * with multipart data
+ *
+ * Copyright (c) 2026 Dianomic Systems
+ *
+ * Released under the Apache 2.0 Licence
+ *
+ * Author: agent
+ */
+
+#include <string>
+#include <map>
+#include <stdint.h>
+
+#define MULTIPART_MAX_HEADERS	16384	// Largest headers block of a part
+#define MULTIPART_MAX_VALUE	65536	// Largest value kept for a part that is not saved
+
+/**
+ * A parser of multipart/form-data content that is given the content
+ * a piece at a time, as it arrives, rather than as a whole.
+ *
+ * The parts of the fields registered with saveFile are written to their
+ * file as they are parsed, only a boundary length of content is held
+ * back between pieces. The values of the other fields are kept in memory
+ * up to MULTIPART_MAX_VALUE bytes.
+ *
+ * The boundaries are found with a Boyer-Moore-Horspool search, the
+ * content may be binary.
+ */
+class MultipartParser {
+	public:
+		MultipartParser(const std::string& boundary);
+		~MultipartParser();
+		void		saveFile(const std::string& field, const std::string& fileName);
+		bool		parse(const uint8_t *data, size_t size);
+		bool		isComplete() const { return m_state == StateEnd; };
+		bool		hasField(const std::string& field) const;
+		std::string	getValue(const std::string& field) const;
+		std::string	getFilename(const std::string& field) const;
+
+	private:
+		size_t		findDelimiter(size_t from) const;
+		bool		beginPart(const std::string& headers);
+		bool		partData(const uint8_t *data, size_t size);
+		bool		endPart();
+		bool		fail(const char *reason);
+
+	private:
+		enum { StatePreamble, StateBoundary, StateHeaders, StateBody, StateEnd, StateError }
+				m_state;
+		std::string	m_delimiter;	// CRLF and the boundary that ends a part
+		size_t		m_skip[256];	// Boyer-Moore-Horspool shift of each byte
+		std::string	m_pending;	// Content not yet parsed
+		std::string	m_field;	// Name of the field of the current part
+		int		m_fd;		// File the current part is written to, or -1
+		std::map<std::string, std::string>
+				m_files;	// File to save each field to
+		std::map<std::string, std::string>
+				m_values;	// Value of each field not saved to a file
+		std::map<std::string, std::string>
+				m_filenames;	// Filename each field was uploaded with
+};
+#endif
@@ -11,21 +11,51 @@
  */
 
 #include <storage_client.h>
+#include <mutex>
+#include <map>
+#include <chrono>
+
+#define PLUGIN_DATA_FLUSH_INTERVAL	30	// Seconds deferred data is held before it is written
 
 class PluginData
 {
 
 public:
+	/**
+	 * When the data persisted is written to storage
+	 */
+	typedef enum {
+		PersistNow,		// Written before persistPluginData returns
+		PersistDeferred		// Held and written by a later call or by flush
+	} Durability;
+
 	PluginData(StorageClient* client);
-	~PluginData() {};
+	~PluginData();
 	// Load data
 	std::string loadStoredData(const std::string& key);
 	// Store data
 	bool persistPluginData(const std::string& key,
-			       const std::string& data);
+			       const std::string& data,
+			       Durability durability = PersistNow);
+	// Write the deferred data
+	bool flush();
+	void setFlushInterval(unsigned int seconds) { m_flushInterval = seconds; };
+
+private:
+	bool			writeData(const std::string& key,
+					  const std::string& data);
+	bool			flushPending();
 
 private:
 	StorageClient*		m_storage;
+	std::mutex		m_mutex;
+	std::map<std::string, std::string>
+				m_stored;	// The data last written for each key
+	std::map<std::string, std::string>
+				m_pending;	// Deferred data not yet written
+	std::chrono::steady_clock::time_point
+				m_pendingSince;	// When the oldest deferred data was persisted
+	unsigned int		m_flushInterval;
 };
 
 #endif
@@ -0,0 +1,55 @@
+#ifndef _PLUGIN_MANIFEST_H
+#define _PLUGIN_MANIFEST_H
+/*
+ * Fledge plugin manifest
+ *
+ * Copyright (c) 2026 Dianomic Systems
+ *
+ * Released under the Apache 2.0 Licence
+ *
+ * Author: agent
+ */
+#include <string>
+#include <map>
+#include <stdint.h>
+
+#define PLUGIN_MANIFEST_FILE	"/plugin_manifest.json"
+
+/**
+ * A record, persisted between runs, of where each plugin was found
+ * in the plugin directories.
+ *
+ * An entry is only returned whilst the plugin file and the directory
+ * that holds it have the modification times recorded when the entry
+ * was added, an update or a new file in the plugin directory causes
+ * the plugin to be searched for again.
+ */
+class PluginManifest {
+	public:
+		PluginManifest(const std::string& file);
+		~PluginManifest();
+		bool		find(const std::string& type, const std::string& name,
+					std::string& path, int& impl);
+		void		add(const std::string& type, const std::string& name,
+					const std::string& path, int impl);
+	private:
+		class Entry {
+			public:
+				std::string	m_path;
+				int		m_impl;
+				uint64_t	m_modified;
+				uint64_t	m_dirModified;
+		};
+		void		load();
+		void		save();
+		static bool	modified(const std::string& path, uint64_t& time);
+		static std::string
+				directory(const std::string& path);
+	private:
+		const std::string	m_file;
+		bool			m_loaded;
+		std::map<std::string, Entry>
+					m_entries;
+};
+
+#endif
@@ -12,6 +12,7 @@
 
 #include <storage_client.h>
 #include <management_client.h>
+#include <service_record.h>
 #include <string.h>
 
 /**
@@ -25,13 +26,19 @@ class FledgeProcess
 		StorageClient*          getStorageClient() const;
 		ManagementClient*	getManagementClient() const;
 		Logger			*getLogger() const;
-    		std::string	    	getName() const { return m_name; };
+    		const std::string&	getName() const { return m_name; };
 
 	    	time_t			getStartTime() const { return m_stime; };
 
 	protected:
 		std::string getArgValue(const std::string& name) const;
 
+	private:
+		bool			getCachedStorageService(ServiceRecord& storageInfo) const;
+		void			cacheStorageService(ServiceRecord& storageInfo) const;
+		bool			isStorageService(const std::string& address,
+						    unsigned short port) const;
+
 	private:
 		const time_t		m_stime;    // Start time
 		const int		m_argc;
@@ -0,0 +1,54 @@
+#ifndef _PYINTERPRETER_H
+#define _PYINTERPRETER_H
+/*
+ * Fledge Python sub-interpreter.
+ *
+ * Copyright (c) 2026 Dianomic Systems
+ *
+ * Released under the Apache 2.0 Licence
+ *
+ * Author: agent
+ */
+#include <Python.h>
+#include <string>
+#include <vector>
+#include <map>
+#include <mutex>
+#include <thread>
+
+/**
+ * A Python sub-interpreter with its own GIL. Python code run in the
+ * sub-interpreter does not serialise with the Python code of the main
+ * interpreter or of any other sub-interpreter, allowing the Python
+ * plugins of a service to use more than one core.
+ *
+ * Sub-interpreters with their own GIL require Python 3.12 or later, on
+ * earlier versions the constructor throws a runtime_error. Extension
+ * modules that do not support sub-interpreters, numpy amongst them,
+ * can not be imported into the sub-interpreter.
+ *
+ * Each thread that calls into the sub-interpreter is given its own
+ * thread state, acquire() attaches the calling thread to the
+ * sub-interpreter and takes its GIL, release() detaches it again. The
+ * calling thread must not be attached to any other interpreter.
+ */
+class PythonInterpreter {
+	public:
+		PythonInterpreter(const std::vector<std::string>& paths);
+		~PythonInterpreter();
+		void			acquire();
+		void			release();
+		static bool		isSupported();
+		static bool		inSubInterpreter();
+		static PyGILState_STATE	ensureGIL();
+		static void		releaseGIL(PyGILState_STATE state);
+	private:
+		PythonInterpreter(const PythonInterpreter&);
+		PythonInterpreter&	operator=(const PythonInterpreter&);
+		PyInterpreterState	*m_interpreter;
+		std::map<std::thread::id, PyThreadState *>
+					m_threads;
+		std::mutex		m_mutex;
+};
+
+#endif
@@ -10,10 +10,13 @@
  * Author: Mark Riddoch
  */
 #include <Python.h>
+#include <string>
+#include <vector>
 
 class PythonRuntime {
 	public:
 		static PythonRuntime	*getPythonRuntime();
+		static void	preload(const std::vector<std::string>& modules);
 		void 	execute(const std::string& python);
 		PyObject	*call(const std::string& name, const std::string& fmt, ...);
 		PyObject	*call(PyObject *module, const std::string& name, const std::string& fmt, ...);
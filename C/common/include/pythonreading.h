@@ -26,9 +26,10 @@ class PythonReading : public Reading {
 		static bool		doneNumPyImport;
 
 	private:
-		PyObject		*convertDatapoint(Datapoint *dp, bool bytesString = false);
-		DatapointValue		*getDatapointValue(PyObject *object);
-		void 			fixQuoting(std::string& str);
-		int			InitNumPy();
+		friend class PythonReadingSet;
+		static PyObject		*convertDatapoint(Datapoint *dp, bool bytesString = false);
+		static DatapointValue	*getDatapointValue(PyObject *object);
+		static void 		fixQuoting(std::string& str);
+		static int		InitNumPy();
 };
 #endif
@@ -11,17 +11,29 @@
  */
 
 #include <reading_set.h>
+#include <columnar_reading_set.h>
 #include <Python.h>
 
 /**
  * A wrapper class for the ReadingSet class that allows conversion
  * to and from Python objects.
+ *
+ * The readings are passed to Python either as a list of reading
+ * dictionaries or as columns, a dictionary with an entry per asset
+ * that holds numpy arrays of the timestamps and of the values of each
+ * datapoint of the readings of the asset.
  */
 class PythonReadingSet : public ReadingSet {
 	public:
 		PythonReadingSet(PyObject *pySet);
 		PyObject	*toPython(bool changeKeys = false);
+		PyObject	*toPythonColumns();
+		static PythonReadingSet
+				*fromColumns(PyObject *columns);
 	private:
+		PythonReadingSet() {};
 		void setReadingAttr(Reading* newReading, PyObject *readingList, bool fillIfMissing);
+		void appendColumns(const std::string& asset, PyObject *columns);
+		static PyObject	*datapointColumn(ReadingColumn *column);
 };
 #endif
@@ -21,6 +21,13 @@
 
 /**
  * Storage layer query container
+ *
+ * The JSON payload of the query is kept once built and returned again
+ * by later calls, until the query or one of its clauses is modified.
+ * A query that is sent repeatedly, with the values of its where clauses
+ * replaced between sends, keeps the JSON of its other clauses. The
+ * payload is built on demand, hence the same query must not be
+ * serialised by several threads at once.
  */
 class Query {
 	public:
@@ -42,7 +49,8 @@ class Query {
 		void				returns(std::vector<Returns *>);
 		void				distinct();
 		void				join(Join *join);
-		const std::string		toJSON() const;
+		const std::string&		toJSON() const;
+		bool				isCached() const;
 	private:
 		Query(const Query&);		// Disable copy of query
 		Query& 				operator=(Query const&);
@@ -55,6 +63,7 @@ class Query {
 		std::vector<Returns *>		m_returns;
 		bool				m_distinct;
 		Join				*m_join;
+		mutable std::string		m_json;		// The JSON payload, empty once modified
 };
 #endif
 
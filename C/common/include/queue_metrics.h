@@ -0,0 +1,74 @@
+#ifndef _QUEUE_METRICS_H
+#define _QUEUE_METRICS_H
+/*
+ * Fledge metrics of the queues of the data path.
+ *
+ * Copyright (c) 2026 Dianomic Systems
+ *
+ * Released under the Apache 2.0 Licence
+ *
+ * Author: agent
+ */
+#include <string>
+#include <vector>
+#include <mutex>
+#include <atomic>
+#include <chrono>
+
+#define QUEUE_RATE_INTERVAL	1000	// Milliseconds over which the rates of the queues are measured
+
+/**
+ * The metrics of a queue of the data path: the current depth, the
+ * largest depth it has reached and the number of entries added to
+ * and removed from it. The owner of the queue calls enqueue and
+ * dequeue as entries are added and removed, the calls do not lock.
+ *
+ * The metrics of a queue are registered with the process wide
+ * QueueMetricsRegistry for as long as the object exists.
+ */
+class QueueMetrics {
+	public:
+		QueueMetrics(const std::string& name, const std::string& unit);
+		~QueueMetrics();
+		void			enqueue(size_t count = 1);
+		void			dequeue(size_t count = 1);
+		size_t			getDepth() const;
+		size_t			getHighWater() const { return m_highWater.load(std::memory_order_relaxed); };
+		unsigned long		getEnqueued() const { return m_enqueued.load(std::memory_order_relaxed); };
+		unsigned long		getDequeued() const { return m_dequeued.load(std::memory_order_relaxed); };
+		const std::string&	getName() const { return m_name; };
+		const std::string&	getUnit() const { return m_unit; };
+	private:
+		friend class QueueMetricsRegistry;
+		const std::string		m_name;
+		const std::string		m_unit;
+		std::atomic<long>		m_depth;
+		std::atomic<size_t>		m_highWater;
+		std::atomic<unsigned long>	m_enqueued;
+		std::atomic<unsigned long>	m_dequeued;
+		// The rates, only used with the mutex of the registry held
+		std::chrono::steady_clock::time_point
+						m_rateTime;
+		unsigned long			m_rateEnqueued;
+		unsigned long			m_rateDequeued;
+		double				m_enqueueRate;
+		double				m_dequeueRate;
+};
+
+/**
+ * The process wide registry of the metrics of the queues, from which
+ * the management API of the service reports them
+ */
+class QueueMetricsRegistry {
+	public:
+		static QueueMetricsRegistry	*getInstance();
+		void				add(QueueMetrics *queue);
+		void				remove(QueueMetrics *queue);
+		void				asJSON(std::string& json);
+	private:
+		QueueMetricsRegistry() {};
+		std::mutex			m_mutex;
+		std::vector<QueueMetrics *>	m_queues;
+};
+
+#endif
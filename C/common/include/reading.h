@@ -10,6 +10,8 @@
  * Author: Mark Riddoch, Massimiliano Pinto
  */
 #include <datapoint.h>
+#include <slab_allocator.h>
+#include <interned_string.h>
 #include <string>
 #include <ctime>
 #include <vector>
@@ -20,6 +22,10 @@
 #define ISO8601_DATE_TIME_FORMAT      "%Y-%m-%d %H:%M:%S +0000"
 #define DATE_TIME_BUFFER_LEN          52
 
+#define READING_INDEX_THRESHOLD       16	// Datapoints from which lookups by name are indexed
+
+class DatapointIndex;
+
 /**
  * An asset reading represented as a class.
  *
@@ -35,15 +41,25 @@ class Reading {
 		Reading(const std::string& asset, std::vector<Datapoint *> values);
 		Reading(const std::string& asset, std::vector<Datapoint *> values, const std::string& ts);
 		Reading(const Reading& orig);
+		Reading(Reading&& orig);
 
 		~Reading();
+		static void			*operator new(size_t size);
+		static void			operator delete(void *ptr);
+		static SlabAllocator		*getAllocator();
 		void				addDatapoint(Datapoint *value);
 		Datapoint			*removeDatapoint(const std::string& name);
 		Datapoint			*getDatapoint(const std::string& name) const;
 		std::string			toJSON(bool minimal = false) const;
 		std::string			getDatapointsJSON() const;
+		void				appendJSON(std::string& out, bool minimal = false) const;
+		void				appendDatapointsJSON(std::string& out) const;
+		size_t				getMemorySize() const;
+		static size_t			getMemorySize(const std::vector<Reading *>& readings);
 		// Return AssetName
-		const std::string&              getAssetName() const { return m_asset; };
+		const std::string&              getAssetName() const { return m_asset.str(); };
+		// Return the interned AssetName
+		const InternedString&		getInternedAssetName() const { return m_asset; };
 		// Set AssetName
 		void				setAssetName(std::string assetName) { m_asset = assetName; };
 		unsigned int			getDatapointCount() { return m_values.size(); };
@@ -77,12 +93,19 @@ class Reading {
 		Reading&			operator=(Reading const&);
 		void				stringToTimestamp(const std::string& timestamp, struct timeval *ts);
 		const std::string		escape(const std::string& str) const;
+		size_t				findDatapoint(const std::string& name) const;
+		const std::string		formatTimestamp(const struct timeval& tv,
+							readingTimeFormat dateFormat, bool addMS) const;
+		size_t				formatTimestamp(char *buffer, const struct timeval& tv,
+							readingTimeFormat dateFormat, bool addMS) const;
 		unsigned long			m_id;
 		bool				m_has_id;
-		std::string			m_asset;
+		InternedString			m_asset;
 		struct timeval			m_timestamp;
 		struct timeval			m_userTimestamp;
 		std::vector<Datapoint *>	m_values;
+		// Positions of the datapoints by name, built by the first lookup
+		mutable DatapointIndex		*m_index = NULL;
 		// Supported date time formats for 'm_timestamp'
 		static std::vector<std::string>	m_dateTypes;
 };
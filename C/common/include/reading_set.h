@@ -27,8 +27,12 @@ class ReadingSet {
 	public:
 		ReadingSet();
 		ReadingSet(const std::string& json);
+		ReadingSet(char *json, size_t length);
+		ReadingSet(std::istream& json);
 		ReadingSet(const std::vector<Reading *>* readings);
+		ReadingSet(ReadingSet&& other);
 		~ReadingSet();
+		ReadingSet&			operator=(ReadingSet&& other);
 
 		unsigned long			getCount() const { return m_count; };
 		const Reading			*operator[] (const unsigned int idx) {
@@ -54,6 +58,7 @@ class ReadingSet {
 		ReadingSet(const ReadingSet&);
 		ReadingSet&			operator=(ReadingSet const &);
 		std::vector<Reading *>		m_readings;
+		void				setCount();
 		// Id of last Reading element
 		unsigned long			m_last_id;    // Id of the last Reading
 };
@@ -66,14 +71,53 @@ class ReadingSet {
 class JSONReading : public Reading {
 	public:
 		JSONReading(const rapidjson::Value& json);
+		JSONReading(unsigned long id, const std::string& asset,
+				const rapidjson::Value& json,
+				const struct timeval& userTs,
+				const struct timeval& ts);
 
 		// Return the reading id
 		unsigned long	getId() const { return m_id; };
 
 	private:
+		void	addDatapoints(const rapidjson::Value& json);
                 void escapeCharacter(std::string& stringToEvaluate, std::string pattern);
 };
 
+/**
+ * ReadingSetParser class
+ *
+ * Parses the rows of a JSON document of readings incrementally as the
+ * text of the document is supplied. Each row is parsed into a
+ * JSONReading as soon as it is complete, so neither the text of the
+ * whole document nor a parsed document of all the rows is held.
+ * A complete document in a buffer that may be modified is parsed
+ * in place with parseInsitu, without copying the text of the rows.
+ */
+class ReadingSetParser {
+	public:
+		ReadingSetParser(std::vector<Reading *>& readings);
+		void				parse(const char *text, size_t length);
+		void				parseInsitu(char *text, size_t length);
+		void				finish();
+	private:
+		void				scan(const char *text, size_t length, char *insitu);
+		void				row(char *text);
+	private:
+		std::vector<Reading *>&		m_readings;
+		rapidjson::MemoryPoolAllocator<>
+						m_allocator;
+		std::string			m_row;
+		std::string			m_string;
+		std::string			m_key;
+		int				m_depth;
+		bool				m_inString;
+		bool				m_escape;
+		bool				m_inRows;
+		bool				m_inRow;
+		bool				m_hasRows;
+};
+
 class ReadingSetException : public std::exception
 {
 	public:
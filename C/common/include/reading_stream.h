@@ -10,11 +10,113 @@
  * Author: Mark Riddoch
  */
 
+#include <stdint.h>
+#include <sys/time.h>
+
 #define RDS_CONNECTION_MAGIC	0x344f4e4e
+#define RDS_ACK_CONNECTION_MAGIC 0x41434e4e
+#define RDS_ZLIB_CONNECTION_MAGIC 0x5a4c4e4e
 #define	RDS_BLOCK_MAGIC		0x5244424b
 #define	RDS_READING_MAGIC	0x52444947
+#define	RDS_BINARY_READING_MAGIC 0x52444942
 #define RDS_ACK_MAGIC		0x4241434b
 #define RDS_NACK_MAGIC		0x4e41434b
+#define RDS_SUBSCRIBE_MAGIC	0x53554253
+#define RDS_FETCH_READING_MAGIC	0x52444652
+#define RDS_ZLIB_BLOCK_MAGIC	0x5a4c424b
+#define RDS_ZLIB_DICT_MAGIC	0x5a4c4443
+
+/**
+ * Version of the stream protocol supported by the storage service. This is
+ * returned in the stream creation response. Version 1, or no version in the
+ * response, supports JSON payloads only. Version 2 adds the binary
+ * datapoint payload, sent with a reading header of RDS_BINARY_READING_MAGIC.
+ * Version 3 adds acknowledged blocks and version 4 compressed blocks, see below.
+ */
+#define RDS_PROTOCOL_VERSION	4
+#define RDS_BINARY_PROTOCOL_VERSION 2
+#define RDS_ACK_PROTOCOL_VERSION 3
+#define RDS_ZLIB_PROTOCOL_VERSION 4
+
+/**
+ * Acknowledged blocks
+ *
+ * A client that connects to a socket stream with RDS_ACK_CONNECTION_MAGIC
+ * in place of RDS_CONNECTION_MAGIC is sent an RDSAcknowledge for each
+ * block once its readings have been passed to the storage plugin. The
+ * acknowledgement carries the block number and RDS_ACK_MAGIC, or
+ * RDS_NACK_MAGIC if the readings of the block could not be stored. Blocks
+ * are acknowledged in the order they are sent, the client keeps the
+ * readings of each block until it is acknowledged, resends a block that
+ * is rejected and sends the unacknowledged blocks again on a new stream
+ * if the connection is lost.
+ */
+
+/**
+ * Compressed blocks
+ *
+ * A client that connects with RDS_ZLIB_CONNECTION_MAGIC has its blocks
+ * acknowledged as above and sends each block as an RDSCompressedHeader
+ * with RDS_ZLIB_BLOCK_MAGIC followed by length bytes of zlib data. The
+ * data inflates to rawLength bytes that hold the block header and the
+ * readings of the block exactly as they are sent uncompressed, a frame
+ * always holds one whole block. Each block is compressed on its own so
+ * that it can be sent again, but blocks are compressed with a preset
+ * dictionary built by the client from the asset and datapoint names of
+ * the readings. The dictionary is sent, before the first block that uses
+ * it, as an RDSCompressedHeader with RDS_ZLIB_DICT_MAGIC followed by
+ * length bytes of dictionary, rawLength is the adler32 checksum zlib
+ * reports for the dictionary. A new dictionary replaces the previous one
+ * for the blocks that follow it.
+ */
+#define RDS_ZLIB_MAX_DICT	(32 * 1024)	// The largest window of zlib
+#define RDS_ZLIB_MAX_BLOCK	(256 * 1024 * 1024)	// Largest inflated block accepted
+
+typedef struct {
+	uint32_t	magic;
+	uint32_t	length;		// Bytes of data that follow
+	uint32_t	rawLength;	// Inflated length of a block or adler32 of a dictionary
+} RDSCompressedHeader;
+
+/**
+ * Payload formats of a reading within the stream
+ */
+#define RDS_PAYLOAD_JSON	0
+#define RDS_PAYLOAD_BINARY	1
+
+/**
+ * Binary datapoint payload
+ *
+ * The payload starts with an RDSPayloadHeader followed by count datapoints.
+ * Each datapoint is a one byte type tag, a 32 bit name length, the name
+ * without a terminating null and then the value. All values are in host
+ * byte order and are not aligned:
+ *
+ *	RDS_DP_INT64		int64_t
+ *	RDS_DP_DOUBLE		double
+ *	RDS_DP_STRING		uint32_t length, char[length]
+ *	RDS_DP_FLOAT_ARRAY	uint32_t count, double[count]
+ *	RDS_DP_DATABUFFER	uint32_t itemSize, uint32_t count, uint8_t[itemSize * count]
+ *	RDS_DP_JSON		uint32_t length, char[length]
+ *
+ * RDS_DP_JSON carries the JSON representation of values that have no
+ * native binary encoding, i.e. nested dictionaries and lists, images
+ * and two dimensional arrays.
+ */
+#define RDS_PAYLOAD_VERSION	2
+
+#define RDS_DP_INT64		1
+#define RDS_DP_DOUBLE		2
+#define RDS_DP_STRING		3
+#define RDS_DP_FLOAT_ARRAY	4
+#define RDS_DP_DATABUFFER	5
+#define RDS_DP_JSON		6
+
+typedef struct {
+	uint16_t	version;
+	uint16_t	reserved;
+	uint32_t	count;
+} RDSPayloadHeader;
 
 typedef struct {
 	uint32_t	magic;
@@ -39,9 +141,123 @@ typedef struct {
 	uint32_t	block;
 } RDSAcknowledge;
 
+/**
+ * Fetch stream
+ *
+ * The fetch stream is the reverse of the ingest stream, the storage
+ * service pushes blocks of readings to a north service. The stream is
+ * created with a POST to /storage/reading/fetch/stream and connected
+ * with an RDSConnectHeader in the same way as the ingest stream.
+ *
+ * The client then sends an RDSSubscribe giving the id of the first
+ * reading it requires and the number of readings per block. The
+ * storage service sends blocks, each an RDSBlockHeader followed by
+ * count readings. Each reading is an RDSFetchReadingHeader, the asset
+ * code and the JSON object of the reading datapoints, neither of which
+ * is null terminated. The client acknowledges each block it has
+ * consumed with an RDSAcknowledge, at most RDS_FETCH_WINDOW blocks are
+ * sent ahead of the acknowledgements. A further RDSSubscribe may be
+ * sent at any time to move the stream to a new id or block size, the
+ * client discards any readings already in flight that it has seen.
+ *
+ * The stream listens on the address the creation request was received
+ * on, so the storage service of a standby node may follow the readings
+ * of a primary node with the same protocol, see replication.h.
+ */
+#define RDS_FETCH_WINDOW	2
+
+typedef struct {
+	uint32_t	magic;
+	uint32_t	blockSize;
+	uint64_t	id;
+} RDSSubscribe;
+
+typedef struct {
+	uint32_t	magic;
+	uint32_t	assetLength;
+	uint32_t	payloadLength;
+	uint32_t	reserved;
+	uint64_t	id;
+	struct timeval	userTs;
+	struct timeval	ts;
+} RDSFetchReadingHeader;
+
+/**
+ * Shared memory stream
+ *
+ * A client on the same host as the storage service may request a shared
+ * memory transport by posting { "transport" : "shared" } when it creates
+ * the ingest stream. The response then carries the name of an abstract
+ * Unix domain socket in place of a port. The client connects to it and
+ * sends an RDSConnectHeader, the storage service replies with the
+ * descriptors of a memfd that holds the ring and two eventfds, a doorbell
+ * rung by the client when blocks are added and an acknowledgement rung
+ * by the storage service as blocks are consumed. The socket remains
+ * connected so that each side sees the other close.
+ *
+ * The memfd starts with an RDSShmHeader followed by the ring. The client
+ * appends blocks at head and the storage service consumes them from tail,
+ * both are byte counts that only increase, the offset in the ring is the
+ * count modulo the ring size. A block is an RDSShmBlockHeader followed by
+ * count ReadingStream records, each padded to a multiple of 8 bytes, with
+ * the datapoints in the binary payload format. A block never wraps, if it
+ * will not fit before the end of the ring the client writes
+ * RDS_SHM_WRAP_MAGIC, unless fewer than sizeof(RDSShmBlockHeader) bytes
+ * remain, and starts the block at the beginning of the ring. The storage
+ * service passes the records to the storage plugin in place and records
+ * the number of the last block consumed in the acknowledgement, with
+ * RDS_NACK_MAGIC if the block was malformed or its readings could not be
+ * stored. The tail is not moved past a rejected block and no further
+ * blocks are consumed.
+ *
+ * The state of a block is written as RDS_SHM_BLOCK_READY by the client.
+ * The storage service changes it to RDS_SHM_BLOCK_CLAIMED before it passes
+ * any of the readings to the plugin. A client that gives up waiting for
+ * the storage service changes the state of the blocks not yet claimed to
+ * RDS_SHM_BLOCK_WITHDRAWN, so that it may send their readings by other
+ * means, and the storage service stops at the first withdrawn block. Both
+ * sides change the state with an atomic compare and exchange.
+ */
+#define RDS_SHM_MAGIC		0x52445348
+#define RDS_SHM_WRAP_MAGIC	0x52445357
+#define RDS_SHM_VERSION		1
+#define RDS_SHM_SIZE		(16 * 1024 * 1024)	// Bytes in the ring
+#define RDS_SHM_ALIGN(x)	(((x) + 7) & ~((size_t)7))
+
+#define RDS_SHM_BLOCK_READY	0
+#define RDS_SHM_BLOCK_CLAIMED	1
+#define RDS_SHM_BLOCK_WITHDRAWN	2
+
+typedef struct {
+	uint32_t	magic;
+	uint32_t	version;
+	uint64_t	size;		// Bytes in the ring that follows the header
+	uint64_t	head;		// Written by the client
+	uint64_t	tail;		// Written by the storage service
+	RDSAcknowledge	ack;		// Written by the storage service
+} RDSShmHeader;
+
+typedef struct {
+	RDSBlockHeader	block;
+	uint32_t	state;		// Which side owns the block
+	uint64_t	length;		// Bytes of ReadingStream records that follow
+} RDSShmBlockHeader;
+
+/**
+ * A reading as received on the stream by the storage service and passed
+ * to the readingStream entry point of the storage plugin.
+ *
+ * The readings are held in the memory pool of the stream handler and
+ * remain valid, unmodified, until the readingStream call for the block
+ * returns. Plugins may therefore bind the asset code and payload directly
+ * to prepared statements without copying them, provided the statement
+ * has been executed, and the transaction committed if requested, before
+ * returning.
+ */
 typedef struct {
 	uint32_t	assetCodeLength;
 	uint32_t 	payloadLength;
+	uint32_t	payloadFormat;
 	struct timeval	userTs;
 	char		assetCode[1];
 } ReadingStream;
@@ -0,0 +1,41 @@
+#ifndef _READING_STREAM_PAYLOAD_H
+#define _READING_STREAM_PAYLOAD_H
+/*
+ * Fledge storage reading stream binary payload encoding.
+ *
+ * Copyright (c) 2026 Dianomic Systems
+ *
+ * Released under the Apache 2.0 Licence
+ *
+ * Author: agent
+ */
+#include <string>
+#include <vector>
+#include <reading_stream.h>
+
+class Reading;
+class Datapoint;
+
+/**
+ * Encode and decode the binary datapoint payload of the reading
+ * stream protocol. The format is described in reading_stream.h.
+ *
+ * The encoder is used by the storage client to avoid creating the
+ * JSON representation of each reading in the south service. The
+ * decoder is used by the storage plugins to write the JSON that is
+ * stored in the reading column directly from the stream buffer,
+ * without an intermediate DOM. The south service also uses the
+ * encoding for the readings it spills to disk whilst the storage
+ * layer is unavailable and decodes them when they are replayed.
+ */
+class ReadingStreamPayload {
+	public:
+		static void	encode(const Reading& reading, std::string& payload);
+		static bool	toJSON(const char *payload, uint32_t length, std::string& json);
+		static bool	decode(const char *payload, uint32_t length,
+				       std::vector<Datapoint *>& datapoints);
+	private:
+		static void	encodeDatapoint(Datapoint *datapoint, std::string& payload);
+};
+
+#endif
@@ -32,28 +32,28 @@ class ResultSet {
 	public:
 		class ColumnValue {
 			public:
-				ColumnValue(const std::string& value)
+				ColumnValue(const std::string& value) : m_doc(NULL), m_owned(true)
 				{
 					m_value.str = (char *)malloc(value.length() + 1);
 					strncpy(m_value.str, value.c_str(), value.length() + 1);
 					m_type = STRING_COLUMN;
 				};
-				ColumnValue(const int value)
+				ColumnValue(const int value) : m_doc(NULL), m_owned(true)
 				{
 					m_value.ival = value;
 					m_type = INT_COLUMN;
 				};
-				ColumnValue(const long value)
+				ColumnValue(const long value) : m_doc(NULL), m_owned(true)
 				{
 					m_value.ival = value;
 					m_type = INT_COLUMN;
 				};
-				ColumnValue(const double value)
+				ColumnValue(const double value) : m_doc(NULL), m_owned(true)
 				{
 					m_value.fval = value;
 					m_type = NUMBER_COLUMN;
 				};
-				ColumnValue(const rapidjson::Value& value)
+				ColumnValue(const rapidjson::Value& value) : m_owned(true)
 				{
 					m_doc = new rapidjson::Document();
 					rapidjson::Document::AllocatorType& a = m_doc->GetAllocator();
@@ -62,6 +62,8 @@ class ResultSet {
 				};
 				~ColumnValue()
 				{
+					if (!m_owned)
+						return;
 					if (m_type == STRING_COLUMN)
 						free(m_value.str);
 					else if (m_type == JSON_COLUMN)
@@ -76,6 +78,21 @@ class ResultSet {
 				char	*getString() const;
 				const rapidjson::Value *getJSON() const { return m_value.json; };
 			private:
+				friend class ResultSet;
+				/**
+				 * Values that refer to the text and document
+				 * of the result set rather than owning a copy
+				 */
+				ColumnValue(char *value) : m_type(STRING_COLUMN),
+						m_doc(NULL), m_owned(false)
+				{
+					m_value.str = value;
+				};
+				ColumnValue(const rapidjson::Value *value) : m_type(JSON_COLUMN),
+						m_doc(NULL), m_owned(false)
+				{
+					m_value.json = const_cast<rapidjson::Value *>(value);
+				};
 				ColumnValue(const ColumnValue&);
 				ColumnValue&	operator=(ColumnValue const&);
 				ColumnType	m_type;
@@ -86,13 +103,16 @@ class ResultSet {
 					rapidjson::Value	*json;
 					}	m_value;
 				rapidjson::Document *m_doc;
+				bool		m_owned;
 		};
 
 		class Row {
 			public:
-				Row(ResultSet *resultSet) : m_resultSet(resultSet) {};
+				Row(ResultSet *resultSet) : m_resultSet(resultSet), m_owned(true) {};
 				~Row()
 				{
+					if (!m_owned)
+						return;
 					for (auto it = m_values.cbegin();
 							it != m_values.cend(); it++)
 						delete *it;
@@ -111,13 +131,16 @@ class ResultSet {
 			private:
 				Row(const Row&);
 				Row&					operator=(Row const&);
+				friend class ResultSet;
 				std::vector<ResultSet::ColumnValue *>	m_values;
 				const ResultSet				*m_resultSet;
+				bool					m_owned;	// The values are not in the arena of the result set
 		};
 
 		typedef std::vector<Row *>::iterator RowIterator;
 
 		ResultSet(const std::string& json);
+		ResultSet(std::string&& json);
 		~ResultSet();
 		unsigned int			rowCount() const { return m_rowCount; };
 		unsigned int			columnCount() const { return m_columns.size(); };
@@ -147,9 +170,20 @@ class ResultSet {
 		};
 
 
+		void					parse();
+		void					release();
+
 		unsigned int				m_rowCount;
 		std::vector<ResultSet::Column *>	m_columns;
 		std::vector<ResultSet::Row *>		m_rows;
+		// The text of the result is parsed in place, the string and JSON
+		// columns refer to the text and the document rather than copies
+		std::string				m_json;
+		rapidjson::Document			m_doc;
+		// The rows and values are constructed in one block each
+		ResultSet::Row				*m_rowArena;
+		ResultSet::ColumnValue			*m_valueArena;
+		size_t					m_valueCount;
 
 };
 
@@ -29,37 +29,42 @@ class Returns {
 		void		format(const std::string format)
 		{
 			m_format = format;
+			m_json.clear();
 		}
 		void		timezone(const std::string timezone)
 		{
 			m_timezone = timezone;
+			m_json.clear();
 		}
-		std::string	toJSON()
+		bool		isCached() const { return !m_json.empty(); };
+		const std::string&	toJSON() const
 		{
-		std::ostringstream json;
-
+			if (!m_json.empty())
+			{
+				return m_json;
+			}
 			if ((! m_alias.empty()) || (! m_format.empty()) || (! m_timezone.empty()))
 			{
-				json << "{ ";
-				json << "\"column\" : \"" << m_column << "\"";
+				m_json = "{ \"column\" : \"" + m_column + "\"";
 				if (! m_alias.empty())
-					json << ", \"alias\" : \"" << m_alias << "\"";
+					m_json += ", \"alias\" : \"" + m_alias + "\"";
 				if (! m_format.empty())
-					json << ", \"format\" : \"" << m_format << "\"";
+					m_json += ", \"format\" : \"" + m_format + "\"";
 				if (! m_timezone.empty())
-					json << ", \"timezone\" : \"" << m_timezone << "\"";
-				json << " }";
+					m_json += ", \"timezone\" : \"" + m_timezone + "\"";
+				m_json += " }";
 			}
 			else
 			{
-				json << "\"" << m_column << "\"";
+				m_json = "\"" + m_column + "\"";
 			}
-			return json.str();
+			return m_json;
 		}
 	private:
 		const std::string	m_column;
 		const std::string	m_alias;
 		std::string		m_format;
 		std::string		m_timezone;
+		mutable std::string	m_json;		// The JSON payload, empty once modified
 };
 #endif
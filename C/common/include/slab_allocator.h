@@ -0,0 +1,80 @@
+#ifndef _SLAB_ALLOCATOR_H
+#define _SLAB_ALLOCATOR_H
+/*
+ * Fledge slab allocator for fixed size objects
+ *
+ * Copyright (c) 2026 Dianomic Systems
+ *
+ * Released under the Apache 2.0 Licence
+ *
+ * Author: agent
+ */
+#include <cstddef>
+#include <mutex>
+#include <atomic>
+#include <vector>
+
+#define SLAB_OBJECTS	1024	// Number of objects carved from each slab
+
+/**
+ * A simple slab allocator used to allocate the short lived, fixed size
+ * objects, such as readings and datapoints, that are created in large
+ * numbers on the ingest path.
+ *
+ * Memory is taken from the system a slab at a time and carved into
+ * equal size slots. Freed slots are placed on a free list and reused,
+ * so that once the allocator has reached the working size of a batch
+ * of readings no further calls to malloc or free are required.
+ *
+ * Slab allocation is optional and may be enabled or disabled at any
+ * time; every allocation carries a small header that records whether
+ * it came from a slab or the heap, so release always returns the
+ * memory to the right place. Allocations larger than the slot size,
+ * as required for classes derived from the allocating class, always
+ * come from the heap.
+ */
+class SlabAllocator {
+	public:
+		SlabAllocator(size_t objectSize, unsigned int slabObjects = SLAB_OBJECTS);
+		void		*allocate(size_t size);
+		static void	release(void *ptr);
+		void		setEnabled(bool enabled) { m_enabled = enabled; };
+		bool		isEnabled() const { return m_enabled; };
+		size_t		getSlabCount();
+		size_t		getFreeCount();
+	private:
+		/**
+		 * The header that precedes every allocation. It is padded to
+		 * the maximum fundamental alignment so that the object that
+		 * follows it is suitably aligned.
+		 */
+		union Header {
+			SlabAllocator	*owner;
+			std::max_align_t	align;
+		};
+		/**
+		 * A free slot, the link overlays the header of the slot
+		 */
+		struct FreeSlot {
+			FreeSlot	*next;
+		};
+		void		grow();
+		void		free(Header *hdr);
+	private:
+		const size_t		m_slotSize;
+		const unsigned int	m_slabObjects;
+		std::atomic<bool>	m_enabled;
+		std::mutex		m_mutex;
+		FreeSlot		*m_free;
+		size_t			m_freeCount;
+		std::vector<char *>	m_slabs;
+};
+
+/**
+ * Enable or disable the use of the slab allocators for the
+ * Reading and Datapoint classes.
+ *
+ * @param enabled	True if readings should be allocated from slabs
+ */
+extern void setReadingSlabAllocation(bool enabled);
+#endif
@@ -24,17 +24,21 @@ class Sort {
 		Sort(const std::string& column, bool reverse) :
 				m_column(column), m_reverse(reverse) {};
 		~Sort() {};
-		std::string	toJSON()
+		const std::string&	toJSON() const
 		{
-		std::ostringstream json;
-
-			json << "{ \"column\" : \"" << m_column << "\", ";
-			json << "\"direction\" : \"" << (m_reverse ? "desc" : "asc") << "\" }";
-			return json.str();
+			if (m_json.empty())
+			{
+				m_json = "{ \"column\" : \"" + m_column + "\", ";
+				m_json += "\"direction\" : \"";
+				m_json += (m_reverse ? "desc" : "asc");
+				m_json += "\" }";
+			}
+			return m_json;
 		}
 	private:
 		const std::string	m_column;
 		bool			m_reverse;
+		mutable std::string	m_json;
 };
 #endif
 
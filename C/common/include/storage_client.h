@@ -12,6 +12,7 @@
 #include <client_http.hpp>
 #include <reading.h>
 #include <reading_set.h>
+#include <columnar_reading_set.h>
 #include <resultset.h>
 #include <purge_result.h>
 #include <query.h>
@@ -19,28 +20,83 @@
 #include <json_properties.h>
 #include <expression.h>
 #include <logger.h>
+#include <reading_stream.h>
 #include <string>
 #include <vector>
 #include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <future>
+#include <functional>
+#include <deque>
+#include <set>
+#include <sys/uio.h>
 
 using HttpClient = SimpleWeb::Client<SimpleWeb::HTTP>;
 
-#define STREAM_BLK_SIZE 	50	// Readings to send per write call to a stream
 #define STREAM_THRESHOLD	25	// Switch to streamed mode above this number of readings per second
+#define STREAM_WINDOW		8	// Blocks sent on the reading stream ahead of their acknowledgement
+#define STREAM_ACK_WAIT		30000	// Milliseconds to wait for a block of the reading stream to be acknowledged
+#define STREAM_BLOCK_RETRIES	3	// Times a block rejected by the storage service is sent again
+#define STREAM_ZLIB_LEVEL	3	// Compression level of the blocks of the reading stream
+#define STREAM_DICT_BLOCKS	100	// Blocks before the stream dictionary may be rebuilt with new names
 
 // Backup values for repeated storage client exception messages
 #define SC_INITIAL_BACKOFF	100
 #define SC_MAX_BACKOFF		1000
 
+#define FETCH_STREAM_WAIT	250	// Milliseconds to wait for a block on the fetch stream
+#define FETCH_STREAM_RETRY	60	// Seconds before retrying a fetch stream that failed
+
+#define SHARED_STREAM_RETRY	60	// Seconds before retrying a shared memory stream that failed
+#define SHARED_STREAM_WAIT	30000	// Milliseconds to wait for the storage service to consume a block
+
+#define STORAGE_ASYNC_THREADS	4	// Threads that make the asynchronous requests
+
 #define DEFAULT_SCHEMA 	"fledge"
 
 class ManagementClient;
 
+/**
+ * The assets and datapoints of the readings wanted by a readings fetch,
+ * an empty list of assets or datapoints wants them all
+ */
+struct ReadingFetchFilter {
+	std::vector<std::string>	assets;
+	bool				exclude = false;	// Want all the assets other than those listed
+	std::vector<std::string>	datapoints;
+	bool				isEmpty() const { return assets.empty() && datapoints.empty(); };
+};
+
+/**
+ * The readings of a readings export, an empty list of assets exports
+ * them all and an empty start or end leaves the range of time open
+ */
+struct ReadingExportRange {
+	std::vector<std::string>	assets;
+	std::string			start;		// UTC user timestamp of the first readings
+	std::string			end;		// UTC user timestamp, exclusive, of the last readings
+	unsigned long			id = 0;		// The id to resume an export from
+};
+
 /**
  * Client for accessing the storage service
  */
 class StorageClient {
 	public:
+		/**
+		 * The transport used to append blocks of readings. By default the
+		 * shared memory stream is used when the storage service is on the
+		 * same host and the REST API otherwise.
+		 */
+		enum AppendMode { AppendAuto, AppendREST, AppendStream, AppendShared };
+		/**
+		 * The compression of the blocks sent on the reading stream. By
+		 * default blocks are compressed when the storage service is on
+		 * another host and supports compressed blocks.
+		 */
+		enum StreamCompression { CompressAuto, CompressNone, CompressZlib };
+
 		StorageClient(HttpClient *client);
 		StorageClient(const std::string& hostname, const unsigned short port);
 		~StorageClient();
@@ -48,19 +104,23 @@ class StorageClient {
 		ResultSet	*queryTable(const std::string& tablename, const Query& query);
 		ReadingSet	*queryTableToReadings(const std::string& tableName, const Query& query);
 		int 		insertTable(const std::string& schema, const std::string& tableName, const InsertValues& values);
+		int 		insertTable(const std::string& schema, const std::string& tableName, const std::vector<InsertValues>& values);
 		int		updateTable(const std::string& schema, const std::string& tableName, const InsertValues& values, const Where& where);
 		int		updateTable(const std::string& schema, const std::string& tableName, const JSONProperties& json, const Where& where);
 		int		updateTable(const std::string& schema, const std::string& tableName, const InsertValues& values, const JSONProperties& json, const Where& where);
 		int		updateTable(const std::string& schema, const std::string& tableName, const ExpressionValues& values, const Where& where);
 		int		updateTable(const std::string& schema, const std::string& tableName, std::vector<std::pair<ExpressionValues *, Where *>>& updates);
+		int		updateTable(const std::string& schema, const std::string& tableName, std::vector<std::pair<InsertValues *, Where *>>& updates);
 		int		updateTable(const std::string& schema, const std::string& tableName, const InsertValues& values, const ExpressionValues& expressoins, const Where& where);
 		int		deleteTable(const std::string& schema, const std::string& tableName, const Query& query);
 		int 		insertTable(const std::string& tableName, const InsertValues& values);
+		int 		insertTable(const std::string& tableName, const std::vector<InsertValues>& values);
 		int		updateTable(const std::string& tableName, const InsertValues& values, const Where& where);
 		int		updateTable(const std::string& tableName, const JSONProperties& json, const Where& where);
 		int		updateTable(const std::string& tableName, const InsertValues& values, const JSONProperties& json, const Where& where);
 		int		updateTable(const std::string& tableName, const ExpressionValues& values, const Where& where);
 		int		updateTable(const std::string& tableName, std::vector<std::pair<ExpressionValues *, Where *>>& updates);
+		int		updateTable(const std::string& tableName, std::vector<std::pair<InsertValues *, Where *>>& updates);
 		int		updateTable(const std::string& tableName, const InsertValues& values, const ExpressionValues& expressoins, const Where& where);
 		int		deleteTable(const std::string& tableName, const Query& query);
 		bool		readingAppend(Reading& reading);
@@ -68,6 +128,19 @@ class StorageClient {
 		ResultSet	*readingQuery(const Query& query);
 		ReadingSet 	*readingQueryToReadings(const Query& query);
 		ReadingSet	*readingFetch(const unsigned long readingId, const unsigned long count);
+		ReadingSet	*readingFetchStream(const unsigned long readingId, const unsigned long count);
+		ReadingSet	*readingFetch(const unsigned long readingId, const unsigned long count,
+					const ReadingFetchFilter& filter, unsigned long& next);
+		bool		isFetchStreaming() const { return m_fetchStream != -1; };
+		bool		readingExport(const ReadingExportRange& range,
+					std::function<bool (ColumnarReadingSet& batch)> batch);
+		std::future<ReadingSet *>
+				readingFetchAsync(const unsigned long readingId, const unsigned long count);
+		std::future<ResultSet *>
+				queryTableAsync(const std::string& tableName, const Query& query);
+		std::future<int>
+				updateTableAsync(const std::string& tableName,
+						std::vector<std::pair<ExpressionValues *, Where *>>& updates);
 		PurgeResult	readingPurgeByAge(unsigned long age, unsigned long sent, bool purgeUnsent);
 		PurgeResult	readingPurgeBySize(unsigned long size, unsigned long sent, bool purgeUnsent);
 		bool		registerAssetNotification(const std::string& assetName,
@@ -76,7 +149,12 @@ class StorageClient {
 							    const std::string& callbackUrl);
 
 		void		registerManagement(ManagementClient *mgmnt) { m_management = mgmnt; };
+		void		setUnreachable(std::function<void ()> callback) { m_unreachable = callback; };
 		bool 		createSchema(const std::string&);
+		void		setAppendMode(AppendMode mode) { m_appendMode = mode; };
+		AppendMode	getAppendMode() const { return m_appendMode; };
+		void		setStreamCompression(StreamCompression compression)
+					{ m_streamCompression = compression; };
 
 	private:
 		void		handleUnexpectedResponse(const char *operation,
@@ -88,8 +166,33 @@ class StorageClient {
 							const std::string& payload);
 		void		handleException(const std::exception& ex, const char *operation, ...);
 		HttpClient 	*getHttpClient(void);
+		void		queueRequest(std::function<void ()> request);
+		void		asyncRequests();
 		bool		openStream();
 		bool		streamReadings(const std::vector<Reading *> & readings);
+		bool		writeStreamBlock(const std::vector<Reading *> & readings, uint32_t blockNumber);
+		bool		readStreamAcks(bool wait);
+		void		closeStream();
+		bool		replayStreamBlocks();
+		bool		appendUnacknowledged();
+		bool		writeCompressedBlock(const std::vector<Reading *> & readings);
+		bool		sendStreamBlock();
+		bool		waitStreamSent();
+		void		streamSender();
+		bool		trainStreamDictionary(const std::vector<Reading *> & readings);
+		bool		compressStream();
+		int		connectStream(int port, uint32_t token, bool compress = false);
+		bool		openFetchStream();
+		void		closeFetchStream();
+		bool		readFetchStream(void *buffer, size_t length);
+		ReadingSet	*readFetchBlock(const unsigned long readingId);
+		bool		sharedStreamAvailable();
+		bool		openSharedStream();
+		bool		connectSharedStream(const std::string& name, uint32_t token);
+		void		closeSharedStream();
+		bool		streamSharedReadings(const std::vector<Reading *>& readings, size_t& sent);
+		bool		waitShared(uint64_t space);
+		bool		withdrawShared(uint64_t start, uint64_t end);
 
 		std::ostringstream 			m_urlbase;
 		std::string				m_host;
@@ -98,12 +201,69 @@ class StorageClient {
 		Logger					*m_logger;
 		pid_t					m_pid;
 		bool					m_streaming;
+		AppendMode				m_appendMode;
+		int					m_streamProtocol;
 		int					m_stream;
 		uint32_t				m_readingBlock;
+		/**
+		 * A block sent on the reading stream that has not been
+		 * acknowledged, the readings are copies owned by the block
+		 */
+		class StreamBlock {
+			public:
+				uint32_t		number;
+				unsigned int		retries;
+				std::vector<Reading *>	readings;
+		};
+		bool					m_streamAcks;	// The storage service acknowledges blocks
+		std::deque<StreamBlock>			m_unacked;
+		RDSAcknowledge				m_ack;		// Acknowledgement being read
+		size_t					m_ackBytes;
+		StreamCompression			m_streamCompression;
+		bool					m_streamCompress;	// Blocks are sent compressed
+		std::string				m_streamPlain;	// Block being assembled for compression
+		/**
+		 * The blocks of the reading stream are written by a sender
+		 * thread, so that the next block is assembled whilst the
+		 * previous one is written. The buffers are kept between blocks.
+		 */
+		std::string				m_streamFill;	// Block being assembled
+		std::string				m_streamSend;	// Block being written by the sender
+		std::string				m_streamPayload;	// Payload of a reading of the block
+		std::thread				m_streamSenderThread;
+		std::mutex				m_streamMutex;
+		std::condition_variable			m_streamCV;
+		bool					m_streamSending;	// The sender is writing a block
+		bool					m_streamSenderRunning;
+		int					m_streamError;	// The errno of a failed write
+		std::string				m_streamDictionary;
+		std::set<std::string>			m_dictionaryNames;	// Names in the dictionary
+		unsigned int				m_dictionaryAge;	// Blocks since the dictionary was sent
 		std::string				m_lastException;
 		int					m_exRepeat;
 		int					m_backoff;
 		ManagementClient			*m_management;
+		std::function<void ()>			m_unreachable;	// Called when the storage service refuses connections
+		int					m_fetchStream;
+		unsigned long				m_fetchNext;
+		unsigned long				m_fetchBlockSize;
+		time_t					m_fetchRetry;
+		std::string				m_fetchAsset;
+		std::string				m_fetchPayload;
+		std::mutex				m_sharedMutex;
+		int					m_sharedSocket;
+		int					m_sharedDoorbell;
+		int					m_sharedAck;
+		RDSShmHeader				*m_shared;
+		char					*m_sharedRing;
+		uint32_t				m_sharedBlock;
+		time_t					m_sharedRetry;
+		// Requests made by the asynchronous request threads
+		std::deque<std::function<void ()> >	m_async_queue;
+		std::mutex				m_mtx_async;
+		std::condition_variable			m_async_cv;
+		std::vector<std::thread>		m_async_threads;
+		bool					m_async_running;
 };
 
 #endif
@@ -34,6 +34,7 @@ string StringStripWhiteSpacesExtra(const  std::string& original);
 void StringStripQuotes(std::string& StringToManage);
 
 string urlEncode(const string& s);
+void urlEncode(const string& s, string& escaped);
 string urlDecode(const string& s);
 void StringEscapeQuotes(string& s);
 
@@ -26,21 +26,23 @@ class Timebucket {
 			const std::string& format) :
 				m_column(column), m_size(size), m_format(format), m_alias(column) {};
 		~Timebucket() {};
-		std::string	toJSON()
+		const std::string&	toJSON() const
 		{
-		std::ostringstream json;
-
-			json << "{ \"timestamp\" : \"" << m_column << "\", ";
-			json << "\"size\" : \"" << m_size << "\", ";
-			json << "\"format\" : \"" << m_format << "\", ";
-			json << "\"alias\" : \"" << m_alias << "\" }";
-			return json.str();
+			if (m_json.empty())
+			{
+				m_json = "{ \"timestamp\" : \"" + m_column + "\", ";
+				m_json += "\"size\" : \"" + std::to_string(m_size) + "\", ";
+				m_json += "\"format\" : \"" + m_format + "\", ";
+				m_json += "\"alias\" : \"" + m_alias + "\" }";
+			}
+			return m_json;
 		}
 	private:
 		const std::string	m_column;
 		unsigned int		m_size;
 		const std::string	m_format;
 		const std::string	m_alias;
+		mutable std::string	m_json;
 };
 #endif
 
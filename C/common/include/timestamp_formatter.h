@@ -0,0 +1,37 @@
+#ifndef _TIMESTAMP_FORMATTER_H
+#define _TIMESTAMP_FORMATTER_H
+/*
+ * Fledge fixed format timestamp conversion
+ *
+ * Copyright (c) 2026 Dianomic Systems
+ *
+ * Released under the Apache 2.0 Licence
+ *
+ * Author: agent
+ */
+#include <sys/time.h>
+#include <time.h>
+#include <stddef.h>
+
+#define TIMESTAMP_DATE_TIME_LEN		19	// YYYY-MM-DD HH:MM:SS
+#define TIMESTAMP_MICROSECONDS_LEN	7	// .uuuuuu
+
+/**
+ * Conversion of UTC timestamps to and from the fixed ISO-8601 style
+ * formats used for readings, without the use of the C library time
+ * conversion routines. Neither direction depends upon the locale or the
+ * timezone of the process, or allocates memory.
+ *
+ * Each thread caches the date and time of the last second it formatted,
+ * since consecutive readings are usually within the same second.
+ */
+class TimestampFormatter {
+	public:
+		static size_t	formatDateTime(char *buffer, time_t seconds, char separator = ' ');
+		static size_t	formatMicroseconds(char *buffer, long usec);
+		static bool	parse(const char *timestamp, struct timeval *tv);
+	private:
+		static void	civilFromDays(long days, int& year, unsigned int& month, unsigned int& day);
+		static long	daysFromCivil(int year, unsigned int month, unsigned int day);
+};
+#endif
@@ -0,0 +1,132 @@
+#ifndef _TRACER_H
+#define _TRACER_H
+/*
+ * Fledge tracing of the data path.
+ *
+ * Copyright (c) 2026 Dianomic Systems
+ *
+ * Released under the Apache 2.0 Licence
+ *
+ * Author: agent
+ */
+#include <string>
+#include <vector>
+#include <memory>
+#include <mutex>
+#include <atomic>
+#include <stdint.h>
+#include <sys/types.h>
+
+#define TRACE_BUFFER_EVENTS	8192	// Spans kept by the ring buffer of each thread
+
+/**
+ * A span recorded by a thread
+ */
+struct TraceEvent {
+	const char	*category;
+	const char	*name;
+	uint64_t	start;		// Microseconds of the monotonic clock
+	uint64_t	duration;	// Microseconds
+};
+
+/**
+ * The ring buffer of the spans of a thread. Only the owning thread
+ * records spans, the buffer is read while the thread may still be
+ * recording, so the slots are atomic and a reader discards the slots
+ * that were overwritten while it copied them.
+ */
+class TraceBuffer {
+	public:
+		TraceBuffer();
+		void		record(const char *category, const char *name,
+					uint64_t start, uint64_t duration);
+		void		events(std::vector<TraceEvent>& events) const;
+		void		clear() { m_tail = m_head.load(std::memory_order_acquire); };
+		pid_t		getThreadId() const { return m_tid; };
+		const std::string&
+				getThreadName() const { return m_threadName; };
+	private:
+		struct Slot {
+			std::atomic<const char *>	category;
+			std::atomic<const char *>	name;
+			std::atomic<uint64_t>		start;
+			std::atomic<uint64_t>		duration;
+		};
+		Slot			m_slots[TRACE_BUFFER_EVENTS];
+		std::atomic<uint64_t>	m_head;		// Spans recorded by the thread
+		std::atomic<uint64_t>	m_tail;		// Spans before this have been cleared
+		pid_t			m_tid;
+		std::string		m_threadName;
+};
+
+/**
+ * The tracing of the spans of the data path of a process. Each thread
+ * records the spans it completes in a ring buffer of its own, so that
+ * recording a span takes no locks. The buffer of a thread is created
+ * when the thread records its first span after tracing is enabled.
+ *
+ * The spans of all the threads are returned in the Chrome trace event
+ * format, which is read by Perfetto and the Chrome trace viewer. The
+ * timestamps are taken from the monotonic clock, which is shared by
+ * the processes of a host, so the traces of several services may be
+ * loaded together to follow readings from one service to the next.
+ */
+class Tracer {
+	public:
+		static Tracer	*getInstance();
+		static uint64_t	now();
+		void		enable(bool enabled);
+		bool		isEnabled() const
+				{
+					return m_enabled.load(std::memory_order_relaxed);
+				};
+		void		record(const char *category, const char *name,
+					uint64_t start, uint64_t duration);
+		void		clear();
+		void		toChromeTrace(std::string& json, const std::string& process);
+	private:
+		Tracer() : m_enabled(false) {};
+		TraceBuffer	*threadBuffer();
+	private:
+		std::atomic<bool>	m_enabled;
+		std::mutex		m_mutex;
+		std::vector<std::shared_ptr<TraceBuffer>>
+					m_buffers;	// Protected by m_mutex
+};
+
+/**
+ * A span of the data path, the span starts when the object is created
+ * and is recorded when it goes out of scope. Nothing is recorded unless
+ * tracing was enabled when the span started. The category and name
+ * must be string literals, they are kept by pointer.
+ */
+class TraceSpan {
+	public:
+		TraceSpan(const char *category, const char *name) :
+			m_category(category), m_name(name),
+			m_start(Tracer::getInstance()->isEnabled() ? Tracer::now() : 0) {};
+		~TraceSpan()
+		{
+			if (m_start)
+				Tracer::getInstance()->record(m_category, m_name,
+						m_start, Tracer::now() - m_start);
+		};
+	private:
+		const char	*m_category;
+		const char	*m_name;
+		uint64_t	m_start;
+};
+
+/*
+ * The spans of the data path are only built when FLEDGE_TRACING is
+ * defined, otherwise TRACE_SPAN generates no code
+ */
+#define TRACE_CONCAT_(a, b)	a##b
+#define TRACE_CONCAT(a, b)	TRACE_CONCAT_(a, b)
+#ifdef FLEDGE_TRACING
+#define TRACE_SPAN(category, name)	TraceSpan TRACE_CONCAT(traceSpan_, __LINE__)(category, name)
+#else
+#define TRACE_SPAN(category, name)
+#endif
+
+#endif
@@ -24,6 +24,11 @@ typedef enum Conditional {
 
 /**
  * Where clause in a selection of records
+ *
+ * The JSON payload of the clause is built once and kept until the
+ * clause is modified. The value of a condition may be replaced, so that
+ * a query that is sent repeatedly with different values keeps its shape
+ * and only the condition whose value changed is serialised again.
  */
 class Where {
 	public:
@@ -52,16 +57,19 @@ class Where {
 			}
 		};
 		~Where();
-		void		andWhere(Where *condition) { m_and = condition; };
-		void		orWhere(Where *condition) { m_or = condition; };
+		void		andWhere(Where *condition) { m_and = condition; m_json.clear(); };
+		void		orWhere(Where *condition) { m_or = condition; m_json.clear(); };
 		void		addIn(const std::string& value)
 		{
 			if (m_condition == In)
 			{
 				m_in.push_back(value);
+				m_json.clear();
 			}
 		};
-		const std::string	toJSON() const;
+		void		value(const std::string& value);
+		const std::string&	toJSON() const;
+		bool		isCached() const;
 	private:
 		Where(const Where&);
 		Where&			operator=(Where const&);
@@ -72,6 +80,7 @@ class Where {
 		Where			*m_or;
 		std::vector<std::string>
 					m_in;
+		mutable std::string	m_json;		// The JSON payload, empty once modified
 };
 #endif
 
@@ -0,0 +1,107 @@
+/*
+ * Fledge process wide string interning
+ *
+ * Copyright (c) 2026 Dianomic Systems
+ *
+ * Released under the Apache 2.0 Licence
+ *
+ * Author: agent
+ */
+#include <interned_string.h>
+#include <logger.h>
+
+using namespace std;
+
+// Number of entries cached per thread before the cache is reset
+#define THREAD_CACHE_SIZE	1024
+
+/**
+ * Return the singleton string table. The table is never destroyed
+ * since interned strings may be referenced from static objects.
+ */
+StringTable *StringTable::getInstance()
+{
+	static StringTable *instance = new StringTable();
+	return instance;
+}
+
+/**
+ * Construct the string table with the empty string
+ */
+StringTable::StringTable() : m_limit(STRING_TABLE_MAX), m_full(false)
+{
+	auto res = m_table.insert(make_pair(string(""), 1));
+	m_empty = &(*res.first);
+}
+
+/**
+ * Intern a string, returning the table entry for the string.
+ *
+ * Each thread keeps a small cache of the strings it has interned so
+ * that the common case of a repeated name does not require the table
+ * mutex. Entries of an unordered_map are never moved, so pointers to
+ * them remain valid as the table grows.
+ *
+ * @param str	The string to intern
+ * @return Entry*	The table entry for the string or NULL if the string
+ *			is not in the table and the table is full
+ */
+const StringTable::Entry *StringTable::intern(const string& str)
+{
+	static thread_local unordered_map<string, const Entry *> cache;
+
+	auto cached = cache.find(str);
+	if (cached != cache.end())
+	{
+		return cached->second;
+	}
+
+	const Entry *entry;
+	{
+		lock_guard<mutex> guard(m_mutex);
+		auto it = m_table.find(str);
+		if (it == m_table.end())
+		{
+			if (m_table.size() >= m_limit)
+			{
+				if (!m_full)
+				{
+					Logger::getLogger()->warn("The table of %lu asset and datapoint names is full, "
+							"further names will not be interned",
+							(unsigned long)m_table.size());
+					m_full = true;
+				}
+				return NULL;
+			}
+			it = m_table.insert(make_pair(str, (uint32_t)m_table.size() + 1)).first;
+		}
+		entry = &(*it);
+	}
+	if (cache.size() >= THREAD_CACHE_SIZE)
+	{
+		cache.clear();
+	}
+	cache[str] = entry;
+	return entry;
+}
+
+/**
+ * Return the number of strings in the table
+ */
+size_t StringTable::size()
+{
+	lock_guard<mutex> guard(m_mutex);
+	return m_table.size();
+}
+
+/**
+ * Set the maximum number of strings held in the table
+ *
+ * @param limit	The maximum number of strings
+ */
+void StringTable::setLimit(size_t limit)
+{
+	lock_guard<mutex> guard(m_mutex);
+	m_limit = limit;
+	m_full = false;
+}
@@ -40,3 +40,13 @@ bool 		first = true;
 	json << " }";
 	return json.str();
 }
+
+/**
+ * Return if the JSON payload of the query of the join is still held
+ *
+ * @return bool	False if the query has been modified since it was serialised
+ */
+bool Join::isCached() const
+{
+	return m_query->isCached();
+}
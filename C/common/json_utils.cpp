@@ -11,6 +11,7 @@
 #include <iostream>
 #include <string>
 #include <vector>
+#include <string.h>
 #include "json_utils.h"
 #include "rapidjson/document.h"
 
@@ -83,6 +84,46 @@ string escaped = subject;
         }
         return escaped;
 }
+
+/**
+ * Append a string to a JSON document as a property value, adding
+ * a backslash before each double quote that is not already escaped.
+ * This is the escaping used by Reading::toJSON and the datapoint
+ * values.
+ *
+ * The string is searched for quotes with memchr, which is vectorised
+ * by the C library, and copied in runs between them, so a string
+ * with no quotes is appended with a single copy.
+ *
+ * @param out		The string to append to
+ * @param str		The string to escape
+ * @param length	The length of the string to escape
+ */
+void JSONappendEscaped(std::string& out, const char *str, size_t length)
+{
+const char *end = str + length;
+const char *start = str;
+const char *quote;
+
+	while ((quote = (const char *)memchr(start, '"', end - start)) != NULL)
+	{
+		// The quote is already escaped if an odd number of backslashes precede it
+		const char *p = quote;
+		while (p > str && p[-1] == '\\')
+		{
+			p--;
+		}
+		out.append(start, quote - start);
+		if (((quote - p) & 1) == 0)
+		{
+			out += '\\';
+		}
+		out += '"';
+		start = quote + 1;
+	}
+	out.append(start, end - start);
+}
+
 /**
  * Return unescaped version of a JSON string
  *
@@ -124,3 +165,71 @@ std::string JSONunescape(const std::string& subject)
         return json;
 }
 
+
+/**
+ * Create a JSON writer
+ *
+ * @param capacity	The initial size of the buffer
+ */
+JSONWriter::JSONWriter(size_t capacity) : m_buffer(0, capacity), m_writer(m_buffer)
+{
+}
+
+/**
+ * Append JSON text to the document as it is
+ *
+ * @param text	The text to append
+ * @return	The writer
+ */
+JSONWriter& JSONWriter::append(const char *text)
+{
+	size_t length = strlen(text);
+	if (length)
+	{
+		memcpy(m_buffer.Push(length), text, length);
+	}
+	return *this;
+}
+
+/**
+ * Append JSON text to the document as it is
+ *
+ * @param text	The text to append
+ * @return	The writer
+ */
+JSONWriter& JSONWriter::append(const string& text)
+{
+	if (!text.empty())
+	{
+		memcpy(m_buffer.Push(text.length()), text.data(), text.length());
+	}
+	return *this;
+}
+
+/**
+ * Append an integer value to the document
+ *
+ * @param value	The value to append
+ * @return	The writer
+ */
+JSONWriter& JSONWriter::append(long value)
+{
+	m_writer.Reset(m_buffer);
+	m_writer.Int64(value);
+	return *this;
+}
+
+/**
+ * Append a string value to the document, in quotes and escaped
+ *
+ * @param value		The string to append
+ * @param length	The length of the string
+ * @return		The writer
+ */
+JSONWriter& JSONWriter::appendString(const char *value, size_t length)
+{
+	// Each value is a new root for the RapidJSON writer
+	m_writer.Reset(m_buffer);
+	m_writer.String(value, length);
+	return *this;
+}
@@ -0,0 +1,280 @@
+/*
+ * Fledge statistics of the age of readings in the data path.
+ *
+ * Copyright (c) 2026 Dianomic Systems
+ *
+ * Released under the Apache 2.0 Licence
+ *
+ * Author: agent
+ */
+#include <lag_statistics.h>
+#include <json_utils.h>
+#include <sstream>
+#include <algorithm>
+#include <string.h>
+
+using namespace std;
+
+/**
+ * The upper bounds of the buckets of the histogram in milliseconds,
+ * readings with a larger lag are counted in the last bucket
+ */
+const unsigned long LagStatistics::bounds[LAG_BUCKETS - 1] = {
+	10, 50, 100, 250, 500, 1000, 2500, 5000, 10000, 30000, 60000, 300000, 3600000
+};
+
+/**
+ * Construct the statistics of the lag at a point in the data path
+ *
+ * @param topAssets	The number of assets with the largest lag to report
+ * @param window	The length in seconds of the windows of the recent lag
+ */
+LagStatistics::LagStatistics(unsigned int topAssets, unsigned int window) :
+	m_topAssets(topAssets), m_window(window), m_count(0), m_sum(0),
+	m_windowStart(0), m_currentMax(0), m_previousMax(0)
+{
+	memset(m_buckets, 0, sizeof(m_buckets));
+	memset(m_current, 0, sizeof(m_current));
+	memset(m_previous, 0, sizeof(m_previous));
+}
+
+/**
+ * Record the lag of a block of readings. The lag of each reading is
+ * the time from its timestamp to the time given, a reading with a
+ * timestamp in the future has no lag.
+ *
+ * @param first		The first reading of the block
+ * @param last		The end of the block
+ * @param userTimestamp	Use the user timestamp of the readings rather than the
+ *			time they were stored
+ * @param now		The time the readings passed this point
+ */
+void LagStatistics::record(vector<Reading *>::const_iterator first,
+		vector<Reading *>::const_iterator last,
+		bool userTimestamp, const struct timeval& now)
+{
+	long nowMs = now.tv_sec * 1000L + now.tv_usec / 1000;
+	lock_guard<mutex> guard(m_mutex);
+	roll(now.tv_sec);
+	for (auto it = first; it != last; ++it)
+	{
+		struct timeval ts;
+		if (userTimestamp)
+			(*it)->getUserTimestamp(&ts);
+		else
+			(*it)->getTimestamp(&ts);
+		long lag = nowMs - (ts.tv_sec * 1000L + ts.tv_usec / 1000);
+		add((*it)->getInternedAssetName(), lag > 0 ? lag : 0);
+	}
+}
+
+/**
+ * Record the lag of a single reading
+ *
+ * @param asset	The asset of the reading
+ * @param lag	The lag of the reading in milliseconds
+ * @param now	The time in seconds the reading passed this point
+ */
+void LagStatistics::record(const InternedString& asset, unsigned long lag, time_t now)
+{
+	lock_guard<mutex> guard(m_mutex);
+	roll(now);
+	add(asset, lag);
+}
+
+/**
+ * Add a lag to the histograms and the lag of the asset, called with
+ * the mutex held
+ *
+ * @param asset	The asset of the reading
+ * @param lag	The lag of the reading in milliseconds
+ */
+void LagStatistics::add(const InternedString& asset, unsigned long lag)
+{
+	int bucket = lower_bound(bounds, bounds + LAG_BUCKETS - 1, lag) - bounds;
+	m_buckets[bucket]++;
+	m_current[bucket]++;
+	m_count++;
+	m_sum += lag;
+	if (lag > m_currentMax)
+		m_currentMax = lag;
+
+	auto res = m_currentAssets.emplace(asset, AssetLag());
+	AssetLag& assetLag = res.first->second;
+	if (res.second)
+	{
+		assetLag.count = 0;
+		assetLag.sum = 0;
+		assetLag.max = 0;
+	}
+	assetLag.count++;
+	assetLag.sum += lag;
+	if (lag > assetLag.max)
+		assetLag.max = lag;
+	assetLag.last = lag;
+}
+
+/**
+ * Start a new window once the current window has ended. The current
+ * window becomes the previous one, unless no lag was recorded for a
+ * whole window, called with the mutex held.
+ *
+ * @param now	The current time in seconds
+ */
+void LagStatistics::roll(time_t now)
+{
+	if (m_windowStart == 0)
+	{
+		m_windowStart = now;
+		return;
+	}
+	if (now < m_windowStart + (time_t)m_window)
+	{
+		return;
+	}
+	if (now < m_windowStart + 2 * (time_t)m_window)
+	{
+		memcpy(m_previous, m_current, sizeof(m_previous));
+		m_previousMax = m_currentMax;
+		m_previousAssets.swap(m_currentAssets);
+	}
+	else
+	{
+		memset(m_previous, 0, sizeof(m_previous));
+		m_previousMax = 0;
+		m_previousAssets.clear();
+	}
+	memset(m_current, 0, sizeof(m_current));
+	m_currentMax = 0;
+	m_currentAssets.clear();
+	m_windowStart = now - (now - m_windowStart) % m_window;
+}
+
+/**
+ * Return the number of readings recorded
+ */
+unsigned long LagStatistics::getCount() const
+{
+	lock_guard<mutex> guard(m_mutex);
+	return m_count;
+}
+
+/**
+ * Return an estimate of a percentile of the recent lag
+ *
+ * @param p	The percentile, between 0 and 100
+ * @return	The lag in milliseconds
+ */
+unsigned long LagStatistics::percentile(double p) const
+{
+	lock_guard<mutex> guard(m_mutex);
+	return windowPercentile(p);
+}
+
+/**
+ * Estimate a percentile of the lag over the current and previous
+ * windows. The lag is interpolated within the bucket that holds the
+ * percentile and is never more than the largest lag recorded in the
+ * windows. Called with the mutex held.
+ *
+ * @param p	The percentile, between 0 and 100
+ * @return	The lag in milliseconds
+ */
+unsigned long LagStatistics::windowPercentile(double p) const
+{
+	unsigned long max = std::max(m_currentMax, m_previousMax);
+	unsigned long total = 0;
+	for (int i = 0; i < LAG_BUCKETS; i++)
+	{
+		total += m_current[i] + m_previous[i];
+	}
+	if (total == 0)
+	{
+		return 0;
+	}
+	double rank = p * total / 100.0;
+	unsigned long below = 0;
+	for (int i = 0; i < LAG_BUCKETS; i++)
+	{
+		unsigned long count = m_current[i] + m_previous[i];
+		if (count > 0 && below + count >= rank)
+		{
+			unsigned long lower = i == 0 ? 0 : bounds[i - 1];
+			unsigned long upper = i == LAG_BUCKETS - 1 ? max : std::min(bounds[i], max);
+			if (upper <= lower)
+			{
+				return upper;
+			}
+			return lower + (unsigned long)((upper - lower) * (rank - below) / count);
+		}
+		below += count;
+	}
+	return max;
+}
+
+/**
+ * Return the statistics as a JSON object. The histogram holds the
+ * count of every reading recorded in each bucket, the percentiles,
+ * maximum and assets are those of the recent readings.
+ *
+ * @param json	The string to return the JSON object in
+ */
+void LagStatistics::asJSON(string& json) const
+{
+	lock_guard<mutex> guard(m_mutex);
+
+	ostringstream convert;
+	convert << "{ \"count\" : " << m_count;
+	convert << ", \"mean\" : " << (m_count ? (unsigned long)(m_sum / m_count) : 0);
+	convert << ", \"histogram\" : [ ";
+	for (int i = 0; i < LAG_BUCKETS; i++)
+	{
+		if (i)
+			convert << ", ";
+		convert << "{ \"le\" : ";
+		if (i < LAG_BUCKETS - 1)
+			convert << bounds[i];
+		else
+			convert << "\"inf\"";
+		convert << ", \"count\" : " << m_buckets[i] << " }";
+	}
+	convert << " ], \"window\" : " << 2 * m_window;
+	convert << ", \"p50\" : " << windowPercentile(50);
+	convert << ", \"p95\" : " << windowPercentile(95);
+	convert << ", \"p99\" : " << windowPercentile(99);
+	convert << ", \"max\" : " << std::max(m_currentMax, m_previousMax);
+
+	// Merge the lag of each asset over both windows
+	unordered_map<InternedString, AssetLag> assets(m_previousAssets);
+	for (auto& current : m_currentAssets)
+	{
+		auto res = assets.emplace(current.first, current.second);
+		if (!res.second)
+		{
+			AssetLag& merged = res.first->second;
+			merged.count += current.second.count;
+			merged.sum += current.second.sum;
+			merged.max = std::max(merged.max, current.second.max);
+			merged.last = current.second.last;
+		}
+	}
+	vector<pair<InternedString, AssetLag>> top(assets.begin(), assets.end());
+	auto end = top.begin() + std::min((size_t)m_topAssets, top.size());
+	partial_sort(top.begin(), end, top.end(),
+			[](const pair<InternedString, AssetLag>& a, const pair<InternedString, AssetLag>& b) {
+				return a.second.max > b.second.max;
+			});
+	convert << ", \"assets\" : [ ";
+	for (auto it = top.begin(); it != end; ++it)
+	{
+		if (it != top.begin())
+			convert << ", ";
+		convert << "{ \"asset\" : \"" << JSONescape(it->first.str()) << "\"";
+		convert << ", \"count\" : " << it->second.count;
+		convert << ", \"mean\" : " << (unsigned long)(it->second.sum / it->second.count);
+		convert << ", \"max\" : " << it->second.max;
+		convert << ", \"last\" : " << it->second.last << " }";
+	}
+	convert << " ] }";
+	json = convert.str();
+}
@@ -15,6 +15,9 @@
 #include <memory>
 #include <string.h>
 #include <sys/time.h>
+#include <pthread.h>
+#include <chrono>
+#include <mpsc_queue.h>
 
 using namespace std;
 
@@ -30,7 +33,10 @@ inline long getCurrTimeUsec()
 
 Logger *Logger::instance = 0;
 
-Logger::Logger(const string& application)
+Logger::Logger(const string& application) : m_minPriority(LOG_DEBUG), m_async(false),
+	m_queue(NULL), m_writer(NULL), m_running(false),
+	m_rateMessages(LOGGER_RATE_MESSAGES), m_rateInterval(LOGGER_RATE_INTERVAL),
+	m_rateSweep(0), m_suppressed(0)
 {
 static char ident[80];
 
@@ -44,12 +50,35 @@ static char ident[80];
 	{
 		strncpy(ident, application.c_str(), sizeof(ident));
 	}
+	memset(m_rateSites, 0, sizeof(m_rateSites));
 	openlog(ident, LOG_PID|LOG_CONS, LOG_USER);
 	instance = this;
 }
 
 Logger::~Logger()
 {
+	{
+		lock_guard<mutex> guard(m_rateMutex);
+		for (int i = 0; i < LOGGER_RATE_SITES; i++)
+		{
+			if (m_rateSites[i].suppressed)
+			{
+				summarise(m_rateSites[i]);
+			}
+		}
+	}
+	if (m_writer)
+	{
+		m_async = false;
+		{
+			lock_guard<mutex> guard(m_writerMutex);
+			m_running = false;
+		}
+		m_writerCV.notify_one();
+		m_writer->join();
+		delete m_writer;
+		delete m_queue;
+	}
 	closelog();
 }
 
@@ -68,40 +97,96 @@ Logger *Logger::getLogger()
  */
 void Logger::setMinLevel(const string& level)
 {
+	int priority;
+
 	if (level.compare("info") == 0)
 	{
-		setlogmask(LOG_UPTO(LOG_INFO));
-		levelString = level;
+		priority = LOG_INFO;
 	} else if (level.compare("warning") == 0)
 	{
-		setlogmask(LOG_UPTO(LOG_WARNING));
-		levelString = level;
+		priority = LOG_WARNING;
 	} else if (level.compare("debug") == 0)
 	{
-		setlogmask(LOG_UPTO(LOG_DEBUG));
-		levelString = level;
+		priority = LOG_DEBUG;
 	} else if (level.compare("error") == 0)
 	{
-		setlogmask(LOG_UPTO(LOG_ERR));
-		levelString = level;
+		priority = LOG_ERR;
 	} else
 	{
 		error("Request to set unsupported log level %s", level.c_str());
+		return;
+	}
+	setlogmask(LOG_UPTO(priority));
+	m_minPriority = priority;
+	levelString = level;
+}
+
+/**
+ * Make the logger asynchronous, so that messages are written to syslog
+ * by a writer thread rather than the thread that logs them. The writer
+ * thread is created the first time the logger is made asynchronous and
+ * remains until the logger is destroyed.
+ *
+ * @param async	True if messages should be written asynchronously
+ */
+void Logger::setAsynchronous(bool async)
+{
+	if (async && !m_writer)
+	{
+		m_queue = new MPSCQueue<Message>(LOGGER_QUEUE_SIZE);
+		m_running = true;
+		m_writer = new thread(&Logger::writer, this);
 	}
+	m_async = async;
+}
+
+/**
+ * Set the number of messages each call site may log in an interval
+ * before further messages are suppressed
+ *
+ * @param messages	The messages allowed in each interval, 0 disables rate limiting
+ * @param interval	The length of the interval in seconds
+ */
+void Logger::setRateLimit(unsigned int messages, unsigned int interval)
+{
+	lock_guard<mutex> guard(m_rateMutex);
+	for (int i = 0; i < LOGGER_RATE_SITES; i++)
+	{
+		if (m_rateSites[i].suppressed)
+		{
+			summarise(m_rateSites[i]);
+		}
+	}
+	memset(m_rateSites, 0, sizeof(m_rateSites));
+	m_rateMessages = messages;
+	m_rateInterval = interval > 0 ? interval : 1;
+	m_rateSweep = 0;
 }
 
 void Logger::debug(const string& msg, ...)
 {
+	if (!isEnabled(LOG_DEBUG))
+		return;
+	va_list args;
+	va_start(args, msg);
+	log(LOG_DEBUG, "DEBUG", msg.c_str(), args);
+	va_end(args);
+}
+
+void Logger::debug(const char *msg, ...)
+{
+	if (!isEnabled(LOG_DEBUG))
+		return;
 	va_list args;
 	va_start(args, msg);
-	string *fmt = format(msg, args);
-	syslog(LOG_DEBUG, "DEBUG: %s", fmt->c_str());
-	delete fmt;
+	log(LOG_DEBUG, "DEBUG", msg, args);
 	va_end(args);
 }
 
 void Logger::printLongString(const string& s)
 {
+	if (!isEnabled(LOG_DEBUG))
+		return;
 	const int charsPerLine = 950;
 	int len = s.size();
 	const char *cstr = s.c_str();
@@ -111,39 +196,61 @@ void Logger::printLongString(const string& s)
 
 void Logger::info(const string& msg, ...)
 {
+	if (!isEnabled(LOG_INFO))
+		return;
 	va_list args;
 	va_start(args, msg);
-	string *fmt = format(msg, args);
-#ifdef ADD_USEC_TS
-	syslog(LOG_INFO, "[.%06ld] INFO: %s", getCurrTimeUsec(), fmt->c_str());
-#else
-	syslog(LOG_INFO, "INFO: %s", fmt->c_str());
-#endif
-	delete fmt;
+	log(LOG_INFO, "INFO", msg.c_str(), args);
+	va_end(args);
+}
+
+void Logger::info(const char *msg, ...)
+{
+	if (!isEnabled(LOG_INFO))
+		return;
+	va_list args;
+	va_start(args, msg);
+	log(LOG_INFO, "INFO", msg, args);
 	va_end(args);
 }
 
 void Logger::warn(const string& msg, ...)
 {
+	if (!isEnabled(LOG_WARNING))
+		return;
 	va_list args;
 	va_start(args, msg);
-	string *fmt = format(msg, args);
-	syslog(LOG_WARNING, "WARNING: %s", fmt->c_str());
-	delete fmt;
+	log(LOG_WARNING, "WARNING", msg.c_str(), args);
+	va_end(args);
+}
+
+void Logger::warn(const char *msg, ...)
+{
+	if (!isEnabled(LOG_WARNING))
+		return;
+	va_list args;
+	va_start(args, msg);
+	log(LOG_WARNING, "WARNING", msg, args);
 	va_end(args);
 }
 
 void Logger::error(const string& msg, ...)
 {
+	if (!isEnabled(LOG_ERR))
+		return;
 	va_list args;
 	va_start(args, msg);
-	string *fmt = format(msg, args);
-#ifdef ADD_USEC_TS
-		syslog(LOG_ERR, "[.%06ld] ERROR: %s", getCurrTimeUsec(), fmt->c_str());
-#else
-		syslog(LOG_ERR, "ERROR: %s", fmt->c_str());
-#endif
-	delete fmt;
+	log(LOG_ERR, "ERROR", msg.c_str(), args);
+	va_end(args);
+}
+
+void Logger::error(const char *msg, ...)
+{
+	if (!isEnabled(LOG_ERR))
+		return;
+	va_list args;
+	va_start(args, msg);
+	log(LOG_ERR, "ERROR", msg, args);
 	va_end(args);
 }
 
@@ -151,16 +258,181 @@ void Logger::fatal(const string& msg, ...)
 {
 	va_list args;
 	va_start(args, msg);
-	string *fmt = format(msg, args);
-	syslog(LOG_CRIT, "FATAL: %s", fmt->c_str());
-	delete fmt;
+	log(LOG_CRIT, "FATAL", msg.c_str(), args);
 	va_end(args);
 }
 
-string *Logger::format( const std::string& format, va_list args)
+void Logger::fatal(const char *msg, ...)
 {
-char	buf[1000];
+	va_list args;
+	va_start(args, msg);
+	log(LOG_CRIT, "FATAL", msg, args);
+	va_end(args);
+}
+
+/**
+ * Format a message into a buffer on the stack and either write it to
+ * syslog or queue it for the writer thread.
+ *
+ * @param priority	The syslog priority of the message
+ * @param prefix	The level name that prefixes the message
+ * @param msg		The printf style format of the message
+ * @param ap		The arguments of the message
+ */
+void Logger::log(int priority, const char *prefix, const char *msg, va_list ap)
+{
+	Message	message;
+	int	len;
+
+	if (priority != LOG_CRIT && priority != LOG_DEBUG && rateLimited(priority, prefix, msg))
+	{
+		return;
+	}
+#ifdef ADD_USEC_TS
+	if (priority == LOG_INFO || priority == LOG_ERR)
+		len = snprintf(message.text, sizeof(message.text), "[.%06ld] %s: ", getCurrTimeUsec(), prefix);
+	else
+		len = snprintf(message.text, sizeof(message.text), "%s: ", prefix);
+#else
+	len = snprintf(message.text, sizeof(message.text), "%s: ", prefix);
+#endif
+	vsnprintf(message.text + len, sizeof(message.text) - len, msg, ap);
+	message.priority = priority;
+	write(message);
+}
 
-	  vsnprintf(buf, sizeof(buf), format.c_str(), args);
-	  return new string(buf);
+/**
+ * Write a formatted message to syslog, or queue it for the writer
+ * thread if the logger is asynchronous
+ *
+ * @param message	The formatted message
+ */
+void Logger::write(Message& message)
+{
+	if (message.priority != LOG_CRIT && m_async.load(std::memory_order_acquire))
+	{
+		size_t count;
+		if (m_queue->push(message, count))
+		{
+			if (count == 1)
+			{
+				m_writerCV.notify_one();
+			}
+			return;
+		}
+	}
+	syslog(message.priority, "%s", message.text);
+}
+
+/**
+ * Check if a message should be suppressed because its call site has
+ * already logged the permitted number of messages in the current
+ * interval. Call sites whose interval has ended report the messages
+ * that were suppressed.
+ *
+ * @param priority	The syslog priority of the message
+ * @param prefix	The level name that prefixes the message
+ * @param msg		The format of the message, which identifies the call site
+ * @return bool		True if the message should be suppressed
+ */
+bool Logger::rateLimited(int priority, const char *prefix, const char *msg)
+{
+	if (m_rateMessages == 0)
+	{
+		return false;
+	}
+	uint32_t hash = 2166136261u ^ (uint32_t)priority;
+	for (const char *p = msg; *p; p++)
+	{
+		hash = (hash ^ (unsigned char)*p) * 16777619u;
+	}
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC_COARSE, &ts);
+	time_t now = ts.tv_sec;
+
+	lock_guard<mutex> guard(m_rateMutex);
+	if (now >= m_rateSweep)
+	{
+		for (int i = 0; i < LOGGER_RATE_SITES; i++)
+		{
+			RateSite& site = m_rateSites[i];
+			if (site.suppressed && now - site.start >= m_rateInterval)
+			{
+				summarise(site);
+				site.hash = 0;
+			}
+		}
+		m_rateSweep = now + m_rateInterval;
+	}
+
+	RateSite& site = m_rateSites[hash & (LOGGER_RATE_SITES - 1)];
+	if (site.hash != hash || now - site.start >= m_rateInterval)
+	{
+		if (site.suppressed)
+		{
+			summarise(site);
+		}
+		site.hash = hash;
+		site.priority = priority;
+		site.prefix = prefix;
+		site.start = now;
+		site.count = 1;
+		site.suppressed = 0;
+		strncpy(site.format, msg, sizeof(site.format) - 1);
+		site.format[sizeof(site.format) - 1] = 0;
+		return false;
+	}
+	if (site.count < m_rateMessages)
+	{
+		site.count++;
+		return false;
+	}
+	site.suppressed++;
+	m_suppressed.fetch_add(1, std::memory_order_relaxed);
+	return true;
+}
+
+/**
+ * Log the number of messages suppressed for a call site. Called with
+ * the rate limiter mutex held.
+ *
+ * @param site	The call site whose messages were suppressed
+ */
+void Logger::summarise(RateSite& site)
+{
+	Message message;
+	snprintf(message.text, sizeof(message.text), "%s: %u similar messages suppressed: %s",
+			site.prefix, site.suppressed, site.format);
+	message.priority = site.priority;
+	site.suppressed = 0;
+	write(message);
+}
+
+/**
+ * The writer thread of an asynchronous logger. Messages are written
+ * to syslog in the order they were queued.
+ */
+void Logger::writer()
+{
+	pthread_setname_np(pthread_self(), "logger");
+	Message	message;
+	unique_lock<mutex> lck(m_writerMutex);
+	while (m_running)
+	{
+		lck.unlock();
+		while (m_queue->pop(message))
+		{
+			syslog(message.priority, "%s", message.text);
+		}
+		lck.lock();
+		if (m_running && m_queue->size() == 0)
+		{
+			m_writerCV.wait_for(lck, chrono::milliseconds(LOGGER_WRITER_WAIT));
+		}
+	}
+	lck.unlock();
+	while (m_queue->pop(message))
+	{
+		syslog(message.priority, "%s", message.text);
+	}
 }
@@ -16,12 +16,60 @@
 #include <bearer_token.h>
 #include <crypto.hpp>
 #include <rapidjson/error/en.h>
+#include <rapidjson/writer.h>
+#include <rapidjson/stringbuffer.h>
 
 using namespace std;
 using namespace rapidjson;
 using namespace SimpleWeb;
 using HttpClient = SimpleWeb::Client<SimpleWeb::HTTP>;
 
+/**
+ * Destructor for the service bootstrap, any asset tracking tuples
+ * not taken by the asset tracker are deleted
+ */
+ServiceBootstrap::~ServiceBootstrap()
+{
+	for (auto tuple : m_tuples)
+	{
+		delete tuple;
+	}
+}
+
+/**
+ * Return a configuration category fetched by the bootstrap
+ *
+ * @param name		The name of the category
+ * @param category	Set to the category if it was fetched
+ * @return bool		True if the category was fetched
+ */
+bool ServiceBootstrap::getCategory(const string& name, ConfigCategory& category) const
+{
+	auto it = m_categories.find(name);
+	if (it == m_categories.end())
+	{
+		return false;
+	}
+	category = it->second;
+	return true;
+}
+
+/**
+ * Return the storage service record fetched by the bootstrap
+ *
+ * @param storage	Set to the storage service record if it was fetched
+ * @return bool		True if the storage service is registered
+ */
+bool ServiceBootstrap::getStorage(ServiceRecord& storage) const
+{
+	if (!m_hasStorage)
+	{
+		return false;
+	}
+	storage = m_storage;
+	return true;
+}
+
 /**
  * Management Client constructor. Creates a class used to send management API requests
  * from a micro service to the Fledge core service.
@@ -32,7 +80,10 @@ using HttpClient = SimpleWeb::Client<SimpleWeb::HTTP>;
  * @param hostname	The hostname of the Fledge core micro service
  * @param port		The port of the management service API listener in the Fledge core
  */
-ManagementClient::ManagementClient(const string& hostname, const unsigned short port) : m_uuid(0)
+ManagementClient::ManagementClient(const string& hostname, const unsigned short port) : m_clients(0),
+	m_uuid(0), m_async_thread(NULL), m_async_running(false),
+	m_audit_batch_size(AUDIT_BATCH_SIZE), m_audit_interval(AUDIT_FLUSH_INTERVAL),
+	m_service_cache_ttl(SERVICE_CACHE_TTL)
 {
 ostringstream urlbase;
 
@@ -41,11 +92,22 @@ ostringstream urlbase;
 }
 
 /**
- * Destructor for management client
+ * Destructor for management client, requests that have been queued
+ * for the asynchronous request thread and buffered audit entries are
+ * sent before it returns
  */
 ManagementClient::~ManagementClient()
 {
-	std::map<std::thread::id, HttpClient *>::iterator item;
+	if (m_async_thread)
+	{
+		{
+			lock_guard<mutex> guard(m_mtx_async);
+			m_async_running = false;
+		}
+		m_async_cv.notify_all();
+		m_async_thread->join();
+		delete m_async_thread;
+	}
 
 	if (m_uuid)
 	{
@@ -53,43 +115,148 @@ ManagementClient::~ManagementClient()
 		m_uuid = 0;
 	}
 
-	// Deletes all the HttpClient objects created in the map
-	for (item  = m_client_map.begin() ; item  != m_client_map.end() ; ++item)
+	// Deletes all the HttpClient objects in the pool
+	for (auto client : m_idle_clients)
 	{
-		delete item->second;
+		delete client;
 	}
 }
 
 /**
- * Creates a HttpClient object for each thread
- * it stores/retrieves the reference to the HttpClient and the associated thread id in a map
+ * Take a HttpClient from the pool for a request to the core. A new
+ * client is created if none is idle and the pool is not full, otherwise
+ * the caller waits for a client to be returned. The clients keep their
+ * connection to the core alive, so that it is reused by later requests
+ * whichever thread makes them.
  *
- * @return HttpClient	The HTTP client connection to the core
+ * @return HttpClientLease	The HTTP client connection to the core
  */
-HttpClient *ManagementClient::getHttpClient() {
-
-	std::map<std::thread::id, HttpClient *>::iterator item;
-	HttpClient *client;
-
-	std::thread::id thread_id = std::this_thread::get_id();
+HttpClientLease ManagementClient::getHttpClient()
+{
+	unique_lock<mutex> lck(m_mtx_clients);
+	while (m_idle_clients.empty() && m_clients >= MANAGEMENT_CLIENT_POOL)
+	{
+		m_client_cv.wait(lck);
+	}
+	if (!m_idle_clients.empty())
+	{
+		HttpClient *client = m_idle_clients.back();
+		m_idle_clients.pop_back();
+		return HttpClientLease(this, client);
+	}
+	m_clients++;
+	lck.unlock();
 
-	m_mtx_client_map.lock();
-	item = m_client_map.find(thread_id);
+	return HttpClientLease(this, new HttpClient(m_urlbase.str()));
+}
 
-	if (item  == m_client_map.end() ) {
+/**
+ * Return a HttpClient to the pool
+ *
+ * @param client	The client to return
+ */
+void ManagementClient::releaseHttpClient(HttpClient *client)
+{
+	{
+		lock_guard<mutex> guard(m_mtx_clients);
+		m_idle_clients.push_back(client);
+	}
+	m_client_cv.notify_one();
+}
 
-		// Adding a new HttpClient
-		client = new HttpClient(m_urlbase.str());
-		m_client_map[thread_id] = client;
+/**
+ * Return the leased client to the pool of the management client
+ */
+HttpClientLease::~HttpClientLease()
+{
+	if (m_client)
+	{
+		m_owner->releaseHttpClient(m_client);
 	}
-	else
+}
+
+/**
+ * Queue a request to be made by the asynchronous request thread,
+ * starting the thread if it is not already running. Requests are
+ * made in the order they are queued.
+ *
+ * @param request	The request to make
+ */
+void ManagementClient::queueRequest(function<void ()> request)
+{
 	{
-		client = item->second;
+		lock_guard<mutex> guard(m_mtx_async);
+		m_async_queue.push_back(request);
+		startAsyncThread();
 	}
+	m_async_cv.notify_one();
+}
 
-	m_mtx_client_map.unlock();
+/**
+ * Start the asynchronous request thread if it is not already
+ * running. Called with m_mtx_async held.
+ */
+void ManagementClient::startAsyncThread()
+{
+	if (!m_async_thread)
+	{
+		m_async_running = true;
+		m_async_thread = new thread(&ManagementClient::asyncRequests, this);
+	}
+}
 
-	return (client);
+/**
+ * The asynchronous request thread, the queue is emptied and the
+ * buffered audit entries are sent before the thread exits.
+ *
+ * Audit entries are sent once the batch is full or the first entry
+ * in the batch has waited for the flush interval.
+ */
+void ManagementClient::asyncRequests()
+{
+	unique_lock<mutex> lck(m_mtx_async);
+	while (m_async_running || !m_async_queue.empty() || !m_audit_batch.empty())
+	{
+		if (m_async_queue.empty())
+		{
+			if (m_audit_batch.empty())
+			{
+				m_async_cv.wait(lck);
+				continue;
+			}
+			if (m_async_running && m_audit_batch.size() < m_audit_batch_size
+					&& m_async_cv.wait_until(lck, m_audit_deadline) == cv_status::no_timeout)
+			{
+				continue;
+			}
+			vector<AuditEntry> batch;
+			if (m_audit_batch.size() > m_audit_batch_size)
+			{
+				auto end = m_audit_batch.begin() + m_audit_batch_size;
+				batch.assign(m_audit_batch.begin(), end);
+				m_audit_batch.erase(m_audit_batch.begin(), end);
+			}
+			else
+			{
+				batch.swap(m_audit_batch);
+			}
+			lck.unlock();
+			postAuditEntries(batch);
+			lck.lock();
+			continue;
+		}
+		function<void ()> request = m_async_queue.front();
+		m_async_queue.pop_front();
+		lck.unlock();
+		try {
+			request();
+		} catch (exception& e) {
+			m_logger->error("Asynchronous request to the core failed: %s", e.what());
+		} catch (...) {
+			m_logger->error("Asynchronous request to the core failed");
+		}
+		lck.lock();
+	}
 }
 
 /**
@@ -208,6 +375,10 @@ bool ManagementClient::unregisterService()
  * Note, if multiple service records match then only the first will be
  * returned.
  *
+ * The records returned by the core are reused for the service cache TTL,
+ * callers that fail to reach a service should call invalidateService
+ * so that the next lookup asks the core for its current location.
+ *
  * @param service	A partially filled service record that will be completed
  * @return bool		Return true if the service record was found
  */
@@ -215,6 +386,24 @@ bool ManagementClient::getService(ServiceRecord& service)
 {
 string payload;
 
+	string key = service.getName().empty() ? "type:" + service.getType() : service.getName();
+	{
+		lock_guard<mutex> guard(m_service_cache_mtx);
+		auto it = m_service_cache.find(key);
+		if (it != m_service_cache.end())
+		{
+			if (it->second.expires > chrono::steady_clock::now())
+			{
+				service.setAddress(it->second.address);
+				service.setPort(it->second.port);
+				service.setProtocol(it->second.protocol);
+				service.setManagementPort(it->second.managementPort);
+				return true;
+			}
+			m_service_cache.erase(it);
+		}
+	}
+
 	try {
 		string url = "/fledge/service";
 		if (!service.getName().empty())
@@ -250,6 +439,16 @@ string payload;
 			service.setPort(serviceRecord["service_port"].GetInt());
 			service.setProtocol(serviceRecord["protocol"].GetString());
 			service.setManagementPort(serviceRecord["management_port"].GetInt());
+			if (m_service_cache_ttl)
+			{
+				lock_guard<mutex> guard(m_service_cache_mtx);
+				CachedService& cached = m_service_cache[key];
+				cached.address = service.getAddress();
+				cached.port = service.getPort();
+				cached.protocol = serviceRecord["protocol"].GetString();
+				cached.managementPort = serviceRecord["management_port"].GetInt();
+				cached.expires = chrono::steady_clock::now() + chrono::seconds(m_service_cache_ttl);
+			}
 			return true;
 		}
 	} catch (const SimpleWeb::system_error &e) {
@@ -259,6 +458,124 @@ string payload;
 	return false;
 }
 
+/**
+ * Discard the cached record of a service, the next call to getService
+ * for it will ask the core. Used when a service can not be reached at
+ * the address it was registered with, it may have been restarted.
+ *
+ * @param name	The name of the service
+ */
+void ManagementClient::invalidateService(const string& name)
+{
+	lock_guard<mutex> guard(m_service_cache_mtx);
+	m_service_cache.erase(name);
+}
+
+/**
+ * Set the number of seconds a service record returned by the core
+ * is reused. The cache is emptied, a TTL of 0 disables it.
+ *
+ * @param ttl	The time to live of the cached records in seconds
+ */
+void ManagementClient::setServiceCacheTTL(unsigned int ttl)
+{
+	lock_guard<mutex> guard(m_service_cache_mtx);
+	m_service_cache_ttl = ttl;
+	m_service_cache.clear();
+}
+
+/**
+ * Fetch, in a single request to the core, the configuration categories,
+ * the storage service record and the asset tracking tuples that a
+ * service needs as it starts.
+ *
+ * Categories that do not exist are not returned. A core that does not
+ * provide the bootstrap entry point causes false to be returned, the
+ * caller should then fetch each of these individually.
+ *
+ * @param serviceName	The name of the service
+ * @param categories	The names of the configuration categories to fetch
+ * @param bootstrap	Populated with the content returned by the core
+ * @return bool		True if the bootstrap content was fetched
+ */
+bool ManagementClient::getBootstrap(const string& serviceName,
+				    const vector<string>& categories,
+				    ServiceBootstrap& bootstrap)
+{
+	try {
+		string url = "/fledge/service/bootstrap?service=" + urlEncode(serviceName);
+		for (auto& category : categories)
+		{
+			url += "&category=" + urlEncode(category);
+		}
+		auto res = this->getHttpClient()->request("GET", url.c_str());
+		Document doc;
+		string response = res->content.string();
+		doc.Parse(response.c_str());
+		if (doc.HasParseError())
+		{
+			bool httpError = (isdigit(response[0]) && isdigit(response[1]) && isdigit(response[2]) && response[3]==':');
+			if (httpError)
+			{
+				m_logger->info("The core does not support the service bootstrap, fetching the configuration individually");
+			}
+			else
+			{
+				m_logger->error("Failed to parse result of service bootstrap: %s", response.c_str());
+			}
+			return false;
+		}
+		if (doc.HasMember("message"))
+		{
+			m_logger->error("Failed to fetch service bootstrap: %s.",
+				doc["message"].GetString());
+			return false;
+		}
+		if (doc.HasMember("categories") && doc["categories"].IsObject())
+		{
+			for (auto& category : doc["categories"].GetObject())
+			{
+				StringBuffer buffer;
+				Writer<StringBuffer> writer(buffer);
+				category.value.Accept(writer);
+				string name = category.name.GetString();
+				bootstrap.m_categories.insert(pair<string, ConfigCategory>(name,
+							ConfigCategory(name, buffer.GetString())));
+			}
+		}
+		if (doc.HasMember("services") && doc["services"].IsArray()
+				&& doc["services"].Size() > 0)
+		{
+			Value& serviceRecord = doc["services"][0];
+			bootstrap.m_storage.setAddress(serviceRecord["address"].GetString());
+			bootstrap.m_storage.setPort(serviceRecord["service_port"].GetInt());
+			bootstrap.m_storage.setProtocol(serviceRecord["protocol"].GetString());
+			bootstrap.m_storage.setManagementPort(serviceRecord["management_port"].GetInt());
+			bootstrap.m_hasStorage = true;
+		}
+		if (doc.HasMember("track") && doc["track"].IsArray())
+		{
+			for (auto& rec : doc["track"].GetArray())
+			{
+				if (!rec.IsObject())
+				{
+					throw runtime_error("Expected asset tracker tuple to be an object");
+				}
+				bootstrap.m_tuples.push_back(new AssetTrackingTuple(rec["service"].GetString(),
+							rec["plugin"].GetString(),
+							rec["asset"].GetString(),
+							rec["event"].GetString()));
+			}
+		}
+		return true;
+	} catch (const SimpleWeb::system_error &e) {
+		m_logger->error("Fetch of service bootstrap failed %s.", e.what());
+	} catch (exception& e) {
+		m_logger->error("Failed to process service bootstrap: %s.", e.what());
+	}
+	return false;
+}
+
 /**
  * Return all services registered with the Fledge core
  *
@@ -582,6 +899,21 @@ ConfigCategory ManagementClient::getCategory(const string& categoryName)
 	}
 }
 
+/**
+ * Fetch a configuration category on the asynchronous request thread
+ *
+ * @param categoryName	The name of the configuration category
+ * @return		A future for the category, it holds the exception if the fetch fails
+ */
+future<ConfigCategory> ManagementClient::getCategoryAsync(const string& categoryName)
+{
+	auto task = make_shared<packaged_task<ConfigCategory ()> >(
+			bind(&ManagementClient::getCategory, this, categoryName));
+	future<ConfigCategory> result = task->get_future();
+	queueRequest([task]() { (*task)(); });
+	return result;
+}
+
 /**
  * Set a category configuration item value
  *
@@ -853,6 +1185,101 @@ bool ManagementClient::addAssetTrackingTuple(const std::string& service,
 		return false;
 }
 
+/**
+ * Encode asset tracking tuples as the JSON array of the track entry point
+ *
+ * @param tuples	The tuples to encode
+ * @return		The JSON array
+ */
+static string assetTrackingPayload(const vector<AssetTrackingTuple *>& tuples)
+{
+	ostringstream convert;
+
+	convert << "[ ";
+	for (size_t i = 0; i < tuples.size(); i++)
+	{
+		AssetTrackingTuple *tuple = tuples[i];
+		if (i)
+			convert << ", ";
+		convert << "{ \"service\" : \"" << JSONescape(tuple->m_serviceName) << "\", ";
+		convert << " \"plugin\" : \"" << JSONescape(tuple->m_pluginName) << "\", ";
+		convert << " \"asset\" : \"" << JSONescape(tuple->m_assetName) << "\", ";
+		convert << " \"event\" : \"" << JSONescape(tuple->m_eventName) << "\" }";
+	}
+	convert << " ]";
+	return convert.str();
+}
+
+/**
+ * Add a number of asset tracking tuples with a single request
+ *
+ * @param tuples	The tuples to add
+ * @return		whether operation was successful
+ */
+bool ManagementClient::addAssetTrackingTuples(const vector<AssetTrackingTuple *>& tuples)
+{
+	return postAssetTrackingTuples(assetTrackingPayload(tuples));
+}
+
+/**
+ * Add a number of asset tracking tuples with a single request made
+ * on the asynchronous request thread. The tuples are encoded before
+ * this call returns, the caller does not need to keep them.
+ *
+ * @param tuples	The tuples to add
+ * @return		A future for whether the operation was successful
+ */
+future<bool> ManagementClient::addAssetTrackingTuplesAsync(const vector<AssetTrackingTuple *>& tuples)
+{
+	auto task = make_shared<packaged_task<bool ()> >(
+			bind(&ManagementClient::postAssetTrackingTuples, this, assetTrackingPayload(tuples)));
+	future<bool> result = task->get_future();
+	queueRequest([task]() { (*task)(); });
+	return result;
+}
+
+/**
+ * Send the JSON encoded asset tracking tuples to the core
+ *
+ * @param payload	The JSON array of tuples
+ * @return		whether operation was successful
+ */
+bool ManagementClient::postAssetTrackingTuples(const string& payload)
+{
+	try {
+		auto res = this->getHttpClient()->request("POST", "/fledge/track", payload);
+		Document doc;
+		string content = res->content.string();
+		doc.Parse(content.c_str());
+		if (doc.HasParseError())
+		{
+			bool httpError = (isdigit(content[0]) && isdigit(content[1]) && isdigit(content[2]) && content[3]==':');
+			m_logger->error("%s asset tracking tuples addition: %s\n", 
+								httpError?"HTTP error during":"Failed to parse result of", 
+								content.c_str());
+			return false;
+		}
+		if (doc.IsObject() && doc.HasMember("tracks"))
+		{
+			return true;
+		}
+		else if (doc.IsObject() && doc.HasMember("message"))
+		{
+			m_logger->error("Failed to add asset tracking tuples: %s.",
+				doc["message"].GetString());
+		}
+		else
+		{
+			m_logger->error("Failed to add asset tracking tuples: %s.",
+					content.c_str());
+		}
+	} catch (const SimpleWeb::system_error &e) {
+		m_logger->error("Failed to add asset tracking tuples: %s.", e.what());
+		return false;
+	}
+	return false;
+}
+
 /**
  * Add an Audit Entry. Called when an auditable event occurs
  * to regsiter that event.
@@ -930,6 +1357,115 @@ bool ManagementClient::addAuditEntry(const std::string& code,
 	return false;
 }
 
+/**
+ * Add an audit entry without the caller waiting for the core.
+ *
+ * The entry is buffered and sent by the asynchronous request thread
+ * with the other entries added within the flush interval, so that a
+ * burst of audit entries is added with a few requests to the core.
+ *
+ * @param   code	The log code for the entry
+ * @param   severity	The severity level
+ * @param   message	The JSON message to log
+ * @return		A future for whether the entry was added
+ */
+future<bool> ManagementClient::addAuditEntryAsync(const std::string& code,
+				     const std::string& severity,
+				     const std::string& message)
+{
+	AuditEntry entry;
+	entry.payload = "{ \"source\" : \"" + code + "\", \"severity\" : \"" + severity
+				+ "\", \"details\" : " + message + " }";
+	entry.result = make_shared<promise<bool> >();
+	future<bool> result = entry.result->get_future();
+	bool notify;
+	{
+		lock_guard<mutex> guard(m_mtx_async);
+		if (m_audit_batch.empty())
+		{
+			m_audit_deadline = chrono::steady_clock::now()
+						+ chrono::milliseconds(m_audit_interval);
+		}
+		m_audit_batch.push_back(entry);
+		// Wake the thread to start the interval or send a full batch
+		notify = m_audit_batch.size() == 1 || m_audit_batch.size() >= m_audit_batch_size;
+		startAsyncThread();
+	}
+	if (notify)
+	{
+		m_async_cv.notify_one();
+	}
+	return result;
+}
+
+/**
+ * Set the batching of the audit entries added with addAuditEntryAsync
+ *
+ * @param size		The maximum number of entries sent with one request
+ * @param interval	The maximum time in milliseconds an entry is buffered
+ */
+void ManagementClient::setAuditBatching(unsigned int size, unsigned int interval)
+{
+	lock_guard<mutex> guard(m_mtx_async);
+	m_audit_batch_size = size ? size : 1;
+	m_audit_interval = interval;
+}
+
+/**
+ * Send a batch of audit entries to the core with a single request
+ * and fulfil the promise of each entry
+ *
+ * @param entries	The audit entries to send
+ */
+void ManagementClient::postAuditEntries(vector<AuditEntry>& entries)
+{
+	string payload = "[ ";
+	for (size_t i = 0; i < entries.size(); i++)
+	{
+		if (i)
+		{
+			payload += ", ";
+		}
+		payload += entries[i].payload;
+	}
+	payload += " ]";
+
+	bool ret = false;
+	try {
+		auto res = this->getHttpClient()->request("POST", "/fledge/audit", payload);
+		Document doc;
+		string content = res->content.string();
+		doc.Parse(content.c_str());
+		if (doc.HasParseError())
+		{
+			bool httpError = (isdigit(content[0]) && isdigit(content[1]) && isdigit(content[2]) && content[3]==':');
+			m_logger->error("%s addition of %d audit entries: %s\n",
+					httpError ? "HTTP error during" : "Failed to parse result of",
+					(int)entries.size(), content.c_str());
+		}
+		else if (doc.IsObject() && doc.HasMember("audit"))
+		{
+			ret = true;
+		}
+		else if (doc.IsObject() && doc.HasMember("message"))
+		{
+			m_logger->error("Failed to add %d audit entries: %s.",
+					(int)entries.size(), doc["message"].GetString());
+		}
+		else
+		{
+			m_logger->error("Failed to add %d audit entries: %s.",
+					(int)entries.size(), content.c_str());
+		}
+	} catch (const exception &e) {
+		m_logger->error("Failed to add %d audit entries: %s.", (int)entries.size(), e.what());
+	}
+	for (auto& entry : entries)
+	{
+		entry.result->set_value(ret);
+	}
+}
+
 /**
  * Checks and validate the JWT bearer token object as reference
  *
@@ -1032,6 +1568,7 @@ bool ManagementClient::refreshBearerToken(const string& currentToken,
 	{
 		// Remove old token from received ones
 		m_received_tokens.erase(currentToken);
+		m_reverified.erase(currentToken);
 	}
 	else
 	{
@@ -1049,6 +1586,13 @@ bool ManagementClient::refreshBearerToken(const string& currentToken,
  * Input token internal data will be set
  * with new values or cached ones
  *
+ * Verified tokens are cached until they expire, so only the first use
+ * of a token is verified by the core. A cached token that is close to
+ * expiry is verified again by the core in the background and removed
+ * from the cache if the core no longer accepts it. The signature of a
+ * token can only be checked by the core, but a token that has already
+ * expired according to its own claims is rejected without calling it.
+ *
  * @param bearerToken	The bearer token object
  * @return		True on success, false otherwise
  */
@@ -1060,83 +1604,141 @@ bool ManagementClient::verifyBearerToken(BearerToken& bearerToken)
 		return false;
 	}
 
-	bool ret = true;
 	const string& token = bearerToken.token();
+	unsigned long now = time(NULL);
 
 	// Check token already exists in cache:
-	map<string, BearerToken>::iterator item;
-	// Acquire lock
-	m_mtx_rTokens.lock();
+	{
+		lock_guard<mutex> guard(m_mtx_rTokens);
+		map<string, BearerToken>::iterator item = m_received_tokens.find(token);
+		if (item != m_received_tokens.end())
+		{
+			// Token is in the cache
+			unsigned long expiration = (*item).second.getExpiration();
+
+			// Check expiration
+			if (now >= expiration)
+			{
+				// Remove token from received ones
+				m_received_tokens.erase(item);
+				m_reverified.erase(token);
+
+				m_logger->error("Micro service bearer token expired.");
+				return false;
+			}
+
+			// Set input token object as per cached data
+			bearerToken = (*item).second;
 
-	item = m_received_tokens.find(token);
-	if (item  == m_received_tokens.end())
+#ifdef DEBUG_BEARER_TOKEN
+			m_logger->debug("Existing token already verified, claims %s:%s:%s:%ld",
+					bearerToken.getAudience().c_str(),
+					bearerToken.getSubject().c_str(),
+					bearerToken.getIssuer().c_str(),
+					bearerToken.getExpiration());
+#endif
+			// Check the token again with the core as it nears expiry
+			if (expiration - now <= BEARER_TOKEN_REVERIFY &&
+			    m_reverified.insert(token).second)
+			{
+				string reverify = token;
+				queueRequest([this, reverify]() { reverifyToken(reverify); });
+			}
+			return true;
+		}
+	}
+
+	// Token is not in the cache, reject it without calling the core if it has expired
+	unsigned long expiration = bearerToken.getClaimedExpiration();
+	if (expiration && now >= expiration)
 	{
-		// Token is not in the cache
-		bool verified = false;
-		// Token does not exist:
-		// Verify it by calling Fledge management endpoint
-		string url = "/fledge/service/verify_token";
-                string payload;
-                SimpleWeb::CaseInsensitiveMultimap header;
-                header.emplace("Authorization", "Bearer " + token);
-                auto res = this->getHttpClient()->request("POST", url.c_str(), payload, header);
-		string response = res->content.string();
+		m_logger->error("Micro service bearer token expired.");
+		return false;
+	}
+
+	// Verify it by calling Fledge management endpoint, the cache is
+	// not locked so that requests with cached tokens are not delayed
+	if (!verifyTokenWithCore(bearerToken))
+	{
+		m_logger->error("Micro service bearer token '%s' not verified.",
+				token.c_str());
+		return false;
+	}
 
-		// Parse JSON message and store claims in input token object
-		verified = bearerToken.verify(response);
-		if (verified)
+#ifdef DEBUG_BEARER_TOKEN
+	m_logger->debug("New token verified by core API endpoint, claims %s:%s:%s:%ld",
+			bearerToken.getAudience().c_str(),
+			bearerToken.getSubject().c_str(),
+			bearerToken.getIssuer().c_str(),
+			bearerToken.getExpiration());
+#endif
+
+	// Token verified, remove any expired tokens and store the token object
+	lock_guard<mutex> guard(m_mtx_rTokens);
+	for (auto it = m_received_tokens.begin(); it != m_received_tokens.end(); )
+	{
+		if (now >= it->second.getExpiration())
 		{
-			// Token verified, store the token object
-			m_received_tokens.emplace(token, bearerToken);
+			m_reverified.erase(it->first);
+			it = m_received_tokens.erase(it);
 		}
 		else
 		{
-			ret = false;
-			m_logger->error("Micro service bearer token '%s' not verified.",
-					token.c_str());
+			++it;
 		}
-#ifdef DEBUG_BEARER_TOKEN
-		m_logger->debug("New token verified by core API endpoint %d, claims %s:%s:%s:%ld",
-				ret,
-				bearerToken.getAudience().c_str(),
-				bearerToken.getSubject().c_str(),
-				bearerToken.getIssuer().c_str(),
-				bearerToken.getExpiration());
-#endif
 	}
-	else
-	{
-		// Token is in the cache
-		unsigned long expiration = (*item).second.getExpiration();
-		unsigned long now = time(NULL);
+	m_received_tokens.emplace(token, bearerToken);
 
-		// Check expiration
-		if (now >= expiration)
-		{
-			ret = false;
-			// Remove token from received ones
-			m_received_tokens.erase(token);
+	return true;
+}
 
-			m_logger->error("Micro service bearer token expired.");
-		}
+/**
+ * Verify a bearer token by calling the token verification
+ * entry point of the core. The claims of the token are set
+ * from the response.
+ *
+ * @param bearerToken	The bearer token object
+ * @return		True if the core verified the token
+ */
+bool ManagementClient::verifyTokenWithCore(BearerToken& bearerToken)
+{
+	string url = "/fledge/service/verify_token";
+	string payload;
+	SimpleWeb::CaseInsensitiveMultimap header;
+	header.emplace("Authorization", "Bearer " + bearerToken.token());
+	auto res = this->getHttpClient()->request("POST", url.c_str(), payload, header);
+	string response = res->content.string();
 
-		// Set input token object as per cached data
-		bearerToken = (*item).second;
+	// Parse JSON message and store claims in input token object
+	return bearerToken.verify(response);
+}
 
-#ifdef DEBUG_BEARER_TOKEN
-		m_logger->debug("Existing token already verified %d, claims %s:%s:%s:%ld",
-				ret,
-				(*item).second.getAudience().c_str(),
-				(*item).second.getSubject().c_str(),
-				(*item).second.getIssuer().c_str(),
-				(*item).second.getExpiration());
-#endif
+/**
+ * Check a cached token that is close to expiry with the core and remove
+ * it if the core no longer accepts it, such as a token that has been
+ * replaced by a refreshed token. The token is kept if the core can not
+ * be reached. Called on the asynchronous request thread.
+ *
+ * @param token		The bearer token to check
+ */
+void ManagementClient::reverifyToken(const string& token)
+{
+	bool verified = true;
+	try {
+		string value = token;
+		BearerToken bearerToken(value);
+		verified = verifyTokenWithCore(bearerToken);
+	} catch (exception& e) {
+		m_logger->warn("Unable to verify bearer token with the core: %s", e.what());
 	}
 
-	// Release lock
-	m_mtx_rTokens.unlock();
-
-	return ret;
+	if (!verified)
+	{
+		lock_guard<mutex> guard(m_mtx_rTokens);
+		m_received_tokens.erase(token);
+		m_reverified.erase(token);
+		m_logger->warn("Micro service bearer token is no longer accepted by the core");
+	}
 }
 
 /**
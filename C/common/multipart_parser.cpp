@@ -0,0 +1,379 @@
+/*
+ * Fledge utilities functions for handling HTTP form data upload
+ * with multipart data
+ *
+ * Copyright (c) 2026 Dianomic Systems
+ *
+ * Released under the Apache 2.0 Licence
+ *
+ * Author: agent
+ */
+
+#include <multipart_parser.h>
+#include <logger.h>
+#include <string_utils.h>
+#include <algorithm>
+#include <fcntl.h>
+#include <unistd.h>
+#include <string.h>
+#include <errno.h>
+
+using namespace std;
+
+/**
+ * Create a parser for the content of a multipart/form-data request
+ *
+ * @param boundary	The boundary of the Content-Type header, without
+ *			the two leading '-'
+ */
+MultipartParser::MultipartParser(const string& boundary) : m_state(StatePreamble), m_fd(-1)
+{
+	m_delimiter = "\r\n--" + boundary;
+	for (int i = 0; i < 256; i++)
+	{
+		m_skip[i] = m_delimiter.length();
+	}
+	for (size_t i = 0; i < m_delimiter.length() - 1; i++)
+	{
+		m_skip[(uint8_t)m_delimiter[i]] = m_delimiter.length() - 1 - i;
+	}
+	// The first boundary has no CRLF before it, unless there is a preamble
+	m_pending = "\r\n";
+}
+
+/**
+ * Destroy the parser, a file left incomplete is removed
+ */
+MultipartParser::~MultipartParser()
+{
+	if (m_fd != -1)
+	{
+		close(m_fd);
+		unlink(m_files[m_field].c_str());
+	}
+}
+
+/**
+ * Save the content of a field to a file as it is parsed
+ *
+ * @param field		The name of the field
+ * @param fileName	The file to save the content to
+ */
+void MultipartParser::saveFile(const string& field, const string& fileName)
+{
+	m_files[field] = fileName;
+}
+
+/**
+ * Parse the next piece of the content
+ *
+ * @param data	The piece of content
+ * @param size	The size of the piece
+ * @return bool	False if the content is not valid multipart content
+ *		or a file could not be written
+ */
+bool MultipartParser::parse(const uint8_t *data, size_t size)
+{
+	if (m_state == StateError)
+	{
+		return false;
+	}
+	if (m_state == StateEnd)
+	{
+		return true;
+	}
+	m_pending.append((const char *)data, size);
+
+	size_t pos = 0;
+	bool more = true;
+	while (more && m_state != StateEnd)
+	{
+		switch (m_state)
+		{
+			case StatePreamble:
+			case StateBody:
+			{
+				size_t found = findDelimiter(pos);
+				size_t end = found;
+				if (found == string::npos)
+				{
+					// Keep back what may be the start of a delimiter
+					end = m_pending.length() > m_delimiter.length() - 1
+						? m_pending.length() - (m_delimiter.length() - 1) : 0;
+					end = max(end, pos);
+					more = false;
+				}
+				if (m_state == StateBody && end > pos
+						&& !partData((const uint8_t *)m_pending.data() + pos, end - pos))
+				{
+					return false;
+				}
+				pos = end;
+				if (found != string::npos)
+				{
+					if (m_state == StateBody && !endPart())
+					{
+						return false;
+					}
+					pos += m_delimiter.length();
+					m_state = StateBoundary;
+				}
+				break;
+			}
+			case StateBoundary:
+				if (m_pending.length() - pos < 2)
+				{
+					more = false;
+				}
+				else if (m_pending.compare(pos, 2, "--") == 0)
+				{
+					m_state = StateEnd;
+				}
+				else if (m_pending.compare(pos, 2, "\r\n") == 0)
+				{
+					pos += 2;
+					m_state = StateHeaders;
+				}
+				else
+				{
+					return fail("unexpected content after a boundary");
+				}
+				break;
+			case StateHeaders:
+			{
+				size_t found = m_pending.find("\r\n\r\n", pos);
+				if (found == string::npos)
+				{
+					if (m_pending.length() - pos > MULTIPART_MAX_HEADERS)
+					{
+						return fail("the headers of a part are too large");
+					}
+					more = false;
+					break;
+				}
+				if (!beginPart(m_pending.substr(pos, found - pos)))
+				{
+					return false;
+				}
+				pos = found + 4;
+				m_state = StateBody;
+				break;
+			}
+			default:
+				more = false;
+				break;
+		}
+	}
+	m_pending.erase(0, pos);
+	return true;
+}
+
+/**
+ * Return if the content had a part for a field
+ *
+ * @param field	The name of the field
+ * @return bool	True if the field was parsed
+ */
+bool MultipartParser::hasField(const string& field) const
+{
+	return m_filenames.find(field) != m_filenames.end();
+}
+
+/**
+ * Return the value of a field that was not saved to a file
+ *
+ * @param field		The name of the field
+ * @return string	The value of the field, empty if there is none
+ */
+string MultipartParser::getValue(const string& field) const
+{
+	auto it = m_values.find(field);
+	return it == m_values.end() ? string() : it->second;
+}
+
+/**
+ * Return the filename a field was uploaded with
+ *
+ * @param field		The name of the field
+ * @return string	The filename, empty if the field was not a file
+ */
+string MultipartParser::getFilename(const string& field) const
+{
+	auto it = m_filenames.find(field);
+	return it == m_filenames.end() ? string() : it->second;
+}
+
+/**
+ * Find the next delimiter in the pending content with a
+ * Boyer-Moore-Horspool search
+ *
+ * @param from		The position to search from
+ * @return size_t	The position of the delimiter or string::npos
+ */
+size_t MultipartParser::findDelimiter(size_t from) const
+{
+	const uint8_t *text = (const uint8_t *)m_pending.data();
+	const uint8_t *pattern = (const uint8_t *)m_delimiter.data();
+	size_t length = m_delimiter.length();
+	size_t last = length - 1;
+
+	for (size_t i = from; i + length <= m_pending.length(); i += m_skip[text[i + last]])
+	{
+		if (text[i + last] == pattern[last] && memcmp(text + i, pattern, last) == 0)
+		{
+			return i;
+		}
+	}
+	return string::npos;
+}
+
+/**
+ * Start a new part from its headers
+ *
+ * @param headers	The headers of the part
+ * @return bool		False if the part can not be saved
+ */
+bool MultipartParser::beginPart(const string& headers)
+{
+	string name, filename;
+	size_t start = 0;
+	while (start < headers.length())
+	{
+		size_t end = headers.find("\r\n", start);
+		if (end == string::npos)
+		{
+			end = headers.length();
+		}
+		string line = headers.substr(start, end - start);
+		start = end + 2;
+
+		size_t colon = line.find(':');
+		if (colon == string::npos || strncasecmp(line.c_str(), "Content-Disposition", colon) != 0)
+		{
+			continue;
+		}
+		// form-data; name="field"; filename="file"
+		stringstream params(line.substr(colon + 1));
+		string param;
+		while (getline(params, param, ';'))
+		{
+			param = StringTrim(param);
+			size_t equals = param.find('=');
+			if (equals == string::npos)
+			{
+				continue;
+			}
+			string value = param.substr(equals + 1);
+			StringStripQuotes(value);
+			if (param.compare(0, equals, "name") == 0)
+			{
+				name = value;
+			}
+			else if (param.compare(0, equals, "filename") == 0)
+			{
+				filename = value;
+			}
+		}
+	}
+
+	m_field = name;
+	m_filenames[name] = filename;
+	auto it = m_files.find(name);
+	if (it != m_files.end())
+	{
+		m_fd = open(it->second.c_str(), O_WRONLY | O_CREAT | O_TRUNC, (mode_t)0644);
+		if (m_fd == -1)
+		{
+			char errBuf[128];
+			char *e = strerror_r(errno, errBuf, sizeof(errBuf));
+			Logger::getLogger()->error("Error while creating filename '%s': %s",
+						it->second.c_str(), e);
+			m_state = StateError;
+			return false;
+		}
+	}
+	else
+	{
+		m_values[name].clear();
+	}
+	return true;
+}
+
+/**
+ * Add content to the current part
+ *
+ * @param data	The content
+ * @param size	The size of the content
+ * @return bool	False if the content could not be saved
+ */
+bool MultipartParser::partData(const uint8_t *data, size_t size)
+{
+	if (m_fd == -1)
+	{
+		string& value = m_values[m_field];
+		if (value.length() + size > MULTIPART_MAX_VALUE)
+		{
+			return fail("the value of a field is too large");
+		}
+		value.append((const char *)data, size);
+		return true;
+	}
+	while (size > 0)
+	{
+		ssize_t n = write(m_fd, data, size);
+		if (n == -1)
+		{
+			if (errno == EINTR)
+			{
+				continue;
+			}
+			char errBuf[128];
+			char *e = strerror_r(errno, errBuf, sizeof(errBuf));
+			Logger::getLogger()->error("Error while writing to file '%s': %s",
+						m_files[m_field].c_str(), e);
+			m_state = StateError;
+			return false;
+		}
+		data += n;
+		size -= n;
+	}
+	return true;
+}
+
+/**
+ * Complete the current part
+ *
+ * @return bool	False if the file of the part could not be written
+ */
+bool MultipartParser::endPart()
+{
+	if (m_fd == -1)
+	{
+		return true;
+	}
+	int rval = close(m_fd);
+	m_fd = -1;
+	if (rval == -1)
+	{
+		char errBuf[128];
+		char *e = strerror_r(errno, errBuf, sizeof(errBuf));
+		Logger::getLogger()->error("Error while writing to file '%s': %s",
+					m_files[m_field].c_str(), e);
+		m_state = StateError;
+		return false;
+	}
+	return true;
+}
+
+/**
+ * Stop parsing content that is not valid
+ *
+ * @param reason	Why the content is not valid
+ * @return bool		Always false
+ */
+bool MultipartParser::fail(const char *reason)
+{
+	Logger::getLogger()->error("Invalid multipart content, %s", reason);
+	m_state = StateError;
+	return false;
+}
@@ -21,10 +21,19 @@ using namespace rapidjson;
  * PluginData constructor
  * @param client	StorageClient pointer
  */
-PluginData::PluginData(StorageClient* client) : m_storage(client)
+PluginData::PluginData(StorageClient* client) : m_storage(client),
+	m_flushInterval(PLUGIN_DATA_FLUSH_INTERVAL)
 {
 }
 
+/**
+ * PluginData destructor, any deferred data is written
+ */
+PluginData::~PluginData()
+{
+	flush();
+}
+
 /**
  * Load stored data for a given key.
  *
@@ -33,6 +42,16 @@ PluginData::PluginData(StorageClient* client) : m_storage(client)
  */
 string PluginData::loadStoredData(const string& key)
 {
+	{
+		// Data persisted but not yet written is the latest
+		lock_guard<mutex> guard(m_mutex);
+		auto it = m_pending.find(key);
+		if (it != m_pending.end())
+		{
+			return it->second;
+		}
+	}
+
 	// Set empty JSON dcocument
 	string foundData("{}");
 	const Condition conditionId(Equals);
@@ -77,6 +96,9 @@ string PluginData::loadStoredData(const string& key)
 	// Free resultset
 	delete pluginData;
 
+	lock_guard<mutex> guard(m_mutex);
+	m_stored[key] = foundData;
+
 	// Return found data
 	return foundData;
 }
@@ -84,12 +106,20 @@ string PluginData::loadStoredData(const string& key)
 /**
  * Store plugin data for a given key.
  *
+ * Data that is the same as the data last written for the key is not
+ * written again. Deferred data replaces any data of the key not yet
+ * written, the data of all the keys is written together once the
+ * oldest has been held for the flush interval, or when data is
+ * persisted with PersistNow, or by flush.
+ *
  * @param    key	The given key
  * @param    data	The JSON data to save (as string)
+ * @param    durability	When the data is written to storage
  * @return		true on success, false otherwise. 
  */
 bool PluginData::persistPluginData(const string& key,
-				   const string& data)
+				   const string& data,
+				   Durability durability)
 {
 	Document JSONData;
 	JSONData.Parse(data.c_str());
@@ -99,7 +129,94 @@ bool PluginData::persistPluginData(const string& key,
 		return false;
 	}	
 
+	// Compare the data in the form it is read back from storage
+	StringBuffer buffer;
+	Writer<StringBuffer> writer(buffer);
+	JSONData.Accept(writer);
+	string compact(buffer.GetString(), buffer.GetSize());
+
+	lock_guard<mutex> guard(m_mutex);
+	auto stored = m_stored.find(key);
+	bool unchanged = stored != m_stored.end() && stored->second.compare(compact) == 0;
+	if (durability == PersistDeferred)
+	{
+		auto now = chrono::steady_clock::now();
+		if (unchanged)
+		{
+			m_pending.erase(key);
+			return true;
+		}
+		if (m_pending.empty())
+		{
+			m_pendingSince = now;
+		}
+		m_pending[key] = compact;
+		if (now - m_pendingSince < chrono::seconds(m_flushInterval))
+		{
+			return true;
+		}
+		return flushPending();
+	}
+
+	m_pending.erase(key);
+	bool ret = unchanged || writeData(key, compact);
+	if (!m_pending.empty())
+	{
+		ret = flushPending() && ret;
+	}
+	return ret;
+}
+
+/**
+ * Write the data persisted with PersistDeferred that has not
+ * been written yet
+ *
+ * @return	true on success, false if any data could not be written
+ */
+bool PluginData::flush()
+{
+	lock_guard<mutex> guard(m_mutex);
+	return flushPending();
+}
+
+/**
+ * Write the deferred data, the data that can not be written is kept
+ * to be written again later. The caller holds m_mutex.
+ *
+ * @return	true on success, false if any data could not be written
+ */
+bool PluginData::flushPending()
+{
 	bool ret = true;
+	for (auto it = m_pending.begin(); it != m_pending.end(); )
+	{
+		if (writeData(it->first, it->second))
+		{
+			it = m_pending.erase(it);
+		}
+		else
+		{
+			ret = false;
+			++it;
+		}
+	}
+	m_pendingSince = chrono::steady_clock::now();
+	return ret;
+}
+
+/**
+ * Write the data of a key to the storage table, the row of the key
+ * is updated or inserted if there is none. The caller holds m_mutex.
+ *
+ * @param    key	The given key
+ * @param    data	The JSON data to save (as string)
+ * @return		true on success, false otherwise.
+ */
+bool PluginData::writeData(const string& key,
+			   const string& data)
+{
+	Document JSONData;
+	JSONData.Parse(data.c_str());
 
 	// Prepare WHERE key = 
 	const Condition conditionUpdate(Equals);
@@ -122,10 +239,11 @@ bool PluginData::persistPluginData(const string& key,
 		if (m_storage->insertTable("plugin_data",
 					   insertData) == -1)
 		{
-			ret = false;
+			Logger::getLogger()->warn("Failed to persist data for %s, unable to insert into storage", key.c_str());
+			return false;
 		}
 	}
 
-	Logger::getLogger()->warn("Failed to persist data for %s, unable to insert into storage", key.c_str());
-	return ret;
+	m_stored[key] = data;
+	return true;
 }
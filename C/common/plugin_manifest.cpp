@@ -0,0 +1,214 @@
+/*
+ * Fledge plugin manifest
+ *
+ * Copyright (c) 2026 Dianomic Systems
+ *
+ * Released under the Apache 2.0 Licence
+ *
+ * Author: agent
+ */
+#include <plugin_manifest.h>
+#include <logger.h>
+#include <rapidjson/document.h>
+#include <rapidjson/writer.h>
+#include <rapidjson/stringbuffer.h>
+#include <fstream>
+#include <sstream>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <stdio.h>
+
+using namespace std;
+using namespace rapidjson;
+
+/**
+ * Construct a plugin manifest, the manifest is read from the
+ * file the first time a plugin is looked up
+ *
+ * @param file	The file the manifest is persisted in
+ */
+PluginManifest::PluginManifest(const string& file) : m_file(file), m_loaded(false)
+{
+}
+
+/**
+ * Destructor for the plugin manifest
+ */
+PluginManifest::~PluginManifest()
+{
+}
+
+/**
+ * Find where a plugin was found before
+ *
+ * @param type	The plugin type
+ * @param name	The plugin name
+ * @param path	Set to the path of the plugin
+ * @param impl	Set to the implementation type of the plugin
+ * @return bool	True if the plugin is in the manifest and is unchanged
+ */
+bool PluginManifest::find(const string& type, const string& name, string& path, int& impl)
+{
+	if (!m_loaded)
+	{
+		load();
+	}
+	auto it = m_entries.find(type + "/" + name);
+	if (it == m_entries.end())
+	{
+		return false;
+	}
+	const Entry& entry = it->second;
+	uint64_t fileTime, dirTime;
+	if (!modified(entry.m_path, fileTime) || fileTime != entry.m_modified
+			|| !modified(directory(entry.m_path), dirTime) || dirTime != entry.m_dirModified)
+	{
+		// The plugin has been updated, removed or joined by other files
+		m_entries.erase(it);
+		return false;
+	}
+	path = entry.m_path;
+	impl = entry.m_impl;
+	return true;
+}
+
+/**
+ * Add a plugin that has been found to the manifest and persist
+ * the manifest
+ *
+ * @param type	The plugin type
+ * @param name	The plugin name
+ * @param path	The path of the plugin
+ * @param impl	The implementation type of the plugin
+ */
+void PluginManifest::add(const string& type, const string& name, const string& path, int impl)
+{
+	Entry entry;
+	entry.m_path = path;
+	entry.m_impl = impl;
+	if (!modified(path, entry.m_modified) || !modified(directory(path), entry.m_dirModified))
+	{
+		return;
+	}
+	if (!m_loaded)
+	{
+		load();
+	}
+	m_entries[type + "/" + name] = entry;
+	save();
+}
+
+/**
+ * Read the manifest from the file, a missing or unreadable
+ * file gives an empty manifest
+ */
+void PluginManifest::load()
+{
+	m_loaded = true;
+	ifstream ifs(m_file.c_str());
+	if (!ifs)
+	{
+		return;
+	}
+	stringstream content;
+	content << ifs.rdbuf();
+
+	Document doc;
+	doc.Parse(content.str().c_str());
+	if (doc.HasParseError() || !doc.IsObject())
+	{
+		Logger::getLogger()->warn("Ignoring the plugin manifest %s as it is not valid JSON", m_file.c_str());
+		return;
+	}
+	for (auto& m : doc.GetObject())
+	{
+		const Value& v = m.value;
+		if (!v.IsObject() || !v.HasMember("path") || !v["path"].IsString()
+				|| !v.HasMember("impl") || !v["impl"].IsInt()
+				|| !v.HasMember("modified") || !v["modified"].IsUint64()
+				|| !v.HasMember("dirModified") || !v["dirModified"].IsUint64())
+		{
+			continue;
+		}
+		Entry entry;
+		entry.m_path = v["path"].GetString();
+		entry.m_impl = v["impl"].GetInt();
+		entry.m_modified = v["modified"].GetUint64();
+		entry.m_dirModified = v["dirModified"].GetUint64();
+		m_entries[m.name.GetString()] = entry;
+	}
+}
+
+/**
+ * Write the manifest to the file. The manifest is written to a
+ * temporary file that is renamed so that other processes never
+ * read a partial manifest.
+ */
+void PluginManifest::save()
+{
+	StringBuffer buffer;
+	Writer<StringBuffer> writer(buffer);
+	writer.StartObject();
+	for (auto& it : m_entries)
+	{
+		writer.Key(it.first.c_str());
+		writer.StartObject();
+		writer.Key("path");
+		writer.String(it.second.m_path.c_str());
+		writer.Key("impl");
+		writer.Int(it.second.m_impl);
+		writer.Key("modified");
+		writer.Uint64(it.second.m_modified);
+		writer.Key("dirModified");
+		writer.Uint64(it.second.m_dirModified);
+		writer.EndObject();
+	}
+	writer.EndObject();
+
+	string tmp = m_file + "." + to_string(getpid());
+	ofstream ofs(tmp.c_str(), ios::out | ios::trunc);
+	if (ofs)
+	{
+		ofs << buffer.GetString();
+		ofs.close();
+	}
+	if (!ofs || rename(tmp.c_str(), m_file.c_str()) != 0)
+	{
+		Logger::getLogger()->debug("Unable to write the plugin manifest %s", m_file.c_str());
+		unlink(tmp.c_str());
+	}
+}
+
+/**
+ * Return the modification time of a file or directory
+ *
+ * @param path	The path of the file or directory
+ * @param time	Set to the modification time in nanoseconds
+ * @return bool	False if the path does not exist
+ */
+bool PluginManifest::modified(const string& path, uint64_t& time)
+{
+	struct stat st;
+	if (stat(path.c_str(), &st) != 0)
+	{
+		return false;
+	}
+	time = (uint64_t)st.st_mtim.tv_sec * 1000000000 + st.st_mtim.tv_nsec;
+	return true;
+}
+
+/**
+ * Return the directory part of a path
+ *
+ * @param path	The path of a file
+ * @return string	The directory that holds the file
+ */
+string PluginManifest::directory(const string& path)
+{
+	size_t pos = path.rfind('/');
+	if (pos == string::npos)
+	{
+		return ".";
+	}
+	return pos == 0 ? "/" : path.substr(0, pos);
+}
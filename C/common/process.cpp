@@ -15,13 +15,26 @@
 #include <logger.h>
 #include <process.h>
 #include <service_record.h>
+#include <utils.h>
 #include <signal.h>
 #include <dlfcn.h>
 #include <execinfo.h>
 #include <cxxabi.h>
+#include <fstream>
+#include <sys/socket.h>
+#include <netdb.h>
+#include <poll.h>
+#include <fcntl.h>
+#include <sys/time.h>
+#include <unistd.h>
+#include <errno.h>
 
 
 #define LOG_SERVICE_NAME  "Fledge Process"
+#define STORAGE_CACHE_FILE "/var/run/storage.service"	// Under the data directory
+#define STORAGE_PROBE_TIMEOUT 250				// Milliseconds
+#define STORAGE_PROBE_RESPONSE 8192				// Bytes of the metrics read to find the storage service
+#define STORAGE_PROBE_METRIC "fledge_storage_"			// Prefix of the metrics of the storage service
 
 using namespace std;
 
@@ -133,17 +146,22 @@ FledgeProcess::FledgeProcess(int argc, char** argv) :
 	// Connection to Fledge core microservice
 	m_client = new ManagementClient(m_core_mngt_host, m_core_mngt_port);
 
-	// Storage layer handle
+	// Storage layer handle, the record cached by a previous task is
+	// used if the storage service still answers at its address
 	ServiceRecord storageInfo("Fledge Storage");
 
-	if (!m_client->getService(storageInfo))
+	if (!getCachedStorageService(storageInfo))
 	{
-		string errMsg("Unable to find storage service at ");
-		errMsg += m_core_mngt_host;
-		errMsg += ':';
-		errMsg += to_string(m_core_mngt_port);
+		if (!m_client->getService(storageInfo))
+		{
+			string errMsg("Unable to find storage service at ");
+			errMsg += m_core_mngt_host;
+			errMsg += ':';
+			errMsg += to_string(m_core_mngt_port);
 
-		throw runtime_error(errMsg);
+			throw runtime_error(errMsg);
+		}
+		cacheStorageService(storageInfo);
 	}
 
 	if (!(m_storage = new StorageClient(storageInfo.getAddress(),
@@ -156,6 +174,9 @@ FledgeProcess::FledgeProcess(int argc, char** argv) :
 
 		throw runtime_error(errMsg);
 	}
+	// Ask the core again in the next task if the storage service goes away
+	string cacheFile = getDataDir() + STORAGE_CACHE_FILE;
+	m_storage->setUnreachable([cacheFile]() { unlink(cacheFile.c_str()); });
 }
 
 /**
@@ -179,6 +200,169 @@ string FledgeProcess::getArgValue(const string& name) const
 	return string("");
 }
 
+/**
+ * Fill a storage service record from the record cached by a previous
+ * task run. The cache is only used if it was written for the same core
+ * and the storage service still answers requests at its address, a
+ * restart of Fledge gives the services new ports and the old port of
+ * the storage service may since have been taken by another service.
+ *
+ * @param storageInfo	The record to fill
+ * @return bool		True if the cached record can be used
+ */
+bool FledgeProcess::getCachedStorageService(ServiceRecord& storageInfo) const
+{
+	ifstream cache(getDataDir() + STORAGE_CACHE_FILE);
+	string coreHost, address;
+	int corePort = 0;
+	unsigned short port = 0;
+	if (!(cache >> coreHost >> corePort >> address >> port))
+	{
+		return false;
+	}
+	if (coreHost != m_core_mngt_host || corePort != m_core_mngt_port || port == 0)
+	{
+		return false;
+	}
+	if (!isStorageService(address, port))
+	{
+		m_logger->info("The cached storage service %s:%d is not available, asking the core",
+				address.c_str(), port);
+		return false;
+	}
+	storageInfo.setAddress(address);
+	storageInfo.setPort(port);
+	return true;
+}
+
+/**
+ * Cache the storage service record returned by the core for the
+ * next task runs. The record is written to a temporary file that is
+ * then renamed, so that tasks starting at the same time never read
+ * a partial record. Failing to write the cache is not an error.
+ *
+ * @param storageInfo	The storage service record
+ */
+void FledgeProcess::cacheStorageService(ServiceRecord& storageInfo) const
+{
+	string cacheFile = getDataDir() + STORAGE_CACHE_FILE;
+	string tmpFile = cacheFile + "." + to_string(getpid());
+	{
+		ofstream cache(tmpFile);
+		if (!cache)
+		{
+			return;
+		}
+		cache << m_core_mngt_host << " " << m_core_mngt_port << " "
+			<< storageInfo.getAddress() << " " << storageInfo.getPort() << endl;
+		if (!cache)
+		{
+			cache.close();
+			unlink(tmpFile.c_str());
+			return;
+		}
+	}
+	if (rename(tmpFile.c_str(), cacheFile.c_str()) == -1)
+	{
+		unlink(tmpFile.c_str());
+	}
+}
+
+/**
+ * Check that the storage service answers at an address by requesting
+ * its metrics, which only the storage service returns. The connection
+ * and each read and write wait at most STORAGE_PROBE_TIMEOUT milliseconds.
+ *
+ * @param address	The address of the service
+ * @param port		The port of the service
+ * @return bool		True if the storage service answered
+ */
+bool FledgeProcess::isStorageService(const string& address, unsigned short port) const
+{
+	struct addrinfo hints, *res;
+	memset(&hints, 0, sizeof(hints));
+	hints.ai_family = AF_UNSPEC;
+	hints.ai_socktype = SOCK_STREAM;
+	if (getaddrinfo(address.c_str(), to_string(port).c_str(), &hints, &res) != 0)
+	{
+		return false;
+	}
+
+	int sock = -1;
+	for (struct addrinfo *ai = res; ai && sock == -1; ai = ai->ai_next)
+	{
+		sock = socket(ai->ai_family, ai->ai_socktype, ai->ai_protocol);
+		if (sock == -1)
+		{
+			continue;
+		}
+		int flags = fcntl(sock, F_GETFL, 0);
+		fcntl(sock, F_SETFL, flags | O_NONBLOCK);
+		bool connected = false;
+		if (connect(sock, ai->ai_addr, ai->ai_addrlen) == 0)
+		{
+			connected = true;
+		}
+		else if (errno == EINPROGRESS)
+		{
+			struct pollfd pfd = { sock, POLLOUT, 0 };
+			int error = 0;
+			socklen_t len = sizeof(error);
+			if (poll(&pfd, 1, STORAGE_PROBE_TIMEOUT) == 1
+				&& getsockopt(sock, SOL_SOCKET, SO_ERROR, &error, &len) == 0
+				&& error == 0)
+			{
+				connected = true;
+			}
+		}
+		if (connected)
+		{
+			fcntl(sock, F_SETFL, flags);
+		}
+		else
+		{
+			close(sock);
+			sock = -1;
+		}
+	}
+	freeaddrinfo(res);
+	if (sock == -1)
+	{
+		return false;
+	}
+
+	struct timeval timeout;
+	timeout.tv_sec = STORAGE_PROBE_TIMEOUT / 1000;
+	timeout.tv_usec = (STORAGE_PROBE_TIMEOUT % 1000) * 1000;
+	setsockopt(sock, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+	setsockopt(sock, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout));
+
+	string request = "GET /storage/metrics HTTP/1.1\r\nHost: " + address
+			+ "\r\nConnection: close\r\n\r\n";
+	bool storage = false;
+	if (send(sock, request.c_str(), request.length(), MSG_NOSIGNAL) == (ssize_t)request.length())
+	{
+		// The status line and the name of the first metric are enough
+		string response;
+		char buf[1024];
+		ssize_t n;
+		while (response.length() < STORAGE_PROBE_RESPONSE
+				&& (n = recv(sock, buf, sizeof(buf), 0)) > 0)
+		{
+			response.append(buf, n);
+			if (response.find(STORAGE_PROBE_METRIC) != string::npos)
+			{
+				break;
+			}
+		}
+		storage = response.compare(0, 7, "HTTP/1.") == 0
+			&& response.compare(8, 4, " 200") == 0
+			&& response.find(STORAGE_PROBE_METRIC) != string::npos;
+	}
+	close(sock);
+	return storage;
+}
+
 /**
  * Return storage client
  */
@@ -0,0 +1,207 @@
+/*
+ * Fledge Python sub-interpreter.
+ *
+ * Copyright (c) 2026 Dianomic Systems
+ *
+ * Released under the Apache 2.0 Licence
+ *
+ * Author: agent
+ */
+#include <pyinterpreter.h>
+#include <pyruntime.h>
+#include <logger.h>
+#include <stdexcept>
+#include <string.h>
+
+using namespace std;
+
+// Sub-interpreters with their own GIL were added in Python 3.12
+#define PY_OWN_GIL	(PY_VERSION_HEX >= 0x030C0000)
+
+/**
+ * Create a sub-interpreter with its own GIL. The calling thread must
+ * not hold the GIL.
+ *
+ * @param paths	Directories to add to the Python path of the sub-interpreter
+ */
+PythonInterpreter::PythonInterpreter(const vector<string>& paths) : m_interpreter(NULL)
+{
+#if PY_OWN_GIL
+	PythonRuntime::getPythonRuntime();
+
+	PyGILState_STATE state = PyGILState_Ensure();
+	PyThreadState *mainState = PyThreadState_Get();
+
+	PyInterpreterConfig config;
+	memset(&config, 0, sizeof(config));
+	config.use_main_obmalloc = 0;
+	config.allow_fork = 0;
+	config.allow_exec = 0;
+	config.allow_threads = 1;
+	config.allow_daemon_threads = 0;
+	config.check_multi_interp_extensions = 1;
+	config.gil = PyInterpreterConfig_OWN_GIL;
+
+	// On success the thread state of the new interpreter is current and
+	// holds its GIL, the GIL of the main interpreter has been released
+	PyThreadState *tstate = NULL;
+	PyStatus status = Py_NewInterpreterFromConfig(&tstate, &config);
+	if (PyStatus_Exception(status) || !tstate)
+	{
+		PyThreadState_Swap(mainState);
+		PyGILState_Release(state);
+		throw runtime_error(string("Unable to create a Python sub-interpreter: ")
+				+ (status.err_msg ? status.err_msg : "unknown error"));
+	}
+	m_interpreter = PyThreadState_GetInterpreter(tstate);
+	m_threads[this_thread::get_id()] = tstate;
+
+	PyObject *sysPath = PySys_GetObject((char *)"path");
+	for (auto& path : paths)
+	{
+		PyObject *dir = PyUnicode_FromString(path.c_str());
+		PyList_Append(sysPath, dir);
+		Py_CLEAR(dir);
+	}
+
+	PyEval_SaveThread();
+	PyEval_RestoreThread(mainState);
+	PyGILState_Release(state);
+#else
+	throw runtime_error("Python sub-interpreters with their own GIL require Python 3.12 or later");
+#endif
+}
+
+/**
+ * Destroy the sub-interpreter. The calling thread must not hold any GIL
+ * and no other thread may be attached to the sub-interpreter.
+ */
+PythonInterpreter::~PythonInterpreter()
+{
+#if PY_OWN_GIL
+	acquire();
+	lock_guard<mutex> guard(m_mutex);
+	PyThreadState *current = PyThreadState_Get();
+	for (auto& thread : m_threads)
+	{
+		if (thread.second != current)
+		{
+			PyThreadState_Clear(thread.second);
+			PyThreadState_Delete(thread.second);
+		}
+	}
+	m_threads.clear();
+	Py_EndInterpreter(current);
+#endif
+}
+
+/**
+ * Attach the calling thread to the sub-interpreter and take its GIL
+ */
+void PythonInterpreter::acquire()
+{
+#if PY_OWN_GIL
+	PyThreadState *tstate;
+	{
+		lock_guard<mutex> guard(m_mutex);
+		auto it = m_threads.find(this_thread::get_id());
+		if (it == m_threads.end())
+		{
+			tstate = PyThreadState_New(m_interpreter);
+			m_threads[this_thread::get_id()] = tstate;
+		}
+		else
+		{
+			tstate = it->second;
+		}
+	}
+	PyEval_RestoreThread(tstate);
+#endif
+}
+
+/**
+ * Release the GIL of the sub-interpreter and detach the calling thread
+ */
+void PythonInterpreter::release()
+{
+#if PY_OWN_GIL
+	PyEval_SaveThread();
+#endif
+}
+
+/**
+ * Return true if the Python runtime supports sub-interpreters with their
+ * own GIL
+ */
+bool PythonInterpreter::isSupported()
+{
+	return PY_OWN_GIL;
+}
+
+/**
+ * Return true if the calling thread is attached to a sub-interpreter
+ */
+bool PythonInterpreter::inSubInterpreter()
+{
+#if PY_OWN_GIL
+#if PY_VERSION_HEX >= 0x030D0000
+	PyThreadState *tstate = PyThreadState_GetUnchecked();
+#else
+	PyThreadState *tstate = _PyThreadState_UncheckedGet();
+#endif
+	return tstate && PyThreadState_GetInterpreter(tstate) != PyInterpreterState_Main();
+#else
+	return false;
+#endif
+}
+
+/**
+ * Take the GIL of the main interpreter, as PyGILState_Ensure, unless the
+ * calling thread is attached to a sub-interpreter. The thread then already
+ * holds the GIL of the sub-interpreter and PyGILState_Ensure would attach
+ * it to the main interpreter instead.
+ *
+ * Threads that call into both the main interpreter and sub-interpreters
+ * must use this rather than PyGILState_Ensure.
+ *
+ * @return The state to pass to releaseGIL
+ */
+PyGILState_STATE PythonInterpreter::ensureGIL()
+{
+	if (inSubInterpreter())
+	{
+		return PyGILState_LOCKED;
+	}
+#if PY_OWN_GIL
+	// PyGILState_Ensure attaches the last thread state the thread attached,
+	// if that was a thread state of a sub-interpreter a thread state of the
+	// main interpreter must be attached once to take its place. That thread
+	// state is kept for the life of the thread.
+	static thread_local PyThreadState *mainState = NULL;
+	PyThreadState *last = PyGILState_GetThisThreadState();
+	if (last && PyThreadState_GetInterpreter(last) != PyInterpreterState_Main())
+	{
+		if (!mainState)
+		{
+			mainState = PyThreadState_New(PyInterpreterState_Main());
+		}
+		PyEval_RestoreThread(mainState);
+		PyEval_SaveThread();
+	}
+#endif
+	return PyGILState_Ensure();
+}
+
+/**
+ * Release the GIL taken by ensureGIL
+ *
+ * @param state	The state returned by ensureGIL
+ */
+void PythonInterpreter::releaseGIL(PyGILState_STATE state)
+{
+	if (inSubInterpreter())
+	{
+		return;
+	}
+	PyGILState_Release(state);
+}
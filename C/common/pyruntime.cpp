@@ -13,6 +13,10 @@
 #include <Python.h>
 #include <stdexcept>
 #include <stdarg.h>
+#include <stdlib.h>
+#include <mutex>
+#include <thread>
+#include <chrono>
 
 
 using namespace std;
@@ -20,6 +24,9 @@ using namespace std;
 
 PythonRuntime *PythonRuntime::m_instance = 0;
 
+// The runtime may be created by a plugin and by the preloading thread at once
+static mutex	runtimeMutex;
+
 /**
  * Get PythonRuntime singleton instance for the process
  *
@@ -27,6 +34,7 @@ PythonRuntime *PythonRuntime::m_instance = 0;
  */
 PythonRuntime *PythonRuntime::getPythonRuntime()
 {
+	lock_guard<mutex> guard(runtimeMutex);
 	if (!m_instance)
 	{
 		m_instance = new PythonRuntime;
@@ -34,6 +42,71 @@ PythonRuntime *PythonRuntime::getPythonRuntime()
 	return m_instance;
 }
 
+/**
+ * Import the modules in the main interpreter, creating the Python runtime
+ * if required
+ *
+ * @param modules	The names of the modules to import
+ */
+static void preloadModules(vector<string> modules)
+{
+	auto start = chrono::steady_clock::now();
+	PythonRuntime *runtime = PythonRuntime::getPythonRuntime();
+
+	// Modules of Fledge itself are found as they are by the plugins
+	const char *root = getenv("FLEDGE_ROOT");
+	if (root)
+	{
+		PyGILState_STATE state = PyGILState_Ensure();
+		PyObject *sysPath = PySys_GetObject((char *)"path");
+		PyObject *dir = PyUnicode_FromString((string(root) + "/python").c_str());
+		if (sysPath && dir && PySequence_Contains(sysPath, dir) == 0)
+		{
+			PyList_Append(sysPath, dir);
+		}
+		Py_CLEAR(dir);
+		PyGILState_Release(state);
+	}
+
+	int loaded = 0;
+	for (auto& name : modules)
+	{
+		PyObject *module = runtime->importModule(name);
+		if (module)
+		{
+			PyGILState_STATE state = PyGILState_Ensure();
+			Py_CLEAR(module);
+			PyGILState_Release(state);
+			loaded++;
+		}
+	}
+	chrono::duration<double> elapsed = chrono::steady_clock::now() - start;
+	Logger::getLogger()->info("Preloaded %d of %d Python modules in %.1f seconds",
+			loaded, (int)modules.size(), elapsed.count());
+}
+
+/**
+ * Import a set of Python modules in a background thread, so that
+ * the first call of a Python plugin that uses them does not wait
+ * for them to be loaded and compiled. A plugin that imports one of
+ * the modules whilst it is being preloaded waits for the import to
+ * complete.
+ *
+ * Plugins that run in their own sub-interpreter do not share the
+ * modules imported by the main interpreter.
+ *
+ * @param modules	The names of the modules to import
+ */
+void PythonRuntime::preload(const vector<string>& modules)
+{
+	if (modules.empty())
+	{
+		return;
+	}
+	thread loader(preloadModules, modules);
+	loader.detach();
+}
+
 /**
  * Constructor
  */
@@ -16,6 +16,7 @@
  */
 #include <pythonreading.h>
 #include <pyruntime.h>
+#include <pyinterpreter.h>
 #include <stdexcept>
 
 #define PY_ARRAY_UNIQUE_SYMBOL  PyArray_API_FLEDGE
@@ -31,6 +32,62 @@ bool PythonReading::doneNumPyImport = false;
 
 using namespace std;
 
+/**
+ * Return a numpy array that holds a copy of the values of a datapoint.
+ * The array owns its copy of the values, so it remains valid after the
+ * reading has been deleted and may be changed in place by the Python
+ * code. The values are copied in one operation rather than one by one.
+ *
+ * @param nd	The number of dimensions
+ * @param dims	The size of each dimension
+ * @param type	The numpy type of the values
+ * @param data	The values
+ * @return The numpy array
+ */
+static PyObject *arrayCopy(int nd, npy_intp *dims, int type, const void *data)
+{
+	PyObject *array = PyArray_SimpleNew(nd, dims, type);
+	if (array)
+	{
+		memcpy(PyArray_DATA((PyArrayObject *)array), data,
+				PyArray_SIZE((PyArrayObject *)array) * PyArray_ITEMSIZE((PyArrayObject *)array));
+	}
+	return array;
+}
+
+/**
+ * Check if a Python object is a one dimensional numpy array of doubles,
+ * as returned for a T_FLOAT_ARRAY datapoint
+ *
+ * @param obj	The Python object
+ * @return True if the object is a numpy array of doubles
+ */
+static bool isFloatArray(PyObject *obj)
+{
+	return PythonReading::doneNumPyImport && PyArray_Check(obj)
+		&& PyArray_NDIM((PyArrayObject *)obj) == 1
+		&& PyArray_TYPE((PyArrayObject *)obj) == NPY_DOUBLE;
+}
+
+/**
+ * Copy the values of a one dimensional numpy array of doubles into a
+ * vector, the values are copied in one operation rather than one by one.
+ *
+ * @param array		The numpy array
+ * @param values	The vector to copy the values into
+ */
+static void arrayValues(PyArrayObject *array, vector<double>& values)
+{
+	PyArrayObject *contiguous = PyArray_GETCONTIGUOUS(array);
+	if (!contiguous)
+	{
+		return;
+	}
+	double *data = (double *)PyArray_DATA(contiguous);
+	values.assign(data, data + PyArray_SIZE(contiguous));
+	Py_DECREF(contiguous);
+}
+
 
 /**
  * Construct a PythonReading from a DICT object returned by Python code.
@@ -249,21 +306,32 @@ DatapointValue *PythonReading::getDatapointValue(PyObject *value)
 			}
 			dataPoint = new DatapointValue(values);
 		}
-		else if (PyList_Check(item0))	// 2D array 		T_2D_FLOAT_ARRAY
+		else if (PyList_Check(item0) || isFloatArray(item0))	// 2D array 		T_2D_FLOAT_ARRAY
 		{
 			vector<vector<double>* > values;
 			for (Py_ssize_t i = 0; i < listSize; i++)
 			{
 				vector<double> *row = new vector<double>;
 				PyObject *pyRow = PyList_GetItem(value, i);
-				for (Py_ssize_t j = 0; j < PyList_Size(pyRow); j++)
+				if (isFloatArray(pyRow))
 				{
-					double d = PyFloat_AS_DOUBLE(PyList_GetItem(pyRow, j));
-					row->push_back(d);
+					arrayValues((PyArrayObject *)pyRow, *row);
+				}
+				else
+				{
+					for (Py_ssize_t j = 0; j < PyList_Size(pyRow); j++)
+					{
+						double d = PyFloat_AS_DOUBLE(PyList_GetItem(pyRow, j));
+						row->push_back(d);
+					}
 				}
 				values.push_back(row);
 			}
 			dataPoint = new DatapointValue(values);
+			for (auto row : values)
+			{
+				delete row;
+			}
 		}
 		else if (PyDict_Check(item0))	// List of datapoints	T_DP_LIST
 		{
@@ -287,7 +355,13 @@ DatapointValue *PythonReading::getDatapointValue(PyObject *value)
 			dataPoint = new DatapointValue(values, false);
 		}
 	}
-	else if (PyArray_Check(value))	// Numpy array
+	else if (isFloatArray(value))	// Numpy array of doubles	T_FLOAT_ARRAY
+	{
+		vector<double> values;
+		arrayValues((PyArrayObject *)value, values);
+		dataPoint = new DatapointValue(values);
+	}
+	else if (doneNumPyImport && PyArray_Check(value))	// Numpy array
 	{
 		PyArrayObject *array = (PyArrayObject *)value;
 		int item_size = PyArray_ITEMSIZE(array);
@@ -459,6 +533,39 @@ PyObject *PythonReading::convertDatapoint(Datapoint *dp, bool bytesString)
 				:
 				PyUnicode_FromString(dp->getData().toStringValue().c_str());
 	}
+	else if (dataType == DatapointValue::dataTagType::T_FLOAT_ARRAY && PythonInterpreter::inSubInterpreter())
+	{
+		// Numpy can not be used in a sub-interpreter
+		vector<double> *values = dp->getData().getDpArr();
+		int i = 0;
+		value = PyList_New(values->size());
+		for (auto it = values->begin(); it != values->end(); ++it)
+		{
+			PyList_SetItem(value, i++, PyFloat_FromDouble(*it));
+		}
+	}
+	else if (dataType == DatapointValue::dataTagType::T_2D_FLOAT_ARRAY && PythonInterpreter::inSubInterpreter())
+	{
+		vector<vector<double>* > *vec = dp->getData().getDp2DArr();
+		value = PyList_New(vec->size());
+		int rowNo = 0;
+		for (auto row : *vec)
+		{
+			int i = 0;
+			PyObject *pyRow = PyList_New(row->size());
+			for (auto& d : *row)
+			{
+				PyList_SetItem(pyRow, i++, PyFloat_FromDouble(d));
+			}
+			PyList_SetItem(value, rowNo++, pyRow);
+		}
+	}
+	else if ((dataType == DatapointValue::dataTagType::T_DATABUFFER
+			|| dataType == DatapointValue::dataTagType::T_IMAGE)
+			&& PythonInterpreter::inSubInterpreter())
+	{
+		Logger::getLogger()->warn("Data buffer and image datapoints can not be passed to a Python plugin that runs in its own interpreter");
+	}
 	else if (dataType == DatapointValue::dataTagType::T_FLOAT_ARRAY)
 	{
 		vector<double>* values = dp->getData().getDpArr();;
@@ -510,7 +617,7 @@ PyObject *PythonReading::convertDatapoint(Datapoint *dp, bool bytesString)
 				break;
 		}
 		PyGILState_STATE state = PyGILState_Ensure();
-		value = PyArray_SimpleNewFromData(1, &dim, type, dbuf->getData());
+		value = arrayCopy(1, &dim, type, dbuf->getData());
 		PyGILState_Release(state);
 #if 0
 		Py_buffer *buffer = (Py_buffer *)malloc(sizeof(Py_buffer));
@@ -534,7 +641,7 @@ PyObject *PythonReading::convertDatapoint(Datapoint *dp, bool bytesString)
 			dim[2] = 3;
 			enum NPY_TYPES	type = NPY_UBYTE;
 			PyGILState_STATE state = PyGILState_Ensure();
-			value = PyArray_SimpleNewFromData(3, dim, type, image->getData());
+			value = arrayCopy(3, dim, type, image->getData());
 			PyGILState_Release(state);
 		}
 		}
@@ -562,7 +669,7 @@ PyObject *PythonReading::convertDatapoint(Datapoint *dp, bool bytesString)
 					break;
 			}
 			PyGILState_STATE state = PyGILState_Ensure();
-			value = PyArray_SimpleNewFromData(2, dim, type, image->getData());
+			value = arrayCopy(2, dim, type, image->getData());
 			PyGILState_Release(state);
 		}
 	}
@@ -10,6 +10,16 @@
 #include <pythonreadingset.h>
 #include <pythonreading.h>
 #include <stdexcept>
+#include <string.h>
+#include <math.h>
+
+// The numpy API is imported by pythonreading.cpp
+#define PY_ARRAY_UNIQUE_SYMBOL  PyArray_API_FLEDGE
+#define NO_IMPORT_ARRAY
+#include <numpy/npy_common.h>
+#define NPY_NO_DEPRECATED_API NPY_1_7_API_VERSION
+#include <numpy/ndarraytypes.h>
+#include <numpy/ndarrayobject.h>
 
 using namespace std;
 
@@ -156,3 +166,333 @@ PyObject *PythonReadingSet::toPython(bool changeKeys)
 	return set;
 }
 
+/**
+ * Return a numpy array of the timestamps of a column as seconds since
+ * the epoch
+ *
+ * @param timestamps	The timestamps
+ * @return A new numpy array of doubles
+ */
+static PyObject *timestampColumn(const vector<struct timeval>& timestamps)
+{
+	npy_intp rows = timestamps.size();
+	PyObject *array = PyArray_SimpleNew(1, &rows, NPY_DOUBLE);
+	double *data = (double *)PyArray_DATA((PyArrayObject *)array);
+	for (npy_intp i = 0; i < rows; i++)
+	{
+		data[i] = timestamps[i].tv_sec + timestamps[i].tv_usec / 1000000.0;
+	}
+	return array;
+}
+
+/**
+ * Return the Python column of the values of a datapoint. Integer and
+ * floating point columns are returned as numpy arrays, the rows without
+ * the datapoint are NaN in a floating point column. Other columns, and
+ * integer columns with missing rows, are returned as a list with None
+ * for the rows without the datapoint.
+ *
+ * @param column	The column of the datapoint
+ * @return A new Python object for the column
+ */
+PyObject *PythonReadingSet::datapointColumn(ReadingColumn *column)
+{
+	npy_intp rows = column->getRows();
+	bool complete = true;
+	for (npy_intp i = 0; i < rows && complete; i++)
+	{
+		complete = column->isPresent(i);
+	}
+
+	if (column->getType() == ReadingColumn::COL_FLOAT)
+	{
+		PyObject *array = PyArray_SimpleNew(1, &rows, NPY_DOUBLE);
+		double *data = (double *)PyArray_DATA((PyArrayObject *)array);
+		memcpy(data, column->getFloats().data(), rows * sizeof(double));
+		for (npy_intp i = 0; i < rows && !complete; i++)
+		{
+			if (!column->isPresent(i))
+			{
+				data[i] = NAN;
+			}
+		}
+		return array;
+	}
+	if (column->getType() == ReadingColumn::COL_INTEGER && complete)
+	{
+		PyObject *array = PyArray_SimpleNew(1, &rows, NPY_LONG);
+		memcpy(PyArray_DATA((PyArrayObject *)array), column->getIntegers().data(),
+				rows * sizeof(long));
+		return array;
+	}
+
+	PyObject *list = PyList_New(rows);
+	for (npy_intp i = 0; i < rows; i++)
+	{
+		PyObject *item = NULL;
+		if (!column->isPresent(i))
+		{
+			Py_INCREF(Py_None);
+			item = Py_None;
+		}
+		else if (column->getType() == ReadingColumn::COL_INTEGER)
+		{
+			item = PyLong_FromLong(column->getIntegers()[i]);
+		}
+		else if (column->getType() == ReadingColumn::COL_STRING)
+		{
+			item = PyUnicode_FromString(column->getStrings()[i].c_str());
+		}
+		else
+		{
+			Datapoint dp(column->getName(), *column->getValue(i));
+			item = PythonReading::convertDatapoint(&dp);
+		}
+		if (!item)
+		{
+			Py_INCREF(Py_None);
+			item = Py_None;
+		}
+		PyList_SetItem(list, i, item);
+	}
+	return list;
+}
+
+/**
+ * Convert the ReadingSet to Python columns. The result is a Python
+ * dictionary with an entry per asset, each asset is a dictionary with
+ *
+ *	user_ts		A numpy array of the user timestamps of the readings
+ *	ts		A numpy array of the timestamps of the readings
+ *	datapoints	A dictionary of the column of each datapoint
+ *
+ * The timestamps are seconds since the epoch. The values of each column
+ * are copied in a single operation when the column is numeric, rather
+ * than creating a Python object for every value of every reading.
+ *
+ * @return A Python object that contains the set of readings as columns
+ */
+PyObject *PythonReadingSet::toPythonColumns()
+{
+	PythonReading::InitNumPy();
+	ColumnarReadingSet columnar(*this);
+	PyObject *set = PyDict_New();
+	for (auto asset : columnar.getAssets())
+	{
+		PyObject *columns = PyDict_New();
+		PyObject *value = timestampColumn(asset->getUserTimestamps());
+		PyDict_SetItemString(columns, "user_ts", value);
+		Py_CLEAR(value);
+		value = timestampColumn(asset->getTimestamps());
+		PyDict_SetItemString(columns, "ts", value);
+		Py_CLEAR(value);
+
+		PyObject *datapoints = PyDict_New();
+		for (auto column : asset->getColumns())
+		{
+			value = datapointColumn(column);
+			PyDict_SetItemString(datapoints, column->getName().c_str(), value);
+			Py_CLEAR(value);
+		}
+		PyDict_SetItemString(columns, "datapoints", datapoints);
+		Py_CLEAR(datapoints);
+
+		PyDict_SetItemString(set, asset->getAssetName().c_str(), columns);
+		Py_CLEAR(columns);
+	}
+	return set;
+}
+
+/**
+ * Convert a timestamp in seconds since the epoch to a timeval
+ *
+ * @param secs	The timestamp
+ * @param tv	The timeval to set
+ */
+static void toTimeval(double secs, struct timeval *tv)
+{
+	tv->tv_sec = (time_t)floor(secs);
+	tv->tv_usec = (suseconds_t)llround((secs - tv->tv_sec) * 1000000.0);
+	if (tv->tv_usec >= 1000000)
+	{
+		tv->tv_sec++;
+		tv->tv_usec -= 1000000;
+	}
+}
+
+/**
+ * Construct a PythonReadingSet from Python columns, as returned by
+ * toPythonColumns. The ts entry of an asset is optional, the user
+ * timestamps are used for both timestamps if it is missing. The
+ * readings of each asset follow those of the previous asset.
+ *
+ * @param columns	The Python dictionary of the columns of each asset
+ * @return PythonReadingSet*	The new reading set, the caller must free this
+ */
+PythonReadingSet *PythonReadingSet::fromColumns(PyObject *columns)
+{
+	if (!PyDict_Check(columns))
+	{
+		Logger::getLogger()->error("Expected a Python dict of columns when constructing a PythonReadingSet");
+		throw runtime_error("Expected a Python dict of columns when constructing a PythonReadingSet");
+	}
+	PythonReading::InitNumPy();
+	PythonReadingSet *set = new PythonReadingSet();
+	PyObject *key, *value;
+	Py_ssize_t pos = 0;
+	while (PyDict_Next(columns, &pos, &key, &value))
+	{
+		if (!PyUnicode_Check(key) || !PyDict_Check(value))
+		{
+			Logger::getLogger()->error("The columns of an asset must be a dict keyed by the asset name");
+			continue;
+		}
+		set->appendColumns(PyUnicode_AsUTF8(key), value);
+	}
+	return set;
+}
+
+/**
+ * Return a contiguous numpy array of doubles for a Python column of
+ * timestamps or floating point values
+ *
+ * @param column	The Python column, a numpy array or a list
+ * @return A new numpy array or NULL if the column can not be converted
+ */
+static PyArrayObject *doubleArray(PyObject *column)
+{
+	PyArrayObject *array = (PyArrayObject *)PyArray_FROM_OTF(column, NPY_DOUBLE, NPY_ARRAY_IN_ARRAY);
+	if (!array)
+	{
+		PyErr_Clear();
+		return NULL;
+	}
+	if (PyArray_NDIM(array) != 1)
+	{
+		Py_DECREF(array);
+		return NULL;
+	}
+	return array;
+}
+
+/**
+ * Append the readings of an asset held as Python columns
+ *
+ * @param asset		The asset name
+ * @param columns	The Python dictionary of the columns of the asset
+ */
+void PythonReadingSet::appendColumns(const string& asset, PyObject *columns)
+{
+	PyObject *userTs = PyDict_GetItemString(columns, "user_ts");
+	PyArrayObject *userTimestamps = userTs ? doubleArray(userTs) : NULL;
+	if (!userTimestamps)
+	{
+		Logger::getLogger()->error("The columns of asset %s do not have a user_ts array", asset.c_str());
+		return;
+	}
+	npy_intp rows = PyArray_SIZE(userTimestamps);
+	PyObject *ts = PyDict_GetItemString(columns, "ts");
+	PyArrayObject *timestamps = ts ? doubleArray(ts) : NULL;
+	if (timestamps && PyArray_SIZE(timestamps) != rows)
+	{
+		Logger::getLogger()->warn("The ts array of asset %s does not match the user_ts array, user_ts will be used", asset.c_str());
+		Py_CLEAR(timestamps);
+	}
+
+	vector<vector<Datapoint *> > datapoints(rows);
+	PyObject *dps = PyDict_GetItemString(columns, "datapoints");
+	PyObject *name, *column;
+	Py_ssize_t pos = 0;
+	while (dps && PyDict_Check(dps) && PyDict_Next(dps, &pos, &name, &column))
+	{
+		if (!PyUnicode_Check(name))
+		{
+			continue;
+		}
+		string dpName = PyUnicode_AsUTF8(name);
+		if (PyArray_Check(column) && PyArray_NDIM((PyArrayObject *)column) == 1
+				&& PyArray_ISINTEGER((PyArrayObject *)column))
+		{
+			PyArrayObject *array = (PyArrayObject *)PyArray_FROM_OTF(column, NPY_LONG, NPY_ARRAY_IN_ARRAY);
+			if (array && PyArray_SIZE(array) == rows)
+			{
+				long *data = (long *)PyArray_DATA(array);
+				for (npy_intp i = 0; i < rows; i++)
+				{
+					DatapointValue dpv(data[i]);
+					datapoints[i].push_back(new Datapoint(dpName, dpv));
+				}
+			}
+			else
+			{
+				PyErr_Clear();
+				Logger::getLogger()->error("Column %s of asset %s does not match the user_ts array", dpName.c_str(), asset.c_str());
+			}
+			Py_XDECREF(array);
+		}
+		else if (PyArray_Check(column) && PyArray_NDIM((PyArrayObject *)column) == 1
+				&& (PyArray_ISFLOAT((PyArrayObject *)column) || PyArray_ISBOOL((PyArrayObject *)column)))
+		{
+			PyArrayObject *array = doubleArray(column);
+			if (array && PyArray_SIZE(array) == rows)
+			{
+				double *data = (double *)PyArray_DATA(array);
+				for (npy_intp i = 0; i < rows; i++)
+				{
+					if (!isnan(data[i]))
+					{
+						DatapointValue dpv(data[i]);
+						datapoints[i].push_back(new Datapoint(dpName, dpv));
+					}
+				}
+			}
+			else
+			{
+				Logger::getLogger()->error("Column %s of asset %s does not match the user_ts array", dpName.c_str(), asset.c_str());
+			}
+			Py_XDECREF(array);
+		}
+		else if (PyList_Check(column) && PyList_Size(column) == rows)
+		{
+			for (npy_intp i = 0; i < rows; i++)
+			{
+				PyObject *item = PyList_GetItem(column, i);
+				if (item == Py_None)
+				{
+					continue;
+				}
+				DatapointValue *dpv = PythonReading::getDatapointValue(item);
+				if (dpv)
+				{
+					datapoints[i].push_back(new Datapoint(dpName, *dpv));
+					delete dpv;
+				}
+			}
+		}
+		else
+		{
+			Logger::getLogger()->error("Column %s of asset %s must be a one dimensional numpy array or a list of the same length as the user_ts array",
+					dpName.c_str(), asset.c_str());
+		}
+	}
+
+	double *uts = (double *)PyArray_DATA(userTimestamps);
+	double *sts = timestamps ? (double *)PyArray_DATA(timestamps) : uts;
+	for (npy_intp i = 0; i < rows; i++)
+	{
+		if (datapoints[i].empty())
+		{
+			continue;
+		}
+		Reading *reading = new Reading(asset, datapoints[i]);
+		struct timeval tv;
+		toTimeval(uts[i], &tv);
+		reading->setUserTimestamp(tv);
+		toTimeval(sts[i], &tv);
+		reading->setTimestamp(tv);
+		m_readings.push_back(reading);
+		m_count++;
+	}
+	Py_CLEAR(userTimestamps);
+	Py_CLEAR(timestamps);
+}
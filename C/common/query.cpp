@@ -175,6 +175,7 @@ Query::~Query()
 void Query::aggregate(Aggregate *aggregate)
 {
 	m_aggregates.push_back(aggregate);
+	m_json.clear();
 }
 
 /**
@@ -185,6 +186,7 @@ void Query::aggregate(Aggregate *aggregate)
 void Query::sort(Sort *sort)
 {
 	m_sort.push_back(sort);
+	m_json.clear();
 }
 
 /**
@@ -195,6 +197,7 @@ void Query::sort(Sort *sort)
 void Query::group(const string& column)
 {
 	m_group = column;
+	m_json.clear();
 }
 
 /**
@@ -205,6 +208,7 @@ void Query::group(const string& column)
 void Query::limit(unsigned int limit)
 {
 	m_limit = limit;
+	m_json.clear();
 }
 
 /**
@@ -215,6 +219,7 @@ void Query::limit(unsigned int limit)
 void Query::timebucket(Timebucket *timebucket)
 {
 	m_timebucket = timebucket;
+	m_json.clear();
 }
 
 /**
@@ -225,6 +230,7 @@ void Query::timebucket(Timebucket *timebucket)
 void Query::returns(Returns *returns)
 {
 	m_returns.push_back(returns);
+	m_json.clear();
 }
 
 /**
@@ -238,6 +244,7 @@ void Query::returns(vector<Returns *> returns)
 	{
 		m_returns.push_back(*it);
 	}
+	m_json.clear();
 }
 
 /**
@@ -248,6 +255,7 @@ void Query::returns(vector<Returns *> returns)
 void Query::join(Join *join)
 {
 	m_join = join;
+	m_json.clear();
 }
 
 /**
@@ -256,30 +264,60 @@ void Query::join(Join *join)
 void Query::distinct()
 {
 	m_distinct = true;
+	m_json.clear();
 }
 
 /**
- * Return the JSON payload for a where clause
+ * Return if the JSON payload of the query, and of the clauses that
+ * may be modified once added to it, is still held
+ *
+ * @return bool	False if the query has been modified since it was serialised
+ */
+bool Query::isCached() const
+{
+	if (m_json.empty() || (m_where && !m_where->isCached()) || (m_join && !m_join->isCached()))
+	{
+		return false;
+	}
+	for (auto it = m_returns.cbegin(); it != m_returns.cend(); ++it)
+	{
+		if (!(*it)->isCached())
+		{
+			return false;
+		}
+	}
+	return true;
+}
+
+/**
+ * Return the JSON payload for a query. The payload is built again only
+ * if the query has been modified since it was last returned, the JSON
+ * of the clauses that have not been modified is reused.
  */
-const string Query::toJSON() const
+const string& Query::toJSON() const
 {
-ostringstream   json;
+	if (isCached())
+	{
+		return m_json;
+	}
+
+string		json;
 bool 		first = true;
 
-	json << "{ ";
+	json.append("{ ");
 	if (m_where)
 	{
 		if (! first)
-			json << ", ";
-		json << "\"where\" : " << m_where->toJSON();
+			json.append(", ");
+		json.append("\"where\" : ").append(m_where->toJSON());
 		first = false;
 	}
 	if (m_join)
 	{
 		if (! first)
-			json << ", ";
+			json.append(", ");
 		first = false;
-		json << m_join->toJSON();
+		json.append(m_join->toJSON());
 	}
 	switch (m_aggregates.size())
 	{
@@ -287,29 +325,29 @@ bool 		first = true;
 		break;
 	case 1:
 		if (! first)
-			json << ", ";
-		json << "\"aggregate\" : " << m_aggregates.front()->toJSON();
+			json.append(", ");
+		json.append("\"aggregate\" : ").append(m_aggregates.front()->toJSON());
 		first = false;
 		break;
 	default:
 		if (! first)
-			json << ", ";
-		json << "\"aggregate\" : [ ";
+			json.append(", ");
+		json.append("\"aggregate\" : [ ");
 		for (auto it = m_aggregates.cbegin(); it != m_aggregates.cend(); ++it)
 		{
 			if (it != m_aggregates.cbegin())
-				json << ", ";
-			json << (*it)->toJSON();
+				json.append(", ");
+			json.append((*it)->toJSON());
 		}
-		json << " ]";
+		json.append(" ]");
 		first = false;
 		break;
 	}
 	if (!m_group.empty())
 	{
 		if (! first)
-			json << ", ";
-		json << "\"group\" : \"" << m_group << "\"";
+			json.append(", ");
+		json.append("\"group\" : \"").append(m_group).append("\"");
 		first = false;
 	}
 	switch (m_sort.size())
@@ -318,59 +356,60 @@ bool 		first = true;
 		break;
 	case 1:
 		if (! first)
-			json << ", ";
-		json << "\"sort\" : " << m_sort.front()->toJSON();
+			json.append(", ");
+		json.append("\"sort\" : ").append(m_sort.front()->toJSON());
 		first = false;
 		break;
 	default:
 		if (! first)
-			json << ", ";
-		json << "\"sort\" : [ ";
+			json.append(", ");
+		json.append("\"sort\" : [ ");
 		for (auto it = m_sort.cbegin(); it != m_sort.cend(); ++it)
 		{
 			if (it != m_sort.cbegin())
-				json << ", ";
-			json << (*it)->toJSON();
+				json.append(", ");
+			json.append((*it)->toJSON());
 		}
-		json << " ], ";
+		json.append(" ]");
 		first = false;
 		break;
 	}
 	if (m_timebucket)
 	{
 		if (! first)
-			json << ", ";
-		json << "\"timebucket\" : " << m_timebucket->toJSON();
+			json.append(", ");
+		json.append("\"timebucket\" : ").append(m_timebucket->toJSON());
 		first = false;
 	}
 	if (m_limit)
 	{
 		if (! first)
-			json << ", ";
-		json << "\"limit\" : " << m_limit;
+			json.append(", ");
+		json.append("\"limit\" : ").append(to_string(m_limit));
 		first = false;
 	}
 	if (m_returns.size())
 	{
 		if (! first)
-			json << ", ";
-		json << "\"return\" : [ ";
+			json.append(", ");
+		json.append("\"return\" : [ ");
 		for (auto it = m_returns.cbegin(); it != m_returns.cend(); ++it)
 		{
 			if (it != m_returns.cbegin())
-				json << ", ";
-			json << (*it)->toJSON();
+				json.append(", ");
+			json.append((*it)->toJSON());
 		}
-		json << " ]";
+		json.append(" ]");
 		first = false;
 	}
 	if (m_distinct)
 	{
 		if (! first)
-			json << ", ";
-		json << "\"modifier\" : \"distinct\"";
+			json.append(", ");
+		json.append("\"modifier\" : \"distinct\"");
 		first = false;
 	}
-	json << " }";
-	return json.str();
+	json.append(" }");
+	m_json.swap(json);
+	return m_json;
 }
@@ -0,0 +1,145 @@
+/*
+ * Fledge metrics of the queues of the data path.
+ *
+ * Copyright (c) 2026 Dianomic Systems
+ *
+ * Released under the Apache 2.0 Licence
+ *
+ * Author: agent
+ */
+#include <queue_metrics.h>
+#include <json_utils.h>
+#include <sstream>
+#include <algorithm>
+
+using namespace std;
+using namespace std::chrono;
+
+/**
+ * Create the metrics of a queue and register them
+ *
+ * @param name	The name the queue is reported as
+ * @param unit	The unit of the entries of the queue, such as readings
+ */
+QueueMetrics::QueueMetrics(const string& name, const string& unit) :
+	m_name(name), m_unit(unit), m_depth(0), m_highWater(0),
+	m_enqueued(0), m_dequeued(0), m_rateTime(steady_clock::now()),
+	m_rateEnqueued(0), m_rateDequeued(0), m_enqueueRate(0.0), m_dequeueRate(0.0)
+{
+	QueueMetricsRegistry::getInstance()->add(this);
+}
+
+/**
+ * Remove the metrics of the queue from the registry
+ */
+QueueMetrics::~QueueMetrics()
+{
+	QueueMetricsRegistry::getInstance()->remove(this);
+}
+
+/**
+ * Record entries added to the queue
+ *
+ * @param count	The number of entries added
+ */
+void QueueMetrics::enqueue(size_t count)
+{
+	m_enqueued.fetch_add(count, memory_order_relaxed);
+	long depth = m_depth.fetch_add(count, memory_order_relaxed) + count;
+	size_t high = m_highWater.load(memory_order_relaxed);
+	while (depth > 0 && (size_t)depth > high
+			&& !m_highWater.compare_exchange_weak(high, (size_t)depth, memory_order_relaxed))
+	{
+	}
+}
+
+/**
+ * Record entries removed from the queue
+ *
+ * @param count	The number of entries removed
+ */
+void QueueMetrics::dequeue(size_t count)
+{
+	m_dequeued.fetch_add(count, memory_order_relaxed);
+	m_depth.fetch_sub(count, memory_order_relaxed);
+}
+
+/**
+ * Return the number of entries in the queue. The depth is never reported
+ * below zero whilst an enqueue and dequeue of the same entry race.
+ */
+size_t QueueMetrics::getDepth() const
+{
+	long depth = m_depth.load(memory_order_relaxed);
+	return depth > 0 ? (size_t)depth : 0;
+}
+
+/**
+ * Return the singleton registry
+ */
+QueueMetricsRegistry *QueueMetricsRegistry::getInstance()
+{
+	static QueueMetricsRegistry *instance = new QueueMetricsRegistry();
+	return instance;
+}
+
+/**
+ * Register the metrics of a queue
+ */
+void QueueMetricsRegistry::add(QueueMetrics *queue)
+{
+	lock_guard<mutex> guard(m_mutex);
+	m_queues.push_back(queue);
+}
+
+/**
+ * Remove the metrics of a queue that no longer exists
+ */
+void QueueMetricsRegistry::remove(QueueMetrics *queue)
+{
+	lock_guard<mutex> guard(m_mutex);
+	m_queues.erase(std::remove(m_queues.begin(), m_queues.end(), queue), m_queues.end());
+}
+
+/**
+ * Return the metrics of all the queues as a JSON object. The rates are
+ * the entries added and removed per second, measured over at least
+ * QUEUE_RATE_INTERVAL milliseconds before the previous report.
+ *
+ * @param json	The string to return the JSON object in
+ */
+void QueueMetricsRegistry::asJSON(string& json)
+{
+	lock_guard<mutex> guard(m_mutex);
+	steady_clock::time_point now = steady_clock::now();
+	ostringstream convert;
+	convert << "{ \"queues\" : [ ";
+	bool first = true;
+	for (auto queue : m_queues)
+	{
+		unsigned long enqueued = queue->getEnqueued();
+		unsigned long dequeued = queue->getDequeued();
+		double elapsed = duration_cast<duration<double>>(now - queue->m_rateTime).count();
+		if (elapsed * 1000 >= QUEUE_RATE_INTERVAL)
+		{
+			queue->m_enqueueRate = (enqueued - queue->m_rateEnqueued) / elapsed;
+			queue->m_dequeueRate = (dequeued - queue->m_rateDequeued) / elapsed;
+			queue->m_rateEnqueued = enqueued;
+			queue->m_rateDequeued = dequeued;
+			queue->m_rateTime = now;
+		}
+		if (!first)
+			convert << ", ";
+		first = false;
+		convert << "{ \"name\" : \"" << JSONescape(queue->getName()) << "\"";
+		convert << ", \"unit\" : \"" << JSONescape(queue->getUnit()) << "\"";
+		convert << ", \"depth\" : " << queue->getDepth();
+		convert << ", \"highWater\" : " << queue->getHighWater();
+		convert << ", \"enqueued\" : " << enqueued;
+		convert << ", \"dequeued\" : " << dequeued;
+		convert << ", \"enqueueRate\" : " << queue->m_enqueueRate;
+		convert << ", \"dequeueRate\" : " << queue->m_dequeueRate << " }";
+	}
+	convert << " ] }";
+	json = convert.str();
+}
@@ -15,6 +15,9 @@
 #include <time.h>
 #include <string.h>
 #include <logger.h>
+#include <timestamp_formatter.h>
+#include <json_utils.h>
+#include <unordered_map>
 
 using namespace std;
 
@@ -25,6 +28,95 @@ std::vector<std::string> Reading::m_dateTypes = {
 	ISO8601_DATE_TIME_FORMAT	// Version with milliseconds
 };
 
+/**
+ * The name of a datapoint held by reference, the names of datapoints
+ * are interned and so outlive the readings that index them
+ */
+struct DatapointName {
+	const string	*name;
+	bool		operator==(const DatapointName& rhs) const { return *name == *rhs.name; };
+};
+
+struct DatapointNameHash {
+	size_t operator()(const DatapointName& name) const { return hash<string>()(*name.name); };
+};
+
+/**
+ * The positions of the datapoints of a reading by name. Only the first
+ * of several datapoints with the same name is indexed, the one that a
+ * search of the datapoints in order finds.
+ *
+ * The datapoints of a reading may be changed through getReadingData, so
+ * the interned name of each datapoint indexed is kept. The index holds
+ * if the datapoints still have these names, which is checked by address
+ * without comparing the names themselves.
+ */
+class DatapointIndex {
+	public:
+		DatapointIndex(const vector<Datapoint *>& values)
+		{
+			m_names.reserve(values.size());
+			m_positions.reserve(values.size());
+			for (auto dp : values)
+			{
+				add(dp);
+			}
+		};
+		void	add(Datapoint *dp)
+		{
+			m_names.push_back(&dp->getName());
+			m_positions.emplace(DatapointName{ m_names.back() }, m_names.size() - 1);
+		};
+		void	remove(size_t position)
+		{
+			const string *name = m_names[position];
+			m_names.erase(m_names.begin() + position);
+			m_positions.erase(DatapointName{ name });
+			for (auto& entry : m_positions)
+			{
+				if (entry.second > position)
+					entry.second--;
+			}
+			// A later datapoint with the same name is now the first
+			for (size_t i = position; i < m_names.size(); i++)
+			{
+				if (m_names[i] == name)
+				{
+					m_positions.emplace(DatapointName{ name }, i);
+					break;
+				}
+			}
+		};
+		bool	holds(const vector<Datapoint *>& values) const
+		{
+			if (values.size() != m_names.size())
+				return false;
+			for (size_t i = 0; i < m_names.size(); i++)
+			{
+				if (&values[i]->getName() != m_names[i])
+					return false;
+			}
+			return true;
+		};
+		size_t	find(const string& name) const
+		{
+			auto it = m_positions.find(DatapointName{ &name });
+			return it == m_positions.end() ? m_names.size() : it->second;
+		};
+		const string	*name(size_t position) const { return m_names[position]; };
+		size_t		size() const { return m_names.size(); };
+		size_t		getMemorySize() const
+		{
+			return sizeof(DatapointIndex) + m_names.capacity() * sizeof(const string *)
+				+ m_positions.size() * (sizeof(DatapointName) + sizeof(size_t) + 2 * sizeof(void *))
+				+ m_positions.bucket_count() * sizeof(void *);
+		};
+	private:
+		vector<const string *>	m_names;
+		unordered_map<DatapointName, size_t, DatapointNameHash>
+					m_positions;
+};
+
 /**
  * Reading constructor
  *
@@ -48,12 +140,9 @@ Reading::Reading(const string& asset, Datapoint *value) : m_asset(asset)
  * Each actual datavalue that relates to that asset is held within an
  * instance of a Datapoint class.
  */
-Reading::Reading(const string& asset, vector<Datapoint *> values) : m_asset(asset)
+Reading::Reading(const string& asset, vector<Datapoint *> values) : m_asset(asset),
+	m_values(std::move(values))
 {
-	for (auto it = values.cbegin(); it != values.cend(); it++)
-	{
-		m_values.push_back(*it);
-	}
 	// Store seconds and microseconds
 	gettimeofday(&m_timestamp, NULL);
 	// Initialise m_userTimestamp
@@ -67,12 +156,9 @@ Reading::Reading(const string& asset, vector<Datapoint *> values) : m_asset(asse
  * Each actual datavalue that relates to that asset is held within an
  * instance of a Datapoint class.
  */
-Reading::Reading(const string& asset, vector<Datapoint *> values, const string& ts) : m_asset(asset)
+Reading::Reading(const string& asset, vector<Datapoint *> values, const string& ts) : m_asset(asset),
+	m_values(std::move(values))
 {
-	for (auto it = values.cbegin(); it != values.cend(); it++)
-	{
-		m_values.push_back(*it);
-	}
 	stringToTimestamp(ts, &m_timestamp);
 	// Initialise m_userTimestamp
 	m_userTimestamp = m_timestamp;
@@ -92,6 +178,20 @@ Reading::Reading(const Reading& orig) : m_asset(orig.m_asset),
 	}
 }
 
+/**
+ * Reading move constructor. The datapoints are taken from the
+ * original reading, which is left with none.
+ */
+Reading::Reading(Reading&& orig) : m_id(orig.m_id), m_has_id(orig.m_has_id),
+	m_asset(orig.m_asset),
+	m_timestamp(orig.m_timestamp),
+	m_userTimestamp(orig.m_userTimestamp),
+	m_values(std::move(orig.m_values)), m_index(orig.m_index)
+{
+	orig.m_values.clear();
+	orig.m_index = NULL;
+}
+
 /**
  * Destructor for Reading class
  */
@@ -101,6 +201,7 @@ Reading::~Reading()
 	{
 		delete(*it);
 	}
+	delete m_index;
 }
 
 /**
@@ -113,6 +214,8 @@ void Reading::removeAllDatapoints()
 		delete(*it);
 	}
 	m_values.clear();
+	delete m_index;
+	m_index = NULL;
 }
 
 /**
@@ -120,6 +223,10 @@ void Reading::removeAllDatapoints()
  */
 void Reading::addDatapoint(Datapoint *value)
 {
+	if (m_index && m_index->size() == m_values.size())
+	{
+		m_index->add(value);
+	}
 	m_values.push_back(value);
 }
 
@@ -131,18 +238,18 @@ void Reading::addDatapoint(Datapoint *value)
  */
 Datapoint *Reading::removeDatapoint(const string& name)
 {
-Datapoint *rval;
-
-	for (auto it = m_values.begin(); it != m_values.end(); it++)
+	size_t position = findDatapoint(name);
+	if (position == m_values.size())
 	{
-		if ((*it)->getName().compare(name) == 0)
-		{
-			rval = *it;
-			m_values.erase(it);
-			return rval;
-		}
+		return NULL;
+	}
+	Datapoint *rval = m_values[position];
+	m_values.erase(m_values.begin() + position);
+	if (m_index)
+	{
+		m_index->remove(position);
 	}
-	return NULL;
+	return rval;
 }
 
 /**
@@ -153,17 +260,55 @@ Datapoint *rval;
  */
 Datapoint *Reading::getDatapoint(const string& name) const
 {
-Datapoint *rval;
+	size_t position = findDatapoint(name);
+	return position == m_values.size() ? NULL : m_values[position];
+}
 
-	for (auto it = m_values.cbegin(); it != m_values.cend(); it++)
+/**
+ * Return the position of the first datapoint with a name. The datapoints
+ * of a reading with READING_INDEX_THRESHOLD or more datapoints are found
+ * with an index of the names, built by the first lookup and rebuilt if
+ * the datapoints have been changed other than by addDatapoint and
+ * removeDatapoint. Fewer datapoints are searched in order.
+ *
+ * Like the rest of the reading the index is not protected against
+ * concurrent use, a reading may only be used by one thread at a time.
+ *
+ * @param name		The name of the datapoint
+ * @return size_t	The position of the datapoint, the number of datapoints if there is none
+ */
+size_t Reading::findDatapoint(const string& name) const
+{
+	if (m_values.size() < READING_INDEX_THRESHOLD)
 	{
-		if ((*it)->getName().compare(name) == 0)
+		for (size_t i = 0; i < m_values.size(); i++)
 		{
-			rval = *it;
-			return rval;
+			if (m_values[i]->getName().compare(name) == 0)
+			{
+				return i;
+			}
 		}
+		return m_values.size();
 	}
-	return NULL;
+
+	if (m_index)
+	{
+		size_t position = m_index->find(name);
+		if (position < m_values.size())
+		{
+			if (&m_values[position]->getName() == m_index->name(position))
+			{
+				return position;
+			}
+		}
+		else if (m_index->holds(m_values))
+		{
+			return m_values.size();
+		}
+		delete m_index;
+	}
+	m_index = new DatapointIndex(m_values);
+	return m_index->find(name);
 }
 
 /**
@@ -172,57 +317,118 @@ Datapoint *rval;
  */
 string Reading::toJSON(bool minimal) const
 {
-ostringstream convert;
+string	rval;
+
+	rval.reserve(128 + 32 * m_values.size());
+	appendJSON(rval, minimal);
+	return rval;
+}
+
+/**
+ * Append the asset reading as a JSON structure to a string. The
+ * reading is written straight into the string, without building a
+ * string for each datapoint, so that a block of readings may be
+ * serialised into a single buffer.
+ *
+ * @param out		The string to append the reading to
+ * @param minimal	Omit the system timestamp
+ */
+void Reading::appendJSON(string& out, bool minimal) const
+{
+char	ts[DATE_TIME_BUFFER_LEN + 20];
 
-	convert << "{\"asset_code\":\"";
-	convert << escape(m_asset);
-	convert << "\",\"user_ts\":\"";
+	out += "{\"asset_code\":\"";
+	JSONappendEscaped(out, m_asset.str().data(), m_asset.length());
+	out += "\",\"user_ts\":\"";
 
 	// Add date_time with microseconds + timezone UTC:
 	// YYYY-MM-DD HH24:MM:SS.MS+00:00
-	convert << getAssetDateUserTime(FMT_DEFAULT) << "+00:00";
+	out.append(ts, formatTimestamp(ts, m_userTimestamp, FMT_DEFAULT, true));
+	out += "+00:00";
 	if (!minimal)
 	{
-		convert << "\",\"ts\":\"";
+		out += "\",\"ts\":\"";
 
 		// Add date_time with microseconds + timezone UTC:
 		// YYYY-MM-DD HH24:MM:SS.MS+00:00
-		convert << getAssetDateTime(FMT_DEFAULT) << "+00:00";
+		out.append(ts, formatTimestamp(ts, m_timestamp, FMT_DEFAULT, true));
+		out += "+00:00";
 	}
 
 	// Add values
-	convert << "\",\"reading\":{";
-	for (auto it = m_values.cbegin(); it != m_values.cend(); it++)
+	out += "\",\"reading\":";
+	appendDatapointsJSON(out);
+	out += '}';
+}
+
+/**
+ * Return the approximate number of bytes of memory used by the reading
+ * and its datapoints. The asset and datapoint names are interned and so
+ * are not included.
+ *
+ * @return size_t	The bytes used by the reading
+ */
+size_t Reading::getMemorySize() const
+{
+	size_t size = sizeof(Reading) + m_values.capacity() * sizeof(Datapoint *);
+	for (auto dp : m_values)
 	{
-		if (it != m_values.cbegin())
-		{
-			convert << ",";
-		}
-		convert << (*it)->toJSONProperty();
+		size += dp->getMemorySize();
 	}
-	convert << "}}";
-	return convert.str();
+	if (m_index)
+	{
+		size += m_index->getMemorySize();
+	}
+	return size;
 }
 
 /**
- * Return the asset reading as a JSON structure encoded in a
+ * Return the approximate number of bytes of memory used by the readings
+ * of a block. The vector that holds them is not included.
+ *
+ * @param readings	The readings
+ * @return size_t	The bytes used by the readings
+ */
+size_t Reading::getMemorySize(const vector<Reading *>& readings)
+{
+	size_t size = 0;
+	for (auto reading : readings)
+	{
+		size += reading->getMemorySize();
+	}
+	return size;
+}
+
+/**
+ * Return the datapoints of the reading as a JSON structure encoded in a
  * C++ string.
  */
 string Reading::getDatapointsJSON() const
 {
-ostringstream convert;
+string	rval;
 
-	convert << "{";
+	rval.reserve(2 + 32 * m_values.size());
+	appendDatapointsJSON(rval);
+	return rval;
+}
+
+/**
+ * Append the datapoints of the reading as a JSON object to a string
+ *
+ * @param out	The string to append the datapoints to
+ */
+void Reading::appendDatapointsJSON(string& out) const
+{
+	out += '{';
 	for (auto it = m_values.cbegin(); it != m_values.cend(); it++)
 	{
 		if (it != m_values.cbegin())
 		{
-			convert << ",";
+			out += ',';
 		}
-		convert << (*it)->toJSONProperty();
+		(*it)->appendJSONProperty(out);
 	}
-	convert << "}";
-	return convert.str();
+	out += '}';
 }
 
 /**
@@ -232,54 +438,7 @@ ostringstream convert;
  */
 const string Reading::getAssetDateTime(readingTimeFormat dateFormat, bool addMS) const
 {
-char date_time[DATE_TIME_BUFFER_LEN];
-char micro_s[10];
-char  assetTime[DATE_TIME_BUFFER_LEN + 20];
-
-        // Populate tm structure
-        struct tm timeinfo;
-	gmtime_r(&m_timestamp.tv_sec, &timeinfo);
-
-        /**
-         * Build date_time with format YYYY-MM-DD HH24:MM:SS.MS+00:00
-         * this is same as Python3:
-         * datetime.datetime.now(tz=datetime.timezone.utc)
-         */
-
-        // Create datetime with seconds
-        std::strftime(date_time, sizeof(date_time),
-		      m_dateTypes[dateFormat].c_str(),
-                      &timeinfo);
-
-	if (dateFormat != FMT_ISO8601 && addMS)
-	{
-		// Add microseconds
-		snprintf(micro_s,
-			 sizeof(micro_s),
-			 ".%06lu",
-			 m_timestamp.tv_usec);
-
-		// Add date_time + microseconds
-		if (dateFormat != FMT_ISO8601MS)
-		{
-			snprintf(assetTime, sizeof(assetTime), "%s%s", date_time, micro_s);
-		}
-		else
-		{
-			string dt(date_time);
-			size_t pos = dt.find_first_of("+");
-			pos--;
-			snprintf(assetTime, sizeof(assetTime), "%s%s%s",
-					dt.substr(0, pos).c_str(),
-				       	micro_s, dt.substr(pos).c_str());
-		}
-		return string(assetTime);
-	}
-	else
-	{
-		return string(date_time);
-	}
-
+	return formatTimestamp(m_timestamp, dateFormat, addMS);
 }
 
 /**
@@ -289,53 +448,66 @@ char  assetTime[DATE_TIME_BUFFER_LEN + 20];
  */
 const string Reading::getAssetDateUserTime(readingTimeFormat dateFormat, bool addMS) const
 {
-	char date_time[DATE_TIME_BUFFER_LEN+10];
-	char micro_s[10];
-	char  assetTime[DATE_TIME_BUFFER_LEN + 20];
-
-	// Populate tm structure with UTC time
-	struct tm timeinfo;
-	gmtime_r(&m_userTimestamp.tv_sec, &timeinfo);
+	return formatTimestamp(m_userTimestamp, dateFormat, addMS);
+}
 
-	/**
-	 * Build date_time with format YYYY-MM-DD HH24:MM:SS.MS+00:00
-	 * this is same as Python3:
-	 * datetime.datetime.now(tz=datetime.timezone.utc)
-	 */
+/**
+ * Format a timestamp in UTC
+ *
+ * Build date_time with format YYYY-MM-DD HH24:MM:SS.MS+00:00
+ * this is same as Python3:
+ * datetime.datetime.now(tz=datetime.timezone.utc)
+ *
+ * The fixed formats are built directly, strftime is only used for
+ * years the formatter does not support.
+ *
+ * @param tv		The timestamp
+ * @param dateFormat    Format: FMT_DEFAULT or FMT_STANDARD
+ * @param addMS		Add the microseconds to the timestamp
+ * @return              The formatted datetime string
+ */
+const string Reading::formatTimestamp(const struct timeval& tv, readingTimeFormat dateFormat, bool addMS) const
+{
+char	assetTime[DATE_TIME_BUFFER_LEN + 20];
 
-	// Create datetime with seconds
-	std::strftime(date_time, sizeof(date_time),
-				  m_dateTypes[dateFormat].c_str(),
-				  &timeinfo);
+	return string(assetTime, formatTimestamp(assetTime, tv, dateFormat, addMS));
+}
 
-	if (dateFormat != FMT_ISO8601 && addMS)
+/**
+ * Format a timestamp into a buffer of at least DATE_TIME_BUFFER_LEN + 20
+ * characters, as formatTimestamp does, without creating a string.
+ *
+ * @param assetTime	The buffer to format the timestamp into
+ * @param tv		The timestamp
+ * @param dateFormat    Format: FMT_DEFAULT or FMT_STANDARD
+ * @param addMS		Add the microseconds to the timestamp
+ * @return		The number of characters written, the buffer is not terminated
+ */
+size_t Reading::formatTimestamp(char *assetTime, const struct timeval& tv, readingTimeFormat dateFormat, bool addMS) const
+{
+	size_t len = TimestampFormatter::formatDateTime(assetTime, tv.tv_sec,
+					dateFormat == FMT_STANDARD ? 'T' : ' ');
+	if (len == 0)
 	{
-		// Add microseconds
-		snprintf(micro_s,
-			 sizeof(micro_s),
-			 ".%06lu",
-			 m_userTimestamp.tv_usec);
-
-		// Add date_time + microseconds
-		if (dateFormat != FMT_ISO8601MS)
-		{
-			snprintf(assetTime, sizeof(assetTime), "%s%s", date_time, micro_s);
-		}
-		else
+		struct tm timeinfo;
+		gmtime_r(&tv.tv_sec, &timeinfo);
+		len = std::strftime(assetTime, DATE_TIME_BUFFER_LEN,
+				      m_dateTypes[dateFormat].c_str(), &timeinfo);
+		if (dateFormat == FMT_ISO8601 || dateFormat == FMT_ISO8601MS)
 		{
-			string dt(date_time);
-			size_t pos = dt.find_first_of("+");
-			pos--;
-			snprintf(assetTime, sizeof(assetTime), "%s%s%s",
-					dt.substr(0, pos).c_str(),
-				       	micro_s, dt.substr(pos).c_str());
+			len -= 6;	// Remove the timezone, it is added below
 		}
-		return string(assetTime);
 	}
-	else
+	if (dateFormat != FMT_ISO8601 && addMS)
 	{
-		return string(date_time);
+		len += TimestampFormatter::formatMicroseconds(&assetTime[len], tv.tv_usec);
 	}
+	if (dateFormat == FMT_ISO8601 || dateFormat == FMT_ISO8601MS)
+	{
+		memcpy(&assetTime[len], " +0000", 6);
+		len += 6;
+	}
+	return len;
 }
 
 /**
@@ -375,6 +547,12 @@ void Reading::setUserTimestamp(const string& timestamp)
  */
 void Reading::stringToTimestamp(const string& timestamp, struct timeval *ts)
 {
+	if (TimestampFormatter::parse(timestamp.c_str(), ts))
+	{
+		return;
+	}
+
+	// Not one of the fixed formats, fall back to the C library
 	char date_time [DATE_TIME_BUFFER_LEN];
 
 	strcpy (date_time, timestamp.c_str());
@@ -431,27 +609,47 @@ void Reading::stringToTimestamp(const string& timestamp, struct timeval *ts)
 const string Reading::escape(const string& str) const
 {
 string rval;
-int bscount = 0;
 
-	for (size_t i = 0; i < str.length(); i++)
-	{
-		if (str[i] == '\\')
-		{
-			bscount++;
-		}
-		else if (str[i] == '\"')
-		{
-			if ((bscount & 1) == 0)	// not already escaped
-			{
-				rval += "\\";	// Add escape of "
-			}
-			bscount = 0;
-		}
-		else
-		{
-			bscount = 0;
-		}
-		rval += str[i];
-	}
+	JSONappendEscaped(rval, str.data(), str.length());
 	return rval;
 }
+
+/**
+ * Return the slab allocator used for Reading objects
+ */
+SlabAllocator *Reading::getAllocator()
+{
+	// Never destroyed, readings may outlive static destructors
+	static SlabAllocator *allocator = new SlabAllocator(sizeof(Reading));
+	return allocator;
+}
+
+/**
+ * Allocate a reading, from the slab allocator if enabled
+ */
+void *Reading::operator new(size_t size)
+{
+	return getAllocator()->allocate(size);
+}
+
+/**
+ * Free a reading allocated via the slab allocator
+ */
+void Reading::operator delete(void *ptr)
+{
+	SlabAllocator::release(ptr);
+}
+
+/**
+ * Enable or disable the use of the slab allocators for the
+ * Reading and Datapoint classes. Readings and datapoints that
+ * are already allocated are unaffected and may be freed safely
+ * regardless of the setting.
+ *
+ * @param enabled	True if readings should be allocated from slabs
+ */
+void setReadingSlabAllocation(bool enabled)
+{
+	Reading::getAllocator()->setEnabled(enabled);
+	Datapoint::getAllocator()->setEnabled(enabled);
+}
@@ -14,26 +14,22 @@
 #include <iostream>
 #include <time.h>
 #include <stdlib.h>
+#include <string.h>
 #include <logger.h>
 #include <base64databuffer.h>
 #include <base64dpimage.h>
 
-#include <boost/algorithm/string/replace.hpp>
 
 #define ASSET_NAME_INVALID_READING "error_invalid_reading"
 
+#define READING_PARSE_BLOCK	(16 * 1024)	// Size of the blocks read from a stream of readings
+
 static const char* kTypeNames[] =
     { "Null", "False", "True", "Object", "Array", "String", "Number" };
 
 using namespace std;
 using namespace rapidjson;
 
-// List of characters to be escaped in JSON
-const vector<string> JSON_characters_to_be_escaped = {
-	"\\",
-	"\""
-};
-
 /**
  * Construct an empty reading set
  */
@@ -64,83 +60,136 @@ ReadingSet::ReadingSet(const vector<Reading *>* readings) : m_last_id(0)
  * Construct a reading set from a JSON document returned from
  * the Fledge storage service query or notification.
  *
+ * The rows are parsed one at a time as the document is scanned, see
+ * ReadingSetParser, so a parsed document of all the rows is never held.
+ *
  * @param json	The JSON document (as string) with readings data
  */
-ReadingSet::ReadingSet(const std::string& json) : m_last_id(0)
+ReadingSet::ReadingSet(const std::string& json) : m_count(0), m_last_id(0)
 {
-	unsigned long rows = 0;
-	Document doc;
-	doc.Parse(json.c_str());
-	if (doc.HasParseError())
-	{
-		throw new ReadingSetException("Unable to parse results json document");
-	}
-	// Check we have "count" and "rows"
-	bool docHasRows =  doc.HasMember("rows"); // Query
-	bool docHasReadings =  doc.HasMember("readings"); // Notification
-
-	// Check we have "rows" or "readings"
-	if (!docHasRows && !docHasReadings)
-	{
-		throw new ReadingSetException("Missing readings or rows array");
-	}
+	ReadingSetParser parser(m_readings);
 
-	// Check we have "count" and "rows"
-	if (doc.HasMember("count") && docHasRows)
-	{
-		m_count = doc["count"].GetUint();
-		// No readings
-		if (!m_count)
+	try {
+		parser.parse(json.data(), json.length());
+		parser.finish();
+	} catch (...) {
+		for (auto reading : m_readings)
 		{
-			m_last_id = 0;
-			return;
+			delete reading;
 		}
+		throw;
 	}
-	else
-	{
-		// These fields might be updated later
-		m_count = 0;
-		m_last_id = 0;
-	}
+	setCount();
+}
 
-	// Get "rows" or "readings" data
-	const Value& readings = docHasRows ? doc["rows"] : doc["readings"];
-	if (readings.IsArray())
-	{
-		unsigned long id = 0;
-		// Process every rows and create the result set
-		for (auto& reading : readings.GetArray())
+/**
+ * Construct a reading set from a JSON document held in a buffer that
+ * may be modified. Each row is parsed in place in the buffer, so the
+ * text of the rows is not copied. The buffer is not needed once the
+ * reading set has been created and its content is then undefined.
+ *
+ * @param json		The JSON document with readings data
+ * @param length	The length of the document
+ */
+ReadingSet::ReadingSet(char *json, size_t length) : m_count(0), m_last_id(0)
+{
+	ReadingSetParser parser(m_readings);
+
+	try {
+		parser.parseInsitu(json, length);
+		parser.finish();
+	} catch (...) {
+		for (auto reading : m_readings)
 		{
-			if (!reading.IsObject())
-			{
-				throw new ReadingSetException("Expected reading to be an object");
-			}
-			JSONReading *value = new JSONReading(reading);
-			m_readings.push_back(value);
+			delete reading;
+		}
+		throw;
+	}
+	setCount();
+}
 
-			// Get the Reading Id
-			id = value->getId();
+/**
+ * Construct a reading set from a JSON document read from a stream.
+ * The document is read in blocks and the rows are parsed as they
+ * are read, see ReadingSetParser.
+ *
+ * @param json	The stream from which to read the JSON document
+ */
+ReadingSet::ReadingSet(std::istream& json) : m_count(0), m_last_id(0)
+{
+	char buffer[READING_PARSE_BLOCK];
+	ReadingSetParser parser(m_readings);
 
-			// We don't have count informations with "readings"
-			if (docHasReadings)
+	try {
+		while (json)
+		{
+			json.read(buffer, sizeof(buffer));
+			streamsize length = json.gcount();
+			if (length <= 0)
 			{
-				rows++;
+				break;
 			}
-
+			parser.parse(buffer, (size_t)length);
 		}
-		// Set the last id
-		m_last_id = id;
-
-		// Set count informations with "readings"
-		if (docHasReadings)
+		parser.finish();
+	} catch (...) {
+		for (auto reading : m_readings)
 		{
-			m_count = rows;
+			delete reading;
 		}
+		throw;
 	}
-	else
+	setCount();
+}
+
+/**
+ * Set the count and the last reading id from the parsed readings
+ */
+void ReadingSet::setCount()
+{
+	m_count = m_readings.size();
+	if (m_count)
+	{
+		m_last_id = m_readings.back()->getId();
+	}
+}
+
+/**
+ * Construct a reading set by taking the readings of another reading
+ * set, which is left empty
+ *
+ * @param other	The reading set to take the readings from
+ */
+ReadingSet::ReadingSet(ReadingSet&& other) : m_count(other.m_count),
+	m_readings(std::move(other.m_readings)), m_last_id(other.m_last_id)
+{
+	other.m_readings.clear();
+	other.m_count = 0;
+	other.m_last_id = 0;
+}
+
+/**
+ * Replace the readings of the reading set with those of another
+ * reading set, which is left empty
+ *
+ * @param other	The reading set to take the readings from
+ */
+ReadingSet& ReadingSet::operator=(ReadingSet&& other)
+{
+	if (this != &other)
 	{
-		throw new ReadingSetException("Expected array of rows in result set");
+		for (auto reading : m_readings)
+		{
+			delete reading;
+		}
+		m_readings = std::move(other.m_readings);
+		m_count = other.m_count;
+		m_last_id = other.m_last_id;
+		other.m_readings.clear();
+		other.m_count = 0;
+		other.m_last_id = 0;
 	}
+	return *this;
 }
 
 /**
@@ -280,6 +329,40 @@ JSONReading::JSONReading(const Value& json)
 		m_timestamp = m_userTimestamp;
 	}
 
+	addDatapoints(json);
+}
+
+/**
+ * Construct a reading from a JSON object that contains the reading values
+ * but neither the asset code nor the timestamps, which are given as
+ * the native values read from a binary fetch stream.
+ *
+ * @param id		The id of the reading
+ * @param asset		The asset code of the reading
+ * @param json		A JSON object with the "reading" values
+ * @param userTs	The user timestamp of the reading
+ * @param ts		The timestamp at which the reading was stored
+ */
+JSONReading::JSONReading(unsigned long id, const string& asset, const Value& json,
+			const struct timeval& userTs, const struct timeval& ts)
+{
+	m_id = id;
+	m_has_id = true;
+	m_asset = asset;
+	m_userTimestamp = userTs;
+	m_timestamp = ts;
+
+	addDatapoints(json);
+}
+
+/**
+ * Add the datapoints held in the "value" or "reading" member
+ * of a JSON reading
+ *
+ * @param json	The JSON reading
+ */
+void JSONReading::addDatapoints(const Value& json)
+{
 	// We have a single value here which is a number
 	if (json.HasMember("value") && json["value"].IsNumber())
 	{
@@ -329,20 +412,22 @@ JSONReading::JSONReading(const Value& json)
 				switch (m.value.GetType()) {
 					// String
 					case (kStringType): {
-						string str = m.value.GetString();
+						const char *str = m.value.GetString();
+						size_t len = m.value.GetStringLength();
 						if (str[0] == '_' && str[1] == '_')
 						{
-							// special encoded type
-							size_t pos = str.find_first_of(':');
-							if (str.compare(2, 10, "DATABUFFER") == 0)
+							// special encoded type, decoded straight from the document
+							const char *colon = (const char *)memchr(str, ':', len);
+							size_t pos = colon ? colon - str + 1 : len;
+							if (strncmp(str + 2, "DATABUFFER", 10) == 0)
 							{
-								DataBuffer *databuffer = new Base64DataBuffer(str.substr(pos + 1));
+								DataBuffer *databuffer = new Base64DataBuffer(str + pos, len - pos);
 								DatapointValue value(databuffer);
 								this->addDatapoint(new Datapoint(m.name.GetString(), value));
 							}
-							else if (str.compare(2, 7, "DPIMAGE") == 0)
+							else if (strncmp(str + 2, "DPIMAGE", 7) == 0)
 							{
-								DPImage *image = new Base64DPImage(str.substr(pos + 1));
+								DPImage *image = new Base64DPImage(str + pos, len - pos);
 								DatapointValue value(image);
 								this->addDatapoint(new Datapoint(m.name.GetString(), value));
 							}
@@ -350,7 +435,7 @@ JSONReading::JSONReading(const Value& json)
 						}
 						else
 						{
-							DatapointValue value(str);
+							DatapointValue value(str, len);
 							this->addDatapoint(new Datapoint(m.name.GetString(), value));
 						}
 						break;
@@ -552,13 +637,18 @@ JSONReading::JSONReading(const Value& json)
 			// invalid asset_name/values.
 			if (json["reading"].IsString())
 			{
-				string tmp_reading1 = json["reading"].GetString();
-
-				// Escape specific character for to be properly manage as JSON
-				for (const string &item : JSON_characters_to_be_escaped)
+				// Escape the backslashes and quotes to be properly managed as JSON
+				string tmp_reading1;
+				const char *str = json["reading"].GetString();
+				size_t length = json["reading"].GetStringLength();
+				tmp_reading1.reserve(length + 8);
+				for (size_t i = 0; i < length; i++)
 				{
-
-					escapeCharacter(tmp_reading1, item);
+					if (str[i] == '\\' || str[i] == '"')
+					{
+						tmp_reading1 += '\\';
+					}
+					tmp_reading1 += str[i];
 				}
 
 				Logger::getLogger()->error(
@@ -608,7 +698,217 @@ JSONReading::JSONReading(const Value& json)
  */
 void JSONReading::escapeCharacter(string& stringToEvaluate, string pattern)
 {
-	string escaped = "\\" + pattern;
+	if (pattern.empty())
+	{
+		return;
+	}
+	string escaped;
+	escaped.reserve(stringToEvaluate.length() + 8);
+	size_t start = 0, pos;
+	while ((pos = stringToEvaluate.find(pattern, start)) != string::npos)
+	{
+		escaped.append(stringToEvaluate, start, pos - start);
+		escaped += '\\';
+		escaped += pattern;
+		start = pos + pattern.length();
+	}
+	if (start == 0)
+	{
+		return;
+	}
+	escaped.append(stringToEvaluate, start, string::npos);
+	stringToEvaluate.swap(escaped);
+}
+
+/**
+ * Construct a parser that adds the readings it parses to a
+ * vector of readings
+ *
+ * @param readings	The vector to which readings are added
+ */
+ReadingSetParser::ReadingSetParser(vector<Reading *>& readings) : m_readings(readings),
+	m_depth(0), m_inString(false), m_escape(false), m_inRows(false), m_inRow(false),
+	m_hasRows(false)
+{
+}
 
-	boost::replace_all(stringToEvaluate, pattern, escaped);
+/**
+ * Parse the next part of the text of a JSON document of readings.
+ * The outer document is scanned for a "rows" or "readings" array,
+ * the text of each object in the array is collected and parsed
+ * once the object is complete.
+ *
+ * @param text		The next part of the document
+ * @param length	The length of the text
+ */
+void ReadingSetParser::parse(const char *text, size_t length)
+{
+	scan(text, length, NULL);
+}
+
+/**
+ * Parse a complete JSON document of readings that is held in a
+ * buffer that may be modified. The rows are parsed in place in the
+ * buffer rather than being copied.
+ *
+ * @param text		The document
+ * @param length	The length of the document
+ */
+void ReadingSetParser::parseInsitu(char *text, size_t length)
+{
+	scan(text, length, text);
+}
+
+/**
+ * Scan the text of a document for the rows of readings. When a row
+ * is complete it is parsed from the copy of its text, or from the
+ * text itself if an in place buffer is given.
+ *
+ * @param text		The next part of the document
+ * @param length	The length of the text
+ * @param insitu	The text if the rows are to be parsed in place, else NULL
+ */
+void ReadingSetParser::scan(const char *text, size_t length, char *insitu)
+{
+	// The start of the current row in this text, a row that started
+	// in an earlier part of the document continues from the start
+	size_t rowStart = 0;
+
+	for (size_t i = 0; i < length; i++)
+	{
+		char c = text[i];
+		if (m_inString)
+		{
+			if (m_escape)
+			{
+				m_escape = false;
+				continue;
+			}
+			if (m_depth != 1)
+			{
+				// Only the keys of the outer object are kept, skip
+				// the rest of the string to a quote or backslash
+				while (i < length && text[i] != '"' && text[i] != '\\')
+					i++;
+				if (i == length)
+					break;
+				c = text[i];
+			}
+			if (c == '\\')
+				m_escape = true;
+			else if (c == '"')
+				m_inString = false;
+			else
+				m_string.push_back(c);
+			continue;
+		}
+		switch (c)
+		{
+			case '"':
+				m_inString = true;
+				if (m_depth == 1)
+					m_string.clear();
+				break;
+			case ':':
+				if (m_depth == 1)
+					m_key = m_string;
+				break;
+			case ',':
+				if (m_depth == 1)
+					m_key.clear();
+				break;
+			case '{':
+				if (m_inRows && m_depth == 2)
+				{
+					m_inRow = true;
+					m_row.clear();
+					rowStart = i;
+				}
+				m_depth++;
+				break;
+			case '}':
+				m_depth--;
+				if (m_inRow && m_depth == 2)
+				{
+					m_inRow = false;
+					if (insitu)
+					{
+						row(insitu + rowStart);
+					}
+					else
+					{
+						// Copy the text of the row in one go
+						m_row.append(text + rowStart, i + 1 - rowStart);
+						row(&m_row[0]);
+					}
+				}
+				break;
+			case '[':
+				if (m_depth == 1 && (m_key.compare("rows") == 0 || m_key.compare("readings") == 0))
+				{
+					m_inRows = true;
+					m_hasRows = true;
+				}
+				m_depth++;
+				break;
+			case ']':
+				m_depth--;
+				if (m_inRows && m_depth == 1)
+				{
+					m_inRows = false;
+				}
+				break;
+			case ' ':
+			case '\t':
+			case '\r':
+			case '\n':
+				break;
+			default:
+				if (m_inRows && m_depth == 2)
+				{
+					throw new ReadingSetException("Expected reading to be an object");
+				}
+				break;
+		}
+	}
+	if (m_inRow && !insitu)
+	{
+		// Keep the part of the row in this text, the rest follows
+		m_row.append(text + rowStart, length - rowStart);
+	}
+}
+
+/**
+ * Check that a complete document has been parsed
+ */
+void ReadingSetParser::finish()
+{
+	if (m_depth != 0 || m_inString)
+	{
+		throw new ReadingSetException("Unable to parse results json document");
+	}
+	if (!m_hasRows)
+	{
+		throw new ReadingSetException("Missing readings or rows array");
+	}
+}
+
+/**
+ * Parse the text of a single row into a reading. The text is parsed
+ * in place and parsing stops at the end of the row, so the text may
+ * be followed by the rest of the document. The allocator is cleared
+ * for each row so that the memory used to parse the row is reused.
+ *
+ * @param text	The text of the row
+ */
+void ReadingSetParser::row(char *text)
+{
+	m_allocator.Clear();
+	Document doc(&m_allocator);
+	doc.ParseInsitu<kParseStopWhenDoneFlag>(text);
+	if (doc.HasParseError() || !doc.IsObject())
+	{
+		throw new ReadingSetException("Unable to parse results json document");
+	}
+	m_readings.push_back(new JSONReading(doc));
 }
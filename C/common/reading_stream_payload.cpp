@@ -0,0 +1,425 @@
+/*
+ * Fledge storage reading stream binary payload encoding.
+ *
+ * Copyright (c) 2026 Dianomic Systems
+ *
+ * Released under the Apache 2.0 Licence
+ *
+ * Author: agent
+ */
+#include <reading_stream_payload.h>
+#include <reading.h>
+#include <reading_set.h>
+#include <base64databuffer.h>
+#include <json_utils.h>
+#include <rapidjson/document.h>
+#include <string.h>
+#include <stdio.h>
+
+using namespace std;
+
+/**
+ * Append a fixed size value to the payload
+ */
+template<typename T> static inline void put(string& payload, T value)
+{
+	payload.append((const char *)&value, sizeof(T));
+}
+
+/**
+ * Extract a fixed size value from the payload, advancing the
+ * payload pointer. The payload data is not aligned and hence
+ * memcpy is used to extract the value.
+ *
+ * @return bool	False if the value would overrun the payload
+ */
+template<typename T> static inline bool get(const char *& ptr, const char *end, T& value)
+{
+	if (ptr + sizeof(T) > end)
+		return false;
+	memcpy(&value, ptr, sizeof(T));
+	ptr += sizeof(T);
+	return true;
+}
+
+/**
+ * Encode the datapoints of a reading into the binary payload
+ * of the reading stream protocol.
+ *
+ * @param reading	The reading to encode
+ * @param payload	The string to encode the payload into
+ */
+void ReadingStreamPayload::encode(const Reading& reading, string& payload)
+{
+	const vector<Datapoint *>& datapoints = const_cast<Reading&>(reading).getReadingData();
+	RDSPayloadHeader hdr;
+
+	payload.clear();
+	hdr.version = RDS_PAYLOAD_VERSION;
+	hdr.reserved = 0;
+	hdr.count = (uint32_t)datapoints.size();
+	put(payload, hdr);
+	for (auto dp : datapoints)
+	{
+		encodeDatapoint(dp, payload);
+	}
+}
+
+/**
+ * Encode a single datapoint into the binary payload
+ *
+ * @param datapoint	The datapoint to encode
+ * @param payload	The payload to append the datapoint to
+ */
+void ReadingStreamPayload::encodeDatapoint(Datapoint *datapoint, string& payload)
+{
+	const DatapointValue& value = datapoint->getData();
+	const string& name = datapoint->getName();
+	uint8_t type;
+
+	switch (value.getType())
+	{
+		case DatapointValue::T_INTEGER:
+			type = RDS_DP_INT64;
+			break;
+		case DatapointValue::T_FLOAT:
+			type = RDS_DP_DOUBLE;
+			break;
+		case DatapointValue::T_STRING:
+			type = RDS_DP_STRING;
+			break;
+		case DatapointValue::T_FLOAT_ARRAY:
+			type = RDS_DP_FLOAT_ARRAY;
+			break;
+		case DatapointValue::T_DATABUFFER:
+			type = RDS_DP_DATABUFFER;
+			break;
+		default:
+			type = RDS_DP_JSON;
+			break;
+	}
+	put(payload, type);
+	put(payload, (uint32_t)name.length());
+	payload.append(name);
+
+	switch (type)
+	{
+		case RDS_DP_INT64:
+			put(payload, (int64_t)value.toInt());
+			break;
+		case RDS_DP_DOUBLE:
+			put(payload, value.toDouble());
+			break;
+		case RDS_DP_STRING:
+		{
+			put(payload, (uint32_t)value.getStringLength());
+			payload.append(value.getStringData(), value.getStringLength());
+			break;
+		}
+		case RDS_DP_FLOAT_ARRAY:
+		{
+			const vector<double> *arr = value.getDpArr();
+			put(payload, (uint32_t)arr->size());
+			payload.append((const char *)arr->data(), arr->size() * sizeof(double));
+			break;
+		}
+		case RDS_DP_DATABUFFER:
+		{
+			const DataBuffer *buffer = value.getDataBuffer();
+			put(payload, (uint32_t)buffer->getItemSize());
+			put(payload, (uint32_t)buffer->getItemCount());
+			payload.append((const char *)buffer->getData(),
+					buffer->getItemSize() * buffer->getItemCount());
+			break;
+		}
+		default:
+		{
+			// Write the JSON in place and then fill in its length
+			size_t at = payload.length();
+			put(payload, (uint32_t)0);
+			value.appendJSON(payload);
+			uint32_t length = payload.length() - at - sizeof(uint32_t);
+			memcpy(&payload[at], &length, sizeof(uint32_t));
+			break;
+		}
+	}
+}
+
+/**
+ * Append a floating point value in the same format as
+ * DatapointValue::toString, i.e. ten decimal places with
+ * trailing zeros removed.
+ */
+static void appendDouble(string& json, double value)
+{
+	char buf[100];
+	int len = snprintf(buf, sizeof(buf), "%.10f", value);
+	if (len > 0 && buf[len - 1] == '0')
+	{
+		while (len > 0 && buf[len - 1] == '0')
+			len--;
+		if (buf[len - 1] == '.')
+			buf[len++] = '0';
+	}
+	json.append(buf, len);
+}
+
+/**
+ * Append a string value escaping quotes in the same way as
+ * DatapointValue::toString does
+ */
+static void appendString(string& json, const char *str, uint32_t length)
+{
+	json += '"';
+	JSONappendEscaped(json, str, length);
+	json += '"';
+}
+
+/**
+ * Convert a binary payload into the JSON representation of the
+ * datapoints, as would have been returned by Reading::getDatapointsJSON.
+ *
+ * @param payload	The binary payload
+ * @param length	The length of the payload in bytes
+ * @param json		The string to write the JSON document into
+ * @return bool		True if the payload was successfully decoded
+ */
+bool ReadingStreamPayload::toJSON(const char *payload, uint32_t length, string& json)
+{
+	const char *ptr = payload;
+	const char *end = payload + length;
+	RDSPayloadHeader hdr;
+
+	json.clear();
+	if (!get(ptr, end, hdr) || hdr.version != RDS_PAYLOAD_VERSION)
+	{
+		return false;
+	}
+	json.reserve(length * 2);
+	json += '{';
+	for (uint32_t i = 0; i < hdr.count; i++)
+	{
+		uint8_t type;
+		uint32_t nameLength;
+		if (!get(ptr, end, type) || !get(ptr, end, nameLength)
+				|| ptr + nameLength > end)
+		{
+			return false;
+		}
+		if (i)
+			json += ',';
+		json += '"';
+		json.append(ptr, nameLength);
+		json += "\":";
+		ptr += nameLength;
+
+		switch (type)
+		{
+			case RDS_DP_INT64:
+			{
+				int64_t value;
+				char buf[24];
+				if (!get(ptr, end, value))
+					return false;
+				int len = snprintf(buf, sizeof(buf), "%lld", (long long)value);
+				json.append(buf, len);
+				break;
+			}
+			case RDS_DP_DOUBLE:
+			{
+				double value;
+				if (!get(ptr, end, value))
+					return false;
+				appendDouble(json, value);
+				break;
+			}
+			case RDS_DP_STRING:
+			case RDS_DP_JSON:
+			{
+				uint32_t len;
+				if (!get(ptr, end, len) || ptr + len > end)
+					return false;
+				if (type == RDS_DP_STRING)
+					appendString(json, ptr, len);
+				else
+					json.append(ptr, len);
+				ptr += len;
+				break;
+			}
+			case RDS_DP_FLOAT_ARRAY:
+			{
+				uint32_t count;
+				if (!get(ptr, end, count) || ptr + (count * sizeof(double)) > end)
+					return false;
+				json += '[';
+				for (uint32_t j = 0; j < count; j++)
+				{
+					double value;
+					char buf[32];
+					get(ptr, end, value);
+					if (j)
+						json += ", ";
+					// Matches the default ostream formatting used by toString
+					int len = snprintf(buf, sizeof(buf), "%g", value);
+					json.append(buf, len);
+				}
+				json += ']';
+				break;
+			}
+			case RDS_DP_DATABUFFER:
+			{
+				uint32_t itemSize, count;
+				if (!get(ptr, end, itemSize) || !get(ptr, end, count)
+						|| ptr + ((size_t)itemSize * count) > end)
+					return false;
+				DataBuffer buffer(itemSize, count);
+				buffer.populate((void *)ptr, itemSize * count);
+				ptr += (size_t)itemSize * count;
+				json += "\"__DATABUFFER:";
+				((const Base64DataBuffer *)&buffer)->appendEncoded(json);
+				json += '"';
+				break;
+			}
+			default:
+				return false;
+		}
+	}
+	json += '}';
+	return true;
+}
+
+/**
+ * Decode a binary payload back into the datapoints it was encoded
+ * from. Values that were carried as JSON, such as nested datapoints,
+ * are parsed in the same way as readings returned by the storage layer.
+ *
+ * @param payload	The binary payload
+ * @param length	The length of the payload in bytes
+ * @param datapoints	The decoded datapoints are appended to this vector
+ * @return bool		True if the payload was successfully decoded, on
+ *			failure no datapoints are returned
+ */
+bool ReadingStreamPayload::decode(const char *payload, uint32_t length, vector<Datapoint *>& datapoints)
+{
+	const char *ptr = payload;
+	const char *end = payload + length;
+	RDSPayloadHeader hdr;
+	vector<Datapoint *> decoded;
+
+	if (!get(ptr, end, hdr) || hdr.version != RDS_PAYLOAD_VERSION)
+	{
+		return false;
+	}
+	decoded.reserve(hdr.count);
+	bool ok = true;
+	for (uint32_t i = 0; ok && i < hdr.count; i++)
+	{
+		uint8_t type;
+		uint32_t nameLength;
+		if (!get(ptr, end, type) || !get(ptr, end, nameLength)
+				|| ptr + nameLength > end)
+		{
+			ok = false;
+			break;
+		}
+		string name(ptr, nameLength);
+		ptr += nameLength;
+
+		switch (type)
+		{
+			case RDS_DP_INT64:
+			{
+				int64_t value;
+				if (!(ok = get(ptr, end, value)))
+					break;
+				DatapointValue dpv((long)value);
+				decoded.push_back(new Datapoint(name, dpv));
+				break;
+			}
+			case RDS_DP_DOUBLE:
+			{
+				double value;
+				if (!(ok = get(ptr, end, value)))
+					break;
+				DatapointValue dpv(value);
+				decoded.push_back(new Datapoint(name, dpv));
+				break;
+			}
+			case RDS_DP_STRING:
+			{
+				uint32_t len;
+				if (!(ok = get(ptr, end, len) && ptr + len <= end))
+					break;
+				DatapointValue dpv(string(ptr, len));
+				ptr += len;
+				decoded.push_back(new Datapoint(name, dpv));
+				break;
+			}
+			case RDS_DP_FLOAT_ARRAY:
+			{
+				uint32_t count;
+				if (!(ok = get(ptr, end, count) && ptr + (count * sizeof(double)) <= end))
+					break;
+				vector<double> values(count);
+				memcpy(values.data(), ptr, count * sizeof(double));
+				ptr += count * sizeof(double);
+				DatapointValue dpv(values);
+				decoded.push_back(new Datapoint(name, dpv));
+				break;
+			}
+			case RDS_DP_DATABUFFER:
+			{
+				uint32_t itemSize, count;
+				if (!(ok = get(ptr, end, itemSize) && get(ptr, end, count)
+						&& ptr + ((size_t)itemSize * count) <= end))
+					break;
+				DataBuffer *buffer = new DataBuffer(itemSize, count);
+				buffer->populate((void *)ptr, itemSize * count);
+				ptr += (size_t)itemSize * count;
+				DatapointValue dpv(buffer);
+				decoded.push_back(new Datapoint(name, dpv));
+				break;
+			}
+			case RDS_DP_JSON:
+			{
+				uint32_t len;
+				if (!(ok = get(ptr, end, len) && ptr + len <= end))
+					break;
+				string json = "{\"reading\":{\"";
+				json.append(name);
+				json.append("\":");
+				json.append(ptr, len);
+				json.append("}}");
+				ptr += len;
+				rapidjson::Document doc;
+				doc.Parse(json.c_str());
+				if (doc.HasParseError() || !doc.IsObject())
+				{
+					ok = false;
+					break;
+				}
+				struct timeval tv = { 0, 0 };
+				try {
+					JSONReading reading(0, "", doc, tv, tv);
+					vector<Datapoint *>& values = reading.getReadingData();
+					decoded.insert(decoded.end(), values.begin(), values.end());
+					values.clear();
+				} catch (...) {
+					ok = false;
+				}
+				break;
+			}
+			default:
+				ok = false;
+				break;
+		}
+	}
+	if (!ok)
+	{
+		for (auto dp : decoded)
+			delete dp;
+		return false;
+	}
+	datapoints.insert(datapoints.end(), decoded.begin(), decoded.end());
+	return true;
+}
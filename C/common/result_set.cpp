@@ -12,6 +12,8 @@
 #include <rapidjson/document.h>
 #include <sstream>
 #include <iostream>
+#include <new>
+#include <stdlib.h>
 
 using namespace std;
 using namespace rapidjson;
@@ -22,106 +24,157 @@ using namespace rapidjson;
  *
  * @param json	The JSON document to construct the result set from
  */
-ResultSet::ResultSet(const std::string& json)
+ResultSet::ResultSet(const std::string& json) : m_rowCount(0), m_json(json),
+	m_rowArena(NULL), m_valueArena(NULL), m_valueCount(0)
 {
-	Document doc;
-	doc.Parse(json.c_str());
-	if (doc.HasParseError())
+	parse();
+}
+
+/**
+ * Construct a result set from a JSON document returned from
+ * the Fledge storage service, taking the text of the document
+ * rather than copying it.
+ *
+ * @param json	The JSON document to construct the result set from
+ */
+ResultSet::ResultSet(std::string&& json) : m_rowCount(0), m_json(std::move(json)),
+	m_rowArena(NULL), m_valueArena(NULL), m_valueCount(0)
+{
+	parse();
+}
+
+/**
+ * Parse the text of the result set. The text is parsed in place, so
+ * the string columns are views of the text and the JSON columns are
+ * values of the one document of the result set. The rows and the
+ * column values are each constructed in a single block, so a result
+ * set costs a handful of allocations however many cells it has.
+ */
+void ResultSet::parse()
+{
+	m_doc.ParseInsitu(&m_json[0]);
+	if (m_doc.HasParseError())
 	{
 		throw new ResultException("Unable to parse results json document");
 	}
-	if (doc.HasMember("count"))
+	if (!m_doc.HasMember("count"))
+	{
+		m_rowCount = 0;
+		return;
+	}
+	m_rowCount = m_doc["count"].GetUint();
+	if (!m_rowCount)
 	{
-		m_rowCount = doc["count"].GetUint();
-		if (m_rowCount)
+		return;
+	}
+	if (!m_doc.HasMember("rows"))
+	{
+		throw new ResultException("Missing rows array");
+	}
+	const Value& rows = m_doc["rows"];
+	if (!rows.IsArray())
+	{
+		throw new ResultException("Expected array of rows in result set");
+	}
+	if (rows.Empty())
+	{
+		return;
+	}
+	try {
+		// Process first row to get column names and types
+		const Value& firstRow = rows[0];
+		for (Value::ConstMemberIterator itr = firstRow.MemberBegin(); itr != firstRow.MemberEnd(); ++itr)
 		{
-			const Value& rows = doc["rows"];
-			if (!doc.HasMember("rows"))
+			ColumnType type = STRING_COLUMN;
+			if (itr->value.IsObject())
 			{
-				throw new ResultException("Missing rows array");
+				type = JSON_COLUMN;
 			}
-			if (rows.IsArray())
+			else if (itr->value.IsNumber() && itr->value.IsDouble())
 			{
-				// Process first row to get column names and types
-				const Value& firstRow = rows[0];
-				for (Value::ConstMemberIterator itr = firstRow.MemberBegin(); itr != firstRow.MemberEnd(); ++itr)
-				{
-					ColumnType type = STRING_COLUMN;
-					if (itr->value.IsObject())
-					{
-						type = JSON_COLUMN;
-					}
-					else if (itr->value.IsNumber() && itr->value.IsDouble())
-					{
-						type = NUMBER_COLUMN;
-					}
-					else if (itr->value.IsNumber())
-					{
-						type = INT_COLUMN;
-					}
-					else if (itr->value.IsBool())
-					{
-						type = BOOL_COLUMN;
-					}
-					else if (itr->value.IsString())
-					{
-						type = STRING_COLUMN;
-					}
-					// Array of any objects is JSON
-					else if (itr->value.IsArray())
-					{
-						type = JSON_COLUMN;
-					}
-					else
-					{
-						throw new ResultException("Unable to determine column type");
-					}
-					m_columns.push_back(new Column(string(itr->name.GetString()), type));
-				}
-				// Process every rows and create the result set
-				for (auto& row : rows.GetArray())
-				{
-					if (!row.IsObject())
-					{
-						throw new ResultException("Expected row to be an object");
-					}
-					ResultSet::Row	*rowValue = new ResultSet::Row(this);
-					unsigned int colNo = 0;
-					for (Value::ConstMemberIterator item = row.MemberBegin(); item != row.MemberEnd(); ++item)
-					{
-						switch (m_columns[colNo]->getType())
-						{
-						case STRING_COLUMN:
-							rowValue->append(new ColumnValue(string(item->value.GetString())));
-							break;
-						case INT_COLUMN:
-							rowValue->append(new ColumnValue(item->value.GetInt()));
-							break;
-						case NUMBER_COLUMN:
-							rowValue->append(new ColumnValue(item->value.GetDouble()));
-							break;
-						case JSON_COLUMN:
-							rowValue->append(new ColumnValue(item->value));
-							break;
-						case BOOL_COLUMN:
-							// TODO Add support
-							rowValue->append(new ColumnValue(string("TODO")));
-							break;
-						}
-						colNo++;
-					}
-					m_rows.push_back(rowValue);
-				}
+				type = NUMBER_COLUMN;
+			}
+			else if (itr->value.IsNumber())
+			{
+				type = INT_COLUMN;
+			}
+			else if (itr->value.IsBool())
+			{
+				type = BOOL_COLUMN;
+			}
+			else if (itr->value.IsString())
+			{
+				type = STRING_COLUMN;
+			}
+			// Array of any objects is JSON
+			else if (itr->value.IsArray())
+			{
+				type = JSON_COLUMN;
 			}
 			else
 			{
-				throw new ResultException("Expected array of rows in result set");
+				throw new ResultException("Unable to determine column type");
 			}
+			m_columns.push_back(new Column(string(itr->name.GetString(), itr->name.GetStringLength()), type));
 		}
-	}
-	else
-	{
-		m_rowCount = 0;
+
+		size_t nRows = rows.Size();
+		size_t nColumns = m_columns.size();
+		m_rowArena = (ResultSet::Row *)malloc(nRows * sizeof(ResultSet::Row));
+		m_valueArena = (ResultSet::ColumnValue *)malloc((nRows * nColumns + 1) * sizeof(ResultSet::ColumnValue));
+		if (!m_rowArena || !m_valueArena)
+		{
+			throw new ResultException("Unable to allocate the result set");
+		}
+		m_rows.reserve(nRows);
+
+		// Process every rows and create the result set
+		for (auto& row : rows.GetArray())
+		{
+			if (!row.IsObject())
+			{
+				throw new ResultException("Expected row to be an object");
+			}
+			if (row.MemberCount() > nColumns)
+			{
+				throw new ResultException("Row has more columns than the first row");
+			}
+			ResultSet::Row *rowValue = new (&m_rowArena[m_rows.size()]) ResultSet::Row(this);
+			rowValue->m_owned = false;
+			rowValue->m_values.reserve(nColumns);
+			m_rows.push_back(rowValue);
+			unsigned int colNo = 0;
+			for (Value::ConstMemberIterator item = row.MemberBegin(); item != row.MemberEnd(); ++item)
+			{
+				void *cell = &m_valueArena[m_valueCount];
+				ColumnValue *value = NULL;
+				switch (m_columns[colNo]->getType())
+				{
+				case STRING_COLUMN:
+					value = new (cell) ColumnValue(const_cast<char *>(item->value.GetString()));
+					break;
+				case INT_COLUMN:
+					value = new (cell) ColumnValue(item->value.GetInt());
+					break;
+				case NUMBER_COLUMN:
+					value = new (cell) ColumnValue(item->value.GetDouble());
+					break;
+				case JSON_COLUMN:
+					value = new (cell) ColumnValue(&item->value);
+					break;
+				case BOOL_COLUMN:
+					// TODO Add support
+					value = new (cell) ColumnValue(const_cast<char *>("TODO"));
+					break;
+				}
+				m_valueCount++;
+				rowValue->append(value);
+				colNo++;
+			}
+		}
+	} catch (...) {
+		release();
+		throw;
 	}
 }
 
@@ -129,17 +182,36 @@ ResultSet::ResultSet(const std::string& json)
  * Destructor for a result set
  */
 ResultSet::~ResultSet()
+{
+	release();
+}
+
+/**
+ * Delete the columns, rows and values of the result set
+ */
+void ResultSet::release()
 {
 	/* Delete the columns */
 	for (auto it = m_columns.cbegin(); it != m_columns.cend(); it++)
 	{
 		delete *it;
 	}
-	/* Delete the rows */
+	m_columns.clear();
+	/* Delete the rows, which are constructed in the arena */
 	for (auto it = m_rows.cbegin(); it != m_rows.cend(); it++)
 	{
-		delete *it;
+		(*it)->~Row();
+	}
+	m_rows.clear();
+	for (size_t i = 0; i < m_valueCount; i++)
+	{
+		m_valueArena[i].~ColumnValue();
 	}
+	m_valueCount = 0;
+	free(m_rowArena);
+	m_rowArena = NULL;
+	free(m_valueArena);
+	m_valueArena = NULL;
 }
 
 /**
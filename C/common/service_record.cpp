@@ -8,8 +8,8 @@
  * Author: Mark Riddoch
  */
 #include <service_record.h>
+#include <json_utils.h>
 #include <string>
-#include <sstream>
 
 using namespace std;
 
@@ -62,22 +62,22 @@ ServiceRecord::ServiceRecord(const string& name) : m_name(name),
  */
 void ServiceRecord::asJSON(string& json) const
 {
-ostringstream convert;
+JSONWriter writer(256);
 
-	convert << "{ ";
-	convert << "\"name\" : \"" << m_name << "\",";
-	convert << "\"type\" : \"" << m_type << "\",";
-	convert << "\"protocol\" : \"" << m_protocol << "\",";
-	convert << "\"address\" : \"" << m_address << "\",";
-	convert << "\"management_port\" : " << m_managementPort;
+	writer.append("{ ");
+	writer.append("\"name\" : ").appendString(m_name).append(",");
+	writer.append("\"type\" : ").appendString(m_type).append(",");
+	writer.append("\"protocol\" : ").appendString(m_protocol).append(",");
+	writer.append("\"address\" : ").appendString(m_address).append(",");
+	writer.append("\"management_port\" : ").append((long)m_managementPort);
 	if (m_port)
 	{
-		convert << ",\"service_port\" : " << m_port;
+		writer.append(",\"service_port\" : ").append((long)m_port);
 	}
 	if (m_token != "") {
-		convert << ",\"token\" : \"" << m_token << "\"";
+		writer.append(",\"token\" : ").appendString(m_token);
 	}
-	convert << " }";
+	writer.append(" }");
 
-	json = convert.str();
+	json = writer.str();
 }
@@ -0,0 +1,140 @@
+/*
+ * Fledge slab allocator for fixed size objects
+ *
+ * Copyright (c) 2026 Dianomic Systems
+ *
+ * Released under the Apache 2.0 Licence
+ *
+ * Author: agent
+ */
+#include <slab_allocator.h>
+#include <cstdlib>
+#include <new>
+
+using namespace std;
+
+/**
+ * Construct a slab allocator for objects of a given size
+ *
+ * @param objectSize	The size of the objects to allocate
+ * @param slabObjects	The number of objects to allocate in each slab
+ */
+SlabAllocator::SlabAllocator(size_t objectSize, unsigned int slabObjects) :
+	m_slotSize(sizeof(Header) + ((objectSize + sizeof(Header) - 1) / sizeof(Header)) * sizeof(Header)),
+	m_slabObjects(slabObjects), m_enabled(false), m_free(NULL), m_freeCount(0)
+{
+}
+
+/**
+ * Allocate memory for an object. If slab allocation is enabled and
+ * the object fits in a slot the memory is taken from the free list,
+ * otherwise it is allocated from the heap.
+ *
+ * @param size	The size of the object required
+ * @return void*	The memory for the object
+ */
+void *SlabAllocator::allocate(size_t size)
+{
+	Header *hdr;
+
+	if (m_enabled && size + sizeof(Header) <= m_slotSize)
+	{
+		lock_guard<mutex> guard(m_mutex);
+		if (!m_free)
+		{
+			grow();
+		}
+		hdr = (Header *)m_free;
+		m_free = m_free->next;
+		m_freeCount--;
+		hdr->owner = this;
+	}
+	else
+	{
+		hdr = (Header *)malloc(sizeof(Header) + size);
+		if (!hdr)
+		{
+			throw bad_alloc();
+		}
+		hdr->owner = NULL;
+	}
+	return hdr + 1;
+}
+
+/**
+ * Release memory previously returned by allocate. The memory is
+ * returned to the free list of the slab allocator it came from
+ * or to the heap.
+ *
+ * @param ptr	The memory to release
+ */
+void SlabAllocator::release(void *ptr)
+{
+	if (!ptr)
+	{
+		return;
+	}
+	Header *hdr = (Header *)ptr - 1;
+	if (hdr->owner)
+	{
+		hdr->owner->free(hdr);
+	}
+	else
+	{
+		::free(hdr);
+	}
+}
+
+/**
+ * Return a slot to the free list
+ *
+ * @param hdr	The header of the slot to free
+ */
+void SlabAllocator::free(Header *hdr)
+{
+	FreeSlot *slot = (FreeSlot *)hdr;
+
+	lock_guard<mutex> guard(m_mutex);
+	slot->next = m_free;
+	m_free = slot;
+	m_freeCount++;
+}
+
+/**
+ * Allocate a new slab and add the slots within it to the
+ * free list. Called with the mutex held.
+ */
+void SlabAllocator::grow()
+{
+	char *slab = (char *)malloc(m_slotSize * m_slabObjects);
+	if (!slab)
+	{
+		throw bad_alloc();
+	}
+	m_slabs.push_back(slab);
+	for (unsigned int i = 0; i < m_slabObjects; i++)
+	{
+		FreeSlot *slot = (FreeSlot *)(slab + (i * m_slotSize));
+		slot->next = m_free;
+		m_free = slot;
+	}
+	m_freeCount += m_slabObjects;
+}
+
+/**
+ * Return the number of slabs that have been allocated
+ */
+size_t SlabAllocator::getSlabCount()
+{
+	lock_guard<mutex> guard(m_mutex);
+	return m_slabs.size();
+}
+
+/**
+ * Return the number of slots on the free list
+ */
+size_t SlabAllocator::getFreeCount()
+{
+	lock_guard<mutex> guard(m_mutex);
+	return m_freeCount;
+}
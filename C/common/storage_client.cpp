@@ -11,19 +11,32 @@
 #include <reading.h>
 #include <reading_set.h>
 #include <reading_stream.h>
+#include <reading_stream_payload.h>
 #include <rapidjson/document.h>
 #include <rapidjson/error/en.h>
 #include <management_client.h>
 #include <service_record.h>
+#include <tracer.h>
 #include <string>
 #include <sstream>
 #include <iostream>
 #include <thread>
 #include <map>
 #include <string_utils.h>
+#include <json_utils.h>
 #include <sys/uio.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/mman.h>
+#include <stddef.h>
+#include <limits>
+#include <poll.h>
+#include <time.h>
 #include <errno.h>
 #include <stdarg.h>
+#include <algorithm>
+#include <zlib.h>
+#include <netdb.h>
 
 #define EXCEPTION_BUFFER_SIZE 120
 
@@ -43,8 +56,21 @@ std::mutex sto_mtx_client_map;
 /**
  * Storage Client constructor
  */
-StorageClient::StorageClient(const string& hostname, const unsigned short port) : m_streaming(false), m_management(NULL)
+StorageClient::StorageClient(const string& hostname, const unsigned short port) : m_streaming(false), m_appendMode(AppendAuto), m_streamProtocol(1), m_management(NULL),
+	m_fetchStream(-1), m_fetchNext(0), m_fetchBlockSize(0), m_fetchRetry(0),
+	m_sharedSocket(-1), m_sharedDoorbell(-1), m_sharedAck(-1), m_shared(NULL), m_sharedRing(NULL),
+	m_sharedBlock(0), m_sharedRetry(0), m_async_running(false)
 {
+	m_stream = -1;
+	m_readingBlock = 0;
+	m_streamAcks = false;
+	m_ackBytes = 0;
+	m_streamCompression = CompressAuto;
+	m_streamCompress = false;
+	m_streamSending = false;
+	m_streamSenderRunning = false;
+	m_streamError = 0;
+	m_dictionaryAge = 0;
 	m_host = hostname;
 	m_pid = getpid();
 	m_logger = Logger::getLogger();
@@ -55,8 +81,22 @@ StorageClient::StorageClient(const string& hostname, const unsigned short port)
  * Storage Client constructor
  * stores the provided HttpClient into the map
  */
-StorageClient::StorageClient(HttpClient *client) : m_streaming(false), m_management(NULL)
+StorageClient::StorageClient(HttpClient *client) : m_streaming(false), m_appendMode(AppendAuto), m_streamProtocol(1), m_management(NULL),
+	m_fetchStream(-1), m_fetchNext(0), m_fetchBlockSize(0), m_fetchRetry(0),
+	m_sharedSocket(-1), m_sharedDoorbell(-1), m_sharedAck(-1), m_shared(NULL), m_sharedRing(NULL),
+	m_sharedBlock(0), m_sharedRetry(0), m_async_running(false)
 {
+	m_stream = -1;
+	m_readingBlock = 0;
+	m_streamAcks = false;
+	m_ackBytes = 0;
+	m_streamCompression = CompressAuto;
+	m_streamCompress = false;
+	m_streamSending = false;
+	m_streamSenderRunning = false;
+	m_streamError = 0;
+	m_dictionaryAge = 0;
+	m_logger = Logger::getLogger();
 
 	std::thread::id thread_id = std::this_thread::get_id();
 
@@ -73,6 +113,47 @@ StorageClient::~StorageClient()
 {
 	std::map<std::thread::id, HttpClient *>::iterator item;
 
+	if (!m_async_threads.empty())
+	{
+		{
+			lock_guard<mutex> guard(m_mtx_async);
+			m_async_running = false;
+		}
+		m_async_cv.notify_all();
+		for (auto& t : m_async_threads)
+		{
+			t.join();
+		}
+	}
+
+	closeFetchStream();
+	closeSharedStream();
+	if (m_streaming && m_streamAcks)
+	{
+		// Give the storage service the chance to store the blocks in flight
+		while (!m_unacked.empty() && readStreamAcks(true));
+	}
+	closeStream();
+	if (m_streamSenderThread.joinable())
+	{
+		{
+			lock_guard<mutex> guard(m_streamMutex);
+			m_streamSenderRunning = false;
+		}
+		m_streamCV.notify_all();
+		m_streamSenderThread.join();
+	}
+	if (!m_unacked.empty())
+	{
+		m_logger->warn("%d blocks of readings sent on the stream were not acknowledged",
+				(int)m_unacked.size());
+	}
+	for (auto& block : m_unacked)
+	{
+		for (auto reading : block.readings)
+			delete reading;
+	}
+
 	// Deletes all the HttpClient objects created in the map
 	for (item  = m_client_map.begin() ; item  != m_client_map.end() ; ++item)
 	{
@@ -112,18 +193,80 @@ HttpClient *StorageClient::getHttpClient(void) {
 	return (client);
 }
 
+/**
+ * Queue a request to be made by the asynchronous request threads,
+ * starting the threads if they are not already running. Requests are
+ * started in the order they are queued, up to STORAGE_ASYNC_THREADS
+ * of them are in flight at once.
+ *
+ * A client created from an HttpClient has no address for the threads
+ * to connect to, the request is made on the calling thread.
+ *
+ * @param request	The request to make
+ */
+void StorageClient::queueRequest(function<void ()> request)
+{
+	if (m_urlbase.str().empty())
+	{
+		request();
+		return;
+	}
+	{
+		lock_guard<mutex> guard(m_mtx_async);
+		m_async_queue.push_back(request);
+		if (m_async_threads.empty())
+		{
+			m_async_running = true;
+			for (int i = 0; i < STORAGE_ASYNC_THREADS; i++)
+			{
+				m_async_threads.emplace_back(&StorageClient::asyncRequests, this);
+			}
+		}
+	}
+	m_async_cv.notify_one();
+}
+
+/**
+ * An asynchronous request thread. Each thread keeps its own connection
+ * to the storage service, the queue is emptied before the threads exit.
+ */
+void StorageClient::asyncRequests()
+{
+	// Create the connection and sequence number of the thread under the lock
+	getHttpClient();
+
+	unique_lock<mutex> lck(m_mtx_async);
+	while (m_async_running || !m_async_queue.empty())
+	{
+		if (m_async_queue.empty())
+		{
+			m_async_cv.wait(lck);
+			continue;
+		}
+		function<void ()> request = m_async_queue.front();
+		m_async_queue.pop_front();
+		lck.unlock();
+		try {
+			request();
+		} catch (exception& e) {
+			m_logger->error("Asynchronous request to the storage service failed: %s", e.what());
+		} catch (...) {
+			m_logger->error("Asynchronous request to the storage service failed");
+		}
+		lck.lock();
+	}
+}
+
 /**
  * Append a single reading
  */
 bool StorageClient::readingAppend(Reading& reading)
 {
 	try {
-		ostringstream convert;
-
-		convert << "{ \"readings\" : [ ";
-		convert << reading.toJSON();
-		convert << " ] }";
-		auto res = this->getHttpClient()->request("POST", "/storage/reading", convert.str());
+		string payload = "{ \"readings\" : [ ";
+		reading.appendJSON(payload);
+		payload += " ] }";
+		auto res = this->getHttpClient()->request("POST", "/storage/reading", payload);
 		if (res->status_code.compare("200 OK") == 0)
 		{
 			return true;
@@ -141,16 +284,51 @@ bool StorageClient::readingAppend(Reading& reading)
 /**
  * Append multiple readings
  *
- * TODO implement a mechanism to force streamed or non-streamed mode
+ * The transport is chosen by the append mode, a mode that can not be
+ * used falls back to the REST API.
  */
 bool StorageClient::readingAppend(const vector<Reading *>& readings)
 {
+	TRACE_SPAN("storage-client", "StorageClient::readingAppend");
 #if INSTRUMENT
 	struct timeval	start, t1, t2;
 #endif
 	if (m_streaming)
 	{
-		return streamReadings(readings);
+		bool rval = streamReadings(readings);
+		if (rval || m_streaming || !m_streamAcks)
+		{
+			return rval;
+		}
+		// The stream has been lost, a new stream is opened below
+		// and the unacknowledged blocks are sent again
+	}
+	if (m_appendMode == AppendStream)
+	{
+		if (openStream())
+		{
+			return streamReadings(readings);
+		}
+		m_logger->warn("Failed to open the readings stream, using the REST API");
+		m_appendMode = AppendREST;
+		if (!appendUnacknowledged())
+		{
+			return false;
+		}
+	}
+	// Use the shared memory stream if the storage service is on this host
+	if ((m_appendMode == AppendAuto || m_appendMode == AppendShared) && sharedStreamAvailable())
+	{
+		size_t sent = 0;
+		if (streamSharedReadings(readings, sent))
+		{
+			return true;
+		}
+		if (sent > 0)
+		{
+			vector<Reading *> rest(readings.begin() + sent, readings.end());
+			return readingAppend(rest);
+		}
 	}
 	// See if we should switch to stream mode
 	struct timeval tmFirst, tmLast, dur;
@@ -185,22 +363,24 @@ bool StorageClient::readingAppend(const vector<Reading *>& readings)
 #if INSTRUMENT
 		gettimeofday(&start, NULL);
 #endif
-		ostringstream convert;
-		convert << "{ \"readings\" : [ ";
+		// Serialise the readings straight into the payload
+		string payload;
+		payload.reserve(64 + readings.size() * 256);
+		payload = "{ \"readings\" : [ ";
 		for (vector<Reading *>::const_iterator it = readings.cbegin();
 						 it != readings.cend(); ++it)
 		{
 			if (it != readings.cbegin())
 			{
-				convert << ", ";
+				payload += ", ";
 			}
-			convert << (*it)->toJSON();
+			(*it)->appendJSON(payload);
 		}
-		convert << " ] }";
+		payload += " ] }";
 #if INSTRUMENT
 		gettimeofday(&t1, NULL);
 #endif
-		auto res = this->getHttpClient()->request("POST", "/storage/reading", convert.str(), headers);
+		auto res = this->getHttpClient()->request("POST", "/storage/reading", payload, headers);
 #if INSTRUMENT
 		gettimeofday(&t2, NULL);
 #endif
@@ -216,7 +396,7 @@ bool StorageClient::readingAppend(const vector<Reading *>& readings)
 			m_logger->info("Appended %d readings in %.3f seconds. Took %.3f seconds to build request", readings.size(), requestTime, buildTime);
 			m_logger->info("%.1f Readings per second, request building %.2f%% of time", readings.size() / (buildTime + requestTime),
 					(buildTime * 100) / (requestTime + buildTime));
-			m_logger->info("Request block size %dK", strlen(convert.str().c_str())/1024);
+			m_logger->info("Request block size %dK", payload.length()/1024);
 #endif
 			return true;
 		}
@@ -247,7 +427,7 @@ ResultSet *StorageClient::readingQuery(const Query& query)
 		{
 			ostringstream resultPayload;
 			resultPayload << res->content.rdbuf();
-			ResultSet *result = new ResultSet(resultPayload.str().c_str());
+			ResultSet *result = new ResultSet(resultPayload.str());
 			return result;
 		}
 		ostringstream resultPayload;
@@ -280,9 +460,8 @@ ReadingSet *StorageClient::readingQueryToReadings(const Query& query)
 		auto res = this->getHttpClient()->request("PUT", "/storage/reading/query", convert.str());
 		if (res->status_code.compare("200 OK") == 0)
 		{
-			ostringstream resultPayload;
-			resultPayload << res->content.rdbuf();
-			ReadingSet* result = new ReadingSet(resultPayload.str().c_str());
+			// Parse the readings directly from the response content
+			ReadingSet* result = new ReadingSet(res->content);
 			return result;
 		}
 		ostringstream resultPayload;
@@ -299,6 +478,24 @@ ReadingSet *StorageClient::readingQueryToReadings(const Query& query)
 	return 0;
 }
 
+/**
+ * Retrieve a set of readings on an asynchronous request thread, several
+ * fetches may be in flight at once
+ *
+ * @param readingId	The ID of the reading which should be the first one to send
+ * @param count		Maximum number if readings to return
+ * @return		A future for the set of readings, it holds the exception if the fetch fails
+ */
+future<ReadingSet *> StorageClient::readingFetchAsync(const unsigned long readingId, const unsigned long count)
+{
+	ReadingSet *(StorageClient::*method)(const unsigned long, const unsigned long) = &StorageClient::readingFetch;
+	auto task = make_shared<packaged_task<ReadingSet *()> >(
+			bind(method, this, readingId, count));
+	future<ReadingSet *> result = task->get_future();
+	queueRequest([task]() { (*task)(); });
+	return result;
+}
+
 /**
  * Retrieve a set of readings for sending on the northbound
  * interface of Fledge
@@ -309,6 +506,7 @@ ReadingSet *StorageClient::readingQueryToReadings(const Query& query)
  */
 ReadingSet *StorageClient::readingFetch(const unsigned long readingId, const unsigned long count)
 {
+	TRACE_SPAN("storage-client", "StorageClient::readingFetch");
 	try {
 
 		char url[256];
@@ -318,9 +516,8 @@ ReadingSet *StorageClient::readingFetch(const unsigned long readingId, const uns
 		auto res = this->getHttpClient()->request("GET", url);
 		if (res->status_code.compare("200 OK") == 0)
 		{
-			ostringstream resultPayload;
-			resultPayload << res->content.rdbuf();
-			ReadingSet *result = new ReadingSet(resultPayload.str().c_str());
+			// Parse the readings directly from the response content
+			ReadingSet *result = new ReadingSet(res->content);
 			return result;
 		}
 		ostringstream resultPayload;
@@ -337,6 +534,409 @@ ReadingSet *StorageClient::readingFetch(const unsigned long readingId, const uns
 	return 0;
 }
 
+/**
+ * Append a list of strings to a JSON document as an array
+ */
+static void jsonArray(ostringstream& json, const vector<string>& values)
+{
+	json << "[";
+	for (size_t i = 0; i < values.size(); i++)
+	{
+		json << (i ? ", \"" : "\"") << JSONescape(values[i]) << "\"";
+	}
+	json << "]";
+}
+
+/**
+ * Fetch a block of the readings of some of the assets, with some of their
+ * datapoints. The storage service does not read the readings that are not
+ * wanted if its plugin supports it.
+ *
+ * As the readings not wanted are not returned the id of the last reading
+ * returned does not show how far the readings have been read, the id from
+ * which the next fetch should start is returned in next.
+ *
+ * @param readingId	The id of the first reading to fetch
+ * @param count		The maximum number of readings to read
+ * @param filter	The assets and datapoints wanted
+ * @param next		Set to the id from which the next fetch should start
+ * @return ReadingSet*	The readings wanted
+ */
+ReadingSet *StorageClient::readingFetch(const unsigned long readingId, const unsigned long count,
+					const ReadingFetchFilter& filter, unsigned long& next)
+{
+	TRACE_SPAN("storage-client", "StorageClient::readingFetch");
+	try {
+		ostringstream payload;
+		payload << "{ \"id\" : " << readingId << ", \"count\" : " << count;
+		payload << ", \"assets\" : ";
+		jsonArray(payload, filter.assets);
+		payload << ", \"exclude\" : " << (filter.exclude ? "true" : "false");
+		payload << ", \"datapoints\" : ";
+		jsonArray(payload, filter.datapoints);
+		payload << " }";
+
+		auto res = this->getHttpClient()->request("PUT", "/storage/reading/fetch", payload.str());
+		if (res->status_code.compare("200 OK") == 0)
+		{
+			string content = res->content.string();
+			// The next id precedes the rows, the only other member
+			// before them is the count
+			next = 0;
+			size_t rows = content.find("\"rows\"");
+			size_t pos = content.find("\"next\"");
+			if (pos != string::npos && pos < rows)
+			{
+				pos = content.find(':', pos);
+				if (pos != string::npos)
+					next = strtoul(content.c_str() + pos + 1, NULL, 10);
+			}
+			return new ReadingSet(&content[0], content.length());
+		}
+		ostringstream resultPayload;
+		resultPayload << res->content.rdbuf();
+		handleUnexpectedResponse("Fetch readings", res->status_code, resultPayload.str());
+	} catch (exception& ex) {
+		handleException(ex, "fetch readings");
+		throw;
+	} catch (exception* ex) {
+		handleException(*ex, "fetch readings");
+		delete ex;
+		throw exception();
+	}
+	return 0;
+}
+
+/**
+ * Export the readings of a range of time and assets. The storage service
+ * streams the readings as binary blocks, see StorageApi::readingExport,
+ * and each block is passed to the batch callback as a columnar set of
+ * readings, the readings belong to the client only for the duration of
+ * the callback. The callback returns false to end the export early.
+ *
+ * An export that is cut short may be resumed by setting the id of the
+ * range to the one after the last reading received.
+ *
+ * @param range		The readings to export
+ * @param batch		Called with each block of readings
+ * @return bool		True if all the readings of the range were passed to the callback
+ */
+bool StorageClient::readingExport(const ReadingExportRange& range,
+			std::function<bool (ColumnarReadingSet& batch)> batch)
+{
+	TRACE_SPAN("storage-client", "StorageClient::readingExport");
+	try {
+		ostringstream payload;
+		payload << "{ \"id\" : " << range.id << ", \"assets\" : ";
+		jsonArray(payload, range.assets);
+		if (!range.start.empty())
+			payload << ", \"start\" : \"" << JSONescape(range.start) << "\"";
+		if (!range.end.empty())
+			payload << ", \"end\" : \"" << JSONescape(range.end) << "\"";
+		payload << " }";
+
+		auto res = this->getHttpClient()->request("PUT", "/storage/reading/export", payload.str());
+		if (res->status_code.compare("200 OK") != 0)
+		{
+			ostringstream resultPayload;
+			resultPayload << res->content.rdbuf();
+			handleUnexpectedResponse("Export readings", res->status_code, resultPayload.str());
+			return false;
+		}
+
+		istream& content = res->content;
+		string asset, reading;
+		RDSBlockHeader blkhdr;
+		while (content.read((char *)&blkhdr, sizeof(blkhdr)))
+		{
+			if (blkhdr.magic != RDS_BLOCK_MAGIC)
+			{
+				m_logger->error("Invalid block header received in the readings export");
+				return false;
+			}
+			if (blkhdr.count == 0)
+			{
+				// The end of the export
+				return true;
+			}
+			vector<Reading *> readings;
+			for (uint32_t i = 0; i < blkhdr.count; i++)
+			{
+				RDSFetchReadingHeader hdr;
+				if (!content.read((char *)&hdr, sizeof(hdr)) || hdr.magic != RDS_FETCH_READING_MAGIC)
+				{
+					m_logger->error("Invalid reading header received in the readings export");
+					break;
+				}
+				asset.resize(hdr.assetLength);
+				reading.resize(hdr.payloadLength);
+				if (!content.read(&asset[0], hdr.assetLength)
+					|| !content.read(&reading[0], hdr.payloadLength))
+				{
+					break;
+				}
+				Document doc;
+				doc.Parse(reading.c_str(), reading.length());
+				if (doc.HasParseError())
+				{
+					m_logger->error("Failed to parse the reading %lu of the readings export: %s",
+							(unsigned long)hdr.id, GetParseError_En(doc.GetParseError()));
+					continue;
+				}
+				Value row(kObjectType);
+				row.AddMember("reading", doc, doc.GetAllocator());
+				readings.push_back(new JSONReading(hdr.id, asset, row, hdr.userTs, hdr.ts));
+			}
+			ReadingSet readingSet(&readings);
+			if (readingSet.getCount() < blkhdr.count && !content)
+			{
+				m_logger->error("The readings export was cut short");
+				return false;
+			}
+			ColumnarReadingSet columns(readingSet);
+			if (!batch(columns))
+			{
+				return false;
+			}
+		}
+		m_logger->error("The readings export ended without the end of export block");
+	} catch (exception& ex) {
+		handleException(ex, "export readings");
+	} catch (ReadingSetException *ex) {
+		m_logger->error("Readings export failed: %s", ex->what());
+		delete ex;
+	}
+	return false;
+}
+
+/**
+ * Fetch a block of readings using the fetch stream of the storage
+ * service. The storage service pushes blocks of readings ahead of
+ * the requests, removing the request latency and the JSON encoding
+ * of the reading metadata. The readings fetch API is used if the
+ * stream can not be created, for example because the storage plugin
+ * does not support it, and creation is retried periodically.
+ *
+ * The stream may only be used by a single thread.
+ *
+ * @param readingId	The id of the first reading to return
+ * @param count		The maximum number of readings to return
+ * @return ReadingSet*	The readings, an empty set if none are available within FETCH_STREAM_WAIT
+ */
+ReadingSet *StorageClient::readingFetchStream(const unsigned long readingId, const unsigned long count)
+{
+	TRACE_SPAN("storage-client", "StorageClient::readingFetchStream");
+	if (m_fetchStream != -1 && readingId < m_fetchNext)
+	{
+		// Blocks in flight would be ahead of the readings required
+		closeFetchStream();
+		m_fetchRetry = 0;
+	}
+	if (m_fetchStream == -1)
+	{
+		if (time(0) < m_fetchRetry || !openFetchStream())
+		{
+			return readingFetch(readingId, count);
+		}
+	}
+	if (readingId != m_fetchNext || count != m_fetchBlockSize)
+	{
+		// Move the stream on to the requested readings, any readings
+		// in flight before them are discarded by readFetchBlock
+		RDSSubscribe sub;
+		sub.magic = RDS_SUBSCRIBE_MAGIC;
+		sub.blockSize = count;
+		sub.id = readingId;
+		if (write(m_fetchStream, &sub, sizeof(sub)) != sizeof(sub))
+		{
+			m_logger->warn("Failed to subscribe to the fetch stream: %s", strerror(errno));
+			closeFetchStream();
+			return readingFetch(readingId, count);
+		}
+		m_fetchNext = readingId;
+		m_fetchBlockSize = count;
+	}
+
+	struct pollfd fds;
+	fds.fd = m_fetchStream;
+	fds.events = POLLIN;
+	int rval = poll(&fds, 1, FETCH_STREAM_WAIT);
+	if (rval == 0)
+	{
+		return new ReadingSet();
+	}
+	ReadingSet *readings = NULL;
+	if (rval > 0 && (fds.revents & POLLIN))
+	{
+		readings = readFetchBlock(readingId);
+	}
+	if (!readings)
+	{
+		closeFetchStream();
+		return readingFetch(readingId, count);
+	}
+	return readings;
+}
+
+/**
+ * Read a block from the fetch stream and acknowledge it. Readings
+ * before the requested id, left in flight by an earlier subscription,
+ * are discarded.
+ *
+ * @param readingId	The id of the first reading required
+ * @return ReadingSet*	The readings or NULL if the stream has failed
+ */
+ReadingSet *StorageClient::readFetchBlock(const unsigned long readingId)
+{
+	RDSBlockHeader blkhdr;
+	if (!readFetchStream(&blkhdr, sizeof(blkhdr)) || blkhdr.magic != RDS_BLOCK_MAGIC)
+	{
+		m_logger->warn("Invalid block header received on the fetch stream");
+		return NULL;
+	}
+	vector<Reading *> readings;
+	try {
+		for (uint32_t i = 0; i < blkhdr.count; i++)
+		{
+			RDSFetchReadingHeader hdr;
+			if (!readFetchStream(&hdr, sizeof(hdr)) || hdr.magic != RDS_FETCH_READING_MAGIC)
+			{
+				throw runtime_error("invalid reading header");
+			}
+			m_fetchAsset.resize(hdr.assetLength);
+			m_fetchPayload.resize(hdr.payloadLength);
+			if (!readFetchStream(&m_fetchAsset[0], hdr.assetLength)
+				|| !readFetchStream(&m_fetchPayload[0], hdr.payloadLength))
+			{
+				throw runtime_error("short read");
+			}
+			if (hdr.id < readingId)
+			{
+				continue;
+			}
+			Document doc;
+			doc.Parse(m_fetchPayload.c_str(), m_fetchPayload.length());
+			if (doc.HasParseError())
+			{
+				m_logger->error("Failed to parse the reading %lu from the fetch stream: %s",
+						(unsigned long)hdr.id, GetParseError_En(doc.GetParseError()));
+				continue;
+			}
+			Value row(kObjectType);
+			row.AddMember("reading", doc, doc.GetAllocator());
+			readings.push_back(new JSONReading(hdr.id, m_fetchAsset, row, hdr.userTs, hdr.ts));
+		}
+	} catch (exception& ex) {
+		m_logger->warn("Fetch stream failed: %s", ex.what());
+		for (auto& reading : readings)
+			delete reading;
+		return NULL;
+	} catch (ReadingSetException *ex) {
+		m_logger->warn("Fetch stream failed: %s", ex->what());
+		delete ex;
+		for (auto& reading : readings)
+			delete reading;
+		return NULL;
+	}
+
+	RDSAcknowledge ack;
+	ack.magic = RDS_ACK_MAGIC;
+	ack.block = blkhdr.blockNumber;
+	if (write(m_fetchStream, &ack, sizeof(ack)) != sizeof(ack))
+	{
+		m_logger->warn("Failed to acknowledge fetch stream block: %s", strerror(errno));
+	}
+	if (readings.size())
+	{
+		m_fetchNext = readings.back()->getId() + 1;
+	}
+	return new ReadingSet(&readings);
+}
+
+/**
+ * Read a number of bytes from the fetch stream
+ *
+ * @param buffer	The buffer to read into
+ * @param length	The number of bytes to read
+ * @return bool		True if all the bytes were read
+ */
+bool StorageClient::readFetchStream(void *buffer, size_t length)
+{
+	char *p = (char *)buffer;
+	while (length)
+	{
+		ssize_t n = read(m_fetchStream, p, length);
+		if (n < 0 && errno == EINTR)
+		{
+			continue;
+		}
+		if (n <= 0)
+		{
+			return false;
+		}
+		p += n;
+		length -= n;
+	}
+	return true;
+}
+
+/**
+ * Create a fetch stream with the storage service
+ *
+ * @return bool	True if the stream has been created
+ */
+bool StorageClient::openFetchStream()
+{
+	m_fetchRetry = time(0) + FETCH_STREAM_RETRY;
+	try {
+		auto res = this->getHttpClient()->request("POST", "/storage/reading/fetch/stream");
+		ostringstream resultPayload;
+		resultPayload << res->content.rdbuf();
+		Document doc;
+		doc.Parse(resultPayload.str().c_str());
+		if (res->status_code.compare("200 OK") != 0)
+		{
+			if (!doc.HasParseError() && doc.HasMember("message") && doc["message"].IsString())
+			{
+				m_logger->info("Fetch stream not available, %s", doc["message"].GetString());
+			}
+			else
+			{
+				handleUnexpectedResponse("Create fetch stream", res->status_code, resultPayload.str());
+			}
+			return false;
+		}
+		if (doc.HasParseError() || !doc.HasMember("port") || !doc.HasMember("token"))
+		{
+			m_logger->error("Invalid fetch stream creation response: %s", resultPayload.str().c_str());
+			return false;
+		}
+		if ((m_fetchStream = connectStream(doc["port"].GetInt(), doc["token"].GetUint())) == -1)
+		{
+			return false;
+		}
+		m_fetchNext = 0;
+		m_fetchBlockSize = 0;
+		m_logger->info("Fetch stream succesfully created");
+		return true;
+	} catch (exception& ex) {
+		handleException(ex, "create fetch stream");
+	}
+	return false;
+}
+
+/**
+ * Close the fetch stream
+ */
+void StorageClient::closeFetchStream()
+{
+	if (m_fetchStream != -1)
+	{
+		close(m_fetchStream);
+		m_fetchStream = -1;
+	}
+}
+
 /**
  * Purge the readings by age
  *
@@ -403,11 +1003,28 @@ PurgeResult StorageClient::readingPurgeBySize(unsigned long size, unsigned long
 }
 
 /**
- * Query a table
+ * Query a table on an asynchronous request thread
  *
- * @param tablename	The name of the table to query
- * @param query		The query payload
- * @return ResultSet*	The resultset of the query
+ * @param tableName	The name of the table to query
+ * @param query		The query payload, it must be kept until the future is ready
+ * @return		A future for the resultset, it holds the exception if the query fails
+ */
+future<ResultSet *> StorageClient::queryTableAsync(const string& tableName, const Query& query)
+{
+	ResultSet *(StorageClient::*method)(const string&, const Query&) = &StorageClient::queryTable;
+	auto task = make_shared<packaged_task<ResultSet *()> >(
+			bind(method, this, tableName, cref(query)));
+	future<ResultSet *> result = task->get_future();
+	queueRequest([task]() { (*task)(); });
+	return result;
+}
+
+/**
+ * Query a table
+ *
+ * @param tablename	The name of the table to query
+ * @param query		The query payload
+ * @return ResultSet*	The resultset of the query
  */
 ResultSet *StorageClient::queryTable(const std::string& tableName, const Query& query)
 {
@@ -424,6 +1041,7 @@ ResultSet *StorageClient::queryTable(const std::string& tableName, const Query&
  */
 ResultSet *StorageClient::queryTable(const std::string& schema, const std::string& tableName, const Query& query)
 {
+	TRACE_SPAN("storage-client", "StorageClient::queryTable");
 	try {
 		ostringstream convert;
 
@@ -435,7 +1053,7 @@ ResultSet *StorageClient::queryTable(const std::string& schema, const std::strin
 		resultPayload << res->content.rdbuf();
 		if (res->status_code.compare("200 OK") == 0)
 		{
-			ResultSet *result = new ResultSet(resultPayload.str().c_str());
+			ResultSet *result = new ResultSet(resultPayload.str());
 			return result;
 		}
 		handleUnexpectedResponse("Query table", res->status_code, resultPayload.str());
@@ -469,14 +1087,14 @@ ReadingSet* StorageClient::queryTableToReadings(const std::string& tableName,
 		snprintf(url, sizeof(url), "/storage/table/%s/query", tableName.c_str());
 
 		auto res = this->getHttpClient()->request("PUT", url, convert.str());
-		ostringstream resultPayload;
-		resultPayload << res->content.rdbuf();
-
 		if (res->status_code.compare("200 OK") == 0)
 		{
-			ReadingSet* result = new ReadingSet(resultPayload.str().c_str());
+			// Parse the readings directly from the response content
+			ReadingSet* result = new ReadingSet(res->content);
 			return result;
 		}
+		ostringstream resultPayload;
+		resultPayload << res->content.rdbuf();
 		handleUnexpectedResponse("Query table", res->status_code, resultPayload.str());
 	} catch (exception& ex) {
 		handleException(ex, "query table %s to readings", tableName.c_str());
@@ -511,6 +1129,7 @@ int StorageClient::insertTable(const string& tableName, const InsertValues& valu
  */
 int StorageClient::insertTable(const string& schema, const string& tableName, const InsertValues& values)
 {
+	TRACE_SPAN("storage-client", "StorageClient::insertTable");
 	try {
 		ostringstream convert;
 
@@ -548,6 +1167,80 @@ int StorageClient::insertTable(const string& schema, const string& tableName, co
 	return 0;
 }
 
+/**
+ * Insert several rows into an arbitrary table in a single request
+ *
+ * @param tableName	The name of the table into which data will be added
+ * @param values	The values of each row to insert into the table
+ * @return int		The number of rows inserted
+ */
+int StorageClient::insertTable(const string& tableName, const vector<InsertValues>& values)
+{
+	return insertTable(DEFAULT_SCHEMA, tableName, values);
+}
+
+/**
+ * Insert several rows into an arbitrary table in a single request.
+ * The rows are inserted within a single transaction of the storage
+ * plugin.
+ *
+ * @param schema	The name of the schema to insert into
+ * @param tableName	The name of the table into which data will be added
+ * @param values	The values of each row to insert into the table
+ * @return int		The number of rows inserted
+ */
+int StorageClient::insertTable(const string& schema, const string& tableName, const vector<InsertValues>& values)
+{
+	if (values.empty())
+	{
+		return 0;
+	}
+	TRACE_SPAN("storage-client", "StorageClient::insertTable");
+	try {
+		string payload = "{ \"inserts\" : [ ";
+		for (auto it = values.cbegin(); it != values.cend(); ++it)
+		{
+			if (it != values.cbegin())
+			{
+				payload += ", ";
+			}
+			payload += it->toJSON();
+		}
+		payload += " ] }";
+
+		char url[128];
+		snprintf(url, sizeof(url), "/storage/schema/%s/table/%s", schema.c_str(), tableName.c_str());
+		auto res = this->getHttpClient()->request("POST", url, payload);
+		ostringstream resultPayload;
+		resultPayload << res->content.rdbuf();
+		if (res->status_code.compare("200 OK") == 0 || res->status_code.compare("201 Created") == 0)
+		{
+			Document doc;
+			doc.Parse(resultPayload.str().c_str());
+			if (doc.HasParseError())
+			{
+				m_logger->info("POST result %s.", res->status_code.c_str());
+				m_logger->error("Failed to parse result of insertTable. %s. Document is %s",
+						GetParseError_En(doc.GetParseError()),
+						resultPayload.str().c_str());
+				return -1;
+			}
+			else if (doc.HasMember("message"))
+			{
+				m_logger->error("Failed to append table data: %s",
+					doc["message"].GetString());
+				return -1;
+			}
+			return doc["rows_affected"].GetInt();
+		}
+		handleUnexpectedResponse("Insert table", res->status_code, resultPayload.str());
+	} catch (exception& ex) {
+		handleException(ex, "insert into table %s", tableName.c_str());
+		throw;
+	}
+	return 0;
+}
+
 /**
  * Update data into an arbitrary table
  *
@@ -572,6 +1265,7 @@ int StorageClient::updateTable(const string& tableName, const InsertValues& valu
  */
 int StorageClient::updateTable(const string& schema, const string& tableName, const InsertValues& values, const Where& where)
 {
+	TRACE_SPAN("storage-client", "StorageClient::updateTable");
 	static HttpClient *httpClient = this->getHttpClient(); // to initialize m_seqnum_map[thread_id] for this thread
 	try {
 		std::thread::id thread_id = std::this_thread::get_id();
@@ -651,6 +1345,7 @@ int StorageClient::updateTable(const string& tableName, const ExpressionValues&
  */
 int StorageClient::updateTable(const string& schema, const string& tableName, const ExpressionValues& values, const Where& where)
 {
+	TRACE_SPAN("storage-client", "StorageClient::updateTable");
 	static HttpClient *httpClient = this->getHttpClient(); // to initialize m_seqnum_map[thread_id] for this thread
 	try {
 		std::thread::id thread_id = std::this_thread::get_id();
@@ -706,6 +1401,36 @@ int StorageClient::updateTable(const string& schema, const string& tableName, co
 	return -1;
 }
 
+/**
+ * Update data into an arbitrary table on an asynchronous request thread
+ *
+ * The request takes ownership of the updates, the vector is emptied
+ * and the expressions and conditions are deleted once the update has
+ * been made.
+ *
+ * @param tableName	The name of the table into which data will be added
+ * @param updates	The expressions and condition pairs to update in the table
+ * @return		A future for the number of rows updated, it holds the exception if the update fails
+ */
+future<int> StorageClient::updateTableAsync(const string& tableName, vector<pair<ExpressionValues *, Where *>>& updates)
+{
+	auto owned = make_shared<vector<pair<ExpressionValues *, Where *>> >();
+	owned->swap(updates);
+	auto task = make_shared<packaged_task<int ()> >([this, tableName, owned]() {
+		return updateTable(tableName, *owned);
+	});
+	future<int> result = task->get_future();
+	queueRequest([task, owned]() {
+		(*task)();
+		for (auto& it : *owned)
+		{
+			delete it.first;
+			delete it.second;
+		}
+	});
+	return result;
+}
+
 /**
  * Update data into an arbitrary table
  *
@@ -728,6 +1453,7 @@ int StorageClient::updateTable(const string& tableName, vector<pair<ExpressionVa
  */
 int StorageClient::updateTable(const string& schema, const string& tableName, vector<pair<ExpressionValues *, Where *>>& updates)
 {
+	TRACE_SPAN("storage-client", "StorageClient::updateTable");
 	static HttpClient *httpClient = this->getHttpClient(); // to initialize m_seqnum_map[thread_id] for this thread
 	try {
 		std::thread::id thread_id = std::this_thread::get_id();
@@ -791,6 +1517,94 @@ int StorageClient::updateTable(const string& schema, const string& tableName, ve
 }
 
 
+/**
+ * Update several rows of an arbitrary table in a single request
+ *
+ * @param tableName	The name of the table to update
+ * @param updates	The values and condition pairs to update in the table
+ * @return int		The number of rows updated
+ */
+int StorageClient::updateTable(const string& tableName, vector<pair<InsertValues *, Where *>>& updates)
+{
+	return updateTable(DEFAULT_SCHEMA, tableName, updates);
+}
+
+/**
+ * Update several rows of an arbitrary table in a single request.
+ * The updates are made within a single transaction of the storage
+ * plugin.
+ *
+ * @param schema	The name of the schema of the table
+ * @param tableName	The name of the table to update
+ * @param updates	The values and condition pairs to update in the table
+ * @return int		The number of rows updated
+ */
+int StorageClient::updateTable(const string& schema, const string& tableName, vector<pair<InsertValues *, Where *>>& updates)
+{
+	if (updates.empty())
+	{
+		return 0;
+	}
+	TRACE_SPAN("storage-client", "StorageClient::updateTable");
+	static HttpClient *httpClient = this->getHttpClient(); // to initialize m_seqnum_map[thread_id] for this thread
+	try {
+		std::thread::id thread_id = std::this_thread::get_id();
+		ostringstream ss;
+		sto_mtx_client_map.lock();
+		m_seqnum_map[thread_id].fetch_add(1);
+		ss << m_pid << "#" << thread_id << "_" << m_seqnum_map[thread_id].load();
+		sto_mtx_client_map.unlock();
+
+		SimpleWeb::CaseInsensitiveMultimap headers = {{"SeqNum", ss.str()}};
+
+		string payload = "{ \"updates\" : [ ";
+		for (auto it = updates.cbegin(); it != updates.cend(); ++it)
+		{
+			if (it != updates.cbegin())
+			{
+				payload += ", ";
+			}
+			payload += "{ \"where\" : ";
+			payload += it->second->toJSON();
+			payload += ", \"values\" : ";
+			payload += it->first->toJSON();
+			payload += " }";
+		}
+		payload += " ] }";
+
+		char url[128];
+		snprintf(url, sizeof(url), "/storage/schema/%s/table/%s", schema.c_str(), tableName.c_str());
+		auto res = this->getHttpClient()->request("PUT", url, payload, headers);
+		ostringstream resultPayload;
+		resultPayload << res->content.rdbuf();
+		if (res->status_code.compare("200 OK") == 0)
+		{
+			Document doc;
+			doc.Parse(resultPayload.str().c_str());
+			if (doc.HasParseError())
+			{
+				m_logger->info("PUT result %s.", res->status_code.c_str());
+				m_logger->error("Failed to parse result of updateTable. %s",
+						GetParseError_En(doc.GetParseError()));
+				return -1;
+			}
+			else if (doc.HasMember("message"))
+			{
+				m_logger->error("Failed to update table data: %s",
+					doc["message"].GetString());
+				return -1;
+			}
+			return doc["rows_affected"].GetInt();
+		}
+		handleUnexpectedResponse("Update table", tableName, res->status_code, resultPayload.str());
+	} catch (exception& ex) {
+		handleException(ex, "update table %s", tableName.c_str());
+		throw;
+	}
+	return -1;
+}
+
+
 /**
  * Update data into an arbitrary table
  *
@@ -1227,38 +2041,32 @@ bool StorageClient::openStream()
 			}
 		       	port = doc["port"].GetInt();
 			token = doc["token"].GetInt();
-			if ((m_stream = socket(AF_INET, SOCK_STREAM, 0)) == -1)
-        		{
-				m_logger->error("Unable to create socket");
-				return false;
-			}
-			struct sockaddr_in serv_addr;
-			hostent *server;
-			if ((server = gethostbyname(m_host.c_str())) == NULL)
+			// Older storage services do not report a protocol version and only accept JSON payloads
+			m_streamProtocol = 1;
+			if (doc.HasMember("protocol") && doc["protocol"].IsInt())
 			{
-				m_logger->error("Unable to resolve hostname for reading stream: %s", m_host.c_str());
-				return false;
+				m_streamProtocol = doc["protocol"].GetInt();
 			}
-			bzero((char *) &serv_addr, sizeof(serv_addr));
-			serv_addr.sin_family = AF_INET;
-			bcopy((char *)server->h_addr, (char *)&serv_addr.sin_addr.s_addr, server->h_length);
-			serv_addr.sin_port = htons(port);
-			if (connect(m_stream, (struct sockaddr *) &serv_addr, sizeof(serv_addr)) < 0)
+			bool compress = compressStream();
+			if ((m_stream = connectStream(port, token, compress)) == -1)
 			{
-				Logger::getLogger()->warn("Unable to connect to storage streaming server: %s, %d", m_host.c_str(), port);
 				return false;
 			}
-			RDSConnectHeader conhdr;
-			conhdr.magic = RDS_CONNECTION_MAGIC;
-			conhdr.token = token;
-			if (write(m_stream, &conhdr, sizeof(conhdr)) != sizeof(conhdr))
+			if (!m_streamSenderThread.joinable())
 			{
-				Logger::getLogger()->warn("Failed to write connection header: %s", strerror(errno));
-				return false;
+				m_streamSenderRunning = true;
+				m_streamSenderThread = thread(&StorageClient::streamSender, this);
 			}
 			m_streaming = true;
-			m_logger->info("Storage stream succesfully created");
-			return true;
+			m_streamAcks = m_streamProtocol >= RDS_ACK_PROTOCOL_VERSION;
+			m_streamCompress = compress;
+			m_streamDictionary.clear();
+			m_dictionaryNames.clear();
+			m_readingBlock = 0;
+			m_ackBytes = 0;
+			m_logger->info("Storage stream succesfully created, protocol version %d%s", m_streamProtocol,
+					compress ? ", compressed" : "");
+			return replayStreamBlocks();
 		}
 		ostringstream resultPayload;
 		resultPayload << res->content.rdbuf();
@@ -1271,170 +2079,1086 @@ bool StorageClient::openStream()
 	return false;
 }
 
+/**
+ * Return if the blocks of the reading stream should be compressed. The
+ * storage service must support compressed blocks and, unless compression
+ * has been requested, be on another host.
+ *
+ * @return bool		True if blocks should be compressed
+ */
+bool StorageClient::compressStream()
+{
+	if (m_streamProtocol < RDS_ZLIB_PROTOCOL_VERSION || m_streamCompression == CompressNone)
+	{
+		return false;
+	}
+	if (m_streamCompression == CompressZlib)
+	{
+		return true;
+	}
+	if (m_host.empty() || m_host.compare("localhost") == 0)
+	{
+		return false;
+	}
+	hostent *server = gethostbyname(m_host.c_str());
+	if (server == NULL || server->h_addrtype != AF_INET)
+	{
+		return false;
+	}
+	// Any address in 127.0.0.0/8 is the loopback interface
+	return ((unsigned char *)server->h_addr)[0] != 127;
+}
+
+/**
+ * Connect to a stream created by the storage service and send the
+ * token that verifies the connection
+ *
+ * @param port		The port of the stream
+ * @param token		The token returned when the stream was created
+ * @param compress	Request compressed blocks on the stream
+ * @return int		The socket of the stream or -1 on failure
+ */
+int StorageClient::connectStream(int port, uint32_t token, bool compress)
+{
+	int sock;
+	if ((sock = socket(AF_INET, SOCK_STREAM, 0)) == -1)
+	{
+		m_logger->error("Unable to create socket");
+		return -1;
+	}
+	struct sockaddr_in serv_addr;
+	hostent *server;
+	if ((server = gethostbyname(m_host.c_str())) == NULL)
+	{
+		m_logger->error("Unable to resolve hostname for reading stream: %s", m_host.c_str());
+		close(sock);
+		return -1;
+	}
+	bzero((char *) &serv_addr, sizeof(serv_addr));
+	serv_addr.sin_family = AF_INET;
+	bcopy((char *)server->h_addr, (char *)&serv_addr.sin_addr.s_addr, server->h_length);
+	serv_addr.sin_port = htons(port);
+	if (connect(sock, (struct sockaddr *) &serv_addr, sizeof(serv_addr)) < 0)
+	{
+		Logger::getLogger()->warn("Unable to connect to storage streaming server: %s, %d", m_host.c_str(), port);
+		close(sock);
+		return -1;
+	}
+	RDSConnectHeader conhdr;
+	if (compress)
+		conhdr.magic = RDS_ZLIB_CONNECTION_MAGIC;
+	else
+		conhdr.magic = m_streamProtocol >= RDS_ACK_PROTOCOL_VERSION ? RDS_ACK_CONNECTION_MAGIC : RDS_CONNECTION_MAGIC;
+	conhdr.token = token;
+	if (write(sock, &conhdr, sizeof(conhdr)) != sizeof(conhdr))
+	{
+		Logger::getLogger()->warn("Failed to write connection header: %s", strerror(errno));
+		close(sock);
+		return -1;
+	}
+	return sock;
+}
+
 /**
  * Stream a set of readings to the storage service.
  *
- * TODO Deal with acknowledgements, add error checking/recovery
+ * If the storage service acknowledges blocks at most STREAM_WINDOW
+ * blocks are sent ahead of the acknowledgements. A copy of the readings
+ * of each block is kept until the block is acknowledged, so that the
+ * block can be sent again if it is rejected or the stream is lost. Once
+ * the copy is taken the readings are the responsibility of the client.
  *
  * @param readings	The readings to stream
  * @return bool		True if the readings have been sent
  */
 bool StorageClient::streamReadings(const std::vector<Reading *> & readings)
 {
-RDSBlockHeader   		blkhdr;
-RDSReadingHeader 		rdhdrs[STREAM_BLK_SIZE];
-register RDSReadingHeader	*phdr;
-struct { const void *iov_base; size_t iov_len;} iovs[STREAM_BLK_SIZE * 4], *iovp;
-string				payloads[STREAM_BLK_SIZE];
-struct timeval			tm[STREAM_BLK_SIZE];
-ssize_t				n, length = 0;
-string				lastAsset;
-
-
 	if (!m_streaming)
 	{
 		return false;
 	}
+	if (!m_streamAcks)
+	{
+		return writeStreamBlock(readings, m_readingBlock++);
+	}
 
-	/*
-	 * Assemble and write the block header. This header contains information
-	 * to synchronise the blocks of data and also the number of readings
-	 * to expect within the block.
-	 */
-	blkhdr.magic = RDS_BLOCK_MAGIC;
-	blkhdr.blockNumber = m_readingBlock++;
-	blkhdr.count = readings.size();
-	if ((n = write(m_stream, &blkhdr, sizeof(blkhdr))) != sizeof(blkhdr))
+	// Collect the acknowledgements that have arrived and wait for
+	// one if the window is full
+	if (!readStreamAcks(false))
 	{
-		if (errno == EPIPE || errno == ECONNRESET)
-		{
-			Logger::getLogger()->warn("Storage service has closed stream unexpectedly");
-			m_streaming = false;
-		}
-		else
+		return false;
+	}
+	while (m_unacked.size() >= STREAM_WINDOW)
+	{
+		if (!readStreamAcks(true))
 		{
-			Logger::getLogger()->error("Failed to write block header: %s", strerror(errno));
+			return false;
 		}
-		return false;
 	}
 
-	/*
-	 * Use the writev scatter/gather interface to send the reading headers and reading data.
-	 * We sent chunks of data in order to allow the parallel sendign and unpacking process
-	 * at the two ends. The chunk size is STREAM_BLK_SIZE readings.
-	 */
-	iovp = iovs;
-	phdr = rdhdrs;
-	int offset = 0;
-	for (int i = 0; i < readings.size(); i++)
+	StreamBlock block;
+	block.number = m_readingBlock++;
+	block.retries = 0;
+	block.readings.reserve(readings.size());
+	for (auto reading : readings)
+	{
+		block.readings.push_back(new Reading(*reading));
+	}
+	m_unacked.push_back(block);
+	if (!writeStreamBlock(readings, block.number))
+	{
+		// The block is sent again when the stream is next opened
+		closeStream();
+	}
+	return true;
+}
+
+/**
+ * Read the acknowledgements of the blocks sent on the stream. Blocks
+ * that have been acknowledged are released and blocks that have been
+ * rejected are sent again.
+ *
+ * @param wait		Wait up to STREAM_ACK_WAIT for an acknowledgement
+ * @return bool		False if the stream has been lost
+ */
+bool StorageClient::readStreamAcks(bool wait)
+{
+	bool acknowledged = false;
+	while (m_streaming)
 	{
-		phdr->magic = RDS_READING_MAGIC;
-		phdr->readingNo = i;
-		string assetCode = readings[i]->getAssetName();
-		if (i > 0 && assetCode.compare(lastAsset) == 0)
+		struct pollfd fds = { m_stream, POLLIN, 0 };
+		int rc = poll(&fds, 1, (wait && !acknowledged) ? STREAM_ACK_WAIT : 0);
+		if (rc < 0 && errno == EINTR)
 		{
-			// Asset name is unchanged so don't send it
-			phdr->assetLength = 0;
+			continue;
 		}
-		else
+		if (rc == 0)
 		{
-			// Asset name has changed or this is the first asset in the block
-			lastAsset = assetCode;
-			phdr->assetLength = assetCode.length() + 1;
+			if (wait && !acknowledged)
+			{
+				m_logger->error("The storage service has not acknowledged block %u of the stream",
+						m_unacked.empty() ? 0 : m_unacked.front().number);
+				closeStream();
+				return false;
+			}
+			return true;
 		}
-
-		// Alwayts generate the JSON variant of the data points and send
-		payloads[offset] = readings[i]->getDatapointsJSON();
-		phdr->payloadLength = payloads[offset].length() + 1;
-
-		// Add the reading header
-		iovp->iov_base = phdr;
-		iovp->iov_len = sizeof(RDSReadingHeader);
-		length += iovp->iov_len;
-		iovp++;
-
-		// Reading user timestamp
-		readings[i]->getUserTimestamp(&tm[offset]);
-		iovp->iov_base = &tm[offset];
-		iovp->iov_len = sizeof(struct timeval);
-		length += iovp->iov_len;
-		iovp++;
-
-		// If the asset code has changed than add that
-		if (phdr->assetLength)
+		ssize_t n = rc < 0 ? -1 : read(m_stream, (char *)&m_ack + m_ackBytes, sizeof(m_ack) - m_ackBytes);
+		if (n <= 0)
 		{
-			iovp->iov_base = readings[i]->getAssetName().c_str();
-			iovp->iov_len = phdr->assetLength;
-			length += iovp->iov_len;
-			iovp++;
+			m_logger->warn("Storage service has closed stream unexpectedly");
+			closeStream();
+			return false;
 		}
+		m_ackBytes += n;
+		if (m_ackBytes < sizeof(m_ack))
+		{
+			continue;
+		}
+		m_ackBytes = 0;
+		acknowledged = true;
 
-		// Add the data points themselves
-		iovp->iov_base = payloads[offset].c_str();
-		iovp->iov_len = phdr->payloadLength;
-		length += iovp->iov_len;
-		iovp++;
-
-		offset++;
-		if (offset == STREAM_BLK_SIZE - 1)
+		if (m_ack.magic == RDS_ACK_MAGIC)
 		{
-			n = writev(m_stream, (const iovec *)iovs, iovp - iovs);
-			if (n < length)
+			for (auto it = m_unacked.begin(); it != m_unacked.end(); ++it)
 			{
-				if (errno == EPIPE || errno == ECONNRESET)
-				{
-					Logger::getLogger()->error("Stream has been closed by the storage service");
-					m_streaming = false;
-				}
-				else
+				if (it->number == m_ack.block)
 				{
-					Logger::getLogger()->error("Write of block short, %d < %d: %s",
-							n, length, strerror(errno));
+					for (auto reading : it->readings)
+						delete reading;
+					m_unacked.erase(it);
+					break;
 				}
+			}
+		}
+		else if (m_ack.magic == RDS_NACK_MAGIC)
+		{
+			auto it = m_unacked.begin();
+			while (it != m_unacked.end() && it->number != m_ack.block)
+				++it;
+			if (it == m_unacked.end())
+			{
+				continue;
+			}
+			StreamBlock block = *it;
+			m_unacked.erase(it);
+			if (++block.retries > STREAM_BLOCK_RETRIES)
+			{
+				m_logger->error("The storage service has rejected a block of %d readings %d times, the readings are discarded",
+						(int)block.readings.size(), block.retries);
+				for (auto reading : block.readings)
+					delete reading;
+				continue;
+			}
+			m_logger->warn("The storage service has rejected block %u of the stream, sending it again",
+					block.number);
+			block.number = m_readingBlock++;
+			m_unacked.push_back(block);
+			if (!writeStreamBlock(block.readings, block.number))
+			{
+				closeStream();
 				return false;
 			}
-			else if (n > length)
-				Logger::getLogger()->fatal("Long write %d < %d", length, n);
-			offset = 0;
-			length = 0;
-			iovp = iovs;
-			phdr = rdhdrs;
 		}
 		else
 		{
-			phdr++;
+			m_logger->error("Unexpected acknowledgement 0x%x on the reading stream", m_ack.magic);
+			closeStream();
+			return false;
 		}
 	}
-	if (length)	// Remaining data to be sent to finish the block
+	return false;
+}
+
+/**
+ * Close the reading stream, the blocks that have not been
+ * acknowledged are kept to be sent when it is opened again
+ */
+void StorageClient::closeStream()
+{
+	if (m_stream != -1)
 	{
-		if ((n = writev(m_stream, (const iovec *)iovs, iovp - iovs)) < length)
+		// Abandon a block the storage service is not reading and
+		// wait for the sender to finish with the socket
+		shutdown(m_stream, SHUT_RDWR);
 		{
-			if (errno == EPIPE || errno == ECONNRESET)
-			{
-				Logger::getLogger()->error("Stream has been closed by the storage service");
-				m_streaming = false;
-			}
-			else
+			unique_lock<mutex> lck(m_streamMutex);
+			while (m_streamSending)
 			{
-				Logger::getLogger()->error("Write of block short, %d < %d: %s",
-						n, length, strerror(errno));
+				m_streamCV.wait(lck);
 			}
-			return false;
+			m_streamError = 0;
 		}
-		else if (n > length)
-			Logger::getLogger()->fatal("Long write %d < %d", length, n);
+		close(m_stream);
+		m_stream = -1;
 	}
-	return true;
+	m_streaming = false;
 }
 
 /**
- * Handle exceptions encountered when communicating to the storage system
+ * Send the blocks that were not acknowledged on a previous stream on
+ * the stream that has just been opened
  *
- * @param ex	The exception we are handling
+ * @return bool		False if the stream has been lost
  */
-void StorageClient::handleException(const exception& ex, const char *operation, ...)
+bool StorageClient::replayStreamBlocks()
 {
-	char buf[EXCEPTION_BUFFER_SIZE];
+	if (!m_streamAcks)
+	{
+		return appendUnacknowledged();
+	}
+	if (!m_unacked.empty())
+	{
+		m_logger->info("Sending %d unacknowledged blocks of readings again", (int)m_unacked.size());
+	}
+	for (auto& block : m_unacked)
+	{
+		block.number = m_readingBlock++;
+		if (!writeStreamBlock(block.readings, block.number))
+		{
+			closeStream();
+			return false;
+		}
+	}
+	return true;
+}
+
+/**
+ * Append the readings of the blocks that were not acknowledged on the
+ * stream with a transport that does not acknowledge blocks
+ *
+ * @return bool		False if the readings could not be appended
+ */
+bool StorageClient::appendUnacknowledged()
+{
+	while (!m_unacked.empty())
+	{
+		StreamBlock block = m_unacked.front();
+		m_unacked.pop_front();
+		if (!readingAppend(block.readings))
+		{
+			m_unacked.push_front(block);
+			return false;
+		}
+		for (auto reading : block.readings)
+			delete reading;
+	}
+	return true;
+}
+
+/**
+ * Assemble a block of readings and hand it to the sender thread to be
+ * written to the stream. The block is written whilst the caller goes on
+ * to assemble the next block.
+ *
+ * @param readings	The readings to write
+ * @param blockNumber	The number of the block
+ * @return bool		True if the block has been handed to the sender
+ */
+bool StorageClient::writeStreamBlock(const std::vector<Reading *> & readings, uint32_t blockNumber)
+{
+RDSBlockHeader   		blkhdr;
+RDSReadingHeader 		rdhdr;
+struct timeval			tm;
+InternedString			lastAsset;
+
+
+	if (!m_streaming)
+	{
+		return false;
+	}
+
+	/*
+	 * The block header contains information to synchronise the blocks
+	 * of data and also the number of readings to expect within the block.
+	 * A compressed block is assembled and then written as one frame.
+	 */
+	string& block = m_streamCompress ? m_streamPlain : m_streamFill;
+	blkhdr.magic = RDS_BLOCK_MAGIC;
+	blkhdr.blockNumber = blockNumber;
+	blkhdr.count = readings.size();
+	block.assign((const char *)&blkhdr, sizeof(blkhdr));
+
+	/*
+	 * Each reading is a reading header, the user timestamp, the asset
+	 * code if it differs from the previous reading and the data points
+	 */
+	bool binary = m_streamProtocol >= RDS_BINARY_PROTOCOL_VERSION;
+	for (uint32_t i = 0; i < readings.size(); i++)
+	{
+		rdhdr.magic = binary ? RDS_BINARY_READING_MAGIC : RDS_READING_MAGIC;
+		rdhdr.readingNo = i;
+		const InternedString& assetCode = readings[i]->getInternedAssetName();
+		if (i > 0 && assetCode == lastAsset)
+		{
+			// Asset name is unchanged so don't send it
+			rdhdr.assetLength = 0;
+		}
+		else
+		{
+			// Asset name has changed or this is the first asset in the block
+			lastAsset = assetCode;
+			rdhdr.assetLength = assetCode.length() + 1;
+		}
+
+		if (binary)
+		{
+			// Send the type tagged binary encoding of the data points
+			ReadingStreamPayload::encode(*readings[i], m_streamPayload);
+		}
+		else
+		{
+			// Generate the JSON variant of the data points, with its terminator
+			m_streamPayload.clear();
+			readings[i]->appendDatapointsJSON(m_streamPayload);
+			m_streamPayload.push_back('\0');
+		}
+		rdhdr.payloadLength = m_streamPayload.length();
+
+		readings[i]->getUserTimestamp(&tm);
+		block.append((const char *)&rdhdr, sizeof(rdhdr));
+		block.append((const char *)&tm, sizeof(tm));
+		if (rdhdr.assetLength)
+		{
+			block.append(readings[i]->getAssetName().c_str(), rdhdr.assetLength);
+		}
+		block.append(m_streamPayload);
+	}
+	if (m_streamCompress && !writeCompressedBlock(readings))
+	{
+		return false;
+	}
+	return sendStreamBlock();
+}
+
+/**
+ * Hand the block that has been assembled to the sender thread, once the
+ * previous block has been written. If the storage service does not
+ * acknowledge blocks the block is not kept to be sent again, so the
+ * write of the block is waited for.
+ *
+ * @return bool		False if the previous block, or a block that is
+ *			not acknowledged, could not be written
+ */
+bool StorageClient::sendStreamBlock()
+{
+	if (!waitStreamSent())
+	{
+		return false;
+	}
+	{
+		lock_guard<mutex> guard(m_streamMutex);
+		m_streamSend.swap(m_streamFill);
+		m_streamSending = true;
+	}
+	m_streamCV.notify_all();
+	if (!m_streamAcks)
+	{
+		return waitStreamSent();
+	}
+	return true;
+}
+
+/**
+ * Wait for the sender thread to finish writing a block
+ *
+ * @return bool		False if the write of the block failed
+ */
+bool StorageClient::waitStreamSent()
+{
+	int error;
+	{
+		unique_lock<mutex> lck(m_streamMutex);
+		while (m_streamSending)
+		{
+			m_streamCV.wait(lck);
+		}
+		error = m_streamError;
+		m_streamError = 0;
+	}
+	if (error == 0)
+	{
+		return true;
+	}
+	if (error == EPIPE || error == ECONNRESET)
+	{
+		m_logger->warn("Stream has been closed by the storage service");
+		m_streaming = false;
+	}
+	else
+	{
+		m_logger->error("Failed to write a block of readings to the stream: %s", strerror(error));
+	}
+	return false;
+}
+
+/**
+ * The sender thread of the reading stream, writes each block handed to
+ * it by sendStreamBlock. The socket blocks the sender rather than the
+ * thread appending the readings when the storage service is slow to
+ * read the stream.
+ */
+void StorageClient::streamSender()
+{
+	pthread_setname_np(pthread_self(), "stream-sender");
+	unique_lock<mutex> lck(m_streamMutex);
+	while (m_streamSenderRunning)
+	{
+		if (!m_streamSending)
+		{
+			m_streamCV.wait(lck);
+			continue;
+		}
+		int fd = m_stream;
+		const char *p = m_streamSend.data();
+		size_t remaining = m_streamSend.length();
+		lck.unlock();
+		int error = 0;
+		while (remaining > 0)
+		{
+			ssize_t n = write(fd, p, remaining);
+			if (n < 0)
+			{
+				if (errno == EINTR)
+					continue;
+				error = errno;
+				break;
+			}
+			p += n;
+			remaining -= n;
+		}
+		lck.lock();
+		m_streamError = error;
+		m_streamSending = false;
+		m_streamCV.notify_all();
+	}
+}
+
+/**
+ * Compress the block that has been assembled and add it to the block to
+ * write to the reading stream as a single frame, preceded by a new
+ * dictionary if one is needed
+ *
+ * @param readings	The readings of the block, used to build the dictionary
+ * @return bool		True if the block has been compressed
+ */
+bool StorageClient::writeCompressedBlock(const std::vector<Reading *> & readings)
+{
+	RDSCompressedHeader	hdr;
+
+	m_streamFill.clear();
+	bool newDictionary = trainStreamDictionary(readings);
+	if (newDictionary)
+	{
+		hdr.magic = RDS_ZLIB_DICT_MAGIC;
+		hdr.length = m_streamDictionary.length();
+		hdr.rawLength = adler32(adler32(0L, Z_NULL, 0),
+				(const Bytef *)m_streamDictionary.data(), m_streamDictionary.length());
+		m_streamFill.append((const char *)&hdr, sizeof(hdr));
+		m_streamFill.append(m_streamDictionary);
+	}
+
+	z_stream strm;
+	memset(&strm, 0, sizeof(strm));
+	if (deflateInit(&strm, STREAM_ZLIB_LEVEL) != Z_OK)
+	{
+		Logger::getLogger()->error("Unable to initialise the compression of a stream block");
+		if (newDictionary)
+			m_streamDictionary.clear();
+		return false;
+	}
+	if (!m_streamDictionary.empty())
+	{
+		deflateSetDictionary(&strm, (const Bytef *)m_streamDictionary.data(), m_streamDictionary.length());
+	}
+	// The compressed block follows its header in the block to write
+	size_t offset = m_streamFill.length() + sizeof(hdr);
+	m_streamFill.resize(offset + deflateBound(&strm, m_streamPlain.length()));
+	strm.next_in = (Bytef *)&m_streamPlain[0];
+	strm.avail_in = m_streamPlain.length();
+	strm.next_out = (Bytef *)&m_streamFill[offset];
+	strm.avail_out = m_streamFill.length() - offset;
+	int rval = deflate(&strm, Z_FINISH);
+	size_t length = strm.total_out;
+	deflateEnd(&strm);
+	if (rval != Z_STREAM_END)
+	{
+		Logger::getLogger()->error("Unable to compress a stream block: %s", zError(rval));
+		if (newDictionary)
+			m_streamDictionary.clear();
+		return false;
+	}
+	m_streamFill.resize(offset + length);
+
+	hdr.magic = RDS_ZLIB_BLOCK_MAGIC;
+	hdr.length = length;
+	hdr.rawLength = m_streamPlain.length();
+	memcpy(&m_streamFill[offset - sizeof(hdr)], &hdr, sizeof(hdr));
+	m_logger->debug("Stream block of %d bytes compressed to %d bytes", m_streamPlain.length(), length);
+	return true;
+}
+
+/**
+ * Build the preset dictionary used to compress the blocks of the reading
+ * stream from the asset and datapoint names of a block. The dictionary
+ * is built for the first block of a stream and is rebuilt when a block
+ * brings new names, at most once every STREAM_DICT_BLOCKS blocks. The
+ * names that occur most often are placed at the end of the dictionary,
+ * where zlib finds them with the shortest distances.
+ *
+ * @param readings	The readings of the block
+ * @return bool		True if a new dictionary should be sent
+ */
+bool StorageClient::trainStreamDictionary(const std::vector<Reading *> & readings)
+{
+	m_dictionaryAge++;
+	if (!m_streamDictionary.empty() && m_dictionaryAge < STREAM_DICT_BLOCKS)
+	{
+		return false;
+	}
+	map<string, unsigned int> names;
+	for (auto reading : readings)
+	{
+		names[reading->getAssetName()]++;
+		for (auto dp : reading->getReadingData())
+		{
+			names[dp->getName()]++;
+		}
+	}
+	bool changed = m_streamDictionary.empty();
+	for (auto& name : names)
+	{
+		if (m_dictionaryNames.find(name.first) == m_dictionaryNames.end())
+		{
+			changed = true;
+			break;
+		}
+	}
+	if (!changed)
+	{
+		m_dictionaryAge = 0;
+		return false;
+	}
+
+	vector<pair<unsigned int, const string *>> ordered;
+	for (auto& name : names)
+	{
+		ordered.push_back(make_pair(name.second, &name.first));
+	}
+	sort(ordered.begin(), ordered.end(),
+		[](const pair<unsigned int, const string *>& a, const pair<unsigned int, const string *>& b)
+			{ return a.first > b.first; });
+	// Keep the most common names that fit in the window, least common first
+	size_t length = 0;
+	size_t fit = 0;
+	while (fit < ordered.size() && length + ordered[fit].second->length() + 2 <= RDS_ZLIB_MAX_DICT)
+	{
+		length += ordered[fit].second->length() + 2;
+		fit++;
+	}
+	if (fit == 0)
+	{
+		return false;
+	}
+	m_streamDictionary.clear();
+	m_dictionaryNames.clear();
+	for (size_t i = fit; i > 0; i--)
+	{
+		const string& name = *ordered[i - 1].second;
+		m_streamDictionary.append("\"");
+		m_streamDictionary.append(name);
+		m_streamDictionary.append("\"");
+		m_dictionaryNames.insert(name);
+	}
+	m_dictionaryAge = 0;
+	return true;
+}
+
+
+/**
+ * Return if the shared memory stream to the storage service is open,
+ * opening it if it has not been tried or the retry interval has passed
+ * since it failed
+ *
+ * @return bool		True if the shared memory stream is open
+ */
+bool StorageClient::sharedStreamAvailable()
+{
+	lock_guard<mutex> guard(m_sharedMutex);
+	if (m_shared)
+	{
+		return true;
+	}
+	if (time(0) < m_sharedRetry)
+	{
+		return false;
+	}
+	if (openSharedStream())
+	{
+		return true;
+	}
+	if (m_sharedRetry != numeric_limits<time_t>::max())
+	{
+		m_sharedRetry = time(0) + SHARED_STREAM_RETRY;
+	}
+	return false;
+}
+
+/**
+ * Ask the storage service for a shared memory stream and connect to it.
+ * If the storage service does not offer the shared memory transport, or
+ * is not on this host, it is not asked again.
+ *
+ * @return bool		True if the stream is open
+ */
+bool StorageClient::openSharedStream()
+{
+	try {
+		auto res = this->getHttpClient()->request("POST", "/storage/reading/stream",
+						"{ \"transport\" : \"shared\" }");
+		ostringstream resultPayload;
+		resultPayload << res->content.rdbuf();
+		if (res->status_code.compare("200 OK") != 0)
+		{
+			handleUnexpectedResponse("Create shared memory stream", res->status_code, resultPayload.str());
+			return false;
+		}
+		Document doc;
+		doc.Parse(resultPayload.str().c_str());
+		if (doc.HasParseError() || !doc.IsObject())
+		{
+			m_logger->error("Failed to parse result of creating shared memory stream: %s",
+					resultPayload.str().c_str());
+			return false;
+		}
+		if (!doc.HasMember("path") || !doc["path"].IsString()
+				|| !doc.HasMember("token") || !doc["token"].IsUint())
+		{
+			m_logger->info("The storage service does not support the shared memory stream");
+			m_sharedRetry = numeric_limits<time_t>::max();
+			return false;
+		}
+		if (!connectSharedStream(doc["path"].GetString(), doc["token"].GetUint()))
+		{
+			m_sharedRetry = numeric_limits<time_t>::max();
+			return false;
+		}
+		m_logger->info("Shared memory stream to the storage service created");
+		return true;
+	} catch (exception& ex) {
+		handleException(ex, "create shared memory stream");
+	}
+	return false;
+}
+
+/**
+ * Connect to the abstract socket of a shared memory stream, send the
+ * token and receive the descriptors of the ring, doorbell and
+ * acknowledgement
+ *
+ * @param name		The name of the abstract socket
+ * @param token		The token returned when the stream was created
+ * @return bool		True if the stream was connected
+ */
+bool StorageClient::connectSharedStream(const string& name, uint32_t token)
+{
+	struct sockaddr_un address;
+	if (name.length() >= sizeof(address.sun_path) - 1)
+	{
+		return false;
+	}
+	if ((m_sharedSocket = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0)) == -1)
+	{
+		m_logger->error("Unable to create socket for shared memory stream");
+		return false;
+	}
+	memset(&address, 0, sizeof(address));
+	address.sun_family = AF_UNIX;
+	memcpy(&address.sun_path[1], name.c_str(), name.length());
+	socklen_t len = offsetof(struct sockaddr_un, sun_path) + 1 + name.length();
+	if (connect(m_sharedSocket, (struct sockaddr *)&address, len) < 0)
+	{
+		m_logger->info("The storage service is not on this host, not using the shared memory stream");
+		closeSharedStream();
+		return false;
+	}
+	RDSConnectHeader conhdr;
+	conhdr.magic = RDS_CONNECTION_MAGIC;
+	conhdr.token = token;
+	if (write(m_sharedSocket, &conhdr, sizeof(conhdr)) != sizeof(conhdr))
+	{
+		m_logger->warn("Failed to write connection header: %s", strerror(errno));
+		closeSharedStream();
+		return false;
+	}
+
+	struct pollfd pfd = { m_sharedSocket, POLLIN, 0 };
+	int fds[3];
+	char control[CMSG_SPACE(sizeof(fds))];
+	uint32_t magic = 0;
+	struct iovec iov = { &magic, sizeof(magic) };
+	struct msghdr msg;
+	memset(&msg, 0, sizeof(msg));
+	msg.msg_iov = &iov;
+	msg.msg_iovlen = 1;
+	msg.msg_control = control;
+	msg.msg_controllen = sizeof(control);
+	if (poll(&pfd, 1, SHARED_STREAM_WAIT) != 1
+			|| recvmsg(m_sharedSocket, &msg, MSG_CMSG_CLOEXEC) != sizeof(magic)
+			|| magic != RDS_SHM_MAGIC)
+	{
+		m_logger->warn("The storage service did not pass the shared memory stream");
+		closeSharedStream();
+		return false;
+	}
+	struct cmsghdr *cmsg = CMSG_FIRSTHDR(&msg);
+	if (!cmsg || cmsg->cmsg_level != SOL_SOCKET || cmsg->cmsg_type != SCM_RIGHTS
+			|| cmsg->cmsg_len != CMSG_LEN(sizeof(fds)))
+	{
+		m_logger->warn("The storage service did not pass the shared memory stream");
+		closeSharedStream();
+		return false;
+	}
+	memcpy(fds, CMSG_DATA(cmsg), sizeof(fds));
+	m_sharedDoorbell = fds[1];
+	m_sharedAck = fds[2];
+	void *mapping = mmap(NULL, sizeof(RDSShmHeader) + RDS_SHM_SIZE,
+				PROT_READ | PROT_WRITE, MAP_SHARED, fds[0], 0);
+	close(fds[0]);
+	if (mapping == MAP_FAILED)
+	{
+		m_logger->error("Failed to map the shared memory stream: %s", strerror(errno));
+		closeSharedStream();
+		return false;
+	}
+	m_shared = (RDSShmHeader *)mapping;
+	m_sharedRing = (char *)mapping + sizeof(RDSShmHeader);
+	if (m_shared->magic != RDS_SHM_MAGIC || m_shared->version != RDS_SHM_VERSION
+			|| m_shared->size != RDS_SHM_SIZE)
+	{
+		m_logger->error("The shared memory stream has an unsupported layout");
+		closeSharedStream();
+		return false;
+	}
+	m_sharedBlock = 0;
+	return true;
+}
+
+/**
+ * Close the shared memory stream, the storage service sees the socket
+ * close and releases its side of the stream
+ */
+void StorageClient::closeSharedStream()
+{
+	if (m_shared)
+	{
+		munmap(m_shared, sizeof(RDSShmHeader) + RDS_SHM_SIZE);
+		m_shared = NULL;
+		m_sharedRing = NULL;
+	}
+	if (m_sharedDoorbell != -1)
+		close(m_sharedDoorbell);
+	if (m_sharedAck != -1)
+		close(m_sharedAck);
+	if (m_sharedSocket != -1)
+		close(m_sharedSocket);
+	m_sharedSocket = m_sharedDoorbell = m_sharedAck = -1;
+}
+
+/**
+ * Wait until the storage service has consumed enough of the shared
+ * memory ring for the given number of bytes to be free
+ *
+ * @param space		The number of bytes required, RDS_SHM_SIZE waits
+ *			for every block to be consumed
+ * @return bool		False if a block was rejected, the storage service
+ *			closed the stream or did not consume a block in time
+ */
+bool StorageClient::waitShared(uint64_t space)
+{
+	uint64_t head = m_shared->head;
+	while (true)
+	{
+		uint64_t tail = __atomic_load_n(&m_shared->tail, __ATOMIC_ACQUIRE);
+		if (__atomic_load_n(&m_shared->ack.magic, __ATOMIC_ACQUIRE) == RDS_NACK_MAGIC)
+		{
+			m_logger->error("The storage service rejected block %d of the shared memory stream",
+					m_shared->ack.block);
+			return false;
+		}
+		if (RDS_SHM_SIZE - (head - tail) >= space)
+		{
+			return true;
+		}
+		struct pollfd fds[2] = { { m_sharedAck, POLLIN, 0 }, { m_sharedSocket, POLLIN, 0 } };
+		int rc = poll(fds, 2, SHARED_STREAM_WAIT);
+		if (rc < 0 && errno == EINTR)
+		{
+			continue;
+		}
+		if (rc <= 0)
+		{
+			m_logger->error("The storage service has not consumed the shared memory stream");
+			return false;
+		}
+		if (fds[1].revents)
+		{
+			m_logger->warn("Storage service has closed the shared memory stream");
+			return false;
+		}
+		uint64_t count;
+		if (read(m_sharedAck, &count, sizeof(count)) != sizeof(count) && errno != EAGAIN)
+		{
+			return false;
+		}
+	}
+}
+
+/**
+ * Take back a block written to the shared memory ring so that its readings
+ * may be sent by other means without being stored twice. A block that the
+ * storage service has already claimed can not be taken back, it is waited
+ * for until the storage service has consumed or rejected it, or has closed
+ * the stream.
+ *
+ * @param start		The position of the block in the ring
+ * @param end		The position of the end of the block in the ring
+ * @return bool		True if the storage service consumed the block, the
+ *			block that follows must then also be taken back
+ */
+bool StorageClient::withdrawShared(uint64_t start, uint64_t end)
+{
+	RDSShmBlockHeader *hdr = (RDSShmBlockHeader *)&m_sharedRing[start % RDS_SHM_SIZE];
+	uint32_t state = RDS_SHM_BLOCK_READY;
+	if (__atomic_load_n(&m_shared->tail, __ATOMIC_ACQUIRE) < end
+			&& __atomic_compare_exchange_n(&hdr->state, &state, RDS_SHM_BLOCK_WITHDRAWN,
+				false, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE))
+	{
+		return false;
+	}
+	bool waiting = false;
+	while (true)
+	{
+		if (__atomic_load_n(&m_shared->tail, __ATOMIC_ACQUIRE) >= end)
+		{
+			return true;
+		}
+		if (__atomic_load_n(&m_shared->ack.magic, __ATOMIC_ACQUIRE) == RDS_NACK_MAGIC)
+		{
+			return false;
+		}
+		if (!waiting)
+		{
+			m_logger->warn("Waiting for the storage service to store block %u of the shared memory stream",
+					hdr->block.blockNumber);
+			waiting = true;
+		}
+		struct pollfd fds[2] = { { m_sharedAck, POLLIN, 0 }, { m_sharedSocket, POLLIN, 0 } };
+		int rc = poll(fds, 2, SHARED_STREAM_WAIT);
+		if (rc < 0 && errno != EINTR)
+		{
+			return false;
+		}
+		if (rc > 0 && fds[1].revents)
+		{
+			// The readings of the block may or may not have been stored
+			m_logger->warn("Storage service closed the shared memory stream whilst storing block %u",
+					hdr->block.blockNumber);
+			return false;
+		}
+		uint64_t count;
+		if (rc > 0 && read(m_sharedAck, &count, sizeof(count)) != sizeof(count) && errno != EAGAIN)
+		{
+			return false;
+		}
+	}
+}
+
+/**
+ * Send readings to the storage service through the shared memory ring.
+ * The readings are written to the ring in blocks of at most half the
+ * ring and the call returns once the storage service has acknowledged
+ * every block, so that the readings have been stored in the same way as
+ * an append request. If the storage service rejects a block, or does not
+ * consume it in time, the blocks it has not claimed are taken back.
+ *
+ * @param readings	The readings to send
+ * @param sent		Set to the number of readings, from the start of
+ *			the vector, that have been acknowledged
+ * @return bool		True if all the readings have been stored
+ */
+bool StorageClient::streamSharedReadings(const vector<Reading *>& readings, size_t& sent)
+{
+	lock_guard<mutex> guard(m_sharedMutex);
+	sent = 0;
+	if (!m_shared)
+	{
+		return false;
+	}
+	const uint64_t maxBlock = RDS_SHM_SIZE / 2;
+	vector<string> payloads(readings.size());
+	vector<size_t> lengths(readings.size());
+	for (size_t i = 0; i < readings.size(); i++)
+	{
+		ReadingStreamPayload::encode(*readings[i], payloads[i]);
+		lengths[i] = RDS_SHM_ALIGN(offsetof(ReadingStream, assetCode)
+				+ readings[i]->getAssetName().length() + 1 + payloads[i].length());
+	}
+
+	struct SharedBlock {
+		uint64_t	start;	// Position of the block in the ring
+		uint64_t	end;	// Position of the end of the block
+		size_t		last;	// Readings to the end of the block
+	};
+	vector<SharedBlock> blocks;
+	size_t first = 0;
+	bool ok = true;
+	while (first < readings.size())
+	{
+		uint64_t length = 0;
+		size_t last = first;
+		while (last < readings.size()
+				&& sizeof(RDSShmBlockHeader) + length + lengths[last] <= maxBlock)
+		{
+			length += lengths[last++];
+		}
+		if (last == first)
+		{
+			m_logger->warn("A reading of asset %s is too large for the shared memory stream",
+					readings[first]->getAssetName().c_str());
+			break;
+		}
+		uint64_t blockLength = sizeof(RDSShmBlockHeader) + length;
+		uint64_t head = m_shared->head;
+		uint64_t offset = head % RDS_SHM_SIZE;
+		uint64_t skip = (RDS_SHM_SIZE - offset < blockLength) ? RDS_SHM_SIZE - offset : 0;
+		if (!waitShared(skip + blockLength))
+		{
+			ok = false;
+			break;
+		}
+		if (skip)
+		{
+			if (skip >= sizeof(RDSShmBlockHeader))
+			{
+				*(uint32_t *)&m_sharedRing[offset] = RDS_SHM_WRAP_MAGIC;
+			}
+			head += skip;
+			offset = 0;
+		}
+		RDSShmBlockHeader *hdr = (RDSShmBlockHeader *)&m_sharedRing[offset];
+		hdr->block.magic = RDS_BLOCK_MAGIC;
+		hdr->block.blockNumber = m_sharedBlock++;
+		hdr->block.count = last - first;
+		hdr->state = RDS_SHM_BLOCK_READY;
+		hdr->length = length;
+		char *p = (char *)(hdr + 1);
+		for (size_t i = first; i < last; i++)
+		{
+			ReadingStream *rs = (ReadingStream *)p;
+			const string& asset = readings[i]->getAssetName();
+			rs->assetCodeLength = asset.length() + 1;
+			rs->payloadLength = payloads[i].length();
+			rs->payloadFormat = RDS_PAYLOAD_BINARY;
+			readings[i]->getUserTimestamp(&rs->userTs);
+			memcpy(rs->assetCode, asset.c_str(), rs->assetCodeLength);
+			memcpy(&rs->assetCode[rs->assetCodeLength], payloads[i].data(), rs->payloadLength);
+			p += lengths[i];
+		}
+		__atomic_store_n(&m_shared->head, head + blockLength, __ATOMIC_RELEASE);
+		uint64_t one = 1;
+		if (write(m_sharedDoorbell, &one, sizeof(one)) != sizeof(one))
+		{
+			m_logger->error("Failed to ring shared memory stream doorbell: %s", strerror(errno));
+			ok = false;
+			break;
+		}
+		SharedBlock block = { head, head + blockLength, last };
+		blocks.push_back(block);
+		first = last;
+	}
+
+	// Wait for every block that was written to be stored
+	if (ok && !waitShared(RDS_SHM_SIZE))
+	{
+		ok = false;
+	}
+	if (!ok)
+	{
+		// Take back the blocks that have not been consumed so that the
+		// caller may send their readings by other means
+		for (auto& block : blocks)
+		{
+			if (!withdrawShared(block.start, block.end))
+			{
+				break;
+			}
+		}
+	}
+	uint64_t tail = __atomic_load_n(&m_shared->tail, __ATOMIC_ACQUIRE);
+	for (auto& block : blocks)
+	{
+		if (block.end <= tail)
+		{
+			sent = block.last;
+		}
+	}
+	if (!ok)
+	{
+		closeSharedStream();
+		m_sharedRetry = time(0) + SHARED_STREAM_RETRY;
+	}
+	return sent == readings.size();
+}
+
+/**
+ * Handle exceptions encountered when communicating to the storage system
+ *
+ * @param ex	The exception we are handling
+ */
+void StorageClient::handleException(const exception& ex, const char *operation, ...)
+{
+	char buf[EXCEPTION_BUFFER_SIZE];
 	va_list ap;
 	va_start(ap, operation);
 	vsnprintf(buf, sizeof(buf), operation, ap);
@@ -1470,10 +3194,15 @@ void StorageClient::handleException(const exception& ex, const char *operation,
 	if (m_lastException.compare("Connection refused") == 0)
 	{
 		// This is probably because the storage service has gone down
+		if (m_unreachable)
+		{
+			m_unreachable();
+		}
 		if (m_management)
 		{
 			// Get a handle on the storage layer
 			ServiceRecord storageRecord("Fledge Storage");
+			m_management->invalidateService(storageRecord.getName());
 			if (!m_management->getService(storageRecord))
 			{
 				m_logger->fatal("Unable to find a storage service from service registry, exiting...");
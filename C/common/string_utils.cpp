@@ -49,11 +49,34 @@ void StringReplaceAll(std::string& StringToManage,
 				   const std::string& StringToSearch,
 				   const std::string& StringReplacement)
 {
-
-	while (StringToManage.find(StringToSearch) != string::npos)
+	if (StringToSearch.empty())
+	{
+		return;
+	}
+	size_t pos = StringToManage.find(StringToSearch);
+	if (pos == string::npos)
 	{
-		StringReplace(StringToManage,StringToSearch, StringReplacement);
+		return;
 	}
+
+	// A replacement can join its neighbours into a new occurrence, e.g.
+	// replacing // with / in ///, passes are repeated until none is left.
+	// A replacement that itself contains the search string would never
+	// terminate, only one pass is made for it.
+	bool again = StringReplacement.find(StringToSearch) == string::npos;
+	string output;
+	do {
+		output.clear();
+		output.reserve(StringToManage.length());
+		size_t start = 0;
+		do {
+			output.append(StringToManage, start, pos - start);
+			output.append(StringReplacement);
+			start = pos + StringToSearch.length();
+		} while ((pos = StringToManage.find(StringToSearch, start)) != string::npos);
+		output.append(StringToManage, start, string::npos);
+		StringToManage.swap(output);
+	} while (again && (pos = StringToManage.find(StringToSearch)) != string::npos);
 }
 
 /**
@@ -127,30 +150,21 @@ std::string extractLastLevel(const std::string& path, char separator)
  */
 std::string StringSlashFix(const std::string& stringToFix)
 {
-	std::string stringFixed;
-
-	stringFixed = stringToFix;
-
-	if (!stringFixed.empty()) {
-
-		char singleChar;
-
-		// Remove first char if '/'
-		for (singleChar = stringFixed.front() ; singleChar == '/' ; singleChar = stringFixed.front())
-		{
-			stringFixed.erase(0, 1);
-		}
-
-		// Remove last char if '/'
-		for (singleChar = stringFixed.back() ; singleChar == '/' ; singleChar = stringFixed.back())
-		{
-			stringFixed.pop_back();
-		}
+	size_t start = stringToFix.find_first_not_of('/');
+	if (start == string::npos)
+	{
+		return "";
+	}
+	size_t end = stringToFix.find_last_not_of('/') + 1;
 
-		// Substitute // with /
-		while (stringFixed.find("//") != string::npos)
+	std::string stringFixed;
+	stringFixed.reserve(end - start);
+	for (size_t i = start; i < end; i++)
+	{
+		char c = stringToFix[i];
+		if (c != '/' || stringFixed.back() != '/')
 		{
-			StringReplace(stringFixed, "//", "/");
+			stringFixed += c;
 		}
 	}
 
@@ -199,19 +213,13 @@ string StringStripWhiteSpacesAll(const  std::string& original)
 {
 	string output;
 
-	output = original;
-
-	for (size_t i = 0; i < output.length(); )
+	output.reserve(original.length());
+	for (char c : original)
 	{
-		if (isspace(output[i]))
-		{
-			output.erase(i, 1);
-		}
-		else
+		if (!isspace((unsigned char)c))
 		{
-			i++;
+			output += c;
 		}
-
 	}
 
 	return (output);
@@ -268,54 +276,57 @@ string StringStripWhiteSpacesExtra(const  std::string& original)
  */
 string urlEncode(const string &s)
 {
-	ostringstream escaped;
-	escaped.fill('0');
-	escaped << hex;
+	string escaped;
+	urlEncode(s, escaped);
+	return escaped;
+}
+
+/**
+ * URL-encode a given string, appending the result to a string.
+ * This allows a URL to be built without the temporary strings
+ * of the version that returns the encoded string.
+ *
+ * @param s             Input string that is to be URL-encoded
+ * @param escaped       The string to append the URL-encoded string to
+ */
+void urlEncode(const string &s, string& escaped)
+{
+	static const char hex[] = "0123456789ABCDEF";
 
+	escaped.reserve(escaped.length() + s.length());
 	for (string::const_iterator i = s.begin(), n = s.end();
 				    i != n;
 				    ++i)
 	{
-		string::value_type c = (*i);
+		unsigned char c = (*i);
 
 		// Keep alphanumeric and other accepted characters intact
 		if (isalnum(c) || c == '-' || c == '_' || c == '.' || c == '~') {
-			escaped << c;
+			escaped += (char)c;
 			continue;
 		}
 
 		 // Any other characters are percent-encoded
-		escaped << uppercase;
-		escaped << '%' << setw(2) << int((unsigned char) c);
-		escaped << nouppercase;
+		escaped += '%';
+		escaped += hex[c >> 4];
+		escaped += hex[c & 0x0f];
 	}
-
-	return escaped.str();
 }
 
 /**
- * Check if a char is an hex value
+ * Return the value of an upper case hex digit
  *
  * @param c	The input char
- * @return	True with hex value
- * 		false otherwise
+ * @return	The value of the digit or -1 if the char
+ *		is not an upper case hex digit
  */
-static inline bool ishex (const char c)
+static inline int hexValue(const char c)
 {
-	if (isdigit(c) ||
-	    c=='A' ||
-	    c=='B' ||
-	    c=='C' ||
-	    c=='D' ||
-	    c=='E' ||
-	    c=='F')
-	{
-		return true;
-	}
-	else
-	{
-		return false;
-	}
+	if (c >= '0' && c <= '9')
+		return c - '0';
+	if (c >= 'A' && c <= 'F')
+		return c - 'A' + 10;
+	return -1;
 }
 
 /**
@@ -329,34 +340,38 @@ static inline bool ishex (const char c)
  */
 string urlDecode(const std::string& name)
 {
-	std::string decoded(name);
-	char* s = (char *)name.c_str();
-	char* dec = (char *)decoded.c_str();
-	char* o;
-	const char* end = s + name.length();
-	int c;
-
-	for (o = dec; s <= end; o++)
+	std::string decoded;
+	const char *s = name.c_str();
+	const char *end = s + name.length();
+
+	decoded.reserve(name.length());
+	while (s < end)
 	{
-		c = *s++;
+		int c = *s++;
 		if (c == '+')
 		{
 			c = ' ';
 		}
-		else if (c == '%' && (!ishex(*s++) ||
-			 !ishex(*s++) ||
-			 !sscanf(s - 2, "%2x", &c)))
+		else if (c == '%')
 		{
-			break;
+			int high = s < end ? hexValue(s[0]) : -1;
+			int low = s + 1 < end ? hexValue(s[1]) : -1;
+			if (high < 0 || low < 0)
+			{
+				break;
+			}
+			c = (high << 4) | low;
+			s += 2;
 		}
-
-		if (dec)
+		if (c == 0)
 		{
-			*o = c;
+			// The decoded string ends at an encoded NUL
+			break;
 		}
+		decoded += (char)c;
 	}
 
-	return string(dec);
+	return decoded;
 }
 
 /**
@@ -440,8 +455,12 @@ std::string StringTrim(const std::string& str)
  */
 bool IsRegex(const string &str) {
 
-	size_t nChar;
-	nChar = strcspn(str.c_str(), "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789_");
+	// Only the first character decides, there is no need to scan the string
+	if (str.empty())
+	{
+		return false;
+	}
+	unsigned char c = str[0];
 
-	return (nChar != 0);
+	return !(isalnum(c) || c == '_');
 }
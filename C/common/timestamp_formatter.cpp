@@ -0,0 +1,269 @@
+/*
+ * Fledge fixed format timestamp conversion
+ *
+ * Copyright (c) 2026 Dianomic Systems
+ *
+ * Released under the Apache 2.0 Licence
+ *
+ * Author: agent
+ */
+#include <timestamp_formatter.h>
+#include <string.h>
+
+#define SECONDS_PER_DAY		86400L
+#define MAX_TIMESTAMP		253402300799L	// 9999-12-31 23:59:59
+
+// The two digit decimal representation of 0 to 99
+static const char digitPairs[] = "00010203040506070809101112131415161718192021222324252627282930313233343536373839404142434445464748495051525354555657585960616263646566676869707172737475767778798081828384858687888990919293949596979899";
+
+/**
+ * The date and time of the last second formatted by a thread
+ */
+static thread_local struct {
+	time_t	seconds;
+	long	day;
+	char	separator;
+	char	text[TIMESTAMP_DATE_TIME_LEN];
+} lastFormatted = { -1, -1, 0, { 0 } };
+
+/**
+ * Write two decimal digits
+ */
+static inline void putDigits(char *buffer, unsigned int value)
+{
+	memcpy(buffer, &digitPairs[value * 2], 2);
+}
+
+/**
+ * Read a fixed number of decimal digits
+ *
+ * @param str		The digits
+ * @param count		The number of digits to read
+ * @param value		Set to the value of the digits
+ * @return bool		False if a character is not a digit
+ */
+static inline bool getDigits(const char *str, int count, unsigned int& value)
+{
+	value = 0;
+	for (int i = 0; i < count; i++)
+	{
+		unsigned int digit = (unsigned char)str[i] - '0';
+		if (digit > 9)
+		{
+			return false;
+		}
+		value = value * 10 + digit;
+	}
+	return true;
+}
+
+/**
+ * Format the date and time of a UTC timestamp as YYYY-MM-DD HH:MM:SS
+ * with the given separator between the date and time. The buffer is not
+ * terminated.
+ *
+ * @param buffer	The buffer of at least TIMESTAMP_DATE_TIME_LEN characters
+ * @param seconds	The seconds since the epoch
+ * @param separator	The character between the date and the time
+ * @return size_t	The number of characters written, 0 if the year is
+ *			not between 1970 and 9999
+ */
+size_t TimestampFormatter::formatDateTime(char *buffer, time_t seconds, char separator)
+{
+	if (seconds < 0 || seconds > MAX_TIMESTAMP)
+	{
+		return 0;
+	}
+	if (seconds == lastFormatted.seconds && separator == lastFormatted.separator)
+	{
+		memcpy(buffer, lastFormatted.text, TIMESTAMP_DATE_TIME_LEN);
+		return TIMESTAMP_DATE_TIME_LEN;
+	}
+	long day = seconds / SECONDS_PER_DAY;
+	if (day != lastFormatted.day)
+	{
+		int year;
+		unsigned int month, mday;
+		civilFromDays(day, year, month, mday);
+		putDigits(lastFormatted.text, year / 100);
+		putDigits(&lastFormatted.text[2], year % 100);
+		lastFormatted.text[4] = '-';
+		putDigits(&lastFormatted.text[5], month);
+		lastFormatted.text[7] = '-';
+		putDigits(&lastFormatted.text[8], mday);
+		lastFormatted.day = day;
+	}
+	unsigned int secs = seconds % SECONDS_PER_DAY;
+	lastFormatted.text[10] = separator;
+	putDigits(&lastFormatted.text[11], secs / 3600);
+	lastFormatted.text[13] = ':';
+	putDigits(&lastFormatted.text[14], (secs / 60) % 60);
+	lastFormatted.text[16] = ':';
+	putDigits(&lastFormatted.text[17], secs % 60);
+	lastFormatted.seconds = seconds;
+	lastFormatted.separator = separator;
+	memcpy(buffer, lastFormatted.text, TIMESTAMP_DATE_TIME_LEN);
+	return TIMESTAMP_DATE_TIME_LEN;
+}
+
+/**
+ * Format microseconds as a decimal point followed by six digits. The
+ * buffer is not terminated.
+ *
+ * @param buffer	The buffer of at least TIMESTAMP_MICROSECONDS_LEN characters
+ * @param usec		The microseconds, 0 to 999999
+ * @return size_t	The number of characters written
+ */
+size_t TimestampFormatter::formatMicroseconds(char *buffer, long usec)
+{
+	unsigned long value = (unsigned long)usec % 1000000;
+	buffer[0] = '.';
+	putDigits(&buffer[1], value / 10000);
+	putDigits(&buffer[3], (value / 100) % 100);
+	putDigits(&buffer[5], value % 100);
+	return TIMESTAMP_MICROSECONDS_LEN;
+}
+
+/**
+ * Parse a timestamp of the form
+ *
+ *	YYYY-MM-DD HH:MM:SS[.fraction][ ][Z|+HH[:MM]|-HH[:MM]]
+ *
+ * where the date and time may also be separated by a T and the hours of
+ * the timezone offset may be a single digit. Fractions of more than six
+ * digits are truncated to microseconds. A timestamp without a timezone
+ * is taken to be UTC.
+ *
+ * @param timestamp	The timestamp to parse
+ * @param tv		Set to the UTC time of the timestamp
+ * @return bool		False if the timestamp is not of this form
+ */
+bool TimestampFormatter::parse(const char *timestamp, struct timeval *tv)
+{
+	unsigned int year, month, day, hour, minute, second;
+	const char *p = timestamp;
+
+	if (!getDigits(p, 4, year) || p[4] != '-'
+		|| !getDigits(&p[5], 2, month) || p[7] != '-'
+		|| !getDigits(&p[8], 2, day) || (p[10] != ' ' && p[10] != 'T')
+		|| !getDigits(&p[11], 2, hour) || p[13] != ':'
+		|| !getDigits(&p[14], 2, minute) || p[16] != ':'
+		|| !getDigits(&p[17], 2, second))
+	{
+		return false;
+	}
+	if (month < 1 || month > 12 || day < 1 || day > 31 || hour > 23
+		|| minute > 59 || second > 60)
+	{
+		return false;
+	}
+	p += TIMESTAMP_DATE_TIME_LEN;
+
+	long usec = 0;
+	if (*p == '.')
+	{
+		p++;
+		int digits = 0;
+		while ((unsigned int)((unsigned char)*p - '0') <= 9)
+		{
+			if (digits < 6)
+			{
+				usec = usec * 10 + (*p - '0');
+				digits++;
+			}
+			p++;
+		}
+		for (; digits < 6; digits++)
+		{
+			usec *= 10;
+		}
+	}
+
+	long offset = 0;
+	while (*p == ' ')
+	{
+		p++;
+	}
+	if (*p == 'Z')
+	{
+		p++;
+	}
+	else if (*p == '+' || *p == '-')
+	{
+		int sign = (*p == '+' ? -1 : 1);
+		unsigned int tzHours, tzMinutes = 0;
+		p++;
+		if (getDigits(p, 2, tzHours))
+		{
+			p += 2;
+		}
+		else if (getDigits(p, 1, tzHours))
+		{
+			p++;
+		}
+		else
+		{
+			return false;
+		}
+		if (*p == ':')
+		{
+			p++;
+		}
+		if (getDigits(p, 2, tzMinutes))
+		{
+			p += 2;
+		}
+		offset = sign * (long)(tzHours * 3600 + tzMinutes * 60);
+	}
+	if (*p && *p != ' ')
+	{
+		return false;
+	}
+
+	tv->tv_sec = daysFromCivil(year, month, day) * SECONDS_PER_DAY
+			+ hour * 3600 + minute * 60 + second + offset;
+	tv->tv_usec = usec;
+	return true;
+}
+
+/**
+ * Convert a count of days since 1970-01-01 to a date in the
+ * proleptic Gregorian calendar
+ *
+ * @param days		Days since the epoch
+ * @param year		Set to the year
+ * @param month		Set to the month, 1 to 12
+ * @param day		Set to the day of the month, 1 to 31
+ */
+void TimestampFormatter::civilFromDays(long days, int& year, unsigned int& month, unsigned int& day)
+{
+	// Count from 0000-03-01 so that the leap day is the last of the year
+	days += 719468;
+	long era = (days >= 0 ? days : days - 146096) / 146097;
+	unsigned int dayOfEra = (unsigned int)(days - era * 146097);
+	unsigned int yearOfEra = (dayOfEra - dayOfEra / 1460 + dayOfEra / 36524 - dayOfEra / 146096) / 365;
+	unsigned int dayOfYear = dayOfEra - (365 * yearOfEra + yearOfEra / 4 - yearOfEra / 100);
+	unsigned int monthIndex = (5 * dayOfYear + 2) / 153;
+	day = dayOfYear - (153 * monthIndex + 2) / 5 + 1;
+	month = monthIndex < 10 ? monthIndex + 3 : monthIndex - 9;
+	year = (int)(yearOfEra + era * 400) + (month <= 2);
+}
+
+/**
+ * Convert a date in the proleptic Gregorian calendar to a count of days
+ * since 1970-01-01
+ *
+ * @param year		The year
+ * @param month		The month, 1 to 12
+ * @param day		The day of the month
+ * @return long		Days since the epoch
+ */
+long TimestampFormatter::daysFromCivil(int year, unsigned int month, unsigned int day)
+{
+	year -= month <= 2;
+	long era = (year >= 0 ? year : year - 399) / 400;
+	unsigned int yearOfEra = (unsigned int)(year - era * 400);
+	unsigned int dayOfYear = (153 * (month > 2 ? month - 3 : month + 9) + 2) / 5 + day - 1;
+	unsigned int dayOfEra = yearOfEra * 365 + yearOfEra / 4 - yearOfEra / 100 + dayOfYear;
+	return era * 146097 + (long)dayOfEra - 719468;
+}
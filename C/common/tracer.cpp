@@ -0,0 +1,222 @@
+/*
+ * Fledge tracing of the data path.
+ *
+ * Copyright (c) 2026 Dianomic Systems
+ *
+ * Released under the Apache 2.0 Licence
+ *
+ * Author: agent
+ */
+#include <tracer.h>
+#include <json_utils.h>
+#include <sstream>
+#include <algorithm>
+#include <pthread.h>
+#include <unistd.h>
+#include <time.h>
+#include <sys/syscall.h>
+
+#define TRACE_MAX_BUFFERS	256	// Buffers kept before those of exited threads are dropped
+
+using namespace std;
+
+/**
+ * Create the ring buffer of the calling thread
+ */
+TraceBuffer::TraceBuffer() : m_head(0), m_tail(0)
+{
+	m_tid = (pid_t)syscall(SYS_gettid);
+	char name[32];
+	if (pthread_getname_np(pthread_self(), name, sizeof(name)) == 0)
+	{
+		m_threadName = name;
+	}
+}
+
+/**
+ * Record a span in the ring buffer, overwriting the oldest span once
+ * the buffer is full. Only called by the thread that owns the buffer.
+ *
+ * @param category	The category of the span
+ * @param name		The name of the span
+ * @param start		The start of the span in microseconds
+ * @param duration	The duration of the span in microseconds
+ */
+void TraceBuffer::record(const char *category, const char *name, uint64_t start, uint64_t duration)
+{
+	uint64_t head = m_head.load(memory_order_relaxed);
+	Slot& slot = m_slots[head % TRACE_BUFFER_EVENTS];
+	slot.category.store(category, memory_order_relaxed);
+	slot.name.store(name, memory_order_relaxed);
+	slot.start.store(start, memory_order_relaxed);
+	slot.duration.store(duration, memory_order_relaxed);
+	m_head.store(head + 1, memory_order_release);
+}
+
+/**
+ * Append the spans in the buffer to a vector of events. The owning
+ * thread may record spans while they are copied, a copied slot is only
+ * kept if the thread cannot have started to overwrite it.
+ *
+ * @param events	The vector to append the spans to
+ */
+void TraceBuffer::events(vector<TraceEvent>& events) const
+{
+	uint64_t head = m_head.load(memory_order_acquire);
+	uint64_t first = head > TRACE_BUFFER_EVENTS ? head - TRACE_BUFFER_EVENTS : 0;
+	first = max(first, m_tail.load(memory_order_relaxed));
+
+	vector<TraceEvent> copied;
+	copied.reserve(head - first);
+	for (uint64_t i = first; i < head; i++)
+	{
+		const Slot& slot = m_slots[i % TRACE_BUFFER_EVENTS];
+		TraceEvent event;
+		event.category = slot.category.load(memory_order_relaxed);
+		event.name = slot.name.load(memory_order_relaxed);
+		event.start = slot.start.load(memory_order_relaxed);
+		event.duration = slot.duration.load(memory_order_relaxed);
+		copied.push_back(event);
+	}
+
+	// The slot of the span being recorded now is not yet counted in the head
+	atomic_thread_fence(memory_order_acquire);
+	uint64_t after = m_head.load(memory_order_relaxed);
+	uint64_t valid = after >= TRACE_BUFFER_EVENTS ? after - TRACE_BUFFER_EVENTS + 1 : 0;
+	for (uint64_t i = first; i < head; i++)
+	{
+		if (i >= valid)
+		{
+			events.push_back(copied[i - first]);
+		}
+	}
+}
+
+/**
+ * Return the singleton tracer
+ */
+Tracer *Tracer::getInstance()
+{
+	// Every span calls this, the initialisation of a local static is thread safe
+	static Tracer *instance = new Tracer();
+	return instance;
+}
+
+/**
+ * Return the time of the monotonic clock in microseconds
+ */
+uint64_t Tracer::now()
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+/**
+ * Start or stop the recording of spans. The spans recorded before
+ * tracing was last enabled are discarded when it is enabled.
+ *
+ * @param enabled	True to record spans
+ */
+void Tracer::enable(bool enabled)
+{
+	if (enabled && !isEnabled())
+	{
+		clear();
+	}
+	m_enabled.store(enabled, memory_order_relaxed);
+}
+
+/**
+ * Return the ring buffer of the calling thread, creating it on the
+ * first span of the thread
+ */
+TraceBuffer *Tracer::threadBuffer()
+{
+	static thread_local shared_ptr<TraceBuffer> buffer;
+	if (!buffer)
+	{
+		buffer = make_shared<TraceBuffer>();
+		lock_guard<mutex> guard(m_mutex);
+		if (m_buffers.size() >= TRACE_MAX_BUFFERS)
+		{
+			// The tracer holds the only reference to the buffers of exited threads
+			m_buffers.erase(remove_if(m_buffers.begin(), m_buffers.end(),
+					[](const shared_ptr<TraceBuffer>& b) { return b.use_count() == 1; }),
+					m_buffers.end());
+		}
+		m_buffers.push_back(buffer);
+	}
+	return buffer.get();
+}
+
+/**
+ * Record a span completed by the calling thread
+ *
+ * @param category	The category of the span
+ * @param name		The name of the span
+ * @param start		The start of the span in microseconds
+ * @param duration	The duration of the span in microseconds
+ */
+void Tracer::record(const char *category, const char *name, uint64_t start, uint64_t duration)
+{
+	threadBuffer()->record(category, name, start, duration);
+}
+
+/**
+ * Discard the recorded spans and the buffers of the threads that have exited
+ */
+void Tracer::clear()
+{
+	lock_guard<mutex> guard(m_mutex);
+	m_buffers.erase(remove_if(m_buffers.begin(), m_buffers.end(),
+			[](const shared_ptr<TraceBuffer>& b) { return b.use_count() == 1; }),
+			m_buffers.end());
+	for (auto& buffer : m_buffers)
+	{
+		buffer->clear();
+	}
+}
+
+/**
+ * Return the recorded spans as a Chrome trace event document. Each
+ * thread is named in the trace and the process is named after the
+ * service.
+ *
+ * @param json		The string to return the document in
+ * @param process	The name of the process in the trace
+ */
+void Tracer::toChromeTrace(string& json, const string& process)
+{
+	vector<shared_ptr<TraceBuffer>> buffers;
+	{
+		lock_guard<mutex> guard(m_mutex);
+		buffers = m_buffers;
+	}
+	pid_t pid = getpid();
+
+	ostringstream convert;
+	convert << "{ \"displayTimeUnit\" : \"ms\", \"traceEvents\" : [ ";
+	convert << "{ \"ph\" : \"M\", \"name\" : \"process_name\", \"pid\" : " << pid;
+	convert << ", \"args\" : { \"name\" : \"" << JSONescape(process) << "\" } }";
+	vector<TraceEvent> events;
+	for (auto& buffer : buffers)
+	{
+		pid_t tid = buffer->getThreadId();
+		convert << ", { \"ph\" : \"M\", \"name\" : \"thread_name\", \"pid\" : " << pid;
+		convert << ", \"tid\" : " << tid << ", \"args\" : { \"name\" : \"";
+		convert << JSONescape(buffer->getThreadName()) << "\" } }";
+
+		events.clear();
+		buffer->events(events);
+		for (auto& event : events)
+		{
+			convert << ", { \"ph\" : \"X\", \"cat\" : \"" << event.category;
+			convert << "\", \"name\" : \"" << event.name;
+			convert << "\", \"ts\" : " << event.start << ", \"dur\" : " << event.duration;
+			convert << ", \"pid\" : " << pid << ", \"tid\" : " << tid << " }";
+		}
+	}
+	convert << " ] }";
+	json = convert.str();
+}
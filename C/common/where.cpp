@@ -9,8 +9,7 @@
  */
 #include <where.h>
 #include <string>
-#include <sstream>
-#include <iostream>
+#include <iterator>
 
 using namespace std;
 
@@ -30,76 +29,113 @@ Where::~Where()
 }
 
 /**
- * Return the JSON payload for a where clause
+ * Replace the value of the condition, the value of an in condition
+ * becomes the only value in the list
+ *
+ * @param value	The new value of the condition
  */
-const string Where::toJSON() const
+void Where::value(const string& value)
 {
-ostringstream json;
+	if (m_condition != In)
+	{
+		m_value = value;
+	}
+	else
+	{
+		m_in.clear();
+		m_in.push_back(value);
+	}
+	m_json.clear();
+}
+
+/**
+ * Return if the JSON payload of the where clause, and of the clauses
+ * it is combined with, is still held
+ *
+ * @return bool	False if a clause has been modified since it was serialised
+ */
+bool Where::isCached() const
+{
+	return !m_json.empty() && (!m_and || m_and->isCached()) && (!m_or || m_or->isCached());
+}
+
+/**
+ * Return the JSON payload for a where clause. The payload is built
+ * again only if the clause has been modified since it was last returned.
+ */
+const string& Where::toJSON() const
+{
+	if (isCached())
+	{
+		return m_json;
+	}
 
-	json << "{ \"column\" : \"" << m_column << "\", ";
-	json << "\"condition\" : \"";
+	string json;
+	json.append("{ \"column\" : \"").append(m_column).append("\", ");
+	json.append("\"condition\" : \"");
 	switch (m_condition)
 	{
 	case Older:
-		json << "older";
+		json.append("older");
 		break;
 	case Newer:
-		json << "newer";
+		json.append("newer");
 		break;
 	case Equals:
-		json << "=";
+		json.append("=");
 		break;
 	case NotEquals:
-		json << "!=";
+		json.append("!=");
 		break;
 	case LessThan:
-		json << "<";
+		json.append("<");
 		break;
 	case GreaterThan:
-		json << ">";
+		json.append(">");
 		break;
 	case In:
-		json << "in";
+		json.append("in");
 		break;
 	}
-	json << "\", ";
+	json.append("\", ");
 
 	if ( (m_condition == Older) || (m_condition == Newer) )
 	{
-		json << "\"value\" : " << m_value << "";
+		json.append("\"value\" : ").append(m_value);
 
 	}
 	else if (m_condition != In)
 	{
-		json << "\"value\" : \"" << m_value << "\"";
+		json.append("\"value\" : \"").append(m_value).append("\"");
 	}
 	else
 	{
-		json << "\"value\" : [";
+		json.append("\"value\" : [");
 		for (auto v = m_in.begin();
 		     v != m_in.end();
 		     ++v)
 		{
-			json << "\"" << *v << "\"";
+			json.append("\"").append(*v).append("\"");
 			if (next(v, 1) != m_in.end())
 			{
-				json << ", ";
+				json.append(", ");
 			}
 		}
-		json << "]";
+		json.append("]");
 	}
 
 	if (m_and || m_or)
 	{
 		if (m_and)
 		{
-			json << ", \"and\" : " << m_and->toJSON();
+			json.append(", \"and\" : ").append(m_and->toJSON());
 		}
 		if (m_or)
 		{
-			json << ", \"or\" : " << m_or->toJSON();
+			json.append(", \"or\" : ").append(m_or->toJSON());
 		}
 	}
-	json << " }";
-	return json.str();
+	json.append(" }");
+	m_json.swap(json);
+	return m_json;
 }
@@ -0,0 +1,513 @@
+/*
+ * Fledge edge to edge reading transport.
+ *
+ * Copyright (c) 2026 Dianomic Systems
+ *
+ * Released under the Apache 2.0 Licence
+ *
+ * Author: agent
+ */
+#include <edge_link.h>
+#include <reading.h>
+#include <reading_stream_payload.h>
+#include <logger.h>
+#include <openssl/err.h>
+#include <zlib.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <netdb.h>
+#include <poll.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <string.h>
+#include <errno.h>
+
+using namespace std;
+
+/**
+ * Return the description of the last OpenSSL error
+ */
+static string sslError()
+{
+	char buffer[256];
+	ERR_error_string_n(ERR_get_error(), buffer, sizeof(buffer));
+	return string(buffer);
+}
+
+/**
+ * Create a link over a connected socket
+ *
+ * @param socket	The connected socket
+ * @param ssl		The TLS session over the socket, NULL for plain TCP
+ */
+EdgeLink::EdgeLink(int socket, SSL *ssl) : m_socket(socket), m_ssl(ssl),
+	m_offset(0), m_fromBuffer(false)
+{
+}
+
+/**
+ * Close the link
+ */
+EdgeLink::~EdgeLink()
+{
+	if (m_ssl)
+	{
+		SSL_shutdown(m_ssl);
+		SSL_free(m_ssl);
+	}
+	close(m_socket);
+}
+
+/**
+ * Create the TLS context of a sender. The certificate of the receiver
+ * is verified with the certificate authorities of the system, or those
+ * of a file for receivers with their own authority.
+ *
+ * @param caFile	The file of certificate authorities, empty to use the system ones
+ * @return SSL_CTX*	The context or NULL on failure
+ */
+SSL_CTX *EdgeLink::clientContext(const string& caFile)
+{
+	SSL_CTX *ctx = SSL_CTX_new(TLS_client_method());
+	if (!ctx)
+	{
+		Logger::getLogger()->error("Unable to create the TLS context: %s", sslError().c_str());
+		return NULL;
+	}
+	int rval = caFile.empty() ? SSL_CTX_set_default_verify_paths(ctx)
+			: SSL_CTX_load_verify_locations(ctx, caFile.c_str(), NULL);
+	if (rval != 1)
+	{
+		Logger::getLogger()->error("Unable to load the certificate authorities %s: %s",
+				caFile.c_str(), sslError().c_str());
+		SSL_CTX_free(ctx);
+		return NULL;
+	}
+	SSL_CTX_set_verify(ctx, SSL_VERIFY_PEER, NULL);
+	return ctx;
+}
+
+/**
+ * Create the TLS context of a receiver
+ *
+ * @param certFile	The file of the certificate chain of the receiver
+ * @param keyFile	The file of the private key of the receiver
+ * @return SSL_CTX*	The context or NULL on failure
+ */
+SSL_CTX *EdgeLink::serverContext(const string& certFile, const string& keyFile)
+{
+	SSL_CTX *ctx = SSL_CTX_new(TLS_server_method());
+	if (!ctx)
+	{
+		Logger::getLogger()->error("Unable to create the TLS context: %s", sslError().c_str());
+		return NULL;
+	}
+	if (SSL_CTX_use_certificate_chain_file(ctx, certFile.c_str()) != 1
+			|| SSL_CTX_use_PrivateKey_file(ctx, keyFile.c_str(), SSL_FILETYPE_PEM) != 1)
+	{
+		Logger::getLogger()->error("Unable to load the certificate %s and key %s: %s",
+				certFile.c_str(), keyFile.c_str(), sslError().c_str());
+		SSL_CTX_free(ctx);
+		return NULL;
+	}
+	return ctx;
+}
+
+/**
+ * Connect to a receiver
+ *
+ * @param host		The host of the receiver
+ * @param port		The port of the receiver
+ * @param ctx		The TLS context, NULL for plain TCP
+ * @param timeout	Milliseconds allowed to connect
+ * @return EdgeLink*	The link or NULL on failure
+ */
+EdgeLink *EdgeLink::connect(const string& host, unsigned short port, SSL_CTX *ctx, int timeout)
+{
+	struct addrinfo hints, *addrs;
+	memset(&hints, 0, sizeof(hints));
+	hints.ai_family = AF_UNSPEC;
+	hints.ai_socktype = SOCK_STREAM;
+	if (getaddrinfo(host.c_str(), to_string(port).c_str(), &hints, &addrs) != 0)
+	{
+		Logger::getLogger()->warn("Unable to resolve the edge receiver %s", host.c_str());
+		return NULL;
+	}
+	int sock = -1;
+	for (struct addrinfo *addr = addrs; addr && sock == -1; addr = addr->ai_next)
+	{
+		if ((sock = socket(addr->ai_family, addr->ai_socktype, addr->ai_protocol)) == -1)
+		{
+			continue;
+		}
+		int flags = fcntl(sock, F_GETFL, 0);
+		fcntl(sock, F_SETFL, flags | O_NONBLOCK);
+		int rval = ::connect(sock, addr->ai_addr, addr->ai_addrlen);
+		if (rval < 0 && errno == EINPROGRESS)
+		{
+			struct pollfd fds;
+			fds.fd = sock;
+			fds.events = POLLOUT;
+			int err = ETIMEDOUT;
+			socklen_t len = sizeof(err);
+			if (poll(&fds, 1, timeout) == 1)
+			{
+				getsockopt(sock, SOL_SOCKET, SO_ERROR, &err, &len);
+			}
+			rval = err ? -1 : 0;
+			errno = err;
+		}
+		if (rval < 0)
+		{
+			Logger::getLogger()->warn("Unable to connect to the edge receiver %s:%d, %s",
+					host.c_str(), port, strerror(errno));
+			close(sock);
+			sock = -1;
+			continue;
+		}
+		fcntl(sock, F_SETFL, flags);
+	}
+	freeaddrinfo(addrs);
+	if (sock == -1)
+	{
+		return NULL;
+	}
+	int one = 1;
+	setsockopt(sock, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+
+	SSL *ssl = NULL;
+	if (ctx)
+	{
+		struct timeval tv = { timeout / 1000, (timeout % 1000) * 1000 };
+		setsockopt(sock, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+		ssl = SSL_new(ctx);
+		SSL_set_fd(ssl, sock);
+		SSL_set_tlsext_host_name(ssl, host.c_str());
+		SSL_set1_host(ssl, host.c_str());
+		if (SSL_connect(ssl) != 1)
+		{
+			Logger::getLogger()->warn("TLS handshake with the edge receiver %s failed: %s",
+					host.c_str(), sslError().c_str());
+			SSL_free(ssl);
+			close(sock);
+			return NULL;
+		}
+		tv = { 0, 0 };
+		setsockopt(sock, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+	}
+	return new EdgeLink(sock, ssl);
+}
+
+/**
+ * Accept the connection of a sender
+ *
+ * @param listen	The listening socket
+ * @param ctx		The TLS context, NULL for plain TCP
+ * @param timeout	Milliseconds to wait for a connection
+ * @return EdgeLink*	The link or NULL if no sender has connected
+ */
+EdgeLink *EdgeLink::accept(int listen, SSL_CTX *ctx, int timeout)
+{
+	struct pollfd fds;
+	fds.fd = listen;
+	fds.events = POLLIN;
+	if (poll(&fds, 1, timeout) != 1)
+	{
+		return NULL;
+	}
+	int sock = ::accept(listen, NULL, NULL);
+	if (sock < 0)
+	{
+		return NULL;
+	}
+	int one = 1;
+	setsockopt(sock, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+	SSL *ssl = NULL;
+	if (ctx)
+	{
+		struct timeval tv = { 10, 0 };
+		setsockopt(sock, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+		ssl = SSL_new(ctx);
+		SSL_set_fd(ssl, sock);
+		if (SSL_accept(ssl) != 1)
+		{
+			Logger::getLogger()->warn("TLS handshake with an edge sender failed: %s",
+					sslError().c_str());
+			SSL_free(ssl);
+			close(sock);
+			return NULL;
+		}
+		tv = { 0, 0 };
+		setsockopt(sock, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+	}
+	return new EdgeLink(sock, ssl);
+}
+
+/**
+ * Write all of a buffer to the link
+ *
+ * @param buffer	The data to write
+ * @param length	The length of the data
+ * @return bool		False if the link has failed
+ */
+bool EdgeLink::write(const void *buffer, size_t length)
+{
+	const char *p = (const char *)buffer;
+	while (length)
+	{
+		ssize_t n;
+		if (m_ssl)
+		{
+			n = SSL_write(m_ssl, p, length);
+		}
+		else
+		{
+			n = send(m_socket, p, length, MSG_NOSIGNAL);
+			if (n < 0 && errno == EINTR)
+				continue;
+		}
+		if (n <= 0)
+		{
+			return false;
+		}
+		p += n;
+		length -= n;
+	}
+	return true;
+}
+
+/**
+ * Read a number of bytes from the link
+ *
+ * @param buffer	The buffer to read into
+ * @param length	The number of bytes to read
+ * @return bool		False if the link has failed or been closed
+ */
+bool EdgeLink::read(void *buffer, size_t length)
+{
+	char *p = (char *)buffer;
+	while (length)
+	{
+		ssize_t n;
+		if (m_ssl)
+		{
+			n = SSL_read(m_ssl, p, length);
+		}
+		else
+		{
+			n = recv(m_socket, p, length, 0);
+			if (n < 0 && errno == EINTR)
+				continue;
+		}
+		if (n <= 0)
+		{
+			return false;
+		}
+		p += n;
+		length -= n;
+	}
+	return true;
+}
+
+/**
+ * Wait for data to be available on the link
+ *
+ * @param timeout	Milliseconds to wait
+ * @return int		Positive if data is available, 0 on timeout, negative on failure
+ */
+int EdgeLink::wait(int timeout)
+{
+	if (m_ssl && SSL_pending(m_ssl) > 0)
+	{
+		return 1;
+	}
+	struct pollfd fds;
+	fds.fd = m_socket;
+	fds.events = POLLIN;
+	int rval = poll(&fds, 1, timeout);
+	if (rval < 0 && errno == EINTR)
+	{
+		return 0;
+	}
+	return rval;
+}
+
+/**
+ * Encode a block of readings
+ *
+ * @param blockNumber	The number of the block
+ * @param first		The first reading of the block
+ * @param last		The reading after the last reading of the block
+ * @param compress	Compress the block
+ * @param block		Set to the block to send
+ */
+void EdgeLink::encodeBlock(uint32_t blockNumber, vector<Reading *>::const_iterator first,
+			vector<Reading *>::const_iterator last, bool compress, string& block)
+{
+	string raw;
+	string payload;
+	RDSBlockHeader hdr;
+	hdr.magic = RDS_BLOCK_MAGIC;
+	hdr.blockNumber = blockNumber;
+	hdr.count = last - first;
+	raw.append((const char *)&hdr, sizeof(hdr));
+	for (auto it = first; it != last; ++it)
+	{
+		Reading *reading = *it;
+		const string& asset = reading->getAssetName();
+		ReadingStreamPayload::encode(*reading, payload);
+		RDSFetchReadingHeader rhdr;
+		rhdr.magic = RDS_FETCH_READING_MAGIC;
+		rhdr.assetLength = asset.length();
+		rhdr.payloadLength = payload.length();
+		rhdr.reserved = RDS_PAYLOAD_BINARY;
+		rhdr.id = reading->getId();
+		reading->getUserTimestamp(&rhdr.userTs);
+		reading->getTimestamp(&rhdr.ts);
+		raw.append((const char *)&rhdr, sizeof(rhdr));
+		raw.append(asset);
+		raw.append(payload);
+	}
+	if (!compress)
+	{
+		block.swap(raw);
+		return;
+	}
+	uLongf length = compressBound(raw.length());
+	block.resize(sizeof(RDSCompressedHeader) + length);
+	if (compress2((Bytef *)&block[sizeof(RDSCompressedHeader)], &length,
+			(const Bytef *)raw.data(), raw.length(), EDGE_ZLIB_LEVEL) != Z_OK)
+	{
+		block.swap(raw);
+		return;
+	}
+	RDSCompressedHeader chdr;
+	chdr.magic = RDS_ZLIB_BLOCK_MAGIC;
+	chdr.length = length;
+	chdr.rawLength = raw.length();
+	memcpy(&block[0], &chdr, sizeof(chdr));
+	block.resize(sizeof(RDSCompressedHeader) + length);
+}
+
+/**
+ * Read the next part of a block, from the inflated block if it was
+ * compressed or otherwise from the link
+ */
+bool EdgeLink::take(void *buffer, size_t length)
+{
+	if (!m_fromBuffer)
+	{
+		return read(buffer, length);
+	}
+	if (m_offset + length > m_inflated.length())
+	{
+		return false;
+	}
+	memcpy(buffer, m_inflated.data() + m_offset, length);
+	m_offset += length;
+	return true;
+}
+
+/**
+ * Read a block of readings from the link, compressed or not
+ *
+ * @param blockNumber	Set to the number of the block
+ * @param readings	The readings of the block are appended, the caller owns them
+ * @return bool		False if the link has failed or the block is not valid
+ */
+bool EdgeLink::readBlock(uint32_t& blockNumber, vector<Reading *>& readings)
+{
+	uint32_t magic;
+	m_fromBuffer = false;
+	if (!read(&magic, sizeof(magic)))
+	{
+		return false;
+	}
+	RDSBlockHeader hdr;
+	if (magic == RDS_ZLIB_BLOCK_MAGIC)
+	{
+		RDSCompressedHeader chdr;
+		chdr.magic = magic;
+		if (!read((char *)&chdr + sizeof(magic), sizeof(chdr) - sizeof(magic)))
+		{
+			return false;
+		}
+		if (chdr.length > EDGE_MAX_BLOCK || chdr.rawLength > EDGE_MAX_BLOCK)
+		{
+			Logger::getLogger()->error("Edge link block of %u bytes is too large", chdr.rawLength);
+			return false;
+		}
+		string compressed;
+		compressed.resize(chdr.length);
+		if (!read(&compressed[0], chdr.length))
+		{
+			return false;
+		}
+		m_inflated.resize(chdr.rawLength);
+		uLongf length = chdr.rawLength;
+		if (uncompress((Bytef *)&m_inflated[0], &length, (const Bytef *)compressed.data(),
+				compressed.length()) != Z_OK || length != chdr.rawLength)
+		{
+			Logger::getLogger()->error("Unable to inflate an edge link block");
+			return false;
+		}
+		m_fromBuffer = true;
+		m_offset = 0;
+		if (!take(&hdr, sizeof(hdr)))
+		{
+			return false;
+		}
+	}
+	else
+	{
+		hdr.magic = magic;
+		if (!read((char *)&hdr + sizeof(magic), sizeof(hdr) - sizeof(magic)))
+		{
+			return false;
+		}
+	}
+	if (hdr.magic != RDS_BLOCK_MAGIC)
+	{
+		Logger::getLogger()->error("Invalid block header 0x%x on the edge link", hdr.magic);
+		return false;
+	}
+	blockNumber = hdr.blockNumber;
+
+	for (uint32_t i = 0; i < hdr.count; i++)
+	{
+		RDSFetchReadingHeader rhdr;
+		if (!take(&rhdr, sizeof(rhdr)))
+		{
+			return false;
+		}
+		if (rhdr.magic != RDS_FETCH_READING_MAGIC || rhdr.reserved != RDS_PAYLOAD_BINARY
+				|| rhdr.assetLength > EDGE_MAX_BLOCK || rhdr.payloadLength > EDGE_MAX_BLOCK)
+		{
+			Logger::getLogger()->error("Invalid reading header on the edge link");
+			return false;
+		}
+		m_asset.resize(rhdr.assetLength);
+		m_payload.resize(rhdr.payloadLength);
+		if (!take(&m_asset[0], rhdr.assetLength) || !take(&m_payload[0], rhdr.payloadLength))
+		{
+			return false;
+		}
+		vector<Datapoint *> datapoints;
+		if (!ReadingStreamPayload::decode(m_payload.data(), rhdr.payloadLength, datapoints))
+		{
+			Logger::getLogger()->error("Unable to decode a reading of %s from the edge link",
+					m_asset.c_str());
+			for (auto dp : datapoints)
+				delete dp;
+			return false;
+		}
+		Reading *reading = new Reading(m_asset, datapoints);
+		reading->setId(rhdr.id);
+		reading->setUserTimestamp(rhdr.userTs);
+		reading->setTimestamp(rhdr.ts);
+		readings.push_back(reading);
+	}
+	m_inflated.clear();
+	return true;
+}
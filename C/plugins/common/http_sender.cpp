@@ -25,3 +25,101 @@ HttpSender::HttpSender()
 HttpSender::~HttpSender()
 {
 }
+
+/**
+ * Construct the stream buffer over the segments of a payload
+ *
+ * @param segments	The segments, which must outlive the buffer
+ */
+SegmentsBuffer::SegmentsBuffer(const vector<string>& segments) :
+	m_segments(segments), m_segment(0), m_start(0), m_length(0)
+{
+	for (auto& segment : segments)
+	{
+		m_length += segment.length();
+	}
+	setSegment(0, 0);
+}
+
+/**
+ * Make a segment the get area of the buffer
+ *
+ * @param segment	The index of the segment
+ * @param offset	The offset within the segment to read from
+ */
+void SegmentsBuffer::setSegment(size_t segment, size_t offset)
+{
+	m_segment = segment;
+	if (segment < m_segments.size())
+	{
+		// The get area is only read, the segment is never modified
+		char *data = const_cast<char *>(m_segments[segment].data());
+		setg(data, data + offset, data + m_segments[segment].length());
+	}
+	else
+	{
+		setg(NULL, NULL, NULL);
+	}
+}
+
+/**
+ * Move to the next segment that is not empty once the current one
+ * has been read
+ *
+ * @return	The next character or eof at the end of the payload
+ */
+SegmentsBuffer::int_type SegmentsBuffer::underflow()
+{
+	while (gptr() == egptr())
+	{
+		if (m_segment >= m_segments.size())
+		{
+			return traits_type::eof();
+		}
+		m_start += m_segments[m_segment].length();
+		setSegment(m_segment + 1, 0);
+	}
+	return traits_type::to_int_type(*gptr());
+}
+
+/**
+ * Seek relative to the start, the end or the current position
+ */
+SegmentsBuffer::pos_type SegmentsBuffer::seekoff(off_type off, ios_base::seekdir dir,
+						ios_base::openmode which)
+{
+	off_type base = 0;
+	if (dir == ios_base::cur)
+	{
+		base = (off_type)m_start + (gptr() - eback());
+	}
+	else if (dir == ios_base::end)
+	{
+		base = (off_type)m_length;
+	}
+	return seekpos(pos_type(base + off), which);
+}
+
+/**
+ * Seek to a position in the payload
+ */
+SegmentsBuffer::pos_type SegmentsBuffer::seekpos(pos_type pos, ios_base::openmode which)
+{
+	off_type position = pos;
+	if (!(which & ios_base::in) || position < 0 || (size_t)position > m_length)
+	{
+		return pos_type(off_type(-1));
+	}
+	size_t remaining = (size_t)position;
+	size_t segment = 0;
+	m_start = 0;
+	while (segment < m_segments.size() && remaining >= m_segments[segment].length()
+			&& segment + 1 < m_segments.size())
+	{
+		remaining -= m_segments[segment].length();
+		m_start += m_segments[segment].length();
+		segment++;
+	}
+	setSegment(segment, remaining);
+	return pos;
+}
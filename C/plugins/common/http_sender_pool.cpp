@@ -0,0 +1,113 @@
+/*
+ * Fledge HTTP Sender pool.
+ *
+ * Copyright (c) 2026 Dianomic Systems
+ *
+ * Released under the Apache 2.0 Licence
+ *
+ * Author: agent
+ */
+
+#include <http_sender_pool.h>
+#include <vector>
+
+using namespace std;
+
+/**
+ * Construct a pool of senders
+ *
+ * @param factory	Function that creates a new sender for the host
+ * @param maxIdle	The maximum number of idle senders to retain
+ * @param idleTimeout	Seconds after which an idle sender is discarded
+ */
+HttpSenderPool::HttpSenderPool(Factory factory, unsigned int maxIdle,
+				unsigned int idleTimeout) :
+	m_factory(factory), m_maxIdle(maxIdle), m_idleTimeout(idleTimeout)
+{
+}
+
+/**
+ * Destroy the pool and the idle senders. All senders acquired
+ * must have been released before the pool is destroyed.
+ */
+HttpSenderPool::~HttpSenderPool()
+{
+	clear();
+}
+
+/**
+ * Acquire a sender, the most recently used idle sender is returned
+ * if there is one, otherwise a new sender is created.
+ *
+ * @return HttpSender*	The sender, to be returned with release
+ */
+HttpSender *HttpSenderPool::acquire()
+{
+	vector<HttpSender *> expired;
+	HttpSender *sender = NULL;
+	{
+		lock_guard<mutex> guard(m_mutex);
+		time_t now = time(0);
+		while (!m_idle.empty())
+		{
+			pair<HttpSender *, time_t> idle = m_idle.back();
+			m_idle.pop_back();
+			if (now - idle.second < (time_t)m_idleTimeout)
+			{
+				sender = idle.first;
+				break;
+			}
+			expired.push_back(idle.first);
+		}
+	}
+	for (auto& s : expired)
+	{
+		delete s;
+	}
+	if (!sender)
+	{
+		sender = m_factory();
+	}
+	return sender;
+}
+
+/**
+ * Return a sender to the pool
+ *
+ * @param sender	The sender acquired from the pool
+ * @param reuse		False if the sender should be discarded, for example
+ *			because the configuration of the host has changed
+ */
+void HttpSenderPool::release(HttpSender *sender, bool reuse)
+{
+	if (!sender)
+	{
+		return;
+	}
+	if (reuse)
+	{
+		lock_guard<mutex> guard(m_mutex);
+		if (m_idle.size() < m_maxIdle)
+		{
+			m_idle.push_back(make_pair(sender, time(0)));
+			return;
+		}
+	}
+	delete sender;
+}
+
+/**
+ * Discard all the idle senders
+ */
+void HttpSenderPool::clear()
+{
+	deque<pair<HttpSender *, time_t>> idle;
+	{
+		lock_guard<mutex> guard(m_mutex);
+		idle.swap(m_idle);
+	}
+	for (auto& s : idle)
+	{
+		delete s.first;
+	}
+}
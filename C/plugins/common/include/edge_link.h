@@ -0,0 +1,98 @@
+#ifndef _EDGE_LINK_H
+#define _EDGE_LINK_H
+/*
+ * Fledge edge to edge reading transport.
+ *
+ * Copyright (c) 2026 Dianomic Systems
+ *
+ * Released under the Apache 2.0 Licence
+ *
+ * Author: agent
+ */
+#include <string>
+#include <vector>
+#include <openssl/ssl.h>
+#include <reading_stream.h>
+
+class Reading;
+
+/**
+ * The edge link protocol, used by the edge north plugin to send readings
+ * to the edge south plugin of another Fledge instance over TCP, or TLS.
+ *
+ * The sender connects and sends an EdgeHello followed by its name and
+ * the shared key, neither null terminated. The receiver replies with an
+ * EdgeWelcome that carries the id of the last reading it has received
+ * from a sender of that name, readings up to that id are not sent again.
+ *
+ * The readings are then sent in blocks using the format of the fetch
+ * stream, see reading_stream.h: an RDSBlockHeader followed by count
+ * readings, each an RDSFetchReadingHeader, the asset code and the binary
+ * datapoint payload. The reserved field of the reading header holds the
+ * payload format, always RDS_PAYLOAD_BINARY. If EDGE_FLAG_ZLIB has been
+ * accepted each block is sent as an RDSCompressedHeader with
+ * RDS_ZLIB_BLOCK_MAGIC followed by the block compressed on its own.
+ *
+ * The receiver acknowledges each block with an RDSAcknowledge once its
+ * readings have been ingested, RDS_NACK_MAGIC if they were not. The
+ * sender has at most the configured window of blocks awaiting
+ * acknowledgement. As in the reading stream all values are in host
+ * byte order.
+ */
+#define EDGE_HELLO_MAGIC	0x45444748
+#define EDGE_WELCOME_MAGIC	0x45444757
+#define EDGE_PROTOCOL_VERSION	1
+#define EDGE_FLAG_ZLIB		0x0001		// Blocks are compressed
+#define EDGE_STATUS_OK		0
+#define EDGE_STATUS_REJECTED	1		// The key is not valid
+#define EDGE_MAX_BLOCK		(64 * 1024 * 1024)	// Largest block accepted
+#define EDGE_ZLIB_LEVEL		3
+
+typedef struct {
+	uint32_t	magic;
+	uint32_t	version;
+	uint32_t	flags;
+	uint16_t	nameLength;
+	uint16_t	keyLength;
+} EdgeHello;
+
+typedef struct {
+	uint32_t	magic;
+	uint32_t	version;
+	uint32_t	flags;		// The flags of the hello accepted by the receiver
+	uint32_t	status;
+	uint64_t	lastId;		// Last reading received from the sender, 0 if none
+} EdgeWelcome;
+
+/**
+ * A connection of the edge link protocol, over a socket or a TLS session
+ */
+class EdgeLink {
+	public:
+		EdgeLink(int socket, SSL *ssl);
+		~EdgeLink();
+		static SSL_CTX	*clientContext(const std::string& caFile);
+		static SSL_CTX	*serverContext(const std::string& certFile, const std::string& keyFile);
+		static EdgeLink	*connect(const std::string& host, unsigned short port,
+					SSL_CTX *ctx, int timeout);
+		static EdgeLink	*accept(int listen, SSL_CTX *ctx, int timeout);
+		bool		write(const void *buffer, size_t length);
+		bool		read(void *buffer, size_t length);
+		int		wait(int timeout);
+		static void	encodeBlock(uint32_t blockNumber,
+					std::vector<Reading *>::const_iterator first,
+					std::vector<Reading *>::const_iterator last,
+					bool compress, std::string& block);
+		bool		readBlock(uint32_t& blockNumber, std::vector<Reading *>& readings);
+	private:
+		bool		take(void *buffer, size_t length);
+		int		m_socket;
+		SSL		*m_ssl;
+		std::string	m_inflated;	// The block being decoded if it was compressed
+		size_t		m_offset;
+		bool		m_fromBuffer;
+		std::string	m_asset;
+		std::string	m_payload;
+};
+
+#endif
@@ -12,6 +12,7 @@
 
 #include <string>
 #include <vector>
+#include <streambuf>
 
 #define HTTP_SENDER_USER_AGENT     "Fledge http sender"
 #define HTTP_SENDER_DEFAULT_METHOD "GET"
@@ -43,6 +44,18 @@ class HttpSender
 				const std::string& payload = std::string()
 		) = 0;
 
+		/**
+		 * HTTP(S) request with a payload made of several segments,
+		 * the segments are sent in order as one payload without
+		 * being concatenated.
+		 */
+		virtual int sendRequestSegments(
+				const std::string& method,
+				const std::string& path,
+				const std::vector<std::pair<std::string, std::string>>& headers,
+				const std::vector<std::string>& segments
+		) = 0;
+
 		virtual std::string getHostPort() = 0;
 		virtual std::string getHTTPResponse() = 0;
 
@@ -58,6 +71,30 @@ class HttpSender
 
 };
 
+/**
+ * A read only stream buffer over the segments of a payload, so that
+ * the segments may be read as a single stream without copying them.
+ * Seeking is supported, the senders use it to find the length of the
+ * payload and to send it again.
+ */
+class SegmentsBuffer : public std::streambuf {
+	public:
+		SegmentsBuffer(const std::vector<std::string>& segments);
+	protected:
+		int_type	underflow();
+		pos_type	seekoff(off_type off, std::ios_base::seekdir dir,
+					std::ios_base::openmode which = std::ios_base::in);
+		pos_type	seekpos(pos_type pos,
+					std::ios_base::openmode which = std::ios_base::in);
+	private:
+		void		setSegment(size_t segment, size_t offset);
+	private:
+		const std::vector<std::string>&	m_segments;
+		size_t				m_segment;	// The segment in the get area
+		size_t				m_start;	// The position of the start of the segment
+		size_t				m_length;	// The length of the payload
+};
+
 /**
  * BadRequest exception
  */
@@ -0,0 +1,56 @@
+#ifndef _HTTP_SENDER_POOL_H
+#define _HTTP_SENDER_POOL_H
+/*
+ * Fledge HTTP Sender pool.
+ *
+ * Copyright (c) 2026 Dianomic Systems
+ *
+ * Released under the Apache 2.0 Licence
+ *
+ * Author: agent
+ */
+
+#include <http_sender.h>
+#include <deque>
+#include <mutex>
+#include <functional>
+#include <time.h>
+
+#define HTTP_POOL_MAX_IDLE	4	// Maximum number of idle senders retained
+#define HTTP_POOL_IDLE_TIMEOUT	60	// Seconds after which an idle sender is discarded
+
+/**
+ * A pool of HTTP senders for a single host. The senders, and the
+ * connections they keep alive, are retained across requests so that
+ * the connection and TLS handshake is not repeated. A sender is only
+ * used by one caller at a time, callers that need concurrent requests
+ * each acquire a sender of their own.
+ *
+ * Senders that have been idle for longer than the idle timeout are
+ * discarded rather than reused, the server is likely to have closed
+ * their connection.
+ */
+class HttpSenderPool
+{
+	public:
+		typedef std::function<HttpSender *()>	Factory;
+
+		HttpSenderPool(Factory factory,
+				unsigned int maxIdle = HTTP_POOL_MAX_IDLE,
+				unsigned int idleTimeout = HTTP_POOL_IDLE_TIMEOUT);
+		~HttpSenderPool();
+		HttpSender		*acquire();
+		void			release(HttpSender *sender, bool reuse = true);
+		void			clear();
+	private:
+		HttpSenderPool(const HttpSenderPool&) = delete;
+		HttpSenderPool&		operator=(const HttpSenderPool&) = delete;
+	private:
+		Factory			m_factory;
+		unsigned int		m_maxIdle;
+		unsigned int		m_idleTimeout;
+		std::mutex		m_mutex;
+		std::deque<std::pair<HttpSender *, time_t>>
+					m_idle;
+};
+#endif
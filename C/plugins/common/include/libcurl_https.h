@@ -49,6 +49,17 @@ public:
 		    const std::string& payload = std::string()
 	);
 
+    /**
+     * HTTP(S) request with a payload made of several segments,
+     * the segments are read by libcurl without being concatenated.
+     */
+    int sendRequestSegments(
+		    const std::string& method,
+		    const std::string& path,
+		    const std::vector<std::pair<std::string, std::string>>& headers,
+		    const std::vector<std::string>& segments
+	);
+
     void setAuthMethod          (std::string& authMethod)           {m_authMethod = authMethod; }
     void setAuthBasicCredentials(std::string& authBasicCredentials) {m_authBasicCredentials = authBasicCredentials; }
 
@@ -68,6 +79,13 @@ private:
 	LibcurlHttps&     operator=(LibcurlHttps const &);
 
     	void setLibCurlOptions(CURL *sender, const std::string& path, const vector<pair<std::string, std::string>>& headers);
+	int  performRequest(const std::string& method,
+			    const std::string& path,
+			    const std::vector<std::pair<std::string, std::string>>& headers,
+			    const std::string *payload,
+			    const std::vector<std::string> *segments);
+	static size_t cb_read_segments(char *buffer, size_t size, size_t nitems, void *userdata);
+	static int    cb_seek_segments(void *userdata, curl_off_t offset, int origin);
 
 private:
 	CURL               *m_sender;
@@ -80,6 +98,7 @@ private:
     	struct curl_slist  *m_chunk = NULL;
 	unsigned int        m_request_timeout;
 	unsigned int        m_connect_timeout;
+	std::string         m_proxy;
 
 	// OCS configurations
 	std::string	m_OCSNamespace;
@@ -89,6 +108,12 @@ private:
 	std::string	m_OCSToken;
 	std::ofstream	m_ofs;
 	bool		m_log;
+
+	// Position of libcurl in the segments of the payload being sent
+	const std::vector<std::string>
+			*m_segments;
+	size_t		m_segment;
+	size_t		m_segmentOffset;
 };
 
 #endif
@@ -11,6 +11,10 @@
  */
 
 #include <string>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <chrono>
 
 using namespace std;
 
@@ -20,6 +24,10 @@ using namespace std;
 #define RETRY_SLEEP_TIME  1
 #define MAX_RETRY         3
 
+#define TOKEN_REFRESH_MARGIN	60	// Seconds before its expiry a token is refreshed
+#define TOKEN_RETRY_INTERVAL	10	// Seconds between attempts to refresh a token after a failure
+#define TOKEN_DEFAULT_LIFETIME	3600	// Seconds a token is assumed to last if no expiry is given
+
 #define URL_RETRIEVE_TOKEN "/identity/connect/token"
 
 #define PAYLOAD_RETRIEVE_TOKEN "grant_type=client_credentials&client_id=CLIENT_ID_PLACEHOLDER&client_secret=CLIENT_SECRET_ID_PLACEHOLDER"
@@ -36,6 +44,38 @@ class OCS
 		~OCS();
 
 		string  retrieveToken(const string& clientId, const string& clientSecret);
+		string  retrieveToken(const string& clientId, const string& clientSecret, long& expiresIn);
 		string  extractToken(const string& response);
+		string  extractToken(const string& response, long& expiresIn);
+};
+
+/**
+ * A cached OCS authentication token. The token is refreshed by a
+ * background thread TOKEN_REFRESH_MARGIN seconds before it expires,
+ * so that the sending of data only waits for a token when the first
+ * one is retrieved.
+ */
+class OCSTokenCache
+{
+	public:
+		OCSTokenCache(const string& clientId, const string& clientSecret);
+		~OCSTokenCache();
+
+		string	getToken();
+	private:
+		bool	refresh(bool ifMissing = false);
+		void	refreshThread();
+
+	private:
+		const string		m_clientId;
+		const string		m_clientSecret;
+		string			m_token;
+		std::chrono::steady_clock::time_point
+					m_refreshAt;	// When the token should be refreshed
+		std::mutex		m_mutex;
+		std::mutex		m_refreshMutex;	// Serialises the requests for tokens
+		std::condition_variable	m_cv;
+		bool			m_shutdown;
+		std::thread		*m_thread;
 };
 #endif
@@ -49,6 +49,16 @@ class SimpleHttps: public HttpSender
 				const std::string& payload = std::string()
 		);
 
+		/**
+		 * HTTP(S) request with a payload made of several segments
+		 */
+		int sendRequestSegments(
+				const std::string& method,
+				const std::string& path,
+				const std::vector<std::pair<std::string, std::string>>& headers,
+				const std::vector<std::string>& segments
+		);
+
 		void setAuthMethod          (std::string& authMethod)           {m_authMethod = authMethod; }
 		void setAuthBasicCredentials(std::string& authBasicCredentials) {m_authBasicCredentials = authBasicCredentials; }
 
@@ -66,6 +76,11 @@ class SimpleHttps: public HttpSender
 		// Make private the copy constructor and operator=
 		SimpleHttps(const SimpleHttps&);
 		SimpleHttps&     operator=(SimpleHttps const &);
+		int		performRequest(const std::string& method,
+					const std::string& path,
+					const std::vector<std::pair<std::string, std::string>>& headers,
+					const std::string *payload,
+					const std::vector<std::string> *segments);
 	private:
 		std::string	    m_host_port;
 		HttpsClient	   *m_sender;
@@ -46,13 +46,24 @@ LibcurlHttps::LibcurlHttps(const string& host_port,
 			m_request_timeout(request_timeout),
 			m_host_port(host_port),
 			m_retry_sleep_time(retry_sleep_Time),
-			m_max_retry (max_retry)
+			m_max_retry (max_retry),
+			m_segments(NULL),
+			m_segment(0),
+			m_segmentOffset(0)
 {
 
 	if (curl_global_init(CURL_GLOBAL_DEFAULT) != 0)
 	{
 		Logger::getLogger()->error("libcurl_https - curl_global_init failed, the libcurl library cannot be initialized.");
 	}
+
+	// The handle is kept for the lifetime of the sender so that its
+	// connections are kept alive from one request to the next
+	m_sender = curl_easy_init();
+	if (!m_sender)
+	{
+		Logger::getLogger()->error("libcurl_https - curl_easy_init failed, the libcurl library cannot be initialized.");
+	}
 	char fname[180];
 	if (getenv("FLEDGE_DATA"))
 		snprintf(fname, sizeof(fname), "%s/omf.log", getenv("FLEDGE_DATA"));
@@ -78,6 +89,11 @@ LibcurlHttps::~LibcurlHttps()
 	{
 		m_ofs.close();
 	}
+	if (m_sender)
+	{
+		curl_easy_cleanup(m_sender);
+	}
+	curl_slist_free_all(m_chunk);
 	curl_global_cleanup();
 }
 
@@ -88,7 +104,7 @@ LibcurlHttps::~LibcurlHttps()
  */
 void LibcurlHttps::setProxy(const string& proxy)
 {
-	curl_easy_setopt(m_sender, CURLOPT_PROXY, proxy.c_str());
+	m_proxy = proxy;
 }
 
 /**
@@ -165,6 +181,11 @@ void LibcurlHttps::setLibCurlOptions(CURL *sender, const string& path, const vec
 {
 	string httpHeader;
 
+	// Reset the options of the previous request, the connections are retained
+	curl_easy_reset(m_sender);
+	curl_slist_free_all(m_chunk);
+	m_chunk = NULL;
+
 #if VERBOSE_LOG
 	curl_easy_setopt(m_sender, CURLOPT_VERBOSE, 1L);
 #else
@@ -216,6 +237,11 @@ void LibcurlHttps::setLibCurlOptions(CURL *sender, const string& path, const vec
 
 	curl_easy_setopt(m_sender, CURLOPT_URL, url.c_str());
 
+	if (!m_proxy.empty())
+	{
+		curl_easy_setopt(m_sender, CURLOPT_PROXY, m_proxy.c_str());
+	}
+
 	// Setup SSL
 	curl_easy_setopt(m_sender, CURLOPT_USE_SSL, CURLUSESSL_ALL);
 	curl_easy_setopt(m_sender, CURLOPT_SSL_VERIFYPEER, 0L);
@@ -244,6 +270,125 @@ int LibcurlHttps::sendRequest(
 		const vector<pair<string, string>>& headers,
 		const string& payload
 )
+{
+	return performRequest(method, path, headers, &payload, NULL);
+}
+
+/**
+ * Send data whose payload is made of several segments, the segments
+ * are read in order by libcurl so they are never concatenated. A
+ * single segment is sent as the payload.
+ * It retries the operation as sendRequest does.
+ *
+ * @param method    The HTTP method (GET, POST, ...)
+ * @param path      The URL path
+ * @param headers   The headers to send
+ * @param segments  The segments of the data payload
+ * @return          The HTTP code, as for sendRequest
+ * @throw	    BadRequest for HTTP 400 error
+ *		    std::exception as generic exception for all the
+ *		    cases >= 401 Client errors / 5xx Server errors
+ */
+int LibcurlHttps::sendRequestSegments(
+		const string& method,
+		const string& path,
+		const vector<pair<string, string>>& headers,
+		const vector<string>& segments
+)
+{
+	if (segments.size() == 1)
+	{
+		return performRequest(method, path, headers, &segments[0], NULL);
+	}
+	return performRequest(method, path, headers, NULL, &segments);
+}
+
+/**
+ * Read callback of libcurl, copies the next part of the segments
+ * of the payload into the buffer of libcurl
+ *
+ * @param buffer	The buffer to fill
+ * @param size		(nitems * size) is the size of 'buffer'
+ * @param nitems
+ * @param userdata	The LibcurlHttps sending the segments
+ * @return		The number of bytes copied, 0 at the end of the payload
+ */
+size_t LibcurlHttps::cb_read_segments(char *buffer, size_t size, size_t nitems, void *userdata)
+{
+	LibcurlHttps *sender = (LibcurlHttps *) userdata;
+	size_t room = size * nitems;
+	size_t copied = 0;
+
+	while (copied < room && sender->m_segment < sender->m_segments->size())
+	{
+		const string& segment = (*sender->m_segments)[sender->m_segment];
+		size_t n = min(room - copied, segment.length() - sender->m_segmentOffset);
+		memcpy(buffer + copied, segment.data() + sender->m_segmentOffset, n);
+		copied += n;
+		sender->m_segmentOffset += n;
+		if (sender->m_segmentOffset >= segment.length())
+		{
+			sender->m_segment++;
+			sender->m_segmentOffset = 0;
+		}
+	}
+	return copied;
+}
+
+/**
+ * Seek callback of libcurl, moves the position in the segments of the
+ * payload when libcurl has to send the payload again, for example
+ * during the authentication
+ *
+ * @param userdata	The LibcurlHttps sending the segments
+ * @param offset	The offset to move to
+ * @param origin	Only SEEK_SET is supported
+ * @return		CURL_SEEKFUNC_OK or CURL_SEEKFUNC_CANTSEEK
+ */
+int LibcurlHttps::cb_seek_segments(void *userdata, curl_off_t offset, int origin)
+{
+	LibcurlHttps *sender = (LibcurlHttps *) userdata;
+
+	if (origin != SEEK_SET || offset < 0)
+	{
+		return CURL_SEEKFUNC_CANTSEEK;
+	}
+	sender->m_segment = 0;
+	sender->m_segmentOffset = 0;
+	size_t remaining = (size_t) offset;
+	while (sender->m_segment < sender->m_segments->size())
+	{
+		size_t length = (*sender->m_segments)[sender->m_segment].length();
+		if (remaining < length)
+		{
+			sender->m_segmentOffset = remaining;
+			return CURL_SEEKFUNC_OK;
+		}
+		remaining -= length;
+		sender->m_segment++;
+	}
+	return remaining == 0 ? CURL_SEEKFUNC_OK : CURL_SEEKFUNC_CANTSEEK;
+}
+
+/**
+ * Execute a request with either a single payload or a payload made
+ * of segments, it retries the operation m_max_retry times
+ * waiting m_retry_sleep_time*2 at each attempt
+ *
+ * @param method    The HTTP method (GET, POST, ...)
+ * @param path      The URL path
+ * @param headers   The headers to send
+ * @param payload   The data payload or NULL
+ * @param segments  The segments of the data payload or NULL
+ * @return          The HTTP code
+ */
+int LibcurlHttps::performRequest(
+		const string& method,
+		const string& path,
+		const vector<pair<string, string>>& headers,
+		const string *payload,
+		const vector<string> *segments
+)
 {
 	// Variables definition
 	long   httpCode = 0;
@@ -265,8 +410,7 @@ int LibcurlHttps::sendRequest(
 	string exceptionMessage;
 	string errorMessage;
 
-	// Init libcurl
-	m_sender = curl_easy_init();
+	// Set the options of the request on the retained handle
 	if(m_sender)
 	{
 		setLibCurlOptions(m_sender, path, headers);
@@ -284,8 +428,24 @@ int LibcurlHttps::sendRequest(
 	{
 		curl_easy_setopt(m_sender, CURLOPT_POST, 1L);
 
-		curl_easy_setopt(m_sender, CURLOPT_POSTFIELDS,           payload.c_str());
-		curl_easy_setopt(m_sender, CURLOPT_POSTFIELDSIZE, (long) payload.length());
+		if (segments)
+		{
+			curl_off_t length = 0;
+			for (auto& segment : *segments)
+			{
+				length += segment.length();
+			}
+			curl_easy_setopt(m_sender, CURLOPT_READFUNCTION, cb_read_segments);
+			curl_easy_setopt(m_sender, CURLOPT_READDATA, this);
+			curl_easy_setopt(m_sender, CURLOPT_SEEKFUNCTION, cb_seek_segments);
+			curl_easy_setopt(m_sender, CURLOPT_SEEKDATA, this);
+			curl_easy_setopt(m_sender, CURLOPT_POSTFIELDSIZE_LARGE, length);
+		}
+		else
+		{
+			curl_easy_setopt(m_sender, CURLOPT_POSTFIELDS,           payload->c_str());
+			curl_easy_setopt(m_sender, CURLOPT_POSTFIELDSIZE, (long) payload->length());
+		}
 	}
 	else if (method.compare("GET") == 0)
 	{
@@ -333,9 +493,25 @@ int LibcurlHttps::sendRequest(
 					m_ofs << "    " << it->first << ": " << it->second << endl;
 				}
 				m_ofs << "Payload:" << endl;
-				m_ofs << payload << endl;
+				if (segments)
+				{
+					for (auto& segment : *segments)
+					{
+						m_ofs << segment;
+					}
+					m_ofs << endl;
+				}
+				else
+				{
+					m_ofs << *payload << endl;
+				}
 			}
 
+			// Each attempt reads the segments from the start
+			m_segments = segments;
+			m_segment = 0;
+			m_segmentOffset = 0;
+
 			// Execute the HTTP method
 			res = curl_easy_perform(m_sender);
 
@@ -395,7 +571,7 @@ int LibcurlHttps::sendRequest(
 					"HTTPS sendRequest : retry count |%d| error |%s| message |%s|",
 					retryCount,
 					errorMessage.c_str(),
-					payload.c_str());
+					payload ? payload->c_str() : "");
 
 			}
 			else
@@ -405,7 +581,7 @@ int LibcurlHttps::sendRequest(
 					retryCount,
 					httpCode,
 					errorMessage.c_str(),
-					payload.c_str());
+					payload ? payload->c_str() : "");
 			}
 #endif
 
@@ -425,10 +601,8 @@ int LibcurlHttps::sendRequest(
 		}
 	} while (retry);
 
-	// Cleanup
-	curl_easy_cleanup(m_sender);
+	// Cleanup, the handle is retained for the next request
 	curl_slist_free_all(m_chunk);
-	m_sender = NULL;
 	m_chunk = NULL;
 
 	// Check if an error should be raised
@@ -12,6 +12,7 @@
 #include <string>
 #include <vector>
 #include <utility>
+#include <thread>
 
 #include <ocs.h>
 #include <string_utils.h>
@@ -40,10 +41,25 @@ OCS::~OCS()
  *
  */
 std::string OCS::extractToken(const string& response)
+{
+	long expiresIn;
+	return extractToken(response, expiresIn);
+}
+
+/**
+ * Extracts the OCS token and its lifetime from the JSON returned by the OCS api
+ *
+ * @param response  JSON message generated by the OCS API containing the OCS token
+ * @param expiresIn Set to the seconds for which the token is valid, 0 if not given
+ * @return          The OCS token to be used for authentication in API calls
+ *
+ */
+std::string OCS::extractToken(const string& response, long& expiresIn)
 {
 	Document JSon;
 	string token;
 
+	expiresIn = 0;
 	ParseResult ok = JSon.Parse(response.c_str());
 	if (!ok)
 	{
@@ -51,10 +67,14 @@ std::string OCS::extractToken(const string& response)
 	}
 	else
 	{
-		if (JSon.HasMember("access_token"))
+		if (JSon.HasMember("access_token") && JSon["access_token"].IsString())
 		{
 			token = JSon["access_token"].GetString();
 		}
+		if (JSon.HasMember("expires_in") && JSon["expires_in"].IsInt64())
+		{
+			expiresIn = JSon["expires_in"].GetInt64();
+		}
 	}
 
 	return(token);
@@ -69,6 +89,21 @@ std::string OCS::extractToken(const string& response)
  *
  */
 std::string OCS::retrieveToken(const string& clientId, const string& clientSecret)
+{
+	long expiresIn;
+	return retrieveToken(clientId, clientSecret, expiresIn);
+}
+
+/**
+ * Calls the OCS api to retrieve the authentication token related to the the clientId and clientSecret
+ *
+ * @param clientId      Client Id code assigned by OCS using its GUI to the specific connection
+ * @param clientSecret  Client Secret code assigned by OCS using its gui to the specific connection
+ * @param expiresIn     Set to the seconds for which the token is valid, 0 if not known
+ * @return              The OCS token to be used for authentication in API calls
+ *
+ */
+std::string OCS::retrieveToken(const string& clientId, const string& clientSecret, long& expiresIn)
 {
 	string token;
 	string response;
@@ -78,6 +113,7 @@ std::string OCS::retrieveToken(const string& clientId, const string& clientSecre
 	vector<pair<string, string>> header;
 	int httpCode;
 
+	expiresIn = 0;
 	endPoint = new SimpleHttps(OCS_HOST,
 							   TIMEOUT_CONNECT,
 							   TIMEOUT_REQUEST,
@@ -107,7 +143,7 @@ std::string OCS::retrieveToken(const string& clientId, const string& clientSecre
 
 		if (httpCode >= 200 && httpCode <= 399)
 		{
-			token = extractToken(response);
+			token = extractToken(response, expiresIn);
 			Logger::getLogger()->debug("OCS authentication token :%s:" ,token.c_str() );
 		}
 		else
@@ -124,4 +160,114 @@ std::string OCS::retrieveToken(const string& clientId, const string& clientSecre
 	delete endPoint;
 
 	return token;
-}
\ No newline at end of file
+}
+
+/**
+ * Create the cache of the token of an OCS connection and start the
+ * thread that refreshes it
+ *
+ * @param clientId      Client Id code assigned by OCS to the connection
+ * @param clientSecret  Client Secret code assigned by OCS to the connection
+ */
+OCSTokenCache::OCSTokenCache(const string& clientId, const string& clientSecret) :
+	m_clientId(clientId), m_clientSecret(clientSecret), m_shutdown(false)
+{
+	m_thread = new thread(&OCSTokenCache::refreshThread, this);
+}
+
+/**
+ * Stop the refresh thread
+ */
+OCSTokenCache::~OCSTokenCache()
+{
+	{
+		lock_guard<mutex> guard(m_mutex);
+		m_shutdown = true;
+		m_cv.notify_all();
+	}
+	m_thread->join();
+	delete m_thread;
+}
+
+/**
+ * Return the current token. The caller only waits for a token to be
+ * retrieved if there is none yet or the last one could not be refreshed
+ * before it expired.
+ *
+ * @return      The token, empty if none could be retrieved
+ */
+string OCSTokenCache::getToken()
+{
+	{
+		lock_guard<mutex> guard(m_mutex);
+		if (!m_token.empty())
+		{
+			return m_token;
+		}
+	}
+	refresh(true);
+	lock_guard<mutex> guard(m_mutex);
+	return m_token;
+}
+
+/**
+ * Retrieve a new token from OCS
+ *
+ * @param ifMissing	Only retrieve a token if there is none, as one
+ *			may have been retrieved whilst waiting for another request
+ * @return		True if a token was retrieved
+ */
+bool OCSTokenCache::refresh(bool ifMissing)
+{
+	lock_guard<mutex> refreshGuard(m_refreshMutex);
+	if (ifMissing)
+	{
+		lock_guard<mutex> guard(m_mutex);
+		if (!m_token.empty())
+		{
+			return true;
+		}
+	}
+	OCS ocs;
+	long expiresIn;
+	string token = ocs.retrieveToken(m_clientId, m_clientSecret, expiresIn);
+
+	lock_guard<mutex> guard(m_mutex);
+	auto now = chrono::steady_clock::now();
+	if (token.empty())
+	{
+		m_refreshAt = now + chrono::seconds(TOKEN_RETRY_INTERVAL);
+		m_cv.notify_all();
+		return false;
+	}
+	if (expiresIn <= 0)
+	{
+		expiresIn = TOKEN_DEFAULT_LIFETIME;
+	}
+	long refreshIn = expiresIn > 2 * TOKEN_REFRESH_MARGIN ? expiresIn - TOKEN_REFRESH_MARGIN : expiresIn / 2;
+	m_token = token;
+	m_refreshAt = now + chrono::seconds(refreshIn);
+	m_cv.notify_all();
+	Logger::getLogger()->debug("OCS authentication token refreshed, it expires in %ld seconds", expiresIn);
+	return true;
+}
+
+/**
+ * The thread that refreshes the token before it expires
+ */
+void OCSTokenCache::refreshThread()
+{
+	unique_lock<mutex> lck(m_mutex);
+	m_refreshAt = chrono::steady_clock::now();
+	while (!m_shutdown)
+	{
+		if (chrono::steady_clock::now() < m_refreshAt)
+		{
+			m_cv.wait_until(lck, m_refreshAt);
+			continue;
+		}
+		lck.unlock();
+		refresh();
+		lck.lock();
+	}
+}
@@ -80,7 +80,7 @@ SimpleHttp::~SimpleHttp()
  * @param path      The URL path
  * @param headers   The optional headers to send
  * @param payload   The optional data payload (for POST, PUT)
- * @return          The HTTP code on success or 0 on execptions
+ * @return          The HTTP code, as for performRequest
  */
 int SimpleHttp::sendRequest(
 		const string& method,
@@ -88,6 +88,53 @@ int SimpleHttp::sendRequest(
 		const vector<pair<string, string>>& headers,
 		const string& payload
 )
+{
+	return performRequest(method, path, headers, &payload, NULL);
+}
+
+/**
+ * Send data whose payload is made of several segments, the segments
+ * are streamed to the request rather than concatenated. A single
+ * segment is sent as the payload.
+ *
+ * @param method    The HTTP method (GET, POST, ...)
+ * @param path      The URL path
+ * @param headers   The headers to send
+ * @param segments  The segments of the data payload
+ * @return          The HTTP code, as for performRequest
+ */
+int SimpleHttp::sendRequestSegments(
+		const string& method,
+		const string& path,
+		const vector<pair<string, string>>& headers,
+		const vector<string>& segments
+)
+{
+	if (segments.size() == 1)
+	{
+		return performRequest(method, path, headers, &segments[0], NULL);
+	}
+	return performRequest(method, path, headers, NULL, &segments);
+}
+
+/**
+ * Execute a request with either a single payload or a payload made
+ * of segments
+ *
+ * @param method    The HTTP method (GET, POST, ...)
+ * @param path      The URL path
+ * @param headers   The optional headers to send
+ * @param payload   The data payload or NULL
+ * @param segments  The segments of the data payload or NULL
+ * @return          The HTTP code on success or 0 on execptions
+ */
+int SimpleHttp::performRequest(
+		const string& method,
+		const string& path,
+		const vector<pair<string, string>>& headers,
+		const string *payload,
+		const vector<string> *segments
+)
 {
 	SimpleWeb::CaseInsensitiveMultimap header;
 
@@ -140,11 +187,32 @@ int SimpleHttp::sendRequest(
 					m_ofs << "    " << it->first << ": " << it->second << endl;
 				}
 				m_ofs << "Payload:" << endl;
-				m_ofs << payload << endl;
+				if (payload)
+				{
+					m_ofs << *payload << endl;
+				}
+				else
+				{
+					for (auto& segment : *segments)
+					{
+						m_ofs << segment;
+					}
+					m_ofs << endl;
+				}
 			}
 
 			// Call HTTPS method
-			auto res = m_sender->request(method, path, payload, header);
+			shared_ptr<HttpClient::Response> res;
+			if (payload)
+			{
+				res = m_sender->request(method, path, *payload, header);
+			}
+			else
+			{
+				SegmentsBuffer buffer(*segments);
+				istream content(&buffer);
+				res = m_sender->request(method, path, content, header);
+			}
 
 			retCode = res->status_code;
 			response = res->content.string();
@@ -187,7 +255,7 @@ int SimpleHttp::sendRequest(
 			Logger::getLogger()->info("HTTP sendRequest succeeded : retry count |%d| HTTP code |%d| message |%s|",
 						  retry_count,
 						  http_code,
-						  payload.c_str());
+						  payload ? payload->c_str() : "");
 #endif
 		}
 		else
@@ -199,7 +267,7 @@ int SimpleHttp::sendRequest(
 					"HTTP sendRequest : retry count |%d| error |%s| message |%s|",
 					retry_count,
 					exception_message.c_str(),
-					payload.c_str());
+					payload ? payload->c_str() : "");
 
 			}
 			else
@@ -209,7 +277,7 @@ int SimpleHttp::sendRequest(
 					retry_count,
 					http_code,
 					response.c_str(),
-					payload.c_str());
+					payload ? payload->c_str() : "");
 			}
 #endif
 
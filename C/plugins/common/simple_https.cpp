@@ -76,22 +76,69 @@ void SimpleHttps::setProxy(const string& proxy)
 }
 
 /**
- * Send data, it retries the operation m_max_retry times
- * waiting m_retry_sleep_time*2 at each attempt
+ * Send data
  *
  * @param method    The HTTP method (GET, POST, ...)
  * @param path      The URL path
  * @param headers   The optional headers to send
  * @param payload   The optional data payload (for POST, PUT)
+ * @return          The HTTP code, as for performRequest
+ */
+int SimpleHttps::sendRequest(
+		const string& method,
+		const string& path,
+		const vector<pair<string, string>>& headers,
+		const string& payload
+)
+{
+	return performRequest(method, path, headers, &payload, NULL);
+}
+
+/**
+ * Send data whose payload is made of several segments, the segments
+ * are streamed to the request rather than concatenated. A single
+ * segment is sent as the payload.
+ *
+ * @param method    The HTTP method (GET, POST, ...)
+ * @param path      The URL path
+ * @param headers   The headers to send
+ * @param segments  The segments of the data payload
+ * @return          The HTTP code, as for performRequest
+ */
+int SimpleHttps::sendRequestSegments(
+		const string& method,
+		const string& path,
+		const vector<pair<string, string>>& headers,
+		const vector<string>& segments
+)
+{
+	if (segments.size() == 1)
+	{
+		return performRequest(method, path, headers, &segments[0], NULL);
+	}
+	return performRequest(method, path, headers, NULL, &segments);
+}
+
+/**
+ * Execute a request with either a single payload or a payload made
+ * of segments, it retries the operation m_max_retry times
+ * waiting m_retry_sleep_time*2 at each attempt
+ *
+ * @param method    The HTTP method (GET, POST, ...)
+ * @param path      The URL path
+ * @param headers   The optional headers to send
+ * @param payload   The data payload or NULL
+ * @param segments  The segments of the data payload or NULL
  * @return          The HTTP code for the cases : 1xx Informational / 2xx Success / 3xx Redirection
  * @throw	    BadRequest for HTTP 400 error
  *		    std::exception as generic exception for all the cases >= 401 Client errors / 5xx Server errors
  */
-int SimpleHttps::sendRequest(
+int SimpleHttps::performRequest(
 		const string& method,
 		const string& path,
 		const vector<pair<string, string>>& headers,
-		const string& payload
+		const string *payload,
+		const vector<string> *segments
 )
 {
 	SimpleWeb::CaseInsensitiveMultimap header;
@@ -150,11 +197,32 @@ int SimpleHttps::sendRequest(
 					m_ofs << "    " << it->first << ": " << it->second << endl;
 				}
 				m_ofs << "Payload:" << endl;
-				m_ofs << payload << endl;
+				if (payload)
+				{
+					m_ofs << *payload << endl;
+				}
+				else
+				{
+					for (auto& segment : *segments)
+					{
+						m_ofs << segment;
+					}
+					m_ofs << endl;
+				}
 			}
 
 			// Call HTTPS method
-			auto res = m_sender->request(method, path, payload, header);
+			shared_ptr<HttpsClient::Response> res;
+			if (payload)
+			{
+				res = m_sender->request(method, path, *payload, header);
+			}
+			else
+			{
+				SegmentsBuffer buffer(*segments);
+				istream content(&buffer);
+				res = m_sender->request(method, path, content, header);
+			}
 
 			retCode = res->status_code;
 			response = res->content.string();
@@ -195,7 +263,7 @@ int SimpleHttps::sendRequest(
 			Logger::getLogger()->info("HTTPS sendRequest succeeded : retry count |%d| HTTP code |%d| message |%s|",
 						  retry_count,
 						  http_code,
-						  payload.c_str());
+						  payload ? payload->c_str() : "");
 #endif
 		}
 		else
@@ -207,7 +275,7 @@ int SimpleHttps::sendRequest(
 					"HTTPS sendRequest : retry count |%d| error |%s| message |%s|",
 					retry_count,
 					exception_message.c_str(),
-					payload.c_str());
+					payload ? payload->c_str() : "");
 
 			}
 			else
@@ -217,7 +285,7 @@ int SimpleHttps::sendRequest(
 					retry_count,
 					http_code,
 					response.c_str(),
-					payload.c_str());
+					payload ? payload->c_str() : "");
 			}
 #endif
 
@@ -0,0 +1,197 @@
+/*
+ * Fledge OSI Soft OMF interface to PI Server.
+ *
+ * Copyright (c) 2026 Dianomic Systems
+ *
+ * Released under the Apache 2.0 Licence
+ *
+ * Author: agent
+ */
+#include <gzip_writer.h>
+#include <cstring>
+#include <sstream>
+#include <stdexcept>
+
+using namespace std;
+
+/**
+ * Construct a gzip writer
+ *
+ * @param level		The zlib compression level
+ * @param threaded	Compress on a thread of the writer
+ */
+GzipWriter::GzipWriter(int level, bool threaded) : m_inputLength(0),
+	m_finished(false), m_thread(NULL), m_end(false)
+{
+	const int windowBits = 15;
+	const int GZIP_ENCODING = 16;
+
+	memset(&m_zs, 0, sizeof(m_zs));
+	if (deflateInit2(&m_zs, level, Z_DEFLATED,
+			windowBits | GZIP_ENCODING, 8,
+			Z_DEFAULT_STRATEGY) != Z_OK)
+	{
+		throw runtime_error("deflateInit failed while compressing.");
+	}
+	if (threaded)
+	{
+		m_thread = new thread(&GzipWriter::compressThread, this);
+	}
+}
+
+/**
+ * Destroy the gzip writer, stopping the compression thread if
+ * finish has not been called
+ */
+GzipWriter::~GzipWriter()
+{
+	if (m_thread)
+	{
+		{
+			lock_guard<mutex> guard(m_mutex);
+			m_end = true;
+			m_queue.clear();
+		}
+		m_cv.notify_all();
+		m_thread->join();
+		delete m_thread;
+	}
+	deflateEnd(&m_zs);
+}
+
+/**
+ * Write a piece of the payload to the compressor
+ *
+ * @param data	The piece of the payload
+ */
+void GzipWriter::write(const string& data)
+{
+	if (m_thread)
+	{
+		write(string(data));
+		return;
+	}
+	m_inputLength += data.length();
+	compress(data.data(), data.length(), Z_NO_FLUSH);
+}
+
+/**
+ * Write a piece of the payload to the compressor. When compressing on
+ * a thread the piece is queued without being copied, the caller waits
+ * if the thread has fallen GZIP_WRITER_QUEUE pieces behind.
+ *
+ * @param data	The piece of the payload
+ */
+void GzipWriter::write(string&& data)
+{
+	m_inputLength += data.length();
+	if (!m_thread)
+	{
+		compress(data.data(), data.length(), Z_NO_FLUSH);
+		return;
+	}
+	unique_lock<mutex> lck(m_mutex);
+	m_cv.wait(lck, [this]{ return m_queue.size() < GZIP_WRITER_QUEUE; });
+	m_queue.push_back(move(data));
+	m_cv.notify_all();
+}
+
+/**
+ * Complete the compression of the payload
+ *
+ * @return	The gzip compressed payload
+ * @throw	runtime_error if the compression failed
+ */
+const string& GzipWriter::finish()
+{
+	if (m_finished)
+	{
+		return m_output;
+	}
+	if (m_thread)
+	{
+		{
+			lock_guard<mutex> guard(m_mutex);
+			m_end = true;
+		}
+		m_cv.notify_all();
+		m_thread->join();
+		delete m_thread;
+		m_thread = NULL;
+		if (!m_error.empty())
+		{
+			throw runtime_error(m_error);
+		}
+	}
+	compress(NULL, 0, Z_FINISH);
+	m_finished = true;
+	return m_output;
+}
+
+/**
+ * Pass data through the compressor and append the compressed data
+ * that is available to the output
+ *
+ * @param data		The data to compress
+ * @param length	The length of the data
+ * @param flush		The zlib flush mode
+ */
+void GzipWriter::compress(const char *data, size_t length, int flush)
+{
+	char buffer[GZIP_WRITER_BUFFER];
+	int ret;
+
+	m_zs.next_in = (Bytef *)data;
+	m_zs.avail_in = length;
+	do {
+		m_zs.next_out = reinterpret_cast<Bytef *>(buffer);
+		m_zs.avail_out = sizeof(buffer);
+		ret = deflate(&m_zs, flush);
+		if (ret == Z_STREAM_ERROR)
+		{
+			break;
+		}
+		m_output.append(buffer, sizeof(buffer) - m_zs.avail_out);
+	} while (m_zs.avail_out == 0);
+
+	if (ret == Z_STREAM_ERROR || (flush == Z_FINISH && ret != Z_STREAM_END))
+	{
+		ostringstream oss;
+		oss << "Exception during zlib compression: (" << ret << ") " << (m_zs.msg ? m_zs.msg : "");
+		throw runtime_error(oss.str());
+	}
+}
+
+/**
+ * The compression thread, compresses the queued pieces of the
+ * payload until finish is called
+ */
+void GzipWriter::compressThread()
+{
+	unique_lock<mutex> lck(m_mutex);
+	while (true)
+	{
+		m_cv.wait(lck, [this]{ return m_end || !m_queue.empty(); });
+		if (m_queue.empty())
+		{
+			break;
+		}
+		string data = move(m_queue.front());
+		m_queue.pop_front();
+		m_cv.notify_all();
+		if (!m_error.empty())
+		{
+			// Discard the remaining data following an error
+			continue;
+		}
+		lck.unlock();
+		try {
+			compress(data.data(), data.length(), Z_NO_FLUSH);
+		} catch (exception& e) {
+			lck.lock();
+			m_error = e.what();
+			continue;
+		}
+		lck.lock();
+	}
+}
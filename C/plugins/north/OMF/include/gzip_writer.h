@@ -0,0 +1,56 @@
+#ifndef _GZIP_WRITER_H
+#define _GZIP_WRITER_H
+/*
+ * Fledge OSI Soft OMF interface to PI Server.
+ *
+ * Copyright (c) 2026 Dianomic Systems
+ *
+ * Released under the Apache 2.0 Licence
+ *
+ * Author: agent
+ */
+#include <string>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <zlib.h>
+
+#define GZIP_WRITER_BUFFER	32768	// Size of the buffer the compressed data is retrieved in
+#define GZIP_WRITER_QUEUE	4	// Maximum number of pieces waiting for the compression thread
+
+/**
+ * A streaming gzip compressor. The payload is written to the compressor
+ * in pieces as it is built, so the uncompressed payload never needs to
+ * exist in memory as a whole. Optionally the compression is done on a
+ * thread of its own, the pieces written are then queued for that thread
+ * and the writer may build the next piece whilst the previous one is
+ * being compressed.
+ */
+class GzipWriter {
+	public:
+		GzipWriter(int level = Z_DEFAULT_COMPRESSION, bool threaded = false);
+		~GzipWriter();
+		void			write(const std::string& data);
+		void			write(std::string&& data);
+		const std::string&	finish();
+		size_t			inputLength() const { return m_inputLength; };
+	private:
+		GzipWriter(const GzipWriter&) = delete;
+		GzipWriter&		operator=(const GzipWriter&) = delete;
+		void			compress(const char *data, size_t length, int flush);
+		void			compressThread();
+	private:
+		z_stream		m_zs;
+		std::string		m_output;
+		size_t			m_inputLength;
+		bool			m_finished;
+		std::thread		*m_thread;
+		std::mutex		m_mutex;
+		std::condition_variable	m_cv;
+		std::deque<std::string>	m_queue;
+		bool			m_end;
+		std::string		m_error;
+};
+
+#endif
@@ -12,8 +12,12 @@
 #include <string>
 #include <vector>
 #include <map>
+#include <memory>
+#include <unordered_map>
+#include <unordered_set>
 #include <reading.h>
 #include <http_sender.h>
+#include <omf_afpath.h>
 #include <zlib.h>
 #include <rapidjson/document.h>
 
@@ -75,6 +79,15 @@ class OMFDataTypes
 };
 
 class OMFHints;
+class OMFDataTemplate;
+
+// Per asset templates of the OMF data messages
+typedef std::unordered_map<std::string, std::shared_ptr<OMFDataTemplate>>
+		OMFDataTemplates;
+
+// Parsed OMF hints by the text of the hints
+typedef std::unordered_map<std::string, std::shared_ptr<OMFHints>>
+		OMFHintsCache;
 
 /**
  * The OMF class.
@@ -191,6 +204,25 @@ class OMF
 			m_staticData = staticData;
 		};
 
+		// Set the zlib level and threading of the payload compression
+		void setCompression(int level, bool threaded)
+		{
+			m_compressionLevel = level;
+			m_compressionThread = threaded;
+		};
+
+		// Keep the data message templates beyond the lifetime of this object
+		void setDataTemplates(OMFDataTemplates *templates)
+		{
+			m_dataTemplates = templates;
+		};
+
+		// Keep the parsed OMF hints beyond the lifetime of this object
+		void setHintsCache(OMFHintsCache *hints)
+		{
+			m_hintsCache = hints;
+		};
+
 		void generateAFHierarchyPrefixLevel(string& path, string& prefix, string& AFHierarchyLevel);
 
 		// Retrieve private objects
@@ -252,6 +284,15 @@ private:
 		// Send OMF data types
 		bool sendDataTypes(const Reading& row, OMFHints *hints);
 
+		// Queue the OMF data types in the batch of the block
+		bool queueDataTypes(const Reading& row, OMFHints *hints);
+
+		// Send the queued OMF data types as combined messages
+		bool flushDataTypes();
+		bool sendTypeBatchMessage(const std::string& msgType,
+					  const std::string& description,
+					  const std::string& messages);
+
 		// Get saved dataType
 		bool getCreatedTypes(const std::string& keyComplete, const Reading& row, OMFHints *hints);
 
@@ -314,9 +355,28 @@ private:
 
 		bool createAFHierarchyOmfHint(const string& assetName, const  string &OmfHintHierarchy);
 
+		// Get the data message template for an asset
+		std::shared_ptr<OMFDataTemplate>
+			getDataTemplate(const std::string& assetName,
+					const std::string& measurementId,
+					const std::string& hintText,
+					OMFHints *hints);
+
+		// Get the parsed OMF hints for the text of the hints
+		std::shared_ptr<OMFHints>
+			parseHints(const std::string& hintText);
+
 		bool HandleAFMapNames(Document& JSon);
 		bool HandleAFMapMetedata(Document& JSon);
 
+		// Evaluation of the compiled AF map rules
+		std::string resolveAFPath(const OMFAFPath& path, const Reading& reading);
+		const std::string& getAFPrefix(const std::string& path);
+		void applyAFRule(const std::string& assetName, const OMFAFPath& path,
+				 const Reading& reading, const char *rule);
+		void addAssetAFHierarchy(const std::string& assetName, const std::string& path,
+					 const std::string& prefix, const char *rule);
+
 	private:
 		// Use for the evaluatin of the OMFDataTypes.typesShort
 		union t_typeCount {
@@ -388,6 +448,24 @@ private:
 			// {"",         {{"",        ""}} }
 		};
 
+		/**
+		 * The AF map rules compiled for the evaluation of the readings,
+		 * the names rules results are cached per asset
+		 */
+		struct AFValueRule {
+			std::string	property;
+			std::vector<std::pair<std::string, OMFAFPath>>
+					values;		// Value with the quotes stripped - path
+		};
+		std::unordered_map<std::string, OMFAFPath>	m_AFNamesPaths;
+		std::unordered_map<std::string, std::pair<std::string, std::string>>
+								m_AFNamesResults;
+		std::unordered_map<std::string, OMFAFPath>	m_AFExistPaths;
+		std::vector<std::pair<std::string, OMFAFPath>>	m_AFNonExistPaths;
+		std::vector<AFValueRule>			m_AFEqualRules;
+		std::vector<AFValueRule>			m_AFNotEqualRules;
+		std::unordered_map<std::string, std::string>	m_AFPrefixes;
+
 		map<std::string, vector<pair<string, string>>>  m_AssetNamePrefix ={
 
 			// Property   - Hierarchy - prefix
@@ -424,6 +502,53 @@ private:
 		// Stores the type for the block of data containing all the used properties
 		std::map<string, Reading*> m_SuperSetDataPoints;
 
+		// The typesShort of each superset, evaluated once per block of data
+		std::unordered_map<std::string, unsigned long> m_SuperSetTypesShort;
+
+		/**
+		 * Per asset templates of the data messages and the assets
+		 * whose templates have been checked against the current block
+		 */
+		/**
+		 * Compression of the data payloads
+		 */
+		int			m_compressionLevel;
+		bool			m_compressionThread;
+
+		OMFDataTemplates	m_localTemplates;
+		OMFDataTemplates	*m_dataTemplates;
+		std::unordered_set<std::string>
+					m_templatesChecked;
+
+		/**
+		 * Parsed OMF hints, readings often carry the same hints
+		 */
+		OMFHintsCache		m_localHintsCache;
+		OMFHintsCache		*m_hintsCache;
+
+		/**
+		 * The data type messages of the new assets of a block, they
+		 * are sent as a few combined messages rather than one set of
+		 * messages per asset. The assets are kept so that the messages
+		 * can be sent one asset at a time if a combined message fails.
+		 */
+		struct TypeBatchAsset {
+			std::string	keyComplete;
+			std::string	assetName;
+			const Reading	*row;
+			OMFHints	*hints;
+			bool		retryTypeId;	// Send with a new type-id on a data type error
+		};
+		struct TypeBatch {
+			std::string	types;
+			std::string	containers;
+			std::string	staticData;
+			std::string	links;
+			std::vector<TypeBatchAsset>
+					assets;
+		};
+		TypeBatch		*m_typeBatch;
+
 		/**
 		 * Static data to send to OMF
 		 */
@@ -446,9 +571,45 @@ class OMFData
 			const std::string& DefaultAFLocation = std::string(),
 			OMFHints *hints = NULL);
 
+		OMFData(const Reading& reading,
+			const OMFDataTemplate& dataTemplate);
+
 		const std::string& OMFdataVal() const;
+		static bool	appendValue(const Reading& reading,
+					const OMFDataTemplate& dataTemplate,
+					std::string& out);
 	private:
 		std::string	m_value;
 };
 
+/**
+ * The OMFDataTemplate class.
+ * The parts of the data messages of an asset that do not change
+ * from one reading to the next: the container header and the
+ * datapoint names with the PI Server naming rules applied.
+ */
+class OMFDataTemplate
+{
+	public:
+		OMFDataTemplate(const std::string& measurementId,
+				const std::string& hintText,
+				OMFHints *hints);
+
+		bool			matches(const std::string& measurementId,
+						const std::string& hintText) const
+					{
+						return m_measurementId == measurementId &&
+							m_hintText == hintText;
+					};
+		void			addDatapoints(const Reading& reading);
+		const std::string&	header() const { return m_header; };
+		const std::string	*datapoint(const std::string& name) const;
+	private:
+		std::string		m_measurementId;
+		std::string		m_hintText;
+		std::string		m_header;
+		std::unordered_map<std::string, std::string>
+					m_datapoints;
+};
+
 #endif
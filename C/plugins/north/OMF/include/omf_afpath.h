@@ -0,0 +1,41 @@
+#ifndef _OMF_AFPATH_H
+#define _OMF_AFPATH_H
+/*
+ * Fledge OSI Soft OMF interface to PI Server.
+ *
+ * Copyright (c) 2026 Dianomic Systems
+ *
+ * Released under the Apache 2.0 Licence
+ *
+ * Author: agent
+ */
+#include <string>
+#include <vector>
+#include <reading.h>
+
+/**
+ * An Asset Framework hierarchy path of an AF map rule, the path is
+ * split once into its literal parts and the variables of the form
+ * ${property:default} so that it can be expanded for each reading
+ * without being parsed again.
+ */
+class OMFAFPath
+{
+	public:
+		OMFAFPath(const std::string& path);
+		const std::string&	path() const { return m_path; };
+		bool			isRelative() const { return m_path.empty() || m_path[0] != '/'; };
+		bool			hasVariables() const { return m_variables; };
+		std::string		expand(const Reading& reading) const;
+	private:
+		struct Segment {
+			std::string	text;		// Literal text or the property name of a variable
+			std::string	defaultValue;
+			bool		variable;
+		};
+		std::string		m_path;
+		std::vector<Segment>	m_segments;
+		bool			m_variables;
+};
+
+#endif
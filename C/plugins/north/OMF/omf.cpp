@@ -14,7 +14,9 @@
 #include <cstring>
 #include <omf.h>
 #include <OMFHint.h>
+#include <gzip_writer.h>
 #include <logger.h>
+#include <tracer.h>
 #include <zlib.h>
 #include <rapidjson/document.h>
 #include "rapidjson/error/en.h"
@@ -29,6 +31,8 @@
 #include <algorithm>
 #include <vector>
 #include <iterator>
+#include <list>
+#include <mutex>
 
 using namespace std;
 using namespace rapidjson;
@@ -41,6 +45,14 @@ static bool isTypeSupported(DatapointValue& dataPoint);
 #define  AFHierarchySeparator '/'
 #define  AF_TYPES_SUFFIX       "-type"      // The asset name is composed by: asset name + AF_TYPES_SUFFIX + incremental id of the type
 
+// Construction of the OMF data messages of a block
+#define OMF_BUILD_THREADS	4	// Maximum number of threads building the data messages
+#define OMF_BUILD_MIN_READINGS	500	// Minimum number of readings given to each build thread
+#define NAMING_RULES_CACHE_SIZE	10000	// Number of names the results of the naming rules are cached for
+#define OMF_COMPRESS_CHUNK	(64 * 1024)	// Size of the pieces of the payload written to the compressor
+#define OMF_TYPE_BATCH_SIZE	100	// Maximum number of assets whose data types are sent in one combined message
+#define OMF_HINTS_CACHE_SIZE	1000	// Number of distinct OMF hints kept parsed
+
 // Handling escapes for AF Hierarchies
 #define AFH_SLASH            "/"
 #define AFH_SLASH_ESCAPE     "@/"
@@ -217,6 +229,236 @@ const string& OMFData::OMFdataVal() const
 	return m_value;
 }
 
+/**
+ * OMFData constructor, generates the OMF message containing the data
+ * using the template of the asset of the reading
+ *
+ * @param reading           Reading for which the OMF message must be generated
+ * @param dataTemplate      The template of the data messages of the asset
+ */
+OMFData::OMFData(const Reading& reading, const OMFDataTemplate& dataTemplate)
+{
+	m_value.append(dataTemplate.header());
+	if (appendValue(reading, dataTemplate, m_value))
+	{
+		m_value.append("}]}");
+	}
+	else
+	{
+		m_value.clear();
+	}
+}
+
+/**
+ * Append the value object of a reading, without its enclosing braces,
+ * to the values of an OMF data message
+ *
+ * @param reading           The reading to append the value of
+ * @param dataTemplate      The template of the data messages of the asset
+ * @param out               The message to append the value to
+ * @return bool             False, with nothing appended, if all the
+ *                          datapoints are unsupported
+ */
+bool OMFData::appendValue(const Reading& reading, const OMFDataTemplate& dataTemplate, string& out)
+{
+	const vector<Datapoint*>& data = reading.getReadingData();
+	unsigned long skipDatapoints = 0;
+	size_t length = out.length();
+
+	for (auto it = data.cbegin(); it != data.cend(); ++it)
+	{
+		const string& dpName = (*it)->getName();
+		if (dpName.compare(OMF_HINT) == 0)
+		{
+			// Don't send the OMF Hint to the PI Server
+			continue;
+		}
+		if (!isTypeSupported((*it)->getData()))
+		{
+			skipDatapoints++;
+			continue;
+		}
+		const string *name = dataTemplate.datapoint(dpName);
+		if (name)
+		{
+			out.append(*name);
+		}
+		else
+		{
+			out.append("\"" + OMF::ApplyPIServerNamingRulesObj(dpName, nullptr) + "\": ");
+		}
+		out.append((*it)->getData().toString());
+		out.append(", ");
+	}
+
+	// Send nothing if all the datapoints are unsupported
+	if (skipDatapoints && skipDatapoints >= data.size())
+	{
+		out.resize(length);
+		return false;
+	}
+
+	// Append Z to getAssetDateTime(FMT_STANDARD)
+	out.append("\"Time\": \"" + reading.getAssetDateUserTime(Reading::FMT_STANDARD) + "Z" + "\"");
+	return true;
+}
+
+/**
+ * OMFDataTemplate constructor, creates the container header of the
+ * data messages of an asset
+ *
+ * @param measurementId     Name/Reference of the object of the Data Archive at which the data must be assigned
+ * @param hintText          The text of the OMF hints the template is created for
+ * @param hints             The parsed OMF hints, or NULL if there are none
+ */
+OMFDataTemplate::OMFDataTemplate(const string& measurementId, const string& hintText,
+				OMFHints *hints) : m_measurementId(measurementId), m_hintText(hintText)
+{
+	string containerId = measurementId;
+
+	// Apply any TagName hints to modify the containerid
+	if (hints)
+	{
+		const std::vector<OMFHint *> omfHints = hints->getHints();
+		for (auto it = omfHints.cbegin(); it != omfHints.cend(); it++)
+		{
+			if (typeid(**it) == typeid(OMFTagNameHint) ||
+			    typeid(**it) == typeid(OMFTagHint))
+			{
+				containerId = (*it)->getHint();
+				Logger::getLogger()->info("Using OMF TagName hint: %s", containerId.c_str());
+			}
+		}
+	}
+
+	m_header = "{\"containerid\": \"" + containerId + "\", \"values\": [{";
+}
+
+/**
+ * Add the names of the datapoints of a reading to the template
+ *
+ * @param reading	The reading with the datapoints to add
+ */
+void OMFDataTemplate::addDatapoints(const Reading& reading)
+{
+	const vector<Datapoint*>& data = reading.getReadingData();
+	for (auto it = data.cbegin(); it != data.cend(); ++it)
+	{
+		const string& dpName = (*it)->getName();
+		if (m_datapoints.find(dpName) == m_datapoints.end())
+		{
+			m_datapoints[dpName] = "\"" + OMF::ApplyPIServerNamingRulesObj(dpName, nullptr) + "\": ";
+		}
+	}
+}
+
+/**
+ * Return the name, quoted and followed by the separator of the value,
+ * of a datapoint in the data messages
+ *
+ * @param name		The name of the datapoint in the reading
+ * @return		The name in the data messages or NULL if it is not in the template
+ */
+const string *OMFDataTemplate::datapoint(const string& name) const
+{
+	auto it = m_datapoints.find(name);
+	if (it == m_datapoints.end())
+	{
+		return NULL;
+	}
+	return &it->second;
+}
+
+/**
+ * The reading and the template needed to build the OMF data message
+ * of a reading. The template is looked up once the types and containers
+ * of the block have been sent, as the type-id of an asset may change
+ * when they are sent.
+ */
+struct OMFDataJob {
+	OMFDataJob(Reading *reading, const string& assetName,
+		   const string& hintText, const shared_ptr<OMFHints>& hints) :
+			reading(reading), assetName(assetName),
+			hintText(hintText), hints(hints)
+	{
+	};
+	Reading				*reading;
+	string				assetName;
+	string				hintText;
+	shared_ptr<OMFHints>		hints;
+	shared_ptr<OMFDataTemplate>	dataTemplate;
+};
+
+/**
+ * Build the OMF data messages for a contiguous range of readings,
+ * the messages are separated by ", " in the order of the readings.
+ * Consecutive readings of the same container share one message, with
+ * a value for each reading in its values array.
+ * If a compressor is given the messages are written to it each time
+ * OMF_COMPRESS_CHUNK bytes have been built.
+ *
+ * @param jobs			The readings to build the messages for
+ * @param first			The index of the first reading of the range
+ * @param last			The index after the last reading of the range
+ * @param out			The string to append the messages to
+ * @param gzip			The compressor to write the messages to or NULL
+ */
+static void buildOMFData(const vector<OMFDataJob>& jobs, size_t first, size_t last,
+			string& out, GzipWriter *gzip)
+{
+	bool pendingSeparator = false;
+	const OMFDataTemplate *open = NULL;	// Template of the message being built
+	for (size_t i = first; i < last; i++)
+	{
+		const OMFDataJob& job = jobs[i];
+		const OMFDataTemplate *dataTemplate = job.dataTemplate.get();
+		if (open == dataTemplate)
+		{
+			size_t length = out.length();
+			out.append("}, {");
+			if (!OMFData::appendValue(*job.reading, *dataTemplate, out))
+			{
+				out.resize(length);
+				continue;
+			}
+		}
+		else
+		{
+			size_t length = out.length();
+			if (open)
+			{
+				out.append("}]}");
+			}
+			if (pendingSeparator)
+			{
+				out.append(", ");
+			}
+			out.append(dataTemplate->header());
+			if (!OMFData::appendValue(*job.reading, *dataTemplate, out))
+			{
+				out.resize(length);
+				continue;
+			}
+			open = dataTemplate;
+			pendingSeparator = true;
+		}
+		if (gzip && out.length() >= OMF_COMPRESS_CHUNK)
+		{
+			gzip->write(move(out));
+			out.clear();
+		}
+	}
+	if (open)
+	{
+		out.append("}]}");
+	}
+	if (gzip && !out.empty())
+	{
+		gzip->write(move(out));
+		out.clear();
+	}
+}
+
 /**
  * OMF constructor
  */
@@ -232,6 +474,11 @@ OMF::OMF(HttpSender& sender,
 	m_lastError = false;
 	m_changeTypeId = false;
 	m_OMFDataTypes = NULL;
+	m_dataTemplates = &m_localTemplates;
+	m_compressionLevel = Z_DEFAULT_COMPRESSION;
+	m_compressionThread = false;
+	m_typeBatch = NULL;
+	m_hintsCache = &m_localHintsCache;
 }
 
 /**
@@ -255,6 +502,11 @@ OMF::OMF(HttpSender& sender,
 
 	m_lastError = false;
 	m_changeTypeId = false;
+	m_dataTemplates = &m_localTemplates;
+	m_compressionLevel = Z_DEFAULT_COMPRESSION;
+	m_compressionThread = false;
+	m_typeBatch = NULL;
+	m_hintsCache = &m_localHintsCache;
 }
 
 // Destructor
@@ -272,51 +524,14 @@ OMF::~OMF()
 std::string OMF::compress_string(const std::string& str,
                             int compressionlevel)
 {
-    const int windowBits = 15;
-    const int GZIP_ENCODING = 16;
-
-    z_stream zs;                        // z_stream is zlib's control structure
-    memset(&zs, 0, sizeof(zs));
-
-    if (deflateInit2(&zs, compressionlevel, Z_DEFLATED,
-		 windowBits | GZIP_ENCODING, 8,
-		 Z_DEFAULT_STRATEGY) != Z_OK)
-        throw(std::runtime_error("deflateInit failed while compressing."));
-
-    zs.next_in = (Bytef*)str.data();
-    zs.avail_in = str.size();           // set the z_stream's input
-
-    int ret;
-    char outbuffer[32768];
-    std::string outstring;
-
-    // retrieve the compressed bytes blockwise
-    do {
-        zs.next_out = reinterpret_cast<Bytef*>(outbuffer);
-        zs.avail_out = sizeof(outbuffer);
-
-        ret = deflate(&zs, Z_FINISH);
-
-        if (outstring.size() < zs.total_out) {
-            // append the block to the output string
-            outstring.append(outbuffer,
-                             zs.total_out - outstring.size());
-        }
-    } while (ret == Z_OK);
-
-    deflateEnd(&zs);
-
-    if (ret != Z_STREAM_END) {          // an error occurred that was not EOF
-        std::ostringstream oss;
-        oss << "Exception during zlib compression: (" << ret << ") " << zs.msg;
-        throw(std::runtime_error(oss.str()));
-    }
-
-    return outstring;
+	GzipWriter gzip(compressionlevel);
+	gzip.write(str);
+	return gzip.finish();
 }
 
 /**
- * Sends all the data type messages for a Reading data row
+ * Sends all the data type messages for a Reading data row,
+ * while a batch is active the messages are queued in the batch
  *
  * @param row    The current Reading data row
  * @return       True if all data types have been sent (HTTP 2xx OK)
@@ -324,9 +539,15 @@ std::string OMF::compress_string(const std::string& str,
  */
 bool OMF::sendDataTypes(const Reading& row, OMFHints *hints)
 {
+	TRACE_SPAN("omf", "OMF::sendDataTypes");
 	int res;
 	m_changeTypeId = false;
 
+	if (m_typeBatch)
+	{
+		return queueDataTypes(row, hints);
+	}
+
 	// Create header for Type
 	vector<pair<string, string>> resType = OMF::createMessageHeader("Type");
 	// Create data for Type message	
@@ -601,6 +822,193 @@ bool OMF::sendDataTypes(const Reading& row, OMFHints *hints)
 	return true;
 }
 
+/**
+ * Append the elements of an OMF message, a JSON array, to the
+ * elements of a combined message
+ *
+ * @param batch		The elements of the combined message
+ * @param message	The JSON array to append
+ */
+static void appendBatchMessage(string& batch, const string& message)
+{
+	size_t first = message.find('[');
+	size_t last = message.rfind(']');
+	if (first == string::npos || last == string::npos || last <= first + 1)
+	{
+		return;
+	}
+	if (!batch.empty())
+	{
+		batch.append(", ");
+	}
+	batch.append(message, first + 1, last - first - 1);
+}
+
+/**
+ * Queue the data type messages for a Reading data row in the batch
+ * of the block, the messages are sent by flushDataTypes
+ *
+ * @param row    The current Reading data row
+ * @return       Always true, errors are reported when the batch is sent
+ */
+bool OMF::queueDataTypes(const Reading& row, OMFHints *hints)
+{
+	string typeData = OMF::createTypeData(row, hints);
+
+	// If Datatype in Reading row is not supported, just return true
+	if (typeData.empty())
+	{
+		return true;
+	}
+
+	appendBatchMessage(m_typeBatch->types, typeData);
+	appendBatchMessage(m_typeBatch->containers, OMF::createContainerData(row, hints));
+
+	if (m_sendFullStructure)
+	{
+		appendBatchMessage(m_typeBatch->staticData, OMF::createStaticData(row));
+
+		string AFHierarchyLevel;
+		string objectPrefix;
+
+		auto rule = m_AssetNamePrefix.find(m_assetName);
+		if (rule != m_AssetNamePrefix.end())
+		{
+			for (auto &item : rule->second)
+			{
+				string AFHierarchy = item.first;
+				string prefix;
+
+				generateAFHierarchyPrefixLevel(AFHierarchy, prefix, AFHierarchyLevel);
+				prefix = item.second;
+
+				if (objectPrefix.empty())
+				{
+					objectPrefix = prefix;
+				}
+				appendBatchMessage(m_typeBatch->links,
+						OMF::createLinkData(row, AFHierarchyLevel, prefix, objectPrefix, hints));
+			}
+		}
+		else
+		{
+			Logger::getLogger()->error("AF hiererachy is not defined for the asset Name |%s|", m_assetName.c_str());
+		}
+	}
+	return true;
+}
+
+/**
+ * Send one of the combined data type messages of a batch
+ *
+ * @param msgType	The OMF message type: Type, Container or Data
+ * @param description	The description of the message used for logging
+ * @param messages	The elements of the combined message
+ * @return		True if the message has been sent (HTTP 2xx OK)
+ */
+bool OMF::sendTypeBatchMessage(const string& msgType,
+			       const string& description,
+			       const string& messages)
+{
+	if (messages.empty())
+	{
+		return true;
+	}
+
+	vector<pair<string, string>> header = OMF::createMessageHeader(msgType);
+	string payload = "[" + messages + "]";
+	try
+	{
+		int res = m_sender.sendRequest("POST",
+					       m_path,
+					       header,
+					       payload);
+		if  ( ! (res >= 200 && res <= 299) )
+		{
+			Logger::getLogger()->error("Sending combined JSON dataType message '%s' "
+						   "- error: HTTP code |%d| - %s %s",
+						   description.c_str(),
+						   res,
+						   m_sender.getHostPort().c_str(),
+						   m_path.c_str());
+			return false;
+		}
+	}
+	catch (const std::exception& e)
+	{
+		string errorMsg = errorMessageHandler(e.what());
+
+		Logger::getLogger()->warn("Sending combined JSON dataType message '%s' "
+					  "- %s - %s %s",
+					  description.c_str(),
+					  errorMsg.c_str(),
+					  m_sender.getHostPort().c_str(),
+					  m_path.c_str());
+		return false;
+	}
+	return true;
+}
+
+/**
+ * Send the data type messages queued in the batch of the block as
+ * one combined message for each of the types, containers, static data
+ * and links. If a combined message fails the messages are sent again
+ * one asset at a time so that the type errors are handled per asset.
+ * If the data types can not be sent they are no longer recorded as
+ * created for any of the assets of the batch.
+ *
+ * @return	True if the data types of all the queued assets have been sent
+ */
+bool OMF::flushDataTypes()
+{
+	if (!m_typeBatch || m_typeBatch->assets.empty())
+	{
+		return true;
+	}
+
+	TypeBatch *batch = m_typeBatch;
+	TypeBatch pending;
+	swap(pending, *batch);
+
+	// The messages are sent directly while the batch is handled
+	m_typeBatch = NULL;
+
+	bool ret = sendTypeBatchMessage("Type", "Type", pending.types) &&
+		   sendTypeBatchMessage("Container", "Container", pending.containers) &&
+		   sendTypeBatchMessage("Data", "StaticData", pending.staticData) &&
+		   sendTypeBatchMessage("Data", "Data (lynk)", pending.links);
+	if (!ret)
+	{
+		Logger::getLogger()->warn("Sending the data types of %d assets one asset at a time",
+					  (int)pending.assets.size());
+		ret = true;
+		string assetName = m_assetName;
+		for (auto it = pending.assets.cbegin(); ret && it != pending.assets.cend(); it++)
+		{
+			m_assetName = it->assetName;
+			if (!OMF::sendDataTypes(*it->row, it->hints) &&
+			    (!it->retryTypeId || !m_changeTypeId ||
+			     !OMF::handleTypeErrors(it->keyComplete, *it->row, it->hints)))
+			{
+				ret = false;
+			}
+		}
+		m_assetName = assetName;
+	}
+	if (!ret)
+	{
+		// The data types were recorded as created when they were queued,
+		// those of the whole batch must be sent again with the next block
+		for (auto& asset : pending.assets)
+		{
+			OMF::clearCreatedTypes(asset.keyComplete);
+		}
+	}
+
+	m_typeBatch = batch;
+	return ret;
+}
+
 /**
  * AFHierarchy - send an OMF message
  *
@@ -1006,6 +1414,7 @@ void OMF::setAFHierarchy()
 uint32_t OMF::sendToServer(const vector<Reading *>& readings,
 			   bool compression, bool skipSentDataTypes)
 {
+	TRACE_SPAN("omf", "OMF::sendToServer");
 	bool AFHierarchySent = false;
 	bool sendDataTypes;
 	string keyComplete;
@@ -1060,15 +1469,18 @@ uint32_t OMF::sendToServer(const vector<Reading *>& readings,
 	 * - add OMF data to new vector
 	 */
 
-	// Used for logging
-	string json_not_compressed;
-
 	string OMFHintAFHierarchyTmp;
 	string OMFHintAFHierarchy;
 
-	bool pendingSeparator = false;
-	ostringstream jsonData;
-	jsonData << "[";
+	// The data messages are built once the types of all readings are handled
+	vector<OMFDataJob> jobs;
+	m_templatesChecked.clear();
+	jobs.reserve(readings.size());
+
+	// The data types of the new assets are sent as combined messages
+	TypeBatch typeBatch;
+	m_typeBatch = &typeBatch;
+
 	// Fetch Reading* data
 	for (vector<Reading *>::const_iterator elem = readings.begin();
 						    elem != readings.end();
@@ -1079,12 +1491,16 @@ uint32_t OMF::sendToServer(const vector<Reading *>& readings,
 
 		// Fetch and parse any OMFHint for this reading
 		Datapoint *hintsdp = reading->getDatapoint("OMFHint");
+		shared_ptr<OMFHints> parsedHints;
 		OMFHints *hints = NULL;
+		string hintText;
 		bool usingTagHint = false;
 		long typeId = 0;
 		if (hintsdp)
 		{
-			hints = new OMFHints(hintsdp->getData().toString());
+			hintText = hintsdp->getData().toString();
+			parsedHints = parseHints(hintText);
+			hints = parsedHints.get();
 			const vector<OMFHint *> omfHints = hints->getHints();
 			for (auto it = omfHints.cbegin(); it != omfHints.cend(); it++)
 			{
@@ -1227,9 +1643,14 @@ uint32_t OMF::sendToServer(const vector<Reading *>& readings,
 								*reading, skipSentDataTypes, hints))
 				{
 					// Failure
+					m_typeBatch = NULL;
 					m_lastError = true;
 					return 0;
 				}
+				if (sendDataTypes)
+				{
+					typeBatch.assets.push_back({keyComplete, m_assetName, reading, hints, false});
+				}
 			}
 			else
 			{
@@ -1248,27 +1669,167 @@ uint32_t OMF::sendToServer(const vector<Reading *>& readings,
 					OMF::unsetMapObjectTypes(m_SuperSetDataPoints);
 
 					// Failure
+					m_typeBatch = NULL;
 					m_lastError = true;
 					return 0;
 				}
+				if (sendDataTypes)
+				{
+					typeBatch.assets.push_back({keyComplete, m_assetName, datatypeStructure, hints, true});
+				}
+			}
+
+			if (typeBatch.assets.size() >= OMF_TYPE_BATCH_SIZE && !flushDataTypes())
+			{
+				// Remove all assets supersetDataPoints
+				OMF::unsetMapObjectTypes(m_SuperSetDataPoints);
+
+				// Failure
+				m_typeBatch = NULL;
+				m_lastError = true;
+				return 0;
 			}
 
 			// Create the key for dataTypes sending once
 			typeId = OMF::getAssetTypeId(m_assetName);
 		}
 
-		measurementId = generateMeasurementId(m_assetName);
+		jobs.emplace_back(reading, m_assetName, hintText, parsedHints);
+	}
 
-		string outData = OMFData(*reading, measurementId, m_PIServerEndpoint, AFHierarchyPrefix, hints ).OMFdataVal();
-		if (!outData.empty())
+	// Send the data types still queued
+	bool typesSent = flushDataTypes();
+	m_typeBatch = NULL;
+	if (!typesSent)
+	{
+		// Remove all assets supersetDataPoints
+		OMF::unsetMapObjectTypes(m_SuperSetDataPoints);
+
+		// Failure
+		m_lastError = true;
+		return 0;
+	}
+
+	// The type-id of the assets is now known, get the templates of the data messages
+	for (auto& job : jobs)
+	{
+		measurementId = generateMeasurementId(job.assetName);
+		job.dataTemplate = getDataTemplate(job.assetName, measurementId, job.hintText, job.hints.get());
+	}
+
+	/*
+	 * Bring the readings of each container together, in the order of
+	 * the first reading of each, so that they share one data message.
+	 * The sort is stable so the readings of a container remain in order.
+	 */
+	unordered_map<const OMFDataTemplate *, size_t> containerOrder;
+	for (auto& job : jobs)
+	{
+		containerOrder.emplace(job.dataTemplate.get(), containerOrder.size());
+	}
+	if (containerOrder.size() > 1)
+	{
+		stable_sort(jobs.begin(), jobs.end(),
+			[&containerOrder](const OMFDataJob& a, const OMFDataJob& b) {
+				return containerOrder[a.dataTemplate.get()] < containerOrder[b.dataTemplate.get()];
+			});
+	}
+
+	/*
+	 * Build the data messages, large blocks are split into contiguous
+	 * ranges of readings built on separate threads. The ranges are
+	 * merged in the order of the readings so the data of each
+	 * container remains in order.
+	 */
+	size_t nThreads = jobs.size() / OMF_BUILD_MIN_READINGS;
+	if (nThreads > OMF_BUILD_THREADS)
+	{
+		nThreads = OMF_BUILD_THREADS;
+	}
+	unsigned int cores = thread::hardware_concurrency();
+	if (cores && nThreads > cores)
+	{
+		nThreads = cores;
+	}
+
+	/*
+	 * With compression the messages are written to the compressor as
+	 * they are built, the uncompressed payload is never assembled
+	 */
+	unique_ptr<GzipWriter> gzip;
+	if (compression)
+	{
+		gzip.reset(new GzipWriter(m_compressionLevel, m_compressionThread));
+	}
+
+	/*
+	 * Without compression the payload is handed to the sender as the
+	 * segments built, they are never concatenated
+	 */
+	vector<string> segments;
+	if (nThreads <= 1)
+	{
+		if (gzip)
 		{
-			jsonData << (pendingSeparator ? ", " : "") << outData;
-			pendingSeparator = true;
+			string data;
+			gzip->write(string("["));
+			buildOMFData(jobs, 0, jobs.size(), data, gzip.get());
+		}
+		else
+		{
+			segments.emplace_back("[");
+			buildOMFData(jobs, 0, jobs.size(), segments.back(), NULL);
+		}
+	}
+	else
+	{
+		vector<string> parts(nThreads);
+		vector<thread> builders;
+		size_t range = (jobs.size() + nThreads - 1) / nThreads;
+		for (size_t i = 1; i < nThreads; i++)
+		{
+			size_t first = i * range;
+			size_t last = min(first + range, jobs.size());
+			builders.emplace_back(buildOMFData, cref(jobs), first, last,
+					ref(parts[i]), (GzipWriter *)NULL);
 		}
+		// The calling thread builds the first range
+		parts[0] = "[";
+		buildOMFData(jobs, 0, min(range, jobs.size()), parts[0], NULL);
 
-		if (hints)
+		// Each range is written out as soon as it has been built
+		bool pendingSeparator = parts[0].length() > 1;
+		for (size_t i = 0; i < nThreads; i++)
 		{
-			delete hints;
+			if (i > 0)
+			{
+				builders[i - 1].join();
+				if (parts[i].empty())
+				{
+					continue;
+				}
+				if (pendingSeparator)
+				{
+					if (gzip)
+					{
+						gzip->write(string(", "));
+					}
+					else
+					{
+						segments.emplace_back(", ");
+					}
+				}
+				pendingSeparator = true;
+			}
+			if (gzip)
+			{
+				gzip->write(move(parts[i]));
+				string().swap(parts[i]);
+			}
+			else
+			{
+				segments.emplace_back(move(parts[i]));
+			}
 		}
 	}
 
@@ -1279,14 +1840,31 @@ uint32_t OMF::sendToServer(const vector<Reading *>& readings,
 	// Remove all assets supersetDataPoints
 	OMF::unsetMapObjectTypes(m_SuperSetDataPoints);
 
-	jsonData << "]";
-
-	string json = jsonData.str();
-	json_not_compressed = json;
-
-	if (compression)
+#if INSTRUMENT
+	// Used for logging
+	size_t json_not_compressed = 0;
+	size_t payloadLength = 0;
+#endif
+	if (gzip)
 	{
-		json = compress_string(json);
+		gzip->write(string("]"));
+		segments.emplace_back(gzip->finish());
+#if INSTRUMENT
+		json_not_compressed = gzip->inputLength();
+		payloadLength = segments.back().length();
+#endif
+		gzip.reset();
+	}
+	else
+	{
+		segments.emplace_back("]");
+#if INSTRUMENT
+		for (auto& segment : segments)
+		{
+			payloadLength += segment.length();
+		}
+		json_not_compressed = payloadLength;
+#endif
 	}
 
 #if INSTRUMENT
@@ -1310,10 +1888,10 @@ uint32_t OMF::sendToServer(const vector<Reading *>& readings,
 	// Then get HTTPS POST ret code and return 0 to client on error
 	try
 	{
-		int res = m_sender.sendRequest("POST",
-					       m_path,
-					       readingData,
-					       json);
+		int res = m_sender.sendRequestSegments("POST",
+						       m_path,
+						       readingData,
+						       segments);
 		if  ( ! (res >= 200 && res <= 299) )
 		{
 			Logger::getLogger()->error("Sending JSON readings , "
@@ -1357,8 +1935,8 @@ uint32_t OMF::sendToServer(const vector<Reading *>& readings,
 								   timeT2,
 								   timeT3,
 								   timeT4,
-								   json_not_compressed.length(),
-								   json.length()
+								   json_not_compressed,
+								   payloadLength
 		);
 
 #endif
@@ -1507,12 +2085,14 @@ uint32_t OMF::sendToServer(const vector<Reading>& readings,
 						    ++elem)
 	{
 		bool sendDataTypes;
+		shared_ptr<OMFHints> parsedHints;
 		OMFHints *hints = NULL;
 
 		Datapoint *hintsdp = elem->getDatapoint(OMF_HINT);
 		if (hintsdp)
 		{
-			hints = new OMFHints(hintsdp->getData().toString());
+			parsedHints = parseHints(hintsdp->getData().toString());
+			hints = parsedHints.get();
 		}
 
 		// Create the key for dataTypes sending once
@@ -1613,10 +2193,12 @@ uint32_t OMF::sendToServer(const Reading* reading,
 
 
 	Datapoint *hintsdp = reading->getDatapoint("OMFHint");
+	shared_ptr<OMFHints> parsedHints;
 	OMFHints *hints = NULL;
 	if (hintsdp)
 	{
-		hints = new OMFHints(hintsdp->getData().toString());
+		parsedHints = parseHints(hintsdp->getData().toString());
+		hints = parsedHints.get();
 	}
 	if (!OMF::handleDataTypes(key, *reading, skipSentDataTypes, hints))
 	{
@@ -1975,6 +2557,66 @@ std::string OMF::generateMeasurementId(const string& assetName)
 	return(measurementId);
 }
 
+/**
+ * Return the template of the data messages of an asset, the template
+ * is created if there is none or the existing template was created for
+ * a different container or different OMF hints. The datapoints of the
+ * asset in the current block are added to the template the first time
+ * it is returned for each block.
+ *
+ * @param assetName	The asset name, with the PI Server naming rules applied
+ * @param measurementId	The measurement id of the asset
+ * @param hintText	The text of the OMF hints of the reading
+ * @param hints		The parsed OMF hints of the reading, or NULL
+ * @return		The template of the data messages
+ */
+shared_ptr<OMFDataTemplate> OMF::getDataTemplate(const string& assetName,
+						const string& measurementId,
+						const string& hintText,
+						OMFHints *hints)
+{
+	shared_ptr<OMFDataTemplate>& dataTemplate = (*m_dataTemplates)[assetName];
+	if (!dataTemplate || !dataTemplate->matches(measurementId, hintText))
+	{
+		dataTemplate = make_shared<OMFDataTemplate>(measurementId, hintText, hints);
+		m_templatesChecked.erase(assetName);
+	}
+	if (m_templatesChecked.insert(assetName).second)
+	{
+		auto it = m_SuperSetDataPoints.find(assetName);
+		if (it != m_SuperSetDataPoints.end())
+		{
+			dataTemplate->addDatapoints(*it->second);
+		}
+	}
+	return dataTemplate;
+}
+
+
+/**
+ * Return the parsed OMF hints for the text of the hints, the hints
+ * are parsed the first time the text is seen. The cache is emptied
+ * once it holds OMF_HINTS_CACHE_SIZE hints, hints that are in use
+ * stay valid as they are shared.
+ *
+ * @param hintText	The text of the OMF hints of a reading
+ * @return		The parsed OMF hints
+ */
+shared_ptr<OMFHints> OMF::parseHints(const string& hintText)
+{
+	auto it = m_hintsCache->find(hintText);
+	if (it != m_hintsCache->end())
+	{
+		return it->second;
+	}
+	if (m_hintsCache->size() >= OMF_HINTS_CACHE_SIZE)
+	{
+		m_hintsCache->clear();
+	}
+	shared_ptr<OMFHints> hints = make_shared<OMFHints>(hintText);
+	m_hintsCache->insert(make_pair(hintText, hints));
+	return hints;
+}
 
 /**
  * Generate a suffix for the given asset in relation to the selected naming schema and the value of the type id
@@ -2474,326 +3116,226 @@ std::string OMF::variableValueHandle(const Reading& reading, std::string &AFHier
 		}
 	}
 
-	StringReplaceAll(AFHierarchyNew, "//", "/");
+	StringReplaceAll(AFHierarchyNew, "//", "/");
+
+	Logger::getLogger()->debug("%s - Variables found :%s: AFHierarchy :%s: AFHierarchyNew :%s: variableValue :%s: propertyToSearch :%s: propertyValue :%s: propertyDefault :%s:"
+		,__FUNCTION__
+		,found ? "true" : "false"
+		,AFHierarchy.c_str()
+		,AFHierarchyNew.c_str()
+		,variableValue.c_str()
+		,propertyToSearch.c_str()
+		,propertyValue.c_str()
+		,propertyDefault.c_str()
+		);
+
+	return (AFHierarchyNew);
+}
+
+/**
+ * Expand an AF hierarchy path of a rule for a reading, relative
+ * paths are placed below the default AF location
+ *
+ * @param path		The compiled path of the rule
+ * @param reading	The reading the variables are taken from
+ * @return		The path with the PI Server naming rules applied
+ */
+string OMF::resolveAFPath(const OMFAFPath& path, const Reading& reading)
+{
+	string resolved;
+	bool changed;
+
+	if (path.isRelative())
+	{
+		resolved = "/" + m_DefaultAFLocation + "/" + path.path();
+		if (m_DefaultAFLocation.find("${") != string::npos)
+		{
+			// Unusual, variables in the default location are expanded too
+			resolved = variableValueHandle(reading, resolved);
+		}
+		else
+		{
+			resolved = "/" + m_DefaultAFLocation + "/" + path.expand(reading);
+		}
+	}
+	else
+	{
+		resolved = path.expand(reading);
+	}
+	StringReplaceAll(resolved, "//", "/");
+
+	return ApplyPIServerNamingRulesPath(resolved, &changed);
+}
+
+/**
+ * Return the unique prefix of an AF hierarchy path
+ *
+ * @param path	The AF hierarchy path
+ * @return	The prefix of the path
+ */
+const string& OMF::getAFPrefix(const string& path)
+{
+	auto it = m_AFPrefixes.find(path);
+	if (it == m_AFPrefixes.end())
+	{
+		string pathCopy = path;
+		string prefix;
+		string AFHierarchyLevel;
+
+		generateAFHierarchyPrefixLevel(pathCopy, prefix, AFHierarchyLevel);
+		it = m_AFPrefixes.insert(make_pair(path, prefix)).first;
+	}
+	return it->second;
+}
+
+/**
+ * Apply a matched rule to an asset
+ *
+ * @param assetName	The asset name
+ * @param path		The compiled path of the rule
+ * @param reading	The reading the rule matched
+ * @param rule		The kind of the rule, used for logging
+ */
+void OMF::applyAFRule(const string& assetName, const OMFAFPath& path,
+		      const Reading& reading, const char *rule)
+{
+	string resolved = resolveAFPath(path, reading);
+	addAssetAFHierarchy(assetName, resolved, getAFPrefix(resolved), rule);
+}
 
-	Logger::getLogger()->debug("%s - Variables found :%s: AFHierarchy :%s: AFHierarchyNew :%s: variableValue :%s: propertyToSearch :%s: propertyValue :%s: propertyDefault :%s:"
-		,__FUNCTION__
-		,found ? "true" : "false"
-		,AFHierarchy.c_str()
-		,AFHierarchyNew.c_str()
-		,variableValue.c_str()
-		,propertyToSearch.c_str()
-		,propertyValue.c_str()
-		,propertyDefault.c_str()
-		);
+/**
+ * Add an AF hierarchy to an asset, the hierarchy is sent the first
+ * time it is added to the asset
+ *
+ * @param assetName	The asset name
+ * @param path		The AF hierarchy path
+ * @param prefix	The prefix of the path
+ * @param rule		The kind of the rule, used for logging
+ */
+void OMF::addAssetAFHierarchy(const string& assetName, const string& path,
+			      const string& prefix, const char *rule)
+{
+	auto& v = m_AssetNamePrefix[assetName];
+	auto item = make_pair(path, prefix);
 
-	return (AFHierarchyNew);
+	if (std::find(v.begin(), v.end(), item) == v.end())
+	{
+		sendAFHierarchy(path);
+		v.push_back(item);
+
+		Logger::getLogger()->debug("%s - %s asset :%s: path added :%s:", __FUNCTION__, rule, assetName.c_str(), path.c_str());
+	}
+	else
+	{
+		Logger::getLogger()->debug("%s - %s already created asset :%s: path :%s:", __FUNCTION__, rule, assetName.c_str(), path.c_str());
+	}
 }
 
 /**
  * Evaluated the maps containing the Named and Metadata rules to fill the map m_AssetNamePrefix
  * containing for each asset name the related prefix and hierarchy name
  *
+ * The rules are compiled by HandleAFMapNames and HandleAFMapMetedata, the
+ * result of the names rule of an asset is cached as it does not change
+ * from one reading to the next.
+ *
  * @param path                   assetName to evaluate
  * @param reading		         reading row from which will be extracted the datapoint for the evaluation of the rules
  */
 void OMF::evaluateAFHierarchyRules(const string& assetName, const Reading& reading)
 {
 	bool ruleMatched = false;
-	bool ruleMatchedNames = false;
-	bool success;
-
-	string pathInitial;
-	string path;
-	bool changed;
 
 	// names rules - Check if there are any rules defined or not
-	if (!m_AFMapEmptyNames)
+	if (!m_AFMapEmptyNames && !m_AFNamesPaths.empty())
 	{
-		if (! m_NamesRules.empty())
+		auto result = m_AFNamesResults.find(assetName);
+		if (result == m_AFNamesResults.end())
 		{
-
-			string pathNamingRules;
-			string prefix;
-			string AFHierarchyLevel;
-
-			auto it = m_NamesRules.find(assetName);
-			if (it != m_NamesRules.end())
+			auto it = m_AFNamesPaths.find(assetName);
+			if (it != m_AFNamesPaths.end())
 			{
+				string path = resolveAFPath(it->second, reading);
 
-				pathInitial = it->second;
-
-				if (pathInitial.at(0) != '/')
-				{
-					// relative  path
-					pathInitial = "/" + m_DefaultAFLocation + "/" + pathInitial;
-				}
-				path = variableValueHandle(reading, pathInitial);
-				path = ApplyPIServerNamingRulesPath(path, &changed);
-
-				if (pathInitial.compare(path) != 0) {
-
-					it->second = path;
-				}
-
-				generateAFHierarchyPrefixLevel(path, prefix, AFHierarchyLevel);
-				ruleMatched = true;
-				ruleMatchedNames = true;
-
-				auto v =  m_AssetNamePrefix[assetName];
-				auto item = make_pair(path, prefix);
-
-				if(v.size() == 0 ||  std::find(v.begin(), v.end(), item) == v.end())
-				{
-					success = sendAFHierarchy(path.c_str());
-					m_AssetNamePrefix[assetName].push_back(item);
-
-					Logger::getLogger()->debug(
-						"%s - m_NamesRules size :%d: m_AssetNamePrefix size :%d:   vector size :%d: pathInitial :%s: path :%s: stored :%s:"
-							,__FUNCTION__
-							,m_NamesRules.size()
-							,m_AssetNamePrefix.size()
-							,v.size()
-							,pathInitial.c_str()
-							,path.c_str()
-							,it->second.c_str());
-				} else {
-					Logger::getLogger()->debug(
-						"%s - m_NamesRules skipped pathInitial :%s: path :%s: stored :%s:"
-							,__FUNCTION__
-							,pathInitial.c_str()
-							,path.c_str()
-							,it->second.c_str());
-				}
+				// The path of the asset is fixed once the variables are expanded
+				m_NamesRules[assetName] = path;
+				result = m_AFNamesResults.insert(make_pair(assetName,
+						make_pair(path, getAFPrefix(path)))).first;
 			}
 		}
+		if (result != m_AFNamesResults.end())
+		{
+			addAssetAFHierarchy(assetName, result->second.first, result->second.second, "m_NamesRules");
+			ruleMatched = true;
+		}
 	}
 
 	// Meta rules - Check if there are any rules defined or not
 	if (!m_AFMapEmptyMetadata)
 	{
-		auto values = reading.getReadingData();
-
 		// Metadata Rules - Exist
-		if (! m_MetadataRulesExist.empty() )
+		if (!m_AFExistPaths.empty())
 		{
-			string propertyName;
-			string prefix;
-			string AFHierarchyLevel;
-
-			for (auto it = values.begin(); it != values.end(); it++)
+			const vector<Datapoint *>& values = reading.getReadingData();
+			for (auto it = values.cbegin(); it != values.cend(); it++)
 			{
-				propertyName = (*it)->getName();
-				auto rule = m_MetadataRulesExist.find(propertyName);
-				if (rule != m_MetadataRulesExist.end())
+				auto rule = m_AFExistPaths.find((*it)->getName());
+				if (rule != m_AFExistPaths.end())
 				{
-					pathInitial = rule->second;;
-					if (pathInitial.at(0) != '/')
-					{
-						pathInitial = "/" + m_DefaultAFLocation + "/" + pathInitial;
-					}
-
-					path = variableValueHandle(reading, pathInitial);
-					path = ApplyPIServerNamingRulesPath(path, &changed);
-
-					generateAFHierarchyPrefixLevel(path, prefix, AFHierarchyLevel);
+					applyAFRule(assetName, rule->second, reading, "m_MetadataRulesExist");
 					ruleMatched = true;
-
-					auto v =  m_AssetNamePrefix[assetName];
-					auto item = make_pair(path, prefix);
-
-					if(v.size() == 0 || std::find(v.begin(), v.end(), item) == v.end())
-					{
-						success = sendAFHierarchy(path.c_str());
-						m_AssetNamePrefix[assetName].push_back(item);
-
-						Logger::getLogger()->debug("%s - m_MetadataRulesExist asset :%s: path added :%s: :%s:" , __FUNCTION__, assetName.c_str(), pathInitial.c_str()  , path.c_str() );
-					} else {
-						Logger::getLogger()->debug("%s - m_MetadataRulesExist already created asset :%s: path added :%s: :%s:" , __FUNCTION__, assetName.c_str(), pathInitial.c_str()  , path.c_str() );
-					}
 				}
 			}
 		}
 
 		// Metadata Rules - NonExist
-		if (! m_MetadataRulesNonExist.empty() )
+		for (auto it = m_AFNonExistPaths.cbegin(); it != m_AFNonExistPaths.cend(); it++)
 		{
-			string propertyName;
-			string prefix;
-			string AFHierarchyLevel;
-
-			bool found;
-			string rule;
-			for (auto it = m_MetadataRulesNonExist.begin(); it != m_MetadataRulesNonExist.end(); it++)
+			if (!reading.getDatapoint(it->first))
 			{
-				found = false;
-				rule = it->first;
-				pathInitial = it->second;
-				for (auto itL2 = values.begin(); found == false && itL2 != values.end(); itL2++)
-				{
-					propertyName = (*itL2)->getName();
-					if (propertyName.compare(rule) == 0)
-					{
-						found = true;
-					}
-				}
-				if (!found)
-				{
-					if (pathInitial.at(0) != '/')
-					{
-						// relative  path
-						pathInitial = "/" +m_DefaultAFLocation + "/" + pathInitial;
-					}
-					path = variableValueHandle(reading, pathInitial);
-					path = ApplyPIServerNamingRulesPath(path, &changed);
-
-					generateAFHierarchyPrefixLevel(path, prefix, AFHierarchyLevel);
-					ruleMatched = true;
-
-					auto v =  m_AssetNamePrefix[assetName];
-					auto item = make_pair(path, prefix);
-
-
-					if(v.size() == 0 || std::find(v.begin(), v.end(), item) == v.end())
-					{
-						success = sendAFHierarchy(path.c_str());
-						m_AssetNamePrefix[assetName].push_back(item);
-
-						Logger::getLogger()->debug("%s - m_MetadataRulesNonExist - asset :%s: path added :%s: :%s:" , __FUNCTION__, assetName.c_str(), pathInitial.c_str()  , path.c_str() );
-					} else {
-						Logger::getLogger()->debug("%s - m_MetadataRulesNonExist -  already created asset :%s: path added :%s: :%s:" , __FUNCTION__, assetName.c_str(), pathInitial.c_str()  , path.c_str() );
-					}
-				}
+				applyAFRule(assetName, it->second, reading, "m_MetadataRulesNonExist");
+				ruleMatched = true;
 			}
 		}
 
-		// Metadata Rules - equal
-		if ( ! m_MetadataRulesEqual.empty() )
+		// Metadata Rules - equal, the first value equal to the property applies
+		for (auto it = m_AFEqualRules.cbegin(); it != m_AFEqualRules.cend(); it++)
 		{
-			string propertyName;
-			string prefix;
-			string AFHierarchyLevel;
-
-			bool found;
-			string rule;
-			for (auto it = m_MetadataRulesEqual.begin(); it != m_MetadataRulesEqual.end(); it++)
+			Datapoint *dp = reading.getDatapoint(it->property);
+			if (!dp)
 			{
-				found = false;
-				rule = it->first;
-				for (auto itL2 = values.begin(); found == false && itL2 != values.end(); itL2++)
-				{
-					propertyName = (*itL2)->getName();
-					DatapointValue data = (*itL2)->getData();
-					string dataValue = data.toString();
-					StringStripQuotes(dataValue);
-					if (propertyName.compare(rule) == 0)
-					{
-						for (auto itL3 = it->second.begin(); found == false && itL3 != it->second.end(); itL3++)
-						{
-							string value = itL3->first;
-							StringStripQuotes(value);
-							pathInitial = itL3->second;
-							if (value.compare(dataValue) == 0)
-							{
-								found = true;
-							}
-						}
-					}
-				}
-				if (found)
+				continue;
+			}
+			string dataValue = dp->getData().toString();
+			StringStripQuotes(dataValue);
+			for (auto value = it->values.cbegin(); value != it->values.cend(); value++)
+			{
+				if (value->first.compare(dataValue) == 0)
 				{
-					if (pathInitial.at(0) != '/')
-					{
-						// relative  path
-						pathInitial = "/" + m_DefaultAFLocation + "/" + pathInitial;
-					}
-					
-					path = variableValueHandle(reading, pathInitial);
-					path = ApplyPIServerNamingRulesPath(path, &changed);
-					
-					generateAFHierarchyPrefixLevel(path, prefix, AFHierarchyLevel);
+					applyAFRule(assetName, value->second, reading, "m_MetadataRulesEqual");
 					ruleMatched = true;
-
-					auto v =  m_AssetNamePrefix[assetName];
-					auto item = make_pair(path, prefix);
-
-
-					if(v.size() == 0 || std::find(v.begin(), v.end(), item) == v.end())
-					{
-						success = sendAFHierarchy(path.c_str());
-						m_AssetNamePrefix[assetName].push_back(item);
-
-						Logger::getLogger()->debug("%s - m_MetadataRulesEqual asset :%s: path added :%s: :%s:" , __FUNCTION__, assetName.c_str(), pathInitial.c_str()  , path.c_str() );
-					} else {
-						Logger::getLogger()->debug("%s - m_MetadataRulesEqual already created asset :%s: path added :%s: :%s:" , __FUNCTION__, assetName.c_str(), pathInitial.c_str()  , path.c_str() );
-					}
-					
+					break;
 				}
 			}
 		}
 
-		// Metadata Rules - Not equal
-		if ( ! m_MetadataRulesNotEqual.empty() )
+		// Metadata Rules - Not equal, the first value not equal to the property applies
+		for (auto it = m_AFNotEqualRules.cbegin(); it != m_AFNotEqualRules.cend(); it++)
 		{
-			string propertyName;
-			string prefix;
-			string AFHierarchyLevel;
-			string rule;
-			bool NotEqual;
-
-			for (auto it = m_MetadataRulesNotEqual.begin(); it != m_MetadataRulesNotEqual.end(); it++)
+			Datapoint *dp = reading.getDatapoint(it->property);
+			if (!dp)
 			{
-				NotEqual = false;
-				rule = it->first;
-				for (auto itL2 = values.begin(); NotEqual == false && itL2 != values.end(); itL2++)
-				{
-					propertyName = (*itL2)->getName();
-
-					if (propertyName.compare(rule) == 0)
-					{
-						DatapointValue data = (*itL2)->getData();
-						string dataValue = data.toString();
-						StringStripQuotes(dataValue);
-
-						for (auto itL3 = it->second.begin(); NotEqual == false && itL3 != it->second.end(); itL3++)
-						{
-							string value = itL3->first;
-							pathInitial = itL3->second;
-							StringStripQuotes(value);
-
-							if (value.compare(dataValue) != 0)
-							{
-								NotEqual = true;
-							}
-						}
-					}
-				}
-				if (NotEqual)
+				continue;
+			}
+			string dataValue = dp->getData().toString();
+			StringStripQuotes(dataValue);
+			for (auto value = it->values.cbegin(); value != it->values.cend(); value++)
+			{
+				if (value->first.compare(dataValue) != 0)
 				{
-					if (pathInitial.at(0) != '/')
-					{
-						// relative  path
-						pathInitial = "/" + m_DefaultAFLocation + "/" + pathInitial;
-					}
-					path = variableValueHandle(reading, pathInitial);
-					path = ApplyPIServerNamingRulesPath(path, &changed);
-
-					generateAFHierarchyPrefixLevel(path, prefix, AFHierarchyLevel);
+					applyAFRule(assetName, value->second, reading, "m_MetadataRulesNotEqual");
 					ruleMatched = true;
-
-					auto v =  m_AssetNamePrefix[assetName];
-					auto item = make_pair(path, prefix);
-
-
-					if(v.size() == 0 || std::find(v.begin(), v.end(), item) == v.end())
-					{
-						success = sendAFHierarchy(path.c_str());
-						m_AssetNamePrefix[assetName].push_back(item);
-
-						Logger::getLogger()->debug("%s - m_MetadataRulesNotEqual asset :%s: path added :%s: :%s:" , __FUNCTION__, assetName.c_str(), pathInitial.c_str()  , path.c_str() );
-					} else {
-						Logger::getLogger()->debug("%s - m_MetadataRulesNotEqual already created asset :%s: path added :%s: :%s:" , __FUNCTION__, assetName.c_str(), pathInitial.c_str()  , path.c_str() );
-					}
+					break;
 				}
 			}
 		}
@@ -2802,13 +3344,12 @@ void OMF::evaluateAFHierarchyRules(const string& assetName, const Reading& readi
 	// If no rules matched se the AF default location
 	if ( ! ruleMatched )
 	{
-		string prefix;
-		string AFHierarchyLevel;
-
-		generateAFHierarchyPrefixLevel(m_DefaultAFLocation, prefix, AFHierarchyLevel);
-
-		auto item = make_pair(m_DefaultAFLocation, prefix);
-		m_AssetNamePrefix[assetName].push_back(item);
+		auto item = make_pair(m_DefaultAFLocation, getAFPrefix(m_DefaultAFLocation));
+		auto& v = m_AssetNamePrefix[assetName];
+		if (std::find(v.begin(), v.end(), item) == v.end())
+		{
+			v.push_back(item);
+		}
 	}
 
 }
@@ -3026,6 +3567,14 @@ bool OMF::HandleAFMapNames(Document& JSon)
 		}
 	}
 
+	// Compile the rules for the evaluation of the readings
+	m_AFNamesPaths.clear();
+	m_AFNamesResults.clear();
+	for (auto it = m_NamesRules.cbegin(); it != m_NamesRules.cend(); it++)
+	{
+		m_AFNamesPaths.insert(make_pair(it->first, OMFAFPath(it->second)));
+	}
+
 	return success;
 }
 
@@ -3146,6 +3695,37 @@ bool OMF::HandleAFMapMetedata(Document& JSon)
 			}
 		}
 	}
+	// Compile the rules for the evaluation of the readings
+	m_AFExistPaths.clear();
+	for (auto it = m_MetadataRulesExist.cbegin(); it != m_MetadataRulesExist.cend(); it++)
+	{
+		m_AFExistPaths.insert(make_pair(it->first, OMFAFPath(it->second)));
+	}
+	m_AFNonExistPaths.clear();
+	for (auto it = m_MetadataRulesNonExist.cbegin(); it != m_MetadataRulesNonExist.cend(); it++)
+	{
+		m_AFNonExistPaths.push_back(make_pair(it->first, OMFAFPath(it->second)));
+	}
+	m_AFEqualRules.clear();
+	m_AFNotEqualRules.clear();
+	const map<string, vector<pair<string, string>>> *valueRules[] = { &m_MetadataRulesEqual, &m_MetadataRulesNotEqual };
+	vector<AFValueRule> *compiledRules[] = { &m_AFEqualRules, &m_AFNotEqualRules };
+	for (int i = 0; i < 2; i++)
+	{
+		for (auto it = valueRules[i]->cbegin(); it != valueRules[i]->cend(); it++)
+		{
+			AFValueRule rule;
+			rule.property = it->first;
+			for (auto itL2 = it->second.cbegin(); itL2 != it->second.cend(); itL2++)
+			{
+				string value = itL2->first;
+				StringStripQuotes(value);
+				rule.values.push_back(make_pair(value, OMFAFPath(itL2->second)));
+			}
+			compiledRules[i]->push_back(rule);
+		}
+	}
+
 	return success;
 }
 
@@ -3325,6 +3905,8 @@ void OMF::setMapObjectTypes(const vector<Reading*>& readings,
 	// Temporary map for [asset][datapoint] = type
 	std::map<string, map<string, string>> readingAllDataPoints;
 
+	m_SuperSetTypesShort.clear();
+
 	// Fetch ALL Reading pointers in the input vector
 	// and create a map of [assetName][datapoint1 .. datapointN] = type
 	for (vector<Reading *>::const_iterator elem = readings.begin();
@@ -3336,8 +3918,26 @@ void OMF::setMapObjectTypes(const vector<Reading*>& readings,
 
 		//string assetName = (**elem).getAssetName();
 
+		// Fetch and parse any OMFHint for this reading, an integer hint may change the types
+		bool integerHint = false;
+		Datapoint *hintsdp = (**elem).getDatapoint("OMFHint");
+		if (hintsdp)
+		{
+			shared_ptr<OMFHints> hints = parseHints(hintsdp->getData().toString());
+			const vector<OMFHint *>& omfHints = hints->getHints();
+
+			for (auto it = omfHints.cbegin(); it != omfHints.cend(); it++)
+			{
+				if (typeid(**it) == typeid(OMFIntegerHint))
+				{
+					integerHint = true;
+					break;
+				}
+			}
+		}
+
 		// Get all datapoints
-		const vector<Datapoint*> data = (**elem).getReadingData();
+		const vector<Datapoint*>& data = (**elem).getReadingData();
 		// Iterate through datapoints
 		for (vector<Datapoint*>::const_iterator it = data.begin();
 							it != data.end();
@@ -3356,27 +3956,9 @@ void OMF::setMapObjectTypes(const vector<Reading*>& readings,
 				omfType = omfTypes[((*it)->getData()).getType()];
 
 				// if an OMF hint is applied the type may change
+				if (integerHint && omfType == OMF_TYPE_FLOAT)
 				{
-					Reading *reading = *elem;
-
-					// Fetch and parse any OMFHint for this reading
-					Datapoint *hintsdp = reading->getDatapoint("OMFHint");
-					OMFHints *hints = NULL;
-
-					if (hintsdp && (omfType == OMF_TYPE_FLOAT || omfType == OMF_TYPE_INTEGER))
-					{
-						hints = new OMFHints(hintsdp->getData().toString());
-						const vector<OMFHint *> omfHints = hints->getHints();
-
-						for (auto it = omfHints.cbegin(); it != omfHints.cend(); it++)
-						{
-							if (typeid(**it) == typeid(OMFIntegerHint))
-							{
-								omfType = OMF_TYPE_INTEGER;
-								break;
-							}
-						}
-					}
+					omfType = OMF_TYPE_INTEGER;
 				}
 
 				auto itr = readingAllDataPoints.find(assetName);
@@ -3457,7 +4039,11 @@ void OMF::setMapObjectTypes(const vector<Reading*>& readings,
 		}
 
 		// Add the superset Reading data with fake values
-		dataSuperSet.emplace(assetName, new Reading(assetName, values));
+		Reading *superSet = new Reading(assetName, values);
+		dataSuperSet.emplace(assetName, superSet);
+
+		// Evaluate the typesShort of the superset once rather than for each reading
+		m_SuperSetTypesShort[assetName] = calcTypeShort(*superSet);
 	}
 }
 
@@ -3887,6 +4473,9 @@ bool OMF::setPathStored(const string& assetName, string &afHierarchy)
 void OMF::incrementAssetTypeId(const std::string& keyComplete)
 {
 	long typeId;
+
+	// The container ids of the data messages change with the type-id
+	m_dataTemplates->clear();
 	if (!m_OMFDataTypes)
         {
 		// Increment current value of m_typeId
@@ -3921,6 +4510,9 @@ void OMF::incrementAssetTypeId(const std::string& keyComplete)
 void OMF::incrementAssetTypeIdOnly(const std::string& keyComplete)
 {
 	long typeId;
+
+	// The container ids of the data messages change with the type-id
+	m_dataTemplates->clear();
 	if (m_OMFDataTypes)
 	{
 		auto it = m_OMFDataTypes->find(keyComplete);
@@ -3944,13 +4536,13 @@ unsigned long OMF::calcTypeShort(const Reading& row)
 
 	int type;
 
-	const vector<Datapoint*> data = row.getReadingData();
+	const vector<Datapoint*>& data = row.getReadingData();
 	for (vector<Datapoint*>::const_iterator it = data.begin();
 		 (it != data.end() &&
 		  isTypeSupported((*it)->getData()));
 		 ++it)
 	{
-		string dpName = (*it)->getName();
+		const string& dpName = (*it)->getName();
 
 		if (!isTypeSupported((*it)->getData()))
 		{
@@ -4242,18 +4834,15 @@ bool OMF::getCreatedTypes(const string& keyComplete, const Reading& row, OMFHint
 						}
 						else
 						{
-							// Check if the defined type has changed respect the superset type
-							Reading* datatypeStructure = NULL;
+							// Check if the defined type has changed respect the superset type,
+							// the typesShort of the superset is evaluated when the superset is created
+							auto itSuper = m_SuperSetTypesShort.find(m_assetName);
 
-							auto itSuper = m_SuperSetDataPoints.find(m_assetName);
-
-							if (itSuper != m_SuperSetDataPoints.end())
+							if (itSuper != m_SuperSetTypesShort.end())
 							{
-								datatypeStructure = (*itSuper).second;
-
 								// Check if the types are changed
 								typeStored.valueLong = type.typesShort;
-								typeNew.valueLong = calcTypeShort(*datatypeStructure);
+								typeNew.valueLong = itSuper->second;
 
 								if (typeNew.cnt.tTotal  > typeStored.cnt.tTotal ||
 									typeNew.cnt.tFloat  > typeStored.cnt.tFloat ||
@@ -4292,6 +4881,78 @@ static bool isTypeSupported(DatapointValue& dataPoint)
 	}
 }
 
+/**
+ * A bounded cache of the results of applying the PI Server naming
+ * rules to names, the least recently used names are evicted once
+ * the cache is full. The cache is shared by the threads building
+ * the OMF messages.
+ */
+class NamingRulesCache
+{
+	public:
+		NamingRulesCache(size_t size) : m_size(size) {};
+		bool	find(const string& name, string& result, bool& changed);
+		void	add(const string& name, const string& result, bool changed);
+	private:
+		struct Entry {
+			string			result;
+			bool			changed;
+			list<string>::iterator	lru;
+		};
+		mutex				m_mutex;
+		size_t				m_size;
+		list<string>			m_lru;	// Most recently used names at the front
+		unordered_map<string, Entry>	m_entries;
+};
+
+/**
+ * Find the result of applying the naming rules to a name
+ *
+ * @param name		The name
+ * @param result	The name with the naming rules applied
+ * @param changed	Set to true if the rules changed the name
+ * @return		True if the name was in the cache
+ */
+bool NamingRulesCache::find(const string& name, string& result, bool& changed)
+{
+	lock_guard<mutex> guard(m_mutex);
+	auto it = m_entries.find(name);
+	if (it == m_entries.end())
+	{
+		return false;
+	}
+	m_lru.splice(m_lru.begin(), m_lru, it->second.lru);
+	result = it->second.result;
+	changed = it->second.changed;
+	return true;
+}
+
+/**
+ * Add the result of applying the naming rules to a name
+ *
+ * @param name		The name
+ * @param result	The name with the naming rules applied
+ * @param changed	True if the rules changed the name
+ */
+void NamingRulesCache::add(const string& name, const string& result, bool changed)
+{
+	lock_guard<mutex> guard(m_mutex);
+	if (m_entries.find(name) != m_entries.end())
+	{
+		return;
+	}
+	if (m_entries.size() >= m_size)
+	{
+		m_entries.erase(m_lru.back());
+		m_lru.pop_back();
+	}
+	m_lru.push_front(name);
+	Entry& entry = m_entries[name];
+	entry.result = result;
+	entry.changed = changed;
+	entry.lru = m_lru.begin();
+}
+
 /**
  * Check a PI Server name and returns the proper name to use following the naming rules
  *
@@ -4301,7 +4962,7 @@ static bool isTypeSupported(DatapointValue& dataPoint)
  * @param    changed  if not null, it is set to true if a change occur
  * @return			  Object name following the PI Server naming rules
  */
-std::string OMF::ApplyPIServerNamingRulesInvalidChars(const std::string &objName, bool *changed)
+static std::string namingRulesInvalidChars(const std::string &objName, bool *changed)
 {
 	std::string nameFixed;
 
@@ -4339,6 +5000,30 @@ std::string OMF::ApplyPIServerNamingRulesInvalidChars(const std::string &objName
 	return (nameFixed);
 }
 
+/**
+ * Apply the PI Server naming rules, the results are cached
+ *
+ * @param    objName  The object name to verify
+ * @param    changed  if not null, it is set to true if a change occur
+ * @return			  Object name following the PI Server naming rules
+ */
+std::string OMF::ApplyPIServerNamingRulesInvalidChars(const std::string &objName, bool *changed)
+{
+	static NamingRulesCache cache(NAMING_RULES_CACHE_SIZE);
+	std::string nameFixed;
+	bool fixed;
+
+	if (!cache.find(objName, nameFixed, fixed))
+	{
+		nameFixed = namingRulesInvalidChars(objName, &fixed);
+		cache.add(objName, nameFixed, fixed);
+	}
+	if (changed)
+		*changed = fixed;
+
+	return (nameFixed);
+}
+
 /**
  * Check a PI Server object name and returns the proper name to use following the naming rules:
  *
@@ -4354,7 +5039,7 @@ std::string OMF::ApplyPIServerNamingRulesInvalidChars(const std::string &objName
  * @param    changed  if not null, it is set to true if a change occur
  * @return			  Object name following the PI Server naming rules
  */
-std::string OMF::ApplyPIServerNamingRulesObj(const std::string &objName, bool *changed)
+static std::string namingRulesObj(const std::string &objName, bool *changed)
 {
 	std::string nameFixed;
 
@@ -4384,7 +5069,7 @@ std::string OMF::ApplyPIServerNamingRulesObj(const std::string &objName, bool *c
 		}
 	}
 
-	nameFixed = ApplyPIServerNamingRulesInvalidChars(nameFixed, changed);
+	nameFixed = OMF::ApplyPIServerNamingRulesInvalidChars(nameFixed, changed);
 
 	/// Names cannot begin with '__'. These are reserved for system use.
 	if (
@@ -4402,6 +5087,30 @@ std::string OMF::ApplyPIServerNamingRulesObj(const std::string &objName, bool *c
 	return (nameFixed);
 }
 
+/**
+ * Apply the PI Server naming rules, the results are cached
+ *
+ * @param    objName  The object name to verify
+ * @param    changed  if not null, it is set to true if a change occur
+ * @return			  Object name following the PI Server naming rules
+ */
+std::string OMF::ApplyPIServerNamingRulesObj(const std::string &objName, bool *changed)
+{
+	static NamingRulesCache cache(NAMING_RULES_CACHE_SIZE);
+	std::string nameFixed;
+	bool fixed;
+
+	if (!cache.find(objName, nameFixed, fixed))
+	{
+		nameFixed = namingRulesObj(objName, &fixed);
+		cache.add(objName, nameFixed, fixed);
+	}
+	if (changed)
+		*changed = fixed;
+
+	return (nameFixed);
+}
+
 
 /**
  * Check a PI Server path name and returns the proper name to use following the naming rules:
@@ -4418,7 +5127,7 @@ std::string OMF::ApplyPIServerNamingRulesObj(const std::string &objName, bool *c
  * @param    changed  if not null, it is set to true if a change occur
  * @return			  Object name following the PI Server naming rules
  */
-std::string OMF::ApplyPIServerNamingRulesPath(const std::string &objName, bool *changed)
+static std::string namingRulesPath(const std::string &objName, bool *changed)
 {
 	std::string nameFixed;
 
@@ -4447,7 +5156,7 @@ std::string OMF::ApplyPIServerNamingRulesPath(const std::string &objName, bool *
 		}
 	}
 
-	nameFixed = ApplyPIServerNamingRulesInvalidChars(nameFixed, changed);
+	nameFixed = OMF::ApplyPIServerNamingRulesInvalidChars(nameFixed, changed);
 
 	/// Names cannot begin with '__'. These are reserved for system use.
 	if (
@@ -4473,3 +5182,27 @@ std::string OMF::ApplyPIServerNamingRulesPath(const std::string &objName, bool *
 	return (nameFixed);
 }
 
+/**
+ * Apply the PI Server naming rules, the results are cached
+ *
+ * @param    objName  The object name to verify
+ * @param    changed  if not null, it is set to true if a change occur
+ * @return			  Object name following the PI Server naming rules
+ */
+std::string OMF::ApplyPIServerNamingRulesPath(const std::string &objName, bool *changed)
+{
+	static NamingRulesCache cache(NAMING_RULES_CACHE_SIZE);
+	std::string nameFixed;
+	bool fixed;
+
+	if (!cache.find(objName, nameFixed, fixed))
+	{
+		nameFixed = namingRulesPath(objName, &fixed);
+		cache.add(objName, nameFixed, fixed);
+	}
+	if (changed)
+		*changed = fixed;
+
+	return (nameFixed);
+}
+
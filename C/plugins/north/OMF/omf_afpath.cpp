@@ -0,0 +1,78 @@
+/*
+ * Fledge OSI Soft OMF interface to PI Server.
+ *
+ * Copyright (c) 2026 Dianomic Systems
+ *
+ * Released under the Apache 2.0 Licence
+ *
+ * Author: agent
+ */
+#include <omf_afpath.h>
+#include <omf.h>
+#include <string_utils.h>
+
+using namespace std;
+
+/**
+ * Split an AF hierarchy path into literal parts and variables
+ *
+ * @param path	The path as defined in the AF map
+ */
+OMFAFPath::OMFAFPath(const string& path) : m_path(path), m_variables(false)
+{
+	string rest = path;
+	string variable, property, defaultValue;
+
+	while (OMF::extractVariable(rest, variable, property, defaultValue))
+	{
+		size_t pos = rest.find(variable);
+		if (pos > 0)
+		{
+			m_segments.push_back({ rest.substr(0, pos), "", false });
+		}
+		m_segments.push_back({ property, defaultValue, true });
+		m_variables = true;
+		rest = rest.substr(pos + variable.length());
+	}
+	if (!rest.empty())
+	{
+		m_segments.push_back({ rest, "", false });
+	}
+}
+
+/**
+ * Expand the variables of the path with the values of the datapoints
+ * of a reading, the default value is used for the variables whose
+ * datapoint is not in the reading
+ *
+ * @param reading	The reading
+ * @return		The expanded path
+ */
+string OMFAFPath::expand(const Reading& reading) const
+{
+	if (!m_variables)
+	{
+		return m_path;
+	}
+	string expanded;
+	for (auto& segment : m_segments)
+	{
+		if (!segment.variable)
+		{
+			expanded.append(segment.text);
+			continue;
+		}
+		Datapoint *dp = reading.getDatapoint(segment.text);
+		if (dp)
+		{
+			string value = dp->getData().toString();
+			StringReplaceAll(value, "\"", "");
+			expanded.append(value);
+		}
+		else
+		{
+			expanded.append(segment.defaultValue);
+		}
+	}
+	return expanded;
+}
@@ -45,6 +45,7 @@
 #include <ocs.h>
 #include <simple_https.h>
 #include <simple_http.h>
+#include <http_sender_pool.h>
 #include <config_category.h>
 #include "rapidjson/writer.h"
 #include "rapidjson/stringbuffer.h"
@@ -67,6 +68,7 @@ using namespace SimpleWeb;
 #define PLUGIN_NAME "OMF"
 #define TYPE_ID_KEY "type-id"
 #define SENT_TYPES_KEY "sentDataTypes"
+#define SENT_TYPES_COMPACT_KEY "sentDataTypesCompact"
 #define DATA_KEY "dataTypes"
 #define DATA_KEY_SHORT "dataTypesShort"
 #define DATA_KEY_HINT "hintChecksum"
@@ -338,6 +340,24 @@ const char *PLUGIN_DEFAULT_CONFIG_INFO = QUOTE(
 			"default": NOT_BLOCKING_ERRORS_DEFAULT_PI_WEB_API,
 			"order": "27" ,
 			"readonly": "true"
+		},
+		"compressionLevel": {
+			"description": "The gzip compression level of the readings data, 1 is the fastest and 9 gives the best compression",
+			"type": "integer",
+			"default": "6",
+			"minimum": "1",
+			"maximum": "9",
+			"order": "28",
+			"displayName": "Compression Level",
+			"validity" : "compression == \"true\""
+		},
+		"compressionThread": {
+			"description": "Compress the readings data on a separate thread whilst the data is being built",
+			"type": "boolean",
+			"default": "false",
+			"order": "29",
+			"displayName": "Compression Thread",
+			"validity" : "compression == \"true\""
 		}
 	}
 );
@@ -349,10 +369,11 @@ const char *PLUGIN_DEFAULT_CONFIG_INFO = QUOTE(
  */
 typedef struct
 {
-	HttpSender	*sender;                // HTTPS connection
-	OMF 		*omf;                   // OMF data protocol
+	HttpSenderPool	*senderPool;            // HTTPS connections kept alive between blocks
 	bool        sendFullStructure;      // It sends the minimum OMF structural messages to load data into Data Archive if disabled
 	bool		compression;            // whether to compress readings' data
+	int		compressionLevel;       // zlib compression level of the readings' data
+	bool		compressionThread;      // whether to compress on a thread of its own
 	string		protocol;               // http / https
 	string		hostAndPort;            // hostname:port for SimpleHttps
 	unsigned int	retrySleepTime;     // Seconds between each retry
@@ -387,7 +408,7 @@ typedef struct
 	string		OCSTenantId;
 	string		OCSClientId;
 	string		OCSClientSecret;
-	string		OCSToken;
+	OCSTokenCache	*OCSTokens;             // Refreshes the OCS token before it expires
 
 	vector<pair<string, string>>
 			staticData;	// Static data
@@ -397,17 +418,24 @@ typedef struct
 	// Per asset DataTypes
 	std::map<std::string, OMFDataTypes>
 			assetsDataTypes;
+	// Per asset data message templates
+	OMFDataTemplates
+			dataTemplates;
+	// Parsed OMF hints
+	OMFHintsCache
+			hintsCache;
 } CONNECTOR_INFO;
 
 unsigned long calcTypeShort                (const string& dataTypes);
 string        saveSentDataTypes            (CONNECTOR_INFO* connInfo);
 void          loadSentDataTypes            (CONNECTOR_INFO* connInfo, Document& JSONData);
+void          loadCompactDataTypes         (CONNECTOR_INFO* connInfo, const Value& cachedTypes);
 long          getMaxTypeId                 (CONNECTOR_INFO* connInfo);
 OMF_ENDPOINT  identifyPIServerEndpoint     (CONNECTOR_INFO* connInfo);
 string        AuthBasicCredentialsGenerate (string& userId, string& password);
 void          AuthKerberosSetup            (string& keytabFile, string& keytabFileName);
-string        OCSRetrieveAuthToken         (CONNECTOR_INFO* connInfo);
 string        PIWebAPIGetVersion           (CONNECTOR_INFO* connInfo);
+static HttpSender *createSender            (CONNECTOR_INFO* connInfo);
 
 /**
  * Return the information about this plugin
@@ -451,6 +479,8 @@ PLUGIN_HANDLE plugin_init(ConfigCategory* configData)
 	 */
 	// Allocate connector struct
 	CONNECTOR_INFO *connInfo = new CONNECTOR_INFO;
+	connInfo->senderPool = NULL;
+	connInfo->OCSTokens = NULL;
 
 	// PIServerEndpoint handling
 	string PIServerEndpoint = configData->getValue("PIServerEndpoint");
@@ -599,6 +629,20 @@ PLUGIN_HANDLE plugin_init(ConfigCategory* configData)
 	else
 		connInfo->compression = false;
 
+	connInfo->compressionLevel = Z_DEFAULT_COMPRESSION;
+	if (configData->itemExists("compressionLevel"))
+	{
+		int level = atoi(configData->getValue("compressionLevel").c_str());
+		if (level >= Z_BEST_SPEED && level <= Z_BEST_COMPRESSION)
+			connInfo->compressionLevel = level;
+	}
+	connInfo->compressionThread = false;
+	if (configData->itemExists("compressionThread"))
+	{
+		string thr = configData->getValue("compressionThread");
+		connInfo->compressionThread = (thr == "True" || thr == "true" || thr == "TRUE");
+	}
+
 	// Set the list of errors considered not blocking in the communication
 	// with the PI Server
 	if (connInfo->PIServerEndpoint == ENDPOINT_PIWEB_API)
@@ -667,6 +711,19 @@ PLUGIN_HANDLE plugin_init(ConfigCategory* configData)
 		Logger::getLogger()->info("PIWebAPI version :%s:" ,connInfo->PIWebAPIVersion.c_str() );
 	}
 
+	/**
+	 * The senders are retained between blocks so that the connection,
+	 * and the TLS handshake, to the PI Server is reused
+	 */
+	connInfo->senderPool = new HttpSenderPool([connInfo]() {
+						return createSender(connInfo);
+					});
+	if (connInfo->PIServerEndpoint == ENDPOINT_OCS)
+	{
+		connInfo->OCSTokens = new OCSTokenCache(connInfo->OCSClientId,
+						connInfo->OCSClientSecret);
+	}
+
 #if VERBOSE_LOG
 	// Log plugin configuration
 	Logger::getLogger()->info("%s plugin configured: URL=%s, "
@@ -742,113 +799,123 @@ void plugin_start(const PLUGIN_HANDLE handle,
 }
 
 /**
- * Send Readings data to historian server
+ * Create a sender for the PI Server
+ *
+ * Select the proper library in relation to the need,
+ * LibcurlHttps is needed to integrate Kerberos as the SimpleHttp does not support it
+ * the Libcurl integration implements only HTTPS not HTTP at the current stage
+ *
+ * The handler is allocated using "Hostname : port", connect_timeout and request_timeout.
+ * Default is no timeout at all
+ *
+ * @param connInfo	The plugin handle
+ * @return		The new sender
  */
-uint32_t plugin_send(const PLUGIN_HANDLE handle,
-		     const vector<Reading *>& readings)
+static HttpSender *createSender(CONNECTOR_INFO *connInfo)
 {
-	CONNECTOR_INFO* connInfo = (CONNECTOR_INFO *)handle;
-
-	/**
-	 * Select the proper library in relation to the need,
-	 * LibcurlHttps is needed to integrate Kerberos as the SimpleHttp does not support it
-	 * the Libcurl integration implements only HTTPS not HTTP at the current stage
-	 *
-	 * The handler is allocated using "Hostname : port", connect_timeout and request_timeout.
-	 * Default is no timeout at all
-	 */
 	if (connInfo->PIWebAPIAuthMethod.compare("k") == 0)
 	{
-		connInfo->sender = new LibcurlHttps(connInfo->hostAndPort,
-						    connInfo->timeout,
-						    connInfo->timeout,
-						    connInfo->retrySleepTime,
-						    connInfo->maxRetry);
+		return new LibcurlHttps(connInfo->hostAndPort,
+					connInfo->timeout,
+					connInfo->timeout,
+					connInfo->retrySleepTime,
+					connInfo->maxRetry);
 	}
-	else
+	else if (connInfo->protocol.compare("http") == 0)
 	{
-		if (connInfo->protocol.compare("http") == 0)
-		{
-			connInfo->sender = new SimpleHttp(connInfo->hostAndPort,
-											  connInfo->timeout,
-											  connInfo->timeout,
-											  connInfo->retrySleepTime,
-											  connInfo->maxRetry);
-		}
-		else
-		{
-			connInfo->sender = new SimpleHttps(connInfo->hostAndPort,
-											   connInfo->timeout,
-											   connInfo->timeout,
-											   connInfo->retrySleepTime,
-											   connInfo->maxRetry);
-		}
+		return new SimpleHttp(connInfo->hostAndPort,
+				      connInfo->timeout,
+				      connInfo->timeout,
+				      connInfo->retrySleepTime,
+				      connInfo->maxRetry);
 	}
+	return new SimpleHttps(connInfo->hostAndPort,
+			       connInfo->timeout,
+			       connInfo->timeout,
+			       connInfo->retrySleepTime,
+			       connInfo->maxRetry);
+}
+
+/**
+ * Send Readings data to historian server
+ */
+uint32_t plugin_send(const PLUGIN_HANDLE handle,
+		     const vector<Reading *>& readings)
+{
+	CONNECTOR_INFO* connInfo = (CONNECTOR_INFO *)handle;
 
-	connInfo->sender->setAuthMethod          (connInfo->PIWebAPIAuthMethod);
-	connInfo->sender->setAuthBasicCredentials(connInfo->PIWebAPICredentials);
+	// The sender and the OMF object belong to this call, plugin_send
+	// may be called for several blocks at once
+	HttpSender *sender = connInfo->senderPool->acquire();
 
-	// OCS configurations
-	connInfo->sender->setOCSNamespace        (connInfo->OCSNamespace);
-	connInfo->sender->setOCSTenantId         (connInfo->OCSTenantId);
-	connInfo->sender->setOCSClientId         (connInfo->OCSClientId);
-	connInfo->sender->setOCSClientSecret     (connInfo->OCSClientSecret);
+	sender->setAuthMethod          (connInfo->PIWebAPIAuthMethod);
+	sender->setAuthBasicCredentials(connInfo->PIWebAPICredentials);
 
-	// OCS - retrieves the authentication token
-	// It is retrieved at every send as it can expire and the configuration is only in OCS
-	if (connInfo->PIServerEndpoint == ENDPOINT_OCS)
+	// OCS configurations
+	sender->setOCSNamespace        (connInfo->OCSNamespace);
+	sender->setOCSTenantId         (connInfo->OCSTenantId);
+	sender->setOCSClientId         (connInfo->OCSClientId);
+	sender->setOCSClientSecret     (connInfo->OCSClientSecret);
+
+	// OCS - the authentication token is cached and refreshed in the
+	// background before it expires
+	if (connInfo->OCSTokens)
 	{
-		connInfo->OCSToken = OCSRetrieveAuthToken(connInfo);
-		connInfo->sender->setOCSToken  (connInfo->OCSToken);
+		string token = connInfo->OCSTokens->getToken();
+		sender->setOCSToken    (token);
 	}
 
 	// Allocate the PI Server data protocol
-	connInfo->omf = new OMF(*connInfo->sender,
-				connInfo->path,
-				connInfo->assetsDataTypes,
-				connInfo->producerToken);
+	OMF *omf = new OMF(*sender,
+			   connInfo->path,
+			   connInfo->assetsDataTypes,
+			   connInfo->producerToken);
 
-	connInfo->omf->setSendFullStructure(connInfo->sendFullStructure);
+	omf->setSendFullStructure(connInfo->sendFullStructure);
 
 	// Set PIServerEndpoint configuration
-	connInfo->omf->setNamingScheme(connInfo->NamingScheme);
-	connInfo->omf->setPIServerEndpoint(connInfo->PIServerEndpoint);
-	connInfo->omf->setDefaultAFLocation(connInfo->DefaultAFLocation);
-	connInfo->omf->setAFMap(connInfo->AFMap);
+	omf->setNamingScheme(connInfo->NamingScheme);
+	omf->setPIServerEndpoint(connInfo->PIServerEndpoint);
+	omf->setDefaultAFLocation(connInfo->DefaultAFLocation);
+	omf->setAFMap(connInfo->AFMap);
 
 	// Generates the prefix to have unique asset_id across different levels of hierarchies
 	string AFHierarchyLevel;
-	connInfo->omf->generateAFHierarchyPrefixLevel(connInfo->DefaultAFLocation, connInfo->prefixAFAsset, AFHierarchyLevel);
+	omf->generateAFHierarchyPrefixLevel(connInfo->DefaultAFLocation, connInfo->prefixAFAsset, AFHierarchyLevel);
 
-	connInfo->omf->setPrefixAFAsset(connInfo->prefixAFAsset);
+	omf->setPrefixAFAsset(connInfo->prefixAFAsset);
 
 	// Set OMF FormatTypes  
-	connInfo->omf->setFormatType(OMF_TYPE_FLOAT,
-				     connInfo->formatNumber);
-	connInfo->omf->setFormatType(OMF_TYPE_INTEGER,
-				     connInfo->formatInteger);
-
-	connInfo->omf->setStaticData(&connInfo->staticData);
-	connInfo->omf->setNotBlockingErrors(connInfo->notBlockingErrors);
+	omf->setFormatType(OMF_TYPE_FLOAT,
+			   connInfo->formatNumber);
+	omf->setFormatType(OMF_TYPE_INTEGER,
+			   connInfo->formatInteger);
+
+	omf->setStaticData(&connInfo->staticData);
+	omf->setDataTemplates(&connInfo->dataTemplates);
+	omf->setHintsCache(&connInfo->hintsCache);
+	omf->setCompression(connInfo->compressionLevel,
+			    connInfo->compressionThread);
+	omf->setNotBlockingErrors(connInfo->notBlockingErrors);
 
 	// Send data
-	uint32_t ret = connInfo->omf->sendToServer(readings,
-						   connInfo->compression);
+	uint32_t ret = omf->sendToServer(readings,
+					 connInfo->compression);
 
 	// Detect typeId change in OMF class
-	if (connInfo->omf->getTypeId() != connInfo->typeId)
+	if (omf->getTypeId() != connInfo->typeId)
 	{
 		// Update typeId in plugin handle
-		connInfo->typeId = connInfo->omf->getTypeId();
+		connInfo->typeId = omf->getTypeId();
 		// Log change
 		Logger::getLogger()->info("%s plugin: a new OMF global %s (%d) has been created.",
 					  PLUGIN_NAME,
 					  TYPE_ID_KEY,
 					  connInfo->typeId);
 	}
-	// Delete objects
-	delete connInfo->sender;
-	delete connInfo->omf;
+	// Delete objects, the sender is returned to the pool
+	connInfo->senderPool->release(sender);
+	delete omf;
 
 	// Return sent data ret code
 	return ret;
@@ -895,6 +962,8 @@ string plugin_shutdown(PLUGIN_HANDLE handle)
 				   saveData.str().c_str());
 
 	// Delete plugin handle
+	delete connInfo->senderPool;
+	delete connInfo->OCSTokens;
 	delete connInfo;
 
 	// Return current plugin data to save
@@ -907,15 +976,20 @@ string plugin_shutdown(PLUGIN_HANDLE handle)
 /**
  * Return a JSON string with the dataTypes to save in plugion_data
  *
+ * The data types are saved in the compact form, an array with one
+ * array per asset whose elements are, in order: the key, the type-id,
+ * the short data types, the hints checksum, the naming scheme,
+ * the AF hierarchy hash, the AF hierarchy, the original AF hierarchy
+ * and the data types as a string.
+ *
  * Note: the entry with FAKE_ASSET_KEY is never saved.
  *
  * @param   connInfo  The CONNECTOR_INFO data structure
- * @return            The string with JSON data
+ * @return            The string with JSON data, empty if there are no data types
  */
 string saveSentDataTypes(CONNECTOR_INFO* connInfo)
 {
 	string ret;
-	std::ostringstream newData;
 
 	auto it = connInfo->assetsDataTypes.find(FAKE_ASSET_KEY);
 	if (it != connInfo->assetsDataTypes.end())
@@ -926,78 +1000,106 @@ string saveSentDataTypes(CONNECTOR_INFO* connInfo)
 		connInfo->assetsDataTypes.erase(it);
 	}
 
+	StringBuffer buffer;
+	Writer<StringBuffer> writer(buffer);
+	unsigned long saved = 0;
 
-	unsigned long tSize = connInfo->assetsDataTypes.size();
-	if (tSize)
+	// Prepare output data (skip empty data types)
+	writer.StartArray();
+	for (auto it = connInfo->assetsDataTypes.cbegin();
+		  it != connInfo->assetsDataTypes.cend();
+		  ++it)
 	{
-		
-		// Prepare output data (skip empty data types)
-		newData << "\"" << SENT_TYPES_KEY << "\" : [";
-
-		bool pendingSeparator = false;
-		for (auto it = connInfo->assetsDataTypes.begin();
-			  it != connInfo->assetsDataTypes.end();
-			  ++it)
+		const OMFDataTypes& dataType = (*it).second;
+		if (dataType.types.compare("{}") == 0)
 		{
-			if (((*it).second).types.compare("{}") != 0)
-			{
-				newData << (pendingSeparator ? ", " : "");
-				newData << "{\"" << (*it).first << "\" : {\"" << TYPE_ID_KEY <<
-					   "\": " << to_string(((*it).second).typeId);
-
-				// The information should be stored as string in hexadecimal format
-				std::stringstream tmpStream;
-				tmpStream << std::hex << ((*it).second).typesShort;
-				std::string typesShort = tmpStream.str();
-
-				newData << ", \"" << DATA_KEY_SHORT << "\": \"0x" << typesShort << "\"";
-				std::stringstream hintStream;
-				hintStream << std::hex << ((*it).second).hintChkSum;
-				std::string hintChecksum = hintStream.str();
-				newData << ", \"" << DATA_KEY_HINT << "\": \"0x" << hintChecksum << "\"";
-
-				long NamingScheme;
-				NamingScheme = ((*it).second).namingScheme;
-				newData << ", \"" << NAMING_SCHEME << "\": " << to_string(NamingScheme) << "";
-
-				string AFHHash;
-				AFHHash = ((*it).second).afhHash;
-				newData << ", \"" << AFH_HASH << "\": \"" << AFHHash << "\"";
-
-				string AFHierarchy;
-				AFHierarchy = ((*it).second).afHierarchy;
-				newData << ", \"" << AF_HIERARCHY << "\": \"" << AFHierarchy << "\"";
+			continue;
+		}
+		writer.StartArray();
+		writer.String((*it).first.c_str(), (*it).first.length());
+		writer.Int64(dataType.typeId);
+		writer.Uint64(dataType.typesShort);
+		writer.Uint(dataType.hintChkSum);
+		writer.Int64(dataType.namingScheme);
+		writer.String(dataType.afhHash.c_str(), dataType.afhHash.length());
+		writer.String(dataType.afHierarchy.c_str(), dataType.afHierarchy.length());
+		writer.String(dataType.afHierarchyOrig.c_str(), dataType.afHierarchyOrig.length());
+		writer.String(dataType.types.empty() ? "{}" : dataType.types.c_str());
+		writer.EndArray();
+		saved++;
+	}
+	writer.EndArray();
 
-				string AFHierarchyOrig;
-				AFHierarchyOrig = ((*it).second).afHierarchyOrig;
-				newData << ", \"" << AF_HIERARCHY_ORIG << "\": \"" << AFHierarchyOrig << "\"";
+	if (saved)
+	{
+		ret = "\"" SENT_TYPES_COMPACT_KEY "\" : ";
+		ret.append(buffer.GetString(), buffer.GetSize());
+	}
 
-				Logger::getLogger()->debug("%s - AFHHash :%s: AFHierarchy :%s: AFHierarchyOrig :%s:", __FUNCTION__, AFHHash.c_str(), AFHierarchy.c_str(), AFHierarchyOrig.c_str()  );
-				Logger::getLogger()->debug("%s - NamingScheme :%ld: ", __FUNCTION__,NamingScheme );
+	Logger::getLogger()->debug("%s - saved the data types of %lu assets", __FUNCTION__, saved);
 
-				newData << ", \"" << DATA_KEY << "\": " <<
-					   (((*it).second).types.empty() ? "{}" : ((*it).second).types) <<
-					   "}}";
-				pendingSeparator = true;
-			}
-		}
+	return ret;
+}
 
-		tSize = connInfo->assetsDataTypes.size();
-		if (!tSize)
+/**
+ * Load the data types saved in the compact form by saveSentDataTypes
+ *
+ * The entries are saved in the order of the map, so each one is
+ * inserted at the end of the map without searching for its position.
+ *
+ * @param   connInfo	The CONNECTOR_INFO data structure
+ * @param   cachedTypes	The array of the saved data types
+ */
+void loadCompactDataTypes(CONNECTOR_INFO* connInfo,
+			  const Value& cachedTypes)
+{
+	unsigned long loaded = 0;
+	for (Value::ConstValueIterator it = cachedTypes.Begin();
+					it != cachedTypes.End();
+					++it)
+	{
+		if (!it->IsArray() ||
+		    it->Size() != 9 ||
+		    !(*it)[0].IsString() ||
+		    !(*it)[1].IsInt64() ||
+		    !(*it)[2].IsUint64() ||
+		    !(*it)[3].IsUint() ||
+		    !(*it)[4].IsInt64() ||
+		    !(*it)[5].IsString() ||
+		    !(*it)[6].IsString() ||
+		    !(*it)[7].IsString() ||
+		    !(*it)[8].IsString())
 		{
-			// DataTypes map is empty
-			return ret;
+			Logger::getLogger()->warn("%s plugin: current element in '%s' " \
+						  "property is not valid, ignoring it",
+						  PLUGIN_NAME,
+						  SENT_TYPES_COMPACT_KEY);
+			continue;
 		}
 
-		newData << "]";
-
-		ret = newData.str();
+		OMFDataTypes dataType;
+		dataType.typeId = (*it)[1].GetInt64();
+		dataType.typesShort = (*it)[2].GetUint64();
+		dataType.hintChkSum = (*it)[3].GetUint();
+		dataType.namingScheme = (*it)[4].GetInt64();
+		dataType.afhHash.assign((*it)[5].GetString(), (*it)[5].GetStringLength());
+		dataType.afHierarchy.assign((*it)[6].GetString(), (*it)[6].GetStringLength());
+		dataType.afHierarchyOrig.assign((*it)[7].GetString(), (*it)[7].GetStringLength());
+		dataType.types.assign((*it)[8].GetString(), (*it)[8].GetStringLength());
+
+		// Add data into the map, a duplicate key keeps the last entry
+		string key((*it)[0].GetString(), (*it)[0].GetStringLength());
+		auto pos = connInfo->assetsDataTypes.emplace_hint(connInfo->assetsDataTypes.end(),
+								  key, dataType);
+		pos->second = dataType;
+		loaded++;
 	}
 
-	return ret;
+	Logger::getLogger()->info("%s plugin: loaded the data types of %lu assets",
+				  PLUGIN_NAME,
+				  loaded);
 }
 
-
 /**
  * Calculate the TypeShort in the case it is missing loading type definition
  *
@@ -1082,6 +1184,9 @@ unsigned long calcTypeShort(const string& dataTypes)
  * to the found value, i.e. 14:
  * all new created OMF dataTypes have type-id prefix set to the value of 14.
  *
+ * The data types are loaded from the compact form written by saveSentDataTypes
+ * or, if they were saved by an earlier version, from the per asset objects.
+ *
  * If proper per asset types data is loaded, the FAKE_ASSET_KEY is not set:
  * all new created OMF dataTypes have type-id prefix set to the value of 1
  * while existing (loaded) OMF dataTypes will keep their type-id values.
@@ -1092,7 +1197,12 @@ unsigned long calcTypeShort(const string& dataTypes)
 void loadSentDataTypes(CONNECTOR_INFO* connInfo,
                         Document& JSONData)
 {
-	if (JSONData.HasMember(SENT_TYPES_KEY) &&
+	if (JSONData.HasMember(SENT_TYPES_COMPACT_KEY) &&
+	    JSONData[SENT_TYPES_COMPACT_KEY].IsArray())
+	{
+		loadCompactDataTypes(connInfo, JSONData[SENT_TYPES_COMPACT_KEY]);
+	}
+	else if (JSONData.HasMember(SENT_TYPES_KEY) &&
 	    JSONData[SENT_TYPES_KEY].IsArray())
 	{
 		const Value& cachedTypes = JSONData[SENT_TYPES_KEY];
@@ -1332,23 +1442,6 @@ string PIWebAPIGetVersion(CONNECTOR_INFO* connInfo)
 }
 
 
-/**
- * Calls the OCS api to retrieve the authentication token
- */
-string OCSRetrieveAuthToken(CONNECTOR_INFO* connInfo)
-{
-	string token;
-	OCS *ocs;
-
-	ocs = new OCS();
-
-	token = ocs->retrieveToken(connInfo->OCSClientId , connInfo->OCSClientSecret);
-
-	delete ocs;
-
-	return token;
-}
-
 /**
  * Evaluate if the endpoint is a PI Web API or a Connector Relay.
  *
@@ -0,0 +1,247 @@
+/*
+ * Fledge edge north plugin.
+ *
+ * Copyright (c) 2026 Dianomic Systems
+ *
+ * Released under the Apache 2.0 Licence
+ *
+ * Author: agent
+ */
+#include <edge_sender.h>
+#include <logger.h>
+#include <deque>
+#include <unistd.h>
+#include <stdlib.h>
+#include <string.h>
+
+using namespace std;
+
+/**
+ * Create the sender from the configuration of the plugin
+ *
+ * @param config	The configuration category of the plugin
+ */
+EdgeSender::EdgeSender(ConfigCategory *config) : m_port(0), m_tls(false),
+	m_blockSize(500), m_window(4), m_compress(true), m_ctx(NULL), m_link(NULL),
+	m_compressed(false), m_lastId(0), m_blockNumber(0), m_backoff(0)
+{
+	m_service = config->getName();
+	configure(config);
+}
+
+/**
+ * Close the connection to the receiver
+ */
+EdgeSender::~EdgeSender()
+{
+	disconnect();
+	if (m_ctx)
+	{
+		SSL_CTX_free(m_ctx);
+	}
+}
+
+/**
+ * Apply a configuration, the connection is opened again with the
+ * new settings by the next send. The category of a reconfiguration
+ * does not carry the name of the service, the name of the category
+ * given at creation is kept for the default sender name.
+ *
+ * @param config	The configuration category of the plugin
+ */
+void EdgeSender::configure(ConfigCategory *config)
+{
+	lock_guard<mutex> guard(m_mutex);
+	disconnect();
+	m_host = config->getValue("host");
+	m_port = (unsigned short)strtoul(config->getValue("port").c_str(), NULL, 10);
+	m_tls = config->getValue("tls").compare("true") == 0;
+	m_caFile = config->itemExists("caFile") ? config->getValue("caFile") : "";
+	m_key = config->itemExists("key") ? config->getValue("key") : "";
+	m_blockSize = strtoul(config->getValue("blockSize").c_str(), NULL, 10);
+	m_window = strtoul(config->getValue("window").c_str(), NULL, 10);
+	m_compress = config->getValue("compression").compare("true") == 0;
+	if (m_blockSize < 1)
+		m_blockSize = 1;
+	if (m_window < 1)
+		m_window = 1;
+
+	m_name = config->itemExists("name") ? config->getValue("name") : "";
+	if (m_name.empty())
+	{
+		char hostname[256];
+		if (gethostname(hostname, sizeof(hostname)) != 0)
+			strcpy(hostname, "localhost");
+		hostname[sizeof(hostname) - 1] = 0;
+		m_name = string(hostname) + "/" + m_service;
+	}
+
+	if (m_ctx)
+	{
+		SSL_CTX_free(m_ctx);
+		m_ctx = NULL;
+	}
+	if (m_tls && (m_ctx = EdgeLink::clientContext(m_caFile)) == NULL)
+	{
+		Logger::getLogger()->error("The readings can not be sent until the TLS configuration is corrected");
+	}
+}
+
+/**
+ * Connect to the receiver and exchange the hello and welcome
+ *
+ * @return bool	True if the connection is ready to send readings
+ */
+bool EdgeSender::connect()
+{
+	if (m_tls && !m_ctx)
+	{
+		return false;
+	}
+	m_link = EdgeLink::connect(m_host, m_port, m_ctx, EDGE_CONNECT_TIMEOUT);
+	if (!m_link)
+	{
+		return false;
+	}
+	EdgeHello hello;
+	hello.magic = EDGE_HELLO_MAGIC;
+	hello.version = EDGE_PROTOCOL_VERSION;
+	hello.flags = m_compress ? EDGE_FLAG_ZLIB : 0;
+	hello.nameLength = m_name.length();
+	hello.keyLength = m_key.length();
+	EdgeWelcome welcome;
+	if (!m_link->write(&hello, sizeof(hello)) || !m_link->write(m_name.data(), m_name.length())
+			|| !m_link->write(m_key.data(), m_key.length())
+			|| m_link->wait(EDGE_CONNECT_TIMEOUT) <= 0
+			|| !m_link->read(&welcome, sizeof(welcome))
+			|| welcome.magic != EDGE_WELCOME_MAGIC)
+	{
+		Logger::getLogger()->warn("The edge receiver %s:%d did not accept the connection",
+				m_host.c_str(), m_port);
+		disconnect();
+		return false;
+	}
+	if (welcome.status != EDGE_STATUS_OK)
+	{
+		Logger::getLogger()->error("The edge receiver %s:%d rejected the key of %s",
+				m_host.c_str(), m_port, m_name.c_str());
+		disconnect();
+		return false;
+	}
+	m_compressed = (welcome.flags & EDGE_FLAG_ZLIB) != 0;
+	m_lastId = welcome.lastId;
+	m_blockNumber = 0;
+	Logger::getLogger()->info("Connected to the edge receiver %s:%d as %s, it has the readings up to %lu",
+			m_host.c_str(), m_port, m_name.c_str(), (unsigned long)m_lastId);
+	return true;
+}
+
+/**
+ * Close the connection to the receiver
+ */
+void EdgeSender::disconnect()
+{
+	delete m_link;
+	m_link = NULL;
+}
+
+/**
+ * Wait before the next attempt to reach the receiver, the wait doubles
+ * after each failure up to EDGE_MAX_BACKOFF seconds
+ */
+void EdgeSender::backoff()
+{
+	m_backoff = m_backoff ? m_backoff * 2 : 1;
+	if (m_backoff > EDGE_MAX_BACKOFF)
+		m_backoff = EDGE_MAX_BACKOFF;
+	sleep(m_backoff);
+}
+
+/**
+ * Close the connection after a failure to send, waiting before the
+ * readings are sent again if none were acknowledged
+ *
+ * @param acknowledged	The readings acknowledged before the failure
+ * @return uint32_t	The readings acknowledged
+ */
+uint32_t EdgeSender::failed(size_t acknowledged)
+{
+	disconnect();
+	if (acknowledged == 0)
+	{
+		backoff();
+	}
+	return acknowledged;
+}
+
+/**
+ * Send a set of readings to the receiver
+ *
+ * @param readings	The readings to send
+ * @return uint32_t	The number of readings the receiver has acknowledged
+ */
+uint32_t EdgeSender::send(const vector<Reading *>& readings)
+{
+	lock_guard<mutex> guard(m_mutex);
+	if (!m_link && !connect())
+	{
+		backoff();
+		return 0;
+	}
+
+	// Skip the readings the receiver already has
+	size_t acknowledged = 0;
+	while (m_lastId && acknowledged < readings.size()
+			&& readings[acknowledged]->getId() <= m_lastId)
+	{
+		acknowledged++;
+	}
+
+	deque<pair<uint32_t, size_t> > inflight;	// Block number and end of each block sent
+	size_t next = acknowledged;
+	string block;
+	while (acknowledged < readings.size())
+	{
+		while (next < readings.size() && inflight.size() < m_window)
+		{
+			size_t end = next + m_blockSize < readings.size() ? next + m_blockSize : readings.size();
+			EdgeLink::encodeBlock(m_blockNumber, readings.cbegin() + next,
+					readings.cbegin() + end, m_compressed, block);
+			if (!m_link->write(block.data(), block.length()))
+			{
+				Logger::getLogger()->warn("Connection to the edge receiver %s:%d lost",
+						m_host.c_str(), m_port);
+				return failed(acknowledged);
+			}
+			inflight.push_back(make_pair(m_blockNumber++, end));
+			next = end;
+		}
+
+		RDSAcknowledge ack;
+		if (m_link->wait(EDGE_ACK_TIMEOUT) <= 0 || !m_link->read(&ack, sizeof(ack)))
+		{
+			Logger::getLogger()->warn("No acknowledgement from the edge receiver %s:%d",
+					m_host.c_str(), m_port);
+			return failed(acknowledged);
+		}
+		if ((ack.magic != RDS_ACK_MAGIC && ack.magic != RDS_NACK_MAGIC)
+				|| ack.block != inflight.front().first)
+		{
+			Logger::getLogger()->error("Invalid acknowledgement from the edge receiver %s:%d",
+					m_host.c_str(), m_port);
+			return failed(acknowledged);
+		}
+		if (ack.magic == RDS_NACK_MAGIC)
+		{
+			// The blocks in flight are sent again on a new connection
+			Logger::getLogger()->warn("The edge receiver %s:%d failed to ingest a block of readings",
+					m_host.c_str(), m_port);
+			return failed(acknowledged);
+		}
+		acknowledged = inflight.front().second;
+		inflight.pop_front();
+		m_lastId = readings[acknowledged - 1]->getId();
+	}
+	m_backoff = 0;
+	return acknowledged;
+}
@@ -0,0 +1,64 @@
+#ifndef _EDGE_SENDER_H
+#define _EDGE_SENDER_H
+/*
+ * Fledge edge north plugin.
+ *
+ * Copyright (c) 2026 Dianomic Systems
+ *
+ * Released under the Apache 2.0 Licence
+ *
+ * Author: agent
+ */
+#include <config_category.h>
+#include <edge_link.h>
+#include <reading.h>
+#include <string>
+#include <vector>
+#include <mutex>
+
+#define EDGE_CONNECT_TIMEOUT	10000	// Milliseconds allowed to connect to the receiver
+#define EDGE_ACK_TIMEOUT	30000	// Milliseconds to wait for a block to be acknowledged
+#define EDGE_MAX_BACKOFF	30	// Longest wait in seconds between connection attempts
+
+/**
+ * Sends readings to the edge south plugin of another Fledge instance
+ * using the edge link protocol, see edge_link.h.
+ *
+ * The connection is kept between calls to send. The readings of each
+ * call are split into blocks, up to the window of blocks are sent ahead
+ * of the acknowledgements and the call returns the number of readings
+ * of the blocks that have been acknowledged. Readings the receiver
+ * reports it already has, after a reconnection, are counted as sent
+ * without being sent again.
+ */
+class EdgeSender {
+	public:
+		EdgeSender(ConfigCategory *config);
+		~EdgeSender();
+		void		configure(ConfigCategory *config);
+		uint32_t	send(const std::vector<Reading *>& readings);
+	private:
+		bool		connect();
+		void		disconnect();
+		void		backoff();
+		uint32_t	failed(size_t acknowledged);
+		std::mutex	m_mutex;
+		std::string	m_service;
+		std::string	m_host;
+		unsigned short	m_port;
+		bool		m_tls;
+		std::string	m_caFile;
+		std::string	m_name;
+		std::string	m_key;
+		unsigned int	m_blockSize;
+		unsigned int	m_window;
+		bool		m_compress;
+		SSL_CTX		*m_ctx;
+		EdgeLink	*m_link;
+		bool		m_compressed;	// The receiver accepted compressed blocks
+		uint64_t	m_lastId;	// Last reading the receiver has
+		uint32_t	m_blockNumber;
+		unsigned int	m_backoff;
+};
+
+#endif
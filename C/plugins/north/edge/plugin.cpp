@@ -0,0 +1,170 @@
+/*
+ * Fledge edge north plugin.
+ *
+ * Sends readings to the edge south plugin of another Fledge instance,
+ * typically a site aggregator, in the binary format of the reading
+ * stream over TCP or TLS.
+ *
+ * Copyright (c) 2026 Dianomic Systems
+ *
+ * Released under the Apache 2.0 Licence
+ *
+ * Author: agent
+ */
+#include <plugin_api.h>
+#include <config_category.h>
+#include <logger.h>
+#include <edge_sender.h>
+#include <string>
+#include <version.h>
+
+using namespace std;
+
+#define PLUGIN_NAME "edge"
+
+static const char *default_config = QUOTE({
+		"plugin" : {
+			"description" : "Send readings to the edge south plugin of another Fledge instance",
+			"type" : "string",
+			"default" : PLUGIN_NAME,
+			"readonly" : "true"
+		},
+		"host" : {
+			"description" : "The host of the Fledge instance that receives the readings",
+			"type" : "string",
+			"default" : "localhost",
+			"order" : "1",
+			"displayName" : "Host"
+		},
+		"port" : {
+			"description" : "The port the edge south plugin of the receiver listens on",
+			"type" : "integer",
+			"default" : "6690",
+			"order" : "2",
+			"displayName" : "Port"
+		},
+		"tls" : {
+			"description" : "Connect to the receiver using TLS",
+			"type" : "boolean",
+			"default" : "false",
+			"order" : "3",
+			"displayName" : "TLS"
+		},
+		"caFile" : {
+			"description" : "The file of the certificate authorities that verify the certificate of the receiver, empty to use those of the system",
+			"type" : "string",
+			"default" : "",
+			"order" : "4",
+			"displayName" : "CA Certificates",
+			"validity" : "tls == \"true\""
+		},
+		"key" : {
+			"description" : "The key the receiver requires of its senders",
+			"type" : "password",
+			"default" : "",
+			"order" : "5",
+			"displayName" : "Key"
+		},
+		"name" : {
+			"description" : "The name this instance sends readings as, the receiver tracks the readings it has by name. Empty to use the host name and the service name.",
+			"type" : "string",
+			"default" : "",
+			"order" : "6",
+			"displayName" : "Sender Name"
+		},
+		"blockSize" : {
+			"description" : "The number of readings sent in each block",
+			"type" : "integer",
+			"default" : "500",
+			"minimum" : "1",
+			"order" : "7",
+			"displayName" : "Block Size"
+		},
+		"window" : {
+			"description" : "The number of blocks sent ahead of the acknowledgements of the receiver",
+			"type" : "integer",
+			"default" : "4",
+			"minimum" : "1",
+			"order" : "8",
+			"displayName" : "Window"
+		},
+		"compression" : {
+			"description" : "Compress the blocks of readings if the receiver supports it",
+			"type" : "boolean",
+			"default" : "true",
+			"order" : "9",
+			"displayName" : "Compression"
+		}
+	});
+
+extern "C" {
+
+/**
+ * The plugin information structure
+ */
+static PLUGIN_INFORMATION info = {
+	PLUGIN_NAME,			// Name
+	VERSION,			// Version
+	0,				// Flags
+	PLUGIN_TYPE_NORTH,		// Type
+	"1.0.0",			// Interface version
+	default_config			// Default configuration
+};
+
+/**
+ * Return the information about this plugin
+ */
+PLUGIN_INFORMATION *plugin_info()
+{
+	return &info;
+}
+
+/**
+ * Initialise the plugin with configuration.
+ *
+ * @param config	The configuration category of the plugin
+ * @return PLUGIN_HANDLE	The sender
+ */
+PLUGIN_HANDLE plugin_init(ConfigCategory *config)
+{
+	return (PLUGIN_HANDLE)new EdgeSender(config);
+}
+
+/**
+ * Send readings to the receiver
+ *
+ * @param handle	The sender
+ * @param readings	The readings to send
+ * @return uint32_t	The number of readings sent
+ */
+uint32_t plugin_send(const PLUGIN_HANDLE handle, const vector<Reading *>& readings)
+{
+	EdgeSender *sender = (EdgeSender *)handle;
+	return sender->send(readings);
+}
+
+/**
+ * Reconfigure the plugin
+ *
+ * @param handle	The sender
+ * @param newConfig	The new configuration of the plugin
+ */
+void plugin_reconfigure(PLUGIN_HANDLE *handle, const string& newConfig)
+{
+	EdgeSender *sender = (EdgeSender *)*handle;
+	ConfigCategory config("edge", newConfig);
+	sender->configure(&config);
+}
+
+/**
+ * Shutdown the plugin
+ *
+ * @param handle	The sender
+ */
+void plugin_shutdown(PLUGIN_HANDLE handle)
+{
+	EdgeSender *sender = (EdgeSender *)handle;
+	delete sender;
+}
+
+};
@@ -0,0 +1,383 @@
+/*
+ * Fledge edge south plugin.
+ *
+ * Copyright (c) 2026 Dianomic Systems
+ *
+ * Released under the Apache 2.0 Licence
+ *
+ * Author: agent
+ */
+#include <edge_receiver.h>
+#include <logger.h>
+#include <utils.h>
+#include <json_utils.h>
+#include <rapidjson/document.h>
+#include <openssl/crypto.h>
+#include <fstream>
+#include <sstream>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <unistd.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+
+using namespace std;
+using namespace rapidjson;
+
+/**
+ * Create the receiver from the configuration of the plugin
+ *
+ * @param config	The configuration category of the plugin
+ */
+EdgeReceiver::EdgeReceiver(ConfigCategory *config) : m_port(0), m_tls(false),
+	m_ctx(NULL), m_ingest(NULL), m_data(NULL), m_running(false), m_listen(-1),
+	m_listener(NULL), m_connections(0)
+{
+	m_service = config->getName();
+	m_positionFile = getDataDir() + "/edge_" + m_service + ".json";
+	loadPositions();
+	configure(config);
+}
+
+/**
+ * Stop receiving readings
+ */
+EdgeReceiver::~EdgeReceiver()
+{
+	stop();
+	if (m_ctx)
+	{
+		SSL_CTX_free(m_ctx);
+	}
+}
+
+/**
+ * Apply a configuration, the receiver must be stopped
+ *
+ * @param config	The configuration category of the plugin
+ */
+void EdgeReceiver::configure(ConfigCategory *config)
+{
+	lock_guard<mutex> guard(m_configMutex);
+	m_port = (unsigned short)strtoul(config->getValue("port").c_str(), NULL, 10);
+	m_tls = config->getValue("tls").compare("true") == 0;
+	m_certFile = config->itemExists("certificate") ? config->getValue("certificate") : "";
+	m_keyFile = config->itemExists("privateKey") ? config->getValue("privateKey") : "";
+	m_key = config->itemExists("key") ? config->getValue("key") : "";
+	if (m_ctx)
+	{
+		SSL_CTX_free(m_ctx);
+		m_ctx = NULL;
+	}
+	if (m_tls && (m_ctx = EdgeLink::serverContext(m_certFile, m_keyFile)) == NULL)
+	{
+		Logger::getLogger()->error("The readings can not be received until the TLS configuration is corrected");
+	}
+}
+
+/**
+ * Register the function that passes readings to the south service
+ *
+ * @param cb	The ingest function
+ * @param data	The data of the ingest function
+ */
+void EdgeReceiver::registerIngest(INGEST_CB2 cb, void *data)
+{
+	m_ingest = cb;
+	m_data = data;
+}
+
+/**
+ * Start listening for senders
+ */
+void EdgeReceiver::start()
+{
+	lock_guard<mutex> guard(m_configMutex);
+	if (m_running)
+	{
+		return;
+	}
+	if (m_tls && !m_ctx)
+	{
+		return;
+	}
+	m_listen = socket(AF_INET, SOCK_STREAM, 0);
+	if (m_listen < 0)
+	{
+		Logger::getLogger()->error("Unable to create the edge listener: %s", strerror(errno));
+		return;
+	}
+	int one = 1;
+	setsockopt(m_listen, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+	struct sockaddr_in addr;
+	memset(&addr, 0, sizeof(addr));
+	addr.sin_family = AF_INET;
+	addr.sin_addr.s_addr = htonl(INADDR_ANY);
+	addr.sin_port = htons(m_port);
+	if (::bind(m_listen, (struct sockaddr *)&addr, sizeof(addr)) != 0
+			|| ::listen(m_listen, 8) != 0)
+	{
+		Logger::getLogger()->error("Unable to listen for edge senders on port %d: %s",
+				m_port, strerror(errno));
+		close(m_listen);
+		m_listen = -1;
+		return;
+	}
+	m_running = true;
+	m_listener = new thread(&EdgeReceiver::listen, this);
+	Logger::getLogger()->info("Listening for edge senders on port %d%s", m_port,
+			m_tls ? " using TLS" : "");
+}
+
+/**
+ * Stop listening and wait for the senders being served to be closed
+ */
+void EdgeReceiver::stop()
+{
+	if (!m_running)
+	{
+		return;
+	}
+	m_running = false;
+	m_listener->join();
+	delete m_listener;
+	m_listener = NULL;
+	close(m_listen);
+	m_listen = -1;
+	unique_lock<mutex> lck(m_mutex);
+	while (m_connections)
+	{
+		m_cv.wait(lck);
+	}
+}
+
+/**
+ * The thread that accepts the connections of senders
+ */
+void EdgeReceiver::listen()
+{
+	while (m_running)
+	{
+		EdgeLink *link = EdgeLink::accept(m_listen, m_ctx, EDGE_POLL_INTERVAL);
+		if (!link)
+		{
+			continue;
+		}
+		lock_guard<mutex> guard(m_mutex);
+		m_connections++;
+		thread(&EdgeReceiver::serve, this, link).detach();
+	}
+}
+
+/**
+ * Serve the connection of a sender until it is closed or the receiver
+ * is stopped
+ *
+ * @param link	The connection of the sender
+ */
+void EdgeReceiver::serve(EdgeLink *link)
+{
+	EdgeHello hello;
+	string name, key;
+	if (link->wait(EDGE_POLL_INTERVAL * 10) > 0 && link->read(&hello, sizeof(hello))
+			&& hello.magic == EDGE_HELLO_MAGIC)
+	{
+		name.resize(hello.nameLength);
+		key.resize(hello.keyLength);
+		if (!link->read(&name[0], name.length()) || !link->read(&key[0], key.length()))
+		{
+			name.clear();
+		}
+	}
+	if (name.empty())
+	{
+		Logger::getLogger()->warn("Closing a connection that is not from an edge sender");
+	}
+	else
+	{
+		EdgeWelcome welcome;
+		welcome.magic = EDGE_WELCOME_MAGIC;
+		welcome.version = EDGE_PROTOCOL_VERSION;
+		welcome.flags = hello.flags & EDGE_FLAG_ZLIB;
+		welcome.status = key.length() == m_key.length()
+				&& CRYPTO_memcmp(key.data(), m_key.data(), key.length()) == 0
+				? EDGE_STATUS_OK : EDGE_STATUS_REJECTED;
+		uint64_t lastId = getLastId(name);
+		welcome.lastId = lastId;
+		if (welcome.status != EDGE_STATUS_OK)
+		{
+			Logger::getLogger()->warn("Rejecting the edge sender %s as its key is not valid",
+					name.c_str());
+			link->write(&welcome, sizeof(welcome));
+		}
+		else if (link->write(&welcome, sizeof(welcome)))
+		{
+			Logger::getLogger()->info("Receiving readings from the edge sender %s after %lu",
+					name.c_str(), (unsigned long)lastId);
+			while (m_running)
+			{
+				int rval = link->wait(EDGE_POLL_INTERVAL);
+				if (rval < 0)
+				{
+					break;
+				}
+				if (rval == 0)
+				{
+					continue;
+				}
+				uint32_t blockNumber;
+				vector<Reading *> readings;
+				if (!link->readBlock(blockNumber, readings))
+				{
+					for (auto reading : readings)
+						delete reading;
+					break;
+				}
+
+				// Drop the readings taken before a reconnection
+				uint64_t blockLastId = lastId;
+				size_t kept = 0;
+				for (auto reading : readings)
+				{
+					unsigned long id = reading->getId();
+					if (id && id <= lastId)
+					{
+						delete reading;
+						continue;
+					}
+					if (id > blockLastId)
+						blockLastId = id;
+					readings[kept++] = reading;
+				}
+				readings.resize(kept);
+
+				RDSAcknowledge ack;
+				ack.block = blockNumber;
+				if (readings.empty() || ingest(readings))
+				{
+					ack.magic = RDS_ACK_MAGIC;
+					if (blockLastId != lastId)
+					{
+						lastId = blockLastId;
+						setLastId(name, lastId);
+					}
+				}
+				else
+				{
+					ack.magic = RDS_NACK_MAGIC;
+				}
+				if (!link->write(&ack, sizeof(ack)))
+				{
+					break;
+				}
+			}
+			Logger::getLogger()->info("The edge sender %s has disconnected", name.c_str());
+		}
+	}
+	delete link;
+
+	lock_guard<mutex> guard(m_mutex);
+	m_connections--;
+	m_cv.notify_all();
+}
+
+/**
+ * Pass a block of readings to the south service
+ *
+ * @param readings	The readings, owned by the service if they are taken
+ * @return bool		False if the readings could not be taken
+ */
+bool EdgeReceiver::ingest(vector<Reading *>& readings)
+{
+	if (!m_ingest)
+	{
+		for (auto reading : readings)
+			delete reading;
+		return false;
+	}
+	(*m_ingest)(m_data, new ReadingSet(&readings));
+	return true;
+}
+
+/**
+ * Return the id of the last reading taken from a sender
+ *
+ * @param sender	The name of the sender
+ * @return uint64_t	The id of the last reading, 0 if none
+ */
+uint64_t EdgeReceiver::getLastId(const string& sender)
+{
+	lock_guard<mutex> guard(m_mutex);
+	auto it = m_positions.find(sender);
+	return it == m_positions.end() ? 0 : it->second;
+}
+
+/**
+ * Record the id of the last reading taken from a sender
+ *
+ * @param sender	The name of the sender
+ * @param id		The id of the last reading
+ */
+void EdgeReceiver::setLastId(const string& sender, uint64_t id)
+{
+	lock_guard<mutex> guard(m_mutex);
+	m_positions[sender] = id;
+	savePositions();
+}
+
+/**
+ * Load the last reading taken from each sender
+ */
+void EdgeReceiver::loadPositions()
+{
+	ifstream ifs(m_positionFile.c_str());
+	if (!ifs)
+	{
+		return;
+	}
+	stringstream content;
+	content << ifs.rdbuf();
+	Document doc;
+	doc.Parse(content.str().c_str());
+	if (doc.HasParseError() || !doc.IsObject())
+	{
+		Logger::getLogger()->warn("Ignoring the edge sender positions %s as they are not valid",
+				m_positionFile.c_str());
+		return;
+	}
+	for (auto& m : doc.GetObject())
+	{
+		if (m.value.IsUint64())
+		{
+			m_positions[m.name.GetString()] = m.value.GetUint64();
+		}
+	}
+}
+
+/**
+ * Save the last reading taken from each sender, the caller holds m_mutex
+ */
+void EdgeReceiver::savePositions()
+{
+	string tmp = m_positionFile + ".tmp";
+	ofstream ofs(tmp.c_str(), ios::out | ios::trunc);
+	if (ofs)
+	{
+		ofs << "{ ";
+		for (auto it = m_positions.cbegin(); it != m_positions.cend(); ++it)
+		{
+			if (it != m_positions.cbegin())
+				ofs << ", ";
+			ofs << "\"" << JSONescape(it->first) << "\" : " << it->second;
+		}
+		ofs << " }";
+		ofs.close();
+	}
+	if (!ofs || rename(tmp.c_str(), m_positionFile.c_str()) != 0)
+	{
+		Logger::getLogger()->warn("Unable to write the edge sender positions %s",
+				m_positionFile.c_str());
+		unlink(tmp.c_str());
+	}
+}
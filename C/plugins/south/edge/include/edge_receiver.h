@@ -0,0 +1,74 @@
+#ifndef _EDGE_RECEIVER_H
+#define _EDGE_RECEIVER_H
+/*
+ * Fledge edge south plugin.
+ *
+ * Copyright (c) 2026 Dianomic Systems
+ *
+ * Released under the Apache 2.0 Licence
+ *
+ * Author: agent
+ */
+#include <config_category.h>
+#include <edge_link.h>
+#include <reading_set.h>
+#include <string>
+#include <map>
+#include <mutex>
+#include <thread>
+#include <condition_variable>
+
+#define EDGE_POLL_INTERVAL	1000	// Milliseconds between checks for shutdown
+
+typedef void (*INGEST_CB2)(void *, ReadingSet *);
+
+/**
+ * Receives readings from the edge north plugins of other Fledge
+ * instances using the edge link protocol, see edge_link.h.
+ *
+ * Each sender is served by a thread of its own. The blocks of readings
+ * are passed to the south service as they arrive and acknowledged once
+ * the service has them. The id of the last reading taken from each
+ * sender is kept in a file in the data directory so that a sender that
+ * reconnects, or this service when it restarts, does not send again the
+ * readings that have already been taken.
+ */
+class EdgeReceiver {
+	public:
+		EdgeReceiver(ConfigCategory *config);
+		~EdgeReceiver();
+		void		configure(ConfigCategory *config);
+		void		registerIngest(INGEST_CB2 cb, void *data);
+		void		start();
+		void		stop();
+	private:
+		void		listen();
+		void		serve(EdgeLink *link);
+		bool		ingest(std::vector<Reading *>& readings);
+		uint64_t	getLastId(const std::string& sender);
+		void		setLastId(const std::string& sender, uint64_t id);
+		void		loadPositions();
+		void		savePositions();
+		std::mutex	m_configMutex;
+		std::string	m_service;
+		unsigned short	m_port;
+		bool		m_tls;
+		std::string	m_certFile;
+		std::string	m_keyFile;
+		std::string	m_key;
+		SSL_CTX		*m_ctx;
+		INGEST_CB2	m_ingest;
+		void		*m_data;
+		volatile bool	m_running;
+		int		m_listen;
+		std::thread	*m_listener;
+		std::mutex	m_mutex;
+		std::condition_variable
+				m_cv;
+		unsigned int	m_connections;	// Senders being served
+		std::map<std::string, uint64_t>
+				m_positions;	// The last reading taken from each sender
+		std::string	m_positionFile;
+};
+
+#endif
@@ -0,0 +1,154 @@
+/*
+ * Fledge edge south plugin.
+ *
+ * Receives readings from the edge north plugins of other Fledge
+ * instances in the binary format of the reading stream over TCP or TLS.
+ *
+ * Copyright (c) 2026 Dianomic Systems
+ *
+ * Released under the Apache 2.0 Licence
+ *
+ * Author: agent
+ */
+#include <plugin_api.h>
+#include <config_category.h>
+#include <logger.h>
+#include <edge_receiver.h>
+#include <string>
+#include <version.h>
+
+using namespace std;
+
+#define PLUGIN_NAME "edge"
+
+static const char *default_config = QUOTE({
+		"plugin" : {
+			"description" : "Receive readings from the edge north plugins of other Fledge instances",
+			"type" : "string",
+			"default" : PLUGIN_NAME,
+			"readonly" : "true"
+		},
+		"port" : {
+			"description" : "The port to listen on for senders",
+			"type" : "integer",
+			"default" : "6690",
+			"order" : "1",
+			"displayName" : "Port"
+		},
+		"tls" : {
+			"description" : "Require the senders to connect using TLS",
+			"type" : "boolean",
+			"default" : "false",
+			"order" : "2",
+			"displayName" : "TLS"
+		},
+		"certificate" : {
+			"description" : "The file of the certificate presented to the senders",
+			"type" : "string",
+			"default" : "",
+			"order" : "3",
+			"displayName" : "Certificate",
+			"validity" : "tls == \"true\""
+		},
+		"privateKey" : {
+			"description" : "The file of the private key of the certificate",
+			"type" : "string",
+			"default" : "",
+			"order" : "4",
+			"displayName" : "Private Key",
+			"validity" : "tls == \"true\""
+		},
+		"key" : {
+			"description" : "The key the senders must present",
+			"type" : "password",
+			"default" : "",
+			"order" : "5",
+			"displayName" : "Key"
+		}
+	});
+
+extern "C" {
+
+/**
+ * The plugin information structure
+ */
+static PLUGIN_INFORMATION info = {
+	PLUGIN_NAME,			// Name
+	VERSION,			// Version
+	SP_ASYNC,			// Flags
+	PLUGIN_TYPE_SOUTH,		// Type
+	"2.0.0",			// Interface version
+	default_config			// Default configuration
+};
+
+/**
+ * Return the information about this plugin
+ */
+PLUGIN_INFORMATION *plugin_info()
+{
+	return &info;
+}
+
+/**
+ * Initialise the plugin with configuration.
+ *
+ * @param config	The configuration category of the plugin
+ * @return PLUGIN_HANDLE	The receiver
+ */
+PLUGIN_HANDLE plugin_init(ConfigCategory *config)
+{
+	return (PLUGIN_HANDLE)new EdgeReceiver(config);
+}
+
+/**
+ * Start listening for senders
+ *
+ * @param handle	The receiver
+ */
+void plugin_start(PLUGIN_HANDLE handle)
+{
+	EdgeReceiver *receiver = (EdgeReceiver *)handle;
+	receiver->start();
+}
+
+/**
+ * Register the function that passes the readings to the south service
+ *
+ * @param handle	The receiver
+ * @param cb		The ingest function
+ * @param data		The data of the ingest function
+ */
+void plugin_register_ingest(PLUGIN_HANDLE handle, INGEST_CB2 cb, void *data)
+{
+	EdgeReceiver *receiver = (EdgeReceiver *)handle;
+	receiver->registerIngest(cb, data);
+}
+
+/**
+ * Reconfigure the plugin, the senders are disconnected and reconnect
+ * once the receiver listens again with the new configuration
+ *
+ * @param handle	The receiver
+ * @param newConfig	The new configuration of the plugin
+ */
+void plugin_reconfigure(PLUGIN_HANDLE *handle, const string& newConfig)
+{
+	EdgeReceiver *receiver = (EdgeReceiver *)*handle;
+	ConfigCategory config("edge", newConfig);
+	receiver->stop();
+	receiver->configure(&config);
+	receiver->start();
+}
+
+/**
+ * Shutdown the plugin
+ *
+ * @param handle	The receiver
+ */
+void plugin_shutdown(PLUGIN_HANDLE handle)
+{
+	EdgeReceiver *receiver = (EdgeReceiver *)handle;
+	delete receiver;
+}
+
+};
@@ -0,0 +1,66 @@
+#ifndef _PAYLOAD_DOCUMENT_H
+#define _PAYLOAD_DOCUMENT_H
+/*
+ * Fledge storage service.
+ *
+ * Copyright (c) 2026 Dianomic Systems
+ *
+ * Released under the Apache 2.0 Licence
+ *
+ * Author: agent
+ */
+
+#include <string>
+#include <vector>
+#include <rapidjson/document.h>
+
+#define ARENA_CHUNK_SIZE	(64 * 1024)	// Size of the retained allocator chunk
+
+/**
+ * A per thread arena used to parse the JSON payloads of the storage
+ * API. The arena retains a chunk of memory for the values of the
+ * document and a buffer for the text of the payload, which is parsed
+ * in situ, so that repeated requests on the same thread do not
+ * allocate and free the memory for every request.
+ */
+class PayloadArena {
+	public:
+		PayloadArena();
+		~PayloadArena();
+		rapidjson::Document&	parse(const char *payload, size_t length);
+		rapidjson::Document&	document() { return *m_document; };
+		bool			claim();
+		void			release() { m_inUse = false; };
+		static PayloadArena	*getThreadArena();
+	private:
+		char			*m_chunk;
+		rapidjson::MemoryPoolAllocator<>
+					*m_allocator;
+		rapidjson::Document	*m_document;
+		std::vector<char>	m_text;
+		bool			m_inUse;
+};
+
+/**
+ * A JSON document for a storage API payload. The document uses the
+ * arena of the calling thread, if the arena is already in use by an
+ * enclosing document a private document is used instead.
+ *
+ * The document and any strings taken from it are only valid for the
+ * lifetime of the PayloadDocument.
+ */
+class PayloadDocument {
+	public:
+		PayloadDocument();
+		~PayloadDocument();
+		rapidjson::Document&	parse(const char *payload);
+		rapidjson::Document&	parse(const std::string& payload);
+		rapidjson::Document&	get() { return *m_document; };
+	private:
+		PayloadDocument(const PayloadDocument&) = delete;
+		PayloadDocument&	operator=(const PayloadDocument&) = delete;
+		PayloadArena		*m_arena;
+		rapidjson::Document	*m_document;
+};
+
+#endif
@@ -0,0 +1,125 @@
+#ifndef _POOL_AUTOSCALER_H
+#define _POOL_AUTOSCALER_H
+/*
+ * Fledge storage service - Autoscaling of the connection pools of the storage plugins
+ *
+ * Copyright (c) 2026 Dianomic Systems
+ *
+ * Released under the Apache 2.0 Licence
+ *
+ * Author: agent
+ */
+#include <string>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <chrono>
+
+#define POOL_HEADROOM_PERCENT		25	// Connections kept above the peak in use, as a percentage of the peak
+#define POOL_SHRINK_UTILISATION		50	// Percentage utilisation below which an idle pool is shrunk
+
+/**
+ * The usage of a pool of connections since the last time it was reset
+ */
+typedef struct {
+	unsigned int	size;		// Connections in the pool, idle and in use
+	unsigned int	inUse;		// Connections in use
+	unsigned int	peakInUse;	// The most connections in use at once
+	unsigned long	allocations;	// Connections allocated
+	unsigned long	waits;		// Allocations that found no idle connection
+	unsigned long	waitTime;	// Microseconds the allocations waited for a connection
+	unsigned long	maxWait;	// Longest wait for a connection in microseconds
+	double		busyTime;	// Microseconds of connection use
+	unsigned long	elapsed;	// Microseconds since the usage was reset
+} POOL_USAGE;
+
+/**
+ * The accounting of the use of a pool of connections. It is updated by
+ * the connection manager as connections are opened, closed, allocated and
+ * released, with the lock of the pool held, so it has no lock of its own.
+ *
+ * The busy time is the sum over time of the number of connections in use,
+ * divided by the size of the pool and the elapsed time it gives the
+ * utilisation of the pool.
+ */
+class PoolUsage {
+	public:
+		PoolUsage();
+		void			opened() { m_size++; };
+		void			closed() { m_size--; };
+		void			allocated(bool waited, unsigned long waitTime);
+		void			released();
+		void			usage(POOL_USAGE& usage, bool reset);
+	private:
+		void			accumulate(std::chrono::steady_clock::time_point now);
+	private:
+		unsigned int		m_size;
+		unsigned int		m_inUse;
+		POOL_USAGE		m_usage;
+		std::chrono::steady_clock::time_point
+					m_lastChange;
+		std::chrono::steady_clock::time_point
+					m_reset;
+};
+
+/**
+ * The interface of a connection manager whose pool is resized by the
+ * autoscaler
+ */
+class ConnectionPool {
+	public:
+		virtual ~ConnectionPool() {};
+		virtual void		growPool(unsigned int) = 0;
+		virtual unsigned int	shrinkPool(unsigned int) = 0;
+		virtual void		poolUsage(POOL_USAGE& usage, bool reset) = 0;
+};
+
+/**
+ * A thread that resizes the pool of connections of a storage plugin from
+ * the demand for connections, within a minimum and maximum size.
+ *
+ * The connection managers do not make a caller wait for another caller to
+ * release a connection, as a caller may hold more than one connection, so
+ * an allocation that finds no idle connection opens a new one. The wait
+ * is the time taken to open that connection and the new connection joins
+ * the pool when it is released.
+ *
+ * Every interval the pool is sized to the peak number of connections in
+ * use, plus POOL_HEADROOM_PERCENT of the peak and at least one connection.
+ * If allocations waited the connections needed are opened by the thread
+ * ahead of the next burst, rather than by the callers that need them. An
+ * idle pool, with a utilisation below POOL_SHRINK_UTILISATION percent and
+ * no waits, is shrunk by half of the excess connections each interval, so
+ * that a short lull does not close the connections a busy period needs.
+ * Only idle connections are closed.
+ */
+class PoolAutoscaler {
+	public:
+		PoolAutoscaler(ConnectionPool *pool);
+		~PoolAutoscaler();
+		void			start(unsigned int minimum,
+						unsigned int maximum,
+						unsigned int interval);
+		void			stop();
+		bool			isRunning() const { return m_running; };
+		void			scale();
+		void			asJSON(std::string& json);
+	private:
+		void			scaleThread();
+	private:
+		ConnectionPool		*m_pool;
+		std::thread		*m_thread;
+		bool			m_running;
+		unsigned int		m_minimum;
+		unsigned int		m_maximum;		// 0 for no maximum
+		unsigned int		m_interval;		// Seconds between resizes of the pool
+		std::mutex		m_mutex;
+		std::condition_variable	m_cv;
+		// Statistics, protected by m_mutex
+		POOL_USAGE		m_last;			// The usage of the last interval
+		unsigned int		m_target;		// The size the pool was last set to
+		unsigned long		m_grown;		// Connections opened by the autoscaler
+		unsigned long		m_shrunk;		// Connections closed by the autoscaler
+};
+
+#endif
@@ -0,0 +1,117 @@
+#ifndef _QUERY_SHAPE_H
+#define _QUERY_SHAPE_H
+/*
+ * Fledge storage service.
+ *
+ * Copyright (c) 2026 Dianomic Systems
+ *
+ * Released under the Apache 2.0 Licence
+ *
+ * Author: agent
+ */
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <rapidjson/document.h>
+
+#define MAX_QUERY_SHAPES	200	// Shapes cached by each connection
+
+/**
+ * A literal value taken out of the payload of a query
+ */
+class QueryParameter {
+	public:
+		rapidjson::Value	*m_value;	// The value in the payload
+		bool			m_isString;
+		std::string		m_string;
+		int			m_integer;
+};
+
+/**
+ * A statement of the SQL template of a query shape, with the index in
+ * the parameters of the shape of the value bound to each placeholder
+ */
+class QueryStatement {
+	public:
+		std::string		m_sql;
+		std::vector<int>	m_parameters;
+		unsigned long		m_id;		// Unique to the statement in the cache
+};
+
+/**
+ * The shape of a query of the storage API, the JSON payload with the
+ * literal values of its where clauses and updates replaced by markers.
+ * The payloads sent by core and the tasks repeat the same shapes with
+ * different values.
+ *
+ * The SQL built from the payload with the markers is turned into a
+ * template by replacing the markers with placeholders, the same template
+ * is then executed with the literal values of any payload of the same
+ * shape bound to the placeholders, without walking the payload to build
+ * and escape the SQL again.
+ *
+ * Only the values of comparisons of where clauses, including those of
+ * the queries of joined tables, the values of the columns set by updates
+ * and the values of update expressions are taken out, any other value
+ * is part of the shape. String values that may be
+ * functions and numbers that are not integers are left in the shape as
+ * they change the SQL.
+ */
+class QueryShape {
+	public:
+		typedef enum {
+			PlaceholderQuestion,	// ? as used by SQLite
+			PlaceholderDollar	// $1, $2... as used by PostgreSQL
+		} Placeholder;
+		QueryShape(rapidjson::Document& payload) : m_payload(payload) {};
+		void		extract(const char *operation, const std::string& table);
+		bool		extracted() const { return !m_key.empty(); };
+		const std::string&
+				key() const { return m_key; };
+		const std::vector<QueryParameter>&
+				parameters() const { return m_parameters; };
+		void		restore();
+		bool		statements(const char *sql, Placeholder placeholder,
+					std::vector<QueryStatement>& statements) const;
+	private:
+		void		where(rapidjson::Value& where);
+		void		join(rapidjson::Value& join);
+		void		literal(rapidjson::Value& value);
+		std::string	marker(int parameter) const;
+	private:
+		rapidjson::Document&	m_payload;
+		std::string		m_key;
+		std::vector<QueryParameter>
+					m_parameters;
+};
+
+/**
+ * The SQL template of a query shape, a shape whose SQL could not be
+ * turned into a template is cached without any statements, its queries
+ * are built from the payload each time.
+ */
+class QueryTemplate {
+	public:
+		bool			m_cacheable;
+		std::vector<QueryStatement>
+					m_statements;
+};
+
+/**
+ * The SQL templates of the query shapes seen by a connection
+ */
+class QueryShapeCache {
+	public:
+		QueryShapeCache() : m_nextId(0) {};
+		const QueryTemplate	*find(const std::string& key) const;
+		const QueryTemplate	*add(const QueryShape& shape, const char *sql,
+						QueryShape::Placeholder placeholder);
+		bool			full() const { return m_shapes.size() >= MAX_QUERY_SHAPES; };
+		void			clear() { m_shapes.clear(); };
+	private:
+		std::unordered_map<std::string, QueryTemplate>
+					m_shapes;
+		unsigned long		m_nextId;
+};
+
+#endif
@@ -12,12 +12,22 @@
 
 #include <string>
 #include <list>
+#include <vector>
+#include <sys/uio.h>
 
 #define BUFFER_CHUNK	1024
 
 /**
  * Buffer class designed to hold SQL statement that can
  * as required but have minimal copy semantics.
+ *
+ * The SQL is held in a chain of buffers. A size hint, or a call to
+ * reserve, allocates a buffer large enough to hold the statement in a
+ * single buffer. The statement is handed out either as a copy owned by
+ * the caller, with coalesce, or in place with c_str, which copies the
+ * chain only if it holds more than one buffer, or as the segments of the
+ * chain with iov. A buffer that is cleared keeps its largest allocation
+ * and can be reused for the next statement.
  */
 class SQLBuffer {
 	class Buffer {
@@ -34,6 +44,7 @@ class SQLBuffer {
 
         public:
                 SQLBuffer();
+                SQLBuffer(unsigned int sizeHint);
                 ~SQLBuffer();
 
 		bool			isEmpty() { return buffers.empty() || (buffers.size() == 1 && buffers.front()->offset == 0); }
@@ -46,9 +57,15 @@ class SQLBuffer {
 		void			append(const double);
 		void			append(const std::string&);
 		void			quote(const std::string&);
+		void			reserve(unsigned int size);
+		void			clear();
+		unsigned int		length() const;
 		const char		*coalesce();
+		const char		*c_str();
+		void			iov(std::vector<struct iovec>& vec) const;
 
 	private:
+		char			*space(unsigned int len);
 		std::list<Buffer *>	buffers;
 };
 
@@ -0,0 +1,120 @@
+#ifndef _STORAGE_PROFILE_H
+#define _STORAGE_PROFILE_H
+/*
+ * Fledge storage service.
+ *
+ * Copyright (c) 2026 Dianomic Systems
+ *
+ * Released under the Apache 2.0 Licence
+ *
+ * Author: agent
+ */
+#include <string>
+#include <vector>
+#include <mutex>
+#include <atomic>
+#include <chrono>
+
+#define PROFILE_BUCKETS		12	// Latency buckets of each operation
+#define PROFILE_SLOW_STATEMENTS	10	// Slowest statements kept with their SQL
+#define PROFILE_SQL_LENGTH	1024	// Characters of SQL kept for a slow statement
+
+/**
+ * The operations of a storage plugin that are profiled
+ */
+typedef enum {
+	ProfileInsert,
+	ProfileQuery,
+	ProfileUpdate,
+	ProfileDelete,
+	ProfileAppend,
+	ProfileFetch,
+	ProfileReadingQuery,
+	ProfilePurge,
+	ProfileOperations	// The number of operations
+} ProfileOperation;
+
+/**
+ * The latency profile of the storage plugins. A histogram of the duration
+ * of each operation of the plugin API is kept, together with the SQL text
+ * of the slowest statements executed by the plugins.
+ *
+ * The profile is held in the storage common library and is shared by all
+ * the storage plugins loaded by the storage service. Recording a duration
+ * only updates atomic counters, the lock is taken only by the statements
+ * slower than the slowest statements already kept.
+ */
+class StorageProfile {
+	public:
+		static StorageProfile	*getInstance();
+		void			operation(ProfileOperation op, unsigned long usecs);
+		void			statement(const char *sql, unsigned long usecs);
+		void			asJSON(std::string& json);
+		void			reset();
+	private:
+		StorageProfile();
+		class SlowStatement {
+			public:
+				unsigned long	m_usecs;
+				time_t		m_time;
+				std::string	m_sql;
+		};
+	private:
+		static StorageProfile	*m_instance;
+		std::atomic<unsigned long>
+					m_buckets[ProfileOperations][PROFILE_BUCKETS];
+		std::atomic<unsigned long>
+					m_count[ProfileOperations];
+		std::atomic<unsigned long>
+					m_total[ProfileOperations];	// Microseconds
+		std::atomic<unsigned long>
+					m_max[ProfileOperations];	// Microseconds
+		std::atomic<unsigned long>
+					m_slowFloor;	// Duration of the fastest slow statement kept
+		std::vector<SlowStatement>
+					m_slow;		// Protected by m_mutex
+		std::mutex		m_mutex;
+};
+
+/**
+ * Time an operation of a storage plugin, the duration is recorded in
+ * the storage profile when the timer goes out of scope
+ */
+class ProfileTimer {
+	public:
+		ProfileTimer(ProfileOperation op) : m_op(op),
+			m_start(std::chrono::steady_clock::now()) {};
+		~ProfileTimer()
+		{
+			StorageProfile::getInstance()->operation(m_op,
+				std::chrono::duration_cast<std::chrono::microseconds>(
+					std::chrono::steady_clock::now() - m_start).count());
+		};
+	private:
+		ProfileOperation	m_op;
+		std::chrono::steady_clock::time_point
+					m_start;
+};
+
+/**
+ * Time the execution of a SQL statement, the statement is kept in the
+ * storage profile if it is amongst the slowest statements. The SQL text
+ * must remain valid until the timer goes out of scope.
+ */
+class StatementTimer {
+	public:
+		StatementTimer(const char *sql) : m_sql(sql),
+			m_start(std::chrono::steady_clock::now()) {};
+		~StatementTimer()
+		{
+			StorageProfile::getInstance()->statement(m_sql,
+				std::chrono::duration_cast<std::chrono::microseconds>(
+					std::chrono::steady_clock::now() - m_start).count());
+		};
+	private:
+		const char		*m_sql;
+		std::chrono::steady_clock::time_point
+					m_start;
+};
+
+#endif
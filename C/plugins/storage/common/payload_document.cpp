@@ -0,0 +1,149 @@
+/*
+ * Fledge storage service.
+ *
+ * Copyright (c) 2026 Dianomic Systems
+ *
+ * Released under the Apache 2.0 Licence
+ *
+ * Author: agent
+ */
+#include <payload_document.h>
+#include <string.h>
+
+using namespace std;
+using namespace rapidjson;
+
+// Text buffers larger than this are not retained after a small payload
+#define MAX_RETAINED_TEXT	(1024 * 1024)
+
+/**
+ * Construct the arena with its retained chunk of memory
+ */
+PayloadArena::PayloadArena() : m_inUse(false)
+{
+	m_chunk = new char[ARENA_CHUNK_SIZE];
+	m_allocator = new MemoryPoolAllocator<>(m_chunk, ARENA_CHUNK_SIZE, ARENA_CHUNK_SIZE);
+	m_document = new Document(m_allocator);
+}
+
+/**
+ * Destroy the arena and the memory it has retained
+ */
+PayloadArena::~PayloadArena()
+{
+	delete m_document;
+	delete m_allocator;
+	delete[] m_chunk;
+}
+
+/**
+ * Return the arena for the calling thread
+ */
+PayloadArena *PayloadArena::getThreadArena()
+{
+	static thread_local PayloadArena arena;
+	return &arena;
+}
+
+/**
+ * Claim the arena for a document
+ *
+ * @return bool	True if the arena was free and has been claimed
+ */
+bool PayloadArena::claim()
+{
+	if (m_inUse)
+	{
+		return false;
+	}
+	m_inUse = true;
+	return true;
+}
+
+/**
+ * Parse a payload into the document of the arena. Any document
+ * previously parsed by the arena is discarded.
+ *
+ * @param payload	The payload text
+ * @param length	The length of the payload
+ * @return Document&	The parsed document
+ */
+Document& PayloadArena::parse(const char *payload, size_t length)
+{
+	m_document->SetNull();
+	m_allocator->Clear();
+
+	if (m_text.capacity() > MAX_RETAINED_TEXT && length < m_text.capacity() / 4)
+	{
+		vector<char>().swap(m_text);
+	}
+	m_text.resize(length + 1);
+	memcpy(m_text.data(), payload, length);
+	m_text[length] = 0;
+
+	// The document references the strings in the copy of the payload
+	return m_document->ParseInsitu(m_text.data());
+}
+
+/**
+ * Create a payload document, using the arena of the calling
+ * thread if it is available.
+ */
+PayloadDocument::PayloadDocument()
+{
+	m_arena = PayloadArena::getThreadArena();
+	if (m_arena->claim())
+	{
+		m_document = &m_arena->document();
+	}
+	else
+	{
+		m_arena = NULL;
+		m_document = new Document();
+	}
+}
+
+/**
+ * Destroy the payload document, releasing the thread arena
+ */
+PayloadDocument::~PayloadDocument()
+{
+	if (m_arena)
+	{
+		m_arena->release();
+	}
+	else
+	{
+		delete m_document;
+	}
+}
+
+/**
+ * Parse the payload
+ *
+ * @param payload	The payload to parse
+ * @return Document&	The document, check HasParseError for the result
+ */
+Document& PayloadDocument::parse(const char *payload)
+{
+	if (m_arena)
+	{
+		return m_arena->parse(payload, strlen(payload));
+	}
+	return m_document->Parse(payload);
+}
+
+/**
+ * Parse the payload
+ *
+ * @param payload	The payload to parse
+ * @return Document&	The document, check HasParseError for the result
+ */
+Document& PayloadDocument::parse(const string& payload)
+{
+	if (m_arena)
+	{
+		return m_arena->parse(payload.c_str(), payload.length());
+	}
+	return m_document->Parse(payload.c_str());
+}
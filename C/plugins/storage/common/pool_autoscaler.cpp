@@ -0,0 +1,285 @@
+/*
+ * Fledge storage service - Autoscaling of the connection pools of the storage plugins
+ *
+ * Copyright (c) 2026 Dianomic Systems
+ *
+ * Released under the Apache 2.0 Licence
+ *
+ * Author: agent
+ */
+
+#include <pool_autoscaler.h>
+#include <logger.h>
+#include <sstream>
+#include <string.h>
+
+using namespace std;
+
+/**
+ * Constructor for the usage of a pool
+ */
+PoolUsage::PoolUsage() : m_size(0), m_inUse(0)
+{
+	memset(&m_usage, 0, sizeof(m_usage));
+	m_lastChange = m_reset = chrono::steady_clock::now();
+}
+
+/**
+ * Add the time the connections in use have been busy since
+ * the number in use last changed
+ *
+ * @param now	The current time
+ */
+void PoolUsage::accumulate(chrono::steady_clock::time_point now)
+{
+	m_usage.busyTime += (double)m_inUse
+		* chrono::duration_cast<chrono::microseconds>(now - m_lastChange).count();
+	m_lastChange = now;
+}
+
+/**
+ * Record the allocation of a connection
+ *
+ * @param waited	The allocation found no idle connection
+ * @param waitTime	The microseconds the allocation waited
+ */
+void PoolUsage::allocated(bool waited, unsigned long waitTime)
+{
+	accumulate(chrono::steady_clock::now());
+	m_inUse++;
+	if (m_inUse > m_usage.peakInUse)
+	{
+		m_usage.peakInUse = m_inUse;
+	}
+	m_usage.allocations++;
+	if (waited)
+	{
+		m_usage.waits++;
+		m_usage.waitTime += waitTime;
+		if (waitTime > m_usage.maxWait)
+		{
+			m_usage.maxWait = waitTime;
+		}
+	}
+}
+
+/**
+ * Record the release of a connection
+ */
+void PoolUsage::released()
+{
+	accumulate(chrono::steady_clock::now());
+	if (m_inUse > 0)
+	{
+		m_inUse--;
+	}
+}
+
+/**
+ * Return the usage of the pool
+ *
+ * @param usage	Set to the usage since the last reset
+ * @param reset	Start a new period of usage
+ */
+void PoolUsage::usage(POOL_USAGE& usage, bool reset)
+{
+	chrono::steady_clock::time_point now = chrono::steady_clock::now();
+	accumulate(now);
+	usage = m_usage;
+	usage.size = m_size;
+	usage.inUse = m_inUse;
+	usage.elapsed = chrono::duration_cast<chrono::microseconds>(now - m_reset).count();
+	if (reset)
+	{
+		memset(&m_usage, 0, sizeof(m_usage));
+		m_usage.peakInUse = m_inUse;
+		m_reset = now;
+	}
+}
+
+/**
+ * Constructor for the autoscaler of a pool
+ *
+ * @param pool	The connection manager of the pool
+ */
+PoolAutoscaler::PoolAutoscaler(ConnectionPool *pool) : m_pool(pool),
+	m_thread(NULL), m_running(false), m_minimum(0), m_maximum(0), m_interval(0),
+	m_target(0), m_grown(0), m_shrunk(0)
+{
+	memset(&m_last, 0, sizeof(m_last));
+}
+
+/**
+ * Destructor for the autoscaler
+ */
+PoolAutoscaler::~PoolAutoscaler()
+{
+	stop();
+}
+
+/**
+ * Start the autoscaler thread
+ *
+ * @param minimum	The smallest size of the pool
+ * @param maximum	The largest size of the pool, 0 for no maximum
+ * @param interval	Seconds between the resizes of the pool
+ */
+void PoolAutoscaler::start(unsigned int minimum, unsigned int maximum, unsigned int interval)
+{
+	lock_guard<mutex> guard(m_mutex);
+	if (m_running)
+	{
+		return;
+	}
+	m_minimum = minimum;
+	m_maximum = (maximum && maximum < minimum) ? minimum : maximum;
+	m_interval = interval ? interval : 1;
+	// The usage of the first interval starts now
+	m_pool->poolUsage(m_last, true);
+	m_target = m_last.size;
+	m_running = true;
+	m_thread = new thread(&PoolAutoscaler::scaleThread, this);
+	if (m_maximum)
+	{
+		Logger::getLogger()->info("The connection pool will be resized every %u seconds, between %u and %u connections",
+				m_interval, m_minimum, m_maximum);
+	}
+	else
+	{
+		Logger::getLogger()->info("The connection pool will be resized every %u seconds, with at least %u connections",
+				m_interval, m_minimum);
+	}
+}
+
+/**
+ * Stop the autoscaler thread
+ */
+void PoolAutoscaler::stop()
+{
+	{
+		lock_guard<mutex> guard(m_mutex);
+		if (!m_running)
+		{
+			return;
+		}
+		m_running = false;
+	}
+	m_cv.notify_all();
+	m_thread->join();
+	delete m_thread;
+	m_thread = NULL;
+}
+
+/**
+ * The autoscaler thread
+ */
+void PoolAutoscaler::scaleThread()
+{
+	while (true)
+	{
+		{
+			unique_lock<mutex> lck(m_mutex);
+			m_cv.wait_for(lck, chrono::seconds(m_interval), [this]{ return !m_running; });
+			if (!m_running)
+			{
+				break;
+			}
+		}
+		scale();
+	}
+}
+
+/**
+ * Resize the pool from its usage since it was last resized, called
+ * by the autoscaler thread every interval
+ */
+void PoolAutoscaler::scale()
+{
+	POOL_USAGE usage;
+	m_pool->poolUsage(usage, true);
+
+	unsigned int needed = usage.peakInUse + usage.peakInUse * POOL_HEADROOM_PERCENT / 100 + 1;
+	unsigned int target = usage.size;
+	if (needed > usage.size)
+	{
+		target = needed;
+	}
+	else if (needed < usage.size && usage.waits == 0
+			&& usage.busyTime * 100 <= (double)usage.size * usage.elapsed * POOL_SHRINK_UTILISATION)
+	{
+		target = usage.size - (usage.size - needed + 1) / 2;
+	}
+	if (target < m_minimum)
+	{
+		target = m_minimum;
+	}
+	if (m_maximum && target > m_maximum)
+	{
+		target = m_maximum;
+	}
+
+	unsigned long grown = 0, shrunk = 0;
+	if (target > usage.size)
+	{
+		grown = target - usage.size;
+		m_pool->growPool(grown);
+	}
+	else if (target < usage.size)
+	{
+		shrunk = m_pool->shrinkPool(usage.size - target);
+	}
+	if (grown || shrunk)
+	{
+		Logger::getLogger()->debug("Connection pool resized from %u to %u connections, peak in use %u, %lu waits",
+				usage.size, (unsigned int)(usage.size + grown - shrunk),
+				usage.peakInUse, usage.waits);
+	}
+
+	lock_guard<mutex> guard(m_mutex);
+	m_last = usage;
+	m_target = target;
+	m_grown += grown;
+	m_shrunk += shrunk;
+}
+
+/**
+ * Return the usage of the pool and the work of the autoscaler. The
+ * usage is that of the last interval of the autoscaler, or since the
+ * plugin started if the autoscaler is not running.
+ *
+ * @param json	Set to the JSON object of the statistics
+ */
+void PoolAutoscaler::asJSON(string& json)
+{
+	POOL_USAGE current;
+	m_pool->poolUsage(current, false);
+
+	lock_guard<mutex> guard(m_mutex);
+	const POOL_USAGE& usage = m_running ? m_last : current;
+	double utilisation = 0.0;
+	if (usage.size && usage.elapsed)
+	{
+		utilisation = usage.busyTime * 100.0 / ((double)usage.size * usage.elapsed);
+	}
+	ostringstream convert;
+	convert << "{ \"size\" : " << current.size;
+	convert << ", \"inUse\" : " << current.inUse;
+	convert << ", \"peakInUse\" : " << usage.peakInUse;
+	convert << ", \"utilisation\" : " << utilisation;
+	convert << ", \"allocations\" : " << usage.allocations;
+	convert << ", \"waits\" : " << usage.waits;
+	convert << ", \"averageWait\" : " << (usage.waits ? usage.waitTime / usage.waits : 0);
+	convert << ", \"maxWait\" : " << usage.maxWait;
+	convert << ", \"autoscale\" : " << (m_running ? "true" : "false");
+	if (m_running)
+	{
+		convert << ", \"interval\" : " << m_interval;
+		convert << ", \"minimum\" : " << m_minimum;
+		convert << ", \"maximum\" : " << m_maximum;
+		convert << ", \"target\" : " << m_target;
+		convert << ", \"grown\" : " << m_grown;
+		convert << ", \"shrunk\" : " << m_shrunk;
+	}
+	convert << " }";
+	json = convert.str();
+}
@@ -0,0 +1,379 @@
+/*
+ * Fledge storage service.
+ *
+ * Copyright (c) 2026 Dianomic Systems
+ *
+ * Released under the Apache 2.0 Licence
+ *
+ * Author: agent
+ */
+#include <query_shape.h>
+#include <rapidjson/writer.h>
+#include <rapidjson/stringbuffer.h>
+#include <string.h>
+#include <ctype.h>
+#include <algorithm>
+
+using namespace std;
+using namespace rapidjson;
+
+/**
+ * The integer values are replaced by markers from this base, chosen to
+ * be unlikely to appear elsewhere in the SQL. A marker found more than
+ * once makes the shape uncacheable.
+ */
+#define INTEGER_MARKER_BASE	2130000000
+
+/**
+ * The conditions of a where clause whose value is a plain literal in the
+ * SQL, the values of the other conditions are part of the shape
+ */
+static const char *comparisons[] = {
+	"=", "!=", "<>", "<", ">", "<=", ">=", "like", "LIKE", NULL
+};
+
+/**
+ * Replace the literal values of the payload with markers and build the
+ * key of the shape of the query
+ *
+ * @param operation	The storage operation of the payload
+ * @param table		The table the payload applies to
+ */
+void QueryShape::extract(const char *operation, const string& table)
+{
+	m_parameters.clear();
+	if (m_payload.IsObject())
+	{
+		if (m_payload.HasMember("where"))
+		{
+			where(m_payload["where"]);
+		}
+		if (m_payload.HasMember("join"))
+		{
+			join(m_payload["join"]);
+		}
+		if (m_payload.HasMember("updates") && m_payload["updates"].IsArray())
+		{
+			for (auto& update : m_payload["updates"].GetArray())
+			{
+				if (!update.IsObject())
+				{
+					continue;
+				}
+				if (update.HasMember("values") && update["values"].IsObject())
+				{
+					for (auto& value : update["values"].GetObject())
+					{
+						literal(value.value);
+					}
+				}
+				if (update.HasMember("expressions") && update["expressions"].IsArray())
+				{
+					for (auto& expression : update["expressions"].GetArray())
+					{
+						if (expression.IsObject() && expression.HasMember("value"))
+						{
+							literal(expression["value"]);
+						}
+					}
+				}
+				if (update.HasMember("condition"))
+				{
+					where(update["condition"]);
+				}
+				else if (update.HasMember("where"))
+				{
+					where(update["where"]);
+				}
+			}
+		}
+	}
+
+	StringBuffer buffer;
+	Writer<StringBuffer> writer(buffer);
+	m_payload.Accept(writer);
+	m_key = operation;
+	m_key.append(":");
+	m_key.append(table);
+	m_key.append(":");
+	m_key.append(buffer.GetString(), buffer.GetSize());
+}
+
+/**
+ * Put the literal values back in the payload in place of the markers
+ */
+void QueryShape::restore()
+{
+	for (auto& parameter : m_parameters)
+	{
+		if (parameter.m_isString)
+		{
+			parameter.m_value->SetString(parameter.m_string.c_str(),
+					parameter.m_string.length(), m_payload.GetAllocator());
+		}
+		else
+		{
+			parameter.m_value->SetInt(parameter.m_integer);
+		}
+	}
+	m_parameters.clear();
+}
+
+/**
+ * Take the values of the comparisons out of a where clause and the
+ * clauses chained to it
+ *
+ * @param where	The where clause
+ */
+void QueryShape::where(Value& where)
+{
+	if (!where.IsObject())
+	{
+		return;
+	}
+	if (where.HasMember("condition") && where["condition"].IsString() && where.HasMember("value"))
+	{
+		const char *condition = where["condition"].GetString();
+		for (int i = 0; comparisons[i]; i++)
+		{
+			if (strcmp(condition, comparisons[i]) == 0)
+			{
+				literal(where["value"]);
+				break;
+			}
+		}
+	}
+	if (where.HasMember("and"))
+	{
+		QueryShape::where(where["and"]);
+	}
+	if (where.HasMember("or"))
+	{
+		QueryShape::where(where["or"]);
+	}
+}
+
+/**
+ * Take the values of the comparisons out of the where clause of the
+ * query of a joined table and of the tables joined to it, the SQL of
+ * joins with different values is then the same template
+ *
+ * @param join	The join clause
+ */
+void QueryShape::join(Value& join)
+{
+	if (!join.IsObject() || !join.HasMember("query") || !join["query"].IsObject())
+	{
+		return;
+	}
+	Value& query = join["query"];
+	if (query.HasMember("where"))
+	{
+		where(query["where"]);
+	}
+	if (query.HasMember("join"))
+	{
+		QueryShape::join(query["join"]);
+	}
+}
+
+/**
+ * Replace a literal value with the marker of a new parameter. Strings
+ * that may be functions, such as now(), and values that are not strings
+ * or integers are left in the payload.
+ *
+ * @param value	The value in the payload
+ */
+void QueryShape::literal(Value& value)
+{
+	QueryParameter parameter;
+
+	parameter.m_value = &value;
+	if (value.IsString())
+	{
+		if (strchr(value.GetString(), '('))
+		{
+			return;
+		}
+		parameter.m_isString = true;
+		parameter.m_string.assign(value.GetString(), value.GetStringLength());
+		parameter.m_integer = 0;
+		string text = marker(m_parameters.size());
+		value.SetString(text.c_str(), text.length(), m_payload.GetAllocator());
+	}
+	else if (value.IsInt())
+	{
+		parameter.m_isString = false;
+		parameter.m_integer = value.GetInt();
+		value.SetInt(INTEGER_MARKER_BASE + (int)m_parameters.size());
+	}
+	else
+	{
+		return;
+	}
+	m_parameters.push_back(parameter);
+}
+
+/**
+ * Return the marker of a parameter as it appears in the SQL
+ *
+ * @param parameter	The index of the parameter
+ * @return string	The marker, the string markers are without the quotes
+ */
+string QueryShape::marker(int parameter) const
+{
+	if (parameter < (int)m_parameters.size() && !m_parameters[parameter].m_isString)
+	{
+		return to_string(INTEGER_MARKER_BASE + parameter);
+	}
+	return "@@fledge_parameter_" + to_string(parameter) + "@@";
+}
+
+/**
+ * Turn the SQL built from the payload with the markers into the
+ * statements of the template of the shape. Each marker must appear
+ * exactly once in the SQL as a complete literal outside any quoted
+ * text, otherwise the literal is not a simple value of the SQL and the
+ * shape can not be cached.
+ *
+ * @param sql		The SQL built from the payload with the markers
+ * @param placeholder	The placeholders of the database
+ * @param statements	Set to the statements of the template
+ * @return bool		False if the SQL can not be turned into a template
+ */
+bool QueryShape::statements(const char *sql, Placeholder placeholder,
+			    vector<QueryStatement>& statements) const
+{
+	string text(sql);
+	vector<pair<size_t, int>> found;	// Position of each marker and its parameter
+
+	for (int i = 0; i < (int)m_parameters.size(); i++)
+	{
+		string mark = marker(i);
+		size_t pos = text.find(mark);
+		if (pos == string::npos || text.find(mark, pos + 1) != string::npos)
+		{
+			return false;
+		}
+		if (m_parameters[i].m_isString)
+		{
+			// The string must be a complete quoted literal
+			if (pos == 0 || text[pos - 1] != '\'' || text[pos + mark.length()] != '\'')
+			{
+				return false;
+			}
+			pos--;
+		}
+		else
+		{
+			char before = pos ? text[pos - 1] : ' ';
+			char after = text[pos + mark.length()];
+			if (isalnum(before) || strchr("_.-'\"", before)
+					|| (after && (isalnum(after) || strchr("_.'\"", after))))
+			{
+				return false;
+			}
+		}
+		found.push_back(make_pair(pos, i));
+	}
+	sort(found.begin(), found.end());
+
+	// Split the SQL into statements at the semicolons outside quoted text
+	statements.clear();
+	QueryStatement statement;
+	char quote = 0;
+	auto next = found.begin();
+	for (size_t pos = 0; pos < text.length(); pos++)
+	{
+		char c = text[pos];
+		if (next != found.end() && next->first == pos)
+		{
+			if (quote)
+			{
+				return false;
+			}
+			statement.m_parameters.push_back(next->second);
+			if (placeholder == PlaceholderDollar)
+			{
+				statement.m_sql.append("$" + to_string(statement.m_parameters.size()));
+			}
+			else
+			{
+				statement.m_sql.append("?");
+			}
+			string mark = marker(next->second);
+			pos += mark.length() + (m_parameters[next->second].m_isString ? 2 : 0) - 1;
+			++next;
+			continue;
+		}
+		if (quote)
+		{
+			if (c == quote)
+			{
+				quote = 0;
+			}
+		}
+		else if (c == '\'' || c == '"')
+		{
+			quote = c;
+		}
+		else if (c == ';')
+		{
+			if (statement.m_sql.find_first_not_of(" \t\n") != string::npos)
+			{
+				statements.push_back(statement);
+			}
+			statement.m_sql.clear();
+			statement.m_parameters.clear();
+			continue;
+		}
+		statement.m_sql.push_back(c);
+	}
+	if (statement.m_sql.find_first_not_of(" \t\n") != string::npos)
+	{
+		statements.push_back(statement);
+	}
+	return !statements.empty();
+}
+
+/**
+ * Return the template of a query shape
+ *
+ * @param key			The key of the shape
+ * @return QueryTemplate*	The template or NULL if the shape is not cached
+ */
+const QueryTemplate *QueryShapeCache::find(const string& key) const
+{
+	auto it = m_shapes.find(key);
+	if (it == m_shapes.end())
+	{
+		return NULL;
+	}
+	return &it->second;
+}
+
+/**
+ * Add the template of a query shape to the cache. The template remains
+ * valid until the cache is cleared.
+ *
+ * @param shape			The shape of the query
+ * @param sql			The SQL built from the payload with the markers
+ * @param placeholder		The placeholders of the database
+ * @return QueryTemplate*	The template added to the cache
+ */
+const QueryTemplate *QueryShapeCache::add(const QueryShape& shape, const char *sql,
+					  QueryShape::Placeholder placeholder)
+{
+	QueryTemplate& entry = m_shapes[shape.key()];
+
+	entry.m_cacheable = shape.statements(sql, placeholder, entry.m_statements);
+	if (!entry.m_cacheable)
+	{
+		entry.m_statements.clear();
+	}
+	for (auto& statement : entry.m_statements)
+	{
+		statement.m_id = m_nextId++;
+	}
+	return &entry;
+}
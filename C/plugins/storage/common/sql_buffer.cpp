@@ -9,6 +9,8 @@
  */
 #include <sql_buffer.h>
 #include <string.h>
+#include <stdio.h>
+#include <math.h>
 #include <string_utils.h>
 
 using namespace std;
@@ -17,6 +19,87 @@ using namespace std;
  * as required but have minimal copy semantics.
  */
 
+/**
+ * Write the decimal digits of an unsigned value
+ *
+ * @param buf	The buffer to write to, at least 20 characters
+ * @param value	The value to write
+ * @return	The number of characters written
+ */
+static unsigned int formatUnsigned(char *buf, unsigned long value)
+{
+char		digits[20];
+unsigned int	len = 0;
+
+	do {
+		digits[len++] = '0' + (value % 10);
+		value /= 10;
+	} while (value);
+	for (unsigned int i = 0; i < len; i++)
+	{
+		buf[i] = digits[len - i - 1];
+	}
+	return len;
+}
+
+/**
+ * Write the decimal digits of a signed value
+ *
+ * @param buf	The buffer to write to, at least 21 characters
+ * @param value	The value to write
+ * @return	The number of characters written
+ */
+static unsigned int formatSigned(char *buf, long value)
+{
+	if (value < 0)
+	{
+		buf[0] = '-';
+		return 1 + formatUnsigned(buf + 1, 0UL - (unsigned long)value);
+	}
+	return formatUnsigned(buf, (unsigned long)value);
+}
+
+/**
+ * Write a double with six decimal places, as the %f format of printf.
+ * Values whose rounding to six places is not certain from the scaled
+ * value, those close to half of the last place or too large for the
+ * scaled value to be exact enough, are written by snprintf.
+ *
+ * @param buf	The buffer to write to, at least 80 characters
+ * @param value	The value to write
+ * @return	The number of characters written
+ */
+static unsigned int formatDouble(char *buf, double value)
+{
+	double magnitude = fabs(value);
+	if (!(magnitude < 1e6))		// Also true for NaN
+	{
+		return (unsigned int)snprintf(buf, 80, "%f", value);
+	}
+	double scaled = magnitude * 1e6;
+	double fraction = scaled - floor(scaled);
+	if (fraction > 0.499 && fraction < 0.501)
+	{
+		return (unsigned int)snprintf(buf, 80, "%f", value);
+	}
+
+	unsigned long micros = (unsigned long)(scaled + 0.5);
+	unsigned int len = 0;
+	if (signbit(value))
+	{
+		buf[len++] = '-';
+	}
+	len += formatUnsigned(buf + len, micros / 1000000);
+	buf[len++] = '.';
+	unsigned long fractional = micros % 1000000;
+	for (int i = 5; i >= 0; i--)
+	{
+		buf[len + i] = '0' + (fractional % 10);
+		fractional /= 10;
+	}
+	return len + 6;
+}
+
 /**
  * SQLBuffer constructor
  */
@@ -25,6 +108,24 @@ SQLBuffer::SQLBuffer()
         buffers.push_front(new SQLBuffer::Buffer());
 }
 
+/**
+ * SQLBuffer constructor with a hint of the size of the SQL statement,
+ * a statement that fits within the hint is held in a single buffer
+ *
+ * @param sizeHint	The expected size of the SQL statement
+ */
+SQLBuffer::SQLBuffer(unsigned int sizeHint)
+{
+	if (sizeHint > BUFFER_CHUNK)
+	{
+		buffers.push_front(new SQLBuffer::Buffer(sizeHint));
+	}
+	else
+	{
+		buffers.push_front(new SQLBuffer::Buffer());
+	}
+}
+
 /**
  * SQLBuffer destructor
  */
@@ -36,6 +137,33 @@ SQLBuffer::~SQLBuffer()
 	}
 }
 
+/**
+ * Return the position at which to write data of a given length, adding
+ * a buffer to the chain if the last buffer does not have the space for
+ * the data and its terminating null
+ *
+ * @param len	The length of the data to write
+ * @return	The position in the last buffer of the chain
+ */
+char *SQLBuffer::space(unsigned int len)
+{
+SQLBuffer::Buffer *buffer = buffers.back();
+
+        if (buffer->offset + len >= buffer->length)
+        {
+		if (len > BUFFER_CHUNK)
+		{
+			buffer = new SQLBuffer::Buffer(len + BUFFER_CHUNK);
+		}
+		else
+		{
+			buffer = new SQLBuffer::Buffer();
+		}
+		buffers.push_back(buffer);
+	}
+	return &buffer->data[buffer->offset];
+}
+
 /**
  * Append a character to a buffer
  *
@@ -63,21 +191,10 @@ SQLBuffer::Buffer *buffer = buffers.back();
 void SQLBuffer::append(const char *data)
 {
 unsigned int len = strlen(data);
+char	*dest = space(len);
 SQLBuffer::Buffer *buffer = buffers.back();
 
-        if (buffer->offset + len >= buffer->length)
-        {
-		if (len > BUFFER_CHUNK)
-		{
-			buffer = new SQLBuffer::Buffer(len + BUFFER_CHUNK);
-		}
-		else
-		{
-			buffer = new SQLBuffer::Buffer();
-		}
-		buffers.push_back(buffer);
-	}
-	memcpy(&buffer->data[buffer->offset], data, len);
+	memcpy(dest, data, len);
 	buffer->offset += len;
 	buffer->data[buffer->offset] = 0;
 }
@@ -89,19 +206,7 @@ SQLBuffer::Buffer *buffer = buffers.back();
  */
 void SQLBuffer::append(const int value)
 {
-char	tmpbuf[80];
-unsigned int len;
-SQLBuffer::Buffer *buffer = buffers.back();
-
-	len = (unsigned int)snprintf(tmpbuf, 80, "%d", value);
-        if (buffer->offset + len >= buffer->length)
-        {
-		buffer = new SQLBuffer::Buffer();
-		buffers.push_back(buffer);
-	}
-	memcpy(&buffer->data[buffer->offset], tmpbuf, len);
-	buffer->offset += len;
-	buffer->data[buffer->offset] = 0;
+	append((const long)value);
 }
 
 /**
@@ -111,18 +216,10 @@ SQLBuffer::Buffer *buffer = buffers.back();
  */
 void SQLBuffer::append(const long value)
 {
-char	tmpbuf[80];
-unsigned int len;
+char	*dest = space(21);
 SQLBuffer::Buffer *buffer = buffers.back();
 
-	len = (unsigned int)snprintf(tmpbuf, 80, "%ld", value);
-        if (buffer->offset + len >= buffer->length)
-        {
-		buffer = new SQLBuffer::Buffer();
-		buffers.push_back(buffer);
-	}
-	memcpy(&buffer->data[buffer->offset], tmpbuf, len);
-	buffer->offset += len;
+	buffer->offset += formatSigned(dest, value);
 	buffer->data[buffer->offset] = 0;
 }
 
@@ -133,19 +230,7 @@ SQLBuffer::Buffer *buffer = buffers.back();
  */
 void SQLBuffer::append(const unsigned int value)
 {
-char	tmpbuf[80];
-unsigned int len;
-SQLBuffer::Buffer *buffer = buffers.back();
-
-	len = (unsigned int)snprintf(tmpbuf, 80, "%u", value);
-        if (buffer->offset + len >= buffer->length)
-        {
-		buffer = new SQLBuffer::Buffer();
-		buffers.push_back(buffer);
-	}
-	memcpy(&buffer->data[buffer->offset], tmpbuf, len);
-	buffer->offset += len;
-	buffer->data[buffer->offset] = 0;
+	append((const unsigned long)value);
 }
 
 /**
@@ -155,18 +240,10 @@ SQLBuffer::Buffer *buffer = buffers.back();
  */
 void SQLBuffer::append(const unsigned long value)
 {
-char	tmpbuf[80];
-unsigned int len;
+char	*dest = space(20);
 SQLBuffer::Buffer *buffer = buffers.back();
 
-	len = (unsigned int)snprintf(tmpbuf, 80, "%lu", value);
-        if (buffer->offset + len >= buffer->length)
-        {
-		buffer = new SQLBuffer::Buffer();
-		buffers.push_back(buffer);
-	}
-	memcpy(&buffer->data[buffer->offset], tmpbuf, len);
-	buffer->offset += len;
+	buffer->offset += formatUnsigned(dest, value);
 	buffer->data[buffer->offset] = 0;
 }
 
@@ -179,15 +256,11 @@ void SQLBuffer::append(const double value)
 {
 char	tmpbuf[80];
 unsigned int len;
-SQLBuffer::Buffer *buffer = buffers.back();
 
-	len = (unsigned int)snprintf(tmpbuf, 80, "%f", value);
-        if (buffer->offset + len >= buffer->length)
-        {
-		buffer = new SQLBuffer::Buffer();
-		buffers.push_back(buffer);
-	}
-	memcpy(&buffer->data[buffer->offset], tmpbuf, len);
+	len = formatDouble(tmpbuf, value);
+	char *dest = space(len);
+	SQLBuffer::Buffer *buffer = buffers.back();
+	memcpy(dest, tmpbuf, len);
 	buffer->offset += len;
 	buffer->data[buffer->offset] = 0;
 }
@@ -201,21 +274,10 @@ void SQLBuffer::append(const string& str)
 {
 const char	*cstr = str.c_str();
 unsigned int len = strlen(cstr);
+char	*dest = space(len);
 SQLBuffer::Buffer *buffer = buffers.back();
 
-        if (buffer->offset + len >= buffer->length)
-        {
-		if (len > BUFFER_CHUNK)
-		{
-			buffer = new SQLBuffer::Buffer(len + BUFFER_CHUNK);
-		}
-		else
-		{
-			buffer = new SQLBuffer::Buffer();
-		}
-		buffers.push_back(buffer);
-	}
-	memcpy(&buffer->data[buffer->offset], cstr, len);
+	memcpy(dest, cstr, len);
 	buffer->offset += len;
 	buffer->data[buffer->offset] = 0;
 }
@@ -231,25 +293,86 @@ string esc = str;
 StringEscapeQuotes(esc);
 const char	*cstr = esc.c_str();
 unsigned int len = strlen(cstr) + 2;
+char	*dest = space(len);
 SQLBuffer::Buffer *buffer = buffers.back();
 
-        if (buffer->offset + len >= buffer->length)
-        {
-		if (len > BUFFER_CHUNK)
+	dest[0] = '"';
+	memcpy(&dest[1], cstr, len - 2);
+	dest[len - 1] = '"';
+	buffer->offset += len;
+	buffer->data[buffer->offset] = 0;
+}
+
+/**
+ * Make sure the data appended next, up to the given size, is held in
+ * the same buffer as the data that precedes it if the buffer is empty,
+ * or in a single new buffer otherwise
+ *
+ * @param size	The size of the data that will be appended
+ */
+void SQLBuffer::reserve(unsigned int size)
+{
+SQLBuffer::Buffer *buffer = buffers.back();
+
+	if (buffer->offset + size < buffer->length)
+	{
+		return;
+	}
+	if (buffer->offset == 0 && buffer->attached)
+	{
+		delete buffer;
+		buffers.pop_back();
+	}
+	buffers.push_back(new SQLBuffer::Buffer(size > BUFFER_CHUNK ? size : BUFFER_CHUNK));
+}
+
+/**
+ * Empty the buffer so that it can be reused for another statement. The
+ * largest buffer of the chain is kept, a statement no larger than the
+ * previous one is then held in a single buffer without any allocation.
+ */
+void SQLBuffer::clear()
+{
+SQLBuffer::Buffer *largest = NULL;
+
+	for (list<SQLBuffer::Buffer *>::iterator it = buffers.begin(); it != buffers.end(); ++it)
+	{
+		if ((*it)->attached && (!largest || (*it)->length > largest->length))
 		{
-			buffer = new SQLBuffer::Buffer(len + BUFFER_CHUNK);
+			largest = *it;
 		}
-		else
+	}
+	for (list<SQLBuffer::Buffer *>::iterator it = buffers.begin(); it != buffers.end(); ++it)
+	{
+		if (*it != largest)
 		{
-			buffer = new SQLBuffer::Buffer();
+			delete *it;
 		}
-		buffers.push_back(buffer);
 	}
-	buffer->data[buffer->offset] = '"';
-	memcpy(&buffer->data[buffer->offset + 1], cstr, len - 2);
-	buffer->data[buffer->offset + len - 1] = '"';
-	buffer->offset += len;
-	buffer->data[buffer->offset] = 0;
+	buffers.clear();
+	if (!largest)
+	{
+		largest = new SQLBuffer::Buffer();
+	}
+	largest->offset = 0;
+	largest->data[0] = 0;
+	buffers.push_back(largest);
+}
+
+/**
+ * Return the length of the SQL statement held in the buffer
+ *
+ * @return	The length of the statement
+ */
+unsigned int SQLBuffer::length() const
+{
+unsigned int length = 0;
+
+	for (list<SQLBuffer::Buffer *>::const_iterator it = buffers.begin(); it != buffers.end(); ++it)
+	{
+		length += (*it)->offset;
+	}
+	return length;
 }
 
 /**
@@ -282,6 +405,57 @@ char	     *buffer = 0;
 	return buffer;
 }
 
+/**
+ * Return the SQL statement held in the buffer as a null terminated
+ * string without handing over its ownership. A chain of buffers is
+ * first replaced by a single buffer, a statement held in a single
+ * buffer is returned without any copy.
+ *
+ * The string remains owned by the SQLBuffer and is valid until the
+ * next change to the SQLBuffer.
+ * @return char* The SQL statement
+ */
+const char *SQLBuffer::c_str()
+{
+	if (buffers.size() > 1)
+	{
+		unsigned int len = length();
+		SQLBuffer::Buffer *single = new SQLBuffer::Buffer(len);
+		for (list<SQLBuffer::Buffer *>::iterator it = buffers.begin(); it != buffers.end(); ++it)
+		{
+			memcpy(&single->data[single->offset], (*it)->data, (*it)->offset);
+			single->offset += (*it)->offset;
+			delete *it;
+		}
+		single->data[single->offset] = 0;
+		buffers.clear();
+		buffers.push_back(single);
+	}
+	return buffers.back()->data;
+}
+
+/**
+ * Return the segments of the SQL statement held in the chain of buffers,
+ * for consumers that write the statement without needing it in a single
+ * buffer. The segments remain valid until the next change to the SQLBuffer.
+ *
+ * @param vec	Set to the segments of the statement
+ */
+void SQLBuffer::iov(vector<struct iovec>& vec) const
+{
+	vec.clear();
+	for (list<SQLBuffer::Buffer *>::const_iterator it = buffers.begin(); it != buffers.end(); ++it)
+	{
+		if ((*it)->offset)
+		{
+			struct iovec segment;
+			segment.iov_base = (*it)->data;
+			segment.iov_len = (*it)->offset;
+			vec.push_back(segment);
+		}
+	}
+}
+
 /**
  * Construct a buffer with a standard size initial buffer.
  */
@@ -0,0 +1,224 @@
+/*
+ * Fledge storage service.
+ *
+ * Copyright (c) 2026 Dianomic Systems
+ *
+ * Released under the Apache 2.0 Licence
+ *
+ * Author: agent
+ */
+#include <storage_profile.h>
+#include <json_utils.h>
+#include <sstream>
+#include <time.h>
+#include <string.h>
+#include <algorithm>
+
+using namespace std;
+
+/**
+ * The upper bound in microseconds of each latency bucket, the last
+ * bucket holds the operations above the last bound
+ */
+static const unsigned long bucketBounds[PROFILE_BUCKETS - 1] = {
+	100, 500, 1000, 5000, 10000, 50000, 100000,
+	500000, 1000000, 5000000, 10000000
+};
+
+/**
+ * The names of the operations in the JSON document
+ */
+static const char *operationNames[ProfileOperations] = {
+	"insert", "query", "update", "delete",
+	"append", "fetch", "readingQuery", "purge"
+};
+
+StorageProfile *StorageProfile::m_instance = 0;
+
+/**
+ * Constructor for the storage profile
+ */
+StorageProfile::StorageProfile()
+{
+	reset();
+}
+
+/**
+ * Return the singleton instance of the storage profile
+ *
+ * @return StorageProfile*	The storage profile
+ */
+StorageProfile *StorageProfile::getInstance()
+{
+	static mutex instanceMutex;
+	lock_guard<mutex> guard(instanceMutex);
+	if (m_instance == 0)
+	{
+		m_instance = new StorageProfile();
+	}
+	return m_instance;
+}
+
+/**
+ * Record the duration of an operation of a storage plugin
+ *
+ * @param op	The operation
+ * @param usecs	The duration of the operation in microseconds
+ */
+void StorageProfile::operation(ProfileOperation op, unsigned long usecs)
+{
+	int bucket = 0;
+	while (bucket < PROFILE_BUCKETS - 1 && usecs >= bucketBounds[bucket])
+	{
+		bucket++;
+	}
+	m_buckets[op][bucket]++;
+	m_count[op]++;
+	m_total[op] += usecs;
+	unsigned long max = m_max[op];
+	while (usecs > max && !m_max[op].compare_exchange_weak(max, usecs))
+		;
+}
+
+/**
+ * Record the duration of a SQL statement. The statement is kept if it
+ * is slower than one of the slowest statements kept, replacing the
+ * fastest of these.
+ *
+ * @param sql	The SQL text of the statement
+ * @param usecs	The duration of the statement in microseconds
+ */
+void StorageProfile::statement(const char *sql, unsigned long usecs)
+{
+	if (!sql || usecs <= m_slowFloor)
+	{
+		return;
+	}
+
+	lock_guard<mutex> guard(m_mutex);
+	SlowStatement slow;
+	slow.m_usecs = usecs;
+	slow.m_time = time(0);
+	slow.m_sql.assign(sql, strnlen(sql, PROFILE_SQL_LENGTH));
+	if (m_slow.size() < PROFILE_SLOW_STATEMENTS)
+	{
+		m_slow.push_back(slow);
+		if (m_slow.size() < PROFILE_SLOW_STATEMENTS)
+		{
+			return;
+		}
+	}
+	else
+	{
+		int fastest = 0;
+		for (int i = 1; i < (int)m_slow.size(); i++)
+		{
+			if (m_slow[i].m_usecs < m_slow[fastest].m_usecs)
+			{
+				fastest = i;
+			}
+		}
+		if (usecs <= m_slow[fastest].m_usecs)
+		{
+			return;
+		}
+		m_slow[fastest] = slow;
+	}
+
+	// Only the statements slower than those kept now take the lock
+	unsigned long floor = m_slow[0].m_usecs;
+	for (auto& s : m_slow)
+	{
+		if (s.m_usecs < floor)
+		{
+			floor = s.m_usecs;
+		}
+	}
+	m_slowFloor = floor;
+}
+
+/**
+ * Clear the profile
+ */
+void StorageProfile::reset()
+{
+	for (int op = 0; op < ProfileOperations; op++)
+	{
+		for (int b = 0; b < PROFILE_BUCKETS; b++)
+		{
+			m_buckets[op][b] = 0;
+		}
+		m_count[op] = 0;
+		m_total[op] = 0;
+		m_max[op] = 0;
+	}
+	lock_guard<mutex> guard(m_mutex);
+	m_slow.clear();
+	m_slowFloor = 0;
+}
+
+/**
+ * Return the profile as a JSON document. Each operation has its count,
+ * average and maximum duration and the histogram of the durations, the
+ * durations are in microseconds.
+ *
+ * @param json	Set to the JSON document
+ */
+void StorageProfile::asJSON(string& json)
+{
+ostringstream convert;
+
+	convert << "{ \"operations\" : { ";
+	for (int op = 0; op < ProfileOperations; op++)
+	{
+		unsigned long count = m_count[op];
+		if (op)
+		{
+			convert << ", ";
+		}
+		convert << "\"" << operationNames[op] << "\" : { ";
+		convert << "\"count\" : " << count << ", ";
+		convert << "\"average\" : " << (count ? m_total[op] / count : 0) << ", ";
+		convert << "\"max\" : " << m_max[op] << ", ";
+		convert << "\"histogram\" : { ";
+		for (int b = 0; b < PROFILE_BUCKETS; b++)
+		{
+			if (b)
+			{
+				convert << ", ";
+			}
+			if (b < PROFILE_BUCKETS - 1)
+			{
+				convert << "\"<" << bucketBounds[b] << "\" : ";
+			}
+			else
+			{
+				convert << "\">=" << bucketBounds[b - 1] << "\" : ";
+			}
+			convert << m_buckets[op][b];
+		}
+		convert << " } }";
+	}
+	convert << " }, \"slowStatements\" : [ ";
+
+	lock_guard<mutex> guard(m_mutex);
+	vector<SlowStatement> slow(m_slow);
+	sort(slow.begin(), slow.end(), [](const SlowStatement& a, const SlowStatement& b)
+			{ return a.m_usecs > b.m_usecs; });
+	for (int i = 0; i < (int)slow.size(); i++)
+	{
+		char ts[40];
+		struct tm tm;
+		gmtime_r(&slow[i].m_time, &tm);
+		strftime(ts, sizeof(ts), "%Y-%m-%d %H:%M:%S", &tm);
+		if (i)
+		{
+			convert << ", ";
+		}
+		convert << "{ \"duration\" : " << slow[i].m_usecs << ", ";
+		convert << "\"timestamp\" : \"" << ts << "\", ";
+		convert << "\"sql\" : \"" << JSONescape(slow[i].m_sql) << "\" }";
+	}
+	convert << " ] }";
+	json = convert.str();
+}
@@ -10,6 +10,10 @@
 #include <connection.h>
 #include <connection_manager.h>
 #include <sql_buffer.h>
+#include <payload_document.h>
+#include <storage_profile.h>
+#include <reading_stream_payload.h>
+#include <tracer.h>
 #include <iostream>
 #include <libpq-fe.h>
 #include "rapidjson/document.h"
@@ -21,6 +25,7 @@
 #include <vector>
 #include <stdarg.h>
 #include <stdlib.h>
+#include <string.h>
 #include <sstream>
 #include <logger.h>
 #include <time.h>
@@ -301,7 +306,7 @@ bool Connection::aggregateQuery(const Value& payload, string& resultSet)
 
 	logSQL("CommonRetrieve", query);
 
-	PGresult *res = PQexec(dbConnection, query);
+	PGresult *res = timedExec(query);
 
 	delete[] query;
 
@@ -324,10 +329,14 @@ bool Connection::aggregateQuery(const Value& payload, string& resultSet)
 	return false;
 }
 
+unsigned long Connection::m_partitionSize = 0;
+atomic<unsigned long> Connection::m_partitionAppended(0);
+mutex Connection::m_partitionMutex;
+
 /**
  * Create a database connection
  */
-Connection::Connection()
+Connection::Connection() : m_logSQL(false), m_copyReadings(true)
 {
 	const char *defaultConninfo = "dbname = fledge";
 	char *connInfo = NULL;
@@ -367,9 +376,12 @@ Connection::~Connection()
  */
 bool Connection::retrieve(const string& table, const string& condition, string& resultSet)
 {
-Document document;  // Default template parameter uses UTF8 and MemoryPoolAllocator.
+PayloadDocument payloadDoc;
+Document& document = payloadDoc.get();
 SQLBuffer	sql;
 SQLBuffer	jsonConstraints;	// Extra constraints to add to where clause
+QueryShape	shape(document);
+const QueryTemplate *shapeTemplate = NULL;
 
 	try {
 		if (condition.empty())
@@ -379,11 +391,41 @@ SQLBuffer	jsonConstraints;	// Extra constraints to add to where clause
 		}
 		else
 		{
-			if (document.Parse(condition.c_str()).HasParseError())
+			if (payloadDoc.parse(condition.c_str()).HasParseError())
 			{
 				raiseError("retrieve", "Failed to parse JSON payload");
 				return false;
 			}
+
+			// A query of a shape already seen executes the SQL template of the shape
+			shape.extract("retrieve", table);
+			shapeTemplate = m_shapes.find(shape.key());
+			if (shapeTemplate && shapeTemplate->m_cacheable)
+			{
+				PGresult *res = execShape(shapeTemplate, shape);
+				if (PQresultStatus(res) == PGRES_TUPLES_OK)
+				{
+					mapResultSet(res, resultSet);
+					PQclear(res);
+					return true;
+				}
+				char *SQLState = PQresultErrorField(res, PG_DIAG_SQLSTATE);
+				if (SQLState && !strcmp(SQLState, "22P02"))	// Conversion error
+				{
+					raiseError("retrieve", "Unable to convert data to the required type");
+				}
+				else
+				{
+					raiseError("retrieve", PQresultErrorMessage(res));
+				}
+				PQclear(res);
+				return false;
+			}
+			else if (shapeTemplate)
+			{
+				shape.restore();
+			}
+
 			if (document.HasMember("aggregate"))
 			{
 				sql.append("SELECT ");
@@ -522,9 +564,7 @@ SQLBuffer	jsonConstraints;	// Extra constraints to add to where clause
 				if (! jsonConstraints.isEmpty())
 				{
 					sql.append(" AND ");
-					const char *jsonBuf =  jsonConstraints.coalesce();
-					sql.append(jsonBuf);
-					delete[] jsonBuf;
+					sql.append(jsonConstraints.c_str());
 				}
 			}
 			if (!jsonModifiers(document, sql))
@@ -534,11 +574,17 @@ SQLBuffer	jsonConstraints;	// Extra constraints to add to where clause
 		}
 		sql.append(';');
 
-		const char *query = sql.coalesce();
+		const char *query = sql.c_str();
+		if (shape.extracted() && !shapeTemplate)
+		{
+			// The SQL of a new shape has the markers of the literal
+			// values, the query is executed again using the new shape
+			cacheShape(shape, query);
+			return retrieve(table, condition, resultSet);
+		}
 		logSQL("CommonRetrieve", query);
 
-		PGresult *res = PQexec(dbConnection, query);
-		delete[] query;
+		PGresult *res = timedExec(query);
 		if (PQresultStatus(res) == PGRES_TUPLES_OK)
 		{
 			mapResultSet(res, resultSet);
@@ -569,7 +615,8 @@ SQLBuffer	jsonConstraints;	// Extra constraints to add to where clause
  */
 bool Connection::retrieveReadings(const string& condition, string& resultSet)
 {
-	Document document;  // Default template parameter uses UTF8 and MemoryPoolAllocator.
+	PayloadDocument payloadDoc;
+	Document& document = payloadDoc.get();
 	SQLBuffer	sql;
 	SQLBuffer	jsonConstraints;	// Extra constraints to add to where clause
 
@@ -592,7 +639,7 @@ bool Connection::retrieveReadings(const string& condition, string& resultSet)
 		}
 		else
 		{
-			if (document.Parse(condition.c_str()).HasParseError())
+			if (payloadDoc.parse(condition.c_str()).HasParseError())
 			{
 				raiseError("retrieve", "Failed to parse JSON payload");
 				return false;
@@ -801,7 +848,7 @@ bool Connection::retrieveReadings(const string& condition, string& resultSet)
 		const char *query = sql.coalesce();
 		logSQL("CommonRetrieve", query);
 
-		PGresult *res = PQexec(dbConnection, query);
+		PGresult *res = timedExec(query);
 		delete[] query;
 		if (PQresultStatus(res) == PGRES_TUPLES_OK)
 		{
@@ -832,8 +879,9 @@ bool Connection::retrieveReadings(const string& condition, string& resultSet)
  */
 int Connection::insert(const std::string& table, const std::string& data)
 {
-SQLBuffer	sql;
-Document	document;
+SQLBuffer	sql(data.length() + BUFFER_CHUNK);	// The statement is about the size of the payload
+PayloadDocument	payloadDoc;
+Document&	document = payloadDoc.get();
 ostringstream convert;
 std::size_t arr = data.find("inserts");
 
@@ -848,7 +896,7 @@ std::size_t arr = data.find("inserts");
 		convert << " ] }";
 	}
 
-	if (document.Parse(stdInsert ? convert.str().c_str() : data.c_str()).HasParseError())
+	if (payloadDoc.parse(stdInsert ? convert.str().c_str() : data.c_str()).HasParseError())
 	{
 		raiseError("insert", "Failed to parse JSON payload\n");
 		return -1;
@@ -932,19 +980,16 @@ std::size_t arr = data.find("inserts");
 			col++;
 		}
 		sql.append(") VALUES (");
-		const char *vals = values.coalesce();
-		sql.append(vals);
-		delete[] vals;
+		sql.append(values.c_str());
 		sql.append(");");
 
 		// Increment row count
 		ins++;
 	}
 
-	const char *query = sql.coalesce();
+	const char *query = sql.c_str();
 	logSQL("CommonInsert", query);
-	PGresult *res = PQexec(dbConnection, query);
-	delete[] query;
+	PGresult *res = timedExec(query);
 	if (PQresultStatus(res) == PGRES_COMMAND_OK)
 	{
 		PQclear(res);
@@ -961,9 +1006,11 @@ std::size_t arr = data.find("inserts");
  */
 int Connection::update(const string& table, const string& payload)
 {
-// Default template parameter uses UTF8 and MemoryPoolAllocator.
-Document	document;
+PayloadDocument	payloadDoc;
+Document&	document = payloadDoc.get();
 SQLBuffer	sql;
+QueryShape	shape(document);
+const QueryTemplate *shapeTemplate = NULL;
 
 	int 	row = 0;
 	ostringstream convert;
@@ -977,7 +1024,7 @@ SQLBuffer	sql;
 		convert << " ] }";
 	}
 
-	if (document.Parse(changeReqd?convert.str().c_str():payload.c_str()).HasParseError())
+	if (payloadDoc.parse(changeReqd?convert.str().c_str():payload.c_str()).HasParseError())
 	{
 		raiseError("update", "Failed to parse JSON payload");
 		return -1;
@@ -990,6 +1037,38 @@ SQLBuffer	sql;
 			raiseError("update", "Payload is missing the updates array");
 			return -1;
 		}
+
+		int rows;
+		if (updateStatistics(table, updates, rows))
+		{
+			return rows;
+		}
+
+		// An update of a shape already seen executes the SQL template of the shape
+		shape.extract("update", table);
+		shapeTemplate = m_shapes.find(shape.key());
+		if (shapeTemplate && shapeTemplate->m_cacheable)
+		{
+			PGresult *res = execShape(shapeTemplate, shape);
+			if (PQresultStatus(res) == PGRES_COMMAND_OK)
+			{
+				rows = atoi(PQcmdTuples(res));
+				PQclear(res);
+				if (rows == 0)
+				{
+					raiseError("update", "No rows where updated");
+					return -1;
+				}
+				return rows;
+			}
+			raiseError("update", PQresultErrorMessage(res));
+			PQclear(res);
+			return -1;
+		}
+		else if (shapeTemplate)
+		{
+			shape.restore();
+		}
 		
 		int i=0;
 		for (Value::ConstValueIterator iter = updates.Begin(); iter != updates.End(); ++iter,++i)
@@ -1277,10 +1356,16 @@ SQLBuffer	sql;
 		}
 	}
 
-	const char *query = sql.coalesce();
+	const char *query = sql.c_str();
+	if (shape.extracted() && !shapeTemplate)
+	{
+		// The SQL of a new shape has the markers of the literal
+		// values, the update is executed again using the new shape
+		cacheShape(shape, query);
+		return update(table, payload);
+	}
 	logSQL("CommonUpdate", query);
-	PGresult *res = PQexec(dbConnection, query);
-	delete[] query;
+	PGresult *res = timedExec(query);
 	if (PQresultStatus(res) == PGRES_COMMAND_OK)
 	{
 		if (atoi(PQcmdTuples(res)) == 0)
@@ -1296,27 +1381,252 @@ SQLBuffer	sql;
 	return -1;
 }
 
+/**
+ * The update of the statistics by the services is a single numeric
+ * increment of the value of a key. These are executed as a prepared
+ * statement rather than building, escaping and planning a new UPDATE
+ * each time. A batch of increments is pipelined if libpq supports it,
+ * otherwise it is left to the generic update as is any other update.
+ *
+ * @param table		The table to update
+ * @param updates	The updates array of the payload
+ * @param rows		Set to the number of rows updated or -1 on error
+ * @return bool		True if the updates have been executed, false if they
+ *			are left to the generic update
+ */
+bool Connection::updateStatistics(const string& table, const Value& updates, int& rows)
+{
+	if (table.compare("fledge.statistics") != 0 || updates.Size() == 0)
+	{
+		return false;
+	}
+
+	vector<vector<string>> increments;
+	for (Value::ConstValueIterator iter = updates.Begin(); iter != updates.End(); ++iter)
+	{
+		if (!iter->IsObject() || iter->MemberCount() != 2
+				|| !iter->HasMember("where") || !iter->HasMember("expressions"))
+		{
+			return false;
+		}
+		const Value& where = (*iter)["where"];
+		const Value& exprs = (*iter)["expressions"];
+		if (!where.IsObject() || where.MemberCount() != 3
+				|| !where.HasMember("column") || !where["column"].IsString()
+				|| strcmp(where["column"].GetString(), "key") != 0
+				|| !where.HasMember("condition") || !where["condition"].IsString()
+				|| strcmp(where["condition"].GetString(), "=") != 0
+				|| !where.HasMember("value") || !where["value"].IsString())
+		{
+			return false;
+		}
+		if (!exprs.IsArray() || exprs.Size() != 1)
+		{
+			return false;
+		}
+		const Value& expr = exprs[0];
+		if (!expr.IsObject() || !expr.HasMember("column") || !expr["column"].IsString()
+				|| strcmp(expr["column"].GetString(), "value") != 0
+				|| !expr.HasMember("operator") || !expr["operator"].IsString()
+				|| strcmp(expr["operator"].GetString(), "+") != 0
+				|| !expr.HasMember("value") || !expr["value"].IsInt64())
+		{
+			return false;
+		}
+		increments.push_back({ to_string(expr["value"].GetInt64()), where["value"].GetString() });
+	}
+
+	const char *sql = "UPDATE fledge.statistics SET value = value + $1 WHERE key = $2;";
+	if (increments.size() > 1)
+	{
+		// Several increments are pipelined, executing them one by one
+		// would cost a round trip each. Without pipelining the generic
+		// update sends them all in a single batched statement.
+#ifdef LIBPQ_HAS_PIPELINING
+		if (!pipelinePrepared("statistics_update", sql, increments, rows))
+		{
+			return false;
+		}
+#else
+		return false;
+#endif
+	}
+	else
+	{
+		PGresult *res = execPrepared("statistics_update", sql, increments[0]);
+		if (PQresultStatus(res) != PGRES_COMMAND_OK)
+		{
+			raiseError("update", PQerrorMessage(dbConnection));
+			rows = -1;
+		}
+		else
+		{
+			rows = atoi(PQcmdTuples(res));
+		}
+		PQclear(res);
+	}
+
+	if (rows == 0)
+	{
+		// As the generic update, reported on the last update only
+		raiseError("update", "No rows where updated");
+		rows = -1;
+	}
+	return true;
+}
+
+#ifdef LIBPQ_HAS_PIPELINING
+/**
+ * Execute a prepared statement once for each set of parameters using
+ * the pipeline mode of libpq. The executions are sent back to back and
+ * their results read after each block of PIPELINE_BLOCK_SIZE commands,
+ * rather than waiting for a round trip to the server per execution.
+ * All the executions run in a single transaction, rolled back on the
+ * first error.
+ *
+ * @param name		The name of the prepared statement
+ * @param sql		The SQL of the statement, prepared on first use
+ * @param params	The parameters of each execution
+ * @param rows		Set to the rows affected by the last execution or -1 on error
+ * @return bool		False if the connection could not enter pipeline mode,
+ *			in which case nothing has been executed
+ */
+bool Connection::pipelinePrepared(const char *name, const char *sql,
+				  const vector<vector<string>>& params, int& rows)
+{
+	if (params.empty() || !PQenterPipelineMode(dbConnection))
+	{
+		return false;
+	}
+
+	bool failed = false;
+	int prepareIndex = -1;	// Position of the prepare in the current block
+	int commands = 0;
+	rows = 0;
+
+	// Read the results of the commands sent since the last synchronisation
+	auto sync = [&]() {
+		PQpipelineSync(dbConnection);
+		for (int i = 0; i < commands; i++)
+		{
+			PGresult *res = PQgetResult(dbConnection);
+			if (PQresultStatus(res) == PGRES_COMMAND_OK)
+			{
+				if (i == prepareIndex)
+				{
+					m_prepared.insert(name);
+				}
+				else if (*PQcmdTuples(res))
+				{
+					rows = atoi(PQcmdTuples(res));
+				}
+			}
+			else if (!failed)
+			{
+				// The commands following an error are aborted
+				raiseError("update", PQresultErrorMessage(res));
+				failed = true;
+			}
+			PQclear(res);
+			PQclear(PQgetResult(dbConnection));	// End of the results of the command
+		}
+		PQclear(PQgetResult(dbConnection));		// The synchronisation point
+		commands = 0;
+		prepareIndex = -1;
+	};
+
+	PQsendQueryParams(dbConnection, "BEGIN;", 0, NULL, NULL, NULL, NULL, 0);
+	commands++;
+	if (m_prepared.find(name) == m_prepared.end())
+	{
+		PQsendPrepare(dbConnection, name, sql, params[0].size(), NULL);
+		prepareIndex = commands++;
+	}
+
+	vector<const char *> values;
+	for (auto& param : params)
+	{
+		values.clear();
+		for (auto& value : param)
+		{
+			values.push_back(value.c_str());
+		}
+		PQsendQueryPrepared(dbConnection, name, values.size(), values.data(), NULL, NULL, 0);
+		if (++commands >= PIPELINE_BLOCK_SIZE)
+		{
+			sync();
+			if (failed)
+			{
+				break;
+			}
+		}
+	}
+	PQsendQueryParams(dbConnection, failed ? "ROLLBACK;" : "COMMIT;", 0, NULL, NULL, NULL, NULL, 0);
+	commands++;
+	sync();
+
+	if (!PQexitPipelineMode(dbConnection))
+	{
+		Logger::getLogger()->error("Failed to leave the pipeline mode: %s", PQerrorMessage(dbConnection));
+	}
+	if (failed)
+	{
+		// An error in the last block also aborts the COMMIT
+		if (PQtransactionStatus(dbConnection) != PQTRANS_IDLE)
+		{
+			PQclear(timedExec("ROLLBACK;"));
+		}
+		rows = -1;
+	}
+	return true;
+}
+#endif
+
 /**
  * Perform a delete against a common table
  *
  */
 int Connection::deleteRows(const string& table, const string& condition)
 {
-Document document;  // Default template parameter uses UTF8 and MemoryPoolAllocator.
+PayloadDocument payloadDoc;
+Document& document = payloadDoc.get();
 SQLBuffer	sql;
+QueryShape	shape(document);
+const QueryTemplate *shapeTemplate = NULL;
  
 	sql.append("DELETE FROM ");
 	sql.append(table);
 	if (! condition.empty())
 	{
 		sql.append(" WHERE ");
-		if (document.Parse(condition.c_str()).HasParseError())
+		if (payloadDoc.parse(condition.c_str()).HasParseError())
 		{
 			raiseError("delete", "Failed to parse JSON payload");
 			return -1;
 		}
 		else
 		{
+			// A delete of a shape already seen executes the SQL template of the shape
+			shape.extract("delete", table);
+			shapeTemplate = m_shapes.find(shape.key());
+			if (shapeTemplate && shapeTemplate->m_cacheable)
+			{
+				PGresult *res = execShape(shapeTemplate, shape);
+				if (PQresultStatus(res) == PGRES_COMMAND_OK)
+				{
+					int rows = atoi(PQcmdTuples(res));
+					PQclear(res);
+					return rows;
+				}
+				raiseError("delete", PQresultErrorMessage(res));
+				PQclear(res);
+				return -1;
+			}
+			else if (shapeTemplate)
+			{
+				shape.restore();
+			}
+
 			if (document.HasMember("where"))
 			{
 				if (!jsonWhereClause(document["where"], sql))
@@ -1333,10 +1643,16 @@ SQLBuffer	sql;
 	}
 	sql.append(';');
 
-	const char *query = sql.coalesce();
+	const char *query = sql.c_str();
+	if (shape.extracted() && !shapeTemplate)
+	{
+		// The SQL of a new shape has the markers of the literal
+		// values, the delete is executed again using the new shape
+		cacheShape(shape, query);
+		return deleteRows(table, condition);
+	}
 	logSQL("CommonDelete", query);
-	PGresult *res = PQexec(dbConnection, query);
-	delete[] query;
+	PGresult *res = timedExec(query);
 	if (PQresultStatus(res) == PGRES_COMMAND_OK)
 	{
 		PQclear(res);
@@ -1464,25 +1780,53 @@ bool Connection::formatDate(char *formatted_date, size_t buffer_size, const char
 }
 
 
+/**
+ * Check a reading of an appendReadings payload has the members that are
+ * written to the readings table
+ *
+ * @param reading	The reading from the readings array
+ * @return const char*	The reason the reading is invalid or NULL if it is valid
+ */
+static const char *invalidReading(const Value& reading)
+{
+	if (!reading.IsObject())
+	{
+		return "Each reading in the readings array must be an object";
+	}
+	if (!reading.HasMember("user_ts") || !reading["user_ts"].IsString())
+	{
+		return "Each reading must have a user_ts string";
+	}
+	if (!reading.HasMember("asset_code") || !reading["asset_code"].IsString())
+	{
+		return "Each reading must have an asset_code string";
+	}
+	if (!reading.HasMember("reading"))
+	{
+		return "Each reading must have a reading value";
+	}
+	return NULL;
+}
+
 /**
  * Append a set of readings to the readings table
  */
 int Connection::appendReadings(const char *readings)
 {
-Document 	doc;
+	TRACE_SPAN("storage-plugin", "Connection::appendReadings");
+PayloadDocument	payloadDoc;
+Document&	doc = payloadDoc.get();
 SQLBuffer	sql;
 int		row = 0;
 bool 		add_row = false;
 
-	ParseResult ok = doc.Parse(readings);
+	ParseResult ok = payloadDoc.parse(readings);
 	if (!ok)
 	{
  		raiseError("appendReadings", GetParseError_En(doc.GetParseError()));
 		return -1;
 	}
 
-	sql.append("INSERT INTO fledge.readings ( user_ts, asset_code, reading ) VALUES ");
-
 	if (!doc.HasMember("readings"))
 	{
 		raiseError("appendReadings", "Payload is missing a readings array");
@@ -1494,12 +1838,33 @@ bool 		add_row = false;
 		raiseError("appendReadings", "Payload is missing the readings array");
 		return -1;
 	}
+
+	if (m_copyReadings)
+	{
+		// COPY can not evaluate functions, these payloads use INSERT
+		bool hasFunction = false;
+		for (Value::ConstValueIterator itr = rdings.Begin(); itr != rdings.End(); ++itr)
+		{
+			if (itr->IsObject() && itr->HasMember("user_ts") && (*itr)["user_ts"].IsString()
+					&& isFunction((*itr)["user_ts"].GetString()))
+			{
+				hasFunction = true;
+				break;
+			}
+		}
+		if (!hasFunction)
+		{
+			return copyReadings(rdings);
+		}
+	}
+
+	sql.append("INSERT INTO fledge.readings ( user_ts, asset_code, reading ) VALUES ");
 	for (Value::ConstValueIterator itr = rdings.Begin(); itr != rdings.End(); ++itr)
 	{
-		if (!itr->IsObject())
+		const char *invalid = invalidReading(*itr);
+		if (invalid)
 		{
-			raiseError("appendReadings",
-					"Each reading in the readings array must be an object");
+			raiseError("appendReadings", invalid);
 			return -1;
 		}
 		add_row = true;
@@ -1564,12 +1929,13 @@ bool 		add_row = false;
 	const char *query = sql.coalesce();
 
 	logSQL("ReadingsAppend", query);
-	PGresult *res = PQexec(dbConnection, query);
+	PGresult *res = timedExec(query);
 	delete[] query;
 	if (PQresultStatus(res) == PGRES_COMMAND_OK)
 	{
+		int rows = atoi(PQcmdTuples(res));
 		PQclear(res);
-		return atoi(PQcmdTuples(res));
+		return rows;
 	}
  	raiseError("appendReadings", PQerrorMessage(dbConnection));
 	PQclear(res);
@@ -1577,89 +1943,855 @@ bool 		add_row = false;
 }
 
 /**
- * Fetch a block of readings from the reading table
+ * Append a set of readings to the readings table using COPY FROM STDIN.
+ * The rows are sent in text format, in chunks of COPY_CHUNK_SIZE bytes,
+ * which avoids building and parsing a single large INSERT statement.
+ *
+ * As with the INSERT, a reading that lacks the members of a row fails the
+ * whole append and readings with an invalid date are rejected and reported.
+ *
+ * @param readings	The array of readings from the appendReadings payload
+ * @return int		The number of readings appended or -1 on error
  */
-bool Connection::fetchReadings(unsigned long id, unsigned int blksize, std::string& resultSet)
+int Connection::copyReadings(const Value& readings)
 {
-char	sqlbuffer[200];
+string	buffer;
+int	row = 0;
+int	rejected = 0;
 
-	snprintf(sqlbuffer, sizeof(sqlbuffer),
-		"SELECT id, asset_code, reading, user_ts AT TIME ZONE 'UTC' as \"user_ts\", ts AT TIME ZONE 'UTC' as \"ts\" FROM fledge.readings WHERE id >= %ld ORDER BY id LIMIT %d;", id, blksize);
+	// The readings are checked before the copy so a bad payload sends nothing
+	for (Value::ConstValueIterator itr = readings.Begin(); itr != readings.End(); ++itr)
+	{
+		const char *invalid = invalidReading(*itr);
+		if (invalid)
+		{
+			raiseError("appendReadings", invalid);
+			return -1;
+		}
+	}
 
-	logSQL("ReadingsFetch", sqlbuffer);
-	PGresult *res = PQexec(dbConnection, sqlbuffer);
-	if (PQresultStatus(res) == PGRES_TUPLES_OK)
+	const char *copy = "COPY fledge.readings ( user_ts, asset_code, reading ) FROM STDIN";
+	logSQL("ReadingsCopy", copy);
+	PGresult *res = timedExec(copy);
+	if (PQresultStatus(res) != PGRES_COPY_IN)
 	{
-		mapResultSet(res, resultSet);
+		raiseError("appendReadings", PQerrorMessage(dbConnection));
 		PQclear(res);
-		return true;
+		return -1;
 	}
- 	raiseError("retrieve", PQerrorMessage(dbConnection));
 	PQclear(res);
-	return false;
-}
-
-
-
-/**
- * Purge readings from the reading table
- */
-unsigned int  Connection::purgeReadings(unsigned long age, unsigned int flags, unsigned long sent, std::string& result)
-{
-	unsigned long rowidLimit = 0, minrowidLimit = 0, maxrowidLimit = 0, rowidMin;
-
-	string sqlCommand;
-	SQLBuffer sql;
-	long unsentPurged = 0;
-	long unsentRetained = 0;
-	long numReadings = 0;
-	bool flag_retain;
-	int blocks = 0;
-	struct timeval startTv{}, endTv{};
 
-	const char *logSection="ReadingsPurgeByAge";
+	buffer.reserve(COPY_CHUNK_SIZE + 1024);
+	const char *error = NULL;
+	for (Value::ConstValueIterator itr = readings.Begin(); itr != readings.End(); ++itr)
+	{
+		char formatted_date[LEN_BUFFER_DATE] = {0};
+		const char *str = (*itr)["user_ts"].GetString();
+		if (! formatDate(formatted_date, sizeof(formatted_date), str) )
+		{
+			raiseError("appendReadings", "Invalid date |%s|", str);
+			rejected++;
+			continue;
+		}
 
-	Logger *logger = Logger::getLogger();
+		StringBuffer reading;
+		Writer<StringBuffer> writer(reading);
+		(*itr)["reading"].Accept(writer);
 
-	flag_retain = false;
+		buffer.append(formatted_date);
+		buffer.append(1, '\t');
+		copyEscape(buffer, (*itr)["asset_code"].GetString());
+		buffer.append(1, '\t');
+		copyEscape(buffer, reading.GetString());
+		buffer.append(1, '\n');
+		row++;
 
-	if ( (flags & STORAGE_PURGE_RETAIN_ANY) || (flags & STORAGE_PURGE_RETAIN_ALL) )
+		if (buffer.length() >= COPY_CHUNK_SIZE)
+		{
+			if (PQputCopyData(dbConnection, buffer.c_str(), buffer.length()) != 1)
+			{
+				error = PQerrorMessage(dbConnection);
+				break;
+			}
+			buffer.clear();
+		}
+	}
+	if (!error && buffer.length() > 0
+			&& PQputCopyData(dbConnection, buffer.c_str(), buffer.length()) != 1)
 	{
-		flag_retain = true;
+		error = PQerrorMessage(dbConnection);
 	}
-	Logger::getLogger()->debug("%s - flags :%X: flag_retain :%d: sent :%lu:", __FUNCTION__, flags, flag_retain, sent);
-
-	// Prepare empty result
-	result = "{ \"removed\" : 0, ";
-	result += " \"unsentPurged\" : 0, ";
-	result += " \"unsentRetained\" : 0, ";
-	result += " \"readings\" : 0 }";
-
-	logger->info("Purge starting...");
-	gettimeofday(&startTv, NULL);
 
-	/*
-	 * We fetch the current rowid and limit the purge process to work on just
-	 * those rows present in the database when the purge process started.
-	 * This prevents us looping in the purge process if new readings become
-	 * eligible for purging at a rate that is faster than we can purge them.
-	 */
-	rowidLimit = purgeOperation("SELECT max(id) from fledge.readings;", logSection,
-						   "ReadingsPurgeByAge - phase 1, fetching maximum id",
-						   true);
-	if (rowidLimit == -1) {
-		return 0;
+	row = copyEnd("appendReadings", error, row);
+	if (row >= 0 && rejected > 0)
+	{
+		Logger::getLogger()->warn("%d of %d readings were rejected with an invalid date",
+				rejected, rejected + row);
 	}
-	maxrowidLimit = rowidLimit;
+	return row;
+}
 
-	minrowidLimit = purgeOperation("SELECT min(id) from fledge.readings;", logSection,
-						   "ReadingsPurgeByAge - phase 1, fetching minimum id", true);
-	if (minrowidLimit == -1) {
-		return 0;
+/**
+ * Complete a COPY FROM STDIN, the copy is aborted if an error occurred
+ * whilst the data was sent
+ *
+ * @param operation	The operation reported with the errors
+ * @param error		The error that occurred sending the data or NULL
+ * @param rows		The number of rows sent
+ * @return int		The number of rows copied or -1 on error
+ */
+int Connection::copyEnd(const char *operation, const char *error, int rows)
+{
+PGresult	*res;
+
+	// Terminating the copy with an error message aborts it
+	if (PQputCopyEnd(dbConnection, error) != 1)
+	{
+		raiseError(operation, PQerrorMessage(dbConnection));
+		rows = -1;
 	}
-	//###   #########################################################################################:
 
-	if (age == 0)
+	bool failed = false;
+	while ((res = PQgetResult(dbConnection)) != NULL)
+	{
+		if (PQresultStatus(res) != PGRES_COMMAND_OK)
+		{
+			failed = true;
+		}
+		PQclear(res);
+	}
+	if (error)
+	{
+		raiseError(operation, error);
+		return -1;
+	}
+	if (failed)
+	{
+		raiseError(operation, PQerrorMessage(dbConnection));
+		return -1;
+	}
+	return rows;
+}
+
+/**
+ * Append a value to a COPY text format row, escaping the characters
+ * that are significant in the COPY text format.
+ *
+ * @param buffer	The buffer to append to
+ * @param str		The value to append
+ */
+void Connection::copyEscape(string& buffer, const char *str)
+{
+	for (const char *p = str; *p; p++)
+	{
+		switch (*p)
+		{
+			case '\\':
+				buffer.append("\\\\");
+				break;
+			case '\t':
+				buffer.append("\\t");
+				break;
+			case '\n':
+				buffer.append("\\n");
+				break;
+			case '\r':
+				buffer.append("\\r");
+				break;
+			default:
+				buffer.append(1, *p);
+				break;
+		}
+	}
+}
+
+/**
+ * Append a stream of readings to the readings table. The readings
+ * arrive as a NULL terminated array of ReadingStream structures, the
+ * INSERT statement is built directly from these without creating
+ * and parsing an intermediate JSON document.
+ *
+ * @param readings	The readings to append
+ * @param commit	Unused, each block is a single statement and is committed on completion
+ * @return int		The number of readings appended or -1 on error
+ */
+int Connection::readingStream(ReadingStream **readings, bool commit)
+{
+	TRACE_SPAN("storage-plugin", "Connection::readingStream");
+SQLBuffer	sql;
+int		row = 0;
+string		reading;
+char		ts[60], micro_s[10];
+struct tm	timeinfo;
+
+	(void)commit;
+	if (m_copyReadings && copyBinary())
+	{
+		return copyReadingStream(readings);
+	}
+
+	sql.append("INSERT INTO fledge.readings ( user_ts, asset_code, reading ) VALUES ");
+	for (int i = 0; readings[i]; i++)
+	{
+		const char *payload = &(readings[i]->assetCode[readings[i]->assetCodeLength]);
+		if (readings[i]->payloadFormat == RDS_PAYLOAD_BINARY)
+		{
+			if (!ReadingStreamPayload::toJSON(payload, readings[i]->payloadLength, reading))
+			{
+				raiseError("readingStream", "Unable to decode binary payload for asset %s",
+						readings[i]->assetCode);
+				continue;
+			}
+		}
+		else
+		{
+			reading = payload;
+		}
+
+		gmtime_r(&readings[i]->userTs.tv_sec, &timeinfo);
+		std::strftime(ts, sizeof(ts), "%Y-%m-%d %H:%M:%S", &timeinfo);
+		snprintf(micro_s, sizeof(micro_s), ".%06lu", readings[i]->userTs.tv_usec);
+
+		if (row)
+			sql.append(", (");
+		else
+			sql.append('(');
+		sql.append('\'');
+		sql.append(ts);
+		sql.append(micro_s);
+		sql.append("+00:00',\'");
+		sql.append(readings[i]->assetCode);
+		sql.append("', '");
+		sql.append(escape(reading));
+		sql.append("\' )");
+		row++;
+	}
+	if (row == 0)
+	{
+		return 0;
+	}
+	sql.append(';');
+
+	const char *query = sql.coalesce();
+
+	logSQL("ReadingsStream", query);
+	PGresult *res = timedExec(query);
+	delete[] query;
+	if (PQresultStatus(res) == PGRES_COMMAND_OK)
+	{
+		int rows = atoi(PQcmdTuples(res));
+		PQclear(res);
+		return rows;
+	}
+ 	raiseError("readingStream", PQerrorMessage(dbConnection));
+	PQclear(res);
+	return -1;
+}
+
+/**
+ * Append a big endian 16 bit integer to a COPY binary format buffer
+ */
+static inline void copyInt16(string& buffer, uint16_t value)
+{
+	buffer.append(1, (char)(value >> 8));
+	buffer.append(1, (char)value);
+}
+
+/**
+ * Append a big endian 32 bit integer to a COPY binary format buffer
+ */
+static inline void copyInt32(string& buffer, uint32_t value)
+{
+	copyInt16(buffer, (uint16_t)(value >> 16));
+	copyInt16(buffer, (uint16_t)value);
+}
+
+/**
+ * Append a big endian 64 bit integer to a COPY binary format buffer
+ */
+static inline void copyInt64(string& buffer, uint64_t value)
+{
+	copyInt32(buffer, (uint32_t)(value >> 32));
+	copyInt32(buffer, (uint32_t)value);
+}
+
+/**
+ * Check if the readings can be sent in the COPY binary format. The binary
+ * timestamps are integer microseconds, servers built with floating point
+ * timestamps, prior to Postgres 10, use the text format.
+ *
+ * @return bool		True if the binary format can be used
+ */
+bool Connection::copyBinary()
+{
+	const char *integerDatetimes = PQparameterStatus(dbConnection, "integer_datetimes");
+	return integerDatetimes && strcmp(integerDatetimes, "on") == 0;
+}
+
+/**
+ * Append a stream of readings to the readings table using COPY FROM STDIN
+ * in binary format. The rows are encoded directly from the ReadingStream
+ * structures and sent in chunks of COPY_CHUNK_SIZE bytes, neither the SQL
+ * text nor the timestamps as strings are built.
+ *
+ * @param readings	The NULL terminated array of readings to append
+ * @return int		The number of readings appended or -1 on error
+ */
+int Connection::copyReadingStream(ReadingStream **readings)
+{
+string	buffer;
+string	reading;
+int	row = 0;
+
+	const char *copy = "COPY fledge.readings ( user_ts, asset_code, reading ) FROM STDIN WITH (FORMAT binary)";
+	logSQL("ReadingsCopy", copy);
+	PGresult *res = timedExec(copy);
+	if (PQresultStatus(res) != PGRES_COPY_IN)
+	{
+		raiseError("readingStream", PQerrorMessage(dbConnection));
+		PQclear(res);
+		return -1;
+	}
+	PQclear(res);
+
+	buffer.reserve(COPY_CHUNK_SIZE + 1024);
+	buffer.append("PGCOPY\n\377\r\n\0", 11);
+	copyInt32(buffer, 0);		// Flags
+	copyInt32(buffer, 0);		// Header extension length
+
+	const char *error = NULL;
+	for (int i = 0; readings[i]; i++)
+	{
+		const char *payload = &(readings[i]->assetCode[readings[i]->assetCodeLength]);
+		if (readings[i]->payloadFormat == RDS_PAYLOAD_BINARY)
+		{
+			if (!ReadingStreamPayload::toJSON(payload, readings[i]->payloadLength, reading))
+			{
+				raiseError("readingStream", "Unable to decode binary payload for asset %s",
+						readings[i]->assetCode);
+				continue;
+			}
+		}
+		else
+		{
+			reading = payload;
+		}
+
+		// Microseconds since the Postgres epoch, 2000-01-01 00:00:00 UTC
+		int64_t userTs = ((int64_t)readings[i]->userTs.tv_sec - POSTGRES_EPOCH_UNIX) * 1000000
+				+ readings[i]->userTs.tv_usec;
+		size_t assetLength = strlen(readings[i]->assetCode);
+
+		copyInt16(buffer, 3);
+		copyInt32(buffer, 8);
+		copyInt64(buffer, (uint64_t)userTs);
+		copyInt32(buffer, (uint32_t)assetLength);
+		buffer.append(readings[i]->assetCode, assetLength);
+		copyInt32(buffer, (uint32_t)reading.length() + 1);
+		buffer.append(1, (char)1);	// Version of the jsonb binary format
+		buffer.append(reading);
+		row++;
+
+		if (buffer.length() >= COPY_CHUNK_SIZE)
+		{
+			if (PQputCopyData(dbConnection, buffer.data(), buffer.length()) != 1)
+			{
+				error = PQerrorMessage(dbConnection);
+				break;
+			}
+			buffer.clear();
+		}
+	}
+	if (!error)
+	{
+		copyInt16(buffer, 0xffff);	// Trailer
+		if (PQputCopyData(dbConnection, buffer.data(), buffer.length()) != 1)
+		{
+			error = PQerrorMessage(dbConnection);
+		}
+	}
+
+	return copyEnd("readingStream", error, row);
+}
+
+/**
+ * Fetch a block of readings from the reading table
+ */
+bool Connection::fetchReadings(unsigned long id, unsigned int blksize, std::string& resultSet)
+{
+	TRACE_SPAN("storage-plugin", "Connection::fetchReadings");
+	const char *sql = "SELECT id, asset_code, reading, user_ts AT TIME ZONE 'UTC' as \"user_ts\", ts AT TIME ZONE 'UTC' as \"ts\" FROM fledge.readings WHERE id >= $1 ORDER BY id LIMIT $2;";
+
+	// The result is decoded from the binary format when the timestamps are integers
+	PGresult *res = execPrepared("readings_fetch", sql, { to_string(id), to_string(blksize) },
+					copyBinary() ? 1 : 0);
+	if (PQresultStatus(res) == PGRES_TUPLES_OK)
+	{
+		mapResultSet(res, resultSet);
+		PQclear(res);
+		return true;
+	}
+ 	raiseError("retrieve", PQerrorMessage(dbConnection));
+	PQclear(res);
+	return false;
+}
+
+
+
+/**
+ * Execute a SQL statement, the duration of the statement is recorded
+ * in the storage profile
+ *
+ * @param sql		The SQL statement
+ * @return PGresult*	The result of the statement
+ */
+PGresult *Connection::timedExec(const char *sql)
+{
+	StatementTimer timer(sql);
+	return PQexec(dbConnection, sql);
+}
+
+/**
+ * Execute a statement prepared on this connection. The statement is
+ * prepared the first time it is used and the name recorded, the later
+ * executions only send the values of the parameters, they are neither
+ * escaped nor planned again.
+ *
+ * @param name		The name of the prepared statement
+ * @param sql		The SQL of the statement, with the parameters $1, $2...
+ * @param params	The values of the parameters in text format
+ * @param resultFormat	1 to request the result in binary format, 0 for text
+ * @return PGresult*	The result of the execution, to be released by the caller
+ */
+PGresult *Connection::execPrepared(const char *name, const char *sql, const vector<string>& params,
+				   int resultFormat)
+{
+	if (m_prepared.find(name) == m_prepared.end())
+	{
+		PGresult *res = PQprepare(dbConnection, name, sql, params.size(), NULL);
+		if (PQresultStatus(res) != PGRES_COMMAND_OK)
+		{
+			return res;
+		}
+		PQclear(res);
+		m_prepared.insert(name);
+	}
+
+	vector<const char *> values;
+	values.reserve(params.size());
+	for (auto& param : params)
+	{
+		values.push_back(param.c_str());
+	}
+	logSQL(name, sql);
+	StatementTimer timer(sql);
+	return PQexecPrepared(dbConnection, name, params.size(), values.data(), NULL, NULL, resultFormat);
+}
+
+/**
+ * Add the SQL template of a query shape to the cache of the connection.
+ * When the cache is full the statements prepared on the connection are
+ * deallocated together with the shapes, the statements still in use are
+ * prepared again the next time they are executed.
+ *
+ * @param shape			The shape of the query
+ * @param sql			The SQL built from the payload with the markers
+ * @return QueryTemplate*	The template of the shape
+ */
+const QueryTemplate *Connection::cacheShape(const QueryShape& shape, const char *sql)
+{
+	if (m_shapes.full())
+	{
+		PQclear(timedExec("DEALLOCATE ALL;"));
+		m_prepared.clear();
+		m_shapes.clear();
+	}
+	return m_shapes.add(shape, sql, QueryShape::PlaceholderDollar);
+}
+
+/**
+ * Execute the statements of the SQL template of a query shape with the
+ * literal values of the query as the parameters of the statements. Each
+ * statement of the template is prepared once on the connection, the
+ * statements of a template with more than one statement are executed
+ * in a transaction.
+ *
+ * @param shapeTemplate	The template of the shape of the query
+ * @param shape		The shape of the query with its literal values
+ * @return PGresult*	The result of the last statement or of the statement
+ *			that failed, to be released by the caller
+ */
+PGresult *Connection::execShape(const QueryTemplate *shapeTemplate, const QueryShape& shape)
+{
+const vector<QueryParameter>& parameters = shape.parameters();
+bool transaction = shapeTemplate->m_statements.size() > 1;
+PGresult *res = NULL;
+
+	if (transaction)
+	{
+		PQclear(timedExec("BEGIN;"));
+	}
+	for (auto& statement : shapeTemplate->m_statements)
+	{
+		vector<string> params;
+		for (int index : statement.m_parameters)
+		{
+			const QueryParameter& parameter = parameters[index];
+			params.push_back(parameter.m_isString ? parameter.m_string
+						: to_string(parameter.m_integer));
+		}
+		string name = "shape_" + to_string(statement.m_id);
+		if (res)
+		{
+			PQclear(res);
+		}
+		res = execPrepared(name.c_str(), statement.m_sql.c_str(), params);
+		ExecStatusType status = PQresultStatus(res);
+		if (status != PGRES_COMMAND_OK && status != PGRES_TUPLES_OK)
+		{
+			if (transaction)
+			{
+				PQclear(timedExec("ROLLBACK;"));
+			}
+			return res;
+		}
+	}
+	if (transaction)
+	{
+		PGresult *commit = timedExec("COMMIT;");
+		if (PQresultStatus(commit) != PGRES_COMMAND_OK)
+		{
+			PQclear(res);
+			return commit;
+		}
+		PQclear(commit);
+	}
+	return res;
+}
+
+/**
+ * Return the last id taken from the sequence of the readings
+ *
+ * @return long	The last reading id, 0 if none has been taken, -1 on error
+ */
+long Connection::lastReadingId()
+{
+	PGresult *res = timedExec(
+			"SELECT CASE WHEN is_called THEN last_value ELSE last_value - 1 END FROM fledge.readings_id_seq;");
+	if (PQresultStatus(res) != PGRES_TUPLES_OK || PQntuples(res) != 1)
+	{
+		raiseError("lastReadingId", PQerrorMessage(dbConnection));
+		PQclear(res);
+		return -1;
+	}
+	long id = atol(PQgetvalue(res, 0, 0));
+	PQclear(res);
+	return id;
+}
+
+/**
+ * Convert the readings table into a table partitioned by ranges of ids,
+ * if it is not already, and create the partitions of the next readings.
+ * The existing readings become the first partition, ending after the
+ * last id in use, and a default partition receives any reading outside
+ * the partitions. The purge of the readings by age then drops the
+ * partitions that are entirely older than the age rather than deleting
+ * their readings.
+ *
+ * @return bool	True if the readings table is partitioned
+ */
+bool Connection::partitionReadings()
+{
+	if (m_partitionSize == 0)
+	{
+		return false;
+	}
+
+	PGresult *res = timedExec("SELECT c.relkind FROM pg_class c "
+			"JOIN pg_namespace n ON n.oid = c.relnamespace "
+			"WHERE n.nspname = 'fledge' AND c.relname = 'readings';");
+	if (PQresultStatus(res) != PGRES_TUPLES_OK || PQntuples(res) != 1)
+	{
+		raiseError("partitionReadings", PQerrorMessage(dbConnection));
+		PQclear(res);
+		return false;
+	}
+	bool partitioned = PQgetvalue(res, 0, 0)[0] == 'p';
+	PQclear(res);
+
+	if (!partitioned)
+	{
+		lock_guard<mutex> guard(m_partitionMutex);
+		long last = lastReadingId();
+		if (last == -1)
+		{
+			return false;
+		}
+		unsigned long end = ((last + m_partitionSize - 1) / m_partitionSize) * m_partitionSize + 1;
+
+		Logger::getLogger()->info("Converting the readings table to a partitioned table, the existing readings are kept in the partition readings_legacy");
+		// A single statement string is executed as a single transaction
+		string sql = "ALTER TABLE fledge.readings RENAME TO readings_legacy;"
+			"ALTER INDEX IF EXISTS fledge.readings_pkey RENAME TO readings_legacy_pkey;"
+			"ALTER INDEX IF EXISTS fledge.fki_readings_fk1 RENAME TO readings_legacy_ix1;"
+			"ALTER INDEX IF EXISTS fledge.readings_ix2 RENAME TO readings_legacy_ix2;"
+			"ALTER INDEX IF EXISTS fledge.readings_ix3 RENAME TO readings_legacy_ix3;"
+			"CREATE TABLE fledge.readings (LIKE fledge.readings_legacy INCLUDING DEFAULTS) PARTITION BY RANGE (id);"
+			"ALTER TABLE fledge.readings ATTACH PARTITION fledge.readings_legacy FOR VALUES FROM (MINVALUE) TO (" + to_string(end) + ");"
+			"ALTER TABLE fledge.readings ADD CONSTRAINT readings_pkey PRIMARY KEY (id);"
+			"CREATE INDEX fki_readings_fk1 ON fledge.readings USING btree (asset_code, user_ts desc);"
+			"CREATE INDEX readings_ix2 ON fledge.readings USING btree (asset_code);"
+			"CREATE INDEX readings_ix3 ON fledge.readings USING btree (user_ts);"
+			"CREATE TABLE fledge.readings_default PARTITION OF fledge.readings DEFAULT;"
+			"GRANT SELECT, INSERT, UPDATE, DELETE ON fledge.readings TO PUBLIC;";
+		logSQL("PartitionReadings", sql.c_str());
+		res = timedExec(sql.c_str());
+		if (PQresultStatus(res) != PGRES_COMMAND_OK)
+		{
+			raiseError("partitionReadings", PQerrorMessage(dbConnection));
+			PQclear(res);
+			return false;
+		}
+		PQclear(res);
+	}
+	return createPartitions();
+}
+
+/**
+ * Return the partitions of the readings table, other than the default
+ * partition, with the range of ids of each in ascending order
+ *
+ * @param partitions	Set to the name and the range of ids of each partition
+ * @return bool		True if the partitions have been returned
+ */
+bool Connection::readingsPartitions(vector<pair<string, pair<unsigned long, unsigned long>>>& partitions)
+{
+	PGresult *res = timedExec("SELECT c.relname, pg_get_expr(c.relpartbound, c.oid) "
+			"FROM pg_inherits i JOIN pg_class c ON c.oid = i.inhrelid "
+			"WHERE i.inhparent = 'fledge.readings'::regclass;");
+	if (PQresultStatus(res) != PGRES_TUPLES_OK)
+	{
+		raiseError("readingsPartitions", PQerrorMessage(dbConnection));
+		PQclear(res);
+		return false;
+	}
+
+	partitions.clear();
+	for (int i = 0; i < PQntuples(res); i++)
+	{
+		// The bound is FOR VALUES FROM ('1') TO ('1001'), MINVALUE is read as 0
+		const char *bound = PQgetvalue(res, i, 1);
+		const char *from = strstr(bound, "FROM (");
+		const char *to = strstr(bound, "TO (");
+		if (!from || !to)
+		{
+			continue;
+		}
+		from += 6;
+		to += 4;
+		partitions.push_back(make_pair(string(PQgetvalue(res, i, 0)),
+				make_pair(strtoul(from + (*from == '\'' ? 1 : 0), NULL, 10),
+					  strtoul(to + (*to == '\'' ? 1 : 0), NULL, 10))));
+	}
+	PQclear(res);
+
+	sort(partitions.begin(), partitions.end(),
+		[](const pair<string, pair<unsigned long, unsigned long>>& a,
+		   const pair<string, pair<unsigned long, unsigned long>>& b)
+		{ return a.second.second < b.second.second; });
+	return true;
+}
+
+/**
+ * Create the partitions of the readings table needed for the next
+ * PARTITIONS_AHEAD times the partition size readings. A partition
+ * starts after any reading already stored in the default partition,
+ * these readings are left in the default partition.
+ *
+ * @return bool	True if the partitions exist
+ */
+bool Connection::createPartitions()
+{
+	vector<pair<string, pair<unsigned long, unsigned long>>> partitions;
+	long last = lastReadingId();
+	if (last == -1 || !readingsPartitions(partitions))
+	{
+		return false;
+	}
+
+	unsigned long high = partitions.empty() ? 1 : partitions.back().second.second;
+	unsigned long target = last + 1 + m_partitionSize * PARTITIONS_AHEAD;
+	if (high >= target)
+	{
+		return true;
+	}
+
+	PGresult *res = timedExec("SELECT max(id) FROM fledge.readings_default;");
+	if (PQresultStatus(res) == PGRES_TUPLES_OK && PQntuples(res) == 1 && !PQgetisnull(res, 0, 0))
+	{
+		unsigned long stray = strtoul(PQgetvalue(res, 0, 0), NULL, 10);
+		if (stray >= high)
+		{
+			Logger::getLogger()->warn("Readings up to id %lu are held in the default partition of the readings table", stray);
+			high = stray + 1;
+		}
+	}
+	PQclear(res);
+
+	while (high < target)
+	{
+		string sql = "CREATE TABLE IF NOT EXISTS fledge.readings_" + to_string(high)
+			+ " PARTITION OF fledge.readings FOR VALUES FROM (" + to_string(high)
+			+ ") TO (" + to_string(high + m_partitionSize) + ");";
+		logSQL("CreatePartition", sql.c_str());
+		res = timedExec(sql.c_str());
+		if (PQresultStatus(res) != PGRES_COMMAND_OK)
+		{
+			raiseError("createPartitions", PQerrorMessage(dbConnection));
+			PQclear(res);
+			return false;
+		}
+		PQclear(res);
+		Logger::getLogger()->debug("Created partition readings_%lu of the readings table", high);
+		high += m_partitionSize;
+	}
+	return true;
+}
+
+/**
+ * Account for the readings appended, the partitions needed for the next
+ * readings are created each quarter of a partition
+ *
+ * @param rows	The number of readings appended
+ */
+void Connection::readingsAppended(int rows)
+{
+	if (m_partitionSize == 0 || rows <= 0)
+	{
+		return;
+	}
+	if (m_partitionAppended.fetch_add(rows) + rows >= m_partitionSize / 4)
+	{
+		unique_lock<mutex> lck(m_partitionMutex, try_to_lock);
+		if (lck.owns_lock())
+		{
+			m_partitionAppended = 0;
+			createPartitions();
+		}
+	}
+}
+
+/**
+ * Drop the partitions of the readings table that only hold readings
+ * up to the purge limit. The number of readings of a partition is that
+ * of its range of ids, as for the remaining readings reported by the purge.
+ *
+ * @param rowidMin	The lowest reading id, moved to the last id dropped
+ * @param rowidLimit	The last reading id to purge
+ * @return unsigned long	The number of readings dropped
+ */
+unsigned long Connection::dropPartitions(unsigned long& rowidMin, unsigned long rowidLimit)
+{
+	vector<pair<string, pair<unsigned long, unsigned long>>> partitions;
+	unsigned long removed = 0;
+	int dropped = 0;
+
+	lock_guard<mutex> guard(m_partitionMutex);
+	if (!readingsPartitions(partitions))
+	{
+		return 0;
+	}
+	for (auto& partition : partitions)
+	{
+		unsigned long from = partition.second.first;
+		unsigned long to = partition.second.second;
+		if (to - 1 > rowidLimit)
+		{
+			break;
+		}
+		string sql = "DROP TABLE fledge." + partition.first + ";";
+		logSQL("DropPartition", sql.c_str());
+		PGresult *res = timedExec(sql.c_str());
+		if (PQresultStatus(res) != PGRES_COMMAND_OK)
+		{
+			raiseError("dropPartitions", PQerrorMessage(dbConnection));
+			PQclear(res);
+			break;
+		}
+		PQclear(res);
+		if (to - 1 > rowidMin)
+		{
+			removed += to - max(from, rowidMin);
+			rowidMin = to - 1;
+		}
+		dropped++;
+	}
+	if (dropped)
+	{
+		Logger::getLogger()->info("Purge dropped %d partitions of the readings table with %lu readings", dropped, removed);
+	}
+	return removed;
+}
+
+/**
+ * Purge readings from the reading table
+ */
+unsigned int  Connection::purgeReadings(unsigned long age, unsigned int flags, unsigned long sent, std::string& result)
+{
+	unsigned long rowidLimit = 0, minrowidLimit = 0, maxrowidLimit = 0, rowidMin;
+
+	string sqlCommand;
+	SQLBuffer sql;
+	long unsentPurged = 0;
+	long unsentRetained = 0;
+	long numReadings = 0;
+	bool flag_retain;
+	int blocks = 0;
+	struct timeval startTv{}, endTv{};
+
+	const char *logSection="ReadingsPurgeByAge";
+
+	Logger *logger = Logger::getLogger();
+
+	flag_retain = false;
+
+	if ( (flags & STORAGE_PURGE_RETAIN_ANY) || (flags & STORAGE_PURGE_RETAIN_ALL) )
+	{
+		flag_retain = true;
+	}
+	Logger::getLogger()->debug("%s - flags :%X: flag_retain :%d: sent :%lu:", __FUNCTION__, flags, flag_retain, sent);
+
+	// Prepare empty result
+	result = "{ \"removed\" : 0, ";
+	result += " \"unsentPurged\" : 0, ";
+	result += " \"unsentRetained\" : 0, ";
+	result += " \"readings\" : 0 }";
+
+	logger->info("Purge starting...");
+	gettimeofday(&startTv, NULL);
+
+	/*
+	 * We fetch the current rowid and limit the purge process to work on just
+	 * those rows present in the database when the purge process started.
+	 * This prevents us looping in the purge process if new readings become
+	 * eligible for purging at a rate that is faster than we can purge them.
+	 */
+	rowidLimit = purgeOperation("SELECT max(id) from fledge.readings;", logSection,
+						   "ReadingsPurgeByAge - phase 1, fetching maximum id",
+						   true);
+	if (rowidLimit == -1) {
+		return 0;
+	}
+	maxrowidLimit = rowidLimit;
+
+	minrowidLimit = purgeOperation("SELECT min(id) from fledge.readings;", logSection,
+						   "ReadingsPurgeByAge - phase 1, fetching minimum id", true);
+	if (minrowidLimit == -1) {
+		return 0;
+	}
+	//###   #########################################################################################:
+
+	if (age == 0)
 	{
 		/*
 		 * An age of 0 means remove the oldest hours data.
@@ -1708,8 +2840,9 @@ unsigned int  Connection::purgeReadings(unsigned long age, unsigned int flags, u
 			if (prev_m == m) break;
 
 			// e.g. select id from readings where rowid = 219867307 AND user_ts < datetime('now' , '-24 hours', 'utc');
-			sqlCommand = "SELECT id FROM fledge.readings WHERE id = " + to_string (m) + " AND user_ts < (now() - INTERVAL '" + to_string (age) + " hours');";
-			midRowId = purgeOperation(sqlCommand.c_str() , logSection, "ReadingsPurgeByAge - phase 2, fetching midRowId", true);
+			midRowId = purgePrepared("purge_mid_id",
+					"SELECT id FROM fledge.readings WHERE id = $1 AND user_ts < (now() - $2 * INTERVAL '1 hour');",
+					{ to_string(m), to_string(age) }, "ReadingsPurgeByAge - phase 2, fetching midRowId", true);
 			if (midRowId == -1) {
 				return 0;
 			}
@@ -1734,8 +2867,9 @@ unsigned int  Connection::purgeReadings(unsigned long age, unsigned int flags, u
 
 		Logger::getLogger()->debug("%s - s1 rowidLimit :%lu: minrowidLimit :%lu: maxrowidLimit :%lu:", __FUNCTION__, rowidLimit, minrowidLimit, maxrowidLimit);
 
-		sqlCommand = "SELECT max(id) FROM fledge.readings WHERE id <= " + to_string (rowidLimit) + " AND user_ts < (now() - INTERVAL '" + to_string (age) + " hours');";
-		rowidLimit = purgeOperation(sqlCommand.c_str() , logSection, "ReadingsPurgeByAge - phase 2, checking rowidLimit", true);
+		rowidLimit = purgePrepared("purge_max_id",
+					"SELECT max(id) FROM fledge.readings WHERE id <= $1 AND user_ts < (now() - $2 * INTERVAL '1 hour');",
+					{ to_string(rowidLimit), to_string(age) }, "ReadingsPurgeByAge - phase 2, checking rowidLimit", true);
 
 		if (rowidLimit == -1) {
 			return 0;
@@ -1775,6 +2909,11 @@ unsigned int  Connection::purgeReadings(unsigned long age, unsigned int flags, u
 	unsigned int deletedRows = 0;
 	unsigned int rowsAffected, totTime=0, prevBlocks=0, prevTotTime=0;
 
+	if (m_partitionSize)
+	{
+		deletedRows += dropPartitions(rowidMin, rowidLimit);
+	}
+
 	logger->info("Purge about to delete readings # %ld to %ld", rowidMin, rowidLimit);
 	while (rowidMin < rowidLimit)
 	{
@@ -1786,13 +2925,12 @@ unsigned int  Connection::purgeReadings(unsigned long age, unsigned int flags, u
 		}
 
 		{
-			sqlCommand = "DELETE FROM fledge.readings WHERE id <=" + to_string(rowidMin) + ";" ;
-
 			START_TIME;
-			rowsAffected = purgeOperation(sqlCommand.c_str() , logSection, "ReadingsPurgeByAge - phase 3, deleting readings", false);
+			rowsAffected = purgePrepared("purge_delete", "DELETE FROM fledge.readings WHERE id <= $1;",
+					{ to_string(rowidMin) }, "ReadingsPurgeByAge - phase 3, deleting readings", false);
 			END_TIME;
 
-			logger->debug("%s - DELETE sql :%s: rowsAffected :%ld:",  __FUNCTION__, sqlCommand.c_str() ,rowsAffected);
+			logger->debug("%s - DELETE id <= %lu rowsAffected :%ld:",  __FUNCTION__, rowidMin, rowsAffected);
 
 			if (rowsAffected == -1) {
 				return 0;
@@ -1876,22 +3014,49 @@ unsigned long Connection::purgeOperation(const char *sql, const char *logSection
 {
 	SQLBuffer sqlBuffer;
 	const char *query;
-	unsigned long value;
 	PGresult *res;
-	bool error;
-	char *PGValue {};
-
-	error = false;
-	value = 0;
 
 	Logger::getLogger()->debug("%s - sql :%s: logSection :%s: phase :%s:", __FUNCTION__, sql, logSection, phase);
 
 	sqlBuffer.append(sql);
 	query = sqlBuffer.coalesce();
 	logSQL(logSection, query);
-	res = PQexec(dbConnection, query);
+	res = timedExec(query);
 	delete[] query;
 
+	return purgeResult(res, phase, retrieve);
+}
+
+/**
+ * Execute a prepared statement for the purge task
+ *
+ * @param name		The name of the prepared statement
+ * @param sql		The SQL of the statement, prepared on first use
+ * @param params	The values of the parameters
+ * @param phase		The phase of the purge reported with the errors
+ * @param retrieve	True if the statement returns a value
+ * @return unsigned long	The value returned or the rows affected, -1 on error
+ */
+unsigned long Connection::purgePrepared(const char *name, const char *sql, const vector<string>& params,
+					const char *phase, bool retrieve)
+{
+	return purgeResult(execPrepared(name, sql, params), phase, retrieve);
+}
+
+/**
+ * Return the value of the result of a purge statement and release the result
+ *
+ * @param res		The result of the statement
+ * @param phase		The phase of the purge reported with the errors
+ * @param retrieve	True if the statement returns a value
+ * @return unsigned long	The value returned or the rows affected, -1 on error
+ */
+unsigned long Connection::purgeResult(PGresult *res, const char *phase, bool retrieve)
+{
+	unsigned long value = 0;
+	bool error = false;
+	char *PGValue {};
+
 	if (retrieve) {
 		if (PQresultStatus(res) == PGRES_TUPLES_OK) {
 
@@ -2006,8 +3171,8 @@ unsigned int  Connection::purgeReadingsByRows(unsigned long rows,
 		{
 			logger->info("RowCount %lu, Max Id %lu, min Id %lu, delete point %lu", rowcount, maxId, minId, deletePoint);
 
-			sqlCommand = "DELETE FROM fledge.readings WHERE id <= " +  to_string(deletePoint);
-			rowsAffectedLastComand = purgeOperation(sqlCommand.c_str(), logSection, "ReadingsPurgeByRows - phase 2, deleting readings", false);
+			rowsAffectedLastComand = purgePrepared("purge_delete", "DELETE FROM fledge.readings WHERE id <= $1;",
+					{ to_string(deletePoint) }, "ReadingsPurgeByRows - phase 2, deleting readings", false);
 
 			deletedRows += rowsAffectedLastComand;
 			numReadings -= rowsAffectedLastComand;
@@ -2049,128 +3214,220 @@ unsigned int  Connection::purgeReadingsByRows(unsigned long rows,
 
 }
 
+/**
+ * The conversion to JSON of a column of a result set
+ */
+enum ResultColumnType {
+	RESULT_STRING,		// Any other type, returned as its text
+	RESULT_CHAR,		// char(x), trimmed
+	RESULT_JSON,		// jsonb
+	RESULT_INT16,
+	RESULT_INT32,
+	RESULT_INT64,
+	RESULT_FLOAT4,
+	RESULT_FLOAT8,
+	RESULT_TIMESTAMP	// timestamp without time zone
+};
+
+/**
+ * Read a big endian integer of a binary format result
+ */
+static inline uint64_t resultInt(const char *value, int bytes)
+{
+	uint64_t result = 0;
+	for (int i = 0; i < bytes; i++)
+	{
+		result = (result << 8) | (unsigned char)value[i];
+	}
+	return result;
+}
+
+/**
+ * Format a binary timestamp, microseconds since the Postgres epoch, as
+ * the text output of Postgres. The trailing zeros of the fraction of
+ * a second are removed.
+ *
+ * @param value		The binary timestamp
+ * @param buffer	The buffer for the formatted timestamp
+ * @param size		The size of the buffer
+ */
+static void resultTimestamp(int64_t value, char *buffer, size_t size)
+{
+	int64_t seconds = value / 1000000;
+	int64_t micros = value % 1000000;
+	if (micros < 0)
+	{
+		micros += 1000000;
+		seconds--;
+	}
+	time_t t = (time_t)(seconds + POSTGRES_EPOCH_UNIX);
+	struct tm tm;
+	gmtime_r(&t, &tm);
+	size_t len = strftime(buffer, size, "%Y-%m-%d %H:%M:%S", &tm);
+	if (micros && len + 8 <= size)
+	{
+		snprintf(buffer + len, size - len, ".%06ld", (long)micros);
+		char *p = buffer + len + 6;
+		while (*p == '0')
+		{
+			*p-- = 0;
+		}
+	}
+}
+
 /**
  * Map a SQL result set to a JSON document
+ *
+ * The JSON is written directly from the result set, the conversion of
+ * each column is chosen once from its type. The columns of a result set
+ * requested in binary format are decoded without parsing their text,
+ * the types handled in binary are the integers, the floats, jsonb, the
+ * character types and timestamp without time zone.
  */
 void Connection::mapResultSet(PGresult *res, string& resultSet)
 {
-int nFields, i, j;
-Document doc;
+int nFields = PQnfields(res); // No. of columns in resultset
+int nRows = PQntuples(res);
+StringBuffer buffer;
+Writer<StringBuffer> writer(buffer);
+StringBuffer jsonBuffer;
+char timestamp[40];
+
+	vector<ResultColumnType> types(nFields);
+	vector<bool> binary(nFields);
+	vector<const char *> names(nFields);
+	for (int j = 0; j < nFields; j++)
+	{
+		names[j] = PQfname(res, j);
+		binary[j] = PQfformat(res, j) == 1;
+		switch (PQftype(res, j))
+		{
+			case 3802: types[j] = RESULT_JSON; break;	// jsonb
+			case 21: types[j] = RESULT_INT16; break;	// int2
+			case 23: types[j] = RESULT_INT32; break;	// int4
+			case 20: types[j] = RESULT_INT64; break;	// int8
+			case 700: types[j] = RESULT_FLOAT4; break;	// float4
+			case 701:					// float8
+			case 710: types[j] = RESULT_FLOAT8; break;	// this OID doesn't exist
+			case 1042: types[j] = RESULT_CHAR; break;	// char(x)
+			case 1114: types[j] = RESULT_TIMESTAMP; break;	// timestamp
+			default: types[j] = RESULT_STRING; break;
+		}
+	}
 
-	doc.SetObject();    // Create the JSON document
-	Document::AllocatorType& allocator = doc.GetAllocator();
-	nFields = PQnfields(res); // No. of columns in resultset
-	Value rows(kArrayType);   // Setup a rows array
-	Value count;
-	count.SetInt(PQntuples(res)); // Create the count
-	doc.AddMember("count", count, allocator);
+	writer.StartObject();
+	writer.Key("count");
+	writer.Int(nRows);
+	writer.Key("rows");
+	writer.StartArray();
 
 	// Iterate over the rows
-	for (i = 0; i < PQntuples(res); i++)
+	for (int i = 0; i < nRows; i++)
 	{
-		Value row(kObjectType); // Create a row
-		for (j = 0; j < nFields; j++)
+		writer.StartObject();
+		for (int j = 0; j < nFields; j++)
 		{
-			/**
-			 * TODO Improve handling of Oid's
-			 *
-			 * Current OID detection is based on
-			 *
-			 * SELECT oid, typname FROM pg_type;
-			 */
+			char *value = PQgetvalue(res, i, j);
+			int length = PQgetlength(res, i, j);
 
 			/**
 			 * If PQgetvalue() is pointer to an empty string,
 			 * we assume that is a NULL and we return
-			 * the "" value no matter the OID value
+			 * the "" value no matter the type
 			 */
-			if (!strlen(PQgetvalue(res, i, j)))
+			if (length == 0 || (!binary[j] && !*value))
 			{
-				Value value("", allocator);
-				Value name(PQfname(res, j), allocator);
-				row.AddMember(name, value, allocator);
-
-				// Get the next column
+				writer.Key(names[j]);
+				writer.String("");
 				continue;
 			}
 
-			/* PQgetvalue() has a value, check OID */	
-			Oid oid = PQftype(res, j);
-			switch (oid)
+			switch (types[j])
 			{
-				case 3802: // JSON type hard coded in this example: jsonb
+				case RESULT_JSON:
 				{
-					Document d;
-					if (d.Parse(PQgetvalue(res, i, j)).HasParseError())
+					if (binary[j])
+					{
+						value++;	// jsonb version number
+					}
+					jsonBuffer.Clear();
+					Writer<StringBuffer> jsonWriter(jsonBuffer);
+					Reader reader;
+					StringStream stream(value);
+					if (reader.Parse(stream, jsonWriter).IsError())
 					{
-						raiseError("resultSet", "Failed to parse: %s\n", PQgetvalue(res, i, j));
+						raiseError("resultSet", "Failed to parse: %s\n", value);
 						continue;
 					}
-					Value value(d, allocator);
-					Value name(PQfname(res, j), allocator);
-					row.AddMember(name, value, allocator);
+					writer.Key(names[j]);
+					writer.RawValue(jsonBuffer.GetString(), jsonBuffer.GetSize(), kObjectType);
 					break;
 				}
-				case 23:    //INT 4 bytes: int4
-				{
-					int32_t intVal = atoi(PQgetvalue(res, i, j));
-					Value name(PQfname(res, j), allocator);
-					row.AddMember(name, intVal, allocator);
-					break;
-				}
-				case 21:    //SMALLINT 2 bytes: int2
-				{
-					int16_t intVal = (short)atoi(PQgetvalue(res, i, j));
-					Value name(PQfname(res, j), allocator);
-					row.AddMember(name, intVal, allocator);
+				case RESULT_INT16:
+					writer.Key(names[j]);
+					writer.Int(binary[j] ? (int16_t)resultInt(value, 2) : (short)atoi(value));
 					break;
-				}
-				case 20:    //BIG INT 8 bytes: int8
-				{
-					int64_t intVal = atol(PQgetvalue(res, i, j));
-					Value name(PQfname(res, j), allocator);
-					row.AddMember(name, intVal, allocator);
+				case RESULT_INT32:
+					writer.Key(names[j]);
+					writer.Int(binary[j] ? (int32_t)resultInt(value, 4) : atoi(value));
 					break;
-				}
-				case 700: // float4
-				case 701: // float8
-				case 710: // this OID doesn't exist
-				{
-					double dblVal = atof(PQgetvalue(res, i, j));
-					Value name(PQfname(res, j), allocator);
-					row.AddMember(name, dblVal, allocator);
+				case RESULT_INT64:
+					writer.Key(names[j]);
+					writer.Int64(binary[j] ? (int64_t)resultInt(value, 8) : atol(value));
 					break;
-				}
-				case 1184: // Timestamp: timestamptz
+				case RESULT_FLOAT4:
+				case RESULT_FLOAT8:
 				{
-					char *str = PQgetvalue(res, i, j);
-					Value value(str, allocator);
-					Value name(PQfname(res, j), allocator);
-					row.AddMember(name, value, allocator);
+					double dblVal;
+					if (!binary[j])
+					{
+						dblVal = atof(value);
+					}
+					else if (types[j] == RESULT_FLOAT4)
+					{
+						uint32_t bits = (uint32_t)resultInt(value, 4);
+						float fltVal;
+						memcpy(&fltVal, &bits, sizeof(fltVal));
+						dblVal = fltVal;
+					}
+					else
+					{
+						uint64_t bits = resultInt(value, 8);
+						memcpy(&dblVal, &bits, sizeof(dblVal));
+					}
+					writer.Key(names[j]);
+					writer.Double(dblVal);
 					break;
 				}
-				default:
-				{
-					char *str = PQgetvalue(res, i, j);
-					if (oid == 1042) // char(x) rather than varchar so trim white space
+				case RESULT_TIMESTAMP:
+					writer.Key(names[j]);
+					if (binary[j])
 					{
-						str = trim(str);
+						resultTimestamp((int64_t)resultInt(value, 8), timestamp, sizeof(timestamp));
+						writer.String(timestamp);
+					}
+					else
+					{
+						writer.String(value, length);
 					}
-					Value value(str, allocator);
-					Value name(PQfname(res, j), allocator);
-					row.AddMember(name, value, allocator);
 					break;
-				}
+				case RESULT_CHAR:
+					// char(x) rather than varchar so trim white space
+					value = trim(value);
+					writer.Key(names[j]);
+					writer.String(value);
+					break;
+				default:
+					writer.Key(names[j]);
+					writer.String(value, length);
+					break;
 			}
 		}
-		rows.PushBack(row, allocator);  // Add the row
+		writer.EndObject();
 	}
-	doc.AddMember("rows", rows, allocator); // Add the rows to the JSON
-	/* Write out the JSON document we created */
-	StringBuffer buffer;
-	Writer<StringBuffer> writer(buffer);
-	doc.Accept(writer);
-	resultSet = buffer.GetString();
+	writer.EndArray();
+	writer.EndObject();
+	resultSet.assign(buffer.GetString(), buffer.GetSize());
 }
 
 /**
@@ -3018,7 +4275,7 @@ SQLBuffer buf;
 	buf.append(table);
 	buf.append("'");
 	const char *query = buf.coalesce();
-	PGresult *res = PQexec(dbConnection, query);
+	PGresult *res = timedExec(query);
 	delete[] query;
 	if (PQresultStatus(res) == PGRES_TUPLES_OK)
 	{
@@ -3165,7 +4422,7 @@ int Connection::create_table_snapshot(const string& table, const string& id)
 
 	logSQL("CreateTableSnapshot", query.c_str());
 
-	PGresult *res = PQexec(dbConnection, query.c_str());
+	PGresult *res = timedExec(query.c_str());
 	if (PQresultStatus(res) == PGRES_COMMAND_OK)
 	{
 		PQclear(res);
@@ -3195,7 +4452,7 @@ int Connection::load_table_snapshot(const string& table, const string& id)
 
 	logSQL("LoadTableSnapshot", query.c_str());
 
-	PGresult *res = PQexec(dbConnection, query.c_str());
+	PGresult *res = timedExec(query.c_str());
 	if (PQresultStatus(res) == PGRES_COMMAND_OK)
 	{
 		PQclear(res);
@@ -3203,7 +4460,7 @@ int Connection::load_table_snapshot(const string& table, const string& id)
 	}
 	else
 	{
-		PGresult *resRollback = PQexec(dbConnection, "ROLLBACK;");
+		PGresult *resRollback = timedExec("ROLLBACK;");
 		if (PQresultStatus(resRollback) != PGRES_COMMAND_OK)
 		{
 			raiseError(" rollback load_table_snapshot",
@@ -3230,7 +4487,7 @@ int Connection::delete_table_snapshot(const string& table, const string& id)
 
 	logSQL("DeleteTableSnapshot", query.c_str());
 
-	PGresult *res = PQexec(dbConnection, query.c_str());
+	PGresult *res = timedExec(query.c_str());
 	if (PQresultStatus(res) == PGRES_COMMAND_OK)
 	{
 		PQclear(res);
@@ -3265,7 +4522,7 @@ SQLBuffer sql;
 		const char *query = sql.coalesce();
 		logSQL("GetTableSnapshots", query);
 
-		PGresult *res = PQexec(dbConnection, query);
+		PGresult *res = timedExec(query);
 		delete[] query;
 		if (PQresultStatus(res) == PGRES_TUPLES_OK)
 		{
@@ -3580,7 +4837,7 @@ bool Connection::findSchemaFromDB(const std::string &service, const std::string
                 const char *query = sql.coalesce();
                 logSQL("findSchemaFromDB", query);
 
-                PGresult *res = PQexec(dbConnection, query);
+                PGresult *res = timedExec(query);
                 delete[] query;
                 if (PQresultStatus(res) == PGRES_TUPLES_OK)
                 {
@@ -9,6 +9,7 @@
  */
 #include <connection_manager.h>
 #include <connection.h>
+#include <chrono>
 
 
 ConnectionManager *ConnectionManager::instance = 0;
@@ -20,6 +21,7 @@ ConnectionManager::ConnectionManager()
 {
 	lastError.message = NULL;
 	lastError.entryPoint = NULL;
+	m_copyReadings = true;
 	if (getenv("FLEDGE_TRACE_SQL"))
 		m_logSQL = true;
 	else
@@ -60,8 +62,10 @@ void ConnectionManager::growPool(unsigned int delta)
 	{
 		Connection *conn = new Connection();
 		conn->setTrace(m_logSQL);
+		conn->setCopyReadings(m_copyReadings);
 		idleLock.lock();
 		idle.push_back(conn);
+		m_usage.opened();
 		idleLock.unlock();
 	}
 }
@@ -80,39 +84,56 @@ Connection   *conn;
 	while (delta-- > 0)
 	{
 		idleLock.lock();
-		conn = idle.back();
-		idle.pop_back();
-		idleLock.unlock();
-		if (conn)
-		{
-			delete conn;
-			removed++;
-		}
-		else
+		if (idle.empty())
 		{
+			idleLock.unlock();
 			break;
 		}
+		conn = idle.back();
+		idle.pop_back();
+		m_usage.closed();
+		idleLock.unlock();
+		delete conn;
+		removed++;
 	}
 	return removed;
 }
 
+/**
+ * Return the usage of the pool
+ *
+ * @param usage	Set to the usage of the pool
+ * @param reset	Start a new period of usage
+ */
+void ConnectionManager::poolUsage(POOL_USAGE& usage, bool reset)
+{
+	std::lock_guard<std::mutex> guard(idleLock);
+	m_usage.usage(usage, reset);
+}
+
 /**
  * Allocate a connection from the idle pool. If
- * no connection is available add a new connection
+ * no connection is available add a new connection,
+ * the time taken is recorded as a wait for a connection
  */
 Connection *ConnectionManager::allocate()
 {
 Connection *conn = 0;
+auto start = std::chrono::steady_clock::now();
 
 	idleLock.lock();
 	if (idle.empty())
 	{
 		conn = new Connection();
+		m_usage.opened();
+		m_usage.allocated(true, std::chrono::duration_cast<std::chrono::microseconds>(
+					std::chrono::steady_clock::now() - start).count());
 	}
 	else
 	{
 		conn = idle.front();
 	    	idle.pop_front();
+		m_usage.allocated(false, 0);
 	}
 	idleLock.unlock();
 	if (conn)
@@ -137,6 +158,7 @@ void ConnectionManager::release(Connection *conn)
 	inUseLock.unlock();
 	idleLock.lock();
 	idle.push_back(conn);
+	m_usage.released();
 	idleLock.unlock();
 }
 
@@ -11,6 +11,8 @@
  */
 
 #include <sql_buffer.h>
+#include <query_shape.h>
+#include <reading_stream.h>
 #include <string>
 #include <rapidjson/document.h>
 #include <libpq-fe.h>
@@ -18,11 +20,18 @@
 #include <unordered_set>
 #include <functional>
 #include <vector>
+#include <mutex>
+#include <atomic>
 
 #define	STORAGE_PURGE_RETAIN_ANY 0x0001U
 #define	STORAGE_PURGE_RETAIN_ALL 0x0002U
 #define STORAGE_PURGE_SIZE	     0x0004U
 
+#define COPY_CHUNK_SIZE		65536	// Bytes of COPY data sent with each PQputCopyData
+#define POSTGRES_EPOCH_UNIX	946684800	// 2000-01-01 00:00:00 UTC, the epoch of the binary timestamps
+#define PIPELINE_BLOCK_SIZE	1000	// Commands sent in pipeline mode before the results are read
+#define PARTITIONS_AHEAD	2	// Partitions of the readings table created beyond the one in use
+
 class Connection {
 	public:
 		Connection();
@@ -34,6 +43,7 @@ class Connection {
 		int		update(const std::string& table, const std::string& data);
 		int		deleteRows(const std::string& table, const std::string& condition);
 		int		appendReadings(const char *readings);
+		int		readingStream(ReadingStream **readings, bool commit);
 		bool		fetchReadings(unsigned long id, unsigned int blksize, std::string& resultSet);
 		unsigned int	purgeReadings(unsigned long age, unsigned int flags, unsigned long sent, std::string& results);
 		unsigned int	purgeReadingsByRows(unsigned long rowcount, unsigned int flags,unsigned long sent, std::string& results);
@@ -41,6 +51,12 @@ class Connection {
 
 		long		tableSize(const std::string& table);
 		void		setTrace(bool flag) { m_logSQL = flag; };
+		void		setCopyReadings(bool flag) { m_copyReadings = flag; };
+		static void	setPartitionSize(unsigned long size) { m_partitionSize = size; };
+		static unsigned long
+				getPartitionSize() { return m_partitionSize; };
+		bool		partitionReadings();
+		void		readingsAppended(int rows);
     		static bool 	formatDate(char *formatted_date, size_t formatted_date_size, const char *date);
 		int		create_table_snapshot(const std::string& table, const std::string& id);
 		int		load_table_snapshot(const std::string& table, const std::string& id);
@@ -53,6 +69,44 @@ class Connection {
 
 	private:
 		bool		m_logSQL;
+		bool		m_copyReadings;
+		static unsigned long
+				m_partitionSize;	// Reading ids per partition, 0 if not partitioned
+		static std::atomic<unsigned long>
+				m_partitionAppended;	// Readings appended since the partitions were checked
+		static std::mutex
+				m_partitionMutex;
+		long		lastReadingId();
+		bool		readingsPartitions(std::vector<std::pair<std::string, std::pair<unsigned long, unsigned long>>>& partitions);
+		bool		createPartitions();
+		unsigned long	dropPartitions(unsigned long& rowidMin, unsigned long rowidLimit);
+		int		copyReadings(const rapidjson::Value& readings);
+		void		copyEscape(std::string& buffer, const char *str);
+		int		copyEnd(const char *operation, const char *error, int rows);
+		bool		copyBinary();
+		int		copyReadingStream(ReadingStream **readings);
+		std::unordered_set<std::string>
+				m_prepared;	// Names of the statements prepared on this connection
+		PGresult	*timedExec(const char *sql);
+		PGresult	*execPrepared(const char *name, const char *sql,
+					const std::vector<std::string>& params,
+					int resultFormat = 0);
+		unsigned long	purgePrepared(const char *name, const char *sql,
+					const std::vector<std::string>& params,
+					const char *phase, bool retrieve);
+		unsigned long	purgeResult(PGresult *res, const char *phase, bool retrieve);
+		bool		updateStatistics(const std::string& table,
+					const rapidjson::Value& updates, int& rows);
+		QueryShapeCache	m_shapes;	// SQL templates of the query shapes
+		const QueryTemplate
+				*cacheShape(const QueryShape& shape, const char *sql);
+		PGresult	*execShape(const QueryTemplate *shapeTemplate,
+					const QueryShape& shape);
+#ifdef LIBPQ_HAS_PIPELINING
+		bool		pipelinePrepared(const char *name, const char *sql,
+					const std::vector<std::vector<std::string>>& params,
+					int& rows);
+#endif
 		void		raiseError(const char *operation, const char *reason,...);
 		PGconn		*dbConnection;
 		void		mapResultSet(PGresult *res, std::string& resultSet);
@@ -11,6 +11,7 @@
  */
 
 #include <plugin_api.h>
+#include <pool_autoscaler.h>
 #include <list>
 #include <mutex>
 
@@ -18,16 +19,21 @@ class Connection;
 
 /**
  * Singleton class to manage Postgres connection pool
+ *
+ * The use of the pool is recorded for the PoolAutoscaler,
+ * which grows and shrinks the pool.
  */
-class ConnectionManager {
+class ConnectionManager : public ConnectionPool {
 	public:
 		static ConnectionManager  *getInstance();
 		void                      growPool(unsigned int);
 		unsigned int              shrinkPool(unsigned int);
+		void                      poolUsage(POOL_USAGE& usage, bool reset);
 		Connection                *allocate();
 		void                      release(Connection *);
 		void			  shutdown();
 		void			  setError(const char *, const char *, bool);
+		void			  setCopyReadings(bool copy) { m_copyReadings = copy; };
 		PLUGIN_ERROR		  *getError()
 					  {
 						return &lastError;
@@ -41,8 +47,10 @@ class ConnectionManager {
 		std::mutex                   idleLock;
 		std::mutex                   inUseLock;
 		std::mutex                   errorLock;
+		PoolUsage                    m_usage;	// Guarded by idleLock
 		PLUGIN_ERROR		     lastError;
 		bool			     m_logSQL;
+		bool			     m_copyReadings;
 };
 
 #endif
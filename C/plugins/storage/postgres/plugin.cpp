@@ -10,6 +10,7 @@
 #include <connection_manager.h>
 #include <connection.h>
 #include <plugin_api.h>
+#include <storage_profile.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <strings.h>
@@ -22,12 +23,16 @@
 #include <string>
 #include <logger.h>
 #include <plugin_exception.h>
+#include <config_category.h>
+#include <pool_autoscaler.h>
 
 using namespace std;
 using namespace rapidjson;
 
 #define DEFAULT_SCHEMA "fledge"
 
+static PoolAutoscaler	*poolAutoscaler = NULL;
+
 /**
  * The Postgres plugin interface
  */
@@ -41,6 +46,44 @@ const char *default_config = QUOTE({
                         "default" : "5",
                         "displayName" : "Pool Size",
                         "order" : "1"
+                        },
+                "copyReadings" : {
+                        "description" : "Append readings using COPY rather than INSERT statements",
+                        "type" : "boolean",
+                        "default" : "true",
+                        "displayName" : "Bulk Copy",
+                        "order" : "2"
+                        },
+                "partitionSize" : {
+                        "description" : "The number of readings held in each partition of the readings table, the purge drops the partitions of the older readings. 0 keeps an unpartitioned table",
+                        "type" : "integer",
+                        "default" : "0",
+                        "displayName" : "Readings per partition",
+                        "order" : "3"
+                        },
+                "poolScaleInterval" : {
+                        "description" : "Seconds between the resizes of the pool of connections from the demand for connections, 0 keeps the connections opened when they are needed",
+                        "type" : "integer",
+                        "default" : "0",
+                        "minimum" : "0",
+                        "displayName" : "Pool resize interval",
+                        "order" : "4"
+                        },
+                "poolMinimum" : {
+                        "description" : "The smallest number of connections the pool is resized to",
+                        "type" : "integer",
+                        "default" : "5",
+                        "minimum" : "1",
+                        "displayName" : "Minimum pool size",
+                        "order" : "5"
+                        },
+                "poolMaximum" : {
+                        "description" : "The largest number of connections the pool is resized to, 0 for no limit. Connections needed above the limit are still opened and are closed once they are idle",
+                        "type" : "integer",
+                        "default" : "0",
+                        "minimum" : "0",
+                        "displayName" : "Maximum pool size",
+                        "order" : "6"
                         }
                 });
 
@@ -69,11 +112,49 @@ PLUGIN_INFORMATION *plugin_info()
  * In the case of Postgres we also get a pool of connections
  * to use.
  */
-PLUGIN_HANDLE plugin_init()
+PLUGIN_HANDLE plugin_init(ConfigCategory *category)
 {
 ConnectionManager *manager = ConnectionManager::getInstance();
 
-	manager->growPool(5);
+	if (category && category->itemExists("copyReadings"))
+	{
+		manager->setCopyReadings(category->getValue("copyReadings").compare("true") == 0);
+	}
+	if (category && category->itemExists("partitionSize"))
+	{
+		Connection::setPartitionSize(strtoul(category->getValue("partitionSize").c_str(), NULL, 10));
+	}
+	unsigned int poolSize = 5;
+	if (category && category->itemExists("poolSize"))
+	{
+		poolSize = strtoul(category->getValue("poolSize").c_str(), NULL, 10);
+	}
+	manager->growPool(poolSize);
+	if (Connection::getPartitionSize())
+	{
+		Connection *connection = manager->allocate();
+		connection->partitionReadings();
+		manager->release(connection);
+	}
+
+	unsigned int poolInterval = 0, poolMinimum = poolSize, poolMaximum = 0;
+	if (category && category->itemExists("poolScaleInterval"))
+	{
+		poolInterval = strtoul(category->getValue("poolScaleInterval").c_str(), NULL, 10);
+	}
+	if (category && category->itemExists("poolMinimum"))
+	{
+		poolMinimum = strtoul(category->getValue("poolMinimum").c_str(), NULL, 10);
+	}
+	if (category && category->itemExists("poolMaximum"))
+	{
+		poolMaximum = strtoul(category->getValue("poolMaximum").c_str(), NULL, 10);
+	}
+	poolAutoscaler = new PoolAutoscaler(manager);
+	if (poolInterval)
+	{
+		poolAutoscaler->start(poolMinimum, poolMaximum, poolInterval);
+	}
 	return manager;
 }
 
@@ -82,6 +163,7 @@ ConnectionManager *manager = ConnectionManager::getInstance();
  */
 int plugin_common_insert(PLUGIN_HANDLE handle, char *schema, char *table, char *data)
 {
+ProfileTimer	  timer(ProfileInsert);
 ConnectionManager *manager = (ConnectionManager *)handle;
 Connection        *connection = manager->allocate();
 
@@ -97,6 +179,7 @@ if (!schema) schema = DEFAULT_SCHEMA;
  */
 const char *plugin_common_retrieve(PLUGIN_HANDLE handle, char *schema, char *table, char *query)
 {
+ProfileTimer	  timer(ProfileQuery);
 ConnectionManager *manager = (ConnectionManager *)handle;
 Connection        *connection = manager->allocate();
 std::string results;
@@ -117,6 +200,7 @@ if (!schema) schema = DEFAULT_SCHEMA;
  */
 int plugin_common_update(PLUGIN_HANDLE handle, char *schema, char *table, char *data)
 {
+ProfileTimer	  timer(ProfileUpdate);
 ConnectionManager *manager = (ConnectionManager *)handle;
 Connection        *connection = manager->allocate();
 if (!schema) schema = DEFAULT_SCHEMA;
@@ -131,6 +215,7 @@ if (!schema) schema = DEFAULT_SCHEMA;
  */
 int plugin_common_delete(PLUGIN_HANDLE handle, char *schema , char *table, char *condition)
 {
+ProfileTimer	  timer(ProfileDelete);
 ConnectionManager *manager = (ConnectionManager *)handle;
 Connection        *connection = manager->allocate();
 
@@ -146,19 +231,37 @@ if (!schema) schema = DEFAULT_SCHEMA;
  */
 int plugin_reading_append(PLUGIN_HANDLE handle, char *readings)
 {
+ProfileTimer	  timer(ProfileAppend);
 ConnectionManager *manager = (ConnectionManager *)handle;
 Connection        *connection = manager->allocate();
 
 	int result = connection->appendReadings(readings);
+	connection->readingsAppended(result);
 	manager->release(connection);
 	return result;;
 }
 
+/**
+ * Append a stream of readings to the readings buffer
+ */
+int plugin_readingStream(PLUGIN_HANDLE handle, ReadingStream **readings, bool commit)
+{
+ProfileTimer	  timer(ProfileAppend);
+ConnectionManager *manager = (ConnectionManager *)handle;
+Connection        *connection = manager->allocate();
+
+	int result = connection->readingStream(readings, commit);
+	connection->readingsAppended(result);
+	manager->release(connection);
+	return result;
+}
+
 /**
  * Fetch a block of readings from the readings buffer
  */
 char *plugin_reading_fetch(PLUGIN_HANDLE handle, unsigned long id, unsigned int blksize)
 {
+ProfileTimer	  timer(ProfileFetch);
 ConnectionManager *manager = (ConnectionManager *)handle;
 Connection        *connection = manager->allocate();
 std::string	  resultSet;
@@ -173,6 +276,7 @@ std::string	  resultSet;
  */
 char *plugin_reading_retrieve(PLUGIN_HANDLE handle, char *condition)
 {
+ProfileTimer	  timer(ProfileReadingQuery);
 ConnectionManager *manager = (ConnectionManager *)handle;
 Connection        *connection = manager->allocate();
 std::string results;
@@ -187,6 +291,7 @@ std::string results;
  */
 char *plugin_reading_purge(PLUGIN_HANDLE handle, unsigned long param, unsigned int flags, unsigned long sent)
 {
+ProfileTimer	  timer(ProfilePurge);
 ConnectionManager *manager = (ConnectionManager *)handle;
 Connection        *connection = manager->allocate();
 std::string 	  results;
@@ -214,6 +319,38 @@ void plugin_release(PLUGIN_HANDLE handle, char *results)
 	free(results);
 }
 
+/**
+ * Return the statistics of the plugin as a JSON document
+ */
+char *plugin_statistics(PLUGIN_HANDLE handle)
+{
+	(void)handle;
+	string pool;
+	poolAutoscaler->asJSON(pool);
+	string results = "{ \"pool\" : " + pool + " }";
+	return strdup(results.c_str());
+}
+
+/**
+ * Return the latency profile of the storage plugins as a JSON document
+ *
+ * @param handle	The plugin handle
+ * @param reset		Clear the profile once it has been returned
+ */
+char *plugin_profile(PLUGIN_HANDLE handle, bool reset)
+{
+StorageProfile	*profile = StorageProfile::getInstance();
+std::string	results;
+
+	(void)handle;
+	profile->asJSON(results);
+	if (reset)
+	{
+		profile->reset();
+	}
+	return strdup(results.c_str());
+}
+
 /**
  * Return details on the last error that occured.
  */
@@ -231,6 +368,7 @@ bool plugin_shutdown(PLUGIN_HANDLE handle)
 {
 ConnectionManager *manager = (ConnectionManager *)handle;
   
+	poolAutoscaler->stop();
 	manager->shutdown();
 	return true;
 }
@@ -8,11 +8,17 @@
  * Author: Massimiliano Pinto
  */
 #include <connection.h>
+#include <payload_document.h>
+#include <storage_profile.h>
 #include <connection_manager.h>
 #include <common.h>
 #include <utils.h>
 
 #include "readings_catalogue.h"
+#include <pragma_configuration.h>
+#include <readings_blobs.h>
+#include <readings_compression.h>
+#include <readings_timestamps.h>
 
 /*
  * Control the way purge deletes readings. The block size sets a limit as to how many rows
@@ -37,19 +43,15 @@ using namespace rapidjson;
 #define CONNECT_ERROR_THRESHOLD		5*60	// 5 minutes
 
 /*
- * The following allows for conditional inclusion of code that tracks the top queries
- * run by the storage plugin and the number of times a particular statement has to
- * be retried because of the database being busy./
+ * The following allows for conditional inclusion of code that tracks the number of
+ * times a particular statement has to be retried because of the database being busy.
+ * The slowest statements are always kept by the storage profile.
  */
 #define DO_PROFILE		0
 #define DO_PROFILE_RETRIES	0
 #if DO_PROFILE
-#include <profile.h>
-
-#define	TOP_N_STATEMENTS		10	// Number of statements to report in top n
 #define RETRY_REPORT_THRESHOLD		1000	// Report retry statistics every X calls
 
-QueryProfile profiler(TOP_N_STATEMENTS);
 unsigned long retryStats[MAX_RETRIES] = { 0,0,0,0,0,0,0,0,0,0 };
 unsigned long numStatements = 0;
 int	      maxQueue = 0;
@@ -418,8 +420,10 @@ bool retCode;
 #ifndef SQLITE_SPLIT_READINGS
 /**
  * Create a SQLite3 database connection
+ *
+ * @param readOnly	Open the databases read only, for the connections that only run queries
  */
-Connection::Connection()
+Connection::Connection(bool readOnly) : m_readOnly(readOnly)
 {
 	string dbPath, dbPathReadings;
 	const char *defaultConnection = getenv("DEFAULT_SQLITE_DB_FILE");
@@ -428,6 +432,7 @@ Connection::Connection()
 	m_logSQL = false;
 	m_queuing = 0;
 	m_streamOpenTransaction = true;
+	m_stmtGeneration = 0;
 
 	if (defaultConnection == NULL)
 	{
@@ -467,7 +472,7 @@ Connection::Connection()
 	 */
 	if (sqlite3_open_v2(dbPath.c_str(),
 			    &dbHandle,
-			    SQLITE_OPEN_READWRITE | SQLITE_OPEN_NOMUTEX,
+			    (readOnly ? SQLITE_OPEN_READONLY : SQLITE_OPEN_READWRITE) | SQLITE_OPEN_NOMUTEX,
 			    NULL) != SQLITE_OK)
 	{
 		const char* dbErrMsg = sqlite3_errmsg(dbHandle);
@@ -493,12 +498,12 @@ Connection::Connection()
 		char *zErrMsg = NULL;
 
 		// Enable the WAL for the fledge DB
-		rc = sqlite3_exec(dbHandle, DB_CONFIGURATION, NULL, NULL, &zErrMsg);
+		const char *dbConfiguration = readOnly ? DB_READONLY_CONFIGURATION : DB_CONFIGURATION;
+		rc = sqlite3_exec(dbHandle, dbConfiguration, NULL, NULL, &zErrMsg);
 		if (rc != SQLITE_OK)
 		{
-			string errMsg = "Failed to set WAL from the fledge DB - " DB_CONFIGURATION;
-			Logger::getLogger()->error("%s : error %s",
-			                           DB_CONFIGURATION,
+			Logger::getLogger()->error("Failed to set WAL from the fledge DB - %s : error %s",
+			                           dbConfiguration,
 									   zErrMsg);
 			connectErrorTime = time(0);
 
@@ -580,12 +585,11 @@ Connection::Connection()
 			delete[] sqlReadingsStmt;
 
 			// Enable the WAL for the readings DB
-			rc = sqlite3_exec(dbHandle, DB_CONFIGURATION,NULL, NULL, &zErrMsg);
+			rc = sqlite3_exec(dbHandle, dbConfiguration, NULL, NULL, &zErrMsg);
 			if (rc != SQLITE_OK)
 			{
-				string errMsg = "Failed to set WAL from the readings DB - " DB_CONFIGURATION;
-				Logger::getLogger()->error("%s : error %s",
-										   errMsg.c_str(),
+				Logger::getLogger()->error("Failed to set WAL from the readings DB - %s : error %s",
+										   dbConfiguration,
 										   zErrMsg);
 				connectErrorTime = time(0);
 
@@ -606,8 +610,17 @@ Connection::Connection()
 			connectErrorTime = time(0);
 			sqlite3_close_v2(dbHandle);
 		}
+		else
+		{
+			PragmaConfiguration::getInstance()->apply(dbHandle);
+		}
 	}
 
+	// The readings may be stored compressed
+	ReadingsCompression::registerFunction(dbHandle);
+	// And their timestamps stored as integers
+	ReadingsTimestamps::registerFunctions(dbHandle);
+
 	m_schemaManager = SchemaManager::getInstance();
 }
 #endif
@@ -618,6 +631,7 @@ Connection::Connection()
  */
 Connection::~Connection()
 {
+	clearStatementCache();
 	sqlite3_close_v2(dbHandle);
 }
 
@@ -649,6 +663,10 @@ Document doc;
 int rc;
 // Number of returned rows, number of columns
 unsigned long nRows = 0, nCols = 0;
+#ifndef SQLITE_SPLIT_READINGS
+// The values may hold references to binary objects
+bool blobsStored = ReadingsBlobs::getInstance()->isStored();
+#endif
 
 	// Create the JSON document
 	doc.SetObject();
@@ -698,6 +716,13 @@ unsigned long nRows = 0, nCols = 0;
 						// Use new formatted datetime value
 						str = (char *)newDate.c_str();
 					}
+#ifndef SQLITE_SPLIT_READINGS
+					else if (blobsStored && expandBlobs(str, newDate))
+					{
+						// Images and data buffers stored as binary objects
+						str = (char *)newDate.c_str();
+					}
+#endif
 
 					Value value;
 					if (!d.Parse(str).HasParseError())
@@ -864,13 +889,15 @@ bool Connection::retrieve(const string& schema,
 			  const string& condition,
 			  string& resultSet)
 {
-// Default template parameter uses UTF8 and MemoryPoolAllocator.
-Document	document;
+PayloadDocument	payloadDoc;
+Document&	document = payloadDoc.get();
 SQLBuffer	sql;
 // Extra constraints to add to where clause
 SQLBuffer	jsonConstraints;
 bool		isOptAggregate = false;
 vector<string>  asset_codes;
+QueryShape	shape(document);
+const QueryTemplate *shapeTemplate = NULL;
 
 	if (!m_schemaManager->exists(dbHandle, schema))
 	{
@@ -894,11 +921,24 @@ vector<string>  asset_codes;
 		}
 		else
 		{
-			if (document.Parse(condition.c_str()).HasParseError())
+			if (payloadDoc.parse(condition.c_str()).HasParseError())
 			{
 				raiseError("retrieve", "Failed to parse JSON payload");
 				return false;
 			}
+
+			// A query of a shape already seen executes the SQL template of the shape
+			shape.extract("retrieve", schema + "." + table);
+			shapeTemplate = m_shapes.find(shape.key());
+			if (shapeTemplate && shapeTemplate->m_cacheable)
+			{
+				return execShape("retrieve", shapeTemplate, shape, &resultSet) == SQLITE_DONE;
+			}
+			else if (shapeTemplate)
+			{
+				shape.restore();
+			}
+
 			if (document.HasMember("aggregate"))
 			{
 				sql.append("SELECT ");
@@ -1116,9 +1156,7 @@ vector<string>  asset_codes;
 				if (! jsonConstraints.isEmpty())
 				{
 					sql.append(" AND ");
-                                        const char *jsonBuf =  jsonConstraints.coalesce();
-                                        sql.append(jsonBuf);
-                                        delete[] jsonBuf;
+                                        sql.append(jsonConstraints.c_str());
 				}
 			}
 			if (!jsonModifiers(document, sql, false))
@@ -1129,11 +1167,19 @@ vector<string>  asset_codes;
 		}
 		sql.append(';');
 
-		const char *query = sql.coalesce();
+		const char *query = sql.c_str();
 		char *zErrMsg = NULL;
 		int rc;
 		sqlite3_stmt *stmt;
 
+		if (shape.extracted() && !shapeTemplate)
+		{
+			// The SQL of a new shape has the markers of the literal
+			// values, the query is executed again using the new shape
+			cacheShape(shape, query);
+			return retrieve(schema, table, condition, resultSet);
+		}
+
 		logSQL("CommonRetrive", query);
 
 		// Prepare the SQL statement and get the result set
@@ -1143,7 +1189,6 @@ vector<string>  asset_codes;
 		{
 			raiseError("retrieve", sqlite3_errmsg(dbHandle));
 			Logger::getLogger()->error("SQL statement: %s", query);
-			delete[] query;
 			return false;
 		}
 
@@ -1158,13 +1203,10 @@ vector<string>  asset_codes;
 		{
 			raiseError("retrieve", sqlite3_errmsg(dbHandle));
 			Logger::getLogger()->error("SQL statement: %s", query);
-			delete[] query;
 			// Failure
 			return false;
 		}
 
-		// Release memory for 'query' var
-		delete[] query;
 		// Success
 		return true;
 	} catch (exception e) {
@@ -1180,8 +1222,9 @@ vector<string>  asset_codes;
  */
 int Connection::insert(const string& schema, const string& table, const string& data)
 {
-SQLBuffer	sql;
-Document	document;
+SQLBuffer	sql(data.length() + BUFFER_CHUNK);	// The statement is about the size of the payload
+PayloadDocument	payloadDoc;
+Document&	document = payloadDoc.get();
 ostringstream convert;
 std::size_t arr = data.find("inserts");
 
@@ -1204,7 +1247,7 @@ std::size_t arr = data.find("inserts");
 		convert << " ] }";
 	}
 
-	if (document.Parse(stdInsert ? convert.str().c_str() : data.c_str()).HasParseError())
+	if (payloadDoc.parse(stdInsert ? convert.str().c_str() : data.c_str()).HasParseError())
 	{
 		raiseError("insert", "Failed to parse JSON payload\n");
 		return -1;
@@ -1292,9 +1335,7 @@ std::size_t arr = data.find("inserts");
 			col++;
 		}
 		sql.append(") VALUES (");
-		const char *vals = values.coalesce();
-		sql.append(vals);
-		delete[] vals;
+		sql.append(values.c_str());
 		sql.append(");");
 
 		// Increment row count
@@ -1303,7 +1344,7 @@ std::size_t arr = data.find("inserts");
 
 	sql.append("COMMIT TRANSACTION;");
 
-	const char *query = sql.coalesce();
+	const char *query = sql.c_str();
 	logSQL("CommonInsert", query);
 	char *zErrMsg = NULL;
 	int rc;
@@ -1342,16 +1383,12 @@ std::size_t arr = data.find("inserts");
 		}
 
 		Logger::getLogger()->error("SQL statement: %s", query);
-		// Release memory for 'query' var
-		delete[] query;
 
 		// Failure
 		return -1;
 	}
 	else
 	{
-		// Release memory for 'query' var
-		delete[] query;
 
 		int insert = sqlite3_changes(dbHandle);
 
@@ -1374,10 +1411,12 @@ std::size_t arr = data.find("inserts");
  */
 int Connection::update(const string& schema, const string& table, const string& payload)
 {
-// Default template parameter uses UTF8 and MemoryPoolAllocator.
-Document	document;
+PayloadDocument	payloadDoc;
+Document&	document = payloadDoc.get();
 SQLBuffer	sql;
 vector<string>  asset_codes;
+QueryShape	shape(document);
+const QueryTemplate *shapeTemplate = NULL;
 
 	int 	row = 0;
 	ostringstream convert;
@@ -1400,7 +1439,7 @@ vector<string>  asset_codes;
 		convert << " ] }";
 	}
 
-	if (document.Parse(changeReqd?convert.str().c_str():payload.c_str()).HasParseError())
+	if (payloadDoc.parse(changeReqd?convert.str().c_str():payload.c_str()).HasParseError())
 	{
 		raiseError("update", "Failed to parse JSON payload");
 		return -1;
@@ -1414,6 +1453,28 @@ vector<string>  asset_codes;
 			return -1;
 		}
 
+		// An update of a shape already seen executes the SQL template of the shape
+		shape.extract("update", schema + "." + table);
+		shapeTemplate = m_shapes.find(shape.key());
+		if (shapeTemplate && shapeTemplate->m_cacheable)
+		{
+			if (execShape("update", shapeTemplate, shape, NULL) != SQLITE_DONE)
+			{
+				return -1;
+			}
+			int update = sqlite3_changes(dbHandle);
+			if (update == 0)
+			{
+				raiseError("update", "Not all updates within transaction succeeded");
+				return -1;
+			}
+			return (updates.Size() == 1 ? update : (int)updates.Size());
+		}
+		else if (shapeTemplate)
+		{
+			shape.restore();
+		}
+
 		sql.append("BEGIN TRANSACTION;");
 		int i=0;
 		for (Value::ConstValueIterator iter = updates.Begin(); iter != updates.End(); ++iter,++i)
@@ -1698,7 +1759,14 @@ vector<string>  asset_codes;
 	}
 	sql.append("COMMIT TRANSACTION;");
 	
-	const char *query = sql.coalesce();
+	const char *query = sql.c_str();
+	if (shape.extracted() && !shapeTemplate)
+	{
+		// The SQL of a new shape has the markers of the literal
+		// values, the update is executed again using the new shape
+		cacheShape(shape, query);
+		return update(schema, table, payload);
+	}
 	logSQL("CommonUpdate", query);
 	char *zErrMsg = NULL;
 	int rc;
@@ -1733,14 +1801,10 @@ vector<string>  asset_codes;
 			}
 		}
 		Logger::getLogger()->error("SQL statement: %s", query);
-		// Release memory for 'query' var
-		delete[] query;
 		return -1;
 	}
 	else
 	{
-		// Release memory for 'query' var
-		delete[] query;
 
 		int update = sqlite3_changes(dbHandle);
 
@@ -1769,6 +1833,49 @@ vector<string>  asset_codes;
 }
 #endif
 
+/**
+ * Convert a user timestamp, as formatted by formatDate, to the time
+ * since the epoch
+ *
+ * @param userTs	The user timestamp
+ * @param tv		Set to the time since the epoch
+ * @return bool		False if the timestamp can not be parsed
+ */
+bool userTsToTime(const char *userTs, struct timeval *tv)
+{
+	struct tm tm;
+	memset(&tm, 0, sizeof(tm));
+	if (strlen(userTs) < 19 || sscanf(userTs, "%d-%d-%d %d:%d:%d", &tm.tm_year, &tm.tm_mon,
+				&tm.tm_mday, &tm.tm_hour, &tm.tm_min, &tm.tm_sec) != 6)
+	{
+		return false;
+	}
+	tm.tm_year -= 1900;
+	tm.tm_mon -= 1;
+	tv->tv_sec = timegm(&tm);
+	tv->tv_usec = 0;
+
+	// The fraction of the seconds is followed by the timezone
+	const char *p = userTs + 19;
+	if (*p == '.')
+	{
+		long scale = 100000;
+		for (p++; isdigit(*p); p++)
+		{
+			tv->tv_usec += (*p - '0') * scale;
+			scale /= 10;
+		}
+	}
+	if (*p == '+' || *p == '-')
+	{
+		int hours = 0, minutes = 0;
+		sscanf(p + 1, "%d:%d", &hours, &minutes);
+		long offset = hours * 3600 + minutes * 60;
+		tv->tv_sec += (*p == '+') ? -offset : offset;
+	}
+	return true;
+}
+
 /**
  * Format a date to a fixed format with milliseconds, microseconds and
  * timezone expressed, examples :
@@ -2638,7 +2745,8 @@ bool Connection::jsonWhereClause(
 	SQLBuffer& sql,
 	std::vector<std::string>  &asset_codes,
 	bool convertLocaltime,
-	string prefix)
+	string prefix,
+	bool epochTs)
 {
 
 	string column;
@@ -2667,12 +2775,43 @@ bool Connection::jsonWhereClause(
 	}
 
 	column = whereClause["column"].GetString();
+	cond = whereClause["condition"].GetString();
+
+	// The user_ts stored as an integer is compared as it is stored, so
+	// that the user_ts index of the readings tables can be used
+	int64_t epochValue = 0;
+	bool epochCompare = false;
+	if (epochTs && !convertLocaltime && column.compare("user_ts") == 0)
+	{
+		const Value& value = whereClause["value"];
+		if ((!cond.compare("older") || !cond.compare("newer")) && value.IsInt())
+		{
+			epochValue = ReadingsTimestamps::now() - (int64_t)value.GetInt() * 1000000;
+			epochCompare = true;
+		}
+		else if ((!cond.compare("<") || !cond.compare("<=") || !cond.compare(">") || !cond.compare(">="))
+				&& value.IsString())
+		{
+			epochCompare = ReadingsTimestamps::toEpoch(value.GetString(), &epochValue);
+		}
+	}
+
 	if (!prefix.empty())
 		sql.append(prefix);
-	sql.append(column);
+	sql.append(epochCompare ? EPOCH_USER_TS : column);
 	sql.append(' ');
-	cond = whereClause["condition"].GetString();
-	if (!cond.compare("older"))
+	if (epochCompare)
+	{
+		if (!cond.compare("older"))
+			sql.append('<');
+		else if (!cond.compare("newer"))
+			sql.append('>');
+		else
+			sql.append(cond);
+		sql.append(' ');
+		sql.append((long)epochValue);
+	}
+	else if (!cond.compare("older"))
 	{
 		if (!whereClause["value"].IsInt())
 		{
@@ -2786,7 +2925,7 @@ bool Connection::jsonWhereClause(
 	if (whereClause.HasMember("and"))
 	{
 		sql.append(" AND ");
-		if (!jsonWhereClause(whereClause["and"], sql, asset_codes, convertLocaltime, prefix))
+		if (!jsonWhereClause(whereClause["and"], sql, asset_codes, convertLocaltime, prefix, epochTs))
 		{
 			return false;
 		}
@@ -2794,7 +2933,7 @@ bool Connection::jsonWhereClause(
 	if (whereClause.HasMember("or"))
 	{
 		sql.append(" OR ");
-		if (!jsonWhereClause(whereClause["or"], sql, asset_codes, convertLocaltime, prefix))
+		if (!jsonWhereClause(whereClause["or"], sql, asset_codes, convertLocaltime, prefix, epochTs))
 		{
 			return false;
 		}
@@ -3014,14 +3153,10 @@ int Connection::SQLexec(sqlite3 *db, const char *sql, int (*callback)(void*,int,
 int retries = 0, rc;
 
 	do {
-#if DO_PROFILE
-		ProfileItem *prof = new ProfileItem(sql);
-#endif
-		rc = sqlite3_exec(db, sql, callback, cbArg, errmsg);
-#if DO_PROFILE
-		prof->complete();
-		profiler.insert(prof);
-#endif
+		{
+			StatementTimer timer(sql);
+			rc = sqlite3_exec(db, sql, callback, cbArg, errmsg);
+		}
 		retries++;
 		if (rc != SQLITE_OK)
 		{
@@ -3105,14 +3240,10 @@ int Connection::SQLstep(sqlite3_stmt *statement)
 int retries = 0, rc;
 
 	do {
-#if DO_PROFILE
-		ProfileItem *prof = new ProfileItem(sqlite3_sql(statement));
-#endif
-		rc = sqlite3_step(statement);
-#if DO_PROFILE
-		prof->complete();
-		profiler.insert(prof);
-#endif
+		{
+			StatementTimer timer(sqlite3_sql(statement));
+			rc = sqlite3_step(statement);
+		}
 		retries++;
 		if (rc == SQLITE_LOCKED || rc == SQLITE_BUSY)
 		{
@@ -3163,10 +3294,12 @@ int retries = 0, rc;
  */
 int Connection::deleteRows(const string& schema, const string& table, const string& condition)
 {
-// Default template parameter uses UTF8 and MemoryPoolAllocator.
-Document document;
+PayloadDocument payloadDoc;
+Document& document = payloadDoc.get();
 SQLBuffer	sql;
 vector<string>  asset_codes;
+QueryShape	shape(document);
+const QueryTemplate *shapeTemplate = NULL;
 
 	if (!m_schemaManager->exists(dbHandle, schema))
 	{
@@ -3181,13 +3314,29 @@ vector<string>  asset_codes;
 	if (! condition.empty())
 	{
 		sql.append(" WHERE ");
-		if (document.Parse(condition.c_str()).HasParseError())
+		if (payloadDoc.parse(condition.c_str()).HasParseError())
 		{
 			raiseError("delete", "Failed to parse JSON payload");
 			return -1;
 		}
 		else
 		{
+			// A delete of a shape already seen executes the SQL template of the shape
+			shape.extract("delete", schema + "." + table);
+			shapeTemplate = m_shapes.find(shape.key());
+			if (shapeTemplate && shapeTemplate->m_cacheable)
+			{
+				if (execShape("delete", shapeTemplate, shape, NULL) != SQLITE_DONE)
+				{
+					return -1;
+				}
+				return sqlite3_changes(dbHandle);
+			}
+			else if (shapeTemplate)
+			{
+				shape.restore();
+			}
+
 			if (document.HasMember("where"))
 			{
 				if (!jsonWhereClause(document["where"], sql, asset_codes))
@@ -3205,7 +3354,14 @@ vector<string>  asset_codes;
 	}
 	sql.append(';');
 
-	const char *query = sql.coalesce();
+	const char *query = sql.c_str();
+	if (shape.extracted() && !shapeTemplate)
+	{
+		// The SQL of a new shape has the markers of the literal
+		// values, the delete is executed again using the new shape
+		cacheShape(shape, query);
+		return deleteRows(schema, table, condition);
+	}
 	logSQL("CommonDelete", query);
 	char *zErrMsg = NULL;
 	int delete_rows;
@@ -3226,7 +3382,6 @@ vector<string>  asset_codes;
 	if (rc == SQLITE_OK)
 	{
 		// Success. Release memory for 'query' var
-		delete[] query;
         	return sqlite3_changes(dbHandle);
 	}
 	else
@@ -3234,15 +3389,136 @@ vector<string>  asset_codes;
  		raiseError("delete", zErrMsg);
 		sqlite3_free(zErrMsg);
 		Logger::getLogger()->error("SQL statement: %s", query);
-		delete[] query;
 
 		// Failure
 		return -1;
 	}
 }
+
+/**
+ * Add the SQL template of a query shape to the cache of the connection
+ *
+ * @param shape			The shape of the query
+ * @param sql			The SQL built from the payload with the markers
+ * @return QueryTemplate*	The template of the shape
+ */
+const QueryTemplate *Connection::cacheShape(const QueryShape& shape, const char *sql)
+{
+	if (m_shapes.full())
+	{
+		m_shapes.clear();
+	}
+	return m_shapes.add(shape, sql, QueryShape::PlaceholderQuestion);
+}
+
+/**
+ * Execute the statements of the SQL template of a query shape with the
+ * literal values of the query bound to the placeholders. The statements
+ * are prepared once and kept in the statement cache of the connection.
+ * A transaction left open by a failed statement is rolled back.
+ *
+ * @param operation	The storage operation, for the errors raised
+ * @param shapeTemplate	The template of the shape of the query
+ * @param shape		The shape of the query with its literal values
+ * @param resultSet	Set to the rows of the last statement, NULL for a write
+ * @return int		SQLITE_DONE on success or the SQLite error code
+ */
+int Connection::execShape(const char *operation, const QueryTemplate *shapeTemplate,
+			  const QueryShape& shape, string *resultSet)
+{
+const vector<QueryParameter>& parameters = shape.parameters();
+int rc = SQLITE_DONE;
+
+	checkStatementCache();
+	if (!resultSet)
+	{
+		m_writeAccessOngoing.fetch_add(1);
+	}
+	for (int i = 0; i < (int)shapeTemplate->m_statements.size() && rc == SQLITE_DONE; i++)
+	{
+		const QueryStatement& statement = shapeTemplate->m_statements[i];
+		logSQL(operation, statement.m_sql.c_str());
+
+		sqlite3_stmt *stmt = getCachedStatement(statement.m_sql);
+		if (!stmt)
+		{
+			raiseError(operation, sqlite3_errmsg(dbHandle));
+			Logger::getLogger()->error("SQL statement: %s", statement.m_sql.c_str());
+			rc = SQLITE_ERROR;
+			break;
+		}
+		for (int p = 0; p < (int)statement.m_parameters.size(); p++)
+		{
+			const QueryParameter& parameter = parameters[statement.m_parameters[p]];
+			if (parameter.m_isString)
+			{
+				sqlite3_bind_text(stmt, p + 1, parameter.m_string.c_str(),
+						parameter.m_string.length(), SQLITE_STATIC);
+			}
+			else
+			{
+				sqlite3_bind_int(stmt, p + 1, parameter.m_integer);
+			}
+		}
+
+		if (resultSet && i == (int)shapeTemplate->m_statements.size() - 1)
+		{
+			rc = mapResultSet(stmt, *resultSet);
+		}
+		else
+		{
+			while ((rc = SQLstep(stmt)) == SQLITE_ROW)
+				;
+		}
+		if (rc != SQLITE_DONE)
+		{
+			raiseError(operation, sqlite3_errmsg(dbHandle));
+			Logger::getLogger()->error("SQL statement: %s", statement.m_sql.c_str());
+		}
+		sqlite3_reset(stmt);
+	}
+
+	if (rc != SQLITE_DONE && sqlite3_get_autocommit(dbHandle) == 0)
+	{
+		char *zErrMsg = NULL;
+		if (SQLexec(dbHandle, "ROLLBACK TRANSACTION;", NULL, NULL, &zErrMsg) != SQLITE_OK)
+		{
+			raiseError("rollback", zErrMsg);
+			sqlite3_free(zErrMsg);
+		}
+	}
+	if (!resultSet)
+	{
+		m_writeAccessOngoing.fetch_sub(1);
+		if (m_writeAccessOngoing == 0)
+			db_cv.notify_all();
+	}
+	return rc;
+}
 #endif
 
 #ifndef SQLITE_SPLIT_READINGS
+/**
+ * Execute a statement used to create a table snapshot
+ *
+ * @param operation	The operation to report if the statement fails
+ * @param sql		The SQL statement
+ * @return bool		True if the statement succeeded
+ */
+bool Connection::snapshotExec(const char *operation, const string& sql)
+{
+	logSQL(operation, sql.c_str());
+
+	char *zErrMsg = NULL;
+	if (SQLexec(dbHandle, sql.c_str(), NULL, NULL, &zErrMsg) != SQLITE_OK)
+	{
+		raiseError(operation, zErrMsg);
+		sqlite3_free(zErrMsg);
+		return false;
+	}
+	return true;
+}
+
 /**
  * Create snapshot of a common table
  *
@@ -3252,32 +3528,61 @@ vector<string>  asset_codes;
  *
  * The new created table name has the name:
  * $table_snap$id
+ *
+ * The table is first copied to a private in-memory database, reading
+ * the table does not stop other connections writing to the fledge
+ * database. The snapshot is then written from the copy in blocks of
+ * SNAPSHOT_BLOCK_ROWS, each in its own transaction, so that other
+ * writers are only locked out for the time taken to write a block.
  */
 int Connection::create_table_snapshot(const string& table, const string& id)
 {
-	string query = "CREATE TABLE fledge.";
-	query += table + "_snap" +  id + " AS SELECT * FROM fledge." + table;
+	string snapshot = "fledge." + table + "_snap" + id;
 
-	logSQL("CreateTableSnapshot", query.c_str());
+	if (!snapshotExec("CreateTableSnapshot",
+			"ATTACH DATABASE ':memory:' AS snapshot_copy; "
+			"CREATE TABLE snapshot_copy.data AS SELECT * FROM fledge." + table + ";"))
+	{
+		SQLexec(dbHandle, "DETACH DATABASE snapshot_copy;", NULL, NULL, NULL);
+		return -1;
+	}
 
-	char* zErrMsg = NULL;
-	int rc = SQLexec(dbHandle,
-			 query.c_str(),
-			 NULL,
-			 NULL,
-			 &zErrMsg);
+	// The rows of the copy are numbered from 1 in the order they were copied
+	long rows = 0;
+	sqlite3_stmt *stmt;
+	if (sqlite3_prepare_v2(dbHandle, "SELECT MAX(rowid) FROM snapshot_copy.data;", -1, &stmt, NULL) == SQLITE_OK)
+	{
+		if (SQLstep(stmt) == SQLITE_ROW)
+		{
+			rows = sqlite3_column_int64(stmt, 0);
+		}
+		sqlite3_finalize(stmt);
+	}
 
-	// Check result code
-	if (rc == SQLITE_OK)
+	bool created = snapshotExec("CreateTableSnapshot",
+			"CREATE TABLE " + snapshot + " AS SELECT * FROM snapshot_copy.data WHERE 0;");
+	bool copied = created;
+	for (long copiedRows = 0; copied && copiedRows < rows; copiedRows += SNAPSHOT_BLOCK_ROWS)
 	{
-		return 1;
+		copied = snapshotExec("CreateTableSnapshot",
+				"INSERT INTO " + snapshot + " SELECT * FROM snapshot_copy.data WHERE rowid > "
+				+ to_string(copiedRows) + " AND rowid <= " + to_string(copiedRows + SNAPSHOT_BLOCK_ROWS) + ";");
+		if (copied && rows > SNAPSHOT_BLOCK_ROWS)
+		{
+			Logger::getLogger()->info("Snapshot %s of table %s: %ld of %ld rows copied",
+					id.c_str(), table.c_str(),
+					min(copiedRows + SNAPSHOT_BLOCK_ROWS, rows), rows);
+		}
 	}
-	else
+
+	if (created && !copied)
 	{
-		raiseError("create_table_snapshot", zErrMsg);
-		sqlite3_free(zErrMsg);
-		return -1;
+		// Do not leave an incomplete snapshot
+		snapshotExec("CreateTableSnapshot", "DROP TABLE " + snapshot + ";");
 	}
+	snapshotExec("CreateTableSnapshot", "DETACH DATABASE snapshot_copy;");
+
+	return copied ? 1 : -1;
 }
 
 /**
@@ -12,7 +12,9 @@
 
 #include <connection_manager.h>
 #include <connection.h>
+#include <pragma_configuration.h>
 #include <logger.h>
+#include <chrono>
 
 ConnectionManager *ConnectionManager::instance = 0;
 
@@ -36,6 +38,14 @@ ConnectionManager::ConnectionManager()
 void ConnectionManager::shutdown()
 {
 	shrinkPool(idle.size());
+
+	idleLock.lock();
+	for (auto conn : readIdle)
+	{
+		delete conn;
+	}
+	readIdle.clear();
+	idleLock.unlock();
 }
 
 /**
@@ -66,6 +76,26 @@ void ConnectionManager::growPool(unsigned int delta)
 			conn->setTrace(true);
 		idleLock.lock();
 		idle.push_back(conn);
+		m_usage.opened();
+		idleLock.unlock();
+	}
+}
+
+/**
+ * Grow the pool of read only connections by the number of
+ * connections specified.
+ *
+ * @param delta	The number of connections to add to the pool
+ */
+void ConnectionManager::growReadPool(unsigned int delta)
+{
+	while (delta-- > 0)
+	{
+		Connection *conn = new Connection(true);
+		if (m_trace)
+			conn->setTrace(true);
+		idleLock.lock();
+		readIdle.push_back(conn);
 		idleLock.unlock();
 	}
 }
@@ -84,39 +114,67 @@ Connection   *conn;
 	while (delta-- > 0)
 	{
 		idleLock.lock();
-		conn = idle.back();
-		idle.pop_back();
-		idleLock.unlock();
-		if (conn)
-		{
-			delete conn;
-			removed++;
-		}
-		else
+		if (idle.empty())
 		{
+			idleLock.unlock();
 			break;
 		}
+		conn = idle.back();
+		idle.pop_back();
+		m_usage.closed();
+		idleLock.unlock();
+		delete conn;
+		removed++;
 	}
 	return removed;
 }
 
+/**
+ * Return the usage of the pool of connections that are not read only
+ *
+ * @param usage	Set to the usage of the pool
+ * @param reset	Start a new period of usage
+ */
+void ConnectionManager::poolUsage(POOL_USAGE& usage, bool reset)
+{
+	std::lock_guard<std::mutex> guard(idleLock);
+	m_usage.usage(usage, reset);
+}
+
+/**
+ * Return the idle connections of both pools, the caller
+ * must hold the idleLock
+ */
+std::list<Connection *> ConnectionManager::idleConnections()
+{
+	std::list<Connection *> conns(idle);
+	conns.insert(conns.end(), readIdle.begin(), readIdle.end());
+	return conns;
+}
+
 /**
  * Allocate a connection from the idle pool. If
- * no connection is available add a new connection
+ * no connection is available add a new connection,
+ * the time taken is recorded as a wait for a connection
  */
 Connection *ConnectionManager::allocate()
 {
 Connection *conn = 0;
+auto start = std::chrono::steady_clock::now();
 
 	idleLock.lock();
 	if (idle.empty())
 	{
 		conn = new Connection();
+		m_usage.opened();
+		m_usage.allocated(true, std::chrono::duration_cast<std::chrono::microseconds>(
+					std::chrono::steady_clock::now() - start).count());
 	}
 	else
 	{
 		conn = idle.front();
 	    	idle.pop_front();
+		m_usage.allocated(false, 0);
 	}
 	idleLock.unlock();
 	if (conn)
@@ -152,7 +210,7 @@ bool ConnectionManager::attachNewDb(std::string &path, std::string &alias)
 	// attach the DB to all idle connections
 	{
 
-		for ( auto conn : idle) {
+		for ( auto conn : idleConnections()) {
 
 			dbHandle = conn->getDbHandle();
 			rc = SQLExec (dbHandle, sqlCmd.c_str(), &zErrMsg);
@@ -164,6 +222,7 @@ bool ConnectionManager::attachNewDb(std::string &path, std::string &alias)
 				break;
 			}
 
+			PragmaConfiguration::getInstance()->applyDatabase(dbHandle, alias);
 			Logger::getLogger()->debug("attachNewDb idle dbHandle :%X: sqlCmd :%s: ", dbHandle, sqlCmd.c_str());
 
 		}
@@ -186,6 +245,7 @@ bool ConnectionManager::attachNewDb(std::string &path, std::string &alias)
 					break;
 				}
 
+				PragmaConfiguration::getInstance()->applyDatabase(dbHandle, alias);
 				Logger::getLogger()->debug("attachNewDb inUse dbHandle :%X: sqlCmd :%s: ", dbHandle, sqlCmd.c_str());
 			}
 		}
@@ -197,7 +257,8 @@ bool ConnectionManager::attachNewDb(std::string &path, std::string &alias)
 }
 
 /**
- * Detach a database from all the connections
+ * Detach a database from all the connections, a failure on
+ * a connection does not prevent the detach from the others
  *
  */
 bool ConnectionManager::detachNewDb(std::string &alias)
@@ -218,7 +279,7 @@ bool ConnectionManager::detachNewDb(std::string &alias)
 
 	// attach the DB to all idle connections
 	{
-		for ( auto conn : idle) {
+		for ( auto conn : idleConnections()) {
 
 			dbHandle = conn->getDbHandle();
 			rc = SQLExec (dbHandle, sqlCmd.c_str(), &zErrMsg);
@@ -227,15 +288,13 @@ bool ConnectionManager::detachNewDb(std::string &alias)
 				Logger::getLogger()->error("detachNewDb - It was not possible to detach the db :%s: from an idle connection, error :%s:", alias.c_str(), zErrMsg);
 				sqlite3_free(zErrMsg);
 				result = false;
-				break;
 			}
 			Logger::getLogger()->debug("detachNewDb - idle dbHandle :%X: sqlCmd :%s: ", dbHandle, sqlCmd.c_str());
 		}
 	}
 
-	if (result)
 	{
-		// attach the DB to all inUse connections
+		// detach the DB from all inUse connections
 		{
 
 			for ( auto conn : inUse) {
@@ -247,7 +306,6 @@ bool ConnectionManager::detachNewDb(std::string &alias)
 					Logger::getLogger()->error("detachNewDb - It was not possible to detach the db :%s: from an inUse connection, error :%s:", alias.c_str() ,zErrMsg);
 					sqlite3_free(zErrMsg);
 					result = false;
-					break;
 				}
 				Logger::getLogger()->debug("detachNewDb - inUse dbHandle :%X: sqlCmd :%s: ", dbHandle, sqlCmd.c_str());
 			}
@@ -283,7 +341,7 @@ bool ConnectionManager::attachRequestNewDb(int newDbId, sqlite3 *dbHandle)
 	// attach the DB to all idle connections
 	{
 
-		for ( auto conn : idle) {
+		for ( auto conn : idleConnections()) {
 
 			if (dbHandle == conn->getDbHandle())
 			{
@@ -325,6 +383,34 @@ bool ConnectionManager::attachRequestNewDb(int newDbId, sqlite3 *dbHandle)
 }
 
 
+/**
+ * Allocate a read only connection, for a caller that only runs
+ * queries. If no connection is available add a new connection
+ */
+Connection *ConnectionManager::allocateReader()
+{
+Connection *conn = 0;
+
+	idleLock.lock();
+	if (readIdle.empty())
+	{
+		conn = new Connection(true);
+	}
+	else
+	{
+		conn = readIdle.front();
+		readIdle.pop_front();
+	}
+	idleLock.unlock();
+	if (conn)
+	{
+		inUseLock.lock();
+		inUse.push_front(conn);
+		inUseLock.unlock();
+	}
+	return conn;
+}
+
 /**
  * Release a connection back to the idle pool for
  * reallocation.
@@ -337,7 +423,15 @@ void ConnectionManager::release(Connection *conn)
 	inUse.remove(conn);
 	inUseLock.unlock();
 	idleLock.lock();
-	idle.push_back(conn);
+	if (conn->isReadOnly())
+	{
+		readIdle.push_back(conn);
+	}
+	else
+	{
+		idle.push_back(conn);
+		m_usage.released();
+	}
 	idleLock.unlock();
 }
 
@@ -11,6 +11,7 @@
  */
 
 #include <sql_buffer.h>
+#include <query_shape.h>
 #include <string>
 #include <rapidjson/document.h>
 #include <sqlite3.h>
@@ -20,6 +21,13 @@
 #include <map>
 #include <vector>
 #include <atomic>
+#include <unordered_map>
+#include <set>
+#include <thread>
+#include <readings_writer.h>
+#include <readings_latest.h>
+
+class RollupBatch;
 
 #define _DB_NAME                  "/fledge.db"
 #define READINGS_DB_NAME_BASE     "readings"
@@ -43,6 +51,8 @@
 #define SQLITE3_FLEDGE_DATETIME_TYPE "DATETIME"
 
 #define  DB_CONFIGURATION "PRAGMA busy_timeout = 5000; PRAGMA cache_size = -4000; PRAGMA journal_mode = WAL; PRAGMA secure_delete = off; PRAGMA journal_size_limit = 4096000;"
+// Read only connections do not set the journal mode, it is set by the writers
+#define  DB_READONLY_CONFIGURATION "PRAGMA busy_timeout = 5000; PRAGMA cache_size = -4000; PRAGMA query_only = 1;"
 
 // Set plugin name for log messages
 #ifndef PLUGIN_LOG_NAME
@@ -76,6 +86,13 @@
 #define PURGE_SLOWDOWN_AFTER_BLOCKS 5
 #define PURGE_SLOWDOWN_SLEEP_MS 500
 
+/*
+ * Table snapshots are written in blocks of rows, each in its own transaction,
+ * so that other writers of the fledge database are not locked out for the
+ * duration of the copy
+ */
+#define SNAPSHOT_BLOCK_ROWS	1000
+
 #define SECONDS_PER_DAY "86400.0"
 // 2440587.5 is the julian day at 1/1/1970 0:00 UTC.
 #define JULIAN_DAY_START_UNIXTIME "2440587.5"
@@ -86,6 +103,15 @@
 				 auto usecs = std::chrono::duration_cast<std::chrono::microseconds>( t2 - t1 ).count();
 
 
+/**
+ * The assets and datapoints of a filtered readings fetch
+ */
+typedef struct {
+	std::vector<std::string>	assets;		// The assets to fetch, all if empty
+	bool				exclude;	// Fetch all the assets other than those listed
+	std::set<std::string>		datapoints;	// The datapoints to return, all if empty
+} ReadingsFetchFilter;
+
 int dateCallback(void *data, int nCols, char **colValues, char **colNames);
 bool applyColumnDateFormat(const std::string& inFormat,
 			   const std::string& colName,
@@ -113,10 +139,23 @@ int countCallback(void *data,
 		  char **colNames);
 
 bool applyDateFormat(const std::string& inFormat, std::string& outFormat);
+bool userTsToTime(const char *userTs, struct timeval *tv);
+
+/**
+ * A reading waiting to be inserted into a readings table
+ */
+typedef struct
+{
+	unsigned long	id;
+	std::string	userTs;
+	int64_t		epochTs;	// user_ts in microseconds since the epoch
+	std::string	reading;
+	bool		compressed;	// The reading is compressed
+} READING_ROW;
 
 class Connection {
 	public:
-		Connection();
+		Connection(bool readOnly = false);
 		~Connection();
 #ifndef SQLITE_SPLIT_READINGS
 		bool		createSchema(const std::string& schema);
@@ -139,35 +178,92 @@ class Connection {
 		bool		get_table_snapshots(const std::string& table, std::string& resultSet);
 #endif
 		int		appendReadings(const char *readings);
+		void		appendReadingsGroup(std::vector<AppendRequest *>& requests);
 		int 		readingStream(ReadingStream **readings, bool commit);
 		bool		fetchReadings(unsigned long id, unsigned int blksize,
 						std::string& resultSet);
+		bool		fetchReadingsBinary(unsigned long id, unsigned int blksize,
+						std::string& buffer, unsigned long *rows);
+		bool		fetchReadingsFiltered(unsigned long id, unsigned int blksize,
+						ReadingsFetchFilter& filter, std::string& resultSet);
 		bool		retrieveReadings(const std::string& condition,
 						 std::string& resultSet);
 		unsigned int	purgeReadings(unsigned long age, unsigned int flags,
 						unsigned long sent, std::string& results);
 		unsigned int	purgeReadingsByRows(unsigned long rowcount, unsigned int flags,
 						unsigned long sent, std::string& results);
+		long		purgeReadingsStep(unsigned long age, unsigned int flags,
+						unsigned long sent, unsigned long maxRows,
+						unsigned long budget, unsigned long *unsentPurged,
+						unsigned long *unsentRetained, unsigned long *readings);
 		long		tableSize(const std::string& table);
 		void		setTrace(bool);
 		bool		formatDate(char *formatted_date, size_t formatted_date_size, const char *date);
 		bool		aggregateQuery(const rapidjson::Value& payload, std::string& resultSet);
+		bool		createRollup();
+		bool		loadLatest();
+		bool		createBlobs();
+		bool		createDictionaries();
+		void		purgeRollup();
 		bool		getNow(std::string& Now);
 
 		sqlite3		*getDbHandle() {return dbHandle;};
+		bool		isReadOnly() const { return m_readOnly; };
 		void		setUsedDbId(int dbId);
+		void		attachPendingDbs();
 
 		void		shutdownAppendReadings();
 
 	private:
+#ifndef SQLITE_SPLIT_READINGS
+		bool		snapshotExec(const char *operation, const std::string& sql);
+#endif
 
 		std::vector<int>
 		       		m_NewDbIdList;            // Newly created databases that should be attached
 
 		bool		m_streamOpenTransaction;
+		bool		m_readOnly;
 		int		m_queuing;
 		std::mutex	m_qMutex;
 		int		SQLPrepare(sqlite3 *dbHandle, const char *sqlCmd, sqlite3_stmt **readingsStmt);
+		bool		insertReadingRows(const std::string& table,
+					std::vector<READING_ROW>& rows,
+					unsigned int rowsPerInsert);
+		bool		commitReadings(const std::set<std::string>& dbNames);
+		bool		writeRollup(const RollupBatch& batch);
+		bool		writeLatest(LatestBatch& batch);
+		LatestBatch	m_latest;		// Latest values written by the transaction
+		bool		storeBlobs(std::string& reading, unsigned long id,
+					int dbId, int tableId);
+		bool		expandBlobs(const char *text, std::string& expanded);
+		bool		compressReading(const std::string& asset, READING_ROW& row,
+					std::set<unsigned int>& dictionaries);
+		bool		storeDictionary(unsigned int id);
+		void		purgeBlobs();
+		bool		rollupQuery(const rapidjson::Value& payload,
+					std::string& resultSet, bool *done);
+		bool		readingsRowidLimit(const std::string& aggregate,
+					bool considerExclusion, unsigned long *rowid);
+		int		insertReadings(const std::vector<APPEND_READING>& readings,
+					std::set<std::string>& dbNames,
+					bool& boundarySet);
+		void		appendFailed(std::thread::id tid);
+		void		checkStatementCache();
+		sqlite3_stmt	*getCachedStatement(const std::string& sql);
+		void		clearStatementCache();
+		std::unordered_map<std::string, sqlite3_stmt *>
+				m_stmtCache;		// Prepared statements for the readings tables
+		unsigned long	m_stmtGeneration;	// Catalogue generation of m_stmtCache
+#ifndef SQLITE_SPLIT_READINGS
+		QueryShapeCache	m_shapes;		// SQL templates of the query shapes
+		const QueryTemplate
+				*cacheShape(const QueryShape& shape, const char *sql);
+		int		execShape(const char *operation,
+					const QueryTemplate *shapeTemplate,
+					const QueryShape& shape,
+					std::string *resultSet);
+#endif
 		int		SQLexec(sqlite3 *db, const char *sql,
 				int (*callback)(void*,int,char**,char**),
 					void *cbArg, char **errmsg);
@@ -178,8 +274,17 @@ class Connection {
 		sqlite3		*dbHandle;
 		SchemaManager	*m_schemaManager;
 		int		mapResultSet(void *res, std::string& resultSet, unsigned long *rowsCount = nullptr);
+		bool		fetchReadingRows(unsigned long id, unsigned int blksize,
+						std::string& resultSet, bool binary,
+						unsigned long *rows,
+						ReadingsFetchFilter *filter = NULL);
+		int		mapReadingsBinary(sqlite3_stmt *stmt, std::string& buffer,
+						unsigned long *rowsCount);
+		int		mapReadingsFiltered(sqlite3_stmt *stmt, const ReadingsFetchFilter& filter,
+						unsigned int blksize, unsigned long safeId,
+						std::string& resultSet, unsigned long *rowsCount);
 #ifndef SQLITE_SPLIT_READINGS
-		bool		jsonWhereClause(const rapidjson::Value& whereClause, SQLBuffer&, std::vector<std::string>  &asset_codes, bool convertLocaltime = false, std::string prefix = "");
+		bool		jsonWhereClause(const rapidjson::Value& whereClause, SQLBuffer&, std::vector<std::string>  &asset_codes, bool convertLocaltime = false, std::string prefix = "", bool epochTs = false);
 #else
 		bool		jsonWhereClause(const rapidjson::Value& whereClause, SQLBuffer&, bool convertLocaltime = false, std::string prefix = "");
 #endif
@@ -13,6 +13,7 @@
 #include <sqlite3.h>
 
 #include <plugin_api.h>
+#include <pool_autoscaler.h>
 #include <list>
 #include <mutex>
 
@@ -20,13 +21,24 @@ class Connection;
 
 /**
  * Singleton class to manage SQLite3 connection pool
+ *
+ * The connections that only run queries are allocated from a separate
+ * pool of read only connections, so that long queries do not hold the
+ * connections needed to append readings. The connections of both pools
+ * are in the inUse list whilst they are allocated.
+ *
+ * The use of the pool of connections that are not read only is recorded
+ * for the PoolAutoscaler, which grows and shrinks that pool.
  */
-class ConnectionManager {
+class ConnectionManager : public ConnectionPool {
 	public:
 		static ConnectionManager  *getInstance();
 		void                      growPool(unsigned int);
 		unsigned int              shrinkPool(unsigned int);
+		void                      poolUsage(POOL_USAGE& usage, bool reset);
 		Connection                *allocate();
+		void                      growReadPool(unsigned int);
+		Connection                *allocateReader();
 		bool                      attachNewDb(std::string &path, std::string &alias);
 		bool                      attachRequestNewDb(int newDbId, sqlite3 *dbHandle);
 		bool 					  detachNewDb(std::string &alias);
@@ -44,13 +56,16 @@ class ConnectionManager {
 	private:
 		static ConnectionManager     *instance;
 		int SQLExec(sqlite3 *dbHandle, const char *sqlCmd, char **errMsg);
+		std::list<Connection *>	idleConnections();
 
 	protected:
 		std::list<Connection *>      idle;
 		std::list<Connection *>      inUse;
+		std::list<Connection *>      readIdle;
 		std::mutex                   idleLock;
 		std::mutex                   inUseLock;
 		std::mutex                   errorLock;
+		PoolUsage                    m_usage;	// Guarded by idleLock
 		PLUGIN_ERROR		     lastError;
 		bool			     m_trace;
 };
@@ -0,0 +1,67 @@
+#ifndef _INCREMENTAL_PURGE_H
+#define _INCREMENTAL_PURGE_H
+/*
+ * Fledge storage service - Incremental purge of the readings
+ *
+ * Copyright (c) 2026 Dianomic Systems
+ *
+ * Released under the Apache 2.0 Licence
+ *
+ * Author: agent
+ */
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <string>
+
+class Connection;
+class ConnectionManager;
+
+/**
+ * A thread that purges the readings continuously, in small steps, rather
+ * than in one long operation each time the purge task runs.
+ *
+ * Each interval the thread deletes at most a number of readings within a
+ * time budget. The age, flags and sent id are those of the last request
+ * of the purge task, the purge task then receives the readings removed
+ * by the thread since its previous request.
+ */
+class IncrementalPurge {
+	public:
+		static IncrementalPurge	*getInstance();
+		void			start(ConnectionManager *manager,
+						unsigned int interval,
+						unsigned long maxRows,
+						unsigned long budget);
+		void			stop();
+		bool			isRunning() const { return m_running; };
+		void			purge(unsigned long age, unsigned int flags,
+						unsigned long sent, std::string& result);
+	private:
+		IncrementalPurge();
+		~IncrementalPurge();
+		void			purgeThread();
+	private:
+		static IncrementalPurge	*m_instance;
+		ConnectionManager	*m_manager;
+		Connection		*m_connection;
+		std::thread		*m_thread;
+		bool			m_running;
+		unsigned int		m_interval;		// Seconds between the purge steps
+		unsigned long		m_maxRows;		// Readings deleted by each step
+		unsigned long		m_budget;		// Microseconds each step may take
+		std::mutex		m_mutex;
+		std::condition_variable	m_cv;
+		// The last request of the purge task, protected by m_mutex
+		bool			m_requested;
+		unsigned long		m_age;
+		unsigned int		m_flags;
+		unsigned long		m_sent;
+		// Totals since the last request, protected by m_mutex
+		unsigned long		m_removed;
+		unsigned long		m_unsentPurged;
+		unsigned long		m_unsentRetained;
+		unsigned long		m_readings;
+};
+
+#endif
@@ -0,0 +1,51 @@
+#ifndef _INSERT_CONFIGURATION_H
+#define _INSERT_CONFIGURATION_H
+/*
+ * Fledge storage service - Readings insert configuration
+ *
+ * Copyright (c) 2026 Dianomic Systems
+ *
+ * Released under the Apache 2.0 Licence
+ *
+ * Author: agent
+ */
+#include <atomic>
+#include <stdint.h>
+
+#define DEFAULT_ROWS_PER_INSERT		50	// Rows in each multi-row INSERT statement
+#define MAX_ROWS_PER_INSERT		300	// Keeps the bound parameters below SQLITE_MAX_VARIABLE_NUMBER
+#define ADAPTIVE_MAX_COMMIT_ROWS	10000	// Upper bound of the adaptive transaction size
+
+/**
+ * The strategy used by appendReadings to insert readings into
+ * the readings tables.
+ *
+ * - rowsPerInsert  Number of rows inserted by each INSERT statement
+ * - commitRows     Number of rows above which the readings writer commits the blocks
+ *                  it has grouped, 0 commits every group. A block of readings is
+ *                  always committed whole
+ * - walSizeLimit   Size in KB of the WAL file above which the number of rows per
+ *                  transaction is reduced, 0 disables the adaptive sizing
+ */
+class InsertConfiguration {
+	public:
+		static InsertConfiguration	*getInstance();
+		void				setRowsPerInsert(unsigned int rows);
+		unsigned int			getRowsPerInsert() const { return m_rowsPerInsert; };
+		void				setCommitRows(unsigned int rows);
+		unsigned int			getCommitRows() const;
+		void				setWalSizeLimit(unsigned long limit);
+		bool				isAdaptive() const { return m_walSizeLimit != 0; };
+		void				walSize(unsigned long size);
+	private:
+		InsertConfiguration();
+		~InsertConfiguration();
+	private:
+		static InsertConfiguration	*m_instance;
+		unsigned int			m_rowsPerInsert;
+		unsigned int			m_commitRows;
+		unsigned long			m_walSizeLimit;
+		std::atomic<unsigned int>	m_adaptiveRows;
+};
+
+#endif
@@ -0,0 +1,76 @@
+#ifndef _PRAGMA_CONFIGURATION_H
+#define _PRAGMA_CONFIGURATION_H
+/*
+ * Fledge storage service - SQLite PRAGMA configuration
+ *
+ * Copyright (c) 2026 Dianomic Systems
+ *
+ * Released under the Apache 2.0 Licence
+ *
+ * Author: agent
+ */
+#include <sqlite3.h>
+#include <string>
+#include <set>
+#include <rapidjson/document.h>
+
+#define PRAGMA_DEFAULT		-1	// Leave the SQLite default of a numeric pragma
+
+/**
+ * The pragmas set on a database attached to a connection
+ *
+ * - cacheSize     Value of cache_size, negative values are in KB, 0 leaves the default
+ * - mmapSize      Bytes of the database memory mapped
+ * - synchronous   OFF, NORMAL, FULL or EXTRA, empty leaves the default
+ */
+typedef struct {
+	long		cacheSize;
+	long long	mmapSize;
+	std::string	synchronous;
+} DB_PRAGMAS;
+
+/**
+ * The pragmas of a connection, split between the configuration
+ * database and the readings databases attached to the connection
+ *
+ * - walAutocheckpoint  Pages in the WAL after which a commit runs a checkpoint
+ * - tempStore          DEFAULT, FILE or MEMORY, empty leaves the default
+ */
+typedef struct {
+	DB_PRAGMAS	config;
+	DB_PRAGMAS	readings;
+	long		walAutocheckpoint;
+	std::string	tempStore;
+} CONNECTION_PRAGMAS;
+
+/**
+ * The profile of PRAGMA settings applied to the connections. The
+ * connections of the readings writers have their own settings, the
+ * other connections of the pool are readers.
+ */
+class PragmaConfiguration {
+	public:
+		static PragmaConfiguration	*getInstance();
+		bool				setProfile(const std::string& profile);
+		bool				setOverrides(const std::string& overrides);
+		void				addWriter(sqlite3 *dbHandle);
+		void				removeWriter(sqlite3 *dbHandle);
+		void				disableAutocheckpoint();
+		void				apply(sqlite3 *dbHandle);
+		void				applyDatabase(sqlite3 *dbHandle, const std::string& alias);
+	private:
+		PragmaConfiguration();
+		~PragmaConfiguration();
+		const CONNECTION_PRAGMAS&	getPragmas(sqlite3 *dbHandle) const;
+		void				setDbPragmas(DB_PRAGMAS& pragmas, const rapidjson::Value& value);
+		void				setConnectionPragmas(CONNECTION_PRAGMAS& pragmas,
+							const rapidjson::Value& value);
+		void				exec(sqlite3 *dbHandle, const std::string& sql);
+	private:
+		static PragmaConfiguration	*m_instance;
+		CONNECTION_PRAGMAS		m_reader;
+		CONNECTION_PRAGMAS		m_writer;
+		std::set<sqlite3 *>		m_writerHandles;
+};
+
+#endif
@@ -20,6 +20,8 @@ class PurgeConfiguration {
 		bool				isExcluded(const std::string& asset);
 		void				minimumRetained(uint32_t minimum);
 		uint32_t			getMinimumRetained() { return m_minimum; };
+		void				setThreads(unsigned int threads) { m_threads = threads ? threads : 1; };
+		unsigned int			getThreads() const { return m_threads; };
 	private:
 		PurgeConfiguration();
 		~PurgeConfiguration();
@@ -27,6 +29,7 @@ class PurgeConfiguration {
 		static PurgeConfiguration	*m_instance;
 		std::vector<std::string>	m_exclude;
 		uint32_t			m_minimum;
+		unsigned int			m_threads;	// Connections deleting readings in parallel
 };
 
 #endif
@@ -0,0 +1,53 @@
+#ifndef _READINGS_ALLOCATOR_H
+#define _READINGS_ALLOCATOR_H
+/*
+ * Fledge storage service - Background allocation of the readings databases
+ *
+ * Copyright (c) 2026 Dianomic Systems
+ *
+ * Released under the Apache 2.0 Licence
+ *
+ * Author: agent
+ */
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+
+class Connection;
+class ConnectionManager;
+
+/**
+ * A thread that creates the readings databases ahead of demand. The
+ * tables of a database are created with the database, keeping free
+ * databases in reserve means that the first reading of a new asset no
+ * longer waits for the CREATE TABLE and ATTACH of a new database.
+ *
+ * The thread is woken each time the catalogue moves to the next database
+ * and creates databases until the headroom of free databases is restored.
+ * The new databases are attached to the connection of the thread and
+ * queued for the attach of the other connections before their next use.
+ */
+class ReadingsAllocator {
+	public:
+		static ReadingsAllocator	*getInstance();
+		void			start(ConnectionManager *manager, int headroom);
+		void			stop();
+		bool			isRunning() const { return m_running; };
+		void			notify();
+	private:
+		ReadingsAllocator();
+		~ReadingsAllocator();
+		void			allocatorThread();
+	private:
+		static ReadingsAllocator	*m_instance;
+		ConnectionManager	*m_manager;
+		Connection		*m_connection;
+		std::thread		*m_thread;
+		bool			m_running;
+		int			m_headroom;		// Free databases kept in reserve
+		bool			m_requested;		// Protected by m_mutex
+		std::mutex		m_mutex;
+		std::condition_variable	m_cv;
+};
+
+#endif
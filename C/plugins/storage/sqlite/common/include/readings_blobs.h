@@ -0,0 +1,62 @@
+#ifndef _READINGS_BLOBS_H
+#define _READINGS_BLOBS_H
+/*
+ * Fledge storage service - Binary storage of image and data buffer datapoints
+ *
+ * Copyright (c) 2026 Dianomic Systems
+ *
+ * Released under the Apache 2.0 Licence
+ *
+ * Author: agent
+ */
+#include <string>
+#include <vector>
+#include <atomic>
+
+#define BLOBS_TABLE	"reading_blobs"
+#define BLOB_REFERENCE	"__BLOB:"
+
+/**
+ * An image or data buffer value found in the JSON of a reading.
+ * The value is the type and header of the datapoint, the prefix,
+ * followed by the base64 encoding of the data.
+ */
+class BinaryValue {
+	public:
+		size_t		m_offset;	// Of the value, after the opening quote
+		size_t		m_length;	// Of the value, up to the closing quote
+		size_t		m_prefixLength;	// Of the type and header of the datapoint
+};
+
+/**
+ * The images and data buffers of the readings stored as binary objects
+ * in a table of the first readings database rather than base64 encoded
+ * within the JSON of the readings.
+ *
+ * The value of the datapoint in the reading is replaced by a reference
+ * to the binary object, the value is encoded again only when the reading
+ * is returned, the queries and the purge of the readings that do not
+ * return the reading never read the binary objects.
+ */
+class ReadingsBlobs {
+	public:
+		static ReadingsBlobs	*getInstance();
+		void			setMinimumSize(unsigned long size);
+		bool			isEnabled() const { return m_minimumSize > 0; };
+		unsigned long		getMinimumSize() const { return m_minimumSize; };
+		void			setStored() { m_stored = true; };
+		bool			isStored() const { return m_stored; };
+		static void		findBinaryValues(const std::string& json, size_t minimumSize,
+						std::vector<BinaryValue>& values);
+		static bool		parseReference(const char *str, unsigned long *readingId,
+						unsigned int *seq, size_t *length);
+	private:
+		ReadingsBlobs();
+		~ReadingsBlobs();
+	private:
+		static ReadingsBlobs	*m_instance;
+		unsigned long		m_minimumSize;
+		std::atomic<bool>	m_stored;	// The table holds, or has held, binary objects
+};
+
+#endif
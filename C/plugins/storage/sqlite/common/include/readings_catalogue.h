@@ -12,6 +12,12 @@
 
 #include "connection.h"
 #include <thread>
+#include <mutex>
+#include <atomic>
+#include <ctime>
+#include <climits>
+#include <memory>
+#include <unordered_map>
 
 /**
  * This class handles per thread started transaction boundaries:
@@ -37,6 +43,8 @@ class TransactionBoundary {
  * - nDbPreallocate            = Number of databases to allocate in advance
  * - nDbLeftFreeBeforeAllocate = Number of free databases before a new allocation is executed
  * - nDbToAllocate             = Number of database to allocate each time
+ * - partitionInterval         = Seconds after which the readings move to a new database, 0 disables the partitioning
+ * - timestampIndex            = Index the readings tables by user_ts, used by the queries of the readings by time
  *
  */
 typedef struct
@@ -46,6 +54,8 @@ typedef struct
 	int nDbPreallocate = 3;
 	int nDbLeftFreeBeforeAllocate = 1;
 	int nDbToAllocate = 2;
+	int partitionInterval = 0;
+	bool timestampIndex = true;
 
 } STORAGE_CONFIGURATION;
 
@@ -76,6 +86,23 @@ typedef struct
  * The readings tables are allocated in sequence starting from the readings_1_1 and proceeding with the other tables available in the first database.
  * The tables in the 2nd database (readings_2.db) will be used when all the tables in the first db are allocated.
  *
+ * When the time partitioning is enabled the catalogue in use is closed at every partition interval,
+ * the readings of all the assets then move to tables allocated in a new database.
+ * The closed catalogues are kept as partitions, the end time of each partition is stored in the table:
+ *
+ * readings_1.readings_partition:
+ * - db_id        INTEGER               NOT NULL,
+ * - end_ts       INTEGER               NOT NULL
+ *
+ * The purge by age removes the partitions entirely older than the requested age detaching
+ * and deleting their databases instead of deleting their rows. The databases of the partitions
+ * retained stay attached, a partition is extended rather than closed when its new database
+ * would exceed the number of databases SQLite can attach to a connection.
+ *
+ * The range of the global ids stored in each readings table is kept in memory, it is extended
+ * by the appends and reduced by the purges. The queries built over all the readings tables
+ * for a range of ids only reference the tables whose range overlaps the requested one.
+ *
  * Implementation notes:
  *
  * 1) Many functions receive the database connection as an input parameter:
@@ -126,6 +153,7 @@ public:
 	int           getIncGlobalId() {return m_ReadingsGlobalId++;};
 	int           getMinGlobalId (sqlite3 *dbHandle);
 	int           getGlobalId() {return m_ReadingsGlobalId;};
+	int           getDbIdLast() {return m_dbIdLast;};
 	bool          evaluateGlobalId();
 	bool          storeGlobalId ();
 
@@ -134,10 +162,19 @@ public:
 
 	bool          latestDbUpdate(sqlite3 *dbHandle, int newDbId);
 	void          preallocateNewDbsRange(int dbIdStart, int dbIdEnd);
+	int           preallocateHeadroom(sqlite3 *dbHandle, int headroom);
 	tyReadingReference getReadingReference(Connection *connection, const char *asset_code);
 	bool          attachDbsToAllConnections();
-	std::string   sqlConstructMultiDb(std::string &sqlCmdBase, std::vector<std::string>  &assetCodes, bool considerExclusion=false);
-	int           purgeAllReadings(sqlite3 *dbHandle, const char *sqlCmdBase, char **errMsg = NULL, unsigned long *rowsAffected = NULL);
+	std::string   sqlConstructMultiDb(std::string &sqlCmdBase, std::vector<std::string>  &assetCodes, bool considerExclusion=false,
+					unsigned long idFrom = 0, unsigned long idTo = ULONG_MAX,
+					bool excludeAssets = false, bool *tablesFound = NULL);
+	int           purgeAllReadings(sqlite3 *dbHandle, const char *sqlCmdBase, char **errMsg = NULL, unsigned long *rowsAffected = NULL,
+					unsigned long idTo = ULONG_MAX);
+	void          extendIdRange(const std::string &table, unsigned long minId, unsigned long maxId);
+	void          refreshIdRanges(sqlite3 *dbHandle);
+	unsigned long getMinStoredId(int dbId, int tableId);
+	bool          hasPartitions();
+	unsigned long purgeExpiredPartitions(sqlite3 *dbHandle, unsigned long age, unsigned long sent, bool retainUnsent, unsigned long *unsentPurged);
 
 	bool          connectionAttachAllDbs(sqlite3 *dbHandle);
 	bool          connectionAttachDbList(sqlite3 *dbHandle, std::vector<int> &dbIdList);
@@ -147,6 +184,8 @@ public:
 	void          setUsedDbId(int dbId);
 	int           extractReadingsIdFromName(std::string tableName);
 	int           extractDbIdFromName(std::string tableName);
+	unsigned long getStatementGeneration() const { return m_stmtGeneration; };
+	void          invalidateStatements() { m_stmtGeneration++; };
 
 
 
@@ -176,12 +215,25 @@ private:
 
 	} tyReadingsAvailable;
 
-	ReadingsCatalogue(){};
+	// asset_code  - reading Table Id, Db Id
+	typedef std::map <std::string, std::pair<int, int>> tyAssetCatalogue;
+	typedef std::unordered_map <std::string, std::pair<int, int>> tyAssetLookup;
 
-	bool          createNewDB(sqlite3 *dbHandle, int newDbId,  int startId, NEW_DB_OPERATION attachAllDb);
+	// Range of the global ids stored in a readings table, empty if minId > maxId
+	typedef struct IdRange {
+		unsigned long minId;
+		unsigned long maxId;
+
+	} tyIdRange;
+
+	ReadingsCatalogue() : m_stmtGeneration(0) {};
+
+	bool          createNewDB(sqlite3 *dbHandle, int newDbId,  int startId, NEW_DB_OPERATION attachAllDb, bool recordLast = true);
 	int           getUsedTablesDbId(int dbId);
 	int           getNReadingsAllocate() const {return m_storageConfigCurrent.nReadingsPerDb;}
 	bool          createReadingsTables(sqlite3 *dbHandle, int dbId, int idStartFrom, int nTables);
+	void          applyReadingsIndexes(sqlite3 *dbHandle);
+	void          applyTimestampStorage(sqlite3 *dbHandle);
 	bool          isReadingAvailable() const;
 	void          allocateReadingAvailable();
 	tyReadingsAvailable   evaluateLastReadingAvailable(sqlite3 *dbHandle, int dbId);
@@ -191,6 +243,7 @@ private:
 	void		  raiseError(const char *operation, const char *reason,...);
 	int			  SQLStep(sqlite3_stmt *statement);
 	int           SQLExec(sqlite3 *dbHandle, const char *sqlCmd,  char **errMsg = NULL);
+	int           purgeTables(sqlite3 *dbHandle, const std::vector<std::string>& sqlCmds, char **errMsg, unsigned long *rowsAffected);
 	bool          enableWAL(std::string &dbPathReadings);
 
 	bool          configurationRetrieve(sqlite3 *dbHandle);
@@ -211,6 +264,17 @@ private:
 	int           calcMaxReadingUsed();
 	void          dropReadingsTables(sqlite3 *dbHandle, int dbId, int idStart, int idEnd);
 
+	bool          allocateNewDb(sqlite3 *dbHandle);
+	bool          loadPartitions(sqlite3 *dbHandle, std::map<int, time_t> &dbPartitionEnd);
+	void          rollPartition(sqlite3 *dbHandle);
+	void          publishAssetLookup();
+	bool          isPartitionDb(int dbId);
+	void          dropPartition(sqlite3 *dbHandle, const tyAssetCatalogue &partition);
+	std::vector<const tyAssetCatalogue *>
+	              getAllCatalogues();
+	time_t        nextPartitionEnd(time_t now) const;
+	bool          overlapsIdRange(int dbId, int tableId, unsigned long idFrom, unsigned long idTo);
+
 
 	int                                           m_dbIdCurrent;            // Current database in use
 	int                                           m_dbIdLast;               // Last database available not already in use
@@ -219,11 +283,18 @@ private:
 
 	std::atomic<int>                              m_ReadingsGlobalId;       // Global row id shared among all the readings table
 	int                                           m_nReadingsAvailable = 0; // Number of readings tables available
-	std::map <std::string, std::pair<int, int>>   m_AssetReadingCatalogue={ // In memory structure to identify in which database/table an asset is stored
+	std::atomic<unsigned long>                    m_stmtGeneration;         // Incremented when cached prepared statements become invalid
+	tyAssetCatalogue                              m_AssetReadingCatalogue={ // In memory structure to identify in which database/table an asset is stored
 
 		// asset_code  - reading Table Id, Db Id
 		// {"",         ,{1               ,1 }}
 	};
+	std::shared_ptr<const tyAssetLookup>          m_assetLookup;            // Read only copy of m_AssetReadingCatalogue, replaced as a whole
+	std::map <time_t, tyAssetCatalogue>           m_partitions;             // Closed catalogues by partition end time
+	std::mutex                                    m_partitionsLock;         // Protects the closed catalogues
+	std::atomic<time_t>                           m_partitionEnd{0};        // End of the partition in use, read without the AttachDbSync lock
+	std::map <std::pair<int, int>, tyIdRange>     m_idRanges;               // Range of the ids stored by Db Id, reading Table Id
+	std::mutex                                    m_idRangesLock;           // Protects the ranges of the ids, taken after the partitions lock
 public:
 	TransactionBoundary				m_tx;
 
@@ -0,0 +1,75 @@
+#ifndef _READINGS_COMPRESSION_H
+#define _READINGS_COMPRESSION_H
+/*
+ * Fledge storage service - Compressed storage of the readings
+ *
+ * Copyright (c) 2026 Dianomic Systems
+ *
+ * Released under the Apache 2.0 Licence
+ *
+ * Author: agent
+ */
+#include <string>
+#include <vector>
+#include <map>
+#include <mutex>
+#include <atomic>
+#include <sqlite3.h>
+
+#define DICTIONARIES_TABLE	"reading_dictionaries"
+#define DECODE_FUNCTION		"reading_json"
+#define DICTIONARY_SIZE		4096	// Bytes of a reading used as the dictionary of its asset
+#define COMPRESSION_LEVEL	6
+
+/**
+ * The JSON of the readings stored compressed in the reading column of
+ * the readings tables.
+ *
+ * The JSON is compressed with a dictionary per asset, the JSON of the
+ * first reading of the asset compressed, so that the datapoint names
+ * and the structure repeated by every reading cost almost nothing. A
+ * compressed reading is stored as a BLOB, the id of the dictionary as a
+ * varint followed by the raw deflate data, a reading that does not
+ * compress is stored as text. The dictionaries are stored in a table of
+ * the first readings database, within the transactions of the readings
+ * that use them.
+ *
+ * The reading_json SQL function returns the JSON of a compressed reading,
+ * and the text of a reading that is not compressed, the readings tables
+ * are queried through it once compressed readings have been stored.
+ * decodeReadings rewrites the SQL of a readings table to do so.
+ */
+class ReadingsCompression {
+	public:
+		static ReadingsCompression	*getInstance();
+		void			setEnabled(bool enabled);
+		bool			isEnabled() const { return m_enabled; };
+		void			setStored() { m_stored = true; };
+		bool			isStored() const { return m_stored; };
+		bool			compress(const std::string& asset, const std::string& reading,
+						std::string& compressed, unsigned int& dictionary);
+		bool			decompress(const void *data, size_t length, std::string& reading);
+		bool			getDictionary(unsigned int id, std::string& asset,
+						std::string& dictionary);
+		void			addDictionary(unsigned int id, const std::string& asset,
+						const std::string& dictionary);
+		static void		registerFunction(sqlite3 *db);
+		static std::string	decodeReadings(const std::string& sql);
+	private:
+		ReadingsCompression();
+		~ReadingsCompression();
+		const std::string	*findDictionary(unsigned int id);
+		static void		decode(sqlite3_context *context, int argc, sqlite3_value **argv);
+	private:
+		static ReadingsCompression	*m_instance;
+		bool			m_enabled;
+		std::atomic<bool>	m_stored;	// Compressed readings may have been stored
+		std::mutex		m_mutex;
+		std::map<unsigned int, std::pair<std::string, std::string> >
+					m_dictionaries;	// Asset and dictionary by id
+		std::map<std::string, unsigned int>
+					m_assets;	// Dictionary id by asset
+		unsigned int		m_nextId;
+};
+
+#endif
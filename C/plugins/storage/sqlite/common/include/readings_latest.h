@@ -0,0 +1,92 @@
+#ifndef _READINGS_LATEST_H
+#define _READINGS_LATEST_H
+/*
+ * Fledge storage service - Latest value of each datapoint of each asset
+ *
+ * Copyright (c) 2026 Dianomic Systems
+ *
+ * Released under the Apache 2.0 Licence
+ *
+ * Author: agent
+ */
+#include <string>
+#include <map>
+#include <mutex>
+#include <sys/time.h>
+#include <rapidjson/document.h>
+
+#define LATEST_TABLE	"readings_latest"
+
+/**
+ * The latest value of a datapoint, the value is held as JSON text
+ */
+class LatestValue {
+	public:
+		std::string	m_value;
+		std::string	m_userTs;	// As formatted by formatDate
+		struct timeval	m_time;		// Of the user timestamp
+};
+
+/**
+ * The latest values of the datapoints of the readings inserted by a
+ * transaction, they become the latest values of the assets once the
+ * transaction is committed
+ */
+class LatestBatch {
+	public:
+		typedef std::pair<std::string, std::string> Key;	// Asset and datapoint
+
+		void		add(const char *asset, const char *userTs,
+					const rapidjson::Value& reading);
+		void		add(const Key& key, const LatestValue& value);
+		void		merge(const LatestBatch& batch);
+		const std::map<Key, LatestValue>&
+				values() const { return m_values; };
+		bool		empty() const { return m_values.empty(); };
+		void		clear() { m_values.clear(); };
+	private:
+		std::map<Key, LatestValue>
+				m_values;
+};
+
+/**
+ * The latest value of each datapoint of each asset stored by the plugin.
+ * The values are held in memory, and in a table of the first readings
+ * database from which they are loaded when the plugin starts, so that
+ * the latest reading of every asset is returned without querying the
+ * readings table of each asset.
+ *
+ * A value replaces the latest value of its datapoint only if its user
+ * timestamp is not older, the JSON document of each asset is built again
+ * only when it is next returned after one of its values has changed.
+ */
+class LatestReadings {
+	public:
+		static LatestReadings	*getInstance();
+		void			setEnabled(bool enabled);
+		bool			isEnabled() const { return m_enabled; };
+		bool			isLatest(const LatestBatch::Key& key,
+						const struct timeval& time);
+		void			update(const LatestBatch& batch);
+		void			asJSON(std::string& json, const char *asset);
+	private:
+		LatestReadings();
+		~LatestReadings();
+		class Asset {
+			public:
+				Asset() : m_dirty(true) {};
+				std::map<std::string, LatestValue>
+						m_datapoints;
+				std::string	m_json;
+				bool		m_dirty;	// m_json must be built again
+		};
+		void			assetJSON(const std::string& name, Asset& asset);
+	private:
+		static LatestReadings	*m_instance;
+		bool			m_enabled;
+		std::mutex		m_mutex;
+		std::map<std::string, Asset>
+					m_assets;
+};
+
+#endif
@@ -0,0 +1,54 @@
+#ifndef _READINGS_PAYLOAD_H
+#define _READINGS_PAYLOAD_H
+/*
+ * Fledge storage service - Parser of the payload of a readings append
+ *
+ * Copyright (c) 2026 Dianomic Systems
+ *
+ * Released under the Apache 2.0 Licence
+ *
+ * Author: agent
+ */
+#include <rapidjson/stringbuffer.h>
+#include <string>
+#include <vector>
+
+/**
+ * A reading of an append payload. The strings are held by the
+ * ReadingsPayload the reading was parsed from and are null terminated,
+ * the reading is the compact JSON of its datapoints.
+ */
+typedef struct {
+	const char	*assetCode;
+	const char	*userTs;
+	const char	*reading;
+	size_t		readingLength;
+} APPEND_READING;
+
+/**
+ * The readings of the payload of a readings append,
+ *
+ *	{ "readings" : [ { "asset_code" : ..., "user_ts" : ..., "reading" : { ... } }, ... ] }
+ *
+ * The payload is parsed with the SAX reader of RapidJSON rather than into
+ * a document. The events of each reading are written directly to a single
+ * buffer as the compact JSON that is stored, so no document is built for
+ * the datapoints and each reading is not serialised again for the insert.
+ */
+class ReadingsPayload {
+	public:
+		ReadingsPayload() {};
+		bool				parse(const char *payload);
+		const std::string&		getError() const { return m_error; };
+		const std::vector<APPEND_READING>&
+						getReadings() const { return m_readings; };
+	private:
+		ReadingsPayload(const ReadingsPayload&);
+		ReadingsPayload&		operator=(const ReadingsPayload&);
+		class Handler;
+		rapidjson::StringBuffer		m_buffer;
+		std::vector<APPEND_READING>	m_readings;
+		std::string			m_error;
+};
+
+#endif
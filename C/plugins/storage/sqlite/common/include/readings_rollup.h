@@ -0,0 +1,74 @@
+#ifndef _READINGS_ROLLUP_H
+#define _READINGS_ROLLUP_H
+/*
+ * Fledge storage service - Rollup of the readings over intervals of time
+ *
+ * Copyright (c) 2026 Dianomic Systems
+ *
+ * Released under the Apache 2.0 Licence
+ *
+ * Author: agent
+ */
+#include <string>
+#include <map>
+#include <tuple>
+#include <rapidjson/document.h>
+
+#define ROLLUP_TABLE_BASE	"readings_rollup_"	// Followed by the interval in seconds
+
+/**
+ * The rollup of the readings, the minimum, maximum, sum and count of each
+ * numeric datapoint of each asset over each interval of time. The rollup
+ * is kept up to date as the readings are appended, the time bucket
+ * aggregates of a reading query whose bucket size is a multiple of the
+ * interval are computed from the rollup rather than from every reading.
+ *
+ * The rollup of each interval is held in its own table, the bucket of a
+ * row is the number of intervals since the epoch.
+ */
+class ReadingsRollup {
+	public:
+		static ReadingsRollup	*getInstance();
+		void			setInterval(unsigned int interval);
+		unsigned int		getInterval() const { return m_interval; };
+		bool			isEnabled() const { return m_interval != 0; };
+		const std::string&	getTable() const { return m_table; };
+		bool			supports(double size) const;
+		bool			bucket(const char *userTs, long *bucket) const;
+	private:
+		ReadingsRollup();
+		~ReadingsRollup();
+	private:
+		static ReadingsRollup	*m_instance;
+		unsigned int		m_interval;	// Seconds, 0 disables the rollup
+		std::string		m_table;	// Including the database
+};
+
+/**
+ * The rollup of the readings inserted by a transaction, accumulated as
+ * the readings are inserted and written to the rollup table before the
+ * transaction is committed
+ */
+class RollupBatch {
+	public:
+		class Values {
+			public:
+				double	m_minimum;
+				double	m_maximum;
+				double	m_total;
+				long	m_count;
+				bool	m_integer;	// All the values are integers
+		};
+		typedef std::tuple<std::string, std::string, long> Key;	// Asset, datapoint and bucket
+
+		void		add(const char *asset, const char *userTs,
+					const rapidjson::Value& reading);
+		const std::map<Key, Values>&
+				values() const { return m_values; };
+		bool		empty() const { return m_values.empty(); };
+		void		clear() { m_values.clear(); };
+	private:
+		std::map<Key, Values>	m_values;
+};
+
+#endif
@@ -0,0 +1,60 @@
+#ifndef _READINGS_TIMESTAMPS_H
+#define _READINGS_TIMESTAMPS_H
+/*
+ * Fledge storage service - Storage of the timestamps of the readings
+ *
+ * Copyright (c) 2026 Dianomic Systems
+ *
+ * Released under the Apache 2.0 Licence
+ *
+ * Author: agent
+ */
+#include <string>
+#include <stdint.h>
+#include <sqlite3.h>
+
+#define FORMAT_TS_FUNCTION	"reading_ts"
+#define EPOCH_TS_FUNCTION	"reading_us"
+#define EPOCH_USER_TS		"epoch_user_ts"	// The stored user_ts of the readings queries
+#define EPOCH_SCHEMA_VERSION	1		// user_version of the first readings database
+
+/**
+ * The storage of the user_ts and ts columns of the readings tables.
+ *
+ * The timestamps are stored either as text, formatted as
+ * "YYYY-MM-DD HH:MM:SS.ffffff+00:00", or as the number of microseconds
+ * since the epoch. Integer timestamps are neither formatted when the
+ * readings are stored nor parsed when they are fetched and the
+ * conditions on the time of the readings, including those of the
+ * purge, compare integers.
+ *
+ * The reading_ts SQL function formats an integer timestamp, the
+ * queries of the readings return the formatted text and the fetch of
+ * the readings formats them only for the JSON result. The reading_us
+ * SQL function returns the integer of a formatted timestamp, it is
+ * used to convert the readings stored when the storage changes.
+ */
+class ReadingsTimestamps {
+	public:
+		static ReadingsTimestamps	*getInstance();
+		void			setEpoch(bool epoch) { m_epoch = epoch; };
+		bool			isEpoch() const { return m_epoch; };
+		std::string		columns() const;
+		std::string		fetchColumns(bool raw) const;
+		std::string		seconds(const std::string& column) const;
+		std::string		ago(unsigned long seconds) const;
+		bool			convert(sqlite3 *db, const std::string& table);
+		static bool		toEpoch(const char *userTs, int64_t *epoch);
+		static int64_t		now();
+		static void		registerFunctions(sqlite3 *db);
+	private:
+		ReadingsTimestamps();
+		~ReadingsTimestamps();
+		static void		format(sqlite3_context *context, int argc, sqlite3_value **argv);
+		static void		epoch(sqlite3_context *context, int argc, sqlite3_value **argv);
+	private:
+		static ReadingsTimestamps	*m_instance;
+		bool			m_epoch;
+};
+
+#endif
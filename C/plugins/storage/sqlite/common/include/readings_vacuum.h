@@ -0,0 +1,70 @@
+#ifndef _READINGS_VACUUM_H
+#define _READINGS_VACUUM_H
+/*
+ * Fledge storage service - Incremental vacuum of the readings databases
+ *
+ * Copyright (c) 2026 Dianomic Systems
+ *
+ * Released under the Apache 2.0 Licence
+ *
+ * Author: agent
+ */
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <string>
+
+#define VACUUM_STEP_PAGES	128	// Pages released by each incremental_vacuum statement
+
+class Connection;
+class ConnectionManager;
+
+/**
+ * A thread that returns the free pages of the readings databases to the
+ * file system in the background, so that the files shrink once readings
+ * have been purged rather than keeping their largest size.
+ *
+ * The readings databases are created with auto_vacuum set to INCREMENTAL.
+ * Every interval the free pages of each of them are released with
+ * incremental_vacuum, in steps of VACUUM_STEP_PAGES so that the writers
+ * are only held up briefly, until the page budget of the interval has
+ * been used. Databases created before incremental vacuum was available
+ * are left untouched, converting them would need a full VACUUM.
+ */
+class ReadingsVacuum {
+	public:
+		static ReadingsVacuum	*getInstance();
+		void			start(ConnectionManager *manager,
+						unsigned int interval,
+						unsigned long pages);
+		void			stop();
+		bool			isRunning() const { return m_running; };
+		void			asJSON(std::string& json);
+	private:
+		ReadingsVacuum();
+		~ReadingsVacuum();
+		void			vacuumThread();
+		long			pragmaValue(const std::string& schema,
+						const std::string& pragma);
+		unsigned long		vacuum(const std::string& schema,
+						unsigned long pages);
+	private:
+		static ReadingsVacuum	*m_instance;
+		ConnectionManager	*m_manager;
+		Connection		*m_connection;
+		std::thread		*m_thread;
+		bool			m_running;
+		unsigned int		m_interval;		// Seconds between the vacuums
+		unsigned long		m_pages;		// Pages released in each interval
+		std::mutex		m_mutex;
+		std::condition_variable	m_cv;
+		// Statistics, protected by m_mutex
+		unsigned long		m_runs;			// Vacuums run
+		unsigned long		m_released;		// Pages returned to the file system
+		unsigned long		m_busy;			// Steps that could not lock a database
+		unsigned long		m_freePages;		// Free pages left after the last vacuum
+		unsigned long		m_unsupported;		// Databases without incremental vacuum
+		unsigned long		m_totalTime;		// Milliseconds spent vacuuming
+};
+
+#endif
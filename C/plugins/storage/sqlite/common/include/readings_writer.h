@@ -0,0 +1,85 @@
+#ifndef _READINGS_WRITER_H
+#define _READINGS_WRITER_H
+/*
+ * Fledge storage service - Readings writer
+ *
+ * Copyright (c) 2026 Dianomic Systems
+ *
+ * Released under the Apache 2.0 Licence
+ *
+ * Author: agent
+ */
+#include <readings_payload.h>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <deque>
+#include <vector>
+
+#define READINGS_WRITER_MAX_REQUESTS	64	// Maximum number of appends committed together
+#define READINGS_WRITER_MAX_SHARDS	8	// Maximum number of writer threads
+
+class Connection;
+class ConnectionManager;
+
+/**
+ * A block of readings waiting to be inserted by the readings writer
+ */
+typedef struct {
+	const std::vector<APPEND_READING>
+				*readings;	// The readings
+	int			rows;		// Readings inserted, -1 on failure
+	bool			complete;	// The readings have been committed or rejected
+} AppendRequest;
+
+/**
+ * The threads that insert the readings of all the callers of
+ * appendReadings. The blocks of readings queued whilst a transaction
+ * is being committed are inserted together in the next transaction,
+ * the callers are only woken once the commit has completed. This
+ * replaces the contention for the write lock of the database between
+ * the callers with a single writer and one commit per group.
+ *
+ * SQLite allows a single writer per database file, the readings tables
+ * are spread over several databases. With more than one shard each
+ * writer thread, with its own connection, inserts the blocks whose
+ * first asset is in one of a subset of the databases. A block is not
+ * split between the shards, so that it is committed or rejected as a
+ * whole, the readings of its other assets are inserted by the same
+ * writer.
+ */
+class ReadingsWriter {
+	public:
+		static ReadingsWriter	*getInstance();
+		void			start(ConnectionManager *manager, unsigned int shards = 1);
+		void			stop();
+		bool			isRunning() const { return m_running; };
+		int			append(Connection *connection, const std::vector<APPEND_READING>& readings);
+	private:
+		/**
+		 * A writer thread, its connection and the blocks queued for it
+		 */
+		class Shard {
+			public:
+				Shard() : m_connection(NULL), m_thread(NULL) {};
+				Connection		*m_connection;
+				std::thread		*m_thread;
+				std::condition_variable	m_queueCV;
+				std::deque<AppendRequest *>
+							m_queue;
+		};
+		ReadingsWriter();
+		~ReadingsWriter();
+		unsigned int		route(Connection *connection, const std::vector<APPEND_READING>& readings,
+						unsigned int nShards);
+		void			writerThread(Shard *shard);
+	private:
+		static ReadingsWriter	*m_instance;
+		ConnectionManager	*m_manager;
+		std::vector<Shard *>	m_shards;
+		bool			m_running;
+		std::mutex		m_mutex;
+		std::condition_variable	m_completeCV;
+};
+
+#endif
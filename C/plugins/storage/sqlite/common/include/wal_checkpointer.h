@@ -0,0 +1,66 @@
+#ifndef _WAL_CHECKPOINTER_H
+#define _WAL_CHECKPOINTER_H
+/*
+ * Fledge storage service - WAL checkpoint scheduler
+ *
+ * Copyright (c) 2026 Dianomic Systems
+ *
+ * Released under the Apache 2.0 Licence
+ *
+ * Author: agent
+ */
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <string>
+#include <ctime>
+
+class Connection;
+class ConnectionManager;
+
+/**
+ * A thread that checkpoints the write ahead logs of the databases in the
+ * background. The automatic checkpoint of SQLite is disabled whilst the
+ * thread runs so that the connection that crosses the threshold, usually
+ * one appending readings, no longer pays for the checkpoint.
+ *
+ * A PASSIVE checkpoint of all the databases is run every interval, a WAL
+ * that grows beyond the size limit is checkpointed with RESTART so that
+ * it is reused from the start rather than growing further.
+ */
+class WalCheckpointer {
+	public:
+		static WalCheckpointer	*getInstance();
+		void			start(ConnectionManager *manager,
+						unsigned int interval,
+						unsigned long walSizeLimit);
+		void			stop();
+		bool			isRunning() const { return m_running; };
+		void			asJSON(std::string& json);
+	private:
+		WalCheckpointer();
+		~WalCheckpointer();
+		void			checkpointThread();
+		void			checkpoint(const std::string& schema, int mode);
+	private:
+		static WalCheckpointer	*m_instance;
+		ConnectionManager	*m_manager;
+		Connection		*m_connection;
+		std::thread		*m_thread;
+		bool			m_running;
+		unsigned int		m_interval;		// Seconds between the passive checkpoints
+		unsigned long		m_walSizeLimit;		// Bytes of WAL that trigger a restart checkpoint
+		std::mutex		m_mutex;
+		std::condition_variable	m_cv;
+		// Statistics, protected by m_mutex
+		unsigned long		m_passive;		// Passive checkpoints run
+		unsigned long		m_restart;		// Restart checkpoints run
+		unsigned long		m_busy;			// Checkpoints that could not complete
+		unsigned long		m_frames;		// Frames copied into the databases
+		unsigned long		m_totalTime;		// Milliseconds spent checkpointing
+		unsigned long		m_maxTime;		// Longest checkpoint in milliseconds
+		unsigned long		m_maxWalSize;		// Largest WAL seen in bytes
+		time_t			m_last;			// Time of the last checkpoint
+};
+
+#endif
@@ -0,0 +1,175 @@
+/*
+ * Fledge storage service - Incremental purge of the readings
+ *
+ * Copyright (c) 2026 Dianomic Systems
+ *
+ * Released under the Apache 2.0 Licence
+ *
+ * Author: agent
+ */
+
+#include <incremental_purge.h>
+#include <connection.h>
+#include <connection_manager.h>
+#include <logger.h>
+#include <sstream>
+
+using namespace std;
+
+IncrementalPurge *IncrementalPurge::m_instance = 0;
+
+/**
+ * Constructor for the incremental purge
+ */
+IncrementalPurge::IncrementalPurge() : m_manager(NULL), m_connection(NULL),
+	m_thread(NULL), m_running(false), m_interval(0), m_maxRows(0), m_budget(0),
+	m_requested(false), m_age(0), m_flags(0), m_sent(0),
+	m_removed(0), m_unsentPurged(0), m_unsentRetained(0), m_readings(0)
+{
+}
+
+/**
+ * Destructor for the incremental purge
+ */
+IncrementalPurge::~IncrementalPurge()
+{
+	stop();
+}
+
+/**
+ * Return the singleton instance of the IncrementalPurge class
+ * for this plugin
+ *
+ * @return IncrementalPurge* singleton instance
+ */
+IncrementalPurge *IncrementalPurge::getInstance()
+{
+	if (m_instance == 0)
+	{
+		m_instance = new IncrementalPurge();
+	}
+	return m_instance;
+}
+
+/**
+ * Start the purge thread. The thread keeps a connection from the
+ * pool for its own use until it is stopped. No reading is purged
+ * until the first request of the purge task.
+ *
+ * @param manager	The connection manager of the plugin
+ * @param interval	Seconds between the purge steps
+ * @param maxRows	The maximum number of readings deleted by each step
+ * @param budget	The time budget of each step in milliseconds
+ */
+void IncrementalPurge::start(ConnectionManager *manager, unsigned int interval,
+			     unsigned long maxRows, unsigned long budget)
+{
+	lock_guard<mutex> guard(m_mutex);
+	if (m_running)
+	{
+		return;
+	}
+	m_manager = manager;
+	m_interval = interval ? interval : 1;
+	m_maxRows = maxRows ? maxRows : 1;
+	m_budget = budget * 1000;
+	m_connection = manager->allocate();
+	m_running = true;
+	m_thread = new thread(&IncrementalPurge::purgeThread, this);
+	Logger::getLogger()->info("Readings will be purged every %u seconds, at most %lu readings in %lu milliseconds",
+			m_interval, m_maxRows, budget);
+}
+
+/**
+ * Stop the purge thread
+ */
+void IncrementalPurge::stop()
+{
+	{
+		lock_guard<mutex> guard(m_mutex);
+		if (!m_running)
+		{
+			return;
+		}
+		m_running = false;
+	}
+	m_cv.notify_all();
+	m_thread->join();
+	delete m_thread;
+	m_thread = NULL;
+	m_manager->release(m_connection);
+	m_connection = NULL;
+}
+
+/**
+ * A request of the purge task. The parameters are used by the following
+ * steps of the purge thread and the totals of the readings purged since
+ * the previous request are returned.
+ *
+ * @param age		Age in hours of the readings to purge
+ * @param flags		The purge flags
+ * @param sent		The id of the last reading sent north
+ * @param result	Set to the JSON document of the totals
+ */
+void IncrementalPurge::purge(unsigned long age, unsigned int flags, unsigned long sent, string& result)
+{
+ostringstream convert;
+
+	lock_guard<mutex> guard(m_mutex);
+	m_requested = true;
+	m_age = age;
+	m_flags = flags;
+	m_sent = sent;
+
+	convert << "{ \"removed\" : " << m_removed << ", ";
+	convert << " \"unsentPurged\" : " << (sent == 0 ? m_removed : m_unsentPurged) << ", ";
+	convert << " \"unsentRetained\" : " << m_unsentRetained << ", ";
+	convert << " \"readings\" : " << m_readings << " }";
+	result = convert.str();
+
+	m_removed = 0;
+	m_unsentPurged = 0;
+}
+
+/**
+ * The purge thread, runs a step of the purge every interval with the
+ * parameters of the last request of the purge task
+ */
+void IncrementalPurge::purgeThread()
+{
+	while (true)
+	{
+		unsigned long age;
+		unsigned int flags;
+		unsigned long sent;
+		{
+			unique_lock<mutex> lck(m_mutex);
+			m_cv.wait_for(lck, chrono::seconds(m_interval), [this]{ return !m_running; });
+			if (!m_running)
+			{
+				break;
+			}
+			if (!m_requested)
+			{
+				continue;
+			}
+			age = m_age;
+			flags = m_flags;
+			sent = m_sent;
+		}
+
+		unsigned long unsentPurged = 0, unsentRetained = 0, readings = 0;
+		long removed = m_connection->purgeReadingsStep(age, flags, sent, m_maxRows, m_budget,
+						&unsentPurged, &unsentRetained, &readings);
+		if (removed < 0)
+		{
+			continue;
+		}
+
+		lock_guard<mutex> guard(m_mutex);
+		m_removed += removed;
+		m_unsentPurged += unsentPurged;
+		m_unsentRetained = unsentRetained;
+		m_readings = readings;
+	}
+}
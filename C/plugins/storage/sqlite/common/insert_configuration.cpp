@@ -0,0 +1,132 @@
+/*
+ * Fledge storage service - Readings insert configuration
+ *
+ * Copyright (c) 2026 Dianomic Systems
+ *
+ * Released under the Apache 2.0 Licence
+ *
+ * Author: agent
+ */
+
+#include <insert_configuration.h>
+#include <logger.h>
+
+using namespace std;
+
+InsertConfiguration *InsertConfiguration::m_instance = 0;
+
+/**
+ * Constructor for the insert configuration class
+ */
+InsertConfiguration::InsertConfiguration() : m_rowsPerInsert(DEFAULT_ROWS_PER_INSERT),
+	m_commitRows(0), m_walSizeLimit(0), m_adaptiveRows(ADAPTIVE_MAX_COMMIT_ROWS)
+{
+}
+
+/**
+ * Destructor for the insert configuration class
+ */
+InsertConfiguration::~InsertConfiguration()
+{
+}
+
+/**
+ * Return the singleton instance of the InsertConfiguration class
+ * for this plugin
+ *
+ * @return InsertConfiguration* singleton instance
+ */
+InsertConfiguration *InsertConfiguration::getInstance()
+{
+	if (m_instance == 0)
+	{
+		m_instance = new InsertConfiguration();
+	}
+	return m_instance;
+}
+
+/**
+ * Set the number of rows inserted by each INSERT statement
+ *
+ * @param rows	The number of rows, values outside 1 to MAX_ROWS_PER_INSERT are clamped
+ */
+void InsertConfiguration::setRowsPerInsert(unsigned int rows)
+{
+	if (rows < 1)
+		rows = 1;
+	if (rows > MAX_ROWS_PER_INSERT)
+		rows = MAX_ROWS_PER_INSERT;
+	m_rowsPerInsert = rows;
+	Logger::getLogger()->info("Readings will be inserted %u rows per statement", m_rowsPerInsert);
+}
+
+/**
+ * Set the number of rows above which the readings writer commits
+ * the blocks of readings it has grouped in a transaction
+ *
+ * @param rows	The number of rows, 0 commits every group
+ */
+void InsertConfiguration::setCommitRows(unsigned int rows)
+{
+	m_commitRows = rows;
+	m_adaptiveRows = rows ? rows : ADAPTIVE_MAX_COMMIT_ROWS;
+}
+
+/**
+ * Set the WAL size above which the transaction size is reduced
+ *
+ * @param limit	The WAL size limit in KB, 0 disables adaptive sizing
+ */
+void InsertConfiguration::setWalSizeLimit(unsigned long limit)
+{
+	m_walSizeLimit = limit * 1024;
+}
+
+/**
+ * Return the number of rows after which the transaction should
+ * be committed. When adaptive sizing is enabled this is the
+ * current adaptive value.
+ *
+ * @return unsigned int	The number of rows or 0 to commit every group
+ */
+unsigned int InsertConfiguration::getCommitRows() const
+{
+	if (m_walSizeLimit)
+	{
+		return m_adaptiveRows;
+	}
+	return m_commitRows;
+}
+
+/**
+ * Report the size of the WAL file following a commit. Large WAL
+ * files make the checkpoints that follow them expensive, the number
+ * of rows per transaction is halved whilst the WAL is above the limit
+ * and doubled again, up to the configured value, once it falls below
+ * half of the limit.
+ *
+ * @param size	The size of the WAL file in bytes
+ */
+void InsertConfiguration::walSize(unsigned long size)
+{
+	if (!m_walSizeLimit)
+	{
+		return;
+	}
+	unsigned int rows = m_adaptiveRows;
+	unsigned int maxRows = m_commitRows ? m_commitRows : ADAPTIVE_MAX_COMMIT_ROWS;
+	if (size > m_walSizeLimit && rows > m_rowsPerInsert)
+	{
+		rows /= 2;
+		if (rows < m_rowsPerInsert)
+			rows = m_rowsPerInsert;
+		Logger::getLogger()->debug("WAL size %lu above limit, commit every %u rows", size, rows);
+	}
+	else if (size < m_walSizeLimit / 2 && rows < maxRows)
+	{
+		rows *= 2;
+		if (rows > maxRows)
+			rows = maxRows;
+	}
+	m_adaptiveRows = rows;
+}
@@ -0,0 +1,373 @@
+/*
+ * Fledge storage service - SQLite PRAGMA configuration
+ *
+ * Copyright (c) 2026 Dianomic Systems
+ *
+ * Released under the Apache 2.0 Licence
+ *
+ * Author: agent
+ */
+
+#include <pragma_configuration.h>
+#include <logger.h>
+#include <vector>
+#include <algorithm>
+#include <ctype.h>
+
+using namespace std;
+using namespace rapidjson;
+
+PragmaConfiguration *PragmaConfiguration::m_instance = 0;
+
+/**
+ * The values accepted for the pragmas that take a keyword, the values
+ * are inserted into the PRAGMA statements so nothing else may be used
+ */
+static const char *synchronousValues[] = { "OFF", "NORMAL", "FULL", "EXTRA", NULL };
+static const char *tempStoreValues[] = { "DEFAULT", "FILE", "MEMORY", NULL };
+
+/**
+ * Check the keyword given for a pragma in the overrides
+ *
+ * @param pragma	The name of the pragma
+ * @param value		The value given, converted to upper case if accepted
+ * @param values	The values accepted
+ * @return bool		False if the value is not accepted
+ */
+static bool validKeyword(const char *pragma, string& value, const char *values[])
+{
+	string upper = value;
+	transform(upper.begin(), upper.end(), upper.begin(), ::toupper);
+	for (int i = 0; values[i]; i++)
+	{
+		if (upper.compare(values[i]) == 0)
+		{
+			value = upper;
+			return true;
+		}
+	}
+	Logger::getLogger()->error("The value '%s' of the SQLite %s override is not valid, it will be ignored",
+			value.c_str(), pragma);
+	return false;
+}
+
+/**
+ * The default profile, the settings the plugin has always used. Only the
+ * configuration database has a cache_size set, the readings databases
+ * use the SQLite defaults.
+ */
+static const CONNECTION_PRAGMAS defaultPragmas = {
+	{ -4000, PRAGMA_DEFAULT, "" },
+	{ 0, PRAGMA_DEFAULT, "" },
+	PRAGMA_DEFAULT,
+	""
+};
+
+/**
+ * The high-throughput profile for the readers, for servers with several GB
+ * of memory. The cache is per readings database attached, with many
+ * databases the memory used is the cache size times the number of databases
+ * times the number of connections in the pool. The readings are memory
+ * mapped for the fetch of the north services and synchronous NORMAL is safe
+ * in WAL mode, a power loss may lose the last transactions but does not
+ * corrupt the database.
+ */
+static const CONNECTION_PRAGMAS highThroughputReader = {
+	{ -8192, 67108864, "NORMAL" },		// 8MB cache, 64MB mapped
+	{ -16384, 268435456, "NORMAL" },	// 16MB cache, 256MB mapped
+	PRAGMA_DEFAULT,
+	"MEMORY"
+};
+
+/**
+ * The high-throughput profile for the readings writer. A larger cache keeps
+ * the indexes of the readings tables in memory and checkpointing every
+ * 10000 pages, rather than 1000, moves fewer and larger batches of pages
+ * from the WAL into the database.
+ */
+static const CONNECTION_PRAGMAS highThroughputWriter = {
+	{ -8192, 67108864, "NORMAL" },		// 8MB cache, 64MB mapped
+	{ -65536, 268435456, "NORMAL" },	// 64MB cache, 256MB mapped
+	10000,
+	"MEMORY"
+};
+
+/**
+ * Constructor for the PRAGMA configuration class
+ */
+PragmaConfiguration::PragmaConfiguration() : m_reader(defaultPragmas),
+	m_writer(defaultPragmas)
+{
+}
+
+/**
+ * Destructor for the PRAGMA configuration class
+ */
+PragmaConfiguration::~PragmaConfiguration()
+{
+}
+
+/**
+ * Return the singleton instance of the PragmaConfiguration class
+ * for this plugin
+ *
+ * @return PragmaConfiguration* singleton instance
+ */
+PragmaConfiguration *PragmaConfiguration::getInstance()
+{
+	if (m_instance == 0)
+	{
+		m_instance = new PragmaConfiguration();
+	}
+	return m_instance;
+}
+
+/**
+ * Select the profile of PRAGMA settings
+ *
+ * @param profile	The name of the profile, default or high-throughput
+ * @return bool		False if the profile is not known, the default is used
+ */
+bool PragmaConfiguration::setProfile(const string& profile)
+{
+	if (profile.compare("high-throughput") == 0)
+	{
+		m_reader = highThroughputReader;
+		m_writer = highThroughputWriter;
+	}
+	else
+	{
+		m_reader = defaultPragmas;
+		m_writer = defaultPragmas;
+		if (profile.compare("default") != 0)
+		{
+			Logger::getLogger()->error("Unknown SQLite PRAGMA profile '%s', the default profile will be used",
+					profile.c_str());
+			return false;
+		}
+	}
+	Logger::getLogger()->info("Using the %s SQLite PRAGMA profile", profile.c_str());
+	return true;
+}
+
+/**
+ * Override individual settings of the profile. The overrides are a JSON
+ * document with a reader and a writer object, each with a config and a
+ * readings object for the database pragmas, e.g.
+ *
+ *   { "writer" : { "readings" : { "cache_size" : -131072 }, "wal_autocheckpoint" : 20000 } }
+ *
+ * @param overrides	The JSON document of the overrides
+ * @return bool		False if the document could not be parsed
+ */
+bool PragmaConfiguration::setOverrides(const string& overrides)
+{
+	Document doc;
+	if (doc.Parse(overrides.c_str()).HasParseError() || !doc.IsObject())
+	{
+		Logger::getLogger()->error("The SQLite PRAGMA overrides are not a valid JSON object, they will be ignored");
+		return false;
+	}
+	if (doc.HasMember("reader") && doc["reader"].IsObject())
+	{
+		setConnectionPragmas(m_reader, doc["reader"]);
+	}
+	if (doc.HasMember("writer") && doc["writer"].IsObject())
+	{
+		setConnectionPragmas(m_writer, doc["writer"]);
+	}
+	return true;
+}
+
+/**
+ * Set the connection pragmas found in a JSON object
+ *
+ * @param pragmas	The pragmas to update
+ * @param value		The JSON object of the connection
+ */
+void PragmaConfiguration::setConnectionPragmas(CONNECTION_PRAGMAS& pragmas, const Value& value)
+{
+	if (value.HasMember("config") && value["config"].IsObject())
+	{
+		setDbPragmas(pragmas.config, value["config"]);
+	}
+	if (value.HasMember("readings") && value["readings"].IsObject())
+	{
+		setDbPragmas(pragmas.readings, value["readings"]);
+	}
+	if (value.HasMember("wal_autocheckpoint") && value["wal_autocheckpoint"].IsInt())
+	{
+		pragmas.walAutocheckpoint = value["wal_autocheckpoint"].GetInt();
+	}
+	if (value.HasMember("temp_store") && value["temp_store"].IsString())
+	{
+		string tempStore = value["temp_store"].GetString();
+		if (validKeyword("temp_store", tempStore, tempStoreValues))
+		{
+			pragmas.tempStore = tempStore;
+		}
+	}
+}
+
+/**
+ * Set the database pragmas found in a JSON object
+ *
+ * @param pragmas	The pragmas to update
+ * @param value		The JSON object of the database
+ */
+void PragmaConfiguration::setDbPragmas(DB_PRAGMAS& pragmas, const Value& value)
+{
+	if (value.HasMember("cache_size") && value["cache_size"].IsInt64())
+	{
+		pragmas.cacheSize = value["cache_size"].GetInt64();
+	}
+	if (value.HasMember("mmap_size") && value["mmap_size"].IsInt64())
+	{
+		pragmas.mmapSize = value["mmap_size"].GetInt64();
+	}
+	if (value.HasMember("synchronous") && value["synchronous"].IsString())
+	{
+		string synchronous = value["synchronous"].GetString();
+		if (validKeyword("synchronous", synchronous, synchronousValues))
+		{
+			pragmas.synchronous = synchronous;
+		}
+	}
+}
+
+/**
+ * Record a connection used by a readings writer and apply the
+ * writer settings to it
+ *
+ * @param dbHandle	The writer connection
+ */
+void PragmaConfiguration::addWriter(sqlite3 *dbHandle)
+{
+	m_writerHandles.insert(dbHandle);
+	apply(dbHandle);
+}
+
+/**
+ * Forget a connection once its readings writer has stopped
+ *
+ * @param dbHandle	The writer connection
+ */
+void PragmaConfiguration::removeWriter(sqlite3 *dbHandle)
+{
+	m_writerHandles.erase(dbHandle);
+}
+
+/**
+ * Disable the automatic checkpoint of the WAL on all the connections,
+ * used when the checkpoints are run by the WAL checkpointer
+ */
+void PragmaConfiguration::disableAutocheckpoint()
+{
+	m_reader.walAutocheckpoint = 0;
+	m_writer.walAutocheckpoint = 0;
+}
+
+/**
+ * Return the settings of a connection
+ *
+ * @param dbHandle	The connection
+ */
+const CONNECTION_PRAGMAS& PragmaConfiguration::getPragmas(sqlite3 *dbHandle) const
+{
+	return m_writerHandles.count(dbHandle) ? m_writer : m_reader;
+}
+
+/**
+ * Apply the settings to a connection and all the databases attached to it
+ *
+ * @param dbHandle	The connection
+ */
+void PragmaConfiguration::apply(sqlite3 *dbHandle)
+{
+	const CONNECTION_PRAGMAS& pragmas = getPragmas(dbHandle);
+
+	if (pragmas.walAutocheckpoint != PRAGMA_DEFAULT)
+	{
+		exec(dbHandle, "PRAGMA wal_autocheckpoint = " + to_string(pragmas.walAutocheckpoint) + ";");
+	}
+	if (!pragmas.tempStore.empty())
+	{
+		exec(dbHandle, "PRAGMA temp_store = " + pragmas.tempStore + ";");
+	}
+
+	vector<string> aliases;
+	sqlite3_stmt *stmt;
+	if (sqlite3_prepare_v2(dbHandle, "PRAGMA database_list;", -1, &stmt, NULL) == SQLITE_OK)
+	{
+		while (sqlite3_step(stmt) == SQLITE_ROW)
+		{
+			aliases.push_back((const char *)sqlite3_column_text(stmt, 1));
+		}
+		sqlite3_finalize(stmt);
+	}
+	for (auto& alias : aliases)
+	{
+		applyDatabase(dbHandle, alias);
+	}
+}
+
+/**
+ * Apply the settings of a database attached to a connection, the
+ * readings databases are those whose alias starts with readings_
+ *
+ * @param dbHandle	The connection
+ * @param alias		The alias of the database
+ */
+void PragmaConfiguration::applyDatabase(sqlite3 *dbHandle, const string& alias)
+{
+	const CONNECTION_PRAGMAS& connPragmas = getPragmas(dbHandle);
+	const DB_PRAGMAS *pragmas;
+
+	if (alias.compare(0, 9, "readings_") == 0)
+	{
+		pragmas = &connPragmas.readings;
+	}
+	else if (alias.compare("main") == 0 || alias.compare("fledge") == 0)
+	{
+		pragmas = &connPragmas.config;
+	}
+	else
+	{
+		return;
+	}
+
+	string sql;
+	if (pragmas->cacheSize)
+	{
+		sql += "PRAGMA " + alias + ".cache_size = " + to_string(pragmas->cacheSize) + ";";
+	}
+	if (pragmas->mmapSize != PRAGMA_DEFAULT)
+	{
+		sql += "PRAGMA " + alias + ".mmap_size = " + to_string(pragmas->mmapSize) + ";";
+	}
+	if (!pragmas->synchronous.empty())
+	{
+		sql += "PRAGMA " + alias + ".synchronous = " + pragmas->synchronous + ";";
+	}
+	if (!sql.empty())
+	{
+		exec(dbHandle, sql);
+	}
+}
+
+/**
+ * Execute the PRAGMA statements, a failure is logged but otherwise ignored
+ *
+ * @param dbHandle	The connection
+ * @param sql		The statements
+ */
+void PragmaConfiguration::exec(sqlite3 *dbHandle, const string& sql)
+{
+	char *zErrMsg = NULL;
+	if (sqlite3_exec(dbHandle, sql.c_str(), NULL, NULL, &zErrMsg) != SQLITE_OK)
+	{
+		Logger::getLogger()->error("Failed to set the SQLite pragmas '%s': %s",
+				sql.c_str(), zErrMsg ? zErrMsg : "");
+		sqlite3_free(zErrMsg);
+	}
+}
@@ -18,7 +18,7 @@ PurgeConfiguration *PurgeConfiguration::m_instance = 0;
 /**
  * Constructor for the purge configurtion class
  */
-PurgeConfiguration::PurgeConfiguration() : m_minimum(0)
+PurgeConfiguration::PurgeConfiguration() : m_minimum(0), m_threads(1)
 {
 }
 
@@ -10,9 +10,12 @@
 
 #include <math.h>
 #include <connection.h>
+#include <payload_document.h>
 #include <connection_manager.h>
 #include <common.h>
 #include <reading_stream.h>
+#include <reading_stream_payload.h>
+#include <tracer.h>
 #include <random>
 #include <utils.h>
 
@@ -23,6 +26,15 @@
 #include <vector>
 
 #include <readings_catalogue.h>
+#include <insert_configuration.h>
+#include <readings_rollup.h>
+#include <readings_latest.h>
+#include <readings_blobs.h>
+#include <readings_compression.h>
+#include <readings_timestamps.h>
+#include <readings_writer.h>
+#include <base64_codec.h>
+#include <set>
 
 // 1 enable performance tracking
 #define INSTRUMENT	0
@@ -51,21 +63,19 @@ using namespace rapidjson;
 
 #define CONNECT_ERROR_THRESHOLD		5*60	// 5 minutes
 
+#define MAX_CACHED_STATEMENTS		500	// Prepared statements cached per connection
+
 
 /*
- * The following allows for conditional inclusion of code that tracks the top queries
- * run by the storage plugin and the number of times a particular statement has to
- * be retried because of the database being busy./
+ * The following allows for conditional inclusion of code that tracks the number of
+ * times a particular statement has to be retried because of the database being busy.
+ * The slowest statements are always kept by the storage profile.
  */
 #define DO_PROFILE		0
 #define DO_PROFILE_RETRIES	0
 #if DO_PROFILE
-#include <profile.h>
-
-#define	TOP_N_STATEMENTS		10	// Number of statements to report in top n
 #define RETRY_REPORT_THRESHOLD		1000	// Report retry statistics every X calls
 
-QueryProfile profiler(TOP_N_STATEMENTS);
 unsigned long retryStats[MAX_RETRIES] = { 0,0,0,0,0,0,0,0,0,0 };
 unsigned long numStatements = 0;
 int	      maxQueue = 0;
@@ -127,6 +137,17 @@ bool Connection::aggregateQuery(const Value& payload, string& resultSet)
 		return false;
 	}
 
+	// Answer the query from the rollup of the readings when it can be
+	bool rolledUp;
+	if (!rollupQuery(payload, resultSet, &rolledUp))
+	{
+		return false;
+	}
+	if (rolledUp)
+	{
+		return true;
+	}
+
 	SQLBuffer sql;
 
 	sql.append("SELECT asset_code, ");
@@ -280,7 +301,7 @@ bool Connection::aggregateQuery(const Value& payload, string& resultSet)
 		// SQL - union of all the readings tables
 		string sql_cmd_base;
 		string sql_cmd_tmp;
-		sql_cmd_base = " SELECT  ROWID, id, \"_assetcode_\" asset_code, reading, user_ts, ts  FROM _dbname_._tablename_ ";
+		sql_cmd_base = " SELECT  ROWID, id, \"_assetcode_\" asset_code, reading, " + ReadingsTimestamps::getInstance()->columns() + "  FROM _dbname_._tablename_ ";
 		sql_cmd_tmp = readCat->sqlConstructMultiDb(sql_cmd_base, asset_codes);
 		sql_cmd += sql_cmd_tmp;
 
@@ -297,7 +318,7 @@ bool Connection::aggregateQuery(const Value& payload, string& resultSet)
 
 	// Add where condition
 	sql.append("WHERE ");
-	if (!jsonWhereClause(payload["where"], sql, asset_codes))
+	if (!jsonWhereClause(payload["where"], sql, asset_codes, false, "", ReadingsTimestamps::getInstance()->isEpoch()))
 	{
 		raiseError("retrieve", "aggregateQuery: failure while building WHERE clause");
 		return false;
@@ -384,159 +405,1089 @@ bool Connection::aggregateQuery(const Value& payload, string& resultSet)
 }
 #endif
 
+#ifndef SQLITE_SPLIT_READINGS
 /**
- * Append a stream of readings to SQLite db
- *
- * @param readings  readings to store into the SQLite db
- * @param commit    if true a database commit is executed and a new transaction will be opened at the next execution
- *
- * TODO: the current code should be adapted to use the multi databases/tables implementation
+ * Take the asset code and the time range of a timebucket query out of
+ * its where clause. Only a where clause on a single asset code with
+ * optional newer and older conditions on the user timestamp can be
+ * answered from the rollup.
  *
+ * @param where		The where clause of the query
+ * @param asset		Set to the asset code
+ * @param newer		Set to the newer condition in seconds, 0 if none
+ * @param older		Set to the older condition in seconds, 0 if none
+ * @return bool		False if the where clause can not be answered from the rollup
  */
-int Connection::readingStream(ReadingStream **readings, bool commit)
+static bool rollupWhere(const Value& where, string& asset, long *newer, long *older)
 {
-	// Row defintion related
-	int i;
-	bool add_row = false;
-	const char *user_ts;
-	string now;
-	char ts[60], micro_s[10];
-	char formatted_date[LEN_BUFFER_DATE] = {0};
-	struct tm timeinfo;
-	const char *asset_code;
-	const char *payload;
-	string reading;
-
-	// Retry mechanism
-	int retries = 0;
-	int sleep_time_ms = 0;
+	if (!where.IsObject() || where.HasMember("or")
+			|| !where.HasMember("column") || !where["column"].IsString()
+			|| !where.HasMember("condition") || !where["condition"].IsString()
+			|| !where.HasMember("value"))
+	{
+		return false;
+	}
+	const char *column = where["column"].GetString();
+	const char *condition = where["condition"].GetString();
+	const Value& value = where["value"];
+	if (strcmp(column, "asset_code") == 0 && strcmp(condition, "=") == 0
+			&& value.IsString() && asset.empty())
+	{
+		asset = value.GetString();
+	}
+	else if (strcmp(column, "user_ts") == 0 && strcmp(condition, "newer") == 0
+			&& value.IsInt() && value.GetInt() > 0 && *newer == 0)
+	{
+		*newer = value.GetInt();
+	}
+	else if (strcmp(column, "user_ts") == 0 && strcmp(condition, "older") == 0
+			&& value.IsInt() && value.GetInt() > 0 && *older == 0)
+	{
+		*older = value.GetInt();
+	}
+	else
+	{
+		return false;
+	}
+	if (where.HasMember("and"))
+	{
+		return rollupWhere(where["and"], asset, newer, older);
+	}
+	return !asset.empty();
+}
 
-	// SQLite related
-	sqlite3_stmt *stmt;
-	int sqlite3_resut;
-	int rowNumber = -1;
+/**
+ * Return the expression of a time to compare with the stored user timestamps
+ *
+ * @param seconds	The seconds since the epoch
+ * @return string	The SQL expression
+ */
+static string rollupTime(long seconds)
+{
+	if (ReadingsTimestamps::getInstance()->isEpoch())
+	{
+		return to_string((int64_t)seconds * 1000000);
+	}
+	return "datetime(" + to_string(seconds) + ", 'unixepoch')";
+}
 
-	ostringstream threadId;
-	threadId << std::this_thread::get_id();
-	ReadingsCatalogue *readCatalogue = ReadingsCatalogue::getInstance();
+/**
+ * Answer a timebucket query from the rollup of the readings rather than
+ * from every reading. The query must be on a single asset code, with
+ * buckets of the user timestamp whose size is an even number of rollup
+ * intervals. The result has the same form as that of aggregateQuery and
+ * the aggregates only cover the numeric datapoints. The intervals at the
+ * edges of a newer or older condition are only partly within the range,
+ * they are aggregated from the readings themselves.
+ *
+ * @param payload	JSON object for timebucket query
+ * @param resultSet	JSON Output buffer
+ * @param done		Set to true if the query was answered from the rollup
+ * @return bool		True if the query was not answered from the rollup or succeeded
+ */
+bool Connection::rollupQuery(const Value& payload, string& resultSet, bool *done)
+{
+	ReadingsRollup *rollup = ReadingsRollup::getInstance();
 
+	*done = false;
+	if (!rollup->isEnabled())
 	{
-		// Attaches the needed databases if the queue is not empty
-		AttachDbSync *attachSync = AttachDbSync::getInstance();
-		attachSync->lock();
-
-		if ( ! m_NewDbIdList.empty())
+		return true;
+	}
+	for (auto& member : payload.GetObject())
+	{
+		const char *name = member.name.GetString();
+		if (strcmp(name, "aggregate") && strcmp(name, "timebucket")
+				&& strcmp(name, "where") && strcmp(name, "limit"))
 		{
-			readCatalogue->connectionAttachDbList(this->getDbHandle(), m_NewDbIdList);
+			return true;
 		}
-		attachSync->unlock();
+	}
+	const Value& bucket = payload["timebucket"];
+	if (!bucket.IsObject() || !bucket.HasMember("timestamp") || !bucket["timestamp"].IsString()
+			|| strcmp(bucket["timestamp"].GetString(), "user_ts") != 0
+			|| !bucket.HasMember("size") || !bucket["size"].IsString()
+			|| (bucket.HasMember("format") && !bucket["format"].IsString())
+			|| (bucket.HasMember("alias") && !bucket["alias"].IsString())
+			|| (payload.HasMember("limit") && !payload["limit"].IsInt()))
+	{
+		return true;
+	}
+	double bucketSize = atof(bucket["size"].GetString());
+	if (!rollup->supports(bucketSize))
+	{
+		return true;
+	}
+	unsigned long size = (unsigned long)bucketSize;
+	string asset;
+	long newer = 0, older = 0;
+	if (!rollupWhere(payload["where"], asset, &newer, &older))
+	{
+		return true;
 	}
 
-#if INSTRUMENT
-	struct timeval start, t1, t2, t3, t4, t5;
-#endif
-
-	// * TODO: the current code should be adapted to use the multi databases/tables implementation
-	const char *sql_cmd = "INSERT INTO  " READINGS_DB ".readings_1 ( asset_code, reading, user_ts ) VALUES  (?,?,?)";
+	unsigned long interval = rollup->getInterval();
+	long now = time(0);
+	string sizeText = to_string(size);
+	string bucketTime = "(bucket * " + to_string(interval) + " + " + to_string(size / 2) + ") / " + sizeText;
 
-	if (sqlite3_prepare_v2(dbHandle, sql_cmd, strlen(sql_cmd), &stmt, NULL) != SQLITE_OK)
+	// The whole intervals within the range are taken from the rollup
+	string wholeWhere = "asset_code = '" + escape(asset) + "'";
+	long first = (now - newer) / (long)interval;
+	long last = (now - older) / (long)interval;
+	if (newer)
 	{
-		raiseError("readingStream", sqlite3_errmsg(dbHandle));
-		return -1;
+		wholeWhere += " AND bucket > " + to_string(first);
 	}
+	if (older)
+	{
+		wholeWhere += " AND bucket < " + to_string(last);
+	}
+	string source = "SELECT datapoint, asset_code, bucket, minimum, maximum, total, count FROM "
+			+ rollup->getTable() + " WHERE " + wholeWhere;
 
-	// The handling of the commit parameter is overridden as using a pool of connections every execution receives
-	// a differen one, so a commit at every run is executed.
-	m_streamOpenTransaction = true;
-	commit = true;
-
-	if (m_streamOpenTransaction)
+	// The intervals at the edges from the readings within the range
+	if (newer || older)
 	{
-		if (sqlite3_exec(dbHandle, "BEGIN TRANSACTION", NULL, NULL, NULL) != SQLITE_OK)
+		ReadingsTimestamps *timestamps = ReadingsTimestamps::getInstance();
+		string base = " SELECT \"_assetcode_\" asset_code, reading, user_ts FROM _dbname_._tablename_ ";
+		vector<string> assetCodes;
+		assetCodes.push_back(asset);
+		string readings = ReadingsCatalogue::getInstance()->sqlConstructMultiDb(base, assetCodes);
+		string bucketOf = timestamps->seconds("user_ts") + " / " + to_string(interval);
+		string edges;
+		if (newer)
 		{
-			raiseError("readingStream", sqlite3_errmsg(dbHandle));
-			return -1;
+			edges = to_string(first);
 		}
-		m_streamOpenTransaction = false;
+		if (older)
+		{
+			edges += (newer ? ", " : "") + to_string(last);
+		}
+		source += " UNION ALL SELECT json_each.key, asset_code, " + bucketOf + ", "
+			"min(json_each.value), max(json_each.value), sum(json_each.value), count(*) "
+			"FROM (" + readings + ") AS reading_table, json_each(reading_table.reading) "
+			"WHERE asset_code = '" + escape(asset) + "' "
+			"AND json_each.type IN ('integer', 'real') AND " + bucketOf + " IN (" + edges + ")";
+		if (newer)
+		{
+			source += " AND user_ts > " + rollupTime(now - newer);
+		}
+		if (older)
+		{
+			source += " AND user_ts < " + rollupTime(now - older);
+		}
+		source += " GROUP BY 1, 2, 3";
 	}
 
-#if INSTRUMENT
-	gettimeofday(&start, NULL);
-#endif
+	SQLBuffer sql;
+	sql.append("SELECT asset_code, ");
+	if (bucket.HasMember("format"))
+	{
+		string newFormat;
+		applyColumnDateFormatLocaltime(bucket["format"].GetString(), "timestamp", newFormat, true);
+		sql.append(newFormat);
+	}
+	else
+	{
+		sql.append("timestamp");
+	}
+	if (bucket.HasMember("alias"))
+	{
+		sql.append(" AS ");
+		sql.append(bucket["alias"].GetString());
+	}
+	sql.append(", '{' || group_concat('\"' || x || '\" : ' || resd, ', ') || '}' AS reading ");
 
-	try
+	// The sums of the intervals in each bucket
+	sql.append("FROM ( SELECT datapoint AS x, asset_code, ");
+	sql.append("datetime(" + sizeText + " * (" + bucketTime + "), 'unixepoch') AS \"timestamp\", ");
+	sql.append("'{\"min\" : ' || min(minimum) || ', ");
+	sql.append("\"max\" : ' || max(maximum) || ', ");
+	sql.append("\"average\" : ' || (sum(total) * 1.0 / sum(count)) || ', ");
+	sql.append("\"count\" : ' || sum(count) || ', ");
+	sql.append("\"sum\" : ' || sum(total) || '}' AS resd ");
+	sql.append("FROM (");
+	sql.append(source);
+	sql.append(") rollup_table GROUP BY datapoint, asset_code, ");
+	sql.append(bucketTime);
+	sql.append(") tbl GROUP BY timestamp, asset_code ORDER BY timestamp DESC");
+	if (payload.HasMember("limit"))
 	{
-		for (i = 0; readings[i]; i++)
-		{
-			add_row = true;
+		sql.append(" LIMIT ");
+		sql.append(payload["limit"].GetInt());
+	}
+	sql.append(';');
 
-			// Handles - asset_code
-			asset_code = RDS_ASSET_CODE(readings, i);
+	const char *query = sql.coalesce();
+	sqlite3_stmt *stmt;
 
-			// Handles - reading
-			payload = RDS_PAYLOAD(readings, i);
-			reading = escape(payload);
+	logSQL("RollupRetrieve", query);
 
-			// Handles - user_ts
-			memset(&timeinfo, 0, sizeof(struct tm));
-			gmtime_r(&RDS_USER_TIMESTAMP(readings, i).tv_sec, &timeinfo);
-			std::strftime(ts, sizeof(ts), "%Y-%m-%d %H:%M:%S", &timeinfo);
-			snprintf(micro_s, sizeof(micro_s), ".%06lu", RDS_USER_TIMESTAMP(readings, i).tv_usec);
+	int rc = sqlite3_prepare_v2(dbHandle, query, -1, &stmt, NULL);
+	delete[] query;
+	if (rc != SQLITE_OK)
+	{
+		raiseError("retrieve", sqlite3_errmsg(dbHandle));
+		return false;
+	}
+	rc = mapResultSet(stmt, resultSet);
+	sqlite3_finalize(stmt);
+	if (rc != SQLITE_DONE)
+	{
+		raiseError("retrieve", sqlite3_errmsg(dbHandle));
+		return false;
+	}
+	*done = true;
+	return true;
+}
 
-			formatted_date[0] = {0};
-			strncat(ts, micro_s, 10);
-			user_ts = ts;
-			if (strcmp(user_ts, "now()") == 0)
+/**
+ * Create the rollup table of the configured interval, if it does not
+ * already exist, from the readings already stored. The rollup tables of
+ * other intervals are no longer kept up to date and are dropped.
+ *
+ * @return bool	True if the rollup table is ready
+ */
+bool Connection::createRollup()
+{
+	ReadingsRollup *rollup = ReadingsRollup::getInstance();
+	string current = ROLLUP_TABLE_BASE + to_string(rollup->getInterval());
+	bool exists = false;
+	vector<string> stale;
+	sqlite3_stmt *stmt;
+
+	if (sqlite3_prepare_v2(dbHandle, "SELECT name FROM " READINGS_DB ".sqlite_master "
+				"WHERE type = 'table' AND name LIKE '" ROLLUP_TABLE_BASE "%';",
+				-1, &stmt, NULL) == SQLITE_OK)
+	{
+		while (sqlite3_step(stmt) == SQLITE_ROW)
+		{
+			string name((const char *)sqlite3_column_text(stmt, 0));
+			if (rollup->isEnabled() && name.compare(current) == 0)
 			{
-				getNow(now);
-				user_ts = now.c_str();
+				exists = true;
 			}
 			else
 			{
-				if (!formatDate(formatted_date, sizeof(formatted_date), user_ts))
-				{
-					raiseError("appendReadings", "Invalid date |%s|", user_ts);
-					add_row = false;
-				}
-				else
-				{
-					user_ts = formatted_date;
-				}
+				stale.push_back(name);
 			}
+		}
+		sqlite3_finalize(stmt);
+	}
+	for (auto& name : stale)
+	{
+		string sql = "DROP TABLE " READINGS_DB "." + name + ";";
+		if (SQLexec(dbHandle, sql.c_str(), NULL, NULL, NULL) == SQLITE_OK)
+		{
+			Logger::getLogger()->info("Dropped the readings rollup %s", name.c_str());
+		}
+	}
+	if (!rollup->isEnabled() || exists)
+	{
+		return true;
+	}
 
-			if (add_row)
-			{
-				if (stmt != NULL)
-				{
-					sqlite3_bind_text(stmt, 1, asset_code,      -1, SQLITE_STATIC);
-					sqlite3_bind_text(stmt, 2, reading.c_str(), -1, SQLITE_STATIC);
-					sqlite3_bind_text(stmt, 3, user_ts,         -1, SQLITE_STATIC);
-
-					retries =0;
-					sleep_time_ms = 0;
+	Logger::getLogger()->info("Building the readings rollup %s from the stored readings", current.c_str());
+
+	// The rollup of the readings already stored
+	string readings;
+	string base = " SELECT \"_assetcode_\" asset_code, reading, user_ts FROM _dbname_._tablename_ ";
+	vector<string> assetCodes;
+	readings = ReadingsCatalogue::getInstance()->sqlConstructMultiDb(base, assetCodes);
+
+	string table = rollup->getTable();
+	string interval = to_string(rollup->getInterval());
+	string create = "CREATE TABLE " + table + " ("
+			"asset_code TEXT NOT NULL, "
+			"datapoint TEXT NOT NULL, "
+			"bucket INTEGER NOT NULL, "
+			"minimum NUMERIC, "
+			"maximum NUMERIC, "
+			"total NUMERIC, "
+			"count INTEGER, "
+			"PRIMARY KEY (asset_code, datapoint, bucket)) WITHOUT ROWID;";
+	string fill = "INSERT INTO " + table + " (asset_code, datapoint, bucket, minimum, maximum, total, count) "
+			"SELECT asset_code, json_each.key, " + ReadingsTimestamps::getInstance()->seconds("user_ts") + " / " + interval + ", "
+			"min(json_each.value), max(json_each.value), sum(json_each.value), count(*) "
+			"FROM (" + readings + ") AS reading_table, json_each(reading_table.reading) "
+			"WHERE json_each.type IN ('integer', 'real') "
+			"GROUP BY 1, 2, 3;";
 
-					// Retry mechanism in case SQLlite DB is locked
-					do {
-						// Insert the row using a lock to ensure one insert at time
-						{
-							m_writeAccessOngoing.fetch_add(1);
-							//unique_lock<mutex> lck(db_mutex);
+	m_writeAccessOngoing.fetch_add(1);
+	sqlite3_exec(dbHandle, "BEGIN TRANSACTION", NULL, NULL, NULL);
+	if (SQLexec(dbHandle, create.c_str(), NULL, NULL, NULL) != SQLITE_OK
+			|| SQLexec(dbHandle, fill.c_str(), NULL, NULL, NULL) != SQLITE_OK
+			|| sqlite3_exec(dbHandle, "END TRANSACTION", NULL, NULL, NULL) != SQLITE_OK)
+	{
+		raiseError("rollup", "Creating the readings rollup %s :%s:", current.c_str(), sqlite3_errmsg(dbHandle));
+		sqlite3_exec(dbHandle, "ROLLBACK TRANSACTION", NULL, NULL, NULL);
+		m_writeAccessOngoing.fetch_sub(1);
+		return false;
+	}
+	m_writeAccessOngoing.fetch_sub(1);
+	return true;
+}
 
-							sqlite3_resut = sqlite3_step(stmt);
+/**
+ * Bind the values of the rollup of a datapoint to the statement that
+ * writes them
+ *
+ * @param stmt		The statement
+ * @param key		The asset code, datapoint and bucket
+ * @param values	The rollup of the datapoint
+ */
+static void bindRollup(sqlite3_stmt *stmt, const RollupBatch::Key& key, const RollupBatch::Values& values)
+{
+	const string& asset = std::get<0>(key);
+	const string& datapoint = std::get<1>(key);
 
-							m_writeAccessOngoing.fetch_sub(1);
-							//db_cv.notify_all();
-						}
+	sqlite3_bind_text(stmt, 1, asset.c_str(), (int)asset.length(), SQLITE_STATIC);
+	sqlite3_bind_text(stmt, 2, datapoint.c_str(), (int)datapoint.length(), SQLITE_STATIC);
+	sqlite3_bind_int64(stmt, 3, std::get<2>(key));
+	if (values.m_integer)
+	{
+		sqlite3_bind_int64(stmt, 4, (sqlite3_int64)values.m_minimum);
+		sqlite3_bind_int64(stmt, 5, (sqlite3_int64)values.m_maximum);
+		sqlite3_bind_int64(stmt, 6, (sqlite3_int64)values.m_total);
+	}
+	else
+	{
+		sqlite3_bind_double(stmt, 4, values.m_minimum);
+		sqlite3_bind_double(stmt, 5, values.m_maximum);
+		sqlite3_bind_double(stmt, 6, values.m_total);
+	}
+	sqlite3_bind_int64(stmt, 7, values.m_count);
+}
 
-						if (sqlite3_resut == SQLITE_LOCKED  )
-						{
-							sleep_time_ms = PREP_CMD_RETRY_BASE + (random() %  PREP_CMD_RETRY_BACKOFF);
-							retries++;
+/**
+ * Add the rollup of the readings inserted by the current transaction to
+ * the rollup table, within the transaction
+ *
+ * @param batch		The rollup of the readings inserted
+ * @return bool		True if the rollup was written
+ */
+bool Connection::writeRollup(const RollupBatch& batch)
+{
+	if (batch.empty())
+	{
+		return true;
+	}
+	const string& table = ReadingsRollup::getInstance()->getTable();
+	sqlite3_stmt *update = getCachedStatement("UPDATE " + table + " SET "
+			"minimum = min(minimum, ?4), maximum = max(maximum, ?5), "
+			"total = total + ?6, count = count + ?7 "
+			"WHERE asset_code = ?1 AND datapoint = ?2 AND bucket = ?3;");
+	sqlite3_stmt *insert = getCachedStatement("INSERT INTO " + table +
+			" (asset_code, datapoint, bucket, minimum, maximum, total, count) "
+			"VALUES (?1, ?2, ?3, ?4, ?5, ?6, ?7);");
+	if (!update || !insert)
+	{
+		raiseError("appendReadings", "Preparing the rollup of the readings :%s:", sqlite3_errmsg(dbHandle));
+		return false;
+	}
 
-							Logger::getLogger()->info("SQLITE_LOCKED - record :%d: - retry number :%d: sleep time ms :%d:",i, retries, sleep_time_ms);
+	for (auto& item : batch.values())
+	{
+		// Most rows update the rollup of an interval already started
+		bindRollup(update, item.first, item.second);
+		int rc = SQLstep(update);
+		sqlite3_reset(update);
+		if (rc == SQLITE_DONE && sqlite3_changes(dbHandle) == 0)
+		{
+			bindRollup(insert, item.first, item.second);
+			rc = SQLstep(insert);
+			sqlite3_reset(insert);
+		}
+		if (rc != SQLITE_DONE)
+		{
+			raiseError("appendReadings", "Writing the rollup of the readings :%s:", sqlite3_errmsg(dbHandle));
+			return false;
+		}
+	}
+	return true;
+}
 
-							std::this_thread::sleep_for(std::chrono::milliseconds(sleep_time_ms));
-						}
+/**
+ * Remove the rollup of the intervals older than that of the oldest
+ * reading that remains after a purge, or all of the rollup if no
+ * readings remain
+ */
+void Connection::purgeRollup()
+{
+	ReadingsRollup *rollup = ReadingsRollup::getInstance();
+	if (!rollup->isEnabled())
+	{
+		return;
+	}
+	string base = " SELECT MIN(user_ts) AS user_ts FROM _dbname_._tablename_ ";
+	vector<string> assetCodes;
+	string oldest = "SELECT " + ReadingsTimestamps::getInstance()->seconds("MIN(user_ts)")
+			+ " / " + to_string(rollup->getInterval())
+			+ " FROM (" + ReadingsCatalogue::getInstance()->sqlConstructMultiDb(base, assetCodes) + ")";
+	string sql = "DELETE FROM " + rollup->getTable()
+			+ " WHERE bucket < COALESCE((" + oldest + "), bucket + 1);";
+
+	m_writeAccessOngoing.fetch_add(1);
+	if (SQLexec(dbHandle, sql.c_str(), NULL, NULL, NULL) != SQLITE_OK)
+	{
+		raiseError("purge", "Purging the readings rollup :%s:", sqlite3_errmsg(dbHandle));
+	}
+	m_writeAccessOngoing.fetch_sub(1);
+}
+
+/**
+ * Create the table of the latest values of the assets, if it does not
+ * already exist, and load the latest values held in it
+ *
+ * @return bool	True if the latest values were loaded
+ */
+bool Connection::loadLatest()
+{
+	string sql = "CREATE TABLE IF NOT EXISTS " READINGS_DB "." LATEST_TABLE " ("
+			"asset_code TEXT NOT NULL, "
+			"datapoint TEXT NOT NULL, "
+			"value TEXT, "
+			"user_ts TEXT, "
+			"PRIMARY KEY (asset_code, datapoint)) WITHOUT ROWID;";
+	if (SQLexec(dbHandle, sql.c_str(), NULL, NULL, NULL) != SQLITE_OK)
+	{
+		raiseError("latest", "Creating the table of the latest values :%s:", sqlite3_errmsg(dbHandle));
+		return false;
+	}
+
+	sqlite3_stmt *stmt;
+	if (sqlite3_prepare_v2(dbHandle, "SELECT asset_code, datapoint, value, user_ts FROM "
+				READINGS_DB "." LATEST_TABLE ";", -1, &stmt, NULL) != SQLITE_OK)
+	{
+		raiseError("latest", "Loading the latest values :%s:", sqlite3_errmsg(dbHandle));
+		return false;
+	}
+	LatestBatch batch;
+	while (sqlite3_step(stmt) == SQLITE_ROW)
+	{
+		const char *asset = (const char *)sqlite3_column_text(stmt, 0);
+		const char *datapoint = (const char *)sqlite3_column_text(stmt, 1);
+		const char *value = (const char *)sqlite3_column_text(stmt, 2);
+		const char *userTs = (const char *)sqlite3_column_text(stmt, 3);
+		LatestValue latest;
+		if (!value || !userTs || !userTsToTime(userTs, &latest.m_time))
+		{
+			continue;
+		}
+		latest.m_value = value;
+		latest.m_userTs = userTs;
+		batch.add(LatestBatch::Key(asset, datapoint), latest);
+	}
+	sqlite3_finalize(stmt);
+	LatestReadings::getInstance()->update(batch);
+	Logger::getLogger()->info("Loaded %lu latest values of the assets", (unsigned long)batch.values().size());
+	return true;
+}
+
+/**
+ * Write the latest values of the readings inserted by the current
+ * transaction to the table of the latest values, within the transaction.
+ * The values are held by the connection until the transaction is
+ * committed, those that are older than the latest values already held
+ * are ignored.
+ *
+ * @param batch		The latest values of the readings inserted, cleared
+ * @return bool		True if the values were written
+ */
+bool Connection::writeLatest(LatestBatch& batch)
+{
+	if (batch.empty())
+	{
+		return true;
+	}
+	LatestReadings *latest = LatestReadings::getInstance();
+	sqlite3_stmt *stmt = getCachedStatement("INSERT OR REPLACE INTO " READINGS_DB "." LATEST_TABLE
+			" (asset_code, datapoint, value, user_ts) VALUES (?, ?, ?, ?);");
+	if (!stmt)
+	{
+		raiseError("appendReadings", "Preparing the latest values :%s:", sqlite3_errmsg(dbHandle));
+		return false;
+	}
+	for (auto& item : batch.values())
+	{
+		if (!latest->isLatest(item.first, item.second.m_time))
+		{
+			continue;
+		}
+		sqlite3_bind_text(stmt, 1, item.first.first.c_str(), -1, SQLITE_STATIC);
+		sqlite3_bind_text(stmt, 2, item.first.second.c_str(), -1, SQLITE_STATIC);
+		sqlite3_bind_text(stmt, 3, item.second.m_value.c_str(), -1, SQLITE_STATIC);
+		sqlite3_bind_text(stmt, 4, item.second.m_userTs.c_str(), -1, SQLITE_STATIC);
+		int rc = SQLstep(stmt);
+		sqlite3_reset(stmt);
+		if (rc != SQLITE_DONE)
+		{
+			raiseError("appendReadings", "Writing the latest values :%s:", sqlite3_errmsg(dbHandle));
+			return false;
+		}
+	}
+	m_latest.merge(batch);
+	batch.clear();
+	return true;
+}
+
+/**
+ * Create the table of the binary objects of the readings, if it does not
+ * already exist. The table is created even if the images and data buffers
+ * are kept within the readings so that the objects stored before they were
+ * are still returned and purged.
+ *
+ * @return bool	True if the table exists
+ */
+bool Connection::createBlobs()
+{
+	string sql = "CREATE TABLE IF NOT EXISTS " READINGS_DB "." BLOBS_TABLE " ("
+			"reading_id INTEGER NOT NULL, "
+			"seq INTEGER NOT NULL, "
+			"db_id INTEGER NOT NULL, "
+			"table_id INTEGER NOT NULL, "
+			"prefix TEXT NOT NULL, "
+			"data BLOB NOT NULL, "
+			"PRIMARY KEY (reading_id, seq));"
+		"CREATE INDEX IF NOT EXISTS " READINGS_DB "." BLOBS_TABLE "_ix1 ON "
+			BLOBS_TABLE " (db_id, table_id, reading_id);";
+	if (SQLexec(dbHandle, sql.c_str(), NULL, NULL, NULL) != SQLITE_OK)
+	{
+		raiseError("blobs", "Creating the table of the binary objects :%s:", sqlite3_errmsg(dbHandle));
+		return false;
+	}
+
+	sqlite3_stmt *stmt;
+	if (sqlite3_prepare_v2(dbHandle, "SELECT 1 FROM " READINGS_DB "." BLOBS_TABLE " LIMIT 1;",
+				-1, &stmt, NULL) == SQLITE_OK)
+	{
+		if (sqlite3_step(stmt) == SQLITE_ROW)
+		{
+			ReadingsBlobs::getInstance()->setStored();
+		}
+		sqlite3_finalize(stmt);
+	}
+	return true;
+}
+
+/**
+ * Create the table of the dictionaries of the compressed readings, if it
+ * does not already exist, and load the dictionaries held in it. The table
+ * is created even if the readings are not compressed so that readings
+ * compressed before are still returned.
+ *
+ * @return bool	True if the dictionaries were loaded
+ */
+bool Connection::createDictionaries()
+{
+	string sql = "CREATE TABLE IF NOT EXISTS " READINGS_DB "." DICTIONARIES_TABLE " ("
+			"id INTEGER PRIMARY KEY, "
+			"asset_code TEXT NOT NULL, "
+			"dictionary TEXT NOT NULL);";
+	if (SQLexec(dbHandle, sql.c_str(), NULL, NULL, NULL) != SQLITE_OK)
+	{
+		raiseError("compression", "Creating the table of the dictionaries :%s:", sqlite3_errmsg(dbHandle));
+		return false;
+	}
+
+	sqlite3_stmt *stmt;
+	if (sqlite3_prepare_v2(dbHandle, "SELECT id, asset_code, dictionary FROM "
+				READINGS_DB "." DICTIONARIES_TABLE " ORDER BY id;", -1, &stmt, NULL) != SQLITE_OK)
+	{
+		raiseError("compression", "Loading the dictionaries :%s:", sqlite3_errmsg(dbHandle));
+		return false;
+	}
+	ReadingsCompression *compression = ReadingsCompression::getInstance();
+	unsigned long count = 0;
+	while (sqlite3_step(stmt) == SQLITE_ROW)
+	{
+		const char *asset = (const char *)sqlite3_column_text(stmt, 1);
+		const char *dictionary = (const char *)sqlite3_column_blob(stmt, 2);
+		compression->addDictionary((unsigned int)sqlite3_column_int64(stmt, 0),
+				asset ? asset : "",
+				string(dictionary ? dictionary : "", sqlite3_column_bytes(stmt, 2)));
+		count++;
+	}
+	sqlite3_finalize(stmt);
+	if (count)
+	{
+		Logger::getLogger()->info("Loaded %lu dictionaries of the compressed readings", count);
+	}
+	return true;
+}
+
+/**
+ * Compress the JSON of a reading waiting to be inserted, storing the
+ * dictionary used within the transaction if it has not already been
+ * stored by it. A reading that does not compress is left as text.
+ *
+ * @param asset		The asset of the reading
+ * @param row		The reading, the JSON is replaced if it is compressed
+ * @param dictionaries	The dictionaries stored by the transaction
+ * @return bool		False if the dictionary could not be stored
+ */
+bool Connection::compressReading(const string& asset, READING_ROW& row, set<unsigned int>& dictionaries)
+{
+	string compressed;
+	unsigned int dictionary;
+	row.compressed = false;
+	if (!ReadingsCompression::getInstance()->compress(asset, row.reading, compressed, dictionary))
+	{
+		return true;
+	}
+	if (dictionaries.find(dictionary) == dictionaries.end())
+	{
+		if (!storeDictionary(dictionary))
+		{
+			return false;
+		}
+		dictionaries.insert(dictionary);
+	}
+	row.reading.swap(compressed);
+	row.compressed = true;
+	return true;
+}
+
+/**
+ * Store a dictionary of the compressed readings, within the transaction
+ * of the readings that use it
+ *
+ * @param id		The id of the dictionary
+ * @return bool		False if the dictionary could not be stored
+ */
+bool Connection::storeDictionary(unsigned int id)
+{
+	string asset, dictionary;
+	if (!ReadingsCompression::getInstance()->getDictionary(id, asset, dictionary))
+	{
+		return false;
+	}
+	sqlite3_stmt *stmt = getCachedStatement("INSERT OR IGNORE INTO " READINGS_DB "." DICTIONARIES_TABLE
+			" (id, asset_code, dictionary) VALUES (?, ?, ?);");
+	if (!stmt)
+	{
+		raiseError("appendReadings", "Preparing the dictionaries :%s:", sqlite3_errmsg(dbHandle));
+		return false;
+	}
+	sqlite3_bind_int64(stmt, 1, (sqlite3_int64)id);
+	sqlite3_bind_text(stmt, 2, asset.c_str(), -1, SQLITE_STATIC);
+	sqlite3_bind_text(stmt, 3, dictionary.data(), (int)dictionary.length(), SQLITE_STATIC);
+	int rc = SQLstep(stmt);
+	sqlite3_reset(stmt);
+	if (rc != SQLITE_DONE)
+	{
+		raiseError("appendReadings", "Storing the dictionary of %s :%s:", asset.c_str(), sqlite3_errmsg(dbHandle));
+		return false;
+	}
+	return true;
+}
+
+/**
+ * Store the images and data buffers of a reading as binary objects,
+ * within the transaction of the reading, and replace their values in
+ * the JSON of the reading with references to the binary objects.
+ *
+ * @param reading	The JSON of the reading
+ * @param id		The id of the reading
+ * @param dbId		The database of the readings table of the reading
+ * @param tableId	The readings table of the reading
+ * @return bool		False if a binary object could not be stored
+ */
+bool Connection::storeBlobs(string& reading, unsigned long id, int dbId, int tableId)
+{
+	ReadingsBlobs *blobs = ReadingsBlobs::getInstance();
+	vector<BinaryValue> values;
+	ReadingsBlobs::findBinaryValues(reading, blobs->getMinimumSize(), values);
+	if (values.empty())
+	{
+		return true;
+	}
+	sqlite3_stmt *stmt = getCachedStatement("INSERT INTO " READINGS_DB "." BLOBS_TABLE
+			" (reading_id, seq, db_id, table_id, prefix, data) VALUES (?, ?, ?, ?, ?, ?);");
+	if (!stmt)
+	{
+		raiseError("appendReadings", "Preparing the binary objects :%s:", sqlite3_errmsg(dbHandle));
+		return false;
+	}
+
+	string stored;
+	vector<char> data;
+	size_t copied = 0;
+	unsigned int seq = 0;
+	for (auto& value : values)
+	{
+		const char *encoded = reading.data() + value.m_offset + value.m_prefixLength;
+		size_t encodedLength = value.m_length - value.m_prefixLength;
+		size_t length = base64DecodedLength(encoded, encodedLength);
+		if (length == (size_t)-1)
+		{
+			continue;
+		}
+		data.resize(length);
+		if (!base64Decode(encoded, encodedLength, data.data()))
+		{
+			continue;
+		}
+		sqlite3_bind_int64(stmt, 1, (sqlite3_int64)id);
+		sqlite3_bind_int(stmt, 2, seq);
+		sqlite3_bind_int(stmt, 3, dbId);
+		sqlite3_bind_int(stmt, 4, tableId);
+		sqlite3_bind_text(stmt, 5, reading.data() + value.m_offset, value.m_prefixLength, SQLITE_STATIC);
+		sqlite3_bind_blob(stmt, 6, data.data(), length, SQLITE_STATIC);
+		int rc = SQLstep(stmt);
+		sqlite3_reset(stmt);
+		if (rc != SQLITE_DONE)
+		{
+			raiseError("appendReadings", "Writing the binary objects :%s:", sqlite3_errmsg(dbHandle));
+			return false;
+		}
+
+		stored.append(reading, copied, value.m_offset - copied);
+		stored.append(BLOB_REFERENCE + to_string(id) + "." + to_string(seq));
+		copied = value.m_offset + value.m_length;
+		seq++;
+	}
+	if (seq)
+	{
+		stored.append(reading, copied, string::npos);
+		reading.swap(stored);
+		blobs->setStored();
+	}
+	return true;
+}
+
+/**
+ * Replace the references to binary objects in a value returned by a
+ * query with the base64 encoded images and data buffers. A reference
+ * is either the whole value or a string within the JSON of a reading.
+ *
+ * @param text		The value returned
+ * @param expanded	Set to the value with the references replaced
+ * @return bool		False if the value holds no reference
+ */
+bool Connection::expandBlobs(const char *text, string& expanded)
+{
+	const char *copied = text;
+	const char *ref = text;
+	sqlite3_stmt *stmt = NULL;
+
+	expanded.clear();
+	while ((ref = strstr(ref, BLOB_REFERENCE)) != NULL)
+	{
+		unsigned long readingId;
+		unsigned int seq;
+		size_t length;
+		if ((ref != text && ref[-1] != '"')
+				|| !ReadingsBlobs::parseReference(ref, &readingId, &seq, &length))
+		{
+			ref += sizeof(BLOB_REFERENCE) - 1;
+			continue;
+		}
+		if (!stmt)
+		{
+			stmt = getCachedStatement("SELECT prefix, data FROM " READINGS_DB "." BLOBS_TABLE
+					" WHERE reading_id = ? AND seq = ?;");
+			if (!stmt)
+			{
+				raiseError("retrieve", "Preparing the binary objects :%s:", sqlite3_errmsg(dbHandle));
+				break;
+			}
+		}
+		sqlite3_bind_int64(stmt, 1, (sqlite3_int64)readingId);
+		sqlite3_bind_int(stmt, 2, seq);
+		if (SQLstep(stmt) == SQLITE_ROW)
+		{
+			expanded.append(copied, ref - copied);
+			expanded.append((const char *)sqlite3_column_text(stmt, 0), sqlite3_column_bytes(stmt, 0));
+			base64Append(expanded, sqlite3_column_blob(stmt, 1), sqlite3_column_bytes(stmt, 1));
+			copied = ref + length;
+		}
+		sqlite3_reset(stmt);
+		ref += length;
+	}
+	if (copied == text)
+	{
+		return false;
+	}
+	expanded.append(copied);
+	return true;
+}
+
+/**
+ * Delete the binary objects of the readings that have been purged, those
+ * with an id below the lowest id stored by the readings table of their
+ * reading. Called after the purge has refreshed the ranges of the ids
+ * stored in the readings tables.
+ */
+void Connection::purgeBlobs()
+{
+	if (!ReadingsBlobs::getInstance()->isStored())
+	{
+		return;
+	}
+	ReadingsCatalogue *readCat = ReadingsCatalogue::getInstance();
+	vector<pair<int, int>> tables;
+	sqlite3_stmt *stmt;
+	if (sqlite3_prepare_v2(dbHandle, "SELECT DISTINCT db_id, table_id FROM "
+				READINGS_DB "." BLOBS_TABLE ";", -1, &stmt, NULL) != SQLITE_OK)
+	{
+		raiseError("purge", "Finding the binary objects :%s:", sqlite3_errmsg(dbHandle));
+		return;
+	}
+	while (SQLstep(stmt) == SQLITE_ROW)
+	{
+		tables.push_back(make_pair(sqlite3_column_int(stmt, 0), sqlite3_column_int(stmt, 1)));
+	}
+	sqlite3_finalize(stmt);
+
+	if (sqlite3_prepare_v2(dbHandle, "DELETE FROM " READINGS_DB "." BLOBS_TABLE
+				" WHERE db_id = ? AND table_id = ? AND reading_id < ?;", -1, &stmt, NULL) != SQLITE_OK)
+	{
+		raiseError("purge", "Purging the binary objects :%s:", sqlite3_errmsg(dbHandle));
+		return;
+	}
+	unsigned long deleted = 0;
+	for (auto& table : tables)
+	{
+		unsigned long minId = readCat->getMinStoredId(table.first, table.second);
+		if (minId == 0)
+		{
+			continue;
+		}
+		sqlite3_bind_int(stmt, 1, table.first);
+		sqlite3_bind_int(stmt, 2, table.second);
+		sqlite3_bind_int64(stmt, 3, (sqlite3_int64)minId);
+		if (SQLstep(stmt) == SQLITE_DONE)
+		{
+			deleted += sqlite3_changes(dbHandle);
+		}
+		sqlite3_reset(stmt);
+	}
+	sqlite3_finalize(stmt);
+	Logger::getLogger()->debug("Purged %lu binary objects of the readings", deleted);
+}
+#endif
+
+/**
+ * Append a stream of readings to SQLite db
+ *
+ * @param readings  readings to store into the SQLite db
+ * @param commit    if true a database commit is executed and a new transaction will be opened at the next execution
+ *
+ * TODO: the current code should be adapted to use the multi databases/tables implementation
+ *
+ */
+int Connection::readingStream(ReadingStream **readings, bool commit)
+{
+	TRACE_SPAN("storage-plugin", "Connection::readingStream");
+	// Row defintion related
+	int i;
+	bool add_row = false;
+	const char *user_ts;
+	string now;
+	char ts[60], micro_s[10];
+	char formatted_date[LEN_BUFFER_DATE] = {0};
+	struct tm timeinfo;
+	const char *asset_code;
+	const char *payload;
+	const char *readingText = NULL;
+	size_t readingLength = 0;
+	string reading;
+	bool compressionEnabled = ReadingsCompression::getInstance()->isEnabled();
+	set<unsigned int> dictionaries;
+	READING_ROW compressed;
+	bool epochTs = ReadingsTimestamps::getInstance()->isEpoch();
+	int64_t insertTs = ReadingsTimestamps::now();
+	bool rollupEnabled = ReadingsRollup::getInstance()->isEnabled();
+	RollupBatch rollup;
+	bool latestEnabled = LatestReadings::getInstance()->isEnabled();
+	LatestBatch latest;
+
+	// Retry mechanism
+	int retries = 0;
+	int sleep_time_ms = 0;
+
+	// SQLite related
+	sqlite3_stmt *stmt;
+	int sqlite3_resut;
+	int rowNumber = -1;
+
+	ostringstream threadId;
+	threadId << std::this_thread::get_id();
+	ReadingsCatalogue *readCatalogue = ReadingsCatalogue::getInstance();
+
+	{
+		// Attaches the needed databases if the queue is not empty
+		AttachDbSync *attachSync = AttachDbSync::getInstance();
+		attachSync->lock();
+
+		if ( ! m_NewDbIdList.empty())
+		{
+			readCatalogue->connectionAttachDbList(this->getDbHandle(), m_NewDbIdList);
+		}
+		attachSync->unlock();
+	}
+
+#if INSTRUMENT
+	struct timeval start, t1, t2, t3, t4, t5;
+#endif
+
+	// * TODO: the current code should be adapted to use the multi databases/tables implementation
+	const char *sql_cmd = epochTs
+		? "INSERT INTO  " READINGS_DB ".readings_1 ( asset_code, reading, user_ts, ts ) VALUES  (?,?,?,?)"
+		: "INSERT INTO  " READINGS_DB ".readings_1 ( asset_code, reading, user_ts ) VALUES  (?,?,?)";
+
+	checkStatementCache();
+	if ((stmt = getCachedStatement(sql_cmd)) == NULL)
+	{
+		raiseError("readingStream", sqlite3_errmsg(dbHandle));
+		return -1;
+	}
+
+	// The handling of the commit parameter is overridden as using a pool of connections every execution receives
+	// a differen one, so a commit at every run is executed.
+	m_streamOpenTransaction = true;
+	commit = true;
+
+	if (m_streamOpenTransaction)
+	{
+		if (sqlite3_exec(dbHandle, "BEGIN TRANSACTION", NULL, NULL, NULL) != SQLITE_OK)
+		{
+			raiseError("readingStream", sqlite3_errmsg(dbHandle));
+			return -1;
+		}
+		m_streamOpenTransaction = false;
+	}
+
+#if INSTRUMENT
+	gettimeofday(&start, NULL);
+#endif
+
+	try
+	{
+		for (i = 0; readings[i]; i++)
+		{
+			add_row = true;
+
+			// Handles - asset_code
+			asset_code = RDS_ASSET_CODE(readings, i);
+
+			// Handles - reading
+			payload = RDS_PAYLOAD(readings, i);
+			if (readings[i]->payloadFormat == RDS_PAYLOAD_BINARY)
+			{
+				// Write the JSON for the reading column directly from the binary datapoints
+				if (!ReadingStreamPayload::toJSON(payload, readings[i]->payloadLength, reading))
+				{
+					raiseError("readingStream", "Unable to decode binary payload for asset %s", asset_code);
+					add_row = false;
+				}
+				if (reading.find('\'') != string::npos)
+				{
+					reading = escape(reading);
+				}
+				readingText = reading.data();
+				readingLength = reading.length();
+			}
+			else
+			{
+				// Bind directly against the stream buffer unless escaping is required
+				readingLength = strnlen(payload, readings[i]->payloadLength);
+				if (memchr(payload, '\'', readingLength))
+				{
+					reading = escape(string(payload, readingLength));
+					readingText = reading.data();
+					readingLength = reading.length();
+				}
+				else
+				{
+					readingText = payload;
+				}
+			}
+
+			// Handles - user_ts
+			memset(&timeinfo, 0, sizeof(struct tm));
+			gmtime_r(&RDS_USER_TIMESTAMP(readings, i).tv_sec, &timeinfo);
+			std::strftime(ts, sizeof(ts), "%Y-%m-%d %H:%M:%S", &timeinfo);
+			snprintf(micro_s, sizeof(micro_s), ".%06lu", RDS_USER_TIMESTAMP(readings, i).tv_usec);
+
+			formatted_date[0] = {0};
+			strncat(ts, micro_s, 10);
+			user_ts = ts;
+			if (strcmp(user_ts, "now()") == 0)
+			{
+				getNow(now);
+				user_ts = now.c_str();
+			}
+			else
+			{
+				if (!formatDate(formatted_date, sizeof(formatted_date), user_ts))
+				{
+					raiseError("appendReadings", "Invalid date |%s|", user_ts);
+					add_row = false;
+				}
+				else
+				{
+					user_ts = formatted_date;
+				}
+			}
+
+			if (add_row)
+			{
+				if (compressionEnabled)
+				{
+					compressed.reading.assign(readingText, readingLength);
+					if (!compressReading(asset_code, compressed, dictionaries))
+					{
+						sqlite3_exec(dbHandle, "ROLLBACK TRANSACTION", NULL, NULL, NULL);
+						m_streamOpenTransaction = true;
+						return -1;
+					}
+				}
+				if (stmt != NULL)
+				{
+					sqlite3_bind_text(stmt, 1, asset_code,      -1, SQLITE_STATIC);
+					if (compressionEnabled && compressed.compressed)
+						sqlite3_bind_blob(stmt, 2, compressed.reading.data(), (int)compressed.reading.length(), SQLITE_STATIC);
+					else
+						sqlite3_bind_text(stmt, 2, readingText,     (int)readingLength, SQLITE_STATIC);
+					if (epochTs)
+					{
+						sqlite3_bind_int64(stmt, 3, (sqlite3_int64)RDS_USER_TIMESTAMP(readings, i).tv_sec * 1000000
+								+ RDS_USER_TIMESTAMP(readings, i).tv_usec);
+						sqlite3_bind_int64(stmt, 4, insertTs);
+					}
+					else
+					{
+						sqlite3_bind_text(stmt, 3, user_ts,         -1, SQLITE_STATIC);
+					}
+
+					retries =0;
+					sleep_time_ms = 0;
+
+					// Retry mechanism in case SQLlite DB is locked
+					do {
+						// Insert the row using a lock to ensure one insert at time
+						{
+							m_writeAccessOngoing.fetch_add(1);
+							//unique_lock<mutex> lck(db_mutex);
+
+							sqlite3_resut = sqlite3_step(stmt);
+
+							m_writeAccessOngoing.fetch_sub(1);
+							//db_cv.notify_all();
+						}
+
+						if (sqlite3_resut == SQLITE_LOCKED  )
+						{
+							sleep_time_ms = PREP_CMD_RETRY_BASE + (random() %  PREP_CMD_RETRY_BACKOFF);
+							retries++;
+
+							Logger::getLogger()->info("SQLITE_LOCKED - record :%d: - retry number :%d: sleep time ms :%d:",i, retries, sleep_time_ms);
+
+							std::this_thread::sleep_for(std::chrono::milliseconds(sleep_time_ms));
+						}
 						if (sqlite3_resut == SQLITE_BUSY)
 						{
 							ostringstream threadId;
@@ -557,14 +1508,28 @@ int Connection::readingStream(ReadingStream **readings, bool commit)
 
 						sqlite3_clear_bindings(stmt);
 						sqlite3_reset(stmt);
+
+						if (rollupEnabled || latestEnabled)
+						{
+							Document datapoints;
+							datapoints.Parse(readingText, readingLength);
+							if (rollupEnabled)
+							{
+								rollup.add(asset_code, user_ts, datapoints);
+							}
+							if (latestEnabled)
+							{
+								latest.add(asset_code, user_ts, datapoints);
+							}
+						}
 					}
 					else
 					{
 						raiseError("appendReadings",
-								   "Inserting a row into SQLIte using a prepared command - asset_code :%s: error :%s: reading :%s: ",
+								   "Inserting a row into SQLIte using a prepared command - asset_code :%s: error :%s: reading :%.*s: ",
 								   asset_code,
 								   sqlite3_errmsg(dbHandle),
-								   reading.c_str());
+								   (int)readingLength, readingText);
 
 						sqlite3_exec(dbHandle, "ROLLBACK TRANSACTION", NULL, NULL, NULL);
 						m_streamOpenTransaction = true;
@@ -584,6 +1549,13 @@ int Connection::readingStream(ReadingStream **readings, bool commit)
 		return -1;
 	}
 
+	if (!writeRollup(rollup) || !writeLatest(latest))
+	{
+		sqlite3_exec(dbHandle, "ROLLBACK TRANSACTION", NULL, NULL, NULL);
+		m_streamOpenTransaction = true;
+		return -1;
+	}
+
 #if INSTRUMENT
 	gettimeofday(&t1, NULL);
 #endif
@@ -596,15 +1568,12 @@ int Connection::readingStream(ReadingStream **readings, bool commit)
 			raiseError("appendReadings", "Executing the commit of the transaction - error :%s:", sqlite3_errmsg(dbHandle));
 			rowNumber = -1;
 		}
-		m_streamOpenTransaction = true;
-	}
-
-	if(stmt != NULL)
-	{
-		if (sqlite3_finalize(stmt) != SQLITE_OK)
+		else if (!m_latest.empty())
 		{
-			raiseError("appendReadings","freeing SQLite in memory structure - error :%s:", sqlite3_errmsg(dbHandle));
+			LatestReadings::getInstance()->update(m_latest);
 		}
+		m_latest.clear();
+		m_streamOpenTransaction = true;
 	}
 
 #if INSTRUMENT
@@ -641,6 +1610,21 @@ void Connection::setUsedDbId(int dbId) {
 	m_NewDbIdList.push_back(dbId);
 }
 
+/**
+ * Attach the databases created since the connection was last used
+ */
+void Connection::attachPendingDbs()
+{
+	AttachDbSync *attachSync = AttachDbSync::getInstance();
+	attachSync->lock();
+
+	if ( ! m_NewDbIdList.empty())
+	{
+		ReadingsCatalogue::getInstance()->connectionAttachDbList(this->getDbHandle(), m_NewDbIdList);
+	}
+	attachSync->unlock();
+}
+
 /**
  * Wait until all the threads executing the appendReadings are shutted down
  */
@@ -663,36 +1647,218 @@ void  Connection::shutdownAppendReadings() {
 
 #ifndef SQLITE_SPLIT_READINGS
 /**
- * Append a set of readings to the readings table
+ * Insert a set of rows into a readings table. Complete groups of
+ * rowsPerInsert rows are inserted with a single multi-row INSERT
+ * statement, any remaining rows are inserted one at a time.
+ *
+ * @param table		The qualified name of the readings table
+ * @param rows		The rows to insert
+ * @param rowsPerInsert	The number of rows in a multi-row INSERT
+ * @return bool		True if all the rows were inserted
  */
-int Connection::appendReadings(const char *readings)
+bool Connection::insertReadingRows(const string& table, vector<READING_ROW>& rows, unsigned int rowsPerInsert)
 {
-// Default template parameter uses UTF8 and MemoryPoolAllocator.
-Document doc;
-int      row = 0, readingId;
-bool     add_row = false;
+	size_t offset = 0;
+	bool epochTs = ReadingsTimestamps::getInstance()->isEpoch();
+	int64_t insertTs = epochTs ? ReadingsTimestamps::now() : 0;
 
-int lastReadingsId;
+	while (offset < rows.size())
+	{
+		unsigned int nRows = 1;
+		if (rowsPerInsert > 1 && rows.size() - offset >= rowsPerInsert)
+		{
+			nRows = rowsPerInsert;
+		}
 
-// Variables related to the SQLite insert using prepared command
-const char   *user_ts;
-const char   *asset_code;
-string        reading,
-              msg;
-sqlite3_stmt *stmt;
-int rc;
-int           sqlite3_resut;
-int           readingsId;
-string        now;
+		// Integer timestamps are stored with the time of the insert, the
+		// default of the ts column is text
+		string sql_cmd, values;
+		unsigned int nColumns;
+		if (epochTs)
+		{
+			sql_cmd = "INSERT INTO  " + table + " ( id, user_ts, ts, reading ) VALUES  (?,?,?,?)";
+			values = ",(?,?,?,?)";
+			nColumns = 4;
+		}
+		else
+		{
+			sql_cmd = "INSERT INTO  " + table + " ( id, user_ts, reading ) VALUES  (?,?,?)";
+			values = ",(?,?,?)";
+			nColumns = 3;
+		}
+		for (unsigned int i = 1; i < nRows; i++)
+		{
+			sql_cmd += values;
+		}
+		sqlite3_stmt *stmt = getCachedStatement(sql_cmd);
+		if (stmt == NULL)
+		{
+			raiseError("appendReadings", sqlite3_errmsg(dbHandle));
+			return false;
+		}
+
+		for (unsigned int i = 0; i < nRows; i++)
+		{
+			READING_ROW& row = rows[offset + i];
+			int column = i * nColumns;
+			sqlite3_bind_int64(stmt, ++column, (sqlite3_int64)row.id);
+			if (epochTs)
+			{
+				sqlite3_bind_int64(stmt, ++column, (sqlite3_int64)row.epochTs);
+				sqlite3_bind_int64(stmt, ++column, (sqlite3_int64)insertTs);
+			}
+			else
+			{
+				sqlite3_bind_text(stmt, ++column, row.userTs.c_str(), -1, SQLITE_STATIC);
+			}
+			if (row.compressed)
+				sqlite3_bind_blob(stmt, ++column, row.reading.data(), (int)row.reading.length(), SQLITE_STATIC);
+			else
+				sqlite3_bind_text(stmt, ++column, row.reading.c_str(), -1, SQLITE_STATIC);
+		}
+
+		int retries = 0;
+		int sqlite3_resut;
+
+		// Retry mechanism in case SQLlite DB is locked
+		do {
+			sqlite3_resut = sqlite3_step(stmt);
+
+			if (sqlite3_resut != SQLITE_DONE)
+			{
+				string msgError;
+				if (sqlite3_resut == SQLITE_LOCKED)
+				{
+					msgError = "SQLITE_LOCKED";
+				}
+				else if (sqlite3_resut == SQLITE_BUSY)
+				{
+					msgError = "SQLITE_BUSY";
+				}
+				else
+				{
+					msgError = "SQLITE_ERROR";
+				}
+
+				int sleep_time_ms = PREP_CMD_RETRY_BASE + (random() %  PREP_CMD_RETRY_BACKOFF);
+				retries++;
+
+				if (retries >= LOG_AFTER_NERRORS)
+				{
+					Logger::getLogger()->warn("appendReadings - %s - " \
+							"table :%s: dbHandle :%X: rows :%u: " \
+							"retry number :%d: sleep time ms :%d: error :%s:",
+							msgError.c_str(),
+							table.c_str(),
+							dbHandle,
+							nRows,
+							retries,
+							sleep_time_ms,
+							sqlite3_errmsg(dbHandle));
+				}
+
+				// Put thread to sleep
+				std::this_thread::sleep_for(std::chrono::milliseconds(sleep_time_ms));
+				sqlite3_reset(stmt);
+			}
+		} while (retries < PREP_CMD_MAX_RETRIES && (sqlite3_resut != SQLITE_DONE));
+
+		if (sqlite3_resut != SQLITE_DONE)
+		{
+			raiseError("appendReadings","Inserting into " \
+				"SQLIte using a prepared command - table " \
+				":%s: error :%s: reading :%s: dbHandle :%X:",
+				table.c_str(),
+				sqlite3_errmsg(dbHandle),
+				rows[offset].reading.c_str(),
+				dbHandle);
+			sqlite3_reset(stmt);
+			return false;
+		}
+		sqlite3_reset(stmt);
+		offset += nRows;
+	}
+	if (!rows.empty())
+	{
+		ReadingsCatalogue::getInstance()->extendIdRange(table, rows.front().id, rows.back().id);
+	}
+	return true;
+}
+
+/**
+ * Commit the readings transaction and, when adaptive transaction
+ * sizing is enabled, report the size of the WAL files of the
+ * databases that have been written to.
+ *
+ * @param dbNames	The databases written to by the transaction
+ * @return bool		True if the transaction was committed
+ */
+bool Connection::commitReadings(const set<string>& dbNames)
+{
+	if (sqlite3_exec(dbHandle, "END TRANSACTION", NULL, NULL, NULL) != SQLITE_OK)
+	{
+		raiseError("appendReadings",
+				"Executing the commit of the transaction :%s:",
+				sqlite3_errmsg(dbHandle));
+		m_latest.clear();
+		return false;
+	}
+
+	if (!m_latest.empty())
+	{
+		LatestReadings::getInstance()->update(m_latest);
+		m_latest.clear();
+	}
+
+	InsertConfiguration *insertConfig = InsertConfiguration::getInstance();
+	if (insertConfig->isAdaptive())
+	{
+		unsigned long walSize = 0;
+		for (auto& dbName : dbNames)
+		{
+			const char *file = sqlite3_db_filename(dbHandle, dbName.c_str());
+			struct stat st;
+			if (file && *file && stat((string(file) + "-wal").c_str(), &st) == 0
+					&& (unsigned long)st.st_size > walSize)
+			{
+				walSize = st.st_size;
+			}
+		}
+		insertConfig->walSize(walSize);
+	}
+	return true;
+}
+
+/**
+ * Abandon a call to appendReadings that has failed part way through,
+ * rolling back the current transaction.
+ *
+ * @param tid	The thread performing the append
+ */
+void Connection::appendFailed(std::thread::id tid)
+{
+	sqlite3_exec(dbHandle, "ROLLBACK TRANSACTION", NULL, NULL, NULL);
+	m_latest.clear();
+	m_appendCount--;
 
-std::pair<int, sqlite3_stmt *> pairValue;
-string lastAsset;
+	// Clear transaction boundary for this thread
+	ReadingsCatalogue::getInstance()->m_tx.ClearThreadTransaction(tid);
+	m_writeAccessOngoing.fetch_sub(1);
+}
 
-// Retry mechanism
-int retries = 0;
-int sleep_time_ms = 0;
+/**
+ * Append a set of readings to the readings table
+ *
+ * When the group commit is enabled the readings are parsed here and then
+ * inserted by the readings writer thread, together with the readings of
+ * the other callers, the call returns once they have been committed.
+ */
+int Connection::appendReadings(const char *readings)
+{
+	TRACE_SPAN("storage-plugin", "Connection::appendReadings");
+ReadingsPayload payload;
+int      row = 0;
 
-int stmtArraySize;
 std::thread::id tid = std::this_thread::get_id();
 ostringstream threadId;
 
@@ -712,6 +1878,32 @@ ostringstream threadId;
 
 	ReadingsCatalogue *readCatalogue = ReadingsCatalogue::getInstance();
 
+#if INSTRUMENT
+	Logger::getLogger()->debug("appendReadings start thread :%s:", threadId.str().c_str());
+
+	struct timeval	start, t1, t2, t3, t4, t5;
+#endif
+
+#if INSTRUMENT
+	gettimeofday(&start, NULL);
+#endif
+
+	if (!payload.parse(readings))
+	{
+		raiseError("appendReadings", payload.getError().c_str());
+		m_appendCount--;
+		return -1;
+	}
+	const vector<APPEND_READING>& readingsValue = payload.getReadings();
+
+	ReadingsWriter *writer = ReadingsWriter::getInstance();
+	if (writer->isRunning())
+	{
+		row = writer->append(this, readingsValue);
+		m_appendCount--;
+		return row;
+	}
+
 	{
 		// Attaches the needed databases if the queue is not empty
 		AttachDbSync *attachSync = AttachDbSync::getInstance();
@@ -724,69 +1916,189 @@ ostringstream threadId;
 		attachSync->unlock();
 	}
 
-	stmtArraySize = readCatalogue->getReadingPosition(0, 0);
-	vector<sqlite3_stmt *> readingsStmt(stmtArraySize + 1, nullptr);
+	checkStatementCache();
 
-#if INSTRUMENT
-	Logger::getLogger()->debug("appendReadings start thread :%s:", threadId.str().c_str());
+	bool boundarySet = false;
+	set<string> dbNames;
 
-	struct timeval	start, t1, t2, t3, t4, t5;
-#endif
+	{
+	m_writeAccessOngoing.fetch_add(1);
+	//unique_lock<mutex> lck(db_mutex);
+	sqlite3_exec(dbHandle, "BEGIN TRANSACTION", NULL, NULL, NULL);
 
 #if INSTRUMENT
-	gettimeofday(&start, NULL);
+		gettimeofday(&t1, NULL);
 #endif
 
-	ParseResult ok = doc.Parse(readings);
-	if (!ok)
+	row = insertReadings(readingsValue, dbNames, boundarySet);
+	if (row < 0)
 	{
- 		raiseError("appendReadings", GetParseError_En(doc.GetParseError()));
-		m_appendCount--;
+		appendFailed(tid);
 		return -1;
 	}
 
-	if (!doc.HasMember("readings"))
+	if (!commitReadings(dbNames))
 	{
- 		raiseError("appendReadings", "Payload is missing a readings array");
-		m_appendCount--;
-		return -1;
+		row = -1;
 	}
-	Value &readingsValue = doc["readings"];
-	if (!readingsValue.IsArray())
-	{
-		raiseError("appendReadings", "Payload is missing the readings array");
-		m_appendCount--;
-		return -1;
+
+	// Clear transaction boundary for this thread
+	readCatalogue->m_tx.ClearThreadTransaction(tid);
+
+	m_writeAccessOngoing.fetch_sub(1);
+	//db_cv.notify_all();
 	}
+#if INSTRUMENT
+		gettimeofday(&t2, NULL);
+#endif
+
+
+#if INSTRUMENT
+		gettimeofday(&t3, NULL);
+#endif
+
+#if INSTRUMENT
+		struct timeval tm;
+		double timeT1, timeT2, timeT3;
+
+		timersub(&t1, &start, &tm);
+		timeT1 = tm.tv_sec + ((double)tm.tv_usec / 1000000);
+
+		timersub(&t2, &t1, &tm);
+		timeT2 = tm.tv_sec + ((double)tm.tv_usec / 1000000);
+
+		timersub(&t3, &t2, &tm);
+		timeT3 = tm.tv_sec + ((double)tm.tv_usec / 1000000);
+
+		Logger::getLogger()->debug("appendReadings end   thread :%s: buffer :%10lu: count :%5d: JSON :%6.3f: inserts :%6.3f: finalize :%6.3f:",
+								   threadId.str().c_str(),
+								   strlen(readings),
+								   row,
+								   timeT1,
+								   timeT2,
+								   timeT3
+		);
+
+#endif
+
+	m_appendCount--;
+
+	return row;
+}
+
+/**
+ * Insert a group of blocks of readings, queued by the readings writer,
+ * in a single transaction. Each block is inserted within a savepoint so
+ * that a block that fails is rolled back without affecting the others,
+ * the result of each block is set once the transaction is committed.
+ *
+ * @param requests	The blocks of readings to insert
+ */
+void Connection::appendReadingsGroup(vector<AppendRequest *>& requests)
+{
+std::thread::id tid = std::this_thread::get_id();
 
-	int tableIdx;
-	string sql_cmd;
+	ReadingsCatalogue *readCatalogue = ReadingsCatalogue::getInstance();
 
 	{
+		// Attaches the needed databases if the queue is not empty
+		AttachDbSync *attachSync = AttachDbSync::getInstance();
+		attachSync->lock();
+
+		if ( ! m_NewDbIdList.empty())
+		{
+			readCatalogue->connectionAttachDbList(this->getDbHandle(), m_NewDbIdList);
+		}
+		attachSync->unlock();
+	}
+
+	checkStatementCache();
+
+	bool boundarySet = false;
+	set<string> dbNames;
+
 	m_writeAccessOngoing.fetch_add(1);
-	//unique_lock<mutex> lck(db_mutex);
 	sqlite3_exec(dbHandle, "BEGIN TRANSACTION", NULL, NULL, NULL);
 
-#if INSTRUMENT
-		gettimeofday(&t1, NULL);
-#endif
+	for (auto request : requests)
+	{
+		sqlite3_exec(dbHandle, "SAVEPOINT append", NULL, NULL, NULL);
+		request->rows = insertReadings(*request->readings, dbNames, boundarySet);
+		if (request->rows < 0)
+		{
+			sqlite3_exec(dbHandle, "ROLLBACK TO append", NULL, NULL, NULL);
+		}
+		sqlite3_exec(dbHandle, "RELEASE append", NULL, NULL, NULL);
+	}
 
-	lastAsset = "";
-	for (Value::ConstValueIterator itr = readingsValue.Begin(); itr != readingsValue.End(); ++itr)
+	if (!commitReadings(dbNames))
 	{
-		if (!itr->IsObject())
+		sqlite3_exec(dbHandle, "ROLLBACK TRANSACTION", NULL, NULL, NULL);
+		m_latest.clear();
+		for (auto request : requests)
 		{
-			raiseError("appendReadings","Each reading in the readings array must be an object");
-			sqlite3_exec(dbHandle, "ROLLBACK TRANSACTION;", NULL, NULL, NULL);
-			m_appendCount--;
-			return -1;
+			request->rows = -1;
 		}
+	}
+
+	// Clear transaction boundary for this thread
+	readCatalogue->m_tx.ClearThreadTransaction(tid);
+
+	m_writeAccessOngoing.fetch_sub(1);
+}
 
+/**
+ * Insert the readings of an append within the transaction opened by the
+ * caller. The readings are never committed here, so that a block that
+ * fails part way through is rolled back whole by the caller and may be
+ * sent again without storing any of its readings twice.
+ *
+ * @param readingsValue	The readings to insert
+ * @param dbNames	Updated with the databases written to
+ * @param boundarySet	True if the transaction boundary of the thread is set, updated
+ * @return int		The number of readings inserted, -1 on failure
+ */
+int Connection::insertReadings(const vector<APPEND_READING>& readingsValue, set<string>& dbNames, bool& boundarySet)
+{
+int      row = 0;
+bool     add_row = false;
+
+// Variables related to the SQLite insert using prepared command
+const char   *user_ts;
+const char   *asset_code;
+int           readingsId;
+int           dbId = 0;
+string        now;
+
+string lastAsset;
+
+std::thread::id tid = std::this_thread::get_id();
+
+	ReadingsCatalogue *readCatalogue = ReadingsCatalogue::getInstance();
+	InsertConfiguration *insertConfig = InsertConfiguration::getInstance();
+	unsigned int rowsPerInsert = insertConfig->getRowsPerInsert();
+	vector<READING_ROW> pending;
+	string pendingTable;
+	string table;
+	bool rollupEnabled = ReadingsRollup::getInstance()->isEnabled();
+	RollupBatch rollup;
+	bool latestEnabled = LatestReadings::getInstance()->isEnabled();
+	LatestBatch latest;
+	bool blobsEnabled = ReadingsBlobs::getInstance()->isEnabled();
+	bool compressionEnabled = ReadingsCompression::getInstance()->isEnabled();
+	set<unsigned int> dictionaries;	// Stored by this transaction
+	bool epochTs = ReadingsTimestamps::getInstance()->isEpoch();
+
+	pending.reserve(rowsPerInsert);
+
+	lastAsset = "";
+	for (auto& appended : readingsValue)
+	{
 		add_row = true;
 
 		// Handles - user_ts
 		char formatted_date[LEN_BUFFER_DATE] = {0};
-		user_ts = (*itr)["user_ts"].GetString();
+		user_ts = appended.userTs;
 		if (strcmp(user_ts, "now()") == 0)
 		{
 			getNow(now);
@@ -804,11 +2116,17 @@ ostringstream threadId;
 				user_ts = formatted_date;
 			}
 		}
+		int64_t epoch = 0;
+		if (add_row && epochTs && !ReadingsTimestamps::toEpoch(user_ts, &epoch))
+		{
+			raiseError("appendReadings", "Invalid date |%s|", user_ts);
+			add_row = false;
+		}
 
 		if (add_row)
 		{
 			// Handles - asset_code
-			asset_code = (*itr)["asset_code"].GetString();
+			asset_code = appended.assetCode;
 
 			//# A different asset is managed respect the previous one
 			if (lastAsset.compare(asset_code)!= 0)
@@ -817,227 +2135,108 @@ ostringstream threadId;
 
 				ref = readCatalogue->getReadingReference(this, asset_code);
 				readingsId = ref.tableId;
+				dbId = ref.dbId;
 
 				Logger::getLogger()->debug("tyReadingReference :%s: :%d: :%d: ", asset_code, ref.dbId, ref.tableId);
 
 				if (readingsId == -1)
 				{
 					Logger::getLogger()->warn("appendReadings - It was not possible to insert the row for the asset_code :%s: into the readings, row ignored.", asset_code);
-					stmt = NULL;
+					table.clear();
 				}
 				else
 				{
-					int nReadings, idxReadings;
+					string dbName = readCatalogue->generateDbName(ref.dbId);
+					table = dbName + "." + readCatalogue->generateReadingsName(ref.dbId, readingsId);
+					dbNames.insert(dbName);
 
-					nReadings = readCatalogue->getReadingsCount();
-					idxReadings = readCatalogue->getReadingPosition(ref.dbId, ref.tableId);
-
-					Logger::getLogger()->debug("tyReadingReference :%s: :%d: :%d: idxReadings :%d:", asset_code, ref.dbId, ref.tableId, idxReadings);
+					lastAsset = asset_code;
+				}
+			}
 
-					if (idxReadings >= stmtArraySize)
+			if (!table.empty())
+			{
+				// Rows are only batched for a single table
+				if (table.compare(pendingTable) != 0)
+				{
+					if (!insertReadingRows(pendingTable, pending, rowsPerInsert))
 					{
-						stmtArraySize = idxReadings + 1;
-						readingsStmt.resize(stmtArraySize, nullptr);
-
-						Logger::getLogger()->debug("appendReadings: thread :%s: resize size :%d: idx :%d: ", threadId.str().c_str(), stmtArraySize, readingsId);
+						return -1;
 					}
+					row += pending.size();
+					pending.clear();
+					pendingTable = table;
+				}
 
-					if (readingsStmt[idxReadings] == nullptr)
+				// Handles - reading, already the compact JSON of the datapoints
+				READING_ROW newRow;
+				newRow.id = readCatalogue->getIncGlobalId();
+				if (!boundarySet)
+				{
+					// First reading of the transaction, use the id as transaction start
+					readCatalogue->m_tx.SetThreadTransactionStart(tid, newRow.id);
+					boundarySet = true;
+				}
+				newRow.userTs = user_ts;
+				newRow.epochTs = epoch;
+				if (blobsEnabled)
+				{
+					string reading(appended.reading, appended.readingLength);
+					if (!storeBlobs(reading, newRow.id, dbId, readingsId))
 					{
-						string dbName = readCatalogue->generateDbName(ref.dbId);
-						string dbReadingsName = readCatalogue->generateReadingsName(ref.dbId, readingsId);
-
-						sql_cmd = "INSERT INTO  " + dbName + "." + dbReadingsName + " ( id, user_ts, reading ) VALUES  (?,?,?)";
-						rc = SQLPrepare(dbHandle, sql_cmd.c_str(), &readingsStmt[idxReadings]);
-
-						Logger::getLogger()->debug("tyReadingReference sql_cmd  :%s: :%s: :%d: :%d: ", sql_cmd.c_str(), asset_code, ref.dbId, ref.tableId);
-
-						if (rc != SQLITE_OK)
-						{
-							raiseError("appendReadings", sqlite3_errmsg(dbHandle));
-						}
+						return -1;
 					}
-					stmt = readingsStmt[idxReadings];
-
-					lastAsset = asset_code;
+					newRow.reading = escape(reading);
 				}
-			}
-
-			// Handles - reading
-			StringBuffer buffer;
-			Writer<StringBuffer> writer(buffer);
-			(*itr)["reading"].Accept(writer);
-			reading = escape(buffer.GetString());
-
-			if(stmt != NULL) {
-				// First reading, use the id as transaction start
-				if (itr == readingsValue.Begin())
+				else
 				{
-					// Get current reading global id
-					unsigned long startTransactionId = readCatalogue->getIncGlobalId();
-
-					// Mark transaction srtart fot this thread
-					readCatalogue->m_tx.SetThreadTransactionStart(tid,
-							startTransactionId);
-
-					// Bind first parameter with reading id
-					sqlite3_bind_int (stmt, 1, startTransactionId);
+					newRow.reading = escape(appended.reading);
 				}
-				else
+				newRow.compressed = false;
+				if (compressionEnabled && !compressReading(asset_code, newRow, dictionaries))
 				{
-					// Bind first parameter with reading id
-					sqlite3_bind_int (stmt, 1, readCatalogue->getIncGlobalId());
+					return -1;
 				}
-
-				// Set parameter for user timestamp
-				sqlite3_bind_text(stmt, 2, user_ts         ,-1, SQLITE_STATIC);
-
-				// Set parameter for reading JSON data
-				sqlite3_bind_text(stmt, 3, reading.c_str(), -1, SQLITE_STATIC);
-
-				retries =0;
-				sleep_time_ms = 0;
-
-				string msgError;
-
-				// Retry mechanism in case SQLlite DB is locked
-				do {
-					// Insert the row using a lock to ensure one insert at time
+				pending.push_back(newRow);
+				if (rollupEnabled || latestEnabled)
+				{
+					// Only the rollup and latest values need the datapoints
+					Document reading;
+					reading.Parse(appended.reading, appended.readingLength);
+					if (rollupEnabled)
 					{
-						sqlite3_resut = sqlite3_step(stmt);
+						rollup.add(asset_code, user_ts, reading);
 					}
-
-					if(sqlite3_resut != SQLITE_DONE)
+					if (latestEnabled)
 					{
-						msgError = "";
-						if (sqlite3_resut == SQLITE_LOCKED  )
-						{
-							msgError = "SQLITE_LOCKED";
-
-						} else if (sqlite3_resut == SQLITE_BUSY)
-						{
-							msgError = "SQLITE_BUSY";
-
-						} else if (sqlite3_resut  != SQLITE_DONE)
-						{
-							msgError = "SQLITE_ERROR";
-						}
-
-						sleep_time_ms = PREP_CMD_RETRY_BASE + (random() %  PREP_CMD_RETRY_BACKOFF);
-						retries++;
-
-						if (retries >= LOG_AFTER_NERRORS)
-						{
-							Logger::getLogger()->warn("appendReadings - %s - " \
-									"asset_code :%s: readingsId :%d: " \
-									"thread :%s: dbHandle :%X: record " \
-									":%d: retry number :%d: sleep time ms :%d:error :%s:",
-									msgError.c_str(),
-									asset_code,
-									readingsId,
-									threadId.str().c_str() ,
-									dbHandle,
-									row,
-									retries,
-									sleep_time_ms,
-									sqlite3_errmsg(dbHandle));
-						}
-
-						// Put thread to sleep
-						std::this_thread::sleep_for(std::chrono::milliseconds(sleep_time_ms));
+						latest.add(asset_code, user_ts, reading);
 					}
-				} while (retries < PREP_CMD_MAX_RETRIES && (sqlite3_resut != SQLITE_DONE));
-
-				if (sqlite3_resut == SQLITE_DONE)
-				{
-					row++;
-
-					sqlite3_clear_bindings(stmt);
-					sqlite3_reset(stmt);
 				}
-				else
-				{
-					raiseError("appendReadings","Inserting a row into " \
-						"SQLIte using a prepared command - asset_code " \
-						":%s: error :%s: reading :%s: dbHandle :%X:",
-						asset_code,
-						sqlite3_errmsg(dbHandle),
-						reading.c_str(),
-						dbHandle);
 
-					sqlite3_exec(dbHandle, "ROLLBACK TRANSACTION", NULL, NULL, NULL);
-					m_appendCount--;
-
-					// Clear transaction boundary for this thread
-					readCatalogue->m_tx.ClearThreadTransaction(tid);
-					return -1;
+				if (pending.size() >= rowsPerInsert)
+				{
+					if (!insertReadingRows(pendingTable, pending, rowsPerInsert))
+					{
+						return -1;
+					}
+					row += pending.size();
+					pending.clear();
 				}
-			}
-		}
-	}
-
-	sqlite3_resut = sqlite3_exec(dbHandle, "END TRANSACTION", NULL, NULL, NULL);
-	if (sqlite3_resut != SQLITE_OK)
-	{
-		raiseError("appendReadings",
-				"Executing the commit of the transaction :%s:",
-				sqlite3_errmsg(dbHandle));
-		row = -1;
-	}
-
-	// Clear transaction boundary for this thread
-	readCatalogue->m_tx.ClearThreadTransaction(tid);
-
-	m_writeAccessOngoing.fetch_sub(1);
-	//db_cv.notify_all();
-	}
-#if INSTRUMENT
-		gettimeofday(&t2, NULL);
-#endif
-
-	// Finalize sqlite structures
-	for (auto &item : readingsStmt)
-	{
-		if(item != nullptr)
-		{
-
-			if (sqlite3_finalize(item) != SQLITE_OK)
-			{
-				raiseError("appendReadings","freeing SQLite in memory structure - error :%s:", sqlite3_errmsg(dbHandle));
-			}
-		}
-
-	}
-
-#if INSTRUMENT
-		gettimeofday(&t3, NULL);
-#endif
-
-#if INSTRUMENT
-		struct timeval tm;
-		double timeT1, timeT2, timeT3;
-
-		timersub(&t1, &start, &tm);
-		timeT1 = tm.tv_sec + ((double)tm.tv_usec / 1000000);
-
-		timersub(&t2, &t1, &tm);
-		timeT2 = tm.tv_sec + ((double)tm.tv_usec / 1000000);
-
-		timersub(&t3, &t2, &tm);
-		timeT3 = tm.tv_sec + ((double)tm.tv_usec / 1000000);
 
-		Logger::getLogger()->debug("appendReadings end   thread :%s: buffer :%10lu: count :%5d: JSON :%6.3f: inserts :%6.3f: finalize :%6.3f:",
-								   threadId.str().c_str(),
-								   strlen(readings),
-								   row,
-								   timeT1,
-								   timeT2,
-								   timeT3
-		);
+			}
+		}
+	}
 
-#endif
+	if (!insertReadingRows(pendingTable, pending, rowsPerInsert))
+	{
+		return -1;
+	}
+	row += pending.size();
 
-	m_appendCount--;
+	if (!writeRollup(rollup) || !writeLatest(latest))
+	{
+		return -1;
+	}
 
 	return row;
 }
@@ -1059,6 +2258,268 @@ ostringstream threadId;
 bool Connection::fetchReadings(unsigned long id,
 			       unsigned int blksize,
 			       std::string& resultSet)
+{
+	TRACE_SPAN("storage-plugin", "Connection::fetchReadings");
+	return fetchReadingRows(id, blksize, resultSet, false, NULL);
+}
+
+/**
+ * Fetch a block of readings from the reading table in the binary
+ * format of the fetch stream. Each reading is an RDSFetchReadingHeader
+ * followed by the asset code and the JSON reading, the readings are
+ * appended to the buffer.
+ *
+ * @param id		The id of the first reading to fetch
+ * @param blksize	The maximum number of readings to fetch
+ * @param buffer	The buffer to which the readings are appended
+ * @param rows		Set to the number of readings fetched
+ * @return bool		True if the fetch succeeded
+ */
+bool Connection::fetchReadingsBinary(unsigned long id,
+			       unsigned int blksize,
+			       std::string& buffer,
+			       unsigned long *rows)
+{
+	TRACE_SPAN("storage-plugin", "Connection::fetchReadingsBinary");
+	return fetchReadingRows(id, blksize, buffer, true, rows);
+}
+
+/**
+ * Fetch a block of the readings of some of the assets, returning some
+ * of their datapoints. The readings tables of the assets not wanted are
+ * not referenced by the fetch.
+ *
+ * The result holds the readings as for fetchReadings and the id from
+ * which the next fetch should start, as the readings of the assets not
+ * wanted are not returned the id of the last reading returned does not
+ * show how far the readings have been read.
+ *
+ * @param id		The id of the first reading to fetch
+ * @param blksize	The maximum number of readings to fetch
+ * @param filter	The assets and datapoints to fetch
+ * @param resultSet	The result of the fetch
+ * @return bool		True if the fetch succeeded
+ */
+bool Connection::fetchReadingsFiltered(unsigned long id,
+			       unsigned int blksize,
+			       ReadingsFetchFilter& filter,
+			       std::string& resultSet)
+{
+	TRACE_SPAN("storage-plugin", "Connection::fetchReadingsFiltered");
+	return fetchReadingRows(id, blksize, resultSet, false, NULL, &filter);
+}
+
+/**
+ * Parse a UTC timestamp returned by the readings fetch into a
+ * timeval. The timestamp is of the form YYYY-MM-DD HH:MM:SS with
+ * an optional fraction of a second.
+ *
+ * @param str	The timestamp
+ * @param tv	The timeval to populate
+ */
+static void fetchTimestamp(const char *str, struct timeval *tv)
+{
+	struct tm tm;
+	memset(&tm, 0, sizeof(tm));
+	tv->tv_sec = 0;
+	tv->tv_usec = 0;
+	if (!str || sscanf(str, "%d-%d-%d %d:%d:%d", &tm.tm_year, &tm.tm_mon, &tm.tm_mday,
+				&tm.tm_hour, &tm.tm_min, &tm.tm_sec) != 6)
+	{
+		return;
+	}
+	tm.tm_year -= 1900;
+	tm.tm_mon -= 1;
+	tv->tv_sec = timegm(&tm);
+	const char *frac = strchr(str, '.');
+	if (frac)
+	{
+		long usec = 0;
+		int digits = 0;
+		for (frac++; isdigit(*frac) && digits < 6; frac++, digits++)
+		{
+			usec = usec * 10 + (*frac - '0');
+		}
+		for (; digits < 6; digits++)
+		{
+			usec *= 10;
+		}
+		tv->tv_usec = usec;
+	}
+}
+
+/**
+ * Return the timestamp of a column of a readings fetch as a timeval,
+ * the timestamp is either formatted as UTC or stored as the number of
+ * microseconds since the epoch
+ *
+ * @param stmt		The statement of the fetch
+ * @param column	The column of the timestamp
+ * @param tv		The timeval to populate
+ */
+static void columnTimestamp(sqlite3_stmt *stmt, int column, struct timeval *tv)
+{
+	if (sqlite3_column_type(stmt, column) != SQLITE_INTEGER)
+	{
+		fetchTimestamp((const char *)sqlite3_column_text(stmt, column), tv);
+		return;
+	}
+	int64_t epoch = sqlite3_column_int64(stmt, column);
+	tv->tv_sec = (time_t)(epoch / 1000000);
+	tv->tv_usec = (suseconds_t)(epoch % 1000000);
+	if (tv->tv_usec < 0)
+	{
+		tv->tv_usec += 1000000;
+		tv->tv_sec--;
+	}
+}
+
+/**
+ * Map the rows of a readings fetch into the binary format of
+ * the fetch stream
+ *
+ * @param stmt		The statement to step
+ * @param buffer	The buffer to which the readings are appended
+ * @param rowsCount	Set to the number of rows mapped
+ * @return int		The SQLite result of the last step
+ */
+int Connection::mapReadingsBinary(sqlite3_stmt *stmt, string& buffer, unsigned long *rowsCount)
+{
+int rc;
+unsigned long nRows = 0;
+bool blobsStored = ReadingsBlobs::getInstance()->isStored();
+string expanded;
+
+	while ((rc = SQLstep(stmt)) == SQLITE_ROW)
+	{
+		RDSFetchReadingHeader hdr;
+		const char *asset = (const char *)sqlite3_column_text(stmt, 1);
+		hdr.assetLength = sqlite3_column_bytes(stmt, 1);
+		const char *reading = (const char *)sqlite3_column_text(stmt, 2);
+		hdr.payloadLength = sqlite3_column_bytes(stmt, 2);
+		if (blobsStored && reading && expandBlobs(reading, expanded))
+		{
+			reading = expanded.c_str();
+			hdr.payloadLength = expanded.length();
+		}
+		hdr.magic = RDS_FETCH_READING_MAGIC;
+		hdr.reserved = 0;
+		hdr.id = (uint64_t)sqlite3_column_int64(stmt, 0);
+		columnTimestamp(stmt, 3, &hdr.userTs);
+		columnTimestamp(stmt, 4, &hdr.ts);
+
+		buffer.append((const char *)&hdr, sizeof(hdr));
+		buffer.append(asset ? asset : "", hdr.assetLength);
+		buffer.append(reading ? reading : "", hdr.payloadLength);
+		nRows++;
+	}
+	*rowsCount = nRows;
+	return rc;
+}
+
+/**
+ * Map the rows of a filtered readings fetch to a JSON document. The
+ * datapoints not wanted are removed from each reading and readings left
+ * with no datapoints are not returned. The document carries the id from
+ * which the next fetch should start: after the last row if the block is
+ * full, otherwise the safe id as every reading below it has been read.
+ *
+ * @param stmt		The statement to step
+ * @param filter	The datapoints to return
+ * @param blksize	The block size of the fetch
+ * @param safeId	The id below which all readings have been fetched
+ * @param resultSet	Set to the JSON document
+ * @param rowsCount	Set to the number of rows read
+ * @return int		The SQLite result of the last step
+ */
+int Connection::mapReadingsFiltered(sqlite3_stmt *stmt, const ReadingsFetchFilter& filter,
+			unsigned int blksize, unsigned long safeId,
+			string& resultSet, unsigned long *rowsCount)
+{
+int rc;
+unsigned long nRows = 0;
+unsigned long returned = 0;
+unsigned long lastId = 0;
+bool blobsStored = ReadingsBlobs::getInstance()->isStored();
+string expanded;
+StringBuffer rows;
+Writer<StringBuffer> writer(rows);
+
+	writer.StartArray();
+	while ((rc = SQLstep(stmt)) == SQLITE_ROW)
+	{
+		nRows++;
+		lastId = (unsigned long)sqlite3_column_int64(stmt, 0);
+		const char *reading = (const char *)sqlite3_column_text(stmt, 2);
+		if (blobsStored && reading && expandBlobs(reading, expanded))
+		{
+			reading = expanded.c_str();
+		}
+		Document doc;
+		if (!reading || doc.Parse(reading).HasParseError() || !doc.IsObject())
+		{
+			continue;
+		}
+		if (!filter.datapoints.empty())
+		{
+			for (auto m = doc.MemberBegin(); m != doc.MemberEnd(); )
+			{
+				if (filter.datapoints.count(m->name.GetString()))
+					++m;
+				else
+					m = doc.EraseMember(m);
+			}
+			if (doc.MemberCount() == 0)
+			{
+				continue;
+			}
+		}
+		const char *asset = (const char *)sqlite3_column_text(stmt, 1);
+		const char *userTs = (const char *)sqlite3_column_text(stmt, 3);
+		const char *ts = (const char *)sqlite3_column_text(stmt, 4);
+		writer.StartObject();
+		writer.Key("id");
+		writer.Int64((int64_t)lastId);
+		writer.Key("asset_code");
+		writer.String(asset ? asset : "");
+		writer.Key("reading");
+		doc.Accept(writer);
+		writer.Key("user_ts");
+		writer.String(userTs ? userTs : "");
+		writer.Key("ts");
+		writer.String(ts ? ts : "");
+		writer.EndObject();
+		returned++;
+	}
+	writer.EndArray();
+
+	unsigned long next = nRows >= blksize ? lastId + 1 : safeId;
+	resultSet = "{\"count\":" + to_string(returned) + ",\"next\":" + to_string(next)
+			+ ",\"rows\":";
+	resultSet.append(rows.GetString(), rows.GetSize());
+	resultSet += "}";
+	*rowsCount = nRows;
+	return rc;
+}
+
+/**
+ * Fetch a block of readings from the reading tables and map them
+ * either to a JSON document or to the binary fetch stream format
+ *
+ * @param id		The id of the first reading to fetch
+ * @param blksize	The maximum number of readings to fetch
+ * @param resultSet	The result of the fetch
+ * @param binary	Map the readings to the binary format
+ * @param rows		If not NULL set to the number of readings fetched
+ * @param filter	If not NULL the assets and datapoints to fetch
+ * @return bool		True if the fetch succeeded
+ */
+bool Connection::fetchReadingRows(unsigned long id,
+			       unsigned int blksize,
+			       std::string& resultSet,
+			       bool binary,
+			       unsigned long *rows,
+			       ReadingsFetchFilter *filter)
 {
 char sqlbuffer[5120];
 char *zErrMsg = NULL;
@@ -1069,6 +2530,7 @@ string sql_cmd;
 unsigned int minGlobalId;
 unsigned int idWindow;
 unsigned long rowsCount;
+unsigned long safe_id;
 
 	ostringstream threadId;
 	threadId << std::this_thread::get_id();
@@ -1102,14 +2564,14 @@ unsigned long rowsCount;
 	// Generate a single SQL statement that using a set of UNION considers all the readings table in handling
 	{
 		// SQL - start
+		// The binary format holds the timestamps as a timeval, integer
+		// timestamps are mapped without being formatted
 		sql_cmd = R"(
 			SELECT
 				id,
 				asset_code,
 				reading,
-				strftime('%Y-%m-%d %H:%M:%S', user_ts, 'utc')  ||
-				substr(user_ts, instr(user_ts, '.'), 7) AS user_ts,
-				strftime('%Y-%m-%d %H:%M:%f', ts, 'utc') AS ts
+				)" + ReadingsTimestamps::getInstance()->fetchColumns(binary && !filter) + R"(
 			FROM
 			(
 		)";
@@ -1117,45 +2579,68 @@ unsigned long rowsCount;
 		// SQL - union of all the readings tables
 		string sql_cmd_base;
 		string sql_cmd_tmp;
-		// Would like to add a LIMIT on each sub-query in the union all, however SQLITE
-		// does not support this. Note we can not use id + blocksize as this fail if we 
-		// have holes in the id space
+		// Note we can not use id + blocksize as this fail if we have holes in the
+		// id space. A LIMIT on each sub-query of the union all is not needed: as
+		// each table is ordered by its id, its primary key, SQLite runs the query
+		// as a merge of a range scan of each table that stops once the LIMIT rows
+		// have been returned, there is no sort of the union. The id of the next
+		// fetch is therefore the cursor of every table. The sub-queries must be
+		// kept as plain selects on the id for the merge to be used.
+		// The id range and block size are bound as parameters so that the
+		// statement can be cached and reused by subsequent fetches
 		sql_cmd_base = " SELECT  id, \"_assetcode_\" asset_code, reading, user_ts, ts " \
-				"FROM _dbname_._tablename_ WHERE id >= " +
-				to_string(id) + " ";
+				"FROM _dbname_._tablename_ WHERE id >= ?1 AND id < ?2 ";
 
 		// Check for any uncommitted transactions:
 		// fetch the minimum reading id among all per thread transactions
 		// an use it as a boundary limit.
 		// If no pending transactions just use current global reading id as limit
-		unsigned long safe_id = readCatalogue->m_tx.GetMinReadingId();
-		if (safe_id)
+		safe_id = readCatalogue->m_tx.GetMinReadingId();
+		if (!safe_id)
 		{
-			sql_cmd_base += "AND id < " + to_string(safe_id) + " ";
+			safe_id = readCatalogue->getGlobalId();
+		}
+
+		// Only the tables holding ids below the safe id are referenced
+		if (filter)
+		{
+			// Nor are the tables of the assets not wanted
+			bool tablesFound;
+			sql_cmd_tmp = readCatalogue->sqlConstructMultiDb(sql_cmd_base, filter->assets, false,
+					id, safe_id, filter->exclude, &tablesFound);
+			if (!tablesFound)
+			{
+				// The command would reference a dummy table
+				resultSet = "{\"count\":0,\"next\":" + to_string(safe_id) + ",\"rows\":[]}";
+				if (rows)
+				{
+					*rows = 0;
+				}
+				return true;
+			}
 		}
 		else
 		{
-			sql_cmd_base += "AND id < " + to_string(readCatalogue->getGlobalId()) + " ";
+			sql_cmd_tmp = readCatalogue->sqlConstructMultiDb(sql_cmd_base, asset_codes, false, id, safe_id);
 		}
-
-		sql_cmd_tmp = readCatalogue->sqlConstructMultiDb(sql_cmd_base, asset_codes);
 		sql_cmd += sql_cmd_tmp;
 
 		// SQL - end
 		sql_cmd += R"(
 			) as tb
 			ORDER BY id ASC
-			LIMIT
-		)" + to_string(blksize);
+			LIMIT ?3
+		)";
 
 	}
 
 	logSQL("ReadingsFetch", sql_cmd.c_str());
 
+	checkStatementCache();
 	sqlite3_stmt *stmt;
-	// Prepare the SQL statement and get the result set
-	rc = sqlite3_prepare_v2(dbHandle, sql_cmd.c_str(),-1,&stmt,NULL);
-	if (rc != SQLITE_OK)
+	// Get the prepared SQL statement and the result set
+	stmt = getCachedStatement(sql_cmd);
+	if (stmt == NULL)
 	{
 		raiseError("retrieve", sqlite3_errmsg(dbHandle));
 
@@ -1164,10 +2649,19 @@ unsigned long rowsCount;
 	}
 	else
 	{
+		sqlite3_bind_int64(stmt, 1, (sqlite3_int64)id);
+		sqlite3_bind_int64(stmt, 2, (sqlite3_int64)safe_id);
+		sqlite3_bind_int64(stmt, 3, (sqlite3_int64)blksize);
+
 		// Call result set mapping
-		rc = mapResultSet(stmt, resultSet, &rowsCount);
+		if (filter)
+			rc = mapReadingsFiltered(stmt, *filter, blksize, safe_id, resultSet, &rowsCount);
+		else
+			rc = binary ? mapReadingsBinary(stmt, resultSet, &rowsCount)
+				: mapResultSet(stmt, resultSet, &rowsCount);
+		sqlite3_reset(stmt);
 
-		if (rowsCount == 0)
+		if (rowsCount == 0 && !filter)
 		{
 			// If no data were processed, it verifies if there are data having id above the current searched window
 			minGlobalId = readCatalogue->getMinGlobalId(this->getDbHandle());
@@ -1177,9 +2671,6 @@ unsigned long rowsCount;
 			{
 				id = minGlobalId;
 
-				// Delete result set
-				sqlite3_finalize(stmt);
-
 				// Generate a single SQL statement that using a set of UNION considers all the readings table in handling
 				{
 					// SQL - start
@@ -1188,9 +2679,7 @@ unsigned long rowsCount;
 							id,
 							asset_code,
 							reading,
-							strftime('%Y-%m-%d %H:%M:%S', user_ts, 'utc')  ||
-							substr(user_ts, instr(user_ts, '.'), 7) AS user_ts,
-							strftime('%Y-%m-%d %H:%M:%f', ts, 'utc') AS ts
+							)" + ReadingsTimestamps::getInstance()->fetchColumns(binary) + R"(
 						FROM
 						(
 					)";
@@ -1198,32 +2687,37 @@ unsigned long rowsCount;
 					// SQL - union of all the readings tables
 					string sql_cmd_base;
 					string sql_cmd_tmp;
-					sql_cmd_base = " SELECT  id, \"_assetcode_\" asset_code, reading, user_ts, ts  FROM _dbname_._tablename_ WHERE id >= " + to_string(id) + " and id <=  " + to_string(id) + " + " + to_string(blksize) + " ";
-					sql_cmd_tmp = readCatalogue->sqlConstructMultiDb(sql_cmd_base, asset_codes);
+					sql_cmd_base = " SELECT  id, \"_assetcode_\" asset_code, reading, user_ts, ts  FROM _dbname_._tablename_ WHERE id >= ?1 and id <= ?1 + ?3 ";
+					sql_cmd_tmp = readCatalogue->sqlConstructMultiDb(sql_cmd_base, asset_codes, false, id, id + blksize);
 					sql_cmd += sql_cmd_tmp;
 
 					// SQL - end
 					sql_cmd += R"(
 					) as tb
 					ORDER BY id ASC
-					LIMIT
-				)" + to_string(blksize);
+					LIMIT ?3
+				)";
 
 				}
 
 				logSQL("ReadingsFetch", sql_cmd.c_str());
 
-				// Prepare the SQL statement and get the result set
-				rc = sqlite3_prepare_v2(dbHandle, sql_cmd.c_str(),-1,&stmt,NULL);
-				if (rc != SQLITE_OK)
+				// Get the prepared SQL statement and the result set
+				stmt = getCachedStatement(sql_cmd);
+				if (stmt == NULL)
 				{
 					raiseError("retrieve", sqlite3_errmsg(dbHandle));
 
 					// Failure
 					return false;
 				}
+				sqlite3_bind_int64(stmt, 1, (sqlite3_int64)id);
+				sqlite3_bind_int64(stmt, 3, (sqlite3_int64)blksize);
+
 				// Call result set mapping
-				rc = mapResultSet(stmt, resultSet, &rowsCount);
+				rc = binary ? mapReadingsBinary(stmt, resultSet, &rowsCount)
+				: mapResultSet(stmt, resultSet, &rowsCount);
+				sqlite3_reset(stmt);
 
 				if (rowsCount != 0)
 				{
@@ -1232,8 +2726,10 @@ unsigned long rowsCount;
 			}
 		}
 
-		// Delete result set
-		sqlite3_finalize(stmt);
+		if (rows)
+		{
+			*rows = rowsCount;
+		}
 
 		// Check result set errors
 		if (rc != SQLITE_DONE)
@@ -1261,8 +2757,8 @@ unsigned long rowsCount;
  */
 bool Connection::retrieveReadings(const string& condition, string& resultSet)
 {
-// Default template parameter uses UTF8 and MemoryPoolAllocator.
-Document	document;
+PayloadDocument	payloadDoc;
+Document&	document = payloadDoc.get();
 SQLBuffer	sql;
 
 SQLBuffer	sqlExtDummy;
@@ -1321,7 +2817,7 @@ vector<string>  asset_codes;
 			// SQL - union of all the readings tables
 			string sql_cmd_base;
 			string sql_cmd_tmp;
-			sql_cmd_base = " SELECT  id, \"_assetcode_\" asset_code, reading, user_ts, ts  FROM _dbname_._tablename_ ";
+			sql_cmd_base = " SELECT  id, \"_assetcode_\" asset_code, reading, " + ReadingsTimestamps::getInstance()->columns() + "  FROM _dbname_._tablename_ ";
 			sql_cmd_tmp = readCat->sqlConstructMultiDb(sql_cmd_base, asset_codes);
 			sql_cmd += sql_cmd_tmp;
 
@@ -1333,7 +2829,7 @@ vector<string>  asset_codes;
 		}
 		else
 		{
-			if (document.Parse(condition.c_str()).HasParseError())
+			if (payloadDoc.parse(condition.c_str()).HasParseError())
 			{
 				raiseError("retrieve", "Failed to parse JSON payload");
 				return false;
@@ -1613,7 +3109,7 @@ vector<string>  asset_codes;
 					if (! strstr(queryTmp, "asset_code"))
 						sql_cmd_base += ",  asset_code";
 
-					sql_cmd_base += ", id, reading, user_ts, ts ";
+					sql_cmd_base += ", id, reading, " + ReadingsTimestamps::getInstance()->columns() + " ";
 					StringReplaceAll (sql_cmd_base, "asset_code", " \"_assetcode_\" .assetcode. ");
 					sql_cmd_base += " FROM _dbname_._tablename_ ";
 
@@ -1621,7 +3117,7 @@ vector<string>  asset_codes;
 				}
 				else
 				{
-					sql_cmd_base = " SELECT ROWID, id, \"_assetcode_\" asset_code, reading, user_ts, ts  FROM _dbname_._tablename_ ";
+					sql_cmd_base = " SELECT ROWID, id, \"_assetcode_\" asset_code, reading, " + ReadingsTimestamps::getInstance()->columns() + "  FROM _dbname_._tablename_ ";
 				}
 				sql_cmd_tmp = readCat->sqlConstructMultiDb(sql_cmd_base, asset_codes);
 				sql_cmd += sql_cmd_tmp;
@@ -1642,7 +3138,7 @@ vector<string>  asset_codes;
 			 
 				if (document.HasMember("where"))
 				{
-					if (!jsonWhereClause(document["where"], sql, asset_codes))
+					if (!jsonWhereClause(document["where"], sql, asset_codes, false, "", ReadingsTimestamps::getInstance()->isEpoch()))
 					{
 						return false;
 					}
@@ -1770,6 +3266,27 @@ vector<string>  assetCodes;
 
 	logger->info("Purge starting...");
 	gettimeofday(&startTv, NULL);
+
+	/*
+	 * The partitions entirely older than the age are removed deleting their
+	 * databases, the readings left are then purged by rows as usual.
+	 */
+	unsigned long partitionPurged = 0, partitionUnsentPurged = 0;
+	if (age > 0 && readCatalogue->hasPartitions())
+	{
+		partitionPurged = readCatalogue->purgeExpiredPartitions(dbHandle, age, sent, flag_retain, &partitionUnsentPurged);
+		if (partitionPurged > 0)
+		{
+			ostringstream convert;
+
+			convert << "{ \"removed\" : " << partitionPurged << ", ";
+			convert << " \"unsentPurged\" : " << (sent == 0 ? partitionPurged : partitionUnsentPurged) << ", ";
+			convert << " \"unsentRetained\" : 0, ";
+			convert << " \"readings\" : 0 }";
+
+			result = convert.str();
+		}
+	}
 	/*
 	 * We fetch the current rowid and limit the purge process to work on just
 	 * those rows present in the database when the purge process started.
@@ -1878,7 +3395,7 @@ vector<string>  assetCodes;
 		{
 			// SQL - start
 			sql_cmd = R"(
-				SELECT (strftime('%s','now', 'utc') - strftime('%s', MIN(user_ts)))/360
+				SELECT (strftime('%s','now', 'utc') - )" + ReadingsTimestamps::getInstance()->seconds("MIN(user_ts)") + R"()/360
 				FROM
 				(
 			)";
@@ -1953,11 +3470,15 @@ vector<string>  assetCodes;
 		if (l == r)
 		{
  			logger->info("No data to purge: min_id == max_id == %u", minrowidLimit);
-			return 0;
+			return partitionPurged;
 		}
 
 		unsigned long m=l;
+		string ageModifier = "-" + to_string(age) + " hours";
+		bool epochTs = ReadingsTimestamps::getInstance()->isEpoch();
+		int64_t epochLimit = ReadingsTimestamps::now() - (int64_t)age * 3600 * 1000000;
 
+		checkStatementCache();
 		while (l <= r)
 		{
 			unsigned long midRowId = 0;
@@ -1981,7 +3502,8 @@ vector<string>  assetCodes;
 				// SQL - union of all the readings tables
 				string sql_cmd_base;
 				string sql_cmd_tmp;
-				sql_cmd_base = " SELECT id FROM _dbname_._tablename_  WHERE rowid = " + to_string(m) + " AND user_ts < datetime('now' , '-" +to_string(age) + " hours')";
+				sql_cmd_base = " SELECT id FROM _dbname_._tablename_  WHERE rowid = ?1 AND user_ts < ";
+				sql_cmd_base += epochTs ? "?2" : "datetime('now' , ?2)";
 				ReadingsCatalogue *readCat = ReadingsCatalogue::getInstance();
 				sql_cmd_tmp = readCat->sqlConstructMultiDb(sql_cmd_base, assetCodes);
 				sql_cmd += sql_cmd_tmp;
@@ -1993,24 +3515,29 @@ vector<string>  assetCodes;
 
 			}
 
-			SQLBuffer sqlBuffer;
-			sqlBuffer.append(sql_cmd);
-			sqlBuffer.append(';');
-			const char *query = sqlBuffer.coalesce();
-
-			rc = SQLexec(dbHandle,
-			query,
-			rowidCallback,
-			&midRowId,
-			&zErrMsg);
-
+			// The statement is the same for every step of the search,
+			// only the bound row id changes
+			sqlite3_stmt *stmt = getCachedStatement(sql_cmd);
+			if (stmt == NULL)
+			{
+	 			raiseError("purge - phase 1, fetching midRowId ", sqlite3_errmsg(dbHandle));
+				return 0;
+			}
+			sqlite3_bind_int64(stmt, 1, (sqlite3_int64)m);
+			if (epochTs)
+				sqlite3_bind_int64(stmt, 2, (sqlite3_int64)epochLimit);
+			else
+				sqlite3_bind_text(stmt, 2, ageModifier.c_str(), -1, SQLITE_STATIC);
 
-			delete[] query;
+			while ((rc = SQLstep(stmt)) == SQLITE_ROW)
+			{
+				midRowId = (unsigned long)sqlite3_column_int64(stmt, 0);
+			}
+			sqlite3_reset(stmt);
 
-			if (rc != SQLITE_OK)
+			if (rc != SQLITE_DONE)
 			{
-	 			raiseError("purge - phase 1, fetching midRowId ", zErrMsg);
-				sqlite3_free(zErrMsg);
+	 			raiseError("purge - phase 1, fetching midRowId ", sqlite3_errmsg(dbHandle));
 				return 0;
 			}
 
@@ -2036,7 +3563,7 @@ vector<string>  assetCodes;
 		if (minrowidLimit == rowidLimit)
 		{
 			logger->info("No data to purge");
-			return 0;
+			return partitionPurged;
 		}
 
 		rowidMin = minrowidLimit;
@@ -2134,7 +3661,9 @@ vector<string>  assetCodes;
 		SQLBuffer sql;
 		sql.append("DELETE FROM  _dbname_._tablename_ WHERE rowid <= ");
 		sql.append(rowidMin);
-		sql.append(" AND user_ts < datetime('now' , '-" +to_string(age) + " hours')");
+		// The unary + keeps SQLite from searching the user_ts index, the
+		// rowid range bounds the rows that are deleted
+		sql.append(" AND +user_ts < " + ReadingsTimestamps::getInstance()->ago(age * 3600));
 		sql.append(';');
 		const char *query = sql.coalesce();
 
@@ -2146,7 +3675,7 @@ vector<string>  assetCodes;
 //		if (m_writeAccessOngoing) db_cv.wait(lck);
 
 		START_TIME;
-		rc = readCat->purgeAllReadings(dbHandle, query ,&zErrMsg, &rowsAffected);
+		rc = readCat->purgeAllReadings(dbHandle, query ,&zErrMsg, &rowsAffected, rowidMin);
 		END_TIME;
 
 		logger->debug("%s - DELETE sql :%s: rowsAffected :%ld:",  __FUNCTION__, query ,rowsAffected);
@@ -2201,10 +3730,20 @@ vector<string>  assetCodes;
 		Logger::getLogger()->debug("Purge delete block #%d with %d readings", blocks, rowsAffected);
 	} while (rowidMin  < rowidLimit);
 
+	// The purge raised the lowest id stored in the tables
+	if (deletedRows > 0)
+	{
+		readCat->refreshIdRanges(dbHandle);
+		purgeBlobs();
+	}
+
 	unsentRetained = maxrowidLimit - rowidLimit;
 
 	numReadings = maxrowidLimit +1 - minrowidLimit - deletedRows;
 
+	deletedRows += partitionPurged;
+	unsentPurged += partitionUnsentPurged;
+
 	if (sent == 0)	// Special case when not north process is used
 	{
 		unsentPurged = deletedRows;
@@ -2230,6 +3769,165 @@ vector<string>  assetCodes;
 
 #endif
 
+#ifndef SQLITE_SPLIT_READINGS
+/**
+ * Return the lowest or highest rowid of the readings tables
+ *
+ * @param aggregate		MIN or MAX
+ * @param considerExclusion	Ignore the tables of the assets excluded from the purge
+ * @param rowid			Set to the rowid, 0 if the tables are empty
+ * @return bool			False if the query failed
+ */
+bool Connection::readingsRowidLimit(const string& aggregate, bool considerExclusion, unsigned long *rowid)
+{
+vector<string>  assetCodes;
+char *zErrMsg = NULL;
+
+	string sql_cmd = "SELECT " + aggregate + "(rowid) FROM ( ";
+	string sql_cmd_base = " SELECT " + aggregate + "(rowid) rowid FROM _dbname_._tablename_ ";
+	sql_cmd += ReadingsCatalogue::getInstance()->sqlConstructMultiDb(sql_cmd_base, assetCodes, considerExclusion);
+	sql_cmd += " ) as readings_1";
+
+	*rowid = 0;
+	int rc = SQLexec(dbHandle,
+			 sql_cmd.c_str(),
+			 rowidCallback,
+			 rowid,
+			 &zErrMsg);
+	if (rc != SQLITE_OK)
+	{
+		raiseError("purge - fetching rowid limit", zErrMsg);
+		sqlite3_free(zErrMsg);
+		return false;
+	}
+	return true;
+}
+
+/**
+ * Purge a limited number of readings, a step of the incremental purge.
+ * The oldest readings are deleted in blocks until either maxRows have
+ * been deleted, the time budget is spent or a block finds no reading
+ * older than the age.
+ *
+ * @param age			Age in hours of the readings to purge
+ * @param flags			The purge flags, STORAGE_PURGE_RETAIN_ANY/ALL keep the unsent readings
+ * @param sent			The id of the last reading sent north
+ * @param maxRows		The maximum number of readings to delete
+ * @param budget		The time budget of the step in microseconds
+ * @param unsentPurged		Updated with the unsent readings deleted
+ * @param unsentRetained	Set to the unsent readings kept
+ * @param readings		Set to the readings left
+ * @return long			The readings deleted, -1 on error
+ */
+long Connection::purgeReadingsStep(unsigned long age,
+				   unsigned int flags,
+				   unsigned long sent,
+				   unsigned long maxRows,
+				   unsigned long budget,
+				   unsigned long *unsentPurged,
+				   unsigned long *unsentRetained,
+				   unsigned long *readings)
+{
+unsigned long minRowid, maxRowid, limit, rowidMin;
+unsigned long removed = 0, deletedRows = 0;
+struct timeval startTv, nowTv;
+
+	Logger *logger = Logger::getLogger();
+	ReadingsCatalogue *readCat = ReadingsCatalogue::getInstance();
+
+	attachPendingDbs();
+
+	bool flag_retain = (flags & STORAGE_PURGE_RETAIN_ANY) || (flags & STORAGE_PURGE_RETAIN_ALL);
+
+	gettimeofday(&startTv, NULL);
+
+	if (readCat->hasPartitions())
+	{
+		unsigned long partitionUnsentPurged = 0;
+		removed += readCat->purgeExpiredPartitions(dbHandle, age, sent, flag_retain, &partitionUnsentPurged);
+		*unsentPurged += partitionUnsentPurged;
+	}
+
+	if (!readingsRowidLimit("MAX", false, &maxRowid) || !readingsRowidLimit("MIN", true, &minRowid))
+	{
+		return -1;
+	}
+
+	limit = flag_retain ? min(sent, maxRowid) : maxRowid;
+	rowidMin = minRowid;
+
+	while (rowidMin < limit && removed < maxRows)
+	{
+		unsigned long upper = rowidMin + min((unsigned long)purgeBlockSize, maxRows - removed);
+		if (upper > limit)
+		{
+			upper = limit;
+		}
+
+		SQLBuffer sql;
+		sql.append("DELETE FROM  _dbname_._tablename_ WHERE rowid <= ");
+		sql.append(upper);
+		// Search by rowid rather than user_ts, as purgeReadings does
+		sql.append(" AND +user_ts < " + ReadingsTimestamps::getInstance()->ago(age * 3600));
+		sql.append(';');
+		const char *query = sql.coalesce();
+
+		logSQL("ReadingsPurge", query);
+
+		char *zErrMsg = NULL;
+		unsigned long rowsAffected = 0;
+		int rc = readCat->purgeAllReadings(dbHandle, query, &zErrMsg, &rowsAffected, upper);
+		delete[] query;
+
+		if (rc != SQLITE_OK)
+		{
+			raiseError("purge - incremental", zErrMsg);
+			sqlite3_free(zErrMsg);
+			break;
+		}
+
+		removed += rowsAffected;
+		deletedRows += rowsAffected;
+		if (!flag_retain && sent != 0 && upper > sent)
+		{
+			*unsentPurged += min(rowsAffected, upper - max(sent, rowidMin));
+		}
+
+		// The readings left are not yet old enough to be purged
+		if (rowsAffected == 0)
+		{
+			break;
+		}
+		rowidMin = upper;
+
+		gettimeofday(&nowTv, NULL);
+		unsigned long elapsed = (1000000 * (nowTv.tv_sec - startTv.tv_sec)) + nowTv.tv_usec - startTv.tv_usec;
+		if (elapsed >= budget)
+		{
+			break;
+		}
+	}
+
+	// The purge raised the lowest id stored in the tables
+	if (deletedRows > 0)
+	{
+		readCat->refreshIdRanges(dbHandle);
+		purgeBlobs();
+	}
+
+	*unsentRetained = maxRowid - limit;
+	*readings = maxRowid + 1 - minRowid - deletedRows;
+	if (maxRowid == 0)
+	{
+		*readings = 0;
+	}
+
+	logger->debug("Incremental purge of readings older than %lu hours removed %lu readings", age, removed);
+
+	return removed;
+}
+#endif
+
 #ifndef SQLITE_SPLIT_READINGS
 /**
  * Purge readings from the reading table
@@ -2451,7 +4149,7 @@ bool flag_retain;
 //			if (m_writeAccessOngoing) db_cv.wait(lck);
 
 			// Exec DELETE query: no callback, no resultset
-			rc = readCat->purgeAllReadings(dbHandle, query ,&zErrMsg, &rowsAffected);
+			rc = readCat->purgeAllReadings(dbHandle, query ,&zErrMsg, &rowsAffected, deletePoint);
 
 			logger->debug(" %s - DELETE - query :%s: rowsAffected :%ld:", __FUNCTION__, query ,rowsAffected);
 
@@ -2478,6 +4176,13 @@ bool flag_retain;
 		std::this_thread::sleep_for(std::chrono::milliseconds(1));
 	} while (rowcount > rows);
 
+	// The purge raised the lowest id stored in the tables
+	if (deletedRows > 0)
+	{
+		ReadingsCatalogue::getInstance()->refreshIdRanges(dbHandle);
+		purgeBlobs();
+	}
+
 	if (limit)
 	{
 		unsentRetained = numReadings - rows;
@@ -2499,6 +4204,68 @@ bool flag_retain;
 }
 #endif
 
+/**
+ * Discard the cached prepared statements if the readings catalogue has
+ * detached or dropped readings tables since they were prepared, or if
+ * the cache has grown beyond its limit. This must only be called before
+ * any statements are taken from the cache for an operation, statements
+ * held by the caller are finalized.
+ */
+void Connection::checkStatementCache()
+{
+	unsigned long generation = ReadingsCatalogue::getInstance()->getStatementGeneration();
+
+	if (generation != m_stmtGeneration || m_stmtCache.size() >= MAX_CACHED_STATEMENTS)
+	{
+		clearStatementCache();
+		m_stmtGeneration = generation;
+	}
+}
+
+/**
+ * Return a prepared statement for the SQL command from the cache of
+ * statements held by the connection, preparing it if it is not already
+ * cached. The statement is reset and its bindings cleared, it remains
+ * owned by the cache and must not be finalized by the caller.
+ *
+ * @param sql	The SQL command
+ * @return	The prepared statement or NULL if the preparation failed
+ */
+sqlite3_stmt *Connection::getCachedStatement(const string& sql)
+{
+	auto it = m_stmtCache.find(sql);
+	if (it != m_stmtCache.end())
+	{
+		sqlite3_reset(it->second);
+		sqlite3_clear_bindings(it->second);
+		return it->second;
+	}
+
+	sqlite3_stmt *stmt = NULL;
+	if (SQLPrepare(dbHandle, sql.c_str(), &stmt) != SQLITE_OK)
+	{
+		if (stmt)
+		{
+			sqlite3_finalize(stmt);
+		}
+		return NULL;
+	}
+	m_stmtCache.insert(make_pair(sql, stmt));
+	return stmt;
+}
+
+/**
+ * Finalize all the prepared statements cached by the connection
+ */
+void Connection::clearStatementCache()
+{
+	for (auto& item : m_stmtCache)
+	{
+		sqlite3_finalize(item.second);
+	}
+	m_stmtCache.clear();
+}
+
 /**
  * SQLIte wrapper to retry statements when the database error occurs
  *
@@ -0,0 +1,159 @@
+/*
+ * Fledge storage service - Background allocation of the readings databases
+ *
+ * Copyright (c) 2026 Dianomic Systems
+ *
+ * Released under the Apache 2.0 Licence
+ *
+ * Author: agent
+ */
+
+#include <readings_allocator.h>
+#include <readings_catalogue.h>
+#include <connection.h>
+#include <connection_manager.h>
+#include <logger.h>
+
+using namespace std;
+
+/**
+ * Seconds after which the thread checks the headroom without being woken,
+ * covers the databases removed by a change of the configuration
+ */
+#define ALLOCATOR_CHECK_INTERVAL	60
+
+ReadingsAllocator *ReadingsAllocator::m_instance = 0;
+
+/**
+ * Constructor for the readings allocator
+ */
+ReadingsAllocator::ReadingsAllocator() : m_manager(NULL), m_connection(NULL),
+	m_thread(NULL), m_running(false), m_headroom(0), m_requested(false)
+{
+}
+
+/**
+ * Destructor for the readings allocator
+ */
+ReadingsAllocator::~ReadingsAllocator()
+{
+	stop();
+}
+
+/**
+ * Return the singleton instance of the ReadingsAllocator class
+ * for this plugin
+ *
+ * @return ReadingsAllocator* singleton instance
+ */
+ReadingsAllocator *ReadingsAllocator::getInstance()
+{
+	if (m_instance == 0)
+	{
+		m_instance = new ReadingsAllocator();
+	}
+	return m_instance;
+}
+
+/**
+ * Start the allocator thread. The thread keeps a connection from the
+ * pool for its own use until it is stopped and restores the headroom
+ * as soon as it starts.
+ *
+ * @param manager	The connection manager of the plugin
+ * @param headroom	The number of free databases to keep in reserve
+ */
+void ReadingsAllocator::start(ConnectionManager *manager, int headroom)
+{
+	lock_guard<mutex> guard(m_mutex);
+	if (m_running || headroom < 1)
+	{
+		return;
+	}
+	m_manager = manager;
+	m_headroom = headroom;
+	m_connection = manager->allocate();
+	m_requested = true;
+	m_running = true;
+	m_thread = new thread(&ReadingsAllocator::allocatorThread, this);
+	Logger::getLogger()->info("Readings databases will be created in the background, %d free databases kept in reserve",
+			m_headroom);
+}
+
+/**
+ * Stop the allocator thread
+ */
+void ReadingsAllocator::stop()
+{
+	{
+		lock_guard<mutex> guard(m_mutex);
+		if (!m_running)
+		{
+			return;
+		}
+		m_running = false;
+	}
+	m_cv.notify_all();
+	m_thread->join();
+	delete m_thread;
+	m_thread = NULL;
+	m_manager->release(m_connection);
+	m_connection = NULL;
+}
+
+/**
+ * Wake the allocator thread, called when a free database has been taken
+ * into use. The call only records the request, the databases are created
+ * by the thread.
+ */
+void ReadingsAllocator::notify()
+{
+	{
+		lock_guard<mutex> guard(m_mutex);
+		if (!m_running)
+		{
+			return;
+		}
+		m_requested = true;
+	}
+	m_cv.notify_all();
+}
+
+/**
+ * The allocator thread, restores the headroom of free databases each
+ * time it is woken
+ */
+void ReadingsAllocator::allocatorThread()
+{
+	ReadingsCatalogue *catalogue = ReadingsCatalogue::getInstance();
+
+	while (true)
+	{
+		{
+			unique_lock<mutex> lck(m_mutex);
+			m_cv.wait_for(lck, chrono::seconds(ALLOCATOR_CHECK_INTERVAL),
+					[this]{ return !m_running || m_requested; });
+			if (!m_running)
+			{
+				break;
+			}
+			m_requested = false;
+		}
+
+		m_connection->attachPendingDbs();
+
+		AttachDbSync *attachSync = AttachDbSync::getInstance();
+		attachSync->lock();
+		int created = catalogue->preallocateHeadroom(m_connection->getDbHandle(), m_headroom);
+		int dbIdLast = catalogue->getDbIdLast();
+		attachSync->unlock();
+
+		if (created > 0)
+		{
+			// Recorded without the AttachDbSync lock, the appending connection
+			// that holds the database waits for the lock within its transaction
+			catalogue->latestDbUpdate(m_connection->getDbHandle(), dbIdLast);
+			Logger::getLogger()->debug("ReadingsAllocator - created %d readings databases", created);
+		}
+	}
+}
@@ -0,0 +1,166 @@
+/*
+ * Fledge storage service - Binary storage of image and data buffer datapoints
+ *
+ * Copyright (c) 2026 Dianomic Systems
+ *
+ * Released under the Apache 2.0 Licence
+ *
+ * Author: agent
+ */
+
+#include <readings_blobs.h>
+#include <logger.h>
+#include <string.h>
+#include <stdlib.h>
+#include <ctype.h>
+
+using namespace std;
+
+ReadingsBlobs *ReadingsBlobs::m_instance = 0;
+
+#define IMAGE_TYPE	"\"__DPIMAGE:"
+#define BUFFER_TYPE	"\"__DATABUFFER:"
+
+/**
+ * Constructor for the readings blobs class
+ */
+ReadingsBlobs::ReadingsBlobs() : m_minimumSize(0), m_stored(false)
+{
+}
+
+/**
+ * Destructor for the readings blobs class
+ */
+ReadingsBlobs::~ReadingsBlobs()
+{
+}
+
+/**
+ * Return the singleton instance of the ReadingsBlobs class
+ * for this plugin
+ *
+ * @return ReadingsBlobs* singleton instance
+ */
+ReadingsBlobs *ReadingsBlobs::getInstance()
+{
+	if (m_instance == 0)
+	{
+		m_instance = new ReadingsBlobs();
+	}
+	return m_instance;
+}
+
+/**
+ * Set the minimum size of the data of the images and data buffers
+ * stored as binary objects
+ *
+ * @param size	The size in bytes, 0 keeps them within the readings
+ */
+void ReadingsBlobs::setMinimumSize(unsigned long size)
+{
+	m_minimumSize = size;
+	if (size)
+	{
+		Logger::getLogger()->info("Images and data buffers of %lu bytes or more will be stored as binary objects", size);
+	}
+}
+
+/**
+ * Find the image and data buffer values of the JSON of a reading
+ * whose data is at least of the minimum size
+ *
+ * @param json		The JSON of the reading
+ * @param minimumSize	The minimum size in bytes of the data
+ * @param values	The values found are appended to this vector
+ */
+void ReadingsBlobs::findBinaryValues(const string& json, size_t minimumSize, vector<BinaryValue>& values)
+{
+	size_t pos = 0;
+	while ((pos = json.find("\"__", pos)) != string::npos)
+	{
+		BinaryValue value;
+		value.m_offset = pos + 1;
+		size_t header;
+		bool image = false;
+		if (json.compare(pos, sizeof(IMAGE_TYPE) - 1, IMAGE_TYPE) == 0)
+		{
+			header = pos + sizeof(IMAGE_TYPE) - 1;
+			image = true;
+		}
+		else if (json.compare(pos, sizeof(BUFFER_TYPE) - 1, BUFFER_TYPE) == 0)
+		{
+			header = pos + sizeof(BUFFER_TYPE) - 1;
+		}
+		else
+		{
+			pos += 3;
+			continue;
+		}
+		size_t end = json.find('"', header);
+		if (end == string::npos)
+		{
+			return;
+		}
+		pos = end + 1;
+
+		// The quote is part of a string or the value is the name of a datapoint
+		if ((value.m_offset > 1 && json[value.m_offset - 2] == '\\') || json[end - 1] == '\\'
+				|| (end + 1 < json.length() && json[end + 1] == ':'))
+		{
+			continue;
+		}
+		if (image)
+		{
+			// The width, height and depth of the image precede the data
+			size_t sep = json.find('_', header);
+			if (sep == string::npos || sep > end)
+			{
+				continue;
+			}
+			header = sep + 1;
+		}
+		else
+		{
+			// The item size of the data buffer precedes the data
+			header++;
+		}
+		if (header > end || ((end - header) / 4) * 3 < minimumSize)
+		{
+			continue;
+		}
+		value.m_length = end - value.m_offset;
+		value.m_prefixLength = header - value.m_offset;
+		values.push_back(value);
+	}
+}
+
+/**
+ * Parse a reference to a binary object of the form __BLOB:<reading id>.<seq>
+ *
+ * @param str		The reference
+ * @param readingId	Set to the id of the reading of the binary object
+ * @param seq		Set to the number of the binary object within the reading
+ * @param length	Set to the length of the reference
+ * @return bool		False if the string is not a reference
+ */
+bool ReadingsBlobs::parseReference(const char *str, unsigned long *readingId, unsigned int *seq, size_t *length)
+{
+	if (strncmp(str, BLOB_REFERENCE, sizeof(BLOB_REFERENCE) - 1) != 0)
+	{
+		return false;
+	}
+	const char *p = str + sizeof(BLOB_REFERENCE) - 1;
+	char *end;
+	if (!isdigit(*p))
+	{
+		return false;
+	}
+	*readingId = strtoul(p, &end, 10);
+	if (*end != '.' || !isdigit(end[1]))
+	{
+		return false;
+	}
+	*seq = (unsigned int)strtoul(end + 1, &end, 10);
+	*length = end - str;
+	return true;
+}
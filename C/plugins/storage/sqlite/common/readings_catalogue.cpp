@@ -9,10 +9,14 @@
  */
 
 #include <vector>
+#include <map>
+#include <thread>
+#include <set>
 #include <algorithm>
 #include <utils.h>
 #include <sys/stat.h>
 #include <libgen.h>
+#include <string.h>
 
 #include <string_utils.h>
 #include <connection.h>
@@ -20,6 +24,11 @@
 #include <common.h>
 #include "readings_catalogue.h"
 #include <purge_configuration.h>
+#include <pragma_configuration.h>
+#include <readings_allocator.h>
+#include <readings_blobs.h>
+#include <readings_compression.h>
+#include <readings_timestamps.h>
 
 using namespace std;
 using namespace rapidjson;
@@ -249,7 +258,9 @@ int ReadingsCatalogue::calculateGlobalId (sqlite3 *dbHandle)
 		)";
 
 		bool firstRow = true;
-		if (m_AssetReadingCatalogue.empty())
+		lock_guard<mutex> guard(m_partitionsLock);
+		vector<const tyAssetCatalogue *> catalogues = getAllCatalogues();
+		if (catalogues.empty())
 		{
 			string dbReadingsName = generateReadingsName(1, 1);
 
@@ -257,18 +268,21 @@ int ReadingsCatalogue::calculateGlobalId (sqlite3 *dbHandle)
 		}
 		else
 		{
-			for (auto &item : m_AssetReadingCatalogue)
+			for (auto catalogue : catalogues)
 			{
-				if (!firstRow)
+				for (auto &item : *catalogue)
 				{
-					sql_cmd += " UNION ";
-				}
+					if (!firstRow)
+					{
+						sql_cmd += " UNION ";
+					}
 
-				dbName = generateDbName(item.second.second);
-				dbReadingsName = generateReadingsName(item.second.second, item.second.first);
+					dbName = generateDbName(item.second.second);
+					dbReadingsName = generateReadingsName(item.second.second, item.second.first);
 
-				sql_cmd += " SELECT max(id) id FROM " + dbName + "." + dbReadingsName + " ";
-				firstRow = false;
+					sql_cmd += " SELECT max(id) id FROM " + dbName + "." + dbReadingsName + " ";
+					firstRow = false;
+				}
 			}
 		}
 		sql_cmd += ") AS tb";
@@ -328,7 +342,9 @@ int ReadingsCatalogue::getMinGlobalId (sqlite3 *dbHandle)
 		)";
 
 		bool firstRow = true;
-		if (m_AssetReadingCatalogue.empty())
+		lock_guard<mutex> guard(m_partitionsLock);
+		vector<const tyAssetCatalogue *> catalogues = getAllCatalogues();
+		if (catalogues.empty())
 		{
 			string dbReadingsName = generateReadingsName(1, 1);
 
@@ -336,18 +352,21 @@ int ReadingsCatalogue::getMinGlobalId (sqlite3 *dbHandle)
 		}
 		else
 		{
-			for (auto &item : m_AssetReadingCatalogue)
+			for (auto catalogue : catalogues)
 			{
-				if (!firstRow)
+				for (auto &item : *catalogue)
 				{
-					sql_cmd += " UNION ";
-				}
+					if (!firstRow)
+					{
+						sql_cmd += " UNION ";
+					}
 
-				dbName = generateDbName(item.second.second);
-				dbReadingsName = generateReadingsName(item.second.second, item.second.first);
+					dbName = generateDbName(item.second.second);
+					dbReadingsName = generateReadingsName(item.second.second, item.second.first);
 
-				sql_cmd += " SELECT min(id) id FROM " + dbName + "." + dbReadingsName + " ";
-				firstRow = false;
+					sql_cmd += " SELECT min(id) id FROM " + dbName + "." + dbReadingsName + " ";
+					firstRow = false;
+				}
 			}
 		}
 		sql_cmd += ") AS tb";
@@ -397,6 +416,14 @@ bool  ReadingsCatalogue::loadAssetReadingCatalogue()
 	Connection        *connection = manager->allocate();
 	dbHandle = connection->getDbHandle();
 
+	// Databases belonging to closed partitions
+	map<int, time_t> dbPartitionEnd;
+	if (! loadPartitions(dbHandle, dbPartitionEnd))
+	{
+		manager->release(connection);
+		return false;
+	}
+
 	// loads readings catalog from the db
 	const char *sql_cmd = R"(
 		SELECT
@@ -412,6 +439,7 @@ bool  ReadingsCatalogue::loadAssetReadingCatalogue()
 	if (sqlite3_prepare_v2(dbHandle,sql_cmd,-1, &stmt,NULL) != SQLITE_OK)
 	{
 		raiseError("retrieve asset_reading_catalogue", sqlite3_errmsg(dbHandle));
+		manager->release(connection);
 		return false;
 	}
 	else
@@ -432,7 +460,12 @@ bool  ReadingsCatalogue::loadAssetReadingCatalogue()
 
 			auto newItem = make_pair(tableId,dbId);
 			auto newMapValue = make_pair(asset_name,newItem);
-			m_AssetReadingCatalogue.insert(newMapValue);
+
+			auto partition = dbPartitionEnd.find(dbId);
+			if (partition != dbPartitionEnd.end())
+				m_partitions[partition->second].insert(newMapValue);
+			else
+				m_AssetReadingCatalogue.insert(newMapValue);
 
 		}
 
@@ -443,9 +476,25 @@ bool  ReadingsCatalogue::loadAssetReadingCatalogue()
 
 	Logger::getLogger()->debug("loadAssetReadingCatalogue maxdb :%d:", m_dbIdCurrent);
 
+	publishAssetLookup();
+
 	return true;
 }
 
+/**
+ * Publish a copy of the catalogue of the assets for the lookups of
+ * getReadingReference. The copy is never modified, the appends find the
+ * known assets in it without taking a lock whilst a new copy is built on
+ * the allocation of a table. Called with the AttachDbSync lock held, or
+ * before the appends start.
+ */
+void ReadingsCatalogue::publishAssetLookup()
+{
+	shared_ptr<const tyAssetLookup> lookup = make_shared<const tyAssetLookup>(
+			m_AssetReadingCatalogue.begin(), m_AssetReadingCatalogue.end());
+	atomic_store(&m_assetLookup, lookup);
+}
+
 /**
  * Add the newly create db to the list
  *
@@ -486,6 +535,12 @@ void ReadingsCatalogue::prepareAllDbs() {
 		// Following runs - attaches all the databases
 		for (dbId = 2; dbId <= m_dbIdLast ; dbId++ )
 		{
+			// Databases of the expired partitions were deleted, they must not be created again by the attach
+			struct stat st;
+			if (dbId < m_dbIdCurrent && stat(generateDbFilePah(dbId).c_str(), &st) != 0)
+			{
+				continue;
+			}
 			m_dbIdList.push_back(dbId);
 		}
 		attachDbsToAllConnections();
@@ -533,17 +588,23 @@ void ReadingsCatalogue::getAllDbs(vector<int> &dbIdList) {
 
 	Logger::getLogger()->debug("getAllDbs - used db");
 
-	for (auto &item : m_AssetReadingCatalogue) {
-
-		dbId = item.second.second;
-		if (dbId > 1)
+	{
+		lock_guard<mutex> guard(m_partitionsLock);
+		for (auto catalogue : getAllCatalogues())
 		{
-			if (std::find(dbIdList.begin(), dbIdList.end(), dbId) ==  dbIdList.end() )
-			{
-				dbIdList.push_back(dbId);
-				Logger::getLogger()->debug("getAllDbs  DB :%d:", dbId);
-			}
+			for (auto &item : *catalogue) {
+
+				dbId = item.second.second;
+				if (dbId > 1)
+				{
+					if (std::find(dbIdList.begin(), dbIdList.end(), dbId) ==  dbIdList.end() )
+					{
+						dbIdList.push_back(dbId);
+						Logger::getLogger()->debug("getAllDbs  DB :%d:", dbId);
+					}
 
+				}
+			}
 		}
 	}
 
@@ -586,6 +647,10 @@ void ReadingsCatalogue::getNewDbs(vector<int> &dbIdList) {
 /**
  * Enable WAL on the provided database file
  *
+ * A new database is also set to auto_vacuum INCREMENTAL, so that the
+ * pages freed by the purges can be released by ReadingsVacuum. SQLite
+ * ignores the setting for a database that already has tables.
+ *
  * @param    dbPathReadings	Database path for which the WAL must be enabled
  *
  */
@@ -604,8 +669,13 @@ bool ReadingsCatalogue::enableWAL(string &dbPathReadings) {
 	}
 	else
 	{
-		// Enables the WAL feature
-		rc = sqlite3_exec(dbHandle, DB_CONFIGURATION, NULL, NULL, NULL);
+		// auto_vacuum must be set before the tables are created
+		rc = sqlite3_exec(dbHandle, "PRAGMA auto_vacuum = INCREMENTAL;", NULL, NULL, NULL);
+		if (rc == SQLITE_OK)
+		{
+			// Enables the WAL feature
+			rc = sqlite3_exec(dbHandle, DB_CONFIGURATION, NULL, NULL, NULL);
+		}
 		if (rc != SQLITE_OK)
 		{
 			raiseError("enableWAL", sqlite3_errmsg(dbHandle));
@@ -642,6 +712,10 @@ bool ReadingsCatalogue::attachDb(sqlite3 *dbHandle, std::string &path, std::stri
 		sqlite3_free(zErrMsg);
 		result = false;
 	}
+	else
+	{
+		PragmaConfiguration::getInstance()->applyDatabase(dbHandle, alias);
+	}
 
 	return (result);
 }
@@ -658,6 +732,9 @@ void ReadingsCatalogue::detachDb(sqlite3 *dbHandle, std::string &alias)
 	std::string sqlCmd;
 	char *zErrMsg = nullptr;
 
+	// Statements prepared against the database must be discarded
+	invalidateStatements();
+
 	sqlCmd = "DETACH  DATABASE " + alias + ";";
 
 	Logger::getLogger()->debug("%s - db :%s: cmd :%s:" ,__FUNCTION__,  alias.c_str() , sqlCmd.c_str() );
@@ -818,6 +895,8 @@ void ReadingsCatalogue::multipleReadingsInit(STORAGE_CONFIGURATION &storageConfi
 
 	m_storageConfigCurrent.nDbLeftFreeBeforeAllocate = storageConfig.nDbLeftFreeBeforeAllocate;
 	m_storageConfigCurrent.nDbToAllocate = storageConfig.nDbToAllocate;
+	m_storageConfigCurrent.partitionInterval = storageConfig.partitionInterval;
+	m_storageConfigCurrent.timestampIndex = storageConfig.timestampIndex;
 
 	try
 	{
@@ -844,7 +923,26 @@ void ReadingsCatalogue::multipleReadingsInit(STORAGE_CONFIGURATION &storageConfi
 
 		preallocateReadingsTables(0);   // on the last database
 
+		applyReadingsIndexes(dbHandle);
+
+		applyTimestampStorage(dbHandle);
+
+		// The last database was closed with its partition, new assets must use a new one
+		if (isPartitionDb(m_dbIdCurrent))
+		{
+			m_nReadingsAvailable = 0;
+		}
+		if (m_storageConfigCurrent.partitionInterval > 0)
+		{
+			m_partitionEnd = nextPartitionEnd(time(NULL));
+			Logger::getLogger()->info("Readings partitioned every %d seconds, partitions closed :%d:",
+						  m_storageConfigCurrent.partitionInterval,
+						  (int) m_partitions.size());
+		}
+
 		evaluateGlobalId();
+
+		refreshIdRanges(dbHandle);
 	}
 	catch (exception& e)
 	{
@@ -998,6 +1096,10 @@ void ReadingsCatalogue::configChangeAddTables(sqlite3 *dbHandle, int startId, in
 
 	for (dbId = 1; dbId <= m_dbIdLast ; dbId++ )
 	{
+		// Skips the databases removed with their partition
+		if (dbId > 1 && std::find(m_dbIdList.begin(), m_dbIdList.end(), dbId) == m_dbIdList.end())
+			continue;
+
 		Logger::getLogger()->debug("%s - configChangeAddTables - dbId :%d: startId :%d: nTables :%d:",
 								   __FUNCTION__,
 								   dbId,
@@ -1037,6 +1139,10 @@ void ReadingsCatalogue::configChangeRemoveTables(sqlite3 *dbHandle, int startId,
 
 	for (dbId = 1; dbId <= m_dbIdLast ; dbId++ )
 	{
+		// Skips the databases removed with their partition
+		if (dbId > 1 && std::find(m_dbIdList.begin(), m_dbIdList.end(), dbId) == m_dbIdList.end())
+			continue;
+
 		Logger::getLogger()->debug("%s - configChangeRemoveTables - dbId :%d: startId :%d: endId :%d:",
 								   __FUNCTION__,
 								   dbId,
@@ -1080,12 +1186,14 @@ void  ReadingsCatalogue::dropReadingsTables(sqlite3 *dbHandle, int dbId, int idS
 
 	dbName = generateDbName(dbId);
 
+	invalidateStatements();
+
 	for (idx = idStart ; idx <= idEnd; ++idx)
 	{
 		tableName = generateReadingsName(dbId, idx);
 
 		dropReadings = "DROP TABLE " + dbName + "." + tableName + ";";
-		dropIdx      = "DROP INDEX " + tableName + "_ix3;";
+		dropIdx      = "DROP INDEX IF EXISTS " + tableName + "_ix3;";
 
 
 		rc = SQLExec(dbHandle, dropIdx.c_str());
@@ -1470,7 +1578,8 @@ bool ReadingsCatalogue::latestDbUpdate(sqlite3 *dbHandle, int newDbId)
 	Logger::getLogger()->debug("latestDbUpdate - dbHandle :%X: newDbId :%d:", dbHandle, newDbId);
 
 	{
-		sql_cmd = " UPDATE " READINGS_DB ".configuration_readings SET db_id_Last=" + to_string(newDbId) + ";";
+		// A database created in the background may be recorded after a later one
+		sql_cmd = " UPDATE " READINGS_DB ".configuration_readings SET db_id_Last=MAX(db_id_Last, " + to_string(newDbId) + ");";
 
 		if (SQLExec(dbHandle, sql_cmd.c_str()) != SQLITE_OK)
 		{
@@ -1489,10 +1598,11 @@ bool ReadingsCatalogue::latestDbUpdate(sqlite3 *dbHandle, int newDbId)
  * @param newDbId      If of the created database to create
  * @param startId      Starting id for the creation of the reading tables
  * @param attachAllDb  Type of attache operation to apply on the newly created database
+ * @param recordLast   Record the database as the last created, the caller records it otherwise
  * @return             True of success, false on any error
  *
  */
-bool  ReadingsCatalogue::createNewDB(sqlite3 *dbHandle, int newDbId, int startId, NEW_DB_OPERATION attachAllDb)
+bool  ReadingsCatalogue::createNewDB(sqlite3 *dbHandle, int newDbId, int startId, NEW_DB_OPERATION attachAllDb, bool recordLast)
 {
 	int rc;
 	int nTables;
@@ -1538,7 +1648,10 @@ bool  ReadingsCatalogue::createNewDB(sqlite3 *dbHandle, int newDbId, int startId
 		}
 		enableWAL(dbPathReadings);
 
-		latestDbUpdate(dbHandle, newDbId);
+		if (recordLast)
+		{
+			latestDbUpdate(dbHandle, newDbId);
+		}
 
 	}
 	readingsToAllocate = getNReadingsAllocate();
@@ -1673,11 +1786,14 @@ bool  ReadingsCatalogue::createReadingsTables(sqlite3 *dbHandle, int dbId, int i
 			return false;
 		}
 
-		rc = SQLExec(dbHandle, createReadingsIdx.c_str());
-		if (rc != SQLITE_OK)
+		if (m_storageConfigCurrent.timestampIndex)
 		{
-			raiseError("createReadingsTables", sqlite3_errmsg(dbHandle));
-			return false;
+			rc = SQLExec(dbHandle, createReadingsIdx.c_str());
+			if (rc != SQLITE_OK)
+			{
+				raiseError("createReadingsTables", sqlite3_errmsg(dbHandle));
+				return false;
+			}
 		}
 	}
 	if (newConnection)
@@ -1688,6 +1804,159 @@ bool  ReadingsCatalogue::createReadingsTables(sqlite3 *dbHandle, int dbId, int i
 	return true;
 }
 
+/**
+ * Converts the timestamps of the readings tables of all the attached databases
+ * when their storage has changed, to integers or back to text. The storage in
+ * use is recorded as the user_version of the first readings database once all
+ * the tables are converted, a conversion that was interrupted is completed the
+ * next time the storage service starts. Converting a large database takes a while.
+ *
+ * @param dbHandle Database connection to use for the operations
+ *
+ */
+void ReadingsCatalogue::applyTimestampStorage(sqlite3 *dbHandle)
+{
+	ReadingsTimestamps *timestamps = ReadingsTimestamps::getInstance();
+	int wanted = timestamps->isEpoch() ? EPOCH_SCHEMA_VERSION : 0;
+	int current = 0;
+	sqlite3_stmt *stmt;
+
+	if (sqlite3_prepare_v2(dbHandle, "PRAGMA " READINGS_DB ".user_version;", -1, &stmt, NULL) == SQLITE_OK)
+	{
+		if (sqlite3_step(stmt) == SQLITE_ROW)
+		{
+			current = sqlite3_column_int(stmt, 0);
+		}
+		sqlite3_finalize(stmt);
+	}
+	if (current == wanted)
+	{
+		return;
+	}
+
+	Logger::getLogger()->info("applyTimestampStorage - converting the timestamps of the readings to %s",
+				  wanted ? "microseconds since the epoch" : "text");
+
+	vector<string> dbNames;
+	if (sqlite3_prepare_v2(dbHandle, "PRAGMA database_list;", -1, &stmt, NULL) == SQLITE_OK)
+	{
+		while (sqlite3_step(stmt) == SQLITE_ROW)
+		{
+			const char *name = (const char *)sqlite3_column_text(stmt, 1);
+			if (name && strncmp(name, "readings_", 9) == 0)
+			{
+				dbNames.push_back(name);
+			}
+		}
+		sqlite3_finalize(stmt);
+	}
+
+	bool converted = true;
+	for (auto &dbName : dbNames)
+	{
+		string sql_cmd = "SELECT name FROM " + dbName + ".sqlite_master"
+				 " WHERE type = 'table' AND name GLOB 'readings_[0-9]*_[0-9]*';";
+
+		vector<string> tables;
+		if (sqlite3_prepare_v2(dbHandle, sql_cmd.c_str(), -1, &stmt, NULL) != SQLITE_OK)
+		{
+			raiseError("applyTimestampStorage", sqlite3_errmsg(dbHandle));
+			converted = false;
+			continue;
+		}
+		while (sqlite3_step(stmt) == SQLITE_ROW)
+		{
+			tables.push_back((const char *)sqlite3_column_text(stmt, 0));
+		}
+		sqlite3_finalize(stmt);
+
+		for (auto &table : tables)
+		{
+			if (! timestamps->convert(dbHandle, dbName + "." + table))
+			{
+				converted = false;
+			}
+		}
+	}
+
+	if (converted)
+	{
+		string sql_cmd = "PRAGMA " READINGS_DB ".user_version = " + to_string(wanted) + ";";
+		if (SQLExec(dbHandle, sql_cmd.c_str()) != SQLITE_OK)
+		{
+			raiseError("applyTimestampStorage", sqlite3_errmsg(dbHandle));
+		}
+	}
+}
+
+/**
+ * Creates or drops the user_ts index of the readings tables of all the attached
+ * databases, so that the tables created before the index setting last changed
+ * follow it. Creating the index of a large table takes a while, it is only
+ * done when the setting changes.
+ *
+ * @param dbHandle Database connection to use for the operations
+ *
+ */
+void ReadingsCatalogue::applyReadingsIndexes(sqlite3 *dbHandle)
+{
+	vector<string> dbNames;
+	sqlite3_stmt *stmt;
+
+	if (sqlite3_prepare_v2(dbHandle, "PRAGMA database_list;", -1, &stmt, NULL) == SQLITE_OK)
+	{
+		while (sqlite3_step(stmt) == SQLITE_ROW)
+		{
+			const char *name = (const char *)sqlite3_column_text(stmt, 1);
+			if (name && strncmp(name, "readings_", 9) == 0)
+			{
+				dbNames.push_back(name);
+			}
+		}
+		sqlite3_finalize(stmt);
+	}
+
+	for (auto &dbName : dbNames)
+	{
+		// The readings tables without the index asked for, or with the index not wanted
+		string sql_cmd = "SELECT t.name FROM " + dbName + ".sqlite_master t"
+				 " WHERE t.type = 'table' AND t.name GLOB 'readings_[0-9]*_[0-9]*'"
+				 " AND " + (m_storageConfigCurrent.timestampIndex ? "NOT " : "") + "EXISTS"
+				 " (SELECT 1 FROM " + dbName + ".sqlite_master i"
+				 " WHERE i.type = 'index' AND i.name = t.name || '_ix3');";
+
+		vector<string> tables;
+		if (sqlite3_prepare_v2(dbHandle, sql_cmd.c_str(), -1, &stmt, NULL) != SQLITE_OK)
+		{
+			raiseError("applyReadingsIndexes", sqlite3_errmsg(dbHandle));
+			continue;
+		}
+		while (sqlite3_step(stmt) == SQLITE_ROW)
+		{
+			tables.push_back((const char *)sqlite3_column_text(stmt, 0));
+		}
+		sqlite3_finalize(stmt);
+
+		for (auto &table : tables)
+		{
+			if (m_storageConfigCurrent.timestampIndex)
+			{
+				Logger::getLogger()->info("applyReadingsIndexes - creating the index on user_ts of :%s.%s:", dbName.c_str(), table.c_str());
+				sql_cmd = "CREATE INDEX IF NOT EXISTS " + dbName + "." + table + "_ix3 ON " + table + " (user_ts);";
+			}
+			else
+			{
+				Logger::getLogger()->info("applyReadingsIndexes - dropping the index on user_ts of :%s.%s:", dbName.c_str(), table.c_str());
+				sql_cmd = "DROP INDEX IF EXISTS " + dbName + "." + table + "_ix3;";
+			}
+			if (SQLExec(dbHandle, sql_cmd.c_str()) != SQLITE_OK)
+			{
+				raiseError("applyReadingsIndexes", sqlite3_errmsg(dbHandle));
+			}
+		}
+	}
+}
+
 /**
  * Evaluates the latest reading table defined in the provided database id looking at sqlite_master, the SQLite repository
  *
@@ -1731,7 +2000,7 @@ ReadingsCatalogue::tyReadingsAvailable  ReadingsCatalogue::evaluateLastReadingAv
 	string sql_cmd = R"(
 		SELECT name
 		FROM  )" + dbName +  R"(.sqlite_master
-		WHERE type='table' and name like 'readings_%';
+		WHERE type='table' and name GLOB 'readings_[0-9]*_[0-9]*';
 	)";
 
 	if (sqlite3_prepare_v2(dbHandle,sql_cmd.c_str(),-1, &stmt,NULL) != SQLITE_OK)
@@ -1791,6 +2060,109 @@ void  ReadingsCatalogue::allocateReadingAvailable()
 	m_nReadingsAvailable--;
 }
 
+/**
+ * Moves the allocation of the readings tables to the next database,
+ * new databases are created when the ones available are exhausted
+ *
+ * @param    dbHandle	Database connection to use for the operations
+ * @return              True of success, false on any error
+ */
+bool ReadingsCatalogue::allocateNewDb(sqlite3 *dbHandle)
+{
+	bool success = true;
+	int startReadingsId;
+	tyReadingsAvailable readingsAvailable;
+
+	Logger::getLogger()->debug("allocateNewDb - allocate a new db, dbNAvailable :%d:", m_dbNAvailable);
+
+	if (m_dbNAvailable > 0)
+	{
+		// DBs already created are available
+		m_dbIdCurrent++;
+		m_dbNAvailable--;
+		m_nReadingsAvailable = getNReadingsAllocate();
+
+		Logger::getLogger()->debug("allocateNewDb - allocate a new db, db already available - dbIdCurrent :%d: dbIdLast :%d: dbNAvailable  :%d: nReadingsAvailable :%d:  ", m_dbIdCurrent, m_dbIdLast, m_dbNAvailable, m_nReadingsAvailable);
+	}
+	else
+	{
+		// Allocates new DBs
+		int dbId, dbIdStart, dbIdEnd;
+
+		dbIdStart = m_dbIdLast +1;
+		dbIdEnd = m_dbIdLast + m_storageConfigCurrent.nDbToAllocate;
+
+		Logger::getLogger()->debug("allocateNewDb - allocate a new db - create new db - dbIdCurrent :%d: dbIdStart :%d: dbIdEnd :%d:", m_dbIdCurrent, dbIdStart, dbIdEnd);
+
+		for (dbId = dbIdStart; dbId <= dbIdEnd; dbId++)
+		{
+			readingsAvailable = evaluateLastReadingAvailable(dbHandle, dbId - 1);
+
+			startReadingsId = 1;
+
+			success = createNewDB(dbHandle,  dbId, startReadingsId, NEW_DB_ATTACH_REQUEST);
+			if (success)
+			{
+				Logger::getLogger()->debug("allocateNewDb - allocate a new db - create new dbs - dbId :%d: startReadingsIdOnDB :%d:", dbId, startReadingsId);
+			}
+		}
+		m_dbIdLast = dbIdEnd;
+		m_dbIdCurrent++;
+		m_dbNAvailable = (m_dbIdLast - m_dbIdCurrent) - m_storageConfigCurrent.nDbLeftFreeBeforeAllocate;
+	}
+
+	// Restores the free databases before they are needed again
+	ReadingsAllocator::getInstance()->notify();
+
+	return success;
+}
+
+/**
+ * Creates new databases, with their readings tables, until the given number
+ * of free databases is available. The databases are attached to the given
+ * connection and queued for the attach of the other connections.
+ * Must be called holding the AttachDbSync lock.
+ *
+ * The last database created is not recorded in the configuration of the
+ * readings, a connection appending readings may hold the write lock of the
+ * first readings database whilst it waits for the AttachDbSync lock. The
+ * caller records it with latestDbUpdate once it has released the lock.
+ *
+ * @param    dbHandle	Database connection to use for the operations
+ * @param    headroom	The number of free databases required
+ * @return              The number of databases created
+ */
+int ReadingsCatalogue::preallocateHeadroom(sqlite3 *dbHandle, int headroom)
+{
+	int dbId, dbIdEnd;
+	int created = 0;
+
+	if (m_dbNAvailable >= headroom)
+		return 0;
+
+	dbIdEnd = m_dbIdLast + (headroom - m_dbNAvailable);
+
+	Logger::getLogger()->debug("preallocateHeadroom - dbIdCurrent :%d: dbIdStart :%d: dbIdEnd :%d:", m_dbIdCurrent, m_dbIdLast + 1, dbIdEnd);
+
+	// createNewDB resets the tables available, those of the database in use must be kept
+	int nReadingsAvailable = m_nReadingsAvailable;
+
+	for (dbId = m_dbIdLast + 1; dbId <= dbIdEnd; dbId++)
+	{
+		if (! createNewDB(dbHandle, dbId, 1, NEW_DB_ATTACH_REQUEST, false))
+		{
+			Logger::getLogger()->error("preallocateHeadroom - unable to create the readings database :%d:", dbId);
+			break;
+		}
+		m_dbIdLast = dbId;
+		created++;
+	}
+	m_nReadingsAvailable = nReadingsAvailable;
+	m_dbNAvailable = (m_dbIdLast - m_dbIdCurrent) - m_storageConfigCurrent.nDbLeftFreeBeforeAllocate;
+
+	return created;
+}
+
 /**
  * Allocates a reading table to the given asset_code
  *
@@ -1810,9 +2182,6 @@ ReadingsCatalogue::tyReadingReference  ReadingsCatalogue::getReadingReference(Co
 	string msg;
 	bool success;
 
-	int startReadingsId;
-	tyReadingsAvailable readingsAvailable;
-
 	ostringstream threadId;
 	threadId << std::this_thread::get_id();
 
@@ -1822,8 +2191,17 @@ ReadingsCatalogue::tyReadingReference  ReadingsCatalogue::getReadingReference(Co
 
 	Logger *logger = Logger::getLogger();
 
-	auto item = m_AssetReadingCatalogue.find(asset_code);
-	if (item != m_AssetReadingCatalogue.end())
+	if (m_storageConfigCurrent.partitionInterval > 0 && time(NULL) >= m_partitionEnd)
+	{
+		AttachDbSync *attachSync = AttachDbSync::getInstance();
+		attachSync->lock();
+		rollPartition(dbHandle);
+		attachSync->unlock();
+	}
+
+	shared_ptr<const tyAssetLookup> lookup = atomic_load(&m_assetLookup);
+	auto item = lookup ? lookup->find(asset_code) : tyAssetLookup::const_iterator();
+	if (lookup && item != lookup->end())
 	{
 		//# An asset already  managed
 		ref.tableId = item->second.first;
@@ -1847,43 +2225,7 @@ ReadingsCatalogue::tyReadingReference  ReadingsCatalogue::getReadingReference(Co
 			//# Allocate a new block of readings table
 			if (! isReadingAvailable () )
 			{
-				Logger::getLogger()->debug("getReadingReference - allocate a new db, dbNAvailable :%d:", m_dbNAvailable);
-
-				if (m_dbNAvailable > 0)
-				{
-					// DBs already created are available
-					m_dbIdCurrent++;
-					m_dbNAvailable--;
-					m_nReadingsAvailable = getNReadingsAllocate();
-
-					Logger::getLogger()->debug("getReadingReference - allocate a new db, db already available - dbIdCurrent :%d: dbIdLast :%d: dbNAvailable  :%d: nReadingsAvailable :%d:  ", m_dbIdCurrent, m_dbIdLast, m_dbNAvailable, m_nReadingsAvailable);
-				}
-				else
-				{
-					// Allocates new DBs
-					int dbId, dbIdStart, dbIdEnd;
-
-					dbIdStart = m_dbIdLast +1;
-					dbIdEnd = m_dbIdLast + m_storageConfigCurrent.nDbToAllocate;
-
-					Logger::getLogger()->debug("getReadingReference - allocate a new db - create new db - dbIdCurrent :%d: dbIdStart :%d: dbIdEnd :%d:", m_dbIdCurrent, dbIdStart, dbIdEnd);
-
-					for (dbId = dbIdStart; dbId <= dbIdEnd; dbId++)
-					{
-						readingsAvailable = evaluateLastReadingAvailable(dbHandle, dbId - 1);
-
-						startReadingsId = 1;
-
-						success = createNewDB(dbHandle,  dbId, startReadingsId, NEW_DB_ATTACH_REQUEST);
-						if (success)
-						{
-							Logger::getLogger()->debug("getReadingReference - allocate a new db - create new dbs - dbId :%d: startReadingsIdOnDB :%d:", dbId, startReadingsId);
-						}
-					}
-					m_dbIdLast = dbIdEnd;
-					m_dbIdCurrent++;
-					m_dbNAvailable = (m_dbIdLast - m_dbIdCurrent) - m_storageConfigCurrent.nDbLeftFreeBeforeAllocate;
-				}
+				success = allocateNewDb(dbHandle);
 
 				ref.tableId = -1;
 				ref.dbId = -1;
@@ -1901,6 +2243,13 @@ ReadingsCatalogue::tyReadingReference  ReadingsCatalogue::getReadingReference(Co
 						auto newItem = make_pair(ref.tableId, ref.dbId);
 						auto newMapValue = make_pair(asset_code, newItem);
 						m_AssetReadingCatalogue.insert(newMapValue);
+						publishAssetLookup();
+					}
+
+					// The new table is empty, its range is extended by the appends
+					{
+						lock_guard<mutex> guard(m_idRangesLock);
+						m_idRanges[make_pair(ref.dbId, ref.tableId)] = {1, 0};
 					}
 
 					Logger::getLogger()->debug("getReadingReference - allocate a new reading table for the asset :%s: db Id :%d: readings Id :%d: ", asset_code, ref.dbId, ref.tableId);
@@ -2013,76 +2362,173 @@ int ReadingsCatalogue::getUsedTablesDbId(int dbId)
 /**
  * Delete the content of all the active readings tables using the provided sql command sqlCmdBase
  *
+ * The tables of different databases can be written at the same time by different
+ * connections. When the purge is configured with several threads, the commands of
+ * each database are executed by one of a set of threads, each with its own connection
+ * from the pool, the first thread using the connection of the caller.
+ *
  * @param dbHandle     Database connection to use for the operations
  * @param sqlCmdBase   Sql command to execute
  * @param zErrMsg      value returned by reference, Error message
  * @param rowsAffected value returned by reference if != 0, Number of affected rows
+ * @param idTo         Highest id affected by the sql command, the tables holding only higher ids are skipped
  * @return             returns SQLITE_OK if all the sql commands are properly executed
  *
  */
-int  ReadingsCatalogue::purgeAllReadings(sqlite3 *dbHandle, const char *sqlCmdBase, char **zErrMsg, unsigned long *rowsAffected)
+int  ReadingsCatalogue::purgeAllReadings(sqlite3 *dbHandle, const char *sqlCmdBase, char **zErrMsg, unsigned long *rowsAffected, unsigned long idTo)
 {
 	string dbReadingsName;
 	string dbName;
 	string sqlCmdTmp;
-	string sqlCmd;
-	bool firstRow;
 	int rc;
+	// The commands of each database
+	map<int, vector<string>> sqlCmds;
 
-	if (m_AssetReadingCatalogue.empty())
-	{
-		Logger::getLogger()->debug("purgeAllReadings: no tables defined");
-		rc = SQLITE_OK;
-	}
-	else
+	// The commands are prepared holding the lock on the partitions,
+	// their execution must not block the readers
 	{
-		Logger::getLogger()->debug("purgeAllReadings tables defined");
+		lock_guard<mutex> guard(m_partitionsLock);
 
 		PurgeConfiguration *purgeConfig = PurgeConfiguration::getInstance();
 		bool exclusions = purgeConfig->hasExclusions();
 
-		firstRow = true;
-		if  (rowsAffected != nullptr)
-			*rowsAffected = 0;
-
-		for (auto &item : m_AssetReadingCatalogue)
+		for (auto catalogue : getAllCatalogues())
 		{
-			if (exclusions && purgeConfig->isExcluded(item.first))
+			for (auto &item : *catalogue)
 			{
-				Logger::getLogger()->info("Asset %s excluded from purge", item.first.c_str());
-				continue;
-			}
-			sqlCmdTmp = sqlCmdBase;
-
-			dbName = generateDbName(item.second.second);
-			dbReadingsName = generateReadingsName(item.second.second, item.second.first);
-
-			StringReplaceAll (sqlCmdTmp, "_assetcode_", item.first);
-			StringReplaceAll (sqlCmdTmp, "_dbname_", dbName);
-			StringReplaceAll (sqlCmdTmp, "_tablename_", dbReadingsName);
-			sqlCmd += sqlCmdTmp;
-			firstRow = false;
-
-			rc = SQLExec(dbHandle, sqlCmdTmp.c_str(), zErrMsg);
-
-			Logger::getLogger()->debug("purgeAllReadings:  rc :%d: cmd :%s:", rc ,sqlCmdTmp.c_str() );
+				if (exclusions && purgeConfig->isExcluded(item.first))
+				{
+					Logger::getLogger()->info("Asset %s excluded from purge", item.first.c_str());
+					continue;
+				}
+				if (idTo != ULONG_MAX && ! overlapsIdRange(item.second.second, item.second.first, 0, idTo))
+				{
+					continue;
+				}
+				sqlCmdTmp = sqlCmdBase;
 
-			if (rc != SQLITE_OK)
-			{
-				sqlite3_free(zErrMsg);
-				break;
-			}
-			if  (rowsAffected != nullptr) {
+				dbName = generateDbName(item.second.second);
+				dbReadingsName = generateReadingsName(item.second.second, item.second.first);
 
-				*rowsAffected += (unsigned long ) sqlite3_changes(dbHandle);
+				StringReplaceAll (sqlCmdTmp, "_assetcode_", item.first);
+				StringReplaceAll (sqlCmdTmp, "_dbname_", dbName);
+				StringReplaceAll (sqlCmdTmp, "_tablename_", dbReadingsName);
+				sqlCmds[item.second.second].push_back(sqlCmdTmp);
 			}
-
 		}
 	}
 
-	return(rc);
-
-}
+	if  (rowsAffected != nullptr)
+		*rowsAffected = 0;
+
+	if (sqlCmds.empty())
+	{
+		Logger::getLogger()->debug("purgeAllReadings: no tables defined");
+		return SQLITE_OK;
+	}
+
+	Logger::getLogger()->debug("purgeAllReadings tables defined");
+
+	unsigned int nThreads = min((unsigned int)sqlCmds.size(), PurgeConfiguration::getInstance()->getThreads());
+	if (nThreads <= 1)
+	{
+		rc = SQLITE_OK;
+		for (auto &db : sqlCmds)
+		{
+			rc = purgeTables(dbHandle, db.second, zErrMsg, rowsAffected);
+			if (rc != SQLITE_OK)
+				break;
+		}
+		return rc;
+	}
+
+	// The databases are shared between the threads in turn
+	vector<vector<string>> threadCmds(nThreads);
+	unsigned int n = 0;
+	for (auto &db : sqlCmds)
+	{
+		vector<string>& cmds = threadCmds[n++ % nThreads];
+		cmds.insert(cmds.end(), db.second.begin(), db.second.end());
+	}
+
+	ConnectionManager *manager = ConnectionManager::getInstance();
+	vector<Connection *> connections;
+	vector<thread> threads;
+	vector<int> results(nThreads, SQLITE_OK);
+	vector<char *> errors(nThreads, NULL);
+	vector<unsigned long> affected(nThreads, 0);
+	for (unsigned int i = 1; i < nThreads; i++)
+	{
+		Connection *connection = manager->allocate();
+		connection->attachPendingDbs();
+		connections.push_back(connection);
+		threads.push_back(thread([this, connection, i, &threadCmds, &results, &errors, &affected]() {
+			results[i] = purgeTables(connection->getDbHandle(), threadCmds[i], &errors[i], &affected[i]);
+		}));
+	}
+	results[0] = purgeTables(dbHandle, threadCmds[0], &errors[0], &affected[0]);
+	for (auto &t : threads)
+	{
+		t.join();
+	}
+	for (auto connection : connections)
+	{
+		manager->release(connection);
+	}
+
+	rc = SQLITE_OK;
+	for (unsigned int i = 0; i < nThreads; i++)
+	{
+		if  (rowsAffected != nullptr)
+			*rowsAffected += affected[i];
+		if (results[i] != SQLITE_OK && rc == SQLITE_OK)
+		{
+			rc = results[i];
+			if (zErrMsg)
+				*zErrMsg = errors[i];
+			else
+				sqlite3_free(errors[i]);
+		}
+		else
+		{
+			sqlite3_free(errors[i]);
+		}
+	}
+	Logger::getLogger()->debug("purgeAllReadings: %u threads purged %lu databases", nThreads, sqlCmds.size());
+
+	return(rc);
+}
+
+/**
+ * Execute the purge commands of a set of readings tables on one connection
+ *
+ * @param dbHandle     Database connection to use for the operations
+ * @param sqlCmds      The commands to execute
+ * @param zErrMsg      value returned by reference, Error message
+ * @param rowsAffected value updated if != 0, Number of affected rows
+ * @return             returns SQLITE_OK if all the sql commands are properly executed
+ */
+int  ReadingsCatalogue::purgeTables(sqlite3 *dbHandle, const vector<string>& sqlCmds, char **zErrMsg, unsigned long *rowsAffected)
+{
+	int rc = SQLITE_OK;
+
+	for (auto &sqlPurge : sqlCmds)
+	{
+		rc = SQLExec(dbHandle, sqlPurge.c_str(), zErrMsg);
+
+		Logger::getLogger()->debug("purgeAllReadings:  rc :%d: cmd :%s:", rc ,sqlPurge.c_str() );
+
+		if (rc != SQLITE_OK)
+		{
+			break;
+		}
+		if  (rowsAffected != nullptr) {
+
+			*rowsAffected += (unsigned long ) sqlite3_changes(dbHandle);
+		}
+	}
+	return rc;
+}
 
 /**
  * Constructs a sql command from the given one consisting of a set of UNION ALL commands
@@ -2091,10 +2537,16 @@ int  ReadingsCatalogue::purgeAllReadings(sqlite3 *dbHandle, const char *sqlCmdBa
  * @param sqlCmdBase        Base Sql command
  * @param assetCodes        Asset codes to evaluate for the operation
  * @param considerExclusion If True the asset code in the excluded list must not be considered
+ * @param idFrom            Lowest id considered by the sql command
+ * @param idTo              Highest id considered by the sql command
+ * @param excludeAssets     If True the tables of the asset codes given are the ones not considered
+ * @param tablesFound       If not NULL set to false if no table is considered and the
+ *                          command references a dummy table
  * @return                  Full sql command
  *
  */
-string  ReadingsCatalogue::sqlConstructMultiDb(string &sqlCmdBase, vector<string>  &assetCodes, bool considerExclusion)
+string  ReadingsCatalogue::sqlConstructMultiDb(string &sqlCmdBase, vector<string>  &assetCodes, bool considerExclusion, unsigned long idFrom, unsigned long idTo,
+		bool excludeAssets, bool *tablesFound)
 {
 	string dbReadingsName;
 	string dbName;
@@ -2103,12 +2555,22 @@ string  ReadingsCatalogue::sqlConstructMultiDb(string &sqlCmdBase, vector<string
 
 	string assetCode;
 	bool addTable;
-	bool addedOne;
+	bool addedOne = false;
 
-	if (m_AssetReadingCatalogue.empty())
+	string sqlBase = sqlCmdBase;
+	if (ReadingsCompression::getInstance()->isStored())
+	{
+		// Compressed readings are returned and evaluated as their JSON
+		sqlBase = ReadingsCompression::decodeReadings(sqlBase);
+	}
+
+	lock_guard<mutex> guard(m_partitionsLock);
+	vector<const tyAssetCatalogue *> catalogues = getAllCatalogues();
+
+	if (catalogues.empty())
 	{
 		Logger::getLogger()->debug("sqlConstructMultiDb: no tables defined");
-		sqlCmd = sqlCmdBase;
+		sqlCmd = sqlBase;
 
 		dbReadingsName = generateReadingsName(1, 1);
 
@@ -2127,46 +2589,57 @@ string  ReadingsCatalogue::sqlConstructMultiDb(string &sqlCmdBase, vector<string
 		PurgeConfiguration *purgeConfig = PurgeConfiguration::getInstance();
 		bool exclusions = purgeConfig->hasExclusions();
 
-		for (auto &item : m_AssetReadingCatalogue)
+		for (auto catalogue : catalogues)
 		{
-			assetCode=item.first;
-			addTable = false;
-
-			if (considerExclusion && exclusions && purgeConfig->isExcluded(item.first))
-			{
-				Logger::getLogger()->info("Asset %s excluded from the query on the multiple readings", item.first.c_str());
-				continue;
-			}
-
-			// Evaluates which tables should be referenced
-			if (assetCodes.empty())
-				addTable = true;
-			else
+			for (auto &item : *catalogue)
 			{
-				if (std::find(assetCodes.begin(), assetCodes.end(), assetCode) != assetCodes.end())
-					addTable = true;
-			}
+				assetCode=item.first;
+				addTable = false;
 
-			if (addTable)
-			{
-				addedOne = true;
+				if (considerExclusion && exclusions && purgeConfig->isExcluded(item.first))
+				{
+					Logger::getLogger()->info("Asset %s excluded from the query on the multiple readings", item.first.c_str());
+					continue;
+				}
 
-				sqlCmdTmp = sqlCmdBase;
+				// Evaluates which tables should be referenced
+				if (assetCodes.empty())
+					addTable = true;
+				else
+				{
+					if (std::find(assetCodes.begin(), assetCodes.end(), assetCode) != assetCodes.end())
+						addTable = true;
+					if (excludeAssets)
+						addTable = !addTable;
+				}
 
-				if (!firstRow)
+				// Tables not holding ids in the requested range are not referenced
+				if (addTable && (idFrom != 0 || idTo != ULONG_MAX))
 				{
-					sqlCmd += " UNION ALL ";
+					addTable = overlapsIdRange(item.second.second, item.second.first, idFrom, idTo);
 				}
 
-				dbName = generateDbName(item.second.second);
-				dbReadingsName = generateReadingsName(item.second.second, item.second.first);
+				if (addTable)
+				{
+					addedOne = true;
+
+					sqlCmdTmp = sqlBase;
 
-				StringReplaceAll(sqlCmdTmp, "_assetcode_", assetCode);
-				StringReplaceAll (sqlCmdTmp, ".assetcode.", "asset_code");
-				StringReplaceAll(sqlCmdTmp, "_dbname_", dbName);
-				StringReplaceAll(sqlCmdTmp, "_tablename_", dbReadingsName);
-				sqlCmd += sqlCmdTmp;
-				firstRow = false;
+					if (!firstRow)
+					{
+						sqlCmd += " UNION ALL ";
+					}
+
+					dbName = generateDbName(item.second.second);
+					dbReadingsName = generateReadingsName(item.second.second, item.second.first);
+
+					StringReplaceAll(sqlCmdTmp, "_assetcode_", assetCode);
+					StringReplaceAll (sqlCmdTmp, ".assetcode.", "asset_code");
+					StringReplaceAll(sqlCmdTmp, "_dbname_", dbName);
+					StringReplaceAll(sqlCmdTmp, "_tablename_", dbReadingsName);
+					sqlCmd += sqlCmdTmp;
+					firstRow = false;
+				}
 			}
 		}
 		// Add at least one table eventually a dummy one
@@ -2174,18 +2647,570 @@ string  ReadingsCatalogue::sqlConstructMultiDb(string &sqlCmdBase, vector<string
 		{
 			dbReadingsName = generateReadingsName(1, 1);
 
-			sqlCmd = sqlCmdBase;
+			sqlCmd = sqlBase;
 			StringReplaceAll (sqlCmd, "_assetcode_", "dummy_asset_code");
 			StringReplaceAll (sqlCmd, "_dbname_", READINGS_DB);
 			StringReplaceAll (sqlCmd, "_tablename_", dbReadingsName);
 		}
 	}
+	if (tablesFound)
+	{
+		*tablesFound = addedOne;
+	}
 
 	return(sqlCmd);
 
 }
 
 
+/**
+ * Returns the catalogue in use and the catalogues of the closed partitions,
+ * the caller must hold the lock on the partitions
+ *
+ * @return     Catalogues having at least one readings table
+ *
+ */
+vector<const ReadingsCatalogue::tyAssetCatalogue *> ReadingsCatalogue::getAllCatalogues()
+{
+	vector<const tyAssetCatalogue *> catalogues;
+
+	if (! m_AssetReadingCatalogue.empty())
+		catalogues.push_back(&m_AssetReadingCatalogue);
+
+	for (auto &partition : m_partitions)
+	{
+		if (! partition.second.empty())
+			catalogues.push_back(&partition.second);
+	}
+
+	return (catalogues);
+}
+
+/**
+ * Checks if the given database belongs to a closed partition
+ *
+ * @param dbId Database id to check
+ * @return     True if the database belongs to a closed partition
+ *
+ */
+bool ReadingsCatalogue::isPartitionDb(int dbId)
+{
+	lock_guard<mutex> guard(m_partitionsLock);
+
+	for (auto &partition : m_partitions)
+	{
+		for (auto &item : partition.second)
+		{
+			if (item.second.second == dbId)
+				return true;
+		}
+	}
+	return false;
+}
+
+/**
+ * Checks if there are closed partitions of the readings
+ *
+ * @return     True if at least one partition is closed
+ *
+ */
+bool ReadingsCatalogue::hasPartitions()
+{
+	lock_guard<mutex> guard(m_partitionsLock);
+
+	return (! m_partitions.empty());
+}
+
+/**
+ * Calculates the end of the partition that contains the given time,
+ * the partitions are aligned to the interval in UTC
+ *
+ * @param now  Time for which the partition must be evaluated
+ * @return     End time of the partition
+ *
+ */
+time_t ReadingsCatalogue::nextPartitionEnd(time_t now) const
+{
+	time_t interval = m_storageConfigCurrent.partitionInterval;
+
+	return ((now / interval + 1) * interval);
+}
+
+/**
+ * Loads the end time of the closed partitions, creating the table that holds them if needed
+ *
+ * @param dbHandle       Database connection to use for the operations
+ * @param dbPartitionEnd Returned by reference, end time of the partition of each closed database
+ * @return               True of success, false on any error
+ *
+ */
+bool ReadingsCatalogue::loadPartitions(sqlite3 *dbHandle, map<int, time_t> &dbPartitionEnd)
+{
+	sqlite3_stmt *stmt;
+	int rc;
+
+	const char *createPartitions = R"(
+		CREATE TABLE IF NOT EXISTS )" READINGS_DB R"(.readings_partition (
+			db_id      INTEGER   PRIMARY KEY,
+			end_ts     INTEGER   NOT NULL
+		);
+	)";
+
+	if (SQLExec(dbHandle, createPartitions) != SQLITE_OK)
+	{
+		raiseError("loadPartitions", sqlite3_errmsg(dbHandle));
+		return false;
+	}
+
+	const char *sql_cmd = R"(
+		SELECT
+			db_id,
+			end_ts
+		FROM  )" READINGS_DB R"(.readings_partition;
+	)";
+
+	if (sqlite3_prepare_v2(dbHandle, sql_cmd, -1, &stmt, NULL) != SQLITE_OK)
+	{
+		raiseError("loadPartitions", sqlite3_errmsg(dbHandle));
+		return false;
+	}
+
+	while ((rc = SQLStep(stmt)) == SQLITE_ROW)
+	{
+		dbPartitionEnd[sqlite3_column_int(stmt, 0)] = (time_t) sqlite3_column_int64(stmt, 1);
+	}
+	sqlite3_finalize(stmt);
+
+	Logger::getLogger()->debug("loadPartitions - closed databases :%d:", (int) dbPartitionEnd.size());
+
+	return true;
+}
+
+/**
+ * Return the number of databases attached to a connection
+ *
+ * @param dbHandle Database connection
+ * @return         The number of attached databases
+ */
+static int attachedDatabases(sqlite3 *dbHandle)
+{
+	int attached = 0;
+	sqlite3_stmt *stmt;
+
+	if (sqlite3_prepare_v2(dbHandle, "PRAGMA database_list;", -1, &stmt, NULL) == SQLITE_OK)
+	{
+		while (sqlite3_step(stmt) == SQLITE_ROW)
+		{
+			const char *name = (const char *)sqlite3_column_text(stmt, 1);
+			if (name && strcmp(name, "main") != 0 && strcmp(name, "temp") != 0)
+			{
+				attached++;
+			}
+		}
+		sqlite3_finalize(stmt);
+	}
+	return attached;
+}
+
+/**
+ * Closes the partition in use if its interval is elapsed, the readings of all
+ * the assets then move to tables allocated in a new database.
+ * The databases of the closed partitions stay attached until they are purged,
+ * if new databases are needed and would take the connections beyond the
+ * SQLite limit of attached databases the partition in use is extended instead.
+ * Must be called holding the AttachDbSync lock.
+ *
+ * @param dbHandle Database connection to use for the operations
+ *
+ */
+void ReadingsCatalogue::rollPartition(sqlite3 *dbHandle)
+{
+	string sql_cmd;
+	set<int> dbIds;
+	time_t now = time(NULL);
+
+	if (now < m_partitionEnd)
+		return;
+
+	m_partitionEnd = nextPartitionEnd(now);
+
+	if (m_AssetReadingCatalogue.empty())
+		return;
+
+	if (m_dbNAvailable <= 0)
+	{
+		int limit = sqlite3_limit(dbHandle, SQLITE_LIMIT_ATTACHED, -1);
+		int attached = attachedDatabases(dbHandle);
+		if (attached + m_storageConfigCurrent.nDbToAllocate > limit)
+		{
+			Logger::getLogger()->warn("Readings partition extended, %d databases are attached and at most %d can be attached, "
+						  "the purge by age must remove the oldest partitions",
+						  attached, limit);
+			return;
+		}
+	}
+
+	for (auto &item : m_AssetReadingCatalogue)
+		dbIds.insert(item.second.second);
+
+	for (int dbId : dbIds)
+	{
+		sql_cmd = "INSERT OR REPLACE INTO " READINGS_DB ".readings_partition (db_id, end_ts) VALUES ("
+			  + to_string(dbId) + ","
+			  + to_string(now) + ");";
+
+		if (SQLExec(dbHandle, sql_cmd.c_str()) != SQLITE_OK)
+		{
+			raiseError("rollPartition", sqlite3_errmsg(dbHandle));
+			return;
+		}
+	}
+
+	{
+		lock_guard<mutex> guard(m_partitionsLock);
+
+		m_partitions[now] = std::move(m_AssetReadingCatalogue);
+		m_AssetReadingCatalogue.clear();
+	}
+	publishAssetLookup();
+
+	allocateNewDb(dbHandle);
+
+	Logger::getLogger()->info("Readings partition closed, databases :%d: new database in use :%d:", (int) dbIds.size(), m_dbIdCurrent);
+}
+
+/**
+ * Removes the readings of a closed partition: the databases are detached and deleted,
+ * the tables of the first database, that holds the catalogue, are emptied.
+ * Must be called holding the AttachDbSync lock.
+ *
+ * @param dbHandle  Database connection to use for the operations
+ * @param partition Catalogue of the partition to remove
+ *
+ */
+void ReadingsCatalogue::dropPartition(sqlite3 *dbHandle, const tyAssetCatalogue &partition)
+{
+	string sql_cmd;
+	string dbIdsList;
+	set<int> dbIds;
+
+	ConnectionManager *manager = ConnectionManager::getInstance();
+
+	for (auto &item : partition)
+	{
+		if (item.second.second == 1)
+		{
+			sql_cmd = "DELETE FROM " READINGS_DB "." + generateReadingsName(1, item.second.first) + ";";
+			if (SQLExec(dbHandle, sql_cmd.c_str()) != SQLITE_OK)
+			{
+				raiseError("dropPartition", sqlite3_errmsg(dbHandle));
+			}
+		}
+		if (ReadingsBlobs::getInstance()->isStored())
+		{
+			sql_cmd = "DELETE FROM " READINGS_DB "." BLOBS_TABLE " WHERE db_id = " + to_string(item.second.second) +
+				  " AND table_id = " + to_string(item.second.first) + ";";
+			if (SQLExec(dbHandle, sql_cmd.c_str()) != SQLITE_OK)
+			{
+				raiseError("dropPartition", sqlite3_errmsg(dbHandle));
+			}
+		}
+		dbIds.insert(item.second.second);
+	}
+
+	{
+		lock_guard<mutex> guard(m_idRangesLock);
+		for (auto &item : partition)
+			m_idRanges.erase(make_pair(item.second.second, item.second.first));
+	}
+
+	for (int dbId : dbIds)
+	{
+		if (!dbIdsList.empty())
+			dbIdsList += ",";
+		dbIdsList += to_string(dbId);
+
+		if (dbId == 1)
+			continue;
+
+		string dbAlias = generateDbAlias(dbId);
+
+		Logger::getLogger()->info("dropPartition - removing database :%s:", dbAlias.c_str());
+
+		manager->detachNewDb(dbAlias);
+		try
+		{
+			dbFileDelete(generateDbFilePah(dbId));
+		}
+		catch (exception& e)
+		{
+			Logger::getLogger()->error("dropPartition - %s", e.what());
+		}
+
+		m_dbIdList.erase(std::remove(m_dbIdList.begin(), m_dbIdList.end(), dbId), m_dbIdList.end());
+	}
+	invalidateStatements();
+
+	sql_cmd = "DELETE FROM " READINGS_DB ".asset_reading_catalogue WHERE db_id IN (" + dbIdsList + ");";
+	if (SQLExec(dbHandle, sql_cmd.c_str()) != SQLITE_OK)
+	{
+		raiseError("dropPartition", sqlite3_errmsg(dbHandle));
+	}
+
+	sql_cmd = "DELETE FROM " READINGS_DB ".readings_partition WHERE db_id IN (" + dbIdsList + ");";
+	if (SQLExec(dbHandle, sql_cmd.c_str()) != SQLITE_OK)
+	{
+		raiseError("dropPartition", sqlite3_errmsg(dbHandle));
+	}
+}
+
+/**
+ * Removes the closed partitions whose readings are all older than the given age,
+ * the oldest partitions are removed first.
+ *
+ * A partition is retained if it contains an asset excluded from the purge or,
+ * when requested, readings not yet sent.
+ *
+ * @param dbHandle      Database connection to use for the operations
+ * @param age           Age in hours of the readings to remove
+ * @param sent          Id of the last reading sent
+ * @param retainUnsent  If true the readings not yet sent must be retained
+ * @param unsentPurged  Returned by reference, number of readings removed but not yet sent
+ * @return              Number of readings removed
+ *
+ */
+unsigned long ReadingsCatalogue::purgeExpiredPartitions(sqlite3 *dbHandle, unsigned long age, unsigned long sent, bool retainUnsent, unsigned long *unsentPurged)
+{
+	unsigned long removed = 0;
+	time_t cutoff = time(NULL) - (time_t) (age * 3600);
+
+	PurgeConfiguration *purgeConfig = PurgeConfiguration::getInstance();
+
+	*unsentPurged = 0;
+
+	AttachDbSync *attachSync = AttachDbSync::getInstance();
+	attachSync->lock();
+
+	// The partitions are changed only holding the AttachDbSync lock, they can be read here without the partitions lock
+	while (! m_partitions.empty() && m_partitions.begin()->first <= cutoff)
+	{
+		const tyAssetCatalogue &partition = m_partitions.begin()->second;
+		string sql_cmd;
+		bool excluded = false;
+
+		for (auto &item : partition)
+		{
+			if (purgeConfig->isExcluded(item.first))
+			{
+				excluded = true;
+				break;
+			}
+			sql_cmd += sql_cmd.empty() ? "" : " UNION ALL ";
+			sql_cmd += " SELECT id FROM " + generateDbName(item.second.second) + "." +
+				   generateReadingsName(item.second.second, item.second.first) + " ";
+		}
+		if (excluded)
+		{
+			Logger::getLogger()->info("purgeExpiredPartitions - partition retained, it contains assets excluded from the purge");
+			break;
+		}
+
+		unsigned long count = 0, maxId = 0, unsent = 0;
+		if (! sql_cmd.empty())
+		{
+			sqlite3_stmt *stmt;
+
+			sql_cmd = "SELECT COUNT(*), MAX(id), SUM(id > " + to_string(sent) + ") FROM (" + sql_cmd + ");";
+			if (sqlite3_prepare_v2(dbHandle, sql_cmd.c_str(), -1, &stmt, NULL) != SQLITE_OK)
+			{
+				raiseError("purgeExpiredPartitions", sqlite3_errmsg(dbHandle));
+				break;
+			}
+			if (SQLStep(stmt) == SQLITE_ROW)
+			{
+				count = (unsigned long) sqlite3_column_int64(stmt, 0);
+				maxId = (unsigned long) sqlite3_column_int64(stmt, 1);
+				unsent = (unsigned long) sqlite3_column_int64(stmt, 2);
+			}
+			sqlite3_finalize(stmt);
+		}
+
+		if (retainUnsent && maxId > sent)
+		{
+			Logger::getLogger()->info("purgeExpiredPartitions - partition retained, it contains readings not yet sent");
+			break;
+		}
+
+		dropPartition(dbHandle, partition);
+
+		{
+			lock_guard<mutex> guard(m_partitionsLock);
+			m_partitions.erase(m_partitions.begin());
+		}
+
+		removed += count;
+		if (sent != 0)
+			*unsentPurged += unsent;
+
+		Logger::getLogger()->info("purgeExpiredPartitions - partition removed, readings :%lu:", count);
+	}
+
+	attachSync->unlock();
+
+	return (removed);
+}
+
+
+/**
+ * Extends the range of the ids stored in a readings table with the ids just inserted
+ *
+ * @param table  Qualified name of the readings table as <database>.<table>
+ * @param minId  Lowest id inserted
+ * @param maxId  Highest id inserted
+ *
+ */
+void ReadingsCatalogue::extendIdRange(const string &table, unsigned long minId, unsigned long maxId)
+{
+	string tableName = table.substr(table.find('.') + 1);
+	auto key = make_pair(extractDbIdFromName(tableName), extractReadingsIdFromName(tableName));
+
+	lock_guard<mutex> guard(m_idRangesLock);
+
+	// Tables without a range are always referenced
+	auto item = m_idRanges.find(key);
+	if (item == m_idRanges.end())
+		return;
+
+	tyIdRange &range = item->second;
+	if (range.minId > range.maxId)
+	{
+		range.minId = minId;
+		range.maxId = maxId;
+	}
+	else
+	{
+		range.minId = min(range.minId, minId);
+		range.maxId = max(range.maxId, maxId);
+	}
+}
+
+/**
+ * Checks if the range of the ids stored in a readings table overlaps the given one
+ *
+ * @param dbId    Database id of the readings table
+ * @param tableId Id of the readings table
+ * @param idFrom  Lowest id of the range
+ * @param idTo    Highest id of the range
+ * @return        True if the readings table may hold ids in the range
+ *
+ */
+bool ReadingsCatalogue::overlapsIdRange(int dbId, int tableId, unsigned long idFrom, unsigned long idTo)
+{
+	lock_guard<mutex> guard(m_idRangesLock);
+
+	auto item = m_idRanges.find(make_pair(dbId, tableId));
+	if (item == m_idRanges.end())
+		return true;
+
+	const tyIdRange &range = item->second;
+	if (range.minId > range.maxId)
+		return false;
+
+	return (range.minId <= idTo && range.maxId >= idFrom);
+}
+
+/**
+ * Returns the lowest id that may still be stored in a readings table, the rows with a
+ * lower id have been purged from the table.
+ *
+ * @param dbId    Database id of the table
+ * @param tableId Id of the table
+ * @return        The lowest id or 0 if the range of the ids of the table is not known
+ *
+ */
+unsigned long ReadingsCatalogue::getMinStoredId(int dbId, int tableId)
+{
+	lock_guard<mutex> guard(m_idRangesLock);
+
+	auto item = m_idRanges.find(make_pair(dbId, tableId));
+	if (item == m_idRanges.end())
+		return 0;
+
+	return item->second.minId;
+}
+
+/**
+ * Evaluates the ranges of the ids stored in all the readings tables, called at the start
+ * and after the purge to raise the lowest id of the tables.
+ *
+ * The rows of the transactions in progress are not visible to the evaluation,
+ * the lowest id is therefore never raised above the boundary of the transactions.
+ *
+ * @param dbHandle Database connection to use for the operations
+ *
+ */
+void ReadingsCatalogue::refreshIdRanges(sqlite3 *dbHandle)
+{
+	string sql_cmd;
+	sqlite3_stmt *stmt;
+	unsigned long safeId;
+
+	{
+		lock_guard<mutex> guard(m_partitionsLock);
+
+		for (auto catalogue : getAllCatalogues())
+		{
+			for (auto &item : *catalogue)
+			{
+				if (!sql_cmd.empty())
+					sql_cmd += " UNION ALL ";
+
+				sql_cmd += " SELECT " + to_string(item.second.second) + ", " + to_string(item.second.first) +
+					   ", MIN(id), MAX(id) FROM " + generateDbName(item.second.second) + "." +
+					   generateReadingsName(item.second.second, item.second.first) + " ";
+			}
+		}
+	}
+	if (sql_cmd.empty())
+		return;
+
+	safeId = m_tx.GetMinReadingId();
+	if (!safeId)
+	{
+		safeId = getGlobalId();
+	}
+
+	if (sqlite3_prepare_v2(dbHandle, sql_cmd.c_str(), -1, &stmt, NULL) != SQLITE_OK)
+	{
+		raiseError("refreshIdRanges", sqlite3_errmsg(dbHandle));
+		return;
+	}
+
+	while (SQLStep(stmt) == SQLITE_ROW)
+	{
+		auto key = make_pair(sqlite3_column_int(stmt, 0), sqlite3_column_int(stmt, 1));
+		bool empty = sqlite3_column_type(stmt, 2) == SQLITE_NULL;
+		unsigned long minId = empty ? safeId : min((unsigned long) sqlite3_column_int64(stmt, 2), safeId);
+		unsigned long maxId = empty ? 0 : (unsigned long) sqlite3_column_int64(stmt, 3);
+
+		lock_guard<mutex> guard(m_idRangesLock);
+
+		auto item = m_idRanges.find(key);
+		if (item == m_idRanges.end())
+		{
+			m_idRanges[key] = {minId, maxId};
+		}
+		else
+		{
+			item->second.minId = max(item->second.minId, minId);
+			item->second.maxId = max(item->second.maxId, maxId);
+		}
+	}
+	sqlite3_finalize(stmt);
+
+	Logger::getLogger()->debug("refreshIdRanges - readings tables :%d: safe id :%lu:", (int) m_idRanges.size(), safeId);
+}
+
 /**
  * Generates a SQLIte db alis from the database id
  *
@@ -0,0 +1,431 @@
+/*
+ * Fledge storage service - Compressed storage of the readings
+ *
+ * Copyright (c) 2026 Dianomic Systems
+ *
+ * Released under the Apache 2.0 Licence
+ *
+ * Author: agent
+ */
+
+#include <readings_compression.h>
+#include <logger.h>
+#include <zlib.h>
+#include <string.h>
+#include <ctype.h>
+
+using namespace std;
+
+ReadingsCompression *ReadingsCompression::m_instance = 0;
+
+/**
+ * The zlib streams of a thread, initialised once and reset for each
+ * reading as initialising a stream allocates its window
+ */
+class ZStreams {
+	public:
+		ZStreams()
+		{
+			memset(&m_deflate, 0, sizeof(m_deflate));
+			memset(&m_inflate, 0, sizeof(m_inflate));
+			m_deflateOk = deflateInit2(&m_deflate, COMPRESSION_LEVEL, Z_DEFLATED,
+						-MAX_WBITS, 8, Z_DEFAULT_STRATEGY) == Z_OK;
+			m_inflateOk = inflateInit2(&m_inflate, -MAX_WBITS) == Z_OK;
+		};
+		~ZStreams()
+		{
+			if (m_deflateOk)
+				deflateEnd(&m_deflate);
+			if (m_inflateOk)
+				inflateEnd(&m_inflate);
+		};
+		z_stream	m_deflate;
+		z_stream	m_inflate;
+		bool		m_deflateOk;
+		bool		m_inflateOk;
+};
+
+static thread_local ZStreams zstreams;
+
+/**
+ * Constructor for the readings compression class
+ */
+ReadingsCompression::ReadingsCompression() : m_enabled(false), m_stored(false), m_nextId(1)
+{
+}
+
+/**
+ * Destructor for the readings compression class
+ */
+ReadingsCompression::~ReadingsCompression()
+{
+}
+
+/**
+ * Return the singleton instance of the ReadingsCompression class
+ * for this plugin
+ *
+ * @return ReadingsCompression* singleton instance
+ */
+ReadingsCompression *ReadingsCompression::getInstance()
+{
+	if (m_instance == 0)
+	{
+		m_instance = new ReadingsCompression();
+	}
+	return m_instance;
+}
+
+/**
+ * Set if the readings are stored compressed. Readings already stored
+ * are left as they are.
+ *
+ * @param enabled	True if the readings are stored compressed
+ */
+void ReadingsCompression::setEnabled(bool enabled)
+{
+	m_enabled = enabled;
+	if (enabled)
+	{
+		m_stored = true;
+		Logger::getLogger()->info("The readings will be stored compressed");
+	}
+}
+
+/**
+ * Compress the JSON of a reading with the dictionary of its asset,
+ * the JSON becomes the dictionary if the asset does not have one
+ *
+ * @param asset		The asset of the reading
+ * @param reading	The JSON of the reading
+ * @param compressed	Set to the compressed reading
+ * @param dictionary	Set to the id of the dictionary used
+ * @return bool		False if the reading should be stored as text
+ */
+bool ReadingsCompression::compress(const string& asset, const string& reading,
+				string& compressed, unsigned int& dictionary)
+{
+	const string *dict;
+	{
+		lock_guard<mutex> guard(m_mutex);
+		auto it = m_assets.find(asset);
+		if (it == m_assets.end())
+		{
+			dictionary = m_nextId++;
+			m_assets[asset] = dictionary;
+			m_dictionaries[dictionary] = make_pair(asset, reading.substr(0, DICTIONARY_SIZE));
+		}
+		else
+		{
+			dictionary = it->second;
+		}
+		dict = &m_dictionaries[dictionary].second;
+	}
+
+	z_stream *strm = &zstreams.m_deflate;
+	if (!zstreams.m_deflateOk || deflateReset(strm) != Z_OK
+			|| deflateSetDictionary(strm, (const Bytef *)dict->data(), dict->length()) != Z_OK)
+	{
+		return false;
+	}
+
+	// The dictionary id as a varint
+	compressed.clear();
+	unsigned int id = dictionary;
+	do {
+		unsigned char byte = id & 0x7f;
+		id >>= 7;
+		compressed.push_back((char)(id ? byte | 0x80 : byte));
+	} while (id);
+	size_t header = compressed.length();
+
+	compressed.resize(header + deflateBound(strm, reading.length()));
+	strm->next_in = (Bytef *)reading.data();
+	strm->avail_in = reading.length();
+	strm->next_out = (Bytef *)&compressed[header];
+	strm->avail_out = compressed.length() - header;
+	if (deflate(strm, Z_FINISH) != Z_STREAM_END)
+	{
+		return false;
+	}
+	compressed.resize(header + strm->total_out);
+	return compressed.length() < reading.length();
+}
+
+/**
+ * Return the JSON of a compressed reading
+ *
+ * @param data		The compressed reading
+ * @param length	The length of the compressed reading
+ * @param reading	Set to the JSON of the reading
+ * @return bool		False if the reading could not be decompressed
+ */
+bool ReadingsCompression::decompress(const void *data, size_t length, string& reading)
+{
+	const unsigned char *bytes = (const unsigned char *)data;
+	unsigned int id = 0;
+	size_t header = 0;
+	unsigned int shift = 0;
+	do {
+		if (header >= length || shift > 28)
+			return false;
+		id |= (bytes[header] & 0x7f) << shift;
+		shift += 7;
+	} while (bytes[header++] & 0x80);
+
+	const string *dict = findDictionary(id);
+	z_stream *strm = &zstreams.m_inflate;
+	if (!dict || !zstreams.m_inflateOk || inflateReset(strm) != Z_OK
+			|| inflateSetDictionary(strm, (const Bytef *)dict->data(), dict->length()) != Z_OK)
+	{
+		return false;
+	}
+	strm->next_in = (Bytef *)(bytes + header);
+	strm->avail_in = length - header;
+	reading.clear();
+	int rval;
+	do {
+		char buffer[4096];
+		strm->next_out = (Bytef *)buffer;
+		strm->avail_out = sizeof(buffer);
+		rval = inflate(strm, Z_NO_FLUSH);
+		if (rval != Z_OK && rval != Z_STREAM_END)
+		{
+			return false;
+		}
+		reading.append(buffer, sizeof(buffer) - strm->avail_out);
+	} while (rval != Z_STREAM_END);
+	return true;
+}
+
+/**
+ * Return a dictionary, to be stored with the readings that use it
+ *
+ * @param id		The id of the dictionary
+ * @param asset		Set to the asset of the dictionary
+ * @param dictionary	Set to the dictionary
+ * @return bool		False if there is no such dictionary
+ */
+bool ReadingsCompression::getDictionary(unsigned int id, string& asset, string& dictionary)
+{
+	lock_guard<mutex> guard(m_mutex);
+	auto it = m_dictionaries.find(id);
+	if (it == m_dictionaries.end())
+	{
+		return false;
+	}
+	asset = it->second.first;
+	dictionary = it->second.second;
+	return true;
+}
+
+/**
+ * Add a dictionary read from the table of the dictionaries. The last
+ * dictionary added for an asset is used to compress its readings.
+ *
+ * @param id		The id of the dictionary
+ * @param asset		The asset of the dictionary
+ * @param dictionary	The dictionary
+ */
+void ReadingsCompression::addDictionary(unsigned int id, const string& asset, const string& dictionary)
+{
+	lock_guard<mutex> guard(m_mutex);
+	m_dictionaries[id] = make_pair(asset, dictionary);
+	m_assets[asset] = id;
+	if (id >= m_nextId)
+	{
+		m_nextId = id + 1;
+	}
+	m_stored = true;
+}
+
+/**
+ * Return a dictionary used to decompress readings. Dictionaries are
+ * never removed, the pointer remains valid.
+ *
+ * @param id		The id of the dictionary
+ * @return string*	The dictionary or NULL if there is no such dictionary
+ */
+const string *ReadingsCompression::findDictionary(unsigned int id)
+{
+	lock_guard<mutex> guard(m_mutex);
+	auto it = m_dictionaries.find(id);
+	return it == m_dictionaries.end() ? NULL : &it->second.second;
+}
+
+/**
+ * Register the function that returns the JSON of a reading with a
+ * database connection
+ *
+ * @param db	The database connection
+ */
+void ReadingsCompression::registerFunction(sqlite3 *db)
+{
+	if (sqlite3_create_function(db, DECODE_FUNCTION, 1, SQLITE_UTF8 | SQLITE_DETERMINISTIC,
+				NULL, decode, NULL, NULL) != SQLITE_OK)
+	{
+		Logger::getLogger()->error("Unable to register the %s function: %s",
+				DECODE_FUNCTION, sqlite3_errmsg(db));
+	}
+}
+
+/**
+ * The reading_json SQL function, returns the JSON of a compressed
+ * reading and any other value unchanged
+ */
+void ReadingsCompression::decode(sqlite3_context *context, int argc, sqlite3_value **argv)
+{
+	if (sqlite3_value_type(argv[0]) != SQLITE_BLOB)
+	{
+		sqlite3_result_value(context, argv[0]);
+		return;
+	}
+	string reading;
+	if (!getInstance()->decompress(sqlite3_value_blob(argv[0]), sqlite3_value_bytes(argv[0]), reading))
+	{
+		sqlite3_result_error(context, "Unable to decompress a reading", -1);
+		return;
+	}
+	sqlite3_result_text(context, reading.data(), reading.length(), SQLITE_TRANSIENT);
+}
+
+/**
+ * Return true if the character may be part of an SQL identifier
+ */
+static bool identifierChar(char c)
+{
+	return isalnum((unsigned char)c) || c == '_' || c == '$';
+}
+
+/**
+ * Rewrite the SQL of a readings table so that every reference to the
+ * reading column is made through the reading_json function. A reading
+ * in the columns of a select is returned with the name reading, so that
+ * the queries that select from it see the JSON, and a reading in any
+ * other expression, such as the json_extract of an aggregate or of a
+ * where clause, is replaced by its JSON. Quoted strings, qualified names
+ * and the aliases of columns are left unchanged.
+ *
+ * @param sql	The SQL of a readings table
+ * @return	The SQL with the readings decoded
+ */
+string ReadingsCompression::decodeReadings(const string& sql)
+{
+	string	result;
+	vector<int> selects;	// The depth of each select whose columns are being parsed
+	int	depth = 0;
+	char	previous = 0;	// The last character that is not a space
+	string	lastWord;	// The last keyword or identifier
+	size_t	i = 0;
+
+	result.reserve(sql.length() + 64);
+	while (i < sql.length())
+	{
+		char c = sql[i];
+		if (c == '\'')
+		{
+			// A string literal, such as the path of a json_extract
+			size_t end = i + 1;
+			while (end < sql.length())
+			{
+				if (sql[end] == '\'')
+				{
+					if (end + 1 < sql.length() && sql[end + 1] == '\'')
+					{
+						end += 2;	// An escaped quote
+						continue;
+					}
+					break;
+				}
+				end++;
+			}
+			end = (end < sql.length()) ? end + 1 : end;
+			result.append(sql, i, end - i);
+			i = end;
+			previous = '\'';
+			lastWord.clear();
+			continue;
+		}
+		if (c == '"' || identifierChar(c))
+		{
+			size_t end;
+			string word;
+			if (c == '"')
+			{
+				end = sql.find('"', i + 1);
+				end = (end == string::npos) ? sql.length() : end + 1;
+				word = sql.substr(i + 1, end - i - 2);
+			}
+			else
+			{
+				end = i;
+				while (end < sql.length() && identifierChar(sql[end]))
+					end++;
+				word = sql.substr(i, end - i);
+			}
+			string upper = word;
+			for (auto& ch : upper)
+				ch = toupper((unsigned char)ch);
+			if (c != '"' && upper.compare("SELECT") == 0)
+			{
+				selects.push_back(depth);
+			}
+			else if (c != '"' && upper.compare("FROM") == 0
+					&& !selects.empty() && selects.back() == depth)
+			{
+				selects.pop_back();
+			}
+
+			size_t next = end;
+			while (next < sql.length() && isspace((unsigned char)sql[next]))
+				next++;
+			string lastUpper = lastWord;
+			for (auto& ch : lastUpper)
+				ch = toupper((unsigned char)ch);
+			if (word.compare("reading") == 0 && previous != '.'
+					&& lastUpper.compare("AS") != 0
+					&& lastWord.compare(DECODE_FUNCTION) != 0)
+			{
+				bool column = !selects.empty() && selects.back() == depth
+					&& (previous == ',' || lastUpper.compare("SELECT") == 0
+						|| lastUpper.compare("DISTINCT") == 0)
+					&& (next >= sql.length() || sql[next] == ','
+						|| strncasecmp(sql.c_str() + next, "FROM", 4) == 0);
+				result.append(DECODE_FUNCTION "(reading)");
+				if (column)
+				{
+					result.append(" AS \"reading\"");
+				}
+			}
+			else
+			{
+				result.append(sql, i, end - i);
+			}
+			i = end;
+			previous = 'a';
+			lastWord = (c == '"') ? string() : word;
+			continue;
+		}
+		if (c == '(')
+		{
+			depth++;
+		}
+		else if (c == ')')
+		{
+			while (!selects.empty() && selects.back() >= depth)
+				selects.pop_back();
+			depth--;
+		}
+		if (!isspace((unsigned char)c))
+		{
+			previous = c;
+			if (c != '(')
+			{
+				lastWord.clear();
+			}
+		}
+		result.append(1, c);
+		i++;
+	}
+	return result;
+}
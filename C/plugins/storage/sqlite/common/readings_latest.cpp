@@ -0,0 +1,240 @@
+/*
+ * Fledge storage service - Latest value of each datapoint of each asset
+ *
+ * Copyright (c) 2026 Dianomic Systems
+ *
+ * Released under the Apache 2.0 Licence
+ *
+ * Author: agent
+ */
+
+#include <readings_latest.h>
+#include <connection.h>
+#include <json_utils.h>
+#include <logger.h>
+#include <rapidjson/writer.h>
+#include <rapidjson/stringbuffer.h>
+#include <time.h>
+
+using namespace std;
+using namespace rapidjson;
+
+LatestReadings *LatestReadings::m_instance = 0;
+
+/**
+ * Add the datapoints of a reading to the batch, replacing the values
+ * of the same datapoints that are not newer
+ *
+ * @param asset		The asset code of the reading
+ * @param userTs	The user timestamp as formatted by formatDate
+ * @param reading	The datapoints of the reading
+ */
+void LatestBatch::add(const char *asset, const char *userTs, const Value& reading)
+{
+	LatestValue value;
+	if (!reading.IsObject() || !userTsToTime(userTs, &value.m_time))
+	{
+		return;
+	}
+	value.m_userTs = userTs;
+	for (auto& datapoint : reading.GetObject())
+	{
+		StringBuffer buffer;
+		Writer<StringBuffer> writer(buffer);
+		datapoint.value.Accept(writer);
+		value.m_value.assign(buffer.GetString(), buffer.GetSize());
+		add(Key(asset, datapoint.name.GetString()), value);
+	}
+}
+
+/**
+ * Add the values of another batch to the batch
+ *
+ * @param batch	The batch to add
+ */
+void LatestBatch::merge(const LatestBatch& batch)
+{
+	for (auto& item : batch.m_values)
+	{
+		add(item.first, item.second);
+	}
+}
+
+/**
+ * Add the value of a datapoint to the batch unless the batch holds a
+ * newer value of the datapoint
+ *
+ * @param key	The asset and datapoint
+ * @param value	The value of the datapoint
+ */
+void LatestBatch::add(const Key& key, const LatestValue& value)
+{
+	auto it = m_values.find(key);
+	if (it == m_values.end())
+	{
+		m_values.insert(make_pair(key, value));
+	}
+	else if (!timercmp(&value.m_time, &it->second.m_time, <))
+	{
+		it->second = value;
+	}
+}
+
+/**
+ * Constructor for the latest readings class
+ */
+LatestReadings::LatestReadings() : m_enabled(false)
+{
+}
+
+/**
+ * Destructor for the latest readings class
+ */
+LatestReadings::~LatestReadings()
+{
+}
+
+/**
+ * Return the singleton instance of the LatestReadings class
+ * for this plugin
+ *
+ * @return LatestReadings* singleton instance
+ */
+LatestReadings *LatestReadings::getInstance()
+{
+	if (m_instance == 0)
+	{
+		m_instance = new LatestReadings();
+	}
+	return m_instance;
+}
+
+/**
+ * Enable the latest values of the assets
+ *
+ * @param enabled	True if the latest values are kept
+ */
+void LatestReadings::setEnabled(bool enabled)
+{
+	m_enabled = enabled;
+	if (enabled)
+	{
+		Logger::getLogger()->info("The latest value of each datapoint of each asset will be kept");
+	}
+}
+
+/**
+ * Return if a value would be the latest value of its datapoint
+ *
+ * @param key	The asset and datapoint
+ * @param time	The user timestamp of the value
+ * @return bool	False if a newer value of the datapoint is held
+ */
+bool LatestReadings::isLatest(const LatestBatch::Key& key, const struct timeval& time)
+{
+	lock_guard<mutex> guard(m_mutex);
+	auto asset = m_assets.find(key.first);
+	if (asset == m_assets.end())
+	{
+		return true;
+	}
+	auto datapoint = asset->second.m_datapoints.find(key.second);
+	if (datapoint == asset->second.m_datapoints.end())
+	{
+		return true;
+	}
+	return !timercmp(&time, &datapoint->second.m_time, <);
+}
+
+/**
+ * Update the latest values with those of a committed batch
+ *
+ * @param batch	The latest values of the readings committed
+ */
+void LatestReadings::update(const LatestBatch& batch)
+{
+	lock_guard<mutex> guard(m_mutex);
+	for (auto& item : batch.values())
+	{
+		Asset& asset = m_assets[item.first.first];
+		auto datapoint = asset.m_datapoints.find(item.first.second);
+		if (datapoint == asset.m_datapoints.end())
+		{
+			asset.m_datapoints.insert(make_pair(item.first.second, item.second));
+		}
+		else if (!timercmp(&item.second.m_time, &datapoint->second.m_time, <))
+		{
+			datapoint->second = item.second;
+		}
+		else
+		{
+			continue;
+		}
+		asset.m_dirty = true;
+	}
+}
+
+/**
+ * Return the latest reading of the assets as a JSON result set. Each row
+ * has the asset code, the latest value of each datapoint of the asset and
+ * the user timestamp, in UTC, of the newest of these values.
+ *
+ * @param json	Set to the JSON result set
+ * @param asset	The asset to return or NULL for all the assets
+ */
+void LatestReadings::asJSON(string& json, const char *asset)
+{
+	lock_guard<mutex> guard(m_mutex);
+	string rows;
+	unsigned long count = 0;
+	auto it = asset ? m_assets.find(asset) : m_assets.begin();
+	auto end = (asset && it != m_assets.end()) ? next(it) : m_assets.end();
+	for (; it != end; ++it)
+	{
+		auto& item = *it;
+		if (item.second.m_dirty)
+		{
+			assetJSON(item.first, item.second);
+		}
+		if (count++)
+		{
+			rows.append(", ");
+		}
+		rows.append(item.second.m_json);
+	}
+	json = "{ \"count\" : " + to_string(count) + ", \"rows\" : [ " + rows + " ] }";
+}
+
+/**
+ * Build the JSON document of the latest reading of an asset
+ *
+ * @param name	The asset code
+ * @param asset	The latest values of the asset
+ */
+void LatestReadings::assetJSON(const string& name, Asset& asset)
+{
+	struct timeval latest = { 0, 0 };
+	string reading;
+	for (auto& item : asset.m_datapoints)
+	{
+		if (!reading.empty())
+		{
+			reading.append(", ");
+		}
+		reading.append("\"" + JSONescape(item.first) + "\" : " + item.second.m_value);
+		if (timercmp(&item.second.m_time, &latest, >))
+		{
+			latest = item.second.m_time;
+		}
+	}
+
+	char userTs[40];
+	struct tm tm;
+	gmtime_r(&latest.tv_sec, &tm);
+	size_t len = strftime(userTs, sizeof(userTs), "%Y-%m-%d %H:%M:%S", &tm);
+	snprintf(userTs + len, sizeof(userTs) - len, ".%06ld", (long)latest.tv_usec);
+
+	asset.m_json = "{ \"asset_code\" : \"" + JSONescape(name) + "\", \"reading\" : { "
+			+ reading + " }, \"user_ts\" : \"" + userTs + "\" }";
+	asset.m_dirty = false;
+}
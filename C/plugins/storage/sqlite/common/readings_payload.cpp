@@ -0,0 +1,310 @@
+/*
+ * Fledge storage service - Parser of the payload of a readings append
+ *
+ * Copyright (c) 2026 Dianomic Systems
+ *
+ * Released under the Apache 2.0 Licence
+ *
+ * Author: agent
+ */
+
+#include <readings_payload.h>
+#include <rapidjson/reader.h>
+#include <rapidjson/writer.h>
+#include <rapidjson/error/en.h>
+#include <string.h>
+
+using namespace std;
+using namespace rapidjson;
+
+#define NO_OFFSET	((size_t)-1)
+
+/**
+ * The SAX handler of an append payload. The depth counts the objects
+ * and arrays around the current value, the root object is at depth 1,
+ * the readings array at depth 2 and the members of a reading at depth 3.
+ *
+ * The events of the value of the reading member of a reading are
+ * forwarded to a writer on the buffer of the payload, the asset code and
+ * user timestamp are copied to the buffer. Offsets in the buffer are
+ * recorded as it may be reallocated whilst the payload is parsed.
+ */
+class ReadingsPayload::Handler : public BaseReaderHandler<UTF8<>, Handler> {
+	public:
+		typedef struct {
+			size_t	assetCode;
+			size_t	userTs;
+			size_t	reading;
+			size_t	readingLength;
+		} Offsets;
+
+		Handler(StringBuffer& buffer, string& error) :
+			m_buffer(buffer), m_writer(buffer), m_error(error), m_depth(0),
+			m_member(MEMBER_OTHER), m_hasReadings(false), m_inReadings(false),
+			m_forwarding(false), m_forwardDepth(0) {};
+
+		bool	Null() { return scalar([this]{ return m_writer.Null(); }); };
+		bool	Bool(bool b) { return scalar([this, b]{ return m_writer.Bool(b); }); };
+		bool	Int(int i) { return scalar([this, i]{ return m_writer.Int(i); }); };
+		bool	Uint(unsigned u) { return scalar([this, u]{ return m_writer.Uint(u); }); };
+		bool	Int64(int64_t i) { return scalar([this, i]{ return m_writer.Int64(i); }); };
+		bool	Uint64(uint64_t u) { return scalar([this, u]{ return m_writer.Uint64(u); }); };
+		bool	Double(double d) { return scalar([this, d]{ return m_writer.Double(d); }); };
+		bool	String(const char *str, SizeType length, bool copy)
+			{
+				Target target = enter(KIND_SCALAR);
+				if (target == FORWARD)
+				{
+					return m_writer.String(str, length, copy) && leave();
+				}
+				if (target == LOCAL && m_inReadings && m_depth == 3)
+				{
+					if (m_member == MEMBER_ASSET)
+						m_current.assetCode = store(str, length);
+					else if (m_member == MEMBER_USER_TS)
+						m_current.userTs = store(str, length);
+				}
+				return target != FAIL;
+			};
+		bool	Key(const char *str, SizeType length, bool copy)
+			{
+				if (m_forwarding)
+				{
+					return m_writer.Key(str, length, copy);
+				}
+				if (m_depth == 1)
+				{
+					m_member = is(str, length, "readings") ? MEMBER_READINGS : MEMBER_OTHER;
+				}
+				else if (m_inReadings && m_depth == 3)
+				{
+					if (is(str, length, "asset_code"))
+						m_member = MEMBER_ASSET;
+					else if (is(str, length, "user_ts"))
+						m_member = MEMBER_USER_TS;
+					else if (is(str, length, "reading"))
+						m_member = MEMBER_READING;
+					else
+						m_member = MEMBER_OTHER;
+				}
+				return true;
+			};
+		bool	StartObject()
+			{
+				Target target = enter(KIND_OBJECT);
+				if (target == FORWARD)
+				{
+					m_forwardDepth++;
+					return m_writer.StartObject();
+				}
+				if (target == FAIL)
+				{
+					return false;
+				}
+				m_depth++;
+				if (m_inReadings && m_depth == 3)
+				{
+					m_current.assetCode = m_current.userTs = m_current.reading = NO_OFFSET;
+					m_member = MEMBER_OTHER;
+				}
+				return true;
+			};
+		bool	EndObject(SizeType count)
+			{
+				if (m_forwarding)
+				{
+					m_forwardDepth--;
+					return m_writer.EndObject(count) && leave();
+				}
+				if (m_inReadings && m_depth == 3)
+				{
+					if (m_current.assetCode == NO_OFFSET || m_current.userTs == NO_OFFSET
+							|| m_current.reading == NO_OFFSET)
+					{
+						return fail("Each reading must have an asset_code, a user_ts and a reading");
+					}
+					m_offsets.push_back(m_current);
+				}
+				m_depth--;
+				return true;
+			};
+		bool	StartArray()
+			{
+				Target target = enter(KIND_ARRAY);
+				if (target == FORWARD)
+				{
+					m_forwardDepth++;
+					return m_writer.StartArray();
+				}
+				if (target == FAIL)
+				{
+					return false;
+				}
+				m_depth++;
+				if (m_depth == 2 && m_member == MEMBER_READINGS)
+				{
+					m_hasReadings = true;
+					m_inReadings = true;
+				}
+				return true;
+			};
+		bool	EndArray(SizeType count)
+			{
+				if (m_forwarding)
+				{
+					m_forwardDepth--;
+					return m_writer.EndArray(count) && leave();
+				}
+				if (m_depth == 2)
+				{
+					m_inReadings = false;
+				}
+				m_depth--;
+				return true;
+			};
+		bool	hasReadings() const { return m_hasReadings; };
+		const vector<Offsets>&
+			getOffsets() const { return m_offsets; };
+	private:
+		typedef enum { MEMBER_OTHER, MEMBER_READINGS, MEMBER_ASSET,
+				MEMBER_USER_TS, MEMBER_READING } Member;
+		typedef enum { KIND_SCALAR, KIND_OBJECT, KIND_ARRAY } Kind;
+		typedef enum { FAIL, FORWARD, LOCAL } Target;
+
+		/**
+		 * Return where the events of a value that starts are handled,
+		 * starting to forward them if it is the value of a reading
+		 *
+		 * @param kind	The kind of the value
+		 */
+		Target	enter(Kind kind)
+			{
+				if (m_forwarding)
+				{
+					return FORWARD;
+				}
+				if (m_depth == 0 && kind != KIND_OBJECT)
+				{
+					fail("The payload must be a JSON object");
+					return FAIL;
+				}
+				if (m_depth == 1 && m_member == MEMBER_READINGS && kind != KIND_ARRAY)
+				{
+					fail("Payload is missing the readings array");
+					return FAIL;
+				}
+				if (m_inReadings && m_depth == 2 && kind != KIND_OBJECT)
+				{
+					fail("Each reading in the readings array must be an object");
+					return FAIL;
+				}
+				if (m_inReadings && m_depth == 3 && m_member == MEMBER_READING)
+				{
+					m_writer.Reset(m_buffer);
+					m_current.reading = m_buffer.GetSize();
+					m_forwarding = true;
+					m_forwardDepth = 0;
+					return FORWARD;
+				}
+				return LOCAL;
+			};
+		/**
+		 * Complete the forwarding of the value of a reading once
+		 * the last event of the value has been written
+		 */
+		bool	leave()
+			{
+				if (m_forwardDepth == 0)
+				{
+					m_current.readingLength = m_buffer.GetSize() - m_current.reading;
+					m_buffer.Put('\0');
+					m_forwarding = false;
+				}
+				return true;
+			};
+		template<typename Emit> bool
+			scalar(Emit emit)
+			{
+				Target target = enter(KIND_SCALAR);
+				if (target == FORWARD)
+				{
+					return emit() && leave();
+				}
+				return target != FAIL;
+			};
+		size_t	store(const char *str, SizeType length)
+			{
+				size_t offset = m_buffer.GetSize();
+				char *p = m_buffer.Push(length + 1);
+				memcpy(p, str, length);
+				p[length] = 0;
+				return offset;
+			};
+		bool	fail(const char *error)
+			{
+				m_error = error;
+				return false;
+			};
+		static bool
+			is(const char *str, SizeType length, const char *name)
+			{
+				return length == strlen(name) && strncmp(str, name, length) == 0;
+			};
+		StringBuffer&		m_buffer;
+		Writer<StringBuffer>	m_writer;
+		string&			m_error;
+		int			m_depth;
+		Member			m_member;
+		bool			m_hasReadings;
+		bool			m_inReadings;
+		bool			m_forwarding;
+		int			m_forwardDepth;
+		Offsets			m_current;
+		vector<Offsets>		m_offsets;
+};
+
+/**
+ * Parse the payload of a readings append
+ *
+ * @param payload	The JSON payload
+ * @return bool		False if the payload is not valid, see getError
+ */
+bool ReadingsPayload::parse(const char *payload)
+{
+	m_buffer.Clear();
+	m_readings.clear();
+	m_error.clear();
+
+	Handler handler(m_buffer, m_error);
+	Reader reader;
+	StringStream stream(payload);
+	ParseResult result = reader.Parse(stream, handler);
+	if (!result)
+	{
+		if (m_error.empty())
+		{
+			m_error = GetParseError_En(result.Code());
+		}
+		return false;
+	}
+	if (!handler.hasReadings())
+	{
+		m_error = "Payload is missing a readings array";
+		return false;
+	}
+
+	// The buffer is now complete, resolve the offsets of the readings
+	const char *base = m_buffer.GetString();
+	const vector<Handler::Offsets>& offsets = handler.getOffsets();
+	m_readings.reserve(offsets.size());
+	for (auto& offset : offsets)
+	{
+		APPEND_READING reading;
+		reading.assetCode = base + offset.assetCode;
+		reading.userTs = base + offset.userTs;
+		reading.reading = base + offset.reading;
+		reading.readingLength = offset.readingLength;
+		m_readings.push_back(reading);
+	}
+	return true;
+}
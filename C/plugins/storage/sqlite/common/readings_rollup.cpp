@@ -0,0 +1,148 @@
+/*
+ * Fledge storage service - Rollup of the readings over intervals of time
+ *
+ * Copyright (c) 2026 Dianomic Systems
+ *
+ * Released under the Apache 2.0 Licence
+ *
+ * Author: agent
+ */
+
+#include <readings_rollup.h>
+#include <connection.h>
+#include <logger.h>
+#include <math.h>
+
+using namespace std;
+using namespace rapidjson;
+
+ReadingsRollup *ReadingsRollup::m_instance = 0;
+
+/**
+ * Constructor for the readings rollup class, the rollup is disabled
+ * until an interval is set
+ */
+ReadingsRollup::ReadingsRollup() : m_interval(0)
+{
+}
+
+/**
+ * Destructor for the readings rollup class
+ */
+ReadingsRollup::~ReadingsRollup()
+{
+}
+
+/**
+ * Return the singleton instance of the ReadingsRollup class
+ * for this plugin
+ *
+ * @return ReadingsRollup* singleton instance
+ */
+ReadingsRollup *ReadingsRollup::getInstance()
+{
+	if (m_instance == 0)
+	{
+		m_instance = new ReadingsRollup();
+	}
+	return m_instance;
+}
+
+/**
+ * Set the interval of the rollup
+ *
+ * @param interval	The interval in seconds, 0 disables the rollup
+ */
+void ReadingsRollup::setInterval(unsigned int interval)
+{
+	m_interval = interval;
+	m_table = string(READINGS_DB) + "." + ROLLUP_TABLE_BASE + to_string(interval);
+	if (interval)
+	{
+		Logger::getLogger()->info("Readings will be rolled up every %u seconds", m_interval);
+	}
+}
+
+/**
+ * Return if the time buckets of a given size can be computed from the
+ * rollup. The buckets of the readings queries are centred on multiples
+ * of their size, the size must be an even number of intervals for the
+ * edges of the buckets to fall on the edges of the intervals.
+ *
+ * @param size	The size of the time buckets in seconds
+ * @return bool	True if the buckets can be computed from the rollup
+ */
+bool ReadingsRollup::supports(double size) const
+{
+	if (!m_interval || size < 2 * m_interval || fmod(size, 1.0) != 0.0)
+	{
+		return false;
+	}
+	return ((unsigned long)size % (2 * m_interval)) == 0;
+}
+
+/**
+ * Return the bucket of the rollup of a reading, the number of intervals
+ * between the epoch and the user timestamp of the reading
+ *
+ * @param userTs	The user timestamp as formatted by formatDate
+ * @param bucket	Set to the bucket of the reading
+ * @return bool		False if the timestamp can not be parsed
+ */
+bool ReadingsRollup::bucket(const char *userTs, long *bucket) const
+{
+	struct timeval tv;
+	if (!userTsToTime(userTs, &tv))
+	{
+		return false;
+	}
+	*bucket = tv.tv_sec / m_interval;
+	return true;
+}
+
+/**
+ * Add the numeric datapoints of a reading to the rollup
+ *
+ * @param asset		The asset code of the reading
+ * @param userTs	The user timestamp as formatted by formatDate
+ * @param reading	The datapoints of the reading
+ */
+void RollupBatch::add(const char *asset, const char *userTs, const Value& reading)
+{
+	long bucket;
+	if (!reading.IsObject() || !ReadingsRollup::getInstance()->bucket(userTs, &bucket))
+	{
+		return;
+	}
+	for (auto& datapoint : reading.GetObject())
+	{
+		if (!datapoint.value.IsNumber())
+		{
+			continue;
+		}
+		double value = datapoint.value.GetDouble();
+		bool integer = datapoint.value.IsInt64();
+		Key key(asset, datapoint.name.GetString(), bucket);
+		auto it = m_values.find(key);
+		if (it == m_values.end())
+		{
+			Values& values = m_values[key];
+			values.m_minimum = value;
+			values.m_maximum = value;
+			values.m_total = value;
+			values.m_count = 1;
+			values.m_integer = integer;
+		}
+		else
+		{
+			Values& values = it->second;
+			if (value < values.m_minimum)
+				values.m_minimum = value;
+			if (value > values.m_maximum)
+				values.m_maximum = value;
+			values.m_total += value;
+			values.m_count++;
+			values.m_integer = values.m_integer && integer;
+		}
+	}
+}
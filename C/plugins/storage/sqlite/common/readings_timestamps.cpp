@@ -0,0 +1,274 @@
+/*
+ * Fledge storage service - Storage of the timestamps of the readings
+ *
+ * Copyright (c) 2026 Dianomic Systems
+ *
+ * Released under the Apache 2.0 Licence
+ *
+ * Author: agent
+ */
+
+#include <readings_timestamps.h>
+#include <connection.h>
+#include <logger.h>
+#include <sys/time.h>
+#include <time.h>
+#include <stdio.h>
+
+using namespace std;
+
+ReadingsTimestamps *ReadingsTimestamps::m_instance = 0;
+
+/**
+ * Constructor for the readings timestamps class
+ */
+ReadingsTimestamps::ReadingsTimestamps() : m_epoch(false)
+{
+}
+
+/**
+ * Destructor for the readings timestamps class
+ */
+ReadingsTimestamps::~ReadingsTimestamps()
+{
+}
+
+/**
+ * Return the singleton instance of the ReadingsTimestamps class
+ * for this plugin
+ *
+ * @return ReadingsTimestamps* singleton instance
+ */
+ReadingsTimestamps *ReadingsTimestamps::getInstance()
+{
+	if (m_instance == 0)
+	{
+		m_instance = new ReadingsTimestamps();
+	}
+	return m_instance;
+}
+
+/**
+ * Return the timestamp columns of the select on a readings table that
+ * the queries of the readings are built on. The timestamps are returned
+ * as text, integer timestamps are also returned as they are stored as
+ * epoch_user_ts for the conditions on the time of the readings.
+ *
+ * @return string	The columns
+ */
+string ReadingsTimestamps::columns() const
+{
+	if (!m_epoch)
+	{
+		return "user_ts, ts";
+	}
+	return FORMAT_TS_FUNCTION "(user_ts) AS user_ts, " FORMAT_TS_FUNCTION "(ts) AS ts, user_ts AS " EPOCH_USER_TS;
+}
+
+/**
+ * Return the timestamp columns of the fetch of the readings, formatted
+ * as UTC with the microseconds of user_ts and the milliseconds of ts
+ *
+ * @param raw		Return integer timestamps as they are stored
+ * @return string	The columns
+ */
+string ReadingsTimestamps::fetchColumns(bool raw) const
+{
+	if (!m_epoch)
+	{
+		return "strftime('%Y-%m-%d %H:%M:%S', user_ts, 'utc') || "
+			"substr(user_ts, instr(user_ts, '.'), 7) AS user_ts, "
+			"strftime('%Y-%m-%d %H:%M:%f', ts, 'utc') AS ts";
+	}
+	if (raw)
+	{
+		return "user_ts, ts";
+	}
+	return FORMAT_TS_FUNCTION "(user_ts, 6) AS user_ts, " FORMAT_TS_FUNCTION "(ts, 3) AS ts";
+}
+
+/**
+ * Return the expression of the seconds since the epoch of a
+ * timestamp column
+ *
+ * @param column	The stored timestamp column
+ * @return string	The SQL expression
+ */
+string ReadingsTimestamps::seconds(const string& column) const
+{
+	if (!m_epoch)
+	{
+		return "CAST(strftime('%s', " + column + ") AS INTEGER)";
+	}
+	return "(" + column + " / 1000000)";
+}
+
+/**
+ * Return the expression of a time in the past to compare with
+ * the stored timestamps
+ *
+ * @param seconds	The number of seconds before now
+ * @return string	The SQL expression
+ */
+string ReadingsTimestamps::ago(unsigned long seconds) const
+{
+	if (!m_epoch)
+	{
+		return "datetime('now' , '-" + to_string(seconds) + " seconds')";
+	}
+	return to_string(now() - (int64_t)seconds * 1000000);
+}
+
+/**
+ * Convert the timestamps of a readings table to the storage in use.
+ * The timestamps that are already stored as wanted are left, the
+ * conversion of a table that was interrupted is completed.
+ *
+ * @param db		The database connection
+ * @param table		The qualified name of the readings table
+ * @return bool		True if the table was converted
+ */
+bool ReadingsTimestamps::convert(sqlite3 *db, const string& table)
+{
+	string sql;
+	if (m_epoch)
+	{
+		sql = "UPDATE " + table + " SET user_ts = " EPOCH_TS_FUNCTION "(user_ts), ts = " EPOCH_TS_FUNCTION "(ts)"
+			" WHERE typeof(user_ts) = 'text' OR typeof(ts) = 'text';";
+	}
+	else
+	{
+		sql = "UPDATE " + table + " SET user_ts = " FORMAT_TS_FUNCTION "(user_ts), ts = " FORMAT_TS_FUNCTION "(ts)"
+			" WHERE typeof(user_ts) = 'integer' OR typeof(ts) = 'integer';";
+	}
+
+	char *zErrMsg = NULL;
+	if (sqlite3_exec(db, "BEGIN TRANSACTION;", NULL, NULL, &zErrMsg) != SQLITE_OK
+			|| sqlite3_exec(db, sql.c_str(), NULL, NULL, &zErrMsg) != SQLITE_OK
+			|| sqlite3_exec(db, "COMMIT TRANSACTION;", NULL, NULL, &zErrMsg) != SQLITE_OK)
+	{
+		Logger::getLogger()->error("Unable to convert the timestamps of the readings table %s: %s",
+				table.c_str(), zErrMsg ? zErrMsg : sqlite3_errmsg(db));
+		sqlite3_free(zErrMsg);
+		sqlite3_exec(db, "ROLLBACK TRANSACTION;", NULL, NULL, NULL);
+		return false;
+	}
+	int changes = sqlite3_changes(db);
+	if (changes)
+	{
+		Logger::getLogger()->info("Converted the timestamps of %d readings of the table %s",
+				changes, table.c_str());
+	}
+	return true;
+}
+
+/**
+ * Convert a user timestamp, as formatted by formatDate, to the number
+ * of microseconds since the epoch
+ *
+ * @param userTs	The user timestamp
+ * @param epoch		Set to the microseconds since the epoch
+ * @return bool		False if the timestamp can not be parsed
+ */
+bool ReadingsTimestamps::toEpoch(const char *userTs, int64_t *epoch)
+{
+	struct timeval tv;
+	if (!userTsToTime(userTs, &tv))
+	{
+		return false;
+	}
+	*epoch = (int64_t)tv.tv_sec * 1000000 + tv.tv_usec;
+	return true;
+}
+
+/**
+ * Return the current time as the number of microseconds since the epoch
+ *
+ * @return int64_t	The current time
+ */
+int64_t ReadingsTimestamps::now()
+{
+	struct timeval tv;
+	gettimeofday(&tv, NULL);
+	return (int64_t)tv.tv_sec * 1000000 + tv.tv_usec;
+}
+
+/**
+ * Register the functions that format and parse the timestamps
+ * with a database connection
+ *
+ * @param db	The database connection
+ */
+void ReadingsTimestamps::registerFunctions(sqlite3 *db)
+{
+	if (sqlite3_create_function(db, FORMAT_TS_FUNCTION, -1, SQLITE_UTF8 | SQLITE_DETERMINISTIC,
+				NULL, format, NULL, NULL) != SQLITE_OK
+			|| sqlite3_create_function(db, EPOCH_TS_FUNCTION, 1, SQLITE_UTF8 | SQLITE_DETERMINISTIC,
+				NULL, epoch, NULL, NULL) != SQLITE_OK)
+	{
+		Logger::getLogger()->error("Unable to register the functions of the readings timestamps: %s",
+				sqlite3_errmsg(db));
+	}
+}
+
+/**
+ * The reading_ts SQL function, returns the text of an integer timestamp
+ * and any other value unchanged. With one argument the timestamp is
+ * formatted as it is stored as text, with the number of digits of the
+ * fraction of a second as second argument it is formatted as UTC
+ * without the timezone.
+ */
+void ReadingsTimestamps::format(sqlite3_context *context, int argc, sqlite3_value **argv)
+{
+	if (argc < 1 || argc > 2)
+	{
+		sqlite3_result_error(context, "wrong number of arguments to " FORMAT_TS_FUNCTION, -1);
+		return;
+	}
+	if (sqlite3_value_type(argv[0]) != SQLITE_INTEGER)
+	{
+		sqlite3_result_value(context, argv[0]);
+		return;
+	}
+	int64_t epoch = sqlite3_value_int64(argv[0]);
+	time_t seconds = (time_t)(epoch / 1000000);
+	long usec = (long)(epoch % 1000000);
+	if (usec < 0)
+	{
+		usec += 1000000;
+		seconds--;
+	}
+	struct tm tm;
+	gmtime_r(&seconds, &tm);
+	char text[48];
+	size_t len = strftime(text, sizeof(text), "%Y-%m-%d %H:%M:%S", &tm);
+	if (argc == 1)
+	{
+		len += snprintf(text + len, sizeof(text) - len, ".%06ld+00:00", usec);
+	}
+	else if (sqlite3_value_int(argv[1]) == 3)
+	{
+		len += snprintf(text + len, sizeof(text) - len, ".%03ld", usec / 1000);
+	}
+	else
+	{
+		len += snprintf(text + len, sizeof(text) - len, ".%06ld", usec);
+	}
+	sqlite3_result_text(context, text, (int)len, SQLITE_TRANSIENT);
+}
+
+/**
+ * The reading_us SQL function, returns the integer of a timestamp stored
+ * as text and any other value unchanged
+ */
+void ReadingsTimestamps::epoch(sqlite3_context *context, int argc, sqlite3_value **argv)
+{
+	int64_t epoch;
+	if (sqlite3_value_type(argv[0]) != SQLITE_TEXT
+			|| !toEpoch((const char *)sqlite3_value_text(argv[0]), &epoch))
+	{
+		sqlite3_result_value(context, argv[0]);
+		return;
+	}
+	sqlite3_result_int64(context, epoch);
+}
@@ -0,0 +1,263 @@
+/*
+ * Fledge storage service - Incremental vacuum of the readings databases
+ *
+ * Copyright (c) 2026 Dianomic Systems
+ *
+ * Released under the Apache 2.0 Licence
+ *
+ * Author: agent
+ */
+
+#include <readings_vacuum.h>
+#include <connection.h>
+#include <connection_manager.h>
+#include <logger.h>
+#include <sqlite3.h>
+#include <sys/time.h>
+#include <string.h>
+#include <sstream>
+#include <vector>
+#include <algorithm>
+
+using namespace std;
+
+ReadingsVacuum *ReadingsVacuum::m_instance = 0;
+
+/**
+ * Constructor for the readings vacuum
+ */
+ReadingsVacuum::ReadingsVacuum() : m_manager(NULL), m_connection(NULL),
+	m_thread(NULL), m_running(false), m_interval(0), m_pages(0),
+	m_runs(0), m_released(0), m_busy(0), m_freePages(0), m_unsupported(0),
+	m_totalTime(0)
+{
+}
+
+/**
+ * Destructor for the readings vacuum
+ */
+ReadingsVacuum::~ReadingsVacuum()
+{
+	stop();
+}
+
+/**
+ * Return the singleton instance of the ReadingsVacuum class
+ * for this plugin
+ *
+ * @return ReadingsVacuum* singleton instance
+ */
+ReadingsVacuum *ReadingsVacuum::getInstance()
+{
+	if (m_instance == 0)
+	{
+		m_instance = new ReadingsVacuum();
+	}
+	return m_instance;
+}
+
+/**
+ * Start the vacuum thread. The thread keeps a connection from
+ * the pool for its own use until it is stopped.
+ *
+ * @param manager	The connection manager of the plugin
+ * @param interval	Seconds between the vacuums
+ * @param pages		The maximum number of pages released in each interval
+ */
+void ReadingsVacuum::start(ConnectionManager *manager, unsigned int interval, unsigned long pages)
+{
+	lock_guard<mutex> guard(m_mutex);
+	if (m_running)
+	{
+		return;
+	}
+	m_manager = manager;
+	m_interval = interval ? interval : 1;
+	m_pages = pages ? pages : 1;
+	m_connection = manager->allocate();
+	m_running = true;
+	m_thread = new thread(&ReadingsVacuum::vacuumThread, this);
+	Logger::getLogger()->info("The free pages of the readings databases will be released every %u seconds, at most %lu pages",
+			m_interval, m_pages);
+}
+
+/**
+ * Stop the vacuum thread
+ */
+void ReadingsVacuum::stop()
+{
+	{
+		lock_guard<mutex> guard(m_mutex);
+		if (!m_running)
+		{
+			return;
+		}
+		m_running = false;
+	}
+	m_cv.notify_all();
+	m_thread->join();
+	delete m_thread;
+	m_thread = NULL;
+	m_manager->release(m_connection);
+	m_connection = NULL;
+}
+
+/**
+ * The vacuum thread. Each interval the page budget is shared out in
+ * turn between the readings databases that have free pages.
+ */
+void ReadingsVacuum::vacuumThread()
+{
+	while (true)
+	{
+		{
+			unique_lock<mutex> lck(m_mutex);
+			m_cv.wait_for(lck, chrono::seconds(m_interval), [this]{ return !m_running; });
+			if (!m_running)
+			{
+				break;
+			}
+		}
+
+		// Pick up the databases created since the last vacuum
+		m_connection->attachPendingDbs();
+
+		vector<string> schemas;
+		sqlite3_stmt *stmt;
+		if (sqlite3_prepare_v2(m_connection->getDbHandle(), "PRAGMA database_list;", -1, &stmt, NULL) == SQLITE_OK)
+		{
+			while (sqlite3_step(stmt) == SQLITE_ROW)
+			{
+				const char *name = (const char *)sqlite3_column_text(stmt, 1);
+				if (name && strncmp(name, "readings_", 9) == 0)
+				{
+					schemas.push_back(name);
+				}
+			}
+			sqlite3_finalize(stmt);
+		}
+
+		struct timeval start, end, tm;
+		gettimeofday(&start, NULL);
+		unsigned long budget = m_pages, released = 0, freePages = 0, unsupported = 0;
+		for (auto& schema : schemas)
+		{
+			// 2 is INCREMENTAL, the other modes can not be vacuumed a step at a time
+			if (pragmaValue(schema, "auto_vacuum") != 2)
+			{
+				unsupported++;
+				continue;
+			}
+			if (budget > released)
+			{
+				released += vacuum(schema, budget - released);
+			}
+			long remaining = pragmaValue(schema, "freelist_count");
+			if (remaining > 0)
+			{
+				freePages += remaining;
+			}
+		}
+		gettimeofday(&end, NULL);
+		timersub(&end, &start, &tm);
+
+		lock_guard<mutex> guard(m_mutex);
+		if (unsupported && !m_unsupported)
+		{
+			Logger::getLogger()->info("%lu readings databases were created without incremental vacuum, their free pages are not released",
+					unsupported);
+		}
+		m_runs++;
+		m_released += released;
+		m_freePages = freePages;
+		m_unsupported = unsupported;
+		m_totalTime += tm.tv_sec * 1000 + tm.tv_usec / 1000;
+	}
+}
+
+/**
+ * Return the value of a numeric pragma of a database
+ *
+ * @param schema	The alias of the database
+ * @param pragma	The name of the pragma
+ * @return long		The value of the pragma or -1 if it could not be read
+ */
+long ReadingsVacuum::pragmaValue(const string& schema, const string& pragma)
+{
+	long value = -1;
+	string sql = "PRAGMA " + schema + "." + pragma + ";";
+	sqlite3_stmt *stmt;
+	if (sqlite3_prepare_v2(m_connection->getDbHandle(), sql.c_str(), -1, &stmt, NULL) == SQLITE_OK)
+	{
+		if (sqlite3_step(stmt) == SQLITE_ROW)
+		{
+			value = sqlite3_column_int64(stmt, 0);
+		}
+		sqlite3_finalize(stmt);
+	}
+	return value;
+}
+
+/**
+ * Release the free pages of a database a step at a time
+ *
+ * @param schema	The alias of the database
+ * @param pages		The maximum number of pages to release
+ * @return unsigned long	The number of pages released
+ */
+unsigned long ReadingsVacuum::vacuum(const string& schema, unsigned long pages)
+{
+	unsigned long released = 0;
+	long freePages = pragmaValue(schema, "freelist_count");
+	while (freePages > 0 && released < pages && m_running)
+	{
+		unsigned long step = min((unsigned long)freePages, min(pages - released, (unsigned long)VACUUM_STEP_PAGES));
+		string sql = "PRAGMA " + schema + ".incremental_vacuum(" + to_string(step) + ");";
+		char *zErrMsg = NULL;
+		int rc = sqlite3_exec(m_connection->getDbHandle(), sql.c_str(), NULL, NULL, &zErrMsg);
+		if (rc != SQLITE_OK)
+		{
+			if (rc == SQLITE_BUSY || rc == SQLITE_LOCKED)
+			{
+				lock_guard<mutex> guard(m_mutex);
+				m_busy++;
+			}
+			else
+			{
+				Logger::getLogger()->warn("Incremental vacuum of the database %s failed: %s",
+						schema.c_str(), zErrMsg ? zErrMsg : sqlite3_errstr(rc));
+			}
+			sqlite3_free(zErrMsg);
+			break;
+		}
+		long left = pragmaValue(schema, "freelist_count");
+		if (left < 0 || left >= freePages)
+		{
+			break;
+		}
+		released += freePages - left;
+		freePages = left;
+	}
+	return released;
+}
+
+/**
+ * Return the statistics of the vacuum as a JSON object
+ *
+ * @param json	The JSON object
+ */
+void ReadingsVacuum::asJSON(string& json)
+{
+ostringstream convert;
+
+	lock_guard<mutex> guard(m_mutex);
+	convert << "{ \"running\" : " << (m_running ? "true" : "false") << ",";
+	convert << " \"runs\" : " << m_runs << ",";
+	convert << " \"released\" : " << m_released << ",";
+	convert << " \"busy\" : " << m_busy << ",";
+	convert << " \"freePages\" : " << m_freePages << ",";
+	convert << " \"unsupported\" : " << m_unsupported << ",";
+	convert << " \"totalTime\" : " << m_totalTime << " }";
+
+	json = convert.str();
+}
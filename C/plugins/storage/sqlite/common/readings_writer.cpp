@@ -0,0 +1,239 @@
+/*
+ * Fledge storage service - Readings writer
+ *
+ * Copyright (c) 2026 Dianomic Systems
+ *
+ * Released under the Apache 2.0 Licence
+ *
+ * Author: agent
+ */
+
+#include <readings_writer.h>
+#include <readings_catalogue.h>
+#include <connection.h>
+#include <connection_manager.h>
+#include <insert_configuration.h>
+#include <pragma_configuration.h>
+#include <logger.h>
+
+using namespace std;
+
+ReadingsWriter *ReadingsWriter::m_instance = 0;
+
+/**
+ * Constructor for the readings writer
+ */
+ReadingsWriter::ReadingsWriter() : m_manager(NULL), m_running(false)
+{
+}
+
+/**
+ * Destructor for the readings writer
+ */
+ReadingsWriter::~ReadingsWriter()
+{
+	stop();
+}
+
+/**
+ * Return the singleton instance of the ReadingsWriter class
+ * for this plugin
+ *
+ * @return ReadingsWriter* singleton instance
+ */
+ReadingsWriter *ReadingsWriter::getInstance()
+{
+	if (m_instance == 0)
+	{
+		m_instance = new ReadingsWriter();
+	}
+	return m_instance;
+}
+
+/**
+ * Start the writer threads. Each thread keeps a connection from the
+ * pool for its own use until it is stopped.
+ *
+ * @param manager	The connection manager of the plugin
+ * @param shards	The number of writer threads
+ */
+void ReadingsWriter::start(ConnectionManager *manager, unsigned int shards)
+{
+	lock_guard<mutex> guard(m_mutex);
+	if (m_running)
+	{
+		return;
+	}
+	if (shards < 1)
+	{
+		shards = 1;
+	}
+	else if (shards > READINGS_WRITER_MAX_SHARDS)
+	{
+		shards = READINGS_WRITER_MAX_SHARDS;
+	}
+	m_manager = manager;
+	m_running = true;
+	for (unsigned int i = 0; i < shards; i++)
+	{
+		Shard *shard = new Shard();
+		shard->m_connection = manager->allocate();
+		PragmaConfiguration::getInstance()->addWriter(shard->m_connection->getDbHandle());
+		shard->m_thread = new thread(&ReadingsWriter::writerThread, this, shard);
+		m_shards.push_back(shard);
+	}
+	if (shards == 1)
+	{
+		Logger::getLogger()->info("Readings will be committed in groups by a single writer");
+	}
+	else
+	{
+		Logger::getLogger()->info("Readings will be committed in groups by %d writers, "
+				"each writing to a subset of the readings databases", shards);
+	}
+}
+
+/**
+ * Stop the writer threads. The blocks of readings already queued
+ * are inserted before the threads exit.
+ */
+void ReadingsWriter::stop()
+{
+	{
+		lock_guard<mutex> guard(m_mutex);
+		if (!m_running)
+		{
+			return;
+		}
+		m_running = false;
+	}
+	for (auto shard : m_shards)
+	{
+		shard->m_queueCV.notify_all();
+		shard->m_thread->join();
+		delete shard->m_thread;
+		PragmaConfiguration::getInstance()->removeWriter(shard->m_connection->getDbHandle());
+		m_manager->release(shard->m_connection);
+		delete shard;
+	}
+	m_shards.clear();
+}
+
+/**
+ * Queue a block of readings for the writer threads and wait for
+ * it to be committed. With several shards the block is queued for
+ * the shard of the database of its first asset.
+ *
+ * A block is never split between shards, as the shards commit
+ * separately and the caller resends the whole of a block that
+ * fails. The readings of the assets of other shards are inserted by
+ * the same writer, in the same transaction, so the block is either
+ * committed or rejected as a whole.
+ *
+ * @param connection	The connection of the caller, used to find the
+ *			readings tables of the assets
+ * @param readings	The readings to insert
+ * @return int		The number of readings inserted, -1 on failure
+ */
+int ReadingsWriter::append(Connection *connection, const vector<APPEND_READING>& readings)
+{
+	unsigned int nShards;
+	{
+		lock_guard<mutex> guard(m_mutex);
+		nShards = m_shards.size();
+	}
+	unsigned int target = 0;
+	if (nShards > 1)
+	{
+		target = route(connection, readings, nShards);
+	}
+
+	AppendRequest request = { &readings, 0, false };
+	unique_lock<mutex> lck(m_mutex);
+	if (!m_running || target >= m_shards.size())
+	{
+		return -1;
+	}
+	Shard *shard = m_shards[target];
+	shard->m_queue.push_back(&request);
+	shard->m_queueCV.notify_one();
+	m_completeCV.wait(lck, [&request]{ return request.complete; });
+	return request.rows;
+}
+
+/**
+ * Find the shard of a block of readings, the shard of the readings
+ * database of its first asset. A block whose first asset has no
+ * readings table yet is queued for the first shard.
+ *
+ * @param connection	The connection used to find the readings tables
+ * @param readings	The readings
+ * @param nShards	The number of shards
+ * @return unsigned int	The shard of the block
+ */
+unsigned int ReadingsWriter::route(Connection *connection, const vector<APPEND_READING>& readings,
+			unsigned int nShards)
+{
+	if (readings.empty())
+	{
+		return 0;
+	}
+	ReadingsCatalogue::tyReadingReference ref =
+		ReadingsCatalogue::getInstance()->getReadingReference(connection, readings[0].assetCode);
+	if (ref.dbId <= 0)
+	{
+		return 0;
+	}
+	return (ref.dbId - 1) % nShards;
+}
+
+/**
+ * A writer thread, takes all the blocks of readings queued for its
+ * shard, up to READINGS_WRITER_MAX_REQUESTS or the configured transaction
+ * size, and inserts them in a single transaction.
+ *
+ * @param shard	The shard of the thread
+ */
+void ReadingsWriter::writerThread(Shard *shard)
+{
+	vector<AppendRequest *> group;
+	InsertConfiguration *insertConfig = InsertConfiguration::getInstance();
+
+	while (true)
+	{
+		{
+			unique_lock<mutex> lck(m_mutex);
+			shard->m_queueCV.wait(lck, [this, shard]{ return !shard->m_queue.empty() || !m_running; });
+			if (shard->m_queue.empty())
+			{
+				break;
+			}
+			unsigned int commitRows = insertConfig->getCommitRows();
+			unsigned int rows = 0;
+			while (!shard->m_queue.empty() && group.size() < READINGS_WRITER_MAX_REQUESTS)
+			{
+				AppendRequest *request = shard->m_queue.front();
+				if (commitRows && !group.empty()
+						&& rows + request->readings->size() > commitRows)
+				{
+					break;
+				}
+				rows += request->readings->size();
+				group.push_back(request);
+				shard->m_queue.pop_front();
+			}
+		}
+
+		shard->m_connection->appendReadingsGroup(group);
+
+		{
+			lock_guard<mutex> guard(m_mutex);
+			for (auto request : group)
+			{
+				request->complete = true;
+			}
+		}
+		m_completeCV.notify_all();
+		group.clear();
+	}
+}
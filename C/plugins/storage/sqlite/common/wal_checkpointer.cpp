@@ -0,0 +1,237 @@
+/*
+ * Fledge storage service - WAL checkpoint scheduler
+ *
+ * Copyright (c) 2026 Dianomic Systems
+ *
+ * Released under the Apache 2.0 Licence
+ *
+ * Author: agent
+ */
+
+#include <wal_checkpointer.h>
+#include <connection.h>
+#include <connection_manager.h>
+#include <logger.h>
+#include <sqlite3.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include <sstream>
+#include <vector>
+#include <set>
+
+using namespace std;
+
+WalCheckpointer *WalCheckpointer::m_instance = 0;
+
+/**
+ * Constructor for the WAL checkpointer
+ */
+WalCheckpointer::WalCheckpointer() : m_manager(NULL), m_connection(NULL),
+	m_thread(NULL), m_running(false), m_interval(0), m_walSizeLimit(0),
+	m_passive(0), m_restart(0), m_busy(0), m_frames(0), m_totalTime(0),
+	m_maxTime(0), m_maxWalSize(0), m_last(0)
+{
+}
+
+/**
+ * Destructor for the WAL checkpointer
+ */
+WalCheckpointer::~WalCheckpointer()
+{
+	stop();
+}
+
+/**
+ * Return the singleton instance of the WalCheckpointer class
+ * for this plugin
+ *
+ * @return WalCheckpointer* singleton instance
+ */
+WalCheckpointer *WalCheckpointer::getInstance()
+{
+	if (m_instance == 0)
+	{
+		m_instance = new WalCheckpointer();
+	}
+	return m_instance;
+}
+
+/**
+ * Start the checkpoint thread. The thread keeps a connection from
+ * the pool for its own use until it is stopped.
+ *
+ * @param manager	The connection manager of the plugin
+ * @param interval	Seconds between passive checkpoints, 0 disables them
+ * @param walSizeLimit	Size in KB of a WAL that triggers a restart checkpoint, 0 disables it
+ */
+void WalCheckpointer::start(ConnectionManager *manager, unsigned int interval, unsigned long walSizeLimit)
+{
+	lock_guard<mutex> guard(m_mutex);
+	if (m_running)
+	{
+		return;
+	}
+	m_manager = manager;
+	m_interval = interval;
+	m_walSizeLimit = walSizeLimit * 1024;
+	m_connection = manager->allocate();
+	m_last = time(0);
+	m_running = true;
+	m_thread = new thread(&WalCheckpointer::checkpointThread, this);
+	Logger::getLogger()->info("The write ahead logs will be checkpointed every %u seconds and above %lu KB",
+			interval, walSizeLimit);
+}
+
+/**
+ * Stop the checkpoint thread
+ */
+void WalCheckpointer::stop()
+{
+	{
+		lock_guard<mutex> guard(m_mutex);
+		if (!m_running)
+		{
+			return;
+		}
+		m_running = false;
+	}
+	m_cv.notify_all();
+	m_thread->join();
+	delete m_thread;
+	m_thread = NULL;
+	m_manager->release(m_connection);
+	m_connection = NULL;
+}
+
+/**
+ * The checkpoint thread. The size of the WAL of each database is checked
+ * every second, the passive checkpoint of all the databases is run once
+ * the interval has elapsed.
+ */
+void WalCheckpointer::checkpointThread()
+{
+	while (true)
+	{
+		{
+			unique_lock<mutex> lck(m_mutex);
+			m_cv.wait_for(lck, chrono::seconds(1), [this]{ return !m_running; });
+			if (!m_running)
+			{
+				break;
+			}
+		}
+
+		// Pick up the databases created since the last checkpoint
+		m_connection->attachPendingDbs();
+
+		// The databases attached to the connection and their files, the
+		// configuration database is attached twice, as main and fledge
+		sqlite3 *dbHandle = m_connection->getDbHandle();
+		vector<pair<string, string>> databases;
+		set<string> files;
+		sqlite3_stmt *stmt;
+		if (sqlite3_prepare_v2(dbHandle, "PRAGMA database_list;", -1, &stmt, NULL) == SQLITE_OK)
+		{
+			while (sqlite3_step(stmt) == SQLITE_ROW)
+			{
+				const char *file = (const char *)sqlite3_column_text(stmt, 2);
+				if (file && *file && files.insert(file).second)
+				{
+					databases.push_back(make_pair(string((const char *)sqlite3_column_text(stmt, 1)), string(file)));
+				}
+			}
+			sqlite3_finalize(stmt);
+		}
+
+		if (m_interval && time(0) - m_last >= m_interval)
+		{
+			for (auto& db : databases)
+			{
+				checkpoint(db.first, SQLITE_CHECKPOINT_PASSIVE);
+			}
+			m_last = time(0);
+		}
+
+		for (auto& db : databases)
+		{
+			struct stat st;
+			if (stat((db.second + "-wal").c_str(), &st) != 0)
+			{
+				continue;
+			}
+			unsigned long walSize = st.st_size;
+			{
+				lock_guard<mutex> guard(m_mutex);
+				if (walSize > m_maxWalSize)
+					m_maxWalSize = walSize;
+			}
+			if (m_walSizeLimit && walSize > m_walSizeLimit)
+			{
+				Logger::getLogger()->debug("WAL of %s is %lu bytes, restart checkpoint",
+						db.first.c_str(), walSize);
+				checkpoint(db.first, SQLITE_CHECKPOINT_RESTART);
+			}
+		}
+	}
+}
+
+/**
+ * Checkpoint the WAL of a database and update the statistics
+ *
+ * @param schema	The alias of the database
+ * @param mode		SQLITE_CHECKPOINT_PASSIVE or SQLITE_CHECKPOINT_RESTART
+ */
+void WalCheckpointer::checkpoint(const string& schema, int mode)
+{
+	struct timeval start, end, tm;
+	int logFrames = 0, checkpointed = 0;
+
+	gettimeofday(&start, NULL);
+	int rc = sqlite3_wal_checkpoint_v2(m_connection->getDbHandle(), schema.c_str(),
+			mode, &logFrames, &checkpointed);
+	gettimeofday(&end, NULL);
+	timersub(&end, &start, &tm);
+	unsigned long elapsed = tm.tv_sec * 1000 + tm.tv_usec / 1000;
+
+	lock_guard<mutex> guard(m_mutex);
+	if (mode == SQLITE_CHECKPOINT_RESTART)
+		m_restart++;
+	else
+		m_passive++;
+	if (rc == SQLITE_BUSY || (rc == SQLITE_OK && checkpointed < logFrames))
+	{
+		m_busy++;
+	}
+	else if (rc != SQLITE_OK)
+	{
+		Logger::getLogger()->warn("Checkpoint of the database %s failed: %s",
+				schema.c_str(), sqlite3_errmsg(m_connection->getDbHandle()));
+	}
+	if (checkpointed > 0)
+		m_frames += checkpointed;
+	m_totalTime += elapsed;
+	if (elapsed > m_maxTime)
+		m_maxTime = elapsed;
+}
+
+/**
+ * Return the statistics of the checkpoints as a JSON object
+ *
+ * @param json	The JSON object
+ */
+void WalCheckpointer::asJSON(string& json)
+{
+ostringstream convert;
+
+	lock_guard<mutex> guard(m_mutex);
+	convert << "{ \"running\" : " << (m_running ? "true" : "false") << ",";
+	convert << " \"passive\" : " << m_passive << ",";
+	convert << " \"restart\" : " << m_restart << ",";
+	convert << " \"incomplete\" : " << m_busy << ",";
+	convert << " \"frames\" : " << m_frames << ",";
+	convert << " \"totalTime\" : " << m_totalTime << ",";
+	convert << " \"maxTime\" : " << m_maxTime << ",";
+	convert << " \"maxWalSize\" : " << m_maxWalSize << " }";
+
+	json = convert.str();
+}
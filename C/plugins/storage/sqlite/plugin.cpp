@@ -11,6 +11,7 @@
 #include <connection_manager.h>
 #include <connection.h>
 #include <plugin_api.h>
+#include <storage_profile.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <strings.h>
@@ -27,11 +28,26 @@
 #include <config_category.h>
 #include <readings_catalogue.h>
 #include <purge_configuration.h>
+#include <insert_configuration.h>
+#include <readings_writer.h>
+#include <pragma_configuration.h>
+#include <wal_checkpointer.h>
+#include <readings_vacuum.h>
+#include <incremental_purge.h>
+#include <readings_rollup.h>
+#include <readings_latest.h>
+#include <readings_blobs.h>
+#include <readings_compression.h>
+#include <readings_timestamps.h>
+#include <readings_allocator.h>
 #include <string_utils.h>
+#include <pool_autoscaler.h>
 
 using namespace std;
 using namespace rapidjson;
 
+static PoolAutoscaler	*poolAutoscaler = NULL;
+
 /**
  * The SQLite3 plugin interface
  */
@@ -45,6 +61,93 @@ const char *default_config = QUOTE({
 			"displayName" : "Pool Size",
 			"order" : "1"
 		},
+		"readPoolSize" : {
+			"description" : "The number of read only connections to create in the initial pool of connections used by queries and by the fetch of readings",
+			"type" : "integer",
+			"default" : "3",
+			"minimum" : "0",
+			"displayName" : "Read Pool Size",
+			"order" : "16"
+		},
+		"purgeMode" : {
+			"description" : "Purge the readings when the purge task runs or continuously in small steps, the purge task then reports the readings purged since it last ran",
+			"type" : "enumeration",
+			"options" : [ "task", "incremental" ],
+			"default" : "task",
+			"displayName" : "Purge mode",
+			"order" : "17"
+		},
+		"purgeInterval" : {
+			"description" : "Seconds between the steps of the incremental purge",
+			"type" : "integer",
+			"default" : "10",
+			"minimum" : "1",
+			"displayName" : "Incremental purge interval",
+			"order" : "18"
+		},
+		"purgeRows" : {
+			"description" : "The maximum number of readings deleted by each step of the incremental purge",
+			"type" : "integer",
+			"default" : "10000",
+			"minimum" : "1",
+			"displayName" : "Incremental purge rows",
+			"order" : "19"
+		},
+		"purgeTimeBudget" : {
+			"description" : "Milliseconds after which a step of the incremental purge stops deleting readings",
+			"type" : "integer",
+			"default" : "200",
+			"minimum" : "1",
+			"displayName" : "Incremental purge time budget (ms)",
+			"order" : "20"
+		},
+		"preallocateHeadroom" : {
+			"description" : "The number of free readings databases created in the background ahead of demand, 0 creates them when they are needed by a new asset",
+			"type" : "integer",
+			"default" : "1",
+			"minimum" : "0",
+			"displayName" : "Databases created in advance",
+			"order" : "21"
+		},
+		"rollupInterval" : {
+			"description" : "Seconds of each interval of the rollup of the numeric datapoints used by the time bucket queries of the readings, 0 disables the rollup",
+			"type" : "integer",
+			"default" : "0",
+			"minimum" : "0",
+			"displayName" : "Rollup interval",
+			"order" : "22"
+		},
+		"latestReadings" : {
+			"description" : "Keep the latest value of each datapoint of each asset, returned by the latest readings call of the storage API",
+			"type" : "boolean",
+			"default" : "false",
+			"displayName" : "Latest values",
+			"order" : "23"
+		},
+		"blobSize" : {
+			"description" : "The minimum size in bytes of the data of the image and data buffer datapoints stored as binary objects outside of the readings, 0 keeps them base64 encoded within the readings",
+			"type" : "integer",
+			"default" : "0",
+			"minimum" : "0",
+			"displayName" : "Binary object size",
+			"order" : "24"
+		},
+		"compressReadings" : {
+			"description" : "Store the readings compressed with a dictionary per asset, the readings already stored are left as they are",
+			"type" : "boolean",
+			"default" : "false",
+			"displayName" : "Compress readings",
+			"order" : "26"
+		},
+		"purgeThreads" : {
+			"description" : "The number of connections that delete the readings of different readings databases in parallel during a purge",
+			"type" : "integer",
+			"default" : "1",
+			"minimum" : "1",
+			"maximum" : "8",
+			"displayName" : "Purge threads",
+			"order" : "25"
+		},
 		"nReadingsPerDb" : {
 			"description" : "The number of readings tables in each database that is created",
 			"type" : "integer",
@@ -79,6 +182,142 @@ const char *default_config = QUOTE({
 			"default" : "",
 			"displayName" : "Purge Exclusions",
 			"order" : "6"
+		},
+		"insertBatchSize" : {
+			"description" : "The number of readings to insert with each SQL INSERT statement",
+			"type" : "integer",
+			"default" : "50",
+			"minimum" : "1",
+			"maximum" : "300",
+			"displayName" : "Insert batch size",
+			"order" : "7"
+		},
+		"commitRows" : {
+			"description" : "The most readings the group commit inserts in one transaction, a block of readings is always committed whole, 0 commits all the blocks queued together",
+			"type" : "integer",
+			"default" : "0",
+			"minimum" : "0",
+			"displayName" : "Transaction size",
+			"order" : "8"
+		},
+		"walSizeLimit" : {
+			"description" : "Size of the write ahead log in KB above which the transaction size is reduced, 0 disables adaptive transaction sizing",
+			"type" : "integer",
+			"default" : "0",
+			"minimum" : "0",
+			"displayName" : "WAL size limit (KB)",
+			"order" : "9"
+		},
+		"partitionInterval" : {
+			"description" : "Move the readings to a new database every hour or day, the purge by age then deletes the expired databases. NOTE: every partition retained is an attached database",
+			"type" : "enumeration",
+			"options" : [ "none", "hourly", "daily" ],
+			"default" : "none",
+			"displayName" : "Readings partitioning",
+			"order" : "10"
+		},
+		"groupCommit" : {
+			"description" : "Insert the readings of all the services with a single writer that commits the readings received together in one transaction",
+			"type" : "boolean",
+			"default" : "true",
+			"displayName" : "Group commit",
+			"order" : "11"
+		},
+		"writerShards" : {
+			"description" : "The number of group commit writers, each with its own connection, that insert the readings of the assets of different readings databases in parallel. A block of readings is not split between writers, it is inserted by the writer of the database of its first asset so that it is committed or rejected as a whole",
+			"type" : "integer",
+			"default" : "1",
+			"minimum" : "1",
+			"maximum" : "8",
+			"displayName" : "Writer shards",
+			"order" : "27"
+		},
+		"pragmaProfile" : {
+			"description" : "The SQLite cache, memory mapping and synchronisation settings, high-throughput is intended for servers with several GB of memory",
+			"type" : "enumeration",
+			"options" : [ "default", "high-throughput" ],
+			"default" : "default",
+			"displayName" : "Database tuning profile",
+			"order" : "12"
+		},
+		"pragmaOverrides" : {
+			"description" : "Settings that override those of the tuning profile for the reader and writer connections",
+			"type" : "JSON",
+			"default" : "{}",
+			"displayName" : "Database tuning overrides",
+			"order" : "13"
+		},
+		"checkpointInterval" : {
+			"description" : "Seconds between the background checkpoints of the write ahead logs, 0 leaves the checkpoints to the connections writing to the databases",
+			"type" : "integer",
+			"default" : "0",
+			"minimum" : "0",
+			"displayName" : "Checkpoint interval",
+			"order" : "14"
+		},
+		"checkpointWalSize" : {
+			"description" : "Size in KB of a write ahead log above which the background checkpoint restarts the log, 0 disables the restart",
+			"type" : "integer",
+			"default" : "0",
+			"minimum" : "0",
+			"displayName" : "Checkpoint WAL size (KB)",
+			"order" : "15"
+		},
+		"vacuumInterval" : {
+			"description" : "Seconds between the incremental vacuums that return the space freed by the purges of the readings databases to the file system, 0 disables the vacuum",
+			"type" : "integer",
+			"default" : "600",
+			"minimum" : "0",
+			"displayName" : "Vacuum interval",
+			"order" : "28"
+		},
+		"vacuumPages" : {
+			"description" : "The maximum number of database pages released by each incremental vacuum",
+			"type" : "integer",
+			"default" : "2048",
+			"minimum" : "1",
+			"displayName" : "Vacuum pages",
+			"order" : "29"
+		},
+		"readingsIndex" : {
+			"description" : "Index the readings tables by timestamp for the queries of the readings by time, none appends the readings faster when they are only fetched in order by the north services",
+			"type" : "enumeration",
+			"options" : [ "timestamp", "none" ],
+			"default" : "timestamp",
+			"displayName" : "Readings index",
+			"order" : "30"
+		},
+		"timestamps" : {
+			"description" : "Store the timestamps of the readings as text or as the number of microseconds since the epoch, which are neither formatted nor parsed when the readings are stored and purged. The readings stored are converted when the storage service next starts",
+			"type" : "enumeration",
+			"options" : [ "text", "epoch" ],
+			"default" : "text",
+			"displayName" : "Timestamp storage",
+			"order" : "31"
+		},
+		"poolScaleInterval" : {
+			"description" : "Seconds between the resizes of the pool of connections from the demand for connections, 0 keeps the connections opened when they are needed",
+			"type" : "integer",
+			"default" : "0",
+			"minimum" : "0",
+			"displayName" : "Pool resize interval",
+			"order" : "32"
+		},
+		"poolMinimum" : {
+			"description" : "The smallest number of connections the pool is resized to",
+			"type" : "integer",
+			"default" : "5",
+			"minimum" : "1",
+			"displayName" : "Minimum pool size",
+			"order" : "33"
+		},
+		"poolMaximum" : {
+			"description" : "The largest number of connections the pool is resized to, 0 for no limit. Connections needed above the limit are still opened and are closed once they are idle",
+			"type" : "integer",
+			"default" : "0",
+			"minimum" : "0",
+			"displayName" : "Maximum pool size",
+			"order" : "34"
 		}
 
 });
@@ -114,11 +353,41 @@ PLUGIN_HANDLE plugin_init(ConfigCategory *category)
 
 	STORAGE_CONFIGURATION storageConfig;
 
+	// The pragmas are applied as the connections are created
+	PragmaConfiguration *pragmaConfig = PragmaConfiguration::getInstance();
+	if (category->itemExists("pragmaProfile"))
+	{
+		pragmaConfig->setProfile(category->getValue("pragmaProfile"));
+	}
+	if (category->itemExists("pragmaOverrides"))
+	{
+		pragmaConfig->setOverrides(category->getValue("pragmaOverrides"));
+	}
+
+	unsigned int checkpointInterval = 0;
+	unsigned long checkpointWalSize = 0;
+	if (category->itemExists("checkpointInterval"))
+	{
+		checkpointInterval = strtoul(category->getValue("checkpointInterval").c_str(), NULL, 10);
+	}
+	if (category->itemExists("checkpointWalSize"))
+	{
+		checkpointWalSize = strtoul(category->getValue("checkpointWalSize").c_str(), NULL, 10);
+	}
+	if (checkpointInterval || checkpointWalSize)
+	{
+		pragmaConfig->disableAutocheckpoint();
+	}
+
 	if (category->itemExists("poolSize"))
 	{
 		storageConfig.poolSize = strtol(category->getValue("poolSize").c_str(), NULL, 10);
 	}
 	manager->growPool(storageConfig.poolSize);
+	if (category->itemExists("readPoolSize"))
+	{
+		manager->growReadPool(strtoul(category->getValue("readPoolSize").c_str(), NULL, 10));
+	}
 
 
 	if (category->itemExists("nReadingsPerDb"))
@@ -142,9 +411,145 @@ PLUGIN_HANDLE plugin_init(ConfigCategory *category)
 		storageConfig.nDbToAllocate = strtol(category->getValue("nDbToAllocate").c_str(), NULL, 10);
 	}
 
+	if (category->itemExists("partitionInterval"))
+	{
+		string interval = category->getValue("partitionInterval");
+		if (interval.compare("hourly") == 0)
+			storageConfig.partitionInterval = 3600;
+		else if (interval.compare("daily") == 0)
+			storageConfig.partitionInterval = 86400;
+	}
+
+	if (category->itemExists("readingsIndex"))
+	{
+		storageConfig.timestampIndex = category->getValue("readingsIndex").compare("none") != 0;
+	}
+
+	InsertConfiguration *insertConfig = InsertConfiguration::getInstance();
+	if (category->itemExists("insertBatchSize"))
+	{
+		insertConfig->setRowsPerInsert(strtoul(category->getValue("insertBatchSize").c_str(), NULL, 10));
+	}
+	if (category->itemExists("commitRows"))
+	{
+		insertConfig->setCommitRows(strtoul(category->getValue("commitRows").c_str(), NULL, 10));
+	}
+	if (category->itemExists("walSizeLimit"))
+	{
+		insertConfig->setWalSizeLimit(strtoul(category->getValue("walSizeLimit").c_str(), NULL, 10));
+	}
+
+	if (category->itemExists("timestamps"))
+	{
+		ReadingsTimestamps::getInstance()->setEpoch(category->getValue("timestamps").compare("epoch") == 0);
+	}
+
 	ReadingsCatalogue *readCat = ReadingsCatalogue::getInstance();
 	readCat->multipleReadingsInit(storageConfig);
 
+	if (category->itemExists("rollupInterval"))
+	{
+		ReadingsRollup::getInstance()->setInterval(strtoul(category->getValue("rollupInterval").c_str(), NULL, 10));
+	}
+	if (category->itemExists("latestReadings")
+			&& category->getValue("latestReadings").compare("true") == 0)
+	{
+		LatestReadings::getInstance()->setEnabled(true);
+	}
+	if (category->itemExists("blobSize"))
+	{
+		ReadingsBlobs::getInstance()->setMinimumSize(strtoul(category->getValue("blobSize").c_str(), NULL, 10));
+	}
+	if (category->itemExists("compressReadings")
+			&& category->getValue("compressReadings").compare("true") == 0)
+	{
+		ReadingsCompression::getInstance()->setEnabled(true);
+	}
+	Connection *connection = manager->allocate();
+	connection->createRollup();
+	connection->createBlobs();
+	connection->createDictionaries();
+	if (LatestReadings::getInstance()->isEnabled())
+	{
+		connection->loadLatest();
+	}
+	manager->release(connection);
+
+	if (!category->itemExists("groupCommit")
+			|| category->getValue("groupCommit").compare("true") == 0)
+	{
+		unsigned int shards = 1;
+		if (category->itemExists("writerShards"))
+		{
+			shards = strtoul(category->getValue("writerShards").c_str(), NULL, 10);
+		}
+		ReadingsWriter::getInstance()->start(manager, shards);
+	}
+
+	if (checkpointInterval || checkpointWalSize)
+	{
+		WalCheckpointer::getInstance()->start(manager, checkpointInterval, checkpointWalSize);
+	}
+
+	int headroom = 1;
+	if (category->itemExists("preallocateHeadroom"))
+	{
+		headroom = atoi(category->getValue("preallocateHeadroom").c_str());
+	}
+	ReadingsAllocator::getInstance()->start(manager, headroom);
+
+	unsigned int vacuumInterval = 600;
+	unsigned long vacuumPages = 2048;
+	if (category->itemExists("vacuumInterval"))
+	{
+		vacuumInterval = strtoul(category->getValue("vacuumInterval").c_str(), NULL, 10);
+	}
+	if (category->itemExists("vacuumPages"))
+	{
+		vacuumPages = strtoul(category->getValue("vacuumPages").c_str(), NULL, 10);
+	}
+	if (vacuumInterval)
+	{
+		ReadingsVacuum::getInstance()->start(manager, vacuumInterval, vacuumPages);
+	}
+
+	if (category->itemExists("purgeMode") && category->getValue("purgeMode").compare("incremental") == 0)
+	{
+		unsigned int interval = 10;
+		unsigned long rows = 10000, budget = 200;
+		if (category->itemExists("purgeInterval"))
+			interval = strtoul(category->getValue("purgeInterval").c_str(), NULL, 10);
+		if (category->itemExists("purgeRows"))
+			rows = strtoul(category->getValue("purgeRows").c_str(), NULL, 10);
+		if (category->itemExists("purgeTimeBudget"))
+			budget = strtoul(category->getValue("purgeTimeBudget").c_str(), NULL, 10);
+		IncrementalPurge::getInstance()->start(manager, interval, rows, budget);
+	}
+
+	unsigned int poolInterval = 0, poolMinimum = storageConfig.poolSize, poolMaximum = 0;
+	if (category->itemExists("poolScaleInterval"))
+	{
+		poolInterval = strtoul(category->getValue("poolScaleInterval").c_str(), NULL, 10);
+	}
+	if (category->itemExists("poolMinimum"))
+	{
+		poolMinimum = strtoul(category->getValue("poolMinimum").c_str(), NULL, 10);
+	}
+	if (category->itemExists("poolMaximum"))
+	{
+		poolMaximum = strtoul(category->getValue("poolMaximum").c_str(), NULL, 10);
+	}
+	poolAutoscaler = new PoolAutoscaler(manager);
+	if (poolInterval)
+	{
+		poolAutoscaler->start(poolMinimum, poolMaximum, poolInterval);
+	}
+
+	if (category->itemExists("purgeThreads"))
+	{
+		PurgeConfiguration::getInstance()->setThreads(strtoul(category->getValue("purgeThreads").c_str(), NULL, 10));
+	}
+
 	if (category->itemExists("purgeExclude"))
 	{
 		string exclusions = category->getValue("purgeExclude");
@@ -166,6 +571,7 @@ PLUGIN_HANDLE plugin_init(ConfigCategory *category)
  */
 int plugin_common_insert(PLUGIN_HANDLE handle, char *schema, char *table, char *data)
 {
+ProfileTimer	  timer(ProfileInsert);
 ConnectionManager *manager = (ConnectionManager *)handle;
 Connection        *connection = manager->allocate();
 
@@ -179,8 +585,9 @@ Connection        *connection = manager->allocate();
  */
 const char *plugin_common_retrieve(PLUGIN_HANDLE handle, char *schema, char *table, char *query)
 {
+ProfileTimer	  timer(ProfileQuery);
 ConnectionManager *manager = (ConnectionManager *)handle;
-Connection        *connection = manager->allocate();
+Connection        *connection = manager->allocateReader();
 std::string results;
 
 	bool rval = connection->retrieve(std::string(schema), std::string(table), std::string(query), results);
@@ -197,6 +604,7 @@ std::string results;
  */
 int plugin_common_update(PLUGIN_HANDLE handle, char *schema, char *table, char *data)
 {
+ProfileTimer	  timer(ProfileUpdate);
 ConnectionManager *manager = (ConnectionManager *)handle;
 Connection        *connection = manager->allocate();
 
@@ -210,6 +618,7 @@ Connection        *connection = manager->allocate();
  */
 int plugin_common_delete(PLUGIN_HANDLE handle, char *schema, char *table, char *condition)
 {
+ProfileTimer	  timer(ProfileDelete);
 ConnectionManager *manager = (ConnectionManager *)handle;
 Connection        *connection = manager->allocate();
 
@@ -223,6 +632,7 @@ Connection        *connection = manager->allocate();
  */
 int plugin_reading_append(PLUGIN_HANDLE handle, char *readings)
 {
+ProfileTimer	  timer(ProfileAppend);
 ConnectionManager *manager = (ConnectionManager *)handle;
 Connection        *connection = manager->allocate();
 
@@ -236,6 +646,7 @@ Connection        *connection = manager->allocate();
  */
 int plugin_readingStream(PLUGIN_HANDLE handle, ReadingStream **readings, bool commit)
 {
+	ProfileTimer	  timer(ProfileAppend);
 	int result = 0;
 	ConnectionManager *manager = (ConnectionManager *)handle;
 	Connection        *connection = manager->allocate();
@@ -251,8 +662,9 @@ int plugin_readingStream(PLUGIN_HANDLE handle, ReadingStream **readings, bool co
  */
 char *plugin_reading_fetch(PLUGIN_HANDLE handle, unsigned long id, unsigned int blksize)
 {
+ProfileTimer	  timer(ProfileFetch);
 ConnectionManager *manager = (ConnectionManager *)handle;
-Connection        *connection = manager->allocate();
+Connection        *connection = manager->allocateReader();
 std::string	  resultSet;
 
 	connection->fetchReadings(id, blksize, resultSet);
@@ -260,13 +672,94 @@ std::string	  resultSet;
 	return strdup(resultSet.c_str());
 }
 
+/**
+ * Fetch a block of readings from the readings buffer in the binary
+ * format of the fetch stream. The buffer is allocated with malloc
+ * and must be freed by the caller.
+ *
+ * @return int	The number of readings fetched or -1 on error
+ */
+int plugin_reading_fetch_binary(PLUGIN_HANDLE handle, unsigned long id, unsigned int blksize,
+				char **buffer, size_t *length)
+{
+ProfileTimer	  timer(ProfileFetch);
+ConnectionManager *manager = (ConnectionManager *)handle;
+Connection        *connection = manager->allocateReader();
+std::string	  resultSet;
+unsigned long	  rows = 0;
+
+	bool rval = connection->fetchReadingsBinary(id, blksize, resultSet, &rows);
+	manager->release(connection);
+	if (!rval)
+	{
+		return -1;
+	}
+	*length = resultSet.length();
+	*buffer = (char *)malloc(*length + 1);
+	memcpy(*buffer, resultSet.data(), *length);
+	return (int)rows;
+}
+
+/**
+ * Fetch a block of the readings of some of the assets from the readings
+ * buffer, returning only some of their datapoints. The request is a JSON
+ * document with the id of the first reading, the count of readings and
+ * optionally an array of assets, an exclude flag that inverts the
+ * selection of the assets and an array of datapoints.
+ *
+ * @param handle	The plugin handle
+ * @param request	The JSON request
+ * @return char*	The JSON result set or NULL if the request is not valid
+ */
+char *plugin_reading_fetch_filtered(PLUGIN_HANDLE handle, const char *request)
+{
+ProfileTimer	  timer(ProfileFetch);
+ConnectionManager *manager = (ConnectionManager *)handle;
+std::string	  resultSet;
+ReadingsFetchFilter filter;
+rapidjson::Document doc;
+
+	doc.Parse(request);
+	if (doc.HasParseError() || !doc.IsObject()
+			|| !doc.HasMember("id") || !doc["id"].IsUint64()
+			|| !doc.HasMember("count") || !doc["count"].IsUint())
+	{
+		Logger::getLogger()->error("Invalid filtered readings fetch request %s", request);
+		return NULL;
+	}
+	if (doc.HasMember("assets") && doc["assets"].IsArray())
+	{
+		for (auto& asset : doc["assets"].GetArray())
+		{
+			if (asset.IsString())
+				filter.assets.push_back(asset.GetString());
+		}
+	}
+	filter.exclude = doc.HasMember("exclude") && doc["exclude"].IsBool() && doc["exclude"].GetBool();
+	if (doc.HasMember("datapoints") && doc["datapoints"].IsArray())
+	{
+		for (auto& datapoint : doc["datapoints"].GetArray())
+		{
+			if (datapoint.IsString())
+				filter.datapoints.insert(datapoint.GetString());
+		}
+	}
+
+	Connection *connection = manager->allocateReader();
+	bool rval = connection->fetchReadingsFiltered(doc["id"].GetUint64(), doc["count"].GetUint(),
+			filter, resultSet);
+	manager->release(connection);
+	return rval ? strdup(resultSet.c_str()) : NULL;
+}
+
 /**
  * Retrieve some readings from the readings buffer
  */
 char *plugin_reading_retrieve(PLUGIN_HANDLE handle, char *condition)
 {
+ProfileTimer	  timer(ProfileReadingQuery);
 ConnectionManager *manager = (ConnectionManager *)handle;
-Connection        *connection = manager->allocate();
+Connection        *connection = manager->allocateReader();
 std::string results;
 
 	connection->retrieveReadings(std::string(condition), results);
@@ -274,17 +767,47 @@ std::string results;
 	return strdup(results.c_str());
 }
 
+/**
+ * Return the latest reading of each asset, made of the latest value
+ * of each datapoint of the asset
+ *
+ * @param handle	The plugin handle
+ * @param asset		The asset to return or NULL for all the assets
+ * @return char*	The JSON result set or NULL if the latest values are not kept
+ */
+char *plugin_reading_latest(PLUGIN_HANDLE handle, const char *asset)
+{
+LatestReadings	*latest = LatestReadings::getInstance();
+std::string	results;
+
+	(void)handle;
+	if (!latest->isEnabled())
+	{
+		return NULL;
+	}
+	latest->asJSON(results, asset);
+	return strdup(results.c_str());
+}
+
 /**
  * Purge readings from the buffer
  */
 char *plugin_reading_purge(PLUGIN_HANDLE handle, unsigned long param, unsigned int flags, unsigned long sent)
 {
+ProfileTimer	  timer(ProfilePurge);
 ConnectionManager *manager = (ConnectionManager *)handle;
-Connection        *connection = manager->allocate();
 std::string 	  results;
 unsigned long	  age, size;
 
-	if (flags & STORAGE_PURGE_SIZE)
+	// The incremental purge handles the purge by age, an age of 0 purges
+	// the oldest hour of readings and is left to the purge below
+	IncrementalPurge *incremental = IncrementalPurge::getInstance();
+	Connection        *connection = manager->allocate();
+	if (incremental->isRunning() && !(flags & STORAGE_PURGE_SIZE) && param > 0)
+	{
+		incremental->purge(param, flags, sent, results);
+	}
+	else if (flags & STORAGE_PURGE_SIZE)
 	{
 		(void)connection->purgeReadingsByRows(param, flags, sent, results);
 	}
@@ -293,6 +816,10 @@ unsigned long	  age, size;
 		age = param;
 		(void)connection->purgeReadings(age, flags, sent, results);
 	}
+
+	// The rollup is kept for as long as the readings it was built from,
+	// whichever way they were purged
+	connection->purgeRollup();
 	manager->release(connection);
 	return strdup(results.c_str());
 }
@@ -306,6 +833,43 @@ void plugin_release(PLUGIN_HANDLE handle, char *results)
 	free(results);
 }
 
+/**
+ * Return the statistics of the plugin as a JSON document
+ */
+char *plugin_statistics(PLUGIN_HANDLE handle)
+{
+	(void)handle;
+	string checkpoint;
+	WalCheckpointer::getInstance()->asJSON(checkpoint);
+	string vacuum;
+	ReadingsVacuum::getInstance()->asJSON(vacuum);
+	string pool;
+	poolAutoscaler->asJSON(pool);
+	string results = "{ \"checkpoint\" : " + checkpoint + ", \"vacuum\" : " + vacuum
+		+ ", \"pool\" : " + pool + " }";
+	return strdup(results.c_str());
+}
+
+/**
+ * Return the latency profile of the storage plugins as a JSON document
+ *
+ * @param handle	The plugin handle
+ * @param reset		Clear the profile once it has been returned
+ */
+char *plugin_profile(PLUGIN_HANDLE handle, bool reset)
+{
+StorageProfile	*profile = StorageProfile::getInstance();
+std::string	results;
+
+	(void)handle;
+	profile->asJSON(results);
+	if (reset)
+	{
+		profile->reset();
+	}
+	return strdup(results.c_str());
+}
+
 /**
  * Return details on the last error that occured.
  */
@@ -325,6 +889,12 @@ ConnectionManager *manager = (ConnectionManager *)handle;
 
 	Connection        *connection = manager->allocate();
 	connection->shutdownAppendReadings();
+	ReadingsWriter::getInstance()->stop();
+	WalCheckpointer::getInstance()->stop();
+	ReadingsVacuum::getInstance()->stop();
+	IncrementalPurge::getInstance()->stop();
+	ReadingsAllocator::getInstance()->stop();
+	poolAutoscaler->stop();
 
 	ReadingsCatalogue *readCat = ReadingsCatalogue::getInstance();
 	readCat->storeGlobalId();
@@ -413,7 +983,7 @@ const char* plugin_get_table_snapshots(PLUGIN_HANDLE handle,
 				char *table)
 {
 ConnectionManager *manager = (ConnectionManager *)handle;
-Connection        *connection = manager->allocate();
+Connection        *connection = manager->allocateReader();
 std::string results;
 
 	bool rval = connection->get_table_snapshots(std::string(table), results);
@@ -8,6 +8,8 @@
  * Author: Massimiliano Pinto
  */
 #include <connection.h>
+#include <payload_document.h>
+#include <storage_profile.h>
 #include <connection_manager.h>
 #include <common.h>
 #include <utils.h>
@@ -40,19 +42,15 @@ using namespace rapidjson;
 
 
 /*
- * The following allows for conditional inclusion of code that tracks the top queries
- * run by the storage plugin and the number of times a particular statement has to
- * be retried because of the database being busy./
+ * The following allows for conditional inclusion of code that tracks the number of
+ * times a particular statement has to be retried because of the database being busy.
+ * The slowest statements are always kept by the storage profile.
  */
 #define DO_PROFILE		0
 #define DO_PROFILE_RETRIES	0
 #if DO_PROFILE
-#include <profile.h>
-
-#define	TOP_N_STATEMENTS		10	// Number of statements to report in top n
 #define RETRY_REPORT_THRESHOLD		1000	// Report retry statistics every X calls
 
-QueryProfile profiler(TOP_N_STATEMENTS);
 unsigned long retryStats[MAX_RETRIES] = { 0,0,0,0,0,0,0,0,0,0 };
 unsigned long numStatements = 0;
 int	      maxQueue = 0;
@@ -597,6 +595,60 @@ Connection::Connection()
 			sqlite3_free(zErrMsg);
 		}
 
+		if (m_spill)
+		{
+			attachSpill();
+		}
+	}
+}
+
+bool Connection::m_spill = false;
+
+/**
+ * Attach the hot in memory database the readings are appended to when
+ * they are held in memory and flushed to the readings database in larger
+ * transactions.
+ *
+ * The first connection creates the hot readings table and starts its ids
+ * after the last id given by the readings database, so that the ids stay
+ * in order once the readings are flushed.
+ */
+void Connection::attachSpill()
+{
+	const char *columns = " (" \
+				"id		INTEGER			PRIMARY KEY AUTOINCREMENT," \
+				"asset_code	character varying(50)	NOT NULL," \
+				"reading	JSON			NOT NULL DEFAULT '{}'," \
+				"user_ts	DATETIME 		DEFAULT (STRFTIME('%Y-%m-%d %H:%M:%f+00:00', 'NOW' ))," \
+				"ts		DATETIME 		DEFAULT (STRFTIME('%Y-%m-%d %H:%M:%f+00:00', 'NOW' ))" \
+				");";
+
+	char *zErrMsg = NULL;
+	if (SQLexec(dbHandle, "ATTACH DATABASE 'file::memory:?cache=shared' AS '" READINGS_HOT_DB "';",
+				NULL, NULL, &zErrMsg) != SQLITE_OK)
+	{
+		raiseError("Connection", "Failed to attach the in memory readings database: %s",
+			   zErrMsg ? zErrMsg : "");
+		sqlite3_free(zErrMsg);
+		return;
+	}
+
+	// The hot table is created once, by the first connection to the shared memory database
+	string sql = string("CREATE TABLE " READINGS_HOT_DB "." READINGS_TABLE) + columns;
+	if (sqlite3_exec(dbHandle, sql.c_str(), NULL, NULL, NULL) == SQLITE_OK)
+	{
+		// The sequence is used rather than the last id, the readings on disk may all have been purged
+		sql = "INSERT INTO " READINGS_HOT_DB ".sqlite_sequence (name, seq) "
+			"SELECT '" READINGS_TABLE "', MAX("
+				"IFNULL((SELECT MAX(id) FROM " READINGS_DB_NAME_BASE "." READINGS_TABLE "), 0), "
+				"IFNULL((SELECT seq FROM " READINGS_DB_NAME_BASE ".sqlite_sequence WHERE name = '" READINGS_TABLE "'), 0));";
+		if (SQLexec(dbHandle, sql.c_str(), NULL, NULL, &zErrMsg) != SQLITE_OK)
+		{
+			raiseError("Connection", "Failed to set the first id of the readings: %s",
+				   zErrMsg ? zErrMsg : "");
+			sqlite3_free(zErrMsg);
+		}
+		Logger::getLogger()->info("Readings are held in memory and flushed to the readings database");
 	}
 }
 #endif
@@ -846,8 +898,8 @@ bool Connection::retrieve(const string& table,
 			  const string& condition,
 			  string& resultSet)
 {
-// Default template parameter uses UTF8 and MemoryPoolAllocator.
-Document	document;
+PayloadDocument	payloadDoc;
+Document&	document = payloadDoc.get();
 SQLBuffer	sql;
 // Extra constraints to add to where clause
 SQLBuffer	jsonConstraints;
@@ -866,7 +918,7 @@ SQLBuffer	jsonConstraints;
 		}
 		else
 		{
-			if (document.Parse(condition.c_str()).HasParseError())
+			if (payloadDoc.parse(condition.c_str()).HasParseError())
 			{
 				raiseError("retrieve", "Failed to parse JSON payload");
 				return false;
@@ -1083,7 +1135,8 @@ SQLBuffer	jsonConstraints;
 int Connection::insert(const std::string& table, const std::string& data)
 {
 SQLBuffer	sql;
-Document	document;
+PayloadDocument	payloadDoc;
+Document&	document = payloadDoc.get();
 ostringstream convert;
 std::size_t arr = data.find("inserts");
 
@@ -1099,7 +1152,7 @@ std::size_t arr = data.find("inserts");
 		convert << " ] }";
 	}
 
-	if (document.Parse(stdInsert ? convert.str().c_str() : data.c_str()).HasParseError())
+	if (payloadDoc.parse(stdInsert ? convert.str().c_str() : data.c_str()).HasParseError())
 	{
 		raiseError("insert", "Failed to parse JSON payload\n");
 		return -1;
@@ -1267,8 +1320,8 @@ std::size_t arr = data.find("inserts");
  */
 int Connection::update(const string& table, const string& payload)
 {
-// Default template parameter uses UTF8 and MemoryPoolAllocator.
-Document	document;
+PayloadDocument	payloadDoc;
+Document&	document = payloadDoc.get();
 SQLBuffer	sql;
 
 	int 	row = 0;
@@ -1283,7 +1336,7 @@ SQLBuffer	sql;
 		convert << " ] }";
 	}
 
-	if (document.Parse(changeReqd?convert.str().c_str():payload.c_str()).HasParseError())
+	if (payloadDoc.parse(changeReqd?convert.str().c_str():payload.c_str()).HasParseError())
 	{
 		raiseError("update", "Failed to parse JSON payload");
 		return -1;
@@ -2828,14 +2881,10 @@ int retries = 0, rc;
 int interval;
 
 	do {
-#if DO_PROFILE
-		ProfileItem *prof = new ProfileItem(sql);
-#endif
-		rc = sqlite3_exec(db, sql, callback, cbArg, errmsg);
-#if DO_PROFILE
-		prof->complete();
-		profiler.insert(prof);
-#endif
+		{
+			StatementTimer timer(sql);
+			rc = sqlite3_exec(db, sql, callback, cbArg, errmsg);
+		}
 		retries++;
 		if (rc != SQLITE_OK)
 		{
@@ -2924,14 +2973,10 @@ int Connection::SQLstep(sqlite3_stmt *statement)
 	int interval;
 
 	do {
-#if DO_PROFILE
-		ProfileItem *prof = new ProfileItem(sqlite3_sql(statement));
-#endif
-		rc = sqlite3_step(statement);
-#if DO_PROFILE
-		prof->complete();
-		profiler.insert(prof);
-#endif
+		{
+			StatementTimer timer(sqlite3_sql(statement));
+			rc = sqlite3_step(statement);
+		}
 		retries++;
 		if (rc == SQLITE_LOCKED || rc == SQLITE_BUSY)
 		{
@@ -2989,8 +3034,8 @@ int Connection::SQLstep(sqlite3_stmt *statement)
  */
 int Connection::deleteRows(const string& table, const string& condition)
 {
-// Default template parameter uses UTF8 and MemoryPoolAllocator.
-Document document;
+PayloadDocument payloadDoc;
+Document& document = payloadDoc.get();
 SQLBuffer	sql;
  
 	sql.append("DELETE FROM fledge.");
@@ -2998,7 +3043,7 @@ SQLBuffer	sql;
 	if (! condition.empty())
 	{
 		sql.append(" WHERE ");
-		if (document.Parse(condition.c_str()).HasParseError())
+		if (payloadDoc.parse(condition.c_str()).HasParseError())
 		{
 			raiseError("delete", "Failed to parse JSON payload");
 			return -1;
@@ -23,6 +23,8 @@
 #define READINGS_DB               READINGS_DB_NAME_BASE
 #define READINGS_TABLE            "readings"
 #define READINGS_TABLE_MEM       READINGS_TABLE
+#define READINGS_HOT_DB           "readings_hot"
+#define READINGS_SPILL_FILE_NAME  "/readings_spill.db"
 
 #define MAX_RETRIES				80	// Maximum no. of retries when a lock is encountered
 #define RETRY_BACKOFF			100	// Multipler to backoff DB retry on lock
@@ -106,8 +108,17 @@ class Connection {
 		bool		formatDate(char *formatted_date, size_t formatted_date_size, const char *date);
 		bool		aggregateQuery(const rapidjson::Value& payload, std::string& resultSet);
 		bool        getNow(std::string& Now);
+		static void	setSpill(bool spill) { m_spill = spill; };
+		static bool	isSpill() { return m_spill; };
+		long		flushReadings(unsigned long blockSize);
+		static const char
+				*readingsAppendTable();
+		static const char
+				*readingsSource();
 
 	private:
+		static bool	m_spill;	// Readings appended in memory and flushed to disk
+		void		attachSpill();
 		bool 		m_streamOpenTransaction;
 		int		m_queuing;
 		std::mutex	m_qMutex;
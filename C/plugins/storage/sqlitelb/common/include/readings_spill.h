@@ -0,0 +1,54 @@
+#ifndef _READINGS_SPILL_H
+#define _READINGS_SPILL_H
+/*
+ * Fledge storage service - Spill to disk of the in memory readings
+ *
+ * Copyright (c) 2026 Dianomic Systems
+ *
+ * Released under the Apache 2.0 Licence
+ *
+ * Author: agent
+ */
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <atomic>
+
+class Connection;
+class ConnectionManager;
+
+/**
+ * A thread that flushes the readings appended in memory to the readings
+ * database on disk. The readings are flushed every interval, or as soon
+ * as the readings held in memory exceed the memory cap, and all of them
+ * are flushed when the plugin shuts down.
+ */
+class ReadingsSpill {
+	public:
+		static ReadingsSpill	*getInstance();
+		void			start(ConnectionManager *manager,
+						unsigned int interval,
+						unsigned long maxReadings);
+		void			stop();
+		bool			isRunning() const { return m_running; };
+		void			appended(int readings);
+	private:
+		ReadingsSpill();
+		~ReadingsSpill();
+		void			flushThread();
+		void			flush();
+	private:
+		static ReadingsSpill	*m_instance;
+		ConnectionManager	*m_manager;
+		Connection		*m_connection;
+		std::thread		*m_thread;
+		bool			m_running;
+		unsigned int		m_interval;		// Seconds between the flushes
+		unsigned long		m_maxReadings;		// Readings in memory that trigger a flush
+		std::atomic<long>	m_inMemory;		// Readings appended and not yet flushed
+		bool			m_requested;		// Protected by m_mutex
+		std::mutex		m_mutex;
+		std::condition_variable	m_cv;
+};
+
+#endif
@@ -10,9 +10,12 @@
 
 #include <math.h>
 #include <connection.h>
+#include <payload_document.h>
 #include <connection_manager.h>
 #include <common.h>
 #include <reading_stream.h>
+#include <reading_stream_payload.h>
+#include <tracer.h>
 #include <random>
 
 // 1 enable performance tracking
@@ -68,19 +71,15 @@ using namespace rapidjson;
 
 
 /*
- * The following allows for conditional inclusion of code that tracks the top queries
- * run by the storage plugin and the number of times a particular statement has to
- * be retried because of the database being busy./
+ * The following allows for conditional inclusion of code that tracks the number of
+ * times a particular statement has to be retried because of the database being busy.
+ * The slowest statements are always kept by the storage profile.
  */
 #define DO_PROFILE		0
 #define DO_PROFILE_RETRIES	0
 #if DO_PROFILE
-#include <profile.h>
-
-#define	TOP_N_STATEMENTS		10	// Number of statements to report in top n
 #define RETRY_REPORT_THRESHOLD		1000	// Report retry statistics every X calls
 
-QueryProfile profiler(TOP_N_STATEMENTS);
 unsigned long retryStats[MAX_RETRIES] = { 0,0,0,0,0,0,0,0,0,0 };
 unsigned long numStatements = 0;
 int	      maxQueue = 0;
@@ -98,6 +97,98 @@ static int purgeBlockSize = PURGE_DELETE_BLOCK_SIZE;
 
 static time_t connectErrorTime = 0;
 
+/**
+ * The readings table the appends insert into. With the spill to disk the
+ * readings are appended to the hot in memory database, the readings
+ * database is then the one on disk.
+ *
+ * @return	The qualified name of the table
+ */
+const char *Connection::readingsAppendTable()
+{
+	if (m_spill)
+	{
+		return READINGS_HOT_DB ".readings";
+	}
+	return READINGS_DB_NAME_BASE ".readings";
+}
+
+/**
+ * The source of the readings for the queries. With the spill to disk the
+ * queries span the readings on disk and those not yet flushed, the source
+ * is then aliased as the readings table.
+ *
+ * @return	The table or subquery to select the readings from
+ */
+const char *Connection::readingsSource()
+{
+	if (m_spill)
+	{
+		return "(SELECT id, asset_code, reading, user_ts, ts FROM " READINGS_DB_NAME_BASE ".readings"
+			" UNION ALL "
+			"SELECT id, asset_code, reading, user_ts, ts FROM " READINGS_HOT_DB ".readings) AS readings";
+	}
+	return READINGS_DB_NAME_BASE ".readings";
+}
+
+/**
+ * Move the readings of the hot in memory database to the readings database
+ * on disk. The readings are moved in blocks of consecutive ids, each block
+ * with a single INSERT ... SELECT and DELETE in its own transaction so that
+ * the appends are not held up by one long transaction.
+ *
+ * @param blockSize	The maximum number of readings moved by a transaction
+ * @return long		The number of readings moved, -1 on error
+ */
+long Connection::flushReadings(unsigned long blockSize)
+{
+char sqlbuffer[512];
+char *zErrMsg = NULL;
+long moved = 0;
+
+	while (true)
+	{
+		unsigned long maxId = 0;
+		sqlite3_stmt *stmt;
+
+		snprintf(sqlbuffer, sizeof(sqlbuffer),
+			 "SELECT MAX(id) FROM (SELECT id FROM " READINGS_HOT_DB "." READINGS_TABLE " ORDER BY id LIMIT %lu);",
+			 blockSize);
+		if (sqlite3_prepare_v2(dbHandle, sqlbuffer, -1, &stmt, NULL) != SQLITE_OK)
+		{
+			raiseError("flushReadings", sqlite3_errmsg(dbHandle));
+			return -1;
+		}
+		if (SQLstep(stmt) == SQLITE_ROW && sqlite3_column_type(stmt, 0) != SQLITE_NULL)
+		{
+			maxId = (unsigned long)sqlite3_column_int64(stmt, 0);
+		}
+		sqlite3_finalize(stmt);
+
+		if (maxId == 0)
+		{
+			break;
+		}
+
+		snprintf(sqlbuffer, sizeof(sqlbuffer),
+			 "BEGIN TRANSACTION;"
+			 "INSERT INTO " READINGS_DB_NAME_BASE "." READINGS_TABLE " (id, asset_code, reading, user_ts, ts) "
+			 "SELECT id, asset_code, reading, user_ts, ts FROM " READINGS_HOT_DB "." READINGS_TABLE " WHERE id <= %lu;"
+			 "DELETE FROM " READINGS_HOT_DB "." READINGS_TABLE " WHERE id <= %lu;"
+			 "COMMIT TRANSACTION;",
+			 maxId, maxId);
+		logSQL("ReadingsFlush", sqlbuffer);
+		if (SQLexec(dbHandle, sqlbuffer, NULL, NULL, &zErrMsg) != SQLITE_OK)
+		{
+			raiseError("flushReadings", zErrMsg ? zErrMsg : sqlite3_errmsg(dbHandle));
+			sqlite3_free(zErrMsg);
+			return -1;
+		}
+		moved += sqlite3_changes(dbHandle);
+	}
+	return moved;
+}
+
 
 /**
  * Check whether to compute timebucket query with min,max,avg for all datapoints
@@ -276,7 +367,9 @@ bool Connection::aggregateQuery(const Value& payload, string& resultSet)
 	}
 
 	// Get all datapoints in 'reading' field
-	sql.append("json_each.key AS x, json_each.value AS theval FROM " READINGS_DB_NAME_BASE ".readings, json_each(readings.reading) ");
+	sql.append("json_each.key AS x, json_each.value AS theval FROM ");
+	sql.append(readingsSource());
+	sql.append(", json_each(readings.reading) ");
 
 	// Add where condition
 	sql.append("WHERE ");
@@ -375,6 +468,7 @@ bool Connection::aggregateQuery(const Value& payload, string& resultSet)
  */
 int Connection::readingStream(ReadingStream **readings, bool commit)
 {
+	TRACE_SPAN("storage-plugin", "Connection::readingStream");
 	// Row defintion related
 	int i;
 	bool add_row = false;
@@ -385,6 +479,8 @@ int Connection::readingStream(ReadingStream **readings, bool commit)
 	struct tm timeinfo;
 	const char *asset_code;
 	const char *payload;
+	const char *readingText = NULL;
+	size_t readingLength = 0;
 	string reading;
 
 	// Retry mechanism
@@ -400,9 +496,9 @@ int Connection::readingStream(ReadingStream **readings, bool commit)
 	struct timeval start, t1, t2, t3, t4, t5;
 #endif
 
-	const char *sql_cmd = "INSERT INTO  " READINGS_DB_NAME_BASE ".readings ( asset_code, reading, user_ts ) VALUES  (?,?,?)";
+	string sql_cmd = string("INSERT INTO  ") + readingsAppendTable() + " ( asset_code, reading, user_ts ) VALUES  (?,?,?)";
 
-	if (sqlite3_prepare_v2(dbHandle, sql_cmd, strlen(sql_cmd), &stmt, NULL) != SQLITE_OK)
+	if (sqlite3_prepare_v2(dbHandle, sql_cmd.c_str(), sql_cmd.length(), &stmt, NULL) != SQLITE_OK)
 	{
 		raiseError("readingStream", sqlite3_errmsg(dbHandle));
 		return -1;
@@ -438,7 +534,36 @@ int Connection::readingStream(ReadingStream **readings, bool commit)
 
 			// Handles - reading
 			payload = RDS_PAYLOAD(readings, i);
-			reading = escape(payload);
+			if (readings[i]->payloadFormat == RDS_PAYLOAD_BINARY)
+			{
+				// Write the JSON for the reading column directly from the binary datapoints
+				if (!ReadingStreamPayload::toJSON(payload, readings[i]->payloadLength, reading))
+				{
+					raiseError("readingStream", "Unable to decode binary payload for asset %s", asset_code);
+					add_row = false;
+				}
+				if (reading.find('\'') != string::npos)
+				{
+					reading = escape(reading);
+				}
+				readingText = reading.data();
+				readingLength = reading.length();
+			}
+			else
+			{
+				// Bind directly against the stream buffer unless escaping is required
+				readingLength = strnlen(payload, readings[i]->payloadLength);
+				if (memchr(payload, '\'', readingLength))
+				{
+					reading = escape(string(payload, readingLength));
+					readingText = reading.data();
+					readingLength = reading.length();
+				}
+				else
+				{
+					readingText = payload;
+				}
+			}
 
 			// Handles - user_ts
 			memset(&timeinfo, 0, sizeof(struct tm));
@@ -472,7 +597,7 @@ int Connection::readingStream(ReadingStream **readings, bool commit)
 				if (stmt != NULL)
 				{
 					sqlite3_bind_text(stmt, 1, asset_code,      -1, SQLITE_STATIC);
-					sqlite3_bind_text(stmt, 2, reading.c_str(), -1, SQLITE_STATIC);
+					sqlite3_bind_text(stmt, 2, readingText,     (int)readingLength, SQLITE_STATIC);
 					sqlite3_bind_text(stmt, 3, user_ts,         -1, SQLITE_STATIC);
 
 					retries =0;
@@ -524,10 +649,10 @@ int Connection::readingStream(ReadingStream **readings, bool commit)
 					else
 					{
 						raiseError("appendReadings",
-								   "Inserting a row into SQLIte using a prepared command - asset_code :%s: error :%s: reading :%s: ",
+								   "Inserting a row into SQLIte using a prepared command - asset_code :%s: error :%s: reading :%.*s: ",
 								   asset_code,
 								   sqlite3_errmsg(dbHandle),
-								   reading.c_str());
+								   (int)readingLength, readingText);
 
 						sqlite3_exec(dbHandle, "ROLLBACK TRANSACTION", NULL, NULL, NULL);
 						m_streamOpenTransaction = true;
@@ -600,8 +725,9 @@ int Connection::readingStream(ReadingStream **readings, bool commit)
  */
 int Connection::appendReadings(const char *readings)
 {
-// Default template parameter uses UTF8 and MemoryPoolAllocator.
-Document doc;
+	TRACE_SPAN("storage-plugin", "Connection::appendReadings");
+PayloadDocument payloadDoc;
+Document& doc = payloadDoc.get();
 int      row = 0;
 bool     add_row = false;
 
@@ -630,7 +756,7 @@ int sleep_time_ms = 0;
 	gettimeofday(&start, NULL);
 #endif
 
-	ParseResult ok = doc.Parse(readings);
+	ParseResult ok = payloadDoc.parse(readings);
 	if (!ok)
 	{
  		raiseError("appendReadings", GetParseError_En(doc.GetParseError()));
@@ -649,9 +775,9 @@ int sleep_time_ms = 0;
 		return -1;
 	}
 
-	const char *sql_cmd="INSERT INTO  " READINGS_DB_NAME_BASE ".readings ( user_ts, asset_code, reading ) VALUES  (?,?,?)";
+	string sql_cmd = string("INSERT INTO  ") + readingsAppendTable() + " ( user_ts, asset_code, reading ) VALUES  (?,?,?)";
 
-	sqlite3_prepare_v2(dbHandle, sql_cmd, strlen(sql_cmd), &stmt, NULL);
+	sqlite3_prepare_v2(dbHandle, sql_cmd.c_str(), sql_cmd.length(), &stmt, NULL);
 	{
 	m_writeAccessOngoing.fetch_add(1);
 	//unique_lock<mutex> lck(db_mutex);
@@ -834,7 +960,8 @@ bool Connection::fetchReadings(unsigned long id,
 			       unsigned int blksize,
 			       std::string& resultSet)
 {
-char sqlbuffer[512];
+	TRACE_SPAN("storage-plugin", "Connection::fetchReadings");
+char sqlbuffer[1024];
 char *zErrMsg = NULL;
 int rc;
 int retrieve;
@@ -862,6 +989,35 @@ int retrieve;
 		 sql_cmd,
 		 id,
 		 blksize);
+	if (m_spill)
+	{
+		// The block is taken from the readings on disk followed by those not yet flushed
+		const char *spill_cmd = R"(
+		SELECT
+			id,
+			asset_code,
+			reading,
+			strftime('%%Y-%%m-%%d %%H:%%M:%%S', user_ts, 'utc')  ||
+			substr(user_ts, instr(user_ts, '.'), 7) AS user_ts,
+			strftime('%%Y-%%m-%%d %%H:%%M:%%f', ts, 'utc') AS ts
+		FROM (
+			SELECT * FROM (SELECT * FROM )" READINGS_DB_NAME_BASE R"(.readings WHERE id >= %lu ORDER BY id ASC LIMIT %u)
+			UNION ALL
+			SELECT * FROM (SELECT * FROM )" READINGS_HOT_DB R"(.readings WHERE id >= %lu ORDER BY id ASC LIMIT %u)
+		) AS readings
+		ORDER BY id ASC
+		LIMIT %u;
+		)";
+
+		snprintf(sqlbuffer,
+			 sizeof(sqlbuffer),
+			 spill_cmd,
+			 id,
+			 blksize,
+			 id,
+			 blksize,
+			 blksize);
+	}
 	logSQL("ReadingsFetch", sqlbuffer);
 	sqlite3_stmt *stmt;
 	// Prepare the SQL statement and get the result set
@@ -909,8 +1065,8 @@ int retrieve;
  */
 bool Connection::retrieveReadings(const string& condition, string& resultSet)
 {
-// Default template parameter uses UTF8 and MemoryPoolAllocator.
-Document	document;
+PayloadDocument	payloadDoc;
+Document&	document = payloadDoc.get();
 SQLBuffer	sql;
 // Extra constraints to add to where clause
 SQLBuffer	jsonConstraints;
@@ -933,13 +1089,14 @@ bool		isAggregate = false;
 						strftime(')" F_DATEH24_SEC R"(', user_ts, 'localtime')  ||
 						substr(user_ts, instr(user_ts, '.'), 7) AS user_ts,
 						strftime(')" F_DATEH24_MS R"(', ts, 'localtime') AS ts
-					FROM )" READINGS_DB_NAME_BASE R"(.readings)";
+					FROM )";
 
 			sql.append(sql_cmd);
+			sql.append(readingsSource());
 		}
 		else
 		{
-			if (document.Parse(condition.c_str()).HasParseError())
+			if (payloadDoc.parse(condition.c_str()).HasParseError())
 			{
 				raiseError("retrieve", "Failed to parse JSON payload");
 				return false;
@@ -964,7 +1121,7 @@ bool		isAggregate = false;
 				{
 					return false;
 				}
-				sql.append(" FROM  " READINGS_DB_NAME_BASE ".");
+				sql.append(" FROM  ");
 			}
 			else if (document.HasMember("return"))
 			{
@@ -1153,7 +1310,7 @@ bool		isAggregate = false;
 					}
 					col++;
 				}
-				sql.append(" FROM  " READINGS_DB_NAME_BASE ".");
+				sql.append(" FROM  ");
 			}
 			else
 			{
@@ -1171,11 +1328,11 @@ bool		isAggregate = false;
 						strftime(')" F_DATEH24_SEC R"(', user_ts, 'localtime')  ||
 						substr(user_ts, instr(user_ts, '.'), 7) AS user_ts,
 						strftime(')" F_DATEH24_MS R"(', ts, 'localtime') AS ts
-                    FROM  )" READINGS_DB_NAME_BASE R"(.)";
+                    FROM  )";
 
 				sql.append(sql_cmd);
 			}
-			sql.append("readings");
+			sql.append(readingsSource());
 			if (document.HasMember("where"))
 			{
 				sql.append(" WHERE ");
@@ -0,0 +1,165 @@
+/*
+ * Fledge storage service - Spill to disk of the in memory readings
+ *
+ * Copyright (c) 2026 Dianomic Systems
+ *
+ * Released under the Apache 2.0 Licence
+ *
+ * Author: agent
+ */
+
+#include <readings_spill.h>
+#include <connection.h>
+#include <connection_manager.h>
+#include <logger.h>
+
+using namespace std;
+
+/**
+ * The readings moved to disk by each transaction of a flush
+ */
+#define SPILL_BLOCK_SIZE	5000
+
+ReadingsSpill *ReadingsSpill::m_instance = 0;
+
+/**
+ * Constructor for the readings spill
+ */
+ReadingsSpill::ReadingsSpill() : m_manager(NULL), m_connection(NULL),
+	m_thread(NULL), m_running(false), m_interval(0), m_maxReadings(0),
+	m_inMemory(0), m_requested(false)
+{
+}
+
+/**
+ * Destructor for the readings spill
+ */
+ReadingsSpill::~ReadingsSpill()
+{
+	stop();
+}
+
+/**
+ * Return the singleton instance of the ReadingsSpill class
+ * for this plugin
+ *
+ * @return ReadingsSpill* singleton instance
+ */
+ReadingsSpill *ReadingsSpill::getInstance()
+{
+	if (m_instance == 0)
+	{
+		m_instance = new ReadingsSpill();
+	}
+	return m_instance;
+}
+
+/**
+ * Start the flush thread. The thread keeps a connection from the
+ * pool for its own use until it is stopped.
+ *
+ * @param manager	The connection manager of the plugin
+ * @param interval	Seconds between the flushes
+ * @param maxReadings	The readings held in memory that trigger a flush
+ */
+void ReadingsSpill::start(ConnectionManager *manager, unsigned int interval,
+			  unsigned long maxReadings)
+{
+	lock_guard<mutex> guard(m_mutex);
+	if (m_running)
+	{
+		return;
+	}
+	m_manager = manager;
+	m_interval = interval ? interval : 1;
+	m_maxReadings = maxReadings;
+	m_connection = manager->allocate();
+	m_running = true;
+	m_thread = new thread(&ReadingsSpill::flushThread, this);
+	Logger::getLogger()->info("Readings will be flushed to disk every %u seconds or above %lu readings in memory",
+			m_interval, m_maxReadings);
+}
+
+/**
+ * Stop the flush thread, the readings still in memory are flushed
+ * before the thread exits
+ */
+void ReadingsSpill::stop()
+{
+	{
+		lock_guard<mutex> guard(m_mutex);
+		if (!m_running)
+		{
+			return;
+		}
+		m_running = false;
+	}
+	m_cv.notify_all();
+	m_thread->join();
+	delete m_thread;
+	m_thread = NULL;
+	m_manager->release(m_connection);
+	m_connection = NULL;
+}
+
+/**
+ * Account for the readings appended in memory, the thread is woken
+ * when they exceed the memory cap
+ *
+ * @param readings	The number of readings appended
+ */
+void ReadingsSpill::appended(int readings)
+{
+	if (readings <= 0 || !m_running)
+	{
+		return;
+	}
+	long inMemory = m_inMemory.fetch_add(readings) + readings;
+	if (m_maxReadings && (unsigned long)inMemory >= m_maxReadings)
+	{
+		{
+			lock_guard<mutex> guard(m_mutex);
+			m_requested = true;
+		}
+		m_cv.notify_all();
+	}
+}
+
+/**
+ * The flush thread, flushes the readings every interval or when woken
+ * by the memory cap and once more when the thread is stopped
+ */
+void ReadingsSpill::flushThread()
+{
+	while (true)
+	{
+		bool running;
+		{
+			unique_lock<mutex> lck(m_mutex);
+			m_cv.wait_for(lck, chrono::seconds(m_interval),
+					[this]{ return !m_running || m_requested; });
+			m_requested = false;
+			running = m_running;
+		}
+
+		flush();
+
+		if (!running)
+		{
+			break;
+		}
+	}
+}
+
+/**
+ * Flush the readings held in memory to disk
+ */
+void ReadingsSpill::flush()
+{
+	long moved = m_connection->flushReadings(SPILL_BLOCK_SIZE);
+	if (moved > 0)
+	{
+		m_inMemory.fetch_sub(moved);
+		Logger::getLogger()->debug("ReadingsSpill - flushed %ld readings to disk", moved);
+	}
+}
@@ -11,6 +11,7 @@
 #include <connection_manager.h>
 #include <connection.h>
 #include <plugin_api.h>
+#include <storage_profile.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <strings.h>
@@ -25,6 +26,7 @@
 #include <plugin_exception.h>
 #include <reading_stream.h>
 #include <config_category.h>
+#include <readings_spill.h>
 
 using namespace std;
 using namespace rapidjson;
@@ -41,6 +43,29 @@ const char *default_config = QUOTE({
 			"default" : "5",
 			"displayName" : "Pool Size",
 			"order" : "1"
+			},
+		"memoryBuffer" : {
+			"description" : "Hold the appended readings in memory and write them to the readings database in larger, less frequent transactions. The readings not yet written are lost if the system fails",
+			"type" : "boolean",
+			"default" : "false",
+			"displayName" : "Buffer readings in memory",
+			"order" : "2"
+			},
+		"flushInterval" : {
+			"description" : "Seconds between the writes of the readings held in memory to the readings database",
+			"type" : "integer",
+			"default" : "30",
+			"minimum" : "1",
+			"displayName" : "Flush interval",
+			"order" : "3"
+			},
+		"maxMemoryReadings" : {
+			"description" : "The number of readings held in memory above which they are written before the flush interval, 0 writes them only every interval",
+			"type" : "integer",
+			"default" : "50000",
+			"minimum" : "0",
+			"displayName" : "Memory cap (readings)",
+			"order" : "4"
 			}
 		});
 
@@ -78,7 +103,24 @@ int poolSize = 5;
 	{
 		poolSize = strtol(category->getValue("poolSize").c_str(), NULL, 10);
 	}
+
+	// The connections attach the in memory readings database as they are created
+	bool buffer = category->itemExists("memoryBuffer")
+			&& category->getValue("memoryBuffer").compare("true") == 0;
+	Connection::setSpill(buffer);
+
 	manager->growPool(poolSize);
+
+	if (buffer)
+	{
+		unsigned int interval = 30;
+		unsigned long maxReadings = 50000;
+		if (category->itemExists("flushInterval"))
+			interval = strtoul(category->getValue("flushInterval").c_str(), NULL, 10);
+		if (category->itemExists("maxMemoryReadings"))
+			maxReadings = strtoul(category->getValue("maxMemoryReadings").c_str(), NULL, 10);
+		ReadingsSpill::getInstance()->start(manager, interval, maxReadings);
+	}
 	return manager;
 }
 
@@ -87,6 +129,7 @@ int poolSize = 5;
  */
 int plugin_common_insert(PLUGIN_HANDLE handle, char *table, char *data)
 {
+ProfileTimer	  timer(ProfileInsert);
 ConnectionManager *manager = (ConnectionManager *)handle;
 Connection        *connection = manager->allocate();
 
@@ -100,6 +143,7 @@ Connection        *connection = manager->allocate();
  */
 const char *plugin_common_retrieve(PLUGIN_HANDLE handle, char *table, char *query)
 {
+ProfileTimer	  timer(ProfileQuery);
 ConnectionManager *manager = (ConnectionManager *)handle;
 Connection        *connection = manager->allocate();
 std::string results;
@@ -118,6 +162,7 @@ std::string results;
  */
 int plugin_common_update(PLUGIN_HANDLE handle, char *table, char *data)
 {
+ProfileTimer	  timer(ProfileUpdate);
 ConnectionManager *manager = (ConnectionManager *)handle;
 Connection        *connection = manager->allocate();
 
@@ -131,6 +176,7 @@ Connection        *connection = manager->allocate();
  */
 int plugin_common_delete(PLUGIN_HANDLE handle, char *table, char *condition)
 {
+ProfileTimer	  timer(ProfileDelete);
 ConnectionManager *manager = (ConnectionManager *)handle;
 Connection        *connection = manager->allocate();
 
@@ -144,11 +190,13 @@ Connection        *connection = manager->allocate();
  */
 int plugin_reading_append(PLUGIN_HANDLE handle, char *readings)
 {
+ProfileTimer	  timer(ProfileAppend);
 ConnectionManager *manager = (ConnectionManager *)handle;
 Connection        *connection = manager->allocate();
 
 	int result = connection->appendReadings(readings);
 	manager->release(connection);
+	ReadingsSpill::getInstance()->appended(result);
 	return result;;
 }
 
@@ -157,6 +205,7 @@ Connection        *connection = manager->allocate();
  */
 int plugin_readingStream(PLUGIN_HANDLE handle, ReadingStream **readings, bool commit)
 {
+	ProfileTimer	  timer(ProfileAppend);
 	int result = 0;
 	ConnectionManager *manager = (ConnectionManager *)handle;
 	Connection        *connection = manager->allocate();
@@ -164,6 +213,7 @@ int plugin_readingStream(PLUGIN_HANDLE handle, ReadingStream **readings, bool co
 	result = connection->readingStream(readings, commit);
 
 	manager->release(connection);
+	ReadingsSpill::getInstance()->appended(result);
 	return result;;
 }
 
@@ -172,6 +222,7 @@ int plugin_readingStream(PLUGIN_HANDLE handle, ReadingStream **readings, bool co
  */
 char *plugin_reading_fetch(PLUGIN_HANDLE handle, unsigned long id, unsigned int blksize)
 {
+ProfileTimer	  timer(ProfileFetch);
 ConnectionManager *manager = (ConnectionManager *)handle;
 Connection        *connection = manager->allocate();
 std::string	  resultSet;
@@ -186,6 +237,7 @@ std::string	  resultSet;
  */
 char *plugin_reading_retrieve(PLUGIN_HANDLE handle, char *condition)
 {
+ProfileTimer	  timer(ProfileReadingQuery);
 ConnectionManager *manager = (ConnectionManager *)handle;
 Connection        *connection = manager->allocate();
 std::string results;
@@ -200,6 +252,7 @@ std::string results;
  */
 char *plugin_reading_purge(PLUGIN_HANDLE handle, unsigned long param, unsigned int flags, unsigned long sent)
 {
+ProfileTimer	  timer(ProfilePurge);
 ConnectionManager *manager = (ConnectionManager *)handle;
 Connection        *connection = manager->allocate();
 std::string 	  results;
@@ -227,6 +280,26 @@ void plugin_release(PLUGIN_HANDLE handle, char *results)
 	free(results);
 }
 
+/**
+ * Return the latency profile of the storage plugins as a JSON document
+ *
+ * @param handle	The plugin handle
+ * @param reset		Clear the profile once it has been returned
+ */
+char *plugin_profile(PLUGIN_HANDLE handle, bool reset)
+{
+StorageProfile	*profile = StorageProfile::getInstance();
+std::string	results;
+
+	(void)handle;
+	profile->asJSON(results);
+	if (reset)
+	{
+		profile->reset();
+	}
+	return strdup(results.c_str());
+}
+
 /**
  * Return details on the last error that occured.
  */
@@ -244,6 +317,7 @@ bool plugin_shutdown(PLUGIN_HANDLE handle)
 {
 ConnectionManager *manager = (ConnectionManager *)handle;
   
+	ReadingsSpill::getInstance()->stop();
 	manager->shutdown();
 	return true;
 }
@@ -10,6 +10,7 @@
 #include <connection.h>
 #include <connection_manager.h>
 #include <common.h>
+#include <utils.h>
 
 /**
  * SQLite3 storage plugin for Fledge
@@ -20,6 +21,8 @@ using namespace rapidjson;
 
 static time_t connectErrorTime = 0;
 
+bool Connection::m_spill = false;
+
 /**
  * Create a SQLite3 database connection
  */
@@ -77,6 +80,12 @@ Connection::Connection()
 		int rc;
                 // Exec the statements without getting error messages, for now
 
+		if (m_spill)
+		{
+			attachSpill();
+			return;
+		}
+
 		// ATTACH 'fledge' as in memory shared DB
 		rc = sqlite3_exec(dbHandle,
 				  "ATTACH DATABASE 'file::memory:?cache=shared' AS '" READINGS_TABLE_MEM "'",
@@ -101,3 +110,63 @@ Connection::Connection()
 	}
 
 }
+
+/**
+ * Attach the databases of the spill to disk. The readings are appended to
+ * the hot in memory database and flushed to the readings database on disk,
+ * the one attached as readings and used by the purge.
+ *
+ * The first connection creates the hot readings table and starts its ids
+ * after the highest id the readings database on disk has held.
+ */
+void Connection::attachSpill()
+{
+	string dbPath = getDataDir() + READINGS_SPILL_FILE_NAME;
+	const char *dbPathEnv = getenv("DEFAULT_SQLITE_DB_SPILL_FILE");
+	if (dbPathEnv)
+	{
+		dbPath = dbPathEnv;
+	}
+
+	const char *columns = " (" \
+				"id		INTEGER			PRIMARY KEY AUTOINCREMENT," \
+				"asset_code	character varying(50)	NOT NULL," \
+				"reading	JSON			NOT NULL DEFAULT '{}'," \
+				"user_ts	DATETIME 		DEFAULT (STRFTIME('%Y-%m-%d %H:%M:%f+00:00', 'NOW' ))," \
+				"ts		DATETIME 		DEFAULT (STRFTIME('%Y-%m-%d %H:%M:%f+00:00', 'NOW' ))" \
+				");";
+
+	string sql = "ATTACH DATABASE '" + dbPath + "' AS '" READINGS_DB_NAME_BASE "';";
+	sql += "PRAGMA " READINGS_DB_NAME_BASE ".journal_mode = WAL;";
+	sql += string("CREATE TABLE IF NOT EXISTS " READINGS_DB_NAME_BASE "." READINGS_TABLE) + columns;
+	sql += "CREATE INDEX IF NOT EXISTS " READINGS_DB_NAME_BASE ".fki_" READINGS_TABLE "_fk1 ON " READINGS_TABLE " (asset_code);";
+	sql += "ATTACH DATABASE 'file::memory:?cache=shared' AS '" READINGS_HOT_DB "';";
+
+	char *zErrMsg = NULL;
+	if (sqlite3_exec(dbHandle, sql.c_str(), NULL, NULL, &zErrMsg) != SQLITE_OK)
+	{
+		raiseError("InMemory Connection", "Failed to attach the readings database '%s': %s",
+			   dbPath.c_str(), zErrMsg ? zErrMsg : "");
+		sqlite3_free(zErrMsg);
+		return;
+	}
+
+	// The hot table is created once, by the first connection to the shared memory database
+	sql = string("CREATE TABLE " READINGS_HOT_DB "." READINGS_TABLE) + columns;
+	if (sqlite3_exec(dbHandle, sql.c_str(), NULL, NULL, NULL) == SQLITE_OK)
+	{
+		// The sequence is used rather than the last id, the readings on disk may all have been purged
+		sql = "INSERT INTO " READINGS_HOT_DB ".sqlite_sequence (name, seq) "
+			"SELECT '" READINGS_TABLE "', MAX("
+				"IFNULL((SELECT MAX(id) FROM " READINGS_DB_NAME_BASE "." READINGS_TABLE "), 0), "
+				"IFNULL((SELECT seq FROM " READINGS_DB_NAME_BASE ".sqlite_sequence WHERE name = '" READINGS_TABLE "'), 0));";
+		if (sqlite3_exec(dbHandle, sql.c_str(), NULL, NULL, &zErrMsg) != SQLITE_OK)
+		{
+			raiseError("InMemory Connection", "Failed to set the first id of the readings: %s",
+				   zErrMsg ? zErrMsg : "");
+			sqlite3_free(zErrMsg);
+		}
+		Logger::getLogger()->info("Readings held in memory are flushed to the database %s",
+					  dbPath.c_str());
+	}
+}
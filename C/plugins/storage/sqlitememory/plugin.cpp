@@ -10,6 +10,7 @@
 #include <connection_manager.h>
 #include <connection.h>
 #include <plugin_api.h>
+#include <storage_profile.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <strings.h>
@@ -23,6 +24,8 @@
 #include <logger.h>
 #include <plugin_exception.h>
 #include <common.h>
+#include <config_category.h>
+#include <readings_spill.h>
 
 using namespace std;
 using namespace rapidjson;
@@ -32,15 +35,49 @@ using namespace rapidjson;
  */
 extern "C" {
 
+const char *default_config = QUOTE({
+		"poolSize" : {
+			"description" : "Connection pool size",
+			"type" : "integer",
+			"default" : "5",
+			"displayName" : "Pool Size",
+			"order" : "1"
+		},
+		"spillToDisk" : {
+			"description" : "Flush the readings held in memory to a readings database on disk, the queries then return the readings of both",
+			"type" : "boolean",
+			"default" : "false",
+			"displayName" : "Spill to disk",
+			"order" : "2"
+		},
+		"flushInterval" : {
+			"description" : "Seconds between the flushes of the readings held in memory to disk",
+			"type" : "integer",
+			"default" : "5",
+			"minimum" : "1",
+			"displayName" : "Flush interval",
+			"order" : "3"
+		},
+		"maxMemoryReadings" : {
+			"description" : "The number of readings held in memory above which they are flushed to disk before the flush interval, 0 flushes only every interval",
+			"type" : "integer",
+			"default" : "100000",
+			"minimum" : "0",
+			"displayName" : "Memory cap (readings)",
+			"order" : "4"
+		}
+	});
+
 /**
  * The plugin information structure
  */
 static PLUGIN_INFORMATION info = {
 	"SQLite3",           // Name
-	"1.1.0",           // Version
+	"1.2.0",           // Version
 	SP_READINGS,                // Flags
 	PLUGIN_TYPE_STORAGE,        // Type
-	"1.0.0"           // Interface version
+	"1.4.0",           // Interface version
+	default_config
 };
 
 /**
@@ -56,11 +93,33 @@ PLUGIN_INFORMATION *plugin_info()
  * In the case of SQLLite we also get a pool of connections
  * to use.
  */
-PLUGIN_HANDLE plugin_init()
+PLUGIN_HANDLE plugin_init(ConfigCategory *category)
 {
 ConnectionManager *manager = ConnectionManager::getInstance();
+int poolSize = 5;
+
+	if (category->itemExists("poolSize"))
+	{
+		poolSize = strtol(category->getValue("poolSize").c_str(), NULL, 10);
+	}
+
+	// The connections attach the databases of the spill as they are created
+	bool spill = category->itemExists("spillToDisk")
+			&& category->getValue("spillToDisk").compare("true") == 0;
+	Connection::setSpill(spill);
 
-	manager->growPool(5);
+	manager->growPool(poolSize);
+
+	if (spill)
+	{
+		unsigned int interval = 5;
+		unsigned long maxReadings = 100000;
+		if (category->itemExists("flushInterval"))
+			interval = strtoul(category->getValue("flushInterval").c_str(), NULL, 10);
+		if (category->itemExists("maxMemoryReadings"))
+			maxReadings = strtoul(category->getValue("maxMemoryReadings").c_str(), NULL, 10);
+		ReadingsSpill::getInstance()->start(manager, interval, maxReadings);
+	}
 	return manager;
 }
 /**
@@ -68,11 +127,13 @@ ConnectionManager *manager = ConnectionManager::getInstance();
  */
 int plugin_reading_append(PLUGIN_HANDLE handle, char *readings)
 {
+ProfileTimer	  timer(ProfileAppend);
 ConnectionManager *manager = (ConnectionManager *)handle;
 Connection        *connection = manager->allocate();
 
 	int result = connection->appendReadings(readings);
 	manager->release(connection);
+	ReadingsSpill::getInstance()->appended(result);
 	return result;;
 }
 
@@ -81,6 +142,7 @@ Connection        *connection = manager->allocate();
  */
 char *plugin_reading_fetch(PLUGIN_HANDLE handle, unsigned long id, unsigned int blksize)
 {
+ProfileTimer	  timer(ProfileFetch);
 ConnectionManager *manager = (ConnectionManager *)handle;
 Connection        *connection = manager->allocate();
 std::string	  resultSet;
@@ -95,6 +157,7 @@ std::string	  resultSet;
  */
 char *plugin_reading_retrieve(PLUGIN_HANDLE handle, char *condition)
 {
+ProfileTimer	  timer(ProfileReadingQuery);
 ConnectionManager *manager = (ConnectionManager *)handle;
 Connection        *connection = manager->allocate();
 std::string results;
@@ -109,6 +172,7 @@ std::string results;
  */
 char *plugin_reading_purge(PLUGIN_HANDLE handle, unsigned long param, unsigned int flags, unsigned long sent)
 {
+ProfileTimer	  timer(ProfilePurge);
 ConnectionManager *manager = (ConnectionManager *)handle;
 Connection        *connection = manager->allocate();
 std::string 	  results;
@@ -136,6 +200,26 @@ void plugin_release(PLUGIN_HANDLE handle, char *results)
 	free(results);
 }
 
+/**
+ * Return the latency profile of the storage plugins as a JSON document
+ *
+ * @param handle	The plugin handle
+ * @param reset		Clear the profile once it has been returned
+ */
+char *plugin_profile(PLUGIN_HANDLE handle, bool reset)
+{
+StorageProfile	*profile = StorageProfile::getInstance();
+std::string	results;
+
+	(void)handle;
+	profile->asJSON(results);
+	if (reset)
+	{
+		profile->reset();
+	}
+	return strdup(results.c_str());
+}
+
 /**
  * Return details on the last error that occured.
  */
@@ -153,6 +237,7 @@ bool plugin_shutdown(PLUGIN_HANDLE handle)
 {
 ConnectionManager *manager = (ConnectionManager *)handle;
   
+	ReadingsSpill::getInstance()->stop();
 	manager->shutdown();
 	return true;
 }
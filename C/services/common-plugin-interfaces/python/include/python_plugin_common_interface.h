@@ -11,7 +11,10 @@
  */
 
 #include <cctype>
+#include <string.h>
 #include <plugin_manager.h>
+#include <pyinterpreter.h>
+#include <rapidjson/document.h>
 
 #define SHIM_SCRIPT_REL_PATH  "/python/fledge/plugins/common/shim/"
 #define SHIM_SCRIPT_POSTFIX "_shim"
@@ -36,12 +39,17 @@ class PythonModule
 			m_init(init),
 			m_name(name),
 			m_type(type),
-			m_tState(state)
+			m_tState(state),
+			m_interpreter(NULL)
 		{
 		};
 
 		~PythonModule()
 		{
+			for (auto& value : m_configValues)
+			{
+				Py_CLEAR(value.second);
+			}
 			// Destroy loaded Python module
 			Py_CLEAR(m_module);
 			m_module = NULL;
@@ -64,8 +72,47 @@ class PythonModule
 		string    m_type;
 		PyThreadState*	m_tState;
 		string    m_categoryName;
+		// The sub-interpreter the module runs in, NULL for the main interpreter
+		PythonInterpreter* m_interpreter;
+		// The Python strings of the values of the configuration
+		// items last passed to the plugin, by item name
+		map<string, PyObject*> m_configValues;
 };
 
+/**
+ * Take the GIL of the interpreter a Python module runs in
+ *
+ * @param interpreter	The sub-interpreter of the module or NULL for the main interpreter
+ * @return		The state to pass to releaseGIL
+ */
+static inline PyGILState_STATE acquireGIL(PythonInterpreter *interpreter)
+{
+	if (interpreter)
+	{
+		interpreter->acquire();
+		return PyGILState_LOCKED;
+	}
+	return PythonInterpreter::ensureGIL();
+}
+
+/**
+ * Release the GIL taken by acquireGIL
+ *
+ * @param interpreter	The sub-interpreter of the module or NULL for the main interpreter
+ * @param state		The state returned by acquireGIL
+ */
+static inline void releaseGIL(PythonInterpreter *interpreter, PyGILState_STATE state)
+{
+	if (interpreter)
+	{
+		interpreter->release();
+	}
+	else
+	{
+		PythonInterpreter::releaseGIL(state);
+	}
+}
+
 extern "C" {
 // This is the map of Python object initialised in each 
 // South, Notification, Filter  plugin interfaces
@@ -109,7 +156,7 @@ void PluginInterfaceCleanup(const string& pluginName)
 	}
 
 	// Acquire GIL
-	PyGILState_STATE state = PyGILState_Ensure();
+	PyGILState_STATE state = PythonInterpreter::ensureGIL();
 
 	// Look for Python module, pluginName is the key
 	auto it = pythonModules->find(pluginName);
@@ -130,7 +177,18 @@ void PluginInterfaceCleanup(const string& pluginName)
 		if (h->second->m_name.compare(pluginName) == 0)
 		{
 			// Remove PythonModule object
-			if (h->second->m_module)
+			if (h->second->m_interpreter)
+			{
+				// The module belongs to its own interpreter
+				PyThreadState *save = PyEval_SaveThread();
+				h->second->m_interpreter->acquire();
+				Py_CLEAR(h->second->m_module);
+				h->second->m_interpreter->release();
+				delete h->second->m_interpreter;
+				h->second->m_interpreter = NULL;
+				PyEval_RestoreThread(save);
+			}
+			else if (h->second->m_module)
 			{
 				Py_CLEAR(h->second->m_module);
 				h->second->m_module = NULL;
@@ -180,7 +238,7 @@ void PluginInterfaceCleanup(const string& pluginName)
 	}
 	else
 	{
-		PyGILState_Release(state);
+		PythonInterpreter::releaseGIL(state);
 	}
 
 	Logger::getLogger()->debug("PluginInterfaceCleanup succesfully "
@@ -265,7 +323,7 @@ const char *json_dumps(PyObject *json_dict)
     PyObject *rval;
     PyObject *mod, *method;
 
-	PyGILState_STATE state = PyGILState_Ensure();
+	PyGILState_STATE state = PythonInterpreter::ensureGIL();
 	if ((mod = PyImport_ImportModule("json")) != NULL)
 	{
 		if ((method = PyObject_GetAttrString(mod, "dumps")) != NULL)
@@ -307,7 +365,7 @@ const char *json_dumps(PyObject *json_dict)
 	// Reset error
 	PyErr_Clear();
 
-	PyGILState_Release(state);
+	PythonInterpreter::releaseGIL(state);
 
 	const char *retVal = PyUnicode_AsUTF8(rval);
 	Logger::getLogger()->debug("%s: retVal=%s", __FUNCTION__, retVal);
@@ -324,7 +382,7 @@ PyObject *json_loads(const char *json_str)
 PyObject *rval;
 PyObject *mod, *method;
 
-	PyGILState_STATE state = PyGILState_Ensure();
+	PyGILState_STATE state = PythonInterpreter::ensureGIL();
 	if ((mod = PyImport_ImportModule("json")) != NULL)
 	{
 		if ((method = PyObject_GetAttrString(mod, "loads")) != NULL)
@@ -365,11 +423,134 @@ PyObject *mod, *method;
 	// Reset error
 	PyErr_Clear();
 
-	PyGILState_Release(state);
+	PythonInterpreter::releaseGIL(state);
     
 	return rval;
 }
 
+/**
+ * Convert a JSON value to the Python objects json.loads would return.
+ * Called with the GIL held.
+ *
+ * @param value		The JSON value
+ * @return		A new reference to the Python object
+ */
+static PyObject *json_to_python(const rapidjson::Value& value)
+{
+	if (value.IsString())
+	{
+		return PyUnicode_FromStringAndSize(value.GetString(), value.GetStringLength());
+	}
+	if (value.IsObject())
+	{
+		PyObject *dict = PyDict_New();
+		for (auto& m : value.GetObject())
+		{
+			PyObject *item = json_to_python(m.value);
+			PyDict_SetItemString(dict, m.name.GetString(), item);
+			Py_CLEAR(item);
+		}
+		return dict;
+	}
+	if (value.IsArray())
+	{
+		PyObject *list = PyList_New(value.Size());
+		for (rapidjson::SizeType i = 0; i < value.Size(); i++)
+		{
+			// PyList_SetItem takes the reference
+			PyList_SetItem(list, i, json_to_python(value[i]));
+		}
+		return list;
+	}
+	if (value.IsBool())
+	{
+		return PyBool_FromLong(value.GetBool());
+	}
+	if (value.IsInt64())
+	{
+		return PyLong_FromLongLong(value.GetInt64());
+	}
+	if (value.IsUint64())
+	{
+		return PyLong_FromUnsignedLongLong(value.GetUint64());
+	}
+	if (value.IsNumber())
+	{
+		return PyFloat_FromDouble(value.GetDouble());
+	}
+	Py_RETURN_NONE;
+}
+
+/**
+ * Convert the items of a configuration category to the Python DICT
+ * passed to plugin_init and plugin_reconfigure.
+ *
+ * The value of an item that is the same as when the plugin was last
+ * given its configuration is passed as the same Python string, it is
+ * not converted again. A plugin can then tell with a cheap comparison
+ * that a large item, such as a lookup table, has not changed. Called
+ * with the GIL held.
+ *
+ * @param json		The JSON of the configuration items
+ * @param module	The Python module of the plugin
+ * @return		A new reference to the Python DICT or NULL on error
+ */
+static PyObject *config_loads(const string& json, PythonModule *module)
+{
+	rapidjson::Document doc;
+	doc.Parse(json.c_str());
+	if (doc.HasParseError() || !doc.IsObject())
+	{
+		return json_loads(json.c_str());
+	}
+
+	map<string, PyObject*> values;
+	PyObject *config = PyDict_New();
+	for (auto& item : doc.GetObject())
+	{
+		string name = item.name.GetString();
+		PyObject *pyItem = json_to_python(item.value);
+		if (item.value.IsObject() && item.value.HasMember("value") && item.value["value"].IsString())
+		{
+			const rapidjson::Value& value = item.value["value"];
+			PyObject *pyValue = NULL;
+			auto cached = module->m_configValues.find(name);
+			if (cached != module->m_configValues.end())
+			{
+				Py_ssize_t size;
+				const char *str = PyUnicode_AsUTF8AndSize(cached->second, &size);
+				if (str && (size_t)size == value.GetStringLength()
+						&& memcmp(str, value.GetString(), size) == 0)
+				{
+					pyValue = cached->second;
+					Py_INCREF(pyValue);
+				}
+			}
+			if (pyValue)
+			{
+				PyDict_SetItemString(pyItem, "value", pyValue);
+			}
+			else
+			{
+				pyValue = PyDict_GetItemString(pyItem, "value");
+				Py_INCREF(pyValue);
+			}
+			values[name] = pyValue;
+		}
+		PyDict_SetItemString(config, name.c_str(), pyItem);
+		Py_CLEAR(pyItem);
+	}
+
+	// Keep the values just passed, those of items no longer present are released
+	module->m_configValues.swap(values);
+	for (auto& value : values)
+	{
+		Py_CLEAR(value.second);
+	}
+	PyErr_Clear();
+	return config;
+}
+
 
 /**
  * Fill PLUGIN_INFORMATION structure from Python object
@@ -498,7 +679,7 @@ static PLUGIN_INFORMATION *plugin_info_fn()
 		return NULL;
 	}
 	PyObject* pFunc; 
-	PyGILState_STATE state = PyGILState_Ensure();
+	PyGILState_STATE state = PythonInterpreter::ensureGIL();
 
 	// Fetch required method in loaded object
 	pFunc = PyObject_GetAttrString(it->second->m_module, "plugin_info");
@@ -522,7 +703,7 @@ static PLUGIN_INFORMATION *plugin_info_fn()
 					   gPluginName.c_str());
 		Py_CLEAR(pFunc);
 
-		PyGILState_Release(state);
+		PythonInterpreter::releaseGIL(state);
 		return NULL;
 	}
 
@@ -579,7 +760,7 @@ static PLUGIN_INFORMATION *plugin_info_fn()
 					   info->config);
 	}
 
-	PyGILState_Release(state);
+	PythonInterpreter::releaseGIL(state);
 
 	return info;
 }
@@ -689,7 +870,7 @@ static PLUGIN_HANDLE plugin_init_fn(ConfigCategory *config)
                                 __FUNCTION__, __LINE__, loadModule?"TRUE":"FALSE", reloadModule?"TRUE":"FALSE");
 
 	// Acquire GIL
-	PyGILState_STATE state = PyGILState_Ensure();
+	PyGILState_STATE state = PythonInterpreter::ensureGIL();
 
 	// Import Python module using a new interpreter
 	if (loadModule || reloadModule)
@@ -738,7 +919,7 @@ static PLUGIN_HANDLE plugin_init_fn(ConfigCategory *config)
 							  NULL)) == NULL)
 			{
 				// Release lock
-				PyGILState_Release(state);
+				PythonInterpreter::releaseGIL(state);
 
 				Logger::getLogger()->fatal("plugin_handle: plugin_init(): "
 							   "failed to create Python module "
@@ -755,7 +936,7 @@ static PLUGIN_HANDLE plugin_init_fn(ConfigCategory *config)
 			logErrorMessage();
 
 			// Release lock
-			PyGILState_Release(state);
+			PythonInterpreter::releaseGIL(state);
 
 			Logger::getLogger()->fatal("plugin_handle: plugin_init(): "
 						   "failed to import plugin '%s'",
@@ -772,7 +953,7 @@ static PLUGIN_HANDLE plugin_init_fn(ConfigCategory *config)
 	Logger::getLogger()->debug("%s:%d: calling set_loglevel_in_python_module(), loglevel=%s", __FUNCTION__, __LINE__, Logger::getLogger()->getMinLevel().c_str());
 	set_loglevel_in_python_module(module->m_module, module->m_name + " plugin_init");
     
-	PyObject *config_dict = json_loads(config->itemsToJSON().c_str());
+	PyObject *config_dict = config_loads(config->itemsToJSON(), module);
     
 	// Call Python method passing an object
 	PyObject* pReturn = PyObject_CallMethod(module->m_module,
@@ -840,7 +1021,7 @@ static PLUGIN_HANDLE plugin_init_fn(ConfigCategory *config)
 	}
 	else
 	{
-		PyGILState_Release(state);
+		PythonInterpreter::releaseGIL(state);
 	}
 
 	return pReturn ? (PLUGIN_HANDLE) pReturn : NULL;
@@ -887,7 +1068,7 @@ static void plugin_reconfigure_fn(PLUGIN_HANDLE* handle,
 	std::mutex mtx;
 	PyObject* pFunc;
 	lock_guard<mutex> guard(mtx);
-	PyGILState_STATE state = PyGILState_Ensure();
+	PyGILState_STATE state = PythonInterpreter::ensureGIL();
 
 	Logger::getLogger()->debug("plugin_handle: plugin_reconfigure(): "
 				   "pModule=%p, *handle=%p, plugin '%s'",
@@ -899,7 +1080,7 @@ static void plugin_reconfigure_fn(PLUGIN_HANDLE* handle,
 	{
 		Logger::getLogger()->debug("calling set_loglevel_in_python_module() for updating loglevel");
 		set_loglevel_in_python_module(it->second->m_module, it->second->m_name+" plugin_reconf");
-		PyGILState_Release(state);
+		PythonInterpreter::releaseGIL(state);
 		return;
 	}
 	
@@ -925,13 +1106,13 @@ static void plugin_reconfigure_fn(PLUGIN_HANDLE* handle,
 					   it->second->m_name.c_str());
 		Py_CLEAR(pFunc);
 
-		PyGILState_Release(state);
+		PythonInterpreter::releaseGIL(state);
 		return;
 	}
 
 	Logger::getLogger()->debug("plugin_reconfigure with %s", config.c_str());
 
-	PyObject *new_config_dict = json_loads(config.c_str());
+	PyObject *new_config_dict = config_loads(config, it->second);
 
 	// Call Python method passing an object and a C string
 	PyObject* pReturn = PyObject_CallFunction(pFunc,
@@ -985,7 +1166,7 @@ static void plugin_reconfigure_fn(PLUGIN_HANDLE* handle,
 		}
 	}
 
-	PyGILState_Release(state);
+	PythonInterpreter::releaseGIL(state);
 }
 
 /**
@@ -1099,7 +1280,8 @@ static void plugin_shutdown_fn(PLUGIN_HANDLE handle)
 	}
 
 	PyObject* pFunc; 
-	PyGILState_STATE state = PyGILState_Ensure();
+	PythonInterpreter *interpreter = it->second->m_interpreter;
+	PyGILState_STATE state = acquireGIL(interpreter);
 
 	// Fetch required method in loaded object
 	pFunc = PyObject_GetAttrString(it->second->m_module, "plugin_shutdown");
@@ -1123,7 +1305,7 @@ static void plugin_shutdown_fn(PLUGIN_HANDLE handle)
 					   it->second->m_name.c_str());
 		Py_CLEAR(pFunc);
 
-		PyGILState_Release(state);
+		releaseGIL(interpreter, state);
 		return;
 	}
 
@@ -1183,7 +1365,10 @@ static void plugin_shutdown_fn(PLUGIN_HANDLE handle)
 	module = NULL;
 
 	// Release GIL
-	PyGILState_Release(state);
+	releaseGIL(interpreter, state);
+
+	// End the interpreter of the module once the module is removed
+	delete interpreter;
 
 	Logger::getLogger()->debug("plugin_shutdown_fn succesfully "
 				   "called for plugin '%s'",
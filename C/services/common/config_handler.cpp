@@ -64,6 +64,38 @@ ConfigHandler::configChange(const string& category, const string& config)
 	}
 }
 
+/**
+ * Handle a set of configuration category changes made together. A
+ * category that appears more than once is only passed to the handlers
+ * once, with its last contents, and the categories are passed in the
+ * order in which they were first changed.
+ *
+ * @param changes	The category names and contents
+ */
+void
+ConfigHandler::configChanges(const vector<pair<string, string>>& changes)
+{
+	vector<string> order;
+	map<string, const string *> latest;
+	for (auto& change : changes)
+	{
+		if (latest.find(change.first) == latest.end())
+		{
+			order.push_back(change.first);
+		}
+		latest[change.first] = &change.second;
+	}
+	if (order.size() < changes.size())
+	{
+		m_logger->info("Coalesced %d configuration changes to %d categories",
+				(int)changes.size(), (int)order.size());
+	}
+	for (auto& category : order)
+	{
+		configChange(category, *latest[category]);
+	}
+}
+
 /**
  * Handle a callback from the core to handle the creation of a child category.
  *
@@ -15,6 +15,7 @@
 #include <logger.h>
 #include <string>
 #include <map>
+#include <vector>
 #include <mutex>
 
 typedef std::multimap<std::string, ServiceHandler *> CONFIG_MAP;
@@ -26,6 +27,7 @@ class ConfigHandler {
 	public:
 		static ConfigHandler	*getInstance(ManagementClient *);
 		void			configChange(const std::string& category, const std::string& config);
+		void			configChanges(const std::vector<std::pair<std::string, std::string>>& changes);
 		void            configChildCreate(const std::string& parent_category, const std::string& child_category, const std::string& config);
 		void            configChildDelete(const std::string& parent_category, const std::string& child_category);
 		void			registerCategory(ServiceHandler *handler,
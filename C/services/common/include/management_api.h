@@ -20,8 +20,14 @@
 #define PING			"/fledge/service/ping"
 #define SERVICE_SHUTDOWN	"/fledge/service/shutdown"
 #define CONFIG_CHANGE		"/fledge/change"
+#define CONFIG_CHANGES		"/fledge/changes"
 #define CONFIG_CHILD_CREATE "/fledge/child_create"
 #define CONFIG_CHILD_DELETE "/fledge/child_delete"
+#define SERVICE_TRACE		"/fledge/service/trace"
+#define SERVICE_ALLOCATIONS	"/fledge/service/allocations"
+#define SERVICE_PROFILE		"/fledge/service/profile"
+#define SERVICE_QUEUES		"/fledge/service/queues"
+#define SERVICE_ALLOCATOR	"/fledge/service/allocator"
 
 using HttpServer = SimpleWeb::Server<SimpleWeb::HTTP>;
 
@@ -47,8 +53,16 @@ class ManagementApi {
 		void ping(std::shared_ptr<HttpServer::Response> response, std::shared_ptr<HttpServer::Request> request);
 		void shutdown(std::shared_ptr<HttpServer::Response> response, std::shared_ptr<HttpServer::Request> request);
 		void configChange(std::shared_ptr<HttpServer::Response> response, std::shared_ptr<HttpServer::Request> request);
+		void configChanges(std::shared_ptr<HttpServer::Response> response, std::shared_ptr<HttpServer::Request> request);
 		void configChildCreate(std::shared_ptr<HttpServer::Response> response, std::shared_ptr<HttpServer::Request> request);
 		void configChildDelete(std::shared_ptr<HttpServer::Response> response, std::shared_ptr<HttpServer::Request> request);
+		void getTrace(std::shared_ptr<HttpServer::Response> response, std::shared_ptr<HttpServer::Request> request);
+		void setTrace(std::shared_ptr<HttpServer::Response> response, std::shared_ptr<HttpServer::Request> request);
+		void getAllocations(std::shared_ptr<HttpServer::Response> response, std::shared_ptr<HttpServer::Request> request);
+		void resetAllocations(std::shared_ptr<HttpServer::Response> response, std::shared_ptr<HttpServer::Request> request);
+		void getProfile(std::shared_ptr<HttpServer::Response> response, std::shared_ptr<HttpServer::Request> request);
+		void getQueues(std::shared_ptr<HttpServer::Response> response, std::shared_ptr<HttpServer::Request> request);
+		void getAllocator(std::shared_ptr<HttpServer::Response> response, std::shared_ptr<HttpServer::Request> request);
 
 	protected:
 		static ManagementApi *m_instance;
@@ -59,6 +73,7 @@ class ManagementApi {
 		JSONProvider	*m_statsProvider;
 		ServiceHandler	*m_serviceHandler;
 		std::thread	*m_thread;
+		std::thread	m_profileThread;
 	private:
 		void            respond(std::shared_ptr<HttpServer::Response>, const std::string&);
 };
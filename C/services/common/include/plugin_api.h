@@ -95,6 +95,10 @@ typedef enum controlDestination {
 #define SP_DEPRECATED		0x0080
 /** The plugin is built in and not installed be a seperate package */
 #define SP_BUILTIN		0x0100
+/** The filter keeps no state between calls to plugin_ingest and may be called concurrently */
+#define SP_STATELESS		0x0200
+/** The south plugin may be polled concurrently from several threads */
+#define SP_CONCURRENT_POLL	0x0400
 /** The plugin supports control data */
 #define SP_CONTROL		0x1000
 
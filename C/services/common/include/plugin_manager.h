@@ -13,6 +13,7 @@
 #include <plugin_api.h>
 #include <plugin_handle.h>
 #include <logger.h>
+#include <plugin_manifest.h>
 #include <string>
 #include <list>
 #include <map>
@@ -50,6 +51,7 @@ class PluginManager {
 				*getInfo(const PLUGIN_HANDLE);
 		void		getInstalledPlugins(const std::string& type,
 						    std::list<std::string>& plugins);
+		void		preloadPythonModules(const std::string& modules);
 		void setPluginType(tPluginType type);
 		PLUGIN_TYPE getPluginImplType(const PLUGIN_HANDLE hndl) { return pluginImplTypes[hndl]; }
 
@@ -70,6 +72,7 @@ class PluginManager {
 							pluginHandleMap;
                 Logger*					logger;
 				tPluginType				m_pluginType;
+		PluginManifest				m_manifest;
 };
 
 #endif
@@ -0,0 +1,49 @@
+#ifndef _SERVICE_ALLOCATOR_H
+#define _SERVICE_ALLOCATOR_H
+/*
+ * Fledge service memory allocator statistics and tuning
+ *
+ * Copyright (c) 2026 Dianomic Systems
+ *
+ * Released under the Apache 2.0 Licence
+ *
+ * Author: agent
+ */
+#include <string>
+
+/**
+ * The allocator the service executables were linked with, selected by the
+ * FLEDGE_ALLOCATOR build option: the system malloc, jemalloc, mimalloc or
+ * tcmalloc. Each of the alternative allocators keeps a cache of memory per
+ * thread, so the many small short lived allocations of the data path are
+ * made without contention between the threads.
+ *
+ * The statistics reported are those of the allocator in use. The tuning
+ * is a JSON object of the options that may be changed whilst the service
+ * runs,
+ *
+ *	{ "decay" : 5000, "threadCache" : 16384, "arenas" : 4 }
+ *
+ * decay is the milliseconds freed memory is held before it is returned to
+ * the operating system, used by jemalloc and mimalloc, threadCache is the
+ * KB of the caches of all the threads of tcmalloc and arenas is the largest
+ * number of arenas of the system malloc. An option the allocator does not
+ * support is logged and ignored. The options read by the allocators when
+ * the process starts are given in their environment variables, MALLOC_CONF,
+ * MIMALLOC_ or TCMALLOC_.
+ */
+class ServiceAllocator {
+	public:
+		static ServiceAllocator	*getInstance();
+		const char		*getName() const;
+		bool			configure(const std::string& json);
+		void			asJSON(std::string& json);
+	private:
+		ServiceAllocator() {};
+		bool			setDecay(long milliseconds);
+		bool			setThreadCache(long kilobytes);
+		bool			setArenas(long arenas);
+	private:
+		static ServiceAllocator	*m_instance;
+};
+#endif
@@ -0,0 +1,69 @@
+#ifndef _THREAD_CONFIG_H
+#define _THREAD_CONFIG_H
+/*
+ * Fledge service thread naming, affinity and scheduling
+ *
+ * Copyright (c) 2026 Dianomic Systems
+ *
+ * Released under the Apache 2.0 Licence
+ *
+ * Author: agent
+ */
+#include <string>
+#include <map>
+#include <mutex>
+#include <thread>
+#include <pthread.h>
+#include <sched.h>
+
+#define THREAD_NAME_LEN		15	// Longest thread name supported by the kernel
+#define THREAD_DEFAULT_ROLE	"default"
+
+/**
+ * The CPU affinity and scheduling settings for the threads of a role
+ */
+class ThreadRole {
+	public:
+		ThreadRole();
+		bool		m_hasCpus;
+		cpu_set_t	m_cpus;
+		bool		m_hasPolicy;
+		int		m_policy;
+		int		m_priority;
+};
+
+/**
+ * Names the threads started by a service and applies the CPU affinity
+ * and scheduling class configured for the role of each thread.
+ *
+ * The configuration is a JSON object with an entry per role, an entry
+ * named "default" applies to any role that has no entry of its own.
+ *
+ *	{
+ *	  "ingest" : { "cpus" : "2-3", "policy" : "fifo", "priority" : 10 },
+ *	  "default" : { "cpus" : "0,1,4-15" }
+ *	}
+ *
+ * The policy is one of other, batch, idle, fifo or rr, the priority is
+ * only used by the fifo and rr real time policies. Settings are applied
+ * when a thread is started, a change to the configuration applies to
+ * threads started after the change.
+ */
+class ThreadConfig {
+	public:
+		static ThreadConfig	*getInstance();
+		bool			configure(const std::string& json);
+		void			apply(std::thread& thread, const std::string& role);
+		void			apply(const std::string& role);
+	private:
+		ThreadConfig() {};
+		void			apply(pthread_t thread, const std::string& role);
+		bool			parseCpus(const std::string& cpus, cpu_set_t *set);
+		bool			parsePolicy(const std::string& policy, int *value);
+	private:
+		static ThreadConfig	*m_instance;
+		std::mutex		m_mutex;
+		std::map<std::string, ThreadRole>
+					m_roles;
+};
+#endif
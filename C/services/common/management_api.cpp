@@ -10,7 +10,14 @@
 #include <management_api.h>
 #include <config_handler.h>
 #include <rapidjson/document.h>
+#include <rapidjson/writer.h>
+#include <rapidjson/stringbuffer.h>
 #include <logger.h>
+#include <tracer.h>
+#include <alloc_profiler.h>
+#include <cpu_profiler.h>
+#include <queue_metrics.h>
+#include <service_allocator.h>
 #include <time.h>
 #include <sstream>
 
@@ -47,6 +54,15 @@ void configChangeWrapper(shared_ptr<HttpServer::Response> response, shared_ptr<H
         api->configChange(response, request);
 }
 
+/**
+ * Wrapper for the batched config change method
+ */
+void configChangesWrapper(shared_ptr<HttpServer::Response> response, shared_ptr<HttpServer::Request> request)
+{
+        ManagementApi *api = ManagementApi::getInstance();
+        api->configChanges(response, request);
+}
+
 /**
  * Wrapper for config child  create method
  */
@@ -65,6 +81,68 @@ void configChildDeleteWrapper(shared_ptr<HttpServer::Response> response, shared_
         api->configChildDelete(response, request);
 }
 
+/**
+ * Wrapper for the trace dump method
+ */
+void getTraceWrapper(shared_ptr<HttpServer::Response> response, shared_ptr<HttpServer::Request> request)
+{
+        ManagementApi *api = ManagementApi::getInstance();
+        api->getTrace(response, request);
+}
+
+/**
+ * Wrapper for the trace control method
+ */
+void setTraceWrapper(shared_ptr<HttpServer::Response> response, shared_ptr<HttpServer::Request> request)
+{
+        ManagementApi *api = ManagementApi::getInstance();
+        api->setTrace(response, request);
+}
+
+/**
+ * Wrapper for the allocation counts method
+ */
+void getAllocationsWrapper(shared_ptr<HttpServer::Response> response, shared_ptr<HttpServer::Request> request)
+{
+        ManagementApi *api = ManagementApi::getInstance();
+        api->getAllocations(response, request);
+}
+
+/**
+ * Wrapper for the allocation counts reset method
+ */
+void resetAllocationsWrapper(shared_ptr<HttpServer::Response> response, shared_ptr<HttpServer::Request> request)
+{
+        ManagementApi *api = ManagementApi::getInstance();
+        api->resetAllocations(response, request);
+}
+
+/**
+ * Wrapper for the CPU profile method
+ */
+void getProfileWrapper(shared_ptr<HttpServer::Response> response, shared_ptr<HttpServer::Request> request)
+{
+        ManagementApi *api = ManagementApi::getInstance();
+        api->getProfile(response, request);
+}
+
+/**
+ * Wrapper for the queue metrics method
+ */
+void getQueuesWrapper(shared_ptr<HttpServer::Response> response, shared_ptr<HttpServer::Request> request)
+{
+        ManagementApi *api = ManagementApi::getInstance();
+        api->getQueues(response, request);
+}
+
+/**
+ * Wrapper for the allocator statistics method
+ */
+void getAllocatorWrapper(shared_ptr<HttpServer::Response> response, shared_ptr<HttpServer::Request> request)
+{
+        ManagementApi *api = ManagementApi::getInstance();
+        api->getAllocator(response, request);
+}
 
 /**
  * Construct a microservices management API manager class
@@ -79,8 +157,16 @@ ManagementApi::ManagementApi(const string& name, const unsigned short port) : m_
 	m_server->resource[PING]["GET"] = pingWrapper;
 	m_server->resource[SERVICE_SHUTDOWN]["POST"] = shutdownWrapper;
 	m_server->resource[CONFIG_CHANGE]["POST"] = configChangeWrapper;
+	m_server->resource[CONFIG_CHANGES]["POST"] = configChangesWrapper;
 	m_server->resource[CONFIG_CHILD_CREATE]["POST"] = configChildCreateWrapper;
 	m_server->resource[CONFIG_CHILD_DELETE]["DELETE"] = configChildDeleteWrapper;
+	m_server->resource[SERVICE_TRACE]["GET"] = getTraceWrapper;
+	m_server->resource[SERVICE_TRACE]["PUT"] = setTraceWrapper;
+	m_server->resource[SERVICE_ALLOCATIONS]["GET"] = getAllocationsWrapper;
+	m_server->resource[SERVICE_ALLOCATIONS]["DELETE"] = resetAllocationsWrapper;
+	m_server->resource[SERVICE_PROFILE]["GET"] = getProfileWrapper;
+	m_server->resource[SERVICE_QUEUES]["GET"] = getQueuesWrapper;
+	m_server->resource[SERVICE_ALLOCATOR]["GET"] = getAllocatorWrapper;
 
 
 	m_instance = this;
@@ -111,6 +197,12 @@ void ManagementApi::stop()
 
 void ManagementApi::stopServer()
 {
+	// Return any profile that is running before the server stops
+	CpuProfiler::getInstance()->cancel();
+	if (m_profileThread.joinable())
+	{
+		m_profileThread.join();
+	}
 	m_server->stop();
 	m_thread->join();
 }
@@ -131,6 +223,11 @@ ManagementApi *ManagementApi::getInstance()
  */
 ManagementApi::~ManagementApi()
 {
+	CpuProfiler::getInstance()->cancel();
+	if (m_profileThread.joinable())
+	{
+		m_profileThread.join();
+	}
 	delete m_server;
 	delete m_thread;
 }
@@ -198,6 +295,53 @@ string	category, items, payload;
 	respond(response, responsePayload);
 }
 
+/**
+ * Received a set of configuration changes made together, pass them to
+ * the configuration handler in a single call so that a category changed
+ * more than once is only reconfigured once.
+ *
+ * The payload is of the form
+ *	{ "changes" : [ { "category" : "name", "items" : { ... } }, ... ] }
+ */
+void ManagementApi::configChanges(shared_ptr<HttpServer::Response> response, shared_ptr<HttpServer::Request> request)
+{
+ostringstream convert;
+string responsePayload;
+string	payload;
+
+	payload = request->content.string();
+	vector<pair<string, string>> changes;
+	Document doc;
+	doc.Parse(payload.c_str());
+	if (!doc.HasParseError() && doc.HasMember("changes") && doc["changes"].IsArray())
+	{
+		for (auto& change : doc["changes"].GetArray())
+		{
+			StringBuffer buffer;
+			Writer<StringBuffer> writer(buffer);
+			change.Accept(writer);
+			try {
+				ConfigCategoryChange conf(buffer.GetString());
+				changes.push_back(make_pair(conf.getName(), conf.itemsToJSON(true)));
+			} catch (ConfigMalformed *e) {
+				m_logger->error("Malformed configuration change %s", buffer.GetString());
+				delete e;
+			} catch (...) {
+				m_logger->error("Malformed configuration change %s", buffer.GetString());
+			}
+		}
+	}
+	else
+	{
+		m_logger->error("Malformed configuration changes %s", payload.c_str());
+	}
+	ConfigHandler	*handler = ConfigHandler::getInstance(NULL);
+	handler->configChanges(changes);
+	convert << "{ \"message\" : \"Config changes accepted\" }";
+	responsePayload = convert.str();
+	respond(response, responsePayload);
+}
+
 /**
  * Received a children deletion request, construct a reply and return to caller
  */
@@ -258,6 +402,151 @@ string	category, items, payload, parent_category;
 	respond(response, responsePayload);
 }
 
+/**
+ * Return the spans recorded by the service as a Chrome trace event
+ * document, which may be loaded into Perfetto or the Chrome trace viewer
+ */
+void ManagementApi::getTrace(shared_ptr<HttpServer::Response> response, shared_ptr<HttpServer::Request> request)
+{
+string	responsePayload;
+
+	(void)request;	// Unused argument
+	Tracer::getInstance()->toChromeTrace(responsePayload, m_name);
+	respond(response, responsePayload);
+}
+
+/**
+ * Start or stop the recording of spans by the service. The payload is
+ * of the form
+ *	{ "enabled" : true }
+ * enabling the tracing discards the spans previously recorded.
+ */
+void ManagementApi::setTrace(shared_ptr<HttpServer::Response> response, shared_ptr<HttpServer::Request> request)
+{
+ostringstream convert;
+string	responsePayload;
+
+	Document doc;
+	doc.Parse(request->content.string().c_str());
+	if (doc.HasParseError() || !doc.IsObject() || !doc.HasMember("enabled") || !doc["enabled"].IsBool())
+	{
+		*response << "HTTP/1.1 400 Bad Request\r\nContent-Length: 0\r\n\r\n";
+		return;
+	}
+	bool enabled = doc["enabled"].GetBool();
+	Tracer::getInstance()->enable(enabled);
+	m_logger->info("Tracing of the data path %s", enabled ? "enabled" : "disabled");
+	convert << "{ \"enabled\" : " << (enabled ? "true" : "false") << " }";
+	responsePayload = convert.str();
+	respond(response, responsePayload);
+}
+
+/**
+ * Return the allocations counted against each stage of the data path
+ * and the allocations per reading of the stage. The allocations are
+ * only counted if the service was built with FLEDGE_ALLOC_PROFILING.
+ */
+void ManagementApi::getAllocations(shared_ptr<HttpServer::Response> response, shared_ptr<HttpServer::Request> request)
+{
+string	responsePayload;
+
+	(void)request;	// Unused argument
+	AllocProfiler::asJSON(responsePayload);
+	respond(response, responsePayload);
+}
+
+/**
+ * Set the counts of the allocations back to zero, so that a workload
+ * may be measured without the allocations of the service start
+ */
+void ManagementApi::resetAllocations(shared_ptr<HttpServer::Response> response, shared_ptr<HttpServer::Request> request)
+{
+string	responsePayload;
+
+	(void)request;	// Unused argument
+	AllocProfiler::reset();
+	AllocProfiler::asJSON(responsePayload);
+	respond(response, responsePayload);
+}
+
+/**
+ * Run the sampling CPU profiler for a number of seconds and return the
+ * sampled stacks in the folded format of flame graphs. The request may
+ * set the seconds to profile for and the samples to take per second of
+ * CPU time
+ *	/fledge/service/profile?seconds=30&frequency=99
+ * The profile runs in a thread of its own and the response is sent when
+ * it completes, so that the management API continues to answer other
+ * requests, such as the pings of the core, while the profile runs.
+ */
+void ManagementApi::getProfile(shared_ptr<HttpServer::Response> response, shared_ptr<HttpServer::Request> request)
+{
+	unsigned long seconds = PROFILE_DEFAULT_SECONDS;
+	unsigned long frequency = PROFILE_DEFAULT_FREQUENCY;
+	auto query = request->parse_query_string();
+	auto it = query.find("seconds");
+	if (it != query.end())
+	{
+		seconds = strtoul(it->second.c_str(), NULL, 10);
+	}
+	it = query.find("frequency");
+	if (it != query.end())
+	{
+		frequency = strtoul(it->second.c_str(), NULL, 10);
+	}
+	if (seconds < 1 || seconds > PROFILE_MAX_SECONDS || frequency < 1 || frequency > PROFILE_MAX_FREQUENCY)
+	{
+		*response << "HTTP/1.1 400 Bad Request\r\nContent-Length: 0\r\n\r\n";
+		return;
+	}
+	CpuProfiler *profiler = CpuProfiler::getInstance();
+	if (profiler->isRunning())
+	{
+		*response << "HTTP/1.1 409 Conflict\r\nContent-Length: 0\r\n\r\n";
+		return;
+	}
+	if (m_profileThread.joinable())
+	{
+		m_profileThread.join();
+	}
+	m_logger->info("Profiling the CPU use of the service for %lu seconds", seconds);
+	m_profileThread = thread([response, seconds, frequency, profiler]() {
+		string folded;
+		if (!profiler->profile(seconds, frequency, folded))
+		{
+			*response << "HTTP/1.1 409 Conflict\r\nContent-Length: 0\r\n\r\n";
+			return;
+		}
+		*response << "HTTP/1.1 200 OK\r\nContent-Length: " << folded.length() << "\r\n"
+			<< "Content-type: text/plain\r\n\r\n" << folded;
+	});
+}
+
+/**
+ * Return the depth, high water mark and rates of the queues of the
+ * data path within the service
+ */
+void ManagementApi::getQueues(shared_ptr<HttpServer::Response> response, shared_ptr<HttpServer::Request> request)
+{
+string	responsePayload;
+
+	(void)request;	// Unused argument
+	QueueMetricsRegistry::getInstance()->asJSON(responsePayload);
+	respond(response, responsePayload);
+}
+
+/**
+ * Return the name of the memory allocator the service was built with
+ * and the statistics it reports
+ */
+void ManagementApi::getAllocator(shared_ptr<HttpServer::Response> response, shared_ptr<HttpServer::Request> request)
+{
+string	responsePayload;
+
+	(void)request;	// Unused argument
+	ServiceAllocator::getInstance()->asJSON(responsePayload);
+	respond(response, responsePayload);
+}
 
 /**
  * HTTP response method
@@ -28,6 +28,9 @@
 #include "rapidjson/error/en.h"
 #include <algorithm>
 #include <config_category.h>
+#include <utils.h>
+#include <pyruntime.h>
+#include <string_utils.h>
 
 using namespace std;
 using namespace rapidjson;
@@ -49,7 +52,7 @@ PluginManager *PluginManager::getInstance()
 /**
  * Plugin Manager Constructor
  */
-PluginManager::PluginManager()
+PluginManager::PluginManager() : m_manifest(getDataDir() + PLUGIN_MANIFEST_FILE)
 {
   logger = Logger::getLogger();
 
@@ -244,6 +247,28 @@ string findPlugin(string name, string _type, string _plugin_path, PLUGIN_TYPE ty
 	return "";
 }
 
+/**
+ * Import Python modules used by the plugins of the service in the
+ * background, ahead of the loading of the plugins
+ *
+ * @param modules	A comma separated list of module names
+ */
+void PluginManager::preloadPythonModules(const string& modules)
+{
+	vector<string> names;
+	stringstream list(modules);
+	string name;
+	while (getline(list, name, ','))
+	{
+		name = StringTrim(name);
+		if (!name.empty())
+		{
+			names.push_back(name);
+		}
+	}
+	PythonRuntime::preload(names);
+}
+
 /**
  * Set Plugin Type
  */
@@ -286,11 +311,19 @@ char		buf[MAXPATHLEN];
 	}
 	if (plugin_path)
 		paths += (home ? ";" : "")+string(plugin_path);
+
+	/*
+	 * A plugin found by an earlier load and unchanged since is loaded
+	 * from the same path without searching the plugin directories
+	 */
+	string manifestPath;
+	int manifestImpl;
+	bool manifested = m_manifest.find(type, name, manifestPath, manifestImpl);
   
 	/*
 	 * Find and try to load the plugin that is described via a JSON file
 	 */
-	string path = findPlugin(name, type, paths, JSON_PLUGIN);
+	string path = manifested ? "" : findPlugin(name, type, paths, JSON_PLUGIN);
 	strncpy(buf, path.c_str(), sizeof(buf));
 	if (buf[0] && access(buf, F_OK|R_OK) == 0)
 	{
@@ -346,7 +379,10 @@ char		buf[MAXPATHLEN];
 	/*
 	 * Find and try to load the dynamic library that is the plugin
 	 */
-	path = findPlugin(name, type, paths, BINARY_PLUGIN);
+	if (manifested)
+		path = manifestImpl == BINARY_PLUGIN ? manifestPath : "";
+	else
+		path = findPlugin(name, type, paths, BINARY_PLUGIN);
 	strncpy(buf, path.c_str(), sizeof(buf));
 	if (buf[0] && access(buf, F_OK|R_OK) == 0)
 	{
@@ -396,6 +432,10 @@ char		buf[MAXPATHLEN];
 
 			pluginHandleMap[hndl] = pluginHandle;
 			logger->debug("%s:%d: Added entry in pluginHandleMap={%p, %p}", __FUNCTION__, __LINE__, hndl, pluginHandle);
+			if (!manifested && !json_plugin)
+			{
+				m_manifest.add(type, name, path, BINARY_PLUGIN);
+			}
 		}
 		else
 		{
@@ -406,7 +446,10 @@ char		buf[MAXPATHLEN];
 	}
 
 	// look for and load python plugin with given name
-	path = findPlugin(name, type, paths, PYTHON_PLUGIN);
+	if (manifested)
+		path = manifestImpl == PYTHON_PLUGIN ? manifestPath : "";
+	else
+		path = findPlugin(name, type, paths, PYTHON_PLUGIN);
 	strncpy(buf, path.c_str(), sizeof(buf));
 	if (buf[0] && access(buf, F_OK|R_OK) == 0)
 	{
@@ -474,6 +517,10 @@ char		buf[MAXPATHLEN];
 			pluginImplTypes[hndl] = PYTHON_PLUGIN;
 			pluginInfo[hndl] = info;
 			pluginHandleMap[hndl] = pluginHandle;
+			if (!manifested && !json_plugin)
+			{
+				m_manifest.add(type, name, path, PYTHON_PLUGIN);
+			}
 		}
 		else
 		{
@@ -0,0 +1,253 @@
+/*
+ * Fledge service memory allocator statistics and tuning
+ *
+ * Copyright (c) 2026 Dianomic Systems
+ *
+ * Released under the Apache 2.0 Licence
+ *
+ * Author: agent
+ */
+#include <service_allocator.h>
+#include <logger.h>
+#include <rapidjson/document.h>
+#include <rapidjson/error/en.h>
+#include <sstream>
+#include <stdio.h>
+#if defined(FLEDGE_ALLOCATOR_JEMALLOC)
+#include <jemalloc/jemalloc.h>
+#elif defined(FLEDGE_ALLOCATOR_MIMALLOC)
+#include <mimalloc.h>
+#elif defined(FLEDGE_ALLOCATOR_TCMALLOC)
+#include <gperftools/malloc_extension.h>
+#else
+#include <malloc.h>
+#endif
+
+using namespace std;
+using namespace rapidjson;
+
+ServiceAllocator *ServiceAllocator::m_instance = 0;
+
+/**
+ * Return the singleton allocator of the service
+ */
+ServiceAllocator *ServiceAllocator::getInstance()
+{
+	if (!m_instance)
+		m_instance = new ServiceAllocator();
+	return m_instance;
+}
+
+/**
+ * Return the name of the allocator the service was built with
+ */
+const char *ServiceAllocator::getName() const
+{
+#if defined(FLEDGE_ALLOCATOR_JEMALLOC)
+	return "jemalloc";
+#elif defined(FLEDGE_ALLOCATOR_MIMALLOC)
+	return "mimalloc";
+#elif defined(FLEDGE_ALLOCATOR_TCMALLOC)
+	return "tcmalloc";
+#else
+	return "system";
+#endif
+}
+
+/**
+ * Apply the tuning options of the allocator. Options that are valid but
+ * not supported by the allocator in use are logged and ignored.
+ *
+ * @param json	The JSON object with the tuning options
+ * @return bool	False if the options are not valid
+ */
+bool ServiceAllocator::configure(const string& json)
+{
+	Logger *logger = Logger::getLogger();
+	Document doc;
+	doc.Parse(json.c_str());
+	if (doc.HasParseError() || !doc.IsObject())
+	{
+		logger->error("Allocator configuration is not a valid JSON object: %s",
+				doc.HasParseError() ? GetParseError_En(doc.GetParseError()) : json.c_str());
+		return false;
+	}
+	bool valid = true;
+	for (auto& member : doc.GetObject())
+	{
+		string name = member.name.GetString();
+		if (!member.value.IsInt64() || member.value.GetInt64() < 0)
+		{
+			logger->error("The allocator option '%s' must be a positive integer", name.c_str());
+			valid = false;
+			continue;
+		}
+		long value = (long)member.value.GetInt64();
+		bool supported;
+		if (name.compare("decay") == 0)
+			supported = setDecay(value);
+		else if (name.compare("threadCache") == 0)
+			supported = setThreadCache(value);
+		else if (name.compare("arenas") == 0)
+			supported = setArenas(value);
+		else
+		{
+			logger->error("Unknown allocator option '%s'", name.c_str());
+			valid = false;
+			continue;
+		}
+		if (!supported)
+		{
+			logger->warn("The option '%s' is not supported by the %s allocator", name.c_str(), getName());
+		}
+	}
+	return valid;
+}
+
+/**
+ * Set the time freed memory is held before it is returned to the
+ * operating system
+ *
+ * @param milliseconds	The time to hold freed memory
+ * @return bool		False if the allocator has no such option
+ */
+bool ServiceAllocator::setDecay(long milliseconds)
+{
+#if defined(FLEDGE_ALLOCATOR_JEMALLOC)
+	// The arenas that exist and those that are created later
+	ssize_t decay = milliseconds;
+	char name[64];
+	snprintf(name, sizeof(name), "arena.%u.dirty_decay_ms", MALLCTL_ARENAS_ALL);
+	if (mallctl(name, NULL, NULL, &decay, sizeof(decay)) != 0
+			|| mallctl("arenas.dirty_decay_ms", NULL, NULL, &decay, sizeof(decay)) != 0)
+	{
+		Logger::getLogger()->error("Unable to set the decay of the jemalloc arenas to %ld", milliseconds);
+	}
+	return true;
+#elif defined(FLEDGE_ALLOCATOR_MIMALLOC)
+	// The reset delay was renamed the purge delay in mimalloc 1.8 and 2.1
+#if MI_MALLOC_VERSION >= 210 || (MI_MALLOC_VERSION >= 180 && MI_MALLOC_VERSION < 200)
+	mi_option_set(mi_option_purge_delay, milliseconds);
+#else
+	mi_option_set(mi_option_reset_delay, milliseconds);
+#endif
+	return true;
+#else
+	(void)milliseconds;
+	return false;
+#endif
+}
+
+/**
+ * Set the memory that may be held in the caches of all the threads
+ *
+ * @param kilobytes	The size of the caches in KB
+ * @return bool		False if the allocator has no such option
+ */
+bool ServiceAllocator::setThreadCache(long kilobytes)
+{
+#if defined(FLEDGE_ALLOCATOR_TCMALLOC)
+	if (!MallocExtension::instance()->SetNumericProperty("tcmalloc.max_total_thread_cache_bytes",
+				(size_t)kilobytes * 1024))
+	{
+		Logger::getLogger()->error("Unable to set the tcmalloc thread caches to %ld KB", kilobytes);
+	}
+	return true;
+#else
+	(void)kilobytes;
+	return false;
+#endif
+}
+
+/**
+ * Set the largest number of arenas the threads allocate from
+ *
+ * @param arenas	The number of arenas, 0 for the default
+ * @return bool		False if the allocator has no such option
+ */
+bool ServiceAllocator::setArenas(long arenas)
+{
+#if defined(FLEDGE_ALLOCATOR_JEMALLOC) || defined(FLEDGE_ALLOCATOR_MIMALLOC) || defined(FLEDGE_ALLOCATOR_TCMALLOC)
+	(void)arenas;
+	return false;
+#else
+	if (mallopt(M_ARENA_MAX, (int)arenas) != 1)
+	{
+		Logger::getLogger()->error("Unable to set the number of malloc arenas to %ld", arenas);
+	}
+	return true;
+#endif
+}
+
+/**
+ * Return the name and the statistics of the allocator. The statistics
+ * are in bytes and differ between the allocators.
+ *
+ * @param json	Set to the JSON object of the statistics
+ */
+void ServiceAllocator::asJSON(string& json)
+{
+	ostringstream convert;
+	convert << "{ \"allocator\" : \"" << getName() << "\"";
+#if defined(FLEDGE_ALLOCATOR_JEMALLOC)
+	// The statistics are only updated when the epoch is advanced
+	uint64_t epoch = 1;
+	size_t size = sizeof(epoch);
+	mallctl("epoch", &epoch, &size, &epoch, size);
+	const char *stats[] = { "allocated", "active", "resident", "mapped", "retained" };
+	for (auto stat : stats)
+	{
+		string name = string("stats.") + stat;
+		size_t value = 0;
+		size = sizeof(value);
+		if (mallctl(name.c_str(), &value, &size, NULL, 0) == 0)
+		{
+			convert << ", \"" << stat << "\" : " << value;
+		}
+	}
+	unsigned int narenas = 0;
+	size = sizeof(narenas);
+	if (mallctl("arenas.narenas", &narenas, &size, NULL, 0) == 0)
+	{
+		convert << ", \"arenas\" : " << narenas;
+	}
+#elif defined(FLEDGE_ALLOCATOR_MIMALLOC)
+	size_t elapsed, user, system, rss, peakRss, commit, peakCommit, faults;
+	mi_process_info(&elapsed, &user, &system, &rss, &peakRss, &commit, &peakCommit, &faults);
+	convert << ", \"resident\" : " << rss;
+	convert << ", \"peakResident\" : " << peakRss;
+	convert << ", \"committed\" : " << commit;
+	convert << ", \"peakCommitted\" : " << peakCommit;
+	convert << ", \"pageFaults\" : " << faults;
+#elif defined(FLEDGE_ALLOCATOR_TCMALLOC)
+	const struct { const char *name; const char *property; } stats[] = {
+		{ "allocated", "generic.current_allocated_bytes" },
+		{ "heap", "generic.heap_size" },
+		{ "pageHeapFree", "tcmalloc.pageheap_free_bytes" },
+		{ "pageHeapUnmapped", "tcmalloc.pageheap_unmapped_bytes" },
+		{ "threadCaches", "tcmalloc.current_total_thread_cache_bytes" }
+	};
+	for (auto& stat : stats)
+	{
+		size_t value = 0;
+		if (MallocExtension::instance()->GetNumericProperty(stat.property, &value))
+		{
+			convert << ", \"" << stat.name << "\" : " << value;
+		}
+	}
+#else
+	// mallinfo reports the sizes as int, which overflow above 2GB
+#if defined(__GLIBC__) && (__GLIBC__ > 2 || (__GLIBC__ == 2 && __GLIBC_MINOR__ >= 33))
+	struct mallinfo2 info = mallinfo2();
+#else
+	struct mallinfo info = mallinfo();
+#endif
+	convert << ", \"allocated\" : " << (size_t)info.uordblks + (size_t)info.hblkhd;
+	convert << ", \"heap\" : " << (size_t)info.arena;
+	convert << ", \"mapped\" : " << (size_t)info.hblkhd;
+	convert << ", \"free\" : " << (size_t)info.fordblks;
+	convert << ", \"releasable\" : " << (size_t)info.keepcost;
+#endif
+	convert << " }";
+	json = convert.str();
+}
@@ -0,0 +1,252 @@
+/*
+ * Fledge service thread naming, affinity and scheduling
+ *
+ * Copyright (c) 2026 Dianomic Systems
+ *
+ * Released under the Apache 2.0 Licence
+ *
+ * Author: agent
+ */
+#include <thread_config.h>
+#include <logger.h>
+#include <rapidjson/document.h>
+#include <rapidjson/error/en.h>
+#include <stdlib.h>
+#include <string.h>
+
+using namespace std;
+using namespace rapidjson;
+
+ThreadConfig *ThreadConfig::m_instance = 0;
+
+/**
+ * Construct a role with no affinity or scheduling settings
+ */
+ThreadRole::ThreadRole() : m_hasCpus(false), m_hasPolicy(false),
+	m_policy(SCHED_OTHER), m_priority(0)
+{
+	CPU_ZERO(&m_cpus);
+}
+
+/**
+ * Return the singleton thread configuration
+ */
+ThreadConfig *ThreadConfig::getInstance()
+{
+	if (!m_instance)
+		m_instance = new ThreadConfig();
+	return m_instance;
+}
+
+/**
+ * Set the configuration of the thread roles. The previous configuration
+ * is kept if the new configuration can not be parsed.
+ *
+ * @param json	The JSON object with the settings of each role
+ * @return bool	False if the configuration is not valid
+ */
+bool ThreadConfig::configure(const string& json)
+{
+	Logger *logger = Logger::getLogger();
+	Document doc;
+	doc.Parse(json.c_str());
+	if (doc.HasParseError() || !doc.IsObject())
+	{
+		logger->error("Thread configuration is not a valid JSON object: %s",
+				doc.HasParseError() ? GetParseError_En(doc.GetParseError()) : json.c_str());
+		return false;
+	}
+	map<string, ThreadRole> roles;
+	for (auto& member : doc.GetObject())
+	{
+		string name = member.name.GetString();
+		if (!member.value.IsObject())
+		{
+			logger->error("The thread configuration of role '%s' must be an object", name.c_str());
+			return false;
+		}
+		ThreadRole role;
+		if (member.value.HasMember("cpus"))
+		{
+			const Value& cpus = member.value["cpus"];
+			if (!cpus.IsString() || !parseCpus(cpus.GetString(), &role.m_cpus))
+			{
+				logger->error("Invalid CPU list for thread role '%s'", name.c_str());
+				return false;
+			}
+			role.m_hasCpus = true;
+		}
+		if (member.value.HasMember("policy"))
+		{
+			const Value& policy = member.value["policy"];
+			if (!policy.IsString() || !parsePolicy(policy.GetString(), &role.m_policy))
+			{
+				logger->error("Invalid scheduling policy for thread role '%s'", name.c_str());
+				return false;
+			}
+			role.m_hasPolicy = true;
+		}
+		if (member.value.HasMember("priority"))
+		{
+			const Value& priority = member.value["priority"];
+			if (!priority.IsInt())
+			{
+				logger->error("Invalid scheduling priority for thread role '%s'", name.c_str());
+				return false;
+			}
+			role.m_priority = priority.GetInt();
+		}
+		roles[name] = role;
+	}
+	lock_guard<mutex> guard(m_mutex);
+	m_roles = roles;
+	return true;
+}
+
+/**
+ * Name a thread and apply the settings of its role
+ *
+ * @param thread	The thread
+ * @param role		The role of the thread, also used as its name
+ */
+void ThreadConfig::apply(std::thread& thread, const string& role)
+{
+	apply(thread.native_handle(), role);
+}
+
+/**
+ * Name the calling thread and apply the settings of its role
+ *
+ * @param role		The role of the thread, also used as its name
+ */
+void ThreadConfig::apply(const string& role)
+{
+	apply(pthread_self(), role);
+}
+
+/**
+ * Name a thread and apply the settings of its role. Failures are
+ * logged but are not fatal, the thread runs with the default settings.
+ *
+ * @param thread	The thread
+ * @param role		The role of the thread, also used as its name
+ */
+void ThreadConfig::apply(pthread_t thread, const string& role)
+{
+	Logger *logger = Logger::getLogger();
+	int rval = pthread_setname_np(thread, role.substr(0, THREAD_NAME_LEN).c_str());
+	if (rval != 0)
+	{
+		logger->warn("Unable to name thread '%s': %s", role.c_str(), strerror(rval));
+	}
+
+	ThreadRole settings;
+	{
+		lock_guard<mutex> guard(m_mutex);
+		auto it = m_roles.find(role);
+		if (it == m_roles.end())
+		{
+			it = m_roles.find(THREAD_DEFAULT_ROLE);
+		}
+		if (it == m_roles.end())
+		{
+			return;
+		}
+		settings = it->second;
+	}
+	if (settings.m_hasCpus)
+	{
+		rval = pthread_setaffinity_np(thread, sizeof(cpu_set_t), &settings.m_cpus);
+		if (rval != 0)
+		{
+			logger->warn("Unable to set the CPU affinity of thread '%s': %s",
+					role.c_str(), strerror(rval));
+		}
+	}
+	if (settings.m_hasPolicy)
+	{
+		struct sched_param param;
+		memset(&param, 0, sizeof(param));
+		if (settings.m_policy == SCHED_FIFO || settings.m_policy == SCHED_RR)
+		{
+			param.sched_priority = settings.m_priority;
+		}
+		rval = pthread_setschedparam(thread, settings.m_policy, &param);
+		if (rval != 0)
+		{
+			logger->warn("Unable to set the scheduling policy of thread '%s': %s",
+					role.c_str(), strerror(rval));
+		}
+	}
+}
+
+/**
+ * Parse a list of CPUs of the form 0,2,4-7
+ *
+ * @param cpus		The list of CPUs
+ * @param set		The CPU set to populate
+ * @return bool		False if the list is not valid or empty
+ */
+bool ThreadConfig::parseCpus(const string& cpus, cpu_set_t *set)
+{
+	CPU_ZERO(set);
+	const char *p = cpus.c_str();
+	while (*p)
+	{
+		char *end;
+		long first = strtol(p, &end, 10);
+		if (end == p || first < 0 || first >= CPU_SETSIZE)
+		{
+			return false;
+		}
+		long last = first;
+		p = end;
+		if (*p == '-')
+		{
+			p++;
+			last = strtol(p, &end, 10);
+			if (end == p || last < first || last >= CPU_SETSIZE)
+			{
+				return false;
+			}
+			p = end;
+		}
+		for (long cpu = first; cpu <= last; cpu++)
+		{
+			CPU_SET(cpu, set);
+		}
+		while (*p == ' ')
+			p++;
+		if (*p == ',')
+			p++;
+		else if (*p)
+			return false;
+		while (*p == ' ')
+			p++;
+	}
+	return CPU_COUNT(set) > 0;
+}
+
+/**
+ * Convert the name of a scheduling policy to its value
+ *
+ * @param policy	The name of the policy
+ * @param value		Set to the policy
+ * @return bool		False if the policy is not recognised
+ */
+bool ThreadConfig::parsePolicy(const string& policy, int *value)
+{
+	if (policy.compare("other") == 0)
+		*value = SCHED_OTHER;
+	else if (policy.compare("batch") == 0)
+		*value = SCHED_BATCH;
+	else if (policy.compare("idle") == 0)
+		*value = SCHED_IDLE;
+	else if (policy.compare("fifo") == 0)
+		*value = SCHED_FIFO;
+	else if (policy.compare("rr") == 0)
+		*value = SCHED_RR;
+	else
+		return false;
+	return true;
+}
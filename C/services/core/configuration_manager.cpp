@@ -24,7 +24,10 @@ ConfigurationManager *ConfigurationManager::m_instance = 0;
  * @param port	  Storage layer TCP port
  */
 ConfigurationManager::ConfigurationManager(const string& host,
-					   unsigned short port)
+					   unsigned short port) :
+					   m_namesCached(false),
+					   m_cacheHits(0),
+					   m_cacheMisses(0)
 {
 	m_storage = new StorageClient(host, port);
 }
@@ -64,6 +67,22 @@ ConfigCategories ConfigurationManager::getAllCategoryNames() const
 	// Return object
 	ConfigCategories categories;
 
+	{
+		lock_guard<mutex> guard(m_cacheMutex);
+		if (m_namesCached)
+		{
+			m_cacheHits++;
+			for (auto& name : m_categoryNames)
+			{
+				categories.addCategoryDescription(new ConfigCategoryDescription(name.first,
+												name.second));
+			}
+			return categories;
+		}
+		m_cacheMisses++;
+	}
+
+	vector<pair<string, string>> names;
 	vector<Returns *> columns;
 	columns.push_back(new Returns("key"));
 	columns.push_back(new Returns("description"));
@@ -96,12 +115,19 @@ ConfigCategories ConfigurationManager::getAllCategoryNames() const
 											 description->getString());
 			// Add current row data to categories;
 			categories.addCategoryDescription(value);
+			names.push_back(make_pair(string(key->getString()), string(description->getString())));
 
 		} while (!allCategories->isLastRow(it++));
 
 		// Free result set
 		delete allCategories;
 
+		{
+			lock_guard<mutex> guard(m_cacheMutex);
+			m_categoryNames = names;
+			m_namesCached = true;
+		}
+
 		// Return object
 		return categories;
 
@@ -141,6 +167,17 @@ ConfigCategories ConfigurationManager::getAllCategoryNames() const
 
 ConfigCategory ConfigurationManager::getCategoryAllItems(const string& categoryName) const
 {
+	{
+		lock_guard<mutex> guard(m_cacheMutex);
+		auto cached = m_categoryCache.find(categoryName);
+		if (cached != m_categoryCache.end())
+		{
+			m_cacheHits++;
+			return cached->second;
+		}
+		m_cacheMisses++;
+	}
+
 	// SELECT * FROM fledge.configuration WHERE key = categoryName
 	const Condition conditionKey(Equals);
 	Where *wKey = new Where("key", conditionKey, categoryName);
@@ -191,6 +228,11 @@ ConfigCategory ConfigurationManager::getCategoryAllItems(const string& categoryN
 		// Free result set
 		delete categoryItems;
 
+		{
+			lock_guard<mutex> guard(m_cacheMutex);
+			m_categoryCache[categoryName] = theVal;
+		}
+
 		return theVal;
 	}
 	catch (std::exception* e)
@@ -388,6 +430,11 @@ ConfigCategory ConfigurationManager::createCategory(const std::string& categoryN
 		// Free result set data
 		delete result;
 
+		// Write the stored items through to the cache
+		cacheCategory(categoryName,
+			      categoryDescription,
+			      returnNew ? preparedValue.itemsToJSON() : updatedItems);
+
 		if (returnNew)
 		{
 			// Return the new created category
@@ -638,16 +685,30 @@ bool ConfigurationManager::setCategoryItemValue(const std::string& categoryName,
 	{
 		// UPDATE fledge.configuration SET vale = JSON(jsonValues)
 		// WHERE key = 'categoryName';
-		return (!m_storage->updateTable("configuration", jsonValues, wKey)) ? false : true;
+		if (!m_storage->updateTable("configuration", jsonValues, wKey))
+		{
+			invalidateCategory(categoryName);
+			return false;
+		}
+		// Write the new value through to the cache
+		lock_guard<mutex> guard(m_cacheMutex);
+		auto cached = m_categoryCache.find(categoryName);
+		if (cached != m_categoryCache.end())
+		{
+			cached->second.setValue(itemName, newValue);
+		}
+		return true;
 	}
 	catch (std::exception* e)
 	{
 		delete e;
+		invalidateCategory(categoryName);
 		// Return failure
 		return false;
 	}
 	catch (...)
 	{
+		invalidateCategory(categoryName);
 		// Return failure
 		return false;
 	}
@@ -805,6 +866,11 @@ string ConfigurationManager::addChildCategory(const string& parentCategoryName,
 		throw ExistingChildCategories();
 	}
 
+	{
+		lock_guard<mutex> guard(m_cacheMutex);
+		m_childCache.erase(parentCategoryName);
+	}
+
 	// Fetch current children of parentCategoryName;
 	return this->fetchChildCategories(parentCategoryName);
 }
@@ -817,6 +883,17 @@ string ConfigurationManager::addChildCategory(const string& parentCategoryName,
  */
 string ConfigurationManager::fetchChildCategories(const string& parentCategoryName) const
 {
+	{
+		lock_guard<mutex> guard(m_cacheMutex);
+		auto cached = m_childCache.find(parentCategoryName);
+		if (cached != m_childCache.end())
+		{
+			m_cacheHits++;
+			return cached->second;
+		}
+		m_cacheMisses++;
+	}
+
 	ostringstream currentChildCategories;
 
 	// Fetch current children of parentCategoryName;
@@ -843,6 +920,8 @@ string ConfigurationManager::fetchChildCategories(const string& parentCategoryNa
 			delete newCategories;
 			currentChildCategories << " ] }";
 
+			lock_guard<mutex> guard(m_cacheMutex);
+			m_childCache[parentCategoryName] = currentChildCategories.str();
 			return currentChildCategories.str();
 		}
 
@@ -872,6 +951,9 @@ string ConfigurationManager::fetchChildCategories(const string& parentCategoryNa
 		// Free result set
 		delete newCategories;
 
+		lock_guard<mutex> guard(m_cacheMutex);
+		m_childCache[parentCategoryName] = currentChildCategories.str();
+
 		// Returm child categories
 		return currentChildCategories.str();
 	}
@@ -998,6 +1080,11 @@ string ConfigurationManager::deleteChildCategory(const string& parentCategoryNam
 	Where* wParent = new Where("parent", conditionParent, parentCategoryName, wChild);
 	Query qParentChild(wParent);
 
+	{
+		lock_guard<mutex> guard(m_cacheMutex);
+		m_childCache.erase(parentCategoryName);
+	}
+
 	try
 	{
 		// Do the delete
@@ -1074,6 +1161,8 @@ ConfigCategories ConfigurationManager::deleteCategory(const string& categoryName
 	// DELETE from category_children
 	Query qParent(wParent);
 
+	invalidateCategory(categoryName);
+
 	try
 	{
 		// Do the category delete
@@ -1110,3 +1199,59 @@ ConfigCategories ConfigurationManager::deleteCategory(const string& categoryName
 		throw ConfigCategoryEx();
 	}
 }
+
+/**
+ * Add a category to the cache as it is held in the storage layer.
+ * The list of category names is reloaded on the next request, as the
+ * category may be new or its description may have changed.
+ *
+ * @param categoryName	The category name
+ * @param description	The category description
+ * @param items		The JSON items of the category
+ */
+void ConfigurationManager::cacheCategory(const string& categoryName,
+					 const string& description,
+					 const string& items) const
+{
+	lock_guard<mutex> guard(m_cacheMutex);
+	m_namesCached = false;
+	try
+	{
+		ConfigCategory category(categoryName, items);
+		category.setDescription(description);
+		m_categoryCache[categoryName] = category;
+	}
+	catch (...)
+	{
+		m_categoryCache.erase(categoryName);
+	}
+}
+
+/**
+ * Remove a category, and its child categories, from the cache
+ *
+ * @param categoryName	The category name
+ */
+void ConfigurationManager::invalidateCategory(const string& categoryName) const
+{
+	lock_guard<mutex> guard(m_cacheMutex);
+	m_categoryCache.erase(categoryName);
+	m_childCache.erase(categoryName);
+	m_namesCached = false;
+}
+
+/**
+ * Return the statistics of the category cache
+ *
+ * @return	JSON object with the cache hits, misses and cached categories
+ */
+string ConfigurationManager::getCacheStatistics() const
+{
+	lock_guard<mutex> guard(m_cacheMutex);
+	ostringstream convert;
+	convert << "{ \"hits\" : " << m_cacheHits;
+	convert << ", \"misses\" : " << m_cacheMisses;
+	convert << ", \"categories\" : " << m_categoryCache.size();
+	convert << ", \"children\" : " << m_childCache.size() << " }";
+	return convert.str();
+}
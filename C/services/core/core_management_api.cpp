@@ -125,6 +125,16 @@ void getAllCategoriesWrapper(shared_ptr<HttpServer::Response> response,
 	api->getAllCategories(response, request);
 }
 
+/**
+ * Wrapper for get configuration cache statistics
+ */
+void getConfigurationCacheWrapper(shared_ptr<HttpServer::Response> response,
+				  shared_ptr<HttpServer::Request> request)
+{
+	CoreManagementApi *api = CoreManagementApi::getInstance();
+	api->getConfigurationCache(response, request);
+}
+
 /**
  * Wrapper for get category name
  */
@@ -337,6 +347,15 @@ void CoreManagementApi::getAllCategories(shared_ptr<HttpServer::Response> respon
 	}
 }
 
+/**
+ * Received a GET /fledge/service/configuration/cache
+ */
+void CoreManagementApi::getConfigurationCache(shared_ptr<HttpServer::Response> response,
+					      shared_ptr<HttpServer::Request> request)
+{
+	respond(response, m_config->getCacheStatistics());
+}
+
 /**
  * Wrapper function for the default resource call.
  * This is called whenever an unrecognised entry point call is received.
@@ -629,6 +648,7 @@ void CoreManagementApi::setConfigurationEntryPoints()
 	m_server->resource[DELETE_CHILD_CATEGORY]["DELETE"] = deleteChildCategoryWrapper;
 	m_server->resource[CREATE_CATEGORY]["POST"] = createCategoryWrapper;
 	m_server->resource[ADD_CHILD_CATEGORIES]["POST"] = addChildCategoryWrapper;
+	m_server->resource[GET_CONFIGURATION_CACHE]["GET"] = getConfigurationCacheWrapper;
 
 	Logger *logger = Logger::getLogger();
 	logger->info("ConfigurationManager setup is done.");
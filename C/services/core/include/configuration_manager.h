@@ -14,7 +14,20 @@
 #include <storage_client.h>
 #include <config_category.h>
 #include <string>
+#include <map>
+#include <vector>
+#include <mutex>
 
+/**
+ * The configuration manager of the core.
+ *
+ * Categories, the list of category names and the child categories of
+ * each parent category are held in memory once they have been read from
+ * the storage layer. The cache is updated as categories are created and
+ * item values are set, and entries are removed when categories or child
+ * categories are deleted, so only the first read of each category goes
+ * to the storage layer.
+ */
 class ConfigurationManager {
         public:
 		static ConfigurationManager*	getInstance(const std::string&, short unsigned int);
@@ -70,6 +83,8 @@ class ConfigurationManager {
 		// Internal usage
 		std::string			getCategoryItemValue(const std::string& categoryName,
 								     const std::string& itemName) const;
+		// Cache hits, misses and cached categories as a JSON object
+		std::string			getCacheStatistics() const;
 
 	private:
 		ConfigurationManager(const std::string& host,
@@ -83,9 +98,24 @@ class ConfigurationManager {
 		std::string	fetchChildCategories(const std::string& parentCategoryName) const;
 		std::string	getCategoryDescription(const std::string& categoryName) const;
 
+		void		cacheCategory(const std::string& categoryName,
+					      const std::string& description,
+					      const std::string& items) const;
+		void		invalidateCategory(const std::string& categoryName) const;
+
 	private:
 		static  ConfigurationManager*	m_instance;
 		StorageClient*			m_storage;
+		mutable std::mutex		m_cacheMutex;
+		mutable std::map<std::string, ConfigCategory>
+						m_categoryCache;
+		mutable std::vector<std::pair<std::string, std::string>>
+						m_categoryNames;
+		mutable bool			m_namesCached;
+		mutable std::map<std::string, std::string>
+						m_childCache;
+		mutable unsigned long		m_cacheHits;
+		mutable unsigned long		m_cacheMisses;
 };
 
 /**
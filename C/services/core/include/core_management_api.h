@@ -26,6 +26,7 @@
 #define ADD_CHILD_CATEGORIES		"/fledge/service/category/([A-Za-z][a-zA-Z_0-9]*)/(children)"
 #define REGISTER_CATEGORY_INTEREST	"/fledge/interest"	// TODO implment this, right now it's a fake.
 #define GET_SERVICE			REGISTER_SERVICE
+#define GET_CONFIGURATION_CACHE		"/fledge/service/configuration/cache"
 
 #define UUID_COMPONENT			1
 #define CATEGORY_NAME_COMPONENT		1
@@ -75,6 +76,9 @@ class CoreManagementApi : public ManagementApi {
 		// Called by POST /fledge/service/category/{categoryName}/children
 		void			addChildCategory(std::shared_ptr<HttpServer::Response> response,
 							 std::shared_ptr<HttpServer::Request> request);
+		// Called by GET /fledge/service/configuration/cache
+		void			getConfigurationCache(std::shared_ptr<HttpServer::Response> response,
+							      std::shared_ptr<HttpServer::Request> request);
 		// Default handler for unsupported URLs
 		void			defaultResource(std::shared_ptr<HttpServer::Response> response,
 							std::shared_ptr<HttpServer::Request> request);
@@ -12,10 +12,17 @@
 #include <service_record.h>
 #include <vector>
 #include <map>
+#include <set>
+#include <unordered_map>
 #include <string>
+#include <pthread.h>
 
 /**
  * ServiceRegistry Singleton class
+ *
+ * Services are indexed by name, registration uuid and type. Lookups
+ * take a read lock on the registry so that they may run concurrently,
+ * registration and unregistration take the write lock.
  */
 class ServiceRegistry {
 	public:
@@ -24,13 +31,23 @@ class ServiceRegistry {
 		bool				unRegisterService(ServiceRecord *service);
 		bool				unRegisterService(const std::string& uuid);
 		ServiceRecord			*findService(const std::string& name);
+		void				findServices(const std::string& type,
+							std::vector<ServiceRecord *>& services);
 		std::string			getUUID(ServiceRecord *service);
 	private:
 		ServiceRegistry();
 		~ServiceRegistry();
+		bool				removeService(ServiceRecord *service);
 		static	ServiceRegistry		*m_instance;
-		std::vector<ServiceRecord *>	m_services;
-		std::map<std::string, ServiceRecord *>	m_uuids;
+		pthread_rwlock_t		m_lock;
+		std::unordered_map<std::string, ServiceRecord *>
+						m_names;
+		std::unordered_map<std::string, ServiceRecord *>
+						m_uuids;
+		std::unordered_map<ServiceRecord *, std::string>
+						m_records;	// The uuid of each registered service
+		std::unordered_map<std::string, std::set<ServiceRecord *> >
+						m_types;
 };
 
 #endif
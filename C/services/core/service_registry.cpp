@@ -19,6 +19,7 @@ ServiceRegistry *ServiceRegistry::m_instance = 0;
  */
 ServiceRegistry::ServiceRegistry()
 {
+	pthread_rwlock_init(&m_lock, NULL);
 }
 
 /**
@@ -26,11 +27,11 @@ ServiceRegistry::ServiceRegistry()
  */
 ServiceRegistry::~ServiceRegistry()
 {
-	for (vector<ServiceRecord *>::iterator it = m_services.begin();
-		it != m_services.end(); ++it)
+	for (auto it = m_names.begin(); it != m_names.end(); ++it)
 	{
-		delete *it;
+		delete it->second;
 	}
+	pthread_rwlock_destroy(&m_lock);
 }
 
 /**
@@ -53,55 +54,80 @@ bool ServiceRegistry::registerService(ServiceRecord *service)
 {
 uuid_t		uuid;
 char		uuid_str[37];
-ServiceRecord	*existing;
 
-	if ((existing = findService(service->getName())) != 0)
+	pthread_rwlock_wrlock(&m_lock);
+	auto existing = m_names.find(service->getName());
+	if (existing != m_names.end())
 	{
-		if (existing->getAddress().compare(service->getAddress()) ||
-			existing->getType().compare(service->getType()) ||
-			existing->getPort() != service->getPort())
+		if (existing->second->getAddress().compare(service->getAddress()) ||
+			existing->second->getType().compare(service->getType()) ||
+			existing->second->getPort() != service->getPort())
 		{
 			/* Service already registered with the same name on
 			 * a different address, port or type
 			 */
+			pthread_rwlock_unlock(&m_lock);
 			return false;
 		}
 		// Overwrite existing service
-		unRegisterService(existing);
+		removeService(existing->second);
 	}
-	m_services.push_back(service);
 	uuid_generate_time_safe(uuid);
 	uuid_unparse_lower(uuid, uuid_str);
+	m_names[service->getName()] = service;
 	m_uuids[string(uuid_str)] = service;
+	m_records[service] = string(uuid_str);
+	m_types[service->getType()].insert(service);
+	pthread_rwlock_unlock(&m_lock);
 	return true;
 }
 
 /**
- * Unregister a service with the service registry
+ * Remove a service from the indexes of the registry, the caller
+ * must hold the write lock
  *
- * @param service	The service to unregister
- * @return bool		True if the service was unregistered
+ * @param service	The service to remove
+ * @return bool		True if the service was registered
  */
-bool ServiceRegistry::unRegisterService(ServiceRecord *service)
+bool ServiceRegistry::removeService(ServiceRecord *service)
 {
-	for (vector<ServiceRecord *>::iterator it = m_services.begin();
-		it != m_services.end(); ++it)
+	auto it = m_names.find(service->getName());
+	if (it == m_names.end() || !(*service == *it->second))
+	{
+		return false;
+	}
+	ServiceRecord *registered = it->second;
+	m_names.erase(it);
+	auto rit = m_records.find(registered);
+	if (rit != m_records.end())
+	{
+		m_uuids.erase(rit->second);
+		m_records.erase(rit);
+	}
+	auto tit = m_types.find(registered->getType());
+	if (tit != m_types.end())
 	{
-		if (*service == **it)
+		tit->second.erase(registered);
+		if (tit->second.empty())
 		{
-			m_services.erase(it);
-			for (map<string, ServiceRecord *>::iterator uit = m_uuids.begin(); uit != m_uuids.end(); ++ uit)
-			{
-				if (uit->second == service)
-				{
-					m_uuids.erase(uit);
-					break;
-				}
-			}
-			return true;
+			m_types.erase(tit);
 		}
 	}
-	return false;
+	return true;
+}
+
+/**
+ * Unregister a service with the service registry
+ *
+ * @param service	The service to unregister
+ * @return bool		True if the service was unregistered
+ */
+bool ServiceRegistry::unRegisterService(ServiceRecord *service)
+{
+	pthread_rwlock_wrlock(&m_lock);
+	bool rval = removeService(service);
+	pthread_rwlock_unlock(&m_lock);
+	return rval;
 }
 
 /**
@@ -112,25 +138,16 @@ bool ServiceRegistry::unRegisterService(ServiceRecord *service)
  */
 bool ServiceRegistry::unRegisterService(const string& uuid)
 {
-ServiceRecord	*service;
-map<string, ServiceRecord *>::iterator	uuidIt;
-	
-	if ((uuidIt = m_uuids.find(uuid)) == m_uuids.end())
-	{
-		return false;
-	}
-	service = m_uuids[uuid];
-	for (vector<ServiceRecord *>::iterator it = m_services.begin();
-		it != m_services.end(); ++it)
+	bool rval = false;
+
+	pthread_rwlock_wrlock(&m_lock);
+	auto it = m_uuids.find(uuid);
+	if (it != m_uuids.end())
 	{
-		if (*service == **it)
-		{
-			m_services.erase(it);
-			m_uuids.erase(uuidIt);
-			return true;
-		}
+		rval = removeService(it->second);
 	}
-	return false;
+	pthread_rwlock_unlock(&m_lock);
+	return rval;
 }
 
 /**
@@ -141,13 +158,34 @@ map<string, ServiceRecord *>::iterator	uuidIt;
  */
 ServiceRecord *ServiceRegistry::findService(const string& name)
 {
-	for (vector<ServiceRecord *>::iterator it = m_services.begin();
-		it != m_services.end(); ++it)
+	ServiceRecord *service = 0;
+
+	pthread_rwlock_rdlock(&m_lock);
+	auto it = m_names.find(name);
+	if (it != m_names.end())
 	{
-		if ((*it)->getName().compare(name) == 0)
-			return *it;
+		service = it->second;
 	}
-	return 0;
+	pthread_rwlock_unlock(&m_lock);
+	return service;
+}
+
+/**
+ * Find the services of a given type that are registered with the
+ * service registry
+ *
+ * @param type		The type of the services to find
+ * @param services	The vector to which the services are added
+ */
+void ServiceRegistry::findServices(const string& type, vector<ServiceRecord *>& services)
+{
+	pthread_rwlock_rdlock(&m_lock);
+	auto it = m_types.find(type);
+	if (it != m_types.end())
+	{
+		services.insert(services.end(), it->second.begin(), it->second.end());
+	}
+	pthread_rwlock_unlock(&m_lock);
 }
 
 /**
@@ -159,14 +197,14 @@ ServiceRecord *ServiceRegistry::findService(const string& name)
  */
 string ServiceRegistry::getUUID(ServiceRecord *service)
 {
-map<string, ServiceRecord *>::const_iterator  it;
-
-	for (it = m_uuids.cbegin(); it != m_uuids.cend(); ++it)
+	pthread_rwlock_rdlock(&m_lock);
+	auto it = m_records.find(service);
+	if (it == m_records.end())
 	{
-		if (it->second == service)
-		{
-			return it->first;
-		}
+		pthread_rwlock_unlock(&m_lock);
+		throw new exception();
 	}
-	throw new exception();
+	string uuid = it->second;
+	pthread_rwlock_unlock(&m_lock);
+	return uuid;
 }
@@ -23,8 +23,6 @@ static void filter_plugin_ingest_fn(PyObject *ingest_callback,
 				    PyObject *ingest_obj_ref_data,
 				    PyObject *readingsObj);
 
-static PyObject *IngestError;
-
 /**
  * Implementation of data ingest into filters chain
  *
@@ -68,13 +66,45 @@ static PyMethodDef FilterIngestMethods[] = {
 	{NULL, NULL, 0, NULL}    /* Sentinel */
 };
 
+/**
+ * Add the exception object to the module
+ */
+static int filter_ingest_exec(PyObject *m)
+{
+	PyObject *ingestError = PyErr_NewException("ingest.error", NULL, NULL);
+	if (PyModule_AddObject(m, "error", ingestError) < 0)
+	{
+		Py_XDECREF(ingestError);
+		return -1;
+	}
+	return 0;
+}
+
+#if PY_VERSION_HEX >= 0x030C0000
+/**
+ * The module keeps no state of its own and may be imported into the
+ * sub-interpreters of isolated filters, each with its own GIL
+ */
+static PyModuleDef_Slot FilterIngestSlots[] = {
+	{Py_mod_exec, (void *)filter_ingest_exec},
+	{Py_mod_multiple_interpreters, Py_MOD_PER_INTERPRETER_GIL_SUPPORTED},
+	{0, NULL}
+};
+#endif
+
 static struct PyModuleDef filterIngestmodule = {
 	PyModuleDef_HEAD_INIT,
 	"filter_ingest",   /* name of module */
 	NULL, 		/* module documentation, may be NULL */
+#if PY_VERSION_HEX >= 0x030C0000
+	0,       	/* size of per-interpreter state of the module */
+	FilterIngestMethods,
+	FilterIngestSlots
+#else
 	-1,       	/* size of per-interpreter state of the module,
 	             or -1 if the module keeps state in global variables. */
 	FilterIngestMethods
+#endif
 };
 
 /**
@@ -83,6 +113,9 @@ static struct PyModuleDef filterIngestmodule = {
 PyMODINIT_FUNC
 PyInit_filter_ingest(void)
 {	
+#if PY_VERSION_HEX >= 0x030C0000
+	return PyModuleDef_Init(&filterIngestmodule);
+#else
 	PyObject *m;
 
 	m = PyModule_Create(&filterIngestmodule);
@@ -92,11 +125,13 @@ PyInit_filter_ingest(void)
 		return NULL;
 	}
 
-	IngestError = PyErr_NewException("ingest.error", NULL, NULL);
-	Py_INCREF(IngestError);
-	PyModule_AddObject(m, "error", IngestError);
+	if (filter_ingest_exec(m) < 0)
+	{
+		Py_CLEAR(m);
+	}
 
 	return m;
+#endif
 }
 
 /**
@@ -149,10 +184,23 @@ void filter_plugin_ingest_fn(PyObject *ingest_callback,
 		Logger::getLogger()->debug("%s:%d, pyReadingSet=%p, pyReadingSet readings count=%d", 
                                     __FUNCTION__, __LINE__, pyReadingSet, pyReadingSet?pyReadingSet->getCount():0);
 	}
+	else if (PyDict_Check(readingsObj))
+	{
+		try
+		{
+			// Get vector of Readings from the Python columns
+			pyReadingSet = PythonReadingSet::fromColumns(readingsObj);
+		}
+		catch (std::exception e)
+		{
+			Logger::getLogger()->warn("Unable to create a PythonReadingSet from columns, error: %s", e.what());
+			pyReadingSet = NULL;
+		}
+	}
 	else
 	{
 		Logger::getLogger()->error("Filter did not return a Python List "
-					   "but object type %s",
+					   "or Dict of columns but object type %s",
 					   Py_TYPE(readingsObj)->tp_name);
 	}
 
@@ -171,8 +219,11 @@ void filter_plugin_ingest_fn(PyObject *ingest_callback,
 		// Get ingest object parameter
 		void *data = PyCapsule_GetPointer(ingest_obj_ref_data, NULL);
 
-		// Invoke callback method for ReadingSet filter ingestion
+		// Invoke callback method for ReadingSet filter ingestion, the
+		// next filter in the chain may run in another interpreter
+		Py_BEGIN_ALLOW_THREADS
 		(*cb)(data, pyReadingSet);
+		Py_END_ALLOW_THREADS
 	}
 	else
 	{
@@ -81,7 +81,8 @@ static void filter_plugin_reconfigure_fn(PLUGIN_HANDLE handle,
 	std::mutex mtx;
 	PyObject* pFunc;
 	lock_guard<mutex> guard(mtx);
-	PyGILState_STATE state = PyGILState_Ensure();
+	PythonInterpreter *interpreter = it->second->m_interpreter;
+	PyGILState_STATE state = acquireGIL(interpreter);
 
 	Logger::getLogger()->debug("plugin_handle: plugin_reconfigure(): "
 				   "pModule=%p, *handle=%p, plugin '%s'",
@@ -93,7 +94,7 @@ static void filter_plugin_reconfigure_fn(PLUGIN_HANDLE handle,
 	if(config.compare("logLevel") == 0)
 	{
 		set_loglevel_in_python_module(it->second->m_module, it->second->m_name+" filter_plugin_reconf");
-		PyGILState_Release(state);
+		releaseGIL(interpreter, state);
 		return;
 	}
 	
@@ -104,7 +105,7 @@ static void filter_plugin_reconfigure_fn(PLUGIN_HANDLE handle,
 		Logger::getLogger()->fatal("Cannot find method 'plugin_reconfigure' "
 					   "in loaded python module '%s'",
 					   pName.c_str());
-		PyGILState_Release(state);
+		releaseGIL(interpreter, state);
 		return;
 	}
 
@@ -121,13 +122,13 @@ static void filter_plugin_reconfigure_fn(PLUGIN_HANDLE handle,
 					   pName.c_str());
 		Py_CLEAR(pFunc);
 
-		PyGILState_Release(state);
+		releaseGIL(interpreter, state);
 		return;
 	}
 
 	Logger::getLogger()->debug("plugin_reconfigure with %s", config.c_str());
 
-	PyObject *config_dict = json_loads(config.c_str());
+	PyObject *config_dict = config_loads(config, it->second);
 
 	// Call Python method passing an object and JSON config dict
 	PyObject* pReturn = PyObject_CallFunction(pFunc,
@@ -136,6 +137,7 @@ static void filter_plugin_reconfigure_fn(PLUGIN_HANDLE handle,
 						  config_dict);
 
 	Py_CLEAR(pFunc);
+	Py_CLEAR(config_dict);
 
 	// Handle returned data
 	if (!pReturn)
@@ -175,7 +177,7 @@ static void filter_plugin_reconfigure_fn(PLUGIN_HANDLE handle,
 		}
 	}
 
-	PyGILState_Release(state);
+	releaseGIL(interpreter, state);
 }
 
 /**
@@ -215,16 +217,29 @@ void filter_plugin_ingest_fn(PLUGIN_HANDLE handle, READINGSET *data)
 	string pName = it->second->m_name;
 
 	PyObject* pFunc;
-	PyGILState_STATE state = PyGILState_Ensure();
+	PythonInterpreter *interpreter = it->second->m_interpreter;
+	PyGILState_STATE state = acquireGIL(interpreter);
+
+	// A plugin that has a plugin_ingest_columns method is passed the
+	// readings as columns rather than as a list of readings. The columns
+	// are numpy arrays, which can not be used in an isolated plugin.
+	bool columns = !interpreter;
+	pFunc = columns ? PyObject_GetAttrString(it->second->m_module, "plugin_ingest_columns") : NULL;
+	if (!pFunc || !PyCallable_Check(pFunc))
+	{
+		PyErr_Clear();
+		Py_CLEAR(pFunc);
+		columns = false;
 
-	// Fetch required method in loaded object
-	pFunc = PyObject_GetAttrString(it->second->m_module, "plugin_ingest");
+		// Fetch required method in loaded object
+		pFunc = PyObject_GetAttrString(it->second->m_module, "plugin_ingest");
+	}
 	if (!pFunc)
 	{
 		Logger::getLogger()->fatal("Cannot find 'plugin_ingest' "
 					   "method in loaded python module '%s'",
 					   pName.c_str());
-		PyGILState_Release(state);
+		releaseGIL(interpreter, state);
 		return;
 	}
 	if (!pFunc || !PyCallable_Check(pFunc))
@@ -240,21 +255,24 @@ void filter_plugin_ingest_fn(PLUGIN_HANDLE handle, READINGSET *data)
 					   pName.c_str());
 		Py_CLEAR(pFunc);
 
-		PyGILState_Release(state);
+		releaseGIL(interpreter, state);
 		return;
 	}
 
 	// Call asset tracker
 	// int i=0;
 	vector<Reading *>* readings = ((ReadingSet *)data)->getAllReadingsPtr();
+	InternedString lastAsset;
 	for (vector<Reading *>::const_iterator elem = readings->begin();
 						      elem != readings->end();
 						      ++elem)
 	{
 		// Logger::getLogger()->debug("Reading %d: %s", i++, (*elem)->toJSON().c_str());
 		AssetTracker* atr = AssetTracker::getAssetTracker();
-		if (atr)
+		// Runs of readings of the same asset only need one tuple
+		if (atr && (*elem)->getInternedAssetName() != lastAsset)
 		{
+			lastAsset = (*elem)->getInternedAssetName();
 			AssetTracker::getAssetTracker()->addAssetTrackingTuple(it->second->getCategoryName(),
 										(*elem)->getAssetName(),
 										string("Filter"));
@@ -263,9 +281,9 @@ void filter_plugin_ingest_fn(PLUGIN_HANDLE handle, READINGSET *data)
 
 	Logger::getLogger()->debug("C2Py: filter_plugin_ingest_fn():L%d: data->getCount()=%d", __LINE__, data->getCount());
 
-	// Create a readingList of readings to be filtered
+	// Create a readingList of readings, or the columns of the readings, to be filtered
 	PythonReadingSet *pyReadingSet = (PythonReadingSet *) data;
-	PyObject* readingsList = pyReadingSet->toPython();
+	PyObject* readingsList = columns ? pyReadingSet->toPythonColumns() : pyReadingSet->toPython();
 
 	PyObject* pReturn = PyObject_CallFunction(pFunc,
 						  "OO",
@@ -291,7 +309,7 @@ void filter_plugin_ingest_fn(PLUGIN_HANDLE handle, READINGSET *data)
 	Py_CLEAR(pReturn);
 
 	// Release GIL
-	PyGILState_Release(state);
+	releaseGIL(interpreter, state);
 }
 
 /**
@@ -398,18 +416,33 @@ PLUGIN_HANDLE filter_plugin_init_fn(ConfigCategory* config,
 
 	Logger::getLogger()->info("filter_plugin_init_fn: loadModule=%s, reloadModule=%s", 
                                 loadModule?"TRUE":"FALSE", reloadModule?"TRUE":"FALSE");
+
+	string fledgePythonDir;
+
+	string fledgeRootDir(getenv("FLEDGE_ROOT"));
+	fledgePythonDir = fledgeRootDir + "/python";
+
+	// An isolated filter is imported into a sub-interpreter of its own
+	// so that it does not share the GIL with the other Python plugins
+	PythonInterpreter *interpreter = NULL;
+	if (config->itemExists("isolate") && config->getValue("isolate").compare("true") == 0)
+	{
+		string filtersRootPath = fledgePythonDir + string(R"(/fledge/plugins/filter/)") + pName;
+		try {
+			interpreter = new PythonInterpreter({fledgePythonDir, filtersRootPath});
+		} catch (runtime_error& e) {
+			Logger::getLogger()->warn("Filter '%s' can not be isolated, %s. "
+						  "It will share the Python interpreter of the service",
+						  config->getName().c_str(), e.what());
+		}
+	}
     
 	// Acquire GIL
-	PyGILState_STATE state = PyGILState_Ensure();
+	PyGILState_STATE state = acquireGIL(interpreter);
     
 	// Import Python module
-	if (loadModule || reloadModule)
+	if (loadModule || reloadModule || interpreter)
 	{        
-		string fledgePythonDir;
-
-		string fledgeRootDir(getenv("FLEDGE_ROOT"));
-		fledgePythonDir = fledgeRootDir + "/python";
-
 		// Set Python path for embedded Python 3.x
 		// Get current sys.path - borrowed reference
 		PyObject* sysPath = PySys_GetObject((char *)"path");
@@ -443,7 +476,8 @@ PLUGIN_HANDLE filter_plugin_init_fn(ConfigCategory* config,
 							  NULL)) == NULL)
 			{
 				// Release lock
-				PyGILState_Release(state);
+				releaseGIL(interpreter, state);
+				delete interpreter;
 
 				Logger::getLogger()->fatal("plugin_handle: filter_plugin_init(): "
 							   "failed to create Python module "
@@ -454,6 +488,7 @@ PLUGIN_HANDLE filter_plugin_init_fn(ConfigCategory* config,
 
 			// Set category name
 			newModule->setCategoryName(config->getName());
+			newModule->m_interpreter = interpreter;
 
 			// Set module
 			module = newModule;
@@ -463,7 +498,8 @@ PLUGIN_HANDLE filter_plugin_init_fn(ConfigCategory* config,
 			logErrorMessage();
 
 			// Release lock
-			PyGILState_Release(state);
+			releaseGIL(interpreter, state);
+			delete interpreter;
 
 			Logger::getLogger()->fatal("plugin_handle: filter_plugin_init(): "
 						   "failed to import plugin '%s'",
@@ -487,7 +523,7 @@ PLUGIN_HANDLE filter_plugin_init_fn(ConfigCategory* config,
 	Logger::getLogger()->debug("%s:%d: calling set_loglevel_in_python_module(), loglevel=%s", __FUNCTION__, __LINE__, Logger::getLogger()->getMinLevel().c_str());
 	set_loglevel_in_python_module(module->m_module, module->m_name + " plugin_init");
 
-	PyObject *config_dict = json_loads(config->itemsToJSON().c_str());
+	PyObject *config_dict = config_loads(config->itemsToJSON(), module);
         
 	// Call Python method passing an object
 	PyObject* ingest_fn = PyCapsule_New((void *)output, NULL, NULL);
@@ -553,7 +589,26 @@ PLUGIN_HANDLE filter_plugin_init_fn(ConfigCategory* config,
 	}
 
 	// Release locks
-	PyGILState_Release(state);
+	releaseGIL(interpreter, state);
+	if (!pReturn && interpreter)
+	{
+		// The module, and the interpreter, are only kept with the handle
+		state = acquireGIL(interpreter);
+		if (module)
+		{
+			if (pythonHandles)
+			{
+				auto h = pythonHandles->find(NULL);
+				if (h != pythonHandles->end() && h->second == module)
+				{
+					pythonHandles->erase(h);
+				}
+			}
+			delete module;
+		}
+		releaseGIL(interpreter, state);
+		delete interpreter;
+	}
 
 	return pReturn ? (PLUGIN_HANDLE) pReturn : NULL;
 }
@@ -585,7 +640,7 @@ void *PluginInterfaceInit(const char *pluginName, const char * pluginPathName)
 	PythonRuntime::getPythonRuntime();
     
 	// Acquire GIL
-	PyGILState_STATE state = PyGILState_Ensure();
+	PyGILState_STATE state = PythonInterpreter::ensureGIL();
         
 	Logger::getLogger()->info("FilterPlugin PluginInterfaceInit %s:%d: "
 				   "fledgePythonDir=%s, plugin '%s'",
@@ -639,7 +694,7 @@ void *PluginInterfaceInit(const char *pluginName, const char * pluginPathName)
 							  NULL)) == NULL)
 			{
 				// Release lock
-				PyGILState_Release(state);
+				PythonInterpreter::releaseGIL(state);
 
 				Logger::getLogger()->fatal("plugin_handle: filter_plugin_init(): "
 							   "failed to create Python module "
@@ -687,7 +742,7 @@ void *PluginInterfaceInit(const char *pluginName, const char * pluginPathName)
 	}
 
 	// Release locks
-	PyGILState_Release(state);
+	PythonInterpreter::releaseGIL(state);
 
 	// Return new Python module or NULL
 	return pModule;
@@ -721,6 +776,11 @@ void *PluginInterfaceResolveSymbol(const char *_sym, const string& pName)
 					   pName.c_str());
 		return NULL;
 	}
+	else if (!sym.compare("plugin_ingest_inplace"))
+	{
+		// Python filters are always passed a new set of readings
+		return NULL;
+	}
 	else
 	{
 		Logger::getLogger()->fatal("FilterPluginInterfaceResolveSymbol can not find symbol '%s' "
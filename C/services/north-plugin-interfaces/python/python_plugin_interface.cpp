@@ -37,75 +37,96 @@ uint32_t plugin_send_fn(PLUGIN_HANDLE handle, const std::vector<Reading *>& read
 
 
 /**
- * Function to invoke async 'plugin_send' function in python plugin
+ * The Python functions used to send the readings. An async plugin_send
+ * returns a coroutine, it is run on an asyncio loop owned by the interface
+ * in a thread of its own, so that the sends of several blocks of readings
+ * overlap and the plugin keeps the same loop from one send to the next.
+ * A plugin_send that is not async returns its result directly.
+ */
+static const char *sendHelpers =
+	"import asyncio, concurrent.futures, inspect, threading\n"
+	"_north_send_loop = None\n"
+	"async def _north_send_await(awaitable):\n"
+	"    return await awaitable\n"
+	"def north_send_submit(plugin_send, handle, readings):\n"
+	"    global _north_send_loop\n"
+	"    result = plugin_send(handle, readings, \"000001\")\n"
+	"    if not inspect.isawaitable(result):\n"
+	"        return result\n"
+	"    if _north_send_loop is None:\n"
+	"        _north_send_loop = asyncio.new_event_loop()\n"
+	"        threading.Thread(target=_north_send_loop.run_forever, name=\"north_send\", daemon=True).start()\n"
+	"    return asyncio.run_coroutine_threadsafe(_north_send_await(result), _north_send_loop)\n"
+	"def north_send_result(submitted):\n"
+	"    if isinstance(submitted, concurrent.futures.Future):\n"
+	"        submitted = submitted.result()\n"
+	"    retCode, lastId, numSent = submitted\n"
+	"    return numSent\n";
+
+static PyObject *sendSubmit = NULL;
+static PyObject *sendResult = NULL;
+
+/**
+ * Define the Python functions used to send the readings, the
+ * first time they are needed. Called with the GIL held.
  *
- * @param   plugin_send_module_func Reference to plugin's plugin_send async method
- * @param   handle     Plugin handle from plugin_init_fn
- * @param   readingsList    Reading list to send
+ * @return  True if the functions are defined
  */
-unsigned int call_plugin_send_coroutine(PyObject *plugin_send_module_func, PLUGIN_HANDLE handle, PyObject *readingsList)
+static bool defineSendHelpers()
 {
-	unsigned int numSent=0;
-
-	std::string fcn = "";
-	fcn += "def plugin_send_wrapper(handle, readings, plugin_send_module_func):\n";
-	fcn += "    import asyncio\n";
-	fcn += "    loop = asyncio.new_event_loop()\n"; 
-	fcn += "    asyncio.set_event_loop(loop)\n";
-	fcn += "    coroObj = plugin_send_module_func(handle, readings, \"000001\")\n";
-	fcn += "    futures = [coroObj]\n";
-	fcn += "    done, result = loop.run_until_complete(asyncio.wait(futures))\n"; 
-	fcn += "    numSent = 0\n";
-	fcn += "    for t in done:\n";
-	fcn += "        retCode, lastId, numSent = t.result()\n";
-	fcn += "    return numSent\n";
-
-	PyRun_SimpleString(fcn.c_str());
+	if (sendSubmit && sendResult)
+	{
+		return true;
+	}
+	if (PyRun_SimpleString(sendHelpers) != 0)
+	{
+		Logger::getLogger()->error("Unable to define the functions that send the readings "
+					   "to the north plugin '%s'", gPluginName.c_str());
+		return false;
+	}
 	PyObject* mod = PyImport_ImportModule("__main__");
-	if (mod != NULL) 
+	if (mod != NULL)
+	{
+		sendSubmit = PyObject_GetAttrString(mod, "north_send_submit");
+		sendResult = PyObject_GetAttrString(mod, "north_send_result");
+		Py_CLEAR(mod);
+	}
+	if (!sendSubmit || !sendResult)
 	{
-		PyObject* method = PyObject_GetAttrString(mod, "plugin_send_wrapper");
-		if (method != NULL)
+		if (PyErr_Occurred())
 		{
-			PyObject* arg = Py_BuildValue("OOO", handle, readingsList, plugin_send_module_func);
-			PyObject* pReturn = PyObject_CallObject(method, arg);
-			Logger::getLogger()->debug("%s:%d, pReturn=%p", __FUNCTION__, __LINE__, pReturn);
-			Py_CLEAR(arg);
-		    
-			if (pReturn != NULL)
-			{
-				if(PyLong_Check(pReturn))
-				{
-					numSent = (long)PyLong_AsUnsignedLongMask(pReturn);
-					Logger::getLogger()->debug("numSent=%d", numSent);
-				}
-				else
-				{
-					Logger::getLogger()->warn("plugin_send_wrapper() didn't return a number, returned value is of type %s", (Py_TYPE(pReturn))->tp_name);
-				}	
-				Py_CLEAR(pReturn);
-			}
-			else
-			{
-				Logger::getLogger()->debug("%s:%d: pReturn is NULL", __FUNCTION__, __LINE__);
-				if (PyErr_Occurred())
-				{
-					logErrorMessage();
-				}
-			}
+			logErrorMessage();
 		}
-		Py_CLEAR(method);
+		Py_CLEAR(sendSubmit);
+		Py_CLEAR(sendResult);
+		return false;
 	}
-        
-	// Reset error
-	PyErr_Clear();
-
-	// Remove references
-	Py_CLEAR(mod);
-
-	return numSent;
+	return true;
 }
 
+/**
+ * Return the number of sends of a block of readings that a plugin
+ * allows to be in progress at once, set by the optional module variable
+ * plugin_send_concurrency. Called with the GIL held.
+ *
+ * @param   module	The Python module of the plugin
+ * @return  The number of concurrent sends, 1 if not set
+ */
+static unsigned int sendConcurrency(PyObject *module)
+{
+	unsigned int concurrency = 1;
+	PyObject *value = PyObject_GetAttrString(module, "plugin_send_concurrency");
+	if (value)
+	{
+		if (PyLong_Check(value) && PyLong_AsLong(value) > 1)
+		{
+			concurrency = (unsigned int)PyLong_AsLong(value);
+		}
+		Py_CLEAR(value);
+	}
+	PyErr_Clear();
+	return concurrency;
+}
 
 /**
  * Constructor for PythonPluginHandle
@@ -342,8 +363,7 @@ void plugin_start_fn(PLUGIN_HANDLE handle)
  *
  * @param    handle     Plugin handle from plugin_init_fn
  * @param    readings	Vector of readings data to send
- *
- * NOTE: currently doesn't work with async plugin_send
+ * @return		The number of readings sent
  */
 uint32_t plugin_send_fn(PLUGIN_HANDLE handle, const std::vector<Reading *>& readings)
 {
@@ -414,32 +434,91 @@ uint32_t plugin_send_fn(PLUGIN_HANDLE handle, const std::vector<Reading *>& read
 		return numReadingsSent;
 	}
 
-	// Create a dict of readings
-	// 1 create empty ReadingSet
-	ReadingSet set;
+	if (!defineSendHelpers())
+	{
+		Py_CLEAR(pFunc);
+		PyGILState_Release(state);
+		return numReadingsSent;
+	}
 
-	// 2 append all input readings:
-	// Note: the readings elements are pointers
-	set.append(readings);
+	// Split the readings into a block for each send in progress at once
+	size_t nReadings = readings.size();
+	size_t nBlocks = sendConcurrency(it->second->m_module);
+	if (nBlocks > nReadings)
+	{
+		nBlocks = nReadings ? nReadings : 1;
+	}
 
-	// 3 create a PythonReadingSet object
-	PythonReadingSet *pyReadingSet = (PythonReadingSet *) &set;
+	// Submit all the blocks, the Python list of a block is created
+	// whilst the blocks before it are being sent
+	vector<PyObject *> submitted;
+	vector<size_t> blockSizes;
+	for (size_t block = 0; block < nBlocks; block++)
+	{
+		vector<Reading *> blockReadings(readings.begin() + block * nReadings / nBlocks,
+						readings.begin() + (block + 1) * nReadings / nBlocks);
+		ReadingSet set;
+		// Note: the readings elements are pointers
+		set.append(blockReadings);
+		PyObject* readingsList = ((PythonReadingSet *) &set)->toPython(true);
+		// Remove all elements in the set without freeing them as the
+		// readings pointers will be freed by the caller of plugin_send_fn
+		set.clear();
+
+		PyObject *send = PyObject_CallFunction(sendSubmit, "OOO", pFunc, handle, readingsList);
+		Py_CLEAR(readingsList);
+		if (!send)
+		{
+			logErrorMessage();
+			break;
+		}
+		submitted.push_back(send);
+		blockSizes.push_back(blockReadings.size());
+	}
+
+	// Wait for all the sends, the readings sent are those up to the
+	// first block that was not sent in full. Waiting on a future
+	// releases the GIL to the asyncio loop.
+	bool complete = true;
+	for (size_t block = 0; block < submitted.size(); block++)
+	{
+		PyObject *pReturn = PyObject_CallFunction(sendResult, "O", submitted[block]);
+		Py_CLEAR(submitted[block]);
+		if (pReturn && PyLong_Check(pReturn))
+		{
+			uint32_t numSent = (uint32_t)PyLong_AsUnsignedLongMask(pReturn);
+			if (complete)
+			{
+				numReadingsSent += numSent;
+			}
+			if (numSent < blockSizes[block])
+			{
+				complete = false;
+			}
+		}
+		else
+		{
+			if (pReturn)
+			{
+				Logger::getLogger()->warn("plugin_send didn't return a number of readings sent, "
+							  "returned value is of type %s, plugin '%s'",
+							  (Py_TYPE(pReturn))->tp_name, pName.c_str());
+			}
+			else
+			{
+				logErrorMessage();
+			}
+			complete = false;
+		}
+		Py_CLEAR(pReturn);
+	}
+	PyErr_Clear();
 
-	// 4 create PyObject
-	PyObject* readingsList = pyReadingSet->toPython(true);
-	    
-	numReadingsSent = call_plugin_send_coroutine(pFunc, handle, readingsList);
-	Logger::getLogger()->debug("C2Py: plugin_send_fn():L%d: filtered readings sent %d",
+	Logger::getLogger()->debug("C2Py: plugin_send_fn():L%d: filtered readings sent %d in %d blocks",
 				__LINE__,
-				numReadingsSent);
-   
-	// Remove all elements in readings vector
-	// without freeing them as the reagings pointers
-	// will be be freed by the caller of plugin_send_fn
-	set.clear();
-
-	// Remove python object
-	Py_CLEAR(readingsList);
+				numReadingsSent,
+				(int)submitted.size());
+
 	Py_CLEAR(pFunc);
 
 	// Release GIL
@@ -0,0 +1,96 @@
+/*
+ * Fledge north service.
+ *
+ * Copyright (c) 2026 Dianomic Systems
+ *
+ * Released under the Apache 2.0 Licence
+ *
+ * Author: agent
+ */
+#include <adaptive_block_size.h>
+
+using namespace std;
+
+/**
+ * Construct the block size controller
+ *
+ * @param initial	The initial block size
+ * @param maximum	The largest block size that will be used
+ * @param latencyTarget	The target latency of a send in milliseconds
+ */
+AdaptiveBlockSize::AdaptiveBlockSize(unsigned long initial, unsigned long maximum,
+			unsigned long latencyTarget) : m_errorRate(0.0)
+{
+	configure(initial, maximum, latencyTarget);
+}
+
+/**
+ * Reconfigure the controller, the block size restarts from the
+ * initial value
+ *
+ * @param initial	The initial block size
+ * @param maximum	The largest block size that will be used
+ * @param latencyTarget	The target latency of a send in milliseconds
+ */
+void AdaptiveBlockSize::configure(unsigned long initial, unsigned long maximum,
+			unsigned long latencyTarget)
+{
+	lock_guard<mutex> guard(m_mutex);
+	if (maximum < ADAPTIVE_MIN_BLOCK_SIZE)
+		maximum = ADAPTIVE_MIN_BLOCK_SIZE;
+	if (initial < ADAPTIVE_MIN_BLOCK_SIZE)
+		initial = ADAPTIVE_MIN_BLOCK_SIZE;
+	if (initial > maximum)
+		initial = maximum;
+	m_blockSize = initial;
+	m_maximum = maximum;
+	m_latencyTarget = latencyTarget;
+}
+
+/**
+ * Return the current block size
+ *
+ * @return unsigned long	The block size
+ */
+unsigned long AdaptiveBlockSize::getBlockSize()
+{
+	lock_guard<mutex> guard(m_mutex);
+	return m_blockSize;
+}
+
+/**
+ * Report the outcome of sending a block of readings and return
+ * the block size to use for subsequent blocks
+ *
+ * @param count		The number of readings in the block
+ * @param sent		The number of readings the plugin accepted
+ * @param latency	The time taken by the send in milliseconds
+ * @return unsigned long	The new block size
+ */
+unsigned long AdaptiveBlockSize::sent(unsigned int count, unsigned int sent, unsigned long latency)
+{
+	lock_guard<mutex> guard(m_mutex);
+	bool failed = sent < count;
+
+	m_errorRate = (1.0 - ADAPTIVE_ERROR_WEIGHT) * m_errorRate
+			+ (failed ? ADAPTIVE_ERROR_WEIGHT : 0.0);
+	if (failed)
+	{
+		m_blockSize /= 2;
+	}
+	else if (latency > m_latencyTarget)
+	{
+		m_blockSize -= m_blockSize / 4;
+	}
+	else if (count >= m_blockSize && m_errorRate < ADAPTIVE_MAX_ERROR_RATE)
+	{
+		// Only grow when the block was full, a larger block
+		// makes no difference when the buffer is being drained
+		m_blockSize += ADAPTIVE_BLOCK_INCREMENT;
+	}
+	if (m_blockSize < ADAPTIVE_MIN_BLOCK_SIZE)
+		m_blockSize = ADAPTIVE_MIN_BLOCK_SIZE;
+	if (m_blockSize > m_maximum)
+		m_blockSize = m_maximum;
+	return m_blockSize;
+}
@@ -9,7 +9,9 @@
  */
 
 #include <data_load.h>
-#include <north_service.h>
+#include <thread_config.h>
+#include <tracer.h>
+#include <algorithm>
 
 using namespace std;
 
@@ -24,9 +26,19 @@ static void threadMain(void *arg)
  *
  * Create and start the loading thread
  */
-DataLoad::DataLoad(const string& name, long streamId, StorageClient *storage) : 
-	m_name(name), m_streamId(streamId), m_storage(storage), m_shutdown(false),
-	m_readRequest(0), m_dataSource(SourceReadings), m_pipeline(NULL)
+DataLoad::DataLoad(const string& name, long streamId, StorageClient *storage,
+		ManagementClient *management) :
+	m_name(name), m_streamId(streamId), m_storage(storage), m_mgtClient(management), m_shutdown(false),
+	m_readRequest(0), m_prefetching(false), m_dataSource(SourceReadings),
+	m_statisticsQuery(NULL), m_statisticsId(NULL), m_auditQuery(NULL), m_auditId(NULL), m_pipeline(NULL),
+	m_prefetchBlocks(DEFAULT_PREFETCH_BLOCKS), m_prefetchReadings(DEFAULT_PREFETCH_READINGS),
+	m_prefetchSize(DEFAULT_PREFETCH_SIZE * 1024), m_queuedBlocks(0), m_queuedReadings(0),
+	m_queuedSize(0), m_fetchStream(false), m_catchUpLag(0),
+	m_catchUpFetches(DEFAULT_CATCH_UP_FETCHES), m_catchUpBlock(DEFAULT_CATCH_UP_BLOCK),
+	m_catchingUp(false), m_priorityFetched(0), m_priorityWeight(DEFAULT_PRIORITY_WEIGHT),
+	m_priorityTaken(0), m_bufferingPriority(false), m_conflate(false),
+	m_snapshotInterval(DEFAULT_SNAPSHOT_INTERVAL), m_latestFetched(0), m_queueMetrics("north.load", "readings"),
+	m_pendingSent(0), m_sentStatsCreated(false), m_statsInFlight(0)
 {
 	m_blockSize = DEFAULT_BLOCK_SIZE;
 
@@ -36,6 +48,7 @@ DataLoad::DataLoad(const string& name, long streamId, StorageClient *storage) :
 	}
 	m_lastFetched = getLastSentId();
 	m_thread = new thread(threadMain, this);
+	ThreadConfig::getInstance()->apply(*m_thread, "north-load");
 	loadFilters(name);
 }
 
@@ -52,11 +65,24 @@ DataLoad::~DataLoad()
 	m_cv.notify_all();
 	m_fetchCV.notify_all();
 	m_thread->join();
+	sentStatisticsUpdated(true);
+	flushStatistics();
+	sentStatisticsUpdated(true);
 	if (m_pipeline)
 	{
 		m_pipeline->cleanupFilters(m_name);
 		delete m_pipeline;
 	}
+	delete m_statisticsQuery;
+	delete m_auditQuery;
+	for (auto& latest : m_latest)
+	{
+		delete latest.second;
+	}
+	for (auto readings : m_priorityQueue)
+	{
+		delete readings;
+	}
 	Logger::getLogger()->info("Data load shutdown complete");
 }
 
@@ -92,6 +118,54 @@ bool DataLoad::setDataSource(const string& source)
 	return true;
 }
 
+/**
+ * Set the amount of data to read ahead of the sending thread. The
+ * loading thread keeps reading whilst fewer than the given number of
+ * blocks are buffered and the buffered data is below both of the
+ * high water marks.
+ *
+ * @param blocks	The number of blocks to buffer
+ * @param readings	The high water mark in readings, 0 for no limit
+ * @param size		The high water mark in KB, 0 for no limit
+ */
+void DataLoad::setPrefetch(unsigned int blocks, unsigned long readings, unsigned long size)
+{
+	unique_lock<mutex> lck(m_mutex);
+	m_prefetchBlocks = blocks > 0 ? blocks : 1;
+	m_prefetchReadings = readings;
+	m_prefetchSize = size * 1024;
+	Logger::getLogger()->info("Prefetch %u blocks, up to %lu readings and %lu KB", m_prefetchBlocks, readings, size);
+	m_cv.notify_all();
+}
+
+/**
+ * Check if the loading thread should read another block to
+ * buffer ahead of the sending thread. A block is always read
+ * if nothing is buffered.
+ *
+ * @return bool	True if another block should be read
+ */
+bool DataLoad::prefetchRequired()
+{
+	if (m_queuedBlocks == 0)
+	{
+		return true;
+	}
+	if (m_queuedBlocks >= m_prefetchBlocks)
+	{
+		return false;
+	}
+	if (m_prefetchReadings && m_queuedReadings >= m_prefetchReadings)
+	{
+		return false;
+	}
+	if (m_prefetchSize && m_queuedSize >= m_prefetchSize)
+	{
+		return false;
+	}
+	return true;
+}
+
 /**
  * The background thread that loads data from the database
  */
@@ -100,23 +174,51 @@ void DataLoad::loadThread()
 	while (!m_shutdown)
 	{
 		unsigned int block = waitForReadRequest();
-		readBlock(block);
+		while (readPriority() && !m_shutdown)
+			;
+		if (block)
+		{
+			readBlock(block);
+		}
 	}
 }
 
 /**
- * Wait for a read request to be made
+ * Wait until a block should be read. Once the first read request
+ * has been made blocks are read whenever the buffer is below the
+ * prefetch limits, rather than waiting for the sending thread to
+ * ask for each block.
  *
- * @return int	The size of the block to read
+ * When there are priority assets the wait is interrupted to read them,
+ * in which case no block should be read.
+ *
+ * @return int	The size of the block to read, 0 for none
  */
 unsigned int DataLoad::waitForReadRequest()
 {
 	unique_lock<mutex> lck(m_mutex);
-	while (m_shutdown == false && m_readRequest == 0)
+	while (m_shutdown == false)
 	{
+		if (m_readRequest)
+		{
+			m_prefetching = true;
+		}
+		if (m_prefetching && prefetchRequired())
+		{
+			break;
+		}
+		if (!m_priorityFilter.assets.empty())
+		{
+			// Wake to read the priority assets whilst the bulk is not read
+			if (m_cv.wait_for(lck, chrono::milliseconds(PRIORITY_POLL_INTERVAL)) == cv_status::timeout)
+			{
+				return 0;
+			}
+			continue;
+		}
 		m_cv.wait(lck);
 	}
-	unsigned int rval =  m_readRequest;
+	unsigned int rval =  m_readRequest ? m_readRequest : m_blockSize;
 	m_readRequest = 0;
 	Logger::getLogger()->debug("DataLoad received read request for %d readings", rval);
 	return rval;
@@ -132,6 +234,317 @@ void DataLoad::triggerRead(unsigned int blockSize)
 	m_cv.notify_all();
 }
 
+/**
+ * Set the assets and datapoints the storage service selects
+ * when the readings are fetched. An empty filter fetches all
+ * the readings.
+ *
+ * @param filter	The selection of the readings
+ */
+void DataLoad::setFetchFilter(const ReadingFetchFilter& filter)
+{
+	lock_guard<mutex> guard(m_filterMutex);
+	m_fetchFilter = filter;
+}
+
+/**
+ * Set the conflation of the readings. When conflating only the latest
+ * reading of each asset is held, rather than a queue of blocks, and
+ * the sending thread is given a snapshot of the latest readings at
+ * most once every interval.
+ *
+ * @param enable	Conflate the readings
+ * @param interval	The milliseconds between snapshots
+ */
+void DataLoad::setConflate(bool enable, unsigned long interval)
+{
+	lock_guard<mutex> guard(m_qMutex);
+	m_conflate = enable;
+	m_snapshotInterval = chrono::milliseconds(interval);
+	m_fetchCV.notify_all();
+}
+
+/**
+ * Set the catch up mode. When the readings read are further behind
+ * than the lag the ranges of IDs that follow are fetched concurrently,
+ * in larger blocks, until the newest reading is reached.
+ *
+ * @param lag		The seconds behind at which catch up starts, 0 to disable
+ * @param fetches	The number of ranges fetched concurrently
+ * @param blockSize	The number of IDs in each range
+ */
+void DataLoad::setCatchUp(unsigned long lag, unsigned int fetches, unsigned long blockSize)
+{
+	m_catchUpFetches = fetches > 0 ? fetches : 1;
+	m_catchUpBlock = blockSize > 0 ? blockSize : m_blockSize;
+	m_catchUpLag = lag;
+	if (lag == 0)
+	{
+		m_catchingUp = false;
+	}
+}
+
+/**
+ * Start the catch up mode if the last of a block of readings is
+ * further behind than the catch up lag
+ *
+ * @param readings	The block of readings read
+ */
+void DataLoad::checkLag(ReadingSet *readings)
+{
+	unsigned long lag = m_catchUpLag;
+	if (lag == 0 || m_catchingUp || readings->getCount() == 0)
+	{
+		return;
+	}
+	const Reading *last = readings->getAllReadings().back();
+	unsigned long now = (unsigned long)time(NULL);
+	if (last->getUserTimestamp() + lag < now)
+	{
+		m_catchingUp = true;
+		Logger::getLogger()->info("The readings sent are %lu seconds behind, catching up with %u concurrent reads of %lu readings",
+				now - last->getUserTimestamp(), (unsigned int)m_catchUpFetches,
+				(unsigned long)m_catchUpBlock);
+	}
+}
+
+/**
+ * Read the ranges of IDs that follow the last reading fetched
+ * concurrently and buffer them in order.
+ *
+ * A range that returns a full block may include readings beyond it,
+ * if there are gaps in the IDs, these are removed as they are read by
+ * the next range. A range that returns less than a full block has
+ * reached the newest reading, the ranges after it are discarded since
+ * readings stored whilst they were read may be missing from it, and
+ * the catch up ends. The last reading fetched is always the last one
+ * buffered, the IDs are not assumed to be contiguous.
+ *
+ * @return bool	True if any readings were buffered
+ */
+bool DataLoad::catchUp()
+{
+	TRACE_SPAN("north", "DataLoad::catchUp");
+	unsigned int fetches = m_catchUpFetches;
+	unsigned long block = m_catchUpBlock;
+	unsigned long first = m_lastFetched + 1;
+	vector<ReadingSet *> ranges(fetches, NULL);
+	vector<future<ReadingSet *> > pending;
+
+	for (unsigned int i = 0; i < fetches; i++)
+	{
+		pending.push_back(m_storage->readingFetchAsync(first + i * block, block));
+	}
+	for (unsigned int i = 0; i < fetches; i++)
+	{
+		try {
+			ranges[i] = pending[i].get();
+		} catch (ReadingSetException* e) {
+			// Ignore, the exception has been reported in the layer below
+		} catch (exception& e) {
+			// Ignore, the exception has been reported in the layer below
+		}
+	}
+
+	bool buffered = false;
+	bool newest = false;
+	for (unsigned int i = 0; i < fetches; i++)
+	{
+		ReadingSet *readings = ranges[i];
+		if (newest || !readings)
+		{
+			delete readings;
+			newest = true;
+			continue;
+		}
+		if (readings->getCount() < block)
+		{
+			newest = true;
+			m_catchingUp = false;
+			Logger::getLogger()->info("The readings sent have caught up");
+		}
+		else if (i + 1 < fetches && readings->getLastId() >= first + (i + 1) * block)
+		{
+			// Leave the readings of the next range to it
+			unsigned long next = first + (i + 1) * block;
+			vector<Reading *> *all = readings->getAllReadingsPtr();
+			vector<Reading *> range;
+			for (auto reading : *all)
+			{
+				if (reading->getId() < next)
+					range.push_back(reading);
+				else
+					delete reading;
+			}
+			readings->clear();
+			delete readings;
+			readings = new ReadingSet(&range);
+		}
+		if (readings->getCount())
+		{
+			m_lastFetched = readings->getLastId();
+			bufferReadings(readings);
+			buffered = true;
+		}
+		else
+		{
+			delete readings;
+		}
+	}
+	return buffered;
+}
+
+/**
+ * Set the assets that are read and sent ahead of the other assets.
+ *
+ * The priority assets are read by a separate scan of the readings
+ * from the last reading read and are queued separately, the sending
+ * thread takes up to weight priority blocks for each bulk block. The
+ * bulk read of the readings still includes the priority assets, as it
+ * determines how far the stream has been sent, but the readings of the
+ * priority assets already read by the priority scan are removed from it.
+ *
+ * The fetch filter must be set before the priority assets.
+ *
+ * @param assets	The priority assets, none to disable the priority queue
+ * @param weight	The priority blocks sent for each bulk block
+ */
+void DataLoad::setPriorityAssets(const vector<string>& assets, unsigned int weight)
+{
+	lock_guard<mutex> guard(m_filterMutex);
+	m_priorityAssets.clear();
+	m_priorityFilter = ReadingFetchFilter();
+	m_priorityFilter.datapoints = m_fetchFilter.datapoints;
+	set<string> selected(m_fetchFilter.assets.begin(), m_fetchFilter.assets.end());
+	for (auto& asset : assets)
+	{
+		// Only the assets the fetch filter selects can be sent
+		bool listed = selected.count(asset) > 0;
+		if (m_fetchFilter.assets.empty() || listed != m_fetchFilter.exclude)
+		{
+			m_priorityAssets.insert(asset);
+			m_priorityFilter.assets.push_back(asset);
+		}
+	}
+	m_priorityWeight = weight > 0 ? weight : 1;
+	// The new assets are read from the last reading of the bulk read
+	m_priorityFetched = 0;
+}
+
+/**
+ * Read the next readings of the priority assets, from no earlier than
+ * the last reading of the bulk read, and queue them for the sending
+ * thread. The filter pipeline is used as for the bulk readings.
+ *
+ * @return bool	True if there may be more readings to read at once
+ */
+bool DataLoad::readPriority()
+{
+	ReadingFetchFilter filter;
+	{
+		lock_guard<mutex> guard(m_filterMutex);
+		filter = m_priorityFilter;
+	}
+	if (filter.assets.empty() || m_dataSource != SourceReadings || m_conflate)
+	{
+		return false;
+	}
+	{
+		lock_guard<mutex> guard(m_qMutex);
+		if (m_priorityQueue.size() >= m_prefetchBlocks)
+		{
+			return false;
+		}
+	}
+	unsigned long first;
+	{
+		lock_guard<mutex> guard(m_filterMutex);
+		if (m_priorityFetched < m_lastFetched)
+		{
+			m_priorityFetched = m_lastFetched;
+		}
+		first = m_priorityFetched + 1;
+	}
+	unsigned long next = 0;
+	ReadingSet *readings = NULL;
+	try
+	{
+		readings = m_storage->readingFetch(first, PRIORITY_SCAN_SIZE, filter, next);
+	}
+	catch (ReadingSetException* e)
+	{
+		// Ignore, the exception has been reported in the layer below
+	}
+	catch (exception& e)
+	{
+		// Ignore, the exception has been reported in the layer below
+	}
+	if (!readings)
+	{
+		return false;
+	}
+	{
+		lock_guard<mutex> guard(m_filterMutex);
+		if (m_priorityFilter.assets != filter.assets)
+		{
+			// The priority assets changed whilst they were read
+			delete readings;
+			return true;
+		}
+		if (readings->getCount())
+		{
+			m_priorityFetched = readings->getLastId();
+		}
+		if (next > m_priorityFetched + 1)
+		{
+			m_priorityFetched = next - 1;
+		}
+	}
+	if (readings->getCount() == 0)
+	{
+		delete readings;
+		return next >= first + PRIORITY_SCAN_SIZE;
+	}
+	m_bufferingPriority = true;
+	bufferReadings(readings);
+	m_bufferingPriority = false;
+	return true;
+}
+
+/**
+ * Remove the readings of the priority assets that have already been
+ * read by the priority scan from a block of the bulk readings
+ *
+ * @param readings	The block of bulk readings
+ * @return ReadingSet*	The block without the readings already read
+ */
+ReadingSet *DataLoad::removePriority(ReadingSet *readings)
+{
+	lock_guard<mutex> guard(m_filterMutex);
+	if (m_priorityAssets.empty())
+	{
+		return readings;
+	}
+	vector<Reading *> *all = readings->getAllReadingsPtr();
+	vector<Reading *> kept;
+	kept.reserve(all->size());
+	for (auto reading : *all)
+	{
+		if (reading->getId() <= m_priorityFetched
+				&& m_priorityAssets.count(reading->getAssetName()))
+			delete reading;
+		else
+			kept.push_back(reading);
+	}
+	if (kept.size() == all->size())
+	{
+		return readings;
+	}
+	readings->clear();
+	delete readings;
+	return new ReadingSet(&kept);
+}
+
 /**
  * Read a block of readings from the storage service
  *
@@ -139,17 +552,33 @@ void DataLoad::triggerRead(unsigned int blockSize)
  */
 void DataLoad::readBlock(unsigned int blockSize)
 {
+	TRACE_SPAN("north", "DataLoad::readBlock");
 ReadingSet *readings = NULL;
+ReadingFetchFilter filter;
 
+	{
+		lock_guard<mutex> guard(m_filterMutex);
+		filter = m_fetchFilter;
+	}
+	if (m_catchingUp && m_dataSource == SourceReadings && filter.isEmpty() && catchUp())
+	{
+		return;
+	}
 	do
 	{
+		unsigned long next = 0;
 		try
 		{
 			switch (m_dataSource)
 			{
 				case SourceReadings:
 					// Logger::getLogger()->debug("Fetch %d readings from %d", blockSize, m_lastFetched + 1);
-					readings = m_storage->readingFetch(m_lastFetched + 1, blockSize);
+					if (!filter.isEmpty())
+						readings = m_storage->readingFetch(m_lastFetched + 1, blockSize, filter, next);
+					else if (m_fetchStream)
+						readings = m_storage->readingFetchStream(m_lastFetched + 1, blockSize);
+					else
+						readings = m_storage->readingFetch(m_lastFetched + 1, blockSize);
 					break;
 				case SourceStatistics:
 					readings = fetchStatistics(blockSize);
@@ -175,13 +604,38 @@ ReadingSet *readings = NULL;
 		{
             Logger::getLogger()->debug("DataLoad::readBlock(): Got %d readings from storage client", readings->getCount());
 			m_lastFetched = readings->getLastId();
+			if (m_dataSource == SourceReadings && filter.isEmpty())
+			{
+				checkLag(readings);
+			}
+			if (next > m_lastFetched + 1)
+			{
+				// The readings after the last one returned were not selected
+				m_lastFetched = next - 1;
+			}
 			bufferReadings(readings);
 			return;
 		}
+		else if (next > m_lastFetched + 1)
+		{
+			// None of the readings read were selected, queue an empty
+			// block so that the sender moves past them
+			m_lastFetched = next - 1;
+			delete readings;
+			queueReadings(new ReadingSet());
+			return;
+		}
 		else
 		{
 			// Logger::getLogger()->debug("DataLoad::readBlock(): No readings available");
 		}
+		if (m_dataSource == SourceReadings && m_fetchStream && m_storage->isFetchStreaming())
+		{
+			// The fetch stream has already waited for new readings
+			continue;
+		}
+		while (readPriority() && !m_shutdown)
+			;
 		if (!m_shutdown)
 		{	
 			// TODO improve this
@@ -191,71 +645,87 @@ ReadingSet *readings = NULL;
 }
 
 /**
- * Fetch data from the statistics history table
+ * Fetch data from the statistics history table. The query is built
+ * once, only its id condition and limit change between blocks.
  *
  * @param blockSize	Number of records to fetch
  * @return ReadingSet*	A set of readings
  */
 ReadingSet *DataLoad::fetchStatistics(unsigned int blockSize)
 {
-	const Condition conditionId(GreaterThan);
-	// WHERE id > lastId
-	Where* wId = new Where("id", conditionId, to_string(m_lastFetched + 1));
-	vector<Returns *> columns;
-	// Add colums and needed aliases
-	columns.push_back(new Returns("id"));
-	columns.push_back(new Returns("key", "asset_code"));
-	columns.push_back(new Returns("ts"));
-
-	Returns *tmpReturn = new Returns("history_ts", "user_ts");
-	tmpReturn->timezone("utc");
-	columns.push_back(tmpReturn);
-
-	columns.push_back(new Returns("value"));
-	// Build the query with fields, aliases and where
-	Query qStatistics(columns, wId);
+	if (!m_statisticsQuery)
+	{
+		const Condition conditionId(GreaterThan);
+		// WHERE id > lastId
+		m_statisticsId = new Where("id", conditionId, to_string(m_lastFetched + 1));
+		vector<Returns *> columns;
+		// Add colums and needed aliases
+		columns.push_back(new Returns("id"));
+		columns.push_back(new Returns("key", "asset_code"));
+		columns.push_back(new Returns("ts"));
+
+		Returns *tmpReturn = new Returns("history_ts", "user_ts");
+		tmpReturn->timezone("utc");
+		columns.push_back(tmpReturn);
+
+		columns.push_back(new Returns("value"));
+		// Build the query with fields, aliases and where
+		m_statisticsQuery = new Query(columns, m_statisticsId);
+		// Set sort
+		Sort* sort = new Sort("id");
+		m_statisticsQuery->sort(sort);
+	}
+	else
+	{
+		m_statisticsId->value(to_string(m_lastFetched + 1));
+	}
 	// Set limit
-	qStatistics.limit(blockSize);
-	// Set sort
-	Sort* sort = new Sort("id");
-	qStatistics.sort(sort);
+	m_statisticsQuery->limit(blockSize);
 
 	// Query the statistics_history table and get a ReadingSet result
-	return m_storage->queryTableToReadings("statistics_history", qStatistics);
+	return m_storage->queryTableToReadings("statistics_history", *m_statisticsQuery);
 }
 
 /**
- * Fetch data from the audit log table
+ * Fetch data from the audit log table. The query is built once, only
+ * its id condition and limit change between blocks.
  *
  * @param blockSize	Number of records to fetch
  * @return ReadingSet*	A set of readings
  */
 ReadingSet *DataLoad::fetchAudit(unsigned int blockSize)
 {
-	const Condition conditionId(GreaterThan);
-	// WHERE id > lastId
-	Where* wId = new Where("id", conditionId, to_string(m_lastFetched + 1));
-	vector<Returns *> columns;
-	// Add colums and needed aliases
-	columns.push_back(new Returns("id"));
-	columns.push_back(new Returns("code", "asset_code"));
-	columns.push_back(new Returns("ts"));
-
-	Returns *tmpReturn = new Returns("ts", "user_ts");
-	tmpReturn->timezone("utc");
-	columns.push_back(tmpReturn);
-
-	columns.push_back(new Returns("log"));
-	// Build the query with fields, aliases and where
-	Query qStatistics(columns, wId);
+	if (!m_auditQuery)
+	{
+		const Condition conditionId(GreaterThan);
+		// WHERE id > lastId
+		m_auditId = new Where("id", conditionId, to_string(m_lastFetched + 1));
+		vector<Returns *> columns;
+		// Add colums and needed aliases
+		columns.push_back(new Returns("id"));
+		columns.push_back(new Returns("code", "asset_code"));
+		columns.push_back(new Returns("ts"));
+
+		Returns *tmpReturn = new Returns("ts", "user_ts");
+		tmpReturn->timezone("utc");
+		columns.push_back(tmpReturn);
+
+		columns.push_back(new Returns("log"));
+		// Build the query with fields, aliases and where
+		m_auditQuery = new Query(columns, m_auditId);
+		// Set sort
+		Sort* sort = new Sort("id");
+		m_auditQuery->sort(sort);
+	}
+	else
+	{
+		m_auditId->value(to_string(m_lastFetched + 1));
+	}
 	// Set limit
-	qStatistics.limit(blockSize);
-	// Set sort
-	Sort* sort = new Sort("id");
-	qStatistics.sort(sort);
+	m_auditQuery->limit(blockSize);
 
 	// Query the statistics_history table and get a ReadingSet result
-	return m_storage->queryTableToReadings("statistics_history", qStatistics);
+	return m_storage->queryTableToReadings("statistics_history", *m_auditQuery);
 }
 
 /**
@@ -301,6 +771,10 @@ unsigned long DataLoad::getLastSentId()
  */
 void DataLoad::bufferReadings(ReadingSet *readings)
 {
+	if (!m_bufferingPriority)
+	{
+		readings = removePriority(readings);
+	}
 	if (m_pipeline)
 	{
 		FilterPlugin *firstFilter = m_pipeline->getFirstFilterPlugin();
@@ -319,26 +793,181 @@ void DataLoad::bufferReadings(ReadingSet *readings)
 			return;
 		}
 	}
+	queueReadings(readings);
+	Logger::getLogger()->debug("Buffered %d readings for north processing", readings->getCount());
+}
+
+/**
+ * Add a block of readings to the queue for the sending thread
+ *
+ * @param readings	The readings to queue
+ */
+void DataLoad::queueReadings(ReadingSet *readings)
+{
+	if (m_conflate)
+	{
+		conflateReadings(readings);
+		return;
+	}
+	if (m_bufferingPriority)
+	{
+		unique_lock<mutex> lck(m_qMutex);
+		m_priorityQueue.push_back(readings);
+		m_queueMetrics.enqueue(readings->getCount());
+		m_fetchCV.notify_all();
+		return;
+	}
+	size_t size = estimateSize(readings);
+
 	unique_lock<mutex> lck(m_qMutex);
 	m_queue.push_back(readings);
-	Logger::getLogger()->debug("Buffered %d readings for north processing", readings->getCount());
+	m_queueMetrics.enqueue(readings->getCount());
+	QueuedBlock info;
+	info.size = size;
+	info.lastFetched = m_lastFetched;
+	m_queueInfo.push_back(info);
+	m_queuedBlocks++;
+	m_queuedReadings += readings->getCount();
+	m_queuedSize += size;
 	m_fetchCV.notify_all();
 }
 
+/**
+ * Merge a block of readings into the latest reading of each asset.
+ * A newer reading replaces the values of the datapoints it has, the
+ * other datapoints of the asset keep their latest values.
+ *
+ * @param readings	The readings to merge, the set is deleted
+ */
+void DataLoad::conflateReadings(ReadingSet *readings)
+{
+	vector<Reading *> *all = readings->getAllReadingsPtr();
+
+	unique_lock<mutex> lck(m_qMutex);
+	for (auto reading : *all)
+	{
+		auto res = m_latest.emplace(reading->getAssetName(), reading);
+		if (res.second)
+		{
+			m_queueMetrics.enqueue(1);
+			continue;
+		}
+		Reading *older = res.first->second;
+		vector<string> names;
+		for (auto dp : older->getReadingData())
+		{
+			if (!reading->getDatapoint(dp->getName()))
+			{
+				names.push_back(dp->getName());
+			}
+		}
+		for (auto& name : names)
+		{
+			reading->addDatapoint(older->removeDatapoint(name));
+		}
+		res.first->second = reading;
+		delete older;
+	}
+	m_latestFetched = m_lastFetched;
+	readings->clear();
+	m_fetchCV.notify_all();
+	lck.unlock();
+	delete readings;
+}
+
+/**
+ * Estimate the memory used by a set of readings. The estimate
+ * is only used to limit the amount of data read ahead of the
+ * sending thread.
+ *
+ * @param readings	The readings
+ * @return size_t	The approximate size in bytes
+ */
+size_t DataLoad::estimateSize(ReadingSet *readings)
+{
+	size_t size = 0;
+	const vector<Reading *>& all = readings->getAllReadings();
+	for (auto reading : all)
+	{
+		size += sizeof(Reading) + reading->getAssetName().length();
+		vector<Datapoint *>& datapoints = reading->getReadingData();
+		for (auto dp : datapoints)
+		{
+			size += sizeof(Datapoint) + dp->getName().length();
+			const DatapointValue& value = dp->getData();
+			switch (value.getType())
+			{
+				case DatapointValue::T_STRING:
+					size += value.getStringLength();
+					break;
+				case DatapointValue::T_FLOAT_ARRAY:
+					size += value.getDpArr()->size() * sizeof(double);
+					break;
+				case DatapointValue::T_DP_DICT:
+				case DatapointValue::T_DP_LIST:
+					size += value.getDpVec()->size() * sizeof(Datapoint);
+					break;
+				case DatapointValue::T_IMAGE:
+				{
+					const DPImage *image = value.getImage();
+					size += ((size_t)image->getWidth() * (size_t)image->getHeight() * (size_t)image->getDepth()) / 8;
+					break;
+				}
+				case DatapointValue::T_DATABUFFER:
+				{
+					const DataBuffer *buffer = value.getDataBuffer();
+					size += buffer->getItemSize() * buffer->getItemCount();
+					break;
+				}
+				default:
+					break;
+			}
+		}
+	}
+	return size;
+}
+
 /**
  * Fetch Readings
  *
  * @param wait		Boolean to determine if the call should block the calling thread
+ * @param lastFetched	If not NULL set to the ID of the last reading fetched from
+ *			storage for the block, this includes any readings removed by
+ *			the filters
+ * @param priority	If not NULL set to true if the block is of the priority
+ *			assets, such blocks do not advance the stream
  * @return ReadingSet*	Return a block of readings from the buffer
  */
-ReadingSet *DataLoad::fetchReadings(bool wait)
+ReadingSet *DataLoad::fetchReadings(bool wait, unsigned long *lastFetched, bool *priority)
 {
 	unique_lock<mutex> lck(m_qMutex);
-	while (m_queue.empty())
+	if (priority)
+	{
+		*priority = false;
+	}
+	if (m_queue.empty() && (m_conflate || !m_latest.empty()))
+	{
+		ReadingSet *snapshot = fetchSnapshot(lck, wait, lastFetched);
+		if (snapshot)
+		{
+			return snapshot;
+		}
+	}
+	bool flushed = false;
+	while (m_queue.empty() && m_priorityQueue.empty())
 	{
 		triggerRead(m_blockSize);
 		if (wait && !m_shutdown)
 		{
+			if (m_pendingSent && !flushed)
+			{
+				// Bring the statistics up to date before the sender goes idle
+				lck.unlock();
+				flushStatistics();
+				lck.lock();
+				flushed = true;
+				continue;
+			}
 			m_fetchCV.wait(lck);
 		}
 		else
@@ -346,12 +975,103 @@ ReadingSet *DataLoad::fetchReadings(bool wait)
 			return NULL;
 		}
 	}
+	if (!m_priorityQueue.empty() && (m_queue.empty() || m_priorityTaken < m_priorityWeight))
+	{
+		ReadingSet *rval = m_priorityQueue.front();
+		m_priorityQueue.pop_front();
+		m_priorityTaken++;
+		m_queueMetrics.dequeue(rval->getCount());
+		if (priority)
+		{
+			*priority = true;
+		}
+		if (lastFetched)
+		{
+			*lastFetched = 0;
+		}
+		return rval;
+	}
+	m_priorityTaken = 0;
 	ReadingSet *rval = m_queue.front();
 	m_queue.pop_front();
+	m_queuedBlocks--;
+	m_queuedReadings -= rval->getCount();
+	m_queueMetrics.dequeue(rval->getCount());
+	m_queuedSize -= m_queueInfo.front().size;
+	if (lastFetched)
+	{
+		*lastFetched = m_queueInfo.front().lastFetched;
+	}
+	m_queueInfo.pop_front();
 	triggerRead(m_blockSize);
 	return rval;
 }
 
+/**
+ * Return a snapshot of the latest reading of each asset. Whilst
+ * conflating a snapshot is returned at most once every snapshot
+ * interval, the readings conflated after conflation was disabled
+ * are returned at once.
+ *
+ * @param lck		The lock on the queue mutex
+ * @param wait		Wait for the next snapshot
+ * @param lastFetched	If not NULL set to the ID of the last reading
+ *			fetched from storage for the snapshot
+ * @return ReadingSet*	The snapshot or NULL if there is none, or
+ *			conflation was disabled whilst waiting
+ */
+ReadingSet *DataLoad::fetchSnapshot(unique_lock<mutex>& lck, bool wait, unsigned long *lastFetched)
+{
+	while (!m_shutdown)
+	{
+		if (!m_latest.empty() && (!m_conflate
+				|| chrono::steady_clock::now() >= m_nextSnapshot))
+		{
+			break;
+		}
+		if (!wait)
+		{
+			return NULL;
+		}
+		if (m_latest.empty())
+		{
+			if (!m_conflate)
+			{
+				// Conflation was disabled whilst waiting
+				return NULL;
+			}
+			triggerRead(m_blockSize);
+			m_fetchCV.wait(lck);
+		}
+		else
+		{
+			m_fetchCV.wait_until(lck, m_nextSnapshot);
+		}
+	}
+	if (m_latest.empty())
+	{
+		return NULL;
+	}
+	vector<Reading *> readings;
+	readings.reserve(m_latest.size());
+	for (auto& latest : m_latest)
+	{
+		readings.push_back(latest.second);
+	}
+	m_latest.clear();
+	// Send the snapshot in the order the readings were stored
+	sort(readings.begin(), readings.end(), [](Reading *a, Reading *b) {
+			return a->getId() < b->getId();
+		});
+	m_queueMetrics.dequeue(readings.size());
+	m_nextSnapshot = chrono::steady_clock::now() + m_snapshotInterval;
+	if (lastFetched)
+	{
+		*lastFetched = m_latestFetched;
+	}
+	return new ReadingSet(&readings);
+}
+
 /**
  * Creates a new stream, it adds a new row into the streams table allocating a new stream id
  *
@@ -394,7 +1114,7 @@ InsertValues streamValues;
 		delete rows;
 	}
 
-	NorthService::getMgmtClient()->setCategoryItemValue(m_name, "streamId", to_string(streamId));
+	m_mgtClient->setCategoryItemValue(m_name, "streamId", to_string(streamId));
 	return streamId;
 }
 
@@ -434,9 +1154,8 @@ bool DataLoad::loadFilters(const string& categoryName)
 	 * in the case of this routine being called when the mutex is not held and ensure m_filterPipeline
 	 * only ever points to a fully configured filter pipeline.
 	 */
-	ManagementClient *management = NorthService::getMgmtClient();
 	lock_guard<mutex> guard(m_pipelineMutex);
-	FilterPipeline *filterPipeline = new FilterPipeline(management, *m_storage, m_name);
+	FilterPipeline *filterPipeline = new FilterPipeline(m_mgtClient, *m_storage, m_name);
 	
 	// Try to load filters:
 	if (!filterPipeline->loadFilters(categoryName))
@@ -504,26 +1223,144 @@ void DataLoad::pipelineEnd(OUTPUT_HANDLE *outHandle,
 			     READINGSET *readingSet)
 {
 
+	// Blocks that have been entirely filtered out are still queued,
+	// the sending thread acknowledges them in order with the others
 	DataLoad *load = (DataLoad *)outHandle;
-	if (readingSet->getCount() == 0)	// Special case when all filtered out
+	load->queueReadings(readingSet);
+}
+
+/**
+ * Update the sent statistics. The counts are accumulated and the
+ * statistics table is updated at most once every SENT_STATS_INTERVAL
+ *
+ * @param increment	Increment of the number of readings sent
+ */
+void DataLoad::updateStatistics(uint32_t increment)
+{
+	{
+		lock_guard<mutex> guard(m_statsMutex);
+		m_pendingSent += increment;
+		if (chrono::steady_clock::now() - m_lastStatsFlush < chrono::milliseconds(SENT_STATS_INTERVAL))
+		{
+			return;
+		}
+	}
+	flushStatistics();
+}
+
+/**
+ * Write the accumulated sent counts to the statistics table.
+ *
+ * Both statistics are incremented with a single update request once
+ * their rows are known to exist, nothing is sent if no readings have
+ * been sent since the last update. The update is made asynchronously so
+ * that the sending thread does not wait for the storage service, only
+ * one update is in flight at a time and the counts build up until it
+ * completes.
+ */
+void DataLoad::flushStatistics()
+{
+	if (!sentStatisticsUpdated(false))
+	{
+		return;
+	}
+
+	uint32_t sent;
+	{
+		lock_guard<mutex> guard(m_statsMutex);
+		sent = m_pendingSent;
+		m_pendingSent = 0;
+		m_lastStatsFlush = chrono::steady_clock::now();
+	}
+	if (sent == 0)
 	{
-		load->updateLastSentId(load->m_lastFetched);
+		return;
 	}
 
-	unique_lock<mutex> lck(load->m_qMutex);
-	load->m_queue.push_back(readingSet);
-	load->m_fetchCV.notify_all();
+	if (!m_sentStatsCreated)
+	{
+		// Adds the rows that are not in the statistics table yet
+		updateStatistic(m_name, m_name + " Readings Sent", sent);
+		updateStatistic("Readings Sent", "Readings Sent North", sent);
+		m_sentStatsCreated = true;
+		return;
+	}
+
+	const Condition conditionStat(Equals);
+	vector<pair<ExpressionValues *, Where *>> statsUpdates;
+	const string keys[] = { m_name, "Readings Sent" };
+	for (auto& key : keys)
+	{
+		ExpressionValues *updateValue = new ExpressionValues;
+		updateValue->push_back(Expression("value", "+", (int)sent));
+		statsUpdates.emplace_back(updateValue, new Where("key", conditionStat, key));
+	}
+
+	// The storage client takes ownership of the updates
+	m_statsUpdate = m_storage->updateTableAsync("statistics", statsUpdates);
+	m_statsInFlight = sent;
 }
 
 /**
- * Update the sent statistics
+ * Collect the result of the update of the sent statistics in flight.
+ * If the update failed its count is returned for the next update.
  *
- * @param increment	Increment of the number of readings sent
+ * @param wait	Wait for the update in flight to complete
+ * @return bool	False if an update is still in flight
  */
-void DataLoad::updateStatistics(uint32_t increment)
+bool DataLoad::sentStatisticsUpdated(bool wait)
+{
+	if (!m_statsUpdate.valid())
+	{
+		return true;
+	}
+	if (!wait && m_statsUpdate.wait_for(chrono::seconds(0)) != future_status::ready)
+	{
+		return false;
+	}
+
+	bool updated = false;
+	try {
+		updated = m_statsUpdate.get() >= 0;
+	} catch (...) {
+	}
+	if (!updated)
+	{
+		// Return the count for the next update, which checks the rows exist
+		Logger::getLogger()->info("Update of the sent statistics failed, will retry on the next update");
+		lock_guard<mutex> guard(m_statsMutex);
+		m_pendingSent += m_statsInFlight;
+		m_sentStatsCreated = false;
+	}
+	m_statsInFlight = 0;
+	return true;
+}
+
+/**
+ * Report the block size in use in the statistics of the service
+ *
+ * @param blockSize	The current block size
+ */
+void DataLoad::reportBlockSize(unsigned long blockSize)
 {
-	updateStatistic(m_name, m_name + " Readings Sent", increment);
-	updateStatistic("Readings Sent", "Readings Sent North", increment);
+	string key = m_name + " Block Size";
+	const Condition conditionStat(Equals);
+	Where wStat("key", conditionStat, key);
+
+	// Perform UPDATE fledge.statistics SET value = x WHERE key = 'name Block Size'
+	InsertValues value;
+	value.push_back(InsertValue("value", (long)blockSize));
+	if (m_storage->updateTable("statistics", value, wStat) == -1)
+	{
+		InsertValues values;
+		values.push_back(InsertValue("key",         key));
+		values.push_back(InsertValue("description", m_name + " Block Size"));
+		values.push_back(InsertValue("value",       (long)blockSize));
+		if (m_storage->insertTable("statistics", values) != 1)
+		{
+			Logger::getLogger()->error("Failed to insert the block size statistic for %s", m_name.c_str());
+		}
+	}
 }
 
 /**
@@ -11,6 +11,11 @@
 #include <data_load.h>
 #include <north_service.h>
 #include <reading.h>
+#include <thread_config.h>
+#include <tracer.h>
+#include <alloc_profiler.h>
+#include <utils.h>
+#include <algorithm>
 
 using namespace std;
 
@@ -27,17 +32,39 @@ static void startSenderThread(void *data)
 
 /**
  * Constructor for the data sending class
+ *
+ * @param plugin	The north plugin
+ * @param loader	The data loader that supplies the blocks of readings
+ * @param service	The north service
+ * @param threads	The number of sending threads to run
  */
-DataSender::DataSender(NorthPlugin *plugin, DataLoad *loader, NorthService *service) :
-	m_plugin(plugin), m_loader(loader), m_service(service), m_shutdown(false), m_paused(false)
+DataSender::DataSender(NorthPlugin *plugin, DataLoad *loader, NorthService *service, unsigned int threads) :
+	m_plugin(plugin), m_loader(loader), m_service(service), m_shutdown(false), m_paused(false),
+	m_sending(0), m_nextSequence(0), m_lastAcknowledged(0),
+	m_blockSize(DEFAULT_BLOCK_SIZE, DEFAULT_MAX_BLOCK_SIZE, DEFAULT_SEND_LATENCY_TARGET),
+	m_adaptive(false),
+	m_spool(getDataDir() + "/retry/" + service->getName())
 {
 	m_logger = Logger::getLogger();
 
+	if (threads < 1)
+		threads = 1;
+	if (threads > MAX_SEND_THREADS)
+		threads = MAX_SEND_THREADS;
+	if (threads > 1)
+	{
+		m_logger->info("Starting %u concurrent sending threads", threads);
+	}
+
 	/*
-	 * Fianlly start the thread. Everything mus tbe initialsied
-	 * before the thread is started
+	 * Fianlly start the threads. Everything mus tbe initialsied
+	 * before the threads are started
 	 */
-	m_thread = new thread(startSenderThread, this);
+	for (unsigned int i = 0; i < threads; i++)
+	{
+		m_threads.push_back(new thread(startSenderThread, this));
+		ThreadConfig::getInstance()->apply(*m_threads.back(), "north-send");
+	}
 }
 
 /**
@@ -47,8 +74,11 @@ DataSender::~DataSender()
 {
 	m_logger->info("DataSender shutdown in progress");
 	m_shutdown = true;
-	m_thread->join();
-	delete m_thread;
+	for (auto thread : m_threads)
+	{
+		thread->join();
+		delete thread;
+	}
 	m_logger->info("DataSender shutdown complete");
 }
 
@@ -58,12 +88,22 @@ DataSender::~DataSender()
 void DataSender::sendThread()
 {
 	ReadingSet *readings = nullptr;
+	unsigned long sequence = 0, lastFetched = 0;
+	uint64_t spooled = 0;		// Sequence number of the block in the retry spool
+	bool priority = false, spoolTried = false;
 
 	while (!m_shutdown)
 	{
 		if (readings == NULL) {
 
-			readings = m_loader->fetchReadings(true);
+			// The blocks in the retry spool are sent ahead of new blocks
+			readings = m_spool.take(spooled);
+			if (!readings)
+			{
+				spooled = 0;
+				readings = fetchBlock(sequence, lastFetched, priority);
+			}
+			spoolTried = false;
 		}
 		if (!readings)
 		{
@@ -77,23 +117,48 @@ void DataSender::sendThread()
 			unsigned long lastSent = send(readings);
 			if (lastSent)
 			{
-				m_loader->updateLastSentId(lastSent);
-
 				// Check all readings sent
 				vector<Reading *> *vec = readings->getAllReadingsPtr();
 
 				// Set readings removal
 				removeReadings = vec->size() == 0;
+
+				// Once the whole block is sent any readings the
+				// filters removed from it are also acknowledged
+				if (removeReadings && lastFetched > lastSent)
+				{
+					lastSent = lastFetched;
+				}
+				if (spooled)
+				{
+					if (removeReadings)
+						m_spool.remove(spooled);
+					else
+						m_spool.update(spooled, readings);
+				}
+				else if (!priority)
+				{
+					acknowledge(sequence, lastSent, removeReadings);
+				}
+			}
+			if (!removeReadings && !spooled && !priority && !spoolTried)
+			{
+				spoolTried = true;
+				spool(readings, sequence, lastFetched, spooled);
 			}
 		} else {
 			// All readings filtered out
 			Logger::getLogger()->debug("All readings filtered out");
 
-			// Get last read item from the readings database
-			unsigned long lastRead = m_loader->getLastFetched();
-
-			// Update LastSentId in streams table
-			m_loader->updateLastSentId(lastRead);
+			// Acknowledge the last reading read for the block
+			if (spooled)
+			{
+				m_spool.remove(spooled);
+			}
+			else if (!priority)
+			{
+				acknowledge(sequence, lastFetched, true);
+			}
 
 			// Set readings removal
 			removeReadings = true;
@@ -109,6 +174,104 @@ void DataSender::sendThread()
 	m_logger->info("Sending thread shutdown");
 }
 
+/**
+ * Fetch the next block of readings to send and assign it the
+ * next sequence number. Fetches are serialised so that the
+ * sequence numbers follow the order in which the blocks were
+ * read from storage.
+ *
+ * @param sequence	Set to the sequence number of the block
+ * @param lastFetched	Set to the ID of the last reading read for the block
+ * @param priority	Set to true if the block is of the priority assets, these
+ *			blocks are not given a sequence number as the stream is
+ *			only advanced by the bulk blocks
+ * @return ReadingSet*	The block of readings or NULL on shutdown
+ */
+ReadingSet *DataSender::fetchBlock(unsigned long& sequence, unsigned long& lastFetched, bool& priority)
+{
+	lock_guard<mutex> guard(m_fetchMutex);
+	ReadingSet *readings = m_loader->fetchReadings(true, &lastFetched, &priority);
+	if (readings && !priority)
+	{
+		lock_guard<mutex> ackGuard(m_ackMutex);
+		sequence = m_nextSequence++;
+		BlockAcknowledgement ack;
+		ack.id = 0;
+		ack.complete = false;
+		m_inFlight[sequence] = ack;
+	}
+	return readings;
+}
+
+/**
+ * Acknowledge that some or all of a block of readings has been
+ * sent. Blocks may be acknowledged in any order, the last sent ID
+ * of the stream is only moved up to the last reading sent from the
+ * oldest block still being sent, so that no reading is skipped if
+ * the service is restarted whilst blocks are in flight.
+ *
+ * @param sequence	The sequence number of the block
+ * @param id		The ID of the last reading sent from the block
+ * @param complete	All of the readings in the block have been sent
+ */
+void DataSender::acknowledge(unsigned long sequence, unsigned long id, bool complete)
+{
+	lock_guard<mutex> guard(m_ackMutex);
+	auto it = m_inFlight.find(sequence);
+	if (it == m_inFlight.end())
+	{
+		return;
+	}
+	it->second.id = id;
+	it->second.complete = complete;
+
+	unsigned long lastSent = m_lastAcknowledged;
+	while (!m_inFlight.empty())
+	{
+		auto oldest = m_inFlight.begin();
+		if (oldest->second.id > lastSent)
+		{
+			lastSent = oldest->second.id;
+		}
+		if (!oldest->second.complete)
+		{
+			break;
+		}
+		m_inFlight.erase(oldest);
+	}
+	if (lastSent > m_lastAcknowledged)
+	{
+		m_lastAcknowledged = lastSent;
+		m_loader->updateLastSentId(lastSent);
+	}
+}
+
+/**
+ * Write the readings of a block the plugin failed to send to the retry
+ * spool. Once they are on disk the block is acknowledged, so the stream
+ * moves past it and the readings are not read from storage again if the
+ * service is restarted. The sending thread continues to send the readings
+ * it holds in memory.
+ *
+ * @param readings	The readings of the block still to be sent
+ * @param sequence	The sequence number of the block
+ * @param lastFetched	The ID of the last reading read for the block
+ * @param spooled	Set to the sequence number of the block in the spool
+ * @return bool		False if the retry spool is disabled, full or could
+ *			not be written
+ */
+bool DataSender::spool(ReadingSet *readings, unsigned long sequence,
+			unsigned long lastFetched, uint64_t& spooled)
+{
+	spooled = m_spool.push(readings);
+	if (!spooled)
+	{
+		return false;
+	}
+	acknowledge(sequence, lastFetched, true);
+	return true;
+}
+
 /**
  * Send a block of readings
  *
@@ -117,9 +280,26 @@ void DataSender::sendThread()
  */
 unsigned long DataSender::send(ReadingSet *readings)
 {
+	TRACE_SPAN("north", "DataSender::send");
+	ALLOC_SCOPE(ALLOC_NORTH_SEND);
+	unsigned int count = readings->getCount();
+	ALLOC_READINGS(ALLOC_NORTH_SEND, count);
 	blockPause();
+	auto start = chrono::steady_clock::now();
 	uint32_t sent = m_plugin->send(readings->getAllReadings());
+	auto latency = chrono::duration_cast<chrono::milliseconds>(chrono::steady_clock::now() - start);
 	releasePause();
+	if (m_adaptive)
+	{
+		unsigned long blockSize = m_blockSize.sent(count, sent, (unsigned long)latency.count());
+		if (blockSize != m_loader->getBlockSize())
+		{
+			m_logger->debug("Block size changed to %lu after sending %u of %u readings in %ld ms",
+					blockSize, sent, count, (long)latency.count());
+			m_loader->setBlockSize(blockSize);
+			m_loader->reportBlockSize(blockSize);
+		}
+	}
 	unsigned long lastSent = readings->getReadingId(sent);
 
 	if (sent > 0)
@@ -129,6 +309,14 @@ unsigned long DataSender::send(ReadingSet *readings)
 		// Update asset tracker table/cache, if required
 		vector<Reading *> *vec = readings->getAllReadingsPtr();
 
+		// The lag of the readings the plugin has acknowledged
+		struct timeval now;
+		gettimeofday(&now, NULL);
+		auto acknowledged = find_if(vec->cbegin(), vec->cend(),
+				[lastSent](Reading *reading) { return reading->getId() > lastSent; });
+		m_storeToNorthLag.record(vec->cbegin(), acknowledged, false, now);
+		m_endToEndLag.record(vec->cbegin(), acknowledged, true, now);
+
 		for (vector<Reading *>::iterator it = vec->begin(); it != vec->end(); )
 		{
 			Reading *reading = *it;
@@ -137,10 +325,14 @@ unsigned long DataSender::send(ReadingSet *readings)
 			{
 
 				AssetTrackingTuple tuple(m_service->getName(), m_service->getPluginName(), reading->getAssetName(), "Egress");
-				if (!AssetTracker::getAssetTracker()->checkAssetTrackingCache(tuple))
 				{
-					AssetTracker::getAssetTracker()->addAssetTrackingTuple(tuple);
-					m_logger->info("sendDataThread:  Adding new asset tracking tuple - egress: %s", tuple.assetToString().c_str());
+					// The asset tracker cache is shared by the sending threads
+					lock_guard<mutex> guard(m_trackerMutex);
+					if (!AssetTracker::getAssetTracker()->checkAssetTrackingCache(tuple))
+					{
+						AssetTracker::getAssetTracker()->addAssetTrackingTuple(tuple);
+						m_logger->info("sendDataThread:  Adding new asset tracking tuple - egress: %s", tuple.assetToString().c_str());
+					}
 				}
 
 				// Remove current reading
@@ -155,17 +347,72 @@ unsigned long DataSender::send(ReadingSet *readings)
 				break;
 			}
 		}
+		AssetTracker::getAssetTracker()->flush();
 		m_loader->updateStatistics(sent);
 		return lastSent;
 	}
 	return 0;
 }
 
+/**
+ * Return the lag of the readings that have been sent, from the time
+ * they were stored and from their user timestamp to the time the
+ * plugin acknowledged them
+ *
+ * @param json	Set to the JSON object with the statistics
+ */
+void DataSender::asJSON(string& json) const
+{
+	string storeToNorth, endToEnd, spool;
+	m_storeToNorthLag.asJSON(storeToNorth);
+	m_endToEndLag.asJSON(endToEnd);
+	m_spool.asJSON(spool);
+	json = "{ \"storeToNorthLag\" : " + storeToNorth + ", \"endToEndLag\" : " + endToEnd
+		+ ", \"retrySpool\" : " + spool + " }";
+}
+
+/**
+ * Enable or disable the adaptive sizing of the blocks of readings.
+ * When enabled the block size starts from the initial value and is
+ * adjusted after each send according to the latency and success of
+ * the send.
+ *
+ * @param enable	Enable the adaptive block size
+ * @param initial	The block size to start from
+ * @param maximum	The largest block size to use
+ * @param latencyTarget	The target latency of a send in milliseconds
+ */
+void DataSender::setAdaptiveBlockSize(bool enable, unsigned long initial,
+			unsigned long maximum, unsigned long latencyTarget)
+{
+	if (enable)
+	{
+		m_blockSize.configure(initial, maximum, latencyTarget);
+		m_loader->setBlockSize(m_blockSize.getBlockSize());
+		m_loader->reportBlockSize(m_blockSize.getBlockSize());
+		m_logger->info("Adaptive block size enabled, maximum %lu readings, latency target %lu ms",
+				maximum, latencyTarget);
+	}
+	m_adaptive = enable;
+}
+
+/**
+ * Enable or disable the retry spool. When disabled no new blocks are
+ * spooled, blocks already in the spool are still sent.
+ *
+ * @param enable	Enable the retry spool
+ * @param size		The disk space the spool may use in MB
+ */
+void DataSender::setRetrySpool(bool enable, unsigned long size)
+{
+	m_spool.setMaxDisk(enable ? (uint64_t)size * 1024 * 1024 : 0);
+}
+
 /**
  * Cause the data sender process to pause sending data until a corresponding release call is made.
  *
  * This call does not block until release is called, but does block until the current
- * send completes.
+ * sends complete.
  *
  * Called by external classes that want to prevent interaction
  * with the north plugin.
@@ -173,7 +420,7 @@ unsigned long DataSender::send(ReadingSet *readings)
 void DataSender::pause()
 {
 	unique_lock<mutex> lck(m_pauseMutex);
-	m_pauseCV.wait(lck, [this]{ return m_sending == false; });
+	m_pauseCV.wait(lck, [this]{ return m_sending == 0; });
 
 	m_paused = true;
 }
@@ -205,7 +452,7 @@ void DataSender::blockPause()
 	unique_lock<mutex> lck(m_pauseMutex);
 	m_pauseCV.wait(lck, [this]{ return m_paused == false; });
 
-	m_sending = true;
+	m_sending++;
 }
 
 /*
@@ -218,7 +465,7 @@ void DataSender::releasePause()
 {
 	{
 		std::lock_guard<std::mutex> lck(m_pauseMutex);
-		m_sending = false;
+		m_sending--;
 	}
 	m_pauseCV.notify_all();
 }
@@ -0,0 +1,50 @@
+#ifndef _ADAPTIVE_BLOCK_SIZE_H
+#define _ADAPTIVE_BLOCK_SIZE_H
+/*
+ * Fledge north service.
+ *
+ * Copyright (c) 2026 Dianomic Systems
+ *
+ * Released under the Apache 2.0 Licence
+ *
+ * Author: agent
+ */
+#include <mutex>
+
+#define DEFAULT_MAX_BLOCK_SIZE		10000	// Upper bound of the adaptive block size
+#define DEFAULT_SEND_LATENCY_TARGET	1000	// Target send latency in milliseconds
+#define ADAPTIVE_MIN_BLOCK_SIZE		10	// Lower bound of the adaptive block size
+#define ADAPTIVE_BLOCK_INCREMENT	10	// Readings added after each successful send
+#define ADAPTIVE_MAX_ERROR_RATE		0.05	// Error rate above which the block size is not grown
+#define ADAPTIVE_ERROR_WEIGHT		0.1	// Weight of the latest send in the error rate
+
+/**
+ * An additive increase, multiplicative decrease controller for the
+ * size of the blocks of readings sent by the north service.
+ *
+ * The block size grows by a fixed increment after each full block that
+ * is sent within the latency target whilst the recent error rate is low.
+ * It is halved when a send fails or only part of the block is accepted,
+ * which is how a plugin reports timeouts and rejected or failed requests,
+ * and reduced by a quarter when a send exceeds the latency target.
+ */
+class AdaptiveBlockSize {
+	public:
+		AdaptiveBlockSize(unsigned long initial,
+				unsigned long maximum,
+				unsigned long latencyTarget);
+		void			configure(unsigned long initial,
+					unsigned long maximum,
+					unsigned long latencyTarget);
+		unsigned long		sent(unsigned int count,
+					unsigned int sent,
+					unsigned long latency);
+		unsigned long		getBlockSize();
+	private:
+		std::mutex		m_mutex;
+		unsigned long		m_blockSize;
+		unsigned long		m_maximum;
+		unsigned long		m_latencyTarget;
+		double			m_errorRate;
+};
+#endif
@@ -6,12 +6,38 @@
 #include <mutex>
 #include <condition_variable>
 #include <deque>
+#include <map>
+#include <set>
+#include <atomic>
+#include <chrono>
+#include <future>
 #include <storage_client.h>
+#include <management_client.h>
 #include <reading.h>
 #include <filter_pipeline.h>
 #include <service_handler.h>
+#include <queue_metrics.h>
 
 #define DEFAULT_BLOCK_SIZE 100
+#define DEFAULT_PREFETCH_BLOCKS		2	// Blocks buffered ahead of the sender
+#define DEFAULT_PREFETCH_READINGS	10000	// Readings buffered ahead of the sender
+#define DEFAULT_PREFETCH_SIZE		(10 * 1024)	// KB buffered ahead of the sender
+#define SENT_STATS_INTERVAL		1000	// Minimum milliseconds between updates of the sent statistics
+#define DEFAULT_CATCH_UP_FETCHES	4	// Ranges of readings fetched concurrently when catching up
+#define DEFAULT_CATCH_UP_BLOCK		5000	// Readings in each range fetched when catching up
+#define DEFAULT_PRIORITY_WEIGHT		4	// Priority blocks sent for each bulk block when both are waiting
+#define PRIORITY_POLL_INTERVAL		500	// Milliseconds between reads of the priority assets
+#define PRIORITY_SCAN_SIZE		10000	// Readings scanned by each read of the priority assets
+#define DEFAULT_SNAPSHOT_INTERVAL	1000	// Milliseconds between the snapshots of conflated readings
+
+/**
+ * The details of a block of readings held in the queue
+ * for the sending thread
+ */
+struct QueuedBlock {
+	size_t		size;		// Estimated size of the block
+	unsigned long	lastFetched;	// ID of the last reading fetched for the block
+};
 
 /**
  * A class used in the North service to load data from the buffer
@@ -23,15 +49,19 @@
 class DataLoad : public ServiceHandler {
 	public:
 		DataLoad(const std::string& name, long streamId,
-			       	StorageClient *storage);
+			       	StorageClient *storage,
+				ManagementClient *management);
 		virtual ~DataLoad();
 
 		void			loadThread();
 		bool			setDataSource(const std::string& source);
 		void			triggerRead(unsigned int blockSize);
 		void			updateLastSentId(unsigned long id);
-		ReadingSet		*fetchReadings(bool wait);
+		ReadingSet		*fetchReadings(bool wait,
+						unsigned long *lastFetched = NULL,
+						bool *priority = NULL);
 		void			updateStatistics(uint32_t increment);
+		void			flushStatistics();
 		static void		passToOnwardFilter(OUTPUT_HANDLE *outHandle,
 						READINGSET* readings);
 		static void		pipelineEnd(OUTPUT_HANDLE *outHandle,
@@ -46,6 +76,20 @@ class DataLoad : public ServiceHandler {
 					{
 						m_blockSize = blockSize;
 					};
+		unsigned long		getBlockSize() { return m_blockSize; };
+		void			reportBlockSize(unsigned long blockSize);
+		void			setPrefetch(unsigned int blocks,
+						unsigned long readings,
+						unsigned long size);
+		void			setFetchStream(bool enable) { m_fetchStream = enable; };
+		void			setFetchFilter(const ReadingFetchFilter& filter);
+		void			setConflate(bool enable, unsigned long interval);
+		void			setCatchUp(unsigned long lag,
+						unsigned int fetches,
+						unsigned long blockSize);
+		bool			isCatchingUp() { return m_catchingUp; };
+		void			setPriorityAssets(const std::vector<std::string>& assets,
+						unsigned int weight);
 
 	private:
 		void			readBlock(unsigned int blockSize);
@@ -55,26 +99,87 @@ class DataLoad : public ServiceHandler {
 		ReadingSet		*fetchStatistics(unsigned int blockSize);
 		ReadingSet		*fetchAudit(unsigned int blockSize);
 		void			bufferReadings(ReadingSet *readings);
+		void			queueReadings(ReadingSet *readings);
+		bool			prefetchRequired();
+		void			conflateReadings(ReadingSet *readings);
+		void			checkLag(ReadingSet *readings);
+		bool			catchUp();
+		bool			readPriority();
+		ReadingSet		*removePriority(ReadingSet *readings);
+		ReadingSet		*fetchSnapshot(std::unique_lock<std::mutex>& lck,
+						bool wait, unsigned long *lastFetched);
+		static size_t		estimateSize(ReadingSet *readings);
 		bool			loadFilters(const std::string& category);
 		void			updateStatistic(const std::string& key, const std::string& description, uint32_t increment);
+		bool			sentStatisticsUpdated(bool wait);
 	private:
 		const std::string&	m_name;
 		long			m_streamId;
 		StorageClient		*m_storage;
+		ManagementClient	*m_mgtClient;
 		volatile bool		m_shutdown;
 		std::thread		*m_thread;
 		std::mutex		m_mutex;
 		std::condition_variable m_cv;
 		std::condition_variable m_fetchCV;
 		unsigned int		m_readRequest;
+		bool			m_prefetching;
 		enum { SourceReadings, SourceStatistics, SourceAudit }
 					m_dataSource;
 		unsigned long		m_lastFetched;
+		Query			*m_statisticsQuery;	// Sent again for each block of statistics
+		Where			*m_statisticsId;	// The id condition of m_statisticsQuery
+		Query			*m_auditQuery;		// Sent again for each block of audit entries
+		Where			*m_auditId;		// The id condition of m_auditQuery
 		std::deque<ReadingSet *>
 					m_queue;
 		std::mutex		m_qMutex;
 		FilterPipeline		*m_pipeline;
 		std::mutex		m_pipelineMutex;
 		unsigned long		m_blockSize;
+		unsigned int		m_prefetchBlocks;
+		unsigned long		m_prefetchReadings;
+		unsigned long		m_prefetchSize;
+		std::atomic<unsigned int>
+					m_queuedBlocks;
+		std::atomic<unsigned long>
+					m_queuedReadings;
+		std::atomic<unsigned long>
+					m_queuedSize;
+		std::deque<QueuedBlock>	m_queueInfo;
+		std::atomic<bool>	m_fetchStream;
+		ReadingFetchFilter	m_fetchFilter;	// Readings selected by the storage service
+		std::mutex		m_filterMutex;
+		std::atomic<unsigned long>
+					m_catchUpLag;	// Seconds behind at which catch up starts, 0 to disable
+		std::atomic<unsigned int>
+					m_catchUpFetches;
+		std::atomic<unsigned long>
+					m_catchUpBlock;
+		std::atomic<bool>	m_catchingUp;
+		std::set<std::string>	m_priorityAssets;	// Assets read and sent ahead of the others, guarded by m_filterMutex
+		ReadingFetchFilter	m_priorityFilter;
+		unsigned long		m_priorityFetched;	// ID up to which the priority assets have been read
+		std::deque<ReadingSet *>
+					m_priorityQueue;
+		unsigned int		m_priorityWeight;
+		unsigned int		m_priorityTaken;	// Priority blocks taken since the last bulk block
+		bool			m_bufferingPriority;	// The readings being buffered are for the priority queue
+		std::atomic<bool>	m_conflate;	// Hold the latest value of each asset rather than blocks
+		std::chrono::milliseconds
+					m_snapshotInterval;
+		std::chrono::steady_clock::time_point
+					m_nextSnapshot;
+		std::map<std::string, Reading *>
+					m_latest;	// Latest reading of each asset when conflating
+		unsigned long		m_latestFetched;	// ID of the last reading fetched for m_latest
+		QueueMetrics		m_queueMetrics;	// Readings loaded and waiting to be sent
+		std::mutex		m_statsMutex;
+		std::atomic<uint32_t>	m_pendingSent;	// Readings sent since the statistics were updated
+		std::atomic<bool>	m_sentStatsCreated;
+		std::chrono::steady_clock::time_point
+					m_lastStatsFlush;
+		std::future<int>	m_statsUpdate;	// Update of the sent statistics in flight
+		uint32_t		m_statsInFlight;	// Readings counted by the update in flight
 };
 #endif
@@ -7,20 +7,71 @@
 #include <thread>
 #include <mutex>
 #include <condition_variable>
+#include <vector>
+#include <map>
+#include <atomic>
+#include <adaptive_block_size.h>
+#include <json_provider.h>
+#include <lag_statistics.h>
+#include <retry_spool.h>
+
+#define DEFAULT_SEND_THREADS	1	// Number of concurrent sending threads
+#define MAX_SEND_THREADS	16
 
 class DataLoad;
 class NorthService;
 
-class DataSender {
+/**
+ * The acknowledgement state of a block of readings that
+ * has been taken by a sending thread
+ */
+struct BlockAcknowledgement {
+	unsigned long	id;		// The ID of the last reading sent from the block
+	bool		complete;	// All the readings in the block have been sent
+};
+
+/**
+ * The class that sends the blocks of readings buffered by the DataLoad
+ * class to the north plugin. One or more sending threads may be run,
+ * with more than one thread the blocks are sent concurrently and the
+ * last sent ID of the stream is advanced only as far as the highest
+ * block for which all the preceding blocks have also been sent.
+ *
+ * The lag of the readings that are sent is reported with the statistics
+ * of the service by the ping entry point of the management API.
+ *
+ * When the retry spool is enabled a block the plugin fails to send is
+ * written to disk and the last sent ID of the stream moved past it, so
+ * after a restart it is sent from the spool, ahead of any new blocks,
+ * rather than read from storage and filtered again.
+ */
+class DataSender : public JSONProvider {
 	public:
-		DataSender(NorthPlugin *plugin, DataLoad *loader, NorthService *north);
+		DataSender(NorthPlugin *plugin, DataLoad *loader, NorthService *north,
+				unsigned int threads = DEFAULT_SEND_THREADS);
 		~DataSender();
 		void			sendThread();
 		void			updatePlugin(NorthPlugin *plugin) { m_plugin = plugin; };
 		void			pause();
 		void			release();
+		void			setAdaptiveBlockSize(bool enable,
+						unsigned long initial,
+						unsigned long maximum,
+						unsigned long latencyTarget);
+		void			setRetrySpool(bool enable, unsigned long size);
+		void			asJSON(std::string& json) const;
 	private:
 		unsigned long		send(ReadingSet *readings);
+		ReadingSet		*fetchBlock(unsigned long& sequence,
+						unsigned long& lastFetched,
+						bool& priority);
+		void			acknowledge(unsigned long sequence,
+						unsigned long id,
+						bool complete);
+		bool			spool(ReadingSet *readings,
+						unsigned long sequence,
+						unsigned long lastFetched,
+						uint64_t& spooled);
 		void			blockPause();
 		void			releasePause();
 	private:
@@ -28,12 +79,25 @@ class DataSender {
 		DataLoad		*m_loader;
 		NorthService		*m_service;
 		volatile bool		m_shutdown;
-		std::thread		*m_thread;
+		std::vector<std::thread *>
+					m_threads;
 		Logger			*m_logger;
 		bool			m_paused;
-		bool			m_sending;
+		unsigned int		m_sending;
 		std::mutex		m_pauseMutex;
 		std::condition_variable m_pauseCV;
+		std::mutex		m_fetchMutex;
+		std::mutex		m_ackMutex;
+		std::mutex		m_trackerMutex;
+		unsigned long		m_nextSequence;
+		unsigned long		m_lastAcknowledged;
+		std::map<unsigned long, BlockAcknowledgement>
+					m_inFlight;
+		AdaptiveBlockSize	m_blockSize;
+		std::atomic<bool>	m_adaptive;
+		LagStatistics		m_storeToNorthLag;	// From the storage of the readings to their acknowledgement
+		LagStatistics		m_endToEndLag;		// From the user timestamp of the readings to their acknowledgement
+		RetrySpool		m_spool;		// Blocks the plugin failed to send
 
 };
 #endif
@@ -17,6 +17,14 @@ static struct {
 	const char	*type;
 	const char	*value;
 } defaults[] = {
+	{ "threadConfig",	"Thread Configuration",
+			"The CPU affinity and scheduling policy of the threads of the service, by thread role", "JSON", "{}" },
+	{ "allocatorConfig",	"Allocator Configuration",
+			"The tuning options of the memory allocator of the service", "JSON", "{}" },
+	{ "asyncLogging",	"Asynchronous Logging",
+			"Write log messages from a separate thread so that logging does not delay the service", "boolean", "false" },
+	{ "pythonPreload",	"Python Preload",
+			"A comma separated list of Python modules to import when the service starts, before the Python plugins and filters that use them are loaded", "string", "" },
 	{ NULL, NULL, NULL, NULL, NULL }
 };
 #endif
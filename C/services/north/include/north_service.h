@@ -18,6 +18,8 @@
 #include <filter_plugin.h>
 #include <mutex>
 #include <condition_variable>
+#include <map>
+#include <client_http.hpp>
 
 #define SERVICE_NAME  "Fledge North"
 
@@ -52,12 +54,21 @@ class NorthService : public ServiceAuthHandler {
 		int				operation(const std::string& name, int paramCount, char *names[], char *parameters[], const ControlDestination, const std::string& arg);
 	private:
 		void				addConfigDefaults(DefaultConfigCategory& defaults);
+		void				configurePrefetch();
+		void				configureAdaptiveBlockSize();
+		void				configureRetrySpool();
 		bool 				loadPlugin();
 		void 				createConfigCategories(DefaultConfigCategory configCategory, std::string parent_name,std::string current_name);
 		void				restartPlugin();
 	private:
 		bool				sendToService(const std::string& southService, const std::string& name, const std::string& value);
 		bool				sendToDispatcher(const std::string& path, const std::string& payload);
+		bool				sendControl(const std::string& serviceName,
+							const std::string& method,
+							const std::string& path,
+							const std::string& payload,
+							SimpleWeb::CaseInsensitiveMultimap& headers,
+							const std::string& expected);
 		DataLoad			*m_dataLoad;
 		DataSender			*m_dataSender;
 		NorthPlugin			*northPlugin;
@@ -74,5 +85,8 @@ class NorthService : public ServiceAuthHandler {
 		bool				m_restartPlugin;
 		const std::string		m_token;
 		bool				m_allowControl;
+		std::mutex			m_controlMutex;
+		std::map<std::string, SimpleWeb::Client<SimpleWeb::HTTP> *>
+						m_controlClients;	// Connections to services keyed by service name
 };
 #endif
@@ -0,0 +1,101 @@
+#ifndef _RETRY_SPOOL_H
+#define _RETRY_SPOOL_H
+/*
+ * Fledge north service retry spool.
+ *
+ * Copyright (c) 2026 Dianomic Systems
+ *
+ * Released under the Apache 2.0 Licence
+ *
+ * Author: agent
+ */
+#include <reading_set.h>
+#include <logger.h>
+#include <string>
+#include <map>
+#include <mutex>
+#include <stdint.h>
+
+#define DEFAULT_RETRY_SPOOL_SIZE	1024	// MB of spooled blocks allowed on disk
+
+#define RETRY_BLOCK_MAGIC	0x52545942
+#define RETRY_VERSION		1
+
+/**
+ * The header of a spooled block file, followed by length bytes of
+ * readings. Each reading is written as
+ *
+ *	uint64_t	reading ID
+ *	uint32_t	asset name length, char[length]
+ *	int64_t		user timestamp seconds, microseconds
+ *	int64_t		timestamp seconds, microseconds
+ *	uint32_t	payload length, binary datapoint payload[length]
+ *
+ * The datapoint payload is the encoding of the reading stream protocol.
+ */
+typedef struct {
+	uint32_t	magic;
+	uint32_t	version;
+	uint32_t	count;		// Readings in the block
+	uint32_t	reserved;
+	uint64_t	length;		// Bytes of readings following the header
+} RetryBlockHeader;
+
+/**
+ * A spooled block
+ */
+struct RetryBlock {
+	uint64_t	size;		// Bytes of the block file
+	bool		taken;		// The block is being sent by a sending thread
+};
+
+/**
+ * The blocks of readings that the north plugin failed to send, held on
+ * disk so that they survive a restart of the service.
+ *
+ * A block is spooled once it has passed through the filter pipeline, so
+ * it is neither read from the storage service nor filtered again. Each
+ * block is written to its own file in the spool directory, which is
+ * synchronised to disk before the block is reported as spooled, after
+ * which the last sent ID of the stream may be moved past it. A block is
+ * taken by a sending thread, which keeps the readings in memory until
+ * they have all been sent; the file is rewritten with the readings still
+ * to be sent after a partial send and removed once the block is sent.
+ * Blocks left in the spool directory when the service shuts down are
+ * sent ahead of any new readings when it next starts.
+ *
+ * No new blocks are spooled until the disk space the spool may use has
+ * been set, blocks left by a previous run are still sent.
+ *
+ * The spool is shared by the sending threads.
+ */
+class RetrySpool {
+	public:
+		RetrySpool(const std::string& directory);
+		uint64_t		push(ReadingSet *readings);
+		ReadingSet		*take(uint64_t& sequence);
+		void			update(uint64_t sequence, ReadingSet *readings);
+		void			remove(uint64_t sequence);
+		void			setMaxDisk(uint64_t bytes);
+		void			asJSON(std::string& json) const;
+	private:
+		RetrySpool(const RetrySpool&);
+		RetrySpool&		operator=(const RetrySpool&);
+		void			recover();
+		std::string		blockPath(uint64_t sequence) const;
+		bool			writeBlock(uint64_t sequence, ReadingSet *readings, uint64_t& size);
+		ReadingSet		*readBlock(uint64_t sequence);
+		void			encode(ReadingSet *readings, std::string& block);
+		ReadingSet		*decode(const char *data, const RetryBlockHeader& header);
+	private:
+		std::string		m_directory;
+		uint64_t		m_maxDisk;	// Bytes of spooled blocks allowed on disk, 0 to spool none
+		mutable std::mutex	m_mutex;
+		std::map<uint64_t, RetryBlock>
+					m_blocks;	// Oldest first
+		uint64_t		m_nextSequence;
+		uint64_t		m_diskBytes;
+		Logger			*m_logger;
+};
+
+#endif
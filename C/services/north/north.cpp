@@ -33,7 +33,11 @@
 #include <filter_plugin.h>
 #include <config_handler.h>
 #include <syslog.h>
+#include <thread_config.h>
+#include <service_allocator.h>
+#include <future>
 #include <stdarg.h>
+#include <string_utils.h>
 
 #define SERVICE_TYPE "Northbound"
 
@@ -59,6 +63,26 @@ using namespace std;
 
 static NorthService *service;
 
+/**
+ * Split a comma separated list of names, ignoring the empty names
+ *
+ * @param list	The comma separated list
+ * @param names	The names in the list
+ */
+static void splitList(const string& list, vector<string>& names)
+{
+	stringstream ss(list);
+	string name;
+	while (getline(ss, name, ','))
+	{
+		name = StringTrim(name);
+		if (!name.empty())
+		{
+			names.push_back(name);
+		}
+	}
+}
+
 /**
  * Callback function when a plugin wishes to perform a write operation
  *
@@ -266,6 +290,7 @@ int	size;
  */
 NorthService::NorthService(const string& myName, const string& token) :
 	m_dataLoad(NULL),
+	m_dataSender(NULL),
 	m_shutdown(false),
 	m_storage(NULL),
 	m_pluginData(NULL),
@@ -285,6 +310,8 @@ NorthService::~NorthService()
 {
 	if (m_storage)
 		delete m_storage;
+	for (auto& client : m_controlClients)
+		delete client.second;
 }
 
 /**
@@ -316,29 +343,44 @@ void NorthService::start(string& coreAddress, unsigned short corePort)
 				m_token);		// Token);
 		m_mgtClient = new ManagementClient(coreAddress, corePort);
 
-		// Create an empty North category if one doesn't exist
+		// Create an empty North category if one doesn't exist, this is
+		// only needed once the plugin categories are added beneath it
+		// so is done whilst the configuration is fetched
 		DefaultConfigCategory northConfig(string("North"), string("{}"));
 		northConfig.setDescription("North");
-		m_mgtClient->addCategory(northConfig, true);
+		future<bool> parent = async(launch::async, [this, &northConfig]() {
+					return m_mgtClient->addCategory(northConfig, true);
+				});
 
 		m_config = m_mgtClient->getCategory(m_name);
+		parent.wait();
 		if (!loadPlugin())
 		{
 			logger->fatal("Failed to load north plugin, exiting...");
 			management.stop();
 			return;
 		}
-		if (!m_mgtClient->registerService(record))
-		{
-			logger->error("Failed to register service %s", m_name.c_str());
-		}
-		ConfigHandler *configHandler = ConfigHandler::getInstance(m_mgtClient);
-		configHandler->registerCategory(this, m_name);
-		configHandler->registerCategory(this, m_name+"Advanced");
+		// Register the service and the interest in its categories whilst
+		// the storage service and asset tracking tuples are fetched by a
+		// single bootstrap request
+		future<void> registration = async(launch::async, [this, &record]() {
+				if (!m_mgtClient->registerService(record))
+				{
+					logger->error("Failed to register service %s", m_name.c_str());
+				}
+				ConfigHandler *configHandler = ConfigHandler::getInstance(m_mgtClient);
+				configHandler->registerCategory(this, m_name);
+				configHandler->registerCategory(this, m_name+"Advanced");
+			});
+		ServiceBootstrap bootstrap;
+		bool bootstrapped = m_mgtClient->getBootstrap(m_name, vector<string>(), bootstrap);
 
 		// Get a handle on the storage layer
 		ServiceRecord storageRecord("Fledge Storage");
-		if (!m_mgtClient->getService(storageRecord))
+		bool haveStorage = (bootstrapped && bootstrap.getStorage(storageRecord))
+					|| m_mgtClient->getService(storageRecord);
+		registration.wait();
+		if (!haveStorage)
 		{
 			logger->fatal("Unable to find storage service");
 			m_mgtClient->unregisterService();
@@ -357,7 +399,14 @@ void NorthService::start(string& coreAddress, unsigned short corePort)
 		// Fetch Confguration
 		logger->debug("Initialise the asset tracker");
 		m_assetTracker = new AssetTracker(m_mgtClient, m_name);
-		AssetTracker::getAssetTracker()->populateAssetTrackingCache(m_name, "Egress");
+		if (bootstrapped)
+		{
+			m_assetTracker->populateAssetTrackingCache(bootstrap.getAssetTrackingTuples());
+		}
+		else
+		{
+			m_assetTracker->populateAssetTrackingCache(m_name, "Egress");
+		}
 
 		// If the plugin supports control register the callback functions
 		if (northPlugin->hasControl())
@@ -391,7 +440,7 @@ void NorthService::start(string& coreAddress, unsigned short corePort)
 			streamId = strtol(m_config.getValue("streamId").c_str(), NULL, 10);
 		}
 		logger->debug("Create threads for stream %d", streamId);
-		m_dataLoad = new DataLoad(m_name, streamId, m_storage);
+		m_dataLoad = new DataLoad(m_name, streamId, m_storage, m_mgtClient);
 		if (m_config.itemExists("source"))
 		{
 			m_dataLoad->setDataSource(m_config.getValue("source"));
@@ -407,7 +456,19 @@ void NorthService::start(string& coreAddress, unsigned short corePort)
 				m_dataLoad->setBlockSize(newBlock);
 			}
 		}
-		m_dataSender = new DataSender(northPlugin, m_dataLoad, this);
+		configurePrefetch();
+		unsigned int sendThreads = DEFAULT_SEND_THREADS;
+		if (m_configAdvanced.itemExists("sendThreads"))
+		{
+			sendThreads = strtoul(
+						m_configAdvanced.getValue("sendThreads").c_str(),
+						NULL,
+						10);
+		}
+		m_dataSender = new DataSender(northPlugin, m_dataLoad, this, sendThreads);
+		configureAdaptiveBlockSize();
+		configureRetrySpool();
+		management.registerStats(m_dataSender);
 		logger->debug("North service is running");
 
 		
@@ -425,6 +486,7 @@ void NorthService::start(string& coreAddress, unsigned short corePort)
 		logger->debug("North service is shutting down");
 
 		m_dataLoad->shutdown();		// Forces the data load to return from any blocking fetch call
+		management.registerStats(NULL);
 		delete m_dataSender;
 		logger->debug("North service data sender has shut down");
 		delete m_dataLoad;
@@ -590,6 +652,23 @@ bool NorthService::loadPlugin()
 					}
 				}
 			}
+			if (m_configAdvanced.itemExists("threadConfig"))
+			{
+				ThreadConfig::getInstance()->configure(m_configAdvanced.getValue("threadConfig"));
+			}
+			if (m_configAdvanced.itemExists("allocatorConfig"))
+			{
+				ServiceAllocator::getInstance()->configure(m_configAdvanced.getValue("allocatorConfig"));
+			}
+			if (m_configAdvanced.itemExists("asyncLogging"))
+			{
+				string async = m_configAdvanced.getValue("asyncLogging");
+				logger->setAsynchronous(async[0] == 't' || async[0] == 'T');
+			}
+			if (m_configAdvanced.itemExists("pythonPreload"))
+			{
+				PluginManager::getInstance()->preloadPythonModules(m_configAdvanced.getValue("pythonPreload"));
+			}
 			if (m_configAdvanced.itemExists("control"))
 			{
 				string c = m_configAdvanced.getValue("control");
@@ -638,8 +717,13 @@ void NorthService::configChange(const string& categoryName, const string& catego
 			category.c_str());
 	if (categoryName.compare(m_name) == 0)
 	{
-
-		m_config = ConfigCategory(m_name, category);
+		ConfigCategory config(m_name, category);
+		if (config.getVersion() == m_config.getVersion())
+		{
+			logger->info("Configuration category %s is unchanged", categoryName.c_str());
+			return;
+		}
+		m_config = config;
 
 		m_restartPlugin = true;
 		m_cv.notify_all();
@@ -651,7 +735,13 @@ void NorthService::configChange(const string& categoryName, const string& catego
 	}
 	if (categoryName.compare(m_name+"Advanced") == 0)
 	{
-		m_configAdvanced = ConfigCategory(m_name+"Advanced", category);
+		ConfigCategory config(m_name+"Advanced", category);
+		if (config.getVersion() == m_configAdvanced.getVersion())
+		{
+			logger->info("Configuration category %s is unchanged", categoryName.c_str());
+			return;
+		}
+		m_configAdvanced = config;
 		if (m_configAdvanced.itemExists("logLevel"))
 		{
 			string prevLogLevel = logger->getMinLevel();
@@ -678,6 +768,23 @@ void NorthService::configChange(const string& categoryName, const string& catego
 				}
 			}
 		}
+		if (m_configAdvanced.itemExists("threadConfig"))
+		{
+			ThreadConfig::getInstance()->configure(m_configAdvanced.getValue("threadConfig"));
+		}
+		if (m_configAdvanced.itemExists("allocatorConfig"))
+		{
+			ServiceAllocator::getInstance()->configure(m_configAdvanced.getValue("allocatorConfig"));
+		}
+		if (m_configAdvanced.itemExists("asyncLogging"))
+		{
+			string async = m_configAdvanced.getValue("asyncLogging");
+			logger->setAsynchronous(async[0] == 't' || async[0] == 'T');
+		}
+		if (m_configAdvanced.itemExists("pythonPreload"))
+		{
+			PluginManager::getInstance()->preloadPythonModules(m_configAdvanced.getValue("pythonPreload"));
+		}
 		if (m_configAdvanced.itemExists("control"))
 		{
 			string c = m_configAdvanced.getValue("control");
@@ -703,6 +810,15 @@ void NorthService::configChange(const string& categoryName, const string& catego
 				m_dataLoad->setBlockSize(newBlock);
 			}
 		}
+		if (m_dataLoad)
+		{
+			configurePrefetch();
+		}
+		if (m_dataSender)
+		{
+			configureAdaptiveBlockSize();
+			configureRetrySpool();
+		}
 	}
 
 	// Update the  Security category
@@ -805,6 +921,247 @@ void NorthService::addConfigDefaults(DefaultConfigCategory& defaultConfig)
 		std::to_string(DEFAULT_BLOCK_SIZE),
 		std::to_string(DEFAULT_BLOCK_SIZE));
 	defaultConfig.setItemDisplayName("blockSize", "Data block size");
+
+	// Add the adaptive block size configuration items
+	defaultConfig.addItem("adaptiveBlockSize",
+		"Adjust the size of the blocks of data sent according to the time taken to send them and the failures reported by the plugin.",
+		"boolean", "false", "false");
+	defaultConfig.setItemDisplayName("adaptiveBlockSize", "Adaptive block size");
+	defaultConfig.addItem("maxBlockSize",
+		"The largest block of data that will be sent when the adaptive block size is enabled.",
+		"integer",
+		std::to_string(DEFAULT_MAX_BLOCK_SIZE),
+		std::to_string(DEFAULT_MAX_BLOCK_SIZE));
+	defaultConfig.setItemDisplayName("maxBlockSize", "Maximum block size");
+	defaultConfig.addItem("sendLatencyTarget",
+		"The target time in milliseconds to send a block of data when the adaptive block size is enabled.",
+		"integer",
+		std::to_string(DEFAULT_SEND_LATENCY_TARGET),
+		std::to_string(DEFAULT_SEND_LATENCY_TARGET));
+	defaultConfig.setItemDisplayName("sendLatencyTarget", "Send latency target (ms)");
+
+	// Add the read ahead configuration items
+	defaultConfig.addItem("prefetchBlocks",
+		"The number of blocks of data to read ahead of the block being sent.",
+		"integer",
+		std::to_string(DEFAULT_PREFETCH_BLOCKS),
+		std::to_string(DEFAULT_PREFETCH_BLOCKS));
+	defaultConfig.setItemDisplayName("prefetchBlocks", "Prefetch blocks");
+	defaultConfig.addItem("prefetchReadings",
+		"The maximum number of readings to read ahead of the block being sent, 0 for no limit.",
+		"integer",
+		std::to_string(DEFAULT_PREFETCH_READINGS),
+		std::to_string(DEFAULT_PREFETCH_READINGS));
+	defaultConfig.setItemDisplayName("prefetchReadings", "Prefetch readings limit");
+	defaultConfig.addItem("prefetchSize",
+		"The maximum size in KB of the data to read ahead of the block being sent, 0 for no limit.",
+		"integer",
+		std::to_string(DEFAULT_PREFETCH_SIZE),
+		std::to_string(DEFAULT_PREFETCH_SIZE));
+	defaultConfig.setItemDisplayName("prefetchSize", "Prefetch size limit (KB)");
+	defaultConfig.addItem("fetchStream",
+		"Read the readings over a binary stream pushed by the storage service rather than by individual requests. The readings requests are used if the storage plugin does not support the stream.",
+		"boolean", "false", "false");
+	defaultConfig.setItemDisplayName("fetchStream", "Fetch stream");
+	defaultConfig.addItem("fetchAssets",
+		"A comma separated list of the assets the storage service returns when the readings are read. All the assets are returned if the list is empty.",
+		"string", "", "");
+	defaultConfig.setItemDisplayName("fetchAssets", "Assets to read");
+	defaultConfig.addItem("fetchAssetsExclude",
+		"Return all the assets except those in the list of assets to read",
+		"boolean", "false", "false");
+	defaultConfig.setItemDisplayName("fetchAssetsExclude", "Exclude the assets");
+	defaultConfig.addItem("fetchDatapoints",
+		"A comma separated list of the datapoints the storage service returns in the readings. All the datapoints are returned if the list is empty.",
+		"string", "", "");
+	defaultConfig.setItemDisplayName("fetchDatapoints", "Datapoints to read");
+	defaultConfig.addItem("priorityAssets",
+		"A comma separated list of the assets that are read and sent ahead of the other assets.",
+		"string", "", "");
+	defaultConfig.setItemDisplayName("priorityAssets", "Priority assets");
+	defaultConfig.addItem("priorityWeight",
+		"The number of blocks of the priority assets sent for each block of the other assets when both are waiting to be sent.",
+		"integer",
+		std::to_string(DEFAULT_PRIORITY_WEIGHT),
+		std::to_string(DEFAULT_PRIORITY_WEIGHT));
+	defaultConfig.setItemDisplayName("priorityWeight", "Priority weight");
+	defaultConfig.addItem("conflate",
+		"Send only the latest value of each datapoint of each asset, at most once every snapshot interval, rather than every reading",
+		"boolean", "false", "false");
+	defaultConfig.setItemDisplayName("conflate", "Latest values only");
+	defaultConfig.addItem("snapshotInterval",
+		"The milliseconds between the sending of the latest values when only the latest values are sent",
+		"integer",
+		std::to_string(DEFAULT_SNAPSHOT_INTERVAL),
+		std::to_string(DEFAULT_SNAPSHOT_INTERVAL));
+	defaultConfig.setItemDisplayName("snapshotInterval", "Snapshot interval (ms)");
+	defaultConfig.addItem("catchUpLag",
+		"The number of seconds the readings sent may fall behind before larger blocks of readings are read concurrently to catch up, 0 to disable.",
+		"integer", "0", "0");
+	defaultConfig.setItemDisplayName("catchUpLag", "Catch up lag (s)");
+	defaultConfig.addItem("catchUpFetches",
+		"The number of blocks of readings read concurrently when catching up.",
+		"integer",
+		std::to_string(DEFAULT_CATCH_UP_FETCHES),
+		std::to_string(DEFAULT_CATCH_UP_FETCHES));
+	defaultConfig.setItemDisplayName("catchUpFetches", "Catch up reads");
+	defaultConfig.addItem("catchUpBlockSize",
+		"The number of readings in each block read when catching up.",
+		"integer",
+		std::to_string(DEFAULT_CATCH_UP_BLOCK),
+		std::to_string(DEFAULT_CATCH_UP_BLOCK));
+	defaultConfig.setItemDisplayName("catchUpBlockSize", "Catch up block size");
+
+	// Add the number of concurrent sending threads
+	defaultConfig.addItem("sendThreads",
+		"The number of blocks of data that are sent concurrently. Values greater than 1 require a north plugin that supports concurrent calls to send. A change takes effect when the service is restarted.",
+		"integer",
+		std::to_string(DEFAULT_SEND_THREADS),
+		std::to_string(DEFAULT_SEND_THREADS));
+	defaultConfig.setItemDisplayName("sendThreads", "Concurrent sends");
+
+	// Add the retry spool configuration items
+	defaultConfig.addItem("retrySpool",
+		"Write the blocks of data the plugin fails to send to disk, so that after a restart they are sent first rather than read and filtered again.",
+		"boolean", "false", "false");
+	defaultConfig.setItemDisplayName("retrySpool", "Retry spool");
+	defaultConfig.addItem("retrySpoolSize",
+		"The disk space in MB the blocks of data written to the retry spool may use.",
+		"integer",
+		std::to_string(DEFAULT_RETRY_SPOOL_SIZE),
+		std::to_string(DEFAULT_RETRY_SPOOL_SIZE));
+	defaultConfig.setItemDisplayName("retrySpoolSize", "Retry spool size (MB)");
+}
+
+/**
+ * Configure the adaptive sizing of the blocks of data sent
+ * from the advanced configuration
+ */
+void NorthService::configureAdaptiveBlockSize()
+{
+	bool enable = false;
+	unsigned long maximum = DEFAULT_MAX_BLOCK_SIZE;
+	unsigned long latency = DEFAULT_SEND_LATENCY_TARGET;
+
+	if (m_configAdvanced.itemExists("adaptiveBlockSize"))
+	{
+		enable = m_configAdvanced.getValue("adaptiveBlockSize").compare("true") == 0;
+	}
+	if (m_configAdvanced.itemExists("maxBlockSize"))
+	{
+		maximum = strtoul(m_configAdvanced.getValue("maxBlockSize").c_str(), NULL, 10);
+	}
+	if (m_configAdvanced.itemExists("sendLatencyTarget"))
+	{
+		latency = strtoul(m_configAdvanced.getValue("sendLatencyTarget").c_str(), NULL, 10);
+	}
+	m_dataSender->setAdaptiveBlockSize(enable, m_dataLoad->getBlockSize(), maximum, latency);
+}
+
+/**
+ * Configure the spooling to disk of the blocks of data the plugin
+ * fails to send from the advanced configuration
+ */
+void NorthService::configureRetrySpool()
+{
+	bool enable = false;
+	unsigned long size = DEFAULT_RETRY_SPOOL_SIZE;
+
+	if (m_configAdvanced.itemExists("retrySpool"))
+	{
+		enable = m_configAdvanced.getValue("retrySpool").compare("true") == 0;
+	}
+	if (m_configAdvanced.itemExists("retrySpoolSize"))
+	{
+		size = strtoul(m_configAdvanced.getValue("retrySpoolSize").c_str(), NULL, 10);
+	}
+	m_dataSender->setRetrySpool(enable, size);
+}
+
+/**
+ * Configure the amount of data the data load reads ahead of
+ * the sending thread, and how it reads it, from the advanced
+ * configuration
+ */
+void NorthService::configurePrefetch()
+{
+	unsigned int blocks = DEFAULT_PREFETCH_BLOCKS;
+	unsigned long readings = DEFAULT_PREFETCH_READINGS;
+	unsigned long size = DEFAULT_PREFETCH_SIZE;
+
+	if (m_configAdvanced.itemExists("prefetchBlocks"))
+	{
+		blocks = strtoul(m_configAdvanced.getValue("prefetchBlocks").c_str(), NULL, 10);
+	}
+	if (m_configAdvanced.itemExists("prefetchReadings"))
+	{
+		readings = strtoul(m_configAdvanced.getValue("prefetchReadings").c_str(), NULL, 10);
+	}
+	if (m_configAdvanced.itemExists("prefetchSize"))
+	{
+		size = strtoul(m_configAdvanced.getValue("prefetchSize").c_str(), NULL, 10);
+	}
+	m_dataLoad->setPrefetch(blocks, readings, size);
+	if (m_configAdvanced.itemExists("fetchStream"))
+	{
+		m_dataLoad->setFetchStream(m_configAdvanced.getValue("fetchStream").compare("true") == 0);
+	}
+
+	ReadingFetchFilter filter;
+	if (m_configAdvanced.itemExists("fetchAssets"))
+	{
+		splitList(m_configAdvanced.getValue("fetchAssets"), filter.assets);
+	}
+	if (m_configAdvanced.itemExists("fetchAssetsExclude"))
+	{
+		filter.exclude = m_configAdvanced.getValue("fetchAssetsExclude").compare("true") == 0;
+	}
+	if (m_configAdvanced.itemExists("fetchDatapoints"))
+	{
+		splitList(m_configAdvanced.getValue("fetchDatapoints"), filter.datapoints);
+	}
+	m_dataLoad->setFetchFilter(filter);
+
+	vector<string> priorityAssets;
+	unsigned int weight = DEFAULT_PRIORITY_WEIGHT;
+	if (m_configAdvanced.itemExists("priorityAssets"))
+	{
+		splitList(m_configAdvanced.getValue("priorityAssets"), priorityAssets);
+	}
+	if (m_configAdvanced.itemExists("priorityWeight"))
+	{
+		weight = strtoul(m_configAdvanced.getValue("priorityWeight").c_str(), NULL, 10);
+	}
+	m_dataLoad->setPriorityAssets(priorityAssets, weight);
+
+	bool conflate = false;
+	unsigned long interval = DEFAULT_SNAPSHOT_INTERVAL;
+	if (m_configAdvanced.itemExists("conflate"))
+	{
+		conflate = m_configAdvanced.getValue("conflate").compare("true") == 0;
+	}
+	if (m_configAdvanced.itemExists("snapshotInterval"))
+	{
+		interval = strtoul(m_configAdvanced.getValue("snapshotInterval").c_str(), NULL, 10);
+	}
+	m_dataLoad->setConflate(conflate, interval);
+
+	unsigned long lag = 0;
+	unsigned int fetches = DEFAULT_CATCH_UP_FETCHES;
+	unsigned long catchUpBlock = DEFAULT_CATCH_UP_BLOCK;
+	if (m_configAdvanced.itemExists("catchUpLag"))
+	{
+		lag = strtoul(m_configAdvanced.getValue("catchUpLag").c_str(), NULL, 10);
+	}
+	if (m_configAdvanced.itemExists("catchUpFetches"))
+	{
+		fetches = strtoul(m_configAdvanced.getValue("catchUpFetches").c_str(), NULL, 10);
+	}
+	if (m_configAdvanced.itemExists("catchUpBlockSize"))
+	{
+		catchUpBlock = strtoul(m_configAdvanced.getValue("catchUpBlockSize").c_str(), NULL, 10);
+	}
+	m_dataLoad->setCatchUp(lag, fetches, catchUpBlock);
 }
 
 /**
@@ -898,7 +1255,7 @@ int  NorthService::operation(const string& name, int paramCount, char *names[],
 	string payload = "{ \"destination\" : \"broadcast\",";
 	payload += "\"operation\" : { \"";
 	payload += name;
-	payload += "\" : { \"";
+	payload += "\" : { ";
 	for (int i = 0; i < paramCount; i++)
 	{
 		payload += "\"";
@@ -909,7 +1266,7 @@ int  NorthService::operation(const string& name, int paramCount, char *names[],
 		if (i < paramCount -1)
 			payload += ",";
 	}
-	payload += "\" } }";
+	payload += " } } }";
 	sendToDispatcher("/dispatch/operation", payload);
 	return -1;
 }
@@ -954,7 +1311,7 @@ int NorthService::operation(const string& name, int paramCount, char *names[], c
 	}
 	payload += ", \"operation\" : { \"";
 	payload += name;
-	payload += "\" : { \"";
+	payload += "\" : { ";
 	for (int i = 0; i < paramCount; i++)
 	{
 		payload += "\"";
@@ -965,7 +1322,7 @@ int NorthService::operation(const string& name, int paramCount, char *names[], c
 		if (i < paramCount -1)
 			payload += ",";
 	}
-	payload += "\" } }";
+	payload += " } } }";
 	sendToDispatcher("/dispatch/operation", payload);
 	return -1;
 }
@@ -983,91 +1340,99 @@ bool NorthService::sendToService(const string& southService, const string& name,
 	payload += "\"} }";
 
 	// Send the control message to the south service
-	try {
-		ServiceRecord service(southService);
-		if (!m_mgtClient->getService(service))
-		{
-			Logger::getLogger()->error("Unable to find service '%s'", southService.c_str());
-			return false;
-		}
-		string address = service.getAddress();
-		unsigned short port = service.getPort();
-		char addressAndPort[80];
-		snprintf(addressAndPort, sizeof(addressAndPort), "%s:%d", address.c_str(), port);
-		SimpleWeb::Client<SimpleWeb::HTTP> http(addressAndPort);
-
-		string url = "/fledge/south/setpoint";
-		try {
-			SimpleWeb::CaseInsensitiveMultimap headers = {{"Content-Type", "application/json"}};
-			auto res = http.request("PUT", url, payload, headers);
-			if (res->status_code.compare("200 OK"))
-			{
-				Logger::getLogger()->error("Failed to send set point operation to service %s, %s",
-							southService.c_str(), res->status_code.c_str());
-				return false;
-			}
-		} catch (exception& e) {
-			Logger::getLogger()->error("Failed to send set point operation to service %s, %s",
-						southService.c_str(), e.what());
-			return false;
-		}
+	SimpleWeb::CaseInsensitiveMultimap headers = {{"Content-Type", "application/json"}};
+	return sendControl(southService, "PUT", "/fledge/south/setpoint", payload, headers, "200 OK");
+}
 
-		return true;
-	}
-	catch (exception &e) {
-		Logger::getLogger()->error("Failed to send set point operation to service %s, %s",
-				southService.c_str(), e.what());
-		return false;
+/**
+ * Send to the control dispatcher service
+ */
+bool NorthService::sendToDispatcher(const string& path, const string& payload)
+{
+	SimpleWeb::CaseInsensitiveMultimap headers = {{"Content-Type", "application/json"}};
+	// Pass North service bearer token to dispatcher
+	string regToken = m_mgtClient->getRegistrationBearerToken();
+	if (regToken != "")
+	{
+		headers.emplace("Authorization", "Bearer " + regToken);
 	}
 
+	// Send the control message to the dispatcher service
+	return sendControl("dispatcher", "POST", path, payload, headers, "202 Accepted");
 }
 
 /**
- * Send to the control dispatcher service
+ * Send a control message to a service. The connection to each service
+ * is kept open and reused, so that a control message does not wait for
+ * the service to be looked up and a new connection to be made. If the
+ * message can not be sent the connection is discarded and the message
+ * sent once more over a new connection to the address the service is
+ * registered with now, the service may have been restarted.
+ *
+ * Control messages are sent one at a time, in the order they are made.
+ *
+ * @param serviceName	The name of the service
+ * @param method	The HTTP method of the request
+ * @param path		The path of the request
+ * @param payload	The payload of the request
+ * @param headers	The headers of the request
+ * @param expected	The status of a successful response
+ * @return bool		True if the service accepted the message
  */
-bool NorthService::sendToDispatcher(const string& path, const string& payload)
+bool NorthService::sendControl(const string& serviceName, const string& method,
+				const string& path, const string& payload,
+				SimpleWeb::CaseInsensitiveMultimap& headers,
+				const string& expected)
 {
-	// Send the control message to the south service
-	try {
-		ServiceRecord service("dispatcher");
-		if (!m_mgtClient->getService(service))
+	lock_guard<mutex> guard(m_controlMutex);
+	for (int attempt = 0; attempt < 2; attempt++)
+	{
+		SimpleWeb::Client<SimpleWeb::HTTP> *client;
+		auto it = m_controlClients.find(serviceName);
+		if (it != m_controlClients.end())
 		{
-			Logger::getLogger()->error("Unable to find dispatcher service 'Dispatcher'");
-			return false;
+			client = it->second;
 		}
-		string address = service.getAddress();
-		unsigned short port = service.getPort();
-		char addressAndPort[80];
-		snprintf(addressAndPort, sizeof(addressAndPort), "%s:%d", address.c_str(), port);
-		SimpleWeb::Client<SimpleWeb::HTTP> http(addressAndPort);
-
-		try {
-			SimpleWeb::CaseInsensitiveMultimap headers = {{"Content-Type", "application/json"}};
-			// Pass North service bearer token to dispatcher
-			string regToken = m_mgtClient->getRegistrationBearerToken();
-			if (regToken != "")
-			{
-				headers.emplace("Authorization", "Bearer " + regToken);
+		else
+		{
+			try {
+				ServiceRecord service(serviceName);
+				if (!m_mgtClient->getService(service))
+				{
+					Logger::getLogger()->error("Unable to find service '%s'", serviceName.c_str());
+					return false;
+				}
+				char addressAndPort[80];
+				snprintf(addressAndPort, sizeof(addressAndPort), "%s:%d",
+						service.getAddress().c_str(), service.getPort());
+				client = new SimpleWeb::Client<SimpleWeb::HTTP>(addressAndPort);
+				m_controlClients[serviceName] = client;
+			} catch (exception& e) {
+				Logger::getLogger()->error("Failed to send control operation to service %s, %s",
+						serviceName.c_str(), e.what());
+				return false;
 			}
+		}
 
-			auto res = http.request("POST", path, payload, headers);
-			if (res->status_code.compare("202 Accepted"))
+		try {
+			auto res = client->request(method, path, payload, headers);
+			if (res->status_code.compare(expected))
 			{
-				Logger::getLogger()->error("Failed to send control operation to dispatcher service, %s",
-							res->status_code.c_str());
+				Logger::getLogger()->error("Failed to send control operation to service %s, %s",
+						serviceName.c_str(), res->status_code.c_str());
 				return false;
 			}
+			return true;
 		} catch (exception& e) {
-			Logger::getLogger()->error("Failed to send control operation to dispatcher service, %s",
-						e.what());
-			return false;
+			delete client;
+			m_controlClients.erase(serviceName);
+			m_mgtClient->invalidateService(serviceName);
+			if (attempt)
+			{
+				Logger::getLogger()->error("Failed to send control operation to service %s, %s",
+						serviceName.c_str(), e.what());
+			}
 		}
-
-		return true;
-	}
-	catch (exception &e) {
-		Logger::getLogger()->error("Failed to send control operation to dispatcher service, %s", e.what());
-		return false;
 	}
-
+	return false;
 }
@@ -0,0 +1,491 @@
+/*
+ * Fledge north service retry spool.
+ *
+ * Copyright (c) 2026 Dianomic Systems
+ *
+ * Released under the Apache 2.0 Licence
+ *
+ * Author: agent
+ */
+#include <retry_spool.h>
+#include <reading_stream_payload.h>
+#include <sstream>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <dirent.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <string.h>
+#include <stdio.h>
+#include <errno.h>
+
+using namespace std;
+
+/**
+ * Append a fixed size value to a block
+ */
+template<typename T> static inline void put(string& block, T value)
+{
+	block.append((const char *)&value, sizeof(T));
+}
+
+/**
+ * Extract a fixed size value from a block, advancing the pointer
+ *
+ * @return bool	False if the value would overrun the block
+ */
+template<typename T> static inline bool get(const char *& ptr, const char *end, T& value)
+{
+	if (ptr + sizeof(T) > end)
+		return false;
+	memcpy(&value, ptr, sizeof(T));
+	ptr += sizeof(T);
+	return true;
+}
+
+/**
+ * Create a directory and any missing parent directories
+ *
+ * @param path	The directory to create
+ * @return bool	True if the directory exists
+ */
+static bool makeDirectory(const string& path)
+{
+	for (size_t pos = path.find('/', 1); ; pos = path.find('/', pos + 1))
+	{
+		string dir = path.substr(0, pos);
+		if (mkdir(dir.c_str(), 0750) == -1 && errno != EEXIST)
+		{
+			return false;
+		}
+		if (pos == string::npos)
+		{
+			return true;
+		}
+	}
+}
+
+/**
+ * Construct a retry spool. Any blocks left in the spool directory
+ * by a previous run of the service are spooled to be sent again.
+ *
+ * @param directory	The directory for the block files
+ */
+RetrySpool::RetrySpool(const string& directory) :
+	m_directory(directory), m_maxDisk(0), m_nextSequence(1), m_diskBytes(0)
+{
+	m_logger = Logger::getLogger();
+	recover();
+}
+
+/**
+ * Set the disk space the spooled blocks may use
+ *
+ * @param bytes	The bytes of spooled blocks allowed on disk, 0 to spool no new blocks
+ */
+void RetrySpool::setMaxDisk(uint64_t bytes)
+{
+	lock_guard<mutex> guard(m_mutex);
+	m_maxDisk = bytes;
+}
+
+/**
+ * Find the blocks left by a previous run of the service. A block file
+ * that was still being written when the service stopped is removed,
+ * the readings of that block were not acknowledged.
+ */
+void RetrySpool::recover()
+{
+	DIR *dir = opendir(m_directory.c_str());
+	if (!dir)
+	{
+		return;
+	}
+	struct dirent *entry;
+	while ((entry = readdir(dir)) != NULL)
+	{
+		unsigned long long sequence;
+		char suffix[8];
+		if (sscanf(entry->d_name, "block-%llu.%7s", &sequence, suffix) != 2)
+		{
+			continue;
+		}
+		string path = m_directory + "/" + entry->d_name;
+		struct stat st;
+		if (strcmp(suffix, "retry") != 0 || stat(path.c_str(), &st) == -1)
+		{
+			unlink(path.c_str());
+			continue;
+		}
+		RetryBlock block;
+		block.size = (uint64_t)st.st_size;
+		block.taken = false;
+		m_blocks[sequence] = block;
+		m_diskBytes += block.size;
+		if (sequence >= m_nextSequence)
+		{
+			m_nextSequence = sequence + 1;
+		}
+	}
+	closedir(dir);
+	if (!m_blocks.empty())
+	{
+		m_logger->warn("%lu blocks of readings the plugin failed to send before the service was restarted will be sent first",
+				(unsigned long)m_blocks.size());
+	}
+}
+
+/**
+ * Return the path of the file of a block
+ *
+ * @param sequence	The sequence number of the block
+ */
+string RetrySpool::blockPath(uint64_t sequence) const
+{
+	char name[64];
+	snprintf(name, sizeof(name), "/block-%020llu.retry", (unsigned long long)sequence);
+	return m_directory + name;
+}
+
+/**
+ * Add a block of readings to the spool. The block is taken by the
+ * caller, which remains the owner of the readings and continues to
+ * send them. The readings are on disk when the call returns.
+ *
+ * @param readings	The block of readings
+ * @return uint64_t	The sequence number of the block, 0 if the
+ *			block could not be spooled
+ */
+uint64_t RetrySpool::push(ReadingSet *readings)
+{
+	uint64_t sequence;
+	{
+		lock_guard<mutex> guard(m_mutex);
+		if (m_diskBytes >= m_maxDisk)
+		{
+			return 0;
+		}
+		sequence = m_nextSequence++;
+	}
+	if (!makeDirectory(m_directory))
+	{
+		m_logger->error("Unable to create the retry spool directory %s: %s",
+				m_directory.c_str(), strerror(errno));
+		return 0;
+	}
+	uint64_t size;
+	if (!writeBlock(sequence, readings, size))
+	{
+		return 0;
+	}
+	lock_guard<mutex> guard(m_mutex);
+	RetryBlock block;
+	block.size = size;
+	block.taken = true;
+	m_blocks[sequence] = block;
+	m_diskBytes += size;
+	return sequence;
+}
+
+/**
+ * Take the oldest block that is not already being sent. A block that
+ * can not be read is logged and discarded.
+ *
+ * @param sequence	Set to the sequence number of the block
+ * @return ReadingSet*	The readings of the block, NULL if there is no
+ *			block to send
+ */
+ReadingSet *RetrySpool::take(uint64_t& sequence)
+{
+	while (true)
+	{
+		{
+			lock_guard<mutex> guard(m_mutex);
+			auto it = m_blocks.begin();
+			while (it != m_blocks.end() && it->second.taken)
+			{
+				++it;
+			}
+			if (it == m_blocks.end())
+			{
+				return NULL;
+			}
+			it->second.taken = true;
+			sequence = it->first;
+		}
+		ReadingSet *readings = readBlock(sequence);
+		if (readings)
+		{
+			return readings;
+		}
+		remove(sequence);
+	}
+}
+
+/**
+ * Rewrite a block after some of its readings have been sent, so that
+ * only the readings still to be sent are sent after a restart
+ *
+ * @param sequence	The sequence number of the block
+ * @param readings	The readings still to be sent
+ */
+void RetrySpool::update(uint64_t sequence, ReadingSet *readings)
+{
+	uint64_t size;
+	if (!writeBlock(sequence, readings, size))
+	{
+		// The previous file is kept, its sent readings are sent again after a restart
+		return;
+	}
+	lock_guard<mutex> guard(m_mutex);
+	auto it = m_blocks.find(sequence);
+	if (it != m_blocks.end())
+	{
+		m_diskBytes -= it->second.size;
+		m_diskBytes += size;
+		it->second.size = size;
+	}
+}
+
+/**
+ * Remove a block once all of its readings have been sent
+ *
+ * @param sequence	The sequence number of the block
+ */
+void RetrySpool::remove(uint64_t sequence)
+{
+	unlink(blockPath(sequence).c_str());
+	lock_guard<mutex> guard(m_mutex);
+	auto it = m_blocks.find(sequence);
+	if (it != m_blocks.end())
+	{
+		m_diskBytes -= it->second.size;
+		m_blocks.erase(it);
+	}
+}
+
+/**
+ * Return the blocks and bytes held in the spool
+ *
+ * @param json	Set to the JSON object of the spool
+ */
+void RetrySpool::asJSON(string& json) const
+{
+	lock_guard<mutex> guard(m_mutex);
+	ostringstream convert;
+	convert << "{ \"blocks\" : " << m_blocks.size() << ", \"bytes\" : " << m_diskBytes << " }";
+	json = convert.str();
+}
+
+/**
+ * Write the file of a block. The block is written to a temporary file
+ * that is synchronised to disk and then renamed, so the file of a block
+ * always holds a complete block.
+ *
+ * @param sequence	The sequence number of the block
+ * @param readings	The readings of the block
+ * @param size		Set to the bytes of the file
+ * @return bool		False if the block could not be written
+ */
+bool RetrySpool::writeBlock(uint64_t sequence, ReadingSet *readings, uint64_t& size)
+{
+	string block;
+	encode(readings, block);
+
+	string path = blockPath(sequence);
+	string tmp = path + ".tmp";
+	int fd = open(tmp.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0640);
+	if (fd == -1)
+	{
+		m_logger->error("Unable to create the retry spool file %s: %s",
+				tmp.c_str(), strerror(errno));
+		return false;
+	}
+	const char *ptr = block.data();
+	size_t remaining = block.length();
+	while (remaining > 0)
+	{
+		ssize_t n = ::write(fd, ptr, remaining);
+		if (n == -1 && errno == EINTR)
+		{
+			continue;
+		}
+		if (n <= 0)
+		{
+			break;
+		}
+		ptr += n;
+		remaining -= (size_t)n;
+	}
+	if (remaining > 0 || fsync(fd) == -1)
+	{
+		m_logger->error("Unable to write the retry spool file %s: %s",
+				tmp.c_str(), strerror(errno));
+		close(fd);
+		unlink(tmp.c_str());
+		return false;
+	}
+	close(fd);
+	if (rename(tmp.c_str(), path.c_str()) == -1)
+	{
+		m_logger->error("Unable to rename the retry spool file %s: %s",
+				tmp.c_str(), strerror(errno));
+		unlink(tmp.c_str());
+		return false;
+	}
+	// The rename is only durable once the directory is synchronised
+	int dirfd = open(m_directory.c_str(), O_RDONLY | O_DIRECTORY);
+	if (dirfd != -1)
+	{
+		fsync(dirfd);
+		close(dirfd);
+	}
+	size = block.length();
+	return true;
+}
+
+/**
+ * Read the file of a block
+ *
+ * @param sequence	The sequence number of the block
+ * @return ReadingSet*	The readings of the block, NULL if the file
+ *			could not be read
+ */
+ReadingSet *RetrySpool::readBlock(uint64_t sequence)
+{
+	string path = blockPath(sequence);
+	int fd = open(path.c_str(), O_RDONLY);
+	if (fd == -1)
+	{
+		m_logger->error("Unable to open the retry spool file %s: %s",
+				path.c_str(), strerror(errno));
+		return NULL;
+	}
+	string block;
+	char buffer[65536];
+	ssize_t n;
+	while ((n = ::read(fd, buffer, sizeof(buffer))) != 0)
+	{
+		if (n == -1)
+		{
+			if (errno == EINTR)
+				continue;
+			m_logger->error("Unable to read the retry spool file %s: %s",
+					path.c_str(), strerror(errno));
+			close(fd);
+			return NULL;
+		}
+		block.append(buffer, (size_t)n);
+	}
+	close(fd);
+
+	RetryBlockHeader header;
+	memset(&header, 0, sizeof(header));	// A short file leaves it unread
+	const char *ptr = block.data();
+	const char *end = ptr + block.length();
+	if (!get(ptr, end, header) || header.magic != RETRY_BLOCK_MAGIC
+			|| header.version != RETRY_VERSION || header.length != (uint64_t)(end - ptr))
+	{
+		m_logger->error("The retry spool file %s is not a valid block, %u readings have been discarded",
+				path.c_str(), header.magic == RETRY_BLOCK_MAGIC ? header.count : 0);
+		return NULL;
+	}
+	return decode(ptr, header);
+}
+
+/**
+ * Encode a block of readings in the compact binary format of the spool
+ *
+ * @param readings	The block of readings
+ * @param block		The buffer the block is written to
+ */
+void RetrySpool::encode(ReadingSet *readings, string& block)
+{
+	const vector<Reading *>& vec = readings->getAllReadings();
+	RetryBlockHeader header;
+	header.magic = RETRY_BLOCK_MAGIC;
+	header.version = RETRY_VERSION;
+	header.count = (uint32_t)vec.size();
+	header.reserved = 0;
+	header.length = 0;
+	put(block, header);
+	string payload;
+	for (auto reading : vec)
+	{
+		const string& asset = reading->getAssetName();
+		struct timeval userTs, ts;
+		reading->getUserTimestamp(&userTs);
+		reading->getTimestamp(&ts);
+		put(block, (uint64_t)reading->getId());
+		put(block, (uint32_t)asset.length());
+		block.append(asset);
+		put(block, (int64_t)userTs.tv_sec);
+		put(block, (int64_t)userTs.tv_usec);
+		put(block, (int64_t)ts.tv_sec);
+		put(block, (int64_t)ts.tv_usec);
+		ReadingStreamPayload::encode(*reading, payload);
+		put(block, (uint32_t)payload.length());
+		block.append(payload);
+	}
+	header.length = block.length() - sizeof(header);
+	memcpy(&block[0], &header, sizeof(header));
+}
+
+/**
+ * Recreate a block of readings from its encoding. A reading that can
+ * not be decoded is logged and dropped.
+ *
+ * @param data		The readings of the block
+ * @param header	The header of the block
+ * @return ReadingSet*	The block of readings
+ */
+ReadingSet *RetrySpool::decode(const char *data, const RetryBlockHeader& header)
+{
+	vector<Reading *> readings;
+	readings.reserve(header.count);
+	const char *ptr = data;
+	const char *end = data + header.length;
+	for (uint32_t i = 0; i < header.count; i++)
+	{
+		uint64_t id;
+		uint32_t assetLength, payloadLength;
+		int64_t userSec, userUsec, tsSec, tsUsec;
+		if (!get(ptr, end, id) || !get(ptr, end, assetLength) || ptr + assetLength > end)
+		{
+			break;
+		}
+		string asset(ptr, assetLength);
+		ptr += assetLength;
+		if (!get(ptr, end, userSec) || !get(ptr, end, userUsec)
+				|| !get(ptr, end, tsSec) || !get(ptr, end, tsUsec)
+				|| !get(ptr, end, payloadLength) || ptr + payloadLength > end)
+		{
+			break;
+		}
+		vector<Datapoint *> datapoints;
+		bool decoded = ReadingStreamPayload::decode(ptr, payloadLength, datapoints);
+		ptr += payloadLength;
+		if (!decoded)
+		{
+			m_logger->error("Unable to decode a spooled reading of asset %s, it has been discarded",
+					asset.c_str());
+			continue;
+		}
+		Reading *reading = new Reading(asset, datapoints);
+		struct timeval userTs, ts;
+		userTs.tv_sec = (time_t)userSec;
+		userTs.tv_usec = (suseconds_t)userUsec;
+		ts.tv_sec = (time_t)tsSec;
+		ts.tv_usec = (suseconds_t)tsUsec;
+		reading->setId((unsigned long)id);
+		reading->setUserTimestamp(userTs);
+		reading->setTimestamp(ts);
+		readings.push_back(reading);
+	}
+	if (readings.size() < header.count)
+	{
+		m_logger->error("%lu spooled readings could not be decoded",
+				(unsigned long)(header.count - readings.size()));
+	}
+	return new ReadingSet(&readings);
+}
@@ -59,6 +59,15 @@ bool plugin_deliver_fn(PLUGIN_HANDLE handle,
 // Substitute string values with known data types
 bool substituteObjects(PyObject *data, vector<PyObject*> &removeObjects);
 
+/*
+ * The data of the last rule evaluation, converted to Python objects.
+ * Rules that watch the same assets are evaluated in turn with the same
+ * data, which is then converted once only. Only accessed with the GIL held.
+ */
+static string			lastEvalJSON;
+static PyObject			*lastEvalData = NULL;
+static vector<PyObject *>	lastEvalObjects;
+
 /**
  * Constructor for PythonPluginHandle
  *    - Set sys.path and sys.argv
@@ -458,6 +467,50 @@ std::string plugin_reason_fn(PLUGIN_HANDLE handle)
 	return ret;
 }
 
+/**
+ * Return the Python objects for the data of a rule evaluation, the
+ * conversion of the data of the previous evaluation is reused if
+ * the data is the same.
+ *
+ * Each rule is given its own copy of the dictionary of assets, the
+ * datapoints of the assets are shared by the rules and must not be
+ * modified by them.
+ *
+ * The caller must hold the GIL.
+ *
+ * @param    assetValues	JSON string with asset data to evaluate
+ * @return			New reference to the data or NULL on error
+ */
+static PyObject *evalData(const string& assetValues)
+{
+	if (lastEvalData && assetValues == lastEvalJSON)
+	{
+		return PyDict_Copy(lastEvalData);
+	}
+
+	Py_CLEAR(lastEvalData);
+	for (auto& object : lastEvalObjects)
+	{
+		Py_CLEAR(object);
+	}
+	lastEvalObjects.clear();
+	lastEvalJSON.clear();
+
+	PyObject *data = json_loads(assetValues.c_str());
+	if (!data || !PyDict_Check(data))
+	{
+		return data;
+	}
+
+	// Replace content of some known string data:
+	// DPImage
+	substituteObjects(data, lastEvalObjects);
+
+	lastEvalJSON = assetValues;
+	lastEvalData = data;
+	return PyDict_Copy(data);
+}
+
 /**
  * Function to invoke 'plugin_eval' function in notification rule python plugin
  *
@@ -532,18 +585,22 @@ bool plugin_eval_fn(PLUGIN_HANDLE handle,
 	}
 
 	// Call Python method passing an object and the data as C string
-	PyObject *evalData = json_loads(assetValues.c_str());
-
-	vector<PyObject*> removeObjects;
-	// Replace content of some known string data:
-	// DPImage
-	substituteObjects(evalData, removeObjects);
+	PyObject *data = evalData(assetValues);
+	if (!data)
+	{
+		Logger::getLogger()->error("Unable to convert the data to evaluate "
+					   "for python module '%s'",
+					   it->second->m_name.c_str());
+		Py_CLEAR(pFunc);
+		PyGILState_Release(state);
+		return ret;
+	}
 
 	// Call plugin_eval
 	PyObject* pReturn = PyObject_CallFunction(pFunc,
 						  "OO",
 						  handle,
-						  evalData);
+						  data);
 
 	Py_CLEAR(pFunc);
 
@@ -565,18 +622,9 @@ bool plugin_eval_fn(PLUGIN_HANDLE handle,
 	}
 
 	// REmove objects
-	Py_CLEAR(evalData);
+	Py_CLEAR(data);
 	Py_CLEAR(pReturn);
 
-	// Remove any allocated object in substituteObjects()
-	for (auto it = removeObjects.begin();
-		  it != removeObjects.end();
-		  ++it)
-	{
-		Py_CLEAR(*it);
-	}
-	removeObjects.clear();
-
 	PyGILState_Release(state);
 
 	return ret;
@@ -660,7 +708,7 @@ void notification_plugin_reconfigure_fn(PLUGIN_HANDLE handle,
 	Logger::getLogger()->debug("plugin_reconfigure with %s", config.c_str());
 
 	// Create Python object from string
-	PyObject *config_dict = json_loads(config.c_str());
+	PyObject *config_dict = config_loads(config, it->second);
 
 	// Call Python method passing the Python object
 	PyObject* pReturn = PyObject_CallFunction(pFunc,
@@ -874,7 +922,7 @@ bool substituteObjects(PyObject *data, vector<PyObject*> &removeObjects)
 						if (str.compare(2, 7, "DPIMAGE") == 0)
 						{
 							PyObject *newImage = NULL;
-							DPImage *image = new Base64DPImage(str.substr(pos + 1));
+							DPImage *image = new Base64DPImage(str.data() + pos + 1, str.length() - pos - 1);
 
 							Logger::getLogger()->debug("Inner key '%s' will be "
 										"substituted with a DPImage of %dx%d@%d",
@@ -949,7 +997,7 @@ bool substituteObjects(PyObject *data, vector<PyObject*> &removeObjects)
 						if (str.compare(2, 10, "DATABUFFER") == 0)
 						{
 							PyObject *newImage = NULL;
-							DataBuffer *dbuf = new Base64DataBuffer(str.substr(pos + 1));
+							DataBuffer *dbuf = new Base64DataBuffer(str.data() + pos + 1, str.length() - pos - 1);
 							npy_intp dim = dbuf->getItemCount();
 							enum NPY_TYPES type;
 							bool createImage = true;
@@ -80,10 +80,14 @@ void plugin_ingest_fn(PyObject *ingest_callback, PyObject *ingest_obj_ref_data,
 		return;
 	}
 
-    PyObject* objectsRepresentation = PyObject_Repr(readingsObj);
-    const char* s = PyUnicode_AsUTF8(objectsRepresentation);
-    Logger::getLogger()->debug("%s:%s:L%d : Py2C: filtered readings=%s", __FILE__, __FUNCTION__, __LINE__, s);
-    Py_CLEAR(objectsRepresentation);
+    // The representation of the readings is only built when it will be logged
+    if (Logger::getLogger()->getMinLevel().compare("debug") == 0)
+    {
+        PyObject* objectsRepresentation = PyObject_Repr(readingsObj);
+        const char* s = PyUnicode_AsUTF8(objectsRepresentation);
+        Logger::getLogger()->debug("%s:%s:L%d : Py2C: filtered readings=%s", __FILE__, __FUNCTION__, __LINE__, s);
+        Py_CLEAR(objectsRepresentation);
+    }
 
     PythonReadingSet *pyReadingSet = NULL;
 
@@ -103,7 +107,13 @@ void plugin_ingest_fn(PyObject *ingest_callback, PyObject *ingest_obj_ref_data,
 	{
 		INGEST_CB2 cb = (INGEST_CB2) PyCapsule_GetPointer(ingest_callback, NULL);
 		void *data = PyCapsule_GetPointer(ingest_obj_ref_data, NULL);
+
+		// The readings are converted, the whole set is handed to the ingest
+		// queue without holding the GIL so that other Python threads of the
+		// plugin are not blocked whilst the ingest queue is locked
+		Py_BEGIN_ALLOW_THREADS
 		(*cb)(data, pyReadingSet);
+		Py_END_ALLOW_THREADS
 	}
 	else
 		Logger::getLogger()->error("Py2C interface: plugin_ingest_fn: PythonReadingSet c'tor returned NULL");
@@ -0,0 +1,262 @@
+/*
+ * Fledge south service change of value suppression.
+ *
+ * Copyright (c) 2026 Dianomic Systems
+ *
+ * Released under the Apache 2.0 Licence
+ *
+ * Author: agent
+ */
+#include <change_of_value.h>
+#include <logger.h>
+#include <functional>
+#include <cmath>
+
+using namespace std;
+
+/**
+ * Construct the change of value suppression, initially disabled
+ */
+ChangeOfValue::ChangeOfValue() : m_mode(COV_DISABLED), m_deadband(0.0),
+	m_maxSilence(0.0), m_suppressed(0)
+{
+}
+
+/**
+ * Configure the change of value suppression. The last values are
+ * discarded whenever the configuration changes so that the next value
+ * of every datapoint is passed.
+ *
+ * @param mode		The mode, "Disabled", "Asset" or "Datapoint"
+ * @param deadband	The change in a numeric value that is significant
+ * @param maxSilence	The maximum seconds between values passed, 0 for no limit
+ */
+void ChangeOfValue::configure(const string& mode, double deadband, double maxSilence)
+{
+	Mode newMode = COV_DISABLED;
+	if (mode.compare("Asset") == 0)
+	{
+		newMode = COV_ASSET;
+	}
+	else if (mode.compare("Datapoint") == 0)
+	{
+		newMode = COV_DATAPOINT;
+	}
+	else if (mode.compare("Disabled") != 0)
+	{
+		Logger::getLogger()->error("Unrecognised change of value mode '%s', change of value disabled",
+				mode.c_str());
+	}
+	deadband = fabs(deadband);
+
+	lock_guard<mutex> guard(m_mutex);
+	if (newMode == m_mode && deadband == m_deadband && maxSilence == m_maxSilence)
+	{
+		return;
+	}
+	m_mode = newMode;
+	m_deadband = deadband;
+	m_maxSilence = maxSilence;
+	m_values.clear();
+}
+
+/**
+ * Remove the readings, or datapoints of readings, that have not changed
+ * from a block of readings. The removed readings are deleted.
+ *
+ * @param readings	The block of readings
+ * @return size_t	The number of readings removed
+ */
+size_t ChangeOfValue::process(vector<Reading *> *readings)
+{
+	lock_guard<mutex> guard(m_mutex);
+	if (m_mode == COV_DISABLED)
+	{
+		return 0;
+	}
+	size_t kept = 0;
+	for (size_t i = 0; i < readings->size(); i++)
+	{
+		Reading *reading = (*readings)[i];
+		struct timeval tv;
+		reading->getUserTimestamp(&tv);
+		if (passReading(reading, tv.tv_sec + ((double)tv.tv_usec / 1000000)))
+		{
+			(*readings)[kept++] = reading;
+		}
+		else
+		{
+			delete reading;
+		}
+	}
+	size_t removed = readings->size() - kept;
+	readings->resize(kept);
+	m_suppressed += removed;
+	return removed;
+}
+
+/**
+ * Determine if a reading should be passed. A reading of an asset whose
+ * name is not interned, once the table of names is full, is always passed.
+ *
+ * @param reading	The reading
+ * @param timestamp	The user timestamp of the reading
+ * @return bool		True if the reading should be passed
+ */
+bool ChangeOfValue::passReading(Reading *reading, double timestamp)
+{
+	if (reading->getReadingData().empty() || !reading->getInternedAssetName().interned())
+	{
+		return true;
+	}
+	if (m_mode == COV_ASSET)
+	{
+		return passAsset(reading, timestamp);
+	}
+	return passDatapoints(reading, timestamp);
+}
+
+/**
+ * Determine if any datapoint of a reading has changed, if so the
+ * last values of all the datapoints of the asset are updated.
+ *
+ * The time the asset was last passed is held in the entry for the
+ * asset with a datapoint id of 0, which no interned string has.
+ *
+ * @param reading	The reading
+ * @param timestamp	The user timestamp of the reading
+ * @return bool		True if the reading should be passed
+ */
+bool ChangeOfValue::passAsset(Reading *reading, double timestamp)
+{
+	uint32_t asset = reading->getInternedAssetName().id();
+	vector<Datapoint *>& datapoints = reading->getReadingData();
+
+	bool changed = false;
+	auto it = m_values.find(key(asset, 0));
+	if (it == m_values.end() || silent(it->second, timestamp))
+	{
+		changed = true;
+	}
+	for (size_t i = 0; i < datapoints.size() && !changed; i++)
+	{
+		const InternedString& name = datapoints[i]->getInternedName();
+		auto dp = m_values.find(key(asset, name.id()));
+		if (!name.interned() || dp == m_values.end() || hasChanged(datapoints[i], dp->second))
+		{
+			changed = true;
+		}
+	}
+	if (!changed)
+	{
+		return false;
+	}
+	for (auto& datapoint : datapoints)
+	{
+		if (datapoint->getInternedName().interned())
+		{
+			update(datapoint, m_values[key(asset, datapoint->getInternedName().id())], timestamp);
+		}
+	}
+	m_values[key(asset, 0)].m_sent = timestamp;
+	return true;
+}
+
+/**
+ * Remove the datapoints of a reading that have not changed
+ *
+ * @param reading	The reading
+ * @param timestamp	The user timestamp of the reading
+ * @return bool		True if any datapoints remain in the reading
+ */
+bool ChangeOfValue::passDatapoints(Reading *reading, double timestamp)
+{
+	uint32_t asset = reading->getInternedAssetName().id();
+	vector<Datapoint *>& datapoints = reading->getReadingData();
+
+	size_t kept = 0;
+	for (size_t i = 0; i < datapoints.size(); i++)
+	{
+		Datapoint *datapoint = datapoints[i];
+		if (!datapoint->getInternedName().interned())
+		{
+			datapoints[kept++] = datapoint;
+			continue;
+		}
+		uint64_t k = key(asset, datapoint->getInternedName().id());
+		auto it = m_values.find(k);
+		if (it == m_values.end())
+		{
+			update(datapoint, m_values[k], timestamp);
+			datapoints[kept++] = datapoint;
+		}
+		else if (silent(it->second, timestamp) || hasChanged(datapoint, it->second))
+		{
+			update(datapoint, it->second, timestamp);
+			datapoints[kept++] = datapoint;
+		}
+		else
+		{
+			delete datapoint;
+		}
+	}
+	datapoints.resize(kept);
+	return kept > 0;
+}
+
+/**
+ * Compare the value of a datapoint with the last value passed
+ *
+ * @param datapoint	The datapoint
+ * @param last		The last value passed
+ * @return bool		True if the value has changed
+ */
+bool ChangeOfValue::hasChanged(Datapoint *datapoint, const LastValue& last) const
+{
+	DatapointValue& value = datapoint->getData();
+	switch (value.getType())
+	{
+		case DatapointValue::T_INTEGER:
+		case DatapointValue::T_FLOAT:
+		{
+			if (!last.m_numeric)
+			{
+				return true;
+			}
+			double v = value.getType() == DatapointValue::T_INTEGER ?
+					(double)value.toInt() : value.toDouble();
+			double delta = fabs(v - last.m_value);
+			return m_deadband > 0.0 ? delta > m_deadband : delta != 0.0;
+		}
+		default:
+			return last.m_numeric || hash<string>()(value.toString()) != last.m_digest;
+	}
+}
+
+/**
+ * Record the value of a datapoint that has been passed
+ *
+ * @param datapoint	The datapoint
+ * @param last		The last value entry to update
+ * @param timestamp	The user timestamp of the reading
+ */
+void ChangeOfValue::update(Datapoint *datapoint, LastValue& last, double timestamp)
+{
+	DatapointValue& value = datapoint->getData();
+	switch (value.getType())
+	{
+		case DatapointValue::T_INTEGER:
+			last.m_numeric = true;
+			last.m_value = (double)value.toInt();
+			break;
+		case DatapointValue::T_FLOAT:
+			last.m_numeric = true;
+			last.m_value = value.toDouble();
+			break;
+		default:
+			last.m_numeric = false;
+			last.m_digest = hash<string>()(value.toString());
+			break;
+	}
+	last.m_sent = timestamp;
+}
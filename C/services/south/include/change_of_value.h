@@ -0,0 +1,80 @@
+#ifndef _CHANGE_OF_VALUE_H
+#define _CHANGE_OF_VALUE_H
+/*
+ * Fledge south service change of value suppression.
+ *
+ * Copyright (c) 2026 Dianomic Systems
+ *
+ * Released under the Apache 2.0 Licence
+ *
+ * Author: agent
+ */
+#include <reading.h>
+#include <vector>
+#include <string>
+#include <mutex>
+#include <atomic>
+#include <unordered_map>
+#include <stdint.h>
+
+/**
+ * Removes readings, or datapoints, whose values have not changed since
+ * they were last passed on by the south service.
+ *
+ * In asset mode a reading is passed if any of its datapoints has changed,
+ * otherwise the whole reading is removed. In datapoint mode each datapoint
+ * is considered on its own and a reading is only removed once none of its
+ * datapoints remain.
+ *
+ * A numeric value has changed if it differs from the last value passed by
+ * more than the deadband, any change is significant if the deadband is 0.
+ * Other values are compared by a hash of their string form. A value is
+ * always passed if nothing has been passed for longer than the maximum
+ * silence interval, measured by the user timestamps of the readings.
+ *
+ * The last values are held in a table keyed by the interned asset and
+ * datapoint names, so the table only grows with the number of distinct
+ * datapoints of the service. Names that are not interned, once the
+ * table of names is full, are always passed.
+ */
+class ChangeOfValue {
+	public:
+		typedef enum { COV_DISABLED, COV_ASSET, COV_DATAPOINT } Mode;
+
+		ChangeOfValue();
+		void		configure(const std::string& mode, double deadband, double maxSilence);
+		bool		isEnabled() const { return m_mode != COV_DISABLED; };
+		size_t		process(std::vector<Reading *> *readings);
+		unsigned long	getSuppressed() const { return m_suppressed; };
+	private:
+		typedef struct {
+			bool		m_numeric;	// The last value passed was numeric
+			double		m_value;	// Last numeric value passed
+			size_t		m_digest;	// Hash of the last other value passed
+			double		m_sent;		// User timestamp when last passed
+		} LastValue;
+
+		bool		passReading(Reading *reading, double timestamp);
+		bool		passAsset(Reading *reading, double timestamp);
+		bool		passDatapoints(Reading *reading, double timestamp);
+		bool		hasChanged(Datapoint *datapoint, const LastValue& last) const;
+		void		update(Datapoint *datapoint, LastValue& last, double timestamp);
+		bool		silent(const LastValue& last, double timestamp) const
+				{
+					return m_maxSilence > 0.0 && timestamp - last.m_sent >= m_maxSilence;
+				};
+		static uint64_t	key(uint32_t asset, uint32_t datapoint)
+				{
+					return ((uint64_t)asset << 32) | datapoint;
+				};
+	private:
+		std::mutex	m_mutex;
+		Mode		m_mode;
+		double		m_deadband;
+		double		m_maxSilence;
+		std::unordered_map<uint64_t, LastValue>
+				m_values;
+		std::atomic<unsigned long>
+				m_suppressed;	// Readings removed
+};
+#endif
@@ -21,10 +21,30 @@ static struct {
 			"Maximum time to spend filling buffer before sending", "integer", "5000" },
 	{ "bufferThreshold",	"Maximum buffered Readings",
 			"Number of readings to buffer before sending", "integer", "100" },
+	{ "adaptiveBatching",	"Adaptive Batching",
+			"Predict the arrival of readings to decide when to send a block, rather than waiting a fixed part of the maximum latency", "boolean", "false" },
 	{ "readingsPerSec",	"Reading Rate",
 			"Number of readings to generate per interval", "integer", "1" },
 	{ "throttle",	"Throttle",
 			"Enable flow control by reducing the poll rate", "boolean", "false" },
+	{ "slabAllocation",	"Slab Allocation",
+			"Allocate readings from reusable slabs of memory rather than the heap", "boolean", "false" },
+	{ "memoryLimit",	"Memory Limit (MB)",
+			"The memory buffered readings may use before readings are discarded by the discard policy, 0 for no limit", "integer", "0" },
+	{ "discardSample",	"Discard Sample Interval",
+			"One in this many new readings is kept by the Sample discard policy", "integer", "10" },
+	{ "changeDeadband",	"Change Deadband",
+			"The change in a numeric value that is passed when change of value is enabled, 0 passes any change", "float", "0" },
+	{ "maxSilence",	"Maximum Silence (s)",
+			"The longest time for which an unchanged value is not passed when change of value is enabled, 0 for no limit", "integer", "300" },
+	{ "threadConfig",	"Thread Configuration",
+			"The CPU affinity and scheduling policy of the threads of the service, by thread role", "JSON", "{}" },
+	{ "allocatorConfig",	"Allocator Configuration",
+			"The tuning options of the memory allocator of the service", "JSON", "{}" },
+	{ "asyncLogging",	"Asynchronous Logging",
+			"Write log messages from a separate thread so that logging does not delay the service", "boolean", "false" },
+	{ "pythonPreload",	"Python Preload",
+			"A comma separated list of Python modules to import when the service starts, before the Python plugins and filters that use them are loaded", "string", "" },
 	{ NULL, NULL, NULL, NULL, NULL }
 };
 #endif
@@ -14,18 +14,37 @@
 #include <logger.h>
 #include <vector>
 #include <queue>
+#include <deque>
+#include <atomic>
 #include <thread>
 #include <chrono>
 #include <mutex>
 #include <sstream>
 #include <unordered_set>
+#include <unordered_map>
 #include <condition_variable>
 #include <filter_plugin.h>
 #include <filter_pipeline.h>
 #include <asset_tracking.h>
 #include <service_handler.h>
+#include <ingest_queue.h>
+#include <json_provider.h>
+#include <spill_queue.h>
+#include <change_of_value.h>
+#include <lag_statistics.h>
+#include <queue_metrics.h>
 
 #define SERVICE_NAME  "Fledge South"
+#define INGEST_RING_SIZE	16384	// Number of readings the lock free ingest queue can hold
+#define INGEST_WRITE_QUEUE	4	// Filtered blocks of readings queued for the storage writer
+#define STATS_FLUSH_INTERVAL	1000	// Minimum milliseconds between updates of the statistics table
+#define STATS_CREATE_BATCH	200	// Assets checked by each query for missing statistics rows
+#define FILTER_STATS_INTERVAL	1000	// Minimum milliseconds between snapshots of the filter statistics
+#define SPILL_RETRY_INTERVAL	500	// Milliseconds between attempts to replay readings whilst storage is failing
+#define MEMORY_LOW_WATER_PERCENT	75	// Percentage of the memory limit below which readings are accepted again
+#define BATCH_RATE_INTERVAL	100	// Minimum milliseconds between samples of the reading arrival rate
+#define BATCH_RATE_WEIGHT	0.25	// Weight of the latest sample in the moving average of the arrival rate
+#define MEMORY_RESEND_PERCENT	50	// Percentage of the memory limit blocks waiting for storage may use before spilling
 
 /**
  * The ingest class is used to ingest asset readings.
@@ -33,7 +52,7 @@
  * these are sent using a background thread that regularly
  * wakes up and sends the queued readings.
  */
-class Ingest : public ServiceHandler {
+class Ingest : public ServiceHandler, public JSONProvider {
 
 public:
 	Ingest(StorageClient& storage,
@@ -50,10 +69,12 @@ public:
     	bool		isStopping();
 	bool		isRunning() { return !m_shutdown; };
 	void		processQueue();
+	void		processWrites();
 	void		waitForQueue();
 	size_t		queueLength();
 	void		updateStats(void);
 	int 		createStatsDbEntry(const std::string& assetName);
+	void		createStatsDbEntries(const std::vector<std::string>& assetNames);
 
 	bool		loadFilters(const std::string& categoryName);
 	static void	passToOnwardFilter(OUTPUT_HANDLE *outHandle,
@@ -62,11 +83,29 @@ public:
 					READINGSET* readings);
 
 	void		setTimeout(const long timeout) { m_timeout = timeout; };
-	void		setThreshold(const unsigned int threshold) { m_queueSizeThreshold = threshold; };
+	void		setThreshold(const unsigned int threshold)
+			{
+				m_queueSizeThreshold = threshold;
+				m_readings.setThreshold(threshold);
+			};
+	void		setAdaptiveBatching(bool adaptive) { m_adaptiveBatching = adaptive; };
+	void		recordPolls(unsigned long polls, double seconds);
+	void		setPollThrottle(double rate);
+	void		setMemoryLimit(size_t bytes);
+	void		setDiscardPolicy(const std::string& policy, unsigned long sampleInterval);
+	size_t		memoryUsage() const { return m_queuedBytes + m_writeBytes + m_resendBytes; };
+	size_t		getMemoryLowWater() const { return m_memoryLow; };
+	size_t		getMemoryHighWater() const { return m_memoryHigh; };
+	unsigned long	getCommitLatency(double& mean, double& max);
+	void		setChangeOfValue(const std::string& mode, double deadband, double maxSilence)
+			{
+				m_changeOfValue.configure(mode, deadband, maxSilence);
+			};
 	void		configChange(const std::string&, const std::string&);
 	void		configChildCreate(const std::string& , const std::string&, const std::string&){};
 	void        configChildDelete(const std::string& , const std::string&){};
 	void		shutdown() {};	// Satisfy ServiceHandler
+	void		asJSON(std::string& json) const;
 
 private:
 	void				signalStatsUpdate() {
@@ -74,11 +113,24 @@ private:
 						std::lock_guard<std::mutex> guard(m_statsMutex);
 						m_statsCv.notify_all();
 					};
-	void				logDiscardedStat() {
+	void				logDiscardedStat(unsigned int count = 1) {
 						std::lock_guard<std::mutex> guard(m_statsMutex);
-						m_discardedReadings++;
+						m_discardedReadings += count;
 					};
+	bool				memoryFull();
+	Reading				*shedReading(Reading *reading);
+	void				drainConflated(std::vector<Reading *> *queue);
 	long				calculateWaitTime();
+	long				adaptiveWaitTime(size_t queued, long budget);
+	void				sampleArrivalRate();
+	void				queueForWrite(std::vector<Reading *> *readings);
+	void				writeReadings(std::vector<Reading *> *readings);
+	bool				resendReadings();
+	void				queueForResend(std::vector<Reading *> *readings);
+	void				recordStored(std::vector<Reading *> *readings);
+	void				createStallStats();
+	FilterPipeline			*createPipeline(const std::string& categoryName);
+	void				retirePipeline(FilterPipeline *pipeline);
 
 	StorageClient&			m_storage;
 	long				m_timeout;
@@ -89,31 +141,83 @@ private:
 	std::string 			m_pluginName;
 	ManagementClient		*m_mgtClient;
 	// New data: queued
-	std::vector<Reading *>*		m_queue;
-	std::mutex			m_qMutex;
+	IngestQueue			m_readings;
+	std::mutex			m_conflatedMutex;
 	std::mutex			m_statsMutex;
 	std::mutex			m_pipelineMutex;
 	std::thread*			m_thread;
 	std::thread*			m_statsThread;
+	std::thread*			m_writerThread;
+	// Filtered data waiting for the storage writer
+	std::deque<std::vector<Reading *>*>
+					m_writeQueue;
+	std::mutex			m_writeMutex;
+	std::condition_variable		m_writeCv;
+	bool				m_writerStop;
+	std::atomic<size_t>		m_writeQueued;	      // Readings in the write queue
+	std::atomic<size_t>		m_resendBlocks;
+	std::atomic<size_t>		m_queuedBytes;	      // Approximate bytes of readings waiting to be filtered
+	std::atomic<size_t>		m_writeBytes;	      // Approximate bytes of readings queued for the storage writer
+	std::atomic<size_t>		m_resendBytes;	      // Approximate bytes of readings held in memory for resend
+	std::atomic<size_t>		m_memoryHigh;	      // Bytes at which new readings are discarded, 0 for no limit
+	std::atomic<size_t>		m_memoryLow;	      // Bytes below which readings are accepted again
+	std::atomic<bool>		m_memoryFull;
+	std::atomic<unsigned long>	m_filterStall;	      // Milliseconds the filter stage waited for the writer
+	std::atomic<unsigned long>	m_writeStall;
+	std::atomic<unsigned long>	m_polls;	      // Polls of the plugin since the statistics were updated	      // Milliseconds the writer waited for the filter stage
+	bool				m_stallStatsCreated;
+	unsigned long			m_storedReadings;     // Readings written to storage
+	double				m_latencySum;	      // Seconds from the creation of the stored readings to their commit
+	double				m_latencyMax;
+	// How readings are shed whilst the buffered readings are at the memory limit
+	enum DiscardPolicy { DiscardNewest, DiscardOldest, DiscardConflate, DiscardSample };
+	std::atomic<DiscardPolicy>	m_discardPolicy;
+	std::atomic<unsigned long>	m_sampleInterval;     // One in this many readings is kept by DiscardSample
+	std::atomic<unsigned long>	m_sampleCount;
+	// Latest reading of each asset held by DiscardConflate, guarded by m_conflatedMutex
+	std::unordered_map<std::string, Reading *>
+					m_conflated;
+	std::atomic<bool>		m_adaptiveBatching;   // Wait on the predicted arrival of readings rather than a fixed fraction of the latency
+	std::atomic<unsigned long>	m_arrivals;	      // Readings queued since the ingest was created
+	unsigned long			m_rateArrivals;	      // Arrivals when the arrival rate was last sampled
+	std::chrono::steady_clock::time_point
+					m_rateSampled;
+	double				m_arrivalRate;	      // Moving average of the readings that arrive per millisecond
+	std::atomic<double>		m_batchSize;	      // Moving average of the readings taken in each block
+	LagStatistics			m_storeLag;	      // From the user timestamp of the readings to their commit
 	Logger*				m_logger;
 	std::condition_variable		m_cv;
 	std::condition_variable		m_statsCv;
 	// Data ready to be filtered/sent
 	std::vector<Reading *>*		m_data;
-	std::vector<std::vector<Reading *>*>
-					m_resendQueues;
-	std::queue<std::vector<Reading *>*>
-					m_fullQueues;
-	std::mutex			m_fqMutex;
+	// Blocks waiting to be written once the storage layer is available
+	SpillQueue			m_spill;
+	std::chrono::steady_clock::time_point
+					m_lastResend;
 	unsigned int			m_discardedReadings; // discarded readings since last update to statistics table
 	FilterPipeline*			m_filterPipeline;
+	std::thread			m_retireThread;	      // Shuts down a replaced pipeline
+	std::string			m_filterStatistics;   // Snapshot of the filter statistics
+	double				m_pollRate;	      // Effective polls per second
+	double				m_pollThrottle;	      // Poll rate as a fraction of the configured rate
+	ChangeOfValue			m_changeOfValue;      // Removes unchanged readings before filtering
+	mutable std::mutex		m_filterStatsMutex;
+	std::chrono::steady_clock::time_point
+					m_lastFilterStats;
 	
 	std::unordered_set<std::string> statsDbEntriesCache;  // confirmed stats table entries
-	std::map<std::string, int>	statsPendingEntries;  // pending stats table entries
+	std::unordered_set<InternedString>
+					m_trackedAssets;      // assets with an Ingest asset tracking tuple
+	std::unordered_map<InternedString, int>
+					statsPendingEntries;  // pending stats table entries
+	std::chrono::steady_clock::time_point
+					m_lastStatsFlush;
 	bool				m_highLatency;	      // Flag to indicate we are exceeding latency request
-	int				m_failCnt;
 	bool				m_storageFailed;
 	int				m_storesFailed;
+	QueueMetrics			m_inputMetrics;	      // Readings waiting to be filtered
+	QueueMetrics			m_writeMetrics;	      // Readings waiting for the storage writer
+	QueueMetrics			m_resendMetrics;      // Blocks waiting to be resent to storage
 };
 
 #endif
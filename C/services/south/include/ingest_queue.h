@@ -0,0 +1,65 @@
+#ifndef _INGEST_QUEUE_H
+#define _INGEST_QUEUE_H
+/*
+ * Fledge south service queue of ingested readings.
+ *
+ * Copyright (c) 2026 Dianomic Systems
+ *
+ * Released under the Apache 2.0 Licence
+ *
+ * Author: agent
+ */
+#include <reading.h>
+#include <mpsc_queue.h>
+#include <vector>
+#include <queue>
+#include <mutex>
+#include <atomic>
+
+/**
+ * The readings ingested by a south service waiting to be filtered, taken
+ * in blocks by the single thread that runs the filter pipeline.
+ *
+ * Single readings are added to a lock free ring so that plugins that
+ * ingest from multiple threads do not contend on a mutex. Sets of readings,
+ * and single readings that find the ring full, are added to a locked queue
+ * which is moved to a queue of full blocks each time it reaches the
+ * threshold.
+ *
+ * The readings are taken in the order they were ingested. Once a reading
+ * has been added to the locked queue the single readings that follow it
+ * are also added to the locked queue, until the consumer has taken the
+ * locked queue, so the ring only ever holds readings older than those of
+ * the locked queue and the full blocks. The ring is therefore taken first,
+ * then the full blocks, then the locked queue.
+ */
+class IngestQueue {
+	public:
+		IngestQueue(size_t ringSize, unsigned int threshold);
+		~IngestQueue();
+		void			setThreshold(unsigned int threshold) { m_threshold = threshold; };
+		bool			push(Reading *reading);
+		bool			push(const std::vector<Reading *>& readings);
+		std::vector<Reading *>	*take(bool& all);
+		bool			oldest(Reading*& reading);
+		bool			blockReady() const;
+		size_t			pending();
+		size_t			fullBlocks() const { return m_fullCount; };
+	private:
+		IngestQueue(const IngestQueue&);
+		IngestQueue&		operator=(const IngestQueue&);
+		void			drainRing(std::vector<Reading *> *block, size_t max);
+		void			queueLocked(Reading *reading);
+	private:
+		std::atomic<unsigned int>
+					m_threshold;
+		MPSCQueue<Reading *>	m_ring;
+		std::atomic<bool>	m_overflow;	// Single readings go to the locked queue
+		std::mutex		m_mutex;
+		std::vector<Reading *>	*m_queue;	// Guarded by m_mutex
+		std::queue<std::vector<Reading *> *>
+					m_fullQueues;	// Guarded by m_mutex
+		std::atomic<size_t>	m_fullCount;
+};
+
+#endif
@@ -0,0 +1,46 @@
+#ifndef _POLL_RATE_CONTROLLER_H
+#define _POLL_RATE_CONTROLLER_H
+/*
+ * Fledge south service poll rate controller.
+ *
+ * Copyright (c) 2026 Dianomic Systems
+ *
+ * Released under the Apache 2.0 Licence
+ *
+ * Author: agent
+ */
+
+#define POLL_CONTROL_KP		0.4	// Proportional gain
+#define POLL_CONTROL_KI		0.05	// Integral gain per second
+#define POLL_CONTROL_KD		0.1	// Derivative gain in seconds
+#define POLL_CONTROL_SMOOTHING	0.3	// Weight of a new measurement in the smoothed occupancy
+#define POLL_CONTROL_MIN_RATE	0.01	// Lowest fraction of the configured poll rate
+
+/**
+ * A PID controller that sets the poll rate of a south service, as a
+ * fraction of the configured rate, to hold the occupancy of the ingest
+ * queue at a target.
+ *
+ * The error is the smoothed occupancy less the target, relative to the
+ * target. The derivative is taken of the smoothed occupancy, so that a
+ * single large block does not cause a step in the rate, and the integral
+ * is not accumulated whilst the rate is held at either limit, so that
+ * the rate recovers as soon as the queue drops below the target.
+ */
+class PollRateController {
+	public:
+		PollRateController(double target = 1.0);
+		void		setTarget(double target);
+		void		reset();
+		double		update(double occupancy, double interval);
+		double		getRate() const { return m_rate; };
+		double		getTarget() const { return m_target; };
+	private:
+		double		m_target;
+		double		m_smoothed;
+		double		m_lastError;
+		double		m_integral;
+		double		m_rate;
+		bool		m_first;
+};
+#endif
@@ -15,6 +15,7 @@
 #include <config_category.h>
 #include <string>
 #include <reading_set.h>
+#include <mutex>
 
 typedef void (*INGEST_CB)(void *, Reading);
 typedef void (*INGEST_CB2)(void *, std::vector<Reading *>*);
@@ -46,12 +47,18 @@ public:
 	bool		isAsync() { return info->options & SP_ASYNC; };
 	bool		hasControl() { return info->options & SP_CONTROL; };
 	bool		persistData() { return info->options & SP_PERSIST_DATA; };
+	bool		isConcurrentPoll() { return info->options & SP_CONCURRENT_POLL; };
 	void		startData(const std::string& pluginData);
 	std::string	shutdownSaveData();
 	bool		write(const std::string& name, const std::string& value);
 	bool		operation(const std::string& name, std::vector<PLUGIN_PARAMETER *>& );
+private:
+	PLUGIN_HANDLE	beginPoll();
+	void		endPoll();
+	void		waitForPolls(std::unique_lock<std::mutex>& guard);
 private:
 	PLUGIN_HANDLE	instance;
+	unsigned int	m_activePolls;
 	void		(*pluginStartPtr)(PLUGIN_HANDLE);
 	Reading		(*pluginPollPtr)(PLUGIN_HANDLE);
 	std::vector<Reading*>* (*pluginPollPtrV2)(PLUGIN_HANDLE);
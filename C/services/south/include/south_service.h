@@ -17,6 +17,11 @@
 #include <ingest.h>
 #include <filter_plugin.h>
 #include <plugin_data.h>
+#include <poll_rate_controller.h>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <vector>
 
 #define MAX_SLEEP	5		// Maximum number of seconds the service will sleep during a poll cycle
 
@@ -26,15 +31,22 @@
  * Control the throttling of poll based plugins
  *
  * If the ingest queue grows then we reduce the poll rate, i.e. increase
- * the interval between poll calls. If the ingest queue then drops below
- * the threshold set in the advance configuration we then bring the poll
- * rate back up.
+ * the interval between poll calls. A PID controller sets the poll rate
+ * to hold the ingest queue at a target a little above the buffer
+ * threshold set in the advanced configuration, the rate returns to the
+ * configured rate once the queue is below the target.
  */
-#define SOUTH_THROTTLE_HIGH_PERCENT	50	// Percentage above buffer threshold where we throttle down
-#define SOUTH_THROTTLE_LOW_PERCENT	10	// Percentage above buffer threshold where we throttle up
-#define SOUTH_THROTTLE_PERCENT		10	// The percentage we throttle poll by
-#define SOUTH_THROTTLE_DOWN_INTERVAL	10	// Interval between throttle down attmepts
-#define SOUTH_THROTTLE_UP_INTERVAL	15	// Interval between throttle up attempts
+#define SOUTH_THROTTLE_TARGET_PERCENT	30	// Percentage above buffer threshold at which the queue is held
+#define SOUTH_THROTTLE_INTERVAL		1000	// Milliseconds between updates of the poll rate
+#define SOUTH_THROTTLE_CHANGE_PERCENT	2	// Smallest change in the poll interval applied to the timer
+
+/*
+ * Plugins that advertise SP_CONCURRENT_POLL are polled by a pool of
+ * worker threads, the timer thread hands each poll to an idle worker.
+ * A poll is skipped if every worker is busy, rather than queueing polls
+ * that would be late when they run.
+ */
+#define SOUTH_MAX_POLL_WORKERS		64	// Upper limit on the configured number of poll workers
 
 /**
  * The SouthService class. This class is the core
@@ -62,10 +74,24 @@ class SouthService : public ServiceAuthHandler {
 		void				addConfigDefaults(DefaultConfigCategory& defaults);
 		bool 				loadPlugin();
 		int 				createTimerFd(struct timeval rate);
+		bool				setTimerFd(int fd, struct timeval rate);
+		void				setDesiredInterval(unsigned long usecs);
+		void				setPollInterval(double interval);
+		void				setThrottleTarget(unsigned long threshold);
 		void 				createConfigCategories(DefaultConfigCategory configCategory,
 									std::string parent_name,
 									std::string current_name);
 		void				throttlePoll();
+		void				setChangeOfValue();
+		void				setMemoryLimit();
+		void				setDiscardPolicy();
+		void				setAdaptiveBatching();
+		int				pollPlugin(bool v2);
+		void				setPollWorkers(unsigned long workers);
+		void				startPollWorkers(bool v2);
+		void				stopPollWorkers();
+		bool				dispatchPoll();
+		void				pollWorker(bool v2);
 	private:
 		SouthPlugin			*southPlugin;
 		Logger        			*logger;
@@ -79,15 +105,26 @@ class SouthService : public ServiceAuthHandler {
 		Ingest				*m_ingest;
 		bool				m_throttle;
 		bool				m_throttled;
-		unsigned int			m_highWater;
-		unsigned int			m_lowWater;
+		PollRateController		m_pollController;
 		struct timeval			m_lastThrottle;
+		unsigned long			m_polls;		// Polls since the poll rate was last updated
 		struct timeval			m_desiredRate;
 		struct timeval			m_currentRate;
 		int				m_timerfd;
 		const std::string		m_token;
 		unsigned int			m_repeatCnt;
+		unsigned int			m_desiredRepeat;
 		PluginData			*m_pluginData;
 		std::string			m_dataKey;
+		unsigned int			m_pollWorkers;		// Polls that may run concurrently
+		std::vector<std::thread *>	m_pollThreads;
+		std::mutex			m_pollMutex;
+		std::condition_variable		m_pollCV;
+		unsigned int			m_pendingPolls;		// Polls waiting for a worker
+		unsigned int			m_runningPolls;		// Polls being run by a worker
+		unsigned long			m_skippedPolls;		// Polls skipped as every worker was busy
+		int				m_workerReadings;	// Readings ingested by the workers
+		bool				m_pollWorkersRunning;
+		bool				m_pollV2;		// The plugin supports the version 2 poll interface
 };
 #endif
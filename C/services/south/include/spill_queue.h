@@ -0,0 +1,137 @@
+#ifndef _SPILL_QUEUE_H
+#define _SPILL_QUEUE_H
+/*
+ * Fledge south service spill queue.
+ *
+ * Copyright (c) 2026 Dianomic Systems
+ *
+ * Released under the Apache 2.0 Licence
+ *
+ * Author: agent
+ */
+#include <reading.h>
+#include <logger.h>
+#include <string>
+#include <vector>
+#include <deque>
+#include <stdint.h>
+
+#define SPILL_MEMORY_BLOCKS	16			// Blocks held in memory before spilling to disk
+#define SPILL_SEGMENT_SIZE	(64 * 1024 * 1024)	// Bytes written to a segment file before a new one is started
+#define SPILL_MAX_DISK		(2048LL * 1024 * 1024)	// Bytes of unreplayed readings allowed on disk
+
+#define SPILL_SEGMENT_MAGIC	0x53504c53
+#define SPILL_BLOCK_MAGIC	0x53504c42
+#define SPILL_VERSION		1
+
+/**
+ * The header at the start of a segment file. The consumed offset is
+ * updated through the mapping of the segment as blocks are replayed,
+ * so that a restarted service carries on from the first block that
+ * has not been written to the storage layer.
+ */
+typedef struct {
+	uint32_t	magic;
+	uint32_t	version;
+	uint64_t	consumed;	// Offset of the first block not replayed
+} SpillSegmentHeader;
+
+/**
+ * The header of each block of readings in a segment, followed by
+ * length bytes of readings. Each reading is written as
+ *
+ *	uint32_t	asset name length, char[length]
+ *	int64_t		user timestamp seconds, microseconds
+ *	int64_t		timestamp seconds, microseconds
+ *	uint32_t	payload length, binary datapoint payload[length]
+ *
+ * The datapoint payload is the encoding of the reading stream protocol.
+ */
+typedef struct {
+	uint32_t	magic;
+	uint32_t	count;		// Readings in the block
+	uint64_t	length;		// Bytes of readings following the header
+} SpillBlockHeader;
+
+/**
+ * A segment file of spilled blocks
+ */
+class SpillSegment {
+	public:
+		SpillSegment(const std::string& path, uint64_t sequence) :
+			m_path(path), m_sequence(sequence), m_fd(-1),
+			m_size(0), m_consumed(sizeof(SpillSegmentHeader)), m_blocks(0),
+			m_map(NULL), m_mapped(0) {};
+		std::string	m_path;
+		uint64_t	m_sequence;
+		int		m_fd;
+		uint64_t	m_size;		// Bytes written to the segment
+		uint64_t	m_consumed;	// Offset of the next block to replay
+		size_t		m_blocks;	// Blocks not yet replayed
+		char		*m_map;		// Read mapping of the segment
+		uint64_t	m_mapped;	// Length of the mapping
+};
+
+/**
+ * A first in, first out queue of blocks of readings waiting to be
+ * written to the storage layer.
+ *
+ * A bounded number of blocks, optionally also bounded by the approximate
+ * bytes of memory used by their readings, are held in memory. Once that is exceeded
+ * the blocks are appended to segment files in the spill directory, in
+ * a compact binary format, and the memory is released. Blocks are
+ * replayed from the memory mapped segments in the order they were
+ * queued and each segment is removed once it has been replayed. Blocks
+ * still on disk when the service shuts down are replayed when it next
+ * starts.
+ *
+ * The queue is not thread safe, it is only used by the storage writer.
+ */
+class SpillQueue {
+	public:
+		SpillQueue(const std::string& directory,
+			   size_t memoryBlocks = SPILL_MEMORY_BLOCKS,
+			   uint64_t maxDisk = SPILL_MAX_DISK);
+		~SpillQueue();
+		bool			push(std::vector<Reading *> *readings);
+		std::vector<Reading *>	*front();
+		void			pop();
+		void			flush();
+		bool			empty() const { return m_memory.empty() && m_diskBlocks == 0; };
+		size_t			size() const;
+		size_t			inMemory() const { return m_frontOnDisk ? 0 : m_memory.size(); };
+		uint64_t		diskBytes() const { return m_diskBytes; };
+		uint64_t		memoryBytes() const { return m_memoryBytes; };
+		void			setMaxMemory(uint64_t bytes) { m_maxMemory = bytes; };
+	private:
+		SpillQueue(const SpillQueue&);
+		SpillQueue&		operator=(const SpillQueue&);
+		void			recover();
+		bool			scanSegment(SpillSegment *segment);
+		bool			spill(size_t blocks);
+		bool			openSegment();
+		bool			mapSegment(SpillSegment *segment, uint64_t length);
+		std::vector<Reading *>	*load();
+		void			removeSegment();
+		void			encode(std::vector<Reading *> *readings, std::string& block);
+		std::vector<Reading *>	*decode(const char *data, const SpillBlockHeader& header);
+	private:
+		std::string		m_directory;
+		size_t			m_memoryBlocks;
+		uint64_t		m_maxMemory;	// Bytes of readings held in memory, 0 for no limit
+		uint64_t		m_memoryBytes;
+		uint64_t		m_maxDisk;
+		std::deque<std::vector<Reading *> *>
+					m_memory;
+		bool			m_frontOnDisk;	// Front memory block was loaded from disk
+		uint64_t		m_frontLength;	// Bytes of the front block on disk
+		std::deque<SpillSegment *>
+					m_segments;	// Oldest first, the last is appended to
+		uint64_t		m_nextSequence;
+		size_t			m_diskBlocks;
+		uint64_t		m_diskBytes;
+		std::string		m_block;
+		Logger			*m_logger;
+};
+
+#endif
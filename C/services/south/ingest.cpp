@@ -12,6 +12,10 @@
 #include <config_handler.h>
 #include <thread>
 #include <logger.h>
+#include <utils.h>
+#include <tracer.h>
+#include <alloc_profiler.h>
+#include <thread_config.h>
 
 using namespace std;
 
@@ -35,6 +39,14 @@ static void ingestThread(Ingest *ingest)
 	}
 }
 
+/**
+ * Thread to write the filtered data to the storage layer
+ */
+static void writerThread(Ingest *ingest)
+{
+	ingest->processWrites();
+}
+
 /**
  * Thread to update statistics table in DB
  */
@@ -97,20 +109,135 @@ int Ingest::createStatsDbEntry(const string& assetName)
 	return 0;
 }
 
+/**
+ * Create the rows in the statistics table for a set of assets, if not
+ * present already. The existing rows are found with a query for many
+ * assets at once and only the missing rows are inserted.
+ *
+ * @param assetNames	The asset names to create rows for
+ */
+void Ingest::createStatsDbEntries(const vector<string>& assetNames)
+{
+	for (size_t start = 0; start < assetNames.size(); start += STATS_CREATE_BATCH)
+	{
+		size_t end = start + STATS_CREATE_BATCH;
+		if (end > assetNames.size())
+			end = assetNames.size();
+
+		unordered_map<string, const string *> keys;
+		Where *wKey = NULL;
+		for (size_t i = start; i < end; i++)
+		{
+			string key = assetNames[i];
+			for (auto & c: key) c = toupper(c);
+			if (wKey)
+				wKey->addIn(key);
+			else
+				wKey = new Where("key", In, key);
+			keys[key] = &assetNames[i];
+		}
+		Query qKey(wKey);
+
+		ResultSet* result = 0;
+		try
+		{
+			result = m_storage.queryTable("statistics", qKey);
+			if (result->rowCount())
+			{
+				ResultSet::RowIterator it = result->firstRow();
+				do
+				{
+					ResultSet::ColumnValue* key = (*it)->getColumn("key");
+					keys.erase(key->getString());
+				} while (!result->isLastRow(it++));
+			}
+			delete result;
+		}
+		catch (...)
+		{
+			m_logger->error("%s:%d : Unable to query the statistics table for %d assets", __FUNCTION__, __LINE__, (int)(end - start));
+			continue;
+		}
+
+		for (auto& key : keys)
+		{
+			InsertValues newStatsEntry;
+			newStatsEntry.push_back(InsertValue("key", key.first));
+			newStatsEntry.push_back(InsertValue("description", string("Readings received from asset ")+ *key.second));
+			newStatsEntry.push_back(InsertValue("value", 0));
+			newStatsEntry.push_back(InsertValue("previous_value", 0));
+			try
+			{
+				if (!m_storage.insertTable("statistics", newStatsEntry))
+				{
+					m_logger->error("%s:%d : Insert new row into statistics table failed, newStatsEntry='%s'", __FUNCTION__, __LINE__, newStatsEntry.toJSON().c_str());
+				}
+			}
+			catch (...)
+			{
+				m_logger->error("%s:%d : Unable to create new row in statistics table with key='%s'", __FUNCTION__, __LINE__, key.first.c_str());
+			}
+		}
+	}
+}
+
 /**
  * Update statistics for this south service. Successfully processed 
  * readings are reflected against plugin asset name and READINGS keys.
  * Discarded readings stats are updated against DISCARDED key.
+ *
+ * The updates are made at most once every STATS_FLUSH_INTERVAL and the
+ * pending counts are taken from the ingest threads before the statistics
+ * table is updated, so the ingest threads do not wait for the storage
+ * service whilst the update is made.
  */
 void Ingest::updateStats()
 {
-	unique_lock<mutex> lck(m_statsMutex);
-	if (m_running) // don't wait on condition variable if plugin/ingest is being shutdown
-		m_statsCv.wait(lck);
+	unordered_map<InternedString, int> pending;
+	unsigned int discarded;
+	{
+		unique_lock<mutex> lck(m_statsMutex);
+		if (m_running) // don't wait on condition variable if plugin/ingest is being shutdown
+		{
+			m_statsCv.wait(lck, [this]{
+					return !m_running || !statsPendingEntries.empty() || m_discardedReadings;
+				});
+			// Let further counts accumulate if the table was updated recently
+			m_statsCv.wait_until(lck, m_lastStatsFlush + chrono::milliseconds(STATS_FLUSH_INTERVAL),
+					[this]{ return !m_running; });
+		}
 
-	if (statsPendingEntries.empty())
+		if (statsPendingEntries.empty() && m_discardedReadings == 0
+				&& m_filterStall == 0 && m_writeStall == 0 && m_polls == 0)
+		{
+			return;
+		}
+		pending.swap(statsPendingEntries);
+		discarded = m_discardedReadings;
+		m_discardedReadings = 0;
+		m_lastStatsFlush = chrono::steady_clock::now();
+	}
+	unsigned long filterStall = m_filterStall.exchange(0);
+	unsigned long writeStall = m_writeStall.exchange(0);
+	unsigned long polls = m_polls.exchange(0);
+	if ((filterStall || writeStall || polls) && !m_stallStatsCreated)
 	{
-		return;
+		createStallStats();
+	}
+
+	vector<string> newAssets;
+	for (auto it = pending.begin(); it != pending.end(); ++it)
+	{
+		const string& assetName = it->first.str();
+		if (statsDbEntriesCache.find(assetName) == statsDbEntriesCache.end())
+		{
+			newAssets.push_back(assetName);
+			statsDbEntriesCache.insert(assetName);
+		}
+	}
+	if (!newAssets.empty())
+	{
+		createStatsDbEntries(newAssets);
 	}
 
 	int readings=0;
@@ -118,18 +245,12 @@ void Ingest::updateStats()
 	string key;
 	const Condition conditionStat(Equals);
 	
-	for (auto it = statsPendingEntries.begin(); it != statsPendingEntries.end(); ++it)
+	for (auto it = pending.begin(); it != pending.end(); ++it)
 	{
-		if (statsDbEntriesCache.find(it->first) == statsDbEntriesCache.end())
-		{
-			createStatsDbEntry(it->first);
-			statsDbEntriesCache.insert(it->first);
-		}
-		
 		if (it->second)
-			{
+		{
 			// Prepare fledge.statistics update
-			key = it->first;
+			key = it->first.str();
 			for (auto & c: key) c = toupper(c);
 
 			// Prepare "WHERE key = name
@@ -151,24 +272,43 @@ void Ingest::updateStats()
 		updateValue->push_back(Expression("value", "+", (int) readings));
 		statsUpdates.emplace_back(updateValue, wPluginStat);
 	}
-	if (m_discardedReadings)
+	if (discarded)
 	{
 		Where *wPluginStat = new Where("key", conditionStat, "DISCARDED");
 		ExpressionValues *updateValue = new ExpressionValues;
-		updateValue->push_back(Expression("value", "+", (int) m_discardedReadings));
+		updateValue->push_back(Expression("value", "+", (int) discarded));
 		statsUpdates.emplace_back(updateValue, wPluginStat);
  	}
+	if (filterStall)
+	{
+		Where *wStall = new Where("key", conditionStat, m_serviceName + " Filter Stall");
+		ExpressionValues *updateValue = new ExpressionValues;
+		updateValue->push_back(Expression("value", "+", (int) filterStall));
+		statsUpdates.emplace_back(updateValue, wStall);
+	}
+	if (writeStall)
+	{
+		Where *wStall = new Where("key", conditionStat, m_serviceName + " Write Stall");
+		ExpressionValues *updateValue = new ExpressionValues;
+		updateValue->push_back(Expression("value", "+", (int) writeStall));
+		statsUpdates.emplace_back(updateValue, wStall);
+	}
+	if (polls)
+	{
+		Where *wPolls = new Where("key", conditionStat, m_serviceName + " Polls");
+		ExpressionValues *updateValue = new ExpressionValues;
+		updateValue->push_back(Expression("value", "+", (int) polls));
+		statsUpdates.emplace_back(updateValue, wPolls);
+	}
 	
+	bool updated = false;
 	try {
 		int rv = m_storage.updateTable("statistics", statsUpdates);
 		
 		if (rv<0)
 			Logger::getLogger()->info("%s:%d : Update stats failed, rv=%d", __FUNCTION__, __LINE__, rv);
 		else
-		{
-			m_discardedReadings=0;
-			statsPendingEntries.clear();
-		}
+			updated = true;
 	}
 	catch (...) {
 		Logger::getLogger()->info("%s:%d : Statistics table update failed, will retry on next iteration", __FUNCTION__, __LINE__);
@@ -178,6 +318,63 @@ void Ingest::updateStats()
 		delete it->first;
 		delete it->second;
 	}
+	if (!updated)
+	{
+		// Return the counts so that they are included in the next update
+		lock_guard<mutex> guard(m_statsMutex);
+		for (auto& it : pending)
+			statsPendingEntries[it.first] += it.second;
+		m_discardedReadings += discarded;
+		m_filterStall += filterStall;
+		m_writeStall += writeStall;
+		m_polls += polls;
+	}
+}
+
+/**
+ * Create the statistics that report the time in milliseconds that
+ * each stage of the ingest pipeline has waited for the other and the
+ * number of times the plugin has been polled
+ */
+void Ingest::createStallStats()
+{
+	vector<pair<string, string>> stats = {
+		{ m_serviceName + " Filter Stall", "Milliseconds the filters of " + m_serviceName + " waited for the storage writer" },
+		{ m_serviceName + " Write Stall", "Milliseconds the storage writer of " + m_serviceName + " waited for the filters" },
+		{ m_serviceName + " Polls", "Number of times the plugin of " + m_serviceName + " has been polled" }
+	};
+	for (auto& stat : stats)
+	{
+		const Condition conditionKey(Equals);
+		Where *wKey = new Where("key", conditionKey, stat.first);
+		Query qKey(wKey);
+		try
+		{
+			ResultSet *result = m_storage.queryTable("statistics", qKey);
+			unsigned int rows = result->rowCount();
+			delete result;
+			if (rows)
+			{
+				continue;
+			}
+			InsertValues newStatsEntry;
+			newStatsEntry.push_back(InsertValue("key", stat.first));
+			newStatsEntry.push_back(InsertValue("description", stat.second));
+			newStatsEntry.push_back(InsertValue("value", 0));
+			newStatsEntry.push_back(InsertValue("previous_value", 0));
+			if (!m_storage.insertTable("statistics", newStatsEntry))
+			{
+				m_logger->error("Failed to create the statistic %s", stat.first.c_str());
+				return;
+			}
+		}
+		catch (...)
+		{
+			m_logger->error("Unable to create the statistic %s", stat.first.c_str());
+			return;
+		}
+	}
+	m_stallStatsCreated = true;
 }
 
 /**
@@ -204,15 +401,52 @@ Ingest::Ingest(StorageClient& storage,
 			m_serviceName(serviceName),
 			m_pluginName(pluginName),
 			m_mgtClient(mgmtClient),
-			m_failCnt(0),
+			m_readings(INGEST_RING_SIZE, threshold),
+			m_spill(getDataDir() + "/spill/" + serviceName),
 			m_storageFailed(false),
-			m_storesFailed(0)
+			m_storesFailed(0),
+			m_inputMetrics("south.ingest", "readings"),
+			m_writeMetrics("south.write", "readings"),
+			m_resendMetrics("south.resend", "blocks")
 {
+	// Blocks recovered from the spill files of a previous run
+	m_resendMetrics.enqueue(m_spill.size());
 	m_shutdown = false;
 	m_running = true;
-	m_queue = new vector<Reading *>();
+	m_writerStop = false;
+	m_writeQueued = 0;
+	m_resendBlocks = 0;
+	m_queuedBytes = 0;
+	m_writeBytes = 0;
+	m_resendBytes = 0;
+	m_memoryHigh = 0;
+	m_memoryLow = 0;
+	m_memoryFull = false;
+	m_filterStall = 0;
+	m_writeStall = 0;
+	m_polls = 0;
+	m_pollRate = 0.0;
+	m_pollThrottle = 1.0;
+	m_stallStatsCreated = false;
+	m_storedReadings = 0;
+	m_latencySum = 0.0;
+	m_latencyMax = 0.0;
+	m_discardPolicy = DiscardNewest;
+	m_sampleInterval = 1;
+	m_sampleCount = 0;
+	m_adaptiveBatching = false;
+	m_arrivals = 0;
+	m_rateArrivals = 0;
+	m_rateSampled = chrono::steady_clock::now();
+	m_arrivalRate = 0.0;
+	m_batchSize = 0.0;
+	m_writerThread = new thread(writerThread, this);
 	m_thread = new thread(ingestThread, this);
 	m_statsThread = new thread(statsThread, this);
+	ThreadConfig *threadConfig = ThreadConfig::getInstance();
+	threadConfig->apply(*m_writerThread, "ingest-writer");
+	threadConfig->apply(*m_thread, "ingest");
+	threadConfig->apply(*m_statsThread, "ingest-stats");
 	m_logger = Logger::getLogger();
 	m_data = NULL;
 	m_discardedReadings = 0;
@@ -241,14 +475,27 @@ Ingest::~Ingest()
 	m_cv.notify_one();
 	m_thread->join();
 	processQueue();
+	{
+		lock_guard<mutex> guard(m_writeMutex);
+		m_writerStop = true;
+		m_writeCv.notify_all();
+	}
+	m_writerThread->join();
+	// Keep any readings that could not be written for the next start
+	m_spill.flush();
 	m_statsCv.notify_one();
 	m_statsThread->join();
 	updateStats();
-	delete m_queue;
 	delete m_thread;
+	delete m_writerThread;
 	delete m_statsThread;
 	//delete m_data;
 	
+	if (m_retireThread.joinable())
+	{
+		m_retireThread.join();
+	}
+
 	// Cleanup filters - no other threads are running so no need for the lock
 	if (m_filterPipeline)
 	{
@@ -279,27 +526,33 @@ bool Ingest::isStopping()
 
 /**
  * Add a reading to the reading queue
+ *
+ * Single readings are added to a lock free queue so that plugins
+ * that ingest from multiple threads do not contend on the queue
+ * mutex, see IngestQueue.
  */
 void Ingest::ingest(const Reading& reading)
 {
-vector<Reading *> *fullQueue = 0;
+	ALLOC_SCOPE(ALLOC_SOUTH_INGEST);
 
+	bool full = memoryFull();
+	if (full && m_discardPolicy == DiscardNewest)
 	{
-		lock_guard<mutex> guard(m_qMutex);
-		m_queue->push_back(new Reading(reading));
-		if (m_queue->size() >= m_queueSizeThreshold || m_running == false)
-		{
-			fullQueue = m_queue;
-			m_queue = new vector<Reading *>;
-		}
+		logDiscardedStat();
+		return;
 	}
-	if (fullQueue)
+	Reading *copy = new Reading(reading);
+	m_queuedBytes += copy->getMemorySize();
+	m_arrivals++;
+	if (full && (copy = shedReading(copy)) == NULL)
 	{
-		lock_guard<mutex> guard(m_fqMutex);
-		m_fullQueues.push(fullQueue);
+		return;
 	}
-	if (m_fullQueues.size())
+	m_inputMetrics.enqueue();
+	if (m_readings.push(copy) || m_running == false)
+	{
 		m_cv.notify_all();
+	}
 }
 
 /**
@@ -307,37 +560,35 @@ vector<Reading *> *fullQueue = 0;
  */
 void Ingest::ingest(const vector<Reading *> *vec)
 {
-vector<Reading *> *fullQueue = 0;
-size_t qSize;
-unsigned int nFullQueues = 0;
+	ALLOC_SCOPE(ALLOC_SOUTH_INGEST);
 
+	bool full = memoryFull();
+	if (full && m_discardPolicy == DiscardNewest)
 	{
-		lock_guard<mutex> guard(m_qMutex);
-		
-		// Get the readings in the set
 		for (auto & rdng : *vec)
 		{
-			m_queue->push_back(rdng);
-		}
-		if (m_queue->size() >= m_queueSizeThreshold || m_running == false)
-		{
-			fullQueue = m_queue;
-			m_queue = new vector<Reading *>;
+			delete rdng;
 		}
-		qSize = m_queue->size();
-	}
-	if (fullQueue)
-	{
-		lock_guard<mutex> guard(m_fqMutex);
-		m_fullQueues.push(fullQueue);
-		nFullQueues = m_fullQueues.size();
+		logDiscardedStat(vec->size());
+		return;
 	}
-	else
+	m_queuedBytes += Reading::getMemorySize(*vec);
+	m_arrivals += vec->size();
+	vector<Reading *> kept;
+	if (full && m_discardPolicy != DiscardOldest)
 	{
-		lock_guard<mutex> guard(m_fqMutex);
-		nFullQueues = m_fullQueues.size();
+		for (auto & rdng : *vec)
+		{
+			Reading *reading = shedReading(rdng);
+			if (reading)
+			{
+				kept.push_back(reading);
+			}
+		}
+		vec = &kept;
 	}
-	if (nFullQueues != 0 || qSize > m_queueSizeThreshold * 3 / 4)
+	m_inputMetrics.enqueue(vec->size());
+	if (m_readings.push(*vec) || m_running == false)
 	{
 		m_cv.notify_all();
 	}
@@ -346,17 +597,16 @@ unsigned int nFullQueues = 0;
 /**
  * Work out how long to wait based on age of oldest queued reading
  * We do this in a seperaste function so that we can
- * lock the qMutex to access the oldest element in the queue
+ * lock the queue to access the oldest element in the queue
  *
  * @return the tiem to wait
  */
 long Ingest::calculateWaitTime()
 {
 	long timeout = m_timeout;
-	lock_guard<mutex> guard(m_qMutex);
-	if (!m_queue->empty())
+	Reading *reading = NULL;
+	if (m_readings.oldest(reading))
 	{
-		Reading *reading = (*m_queue)[0];
 		struct timeval tm, now;
 		reading->getUserTimestamp(&tm);
 		gettimeofday(&now, NULL);
@@ -369,130 +619,136 @@ long Ingest::calculateWaitTime()
 
 /**
  * Wait for a period of time to allow the queue to build
+ *
+ * With adaptive batching the wait is recalculated each time the
+ * thread is woken, until either a full block of readings is queued,
+ * the oldest reading reaches the maximum latency or the arrival rate
+ * predicts that waiting will not add to the block, see adaptiveWaitTime.
  */
 void Ingest::waitForQueue()
 {
-	if (m_fullQueues.size() > 0 || m_resendQueues.size() > 0)
+	if (m_readings.fullBlocks() > 0)
 		return;
-	if (m_running && m_queue->size() < m_queueSizeThreshold)
+	if (!m_adaptiveBatching)
 	{
-		long timeout = calculateWaitTime();
-		if (timeout > 0)
+		if (m_running && m_readings.pending() < m_queueSizeThreshold)
 		{
-			mutex mtx;
-			unique_lock<mutex> lck(mtx);
-			m_cv.wait_for(lck,chrono::milliseconds((3 * timeout) / 4));
+			long timeout = calculateWaitTime();
+			if (timeout > 0)
+			{
+				mutex mtx;
+				unique_lock<mutex> lck(mtx);
+				m_cv.wait_for(lck,chrono::milliseconds((3 * timeout) / 4));
+			}
 		}
+		return;
+	}
+	while (m_running && m_readings.fullBlocks() == 0)
+	{
+		sampleArrivalRate();
+		size_t queued = m_readings.pending();
+		if (queued >= m_queueSizeThreshold)
+			break;
+		long timeout = calculateWaitTime();
+		if (timeout > 0)
+			timeout = adaptiveWaitTime(queued, timeout);
+		if (timeout <= 0)
+			break;
+		mutex mtx;
+		unique_lock<mutex> lck(mtx);
+		m_cv.wait_for(lck, chrono::milliseconds(timeout));
 	}
 }
 
+/**
+ * Calculate how long to wait for more readings from the moving average
+ * of the arrival rate.
+ *
+ * We normally wait until the oldest reading reaches the maximum latency,
+ * the ingest wakes the thread early if a full block is queued. If the
+ * rate predicts that no more readings will arrive within the latency
+ * that remains the readings already queued are sent at once, holding
+ * them would add latency without making the block larger.
+ *
+ * @param queued	The number of readings queued
+ * @param budget	The milliseconds until the oldest reading reaches the maximum latency
+ * @return long		The milliseconds to wait, 0 to send the queued readings now
+ */
+long Ingest::adaptiveWaitTime(size_t queued, long budget)
+{
+	if (queued > 0 && m_arrivalRate * budget < 1.0)
+	{
+		return 0;
+	}
+	return budget;
+}
+
+/**
+ * Update the moving average of the rate at which readings arrive.
+ * The rate is sampled at most every BATCH_RATE_INTERVAL milliseconds.
+ * Must only be called from the thread that processes the queue.
+ */
+void Ingest::sampleArrivalRate()
+{
+	auto now = chrono::steady_clock::now();
+	long elapsed = chrono::duration_cast<chrono::milliseconds>(now - m_rateSampled).count();
+	if (elapsed < BATCH_RATE_INTERVAL)
+		return;
+	unsigned long arrivals = m_arrivals;
+	double rate = (double)(arrivals - m_rateArrivals) / elapsed;
+	m_arrivalRate = BATCH_RATE_WEIGHT * rate + (1.0 - BATCH_RATE_WEIGHT) * m_arrivalRate;
+	m_rateArrivals = arrivals;
+	m_rateSampled = now;
+}
+
 /**
  * Process the queue of readings.
  *
- * Send them to the storage layer as a block. If the append call
- * fails requeue the readings for the next transmission.
+ * This is the filter stage of the ingest pipeline, the readings are
+ * passed through the filter pipeline and the block of filtered readings
+ * queued for the storage writer, see processWrites.
  *
- * In order not to lock the queue for an excessie time a new queue
- * is created and the old one moved to a local variable. This minimise
- * the time we hold the queue mutex to the time it takes to swap two
- * variables.
+ * The readings are taken from the queue in blocks, in the order in
+ * which they were ingested, see IngestQueue. The latest readings held
+ * by the Keep Latest policy are sent with the block that empties
+ * the queue.
  */
 void Ingest::processQueue()
 {
 	do {
-		/*
-		 * If we have some data that has been previously filtered but failed to send,
-		 * then first try to send that data.
-		 */
-		while (m_resendQueues.size() > 0)
+		TRACE_SPAN("ingest", "Ingest::processQueue");
+		ALLOC_SCOPE(ALLOC_SOUTH_INGEST);
+		bool all;
+		m_data = m_readings.take(all);
+		if (all)
 		{
-			vector<Reading *> *q = *m_resendQueues.begin();
-			if (m_storage.readingAppend(*q) == false)
-			{
-				if (!m_storageFailed)
-					m_logger->info("Still unable to resend buffered data, leaving on resend queue.");
-				m_storageFailed = true;
-				m_storesFailed++;
-				m_failCnt++;
-				if (m_failCnt > 5)
-				{
-					m_logger->info("Too many failures with block of readings. Removing readings from block");
-					for (int cnt = 5; cnt > 0 && q->size() > 0; cnt--)
-					{
-						Reading *reading = q->front();
-						m_logger->info("Remove reading: %s",
-								reading->toJSON().c_str());
-						delete reading;
-						q->erase(q->begin());
-						logDiscardedStat();
-					}
-					if (q->size() == 0)
-					{
-						delete q;
-						m_resendQueues.erase(m_resendQueues.begin());
-					}
-					m_failCnt = 0;
-				}
-			}
-			else
-			{
-
-				if (m_storageFailed)
-				{
-					m_logger->warn("Storage operational after %d failures", m_storesFailed);
-					m_storageFailed = false;
-					m_storesFailed = 0;
-				}
-				m_failCnt = 0;
-				std::map<std::string, int>		statsEntriesCurrQueue;
-				AssetTracker *tracker = AssetTracker::getAssetTracker();
-				string lastAsset = "";
-				int *lastStat = NULL;
-				for (vector<Reading *>::iterator it = q->begin();
-							 it != q->end(); ++it)
-				{
-					Reading *reading = *it;
-					string assetName = reading->getAssetName();
-					if (lastAsset.compare(assetName))
-					{
-						AssetTrackingTuple tuple(m_serviceName, m_pluginName, assetName, "Ingest");
-						if (!tracker->checkAssetTrackingCache(tuple))
-						{
-							tracker->addAssetTrackingTuple(tuple);
-						}
-						lastAsset = assetName;
-						lastStat = &(statsEntriesCurrQueue[assetName]);
-						(*lastStat)++;
-					}
-					else if (lastStat)
-					{
-						(*lastStat)++;
-					}
-					delete reading;
-				}
-				delete q;
-				m_resendQueues.erase(m_resendQueues.begin());
-				unique_lock<mutex> lck(m_statsMutex);
-				for (auto &it : statsEntriesCurrQueue)
-					statsPendingEntries[it.first] += it.second;
-			}
+			lock_guard<mutex> guard(m_conflatedMutex);
+			drainConflated(m_data);
 		}
+		m_queuedBytes -= Reading::getMemorySize(*m_data);
+		m_inputMetrics.dequeue(m_data->size());
+		m_batchSize = BATCH_RATE_WEIGHT * m_data->size() + (1.0 - BATCH_RATE_WEIGHT) * m_batchSize;
+		ALLOC_READINGS(ALLOC_SOUTH_INGEST, m_data->size());
 
+		// Make room for newer readings by discarding the oldest
+		if (m_discardPolicy == DiscardOldest && memoryFull())
 		{
-			lock_guard<mutex> fqguard(m_fqMutex);
-			if (m_fullQueues.empty())
+			logDiscardedStat(m_data->size());
+			for (auto& reading : *m_data)
 			{
-				// Block of code to execute holding the mutex
-				lock_guard<mutex> guard(m_qMutex);
-				std::vector<Reading *> *newQ = new vector<Reading *>;
-				m_data = m_queue;
-				m_queue = newQ;
-			}
-			else
-			{
-				m_data = m_fullQueues.front();
-				m_fullQueues.pop();
+				delete reading;
 			}
+			delete m_data;
+			m_data = NULL;
+			continue;
+		}
+
+		// Remove the readings that have not changed before they are filtered
+		if (m_changeOfValue.process(m_data) && m_data->empty())
+		{
+			delete m_data;
+			m_data = NULL;
+			continue;
 		}
 		
 		/*
@@ -517,6 +773,10 @@ void Ingest::processQueue()
 				FilterPlugin *firstFilter = m_filterPipeline->getFirstFilterPlugin();
 				if (firstFilter)
 				{
+					TRACE_SPAN("filter", "FilterPipeline");
+					ALLOC_SCOPE(ALLOC_FILTER_PIPELINE);
+					ALLOC_READINGS(ALLOC_FILTER_PIPELINE, m_data->size());
+
 					// Check whether filters are set before calling ingest
 					while (!m_filterPipeline->isReady())
 					{
@@ -525,10 +785,27 @@ void Ingest::processQueue()
 						std::this_thread::sleep_for(std::chrono::milliseconds(150));
 					}
 
-					ReadingSet *readingSet = new ReadingSet(m_data);
-					m_data->clear();
-					// Pass readingSet to filter chain
-					firstFilter->ingest(readingSet);
+					// Stateless filters are passed partitions of the
+					// readings in parallel, otherwise pass the readingSet
+					// to filter chain
+					if (!m_filterPipeline->ingestPartitioned(m_data))
+					{
+						ReadingSet *readingSet = new ReadingSet(m_data);
+						m_data->clear();
+						firstFilter->ingest(readingSet);
+					}
+
+					// Snapshot the statistics of the filters for the
+					// management API, which does not wait for the pipeline mutex
+					auto now = std::chrono::steady_clock::now();
+					if (now - m_lastFilterStats >= std::chrono::milliseconds(FILTER_STATS_INTERVAL))
+					{
+						string statistics;
+						m_filterPipeline->getStatistics(statistics);
+						lock_guard<mutex> statsGuard(m_filterStatsMutex);
+						m_filterStatistics = statistics;
+						m_lastFilterStats = now;
+					}
 
 					/*
 					 * If filtering removed all the readings then simply clean up m_data and
@@ -571,7 +848,7 @@ void Ingest::processQueue()
 		}
 			
 		/**
-		 * 'm_data' vector is ready to be sent to storage service.
+		 * 'm_data' vector is ready to be queued for the storage writer.
 		 *
 		 * Note: m_data might contain:
 		 * - Readings set by the configured service "plugin" 
@@ -583,67 +860,301 @@ void Ingest::processQueue()
 		 */
 		if (!m_data->empty())
 		{
-			if (m_storage.readingAppend(*m_data) == false)
-			{
-				if (!m_storageFailed)
-					m_logger->warn("Failed to write readings to storage layer, queue for resend");
-				m_storageFailed = true;
-				m_storesFailed++;
-				m_resendQueues.push_back(m_data);
-				m_data = NULL;
-				m_failCnt = 1;
-			}
-			else
+			queueForWrite(m_data);
+			m_data = NULL;
+		}
+
+		if (m_data)
+		{
+			delete m_data;
+			m_data = NULL;
+		}
+	} while (m_readings.blockReady() || (m_running == false && m_readings.pending() > 0));
+}
+
+/**
+ * Queue a block of filtered readings for the storage writer. The
+ * filter stage waits whilst the queue is full, the time it waits is
+ * reported as the filter stall statistic.
+ *
+ * @param readings	The readings to write
+ */
+void Ingest::queueForWrite(vector<Reading *> *readings)
+{
+	unique_lock<mutex> lck(m_writeMutex);
+	if (m_writeQueue.size() >= INGEST_WRITE_QUEUE && !m_writerStop)
+	{
+		auto start = chrono::steady_clock::now();
+		m_writeCv.wait(lck, [this]{ return m_writeQueue.size() < INGEST_WRITE_QUEUE || m_writerStop; });
+		m_filterStall += (unsigned long)chrono::duration_cast<chrono::milliseconds>(chrono::steady_clock::now() - start).count();
+	}
+	m_writeQueue.push_back(readings);
+	m_writeQueued += readings->size();
+	m_writeMetrics.enqueue(readings->size());
+	m_writeBytes += Reading::getMemorySize(*readings);
+	m_writeCv.notify_all();
+}
+
+/**
+ * The storage writer stage of the ingest pipeline. Blocks of filtered
+ * readings are taken from the write queue and appended to the storage
+ * layer, so that the filtering of the next block overlaps the write.
+ * The time the writer waits for data whilst readings are queued for
+ * the filter stage is reported as the write stall statistic.
+ *
+ * The writer returns once it has been stopped and the queue is empty.
+ */
+void Ingest::processWrites()
+{
+	while (true)
+	{
+		/*
+		 * If we have some data that has been previously filtered but failed to send,
+		 * then first try to send that data.
+		 */
+		bool resent = resendReadings();
+
+		vector<Reading *> *readings;
+		{
+			unique_lock<mutex> lck(m_writeMutex);
+			if (m_writeQueue.empty())
 			{
-				if (m_storageFailed)
+				if (m_writerStop)
 				{
-					m_logger->warn("Storage operational after %d failures", m_storesFailed);
-					m_storageFailed = false;
-					m_storesFailed = 0;
+					return;
 				}
-				m_failCnt = 0;
-				std::map<std::string, int>		statsEntriesCurrQueue;
-				// check if this requires addition of a new asset tracker tuple
-				// Remove the Readings in the vector
-				AssetTracker *tracker = AssetTracker::getAssetTracker();
-				string lastAsset = "";
-				int *lastStat = NULL;
-				for (vector<Reading *>::iterator it = m_data->begin(); it != m_data->end(); ++it)
+				bool backlog = m_readings.pending() > 0;
+				auto start = chrono::steady_clock::now();
+				if (resent)
 				{
-					Reading *reading = *it;
-					string	assetName = reading->getAssetName();
-					if (lastAsset.compare(assetName))
-					{
-						AssetTrackingTuple tuple(m_serviceName, m_pluginName, assetName, "Ingest");
-						if (!tracker->checkAssetTrackingCache(tuple))
-						{
-							tracker->addAssetTrackingTuple(tuple);
-						}
-						lastAsset = assetName;
-						lastStat = &statsEntriesCurrQueue[assetName];
-						(*lastStat)++;
-					}
-					else if (lastStat)
-					{
-						(*lastStat)++;
-					}
-					delete reading;
+					m_writeCv.wait(lck, [this]{ return !m_writeQueue.empty() || m_writerStop; });
+				}
+				else
+				{
+					// Wake up to retry the queued readings
+					m_writeCv.wait_for(lck, chrono::milliseconds(SPILL_RETRY_INTERVAL),
+						[this]{ return !m_writeQueue.empty() || m_writerStop; });
 				}
+				if (backlog)
 				{
-					unique_lock<mutex> lck(m_statsMutex);
-					for (auto &it : statsEntriesCurrQueue)
-						statsPendingEntries[it.first] += it.second;
+					m_writeStall += (unsigned long)chrono::duration_cast<chrono::milliseconds>(chrono::steady_clock::now() - start).count();
+				}
+				if (m_writeQueue.empty())
+				{
+					if (m_writerStop)
+					{
+						return;
+					}
+					continue;
 				}
 			}
+			readings = m_writeQueue.front();
+			m_writeQueue.pop_front();
+			m_writeQueued -= readings->size();
+			m_writeMetrics.dequeue(readings->size());
+			m_writeCv.notify_all();
 		}
+		size_t bytes = Reading::getMemorySize(*readings);
+		writeReadings(readings);
+		m_writeBytes -= bytes;
+	}
+}
 
-		if (m_data)
+/**
+ * Retry the blocks of readings that previously failed to be written
+ * to the storage layer, in the order they were queued. Whilst the
+ * storage layer is failing a retry is only made every
+ * SPILL_RETRY_INTERVAL milliseconds.
+ *
+ * @return bool	True if all the queued blocks have been written
+ */
+bool Ingest::resendReadings()
+{
+	if (m_spill.empty())
+	{
+		return true;
+	}
+	if (m_storageFailed && chrono::steady_clock::now() - m_lastResend
+			< chrono::milliseconds(SPILL_RETRY_INTERVAL))
+	{
+		return false;
+	}
+	vector<Reading *> *q;
+	while ((q = m_spill.front()) != NULL)
+	{
+		if (q->size() > 0 && m_storage.readingAppend(*q) == false)
 		{
-			delete m_data;
-			m_data = NULL;
+			if (!m_storageFailed)
+				m_logger->info("Still unable to resend buffered data, leaving on resend queue.");
+			m_storageFailed = true;
+			m_storesFailed++;
+			m_lastResend = chrono::steady_clock::now();
+			m_resendBlocks = m_spill.inMemory();
+			m_resendBytes = m_spill.memoryBytes();
+			return false;
+		}
+		if (m_storageFailed)
+		{
+			m_logger->warn("Storage operational after %d failures", m_storesFailed);
+			m_storageFailed = false;
+			m_storesFailed = 0;
 		}
+		m_spill.pop();
+		m_resendMetrics.dequeue();
+		recordStored(q);
+		delete q;
 		signalStatsUpdate();
-	} while (! m_fullQueues.empty());
+		m_resendBlocks = m_spill.inMemory();
+		m_resendBytes = m_spill.memoryBytes();
+	}
+	return true;
+}
+
+/**
+ * Queue a block of readings to be written once the storage layer is
+ * available. The readings are discarded if the spill queue is full.
+ *
+ * @param readings	The readings to queue
+ */
+void Ingest::queueForResend(vector<Reading *> *readings)
+{
+	m_spill.setMaxMemory(m_memoryHigh * MEMORY_RESEND_PERCENT / 100);
+	if (m_spill.push(readings))
+	{
+		m_resendMetrics.enqueue();
+	}
+	else
+	{
+		for (auto reading : *readings)
+		{
+			delete reading;
+			logDiscardedStat();
+		}
+		delete readings;
+	}
+	m_resendBlocks = m_spill.inMemory();
+	m_resendBytes = m_spill.memoryBytes();
+}
+
+/**
+ * Write a block of readings to the storage layer, the readings are
+ * queued for resend if the write fails. If there are readings already
+ * queued the block is queued behind them to keep the readings in order.
+ *
+ * @param readings	The readings to write
+ */
+void Ingest::writeReadings(vector<Reading *> *readings)
+{
+	TRACE_SPAN("ingest", "Ingest::writeReadings");
+	ALLOC_SCOPE(ALLOC_SOUTH_INGEST);
+	if (!m_spill.empty())
+	{
+		queueForResend(readings);
+		return;
+	}
+	if (m_storage.readingAppend(*readings) == false)
+	{
+		if (!m_storageFailed)
+			m_logger->warn("Failed to write readings to storage layer, queue for resend");
+		m_storageFailed = true;
+		m_storesFailed++;
+		m_lastResend = chrono::steady_clock::now();
+		queueForResend(readings);
+		return;
+	}
+	if (m_storageFailed)
+	{
+		m_logger->warn("Storage operational after %d failures", m_storesFailed);
+		m_storageFailed = false;
+		m_storesFailed = 0;
+	}
+	recordStored(readings);
+	delete readings;
+	signalStatsUpdate();
+}
+
+/**
+ * Account for a block of readings that has been written to the storage
+ * layer. The asset tracking tuples are added for any new assets, the
+ * readings are counted against their assets and then deleted. Each
+ * asset is only checked against the asset tracker the first time it
+ * is seen.
+ *
+ * @param readings	The readings that were written
+ */
+void Ingest::recordStored(vector<Reading *> *readings)
+{
+	std::unordered_map<InternedString, int>	statsEntriesCurrQueue;
+	struct timeval now, created;
+	gettimeofday(&now, NULL);
+	double latencySum = 0.0, latencyMax = 0.0;
+	size_t stored = readings->size();
+	m_storeLag.record(readings->begin(), readings->end(), true, now);
+	// check if this requires addition of a new asset tracker tuple
+	// Remove the Readings in the vector
+	AssetTracker *tracker = AssetTracker::getAssetTracker();
+	InternedString lastAsset;
+	int *lastStat = NULL;
+	for (vector<Reading *>::iterator it = readings->begin(); it != readings->end(); ++it)
+	{
+		Reading *reading = *it;
+		const InternedString& assetName = reading->getInternedAssetName();
+		if (lastAsset != assetName)
+		{
+			// Only assets not seen before need a lookup in the asset tracker
+			if (m_trackedAssets.insert(assetName).second)
+			{
+				AssetTrackingTuple tuple(m_serviceName, m_pluginName, assetName, "Ingest");
+				if (!tracker->checkAssetTrackingCache(tuple))
+				{
+					tracker->addAssetTrackingTuple(tuple);
+				}
+			}
+			lastAsset = assetName;
+			lastStat = &statsEntriesCurrQueue[assetName];
+			(*lastStat)++;
+		}
+		else if (lastStat)
+		{
+			(*lastStat)++;
+		}
+		reading->getTimestamp(&created);
+		double latency = (now.tv_sec - created.tv_sec) + (now.tv_usec - created.tv_usec) / 1000000.0;
+		latencySum += latency;
+		if (latency > latencyMax)
+		{
+			latencyMax = latency;
+		}
+		delete reading;
+	}
+	readings->clear();
+	// Send any new tuples, including those of the filters, in one request
+	tracker->flush();
+	unique_lock<mutex> lck(m_statsMutex);
+	for (auto &it : statsEntriesCurrQueue)
+		statsPendingEntries[it.first] += it.second;
+	m_storedReadings += stored;
+	m_latencySum += latencySum;
+	if (latencyMax > m_latencyMax)
+	{
+		m_latencyMax = latencyMax;
+	}
+}
+
+/**
+ * Return the latency of the readings written to storage, from the
+ * creation of each reading to the commit of the block that contained it
+ *
+ * @param mean		Set to the mean latency in seconds
+ * @param max		Set to the largest latency in seconds
+ * @return unsigned long	The number of readings written to storage
+ */
+unsigned long Ingest::getCommitLatency(double& mean, double& max)
+{
+	lock_guard<mutex> guard(m_statsMutex);
+	mean = m_storedReadings ? m_latencySum / m_storedReadings : 0.0;
+	max = m_latencyMax;
+	return m_storedReadings;
 }
 
 /**
@@ -666,33 +1177,66 @@ bool Ingest::loadFilters(const string& categoryName)
 	/*
 	 * We do everything to setup the pipeline using a local FilterPipeline and then assign it
 	 * to the service m_filterPipeline once it is setup to guard against access to the pipeline
-	 * during setup.
-	 * This should not be an issue if the mutex is held, however this approach lessens the risk
-	 * in the case of this routine being called when the mutex is not held and ensure m_filterPipeline
-	 * only ever points to a fully configured filter pipeline.
+	 * during setup. This ensures m_filterPipeline only ever points to a fully configured
+	 * filter pipeline.
 	 */
+	FilterPipeline *filterPipeline = createPipeline(categoryName);
+	if (!filterPipeline)
+	{
+		return false;
+	}
 	lock_guard<mutex> guard(m_pipelineMutex);
+	m_filterPipeline = filterPipeline;
+	return true;
+}
+
+/**
+ * Load and setup a new filter pipeline. The pipeline mutex is not held
+ * so that data continues to flow through any current pipeline.
+ *
+ * @param categoryName	Configuration category name
+ * @return		The new pipeline or NULL on load/init errors
+ */
+FilterPipeline *Ingest::createPipeline(const string& categoryName)
+{
 	FilterPipeline *filterPipeline = new FilterPipeline(m_mgtClient, m_storage, m_serviceName);
 	
 	// Try to load filters:
 	if (!filterPipeline->loadFilters(categoryName))
 	{
-		// Return false on any error
-		return false;
+		delete filterPipeline;
+		return NULL;
 	}
 
 	// Set up the filter pipeline
-	bool rval = filterPipeline->setupFiltersPipeline((void *)passToOnwardFilter, (void *)useFilteredData, this);
-	if (rval)
-	{
-		m_filterPipeline = filterPipeline;
-	}
-	else
+	if (!filterPipeline->setupFiltersPipeline((void *)passToOnwardFilter, (void *)useFilteredData, this))
 	{
 		Logger::getLogger()->error("Failed to setup the filter pipeline, the filters are not attached to the service");
 		filterPipeline->cleanupFilters(categoryName);
+		delete filterPipeline;
+		return NULL;
+	}
+	return filterPipeline;
+}
+
+/**
+ * Shutdown a pipeline that has been replaced, in a thread of its own so
+ * that the ingest of data is not held up by the shutdown of the filters.
+ * The pipeline must no longer be referenced by m_filterPipeline.
+ *
+ * @param pipeline	The pipeline to shutdown
+ */
+void Ingest::retirePipeline(FilterPipeline *pipeline)
+{
+	if (m_retireThread.joinable())
+	{
+		m_retireThread.join();
 	}
-	return rval;
+	m_retireThread = thread([this, pipeline]() {
+		pipeline->cleanupFilters(m_serviceName);
+		delete pipeline;
+		Logger::getLogger()->info("The replaced filter pipeline has been shutdown");
+	});
 }
 
 /**
@@ -739,6 +1283,10 @@ void Ingest::passToOnwardFilter(OUTPUT_HANDLE *outHandle,
 void Ingest::useFilteredData(OUTPUT_HANDLE *outHandle,
 			     READINGSET *readingSet)
 {
+	if (FilterPipeline::collectPartition(readingSet))
+	{
+		return;
+	}
 	Ingest* ingest = (Ingest *)outHandle;
 	if (ingest->m_data != readingSet->getAllReadingsPtr())
 	{
@@ -787,29 +1335,42 @@ void Ingest::configChange(const string& category, const string& newConfig)
 								  "it hasn't changed");
 					return;
 				}
-				/* The new filter pipeline is different to what we have already running
-				 * So remove the current pipeline and recreate.
+				/* The new filter pipeline is different to what we have already running.
+				 * The new pipeline is setup while data continues to flow through the
+				 * current pipeline and then replaces it. Python filters share their
+				 * module between the instances of the filter, a pipeline with Python
+				 * filters is removed before the new pipeline is created.
 			 	 */
-				m_running = false;
 				Logger::getLogger()->info("Ingest::configChange(): "
 							  "filter pipeline has changed, "
 							  "recreating filter pipeline");
-				m_filterPipeline->cleanupFilters(m_serviceName);
-				delete m_filterPipeline;
-				m_filterPipeline = NULL;
+				if (m_filterPipeline->hasPythonFilters())
+				{
+					m_running = false;
+					m_filterPipeline->cleanupFilters(m_serviceName);
+					delete m_filterPipeline;
+					m_filterPipeline = NULL;
+				}
 			}
 		}
 
 		/*
 		 * We have to setup a new pipeline to match the changed configuration.
-		 * Release the lock before reloading the filters as this will acquire
-		 * the lock again
+		 * The lock is not held whilst the new pipeline is setup.
 		 */
-		loadFilters(category);
+		FilterPipeline *filterPipeline = createPipeline(category);
 
-		// Set m_running holding the lock
-		lock_guard<mutex> guard(m_pipelineMutex);
-		m_running = true;
+		FilterPipeline *replaced;
+		{
+			lock_guard<mutex> guard(m_pipelineMutex);
+			replaced = m_filterPipeline;
+			m_filterPipeline = filterPipeline;
+			m_running = true;
+		}
+		if (replaced)
+		{
+			retirePipeline(replaced);
+		}
 	}
 	else
 	{
@@ -829,16 +1390,247 @@ void Ingest::configChange(const string& category, const string& newConfig)
 	}
 }
 
+/**
+ * Return the statistics of the filters of the pipeline, the effective
+ * poll rate of the plugin and the lag of the readings when they are
+ * stored, as reported by the ping entry point of the management API
+ *
+ * @param json	Set to the JSON object with the statistics
+ */
+void Ingest::asJSON(string& json) const
+{
+	lock_guard<mutex> guard(m_filterStatsMutex);
+	json = "{ \"filters\" : " + (m_filterStatistics.empty() ? string("[]") : m_filterStatistics);
+	if (m_pollRate > 0.0)
+	{
+		char buf[100];
+		snprintf(buf, sizeof(buf), ", \"poll\" : { \"rate\" : %.3f, \"throttle\" : %.1f }",
+				m_pollRate, m_pollThrottle * 100);
+		json += buf;
+	}
+	if (m_memoryHigh)
+	{
+		char buf[100];
+		snprintf(buf, sizeof(buf), ", \"memory\" : { \"used\" : %lu, \"limit\" : %lu }",
+				(unsigned long)memoryUsage(), (unsigned long)m_memoryHigh);
+		json += buf;
+	}
+	if (m_changeOfValue.isEnabled())
+	{
+		char buf[80];
+		snprintf(buf, sizeof(buf), ", \"changeOfValue\" : { \"suppressed\" : %lu }",
+				m_changeOfValue.getSuppressed());
+		json += buf;
+	}
+	{
+		char buf[80];
+		snprintf(buf, sizeof(buf), ", \"batch\" : { \"size\" : %.1f, \"adaptive\" : %s }",
+				(double)m_batchSize, m_adaptiveBatching ? "true" : "false");
+		json += buf;
+	}
+	string lag;
+	m_storeLag.asJSON(lag);
+	json += ", \"storeLag\" : " + lag;
+	json += " }";
+}
+
+/**
+ * Record the polls of the plugin. The polls are added to the statistics
+ * and the effective poll rate is reported with the filter statistics.
+ *
+ * @param polls		The number of polls
+ * @param seconds	The time in seconds over which the polls were made
+ */
+void Ingest::recordPolls(unsigned long polls, double seconds)
+{
+	m_polls += polls;
+	if (seconds > 0.0)
+	{
+		lock_guard<mutex> guard(m_filterStatsMutex);
+		m_pollRate = polls / seconds;
+	}
+}
+
+/**
+ * Set the poll rate the throttling has set, as a fraction of the
+ * configured poll rate
+ *
+ * @param rate	The fraction of the configured poll rate
+ */
+void Ingest::setPollThrottle(double rate)
+{
+	lock_guard<mutex> guard(m_filterStatsMutex);
+	m_pollThrottle = rate;
+}
+
+/**
+ * Set the limit on the approximate memory used by the readings buffered
+ * in the south service. Once the limit is reached new readings are
+ * discarded until the memory falls below the low water mark. Blocks of
+ * readings waiting for the storage layer are spilled to disk once they
+ * use more than part of the limit.
+ *
+ * @param bytes	The memory limit in bytes, 0 for no limit
+ */
+void Ingest::setMemoryLimit(size_t bytes)
+{
+	m_memoryHigh = bytes;
+	m_memoryLow = bytes / 100 * MEMORY_LOW_WATER_PERCENT;
+	if (bytes == 0)
+	{
+		m_memoryFull = false;
+	}
+}
+
+/**
+ * Check if the memory used by the buffered readings has reached the
+ * memory limit. Once the limit is reached this remains true until the
+ * memory used falls below the low water mark.
+ *
+ * @return bool	True if new readings should be discarded
+ */
+bool Ingest::memoryFull()
+{
+	size_t high = m_memoryHigh;
+	if (high == 0)
+	{
+		return false;
+	}
+	size_t used = memoryUsage();
+	if (m_memoryFull)
+	{
+		if (used > m_memoryLow)
+		{
+			return true;
+		}
+		bool full = true;
+		if (m_memoryFull.compare_exchange_strong(full, false))
+		{
+			m_logger->warn("Buffered readings are below %lu bytes, new readings are accepted again",
+					(unsigned long)m_memoryLow);
+		}
+		return false;
+	}
+	if (used < high)
+	{
+		return false;
+	}
+	bool full = false;
+	if (m_memoryFull.compare_exchange_strong(full, true))
+	{
+		m_logger->warn("Buffered readings have reached the memory limit of %lu bytes, readings are being discarded",
+				(unsigned long)high);
+	}
+	return true;
+}
+
+/**
+ * Set the policy used to shed readings whilst the buffered readings
+ * are at the memory limit
+ *
+ * The policies are
+ *	Discard Newest	New readings are discarded
+ *	Discard Oldest	New readings are accepted, the oldest queued
+ *			readings are discarded by processQueue
+ *	Keep Latest	Only the latest reading of each asset is kept
+ *	Sample		One in every sampleInterval new readings is kept
+ *
+ * @param policy		The name of the policy
+ * @param sampleInterval	The interval of the Sample policy
+ */
+void Ingest::setDiscardPolicy(const string& policy, unsigned long sampleInterval)
+{
+	DiscardPolicy discard = DiscardNewest;
+	if (policy.compare("Discard Oldest") == 0)
+		discard = DiscardOldest;
+	else if (policy.compare("Keep Latest") == 0)
+		discard = DiscardConflate;
+	else if (policy.compare("Sample") == 0)
+		discard = DiscardSample;
+	else if (policy.compare("Discard Newest") != 0)
+		m_logger->warn("Unknown discard policy '%s', new readings will be discarded", policy.c_str());
+	m_sampleInterval = sampleInterval > 0 ? sampleInterval : 1;
+	m_discardPolicy = discard;
+	if (discard != DiscardConflate)
+	{
+		// Readings held by a previous Keep Latest policy are sent with the next block
+		m_cv.notify_all();
+	}
+}
+
+/**
+ * Apply the discard policy to a reading that arrived whilst the
+ * buffered readings are at the memory limit
+ *
+ * @param reading	The reading, the memory of which has been counted
+ * @return Reading*	The reading to queue or NULL if it was discarded or held
+ */
+Reading *Ingest::shedReading(Reading *reading)
+{
+	switch (m_discardPolicy)
+	{
+		case DiscardOldest:
+			return reading;
+		case DiscardSample:
+			if (m_sampleCount++ % m_sampleInterval == 0)
+			{
+				return reading;
+			}
+			break;
+		case DiscardConflate:
+		{
+			lock_guard<mutex> guard(m_conflatedMutex);
+			auto res = m_conflated.emplace(reading->getAssetName(), reading);
+			if (res.second)
+			{
+				return NULL;
+			}
+			// Replace the older reading of the asset
+			Reading *older = res.first->second;
+			res.first->second = reading;
+			reading = older;
+			break;
+		}
+		default:
+			break;
+	}
+	m_queuedBytes -= reading->getMemorySize();
+	delete reading;
+	logDiscardedStat();
+	return NULL;
+}
+
+/**
+ * Move the latest readings of each asset held by the Keep Latest
+ * policy to a reading queue. Must be called with m_conflatedMutex held.
+ *
+ * @param queue	The queue to append the readings to
+ */
+void Ingest::drainConflated(vector<Reading *> *queue)
+{
+	if (m_conflated.empty())
+	{
+		return;
+	}
+	for (auto& latest : m_conflated)
+	{
+		queue->push_back(latest.second);
+	}
+	m_inputMetrics.enqueue(m_conflated.size());
+	m_conflated.clear();
+}
+
 /**
  * Return the numebr fo queued readings in the south service
  */
 size_t Ingest::queueLength()
 {
-	size_t	len = m_queue->size();
+	size_t	len = m_readings.pending() + m_conflated.size();
 
 	// Approximate the amount of data in the full queues
-	len += m_fullQueues.size() * m_queueSizeThreshold;
-	len += m_resendQueues.size() * m_queueSizeThreshold;
+	len += m_readings.fullBlocks() * m_queueSizeThreshold;
+	len += m_resendBlocks * m_queueSizeThreshold;
+	len += m_writeQueued;
 
 	return len;
 }
@@ -0,0 +1,224 @@
+/*
+ * Fledge south service queue of ingested readings.
+ *
+ * Copyright (c) 2026 Dianomic Systems
+ *
+ * Released under the Apache 2.0 Licence
+ *
+ * Author: agent
+ */
+#include <ingest_queue.h>
+
+using namespace std;
+
+/**
+ * Construct the queue of ingested readings
+ *
+ * @param ringSize	The number of readings the lock free ring can hold
+ * @param threshold	The number of readings in a full block
+ */
+IngestQueue::IngestQueue(size_t ringSize, unsigned int threshold) :
+	m_threshold(threshold), m_ring(ringSize), m_overflow(false), m_fullCount(0)
+{
+	m_queue = new vector<Reading *>;
+}
+
+/**
+ * Destructor for the queue, any readings that have not been taken
+ * are deleted
+ */
+IngestQueue::~IngestQueue()
+{
+	Reading *reading;
+	while (m_ring.pop(reading))
+	{
+		delete reading;
+	}
+	while (!m_fullQueues.empty())
+	{
+		m_queue->insert(m_queue->end(), m_fullQueues.front()->begin(), m_fullQueues.front()->end());
+		delete m_fullQueues.front();
+		m_fullQueues.pop();
+	}
+	for (auto& reading : *m_queue)
+	{
+		delete reading;
+	}
+	delete m_queue;
+}
+
+/**
+ * Add a single reading to the queue. May be called from any thread.
+ *
+ * @param reading	The reading to add
+ * @return bool		True if a full block of readings is queued
+ */
+bool IngestQueue::push(Reading *reading)
+{
+	if (!m_overflow)
+	{
+		size_t count;
+		if (m_ring.push(reading, count))
+		{
+			return count >= m_threshold;
+		}
+	}
+	lock_guard<mutex> guard(m_mutex);
+	m_overflow = true;
+	queueLocked(reading);
+	return m_fullCount > 0;
+}
+
+/**
+ * Add a set of readings to the queue. May be called from any thread.
+ *
+ * @param readings	The readings to add
+ * @return bool		True if a full block of readings is queued or
+ *			the locked queue is approaching a full block
+ */
+bool IngestQueue::push(const vector<Reading *>& readings)
+{
+	lock_guard<mutex> guard(m_mutex);
+	m_overflow = true;
+	for (auto& reading : readings)
+	{
+		queueLocked(reading);
+	}
+	return m_fullCount > 0 || m_queue->size() > m_threshold * 3 / 4;
+}
+
+/**
+ * Add a reading to the locked queue, moving the queue to the full
+ * blocks once it reaches the threshold. Must be called with m_mutex held.
+ *
+ * @param reading	The reading to add
+ */
+void IngestQueue::queueLocked(Reading *reading)
+{
+	m_queue->push_back(reading);
+	if (m_queue->size() >= m_threshold)
+	{
+		m_fullQueues.push(m_queue);
+		m_fullCount++;
+		m_queue = new vector<Reading *>;
+	}
+}
+
+/**
+ * Take the next block of readings, oldest first. Must only be called
+ * from the consumer thread.
+ *
+ * A block is at most the threshold number of readings from the ring,
+ * else the next full block, else the readings that remain in the ring
+ * followed by the locked queue. Only the last empties the queue of
+ * readings and allows single readings back onto the ring.
+ *
+ * @param all		Set to true if the block holds all the queued readings
+ * @return vector*	The block of readings, which may be empty
+ */
+vector<Reading *> *IngestQueue::take(bool& all)
+{
+	vector<Reading *> *block = new vector<Reading *>;
+	all = false;
+
+	// A producer publishes a reading to the ring before it adds the
+	// next to the locked queue, so with the lock held the ring holds
+	// every reading older than those of the locked queue
+	lock_guard<mutex> guard(m_mutex);
+	drainRing(block, m_threshold);
+	if (block->size() >= m_threshold)
+	{
+		return block;
+	}
+	if (!m_fullQueues.empty())
+	{
+		// The readings left in the ring are older than the full blocks
+		if (block->empty())
+		{
+			delete block;
+			block = m_fullQueues.front();
+			m_fullQueues.pop();
+			m_fullCount--;
+		}
+		return block;
+	}
+	if (block->empty())
+	{
+		delete block;
+		block = m_queue;
+		m_queue = new vector<Reading *>;
+	}
+	else
+	{
+		block->insert(block->end(), m_queue->begin(), m_queue->end());
+		m_queue->clear();
+	}
+	m_overflow = false;
+	all = true;
+	return block;
+}
+
+/**
+ * Move readings from the ring to a block. Must only be called from
+ * the consumer thread.
+ *
+ * @param block	The block to append the readings to
+ * @param max	The most readings to move
+ */
+void IngestQueue::drainRing(vector<Reading *> *block, size_t max)
+{
+	Reading *reading;
+	size_t	n = m_ring.size();
+
+	if (n > max)
+		n = max;
+	block->reserve(block->size() + n);
+	while (n-- > 0 && m_ring.pop(reading))
+	{
+		block->push_back(reading);
+	}
+}
+
+/**
+ * Return the oldest reading in the queue without removing it. Must only
+ * be called from the consumer thread.
+ *
+ * @param reading	Set to the oldest reading
+ * @return bool		False if the queue is empty
+ */
+bool IngestQueue::oldest(Reading*& reading)
+{
+	if (m_ring.peek(reading))
+	{
+		return true;
+	}
+	lock_guard<mutex> guard(m_mutex);
+	if (!m_fullQueues.empty() && !m_fullQueues.front()->empty())
+	{
+		reading = m_fullQueues.front()->front();
+		return true;
+	}
+	if (!m_queue->empty())
+	{
+		reading = m_queue->front();
+		return true;
+	}
+	return false;
+}
+
+/**
+ * Return true if a full block of readings can be taken
+ */
+bool IngestQueue::blockReady() const
+{
+	return m_fullCount > 0 || m_ring.size() >= m_threshold;
+}
+
+/**
+ * Return the number of readings queued that are not in a full block
+ */
+size_t IngestQueue::pending()
+{
+	lock_guard<mutex> guard(m_mutex);
+	return m_ring.size() + m_queue->size();
+}
@@ -0,0 +1,91 @@
+/*
+ * Fledge south service poll rate controller.
+ *
+ * Copyright (c) 2026 Dianomic Systems
+ *
+ * Released under the Apache 2.0 Licence
+ *
+ * Author: agent
+ */
+#include <poll_rate_controller.h>
+
+/**
+ * Construct a controller that runs at the full poll rate
+ *
+ * @param target	The target occupancy of the ingest queue
+ */
+PollRateController::PollRateController(double target)
+{
+	setTarget(target);
+	reset();
+}
+
+/**
+ * Set the target occupancy of the ingest queue
+ *
+ * @param target	The target occupancy
+ */
+void PollRateController::setTarget(double target)
+{
+	m_target = target > 1.0 ? target : 1.0;
+}
+
+/**
+ * Return the controller to the full poll rate and discard its history
+ */
+void PollRateController::reset()
+{
+	m_smoothed = 0.0;
+	m_lastError = 0.0;
+	m_integral = 0.0;
+	m_rate = 1.0;
+	m_first = true;
+}
+
+/**
+ * Update the controller with a new measurement of the occupancy of the
+ * ingest queue
+ *
+ * @param occupancy	The number of readings queued
+ * @param interval	The seconds since the previous update
+ * @return double	The poll rate as a fraction of the configured rate
+ */
+double PollRateController::update(double occupancy, double interval)
+{
+	if (m_first)
+	{
+		m_smoothed = occupancy;
+		m_first = false;
+	}
+	else
+	{
+		m_smoothed += POLL_CONTROL_SMOOTHING * (occupancy - m_smoothed);
+	}
+	double error = (m_smoothed - m_target) / m_target;
+	double derivative = interval > 0.0 ? (error - m_lastError) / interval : 0.0;
+	m_lastError = error;
+
+	// Only integrate when the rate is not held at a limit by the error
+	if (!(m_rate >= 1.0 && error < 0.0) && !(m_rate <= POLL_CONTROL_MIN_RATE && error > 0.0))
+	{
+		m_integral += error * interval;
+	}
+	// The rate can not rise above the configured rate, so there is no
+	// need to remember time spent below the target
+	if (m_integral < 0.0)
+	{
+		m_integral = 0.0;
+	}
+	double output = POLL_CONTROL_KP * error + POLL_CONTROL_KI * m_integral
+				+ POLL_CONTROL_KD * derivative;
+	m_rate = 1.0 - output;
+	if (m_rate > 1.0)
+	{
+		m_rate = 1.0;
+	}
+	else if (m_rate < POLL_CONTROL_MIN_RATE)
+	{
+		m_rate = POLL_CONTROL_MIN_RATE;
+	}
+	return m_rate;
+}
@@ -33,6 +33,10 @@
 #include <filter_plugin.h>
 #include <config_handler.h>
 #include <syslog.h>
+#include <thread_config.h>
+#include <service_allocator.h>
+#include <alloc_profiler.h>
+#include <future>
 
 #define SERVICE_TYPE "Southbound"
 
@@ -189,27 +193,26 @@ void doIngest(Ingest *ingest, Reading reading)
 	ingest->ingest(reading);
 }
 
+/**
+ * Callback called by south plugins to ingest a set of readings into Fledge.
+ * The readings are moved from the set to the Ingest class's queue in one
+ * call, the set itself is freed.
+ *
+ * @param ingest	The ingest class to use
+ * @param set		The set of readings to ingest
+ */
 void doIngestV2(Ingest *ingest, ReadingSet *set)
 {
-    std::vector<Reading *> *vec = set->getAllReadingsPtr();
-    std::vector<Reading *> *vec2 = new std::vector<Reading *>;
-    if (!vec)
-    {
-        Logger::getLogger()->info("%s:%d: V2 async ingest method: vec is NULL", __FUNCTION__, __LINE__);
-        return;
-    }
-    else
-    {
-        for (auto & r : *vec)
-        {
-            Reading *r2 = new Reading(*r); // Need to copy reading objects here, since "del set" below would remove encapsulated reading objects also
-            vec2->emplace_back(r2);
-        }
-    }
-    Logger::getLogger()->debug("%s:%d: V2 async ingest method returned: vec->size()=%d", __FUNCTION__, __LINE__, vec->size());
-
-	ingest->ingest(vec2);
-	delete vec2; 	// each reading object inside vector has been allocated on heap and moved to Ingest class's internal queue
+	std::vector<Reading *> *vec = set->getAllReadingsPtr();
+	if (!vec)
+	{
+		Logger::getLogger()->info("%s:%d: V2 async ingest method: vec is NULL", __FUNCTION__, __LINE__);
+		return;
+	}
+	Logger::getLogger()->debug("%s:%d: V2 async ingest method returned: vec->size()=%d", __FUNCTION__, __LINE__, vec->size());
+
+	ingest->ingest(vec);
+	set->clear();	// The reading objects are now owned by the Ingest class's internal queue
 	delete set;
 }
 
@@ -222,8 +225,17 @@ SouthService::SouthService(const string& myName, const string& token) :
 				m_readingsPerSec(1),
 				m_throttle(false),
 				m_throttled(false),
+				m_polls(0),
 				m_token(token),
-				m_repeatCnt(1)
+				m_repeatCnt(1),
+				m_desiredRepeat(1),
+				m_pollWorkers(1),
+				m_pendingPolls(0),
+				m_runningPolls(0),
+				m_skippedPolls(0),
+				m_workerReadings(0),
+				m_pollWorkersRunning(false),
+				m_pollV2(false)
 {
 	m_name = myName;
 	m_type = SERVICE_TYPE;
@@ -272,13 +284,18 @@ void SouthService::start(string& coreAddress, unsigned short corePort)
 		// Allocate and save ManagementClient object
 		m_mgtClient = new ManagementClient(coreAddress, corePort);
 
-		// Create an empty South category if one doesn't exist
+		// Create an empty South category if one doesn't exist, this is
+		// only needed once the plugin categories are added beneath it
+		// so is done whilst the configuration is fetched
 		DefaultConfigCategory southConfig(string("South"), string("{}"));
 		southConfig.setDescription("South");
-		m_mgtClient->addCategory(southConfig, true);
+		future<bool> parent = async(launch::async, [this, &southConfig]() {
+					return m_mgtClient->addCategory(southConfig, true);
+				});
 
 		// Get configuration for service name
 		m_config = m_mgtClient->getCategory(m_name);
+		parent.wait();
 		if (!loadPlugin())
 		{
 			logger->fatal("Failed to load south plugin, exiting...");
@@ -291,19 +308,35 @@ void SouthService::start(string& coreAddress, unsigned short corePort)
 			logger->info("South plugin has a control facility, adding south service API");
 		}
 
-		if (!m_mgtClient->registerService(record))
+		// Register the service and the interest in its categories whilst
+		// the advanced configuration, storage service and asset tracking
+		// tuples are fetched by a single bootstrap request
+		future<void> registration = async(launch::async, [this, &record]() {
+				if (!m_mgtClient->registerService(record))
+				{
+					logger->error("Failed to register service %s", m_name.c_str());
+				}
+
+				// Register for category content changes
+				ConfigHandler *configHandler = ConfigHandler::getInstance(m_mgtClient);
+				configHandler->registerCategory(this, m_name);
+				configHandler->registerCategory(this, m_name+"Advanced");
+			});
+		string advancedCatName = m_name + string("Advanced");
+		ServiceBootstrap bootstrap;
+		bool bootstrapped = m_mgtClient->getBootstrap(m_name,
+						vector<string>(1, advancedCatName), bootstrap);
+		if (!(bootstrapped && bootstrap.getCategory(advancedCatName, m_configAdvanced)))
 		{
-			logger->error("Failed to register service %s", m_name.c_str());
+			m_configAdvanced = m_mgtClient->getCategory(advancedCatName);
 		}
 
-		// Register for category content changes
-		ConfigHandler *configHandler = ConfigHandler::getInstance(m_mgtClient);
-		configHandler->registerCategory(this, m_name);
-		configHandler->registerCategory(this, m_name+"Advanced");
-
 		// Get a handle on the storage layer
 		ServiceRecord storageRecord("Fledge Storage");
-		if (!m_mgtClient->getService(storageRecord))
+		bool haveStorage = (bootstrapped && bootstrap.getStorage(storageRecord))
+					|| m_mgtClient->getService(storageRecord);
+		registration.wait();
+		if (!haveStorage)
 		{
 			logger->fatal("Unable to find storage service");
 			return;
@@ -346,17 +379,35 @@ void SouthService::start(string& coreAddress, unsigned short corePort)
 					}
 				}
 			}
+			if (m_configAdvanced.itemExists("slabAllocation"))
+			{
+				string slab = m_configAdvanced.getValue("slabAllocation");
+				setReadingSlabAllocation(slab[0] == 't' || slab[0] == 'T');
+			}
+			if (m_configAdvanced.itemExists("threadConfig"))
+			{
+				ThreadConfig::getInstance()->configure(m_configAdvanced.getValue("threadConfig"));
+			}
+			if (m_configAdvanced.itemExists("allocatorConfig"))
+			{
+				ServiceAllocator::getInstance()->configure(m_configAdvanced.getValue("allocatorConfig"));
+			}
+			if (m_configAdvanced.itemExists("asyncLogging"))
+			{
+				string async = m_configAdvanced.getValue("asyncLogging");
+				logger->setAsynchronous(async[0] == 't' || async[0] == 'T');
+			}
+			if (m_configAdvanced.itemExists("pythonPreload"))
+			{
+				PluginManager::getInstance()->preloadPythonModules(m_configAdvanced.getValue("pythonPreload"));
+			}
 			if (m_configAdvanced.itemExists("throttle"))
 			{
 				string throt = m_configAdvanced.getValue("throttle");
 				if (throt[0] == 't' || throt[0] == 'T')
 				{
 					m_throttle = true;
-					m_highWater = threshold
-					       	+ (((float)threshold * SOUTH_THROTTLE_HIGH_PERCENT) / 100.0);
-					m_lowWater = threshold
-					       	+ (((float)threshold * SOUTH_THROTTLE_LOW_PERCENT) / 100.0);
-					logger->info("Throttling is enabled, high water mark is set to %ld", m_highWater);
+					setThrottleTarget(threshold);
 				}
 				else
 				{
@@ -368,11 +419,20 @@ void SouthService::start(string& coreAddress, unsigned short corePort)
 		}
 
 		m_assetTracker = new AssetTracker(m_mgtClient, m_name);
+		if (bootstrapped)
+		{
+			m_assetTracker->populateAssetTrackingCache(bootstrap.getAssetTrackingTuples());
+		}
 
 		{
 		// Instantiate the Ingest class
 		Ingest ingest(storage, timeout, threshold, m_name, pluginName, m_mgtClient);
 		m_ingest = &ingest;
+		management.registerStats(&ingest);
+		setChangeOfValue();
+		setMemoryLimit();
+		setDiscardPolicy();
+		setAdaptiveBatching();
 
 		try {
 			m_readingsPerSec = 1;
@@ -411,22 +471,9 @@ void SouthService::start(string& coreAddress, unsigned short corePort)
 				dividend = 60000000;
 			else if (units.compare("hour") == 0)
 				dividend = 3600000000;
-			unsigned long usecs = dividend / m_readingsPerSec;
-
-			if (usecs > MAX_SLEEP * 1000000)
-			{
-				double x = usecs / (MAX_SLEEP * 1000000);
-				m_repeatCnt = ceil(x);
-				usecs /= m_repeatCnt;
-			}
-			else
-			{
-				m_repeatCnt = 1;
-			}
-			m_desiredRate.tv_sec  = (int)(usecs / 1000000);
-			m_desiredRate.tv_usec = (int)(usecs % 1000000);
-			m_timerfd = createTimerFd(m_desiredRate); // interval to be passed is in usecs
-			m_currentRate = m_desiredRate;
+			setDesiredInterval(dividend / m_readingsPerSec);
+			m_timerfd = createTimerFd(m_currentRate); // interval to be passed is in usecs
+			gettimeofday(&m_lastThrottle, NULL);
 			if (m_timerfd < 0)
 			{
 				logger->fatal("Could not create timer FD");
@@ -478,6 +525,15 @@ void SouthService::start(string& coreAddress, unsigned short corePort)
 				}
 			}
 
+			if (southPlugin->isConcurrentPoll())
+			{
+				if (m_configAdvanced.itemExists("pollWorkers"))
+				{
+					setPollWorkers(strtoul(m_configAdvanced.getValue("pollWorkers").c_str(), NULL, 10));
+				}
+				startPollWorkers(pollInterfaceV2);
+			}
+
 			while (!m_shutdown)
 			{
 				uint64_t exp;
@@ -501,50 +557,24 @@ void SouthService::start(string& coreAddress, unsigned short corePort)
 				{
 					break;
 				}
+				if (m_pollWorkersRunning)
+				{
+					if (dispatchPoll())
+					{
+						throttlePoll();
+					}
+					continue;
+				}
 #if DO_CATCHUP
 				for (uint64_t i=0; i<exp; i++)
 #endif
 				{
-					if (!pollInterfaceV2) // v1 poll method
-					{
-					
-						Reading reading = southPlugin->poll();
-						if (reading.getDatapointCount())
-						{
-							ingest.ingest(reading);
-						}
-						++pollCount;
-					}
-					else // V2 poll method
-					{
-						ReadingSet *set = southPlugin->pollV2();
-                        if (set)
-                        {
-                            std::vector<Reading *> *vec = set->getAllReadingsPtr();
-                            std::vector<Reading *> *vec2 = new std::vector<Reading *>;
-                            if (!vec)
-                            {
-                                Logger::getLogger()->info("%s:%d: V2 poll method: vec is NULL", __FUNCTION__, __LINE__);
-                                continue;
-                            }
-                            else
-                            {
-                                for (auto & r : *vec)
-                                {
-                                    Reading *r2 = new Reading(*r); // Need to copy reading objects here, since "del set" below would remove encapsulated reading objects
-                                    vec2->emplace_back(r2);
-                                }
-                            }
-
-    						ingest.ingest(vec2);
-    						pollCount += (int) vec2->size();
-    						delete vec2; 	// each reading object inside vector has been allocated on heap and moved to Ingest class's internal queue
-    						delete set;
-                        }
-					}
+					pollCount += pollPlugin(pollInterfaceV2);
 					throttlePoll();
 				}
 			}
+			stopPollWorkers();
+			pollCount += m_workerReadings;
 			if (clock_gettime(CLOCK_MONOTONIC, &end) == -1)
 			   Logger::getLogger()->error("polling loop end: clock_gettime");
 			
@@ -616,6 +646,7 @@ void SouthService::start(string& coreAddress, unsigned short corePort)
 				southPlugin->shutdown();
 			}
 		}
+		management.registerStats(NULL);
 		}
 		
 		// Clean shutdown, unregister the storage service
@@ -725,9 +756,7 @@ bool SouthService::loadPlugin()
 			children1.push_back(advancedCatName);
 			m_mgtClient->addChildCategories(m_name, children1);
 
-			// Must now reload the merged configuration
-			m_configAdvanced = m_mgtClient->getCategory(advancedCatName);
-
+			// The merged advanced configuration is fetched by the caller
 			return true;
 		}
 	} catch (exception e) {
@@ -757,7 +786,13 @@ void SouthService::configChange(const string& categoryName, const string& catego
 			category.c_str());
 	if (categoryName.compare(m_name) == 0)
 	{
-		m_config = ConfigCategory(m_name, category);
+		ConfigCategory config(m_name, category);
+		if (config.getVersion() == m_config.getVersion())
+		{
+			logger->info("Configuration category %s is unchanged", categoryName.c_str());
+			return;
+		}
+		m_config = config;
 		try {
 			southPlugin->reconfigure(category);
 		}
@@ -770,7 +805,13 @@ void SouthService::configChange(const string& categoryName, const string& catego
 	}
 	if (categoryName.compare(m_name+"Advanced") == 0)
 	{
-		m_configAdvanced = ConfigCategory(m_name+"Advanced", category);
+		ConfigCategory config(m_name+"Advanced", category);
+		if (config.getVersion() == m_configAdvanced.getVersion())
+		{
+			logger->info("Configuration category %s is unchanged", categoryName.c_str());
+			return;
+		}
+		m_configAdvanced = config;
 		if (! southPlugin->isAsync())
 		{
 			try {
@@ -786,22 +827,8 @@ void SouthService::configChange(const string& categoryName, const string& catego
 				if (newval != m_readingsPerSec)
 				{
 					m_readingsPerSec = newval;
-					close(m_timerfd);
-					unsigned long usecs = dividend / m_readingsPerSec;
-					if (usecs > MAX_SLEEP * 1000000)
-					{
-						double x = usecs / (MAX_SLEEP * 1000000);
-						m_repeatCnt = ceil(x);
-						usecs /= m_repeatCnt;
-					}
-					else
-					{
-						m_repeatCnt = 1;
-					}
-					m_desiredRate.tv_sec  = (int)(usecs / 1000000);
-					m_desiredRate.tv_usec = (int)(usecs % 1000000);
-					m_currentRate = m_desiredRate;
-					m_timerfd = createTimerFd(m_desiredRate); // interval to be passed is in usecs
+					setDesiredInterval(dividend / m_readingsPerSec);
+					setTimerFd(m_timerfd, m_currentRate);
 				}
 			} catch (ConfigItemNotFound e) {
 				logger->error("Failed to update poll interval following configuration change");
@@ -840,17 +867,43 @@ void SouthService::configChange(const string& categoryName, const string& catego
 				}
 			}
 		}
+		setChangeOfValue();
+		setMemoryLimit();
+		setDiscardPolicy();
+		setAdaptiveBatching();
+		if (m_configAdvanced.itemExists("pollWorkers"))
+		{
+			setPollWorkers(strtoul(m_configAdvanced.getValue("pollWorkers").c_str(), NULL, 10));
+		}
+		if (m_configAdvanced.itemExists("slabAllocation"))
+		{
+			string slab = m_configAdvanced.getValue("slabAllocation");
+			setReadingSlabAllocation(slab[0] == 't' || slab[0] == 'T');
+		}
+		if (m_configAdvanced.itemExists("threadConfig"))
+		{
+			ThreadConfig::getInstance()->configure(m_configAdvanced.getValue("threadConfig"));
+		}
+		if (m_configAdvanced.itemExists("allocatorConfig"))
+		{
+			ServiceAllocator::getInstance()->configure(m_configAdvanced.getValue("allocatorConfig"));
+		}
+		if (m_configAdvanced.itemExists("asyncLogging"))
+		{
+			string async = m_configAdvanced.getValue("asyncLogging");
+			logger->setAsynchronous(async[0] == 't' || async[0] == 'T');
+		}
+		if (m_configAdvanced.itemExists("pythonPreload"))
+		{
+			PluginManager::getInstance()->preloadPythonModules(m_configAdvanced.getValue("pythonPreload"));
+		}
 		if (m_configAdvanced.itemExists("throttle"))
 		{
 			string throt = m_configAdvanced.getValue("throttle");
 			if (throt[0] == 't' || throt[0] == 'T')
 			{
 				m_throttle = true;
-				m_highWater = threshold
-				       	+ (((float)threshold * SOUTH_THROTTLE_HIGH_PERCENT) / 100.0);
-				m_lowWater = threshold
-				       	+ (((float)threshold * SOUTH_THROTTLE_LOW_PERCENT) / 100.0);
-				logger->info("Throttling is enabled, high water mark is set to %ld", m_highWater);
+				setThrottleTarget(threshold);
 			}
 			else
 			{
@@ -895,6 +948,25 @@ void SouthService::addConfigDefaults(DefaultConfigCategory& defaultConfig)
 		defaultConfig.setItemDisplayName("units", "Reading Rate Per");
 	}
 
+	/* Add the change of value modes */
+	vector<string>	covModes = { "Disabled", "Asset", "Datapoint" };
+	defaultConfig.addItem("changeOfValue", "Only pass on readings, or datapoints, whose values have changed",
+			"Disabled", "Disabled", covModes);
+	defaultConfig.setItemDisplayName("changeOfValue", "Change Of Value");
+
+	/* Add the policies used to shed readings at the memory limit */
+	vector<string>	discardPolicies = { "Discard Newest", "Discard Oldest", "Keep Latest", "Sample" };
+	defaultConfig.addItem("discardPolicy", "How readings are discarded when the memory limit is reached",
+			"Discard Newest", "Discard Newest", discardPolicies);
+	defaultConfig.setItemDisplayName("discardPolicy", "Discard Policy");
+
+	if (!isAsync && southPlugin->isConcurrentPoll())
+	{
+		defaultConfig.addItem("pollWorkers", "The number of polls of the plugin that may run concurrently",
+			       "integer", "1", "1");
+		defaultConfig.setItemDisplayName("pollWorkers", "Poll Workers");
+	}
+
 	if (southPlugin->hasControl())
 	{
 		defaultConfig.addItem("control", "Allow write and control operations on the device",
@@ -913,11 +985,40 @@ void SouthService::addConfigDefaults(DefaultConfigCategory& defaultConfig)
  * Create a timer FD on which a read would return data every time the given 
  * interval elapses
  *
- * @param usecs	 Time in micro-secs after which data would be available on the timer FD
+ * @param rate	 The interval after which data would be available on the timer FD
+ * @return int	 The timer FD or -1 on failure
  */
 int SouthService::createTimerFd(struct timeval rate)
 {
 	int fd = -1;
+
+	errno=0;
+	fd = timerfd_create(CLOCK_REALTIME, 0);
+	if (fd == -1)
+	{
+		Logger::getLogger()->error("timerfd_create failed, errno=%d (%s)", errno, strerror(errno));
+		return fd;
+	}
+
+	if (!setTimerFd(fd, rate))
+	{
+		close (fd);
+		return -1;
+	}
+
+	return fd;
+}
+
+/**
+ * Set the interval of an existing timer FD. The first expiry is one
+ * interval from now.
+ *
+ * @param fd	The timer FD
+ * @param rate	The interval between expiries of the timer
+ * @return bool	False if the timer could not be set
+ */
+bool SouthService::setTimerFd(int fd, struct timeval rate)
+{
 	struct itimerspec new_value;
 	struct timespec now;
 
@@ -939,29 +1040,86 @@ int SouthService::createTimerFd(struct timeval rate)
 		new_value.it_interval.tv_sec += new_value.it_interval.tv_nsec/1000000000;
 		new_value.it_interval.tv_nsec %= 1000000000;
 	}
-	
+
 	errno=0;
-	fd = timerfd_create(CLOCK_REALTIME, 0);
-	if (fd == -1)
+	if (timerfd_settime(fd, TFD_TIMER_ABSTIME, &new_value, NULL) == -1)
 	{
-		Logger::getLogger()->error("timerfd_create failed, errno=%d (%s)", errno, strerror(errno));
-		return fd;
+		Logger::getLogger()->error("timerfd_settime failed, errno=%d (%s)", errno, strerror(errno));
+		return false;
 	}
+	return true;
+}
 
-	if (timerfd_settime(fd, TFD_TIMER_ABSTIME, &new_value, NULL) == -1)
+/**
+ * Set the configured interval between polls. Intervals longer than
+ * MAX_SLEEP seconds are made up of a number of shorter timer expiries.
+ * Any throttling of the poll rate is cancelled.
+ *
+ * @param usecs	The interval between polls in microseconds
+ */
+void SouthService::setDesiredInterval(unsigned long usecs)
+{
+	if (usecs > MAX_SLEEP * 1000000)
 	{
-	    Logger::getLogger()->error("timerfd_settime failed, errno=%d (%s)", errno, strerror(errno));
-	    close (fd);
-		return -1;
+		double x = (double)usecs / (MAX_SLEEP * 1000000);
+		m_desiredRepeat = ceil(x);
+		usecs /= m_desiredRepeat;
+	}
+	else
+	{
+		m_desiredRepeat = 1;
 	}
+	m_desiredRate.tv_sec  = (int)(usecs / 1000000);
+	m_desiredRate.tv_usec = (int)(usecs % 1000000);
+	m_currentRate = m_desiredRate;
+	m_repeatCnt = m_desiredRepeat;
+	m_throttled = false;
+	m_pollController.reset();
+}
 
-	return fd;
+/**
+ * Set the interval between polls whilst throttled. The existing timer
+ * FD is set to the new interval rather than being recreated.
+ *
+ * @param interval	The interval between polls in seconds
+ */
+void SouthService::setPollInterval(double interval)
+{
+	unsigned int repeat = 1;
+	if (interval > MAX_SLEEP)
+	{
+		repeat = ceil(interval / MAX_SLEEP);
+		interval /= repeat;
+	}
+	m_currentRate.tv_sec = (long)interval;
+	m_currentRate.tv_usec = (interval - m_currentRate.tv_sec) * 1000000;
+	m_repeatCnt = repeat;
+	setTimerFd(m_timerfd, m_currentRate);
+}
+
+/**
+ * Set the occupancy of the ingest queue that the throttling holds
+ *
+ * @param threshold	The buffer threshold of the service
+ */
+void SouthService::setThrottleTarget(unsigned long threshold)
+{
+	unsigned long target = threshold + ((threshold * SOUTH_THROTTLE_TARGET_PERCENT) / 100);
+	m_pollController.setTarget(target);
+	logger->info("Throttling is enabled, the ingest queue is held at %lu readings", target);
 }
 
 /**
- * If enabled, control the throttling of the poll rate in order to keep
+ * Called after each poll to report the effective poll rate and, if
+ * enabled, control the throttling of the poll rate in order to keep
  * the buffer usage of the service within check.
  *
+ * Every SOUTH_THROTTLE_INTERVAL milliseconds the occupancy of the ingest
+ * queue is passed to the poll rate controller, which returns the poll
+ * rate as a fraction of the configured rate. The timer is only reset if
+ * the interval between polls changes by more than
+ * SOUTH_THROTTLE_CHANGE_PERCENT.
+ *
  * Although this is written as if rate is being control, which it
  * logically is, the actual values are poll intervals. Hence reducing
  * the poll rate increases the value of m_currentRate.
@@ -970,71 +1128,298 @@ void SouthService::throttlePoll()
 {
 struct timeval now, res;
 
+	m_polls++;
+	gettimeofday(&now, NULL);
+	timersub(&now, &m_lastThrottle, &res);
+	double elapsed = res.tv_sec + ((double)res.tv_usec / 1000000);
+	if (elapsed * 1000 < SOUTH_THROTTLE_INTERVAL)
+	{
+		return;
+	}
+	m_lastThrottle = now;
+	m_ingest->recordPolls(m_polls, elapsed);
+	m_polls = 0;
+
 	if (!m_throttle)
 	{
 		return;
 	}
-	double desired = m_desiredRate.tv_sec + ((double)m_desiredRate.tv_usec / 1000000);
-	desired *= m_repeatCnt;
-	gettimeofday(&now, NULL);
-	timersub(&now, &m_lastThrottle, &res);
-	if (m_ingest->queueLength() > m_highWater && res.tv_sec > SOUTH_THROTTLE_DOWN_INTERVAL)
+	double desired = (m_desiredRate.tv_sec + ((double)m_desiredRate.tv_usec / 1000000)) * m_desiredRepeat;
+	double current = (m_currentRate.tv_sec + ((double)m_currentRate.tv_usec / 1000000)) * m_repeatCnt;
+	// Buffered memory at the low water mark counts as the target occupancy
+	double occupancy = m_ingest->queueLength();
+	size_t lowWater = m_ingest->getMemoryLowWater();
+	if (lowWater)
 	{
-		double rate = m_currentRate.tv_sec + ((double)m_currentRate.tv_usec / 1000000);
-		rate *= (1.0 + ((double)SOUTH_THROTTLE_PERCENT / 100.0));
-		if (rate > MAX_SLEEP * 1000000)
+		double memory = m_pollController.getTarget() * m_ingest->memoryUsage() / lowWater;
+		if (memory > occupancy)
 		{
-			double x = rate / (MAX_SLEEP * 1000000);
-			m_repeatCnt = ceil(x);
-			rate /= m_repeatCnt;
+			occupancy = memory;
+		}
+	}
+	double rate = m_pollController.update(occupancy, elapsed);
+	m_ingest->setPollThrottle(rate);
+	double interval = desired / rate;
+	if (fabs(interval - current) * 100 <= current * SOUTH_THROTTLE_CHANGE_PERCENT)
+	{
+		return;
+	}
+	if (rate < 1.0)
+	{
+		setPollInterval(interval);
+		if (!m_throttled)
+		{
+			logger->warn("%s Throttled down poll, rate is now %.1f%% of desired rate", m_name.c_str(), rate * 100);
 		}
 		else
 		{
-			m_repeatCnt = 1;
+			logger->debug("%s Throttled poll, rate is now %.1f%% of desired rate", m_name.c_str(), rate * 100);
 		}
-		m_currentRate.tv_sec = (long)rate;
-		m_currentRate.tv_usec = (rate - m_currentRate.tv_sec) * 1000000;
-		close(m_timerfd);
-		m_timerfd = createTimerFd(m_currentRate); // interval to be passed is in usecs
-		m_lastThrottle = now;
 		m_throttled = true;
-		logger->warn("%s Throttled down poll, rate is now %.1f%% of desired rate", m_name.c_str(), (desired * 100) / rate);
 	}
-	else if (m_throttled && m_ingest->queueLength() < m_lowWater && res.tv_sec > SOUTH_THROTTLE_UP_INTERVAL)
+	else
 	{
-		// We are currently throttled back but the queue is below the low water mark
-		timersub(&m_desiredRate, &m_currentRate, &res);
-		if (res.tv_sec != 0 || res.tv_usec != 0)
+		m_currentRate = m_desiredRate;
+		m_repeatCnt = m_desiredRepeat;
+		setTimerFd(m_timerfd, m_currentRate);
+		m_throttled = false;
+		logger->warn("%s Poll rate returned to configured value", m_name.c_str());
+	}
+}
+
+/**
+ * Configure the removal of unchanged readings by the ingest class
+ * from the advanced configuration
+ */
+void SouthService::setChangeOfValue()
+{
+	string mode = "Disabled";
+	double deadband = 0.0;
+	double maxSilence = 0.0;
+	if (m_configAdvanced.itemExists("changeOfValue"))
+	{
+		mode = m_configAdvanced.getValue("changeOfValue");
+	}
+	if (m_configAdvanced.itemExists("changeDeadband"))
+	{
+		deadband = strtod(m_configAdvanced.getValue("changeDeadband").c_str(), NULL);
+	}
+	if (m_configAdvanced.itemExists("maxSilence"))
+	{
+		maxSilence = strtod(m_configAdvanced.getValue("maxSilence").c_str(), NULL);
+	}
+	m_ingest->setChangeOfValue(mode, deadband, maxSilence);
+}
+
+/**
+ * Set the limit on the memory used by buffered readings from the
+ * advanced configuration
+ */
+void SouthService::setMemoryLimit()
+{
+	if (m_configAdvanced.itemExists("memoryLimit"))
+	{
+		unsigned long megabytes = strtoul(m_configAdvanced.getValue("memoryLimit").c_str(), NULL, 10);
+		m_ingest->setMemoryLimit((size_t)megabytes * 1024 * 1024);
+	}
+}
+
+/**
+ * Set the policy used to shed readings at the memory limit from the
+ * advanced configuration
+ */
+void SouthService::setDiscardPolicy()
+{
+	string policy = "Discard Newest";
+	unsigned long sampleInterval = 10;
+	if (m_configAdvanced.itemExists("discardPolicy"))
+	{
+		policy = m_configAdvanced.getValue("discardPolicy");
+	}
+	if (m_configAdvanced.itemExists("discardSample"))
+	{
+		sampleInterval = strtoul(m_configAdvanced.getValue("discardSample").c_str(), NULL, 10);
+	}
+	m_ingest->setDiscardPolicy(policy, sampleInterval);
+}
+
+/**
+ * Enable or disable the adaptive batching of readings from the
+ * advanced configuration
+ */
+void SouthService::setAdaptiveBatching()
+{
+	if (m_configAdvanced.itemExists("adaptiveBatching"))
+	{
+		m_ingest->setAdaptiveBatching(m_configAdvanced.getValue("adaptiveBatching").compare("true") == 0);
+	}
+}
+
+/**
+ * Poll the plugin once and pass the readings to the ingest class
+ *
+ * @param v2	The plugin supports the version 2 poll interface
+ * @return int	The number of readings returned by the poll
+ */
+int SouthService::pollPlugin(bool v2)
+{
+	ALLOC_SCOPE(ALLOC_SOUTH_INGEST);
+	if (!v2) // v1 poll method
+	{
+		Reading reading = southPlugin->poll();
+		if (reading.getDatapointCount())
 		{
-			double rate = m_currentRate.tv_sec + ((double)m_currentRate.tv_usec / 1000000);
-			rate *= (1.0 - ((double)SOUTH_THROTTLE_PERCENT / 100.0));
-			if (rate > MAX_SLEEP * 1000000)
-			{
-				double x = rate / (MAX_SLEEP * 1000000);
-				m_repeatCnt = ceil(x);
-				rate /= m_repeatCnt;
-			}
-			else
-			{
-				m_repeatCnt = 1;
-			}
-			m_currentRate.tv_sec = (long)rate;
-			m_currentRate.tv_usec = (rate - m_currentRate.tv_sec) * 1000000;
-			if (m_currentRate.tv_sec <= m_desiredRate.tv_sec
-					&& m_currentRate.tv_usec < m_desiredRate.tv_usec)
-			{
-				m_currentRate = m_desiredRate;
-				m_throttled = false;
-				logger->warn("%s Poll rate returned to configured value", m_name.c_str());
-			}
-			else
+			m_ingest->ingest(reading);
+		}
+		return 1;
+	}
+	ReadingSet *set = southPlugin->pollV2();
+	if (!set)
+	{
+		return 0;
+	}
+	int count = 0;
+	std::vector<Reading *> *vec = set->getAllReadingsPtr();
+	if (!vec)
+	{
+		Logger::getLogger()->info("%s:%d: V2 poll method: vec is NULL", __FUNCTION__, __LINE__);
+	}
+	else
+	{
+		m_ingest->ingest(vec);
+		count = (int) vec->size();
+		set->clear();	// each reading object inside vector has been moved to Ingest class's internal queue
+	}
+	delete set;
+	return count;
+}
+
+/**
+ * Set the number of polls of a plugin that supports concurrent polling
+ * which may run at the same time. Workers are added if the poll workers
+ * are running, a reduction just limits the polls handed to the workers.
+ *
+ * @param workers	The number of concurrent polls
+ */
+void SouthService::setPollWorkers(unsigned long workers)
+{
+	if (workers < 1)
+	{
+		workers = 1;
+	}
+	else if (workers > SOUTH_MAX_POLL_WORKERS)
+	{
+		logger->warn("The number of poll workers is limited to %d", SOUTH_MAX_POLL_WORKERS);
+		workers = SOUTH_MAX_POLL_WORKERS;
+	}
+	lock_guard<mutex> guard(m_pollMutex);
+	m_pollWorkers = workers;
+	while (m_pollWorkersRunning && m_pollThreads.size() < m_pollWorkers)
+	{
+		m_pollThreads.push_back(new thread(&SouthService::pollWorker, this, m_pollV2));
+		ThreadConfig::getInstance()->apply(*m_pollThreads.back(), "south-poll");
+	}
+}
+
+/**
+ * Start the worker threads that poll a plugin that supports concurrent
+ * polling
+ *
+ * @param v2	The plugin supports the version 2 poll interface
+ */
+void SouthService::startPollWorkers(bool v2)
+{
+	lock_guard<mutex> guard(m_pollMutex);
+	m_pollV2 = v2;
+	m_pollWorkersRunning = true;
+	while (m_pollThreads.size() < m_pollWorkers)
+	{
+		m_pollThreads.push_back(new thread(&SouthService::pollWorker, this, m_pollV2));
+		ThreadConfig::getInstance()->apply(*m_pollThreads.back(), "south-poll");
+	}
+	logger->info("Started %d poll workers", m_pollWorkers);
+}
+
+/**
+ * Stop the poll workers and wait for the polls they are running to
+ * complete
+ */
+void SouthService::stopPollWorkers()
+{
+	{
+		lock_guard<mutex> guard(m_pollMutex);
+		if (!m_pollWorkersRunning)
+		{
+			return;
+		}
+		m_pollWorkersRunning = false;
+		m_pendingPolls = 0;
+	}
+	m_pollCV.notify_all();
+	for (auto& worker : m_pollThreads)
+	{
+		worker->join();
+		delete worker;
+	}
+	m_pollThreads.clear();
+	if (m_skippedPolls)
+	{
+		logger->info("%lu polls were skipped as all poll workers were busy", m_skippedPolls);
+	}
+}
+
+/**
+ * Hand a poll to an idle poll worker. The poll is skipped if every
+ * worker is busy or already has a poll waiting for it.
+ *
+ * @return bool		True if the poll was handed to a worker
+ */
+bool SouthService::dispatchPoll()
+{
+	{
+		lock_guard<mutex> guard(m_pollMutex);
+		if (m_pendingPolls + m_runningPolls >= m_pollWorkers)
+		{
+			if (m_skippedPolls++ == 0)
 			{
-				logger->warn("%s Throttled up poll, rate is now %.1f%% of desired rate", m_name.c_str(), (desired * 100) / rate);
+				logger->warn("All poll workers are busy, polls are being skipped");
 			}
-			close(m_timerfd);
-			m_timerfd = createTimerFd(m_currentRate); // interval to be passed is in usecs
-			m_lastThrottle = now;
+			return false;
+		}
+		m_pendingPolls++;
+	}
+	m_pollCV.notify_one();
+	return true;
+}
+
+/**
+ * The poll worker thread, polls the plugin each time a poll is handed
+ * to it by the timer thread
+ *
+ * @param v2	The plugin supports the version 2 poll interface
+ */
+void SouthService::pollWorker(bool v2)
+{
+	unique_lock<mutex> guard(m_pollMutex);
+	while (true)
+	{
+		m_pollCV.wait(guard, [this]{ return m_pendingPolls > 0 || !m_pollWorkersRunning; });
+		if (!m_pollWorkersRunning)
+		{
+			break;
+		}
+		m_pendingPolls--;
+		m_runningPolls++;
+		guard.unlock();
+		int count = 0;
+		try {
+			count = pollPlugin(v2);
+		} catch (...) {
+			// The plugin has logged the failure, carry on polling
 		}
+		guard.lock();
+		m_runningPolls--;
+		m_workerReadings += count;
 	}
 }
 
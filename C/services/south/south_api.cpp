@@ -9,6 +9,7 @@
 #include <south_api.h>
 #include <south_service.h>
 #include <rapidjson/document.h>
+#include <thread_config.h>
 
 using namespace std;
 using namespace rapidjson;
@@ -74,6 +75,7 @@ SouthApi::SouthApi(SouthService *service) : m_service(service), m_thread(NULL)
 
 	api = this;
 	m_thread = new thread(startService);
+	ThreadConfig::getInstance()->apply(*m_thread, "south-api");
 }
 
 /**
@@ -14,12 +14,15 @@
 #include <typeinfo>
 #include <stdexcept>
 #include <mutex>
+#include <condition_variable>
 
 using namespace std;
 
 // mutex between various plugin methods, since reconfigure changes the handle 
 // object itself and marks previous handle as garbage collectible by Python runtime
 std::mutex mtx2;
+// signalled when the last concurrent poll of a plugin completes
+std::condition_variable pollsDone;
 
 /**
  * Constructor for the class that wraps the south plugin
@@ -28,7 +31,8 @@ std::mutex mtx2;
  * enclose in the class.
  *
  */
-SouthPlugin::SouthPlugin(PLUGIN_HANDLE handle, const ConfigCategory& category) : Plugin(handle)
+SouthPlugin::SouthPlugin(PLUGIN_HANDLE handle, const ConfigCategory& category) : Plugin(handle),
+	m_activePolls(0)
 {
 	// Call the init method of the plugin
 	PLUGIN_HANDLE (*pluginInit)(const void *) = (PLUGIN_HANDLE (*)(const void *))
@@ -114,7 +118,8 @@ SouthPlugin::SouthPlugin(PLUGIN_HANDLE handle, const ConfigCategory& category) :
  */
 void SouthPlugin::start()
 {
-	lock_guard<mutex> guard(mtx2);
+	unique_lock<mutex> guard(mtx2);
+	waitForPolls(guard);
 	try {
 		return this->pluginStartPtr(instance);
 	} catch (exception& e) {
@@ -134,7 +139,8 @@ void SouthPlugin::start()
  */
 void SouthPlugin::startData(const string& data)
 {
-	lock_guard<mutex> guard(mtx2);
+	unique_lock<mutex> guard(mtx2);
+	waitForPolls(guard);
 	try {
 		return this->pluginStartDataPtr(instance, data);
 	} catch (exception& e) {
@@ -154,6 +160,26 @@ void SouthPlugin::startData(const string& data)
  */
 Reading SouthPlugin::poll()
 {
+	if (isConcurrentPoll())
+	{
+		PLUGIN_HANDLE handle = beginPoll();
+		try {
+			Reading reading = this->pluginPollPtr(handle);
+			endPoll();
+			return reading;
+		} catch (exception& e) {
+			endPoll();
+			Logger::getLogger()->fatal("Unhandled exception raised in south plugin poll(), %s",
+				e.what());
+			throw;
+		} catch (...) {
+			endPoll();
+			std::exception_ptr p = std::current_exception();
+			Logger::getLogger()->fatal("Unhandled exception raised in south plugin poll(), %s",
+				p ? p.__cxa_exception_type()->name() : "unknown exception");
+			throw;
+		}
+	}
 	lock_guard<mutex> guard(mtx2);
 	try {
 		return this->pluginPollPtr(instance);
@@ -174,6 +200,33 @@ Reading SouthPlugin::poll()
  */
 ReadingSet* SouthPlugin::pollV2()
 {
+	if (isConcurrentPoll())
+	{
+		PLUGIN_HANDLE handle = beginPoll();
+		std::vector<Reading *> *vec;
+		try {
+			vec = this->pluginPollPtrV2(handle);
+		} catch (exception& e) {
+			endPoll();
+			Logger::getLogger()->fatal("Unhandled exception raised in v2 south plugin poll(), %s",
+				e.what());
+			throw;
+		} catch (...) {
+			endPoll();
+			std::exception_ptr p = std::current_exception();
+			Logger::getLogger()->fatal("Unhandled exception raised in v2 south plugin poll(), %s",
+				p ? p.__cxa_exception_type()->name() : "unknown exception");
+			throw;
+		}
+		endPoll();
+		if (!vec)
+		{
+			return NULL;
+		}
+		ReadingSet *set = new ReadingSet(vec);
+		delete vec;
+		return set;
+	}
 	lock_guard<mutex> guard(mtx2);
 	try {
         std::vector<Reading *> *vec = this->pluginPollPtrV2(instance);
@@ -197,12 +250,51 @@ ReadingSet* SouthPlugin::pollV2()
 	}
 }
 
+/**
+ * Start a poll of a plugin that may be polled concurrently. The plugin
+ * mutex is only held whilst the poll is counted, so that other polls may
+ * run alongside it, but the methods that replace or shut down the plugin
+ * instance wait for the count to reach zero before they call the plugin.
+ *
+ * @return PLUGIN_HANDLE	The plugin instance to poll
+ */
+PLUGIN_HANDLE SouthPlugin::beginPoll()
+{
+	lock_guard<mutex> guard(mtx2);
+	m_activePolls++;
+	return instance;
+}
+
+/**
+ * Complete a poll started with beginPoll
+ */
+void SouthPlugin::endPoll()
+{
+	lock_guard<mutex> guard(mtx2);
+	if (--m_activePolls == 0)
+	{
+		pollsDone.notify_all();
+	}
+}
+
+/**
+ * Wait, with the plugin mutex held, for any concurrent polls of the
+ * plugin to complete. New polls can not start whilst the mutex is held.
+ *
+ * @param guard	The lock on the plugin mutex
+ */
+void SouthPlugin::waitForPolls(unique_lock<mutex>& guard)
+{
+	pollsDone.wait(guard, [this]{ return m_activePolls == 0; });
+}
+
 /**
  * Call the reconfigure method in the plugin
  */
 void SouthPlugin::reconfigure(const string& newConfig)
 {
-	lock_guard<mutex> guard(mtx2);
+	unique_lock<mutex> guard(mtx2);
+	waitForPolls(guard);
 	try {
 		this->pluginReconfigurePtr(&instance, newConfig);
 		if (!instance)
@@ -228,7 +320,8 @@ void SouthPlugin::reconfigure(const string& newConfig)
  */
 void SouthPlugin::shutdown()
 {
-	lock_guard<mutex> guard(mtx2);
+	unique_lock<mutex> guard(mtx2);
+	waitForPolls(guard);
 	try {
 		return this->pluginShutdownPtr(instance);
 	} catch (exception& e) {
@@ -248,7 +341,8 @@ void SouthPlugin::shutdown()
  */
 string SouthPlugin::shutdownSaveData()
 {
-	lock_guard<mutex> guard(mtx2);
+	unique_lock<mutex> guard(mtx2);
+	waitForPolls(guard);
 	try {
 		return this->pluginShutdownDataPtr(instance);
 	} catch (exception& e) {
@@ -265,7 +359,8 @@ string SouthPlugin::shutdownSaveData()
 
 void SouthPlugin::registerIngest(INGEST_CB cb, void *data)
 {
-	lock_guard<mutex> guard(mtx2);
+	unique_lock<mutex> guard(mtx2);
+	waitForPolls(guard);
 	try {
 		return this->pluginRegisterPtr(instance, cb, data);
 	} catch (exception& e) {
@@ -282,7 +377,8 @@ void SouthPlugin::registerIngest(INGEST_CB cb, void *data)
 
 void SouthPlugin::registerIngestV2(INGEST_CB2 cb, void *data)
 {
-	lock_guard<mutex> guard(mtx2);
+	unique_lock<mutex> guard(mtx2);
+	waitForPolls(guard);
 	try {
 		return this->pluginRegisterPtrV2(instance, cb, data);
 	} catch (exception& e) {
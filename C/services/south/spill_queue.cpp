@@ -0,0 +1,652 @@
+/*
+ * Fledge south service spill queue.
+ *
+ * Copyright (c) 2026 Dianomic Systems
+ *
+ * Released under the Apache 2.0 Licence
+ *
+ * Author: agent
+ */
+#include <spill_queue.h>
+#include <reading_stream_payload.h>
+#include <algorithm>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include <dirent.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <string.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <errno.h>
+
+using namespace std;
+
+/**
+ * Append a fixed size value to a block
+ */
+template<typename T> static inline void put(string& block, T value)
+{
+	block.append((const char *)&value, sizeof(T));
+}
+
+/**
+ * Extract a fixed size value from a block, advancing the pointer
+ *
+ * @return bool	False if the value would overrun the block
+ */
+template<typename T> static inline bool get(const char *& ptr, const char *end, T& value)
+{
+	if (ptr + sizeof(T) > end)
+		return false;
+	memcpy(&value, ptr, sizeof(T));
+	ptr += sizeof(T);
+	return true;
+}
+
+/**
+ * Create a directory and any missing parent directories
+ *
+ * @param path	The directory to create
+ * @return bool	True if the directory exists
+ */
+static bool makeDirectory(const string& path)
+{
+	for (size_t pos = path.find('/', 1); ; pos = path.find('/', pos + 1))
+	{
+		string dir = path.substr(0, pos);
+		if (mkdir(dir.c_str(), 0750) == -1 && errno != EEXIST)
+		{
+			return false;
+		}
+		if (pos == string::npos)
+		{
+			return true;
+		}
+	}
+}
+
+/**
+ * Construct a spill queue. Any segments left in the spill directory
+ * by a previous run of the service are queued for replay.
+ *
+ * @param directory	The directory for the segment files
+ * @param memoryBlocks	The number of blocks held in memory
+ * @param maxDisk	The maximum bytes of readings held on disk
+ */
+SpillQueue::SpillQueue(const string& directory, size_t memoryBlocks, uint64_t maxDisk) :
+	m_directory(directory), m_memoryBlocks(memoryBlocks), m_maxMemory(0),
+	m_memoryBytes(0), m_maxDisk(maxDisk),
+	m_frontOnDisk(false), m_frontLength(0), m_nextSequence(0),
+	m_diskBlocks(0), m_diskBytes(0)
+{
+	m_logger = Logger::getLogger();
+	recover();
+}
+
+/**
+ * Destroy the spill queue. The readings held in memory are deleted,
+ * flush should be called first if they are to be kept. The segments
+ * are left on disk.
+ */
+SpillQueue::~SpillQueue()
+{
+	for (auto block : m_memory)
+	{
+		for (auto reading : *block)
+			delete reading;
+		delete block;
+	}
+	for (auto segment : m_segments)
+	{
+		if (segment->m_map)
+			munmap(segment->m_map, segment->m_mapped);
+		close(segment->m_fd);
+		delete segment;
+	}
+}
+
+/**
+ * Return the number of blocks in the queue
+ */
+size_t SpillQueue::size() const
+{
+	return m_memory.size() + m_diskBlocks - (m_frontOnDisk ? 1 : 0);
+}
+
+/**
+ * Add a block of readings to the back of the queue. The queue takes
+ * ownership of the block if it is queued.
+ *
+ * Once the memory blocks are exhausted they are spilled to disk along
+ * with the new block, after which all blocks are appended to disk until
+ * the disk has been replayed. This keeps the blocks in order.
+ *
+ * @param readings	The block of readings
+ * @return bool		False if the block could not be queued, it remains
+ *			the property of the caller
+ */
+bool SpillQueue::push(vector<Reading *> *readings)
+{
+	size_t bytes = Reading::getMemorySize(*readings);
+	if (m_segments.empty() && m_memory.size() < m_memoryBlocks
+			&& (m_maxMemory == 0 || m_memoryBytes + bytes <= m_maxMemory))
+	{
+		m_memory.push_back(readings);
+		m_memoryBytes += bytes;
+		return true;
+	}
+	bool spillMemory = m_segments.empty();
+	m_block.clear();
+	size_t blocks = 0;
+	if (spillMemory)
+	{
+		for (auto block : m_memory)
+		{
+			encode(block, m_block);
+			blocks++;
+		}
+	}
+	encode(readings, m_block);
+	blocks++;
+	if (!spill(blocks))
+	{
+		return false;
+	}
+	if (spillMemory)
+	{
+		m_logger->warn("Spilling readings to disk whilst the storage layer is unavailable");
+		for (auto block : m_memory)
+		{
+			for (auto reading : *block)
+				delete reading;
+			delete block;
+		}
+		m_memory.clear();
+		m_memoryBytes = 0;
+	}
+	for (auto reading : *readings)
+		delete reading;
+	delete readings;
+	return true;
+}
+
+/**
+ * Return the block at the front of the queue, loading it from disk if
+ * it is not in memory. The block remains owned by the queue until pop
+ * is called.
+ *
+ * @return vector<Reading *>*	The front block or NULL if the queue is empty
+ */
+vector<Reading *> *SpillQueue::front()
+{
+	if (m_memory.empty())
+	{
+		vector<Reading *> *block = load();
+		if (!block)
+		{
+			return NULL;
+		}
+		m_memory.push_back(block);
+		m_memoryBytes += Reading::getMemorySize(*block);
+		m_frontOnDisk = true;
+	}
+	return m_memory.front();
+}
+
+/**
+ * Remove the block at the front of the queue. The caller takes
+ * ownership of the block returned by front. A block loaded from disk
+ * is marked as consumed in its segment and the segment is removed
+ * once all of its blocks are consumed.
+ */
+void SpillQueue::pop()
+{
+	if (m_memory.empty())
+	{
+		return;
+	}
+	size_t bytes = Reading::getMemorySize(*m_memory.front());
+	m_memoryBytes = bytes < m_memoryBytes ? m_memoryBytes - bytes : 0;
+	m_memory.pop_front();
+	if (!m_frontOnDisk)
+	{
+		return;
+	}
+	m_frontOnDisk = false;
+	SpillSegment *segment = m_segments.front();
+	segment->m_consumed += m_frontLength;
+	((SpillSegmentHeader *)segment->m_map)->consumed = segment->m_consumed;
+	segment->m_blocks--;
+	m_diskBlocks--;
+	m_diskBytes -= m_frontLength;
+	if (segment->m_blocks == 0)
+	{
+		removeSegment();
+	}
+}
+
+/**
+ * Write the blocks held only in memory to disk so that they are
+ * replayed when the service restarts. Called when the service shuts
+ * down with readings that have not been written to storage.
+ */
+void SpillQueue::flush()
+{
+	if (!m_segments.empty() || m_memory.empty())
+	{
+		// Anything not in memory is already on disk
+		return;
+	}
+	m_block.clear();
+	size_t readings = 0;
+	for (auto block : m_memory)
+	{
+		encode(block, m_block);
+		readings += block->size();
+	}
+	if (spill(m_memory.size()))
+	{
+		m_logger->info("%lu readings not written to storage have been saved for the next start",
+				(unsigned long)readings);
+		for (auto block : m_memory)
+		{
+			for (auto reading : *block)
+				delete reading;
+			delete block;
+		}
+		m_memory.clear();
+		m_memoryBytes = 0;
+	}
+}
+
+/**
+ * Find the segments left by a previous run of the service and queue
+ * the blocks they hold that were not replayed
+ */
+void SpillQueue::recover()
+{
+	if (!makeDirectory(m_directory))
+	{
+		m_logger->error("Unable to create spill directory %s: %s",
+				m_directory.c_str(), strerror(errno));
+		return;
+	}
+	DIR *dir = opendir(m_directory.c_str());
+	if (!dir)
+	{
+		return;
+	}
+	vector<uint64_t> sequences;
+	struct dirent *entry;
+	while ((entry = readdir(dir)) != NULL)
+	{
+		unsigned long long sequence;
+		char suffix[8];
+		if (sscanf(entry->d_name, "segment-%llu.%7s", &sequence, suffix) == 2
+				&& strcmp(suffix, "spill") == 0)
+		{
+			sequences.push_back(sequence);
+		}
+	}
+	closedir(dir);
+	sort(sequences.begin(), sequences.end());
+
+	for (auto sequence : sequences)
+	{
+		char name[64];
+		snprintf(name, sizeof(name), "/segment-%020llu.spill", (unsigned long long)sequence);
+		SpillSegment *segment = new SpillSegment(m_directory + name, sequence);
+		m_nextSequence = sequence + 1;
+		if (!scanSegment(segment))
+		{
+			if (segment->m_fd != -1)
+				close(segment->m_fd);
+			unlink(segment->m_path.c_str());
+			delete segment;
+			continue;
+		}
+		m_segments.push_back(segment);
+		m_diskBlocks += segment->m_blocks;
+		m_diskBytes += segment->m_size - segment->m_consumed;
+	}
+	if (m_diskBlocks)
+	{
+		m_logger->warn("%lu blocks of readings saved by a previous run will be written to storage",
+				(unsigned long)m_diskBlocks);
+	}
+}
+
+/**
+ * Count the blocks of a segment that have not been replayed. A block
+ * that was only partly written when the service stopped is truncated.
+ *
+ * @param segment	The segment
+ * @return bool		False if the segment holds no blocks to replay
+ */
+bool SpillQueue::scanSegment(SpillSegment *segment)
+{
+	segment->m_fd = open(segment->m_path.c_str(), O_RDWR | O_APPEND);
+	if (segment->m_fd == -1)
+	{
+		return false;
+	}
+	struct stat st;
+	SpillSegmentHeader header;
+	if (fstat(segment->m_fd, &st) == -1
+		|| pread(segment->m_fd, &header, sizeof(header), 0) != sizeof(header)
+		|| header.magic != SPILL_SEGMENT_MAGIC || header.version != SPILL_VERSION
+		|| header.consumed < sizeof(header))
+	{
+		return false;
+	}
+	uint64_t fileSize = (uint64_t)st.st_size;
+	uint64_t offset = header.consumed;
+	while (offset + sizeof(SpillBlockHeader) <= fileSize)
+	{
+		SpillBlockHeader block;
+		if (pread(segment->m_fd, &block, sizeof(block), (off_t)offset) != sizeof(block)
+			|| block.magic != SPILL_BLOCK_MAGIC
+			|| offset + sizeof(block) + block.length > fileSize)
+		{
+			break;
+		}
+		offset += sizeof(block) + block.length;
+		segment->m_blocks++;
+	}
+	if (offset < fileSize)
+	{
+		m_logger->warn("Truncating incomplete block of spilled readings in %s",
+				segment->m_path.c_str());
+		if (ftruncate(segment->m_fd, (off_t)offset) == -1)
+		{
+			return false;
+		}
+	}
+	segment->m_size = offset;
+	segment->m_consumed = header.consumed;
+	return segment->m_blocks > 0;
+}
+
+/**
+ * Append the encoded blocks to the current segment, starting a new
+ * segment when the current one is full. The write is undone if it
+ * fails part way through.
+ *
+ * @param blocks	The number of blocks in m_block
+ * @return bool		False if the blocks could not be written
+ */
+bool SpillQueue::spill(size_t blocks)
+{
+	if (m_diskBytes + m_block.length() > m_maxDisk)
+	{
+		m_logger->error("The spill limit of %lld bytes has been reached, readings will be discarded",
+				(long long)m_maxDisk);
+		return false;
+	}
+	if (m_segments.empty() || m_segments.back()->m_size >= SPILL_SEGMENT_SIZE)
+	{
+		if (!openSegment())
+		{
+			return false;
+		}
+	}
+	SpillSegment *segment = m_segments.back();
+	const char *ptr = m_block.data();
+	size_t remaining = m_block.length();
+	while (remaining > 0)
+	{
+		ssize_t n = write(segment->m_fd, ptr, remaining);
+		if (n == -1)
+		{
+			if (errno == EINTR)
+				continue;
+			m_logger->error("Unable to write readings to spill segment %s: %s",
+					segment->m_path.c_str(), strerror(errno));
+			if (ftruncate(segment->m_fd, (off_t)segment->m_size) == -1)
+			{
+				m_logger->error("Unable to truncate spill segment %s",
+						segment->m_path.c_str());
+			}
+			if (segment->m_blocks == 0)
+			{
+				// Do not leave an empty segment that later blocks would follow
+				m_segments.pop_back();
+				if (segment->m_map)
+					munmap(segment->m_map, segment->m_mapped);
+				close(segment->m_fd);
+				unlink(segment->m_path.c_str());
+				delete segment;
+			}
+			return false;
+		}
+		ptr += n;
+		remaining -= (size_t)n;
+	}
+	segment->m_size += m_block.length();
+	segment->m_blocks += blocks;
+	m_diskBlocks += blocks;
+	m_diskBytes += m_block.length();
+	return true;
+}
+
+/**
+ * Create a new segment file to append blocks to
+ *
+ * @return bool	False if the segment could not be created
+ */
+bool SpillQueue::openSegment()
+{
+	char name[64];
+	snprintf(name, sizeof(name), "/segment-%020llu.spill", (unsigned long long)m_nextSequence);
+	SpillSegment *segment = new SpillSegment(m_directory + name, m_nextSequence);
+	segment->m_fd = open(segment->m_path.c_str(), O_RDWR | O_CREAT | O_TRUNC | O_APPEND, 0640);
+	if (segment->m_fd == -1)
+	{
+		m_logger->error("Unable to create spill segment %s: %s",
+				segment->m_path.c_str(), strerror(errno));
+		delete segment;
+		return false;
+	}
+	SpillSegmentHeader header;
+	header.magic = SPILL_SEGMENT_MAGIC;
+	header.version = SPILL_VERSION;
+	header.consumed = sizeof(header);
+	if (write(segment->m_fd, &header, sizeof(header)) != sizeof(header))
+	{
+		m_logger->error("Unable to write spill segment %s: %s",
+				segment->m_path.c_str(), strerror(errno));
+		close(segment->m_fd);
+		unlink(segment->m_path.c_str());
+		delete segment;
+		return false;
+	}
+	segment->m_size = sizeof(header);
+	m_nextSequence++;
+	m_segments.push_back(segment);
+	return true;
+}
+
+/**
+ * Map a segment for reading
+ *
+ * @param segment	The segment
+ * @param length	The number of bytes to map
+ * @return bool		False if the segment could not be mapped
+ */
+bool SpillQueue::mapSegment(SpillSegment *segment, uint64_t length)
+{
+	if (segment->m_map)
+	{
+		munmap(segment->m_map, segment->m_mapped);
+		segment->m_map = NULL;
+		segment->m_mapped = 0;
+	}
+	void *map = mmap(NULL, length, PROT_READ | PROT_WRITE, MAP_SHARED, segment->m_fd, 0);
+	if (map == MAP_FAILED)
+	{
+		m_logger->error("Unable to map spill segment %s: %s",
+				segment->m_path.c_str(), strerror(errno));
+		return false;
+	}
+	segment->m_map = (char *)map;
+	segment->m_mapped = length;
+	return true;
+}
+
+/**
+ * Load the next block from the oldest segment. The segment is mapped,
+ * or remapped if it has grown since it was mapped. A segment that can
+ * not be read is discarded.
+ *
+ * @return vector<Reading *>*	The block or NULL if there are no blocks on disk
+ */
+vector<Reading *> *SpillQueue::load()
+{
+	while (!m_segments.empty())
+	{
+		SpillSegment *segment = m_segments.front();
+		if (segment->m_blocks == 0)
+		{
+			removeSegment();
+			continue;
+		}
+		SpillBlockHeader header;
+		const char *block = NULL;
+		if (segment->m_consumed + sizeof(header) <= segment->m_mapped
+				|| mapSegment(segment, segment->m_size))
+		{
+			memcpy(&header, segment->m_map + segment->m_consumed, sizeof(header));
+			if (header.magic == SPILL_BLOCK_MAGIC
+				&& (segment->m_consumed + sizeof(header) + header.length <= segment->m_mapped
+					|| mapSegment(segment, segment->m_size))
+				&& segment->m_consumed + sizeof(header) + header.length <= segment->m_mapped)
+			{
+				block = segment->m_map + segment->m_consumed + sizeof(header);
+			}
+		}
+		if (!block)
+		{
+			m_logger->error("Discarding %lu unreadable blocks of spilled readings in %s",
+					(unsigned long)segment->m_blocks, segment->m_path.c_str());
+			m_diskBlocks -= segment->m_blocks;
+			m_diskBytes -= segment->m_size - segment->m_consumed;
+			removeSegment();
+			continue;
+		}
+		m_frontLength = sizeof(header) + header.length;
+		return decode(block, header);
+	}
+	return NULL;
+}
+
+/**
+ * Remove the oldest segment from the queue and from disk
+ */
+void SpillQueue::removeSegment()
+{
+	SpillSegment *segment = m_segments.front();
+	m_segments.pop_front();
+	if (segment->m_map)
+		munmap(segment->m_map, segment->m_mapped);
+	close(segment->m_fd);
+	unlink(segment->m_path.c_str());
+	delete segment;
+	if (m_segments.empty())
+	{
+		m_logger->info("All spilled readings have been replayed");
+	}
+}
+
+/**
+ * Append the encoding of a block of readings to a buffer
+ *
+ * @param readings	The block of readings
+ * @param block		The buffer to append to
+ */
+void SpillQueue::encode(vector<Reading *> *readings, string& block)
+{
+	size_t start = block.length();
+	SpillBlockHeader header;
+	header.magic = SPILL_BLOCK_MAGIC;
+	header.count = (uint32_t)readings->size();
+	header.length = 0;
+	put(block, header);
+	string payload;
+	for (auto reading : *readings)
+	{
+		const string& asset = reading->getAssetName();
+		struct timeval userTs, ts;
+		reading->getUserTimestamp(&userTs);
+		reading->getTimestamp(&ts);
+		put(block, (uint32_t)asset.length());
+		block.append(asset);
+		put(block, (int64_t)userTs.tv_sec);
+		put(block, (int64_t)userTs.tv_usec);
+		put(block, (int64_t)ts.tv_sec);
+		put(block, (int64_t)ts.tv_usec);
+		ReadingStreamPayload::encode(*reading, payload);
+		put(block, (uint32_t)payload.length());
+		block.append(payload);
+	}
+	header.length = block.length() - start - sizeof(header);
+	memcpy(&block[start], &header, sizeof(header));
+}
+
+/**
+ * Recreate a block of readings from its encoding. A reading that can
+ * not be decoded is logged and dropped.
+ *
+ * @param data		The readings of the block
+ * @param header	The header of the block
+ * @return vector<Reading *>*	The block of readings
+ */
+vector<Reading *> *SpillQueue::decode(const char *data, const SpillBlockHeader& header)
+{
+	vector<Reading *> *readings = new vector<Reading *>;
+	readings->reserve(header.count);
+	const char *ptr = data;
+	const char *end = data + header.length;
+	for (uint32_t i = 0; i < header.count; i++)
+	{
+		uint32_t assetLength, payloadLength;
+		int64_t userSec, userUsec, tsSec, tsUsec;
+		if (!get(ptr, end, assetLength) || ptr + assetLength > end)
+		{
+			break;
+		}
+		string asset(ptr, assetLength);
+		ptr += assetLength;
+		if (!get(ptr, end, userSec) || !get(ptr, end, userUsec)
+				|| !get(ptr, end, tsSec) || !get(ptr, end, tsUsec)
+				|| !get(ptr, end, payloadLength) || ptr + payloadLength > end)
+		{
+			break;
+		}
+		vector<Datapoint *> datapoints;
+		bool decoded = ReadingStreamPayload::decode(ptr, payloadLength, datapoints);
+		ptr += payloadLength;
+		if (!decoded)
+		{
+			m_logger->error("Unable to decode a spilled reading of asset %s, it has been discarded",
+					asset.c_str());
+			continue;
+		}
+		Reading *reading = new Reading(asset, datapoints);
+		struct timeval userTs, ts;
+		userTs.tv_sec = (time_t)userSec;
+		userTs.tv_usec = (suseconds_t)userUsec;
+		ts.tv_sec = (time_t)tsSec;
+		ts.tv_usec = (suseconds_t)tsUsec;
+		reading->setUserTimestamp(userTs);
+		reading->setTimestamp(ts);
+		readings->push_back(reading);
+	}
+	if (readings->size() < header.count)
+	{
+		m_logger->error("%lu spilled readings could not be decoded",
+				(unsigned long)(header.count - readings->size()));
+	}
+	return readings;
+}
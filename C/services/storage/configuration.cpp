@@ -75,6 +75,100 @@ static const char *defaultConfiguration = QUOTE({
 		"displayName" : "Log Level",
 		"options" : [ "error", "warning", "info", "debug" ],
 		"order" : "7"
+	},
+	"workerThreads" : {
+		"value" : "5",
+		"default" : "5",
+		"description" : "The number of threads used to process readings append and fetch requests",
+		"type" : "integer",
+		"displayName" : "Reading Worker Threads",
+		"minimum" : "1",
+		"order" : "8"
+	},
+	"workerQueue" : {
+		"value" : "100",
+		"default" : "100",
+		"description" : "The maximum number of readings requests that may wait for a worker thread before requests are refused",
+		"type" : "integer",
+		"displayName" : "Reading Request Queue",
+		"minimum" : "1",
+		"order" : "9"
+	},
+	"readingCache" : {
+		"value" : "10000",
+		"default" : "10000",
+		"description" : "The number of the most recently fetched readings held in memory and shared by the readings fetch requests, 0 disables the cache",
+		"type" : "integer",
+		"displayName" : "Reading Cache Size",
+		"minimum" : "0",
+		"order" : "10"
+	},
+	"threadConfig" : {
+		"value" : "{}",
+		"default" : "{}",
+		"description" : "The CPU affinity and scheduling policy of the threads of the service, by thread role",
+		"type" : "JSON",
+		"displayName" : "Thread Configuration",
+		"order" : "11"
+	},
+	"asyncLogging" : {
+		"value" : "false",
+		"default" : "false",
+		"description" : "Write log messages from a separate thread so that logging does not delay the service",
+		"type" : "boolean",
+		"displayName" : "Asynchronous Logging",
+		"order" : "12"
+	},
+	"serverThreads" : {
+		"value" : "0",
+		"default" : "0",
+		"description" : "The number of threads that handle requests to the REST API of the service, 0 uses the number of database threads",
+		"type" : "integer",
+		"displayName" : "API Server Threads",
+		"minimum" : "0",
+		"order" : "13"
+	},
+	"requestTimeout" : {
+		"value" : "5",
+		"default" : "5",
+		"description" : "The number of seconds allowed to receive a request, this also limits how long an idle keep-alive connection is held open",
+		"type" : "integer",
+		"displayName" : "Request Timeout",
+		"minimum" : "1",
+		"order" : "14"
+	},
+	"contentTimeout" : {
+		"value" : "300",
+		"default" : "300",
+		"description" : "The number of seconds allowed to receive the content of a request or send a response",
+		"type" : "integer",
+		"displayName" : "Content Timeout",
+		"minimum" : "1",
+		"order" : "15"
+	},
+	"endpointLimits" : {
+		"value" : "{}",
+		"default" : "{}",
+		"description" : "The maximum number of requests of each API entry point that may be processed at once, requests beyond the limit are refused",
+		"type" : "JSON",
+		"displayName" : "Entry Point Limits",
+		"order" : "16"
+	},
+	"replicationSource" : {
+		"value" : "",
+		"default" : "",
+		"description" : "The address and port, host:port, of the storage service of a primary node whose readings are replicated to this node, empty if this node is not a standby. Requires a restart of the storage service.",
+		"type" : "string",
+		"displayName" : "Replication Source",
+		"order" : "17"
+	},
+	"allocatorConfig" : {
+		"value" : "{}",
+		"default" : "{}",
+		"description" : "The tuning options of the memory allocator of the service",
+		"type" : "JSON",
+		"displayName" : "Allocator Configuration",
+		"order" : "18"
 	}
 });
 
@@ -0,0 +1,457 @@
+/*
+ * Fledge storage service.
+ *
+ * Copyright (c) 2026 Dianomic Systems
+ *
+ * Released under the Apache 2.0 Licence
+ *
+ * Author: agent
+ */
+#include <fetch_stream.h>
+#include <storage_plugin.h>
+#include <logger.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <sys/eventfd.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <poll.h>
+#include <unistd.h>
+#include <string.h>
+#include <stdlib.h>
+#include <errno.h>
+#include <thread_config.h>
+
+using namespace std;
+
+/**
+ * Create the handler for the fetch streams
+ *
+ * @param plugin	The storage plugin that holds the readings
+ */
+FetchStreamHandler::FetchStreamHandler(StoragePlugin *plugin) : m_plugin(plugin)
+{
+}
+
+/**
+ * Destroy the handler, stopping any streams that are still running
+ */
+FetchStreamHandler::~FetchStreamHandler()
+{
+	lock_guard<mutex> guard(m_streamsMutex);
+	for (auto& stream : m_streams)
+	{
+		stream->stop();
+		delete stream;
+	}
+	m_streams.clear();
+}
+
+/**
+ * Create a new fetch stream and return the port on which the
+ * client should connect to it
+ *
+ * @param token		The single use connection token the client should send
+ * @param address	The address to listen on, in network byte order
+ * @return uint32_t	The port of the stream or 0 if the stream could not be created
+ */
+uint32_t FetchStreamHandler::createStream(uint32_t *token, uint32_t address)
+{
+	reap();
+	FetchStream *stream = new FetchStream(m_plugin);
+	uint32_t port = stream->create(token, address);
+	if (port == 0)
+	{
+		delete stream;
+		return 0;
+	}
+	lock_guard<mutex> guard(m_streamsMutex);
+	m_streams.push_back(stream);
+	return port;
+}
+
+/**
+ * Notify the streams that new readings have been appended
+ */
+void FetchStreamHandler::notify()
+{
+	lock_guard<mutex> guard(m_streamsMutex);
+	for (auto& stream : m_streams)
+	{
+		stream->notify();
+	}
+}
+
+/**
+ * Remove the streams whose clients have disconnected
+ */
+void FetchStreamHandler::reap()
+{
+	lock_guard<mutex> guard(m_streamsMutex);
+	for (auto it = m_streams.begin(); it != m_streams.end(); )
+	{
+		if ((*it)->finished())
+		{
+			delete *it;
+			it = m_streams.erase(it);
+		}
+		else
+		{
+			++it;
+		}
+	}
+}
+
+/**
+ * Construct a fetch stream
+ *
+ * @param plugin	The storage plugin that holds the readings
+ */
+FetchStreamHandler::FetchStream::FetchStream(StoragePlugin *plugin) : m_plugin(plugin),
+	m_listen(-1), m_socket(-1), m_event(-1), m_port(0), m_token(0),
+	m_subscribed(false), m_moreData(false), m_nextId(0), m_blockSize(0),
+	m_blockNo(0), m_acknowledged(0), m_requestLength(0),
+	m_running(false), m_finished(false), m_thread(NULL)
+{
+}
+
+/**
+ * Destroy the fetch stream, the thread is stopped if still running
+ */
+FetchStreamHandler::FetchStream::~FetchStream()
+{
+	stop();
+	if (m_listen != -1)
+		close(m_listen);
+	if (m_socket != -1)
+		close(m_socket);
+	if (m_event != -1)
+		close(m_event);
+}
+
+/**
+ * Create the listening socket for the stream and start the thread
+ * that will serve it
+ *
+ * @param token		The single use token the client will send in the connect request
+ * @param address	The address to listen on, in network byte order
+ * @return uint32_t	The port of the stream or 0 on failure
+ */
+uint32_t FetchStreamHandler::FetchStream::create(uint32_t *token, uint32_t address)
+{
+	struct sockaddr_in sockAddress;
+
+	if ((m_listen = socket(AF_INET, SOCK_STREAM, 0)) < 0)
+	{
+		Logger::getLogger()->error("Failed to create fetch stream socket: %s", strerror(errno));
+		return 0;
+	}
+	memset(&sockAddress, 0, sizeof(sockAddress));
+	sockAddress.sin_family = AF_INET;
+	sockAddress.sin_addr.s_addr = address;
+	sockAddress.sin_port = 0;
+	if (bind(m_listen, (struct sockaddr *)&sockAddress, sizeof(sockAddress)) < 0)
+	{
+		Logger::getLogger()->error("Failed to bind fetch stream socket: %s", strerror(errno));
+		return 0;
+	}
+	socklen_t len = sizeof(sockAddress);
+	if (getsockname(m_listen, (struct sockaddr *)&sockAddress, &len) == -1)
+	{
+		Logger::getLogger()->error("Failed to get fetch stream socket name, %s", strerror(errno));
+		return 0;
+	}
+	m_port = ntohs(sockAddress.sin_port);
+	if (listen(m_listen, 1) < 0)
+	{
+		Logger::getLogger()->error("Failed to listen on fetch stream: %s", strerror(errno));
+		return 0;
+	}
+	if ((m_event = eventfd(0, EFD_NONBLOCK)) < 0)
+	{
+		Logger::getLogger()->error("Failed to create fetch stream event: %s", strerror(errno));
+		return 0;
+	}
+
+	srand(m_port + (unsigned int)time(0));
+	m_token = (uint32_t)random() & 0xffffffff;
+	*token = m_token;
+
+	m_running = true;
+	m_thread = new thread(&FetchStream::run, this);
+	ThreadConfig::getInstance()->apply(*m_thread, "fetch-stream");
+	Logger::getLogger()->info("Fetch stream listening on port %d", m_port);
+	return m_port;
+}
+
+/**
+ * Stop the thread of the stream and wait for it to exit
+ */
+void FetchStreamHandler::FetchStream::stop()
+{
+	m_running = false;
+	notify();
+	if (m_thread)
+	{
+		m_thread->join();
+		delete m_thread;
+		m_thread = NULL;
+	}
+}
+
+/**
+ * Signal the stream that new readings are available
+ */
+void FetchStreamHandler::FetchStream::notify()
+{
+	uint64_t one = 1;
+	if (m_event != -1 && write(m_event, &one, sizeof(one)) < 0)
+	{
+		// The counter is already signalled
+	}
+}
+
+/**
+ * Accept the connection from the client and verify the token it sends
+ *
+ * @return bool	True if the client has connected
+ */
+bool FetchStreamHandler::FetchStream::connect()
+{
+	struct pollfd fds;
+	fds.fd = m_listen;
+	fds.events = POLLIN;
+	if (poll(&fds, 1, FETCH_ACCEPT_TIMEOUT) <= 0)
+	{
+		Logger::getLogger()->warn("Fetch stream: client failed to connect to port %d", m_port);
+		return false;
+	}
+	m_socket = accept(m_listen, NULL, NULL);
+	close(m_listen);
+	m_listen = -1;
+	if (m_socket < 0)
+	{
+		Logger::getLogger()->warn("Accept failed for fetch stream: %s", strerror(errno));
+		return false;
+	}
+
+	RDSConnectHeader hdr;
+	fds.fd = m_socket;
+	if (poll(&fds, 1, FETCH_ACCEPT_TIMEOUT) <= 0
+			|| recv(m_socket, &hdr, sizeof(hdr), MSG_WAITALL) != (int)sizeof(hdr))
+	{
+		Logger::getLogger()->warn("Fetch stream: failed to read the connection token");
+		return false;
+	}
+	if (hdr.magic != RDS_CONNECTION_MAGIC || hdr.token != m_token)
+	{
+		Logger::getLogger()->error("Fetch stream: invalid connection token received");
+		return false;
+	}
+	return true;
+}
+
+/**
+ * The thread of the stream. Blocks of readings are sent whilst the
+ * client has a subscription, fewer than RDS_FETCH_WINDOW blocks are
+ * awaiting acknowledgement and the last fetch returned a full block.
+ * Otherwise the thread waits for a request from the client, for new
+ * readings to be appended or for the poll interval to expire.
+ */
+void FetchStreamHandler::FetchStream::run()
+{
+	if (!connect())
+	{
+		m_finished = true;
+		return;
+	}
+	Logger::getLogger()->info("Fetch stream on port %d connected", m_port);
+
+	while (m_running)
+	{
+		bool canSend = m_subscribed && m_blockNo - m_acknowledged < RDS_FETCH_WINDOW;
+		struct pollfd fds[2];
+		fds[0].fd = m_socket;
+		fds[0].events = POLLIN | POLLRDHUP;
+		fds[0].revents = 0;
+		fds[1].fd = m_event;
+		fds[1].events = POLLIN;
+		fds[1].revents = 0;
+		int rval = poll(fds, 2, canSend && m_moreData ? 0 : FETCH_POLL_INTERVAL);
+		if (rval < 0 && errno != EINTR)
+		{
+			Logger::getLogger()->error("Fetch stream poll failed: %s", strerror(errno));
+			break;
+		}
+		if (rval == 0)
+		{
+			// Readings may have been added by other means
+			m_moreData = true;
+		}
+		if (fds[0].revents & (POLLRDHUP | POLLHUP | POLLERR))
+		{
+			Logger::getLogger()->info("Fetch stream on port %d closed by the client", m_port);
+			break;
+		}
+		if ((fds[0].revents & POLLIN) && !readRequests())
+		{
+			break;
+		}
+		if (fds[1].revents & POLLIN)
+		{
+			uint64_t count;
+			if (read(m_event, &count, sizeof(count)) > 0)
+				m_moreData = true;
+		}
+		if (m_subscribed && m_moreData && m_blockNo - m_acknowledged < RDS_FETCH_WINDOW)
+		{
+			if (!sendBlock())
+			{
+				break;
+			}
+		}
+	}
+	close(m_socket);
+	m_socket = -1;
+	m_finished = true;
+}
+
+/**
+ * Read the subscription and acknowledgement requests sent by the client.
+ * Requests may arrive split across reads, a partial request is retained
+ * until the remainder arrives.
+ *
+ * @return bool	False if the connection has failed
+ */
+bool FetchStreamHandler::FetchStream::readRequests()
+{
+	ssize_t n = recv(m_socket, m_request + m_requestLength,
+			sizeof(m_request) - m_requestLength, MSG_DONTWAIT);
+	if (n <= 0)
+	{
+		return n < 0 && (errno == EAGAIN || errno == EINTR);
+	}
+	m_requestLength += (size_t)n;
+	while (m_requestLength >= sizeof(uint32_t))
+	{
+		uint32_t magic;
+		memcpy(&magic, m_request, sizeof(magic));
+		size_t length;
+		if (magic == RDS_ACK_MAGIC)
+		{
+			length = sizeof(RDSAcknowledge);
+			if (m_requestLength < length)
+				break;
+			RDSAcknowledge ack;
+			memcpy(&ack, m_request, length);
+			if (ack.block + 1 > m_acknowledged && ack.block < m_blockNo)
+				m_acknowledged = ack.block + 1;
+		}
+		else if (magic == RDS_SUBSCRIBE_MAGIC)
+		{
+			length = sizeof(RDSSubscribe);
+			if (m_requestLength < length)
+				break;
+			RDSSubscribe sub;
+			memcpy(&sub, m_request, length);
+			m_nextId = sub.id;
+			m_blockSize = sub.blockSize ? sub.blockSize : 1;
+			m_subscribed = true;
+			m_moreData = true;
+			// Blocks in flight for a previous subscription are discarded
+			m_acknowledged = m_blockNo;
+		}
+		else
+		{
+			Logger::getLogger()->error("Fetch stream: invalid request 0x%x received", magic);
+			return false;
+		}
+		m_requestLength -= length;
+		memmove(m_request, m_request + length, m_requestLength);
+	}
+	return true;
+}
+
+/**
+ * Fetch the next block of readings from the plugin and send it to
+ * the client
+ *
+ * @return bool	False if the connection has failed
+ */
+bool FetchStreamHandler::FetchStream::sendBlock()
+{
+	char *buffer = NULL;
+	size_t length = 0;
+	int count = m_plugin->readingsFetchBinary(m_nextId, m_blockSize, &buffer, &length);
+	if (count <= 0)
+	{
+		if (count < 0)
+			Logger::getLogger()->error("Fetch stream: failed to fetch readings from %lu",
+					(unsigned long)m_nextId);
+		free(buffer);
+		m_moreData = false;
+		return true;
+	}
+
+	// Find the id of the last reading to move the stream on
+	size_t offset = 0;
+	RDSFetchReadingHeader hdr;
+	for (int i = 0; i < count && offset + sizeof(hdr) <= length; i++)
+	{
+		memcpy(&hdr, buffer + offset, sizeof(hdr));
+		offset += sizeof(hdr) + hdr.assetLength + hdr.payloadLength;
+	}
+	m_nextId = hdr.id + 1;
+	m_moreData = (uint32_t)count >= m_blockSize;
+
+	RDSBlockHeader block;
+	block.magic = RDS_BLOCK_MAGIC;
+	block.blockNumber = m_blockNo++;
+	block.count = (uint32_t)count;
+	bool rval = writeBlock(&block, buffer, length);
+	free(buffer);
+	return rval;
+}
+
+/**
+ * Write a block header and the readings of the block to the client
+ *
+ * @param hdr		The block header
+ * @param buffer	The readings of the block
+ * @param length	The length of the readings
+ * @return bool		False if the write failed
+ */
+bool FetchStreamHandler::FetchStream::writeBlock(RDSBlockHeader *hdr, const char *buffer, size_t length)
+{
+	struct iovec iov[2];
+	iov[0].iov_base = hdr;
+	iov[0].iov_len = sizeof(RDSBlockHeader);
+	iov[1].iov_base = (void *)buffer;
+	iov[1].iov_len = length;
+	int iovcnt = 2;
+	struct iovec *vp = iov;
+	while (iovcnt)
+	{
+		ssize_t n = writev(m_socket, vp, iovcnt);
+		if (n < 0)
+		{
+			if (errno == EINTR)
+				continue;
+			Logger::getLogger()->error("Fetch stream: write failed, %s", strerror(errno));
+			return false;
+		}
+		size_t written = (size_t)n;
+		while (iovcnt && written >= vp->iov_len)
+		{
+			written -= vp->iov_len;
+			vp++;
+			iovcnt--;
+		}
+		if (iovcnt)
+		{
+			vp->iov_base = (char *)vp->iov_base + written;
+			vp->iov_len -= written;
+		}
+	}
+	return true;
+}
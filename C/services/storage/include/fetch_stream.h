@@ -0,0 +1,79 @@
+#ifndef _FETCH_STREAM_H
+#define _FETCH_STREAM_H
+/*
+ * Fledge storage service.
+ *
+ * Copyright (c) 2026 Dianomic Systems
+ *
+ * Released under the Apache 2.0 Licence
+ *
+ * Author: agent
+ */
+#include <thread>
+#include <mutex>
+#include <atomic>
+#include <vector>
+#include <reading_stream.h>
+
+#define FETCH_ACCEPT_TIMEOUT	10000	// Milliseconds to wait for the client to connect
+#define FETCH_POLL_INTERVAL	500	// Milliseconds between checks for new readings
+
+class StoragePlugin;
+
+/**
+ * The handler for the fetch streams that push readings from the storage
+ * service to north services, see reading_stream.h for the protocol.
+ *
+ * Each stream is run by a thread of its own that fetches blocks of
+ * readings from the storage plugin in the binary format of the stream
+ * and writes them to the client. The thread waits for new readings to
+ * be appended once it has caught up with the readings buffer.
+ */
+class FetchStreamHandler {
+	public:
+		FetchStreamHandler(StoragePlugin *plugin);
+		~FetchStreamHandler();
+		uint32_t		createStream(uint32_t *token, uint32_t address);
+		void			notify();
+	private:
+		class FetchStream {
+			public:
+				FetchStream(StoragePlugin *plugin);
+				~FetchStream();
+				uint32_t	create(uint32_t *token, uint32_t address);
+				void		run();
+				void		notify();
+				void		stop();
+				bool		finished() { return m_finished; };
+			private:
+				bool		connect();
+				bool		readRequests();
+				bool		sendBlock();
+				bool		writeBlock(RDSBlockHeader *hdr, const char *buffer, size_t length);
+				StoragePlugin	*m_plugin;
+				int		m_listen;
+				int		m_socket;
+				int		m_event;
+				uint16_t	m_port;
+				uint32_t	m_token;
+				bool		m_subscribed;
+				bool		m_moreData;
+				uint64_t	m_nextId;
+				uint32_t	m_blockSize;
+				uint32_t	m_blockNo;
+				uint32_t	m_acknowledged;
+				char		m_request[sizeof(RDSSubscribe)];
+				size_t		m_requestLength;
+				std::atomic<bool>
+						m_running;
+				std::atomic<bool>
+						m_finished;
+				std::thread	*m_thread;
+		};
+		void			reap();
+		StoragePlugin		*m_plugin;
+		std::mutex		m_streamsMutex;
+		std::vector<FetchStream *>
+					m_streams;
+};
+#endif
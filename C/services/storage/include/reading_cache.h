@@ -0,0 +1,57 @@
+#ifndef _READING_CACHE_H
+#define _READING_CACHE_H
+/*
+ * Fledge storage service.
+ *
+ * Copyright (c) 2026 Dianomic Systems
+ *
+ * Released under the Apache 2.0 Licence
+ *
+ * Author: agent
+ */
+#include <string>
+#include <deque>
+#include <vector>
+#include <mutex>
+
+#define DEFAULT_READING_CACHE_ROWS	10000			// Default number of readings held in the cache
+#define READING_CACHE_MAX_SIZE		(32 * 1024 * 1024)	// Upper bound of the memory used by the cached readings
+
+/**
+ * A reading held in the cache, as the JSON row returned by the
+ * readings fetch of the storage plugin
+ */
+typedef struct {
+	unsigned long	id;
+	std::string	json;
+} ReadingCacheRow;
+
+/**
+ * A cache of the most recent readings fetched from the storage
+ * plugin, shared by all the clients of the storage service.
+ *
+ * The cache holds a window of reading ids, all the readings with
+ * ids within the window are in the cache. The window is extended
+ * as readings beyond it are fetched and the oldest readings are
+ * discarded once the cache is full, so that north services reading
+ * the same recent readings fetch them from the plugin only once.
+ */
+class ReadingCache {
+	public:
+		ReadingCache(unsigned long rows);
+		~ReadingCache();
+		unsigned long		fetch(unsigned long id, unsigned long count,
+						std::string& rows, unsigned long& next);
+		void			add(unsigned long id, std::vector<ReadingCacheRow>& rows);
+		void			clear();
+	private:
+		void			trim();
+		std::mutex		m_mutex;
+		std::deque<ReadingCacheRow>
+					m_rows;
+		unsigned long		m_maxRows;
+		size_t			m_size;
+		unsigned long		m_start;
+		unsigned long		m_end;
+};
+#endif
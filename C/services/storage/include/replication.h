@@ -0,0 +1,66 @@
+#ifndef _REPLICATION_H
+#define _REPLICATION_H
+/*
+ * Fledge storage service.
+ *
+ * Copyright (c) 2026 Dianomic Systems
+ *
+ * Released under the Apache 2.0 Licence
+ *
+ * Author: agent
+ */
+#include <thread>
+#include <atomic>
+#include <string>
+#include <vector>
+#include <reading_stream.h>
+
+#define REPLICATION_STATE_FILE	"/replication.json"
+#define REPLICATION_BLOCK_SIZE	1000	// Readings per block requested from the primary
+#define REPLICATION_RETRY	5	// Seconds between attempts to reach the primary
+#define REPLICATION_POLL	500	// Milliseconds between checks for a stop request
+
+class StorageApi;
+
+/**
+ * Replication of the readings of the storage service of a primary node
+ * to this storage service, the standby.
+ *
+ * The follower opens a fetch stream with the primary storage service,
+ * see reading_stream.h, subscribing from the global id of the first
+ * reading it has not yet stored. Each block received is passed as is
+ * to the readingStream entry point of the readings plugin, without
+ * creating reading objects, and acknowledged once it has been committed.
+ * The id of the next reading of the primary is kept in a file of the
+ * data directory so that a restarted follower carries on where it left
+ * off, a block committed just before a failure may be stored twice.
+ */
+class ReplicationFollower {
+	public:
+		ReplicationFollower(StorageApi *api, const std::string& source);
+		~ReplicationFollower();
+		bool			start();
+		void			stop();
+	private:
+		void			run();
+		bool			connect();
+		bool			follow();
+		bool			readStream(void *buffer, size_t length);
+		bool			applyBlock(const RDSBlockHeader& block);
+		void			loadPosition();
+		void			savePosition();
+		StorageApi		*m_api;
+		std::string		m_source;
+		std::string		m_host;
+		unsigned short		m_port;
+		std::string		m_stateFile;
+		int			m_socket;
+		uint64_t		m_nextId;
+		std::string		m_records;	// The ReadingStream records of a block
+		std::vector<size_t>	m_offsets;
+		std::vector<ReadingStream *>
+					m_readings;
+		std::atomic<bool>	m_running;
+		std::thread		*m_thread;
+};
+#endif
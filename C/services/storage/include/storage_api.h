@@ -15,6 +15,10 @@
 #include <storage_stats.h>
 #include <storage_registry.h>
 #include <stream_handler.h>
+#include <fetch_stream.h>
+#include <reading_cache.h>
+#include <storage_worker_pool.h>
+#include <functional>
 
 using namespace std;
 using HttpServer = SimpleWeb::Server<SimpleWeb::HTTP>;
@@ -27,16 +31,28 @@ using HttpServer = SimpleWeb::Server<SimpleWeb::HTTP>;
 #define READING_ACCESS  	"^/storage/reading$"
 #define READING_QUERY   	"^/storage/reading/query"
 #define READING_PURGE   	"^/storage/reading/purge"
+#define READING_LATEST		"^/storage/reading/latest$"
+#define READING_FETCH_FILTERED	"^/storage/reading/fetch$"
+#define READING_EXPORT		"^/storage/reading/export$"
 #define READING_INTEREST	"^/storage/reading/interest/([A-Za-z\\*][a-zA-Z0-9_%\\.\\-]*)$"
 #define GET_TABLE_SNAPSHOTS	"^/storage/table/([A-Za-z][a-zA-Z_0-9_]*)/snapshot$"
 #define CREATE_TABLE_SNAPSHOT	GET_TABLE_SNAPSHOTS
 #define LOAD_TABLE_SNAPSHOT	"^/storage/table/([A-Za-z][a-zA-Z_0-9_]*)/snapshot/([a-zA-Z_0-9_]*)$"
 #define DELETE_TABLE_SNAPSHOT	LOAD_TABLE_SNAPSHOT
 #define CREATE_STORAGE_STREAM	"^/storage/reading/stream$"
+#define CREATE_FETCH_STREAM	"^/storage/reading/fetch/stream$"
 #define STORAGE_SCHEMA		"^/storage/schema"
 #define STORAGE_TABLE_ACCESS    "^/storage/schema/([A-Za-z][a-zA-Z0-9_]*)/table/([A-Za-z][a-zA-Z0-9_]*)$"
+#define STORAGE_PROFILE		"^/storage/profile$"
+#define STORAGE_METRICS		"^/storage/metrics$"
 #define STORAGE_TABLE_QUERY	 "^/storage/schema/([A-Za-z][a-zA-Z0-9_]*)/table/([A-Za-z][a-zA-Z_0-9]*)/query$"           
 
+#define DEFAULT_REQUEST_TIMEOUT	5	// Seconds to receive a request, also the keep-alive idle limit
+#define DEFAULT_CONTENT_TIMEOUT	300	// Seconds to receive request content or send a response
+
+#define READING_FETCH_PAGE	1000	// Readings fetched from the plugin for each chunk of a fetch response
+#define READING_FETCH_INFLIGHT	2	// Chunks of a fetch response queued before waiting for the connection
+
 #define PURGE_FLAG_RETAIN      "retain"
 #define PURGE_FLAG_RETAIN_ANY  "retainany"
 #define PURGE_FLAG_RETAIN_ALL  "retainall"
@@ -57,11 +73,16 @@ using HttpServer = SimpleWeb::Server<SimpleWeb::HTTP>;
 class StorageApi {
 
 public:
-	StorageApi(const unsigned short port, const unsigned  int threads);
+	StorageApi(const unsigned short port, const unsigned  int threads,
+			const unsigned int workers = DEFAULT_WORKER_THREADS,
+			const unsigned int queueLength = DEFAULT_WORKER_QUEUE);
         static StorageApi *getInstance();
 	void	initResources();
 	void	setPlugin(StoragePlugin *);
 	void	setReadingPlugin(StoragePlugin *);
+	void	setReadingCache(unsigned long rows);
+	void	setTimeouts(long request, long content);
+	void	setEndpointLimits(const std::string& limits);
 	void	start();
 	void	startServer();
 	void	wait();
@@ -73,9 +94,21 @@ public:
 	void	commonUpdate(shared_ptr<HttpServer::Response> response, shared_ptr<HttpServer::Request> request);
 	void	commonDelete(shared_ptr<HttpServer::Response> response, shared_ptr<HttpServer::Request> request);
 	void	defaultResource(shared_ptr<HttpServer::Response> response, shared_ptr<HttpServer::Request> request);
+	void	queueReadingRequest(shared_ptr<HttpServer::Response> response, const std::function<void()>& work);
+	void	limitEndpoint(const char *endpoint, shared_ptr<HttpServer::Response> response,
+				shared_ptr<HttpServer::Request> request,
+				const std::function<void()>& work);
+	void	measureOperation(const char *operation, shared_ptr<HttpServer::Response> response,
+				shared_ptr<HttpServer::Request> request,
+				const std::function<void()>& work);
+	StorageStats&
+		getStats() { return stats; };
 	void	readingAppend(shared_ptr<HttpServer::Response> response, shared_ptr<HttpServer::Request> request);
 	void	readingFetch(shared_ptr<HttpServer::Response> response, shared_ptr<HttpServer::Request> request);
+	void	readingFetchFiltered(shared_ptr<HttpServer::Response> response, shared_ptr<HttpServer::Request> request);
 	void	readingQuery(shared_ptr<HttpServer::Response> response, shared_ptr<HttpServer::Request> request);
+	void	readingExport(shared_ptr<HttpServer::Response> response, shared_ptr<HttpServer::Request> request);
+	void	readingLatest(shared_ptr<HttpServer::Response> response, shared_ptr<HttpServer::Request> request);
 	void	readingPurge(shared_ptr<HttpServer::Response> response, shared_ptr<HttpServer::Request> request);
 	void	readingRegister(shared_ptr<HttpServer::Response> response, shared_ptr<HttpServer::Request> request);
 	void	readingUnregister(shared_ptr<HttpServer::Response> response, shared_ptr<HttpServer::Request> request);
@@ -85,12 +118,16 @@ public:
 	void	getTableSnapshots(shared_ptr<HttpServer::Response> response, shared_ptr<HttpServer::Request> request);
 	void	createStorageStream(shared_ptr<HttpServer::Response> response, shared_ptr<HttpServer::Request> request);
 	bool	readingStream(ReadingStream **readings, bool commit);
+	bool	readingStreamSupported() { return (readingPlugin ? readingPlugin : plugin)->hasStreamSupport(); };
+	void	createFetchStream(shared_ptr<HttpServer::Response> response, shared_ptr<HttpServer::Request> request);
 	void    createStorageSchema(shared_ptr<HttpServer::Response> response, shared_ptr<HttpServer::Request> request);
 	void 	storageTableInsert(shared_ptr<HttpServer::Response> response, shared_ptr<HttpServer::Request> request);
 	void    storageTableUpdate(shared_ptr<HttpServer::Response> response, shared_ptr<HttpServer::Request> request);
 	void    storageTableDelete(shared_ptr<HttpServer::Response> response, shared_ptr<HttpServer::Request> request);
 	void    storageTableSimpleQuery(shared_ptr<HttpServer::Response> response, shared_ptr<HttpServer::Request> request);
 	void    storageTableQuery(shared_ptr<HttpServer::Response> response, shared_ptr<HttpServer::Request> request);
+	void	storageProfile(shared_ptr<HttpServer::Response> response, shared_ptr<HttpServer::Request> request);
+	void	storageMetrics(shared_ptr<HttpServer::Response> response, shared_ptr<HttpServer::Request> request);
 
 
 	void	printList();
@@ -115,9 +152,16 @@ private:
 	StorageRegistry		registry;
 	void			respond(shared_ptr<HttpServer::Response>, const string&);
 	void			respond(shared_ptr<HttpServer::Response>, SimpleWeb::StatusCode, const string&);
+	void			respondBusy(shared_ptr<HttpServer::Response>);
+	void			readingFetchChunked(shared_ptr<HttpServer::Response>, unsigned long, unsigned long);
+	void			readingFetchCached(shared_ptr<HttpServer::Response>, unsigned long, unsigned long);
 	void			internalError(shared_ptr<HttpServer::Response>, const exception&);
 	void			mapError(string&, PLUGIN_ERROR *);
 	StreamHandler		*streamHandler;
+	FetchStreamHandler	*fetchHandler;
+	std::mutex		m_fetchHandlerMutex;
+	ReadingCache		*m_readingCache;
+	StorageWorkerPool	*m_workers;
 };
 
 #endif
@@ -43,6 +43,8 @@ public:
 	int		commonDelete(const std::string& table, const std::string& payload, char *schema = nullptr);
 	int		readingsAppend(const std::string& payload);
 	char		*readingsFetch(unsigned long id, unsigned int blksize);
+	bool		hasFetchFilteredSupport() { return readingsFetchFilteredPtr != NULL; };
+	char		*readingsFetchFiltered(const std::string& payload);
 	char		*readingsRetrieve(const std::string& payload);
 	char		*readingsPurge(unsigned long age, unsigned int flags, unsigned long sent);
 	long		*readingsPurge();
@@ -54,7 +56,13 @@ public:
 	PLUGIN_ERROR	*lastError();
 	bool		hasStreamSupport() { return readingStreamPtr != NULL; };
 	int		readingStream(ReadingStream **stream, bool commit);
+	bool		hasFetchBinarySupport() { return readingsFetchBinaryPtr != NULL; };
+	int		readingsFetchBinary(unsigned long id, unsigned int blksize,
+					char **buffer, size_t *length);
 	bool		pluginShutdown();
+	bool		statistics(std::string& json);
+	bool		profile(std::string& json, bool reset);
+	bool		readingsLatest(std::string& json, const char *asset);
 	int 		createSchema(const std::string& payload);
 	StoragePluginConfiguration
 			*getConfig() { return m_config; };
@@ -71,6 +79,7 @@ private:
         int             (*storageSchemaDeletePtr)(PLUGIN_HANDLE, const char *, const char *, const char*) = nullptr;
 	int		(*readingsAppendPtr)(PLUGIN_HANDLE, const char *);
 	char		*(*readingsFetchPtr)(PLUGIN_HANDLE, unsigned long id, unsigned int blksize);
+	char		*(*readingsFetchFilteredPtr)(PLUGIN_HANDLE, const char *payload);
 	char		*(*readingsRetrievePtr)(PLUGIN_HANDLE, const char *payload);
 	char		*(*readingsPurgePtr)(PLUGIN_HANDLE, unsigned long age, unsigned int flags, unsigned long sent);
 	void		(*releasePtr)(PLUGIN_HANDLE, const char *payload);
@@ -79,8 +88,13 @@ private:
 	int		(*deleteTableSnapshotPtr)(PLUGIN_HANDLE, const char *, const char *);
 	char		*(*getTableSnapshotsPtr)(PLUGIN_HANDLE, const char *);
 	int		(*readingStreamPtr)(PLUGIN_HANDLE, ReadingStream **, bool);
+	int		(*readingsFetchBinaryPtr)(PLUGIN_HANDLE, unsigned long id, unsigned int blksize,
+					char **buffer, size_t *length);
 	PLUGIN_ERROR	*(*lastErrorPtr)(PLUGIN_HANDLE);
 	bool		(*pluginShutdownPtr)(PLUGIN_HANDLE);
+	char		*(*statisticsPtr)(PLUGIN_HANDLE);
+	char		*(*profilePtr)(PLUGIN_HANDLE, bool);
+	char		*(*readingsLatestPtr)(PLUGIN_HANDLE, const char *);
         int 		(*createSchemaPtr)(PLUGIN_HANDLE, const char*);
 	std::string	m_name;
 	StoragePluginConfiguration
@@ -7,8 +7,19 @@
 #include <mutex>
 #include <condition_variable>
 #include <thread>
+#include <map>
+#include <unordered_map>
+#include <atomic>
+#include <client_http.hpp>
+#include <queue_metrics.h>
 
-typedef std::vector<std::pair<std::string *, std::string *> > REGISTRY;
+/**
+ * The registrations, indexed by the asset of interest. The URLs of
+ * the services that registered for all assets are held under "*".
+ */
+typedef std::unordered_multimap<std::string, std::string> REGISTRY;
+
+#define REGISTRY_MAX_BATCH	50	// Maximum number of queued payloads sent in one notification
 
 /**
  * StorageRegistry - a class that manages requests from other microservices
@@ -24,18 +35,23 @@ class StorageRegistry {
 		void		process(const std::string& payload);
 		void		run();
 	private:
-		void		processPayload(char *payload);
-		void		sendPayload(const std::string& url, char *payload);
-		void		filterPayload(const std::string& url, char *payload, const std::string& asset);
 		typedef 	std::pair<time_t, char *> Item;
+		void		processPayloads(const std::vector<Item>& batch);
+		void		sendPayload(const std::string& url, const std::string& readings);
+		SimpleWeb::Client<SimpleWeb::HTTP>
+				*getClient(const std::string& hostport);
 		REGISTRY			m_registrations;
+		std::mutex			m_registrationsMutex;
+		std::atomic<unsigned int>	m_registrationCount;
 		std::queue<StorageRegistry::Item>
 						m_queue;
 		std::mutex			m_qMutex;
 		std::thread			*m_thread;
 		std::condition_variable		m_cv;
-		std::mutex			m_cvMutex;
 		bool				m_running;
+		std::map<std::string, SimpleWeb::Client<SimpleWeb::HTTP> *>
+						m_clients;
+		QueueMetrics			m_queueMetrics;
 };
 
 #endif
@@ -19,6 +19,8 @@
 
 #define SERVICE_NAME  "Fledge Storage"
 
+class ReplicationFollower;
+
 /**
  * The StorageService class. This class is the core
  * of the service that offers access to the Fledge
@@ -46,6 +48,7 @@ class StorageService : public ServiceHandler {
 		Logger        		*logger;
 		StoragePlugin 		*storagePlugin;
 		StoragePlugin 		*readingPlugin;
+		ReplicationFollower	*m_replication;
 		bool			m_shutdown;
 };
 #endif
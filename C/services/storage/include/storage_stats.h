@@ -11,11 +11,88 @@
  */
 #include <json_provider.h>
 #include <string>
+#include <map>
+#include <mutex>
+#include <atomic>
+#include <sys/time.h>
+
+#define LATENCY_BUCKETS	17	// Buckets of the latency histograms, the last is unbounded
+
+class StoragePlugin;
+class StreamHandler;
+
+/**
+ * A histogram of the time taken by an operation, in buckets with fixed
+ * bounds from 100 microseconds to 10 seconds. Percentiles are estimated
+ * by interpolation within the bucket that contains them.
+ */
+class LatencyHistogram {
+	public:
+		LatencyHistogram();
+		void		record(unsigned long usec);
+		unsigned long	percentile(double p) const;
+		unsigned long	getCount() const { return m_count; };
+		unsigned long	getSum() const { return m_sum; };
+		unsigned long	getBucket(int bucket) const { return m_buckets[bucket]; };
+		static const unsigned long
+				bounds[LATENCY_BUCKETS - 1];	// Upper bound of each bucket in microseconds
+	private:
+		std::atomic<unsigned long>	m_buckets[LATENCY_BUCKETS];
+		std::atomic<unsigned long>	m_count;
+		std::atomic<unsigned long>	m_sum;		// Microseconds
+};
+
+/**
+ * The latency and the bytes received and sent of the requests of an
+ * entry point of the storage API
+ */
+class OperationStats {
+	public:
+		OperationStats() : m_bytesIn(0), m_bytesOut(0) {};
+		void		record(unsigned long usec, size_t bytesIn, size_t bytesOut)
+				{
+					m_latency.record(usec);
+					m_bytesIn += bytesIn;
+					m_bytesOut += bytesOut;
+				};
+		const LatencyHistogram&
+				getLatency() const { return m_latency; };
+		unsigned long	getBytesIn() const { return m_bytesIn; };
+		unsigned long	getBytesOut() const { return m_bytesOut; };
+	private:
+		LatencyHistogram		m_latency;
+		std::atomic<unsigned long>	m_bytesIn;
+		std::atomic<unsigned long>	m_bytesOut;
+};
+
+/**
+ * The number of requests of an entry point of the storage API that are
+ * being processed, with an optional limit on that number
+ */
+class EndpointGauge {
+	public:
+		EndpointGauge() : m_limit(0), m_inFlight(0), m_maxInFlight(0), m_rejected(0) {};
+		bool		enter();
+		void		leave() { m_inFlight--; };
+		void		setLimit(unsigned int limit) { m_limit = limit; };
+		unsigned int	getLimit() const { return m_limit; };
+		unsigned int	getInFlight() const { return m_inFlight; };
+		unsigned int	getMaxInFlight() const { return m_maxInFlight; };
+		unsigned long	getRejected() const { return m_rejected; };
+	private:
+		std::atomic<unsigned int>	m_limit;	// 0 for no limit
+		std::atomic<unsigned int>	m_inFlight;
+		std::atomic<unsigned int>	m_maxInFlight;
+		std::atomic<unsigned long>	m_rejected;
+};
 
 class StorageStats : public JSONProvider {
 	public:
 		StorageStats();
 		void		asJSON(std::string &) const;
+		void		asPrometheus(std::string &) const;
+		void		setPlugin(StoragePlugin *plugin) { m_plugin = plugin; };
+		void		setStreamHandler(StreamHandler *handler) { m_streamHandler = handler; };
 		unsigned int commonInsert;
 		unsigned int commonSimpleQuery;
 		unsigned int commonQuery;
@@ -23,7 +100,34 @@ class StorageStats : public JSONProvider {
 		unsigned int commonDelete;
 		unsigned int readingAppend;
 		unsigned int readingFetch;
+		unsigned int readingCacheHit;	// Fetches served entirely by the reading cache
 		unsigned int readingQuery;
 		unsigned int readingPurge;
+		// Reading worker pool queue usage
+		unsigned int workerQueueDepth;
+		unsigned int workerMaxQueueDepth;
+		unsigned int workerRejected;
+		unsigned long workerDispatched;
+		unsigned long workerWaitTotal;	// Microseconds
+		unsigned long workerMaxWait;	// Microseconds
+		// Entry points that are counted and may be limited, the map is
+		// only populated by the constructor
+		std::map<std::string, EndpointGauge> endpoints;
+		// Entry points that are measured, only populated by the constructor
+		std::map<std::string, OperationStats> operations;
+		std::atomic<unsigned long> readingsAppended;	// By requests and streams
+		std::atomic<unsigned long> streamBlocks;
+		std::atomic<unsigned long> streamAcks;		// Shared memory stream blocks acknowledged
+		std::atomic<unsigned long> streamNacks;		// Shared memory stream blocks rejected
+	private:
+		unsigned int	activeStreams() const;
+		StoragePlugin	*m_plugin;	// The readings plugin, reports its own statistics
+		StreamHandler	*m_streamHandler;
+		mutable std::mutex
+				m_rateMutex;
+		mutable unsigned long
+				m_lastReadings;	// Readings appended at the previous report
+		mutable struct timeval
+				m_lastReport;
 };
 #endif
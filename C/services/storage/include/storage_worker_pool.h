@@ -0,0 +1,59 @@
+#ifndef _STORAGE_WORKER_POOL_H
+#define _STORAGE_WORKER_POOL_H
+/*
+ * Fledge storage service.
+ *
+ * Copyright (c) 2026 Dianomic Systems
+ *
+ * Released under the Apache 2.0 Licence
+ *
+ * Author: agent
+ */
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <vector>
+#include <queue>
+#include <chrono>
+#include <storage_stats.h>
+
+#define DEFAULT_WORKER_THREADS	5	// Default number of reading worker threads
+#define DEFAULT_WORKER_QUEUE	100	// Default number of requests that may be queued
+#define WORKER_RETRY_AFTER	1	// Seconds a client is asked to wait when the queue is full
+
+/**
+ * A fixed size pool of worker threads used to execute the readings
+ * append and fetch requests of the storage API. Requests are placed
+ * in a bounded queue; when the queue is full the request is rejected
+ * in order that the caller may apply backpressure to the client
+ * rather than creating an unbounded number of threads.
+ *
+ * The depth of the queue and the time requests wait in the queue are
+ * reported via the storage statistics.
+ */
+class StorageWorkerPool {
+	public:
+		StorageWorkerPool(StorageStats& stats, unsigned int threads, unsigned int queueLength);
+		~StorageWorkerPool();
+		bool		submit(const std::function<void()>& work);
+		void		stop();
+	private:
+		class WorkItem {
+			public:
+				WorkItem(const std::function<void()>& work) :
+					m_work(work), m_queued(std::chrono::steady_clock::now()) {};
+				std::function<void()>				m_work;
+				std::chrono::steady_clock::time_point		m_queued;
+		};
+		void		worker();
+	private:
+		StorageStats&			m_stats;
+		unsigned int			m_queueLength;
+		std::vector<std::thread>	m_threads;
+		std::queue<WorkItem>		m_queue;
+		std::mutex			m_mutex;
+		std::condition_variable		m_cv;
+		bool				m_shutdown;
+};
+#endif
@@ -14,57 +14,106 @@
 #include <condition_variable>
 #include <vector>
 #include <map>
+#include <string>
+#include <atomic>
 #include <sys/epoll.h>
 #include <reading_stream.h>
+#include <queue_metrics.h>
 
 #define MAX_EVENTS	  40	// Number of epoll events in one epoll_wait call
 #define RDS_BLOCK	 10000	// Number of readings to insert in each call to the storage plugin
-#define BLOCK_POOL_SIZES 512	// Increments of block sizes in a block pool
+#define BLOCK_POOL_SIZES 512	// Smallest block size in a block pool, sizes are powers of two
+#define BLOCK_POOL_RETAIN (16 * 1024 * 1024)	// Free bytes a stream block pool may keep
+#define BLOCK_POOL_PRESSURE (64 * 1024 * 1024)	// Free bytes all block pools may keep
+#define STREAM_EVENT_LOOPS 4	// Number of threads that handle the streams
 
 class StorageApi;
 
 class StreamHandler {
 	public:
-		StreamHandler(StorageApi *);
+		StreamHandler(StorageApi *, unsigned int loops = STREAM_EVENT_LOOPS);
 		~StreamHandler();
-		void			handler();
 		uint32_t		createStream(uint32_t *token);
+		std::string		createSharedStream(uint32_t *token);
+		unsigned int		activeStreams();
+		void			poolStatistics(size_t& held, size_t& retained,
+						unsigned long& released) const;
 	private:
+		/**
+		 * The memory usage of the block pools of all the streams
+		 */
+		class PoolStats {
+			public:
+				PoolStats() : m_held(0), m_retained(0), m_released(0) {};
+				std::atomic<size_t>		m_held;		// Bytes allocated by the pools
+				std::atomic<size_t>		m_retained;	// Bytes free in the pools
+				std::atomic<unsigned long>	m_released;	// Bytes returned to the system
+		};
 		class Stream {
 			public:
-				Stream();
+				Stream(QueueMetrics *readingMetrics, QueueMetrics *ringMetrics,
+						PoolStats *poolStats);
 				~Stream();
 				uint32_t	create(int epollfd, uint32_t *token);
+				bool		createShared(int epollfd, uint32_t *token, std::string& name);
 				void		handleEvent(int epollfd, StorageApi *api, uint32_t events);
+				bool		isConnected() const { return m_status == Connected; };
 			private:
 				/**
 				 * A simple memory pool we use to store the messages we receive.
 				 * We use this rather than malloc because it let's us avoid the overhead of
 				 * the more complex heap mamagement and also because it means we avoid
 				 * taking out a process wide mutex.
+				 *
+				 * Blocks are pooled in power of two size classes. The free blocks
+				 * a pool keeps are capped, as are the free blocks of all the pools
+				 * together, so that a burst of large readings does not leave the
+				 * memory held by the storage service.
 				 */
 				class MemoryPool {
 						public:
-							MemoryPool(size_t blkIncr) : m_blkIncr(blkIncr) {};
+							MemoryPool(size_t blkIncr, size_t retain, PoolStats *stats) :
+								m_blkIncr(blkIncr), m_retain(retain),
+								m_retained(0), m_stats(stats) {};
 							~MemoryPool();
 							void		*allocate(size_t size);
 							void		release(void *handle);
+							void		trim();
+							bool		underPressure() const
+									{
+										return m_stats->m_retained > BLOCK_POOL_PRESSURE;
+									};
 						private:
 							size_t		rndSize(size_t size)
-									{ 
-										return m_blkIncr * ((size + m_blkIncr - 1)
-											       	/ m_blkIncr);
+									{
+										size_t rnd = m_blkIncr;
+										while (rnd < size)
+											rnd <<= 1;
+										return rnd;
 									};
-							void		createPool(size_t size);
 							void		growPool(std::vector<void *>*, size_t);
+							void		freeBlock(void *memory, size_t size);
 							size_t		m_blkIncr;
+							size_t		m_retain;
+							size_t		m_retained;	// Bytes free in this pool
+							PoolStats	*m_stats;
 							std::map<size_t, std::vector<void *>* >
 									m_pool;
 					};
 					void		setNonBlocking(int fd);
 					unsigned int	available(int fd);
-					void		queueInsert(StorageApi *api, unsigned int nReadings, bool commit);
+					size_t		streamAvailable();
+					ssize_t		streamRead(void *buffer, size_t length);
+					bool		readFrame();
+					bool		inflateBlock();
+					bool		queueInsert(StorageApi *api, unsigned int nReadings, bool commit);
+					void		acknowledge(uint32_t block, bool stored);
 					void		dump(int n);
+					void		handleSharedEvent(int epollfd, StorageApi *api, uint32_t events);
+					bool		sendDescriptors();
+					void		consumeShared(StorageApi *api);
+					void		acknowledgeShared(StorageApi *api, uint32_t block, bool stored);
+					void		closeShared(int epollfd);
 					enum { Closed, Listen, AwaitingToken, Connected }
 				       			m_status;
 					int		m_socket;
@@ -83,14 +132,61 @@ class StreamHandler {
 					MemoryPool	*m_blockPool;
 					std::string	m_lastAsset;
 					bool		m_sameAsset;
+					bool		m_shared;	// Shared memory transport
+					int		m_shmFd;
+					int		m_doorbell;	// Rung by the client as blocks are added
+					int		m_ackFd;	// Rung as blocks are consumed
+					RDSShmHeader	*m_shm;
+					char		*m_ring;
+					QueueMetrics	*m_readingMetrics;
+					QueueMetrics	*m_ringMetrics;
+					PoolStats	*m_poolStats;
+					uint32_t	m_buffered;	// Readings read but not yet inserted
+					uint64_t	m_ringHead;	// Bytes of the ring counted as added
+					uint64_t	m_ringTail;	// Bytes of the ring counted as consumed
+					struct epoll_event
+							m_doorbellEvent;
+					bool		m_acknowledge;	// The client is sent acknowledgements
+					uint32_t	m_ackBlock;	// Block number sent by the client
+					bool		m_blockFailed;	// An insert of the block failed, for a shared
+									// memory stream no more blocks are consumed
+					bool		m_compressed;	// The client sends compressed blocks
+					RDSCompressedHeader
+							m_frameHdr;	// Header of the compressed frame being read
+					size_t		m_frameHdrBytes;
+					std::string	m_frame;	// Compressed frame being read
+					size_t		m_frameBytes;
+					std::string	m_dictionary;	// Preset dictionary sent by the client
+					std::string	m_plain;	// Inflated block being parsed
+					size_t		m_plainOffset;
 		};
+		/**
+		 * An event loop thread with its own epoll descriptor and the
+		 * streams assigned to it. The readings of a stream are
+		 * inserted by the thread of its event loop, so a slow insert
+		 * only holds up the streams of that loop.
+		 */
+		class EventLoop {
+			public:
+				int			m_pollfd;
+				std::thread		m_thread;
+				std::condition_variable	m_streamsCV;
+				std::mutex		m_streamsMutex;
+				std::vector<Stream *>	m_streams;
+		};
+		void			handler(EventLoop *loop);
+		static void		threadWrapper(StreamHandler *handler, EventLoop *loop);
+		EventLoop		*nextLoop();
+
 		StorageApi		*m_api;
-		std::thread		m_handlerThread;
 		int			m_tokens;
-		std::condition_variable	m_streamsCV;
-		std::mutex		m_streamsMutex;
-		std::vector<Stream *>	m_streams;
-		bool			m_running;
-		int			m_pollfd;
+		std::vector<EventLoop *>
+					m_loops;
+		std::atomic<unsigned int>
+					m_nextLoop;	// Round robin assignment of streams to loops
+		volatile bool		m_running;
+		QueueMetrics		m_readingMetrics;	// Readings buffered by the socket streams
+		QueueMetrics		m_ringMetrics;		// Bytes waiting in the shared memory rings
+		PoolStats		m_poolStats;
 };
 #endif
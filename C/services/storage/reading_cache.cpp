@@ -0,0 +1,141 @@
+/*
+ * Fledge storage service.
+ *
+ * Copyright (c) 2026 Dianomic Systems
+ *
+ * Released under the Apache 2.0 Licence
+ *
+ * Author: agent
+ */
+#include <reading_cache.h>
+#include <algorithm>
+
+using namespace std;
+
+/**
+ * Construct the reading cache
+ *
+ * @param rows	The maximum number of readings to hold
+ */
+ReadingCache::ReadingCache(unsigned long rows) : m_maxRows(rows), m_size(0),
+	m_start(0), m_end(0)
+{
+}
+
+/**
+ * Destroy the reading cache
+ */
+ReadingCache::~ReadingCache()
+{
+}
+
+/**
+ * Fetch readings from the cache. The readings are returned as the
+ * comma separated JSON rows of a readings fetch. Fewer than count
+ * readings are returned if the end of the window is reached, the
+ * remaining readings should then be fetched from the id returned
+ * in next.
+ *
+ * @param id		The id of the first reading to fetch
+ * @param count		The maximum number of readings to fetch
+ * @param rows		The JSON rows of the readings are appended to this string
+ * @param next		The id from which to fetch any further readings
+ * @return unsigned long	The number of readings returned from the cache
+ */
+unsigned long ReadingCache::fetch(unsigned long id, unsigned long count,
+				string& rows, unsigned long& next)
+{
+	lock_guard<mutex> guard(m_mutex);
+	next = id;
+	if (m_rows.empty() || id < m_start || id > m_end)
+	{
+		return 0;
+	}
+	auto it = lower_bound(m_rows.begin(), m_rows.end(), id,
+			[](const ReadingCacheRow& row, unsigned long id) { return row.id < id; });
+	unsigned long n = 0;
+	for ( ; it != m_rows.end() && n < count; ++it, ++n)
+	{
+		if (n)
+			rows.append(",");
+		rows.append(it->json);
+		next = it->id + 1;
+	}
+	if (n < count)
+	{
+		next = m_end + 1;
+	}
+	return n;
+}
+
+/**
+ * Add the readings returned by a fetch from the storage plugin to
+ * the cache. The readings must be all of the readings from the id
+ * of the fetch to the id of the last reading, in the order of their
+ * ids. The window of the cache is extended if the readings follow
+ * on from it. Readings beyond the window replace the contents of the
+ * cache, whilst readings before it are not cached since the cache
+ * holds the most recent readings.
+ *
+ * @param id	The id from which the readings were fetched
+ * @param rows	The readings, these are moved into the cache
+ */
+void ReadingCache::add(unsigned long id, vector<ReadingCacheRow>& rows)
+{
+	if (rows.empty() || m_maxRows == 0)
+	{
+		return;
+	}
+	lock_guard<mutex> guard(m_mutex);
+	if (m_rows.empty() || id > m_end + 1)
+	{
+		m_rows.clear();
+		m_size = 0;
+		m_start = id;
+		m_end = id - 1;
+	}
+	else if (id < m_start || rows.back().id <= m_end)
+	{
+		return;
+	}
+	for (auto& row : rows)
+	{
+		if (row.id > m_end)
+		{
+			m_size += row.json.length();
+			m_end = row.id;
+			m_rows.push_back(move(row));
+		}
+	}
+	trim();
+}
+
+/**
+ * Discard the contents of the cache, used when readings are purged
+ */
+void ReadingCache::clear()
+{
+	lock_guard<mutex> guard(m_mutex);
+	m_rows.clear();
+	m_size = 0;
+	m_start = 0;
+	m_end = 0;
+}
+
+/**
+ * Discard the oldest readings whilst the cache is above its limits
+ */
+void ReadingCache::trim()
+{
+	while (!m_rows.empty() && (m_rows.size() > m_maxRows || m_size > READING_CACHE_MAX_SIZE))
+	{
+		m_size -= m_rows.front().json.length();
+		m_start = m_rows.front().id + 1;
+		m_rows.pop_front();
+	}
+	if (m_rows.empty())
+	{
+		m_start = 0;
+		m_end = 0;
+	}
+}
@@ -0,0 +1,400 @@
+/*
+ * Fledge storage service.
+ *
+ * Copyright (c) 2026 Dianomic Systems
+ *
+ * Released under the Apache 2.0 Licence
+ *
+ * Author: agent
+ */
+#include <replication.h>
+#include <storage_api.h>
+#include <logger.h>
+#include <utils.h>
+#include <thread_config.h>
+#include <client_http.hpp>
+#include <rapidjson/document.h>
+#include <fstream>
+#include <sstream>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netdb.h>
+#include <poll.h>
+#include <unistd.h>
+#include <string.h>
+#include <stddef.h>
+#include <errno.h>
+
+using namespace std;
+using namespace rapidjson;
+using HttpClient = SimpleWeb::Client<SimpleWeb::HTTP>;
+
+/**
+ * Construct the follower of a primary storage service
+ *
+ * @param api		The storage API of this service
+ * @param source	The address of the primary storage service, host:port
+ */
+ReplicationFollower::ReplicationFollower(StorageApi *api, const string& source) : m_api(api),
+	m_source(source), m_port(0), m_socket(-1), m_nextId(1), m_running(false), m_thread(NULL)
+{
+	m_stateFile = getDataDir() + REPLICATION_STATE_FILE;
+}
+
+/**
+ * Destroy the follower, stopping the replication if it is running
+ */
+ReplicationFollower::~ReplicationFollower()
+{
+	stop();
+}
+
+/**
+ * Start the thread that replicates the readings of the primary
+ *
+ * @return bool	False if the replication can not be started
+ */
+bool ReplicationFollower::start()
+{
+	size_t pos = m_source.rfind(':');
+	if (pos == string::npos || pos == 0)
+	{
+		Logger::getLogger()->error("The replication source '%s' should be host:port", m_source.c_str());
+		return false;
+	}
+	m_host = m_source.substr(0, pos);
+	m_port = (unsigned short)strtoul(m_source.substr(pos + 1).c_str(), NULL, 10);
+	if (m_port == 0)
+	{
+		Logger::getLogger()->error("The replication source '%s' has an invalid port", m_source.c_str());
+		return false;
+	}
+	if (!m_api->readingStreamSupported())
+	{
+		Logger::getLogger()->error("The readings plugin does not support the reading stream required for replication");
+		return false;
+	}
+	loadPosition();
+	m_running = true;
+	m_thread = new thread(&ReplicationFollower::run, this);
+	ThreadConfig::getInstance()->apply(*m_thread, "replication");
+	Logger::getLogger()->info("Replicating the readings of the storage service %s from id %lu",
+			m_source.c_str(), (unsigned long)m_nextId);
+	return true;
+}
+
+/**
+ * Stop the replication and wait for the thread to exit
+ */
+void ReplicationFollower::stop()
+{
+	m_running = false;
+	if (m_thread)
+	{
+		m_thread->join();
+		delete m_thread;
+		m_thread = NULL;
+	}
+	if (m_socket != -1)
+	{
+		close(m_socket);
+		m_socket = -1;
+	}
+}
+
+/**
+ * The replication thread, connects to the primary and follows it until
+ * the connection fails, then tries again every REPLICATION_RETRY seconds
+ */
+void ReplicationFollower::run()
+{
+	while (m_running)
+	{
+		if (connect())
+		{
+			Logger::getLogger()->info("Replication stream with %s connected", m_source.c_str());
+			follow();
+			close(m_socket);
+			m_socket = -1;
+		}
+		for (int i = 0; m_running && i < REPLICATION_RETRY * 1000 / REPLICATION_POLL; i++)
+		{
+			usleep(REPLICATION_POLL * 1000);
+		}
+	}
+}
+
+/**
+ * Create a fetch stream with the primary storage service and connect to it
+ *
+ * @return bool	True if the stream is connected
+ */
+bool ReplicationFollower::connect()
+{
+	int port;
+	uint32_t token;
+	try {
+		HttpClient client(m_source);
+		auto res = client.request("POST", "/storage/reading/fetch/stream");
+		ostringstream content;
+		content << res->content.rdbuf();
+		Document doc;
+		doc.Parse(content.str().c_str());
+		if (res->status_code.compare("200 OK") != 0 || doc.HasParseError()
+				|| !doc.HasMember("port") || !doc["port"].IsInt()
+				|| !doc.HasMember("token") || !doc["token"].IsUint())
+		{
+			Logger::getLogger()->warn("Unable to create the replication stream with %s: %s",
+					m_source.c_str(), content.str().c_str());
+			return false;
+		}
+		port = doc["port"].GetInt();
+		token = doc["token"].GetUint();
+	} catch (exception& ex) {
+		Logger::getLogger()->warn("Unable to reach the replication source %s: %s",
+				m_source.c_str(), ex.what());
+		return false;
+	}
+
+	struct addrinfo hints, *addrs;
+	memset(&hints, 0, sizeof(hints));
+	hints.ai_family = AF_INET;
+	hints.ai_socktype = SOCK_STREAM;
+	if (getaddrinfo(m_host.c_str(), to_string(port).c_str(), &hints, &addrs) != 0)
+	{
+		Logger::getLogger()->warn("Unable to resolve the replication source %s", m_host.c_str());
+		return false;
+	}
+	m_socket = socket(AF_INET, SOCK_STREAM, 0);
+	if (m_socket == -1 || ::connect(m_socket, addrs->ai_addr, addrs->ai_addrlen) < 0)
+	{
+		Logger::getLogger()->warn("Unable to connect to the replication stream %s:%d, %s",
+				m_host.c_str(), port, strerror(errno));
+		freeaddrinfo(addrs);
+		if (m_socket != -1)
+		{
+			close(m_socket);
+			m_socket = -1;
+		}
+		return false;
+	}
+	freeaddrinfo(addrs);
+
+	RDSConnectHeader conhdr;
+	conhdr.magic = RDS_CONNECTION_MAGIC;
+	conhdr.token = token;
+	RDSSubscribe sub;
+	sub.magic = RDS_SUBSCRIBE_MAGIC;
+	sub.blockSize = REPLICATION_BLOCK_SIZE;
+	sub.id = m_nextId;
+	if (write(m_socket, &conhdr, sizeof(conhdr)) != sizeof(conhdr)
+			|| write(m_socket, &sub, sizeof(sub)) != sizeof(sub))
+	{
+		Logger::getLogger()->warn("Failed to subscribe to the replication stream: %s", strerror(errno));
+		close(m_socket);
+		m_socket = -1;
+		return false;
+	}
+	return true;
+}
+
+/**
+ * Apply the blocks sent by the primary until the stream fails or
+ * the replication is stopped
+ *
+ * @return bool	False if the stream has failed
+ */
+bool ReplicationFollower::follow()
+{
+	while (m_running)
+	{
+		RDSBlockHeader block;
+		if (!readStream(&block, sizeof(block)))
+		{
+			return false;
+		}
+		if (block.magic != RDS_BLOCK_MAGIC)
+		{
+			Logger::getLogger()->error("Invalid block received on the replication stream");
+			return false;
+		}
+		if (!applyBlock(block))
+		{
+			return false;
+		}
+		RDSAcknowledge ack;
+		ack.magic = RDS_ACK_MAGIC;
+		ack.block = block.blockNumber;
+		if (write(m_socket, &ack, sizeof(ack)) != sizeof(ack))
+		{
+			Logger::getLogger()->warn("Failed to acknowledge a replication block: %s", strerror(errno));
+			return false;
+		}
+	}
+	return true;
+}
+
+/**
+ * Read the readings of a block and pass them to the readings plugin.
+ * The readings are built as ReadingStream records, the asset code and
+ * payload both null terminated, in a buffer reused for every block.
+ *
+ * @param block	The header of the block
+ * @return bool	False if the block could not be read or stored
+ */
+bool ReplicationFollower::applyBlock(const RDSBlockHeader& block)
+{
+	m_records.clear();
+	m_offsets.clear();
+	uint64_t lastId = 0;
+	for (uint32_t i = 0; i < block.count; i++)
+	{
+		RDSFetchReadingHeader hdr;
+		if (!readStream(&hdr, sizeof(hdr)))
+		{
+			return false;
+		}
+		if (hdr.magic != RDS_FETCH_READING_MAGIC)
+		{
+			Logger::getLogger()->error("Invalid reading received on the replication stream");
+			return false;
+		}
+		size_t offset = m_records.length();
+		size_t length = offsetof(ReadingStream, assetCode) + hdr.assetLength + hdr.payloadLength + 2;
+		length = (length + 7) & ~(size_t)7;	// Keep the records aligned
+		m_records.resize(offset + length);
+		ReadingStream *reading = (ReadingStream *)&m_records[offset];
+		reading->assetCodeLength = hdr.assetLength + 1;
+		reading->payloadLength = hdr.payloadLength + 1;
+		reading->payloadFormat = RDS_PAYLOAD_JSON;
+		reading->userTs = hdr.userTs;
+		char *asset = reading->assetCode;
+		char *payload = asset + hdr.assetLength + 1;
+		if (!readStream(asset, hdr.assetLength) || !readStream(payload, hdr.payloadLength))
+		{
+			return false;
+		}
+		asset[hdr.assetLength] = 0;
+		payload[hdr.payloadLength] = 0;
+		if (hdr.id < m_nextId)
+		{
+			// Left in flight by an earlier subscription
+			m_records.resize(offset);
+			continue;
+		}
+		m_offsets.push_back(offset);
+		lastId = hdr.id;
+	}
+	if (m_offsets.empty())
+	{
+		return true;
+	}
+
+	m_readings.clear();
+	for (auto offset : m_offsets)
+	{
+		m_readings.push_back((ReadingStream *)&m_records[offset]);
+	}
+	m_readings.push_back(NULL);
+	if (!m_api->readingStream(m_readings.data(), true))
+	{
+		Logger::getLogger()->error("Failed to store %d replicated readings", (int)m_offsets.size());
+		return false;
+	}
+	m_nextId = lastId + 1;
+	savePosition();
+	return true;
+}
+
+/**
+ * Read a number of bytes from the stream, giving up if the
+ * replication is stopped
+ *
+ * @param buffer	The buffer to read into
+ * @param length	The number of bytes to read
+ * @return bool		True if all the bytes were read
+ */
+bool ReplicationFollower::readStream(void *buffer, size_t length)
+{
+	char *p = (char *)buffer;
+	while (length)
+	{
+		struct pollfd fds;
+		fds.fd = m_socket;
+		fds.events = POLLIN;
+		int rval = poll(&fds, 1, REPLICATION_POLL);
+		if (!m_running)
+		{
+			return false;
+		}
+		if (rval == 0 || (rval < 0 && errno == EINTR))
+		{
+			continue;
+		}
+		ssize_t n = rval < 0 ? -1 : read(m_socket, p, length);
+		if (n < 0 && errno == EINTR)
+		{
+			continue;
+		}
+		if (n <= 0)
+		{
+			Logger::getLogger()->warn("Replication stream with %s lost", m_source.c_str());
+			return false;
+		}
+		p += n;
+		length -= (size_t)n;
+	}
+	return true;
+}
+
+/**
+ * Read the id of the next reading to replicate. The replication starts
+ * from the first reading of the primary if there is no position for
+ * the configured source.
+ */
+void ReplicationFollower::loadPosition()
+{
+	ifstream ifs(m_stateFile.c_str());
+	if (!ifs)
+	{
+		return;
+	}
+	stringstream content;
+	content << ifs.rdbuf();
+	Document doc;
+	doc.Parse(content.str().c_str());
+	if (doc.HasParseError() || !doc.IsObject()
+			|| !doc.HasMember("source") || !doc["source"].IsString()
+			|| !doc.HasMember("nextId") || !doc["nextId"].IsUint64())
+	{
+		Logger::getLogger()->warn("Ignoring the replication position %s as it is not valid", m_stateFile.c_str());
+		return;
+	}
+	if (m_source.compare(doc["source"].GetString()) != 0)
+	{
+		Logger::getLogger()->warn("The replication source has changed from %s, replicating from the first reading",
+				doc["source"].GetString());
+		return;
+	}
+	m_nextId = doc["nextId"].GetUint64();
+}
+
+/**
+ * Write the id of the next reading to replicate. The position is written
+ * to a temporary file that is renamed so that it is never left partial.
+ */
+void ReplicationFollower::savePosition()
+{
+	string tmp = m_stateFile + ".tmp";
+	ofstream ofs(tmp.c_str(), ios::out | ios::trunc);
+	if (ofs)
+	{
+		ofs << "{ \"source\" : \"" << m_source << "\", \"nextId\" : " << m_nextId << " }";
+		ofs.close();
+	}
+	if (!ofs || rename(tmp.c_str(), m_stateFile.c_str()) != 0)
+	{
+		Logger::getLogger()->warn("Unable to write the replication position %s", m_stateFile.c_str());
+		unlink(tmp.c_str());
+	}
+}
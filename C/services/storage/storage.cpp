@@ -25,6 +25,9 @@
 #include <syslog.h>
 #include <config_handler.h>
 #include <plugin_configuration.h>
+#include <thread_config.h>
+#include <service_allocator.h>
+#include <replication.h>
 
 #define NO_EXIT_STACKTRACE		0		// Set to 1 to make storage loop after stacktrace
 
@@ -183,7 +186,7 @@ pid_t pid;
  * Constructor for the storage service
  */
 StorageService::StorageService(const string& myName) : m_name(myName),
-						readingPlugin(NULL), m_shutdown(false)
+						readingPlugin(NULL), m_replication(NULL), m_shutdown(false)
 {
 unsigned short servicePort;
 
@@ -209,6 +212,25 @@ unsigned short servicePort;
 	{
 		threads = (unsigned int)atoi(config->getValue("threads"));
 	}
+	unsigned int serverThreads = 0;
+	if (config->hasValue("serverThreads"))
+	{
+		serverThreads = (unsigned int)atoi(config->getValue("serverThreads"));
+	}
+	if (serverThreads == 0)
+	{
+		serverThreads = threads;
+	}
+	unsigned int workers = DEFAULT_WORKER_THREADS;
+	if (config->hasValue("workerThreads"))
+	{
+		workers = (unsigned int)atoi(config->getValue("workerThreads"));
+	}
+	unsigned int queueLength = DEFAULT_WORKER_QUEUE;
+	if (config->hasValue("workerQueue"))
+	{
+		queueLength = (unsigned int)atoi(config->getValue("workerQueue"));
+	}
 	if (config->hasValue("logLevel"))
 	{
 		logger->setMinLevel(config->getValue("logLevel"));
@@ -217,9 +239,43 @@ unsigned short servicePort;
 	{
 		logger->setMinLevel("warning");
 	}
+	if (config->hasValue("threadConfig"))
+	{
+		ThreadConfig::getInstance()->configure(config->getValue("threadConfig"));
+	}
+	if (config->hasValue("allocatorConfig"))
+	{
+		ServiceAllocator::getInstance()->configure(config->getValue("allocatorConfig"));
+	}
+	if (config->hasValue("asyncLogging"))
+	{
+		const char *async = config->getValue("asyncLogging");
+		logger->setAsynchronous(async[0] == 't' || async[0] == 'T');
+	}
 
-
-	api = new StorageApi(servicePort, threads);
+	api = new StorageApi(servicePort, serverThreads, workers, queueLength);
+	long requestTimeout = DEFAULT_REQUEST_TIMEOUT;
+	if (config->hasValue("requestTimeout"))
+	{
+		requestTimeout = atol(config->getValue("requestTimeout"));
+	}
+	long contentTimeout = DEFAULT_CONTENT_TIMEOUT;
+	if (config->hasValue("contentTimeout"))
+	{
+		contentTimeout = atol(config->getValue("contentTimeout"));
+	}
+	api->setTimeouts(requestTimeout > 0 ? requestTimeout : DEFAULT_REQUEST_TIMEOUT,
+			contentTimeout > 0 ? contentTimeout : DEFAULT_CONTENT_TIMEOUT);
+	if (config->hasValue("endpointLimits"))
+	{
+		api->setEndpointLimits(config->getValue("endpointLimits"));
+	}
+	unsigned long cacheRows = DEFAULT_READING_CACHE_ROWS;
+	if (config->hasValue("readingCache"))
+	{
+		cacheRows = strtoul(config->getValue("readingCache"), NULL, 10);
+	}
+	api->setReadingCache(cacheRows);
 }
 
 /**
@@ -243,6 +299,16 @@ void StorageService::start(string& coreAddress, unsigned short corePort)
 	api->start();
 	management.registerService(this);
 
+	if (config->hasValue("replicationSource") && *config->getValue("replicationSource"))
+	{
+		m_replication = new ReplicationFollower(api, config->getValue("replicationSource"));
+		if (!m_replication->start())
+		{
+			delete m_replication;
+			m_replication = NULL;
+		}
+	}
+
 	management.start();
 
 	// Allow time for the listeners to start before we register
@@ -344,6 +410,12 @@ void StorageService::start(string& coreAddress, unsigned short corePort)
 		// Wait for all the API threads to complete
 		api->wait();
 
+		if (m_replication)
+		{
+			delete m_replication;
+			m_replication = NULL;
+		}
+
 		if (readingPlugin)
 			readingPlugin->pluginShutdown();
 		readingPlugin = NULL;
@@ -358,6 +430,8 @@ void StorageService::start(string& coreAddress, unsigned short corePort)
 	else
 	{
 		api->wait();
+		delete m_replication;
+		m_replication = NULL;
 	}
 	management.stop();
 	logger->info("Storage service shut down.");
@@ -472,6 +546,10 @@ void StorageService::configChange(const string& categoryName, const string& cate
 	if (!categoryName.compare(STORAGE_CATEGORY))
 	{
 		config->updateCategory(category);
+		if (config->hasValue("allocatorConfig"))
+		{
+			ServiceAllocator::getInstance()->configure(config->getValue("allocatorConfig"));
+		}
 		return;
 	}
 	if (!categoryName.compare(getPluginName()))
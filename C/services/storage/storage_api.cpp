@@ -13,21 +13,32 @@
 #include "storage_stats.h"
 #include "management_api.h"
 #include "logger.h"
+#include "tracer.h"
+#include "alloc_profiler.h"
 #include "plugin_exception.h"
+#include "timestamp_formatter.h"
 #include <rapidjson/document.h>
+#include <rapidjson/reader.h>
+#include <rapidjson/writer.h>
+#include <rapidjson/stringbuffer.h>
 #include <atomic>
+#include <condition_variable>
 
 // Added for the default_resource example
 #include <algorithm>
 #include <fstream>
 #include <vector>
+#include <set>
 #ifdef HAVE_OPENSSL
 #include "crypto.hpp"
 #endif
 
 #include <string_utils.h>
+#include <reading_stream_payload.h>
+#include <thread_config.h>
+#include <netinet/in.h>
 
-// Enable worker threads for readings append and fetch
+// Enable worker threads for readings purge
 #define WORKER_THREADS		1
 
 // Threshold for logging number of threads in use for some "readings" wrappers
@@ -59,7 +70,10 @@ using HttpClient = SimpleWeb::Client<SimpleWeb::HTTP>;
 void commonInsertWrapper(shared_ptr<HttpServer::Response> response, shared_ptr<HttpServer::Request> request)
 {
 	StorageApi *api = StorageApi::getInstance();
-	api->commonInsert(response, request);
+	api->limitEndpoint("commonInsert", response, request, [api, response, request]
+	{
+		api->commonInsert(response, request);
+	});
 }
 
 /**
@@ -68,7 +82,10 @@ void commonInsertWrapper(shared_ptr<HttpServer::Response> response, shared_ptr<H
 void commonUpdateWrapper(shared_ptr<HttpServer::Response> response, shared_ptr<HttpServer::Request> request)
 {
 	StorageApi *api = StorageApi::getInstance();
-	api->commonUpdate(response, request);
+	api->limitEndpoint("commonUpdate", response, request, [api, response, request]
+	{
+		api->commonUpdate(response, request);
+	});
 }
 
 /**
@@ -77,7 +94,10 @@ void commonUpdateWrapper(shared_ptr<HttpServer::Response> response, shared_ptr<H
 void commonDeleteWrapper(shared_ptr<HttpServer::Response> response, shared_ptr<HttpServer::Request> request)
 {
 	StorageApi *api = StorageApi::getInstance();
-	api->commonDelete(response, request);
+	api->limitEndpoint("commonDelete", response, request, [api, response, request]
+	{
+		api->commonDelete(response, request);
+	});
 }
 
 /**
@@ -86,7 +106,10 @@ void commonDeleteWrapper(shared_ptr<HttpServer::Response> response, shared_ptr<H
 void commonSimpleQueryWrapper(shared_ptr<HttpServer::Response> response, shared_ptr<HttpServer::Request> request)
 {
 	StorageApi *api = StorageApi::getInstance();
-	api->commonSimpleQuery(response, request);
+	api->limitEndpoint("commonSimpleQuery", response, request, [api, response, request]
+	{
+		api->commonSimpleQuery(response, request);
+	});
 }
 
 /**
@@ -95,7 +118,10 @@ void commonSimpleQueryWrapper(shared_ptr<HttpServer::Response> response, shared_
 void commonQueryWrapper(shared_ptr<HttpServer::Response> response, shared_ptr<HttpServer::Request> request)
 {
 	StorageApi *api = StorageApi::getInstance();
-	api->commonQuery(response, request);
+	api->limitEndpoint("commonQuery", response, request, [api, response, request]
+	{
+		api->commonQuery(response, request);
+	});
 }
 
 /**
@@ -121,34 +147,13 @@ void readingAppendWrapper(shared_ptr<HttpServer::Response> response,
 			  shared_ptr<HttpServer::Request> request)
 {
 	StorageApi *api = StorageApi::getInstance();
-#if WORKER_THREADS
-	std::atomic<int>* cnt = &(api->m_workers_count);
-	// Check rurrent number of workers and log if threshold value is hit
-	int tVal = std::atomic_load(cnt);
-	if (tVal >= MAX_WORKER_THREADS)
-	{
-		Logger::getLogger()->warn("Storage API: readingAppend() is being run by a new thread. "
-					  "Current worker threads count %d exceeds the warning limit of %d allowed threads hit.",
-					  tVal,
-					  MAX_WORKER_THREADS);
-	}
-
-	// Start a new thread
-	thread work_thread([api, cnt, response, request]
+	api->queueReadingRequest(response, [api, response, request]
 	{
-		// Increase count
-		std::atomic_fetch_add(cnt, 1);
-
-		api->readingAppend(response, request);
-
-		// Decrease counter 
-		std::atomic_fetch_sub(cnt, 1);
+		api->measureOperation("readingAppend", response, request, [api, response, request]
+		{
+			api->readingAppend(response, request);
+		});
 	});
-	// Detach the new thread
-	work_thread.detach();
-#else
-	api->readingAppend(response, request);
-#endif
 }
 
 /**
@@ -158,34 +163,45 @@ void readingFetchWrapper(shared_ptr<HttpServer::Response> response,
 			 shared_ptr<HttpServer::Request> request)
 {
 	StorageApi *api = StorageApi::getInstance();
-#if WORKER_THREADS
-	std::atomic<int>* cnt = &(api->m_workers_count);
-	// Check rurrent number of workers and log if threshold value is hit
-	int tVal = std::atomic_load(cnt);
-	if (tVal >= MAX_WORKER_THREADS)
+	api->queueReadingRequest(response, [api, response, request]
 	{
-		Logger::getLogger()->warn("Storage API: readingFetch() is being run by a new thread. "
-					  "Current worker threads count %d exceeds the warning limit of %d allowed threads hit.",
-					  tVal,
-					  MAX_WORKER_THREADS);
-	}
+		api->measureOperation("readingFetch", response, request, [api, response, request]
+		{
+			api->readingFetch(response, request);
+		});
+	});
+}
 
-	// Start a new thread
-	thread work_thread([api, cnt, response, request]
+/**
+ * Wrapper function for the filtered reading fetch API call.
+ */
+void readingFetchFilteredWrapper(shared_ptr<HttpServer::Response> response,
+			 shared_ptr<HttpServer::Request> request)
+{
+	StorageApi *api = StorageApi::getInstance();
+	api->queueReadingRequest(response, [api, response, request]
 	{
-		// Increase count
-		std::atomic_fetch_add(cnt, 1);
-
-		api->readingFetch(response, request);
+		api->measureOperation("readingFetch", response, request, [api, response, request]
+		{
+			api->readingFetchFiltered(response, request);
+		});
+	});
+}
 
-		// Decrease counter 
-		std::atomic_fetch_sub(cnt, 1);
+/**
+ * Wrapper function for the reading export API call.
+ */
+void readingExportWrapper(shared_ptr<HttpServer::Response> response,
+			 shared_ptr<HttpServer::Request> request)
+{
+	StorageApi *api = StorageApi::getInstance();
+	api->queueReadingRequest(response, [api, response, request]
+	{
+		api->limitEndpoint("readingExport", response, request, [api, response, request]
+		{
+			api->readingExport(response, request);
+		});
 	});
-	// Detach the new thread
-	work_thread.detach();
-#else
-	api->readingFetch(response, request);
-#endif
 }
 
 /**
@@ -195,7 +211,23 @@ void readingQueryWrapper(shared_ptr<HttpServer::Response> response,
 			 shared_ptr<HttpServer::Request> request)
 {
 	StorageApi *api = StorageApi::getInstance();
-	api->readingQuery(response, request);
+	api->limitEndpoint("readingQuery", response, request, [api, response, request]
+	{
+		api->readingQuery(response, request);
+	});
+}
+
+/**
+ * Wrapper function for the latest readings API call.
+ */
+void readingLatestWrapper(shared_ptr<HttpServer::Response> response,
+			 shared_ptr<HttpServer::Request> request)
+{
+	StorageApi *api = StorageApi::getInstance();
+	api->limitEndpoint("readingLatest", response, request, [api, response, request]
+	{
+		api->readingLatest(response, request);
+	});
 }
 
 /**
@@ -223,7 +255,10 @@ void readingPurgeWrapper(shared_ptr<HttpServer::Response> response,
 		// Increase count
 		std::atomic_fetch_add(cnt, 1);
 
-		api->readingPurge(response, request);
+		api->measureOperation("readingPurge", response, request, [api, response, request]
+		{
+			api->readingPurge(response, request);
+		});
 		// Decrease counter 
 		std::atomic_fetch_sub(cnt, 1);
 	});
@@ -292,6 +327,26 @@ void getTableSnapshotsWrapper(shared_ptr<HttpServer::Response> response,
 	api->getTableSnapshots(response, request);
 }
 
+/**
+ * Wrapper function for the storage profile API call.
+ */
+void storageProfileWrapper(shared_ptr<HttpServer::Response> response,
+				shared_ptr<HttpServer::Request> request)
+{
+	StorageApi *api = StorageApi::getInstance();
+	api->storageProfile(response, request);
+}
+
+/**
+ * Wrapper function for the storage metrics API call.
+ */
+void storageMetricsWrapper(shared_ptr<HttpServer::Response> response,
+				shared_ptr<HttpServer::Request> request)
+{
+	StorageApi *api = StorageApi::getInstance();
+	api->storageMetrics(response, request);
+}
+
 /**
  * Wrapper function for the create storage stream API call.
  */
@@ -302,6 +357,16 @@ void createStorageStreamWrapper(shared_ptr<HttpServer::Response> response,
 	api->createStorageStream(response, request);
 }
 
+/**
+ * Wrapper function for the create fetch stream API call.
+ */
+void createFetchStreamWrapper(shared_ptr<HttpServer::Response> response,
+				shared_ptr<HttpServer::Request> request)
+{
+	StorageApi *api = StorageApi::getInstance();
+	api->createFetchStream(response, request);
+}
+
 /**
  * Wrapper function for the create storage stream API call.
  */
@@ -331,7 +396,10 @@ void storageTableSimpleQueryWrapper(shared_ptr<HttpServer::Response> response,
                                 shared_ptr<HttpServer::Request> request)
 {
         StorageApi *api = StorageApi::getInstance();
-        api->storageTableSimpleQuery(response, request);
+        api->limitEndpoint("storageTableSimpleQuery", response, request, [api, response, request]
+        {
+                api->storageTableSimpleQuery(response, request);
+        });
 }
 
 /**
@@ -361,13 +429,18 @@ void storageTableQueryWrapper(shared_ptr<HttpServer::Response> response,
                                 shared_ptr<HttpServer::Request> request)
 {
         StorageApi *api = StorageApi::getInstance();
-        api->storageTableQuery(response, request);
+        api->limitEndpoint("storageTableQuery", response, request, [api, response, request]
+        {
+                api->storageTableQuery(response, request);
+        });
 }
 
 /**
  * Construct the singleton Storage API 
  */
-StorageApi::StorageApi(const unsigned short port, const unsigned int threads) : readingPlugin(0), streamHandler(0)
+StorageApi::StorageApi(const unsigned short port, const unsigned int threads,
+		const unsigned int workers, const unsigned int queueLength) :
+		readingPlugin(0), streamHandler(0), fetchHandler(0), m_readingCache(NULL)
 {
 
 	m_port = port;
@@ -375,9 +448,147 @@ StorageApi::StorageApi(const unsigned short port, const unsigned int threads) :
 	m_server = new HttpServer();
 	m_server->config.port = port;
 	m_server->config.thread_pool_size = threads;
+	m_workers = new StorageWorkerPool(stats, workers, queueLength);
 	StorageApi::m_instance = this;
 }
 
+/**
+ * Queue a readings request for execution by the worker pool. If the
+ * queue of the worker pool is full the request is refused with a
+ * 503 status and a Retry-After header in order to apply backpressure
+ * to the client.
+ *
+ * @param response	The response stream to send the response on
+ * @param work		The work to execute in the worker thread
+ */
+void StorageApi::queueReadingRequest(shared_ptr<HttpServer::Response> response,
+			const std::function<void()>& work)
+{
+	if (!m_workers->submit(work))
+	{
+		respondBusy(response);
+		Logger::getLogger()->warn("Storage API: reading worker queue is full, request rejected");
+	}
+}
+
+/**
+ * Process a request of an entry point that may have a limit on the
+ * number of its requests processed at once. A request beyond the limit
+ * is refused with a 503 status and a Retry-After header, so that long
+ * running requests of one entry point can not occupy all the threads
+ * of the server.
+ *
+ * @param endpoint	The name of the entry point in the statistics
+ * @param response	The response stream to send the response on
+ * @param request	The HTTP request
+ * @param work		The processing of the request
+ */
+void StorageApi::limitEndpoint(const char *endpoint, shared_ptr<HttpServer::Response> response,
+			shared_ptr<HttpServer::Request> request,
+			const std::function<void()>& work)
+{
+	EndpointGauge& gauge = stats.endpoints.at(endpoint);
+	if (!gauge.enter())
+	{
+		respondBusy(response);
+		Logger::getLogger()->warn("Storage API: %s has %d requests in progress, request rejected",
+				endpoint, gauge.getLimit());
+		return;
+	}
+	try {
+		measureOperation(endpoint, response, request, work);
+	} catch (...) {
+		gauge.leave();
+		throw;
+	}
+	gauge.leave();
+}
+
+/**
+ * Process a request and record the time taken and the bytes received
+ * and sent in the statistics of the entry point. The bytes sent are
+ * those of the response that is written when the processing returns,
+ * chunks of a response sent during the processing are not counted.
+ *
+ * @param operation	The name of the entry point in the statistics
+ * @param response	The response stream to send the response on
+ * @param request	The HTTP request
+ * @param work		The processing of the request
+ */
+void StorageApi::measureOperation(const char *operation, shared_ptr<HttpServer::Response> response,
+			shared_ptr<HttpServer::Request> request,
+			const std::function<void()>& work)
+{
+	OperationStats& op = stats.operations.at(operation);
+	size_t bytesIn = request->content.size();
+	struct timeval start, end;
+	gettimeofday(&start, NULL);
+	work();
+	gettimeofday(&end, NULL);
+	unsigned long usec = (unsigned long)((end.tv_sec - start.tv_sec) * 1000000 + end.tv_usec - start.tv_usec);
+	op.record(usec, bytesIn, response->size());
+}
+
+/**
+ * Refuse a request as the service is busy, asking the client to retry
+ *
+ * @param response	The response stream to send the response on
+ */
+void StorageApi::respondBusy(shared_ptr<HttpServer::Response> response)
+{
+	string payload = "{ \"error\" : \"Storage service busy, retry later\" }";
+	*response << "HTTP/1.1 " << status_code(SimpleWeb::StatusCode::server_error_service_unavailable)
+		<< "\r\nRetry-After: " << WORKER_RETRY_AFTER
+		<< "\r\nContent-Length: " << payload.length() << "\r\n"
+		<<  "Content-type: application/json\r\n\r\n" << payload;
+}
+
+/**
+ * Set the timeouts of the server, must be called before the server is started
+ *
+ * @param request	Seconds to receive a request, this also limits
+ *			how long an idle keep-alive connection is kept
+ * @param content	Seconds to receive the content of a request or send a response
+ */
+void StorageApi::setTimeouts(long request, long content)
+{
+	m_server->config.timeout_request = request;
+	m_server->config.timeout_content = content;
+}
+
+/**
+ * Set the limits on the number of requests of each entry point processed
+ * at once. Entry points that are not in the limits have no limit.
+ *
+ * @param limits	A JSON object with the limit of each entry point
+ */
+void StorageApi::setEndpointLimits(const string& limits)
+{
+	Document doc;
+	if (doc.Parse(limits.c_str()).HasParseError() || !doc.IsObject())
+	{
+		Logger::getLogger()->error("Storage API: the entry point limits must be a JSON object");
+		return;
+	}
+	for (auto& it : stats.endpoints)
+	{
+		unsigned int limit = 0;
+		if (doc.HasMember(it.first.c_str()) && doc[it.first.c_str()].IsUint())
+		{
+			limit = doc[it.first.c_str()].GetUint();
+		}
+		it.second.setLimit(limit);
+	}
+	for (auto& m : doc.GetObject())
+	{
+		if (stats.endpoints.find(m.name.GetString()) == stats.endpoints.end())
+		{
+			Logger::getLogger()->warn("Storage API: no limit can be set for the entry point %s",
+					m.name.GetString());
+		}
+	}
+}
+
 /**
  * Return the singleton instance of the StorageAPI class
  */
@@ -428,10 +639,14 @@ void StorageApi::initResources()
 
 	m_server->resource[READING_ACCESS]["POST"] = readingAppendWrapper;
 	m_server->resource[READING_ACCESS]["GET"] = readingFetchWrapper;
+	m_server->resource[READING_FETCH_FILTERED]["PUT"] = readingFetchFilteredWrapper;
+	m_server->resource[READING_EXPORT]["PUT"] = readingExportWrapper;
 	m_server->resource[READING_QUERY]["PUT"] = readingQueryWrapper;
 	m_server->resource[READING_PURGE]["PUT"] = readingPurgeWrapper;
+	m_server->resource[READING_LATEST]["GET"] = readingLatestWrapper;
 
 	m_server->resource[CREATE_STORAGE_STREAM]["POST"] = createStorageStreamWrapper;
+	m_server->resource[CREATE_FETCH_STREAM]["POST"] = createFetchStreamWrapper;
 	m_server->resource[STORAGE_SCHEMA]["POST"] = createStorageSchemaWrapper;
 
 	m_server->resource[STORAGE_TABLE_ACCESS]["POST"] = storageTableInsertWrapper;
@@ -440,6 +655,10 @@ void StorageApi::initResources()
 	m_server->resource[STORAGE_TABLE_ACCESS]["DELETE"] = storageTableDeleteWrapper;
 	m_server->resource[STORAGE_TABLE_QUERY]["PUT"] = storageTableQueryWrapper;
 
+	m_server->resource[STORAGE_PROFILE]["GET"] = storageProfileWrapper;
+	m_server->resource[STORAGE_PROFILE]["DELETE"] = storageProfileWrapper;
+	m_server->resource[STORAGE_METRICS]["GET"] = storageMetricsWrapper;
+
 	m_server->on_error = on_error;
 
 	ManagementApi *management = ManagementApi::getInstance();
@@ -456,6 +675,7 @@ void startService()
  */
 void StorageApi::start() {
 	m_thread = new thread(startService);
+	ThreadConfig::getInstance()->apply(*m_thread, "storage-api");
 }
 
 void StorageApi::startServer() {
@@ -464,6 +684,7 @@ void StorageApi::startServer() {
 
 void StorageApi::stopServer() {
 	m_server->stop();
+	m_workers->stop();
 }
 /**
  * Wait for the HTTP server to shutdown
@@ -478,6 +699,8 @@ void StorageApi::wait() {
 void StorageApi::setPlugin(StoragePlugin *plugin)
 {
 	this->plugin = plugin;
+	if (!readingPlugin)
+		stats.setPlugin(plugin);
 }
 
 /**
@@ -486,6 +709,7 @@ void StorageApi::setPlugin(StoragePlugin *plugin)
 void StorageApi::setReadingPlugin(StoragePlugin *plugin)
 {
 	this->readingPlugin = plugin;
+	stats.setPlugin(plugin);
 }
 
 /**
@@ -524,6 +748,7 @@ void StorageApi::respond(shared_ptr<HttpServer::Response> response, SimpleWeb::S
  */
 void StorageApi::commonInsert(shared_ptr<HttpServer::Response> response, shared_ptr<HttpServer::Request> request)
 {
+	TRACE_SPAN("storage", "StorageApi::commonInsert");
 string  tableName;
 string	payload;
 string  responsePayload;
@@ -559,6 +784,7 @@ string  responsePayload;
  */
 void StorageApi::commonUpdate(shared_ptr<HttpServer::Response> response, shared_ptr<HttpServer::Request> request)
 {
+	TRACE_SPAN("storage", "StorageApi::commonUpdate");
 string  tableName;
 string	payload;
 string	responsePayload;
@@ -637,6 +863,7 @@ string	responsePayload;
  */
 void StorageApi::commonSimpleQuery(shared_ptr<HttpServer::Response> response, shared_ptr<HttpServer::Request> request)
 {
+	TRACE_SPAN("storage", "StorageApi::commonSimpleQuery");
 string  tableName;
 SimpleWeb::CaseInsensitiveMultimap	query;
 string payload;
@@ -687,6 +914,7 @@ string payload;
  */
 void StorageApi::commonQuery(shared_ptr<HttpServer::Response> response, shared_ptr<HttpServer::Request> request)
 {
+	TRACE_SPAN("storage", "StorageApi::commonQuery");
 string  tableName;
 string	payload;
 
@@ -723,6 +951,7 @@ string	payload;
  */
 void StorageApi::commonDelete(shared_ptr<HttpServer::Response> response, shared_ptr<HttpServer::Request> request)
 {
+	TRACE_SPAN("storage", "StorageApi::commonDelete");
 string  tableName;
 string	payload;
 string  responsePayload;
@@ -759,6 +988,8 @@ string  responsePayload;
  */
 void StorageApi::readingAppend(shared_ptr<HttpServer::Response> response, shared_ptr<HttpServer::Request> request)
 {
+	TRACE_SPAN("storage", "StorageApi::readingAppend");
+	ALLOC_SCOPE(ALLOC_STORAGE_APPEND);
 string payload;
 string  responsePayload;
 	
@@ -808,7 +1039,13 @@ string  responsePayload;
 		int rval = (readingPlugin ? readingPlugin : plugin)->readingsAppend(payload);
 		if (rval != -1)
 		{
+			stats.readingsAppended += (unsigned long)rval;
+			ALLOC_READINGS(ALLOC_STORAGE_APPEND, rval);
 			registry.process(payload);
+			if (fetchHandler)
+			{
+				fetchHandler->notify();
+			}
 			responsePayload = "{ \"response\" : \"appended\", \"readings_added\" : ";
 			responsePayload += to_string(rval);
 			responsePayload += " }";
@@ -835,6 +1072,7 @@ string  responsePayload;
 void StorageApi::readingFetch(shared_ptr<HttpServer::Response> response,
 			      shared_ptr<HttpServer::Request> request)
 {
+	TRACE_SPAN("storage", "StorageApi::readingFetch");
 SimpleWeb::CaseInsensitiveMultimap query;
 unsigned long			   id = 0;
 unsigned long			   count = 0;
@@ -869,6 +1107,18 @@ unsigned long			   count = 0;
 			count = (unsigned)atol(search->second.c_str());
 		}
 
+		if (count > READING_FETCH_PAGE)
+		{
+			readingFetchChunked(response, id, count);
+			return;
+		}
+
+		if (m_readingCache)
+		{
+			readingFetchCached(response, id, count);
+			return;
+		}
+
 		// Get plugin data
 		char *responsePayload = (readingPlugin ? readingPlugin : plugin)->readingsFetch(id, count);
 		string res = responsePayload;
@@ -883,49 +1133,810 @@ unsigned long			   count = 0;
 }
 
 /**
- * Perform a query on a set of readings
+ * Filter the result of a readings fetch of a plugin that does not support
+ * the filtered fetch, keeping the readings of the assets and the
+ * datapoints wanted.
+ *
+ * @param fetched	The result of the readings fetch
+ * @param request	The filtered fetch request
+ * @param id		The id the fetch started from
+ * @param result	Set to the filtered result
+ */
+static void filterFetchedReadings(const char *fetched, const Value& request,
+				unsigned long id, string& result)
+{
+	set<string> assets, datapoints;
+	if (request.HasMember("assets") && request["assets"].IsArray())
+	{
+		for (auto& asset : request["assets"].GetArray())
+			if (asset.IsString())
+				assets.insert(asset.GetString());
+	}
+	if (request.HasMember("datapoints") && request["datapoints"].IsArray())
+	{
+		for (auto& datapoint : request["datapoints"].GetArray())
+			if (datapoint.IsString())
+				datapoints.insert(datapoint.GetString());
+	}
+	bool exclude = request.HasMember("exclude") && request["exclude"].IsBool()
+			&& request["exclude"].GetBool();
+
+	Document doc;
+	doc.Parse(fetched);
+	unsigned long next = id;
+	unsigned long count = 0;
+	StringBuffer buffer;
+	Writer<StringBuffer> writer(buffer);
+	writer.StartArray();
+	if (!doc.HasParseError() && doc.IsObject() && doc.HasMember("rows") && doc["rows"].IsArray())
+	{
+		for (auto& row : doc["rows"].GetArray())
+		{
+			if (!row.IsObject())
+				continue;
+			if (row.HasMember("id") && row["id"].IsUint64())
+				next = row["id"].GetUint64() + 1;
+			if (!assets.empty() && row.HasMember("asset_code") && row["asset_code"].IsString()
+					&& (assets.count(row["asset_code"].GetString()) != 0) == exclude)
+				continue;
+			if (!datapoints.empty() && row.HasMember("reading") && row["reading"].IsObject())
+			{
+				Value& reading = row["reading"];
+				for (auto m = reading.MemberBegin(); m != reading.MemberEnd(); )
+				{
+					if (datapoints.count(m->name.GetString()))
+						++m;
+					else
+						m = reading.EraseMember(m);
+				}
+				if (reading.MemberCount() == 0)
+					continue;
+			}
+			row.Accept(writer);
+			count++;
+		}
+	}
+	writer.EndArray();
+	result = "{\"count\":" + to_string(count) + ",\"next\":" + to_string(next) + ",\"rows\":";
+	result.append(buffer.GetString(), buffer.GetSize());
+	result += "}";
+}
+
+/**
+ * Fetch a block of the readings of some of the assets, returning only some
+ * of their datapoints. The request is a JSON document with the id of the
+ * first reading, the count of readings and optionally an array of assets,
+ * an exclude flag that inverts the selection of the assets and an array of
+ * datapoints. The result has the readings wanted and the id from which the
+ * next fetch should start.
+ *
+ * The filter is passed to the plugin if it supports the filtered fetch, so
+ * that it does not read the readings of the assets not wanted. Otherwise
+ * the readings fetched are filtered before they are returned.
  *
  * @param response	The response stream to send the response on
  * @param request	The HTTP request
  */
-void StorageApi::readingQuery(shared_ptr<HttpServer::Response> response, shared_ptr<HttpServer::Request> request)
+void StorageApi::readingFetchFiltered(shared_ptr<HttpServer::Response> response,
+			      shared_ptr<HttpServer::Request> request)
 {
+	TRACE_SPAN("storage", "StorageApi::readingFetchFiltered");
 string	payload;
 
-	stats.readingQuery++;
+	stats.readingFetch++;
 	try {
 		payload = request->content.string();
+		Document doc;
+		doc.Parse(payload.c_str());
+		if (doc.HasParseError() || !doc.IsObject()
+				|| !doc.HasMember("id") || !doc["id"].IsUint64()
+				|| !doc.HasMember("count") || !doc["count"].IsUint())
+		{
+			string error = "{ \"error\" : \"The fetch request must have an id and a count\" }";
+			respond(response, SimpleWeb::StatusCode::client_error_bad_request, error);
+			return;
+		}
 
-		char *resultSet = (readingPlugin ? readingPlugin : plugin)->readingsRetrieve(payload);
-		string res = resultSet;
-
+		StoragePlugin *fetchPlugin = readingPlugin ? readingPlugin : plugin;
+		string res;
+		if (fetchPlugin->hasFetchFilteredSupport())
+		{
+			char *resultSet = fetchPlugin->readingsFetchFiltered(payload);
+			if (!resultSet)
+			{
+				mapError(res, fetchPlugin->lastError());
+				respond(response, SimpleWeb::StatusCode::client_error_bad_request, res);
+				return;
+			}
+			res = resultSet;
+			free(resultSet);
+		}
+		else
+		{
+			unsigned long id = doc["id"].GetUint64();
+			char *resultSet = fetchPlugin->readingsFetch(id, doc["count"].GetUint());
+			filterFetchedReadings(resultSet, doc, id, res);
+			free(resultSet);
+		}
 		respond(response, res);
-		free(resultSet);
 	} catch (exception ex) {
 		internalError(response, ex);
 	}
 }
 
+/**
+ * A SAX handler that locates the rows of a page of readings returned
+ * by the readings fetch of a plugin, without building a document for
+ * the page. The handler records the extent of the rows array within
+ * the payload, the number of rows and the id of the last row.
+ */
+class FetchPageHandler : public rapidjson::BaseReaderHandler<rapidjson::UTF8<>, FetchPageHandler> {
+	public:
+		FetchPageHandler(rapidjson::StringStream& stream, vector<ReadingCacheRow> *cacheRows = NULL) :
+			m_stream(stream), m_depth(0), m_inRows(false), m_isId(false), m_rowStart(0),
+			m_cacheRows(cacheRows), m_rows(0), m_lastId(0), m_rowsStart(0), m_rowsEnd(0) {};
+		bool	Key(const char *str, rapidjson::SizeType length, bool)
+			{
+				m_key.assign(str, length);
+				m_isId = m_inRows && m_depth == 3 && m_key.compare("id") == 0;
+				return true;
+			};
+		bool	StartObject()
+			{
+				if (m_inRows && m_depth == 2)
+				{
+					m_rows++;
+					m_rowStart = m_stream.Tell() - 1;
+				}
+				m_depth++;
+				return true;
+			};
+		bool	EndObject(rapidjson::SizeType)
+			{
+				m_depth--;
+				if (m_cacheRows && m_inRows && m_depth == 2)
+				{
+					ReadingCacheRow row;
+					row.id = m_lastId;
+					row.json.assign(m_stream.head_ + m_rowStart, m_stream.Tell() - m_rowStart);
+					m_cacheRows->push_back(move(row));
+				}
+				return true;
+			};
+		bool	StartArray()
+			{
+				if (m_depth == 1 && m_key.compare("rows") == 0)
+				{
+					m_inRows = true;
+					m_rowsStart = m_stream.Tell();
+				}
+				m_depth++;
+				return true;
+			};
+		bool	EndArray(rapidjson::SizeType)
+			{
+				m_depth--;
+				if (m_inRows && m_depth == 1)
+				{
+					m_inRows = false;
+					m_rowsEnd = m_stream.Tell() - 1;
+				}
+				return true;
+			};
+		bool	Int(int i) { return i < 0 ? Default() : id((uint64_t)i); };
+		bool	Uint(unsigned i) { return id(i); };
+		bool	Int64(int64_t i) { return i < 0 ? Default() : id((uint64_t)i); };
+		bool	Uint64(uint64_t i) { return id(i); };
+		bool	Default() { m_isId = false; return true; };
+	private:
+		bool	id(uint64_t value)
+			{
+				if (m_isId)
+					m_lastId = value;
+				m_isId = false;
+				return true;
+			};
+		rapidjson::StringStream&	m_stream;
+		std::string			m_key;
+		int				m_depth;
+		bool				m_inRows;
+		bool				m_isId;
+		size_t				m_rowStart;
+		vector<ReadingCacheRow>		*m_cacheRows;
+	public:
+		unsigned long			m_rows;
+		unsigned long			m_lastId;
+		size_t				m_rowsStart;
+		size_t				m_rowsEnd;
+};
+
+/**
+ * The parts of a chunked response that have been queued on the
+ * connection but not yet written
+ */
+class ChunkedSend {
+	public:
+		ChunkedSend() : m_outstanding(0), m_failed(false) {};
+		void	sent(const SimpleWeb::error_code& ec)
+			{
+				lock_guard<mutex> guard(m_mutex);
+				m_outstanding--;
+				if (ec)
+					m_failed = true;
+				m_cv.notify_all();
+			};
+		/**
+		 * Queue the content written to the response and wait
+		 * whilst too many parts are waiting to be written
+		 *
+		 * @return bool	False if the connection has failed
+		 */
+		bool	send(shared_ptr<HttpServer::Response> response, shared_ptr<ChunkedSend> self)
+			{
+				unique_lock<mutex> lck(m_mutex);
+				m_outstanding++;
+				lck.unlock();
+				response->send([self](const SimpleWeb::error_code& ec) { self->sent(ec); });
+				lck.lock();
+				m_cv.wait(lck, [this]{ return m_outstanding < READING_FETCH_INFLIGHT || m_failed; });
+				return !m_failed;
+			};
+	private:
+		mutex			m_mutex;
+		condition_variable	m_cv;
+		unsigned int		m_outstanding;
+		bool			m_failed;
+};
 
 /**
- * Purge the readings
+ * Write a chunk of a response that uses chunked transfer encoding
+ *
+ * @param response	The response stream
+ * @param data		The data of the chunk
+ * @param length	The length of the data
+ */
+static void writeChunk(shared_ptr<HttpServer::Response> response, const char *data, size_t length)
+{
+	*response << hex << length << dec << "\r\n";
+	response->write(data, (streamsize)length);
+	*response << "\r\n";
+}
+
+/**
+ * Fetch a large block of readings by fetching pages of readings from
+ * the plugin and sending each page as a chunk of the response as soon
+ * as it is available. This bounds the size of the result the plugin
+ * builds and reduces the time to the first byte of the response.
+ *
+ * The response is a single JSON document with the same rows and count
+ * as a fetch of the whole block, the count follows the rows since it
+ * is not known until the last page has been fetched.
  *
  * @param response	The response stream to send the response on
- * @param request	The HTTP request
+ * @param id		The ID of the first reading to fetch
+ * @param count		The maximum number of readings to fetch
  */
-void StorageApi::readingPurge(shared_ptr<HttpServer::Response> response, shared_ptr<HttpServer::Request> request)
+void StorageApi::readingFetchChunked(shared_ptr<HttpServer::Response> response,
+				     unsigned long id, unsigned long count)
 {
-SimpleWeb::CaseInsensitiveMultimap query;
-unsigned long age = 0;
-unsigned long size = 0;
-unsigned long lastSent = 0;
-unsigned int  flagsMask = 0;
-string        flags;
-static std::atomic<bool> already_running(false);
+	TRACE_SPAN("storage", "StorageApi::readingFetchChunked");
+	StoragePlugin *fetchPlugin = readingPlugin ? readingPlugin : plugin;
+	shared_ptr<ChunkedSend> chunks = make_shared<ChunkedSend>();
+	unsigned long total = 0;
+	bool started = false;
 
-	if (already_running)
+	while (total < count)
 	{
-		string payload = "{ \"error\" : \"Previous instance of purge is still running, not starting another one.\" }";
+		unsigned long page = count - total;
+		if (page > READING_FETCH_PAGE)
+			page = READING_FETCH_PAGE;
+		char *payload = fetchPlugin->readingsFetch(id, page);
+		if (!payload)
+		{
+			break;
+		}
+		rapidjson::StringStream stream(payload);
+		FetchPageHandler handler(stream);
+		rapidjson::Reader reader;
+		bool valid = !reader.Parse(stream, handler).IsError() && handler.m_rowsEnd > 0
+				&& (handler.m_rows == 0 || handler.m_lastId > 0);
+		if (!started)
+		{
+			if (!valid || handler.m_rows < page)
+			{
+				// An error or the whole block in a single page,
+				// return the payload of the plugin as it is
+				respond(response, payload);
+				free(payload);
+				return;
+			}
+			*response << "HTTP/1.1 200 OK\r\nTransfer-Encoding: chunked\r\n"
+				<< "Content-type: application/json\r\n\r\n";
+			string start = "{ \"rows\" : [";
+			writeChunk(response, start.c_str(), start.length());
+			started = true;
+		}
+		else if (!valid)
+		{
+			Logger::getLogger()->warn("Readings fetch returned an invalid page, returning %lu readings", total);
+			free(payload);
+			break;
+		}
+		if (handler.m_rows)
+		{
+			if (total)
+			{
+				writeChunk(response, ",", 1);
+			}
+			writeChunk(response, payload + handler.m_rowsStart,
+					handler.m_rowsEnd - handler.m_rowsStart);
+		}
+		free(payload);
+		total += handler.m_rows;
+		id = handler.m_lastId + 1;
+		if (handler.m_rows < page || !chunks->send(response, chunks))
+		{
+			break;
+		}
+	}
+	string end = "], \"count\" : " + to_string(total) + " }";
+	writeChunk(response, end.c_str(), end.length());
+	*response << "0\r\n\r\n";
+}
+
+/**
+ * Fetch a block of readings using the reading cache. The readings
+ * held in the cache are returned from it and the remainder fetched
+ * from the plugin, the readings fetched from the plugin are then
+ * added to the cache for the other clients that will fetch them.
+ *
+ * @param response	The response stream to send the response on
+ * @param id		The ID of the first reading to fetch
+ * @param count		The maximum number of readings to fetch
+ */
+void StorageApi::readingFetchCached(shared_ptr<HttpServer::Response> response,
+				     unsigned long id, unsigned long count)
+{
+	string rows;
+	unsigned long next;
+	unsigned long cached = m_readingCache->fetch(id, count, rows, next);
+	if (cached == count)
+	{
+		stats.readingCacheHit++;
+		respond(response, "{ \"count\" : " + to_string(cached) + ", \"rows\" : [ " + rows + " ] }");
+		return;
+	}
+
+	char *payload = (readingPlugin ? readingPlugin : plugin)->readingsFetch(next, count - cached);
+	if (!payload)
+	{
+		internalError(response, runtime_error("Readings fetch failed"));
+		return;
+	}
+	vector<ReadingCacheRow> fetched;
+	rapidjson::StringStream stream(payload);
+	FetchPageHandler handler(stream, &fetched);
+	rapidjson::Reader reader;
+	bool valid = !reader.Parse(stream, handler).IsError() && handler.m_rowsEnd > 0
+			&& (handler.m_rows == 0 || handler.m_lastId > 0);
+	if (valid && fetched.size() == handler.m_rows)
+	{
+		if (handler.m_rows)
+		{
+			if (cached)
+			{
+				rows.append(",");
+			}
+			rows.append(payload + handler.m_rowsStart, handler.m_rowsEnd - handler.m_rowsStart);
+		}
+		m_readingCache->add(next, fetched);
+		respond(response, "{ \"count\" : " + to_string(cached + handler.m_rows)
+				+ ", \"rows\" : [ " + rows + " ] }");
+	}
+	else if (cached)
+	{
+		respond(response, "{ \"count\" : " + to_string(cached) + ", \"rows\" : [ " + rows + " ] }");
+	}
+	else
+	{
+		// An error from the plugin, return it as it is
+		respond(response, payload);
+	}
+	free(payload);
+}
+
+/**
+ * Create the cache of readings shared by the readings fetch requests
+ *
+ * @param rows	The maximum number of readings to cache, 0 disables the cache
+ */
+void StorageApi::setReadingCache(unsigned long rows)
+{
+	delete m_readingCache;
+	m_readingCache = rows ? new ReadingCache(rows) : NULL;
+	Logger::getLogger()->info("Reading cache of %lu readings", rows);
+}
+
+/**
+ * Perform a query on a set of readings
+ *
+ * @param response	The response stream to send the response on
+ * @param request	The HTTP request
+ */
+void StorageApi::readingQuery(shared_ptr<HttpServer::Response> response, shared_ptr<HttpServer::Request> request)
+{
+	TRACE_SPAN("storage", "StorageApi::readingQuery");
+string	payload;
+
+	stats.readingQuery++;
+	try {
+		payload = request->content.string();
+
+		char *resultSet = (readingPlugin ? readingPlugin : plugin)->readingsRetrieve(payload);
+		string res = resultSet;
+
+		respond(response, res);
+		free(resultSet);
+	} catch (exception ex) {
+		internalError(response, ex);
+	}
+}
+
+/**
+ * Build the query of a page of the readings of an export, the readings
+ * from the id onwards within the time range and assets of the export
+ * request, in the order of their ids
+ *
+ * @param request	The export request
+ * @param id		The id of the first reading of the page
+ * @return string	The JSON query
+ */
+static string readingExportQuery(const Document& request, unsigned long id)
+{
+	StringBuffer buffer;
+	Writer<StringBuffer> writer(buffer);
+	writer.StartObject();
+	writer.Key("where");
+	writer.StartObject();
+	writer.Key("column"); writer.String("id");
+	writer.Key("condition"); writer.String(">=");
+	writer.Key("value"); writer.Uint64(id);
+	int conditions = 1;
+	if (request.HasMember("start"))
+	{
+		writer.Key("and");
+		writer.StartObject();
+		writer.Key("column"); writer.String("user_ts");
+		writer.Key("condition"); writer.String(">=");
+		writer.Key("value"); request["start"].Accept(writer);
+		conditions++;
+	}
+	if (request.HasMember("end"))
+	{
+		writer.Key("and");
+		writer.StartObject();
+		writer.Key("column"); writer.String("user_ts");
+		writer.Key("condition"); writer.String("<");
+		writer.Key("value"); request["end"].Accept(writer);
+		conditions++;
+	}
+	if (request.HasMember("assets") && request["assets"].Size())
+	{
+		writer.Key("and");
+		writer.StartObject();
+		writer.Key("column"); writer.String("asset_code");
+		writer.Key("condition"); writer.String("in");
+		writer.Key("value"); request["assets"].Accept(writer);
+		conditions++;
+	}
+	while (conditions--)
+	{
+		writer.EndObject();
+	}
+	writer.Key("return");
+	writer.StartArray();
+	writer.String("id");
+	writer.String("asset_code");
+	writer.String("reading");
+	for (auto column : { "user_ts", "ts" })
+	{
+		writer.StartObject();
+		writer.Key("column"); writer.String(column);
+		writer.Key("timezone"); writer.String("utc");
+		writer.EndObject();
+	}
+	writer.EndArray();
+	writer.Key("sort");
+	writer.StartObject();
+	writer.Key("column"); writer.String("id");
+	writer.Key("direction"); writer.String("asc");
+	writer.EndObject();
+	writer.Key("limit"); writer.Uint(READING_FETCH_PAGE);
+	writer.EndObject();
+	return buffer.GetString();
+}
+
+/**
+ * Append a row of a readings query to a block of an export as a
+ * reading of the fetch stream
+ *
+ * @param block		The block to append to
+ * @param row		The row of the query
+ * @return bool		False if the row is not a valid reading
+ */
+static bool appendExportReading(string& block, const Value& row)
+{
+	if (!row.IsObject() || !row.HasMember("id") || !row["id"].IsUint64()
+			|| !row.HasMember("asset_code") || !row["asset_code"].IsString()
+			|| !row.HasMember("reading")
+			|| !row.HasMember("user_ts") || !row["user_ts"].IsString()
+			|| !row.HasMember("ts") || !row["ts"].IsString())
+	{
+		return false;
+	}
+	RDSFetchReadingHeader hdr;
+	hdr.magic = RDS_FETCH_READING_MAGIC;
+	hdr.reserved = 0;
+	hdr.id = row["id"].GetUint64();
+	if (!TimestampFormatter::parse(row["user_ts"].GetString(), &hdr.userTs)
+			|| !TimestampFormatter::parse(row["ts"].GetString(), &hdr.ts))
+	{
+		return false;
+	}
+	StringBuffer reading;
+	const char *payload;
+	size_t length;
+	if (row["reading"].IsString())
+	{
+		payload = row["reading"].GetString();
+		length = row["reading"].GetStringLength();
+	}
+	else
+	{
+		Writer<StringBuffer> writer(reading);
+		row["reading"].Accept(writer);
+		payload = reading.GetString();
+		length = reading.GetSize();
+	}
+	hdr.assetLength = row["asset_code"].GetStringLength();
+	hdr.payloadLength = length;
+	block.append((const char *)&hdr, sizeof(hdr));
+	block.append(row["asset_code"].GetString(), hdr.assetLength);
+	block.append(payload, length);
+	return true;
+}
+
+/**
+ * Export the readings of a range of time, and optionally of a set of
+ * assets, as a stream of binary blocks. The request is a JSON object
+ * with the optional members
+ *
+ *	start	The UTC user timestamp of the first readings to export
+ *	end	The UTC user timestamp, exclusive, of the last readings
+ *	assets	An array of the asset codes to export, all if empty
+ *	id	The id from which to export, to resume an export
+ *
+ * The readings are fetched from the plugin a page at a time, in the
+ * order of their ids, and each page is sent as a chunk of the response
+ * as soon as it is available, with the same backpressure as a large
+ * readings fetch. Each chunk is a block of the fetch stream, see
+ * reading_stream.h, with the block numbers counting from 0. The end of
+ * the export is marked by a block with no readings, a response without
+ * it has been cut short and may be resumed from the id after the last
+ * reading received.
+ *
+ * @param response	The response stream to send the response on
+ * @param request	The HTTP request
+ */
+void StorageApi::readingExport(shared_ptr<HttpServer::Response> response, shared_ptr<HttpServer::Request> request)
+{
+	TRACE_SPAN("storage", "StorageApi::readingExport");
+	struct timeval tv;
+
+	stats.readingQuery++;
+	try {
+		string payload = request->content.string();
+		Document doc;
+		doc.Parse(payload.c_str());
+		string error;
+		if (doc.HasParseError() || !doc.IsObject())
+		{
+			error = "The export request must be a JSON object";
+		}
+		else if (doc.HasMember("id") && !doc["id"].IsUint64())
+		{
+			error = "The id of the export request must be a reading id";
+		}
+		else if ((doc.HasMember("start") && (!doc["start"].IsString()
+					|| !TimestampFormatter::parse(doc["start"].GetString(), &tv)))
+				|| (doc.HasMember("end") && (!doc["end"].IsString()
+					|| !TimestampFormatter::parse(doc["end"].GetString(), &tv))))
+		{
+			error = "The start and end of the export request must be timestamps";
+		}
+		else if (doc.HasMember("assets"))
+		{
+			if (!doc["assets"].IsArray())
+			{
+				error = "The assets of the export request must be an array of asset codes";
+			}
+			else
+			{
+				for (auto& asset : doc["assets"].GetArray())
+				{
+					if (!asset.IsString())
+						error = "The assets of the export request must be an array of asset codes";
+				}
+			}
+		}
+		if (!error.empty())
+		{
+			respond(response, SimpleWeb::StatusCode::client_error_bad_request,
+					"{ \"error\" : \"" + error + "\" }");
+			return;
+		}
+
+		StoragePlugin *exportPlugin = readingPlugin ? readingPlugin : plugin;
+		shared_ptr<ChunkedSend> chunks = make_shared<ChunkedSend>();
+		unsigned long id = doc.HasMember("id") ? doc["id"].GetUint64() : 0;
+		uint32_t blockNumber = 0;
+		unsigned long total = 0;
+		bool started = false;
+		bool complete = false;
+		string block;
+		while (true)
+		{
+			char *resultSet = exportPlugin->readingsRetrieve(readingExportQuery(doc, id));
+			if (!resultSet)
+			{
+				if (!started)
+				{
+					string res;
+					mapError(res, exportPlugin->lastError());
+					respond(response, SimpleWeb::StatusCode::client_error_bad_request, res);
+					return;
+				}
+				Logger::getLogger()->error("Readings export failed after %lu readings", total);
+				break;
+			}
+			Document page;
+			page.Parse(resultSet);
+			if (page.HasParseError() || !page.IsObject()
+					|| !page.HasMember("rows") || !page["rows"].IsArray())
+			{
+				if (!started)
+				{
+					// An error from the plugin, return it as it is
+					respond(response, SimpleWeb::StatusCode::client_error_bad_request, resultSet);
+					free(resultSet);
+					return;
+				}
+				Logger::getLogger()->error("Readings export returned an invalid page after %lu readings", total);
+				free(resultSet);
+				break;
+			}
+			free(resultSet);
+			if (!started)
+			{
+				*response << "HTTP/1.1 200 OK\r\nTransfer-Encoding: chunked\r\n"
+					<< "Content-type: application/octet-stream\r\n\r\n";
+				started = true;
+			}
+
+			const Value& rows = page["rows"];
+			unsigned long pageStart = id;
+			RDSBlockHeader hdr;
+			hdr.magic = RDS_BLOCK_MAGIC;
+			hdr.blockNumber = blockNumber;
+			hdr.count = 0;
+			block.assign((const char *)&hdr, sizeof(hdr));
+			for (auto& row : rows.GetArray())
+			{
+				if (appendExportReading(block, row))
+				{
+					hdr.count++;
+				}
+				else
+				{
+					Logger::getLogger()->warn("Readings export skipped an invalid reading");
+				}
+				if (row.IsObject() && row.HasMember("id") && row["id"].IsUint64())
+				{
+					id = row["id"].GetUint64() + 1;
+				}
+			}
+			if (hdr.count)
+			{
+				memcpy(&block[0], &hdr, sizeof(hdr));
+				writeChunk(response, block.c_str(), block.length());
+				blockNumber++;
+				total += hdr.count;
+			}
+			if (rows.Size() < READING_FETCH_PAGE)
+			{
+				complete = true;
+				break;
+			}
+			if (id == pageStart)
+			{
+				Logger::getLogger()->error("Readings export returned a page without reading ids");
+				break;
+			}
+			if (!chunks->send(response, chunks))
+			{
+				break;
+			}
+		}
+		if (complete)
+		{
+			// The block that marks the end of the export
+			RDSBlockHeader hdr;
+			hdr.magic = RDS_BLOCK_MAGIC;
+			hdr.blockNumber = blockNumber;
+			hdr.count = 0;
+			writeChunk(response, (const char *)&hdr, sizeof(hdr));
+			Logger::getLogger()->info("Exported %lu readings in %u blocks", total, blockNumber);
+		}
+		*response << "0\r\n\r\n";
+	} catch (exception ex) {
+		internalError(response, ex);
+	}
+}
+
+/**
+ * Return the latest reading of each asset, the latest value of each
+ * datapoint of the asset, as kept by the readings plugin. The optional
+ * asset query parameter limits the result to a single asset.
+ *
+ * @param response	The response stream to send the response on
+ * @param request	The HTTP request
+ */
+void StorageApi::readingLatest(shared_ptr<HttpServer::Response> response, shared_ptr<HttpServer::Request> request)
+{
+SimpleWeb::CaseInsensitiveMultimap query;
+string	latest;
+
+	stats.readingQuery++;
+	try {
+		query = request->parse_query_string();
+		auto search = query.find("asset");
+		const char *asset = search != query.end() ? search->second.c_str() : NULL;
+
+		if ((readingPlugin ? readingPlugin : plugin)->readingsLatest(latest, asset))
+		{
+			respond(response, latest);
+		}
+		else
+		{
+			string payload = "{ \"error\" : \"The storage plugin does not keep the latest readings\" }";
+			respond(response, SimpleWeb::StatusCode::client_error_not_found, payload);
+		}
+	} catch (exception ex) {
+		internalError(response, ex);
+	}
+}
+
+
+/**
+ * Purge the readings
+ *
+ * @param response	The response stream to send the response on
+ * @param request	The HTTP request
+ */
+void StorageApi::readingPurge(shared_ptr<HttpServer::Response> response, shared_ptr<HttpServer::Request> request)
+{
+	TRACE_SPAN("storage", "StorageApi::readingPurge");
+SimpleWeb::CaseInsensitiveMultimap query;
+unsigned long age = 0;
+unsigned long size = 0;
+unsigned long lastSent = 0;
+unsigned int  flagsMask = 0;
+string        flags;
+static std::atomic<bool> already_running(false);
+
+	if (already_running)
+	{
+		string payload = "{ \"error\" : \"Previous instance of purge is still running, not starting another one.\" }";
 		respond(response, SimpleWeb::StatusCode::client_error_too_many_requests, payload);
 		return;
 	}
@@ -1004,6 +2015,10 @@ static std::atomic<bool> already_running(false);
 			already_running.store(false);
 			return;
 		}
+		if (m_readingCache)
+		{
+			m_readingCache->clear();
+		}
 		respond(response, purged);
 		free(purged);
 	}
@@ -1112,13 +2127,39 @@ void StorageApi::createStorageStream(shared_ptr<HttpServer::Response> response,
 {
 string	responsePayload;
 
-	(void)(request); 	// Surpress unused arguemnt warning
 	try {
 		if (!streamHandler)
 		{
 			streamHandler = new StreamHandler(this);
+			stats.setStreamHandler(streamHandler);
 		}
 		uint32_t token;
+
+		// A client on the same host may ask for the shared memory transport
+		string payload = request->content.string();
+		Document doc;
+		if (!payload.empty() && !doc.Parse(payload.c_str()).HasParseError()
+				&& doc.IsObject() && doc.HasMember("transport") && doc["transport"].IsString()
+				&& strcmp(doc["transport"].GetString(), "shared") == 0)
+		{
+			string name = streamHandler->createSharedStream(&token);
+			if (!name.empty())
+			{
+				responsePayload = "{ \"path\": \"" + name + "\"";
+				responsePayload += ", \"token\":";
+				responsePayload += to_string(token);
+				responsePayload += ", \"protocol\":";
+				responsePayload += to_string(RDS_PROTOCOL_VERSION);
+				responsePayload += " }";
+				respond(response, responsePayload);
+			}
+			else
+			{
+				responsePayload = "{ \"message\" : \"Unable to create the shared memory stream\" }";
+				respond(response, SimpleWeb::StatusCode::client_error_bad_request, responsePayload);
+			}
+			return;
+		}
 		uint32_t port = streamHandler->createStream(&token);
 		if (port != 0)
 		{
@@ -1126,6 +2167,8 @@ string	responsePayload;
 			responsePayload += to_string(port);
 			responsePayload += ", \"token\":"; 
 			responsePayload += to_string(token);
+			responsePayload += ", \"protocol\":"; 
+			responsePayload += to_string(RDS_PROTOCOL_VERSION);
 			responsePayload += " }";
 			respond(response, responsePayload);
 		}
@@ -1139,6 +2182,69 @@ string	responsePayload;
 		}
 }
 
+/**
+ * Create a stream that pushes readings to a north service, or to the
+ * storage service of a standby node. The storage plugin must support
+ * the binary fetch of readings, clients of other plugins fall back to
+ * the readings fetch API. The stream listens on the address the request
+ * was received on, the loopback address for local clients.
+ *
+ * @param response	The response stream to send the response on
+ * @param request	The HTTP request
+ */
+void StorageApi::createFetchStream(shared_ptr<HttpServer::Response> response, shared_ptr<HttpServer::Request> request)
+{
+string	responsePayload;
+
+	try {
+		uint32_t address = htonl(INADDR_LOOPBACK);
+		SimpleWeb::asio::ip::address local = request->local_endpoint().address();
+		if (local.is_v6() && local.to_v6().is_v4_mapped())
+		{
+			local = local.to_v6().to_v4();
+		}
+		if (local.is_v4() && !local.is_unspecified())
+		{
+			address = htonl(local.to_v4().to_ulong());
+		}
+
+		StoragePlugin *readings = readingPlugin ? readingPlugin : plugin;
+		if (!readings->hasFetchBinarySupport())
+		{
+			responsePayload = "{ \"message\" : \"The storage plugin does not support fetch streams\" }";
+			respond(response, SimpleWeb::StatusCode::client_error_bad_request, responsePayload);
+			return;
+		}
+		{
+			lock_guard<mutex> guard(m_fetchHandlerMutex);
+			if (!fetchHandler)
+			{
+				fetchHandler = new FetchStreamHandler(readings);
+			}
+		}
+		uint32_t token;
+		uint32_t port = fetchHandler->createStream(&token, address);
+		if (port != 0)
+		{
+			responsePayload = "{ \"port\":";
+			responsePayload += to_string(port);
+			responsePayload += ", \"token\":";
+			responsePayload += to_string(token);
+			responsePayload += ", \"protocol\":";
+			responsePayload += to_string(RDS_PROTOCOL_VERSION);
+			responsePayload += " }";
+			respond(response, responsePayload);
+		}
+		else
+		{
+			responsePayload = "{ \"message\" : \"Unable to create the fetch stream\" }";
+			respond(response, SimpleWeb::StatusCode::client_error_bad_request, responsePayload);
+		}
+	} catch (exception& ex) {
+		internalError(response, ex);
+	}
+}
+
 /**
  * Append the readings that have arrived via a stream to the storage plugin
  *
@@ -1147,12 +2253,24 @@ string	responsePayload;
  */
 bool StorageApi::readingStream(ReadingStream **readings, bool commit)
 {
+	TRACE_SPAN("storage", "StorageApi::readingStream");
+	ALLOC_SCOPE(ALLOC_STORAGE_APPEND);
 	int c;
 	for (c = 0; readings[c]; c++);
 	Logger::getLogger()->debug("ReadingStream called with %d", c);
 	if ((readingPlugin ? readingPlugin : plugin)->hasStreamSupport())
 	{
-		return (readingPlugin ? readingPlugin : plugin)->readingStream(readings, commit);
+		bool rval = (readingPlugin ? readingPlugin : plugin)->readingStream(readings, commit);
+		if (rval)
+		{
+			stats.readingsAppended += (unsigned long)c;
+			ALLOC_READINGS(ALLOC_STORAGE_APPEND, c);
+		}
+		if (fetchHandler)
+		{
+			fetchHandler->notify();
+		}
+		return rval;
 	}
 	else
 	{
@@ -1175,12 +2293,36 @@ bool StorageApi::readingStream(ReadingStream **readings, bool commit)
 			snprintf(micro_s, sizeof(micro_s), ".%06lu", readings[i]->userTs.tv_usec);
 			convert << ts << micro_s;
 			convert << "\",\"reading\":";
-			convert << &(readings[i]->assetCode[readings[i]->assetCodeLength]);
+			const char *payload = &(readings[i]->assetCode[readings[i]->assetCodeLength]);
+			if (readings[i]->payloadFormat == RDS_PAYLOAD_BINARY)
+			{
+				string json;
+				if (!ReadingStreamPayload::toJSON(payload, readings[i]->payloadLength, json))
+				{
+					Logger::getLogger()->error("Unable to decode binary stream payload for asset %s",
+							readings[i]->assetCode);
+					json = "{}";
+				}
+				convert << json;
+			}
+			else
+			{
+				convert << payload;
+			}
 			convert << "}";
 		}
 		convert << "]}";
 		Logger::getLogger()->debug("Fallback created payload: %s", convert.str().c_str());
-		(readingPlugin ? readingPlugin : plugin)->readingsAppend(convert.str());
+		int appended = (readingPlugin ? readingPlugin : plugin)->readingsAppend(convert.str());
+		if (appended > 0)
+		{
+			stats.readingsAppended += (unsigned long)appended;
+			ALLOC_READINGS(ALLOC_STORAGE_APPEND, appended);
+		}
+		if (fetchHandler)
+		{
+			fetchHandler->notify();
+		}
 	}	
 	return false;
 }
@@ -1379,6 +2521,55 @@ string   payload;
         }
 }
 
+/**
+ * Return the latency profile of the storage plugins, the histograms of
+ * the durations of each operation and the slowest SQL statements. The
+ * profile is shared by the plugins, it is requested from the main
+ * plugin or from the readings plugin if the main plugin does not
+ * profile its operations. A DELETE request also clears the profile.
+ *
+ * @param response	The response stream to send the response on
+ * @param request	The HTTP request
+ */
+void StorageApi::storageProfile(shared_ptr<HttpServer::Response> response,
+				shared_ptr<HttpServer::Request> request)
+{
+string	profile;
+
+	try {
+		bool reset = request->method.compare("DELETE") == 0;
+		if (plugin->profile(profile, reset)
+			|| (readingPlugin && readingPlugin->profile(profile, reset)))
+		{
+			respond(response, profile);
+		}
+		else
+		{
+			string payload = "{ \"error\" : \"The storage plugin does not profile its operations\" }";
+			respond(response, SimpleWeb::StatusCode::client_error_not_found, payload);
+		}
+	} catch (exception ex) {
+		internalError(response, ex);
+	}
+}
+
+/**
+ * Return the statistics of the storage service in the Prometheus
+ * text exposition format
+ *
+ * @param response	The response stream to send the response on
+ * @param request	The HTTP request
+ */
+void StorageApi::storageMetrics(shared_ptr<HttpServer::Response> response,
+				shared_ptr<HttpServer::Request> request)
+{
+string	metrics;
+
+	(void)request;
+	stats.asPrometheus(metrics);
+	*response << "HTTP/1.1 200 OK\r\nContent-Length: " << metrics.length() << "\r\n"
+		 <<  "Content-type: text/plain; version=0.0.4\r\n\r\n" << metrics;
+}
 
 /**
  * Perform an create table and create index for schema provided in the payload.
@@ -103,6 +103,8 @@ StoragePlugin::StoragePlugin(const string& name, PLUGIN_HANDLE handle) : Plugin(
 				manager->resolveSymbol(handle, "plugin_reading_append");
 	readingsFetchPtr = (char * (*)(PLUGIN_HANDLE, unsigned long id, unsigned int blksize))
 				manager->resolveSymbol(handle, "plugin_reading_fetch");
+	readingsFetchFilteredPtr = (char * (*)(PLUGIN_HANDLE, const char *))
+				manager->resolveSymbol(handle, "plugin_reading_fetch_filtered");
 	readingsRetrievePtr = (char * (*)(PLUGIN_HANDLE, const char *))
 				manager->resolveSymbol(handle, "plugin_reading_retrieve");
 	readingsPurgePtr = (char * (*)(PLUGIN_HANDLE, unsigned long age, unsigned int flags, unsigned long sent))
@@ -126,7 +128,14 @@ StoragePlugin::StoragePlugin(const string& name, PLUGIN_HANDLE handle) : Plugin(
 	readingStreamPtr =
 			(int (*)(PLUGIN_HANDLE, ReadingStream **, bool))
 			      manager->resolveSymbol(handle, "plugin_readingStream");
+	readingsFetchBinaryPtr =
+			(int (*)(PLUGIN_HANDLE, unsigned long, unsigned int, char **, size_t *))
+			      manager->resolveSymbol(handle, "plugin_reading_fetch_binary");
 	pluginShutdownPtr = (bool (*)(PLUGIN_HANDLE))manager->resolveSymbol(handle, "plugin_shutdown");
+	statisticsPtr = (char * (*)(PLUGIN_HANDLE))manager->resolveSymbol(handle, "plugin_statistics");
+	profilePtr = (char * (*)(PLUGIN_HANDLE, bool))manager->resolveSymbol(handle, "plugin_profile");
+	readingsLatestPtr = (char * (*)(PLUGIN_HANDLE, const char *))
+			      manager->resolveSymbol(handle, "plugin_reading_latest");
 
 	createSchemaPtr = 
               		(int (*)(PLUGIN_HANDLE, const char*))
@@ -290,6 +299,31 @@ int StoragePlugin::readingStream(ReadingStream **stream, bool commit)
         return this->readingStreamPtr(instance, stream, commit);
 }
 
+/**
+ * Call the filtered readings fetch method in the plugin
+ *
+ * @param payload	The JSON request of the fetch
+ * @return char*	The JSON result set, NULL if the request is not valid
+ */
+char *StoragePlugin::readingsFetchFiltered(const string& payload)
+{
+	return this->readingsFetchFilteredPtr(instance, payload.c_str());
+}
+
+/**
+ * Call the binary readings fetch method in the plugin
+ *
+ * @param id		The id of the first reading to fetch
+ * @param blksize	The maximum number of readings to fetch
+ * @param buffer	Set to a buffer of readings that the caller must free
+ * @param length	Set to the length of the buffer
+ * @return int		The number of readings fetched or -1 on error
+ */
+int StoragePlugin::readingsFetchBinary(unsigned long id, unsigned int blksize, char **buffer, size_t *length)
+{
+	return this->readingsFetchBinaryPtr(instance, id, blksize, buffer, length);
+}
+
 /**
  * Call the shutdown entry point of the plugin
  */
@@ -300,6 +334,62 @@ bool StoragePlugin::pluginShutdown()
 	return true;
 }
 
+/**
+ * Call the optional statistics entry point of the plugin
+ *
+ * @param json	Set to the JSON document of the plugin statistics
+ * @return bool	False if the plugin does not report statistics
+ */
+bool StoragePlugin::statistics(string& json)
+{
+	if (!this->statisticsPtr)
+		return false;
+	char *stats = this->statisticsPtr(instance);
+	if (!stats)
+		return false;
+	json = stats;
+	release(stats);
+	return true;
+}
+
+/**
+ * Call the optional latency profile entry point of the plugin
+ *
+ * @param json	Set to the JSON document of the profile
+ * @param reset	Clear the profile once it has been returned
+ * @return bool	False if the plugin does not profile its operations
+ */
+bool StoragePlugin::profile(string& json, bool reset)
+{
+	if (!this->profilePtr)
+		return false;
+	char *profile = this->profilePtr(instance, reset);
+	if (!profile)
+		return false;
+	json = profile;
+	release(profile);
+	return true;
+}
+
+/**
+ * Call the optional latest readings entry point of the plugin
+ *
+ * @param json	Set to the JSON result set of the latest readings
+ * @param asset	The asset to return or NULL for all the assets
+ * @return bool	False if the plugin does not keep the latest readings
+ */
+bool StoragePlugin::readingsLatest(string& json, const char *asset)
+{
+	if (!this->readingsLatestPtr)
+		return false;
+	char *latest = this->readingsLatestPtr(instance, asset);
+	if (!latest)
+		return false;
+	json = latest;
+	release(latest);
+	return true;
+}
+
 /**
  * Call the schema create method in the plugin
  */
@@ -8,16 +8,17 @@
  * Author: Mark Riddoch
  */
 #include <rapidjson/document.h>
+#include <rapidjson/reader.h>
 #include "storage_registry.h"
 #include "client_http.hpp"
 #include "server_http.hpp"
 #include "management_api.h"
-#include "reading_set.h"
-#include "reading.h"
 #include "logger.h"
 #include "strings.h"
-#include "client_http.hpp"
 #include <chrono>
+#include <unordered_map>
+#include <string.h>
+#include <thread_config.h>
 
 #define CHECK_QTIMES	0	// Turn on to check length of time data is queued
 #define QTIME_THRESHOLD 3	// Threshold to report long queue times
@@ -51,9 +52,11 @@ static void worker(StorageRegistry *registry)
  * the storage layer is minimally impacted by the registration and
  * delivery of these messages to interested microservices.
  */
-StorageRegistry::StorageRegistry()
+StorageRegistry::StorageRegistry() : m_registrationCount(0), m_running(true),
+	m_queueMetrics("storage.registry", "payloads")
 {
 	m_thread = new thread(worker, this);
+	ThreadConfig::getInstance()->apply(*m_thread, "storage-registry");
 }
 
 /**
@@ -62,7 +65,13 @@ StorageRegistry::StorageRegistry()
 StorageRegistry::~StorageRegistry()
 {
 	m_running = false;
+	m_cv.notify_all();
 	m_thread->join();
+	delete m_thread;
+	for (auto& client : m_clients)
+	{
+		delete client.second;
+	}
 }
 
 /**
@@ -75,7 +84,7 @@ StorageRegistry::~StorageRegistry()
 void
 StorageRegistry::process(const string& payload)
 {
-	if (m_registrations.size() != 0)
+	if (m_registrationCount != 0)
 	{
 		/*
 		 * We have some registrations so queue a copy of the payload
@@ -89,6 +98,7 @@ StorageRegistry::process(const string& payload)
 			Item item = make_pair(now, data);
 			lock_guard<mutex> guard(m_qMutex);
 			m_queue.push(item);
+			m_queueMetrics.enqueue();
 			m_cv.notify_all();
 		}
 	}
@@ -103,7 +113,9 @@ StorageRegistry::process(const string& payload)
 void
 StorageRegistry::registerAsset(const string& asset, const string& url)
 {
-	m_registrations.push_back(pair<string *, string *>(new string(asset), new string(url)));
+	lock_guard<mutex> guard(m_registrationsMutex);
+	m_registrations.insert(make_pair(asset, url));
+	m_registrationCount = m_registrations.size();
 }
 
 /**
@@ -115,37 +127,38 @@ StorageRegistry::registerAsset(const string& asset, const string& url)
 void
 StorageRegistry::unregisterAsset(const string& asset, const string& url)
 {
-	for (auto it = m_registrations.begin(); it != m_registrations.end(); )
+	lock_guard<mutex> guard(m_registrationsMutex);
+	auto range = m_registrations.equal_range(asset);
+	for (auto it = range.first; it != range.second; )
 	{
-		if (asset.compare(*(it->first)) == 0 && url.compare(*(it->second)) == 0)
+		if (url.compare(it->second) == 0)
 		{
-			delete it->first;
-			delete it->second;
 			it = m_registrations.erase(it);
 		}
 		else
 		{
 			++it;
-        	}
+		}
 	}
+	m_registrationCount = m_registrations.size();
 }
 
 /**
  * The worker function that processes the queue of payloads
  * that may need to be sent to subscribers.
+ *
+ * All the payloads queued, up to REGISTRY_MAX_BATCH, are taken
+ * from the queue together and sent to each subscriber in a single
+ * notification.
  */
 void
 StorageRegistry::run()
 {
-	m_running = true;
 	while (m_running)
 	{
-		char *data = NULL;
-#if CHECK_QTIMES
-		time_t qTime;
-#endif
+		vector<Item> batch;
 		{
-			unique_lock<mutex> mlock(m_cvMutex);
+			unique_lock<mutex> mlock(m_qMutex);
 			while (m_queue.size() == 0)
 			{
 				m_cv.wait_for(mlock, std::chrono::seconds(REGISTRY_SLEEP_TIME));
@@ -154,166 +167,247 @@ StorageRegistry::run()
 					return;
 				}
 			}
-			Item item = m_queue.front();
-			m_queue.pop();
-			data = item.second;
-#if CHECK_QTIMES
-			qTime = item.first;
-#endif
-		}
-		if (data)
-		{
-#if CHECK_QTIMES
-			if (time(0) - qTime > QTIME_THRESHOLD)
+			while (m_queue.size() && batch.size() < REGISTRY_MAX_BATCH)
 			{
-				Logger::getLogger()->error("Data has been queued for %d seconds to be sent to registered party", (time(0) - qTime));
+				batch.push_back(m_queue.front());
+				m_queue.pop();
 			}
+			m_queueMetrics.dequeue(batch.size());
+		}
+#if CHECK_QTIMES
+		if (time(0) - batch[0].first > QTIME_THRESHOLD)
+		{
+			Logger::getLogger()->error("Data has been queued for %d seconds to be sent to registered party", (time(0) - batch[0].first));
+		}
 #endif
-			processPayload(data);
-			free(data);
+		processPayloads(batch);
+		for (auto& item : batch)
+		{
+			free(item.second);
 		}
 	}
 }
 
 /**
- * Process an incoming payload and distribute as required to registered
- * services
+ * A SAX handler that locates the readings within a reading append
+ * payload, and the asset code of each, without building a document
+ * for the payload. The readings are then copied to the notifications
+ * as they appear in the payload.
+ */
+class ReadingSpans : public BaseReaderHandler<UTF8<>, ReadingSpans> {
+	public:
+		typedef struct {
+			string	asset;
+			size_t	start;
+			size_t	end;
+		} Span;
+		ReadingSpans(StringStream& stream) : m_stream(stream), m_depth(0),
+			m_inReadings(false), m_isAsset(false), m_start(0), m_end(0) {};
+		bool	Key(const char *str, SizeType length, bool)
+			{
+				if (m_depth == 1)
+					m_key.assign(str, length);
+				m_isAsset = m_inReadings && m_depth == 3
+					&& length == 10 && strncmp(str, "asset_code", 10) == 0;
+				return true;
+			};
+		bool	String(const char *str, SizeType length, bool)
+			{
+				if (m_isAsset)
+					m_reading.asset.assign(str, length);
+				m_isAsset = false;
+				return true;
+			};
+		bool	StartObject()
+			{
+				if (m_inReadings && m_depth == 2)
+				{
+					m_reading.asset.clear();
+					m_reading.start = m_stream.Tell() - 1;
+				}
+				m_depth++;
+				return true;
+			};
+		bool	EndObject(SizeType)
+			{
+				m_depth--;
+				if (m_inReadings && m_depth == 2)
+				{
+					m_reading.end = m_stream.Tell();
+					m_readings.push_back(m_reading);
+				}
+				return true;
+			};
+		bool	StartArray()
+			{
+				if (m_depth == 1 && m_key.compare("readings") == 0)
+				{
+					m_inReadings = true;
+					m_start = m_stream.Tell();
+				}
+				m_depth++;
+				return true;
+			};
+		bool	EndArray(SizeType)
+			{
+				m_depth--;
+				if (m_inReadings && m_depth == 1)
+				{
+					m_inReadings = false;
+					m_end = m_stream.Tell() - 1;
+				}
+				return true;
+			};
+		bool	Default() { m_isAsset = false; return true; };
+	private:
+		StringStream&	m_stream;
+		string		m_key;
+		int		m_depth;
+		bool		m_inReadings;
+		bool		m_isAsset;
+		Span		m_reading;
+	public:
+		vector<Span>	m_readings;
+		size_t		m_start;
+		size_t		m_end;
+};
+
+/**
+ * Process a batch of incoming payloads and distribute as required to
+ * the registered services. Each payload is scanned once and split
+ * into a slice of readings per asset, the slices are then sent to
+ * the services registered for each asset. Each service is sent the
+ * readings it has registered for from all of the payloads in one
+ * notification.
  *
- * @param payload	The payload to potentially distribute
+ * @param batch	The payloads to potentially distribute
  */
 void
-StorageRegistry::processPayload(char *payload)
+StorageRegistry::processPayloads(const vector<Item>& batch)
 {
-bool allDone = true;
-
-	// First of all deal with those that registered for all assets
-	for (REGISTRY::const_iterator it = m_registrations.cbegin(); it != m_registrations.cend(); it++)
+	bool perAsset;
+	{
+		lock_guard<mutex> guard(m_registrationsMutex);
+		perAsset = m_registrations.size() > m_registrations.count("*");
+	}
+	string all;
+	unordered_map<string, string> slices;
+	for (auto& item : batch)
 	{
-		if (it->first->compare("*") == 0)
+		const char *payload = item.second;
+		StringStream stream(payload);
+		ReadingSpans spans(stream);
+		Reader reader;
+		if (reader.Parse(stream, spans).IsError() || spans.m_end == 0)
 		{
-			sendPayload(*(it->second), payload);
+			Logger::getLogger()->error("processPayload: Unable to find the readings in the payload");
+			continue;
 		}
-		else
+		if (spans.m_readings.empty())
+		{
+			continue;
+		}
+		if (!all.empty())
+			all.append(",");
+		all.append(payload + spans.m_start, spans.m_end - spans.m_start);
+		if (!perAsset)
+		{
+			continue;
+		}
+		for (auto& reading : spans.m_readings)
 		{
-			allDone = false;
+			string& slice = slices[reading.asset];
+			if (!slice.empty())
+				slice.append(",");
+			slice.append(payload + reading.start, reading.end - reading.start);
 		}
 	}
-	if (allDone)
+	if (all.empty())
 	{
-		// No registrations for individual assets, no need to parse payload
 		return;
 	}
-	for (REGISTRY::const_iterator it = m_registrations.cbegin(); it != m_registrations.cend(); it++)
+
+	map<string, string> notifications;
 	{
-		if (it->first->compare("*") != 0)
+		lock_guard<mutex> guard(m_registrationsMutex);
+		// First of all deal with those that registered for all assets
+		auto range = m_registrations.equal_range("*");
+		for (auto it = range.first; it != range.second; ++it)
 		{
-			try {
-				filterPayload(*(it->second), payload, *(it->first));
-			} catch (const exception& e) {
-				Logger::getLogger()->error("filterPayload: exception %s", e.what());
+			string& readings = notifications[it->second];
+			if (!readings.empty())
+				readings.append(",");
+			readings.append(all);
+		}
+		for (auto& slice : slices)
+		{
+			range = m_registrations.equal_range(slice.first);
+			for (auto it = range.first; it != range.second; ++it)
+			{
+				string& readings = notifications[it->second];
+				if (!readings.empty())
+					readings.append(",");
+				readings.append(slice.second);
 			}
 		}
 	}
+	for (auto& notification : notifications)
+	{
+		sendPayload(notification.first, notification.second);
+	}
 }
 
-
 /**
- * Send the copy of the payload to the given URL
+ * Return the HTTP client used to send notifications to a service. The
+ * clients are retained so that the connection to each service is
+ * reused by the notifications that follow.
  *
- * @param url		The URL to send the payload to
- * @param payload	The payload to send
+ * @param hostport	The host and port of the service
+ * @return HttpClient*	The client for the service
  */
-void
-StorageRegistry::sendPayload(const string& url, char *payload)
+HttpClient *
+StorageRegistry::getClient(const string& hostport)
 {
-	size_t found = url.find_first_of("://");
-	size_t found1 = url.find_first_of("/", found + 3);
-	string hostport = url.substr(found+3, found1 - found - 3);
-	string resource = url.substr(found1);
-
-	HttpClient client(hostport);
-	try {
-		client.request("POST", resource, payload);
-	} catch (const exception& e) {
-		Logger::getLogger()->error("sendPayload: exception %s sending reading data to interested party %s", e.what(), url.c_str());
+	auto it = m_clients.find(hostport);
+	if (it != m_clients.end())
+	{
+		return it->second;
 	}
+	HttpClient *client = new HttpClient(hostport);
+	m_clients[hostport] = client;
+	return client;
 }
 
 /**
- * Send a filtered copy of the payload to the given URL
+ * Send readings to the given URL
  *
- * @param url		The URL to send the payload to
- * @param payload	The payload to send
- * @param asset		The asset code to filter
+ * @param url		The URL to send the readings to
+ * @param readings	The comma separated JSON readings to send
  */
 void
-StorageRegistry::filterPayload(const string& url, char *payload, const string& asset)
+StorageRegistry::sendPayload(const string& url, const string& readings)
 {
-ostringstream convert;
-
 	size_t found = url.find_first_of("://");
 	size_t found1 = url.find_first_of("/", found + 3);
 	string hostport = url.substr(found+3, found1 - found - 3);
 	string resource = url.substr(found1);
 
-	// Filter the payload to include just the one asset
-	Document doc;
-	doc.Parse(payload);
-	if (doc.HasParseError())
-	{
-		Logger::getLogger()->error("filterPayload: Parse error in payload");
-		return;
-	}
-	if (!doc.HasMember("readings"))
-	{
-		Logger::getLogger()->error("filterPayload: payload has no readings object");
-		return;
-	}
-	const Value& readings = doc["readings"];
-	if (!readings.IsArray())
-	{
-		Logger::getLogger()->error("filterPayload: payload readings object is not an array");
-		return;
-	}
-	convert << "{ \"readings\" : [ ";
-	int count = 0;
-	/*
-	 * Loop over the readings and create a reading object for
-	 * each, check if it matches the asset name and incldue in the
-	 * new payload if it does. In eother case free that object
-	 * immediately to reduce the memory requirement.
-	 */
-	for (auto& reading : readings.GetArray())
+	string payload = "{ \"readings\" : [ " + readings + " ] }";
+	for (int attempt = 0; attempt < 2; attempt++)
 	{
-		if (reading.IsObject())
-		{
-			JSONReading *value = new JSONReading(reading);
-			if (value->getAssetName().compare(asset) == 0)
+		HttpClient *client = getClient(hostport);
+		try {
+			client->request("POST", resource, payload);
+			return;
+		} catch (const exception& e) {
+			// Discard the client, the service may have closed an idle
+			// connection, and retry once with a new connection
+			delete client;
+			m_clients.erase(hostport);
+			if (attempt)
 			{
-				if (count)
-					convert << ",";
-				count++;
-				convert << value->toJSON();
+				Logger::getLogger()->error("sendPayload: exception %s sending reading data to interested party %s", e.what(), url.c_str());
 			}
-			delete value;
 		}
 	}
-	
-	convert << "] }";
-
-	/*
-	 * Check if any assets inthe filtered payload
-	 */
-	if (count == 0)
-	{
-		// Nothing to send
-		return;
-	}
-
-	HttpClient client(hostport);
-	try {
-		client.request("POST", resource, convert.str());
-	} catch (const exception& e) {
-		Logger::getLogger()->error("filterPayload: exception %s sending reading data to interested party %s", e.what(), url.c_str());
-	}
 }
@@ -8,19 +8,135 @@
  * Author: Mark Riddoch
  */
 #include <storage_stats.h>
+#include <storage_plugin.h>
+#include <stream_handler.h>
 #include <string>
 #include <sstream>
 
 using namespace std;
 
+const unsigned long LatencyHistogram::bounds[LATENCY_BUCKETS - 1] = {
+	100, 250, 500, 1000, 2500, 5000, 10000, 25000, 50000,
+	100000, 250000, 500000, 1000000, 2500000, 5000000, 10000000
+};
+
+/**
+ * Construct an empty latency histogram
+ */
+LatencyHistogram::LatencyHistogram() : m_count(0), m_sum(0)
+{
+	for (int i = 0; i < LATENCY_BUCKETS; i++)
+	{
+		m_buckets[i] = 0;
+	}
+}
+
+/**
+ * Record the time taken by an operation
+ *
+ * @param usec	The time taken in microseconds
+ */
+void LatencyHistogram::record(unsigned long usec)
+{
+	int bucket = 0;
+	while (bucket < LATENCY_BUCKETS - 1 && usec > bounds[bucket])
+	{
+		bucket++;
+	}
+	m_buckets[bucket]++;
+	m_count++;
+	m_sum += usec;
+}
+
+/**
+ * Estimate a percentile of the recorded times
+ *
+ * @param p	The percentile as a fraction, e.g. 0.95
+ * @return	The estimated time in microseconds, 0 if nothing has been recorded
+ */
+unsigned long LatencyHistogram::percentile(double p) const
+{
+	unsigned long counts[LATENCY_BUCKETS];
+	unsigned long total = 0;
+	for (int i = 0; i < LATENCY_BUCKETS; i++)
+	{
+		counts[i] = m_buckets[i];
+		total += counts[i];
+	}
+	if (total == 0)
+	{
+		return 0;
+	}
+	double rank = p * total;
+	unsigned long below = 0;
+	for (int i = 0; i < LATENCY_BUCKETS - 1; i++)
+	{
+		if (counts[i] && below + counts[i] >= rank)
+		{
+			unsigned long lower = i ? bounds[i - 1] : 0;
+			return lower + (unsigned long)((bounds[i] - lower) * (rank - below) / counts[i]);
+		}
+		below += counts[i];
+	}
+	// In the unbounded bucket, report its lower bound
+	return bounds[LATENCY_BUCKETS - 2];
+}
+
 /**
  * Construct the statistics class for the storage service.
  */
 StorageStats::StorageStats() : commonInsert(0), commonSimpleQuery(0),
 				commonQuery(0), commonUpdate(0), commonDelete(0),
-				readingAppend(0), readingFetch(0),
-				readingQuery(0), readingPurge(0)
+				readingAppend(0), readingFetch(0), readingCacheHit(0),
+				readingQuery(0), readingPurge(0),
+				workerQueueDepth(0), workerMaxQueueDepth(0),
+				workerRejected(0), workerDispatched(0),
+				workerWaitTotal(0), workerMaxWait(0),
+				readingsAppended(0), streamBlocks(0), streamAcks(0), streamNacks(0),
+				m_plugin(NULL), m_streamHandler(NULL), m_lastReadings(0)
 {
+	const char *names[] = { "commonInsert", "commonSimpleQuery", "commonQuery",
+				"commonUpdate", "commonDelete", "readingQuery",
+				"readingExport", "readingLatest", "storageTableSimpleQuery",
+				"storageTableQuery" };
+	for (auto name : names)
+	{
+		endpoints[name];
+		operations[name];
+	}
+	operations["readingAppend"];
+	operations["readingFetch"];
+	operations["readingPurge"];
+	gettimeofday(&m_lastReport, NULL);
+}
+
+/**
+ * Return the number of connected reading streams
+ */
+unsigned int StorageStats::activeStreams() const
+{
+	return m_streamHandler ? m_streamHandler->activeStreams() : 0;
+}
+
+/**
+ * Count a request of the entry point as in flight
+ *
+ * @return bool	False if the entry point is at its limit and the request is refused
+ */
+bool EndpointGauge::enter()
+{
+	unsigned int inFlight = ++m_inFlight;
+	unsigned int limit = m_limit;
+	if (limit && inFlight > limit)
+	{
+		m_inFlight--;
+		m_rejected++;
+		return false;
+	}
+	unsigned int max = m_maxInFlight;
+	while (inFlight > max && !m_maxInFlight.compare_exchange_weak(max, inFlight))
+		;
+	return true;
 }
 
 /**
@@ -37,8 +153,158 @@ ostringstream convert;   // stream used for the conversion
 	convert << " \"commonDelete\" : " << commonDelete << ",";
 	convert << " \"readingAppend\" : " << readingAppend << ",";
 	convert << " \"readingFetch\" : " << readingFetch << ",";
+	convert << " \"readingCacheHit\" : " << readingCacheHit << ",";
 	convert << " \"readingQuery\" : " << readingQuery << ",";
-	convert << " \"readingPurge\" : " << readingPurge << " }";
+	convert << " \"readingPurge\" : " << readingPurge << ",";
+	convert << " \"workerQueueDepth\" : " << workerQueueDepth << ",";
+	convert << " \"workerMaxQueueDepth\" : " << workerMaxQueueDepth << ",";
+	convert << " \"workerRejected\" : " << workerRejected << ",";
+	convert << " \"workerAverageWait\" : "
+		<< (workerDispatched ? workerWaitTotal / workerDispatched : 0) << ",";
+	convert << " \"workerMaxWait\" : " << workerMaxWait << ",";
+	convert << " \"endpoints\" : {";
+	for (auto it = endpoints.cbegin(); it != endpoints.cend(); ++it)
+	{
+		if (it != endpoints.cbegin())
+			convert << ",";
+		convert << " \"" << it->first << "\" : { \"inFlight\" : " << it->second.getInFlight();
+		convert << ", \"maxInFlight\" : " << it->second.getMaxInFlight();
+		convert << ", \"limit\" : " << it->second.getLimit();
+		convert << ", \"rejected\" : " << it->second.getRejected() << " }";
+	}
+	convert << " },";
+	convert << " \"operations\" : {";
+	for (auto it = operations.cbegin(); it != operations.cend(); ++it)
+	{
+		const LatencyHistogram& latency = it->second.getLatency();
+		if (it != operations.cbegin())
+			convert << ",";
+		convert << " \"" << it->first << "\" : { \"count\" : " << latency.getCount();
+		convert << ", \"p50\" : " << latency.percentile(0.50);
+		convert << ", \"p95\" : " << latency.percentile(0.95);
+		convert << ", \"p99\" : " << latency.percentile(0.99);
+		convert << ", \"bytesIn\" : " << it->second.getBytesIn();
+		convert << ", \"bytesOut\" : " << it->second.getBytesOut() << " }";
+	}
+	convert << " },";
+
+	// The rate of readings appended since the previous report
+	double rate = 0.0;
+	{
+		lock_guard<mutex> guard(m_rateMutex);
+		struct timeval now;
+		gettimeofday(&now, NULL);
+		double elapsed = (now.tv_sec - m_lastReport.tv_sec)
+				+ (now.tv_usec - m_lastReport.tv_usec) / 1000000.0;
+		unsigned long readings = readingsAppended;
+		if (elapsed > 0.0)
+		{
+			rate = (readings - m_lastReadings) / elapsed;
+		}
+		m_lastReadings = readings;
+		m_lastReport = now;
+	}
+	convert << " \"readingsAppended\" : " << readingsAppended << ",";
+	convert << " \"readingsPerSecond\" : " << rate << ",";
+	convert << " \"streams\" : " << activeStreams() << ",";
+	convert << " \"streamBlocks\" : " << streamBlocks << ",";
+	convert << " \"streamAcks\" : " << streamAcks << ",";
+	convert << " \"streamNacks\" : " << streamNacks << ",";
+	size_t held = 0, retained = 0;
+	unsigned long released = 0;
+	if (m_streamHandler)
+		m_streamHandler->poolStatistics(held, retained, released);
+	convert << " \"streamPool\" : { \"held\" : " << held << ", \"retained\" : " << retained
+		<< ", \"released\" : " << released << " }";
+	string pluginStats;
+	if (m_plugin && m_plugin->statistics(pluginStats))
+	{
+		convert << ", \"plugin\" : " << pluginStats;
+	}
+	convert << " }";
 
 	json = convert.str();
 }
+
+/**
+ * Serialise the statistics in the Prometheus text exposition format
+ */
+void StorageStats::asPrometheus(string& text) const
+{
+ostringstream convert;
+
+	convert << "# HELP fledge_storage_request_duration_seconds Time taken to process requests\n";
+	convert << "# TYPE fledge_storage_request_duration_seconds histogram\n";
+	for (auto& op : operations)
+	{
+		const LatencyHistogram& latency = op.second.getLatency();
+		unsigned long cumulative = 0;
+		for (int i = 0; i < LATENCY_BUCKETS; i++)
+		{
+			cumulative += latency.getBucket(i);
+			convert << "fledge_storage_request_duration_seconds_bucket{operation=\""
+				<< op.first << "\",le=\"";
+			if (i < LATENCY_BUCKETS - 1)
+				convert << LatencyHistogram::bounds[i] / 1000000.0;
+			else
+				convert << "+Inf";
+			convert << "\"} " << cumulative << "\n";
+		}
+		convert << "fledge_storage_request_duration_seconds_sum{operation=\"" << op.first
+			<< "\"} " << latency.getSum() / 1000000.0 << "\n";
+		convert << "fledge_storage_request_duration_seconds_count{operation=\"" << op.first
+			<< "\"} " << latency.getCount() << "\n";
+	}
+	convert << "# HELP fledge_storage_request_bytes_total Bytes received and sent by requests\n";
+	convert << "# TYPE fledge_storage_request_bytes_total counter\n";
+	for (auto& op : operations)
+	{
+		convert << "fledge_storage_request_bytes_total{operation=\"" << op.first
+			<< "\",direction=\"in\"} " << op.second.getBytesIn() << "\n";
+		convert << "fledge_storage_request_bytes_total{operation=\"" << op.first
+			<< "\",direction=\"out\"} " << op.second.getBytesOut() << "\n";
+	}
+	convert << "# HELP fledge_storage_requests_in_flight Requests being processed\n";
+	convert << "# TYPE fledge_storage_requests_in_flight gauge\n";
+	for (auto& ep : endpoints)
+	{
+		convert << "fledge_storage_requests_in_flight{operation=\"" << ep.first
+			<< "\"} " << ep.second.getInFlight() << "\n";
+	}
+	convert << "# HELP fledge_storage_requests_rejected_total Requests refused by entry point limits\n";
+	convert << "# TYPE fledge_storage_requests_rejected_total counter\n";
+	for (auto& ep : endpoints)
+	{
+		convert << "fledge_storage_requests_rejected_total{operation=\"" << ep.first
+			<< "\"} " << ep.second.getRejected() << "\n";
+	}
+	convert << "# HELP fledge_storage_readings_appended_total Readings appended\n";
+	convert << "# TYPE fledge_storage_readings_appended_total counter\n";
+	convert << "fledge_storage_readings_appended_total " << readingsAppended << "\n";
+	convert << "# HELP fledge_storage_worker_queue_depth Readings requests waiting for a worker\n";
+	convert << "# TYPE fledge_storage_worker_queue_depth gauge\n";
+	convert << "fledge_storage_worker_queue_depth " << workerQueueDepth << "\n";
+	convert << "# HELP fledge_storage_streams Connected reading streams\n";
+	convert << "# TYPE fledge_storage_streams gauge\n";
+	convert << "fledge_storage_streams " << activeStreams() << "\n";
+	convert << "# HELP fledge_storage_stream_blocks_total Blocks of readings received on streams\n";
+	convert << "# TYPE fledge_storage_stream_blocks_total counter\n";
+	convert << "fledge_storage_stream_blocks_total " << streamBlocks << "\n";
+	convert << "# HELP fledge_storage_stream_acks_total Shared memory stream blocks acknowledged\n";
+	convert << "# TYPE fledge_storage_stream_acks_total counter\n";
+	convert << "fledge_storage_stream_acks_total{result=\"ack\"} " << streamAcks << "\n";
+	convert << "fledge_storage_stream_acks_total{result=\"nack\"} " << streamNacks << "\n";
+	size_t held = 0, retained = 0;
+	unsigned long released = 0;
+	if (m_streamHandler)
+		m_streamHandler->poolStatistics(held, retained, released);
+	convert << "# HELP fledge_storage_stream_pool_bytes Memory allocated by the stream block pools\n";
+	convert << "# TYPE fledge_storage_stream_pool_bytes gauge\n";
+	convert << "fledge_storage_stream_pool_bytes{state=\"held\"} " << held << "\n";
+	convert << "fledge_storage_stream_pool_bytes{state=\"retained\"} " << retained << "\n";
+	convert << "# HELP fledge_storage_stream_pool_released_bytes_total Memory the stream block pools returned to the system\n";
+	convert << "# TYPE fledge_storage_stream_pool_released_bytes_total counter\n";
+	convert << "fledge_storage_stream_pool_released_bytes_total " << released << "\n";
+
+	text = convert.str();
+}
@@ -0,0 +1,124 @@
+/*
+ * Fledge storage service.
+ *
+ * Copyright (c) 2026 Dianomic Systems
+ *
+ * Released under the Apache 2.0 Licence
+ *
+ * Author: agent
+ */
+#include <storage_worker_pool.h>
+#include <logger.h>
+#include <thread_config.h>
+
+using namespace std;
+using namespace std::chrono;
+
+/**
+ * Construct the worker pool and start the worker threads
+ *
+ * @param stats		The storage statistics to report queue usage in
+ * @param threads	The number of worker threads to create
+ * @param queueLength	The maximum number of requests that may wait in the queue
+ */
+StorageWorkerPool::StorageWorkerPool(StorageStats& stats, unsigned int threads,
+		unsigned int queueLength) : m_stats(stats), m_queueLength(queueLength),
+		m_shutdown(false)
+{
+	if (threads < 1)
+		threads = 1;
+	for (unsigned int i = 0; i < threads; i++)
+	{
+		m_threads.push_back(thread(&StorageWorkerPool::worker, this));
+		ThreadConfig::getInstance()->apply(m_threads.back(), "storage-worker");
+	}
+	Logger::getLogger()->info("Storage API: %d reading worker threads with a queue of %d requests",
+			threads, queueLength);
+}
+
+/**
+ * Destructor for the worker pool, stop and wait for
+ * the worker threads
+ */
+StorageWorkerPool::~StorageWorkerPool()
+{
+	stop();
+}
+
+/**
+ * Stop the worker threads. Requests that are already queued are
+ * executed before the threads exit.
+ */
+void StorageWorkerPool::stop()
+{
+	{
+		lock_guard<mutex> guard(m_mutex);
+		m_shutdown = true;
+	}
+	m_cv.notify_all();
+	for (auto& t : m_threads)
+	{
+		if (t.joinable())
+			t.join();
+	}
+	m_threads.clear();
+}
+
+/**
+ * Queue a request for execution by one of the worker threads
+ *
+ * @param work	The work to execute
+ * @return bool	False if the queue is full and the request was not queued
+ */
+bool StorageWorkerPool::submit(const function<void()>& work)
+{
+	{
+		lock_guard<mutex> guard(m_mutex);
+		if (m_shutdown || m_queue.size() >= m_queueLength)
+		{
+			m_stats.workerRejected++;
+			return false;
+		}
+		m_queue.push(WorkItem(work));
+		m_stats.workerQueueDepth = m_queue.size();
+		if (m_stats.workerQueueDepth > m_stats.workerMaxQueueDepth)
+			m_stats.workerMaxQueueDepth = m_stats.workerQueueDepth;
+	}
+	m_cv.notify_one();
+	return true;
+}
+
+/**
+ * The worker thread entry point. Take requests from the queue
+ * and execute them until the pool is stopped.
+ */
+void StorageWorkerPool::worker()
+{
+	while (true)
+	{
+		unique_lock<mutex> lck(m_mutex);
+		m_cv.wait(lck, [this]{ return m_shutdown || !m_queue.empty(); });
+		if (m_queue.empty())
+		{
+			// Shutdown and nothing left to do
+			return;
+		}
+		WorkItem item = m_queue.front();
+		m_queue.pop();
+		unsigned long wait = (unsigned long)duration_cast<microseconds>(
+				steady_clock::now() - item.m_queued).count();
+		m_stats.workerQueueDepth = m_queue.size();
+		m_stats.workerDispatched++;
+		m_stats.workerWaitTotal += wait;
+		if (wait > m_stats.workerMaxWait)
+			m_stats.workerMaxWait = wait;
+		lck.unlock();
+
+		try {
+			item.m_work();
+		} catch (exception& e) {
+			Logger::getLogger()->error("Storage API: Unhandled exception in worker thread: %s",
+					e.what());
+		}
+	}
+}
@@ -12,6 +12,9 @@
 #include <storage_api.h>
 #include <reading_stream.h>
 #include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/mman.h>
+#include <sys/eventfd.h>
 #include <netinet/in.h>
 #include <arpa/inet.h>
 #include <fcntl.h>
@@ -20,70 +23,143 @@
 #include <chrono>
 #include <unistd.h>
 #include <errno.h>
+#include <stddef.h>
+#include <atomic>
+#include <malloc.h>
+#include <zlib.h>
+#include <thread_config.h>
 
 
 using namespace std;
 
 /**
- * C wrapper for the handler thread we use to handle the polling of
+ * C wrapper for the handler threads we use to handle the polling of
  * the stream ingestion protocol.
  *
- * @param handler	The SgtreamHanler instance that started this thread
+ * @param handler	The StreamHandler instance that started this thread
+ * @param loop		The event loop the thread runs
  */
-static void threadWrapper(void *handler)
+void StreamHandler::threadWrapper(StreamHandler *handler, EventLoop *loop)
 {
-	((StreamHandler *)handler)->handler();
+	handler->handler(loop);
 }
 
 /**
  * Constructor for the StreamHandler class
+ *
+ * @param api		The storage API
+ * @param loops		The number of event loop threads to handle the streams
  */
-StreamHandler::StreamHandler(StorageApi *api) : m_api(api), m_running(true)
+StreamHandler::StreamHandler(StorageApi *api, unsigned int loops) : m_api(api),
+	m_nextLoop(0), m_running(true),
+	m_readingMetrics("storage.stream", "readings"),
+	m_ringMetrics("storage.sharedRing", "bytes")
 {
-	m_pollfd = epoll_create(1);
-	m_handlerThread = thread(threadWrapper, this);
+	if (loops == 0)
+	{
+		loops = 1;
+	}
+	for (unsigned int i = 0; i < loops; i++)
+	{
+		EventLoop *loop = new EventLoop;
+		loop->m_pollfd = epoll_create(1);
+		m_loops.push_back(loop);
+	}
+	for (auto loop : m_loops)
+	{
+		loop->m_thread = thread(threadWrapper, this, loop);
+		ThreadConfig::getInstance()->apply(loop->m_thread, "stream-handler");
+	}
 }
 
 
 /**
  * Destructor for the StreamHandler. Close down the epoll
- * system and wait for the handler thread to terminate.
+ * system and wait for the handler threads to terminate.
  */
 StreamHandler::~StreamHandler()
 {
 	m_running = false;
-	close(m_pollfd);
-	m_handlerThread.join();
+	for (auto loop : m_loops)
+	{
+		loop->m_streamsCV.notify_all();
+		close(loop->m_pollfd);
+		loop->m_thread.join();
+		delete loop;
+	}
 }
 
 /**
- * The handler method for the stream handler. This is run in its own thread
- * and is responsible for using epoll to gather events on the descriptors and
- * to dispatch them to the individual streams
+ * The handler method for an event loop of the stream handler. This is run in
+ * its own thread and is responsible for using epoll to gather events on the
+ * descriptors of the streams of the loop and to dispatch them to the
+ * individual streams
+ *
+ * @param loop		The event loop to run
  */
-void StreamHandler::handler()
+void StreamHandler::handler(EventLoop *loop)
 {
 	struct epoll_event events[MAX_EVENTS];
 	while (m_running)
 	{
-		std::unique_lock<std::mutex> lock(m_streamsMutex);
-		if (m_streams.size() == 0)
+		std::unique_lock<std::mutex> lock(loop->m_streamsMutex);
+		if (loop->m_streams.size() == 0)
 		{
-			Logger::getLogger()->debug("Waiting for first stream to be created");
-			m_streamsCV.wait_for(lock, chrono::milliseconds(500));
+			loop->m_streamsCV.wait_for(lock, chrono::milliseconds(500));
 		}
 		else
 		{
-			int nfds = epoll_wait(m_pollfd, events, MAX_EVENTS, 1);
+			int nfds = epoll_wait(loop->m_pollfd, events, MAX_EVENTS, 1);
 			for (int i = 0; i < nfds; i++)
 			{
 				Stream *stream = (Stream *)events[i].data.ptr;
-				stream->handleEvent(m_pollfd, m_api, events[i].events);
+				stream->handleEvent(loop->m_pollfd, m_api, events[i].events);
 			}
 		}
 	}
 }
 
+/**
+ * Return the event loop a new stream is assigned to, streams
+ * are assigned to the loops in turn
+ */
+StreamHandler::EventLoop *StreamHandler::nextLoop()
+{
+	return m_loops[m_nextLoop++ % m_loops.size()];
+}
+
+/**
+ * Return the number of streams that have a connected client
+ */
+unsigned int StreamHandler::activeStreams()
+{
+	unsigned int active = 0;
+	for (auto loop : m_loops)
+	{
+		std::unique_lock<std::mutex> lock(loop->m_streamsMutex);
+		for (auto stream : loop->m_streams)
+		{
+			if (stream->isConnected())
+				active++;
+		}
+	}
+	return active;
+}
+
+/**
+ * Return the memory usage of the block pools of the streams
+ *
+ * @param held		Set to the bytes allocated by the block pools
+ * @param retained	Set to the bytes free in the block pools
+ * @param released	Set to the bytes the block pools have returned to the system
+ */
+void StreamHandler::poolStatistics(size_t& held, size_t& retained, unsigned long& released) const
+{
+	held = m_poolStats.m_held;
+	retained = m_poolStats.m_retained;
+	released = m_poolStats.m_released;
+}
+
 /**
  * Create a new stream and add it to the epoll mechanism for the stream handler
  *
@@ -92,22 +168,62 @@ void StreamHandler::handler()
  */
 uint32_t StreamHandler::createStream(uint32_t *token)
 {
-	Stream *stream = new Stream();
-	uint32_t port = stream->create(m_pollfd, token);
+	EventLoop *loop = nextLoop();
+	Stream *stream = new Stream(&m_readingMetrics, &m_ringMetrics, &m_poolStats);
+	uint32_t port = stream->create(loop->m_pollfd, token);
 	{
-		std::unique_lock<std::mutex> lock(m_streamsMutex);
-		m_streams.push_back(stream);
+		std::unique_lock<std::mutex> lock(loop->m_streamsMutex);
+		loop->m_streams.push_back(stream);
 	}
 
-	m_streamsCV.notify_all();
+	loop->m_streamsCV.notify_all();
 
 	return port;
 }
 
+/**
+ * Create a new stream that uses the shared memory transport and add it
+ * to the epoll mechanism for the stream handler
+ *
+ * @param token		The single use connection token the client should send
+ * @return string	The name of the abstract socket the client should connect
+ *			to, or an empty string if the stream could not be created
+ */
+string StreamHandler::createSharedStream(uint32_t *token)
+{
+	EventLoop *loop = nextLoop();
+	Stream *stream = new Stream(&m_readingMetrics, &m_ringMetrics, &m_poolStats);
+	string name;
+	if (!stream->createShared(loop->m_pollfd, token, name))
+	{
+		delete stream;
+		return string();
+	}
+	{
+		std::unique_lock<std::mutex> lock(loop->m_streamsMutex);
+		loop->m_streams.push_back(stream);
+	}
+
+	loop->m_streamsCV.notify_all();
+
+	return name;
+}
+
 /**
  * Create a stream object to deal with the stream protocol
+ *
+ * @param readingMetrics	The metrics of the readings buffered by socket streams
+ * @param ringMetrics		The metrics of the bytes waiting in shared memory rings
+ * @param poolStats		The memory usage of the block pools of all streams
  */
-StreamHandler::Stream::Stream() : m_status(Closed)
+StreamHandler::Stream::Stream(QueueMetrics *readingMetrics, QueueMetrics *ringMetrics,
+		PoolStats *poolStats) :
+	m_status(Closed), m_socket(-1), m_blockPool(NULL),
+	m_shared(false), m_shmFd(-1), m_doorbell(-1), m_ackFd(-1), m_shm(NULL), m_ring(NULL),
+	m_readingMetrics(readingMetrics), m_ringMetrics(ringMetrics),
+	m_poolStats(poolStats), m_buffered(0), m_ringHead(0), m_ringTail(0),
+	m_acknowledge(false), m_ackBlock(0), m_blockFailed(false),
+	m_compressed(false), m_frameHdrBytes(0), m_frameBytes(0), m_plainOffset(0)
 {
 }
 
@@ -116,7 +232,22 @@ StreamHandler::Stream::Stream() : m_status(Closed)
  */
 StreamHandler::Stream::~Stream() 
 {
+	// Whatever the stream still holds leaves the queues with it
+	m_readingMetrics->dequeue(m_buffered);
+	m_ringMetrics->dequeue(m_ringHead - m_ringTail);
 	delete m_blockPool;
+	if (m_shm)
+	{
+		munmap(m_shm, sizeof(RDSShmHeader) + RDS_SHM_SIZE);
+	}
+	if (m_shmFd != -1)
+		close(m_shmFd);
+	if (m_doorbell != -1)
+		close(m_doorbell);
+	if (m_ackFd != -1)
+		close(m_ackFd);
+	if (m_shared && m_socket != -1)
+		close(m_socket);
 }
 
 /**
@@ -132,7 +263,7 @@ uint32_t StreamHandler::Stream::create(int epollfd, uint32_t *token)
 {
 struct sockaddr_in	address;
 
-	if ((m_blockPool = new MemoryPool(BLOCK_POOL_SIZES)) == NULL)
+	if ((m_blockPool = new MemoryPool(BLOCK_POOL_SIZES, BLOCK_POOL_RETAIN, m_poolStats)) == NULL)
 	{
 		Logger::getLogger()->error("Failed to create memory block pool");
 		return 0;
@@ -181,6 +312,95 @@ struct sockaddr_in	address;
 	return m_port;
 }
 
+/**
+ * Create a new shared memory stream. The ring is created in a memfd and a
+ * listener is created on an abstract Unix domain socket. The client will
+ * connect to the socket and send the token, the descriptors of the ring,
+ * the doorbell and the acknowledgement are then passed to it.
+ *
+ * @param epollfd	The epoll descriptor
+ * @param token		The single use token the client will send in the connect request
+ * @param name		Set to the name of the abstract socket
+ * @return bool		True if the stream was created
+ */
+bool StreamHandler::Stream::createShared(int epollfd, uint32_t *token, string& name)
+{
+static atomic<unsigned int>	streamNo(0);
+struct sockaddr_un		address;
+
+	m_shared = true;
+	size_t length = sizeof(RDSShmHeader) + RDS_SHM_SIZE;
+	if ((m_shmFd = memfd_create("fledge-stream", MFD_CLOEXEC)) == -1)
+	{
+		Logger::getLogger()->error("Failed to create shared memory for stream: %s", strerror(errno));
+		return false;
+	}
+	if (ftruncate(m_shmFd, (off_t)length) == -1)
+	{
+		Logger::getLogger()->error("Failed to size shared memory for stream: %s", strerror(errno));
+		return false;
+	}
+	void *mapping = mmap(NULL, length, PROT_READ | PROT_WRITE, MAP_SHARED, m_shmFd, 0);
+	if (mapping == MAP_FAILED)
+	{
+		Logger::getLogger()->error("Failed to map shared memory for stream: %s", strerror(errno));
+		return false;
+	}
+	m_shm = (RDSShmHeader *)mapping;
+	m_ring = (char *)mapping + sizeof(RDSShmHeader);
+	m_shm->magic = RDS_SHM_MAGIC;
+	m_shm->version = RDS_SHM_VERSION;
+	m_shm->size = RDS_SHM_SIZE;
+	m_shm->head = 0;
+	m_shm->tail = 0;
+	m_shm->ack.magic = RDS_ACK_MAGIC;
+	m_shm->ack.block = (uint32_t)-1;	// No block has been consumed
+
+	if ((m_doorbell = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC)) == -1
+			|| (m_ackFd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC)) == -1)
+	{
+		Logger::getLogger()->error("Failed to create stream events: %s", strerror(errno));
+		return false;
+	}
+
+	if ((m_socket = socket(AF_UNIX, SOCK_STREAM, 0)) < 0)
+	{
+		Logger::getLogger()->error("Failed to create socket: %s", strerror(errno));
+		return false;
+	}
+	name = "fledge-stream-" + to_string(getpid()) + "-" + to_string(streamNo++);
+	memset(&address, 0, sizeof(address));
+	address.sun_family = AF_UNIX;
+	memcpy(&address.sun_path[1], name.c_str(), name.length());	// Abstract namespace
+	socklen_t len = offsetof(struct sockaddr_un, sun_path) + 1 + name.length();
+	if (bind(m_socket, (struct sockaddr *)&address, len) < 0)
+	{
+		Logger::getLogger()->error("Failed to bind socket: %s", strerror(errno));
+		return false;
+	}
+	setNonBlocking(m_socket);
+	if (listen(m_socket, 1) < 0)
+	{
+		Logger::getLogger()->error("Failed to listen: %s", strerror(errno));
+		return false;
+	}
+	m_status = Listen;
+	Logger::getLogger()->info("Shared memory stream %s created", name.c_str());
+
+	srand((unsigned int)getpid() + streamNo + (unsigned int)time(0));
+	m_token = (uint32_t)random() & 0xffffffff;
+	*token = m_token;
+
+	m_event.data.ptr = this;
+	m_event.events = EPOLLIN | EPOLLRDHUP;
+	if (epoll_ctl(epollfd, EPOLL_CTL_ADD, m_socket, &m_event) < 0)
+	{
+		Logger::getLogger()->error("Failed to add stream socket to epoll fileset, %s", strerror(errno));
+		return false;
+	}
+	return true;
+}
+
 /**
  * Set the file descriptor to be non blocking
  *
@@ -198,7 +418,7 @@ void StreamHandler::Stream::setNonBlocking(int fd)
  * Handle an epoll event. The precise handling will depend
  * on the state of the stream.
  *
- * TODO Improve memory handling, use seperate threads for inserts, send acknowledgements
+ * TODO Improve memory handling, use seperate threads for inserts
  *
  * @param epollfd	The epoll file descriptor
  */
@@ -206,11 +426,17 @@ void StreamHandler::Stream::handleEvent(int epollfd, StorageApi *api, uint32_t e
 {
 ssize_t n;
 
+	if (m_shared)
+	{
+		handleSharedEvent(epollfd, api, events);
+		return;
+	}
 	if (events & EPOLLRDHUP)
 	{
 		// TODO mark this stream for destruction
 		epoll_ctl(epollfd, EPOLL_CTL_DEL, m_socket, &m_event);
 		close(m_socket);
+		m_status = Closed;
 		Logger::getLogger()->warn("Closing stream...");
 	}
 	if (events & EPOLLIN)
@@ -245,9 +471,13 @@ ssize_t n;
 			}
 			if ((n = read(m_socket, &hdr, sizeof(hdr))) != (int)sizeof(hdr))
 				Logger::getLogger()->warn("Token exchange: Short read of %d bytes: %s", n, strerror(errno));
-			if (hdr.magic == RDS_CONNECTION_MAGIC && hdr.token == m_token)
+			if ((hdr.magic == RDS_CONNECTION_MAGIC || hdr.magic == RDS_ACK_CONNECTION_MAGIC
+						|| hdr.magic == RDS_ZLIB_CONNECTION_MAGIC)
+					&& hdr.token == m_token)
 			{
 				m_status = Connected;
+				m_acknowledge = hdr.magic != RDS_CONNECTION_MAGIC;
+				m_compressed = hdr.magic == RDS_ZLIB_CONNECTION_MAGIC;
 				m_blockNo = 0;
 				m_readingNo = 0;
 				m_protocolState = BlkHdr;
@@ -267,12 +497,12 @@ ssize_t n;
 				if (m_protocolState == BlkHdr)
 				{
 					RDSBlockHeader blkHdr;
-					if (available(m_socket) < sizeof(blkHdr))
+					if (streamAvailable() < sizeof(blkHdr))
 					{
 						Logger::getLogger()->debug("Not enough bytes for block header");
 						return;
 					}
-					if ((n = read(m_socket, &blkHdr, sizeof(blkHdr))) != (int)sizeof(blkHdr))
+					if ((n = streamRead(&blkHdr, sizeof(blkHdr))) != (int)sizeof(blkHdr))
 					{
 						if (errno == EAGAIN)
 							return;
@@ -291,6 +521,8 @@ ssize_t n;
 					{
 					}
 					m_blockNo++;
+					m_ackBlock = blkHdr.blockNumber;
+					m_blockFailed = false;
 					m_blockSize = blkHdr.count;
 					m_protocolState = RdHdr;
 					m_readingNo = 0;
@@ -299,19 +531,19 @@ ssize_t n;
 				else if (m_protocolState == RdHdr)
 				{
 					RDSReadingHeader rdhdr;
-					if (available(m_socket) < sizeof(rdhdr))
+					if (streamAvailable() < sizeof(rdhdr))
 					{
 						Logger::getLogger()->debug("Not enough bytes for reading header");
 						return;
 					}
-					if (read(m_socket, &rdhdr, sizeof(rdhdr)) < (int)sizeof(rdhdr))
+					if (streamRead(&rdhdr, sizeof(rdhdr)) < (int)sizeof(rdhdr))
 					{
 						if (errno == EAGAIN)
 							return;
 						Logger::getLogger()->warn("Not enough bytes for reading header");
 						return;
 					}
-					if (rdhdr.magic != RDS_READING_MAGIC)
+					if (rdhdr.magic != RDS_READING_MAGIC && rdhdr.magic != RDS_BINARY_READING_MAGIC)
 					{
 						Logger::getLogger()->error("Expected reading header %d of %d in block %d, but incorrect header found 0x%x", m_readingNo, m_blockSize, m_blockNo, rdhdr.magic);
 						dump(10);
@@ -332,40 +564,47 @@ ssize_t n;
 						extra = m_lastAsset.length() + 1;
 						rdhdr.assetLength = extra;
 					}
-					extra  += 2 * sizeof(uint32_t);
+					extra  += offsetof(ReadingStream, userTs);
 					m_currentReading = (ReadingStream *)m_blockPool->allocate(m_readingSize + extra);
 					m_readings[m_readingNo % RDS_BLOCK] = m_currentReading;
 					m_currentReading->assetCodeLength = rdhdr.assetLength;
 					m_currentReading->payloadLength = rdhdr.payloadLength;
+					m_currentReading->payloadFormat = (rdhdr.magic == RDS_BINARY_READING_MAGIC)
+									? RDS_PAYLOAD_BINARY : RDS_PAYLOAD_JSON;
 					m_protocolState = RdBody;
 				}
 				else if (m_protocolState == RdBody)
 				{
-					if (available(m_socket) < m_readingSize)
+					if (streamAvailable() < m_readingSize)
 					{
 						Logger::getLogger()->debug("Not enough bytes for reading %d", m_readingSize);
 						return;
 					}
 					if (m_sameAsset)
 					{
-						if ((n = read(m_socket, &m_currentReading->userTs, sizeof(struct timeval))) != (int)sizeof(struct timeval))
+						if ((n = streamRead(&m_currentReading->userTs, sizeof(struct timeval))) != (int)sizeof(struct timeval))
 							Logger::getLogger()->warn("Short read of %d bytes for timestamp: %s", n, strerror(errno));
 						size_t plen = m_readingSize - sizeof(struct timeval);
 						uint32_t assetLen = m_currentReading->assetCodeLength;
-						if ((n = read(m_socket, &m_currentReading->assetCode[assetLen], plen)) < (int)plen)
+						if ((n = streamRead(&m_currentReading->assetCode[assetLen], plen)) < (int)plen)
 							Logger::getLogger()->warn("Short read of %d bytes for payload: %s", n, strerror(errno));
 						memcpy(&m_currentReading->assetCode[0], m_lastAsset.c_str(), assetLen);
 					}
 					else
 					{
-						if ((n = read(m_socket, &m_currentReading->userTs, m_readingSize)) != (int)m_readingSize)
+						if ((n = streamRead(&m_currentReading->userTs, m_readingSize)) != (int)m_readingSize)
 							Logger::getLogger()->warn("Short read of %d bytes for reading: %s", n, strerror(errno));
 						m_lastAsset = m_currentReading->assetCode;
 					}
 					m_readingNo++;
+					m_buffered++;
+					m_readingMetrics->enqueue();
 					if ((m_readingNo % RDS_BLOCK) == 0)
 					{
-						queueInsert(api, RDS_BLOCK, false);
+						if (!queueInsert(api, RDS_BLOCK, false))
+							m_blockFailed = true;
+						m_readingMetrics->dequeue(m_buffered);
+						m_buffered = 0;
 						for (int i = 0; i < RDS_BLOCK; i++)
 							m_blockPool->release(m_readings[i]);
 					}
@@ -373,12 +612,25 @@ ssize_t n;
 					{
 						// We have completed the block, insert readings and wait
 						// for a block header
-						queueInsert(api, m_readingNo % RDS_BLOCK, true);
+						if (!queueInsert(api, m_readingNo % RDS_BLOCK, true))
+							m_blockFailed = true;
+						m_readingMetrics->dequeue(m_buffered);
+						m_buffered = 0;
 						for (uint32_t i = 0; i < m_readingNo % RDS_BLOCK; i++)
 							m_blockPool->release(m_readings[i]);
 					}
 					if (m_readingNo >= m_blockSize)
 					{
+						api->getStats().streamBlocks++;
+						if (m_blockPool->underPressure())
+						{
+							// Give the free blocks back whilst waiting for the next block
+							m_blockPool->trim();
+						}
+						if (m_acknowledge)
+						{
+							acknowledge(m_ackBlock, !m_blockFailed);
+						}
 						m_protocolState = BlkHdr;
 					}
 					else
@@ -391,17 +643,322 @@ ssize_t n;
 	}
 }
 
+/**
+ * Handle an epoll event on a shared memory stream. The socket and the
+ * doorbell share the stream as their epoll data, the doorbell never
+ * reports a hang up and, once connected, the client sends nothing more
+ * on the socket.
+ *
+ * @param epollfd	The epoll file descriptor
+ * @param api		The storage API
+ * @param events	The epoll events
+ */
+void StreamHandler::Stream::handleSharedEvent(int epollfd, StorageApi *api, uint32_t events)
+{
+	if (events & (EPOLLRDHUP | EPOLLHUP | EPOLLERR))
+	{
+		Logger::getLogger()->warn("Closing shared memory stream...");
+		closeShared(epollfd);
+		return;
+	}
+	if ((events & EPOLLIN) == 0)
+	{
+		return;
+	}
+	if (m_status == Listen)
+	{
+		int conn_sock;
+		if ((conn_sock = accept(m_socket, NULL, NULL)) == -1)
+		{
+			Logger::getLogger()->info("Accept failed for shared memory stream: %s", strerror(errno));
+			return;
+		}
+		epoll_ctl(epollfd, EPOLL_CTL_DEL, m_socket, &m_event);
+		close(m_socket);
+		m_socket = conn_sock;
+		m_status = AwaitingToken;
+		setNonBlocking(m_socket);
+		m_event.events = EPOLLIN | EPOLLRDHUP;
+		m_event.data.ptr = this;
+		epoll_ctl(epollfd, EPOLL_CTL_ADD, m_socket, &m_event);
+	}
+	else if (m_status == AwaitingToken)
+	{
+		RDSConnectHeader	hdr;
+		if (available(m_socket) < sizeof(hdr))
+		{
+			return;
+		}
+		if (read(m_socket, &hdr, sizeof(hdr)) != (int)sizeof(hdr)
+				|| hdr.magic != RDS_CONNECTION_MAGIC || hdr.token != m_token)
+		{
+			Logger::getLogger()->warn("Incorrect token for shared memory stream");
+			closeShared(epollfd);
+			return;
+		}
+		if (!sendDescriptors())
+		{
+			closeShared(epollfd);
+			return;
+		}
+		m_status = Connected;
+		m_blockNo = 0;
+		m_doorbellEvent.data.ptr = this;
+		m_doorbellEvent.events = EPOLLIN;
+		epoll_ctl(epollfd, EPOLL_CTL_ADD, m_doorbell, &m_doorbellEvent);
+		Logger::getLogger()->info("Shared memory stream connected");
+	}
+	else if (m_status == Connected)
+	{
+		char discard[64];
+		while (available(m_socket) > 0 && read(m_socket, discard, sizeof(discard)) > 0)
+			;
+		consumeShared(api);
+	}
+}
+
+/**
+ * Pass the descriptors of the ring, the doorbell and the acknowledgement
+ * to the client over the connected socket
+ *
+ * @return bool		True if the descriptors were sent
+ */
+bool StreamHandler::Stream::sendDescriptors()
+{
+	int fds[3] = { m_shmFd, m_doorbell, m_ackFd };
+	char control[CMSG_SPACE(sizeof(fds))];
+	uint32_t magic = RDS_SHM_MAGIC;
+	struct iovec iov;
+	struct msghdr msg;
+
+	iov.iov_base = &magic;
+	iov.iov_len = sizeof(magic);
+	memset(&msg, 0, sizeof(msg));
+	memset(control, 0, sizeof(control));
+	msg.msg_iov = &iov;
+	msg.msg_iovlen = 1;
+	msg.msg_control = control;
+	msg.msg_controllen = sizeof(control);
+	struct cmsghdr *cmsg = CMSG_FIRSTHDR(&msg);
+	cmsg->cmsg_level = SOL_SOCKET;
+	cmsg->cmsg_type = SCM_RIGHTS;
+	cmsg->cmsg_len = CMSG_LEN(sizeof(fds));
+	memcpy(CMSG_DATA(cmsg), fds, sizeof(fds));
+	if (sendmsg(m_socket, &msg, MSG_NOSIGNAL) != (ssize_t)sizeof(magic))
+	{
+		Logger::getLogger()->error("Failed to pass shared memory stream to the client: %s", strerror(errno));
+		return false;
+	}
+	return true;
+}
+
+/**
+ * Consume the blocks the client has added to the ring. The readings are
+ * passed to the storage plugin in place, the space is returned to the
+ * client and the block acknowledged once the plugin has stored them. A
+ * block the plugin fails to store is rejected and the stream stops.
+ *
+ * @param api		The storage API
+ */
+void StreamHandler::Stream::consumeShared(StorageApi *api)
+{
+	uint64_t rung;
+	if (read(m_doorbell, &rung, sizeof(rung)) != sizeof(rung) && errno != EAGAIN)
+	{
+		Logger::getLogger()->warn("Failed to read shared memory stream doorbell: %s", strerror(errno));
+	}
+	if (m_blockFailed)
+	{
+		// The client sends the readings of a rejected block, and those
+		// that follow it, by other means and closes the stream
+		return;
+	}
+	const uint64_t size = RDS_SHM_SIZE;
+	uint64_t head = __atomic_load_n(&m_shm->head, __ATOMIC_ACQUIRE);
+	uint64_t tail = m_shm->tail;
+	m_ringMetrics->enqueue(head - m_ringHead);
+	m_ringHead = head;
+	while (tail != head)
+	{
+		uint64_t offset = tail % size;
+		uint64_t remaining = size - offset;
+		if (remaining < sizeof(RDSShmBlockHeader)
+				|| *(uint32_t *)&m_ring[offset] == RDS_SHM_WRAP_MAGIC)
+		{
+			tail += remaining;
+			continue;
+		}
+		RDSShmBlockHeader *hdr = (RDSShmBlockHeader *)&m_ring[offset];
+		uint32_t state = RDS_SHM_BLOCK_READY;
+		if (!__atomic_compare_exchange_n(&hdr->state, &state, RDS_SHM_BLOCK_CLAIMED,
+					false, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)
+				&& state == RDS_SHM_BLOCK_WITHDRAWN)
+		{
+			// The client gave up waiting and sends the readings by other means
+			Logger::getLogger()->warn("Block %u of the shared memory stream was withdrawn by the client",
+					hdr->block.blockNumber);
+			m_blockFailed = true;
+			return;
+		}
+		uint32_t blockNumber = hdr->block.blockNumber;
+		uint64_t length = hdr->length;
+		uint32_t count = hdr->block.count;
+		bool valid = state == RDS_SHM_BLOCK_READY && hdr->block.magic == RDS_BLOCK_MAGIC
+				&& length <= remaining - sizeof(RDSShmBlockHeader)
+				&& length <= head - tail - sizeof(RDSShmBlockHeader);
+
+		// Check the whole block before any of it is passed to the plugin
+		char *start = (char *)(hdr + 1);
+		char *end = start + length;
+		char *p = start;
+		for (uint32_t i = 0; valid && i < count; i++)
+		{
+			ReadingStream *rs = (ReadingStream *)p;
+			if ((size_t)(end - p) < offsetof(ReadingStream, assetCode))
+			{
+				valid = false;
+				break;
+			}
+			size_t recLen = RDS_SHM_ALIGN(offsetof(ReadingStream, assetCode)
+					+ (size_t)rs->assetCodeLength + rs->payloadLength);
+			valid = rs->assetCodeLength > 0 && recLen <= (size_t)(end - p)
+				&& rs->assetCode[rs->assetCodeLength - 1] == 0
+				&& (rs->payloadFormat == RDS_PAYLOAD_BINARY
+					|| rs->payloadFormat == RDS_PAYLOAD_JSON);
+			p += recLen;
+		}
+		if (!valid)
+		{
+			Logger::getLogger()->error("Malformed block %d on shared memory stream", blockNumber);
+			m_blockFailed = true;
+			acknowledgeShared(api, blockNumber, false);
+			return;
+		}
+
+		bool stored = true;
+		unsigned int n = 0;
+		p = start;
+		for (uint32_t i = 0; stored && i < count; i++)
+		{
+			ReadingStream *rs = (ReadingStream *)p;
+			m_readings[n++] = rs;
+			p += RDS_SHM_ALIGN(offsetof(ReadingStream, assetCode)
+					+ (size_t)rs->assetCodeLength + rs->payloadLength);
+			bool last = (i + 1 == count);
+			if (n == RDS_BLOCK || last)
+			{
+				stored = queueInsert(api, n, last);
+				n = 0;
+			}
+		}
+		if (!stored)
+		{
+			// The tail is left at the block so the client knows
+			// which readings have not been stored
+			Logger::getLogger()->error("Failed to store block %u of the shared memory stream", blockNumber);
+			m_blockFailed = true;
+			acknowledgeShared(api, blockNumber, false);
+			return;
+		}
+
+		tail += sizeof(RDSShmBlockHeader) + length;
+		__atomic_store_n(&m_shm->tail, tail, __ATOMIC_RELEASE);
+		m_ringMetrics->dequeue(tail - m_ringTail);
+		m_ringTail = tail;
+		api->getStats().streamBlocks++;
+		acknowledgeShared(api, blockNumber, true);
+		m_blockNo++;
+		head = __atomic_load_n(&m_shm->head, __ATOMIC_ACQUIRE);
+		m_ringMetrics->enqueue(head - m_ringHead);
+		m_ringHead = head;
+	}
+}
+
+/**
+ * Acknowledge a block of a shared memory stream to the client
+ *
+ * @param api		The storage API
+ * @param block		The block number written by the client
+ * @param stored	The readings of the block have been stored
+ */
+void StreamHandler::Stream::acknowledgeShared(StorageApi *api, uint32_t block, bool stored)
+{
+	if (stored)
+		api->getStats().streamAcks++;
+	else
+		api->getStats().streamNacks++;
+	m_shm->ack.magic = stored ? RDS_ACK_MAGIC : RDS_NACK_MAGIC;
+	__atomic_store_n(&m_shm->ack.block, block, __ATOMIC_RELEASE);
+	uint64_t one = 1;
+	if (write(m_ackFd, &one, sizeof(one)) != sizeof(one))
+		Logger::getLogger()->warn("Failed to acknowledge block: %s", strerror(errno));
+}
+
+/**
+ * Close a shared memory stream, remove its descriptors from the epoll
+ * set and release the ring
+ *
+ * @param epollfd	The epoll file descriptor
+ */
+void StreamHandler::Stream::closeShared(int epollfd)
+{
+	if (m_socket != -1)
+	{
+		epoll_ctl(epollfd, EPOLL_CTL_DEL, m_socket, &m_event);
+		close(m_socket);
+		m_socket = -1;
+	}
+	if (m_status == Connected)
+	{
+		epoll_ctl(epollfd, EPOLL_CTL_DEL, m_doorbell, &m_doorbellEvent);
+	}
+	if (m_shm)
+	{
+		munmap(m_shm, sizeof(RDSShmHeader) + RDS_SHM_SIZE);
+		m_shm = NULL;
+		m_ring = NULL;
+	}
+	close(m_shmFd);
+	close(m_doorbell);
+	close(m_ackFd);
+	m_shmFd = m_doorbell = m_ackFd = -1;
+	m_status = Closed;
+}
+
 /**
  * Queue a block of readings to be inserted into the database. The readings
  * are available via the m_readings array.
  *
+ * The memory pool blocks that hold the readings are not released until
+ * this call returns, the storage plugin relies on this to bind the reading
+ * data in place.
+ *
  * @param nReadings	The number of readings to insert
  * @param commit	Perform commit at end of this block
+ * @return bool		True if the readings were stored
  */
-void StreamHandler::Stream::queueInsert(StorageApi *api, unsigned int nReadings, bool commit)
+bool StreamHandler::Stream::queueInsert(StorageApi *api, unsigned int nReadings, bool commit)
 {
 	m_readings[nReadings] = NULL;
-	api->readingStream(m_readings, commit);
+	return api->readingStream(m_readings, commit);
+}
+
+/**
+ * Acknowledge a block of a socket stream to the client
+ *
+ * @param block		The block number sent by the client
+ * @param stored	The readings of the block have been stored
+ */
+void StreamHandler::Stream::acknowledge(uint32_t block, bool stored)
+{
+	RDSAcknowledge ack;
+	ack.magic = stored ? RDS_ACK_MAGIC : RDS_NACK_MAGIC;
+	ack.block = block;
+	if (write(m_socket, &ack, sizeof(ack)) != sizeof(ack))
+	{
+		Logger::getLogger()->warn("Failed to acknowledge block %u of the stream: %s",
+				block, strerror(errno));
+	}
 }
 
 /**
@@ -422,22 +979,162 @@ unsigned int	avail;
 	return avail;
 }
 
+/**
+ * Return the number of bytes of the stream that can be read without
+ * blocking. For a compressed stream this is what remains of the
+ * current inflated block, the next block is read and inflated once
+ * the current one has been parsed.
+ */
+size_t StreamHandler::Stream::streamAvailable()
+{
+	if (!m_compressed)
+	{
+		return available(m_socket);
+	}
+	if (m_plainOffset == m_plain.length())
+	{
+		m_plain.clear();
+		m_plainOffset = 0;
+		readFrame();
+	}
+	return m_plain.length() - m_plainOffset;
+}
+
+/**
+ * Read bytes from the stream, from the socket or, for a compressed
+ * stream, from the current inflated block
+ *
+ * @param buffer	The buffer to read into
+ * @param length	The number of bytes to read
+ * @return ssize_t	The number of bytes read
+ */
+ssize_t StreamHandler::Stream::streamRead(void *buffer, size_t length)
+{
+	if (!m_compressed)
+	{
+		return read(m_socket, buffer, length);
+	}
+	size_t n = min(length, m_plain.length() - m_plainOffset);
+	memcpy(buffer, m_plain.data() + m_plainOffset, n);
+	m_plainOffset += n;
+	return (ssize_t)n;
+}
+
+/**
+ * Read what is available of the next compressed frame from the socket.
+ * Dictionaries are kept as they arrive and a complete block is inflated.
+ * A malformed frame closes the stream.
+ *
+ * @return bool		True if a block has been inflated
+ */
+bool StreamHandler::Stream::readFrame()
+{
+	while (m_status == Connected)
+	{
+		ssize_t n;
+		if (m_frameHdrBytes < sizeof(m_frameHdr))
+		{
+			n = read(m_socket, (char *)&m_frameHdr + m_frameHdrBytes, sizeof(m_frameHdr) - m_frameHdrBytes);
+			if (n <= 0)
+				return false;
+			m_frameHdrBytes += (size_t)n;
+			if (m_frameHdrBytes < sizeof(m_frameHdr))
+				return false;
+			if ((m_frameHdr.magic != RDS_ZLIB_BLOCK_MAGIC && m_frameHdr.magic != RDS_ZLIB_DICT_MAGIC)
+				|| (m_frameHdr.magic == RDS_ZLIB_DICT_MAGIC && m_frameHdr.length > RDS_ZLIB_MAX_DICT)
+				|| (m_frameHdr.magic == RDS_ZLIB_BLOCK_MAGIC
+					&& (m_frameHdr.rawLength < sizeof(RDSBlockHeader)
+						|| m_frameHdr.rawLength > RDS_ZLIB_MAX_BLOCK
+						|| m_frameHdr.length > RDS_ZLIB_MAX_BLOCK)))
+			{
+				Logger::getLogger()->error("Expected compressed frame after block %d, but incorrect header found 0x%x",
+						m_blockNo, m_frameHdr.magic);
+				close(m_socket);
+				m_status = Closed;
+				return false;
+			}
+			m_frame.resize(m_frameHdr.length);
+			m_frameBytes = 0;
+		}
+		if (m_frameBytes < m_frame.length())
+		{
+			n = read(m_socket, &m_frame[m_frameBytes], m_frame.length() - m_frameBytes);
+			if (n <= 0)
+				return false;
+			m_frameBytes += (size_t)n;
+			if (m_frameBytes < m_frame.length())
+				return false;
+		}
+		m_frameHdrBytes = 0;
+		if (m_frameHdr.magic == RDS_ZLIB_BLOCK_MAGIC)
+		{
+			return inflateBlock();
+		}
+		m_dictionary = m_frame;
+		if (adler32(adler32(0L, Z_NULL, 0), (const Bytef *)m_dictionary.data(), m_dictionary.length())
+				!= m_frameHdr.rawLength)
+		{
+			Logger::getLogger()->warn("Checksum of the stream compression dictionary does not match");
+		}
+		Logger::getLogger()->debug("Stream compression dictionary of %d bytes received", m_dictionary.length());
+	}
+	return false;
+}
+
+/**
+ * Inflate the compressed block that has been read, ready to be parsed.
+ * A block that can not be inflated closes the stream.
+ *
+ * @return bool		True if the block was inflated
+ */
+bool StreamHandler::Stream::inflateBlock()
+{
+	z_stream strm;
+	memset(&strm, 0, sizeof(strm));
+	if (inflateInit(&strm) != Z_OK)
+	{
+		Logger::getLogger()->error("Unable to initialise the inflation of a stream block");
+		close(m_socket);
+		m_status = Closed;
+		return false;
+	}
+	m_plain.resize(m_frameHdr.rawLength);
+	strm.next_in = (Bytef *)&m_frame[0];
+	strm.avail_in = m_frame.length();
+	strm.next_out = (Bytef *)&m_plain[0];
+	strm.avail_out = m_plain.length();
+	int rval = inflate(&strm, Z_FINISH);
+	if (rval == Z_NEED_DICT)
+	{
+		if (inflateSetDictionary(&strm, (const Bytef *)m_dictionary.data(), m_dictionary.length()) == Z_OK)
+			rval = inflate(&strm, Z_FINISH);
+	}
+	size_t inflated = strm.total_out;
+	const char *reason = strm.msg ? strm.msg : zError(rval);
+	inflateEnd(&strm);
+	if (rval != Z_STREAM_END || inflated != m_plain.length())
+	{
+		Logger::getLogger()->error("Unable to inflate compressed stream block %d: %s", m_blockNo, reason);
+		m_plain.clear();
+		close(m_socket);
+		m_status = Closed;
+		return false;
+	}
+	m_plainOffset = 0;
+	return true;
+}
+
 /**
  * Block memory pool destructor. Return any memory from the memory pools
  * to the system.
  */
 StreamHandler::Stream::MemoryPool::~MemoryPool()
 {
+	trim();
 	for (auto it = m_pool.begin(); it != m_pool.end(); it++)
-        {
-                while (! it->second->empty())
-                {
-			void *mem = it->second->back();
-			it->second->pop_back();
-                        free(&((size_t *)mem)[-1]);
-                }
+	{
 		delete it->second;
-        }
+	}
 }
 
 /**
@@ -451,24 +1148,25 @@ void *StreamHandler::Stream::MemoryPool::allocate(size_t size)
 	auto blkpool = m_pool.find(size);
 	if (blkpool == m_pool.end())
 	{
-		Logger::getLogger()->info("No block pool for %d bytes, creating", size);
-		// Create a new memory pool
-		createPool(size);
-		blkpool = m_pool.find(size);
+		Logger::getLogger()->debug("No block pool for %d bytes, creating", size);
+		blkpool = m_pool.insert(pair<size_t, vector<void *>* >(size, new vector<void *>)).first;
 	}
 	if (blkpool->second->empty())
 	{
-		Logger::getLogger()->warn("Extending block pool for %d bytes", size);
 		growPool(blkpool->second, size);
 	}
 	void *memory = blkpool->second->back();
 	blkpool->second->pop_back();
+	m_retained -= size;
+	m_stats->m_retained -= size;
 
 	return memory;
 }
 
 /**
- * Release memory back to the memory pool
+ * Release memory back to the memory pool. If the pool already keeps
+ * as much free memory as it may, or all the pools together do, the
+ * memory is returned to the system.
  *
  * @param memory	The memory to release
  */
@@ -481,29 +1179,46 @@ void StreamHandler::Stream::MemoryPool::release(void *memory)
 		Logger::getLogger()->fatal("Returning memory to a block pool (%d) that does not exist", poolSize);
 		throw runtime_error("Invalid block pool");
 	}
+	if (m_retained + poolSize > m_retain || underPressure())
+	{
+		freeBlock(memory, poolSize);
+		return;
+	}
 	blkpool->second->push_back(memory);
+	m_retained += poolSize;
+	m_stats->m_retained += poolSize;
 }
 
 /**
- * Allocate a new memory block pool
- *
- * @param size	Size of the memory blocks in the pool
+ * Return all the free blocks of the pool to the system
  */
-void StreamHandler::Stream::MemoryPool::createPool(size_t size)
+void StreamHandler::Stream::MemoryPool::trim()
 {
-	size_t realSize = size + sizeof(size_t);
-	vector<void *> *blocks = new vector<void *>;
-	for (int i = 0; i < RDS_BLOCK; i++)
+	size_t released = m_retained;
+	for (auto it = m_pool.begin(); it != m_pool.end(); it++)
 	{
-		size_t *mem = (size_t *)malloc(realSize);
-		blocks->push_back(&mem[1]);
-		mem[0] = size;
+		while (! it->second->empty())
+		{
+			void *mem = it->second->back();
+			it->second->pop_back();
+			m_retained -= it->first;
+			m_stats->m_retained -= it->first;
+			freeBlock(mem, it->first);
+		}
+		it->second->shrink_to_fit();
+	}
+	if (released)
+	{
+		// Blocks below the mmap threshold are only handed back by trimming the heap
+		malloc_trim(0);
+		Logger::getLogger()->debug("Released %lu bytes from a stream block pool", released);
 	}
-	m_pool.insert(pair<int, vector<void *>* >(size, blocks));
 }
 
 /**
- * Grow the memory pool for this size block
+ * Grow the memory pool for this size block. The pool grows by as
+ * many blocks as it may keep free, so large blocks are allocated a
+ * few at a time.
  *
  * @param pool		The memory pool
  * @param size		The size of the blocks in the memory pool
@@ -511,14 +1226,44 @@ void StreamHandler::Stream::MemoryPool::createPool(size_t size)
 void StreamHandler::Stream::MemoryPool::growPool(vector<void *> *pool, size_t size)
 {
 	size_t realSize = size + sizeof(size_t);
-	for (int i = 0; i < RDS_BLOCK; i++)
+	size_t count = (m_retain - min(m_retained, m_retain)) / size;
+	if (count > RDS_BLOCK)
+		count = RDS_BLOCK;
+	else if (count == 0)
+		count = 1;
+	for (size_t i = 0; i < count; i++)
 	{
 		size_t *mem = (size_t *)malloc(realSize);
-		pool->push_back(&mem[1]);
+		if (mem == NULL)
+		{
+			if (i == 0)
+			{
+				Logger::getLogger()->fatal("Unable to allocate a %d byte stream block", size);
+				throw bad_alloc();
+			}
+			break;
+		}
 		mem[0] = size;
+		pool->push_back(&mem[1]);
+		m_retained += size;
+		m_stats->m_retained += size;
+		m_stats->m_held += size;
 	}
 }
 
+/**
+ * Return a block to the system
+ *
+ * @param memory	The block to free
+ * @param size		The size of the block
+ */
+void StreamHandler::Stream::MemoryPool::freeBlock(void *memory, size_t size)
+{
+	free(&((size_t *)memory)[-1]);
+	m_stats->m_held -= size;
+	m_stats->m_released += size;
+}
+
 /**
  * Diagnostic routine to display stream content.
  *
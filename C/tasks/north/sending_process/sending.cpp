@@ -11,7 +11,6 @@
 #include <sending.h>
 #include <csignal>
 #include <sys/prctl.h>
-#include <filter_plugin.h>
 #include <map>
 
 #define VERBOSE_LOG	0
@@ -56,9 +55,6 @@ const map<string, std::tuple<string, string, string>>  data_source_to_informatio
 	{DATA_SOURCE_AUDIT,      std::make_tuple("audit",      "Audit Sent",      "Audit Sent North")}
 };
 
-// static pointer to data buffers for filter plugins
-std::vector<ReadingSet*>* SendingProcess::m_buffer_ptr = 0;
-
 // Used to identifies logs
 const string LOG_SERVICE_NAME = "SendingProcess/sending";
 
@@ -136,8 +132,8 @@ static void signalHandler(int signal)
 // Destructor
 SendingProcess::~SendingProcess()
 {
-	delete m_thread_load;
 	delete m_thread_send;
+	delete m_dataLoad;
 	delete m_plugin;
 }
 
@@ -166,6 +162,8 @@ SendingProcess::SendingProcess(int argc, char** argv) : FledgeProcess(argc, argv
 
 	// NorthPlugin
 	m_plugin = NULL;
+	m_dataLoad = NULL;
+	m_thread_send = NULL;
 
 	// Set vars & counters to 0, false
 	m_last_sent_id  = 0;
@@ -179,20 +177,15 @@ SendingProcess::SendingProcess(int argc, char** argv) : FledgeProcess(argc, argv
 	 * Create or update configuration via Fledge API
 	 */
 
-	// Reads the sending process configuration
-	ConfigCategory processDefault = this->fetchConfiguration(sendingDefaultConfig,
-								 PLUGIN_UNDEFINED);
-
-
-	// The allocation should be done after fetchConfiguration
-	// as the value for m_memory_buffer_size is retrieved from the configuration
-	//
-	// Set buffer of ReadingSet with NULLs
-	m_buffer.resize(m_memory_buffer_size, NULL);
-	// Initialise buffer last read id
-	m_last_read_id.resize(m_memory_buffer_size, 0);
-	// Set the static pointer
-	m_buffer_ptr = &m_buffer;
+	// Once the task has run the plugin is known and the defaults are
+	// registered once only, merged with those of the plugin
+	m_plugin_name = this->getConfiguredPlugin();
+	if (m_plugin_name == PLUGIN_UNDEFINED)
+	{
+		// Reads the sending process configuration
+		ConfigCategory processDefault = this->fetchConfiguration(sendingDefaultConfig,
+									 PLUGIN_UNDEFINED);
+	}
 
 	if (m_plugin_name == PLUGIN_UNDEFINED) {
 
@@ -326,17 +319,24 @@ SendingProcess::SendingProcess(int argc, char** argv) : FledgeProcess(argc, argv
 				  this->getLastSentId());
 #endif
 
-	filterPipeline = NULL;
-
 	m_assetTracker = new AssetTracker(getManagementClient(), getName());
 	AssetTracker::getAssetTracker()->populateAssetTrackingCache(getName(), "Egress");
-	
-	// Load filter plugins
-	if (!this->loadFilters(this->getName()))
+
+	// The data is loaded, filtered and buffered ahead of the sending
+	// thread as in the north service
+	m_dataLoad = new DataLoad(getName(), m_stream_id, getStorageClient(), getManagementClient());
+	if (!m_dataLoad->setDataSource(m_data_source_t.empty() ? DATA_SOURCE_READINGS : m_data_source_t))
+	{
+		string errMsg(LOG_SERVICE_NAME + " - unsupported data source '" + m_data_source_t + "'.");
+
+		m_logger->fatal(errMsg);
+		throw runtime_error(errMsg);
+	}
+	if (m_block_size > 0)
 	{
-		Logger::getLogger()->fatal("SendingProcess failed loading filter plugins. Exiting");
-		throw runtime_error(LOG_SERVICE_NAME + " failure while loading filter plugins.");
+		m_dataLoad->setBlockSize(m_block_size);
 	}
+	m_dataLoad->setPrefetch(m_memory_buffer_size, DEFAULT_PREFETCH_READINGS, DEFAULT_PREFETCH_SIZE);
 }
 
 // While running check signals and execution time
@@ -416,25 +416,47 @@ bool SendingProcess::loadPlugin(const string& pluginName)
 	return false;
 }
 
+/**
+ * Return the plugin named in the configuration of the sending process,
+ * the configuration exists once the task has been created or run
+ *
+ * @return   The plugin name or PLUGIN_UNDEFINED
+ */
+string SendingProcess::getConfiguredPlugin()
+{
+	try
+	{
+		ConfigCategory configuration = this->getManagementClient()->getCategory(this->getName());
+		if (configuration.itemExists("plugin"))
+		{
+			return configuration.getValue("plugin");
+		}
+	}
+	catch (std::exception* e)
+	{
+		delete e;
+	}
+	catch (...)
+	{
+	}
+	return PLUGIN_UNDEFINED;
+}
+
 // Stop running threads & cleanup used resources
 void SendingProcess::stop()
 {
 	// End of processing loop for threads
 	this->stopRunning();
 
+	// Return the sending thread from any wait for data
+	this->m_dataLoad->shutdown();
+
 	// Threads execution has completed.
-	this->m_thread_load->join();
-        this->m_thread_send->join();
+	this->m_thread_send->join();
 
-	// Remove the data buffers
-	for (unsigned int i = 0; i < m_memory_buffer_size; i++)
-	{
-		ReadingSet* data = this->m_buffer[i];
-		if (data != NULL)
-		{
-			delete data;
-		}
-	}
+	// Stop the loading thread and cleanup the filters
+	delete this->m_dataLoad;
+	this->m_dataLoad = NULL;
 
 	// Cleanup the plugin resources
 	if (this->m_plugin->m_plugin_data)
@@ -458,49 +480,16 @@ void SendingProcess::stop()
 		this->m_plugin->shutdown();
 	}
 
-	// Cleanup filters
-	if (filterPipeline)
-	{
-		filterPipeline->cleanupFilters(getName());
-		delete filterPipeline;
-	}
-
 	Logger::getLogger()->info("SendingProcess successfully terminated");
 }
 
-/**
- * Sets the position of the readings table the sending procress
- * has already sent
- *
- * @lastSentId	Id of the readings table already sent
- */
-void SendingProcess::updateStreamLastSentId(long lastSentId)
-{
-
-	string streamId = to_string(this->getStreamId());
-
-	// Prepare WHERE id = val
-	const Condition conditionStream(Equals);
-	Where wStreamId("id",
-	                conditionStream,
-	                streamId);
-
-	// Prepare last_object = value
-	InsertValues lastId;
-	lastId.push_back(InsertValue("last_object",lastSentId));
-
-	// Perform UPDATE fledge.streams SET last_object = x WHERE id = y
-	this->getStorageClient()->updateTable("streams",
-	                                      lastId,
-	                                      wStreamId);
-}
 /**
  * Update database tables statistics and streams
  * setting last_object id in streams
  */
 void SendingProcess::updateDatabaseCounters()
 {
-	updateStreamLastSentId((long)this->getLastSentId());
+	m_dataLoad->updateLastSentId(this->getLastSentId());
 
 	// Updates 'Master' statistic
 	string stat_key;
@@ -927,108 +916,3 @@ ConfigCategory SendingProcess::fetchConfiguration(const std::string& defaultConf
 		return ConfigCategory(configuration);
 	}
 }
-
-/**
- * Load filter plugins for the given configuration
- *
- * @param categoryName	The sending process category name
- * @return 		True if filters were loaded and initialised
- *			or there are no filters
- *			False with load/init errors
- */
-bool SendingProcess::loadFilters(const string& categoryName)
-{
-	filterPipeline = new NorthFilterPipeline(this->getManagementClient(), *(this->getStorageClient()), getName());
-
-	// Try to load filters:
-	if (!filterPipeline->loadFilters(categoryName))
-	{
-		// return false on any error
-		return false;
-	}
-
-	// return true if no filters
-	if (filterPipeline->getFilterCount() == 0)
-	{
-		return true;
-	}
-	
-	// We have some filters: set up the filter pipeline
-	return filterPipeline->setupFiltersPipeline((void *)passToOnwardFilter, (void *)useFilteredData, this);
-}
-
-/**
- * Use the current input readings (they have been filtered
- * by all filters)
- *
- * Note:
- * This routine must passed to last filter "plugin_init" only
- *
- * Static method
- *
- * @param outHandle	Pointer to current buffer index
- *			where to add the readings
- * @param readings	Filtered readings to add to buffer[index]
- */ 	
-void SendingProcess::useFilteredData(OUTPUT_HANDLE *outHandle,
-				     READINGSET *readings)
-{
-	// Handle the readings set by adding readings set to data buffer[index]
-	unsigned long* loadBufferIndex = (unsigned long *)outHandle;
-	SendingProcess::getDataBuffers()->at(*loadBufferIndex) = (ReadingSet *)readings;
-}
-
-/**
- * Pass the current readings set to the next filter in the pipeline
- *
- * Note:
- * This routine must be passed to all filters "plugin_init" except the last one
- *
- * Static method
- *
- * @param outHandle	Pointer to next filter
- * @param readings	Current readings set
- */ 	
-void SendingProcess::passToOnwardFilter(OUTPUT_HANDLE *outHandle,
-					READINGSET *readings)
-{
-	// Get next filter in the pipeline
-	FilterPlugin *next = (FilterPlugin *)outHandle;
-	// Pass readings to next filter
-	next->ingest(readings);
-}
-
-/**
- * Set the current buffer load index
- *
- * @param loadBufferIndex    The buffer load index the load thread is using
- */
-void SendingProcess::setLoadBufferIndex(unsigned long loadBufferIndex)
-{
-	m_load_buffer_index = loadBufferIndex;
-}
-
-/**
- * Get the current buffer load index
- *
- * @return	The buffer load index the load thread is using
- */
-unsigned long SendingProcess::getLoadBufferIndex() const
-{
-        return m_load_buffer_index;
-}
-
-/**
- * Get the current buffer load index pointer
- *
- * NOTE:
- * this routine must be called only to pass the index pointer
- * to the last filter in the pipeline for the readings set.
- *
- * @return    The pointer to the buffer load index being used by the load thread
- */
-const unsigned long* SendingProcess::getLoadBufferIndexPtr() const
-{
-        return &m_load_buffer_index;
-}
-
@@ -25,6 +25,8 @@
 
 #define UTILITIES_CATEGORY	  "Utilities"
 
+#define HISTORICIZE_BATCH	1000	// Rows of the daily statistics history inserted per request
+
 
 class PurgeSystem : public FledgeProcess
 {
@@ -301,9 +301,35 @@ ResultSet *PurgeSystem::extractData(const std::string& tableName, const std::str
 	return (data);
 }
 
+/**
+ * Find the first of a set of alternative column names within a result set
+ *
+ * @param data		The result set
+ * @param names		The alternative names of the column
+ * @return int		The index of the column or -1 if none is present
+ */
+static int findColumn(ResultSet *data, const vector<string>& names)
+{
+	for (auto& name : names)
+	{
+		for (unsigned int i = 0; i < data->columnCount(); i++)
+		{
+			if (data->columnName(i).compare(name) == 0)
+			{
+				return (int)i;
+			}
+		}
+	}
+	return -1;
+}
+
 /**
  * Store the content of the provided recordset in the given table
  *
+ * The rows are inserted HISTORICIZE_BATCH rows per storage request. The
+ * columns are resolved once for the recordset, the SQLite and PostgreSQL
+ * plugins name the date column and return the sum differently.
+ *
  * @param   tableDest  Name of the table in which the recordset should be stored
  * @param   data       recordset to store on the table tableDest
  */
@@ -311,74 +337,60 @@ void PurgeSystem::storeData(const std::string& tableDest, ResultSet *data)
 {
 	long   fieldYear;
 	string fieldDate;
-	string fieldKey;
 	long   fieldValue = 0;
 
 	int affected = 0;
 
-	bool retrieved;
-
 	try
 	{
 		m_logger->debug("%s - storing in :%s: rows :%d:", __FUNCTION__, tableDest.c_str(), data->rowCount() );
 
-		ResultSet::RowIterator item = data->firstRow();
-		do
+		int dateColumn = findColumn(data, { "date(history_ts)", "date" });
+		int keyColumn = findColumn(data, { "key" });
+		int valueColumn = findColumn(data, { "sum_value" });
+		if (dateColumn == -1 || keyColumn == -1 || valueColumn == -1)
 		{
-			ResultSet::Row* row = *item;
+			raiseError ("The statistics history data extracted has unexpected columns");
+		}
 
-			if (row)
-			{
-				// SQLite and PostgreSQL plugins behave differently, it initially tries the code for SQLite and in case
-				// of an error it executes the PostgreSQL one
-				try {
-					fieldDate = row->getColumn("date(history_ts)")->getString();
-					retrieved = true;
-
-				} catch (...) {
-					retrieved = false;
-				}
-				if (! retrieved)
-				{
-					fieldDate = row->getColumn("date")->getString();
-				}
+		vector<InsertValues> batch;
+		batch.reserve(HISTORICIZE_BATCH);
+		for (unsigned int i = 0; i < data->rowCount(); i++)
+		{
+			const ResultSet::Row* row = (*data)[i];
 
-				fieldYear = strtol(fieldDate.substr(0, 4).c_str(), nullptr, 10);
-				fieldKey = row->getColumn("key")->getString();
+			fieldDate = row->getColumn((unsigned int)dateColumn)->getString();
+			fieldYear = strtol(fieldDate.substr(0, 4).c_str(), nullptr, 10);
 
-				// SQLite and PostgreSQL plugins behave differently, it initially tries the code for SQLite and in case
-				// of an error it executes the PostgreSQL one
-				try {
-					fieldValue = row->getColumn("sum_value")->getInteger();
-					retrieved = true;
-				} catch (...) {
-					retrieved = false;
-				}
-				if (! retrieved)
-				{
-					fieldValue = strtol(row->getColumn("sum_value")->getString(), nullptr, 10);
-				}
+			ResultSet::ColumnValue *value = row->getColumn((unsigned int)valueColumn);
+			if (value->getType() == STRING_COLUMN)
+			{
+				fieldValue = strtol(value->getString(), nullptr, 10);
+			}
+			else
+			{
+				fieldValue = value->getInteger();
+			}
 
-				InsertValues values;
-				values.push_back(InsertValue("year", fieldYear) );
-				values.push_back(InsertValue("day", fieldDate) );
-				values.push_back(InsertValue("key", fieldKey) );
-				values.push_back(InsertValue("value", fieldValue) );
+			InsertValues values;
+			values.push_back(InsertValue("year", fieldYear) );
+			values.push_back(InsertValue("day", fieldDate) );
+			values.push_back(InsertValue("key", row->getColumn((unsigned int)keyColumn)->getString()) );
+			values.push_back(InsertValue("value", fieldValue) );
+			batch.push_back(values);
 
-				m_logger->debug("%s - :%s: inserting :%ld: :%s: :%s: :%ld:  ", __FUNCTION__, tableDest.c_str()
-					, fieldYear
-					, fieldDate.c_str()
-					, fieldKey.c_str()
-					, fieldValue);
+			if (batch.size() == HISTORICIZE_BATCH || i == data->rowCount() - 1)
+			{
+				m_logger->debug("%s - :%s: inserting :%d: rows", __FUNCTION__, tableDest.c_str(), (int)batch.size());
 
-				affected = m_storage->insertTable(tableDest, values);
+				affected = m_storage->insertTable(tableDest, batch);
 				if (affected == -1)
 				{
 					raiseError ("Failure inserting rows into :%s: ", tableDest.c_str() );
 				}
+				batch.clear();
 			}
-
-		} while (!data->isLastRow(item++));
+		}
 
 	} catch (const std::exception &e) {
 
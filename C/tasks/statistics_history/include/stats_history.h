@@ -26,9 +26,6 @@ class StatsHistory : public FledgeProcess
 		~StatsHistory();
 
 		void			run() const;
-
-	private:
-		void	processKey(const std::string& key) const;
 };
 
 #endif
@@ -42,6 +42,11 @@ StatsHistory::~StatsHistory()
 /**
  * Statisitics History run method, called by the base class
  * to start the process and do the actual work.
+ *
+ * The values of all the statistics are read in a single query, the
+ * history rows are then added in a single insert and the previous
+ * values updated in a single update, rather than making three
+ * storage requests per statistics key.
  */
 void StatsHistory::run() const
 {
@@ -50,64 +55,58 @@ void StatsHistory::run() const
 	std::signal(SIGSTOP, signalHandler);
 	std::signal(SIGTERM, signalHandler);
 
-	// Get the set of distinct statistics keys
+	// Fetch the current and previous values of every statistics key
 	Query query(new Returns("key"));
-	query.distinct();
-	ResultSet *keySet = getStorageClient()->queryTable("statistics", query);
-
-	ResultSet::RowIterator rowIter = keySet->firstRow();
-
-        do {
-		string key = (*rowIter)->getColumn("key")->getString();
-		try {
-			processKey(key);
-		} catch (exception e) {
-			getLogger()->error("Failed to process statisitics key %s, %s", key, e.what());
-		}
-                rowIter = keySet->nextRow(rowIter);
-	} while (keySet->hasNextRow(rowIter));
-
-	delete keySet;
-}
-
-/**
- * Process a single statistics key
- *
- * @param key	The statistics key to process
- */
-void StatsHistory::processKey(const string& key) const
-{
-Query	query(new Where("key", Equals, key));
-
-	// Fetch the current and previous valaues for the key
 	query.returns(new Returns("value"));
 	query.returns(new Returns("previous_value"));
 	ResultSet *values = getStorageClient()->queryTable("statistics", query);
-	if (values->rowCount() != 1)
+	if (!values)
 	{
-		getLogger()->error("Internal error, failed to get statisitics for key %s", key.c_str());
+		getLogger()->error("Failed to fetch the statistics");
 		return;
 	}
-	int val = ((*values)[0])->getColumn("value")->getInteger();
-	int prev = ((*values)[0])->getColumn("previous_value")->getInteger();
-	delete values;
-	
-	// Insert the row into the configuration history
-	InsertValues historyValues;
-	historyValues.push_back(InsertValue("key", key.c_str()));
-	historyValues.push_back(InsertValue("value", val - prev));
-	historyValues.push_back(InsertValue("history_ts", "now()"));
-	int n_rows;
-	if ((n_rows = getStorageClient()->insertTable("statistics_history", historyValues)) != 1)
+
+	vector<InsertValues> history;
+	vector<pair<InsertValues *, Where *>> updates;
+	history.reserve(values->rowCount());
+	updates.reserve(values->rowCount());
+	for (unsigned int i = 0; i < values->rowCount(); i++)
 	{
-		getLogger()->error("Failed to insert single row to statisitics history table for key %s", key.c_str());
+		const ResultSet::Row *row = (*values)[i];
+		string key = row->getColumn("key")->getString();
+		long val = row->getColumn("value")->getInteger();
+		long prev = row->getColumn("previous_value")->getInteger();
+
+		// The row of the statistics history
+		InsertValues historyValues;
+		historyValues.push_back(InsertValue("key", key));
+		historyValues.push_back(InsertValue("value", val - prev));
+		historyValues.push_back(InsertValue("history_ts", "now()"));
+		history.push_back(historyValues);
+
+		// The new previous value of the statistics row
+		InsertValues *updateValues = new InsertValues;
+		updateValues->push_back(InsertValue("previous_value", val));
+		updates.push_back(pair<InsertValues *, Where *>(updateValues, new Where("key", Equals, key)));
+	}
+	delete values;
+
+	try {
+		if (getStorageClient()->insertTable("statistics_history", history) != (int)history.size())
+		{
+			getLogger()->error("Failed to insert %d rows into the statisitics history table", (int)history.size());
+		}
+		if (getStorageClient()->updateTable("statistics", updates) != (int)updates.size())
+		{
+			getLogger()->error("Failed to update the previous values of %d statisitics", (int)updates.size());
+		}
+	} catch (exception& e) {
+		getLogger()->error("Failed to update the statisitics history, %s", e.what());
 	}
 
-	// Update the previous value in the statistics row
-	InsertValues updateValues;
-	updateValues.push_back(InsertValue("previous_value", val));
-	if (getStorageClient()->updateTable("statistics", updateValues, Where("key", Equals, key)) != 1)
+	for (auto& update : updates)
 	{
-		getLogger()->error("Failed to update single row to statisitics table for key %s", key.c_str());
+		delete update.first;
+		delete update.second;
 	}
 }
@@ -4,6 +4,8 @@
 # See: http://fledge-iot.readthedocs.io/
 # FLEDGE_END
 
+import json
+
 from fledge.common.storage_client.payload_builder import PayloadBuilder
 from fledge.common.storage_client.storage_client import StorageClientAsync
 from fledge.common.storage_client.exceptions import StorageServerError
@@ -65,6 +67,32 @@ class AuditLogger(AuditLoggerSingleton):
             _logger.exception("Failed to log audit trail entry '%s': %s", code, str(ex))
             raise ex
 
+    async def log_entries(self, entries):
+        """ Add a number of audit trail entries with a single insert
+
+        :param entries: list of (severity, code, log) tuples, the severity being
+                        one of success, failure, warning or information
+        """
+        rows = []
+        for severity, code, log in entries:
+            try:
+                level = getattr(self, '_' + str(severity).lower())
+            except AttributeError:
+                raise ValueError("severity type {} is not supported".format(severity))
+            if not isinstance(level, int):
+                raise ValueError("severity type {} is not supported".format(severity))
+            row = {"code": code, "level": level}
+            if log is not None:
+                row["log"] = log
+            rows.append(row)
+        if not rows:
+            return
+        try:
+            await self._storage.insert_into_tbl("log", json.dumps({"inserts": rows}))
+        except (StorageServerError, Exception) as ex:
+            _logger.exception("Failed to log %d audit trail entries: %s", len(rows), str(ex))
+            raise ex
+
     async def success(self, code, log):
         await self._log(self._success, code, log)
 
@@ -36,27 +36,39 @@ async def get_asset_tracker_events(request):
             curl -X GET http://localhost:8081/fledge/track?event=XXX
             curl -X GET http://localhost:8081/fledge/track?service=XXX
     """
+    asset = urllib.parse.unquote(request.query['asset']) if 'asset' in request.query else None
+    event = request.query['event'] if 'event' in request.query else None
+    service = urllib.parse.unquote(request.query['service']) if 'service' in request.query else None
+    try:
+        response = await get_asset_tracker_records(asset=asset, event=event, service=service)
+    except KeyError as ex:
+        raise web.HTTPBadRequest(reason=ex.args[0])
+    except Exception as ex:
+        raise web.HTTPInternalServerError(reason=ex)
+
+    return web.json_response({'track': response})
+
+
+async def get_asset_tracker_records(asset=None, event=None, service=None):
+    """ Return the asset tracking records that match the given asset, event and service, a filter
+    that is None or empty matches every record
+
+    Raises:
+        KeyError: with the message of the storage layer if the query failed
+    """
     payload = PayloadBuilder().SELECT("asset", "event", "service", "fledge", "plugin", "ts") \
         .ALIAS("return", ("ts", 'timestamp')).FORMAT("return", ("ts", "YYYY-MM-DD HH24:MI:SS.MS")) \
         .WHERE(['1', '=', 1])
-    if 'asset' in request.query and request.query['asset'] != '':
-        asset = urllib.parse.unquote(request.query['asset'])
+    if asset:
         payload.AND_WHERE(['asset', '=', asset])
-    if 'event' in request.query and request.query['event'] != '':
-        event = request.query['event']
+    if event:
         payload.AND_WHERE(['event', '=', event])
-    if 'service' in request.query and request.query['service'] != '':
-        service = urllib.parse.unquote(request.query['service'])
+    if service:
         payload.AND_WHERE(['service', '=', service])
 
     storage_client = connect.get_storage_async()
     payload = PayloadBuilder(payload.chain_payload())
-    try:
-        result = await storage_client.query_tbl_with_payload('asset_tracker', payload.payload())
-        response = result['rows']
-    except KeyError:
-        raise web.HTTPBadRequest(reason=result['message'])
-    except Exception as ex:
-        raise web.HTTPInternalServerError(reason=ex)
-
-    return web.json_response({'track': response})
+    result = await storage_client.query_tbl_with_payload('asset_tracker', payload.payload())
+    if 'rows' not in result:
+        raise KeyError(result['message'])
+    return result['rows']
@@ -8,6 +8,7 @@
 import subprocess
 import os
 import json
+import copy
 
 from fledge.common import logger
 from fledge.common.common import _FLEDGE_ROOT, _FLEDGE_PLUGIN_PATH
@@ -15,6 +16,11 @@ from fledge.common.common import _FLEDGE_ROOT, _FLEDGE_PLUGIN_PATH
 _logger = logger.setup(__name__)
 _lib_path = _FLEDGE_ROOT + "/" + "plugins"
 
+# The plugin information by library path, with the modification time of the library it was read from
+_plugin_info_cache = {}
+# The paths of the C utilities found
+_c_utils = {}
+
 
 def get_plugin_info(name, dir):
     try:
@@ -22,11 +28,20 @@ def get_plugin_info(name, dir):
         arg2 = _find_c_lib(name, dir)
         if arg2 is None:
             raise ValueError('The plugin {} does not exist'.format(name))
+        try:
+            modified = os.stat(arg2).st_mtime_ns
+        except OSError:
+            modified = None
+        cached = _plugin_info_cache.get(arg2)
+        if modified is not None and cached is not None and cached[0] == modified:
+            return copy.deepcopy(cached[1])
         cmd_with_args = [arg1, arg2, "plugin_info"]
         p = subprocess.Popen(cmd_with_args, stdout=subprocess.PIPE, stderr=subprocess.PIPE)
         out, err = p.communicate()
         res = out.decode("utf-8")
         jdoc = json.loads(res)
+        if modified is not None:
+            _plugin_info_cache[arg2] = (modified, copy.deepcopy(jdoc))
     except OSError as err:
         _logger.error("%s C plugin get info failed due to %s", name, str(err))
         return {}
@@ -59,11 +74,14 @@ def _find_c_lib(name, dir):
 
 
 def _find_c_util(name):
+    if name in _c_utils and os.path.isfile(_c_utils[name]):
+        return _c_utils[name]
     for path, subdirs, files in os.walk(_FLEDGE_ROOT):
         for fname in files:
             # C-utility file
             if fname == name:
-                return os.path.join(path, fname)
+                _c_utils[name] = os.path.join(path, fname)
+                return _c_utils[name]
     return None
 
 
@@ -23,49 +23,126 @@ __version__ = "${VERSION}"
 _LOGGER = logger.setup(__name__)
 
 
+NOTIFY_BATCH_WINDOW = 0.05
+""" Seconds for which category changes are collected before the interested microservices are notified """
+
+_batch = None
+""" The categories changed in the current batching window and the future that completes once they are notified """
+
+_unbatched = set()
+""" The microservices that do not support the notification of several changes in a single call """
+
+
 async def run(category_name):
     """ Callback run by configuration category to notify changes to interested microservices
 
+    Changes made within the batching window are notified together, a microservice interested
+    in more than one of the changed categories receives a single call with all of its changes
+    and a category changed more than once in the window is only notified once.
+
     Note: this method is async as needed
 
     Args:
         configuration_name (str): name of category that was changed
     """
+    global _batch
+    if _batch is not None:
+        batch = _batch
+        if category_name not in batch['categories']:
+            batch['categories'].append(category_name)
+        await asyncio.shield(batch['done'])
+        return
 
-    # get all interest records regarding category_name
+    batch = {'categories': [category_name], 'done': asyncio.get_event_loop().create_future()}
+    _batch = batch
+    try:
+        await asyncio.sleep(NOTIFY_BATCH_WINDOW)
+    finally:
+        _batch = None
+    try:
+        await _notify(batch['categories'])
+    finally:
+        batch['done'].set_result(None)
+
+
+async def _notify(category_names):
+    """ Notify the interested microservices of the changes to a set of categories
+
+    Args:
+        category_names (list): names of the categories that were changed
+    """
+    # get all interest records regarding each category and collect the changes of each microservice
     cfg_mgr = ConfigurationManager()
     interest_registry = InterestRegistry(cfg_mgr)
-    try:
-        interest_records = interest_registry.get(category_name=category_name)
-    except interest_registry_exceptions.DoesNotExist:
-        return
+    changes = {}
+    for category_name in category_names:
+        try:
+            interest_records = interest_registry.get(category_name=category_name)
+        except interest_registry_exceptions.DoesNotExist:
+            continue
 
-    category_value = await cfg_mgr.get_category_all_items(category_name)
-    payload = {"category" : category_name, "items" : category_value}
-    headers = {'content-type': 'application/json'}
+        category_value = await cfg_mgr.get_category_all_items(category_name)
+        payload = {"category" : category_name, "items" : category_value}
+        for i in interest_records:
+            changes.setdefault(i._microservice_uuid, []).append(payload)
 
-    # for each microservice interested in category_name, notify change
-    for i in interest_records:
+    # for each microservice interested in the changed categories, notify the changes
+    for microservice_uuid, payloads in changes.items():
         # get microservice management server info of microservice through service registry
         try: 
-            service_record = ServiceRegistry.get(idx=i._microservice_uuid)[0]
+            service_record = ServiceRegistry.get(idx=microservice_uuid)[0]
         except service_registry_exceptions.DoesNotExist:
-            _LOGGER.exception("Unable to notify microservice with uuid %s as it is not found in the service registry", i._microservice_uuid)
+            _LOGGER.exception("Unable to notify microservice with uuid %s as it is not found in the service registry", microservice_uuid)
             continue
-        url = "{}://{}:{}/fledge/change".format(service_record._protocol, service_record._address, service_record._management_port)
-
-        async with aiohttp.ClientSession() as session:
-            try:
-                async with session.post(url, data=json.dumps(payload, sort_keys=True), headers=headers) as resp:
-                    result = await resp.text()
-                    status_code = resp.status
-                    if status_code in range(400, 500):
-                        _LOGGER.error("Bad request error code: %d, reason: %s", status_code, resp.reason)
-                    if status_code in range(500, 600):
-                        _LOGGER.error("Server error code: %d, reason: %s", status_code, resp.reason)
-            except Exception as ex:
-                _LOGGER.exception("Unable to notify microservice with uuid %s due to exception: %s", i._microservice_uuid, str(ex))
+        if len(payloads) > 1 and microservice_uuid not in _unbatched:
+            if await _notify_changes(microservice_uuid, service_record, payloads):
                 continue
+        for payload in payloads:
+            await _notify_change(microservice_uuid, service_record, payload)
+
+
+async def _notify_change(microservice_uuid, service_record, payload):
+    """ Notify a microservice of the change to a single category """
+    url = "{}://{}:{}/fledge/change".format(service_record._protocol, service_record._address, service_record._management_port)
+    headers = {'content-type': 'application/json'}
+
+    async with aiohttp.ClientSession() as session:
+        try:
+            async with session.post(url, data=json.dumps(payload, sort_keys=True), headers=headers) as resp:
+                result = await resp.text()
+                status_code = resp.status
+                if status_code in range(400, 500):
+                    _LOGGER.error("Bad request error code: %d, reason: %s", status_code, resp.reason)
+                if status_code in range(500, 600):
+                    _LOGGER.error("Server error code: %d, reason: %s", status_code, resp.reason)
+        except Exception as ex:
+            _LOGGER.exception("Unable to notify microservice with uuid %s due to exception: %s", microservice_uuid, str(ex))
+
+
+async def _notify_changes(microservice_uuid, service_record, payloads):
+    """ Notify a microservice of the changes to several categories in a single call
+
+    Returns:
+        False if the microservice does not support the call and must be notified of each change separately
+    """
+    url = "{}://{}:{}/fledge/changes".format(service_record._protocol, service_record._address, service_record._management_port)
+    headers = {'content-type': 'application/json'}
+
+    async with aiohttp.ClientSession() as session:
+        try:
+            async with session.post(url, data=json.dumps({"changes": payloads}, sort_keys=True), headers=headers) as resp:
+                result = await resp.text()
+                status_code = resp.status
+                if status_code in (404, 405):
+                    _unbatched.add(microservice_uuid)
+                    return False
+                if status_code in range(400, 500):
+                    _LOGGER.error("Bad request error code: %d, reason: %s", status_code, resp.reason)
+                if status_code in range(500, 600):
+                    _LOGGER.error("Server error code: %d, reason: %s", status_code, resp.reason)
+        except Exception as ex:
+            _LOGGER.exception("Unable to notify microservice with uuid %s due to exception: %s", microservice_uuid, str(ex))
+    return True
 
 
 async def run_child_create(parent_category_name, child_category_list):
@@ -1277,22 +1277,61 @@ class Server:
 
             raise web.HTTPNotFound(reason=msg)
 
-        services = []
-        for service in services_list:
-            svc = dict()
-            svc["id"] = service._id
-            svc["name"] = service._name
-            svc["type"] = service._type
-            svc["address"] = service._address
-            svc["management_port"] = service._management_port
-            svc["protocol"] = service._protocol
-            svc["status"] = ServiceRecord.Status(int(service._status)).name.lower()
-            if service._port:
-                svc["service_port"] = service._port
-            services.append(svc)
+        services = [cls._service_as_dict(service) for service in services_list]
 
         return web.json_response({"services": services})
 
+    @classmethod
+    def _service_as_dict(cls, service):
+        svc = dict()
+        svc["id"] = service._id
+        svc["name"] = service._name
+        svc["type"] = service._type
+        svc["address"] = service._address
+        svc["management_port"] = service._management_port
+        svc["protocol"] = service._protocol
+        svc["status"] = ServiceRecord.Status(int(service._status)).name.lower()
+        if service._port:
+            svc["service_port"] = service._port
+        return svc
+
+    @classmethod
+    async def get_bootstrap(cls, request):
+        """ Returns, in a single response, what a microservice fetches from the core as it starts:
+        the requested configuration categories, the storage service record and the asset tracking
+        records of the service. Categories that do not exist are left out of the response.
+
+        :Example:
+            curl -X GET "http://localhost:<core mgt port>/fledge/service/bootstrap?service=Sine&category=Sine&category=SineAdvanced"
+        """
+        service_name = request.query['service'] if 'service' in request.query else None
+        category_names = request.query.getall('category', [])
+
+        async def get_track():
+            if not service_name:
+                return []
+            return await asset_tracker_api.get_asset_tracker_records(service=service_name)
+
+        try:
+            results = await asyncio.gather(
+                get_track(),
+                *[cls._configuration_manager.get_category_all_items(name) for name in category_names])
+        except KeyError as ex:
+            raise web.HTTPBadRequest(reason=ex.args[0])
+        except Exception as ex:
+            raise web.HTTPInternalServerError(reason=str(ex))
+
+        categories = {}
+        for name, category in zip(category_names, results[1:]):
+            if category is not None:
+                categories[name] = category
+        try:
+            services = [cls._service_as_dict(service) for service in ServiceRegistry.get(s_type='Storage')]
+        except service_registry_exceptions.DoesNotExist:
+            services = []
+
+        return web.json_response({"categories": categories, "services": services, "track": results[0]})
+
     @classmethod
     async def get_auth_token(cls, request: web.Request) -> web.Response:
         """ get auth token
@@ -1588,14 +1627,26 @@ class Server:
     @classmethod
     async def add_track(cls, request):
         data = await request.json()
-        if not isinstance(data, dict):
-            raise ValueError('Data payload must be a dictionary')
+        # A list of records may be added with a single request
+        if not isinstance(data, (dict, list)):
+            raise ValueError('Data payload must be a dictionary or a list of dictionaries')
 
         try:
-            result = await cls._asset_tracker.add_asset_record(asset=data.get("asset"),
-                                                               plugin=data.get("plugin"),
-                                                               service=data.get("service"),
-                                                               event=data.get("event"))
+            if isinstance(data, list):
+                tracks = []
+                for record in data:
+                    if not isinstance(record, dict):
+                        raise TypeError('Each asset tracking record must be a dictionary')
+                    tracks.append(await cls._asset_tracker.add_asset_record(asset=record.get("asset"),
+                                                                            plugin=record.get("plugin"),
+                                                                            service=record.get("service"),
+                                                                            event=record.get("event")))
+                result = {"tracks": tracks}
+            else:
+                result = await cls._asset_tracker.add_asset_record(asset=data.get("asset"),
+                                                                   plugin=data.get("plugin"),
+                                                                   service=data.get("service"),
+                                                                   event=data.get("event"))
         except (TypeError, StorageServerError) as ex:
             raise web.HTTPBadRequest(reason=str(ex))
         except ValueError as ex:
@@ -1698,26 +1749,44 @@ class Server:
     @classmethod
     async def add_audit(cls, request):
         data = await request.json()
-        if not isinstance(data, dict):
-            raise ValueError('Data payload must be a dictionary')
+        # A list of entries may be added with a single request
+        if not isinstance(data, (dict, list)):
+            raise ValueError('Data payload must be a dictionary or a list of dictionaries')
 
         try:
-            code=data.get("source")
-            level=data.get("severity")
-            message=data.get("details")
-
-            # Add audit entry code and message for the given level
-            await getattr(cls._audit, str(level).lower())(code, message)
-
-            # Set timestamp for return message
-            timestamp = datetime.now().strftime("%Y-%m-%d %H:%M:%S.%f")[:-3]
-
-            # Return JSON message
-            message = {'timestamp': str(timestamp),
-                       'source': code,
-                       'severity': level,
-                       'details': message 
-                      }
+            if isinstance(data, list):
+                entries = []
+                for entry in data:
+                    if not isinstance(entry, dict):
+                        raise TypeError('Each audit entry must be a dictionary')
+                    entries.append((entry.get("severity"), entry.get("source"), entry.get("details")))
+
+                # Add all the audit entries with a single storage insert
+                await cls._audit.log_entries(entries)
+
+                timestamp = datetime.now().strftime("%Y-%m-%d %H:%M:%S.%f")[:-3]
+                message = {"audit": [{'timestamp': str(timestamp),
+                                      'source': code,
+                                      'severity': level,
+                                      'details': details
+                                      } for level, code, details in entries]}
+            else:
+                code=data.get("source")
+                level=data.get("severity")
+                message=data.get("details")
+
+                # Add audit entry code and message for the given level
+                await getattr(cls._audit, str(level).lower())(code, message)
+
+                # Set timestamp for return message
+                timestamp = datetime.now().strftime("%Y-%m-%d %H:%M:%S.%f")[:-3]
+
+                # Return JSON message
+                message = {'timestamp': str(timestamp),
+                           'source': code,
+                           'severity': level,
+                           'details': message 
+                          }
 
         except (TypeError, StorageServerError) as ex:
             raise web.HTTPBadRequest(reason=str(ex))
@@ -0,0 +1,3 @@
+DROP INDEX IF EXISTS fledge.asset_tracker_ix3;
+DROP INDEX IF EXISTS fledge.asset_tracker_ix2;
+CREATE INDEX asset_tracker_ix2 ON fledge.asset_tracker USING btree (service);
@@ -775,7 +775,8 @@ CREATE TABLE fledge.asset_tracker (
        ts            timestamp(6) with time zone NOT NULL DEFAULT now() );
 
 CREATE INDEX asset_tracker_ix1 ON fledge.asset_tracker USING btree (asset);
-CREATE INDEX asset_tracker_ix2 ON fledge.asset_tracker USING btree (service);
+CREATE INDEX asset_tracker_ix2 ON fledge.asset_tracker USING btree (service, event, plugin, asset);
+CREATE INDEX asset_tracker_ix3 ON fledge.asset_tracker USING btree (event, plugin, service);
 
 -- Create plugin_data table
 -- Persist plugin data in the storage
@@ -0,0 +1,4 @@
+-- Indexes that cover the asset tracking queries by service and by event
+DROP INDEX IF EXISTS fledge.asset_tracker_ix2;
+CREATE INDEX asset_tracker_ix2 ON fledge.asset_tracker USING btree (service, event, plugin, asset);
+CREATE INDEX IF NOT EXISTS asset_tracker_ix3 ON fledge.asset_tracker USING btree (event, plugin, service);
@@ -0,0 +1,4 @@
+DROP INDEX IF EXISTS asset_tracker_ix3;
+DROP INDEX IF EXISTS asset_tracker_ix2;
+CREATE INDEX asset_tracker_ix2
+    ON asset_tracker(service);
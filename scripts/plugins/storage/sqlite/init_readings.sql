@@ -48,6 +48,10 @@
 -- SCHEMA CREATION
 ----------------------------------------------------------------------
 
+-- The pages freed by the purges are released by the incremental vacuum
+-- of the storage plugin, the mode must be set before any table is created
+PRAGMA readings_1.auto_vacuum = INCREMENTAL;
+
 --
 -- Stores in which database/readings table the specific asset_code is stored
 --
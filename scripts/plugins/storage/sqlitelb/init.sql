@@ -568,7 +568,8 @@ CREATE TABLE fledge.asset_tracker (
        ts            DATETIME DEFAULT (STRFTIME('%Y-%m-%d %H:%M:%f', 'NOW', 'localtime')) );
 
 CREATE INDEX asset_tracker_ix1 ON asset_tracker (asset);
-CREATE INDEX asset_tracker_ix2 ON asset_tracker (service);
+CREATE INDEX asset_tracker_ix2 ON asset_tracker (service, event, plugin, asset);
+CREATE INDEX asset_tracker_ix3 ON asset_tracker (event, plugin, service);
 
 -- Create plugin_data table
 -- Persist plugin data in the storage
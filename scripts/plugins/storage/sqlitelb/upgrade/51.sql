@@ -0,0 +1,6 @@
+-- Indexes that cover the asset tracking queries by service and by event
+DROP INDEX IF EXISTS asset_tracker_ix2;
+CREATE INDEX asset_tracker_ix2
+    ON asset_tracker(service, event, plugin, asset);
+CREATE INDEX IF NOT EXISTS asset_tracker_ix3
+    ON asset_tracker(event, plugin, service);
@@ -0,0 +1,45 @@
+#include <benchmark/benchmark.h>
+#include <base64dpimage.h>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+/**
+ * Create a 24 bit image of the given width with a 4:3 aspect ratio
+ */
+static DPImage *image(int width)
+{
+	int height = width * 3 / 4;
+	vector<uint8_t> pixels(width * height * 3);
+	for (size_t i = 0; i < pixels.size(); i++)
+		pixels[i] = (uint8_t)(i * 31 + (i >> 8));
+	return new DPImage(width, height, 24, pixels.data());
+}
+
+static void BM_ImageEncode(benchmark::State& state)
+{
+	DPImage *img = image(state.range(0));
+	for (auto _ : state)
+	{
+		string encoded = ((Base64DPImage *)img)->encode();
+		benchmark::DoNotOptimize(encoded);
+	}
+	state.SetBytesProcessed(state.iterations() * img->getWidth() * img->getHeight() * 3);
+	delete img;
+}
+BENCHMARK(BM_ImageEncode)->Arg(64)->Arg(640);
+
+static void BM_ImageDecode(benchmark::State& state)
+{
+	DPImage *img = image(state.range(0));
+	string encoded = ((Base64DPImage *)img)->encode();
+	for (auto _ : state)
+	{
+		Base64DPImage decoded(encoded);
+		benchmark::DoNotOptimize(decoded.getData());
+	}
+	state.SetBytesProcessed(state.iterations() * img->getWidth() * img->getHeight() * 3);
+	delete img;
+}
+BENCHMARK(BM_ImageDecode)->Arg(64)->Arg(640);
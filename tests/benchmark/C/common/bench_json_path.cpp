@@ -0,0 +1,63 @@
+#include <benchmark/benchmark.h>
+#include <JSONPath.h>
+#include <string>
+#include <vector>
+
+using namespace std;
+using namespace rapidjson;
+
+/**
+ * Create a message with the given number of sensors, each an object
+ * with a name, value and an array of readings, and the paths that
+ * select the value of each sensor
+ */
+static string message(int sensors, vector<string>& paths)
+{
+	string json = "{ \"device\" : \"benchmark\", \"sensors\" : { ";
+	for (int i = 0; i < sensors; i++)
+	{
+		string name = "sensor" + to_string(i);
+		if (i)
+			json += ", ";
+		json += "\"" + name + "\" : { \"name\" : \"" + name + "\", \"value\" : " + to_string(i * 1.5)
+			+ ", \"history\" : [ 1.5, 2.5, 3.5 ] }";
+		paths.push_back("/sensors/" + name + "/value");
+	}
+	json += " } }";
+	return json;
+}
+
+static void BM_JSONPathFindNode(benchmark::State& state)
+{
+	vector<string> paths;
+	string json = message(state.range(0), paths);
+	vector<JSONPath *> jpaths;
+	for (auto& path : paths)
+		jpaths.push_back(new JSONPath(path));
+	for (auto _ : state)
+	{
+		Document doc;
+		doc.Parse(json.c_str());
+		for (auto jpath : jpaths)
+			benchmark::DoNotOptimize(jpath->findNode(doc));
+	}
+	for (auto jpath : jpaths)
+		delete jpath;
+	state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_JSONPathFindNode)->Arg(50);
+
+static void BM_JSONPathSet(benchmark::State& state)
+{
+	vector<string> paths;
+	string json = message(state.range(0), paths);
+	JSONPathSet set(paths);
+	for (auto _ : state)
+	{
+		Document results;
+		set.evaluate(json.c_str(), results);
+		benchmark::DoNotOptimize(results);
+	}
+	state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_JSONPathSet)->Arg(50);
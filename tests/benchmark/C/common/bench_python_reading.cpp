@@ -0,0 +1,52 @@
+#include <benchmark/benchmark.h>
+#include <pythonreading.h>
+#include <pyruntime.h>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+/**
+ * Create a reading with the given number of numeric datapoints
+ */
+static Reading *pythonReading(int datapoints)
+{
+	vector<Datapoint *> values;
+	for (int i = 0; i < datapoints; i++)
+	{
+		DatapointValue value(1234.5 + i);
+		values.push_back(new Datapoint("double" + to_string(i), value));
+	}
+	return new Reading("benchmark", values);
+}
+
+static void BM_PythonReadingToPython(benchmark::State& state)
+{
+	PythonRuntime::getPythonRuntime();
+	Reading *reading = pythonReading(state.range(0));
+	for (auto _ : state)
+	{
+		PyObject *pyReading = ((PythonReading *)reading)->toPython();
+		benchmark::DoNotOptimize(pyReading);
+		Py_CLEAR(pyReading);
+	}
+	state.SetItemsProcessed(state.iterations());
+	delete reading;
+}
+BENCHMARK(BM_PythonReadingToPython)->Arg(1)->Arg(10)->Arg(100);
+
+static void BM_PythonReadingFromPython(benchmark::State& state)
+{
+	PythonRuntime::getPythonRuntime();
+	Reading *reading = pythonReading(state.range(0));
+	PyObject *pyReading = ((PythonReading *)reading)->toPython();
+	for (auto _ : state)
+	{
+		PythonReading converted(pyReading);
+		benchmark::DoNotOptimize(converted);
+	}
+	state.SetItemsProcessed(state.iterations());
+	Py_CLEAR(pyReading);
+	delete reading;
+}
+BENCHMARK(BM_PythonReadingFromPython)->Arg(1)->Arg(10)->Arg(100);
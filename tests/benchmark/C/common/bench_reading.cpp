@@ -0,0 +1,125 @@
+#include <benchmark/benchmark.h>
+#include <reading.h>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+/**
+ * Create a reading with the given number of numeric datapoints
+ */
+static Reading *numericReading(int datapoints)
+{
+	vector<Datapoint *> values;
+	for (int i = 0; i < datapoints; i++)
+	{
+		if (i % 2)
+		{
+			DatapointValue value(1234.5 + i);
+			values.push_back(new Datapoint("double" + to_string(i), value));
+		}
+		else
+		{
+			DatapointValue value((long)i);
+			values.push_back(new Datapoint("long" + to_string(i), value));
+		}
+	}
+	return new Reading("benchmark", values);
+}
+
+static void BM_ReadingConstruct(benchmark::State& state)
+{
+	for (auto _ : state)
+	{
+		Reading *reading = numericReading(state.range(0));
+		benchmark::DoNotOptimize(reading);
+		delete reading;
+	}
+	state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_ReadingConstruct)->Arg(1)->Arg(10)->Arg(100);
+
+static void BM_ReadingCopy(benchmark::State& state)
+{
+	Reading *reading = numericReading(state.range(0));
+	for (auto _ : state)
+	{
+		Reading copy(*reading);
+		benchmark::DoNotOptimize(copy);
+	}
+	state.SetItemsProcessed(state.iterations());
+	delete reading;
+}
+BENCHMARK(BM_ReadingCopy)->Arg(1)->Arg(10)->Arg(100);
+
+static void BM_ReadingToJSON(benchmark::State& state)
+{
+	Reading *reading = numericReading(state.range(0));
+	size_t bytes = 0;
+	for (auto _ : state)
+	{
+		string json = reading->toJSON();
+		bytes += json.length();
+		benchmark::DoNotOptimize(json);
+	}
+	state.SetBytesProcessed(bytes);
+	state.SetItemsProcessed(state.iterations());
+	delete reading;
+}
+BENCHMARK(BM_ReadingToJSON)->Arg(1)->Arg(10)->Arg(100);
+
+static void BM_ReadingDatapointsJSON(benchmark::State& state)
+{
+	Reading *reading = numericReading(state.range(0));
+	for (auto _ : state)
+	{
+		string json = reading->getDatapointsJSON();
+		benchmark::DoNotOptimize(json);
+	}
+	state.SetItemsProcessed(state.iterations());
+	delete reading;
+}
+BENCHMARK(BM_ReadingDatapointsJSON)->Arg(1)->Arg(10)->Arg(100);
+
+static void BM_DatapointString(benchmark::State& state)
+{
+	for (auto _ : state)
+	{
+		DatapointValue value(string("a string value of some length"));
+		Datapoint dp("string", value);
+		string s = dp.toJSONProperty();
+		benchmark::DoNotOptimize(s);
+	}
+}
+BENCHMARK(BM_DatapointString);
+
+static void BM_DatapointArray(benchmark::State& state)
+{
+	vector<double> array(state.range(0), 1.5);
+	for (auto _ : state)
+	{
+		DatapointValue value(array);
+		Datapoint dp("array", value);
+		string s = dp.toJSONProperty();
+		benchmark::DoNotOptimize(s);
+	}
+}
+BENCHMARK(BM_DatapointArray)->Arg(10)->Arg(1000);
+
+static void BM_DatapointNested(benchmark::State& state)
+{
+	for (auto _ : state)
+	{
+		vector<Datapoint *> *children = new vector<Datapoint *>;
+		for (int i = 0; i < 10; i++)
+		{
+			DatapointValue child((long)i);
+			children->push_back(new Datapoint("child" + to_string(i), child));
+		}
+		DatapointValue value(children, true);
+		Datapoint dp("nested", value);
+		string s = dp.toJSONProperty();
+		benchmark::DoNotOptimize(s);
+	}
+}
+BENCHMARK(BM_DatapointNested);
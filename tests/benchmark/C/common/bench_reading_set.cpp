@@ -0,0 +1,58 @@
+#include <benchmark/benchmark.h>
+#include <reading_set.h>
+#include <rapidjson/document.h>
+#include <string>
+#include <sstream>
+
+using namespace std;
+using namespace rapidjson;
+
+/**
+ * Create the JSON of a block of readings as returned by the storage service
+ */
+static string readingsJSON(int count)
+{
+	ostringstream json;
+	json << "{ \"count\" : " << count << ", \"rows\" : [ ";
+	for (int i = 0; i < count; i++)
+	{
+		if (i)
+			json << ", ";
+		json << "{ \"id\" : " << i + 1 << ", \"asset_code\" : \"sinusoid\", "
+			<< "\"reading\" : { \"sinusoid\" : " << i * 0.01 << ", \"count\" : " << i << " }, "
+			<< "\"user_ts\" : \"2022-09-21 15:00:08.532958\", "
+			<< "\"ts\" : \"2022-09-21 15:00:08.542958\" }";
+	}
+	json << " ] }";
+	return json.str();
+}
+
+static void BM_ReadingSetParse(benchmark::State& state)
+{
+	string json = readingsJSON(state.range(0));
+	for (auto _ : state)
+	{
+		ReadingSet readings(json);
+		benchmark::DoNotOptimize(readings);
+	}
+	state.SetItemsProcessed(state.iterations() * state.range(0));
+	state.SetBytesProcessed(state.iterations() * json.length());
+}
+BENCHMARK(BM_ReadingSetParse)->Arg(1)->Arg(100)->Arg(10000);
+
+static void BM_JSONReading(benchmark::State& state)
+{
+	const char *json = "{ \"id\": 17651, \"asset_code\": \"luxometer\", "
+			"\"reading\": { \"lux\": 76204.524, \"status\" : \"ok\" }, "
+			"\"user_ts\": \"2017-09-21 15:00:08.532958\", "
+			"\"ts\": \"2017-09-22 14:47:18.872708\" }";
+	Document doc;
+	doc.Parse(json);
+	for (auto _ : state)
+	{
+		JSONReading reading(doc);
+		benchmark::DoNotOptimize(reading);
+	}
+	state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_JSONReading);
@@ -0,0 +1,72 @@
+#include <benchmark/benchmark.h>
+#include <string_utils.h>
+#include <string>
+
+using namespace std;
+
+static void BM_StringReplaceAll(benchmark::State& state)
+{
+	string path = "/site//building//floor_1//room_2//sensor_3//";
+	for (auto _ : state)
+	{
+		string test = path;
+		StringReplaceAll(test, "//", "/");
+		benchmark::DoNotOptimize(test);
+	}
+}
+BENCHMARK(BM_StringReplaceAll);
+
+static void BM_StringSlashFix(benchmark::State& state)
+{
+	string path = "//site//building//floor_1//room_2//sensor_3//";
+	for (auto _ : state)
+	{
+		string fixed = StringSlashFix(path);
+		benchmark::DoNotOptimize(fixed);
+	}
+}
+BENCHMARK(BM_StringSlashFix);
+
+static void BM_StringStripWhiteSpacesAll(benchmark::State& state)
+{
+	string json = "{ \"name\" : \"sinusoid\",\n  \"value\" : 1.5,\n  \"unit\" : \"volts\" }";
+	for (auto _ : state)
+	{
+		string stripped = StringStripWhiteSpacesAll(json);
+		benchmark::DoNotOptimize(stripped);
+	}
+}
+BENCHMARK(BM_StringStripWhiteSpacesAll);
+
+static void BM_UrlEncode(benchmark::State& state)
+{
+	string name = "OMF north/plugin #1 (building 2)";
+	for (auto _ : state)
+	{
+		string encoded = urlEncode(name);
+		benchmark::DoNotOptimize(encoded);
+	}
+}
+BENCHMARK(BM_UrlEncode);
+
+static void BM_UrlDecode(benchmark::State& state)
+{
+	string encoded = urlEncode("OMF north/plugin #1 (building 2)");
+	for (auto _ : state)
+	{
+		string decoded = urlDecode(encoded);
+		benchmark::DoNotOptimize(decoded);
+	}
+}
+BENCHMARK(BM_UrlDecode);
+
+static void BM_IsRegex(benchmark::State& state)
+{
+	string name = "sinusoid_asset_with_a_long_name_1";
+	for (auto _ : state)
+	{
+		bool regex = IsRegex(name);
+		benchmark::DoNotOptimize(regex);
+	}
+}
+BENCHMARK(BM_IsRegex);
@@ -0,0 +1,307 @@
+/*
+ * Fledge ingest throughput benchmark.
+ *
+ * Drives the storage service of a running Fledge instance through the
+ * Ingest class of the south service, using a synthetic source in place
+ * of a south plugin, and reports the throughput, the latency from the
+ * creation of a reading to its commit and the CPU and memory used by
+ * the storage service.
+ *
+ * Copyright (c) 2026 Dianomic Systems
+ *
+ * Released under the Apache 2.0 Licence
+ *
+ * Author: agent
+ */
+#include <synthetic_source.h>
+#include <ingest.h>
+#include <storage_client.h>
+#include <management_client.h>
+#include <asset_tracking.h>
+#include <service_record.h>
+#include <logger.h>
+#include <alloc_profiler.h>
+#include <getopt.h>
+#include <unistd.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fstream>
+#include <sstream>
+#include <thread>
+#include <chrono>
+
+#define SERVICE_NAME_BENCHMARK	"IngestBenchmark"
+#define PLUGIN_NAME_BENCHMARK	"synthetic"
+#define DRAIN_TIMEOUT		60	// Seconds to wait for queued readings to be committed
+
+using namespace std;
+using namespace std::chrono;
+
+/**
+ * The CPU time and memory of a process, read from /proc
+ */
+class ProcessSample {
+	public:
+		ProcessSample() : cpu(0.0), rss(0), peakRss(0) {};
+		bool		sample(pid_t pid);
+		double		cpu;		// Seconds of user and system time
+		unsigned long	rss;		// Resident set in kB
+		unsigned long	peakRss;	// Peak resident set in kB
+};
+
+/**
+ * Sample the CPU time and memory of a process
+ *
+ * @param pid	The process to sample
+ * @return bool	True if the process could be sampled
+ */
+bool ProcessSample::sample(pid_t pid)
+{
+	ifstream stat("/proc/" + to_string(pid) + "/stat");
+	string line;
+	if (!getline(stat, line))
+	{
+		return false;
+	}
+	// The command name may contain spaces, the fields follow the last ')'
+	size_t pos = line.rfind(')');
+	if (pos == string::npos)
+	{
+		return false;
+	}
+	istringstream fields(line.substr(pos + 2));
+	string field;
+	unsigned long utime = 0, stime = 0;
+	// utime and stime are the 12th and 13th fields after the command name
+	for (int i = 1; i <= 13 && fields >> field; i++)
+	{
+		if (i == 12)
+			utime = strtoul(field.c_str(), NULL, 10);
+		else if (i == 13)
+			stime = strtoul(field.c_str(), NULL, 10);
+	}
+	cpu = (double)(utime + stime) / sysconf(_SC_CLK_TCK);
+
+	ifstream status("/proc/" + to_string(pid) + "/status");
+	while (getline(status, line))
+	{
+		if (line.compare(0, 6, "VmRSS:") == 0)
+			rss = strtoul(line.c_str() + 6, NULL, 10);
+		else if (line.compare(0, 6, "VmHWM:") == 0)
+			peakRss = strtoul(line.c_str() + 6, NULL, 10);
+	}
+	return true;
+}
+
+static void usage(const char *name)
+{
+	fprintf(stderr, "Usage: %s [options]\n", name);
+	fprintf(stderr, "  --core-address=ADDR   Address of the Fledge core (localhost)\n");
+	fprintf(stderr, "  --core-port=PORT      Management port of the Fledge core (8081)\n");
+	fprintf(stderr, "  --storage-pid=PID     Process of the storage service to measure\n");
+	fprintf(stderr, "  --mode=MODE           Append with auto, rest, stream or shared (auto)\n");
+	fprintf(stderr, "  --assets=N            Number of assets (10)\n");
+	fprintf(stderr, "  --datapoints=N        Datapoints per reading (5)\n");
+	fprintf(stderr, "  --shape=SHAPE         Datapoints are numeric, string, array or nested (numeric)\n");
+	fprintf(stderr, "  --array-size=N        Elements in array datapoints (16)\n");
+	fprintf(stderr, "  --rate=N              Readings per second, 0 for as fast as possible (10000)\n");
+	fprintf(stderr, "  --burst=N             Readings ingested together (100)\n");
+	fprintf(stderr, "  --duration=N          Seconds to generate readings for (60)\n");
+	fprintf(stderr, "  --threshold=N         Ingest buffer threshold (500)\n");
+	fprintf(stderr, "  --timeout=N           Ingest buffer timeout in milliseconds (5000)\n");
+	fprintf(stderr, "  --label=LABEL         Label for the results, such as the storage plugin\n");
+	fprintf(stderr, "  --output=FILE         Write the JSON results to FILE rather than stdout\n");
+}
+
+int main(int argc, char *argv[])
+{
+	string coreAddress = "localhost";
+	unsigned short corePort = 8081;
+	pid_t storagePid = 0;
+	string mode = "auto", shapeName = "numeric", label, output;
+	unsigned int assets = 10, datapoints = 5, arraySize = 16;
+	unsigned int rate = 10000, burst = 100, runTime = 60;
+	unsigned int threshold = 500;
+	long timeout = 5000;
+
+	static struct option options[] = {
+		{ "core-address", required_argument, 0, 'a' },
+		{ "core-port", required_argument, 0, 'p' },
+		{ "storage-pid", required_argument, 0, 'P' },
+		{ "mode", required_argument, 0, 'm' },
+		{ "assets", required_argument, 0, 'n' },
+		{ "datapoints", required_argument, 0, 'd' },
+		{ "shape", required_argument, 0, 's' },
+		{ "array-size", required_argument, 0, 'A' },
+		{ "rate", required_argument, 0, 'r' },
+		{ "burst", required_argument, 0, 'b' },
+		{ "duration", required_argument, 0, 'D' },
+		{ "threshold", required_argument, 0, 't' },
+		{ "timeout", required_argument, 0, 'T' },
+		{ "label", required_argument, 0, 'l' },
+		{ "output", required_argument, 0, 'o' },
+		{ 0, 0, 0, 0 }
+	};
+	int opt;
+	while ((opt = getopt_long(argc, argv, "", options, NULL)) != -1)
+	{
+		switch (opt)
+		{
+			case 'a': coreAddress = optarg; break;
+			case 'p': corePort = (unsigned short)atoi(optarg); break;
+			case 'P': storagePid = (pid_t)atoi(optarg); break;
+			case 'm': mode = optarg; break;
+			case 'n': assets = (unsigned int)atoi(optarg); break;
+			case 'd': datapoints = (unsigned int)atoi(optarg); break;
+			case 's': shapeName = optarg; break;
+			case 'A': arraySize = (unsigned int)atoi(optarg); break;
+			case 'r': rate = (unsigned int)atoi(optarg); break;
+			case 'b': burst = (unsigned int)atoi(optarg); break;
+			case 'D': runTime = (unsigned int)atoi(optarg); break;
+			case 't': threshold = (unsigned int)atoi(optarg); break;
+			case 'T': timeout = atol(optarg); break;
+			case 'l': label = optarg; break;
+			case 'o': output = optarg; break;
+			default:
+				usage(argv[0]);
+				return 1;
+		}
+	}
+
+	SyntheticSource::Shape shape;
+	if (!SyntheticSource::parseShape(shapeName, shape) || assets == 0 || burst == 0)
+	{
+		usage(argv[0]);
+		return 1;
+	}
+	StorageClient::AppendMode appendMode;
+	if (mode.compare("auto") == 0)
+		appendMode = StorageClient::AppendAuto;
+	else if (mode.compare("rest") == 0)
+		appendMode = StorageClient::AppendREST;
+	else if (mode.compare("stream") == 0)
+		appendMode = StorageClient::AppendStream;
+	else if (mode.compare("shared") == 0)
+		appendMode = StorageClient::AppendShared;
+	else
+	{
+		usage(argv[0]);
+		return 1;
+	}
+
+	Logger *logger = new Logger(SERVICE_NAME_BENCHMARK);
+	logger->setMinLevel("warning");
+
+	ManagementClient management(coreAddress, corePort);
+	ServiceRecord storageRecord("Fledge Storage");
+	if (!management.getService(storageRecord))
+	{
+		fprintf(stderr, "Unable to find the storage service through the core at %s:%d\n",
+				coreAddress.c_str(), corePort);
+		return 1;
+	}
+	StorageClient storage(storageRecord.getAddress(), storageRecord.getPort());
+	storage.setAppendMode(appendMode);
+
+	AssetTracker tracker(&management, SERVICE_NAME_BENCHMARK);
+	SyntheticSource source(assets, datapoints, shape, arraySize);
+
+	ProcessSample storageStart, storageEnd;
+	if (storagePid && !storageStart.sample(storagePid))
+	{
+		fprintf(stderr, "Unable to sample the storage service process %d\n", storagePid);
+		storagePid = 0;
+	}
+
+	unsigned long generated = 0, stored = 0;
+	double meanLatency = 0.0, maxLatency = 0.0;
+	size_t peakQueued = 0;
+	double elapsed;
+	{
+		Ingest ingest(storage, timeout, threshold, SERVICE_NAME_BENCHMARK,
+				PLUGIN_NAME_BENCHMARK, &management);
+
+		// Only count the allocations of the readings that are ingested
+		AllocProfiler::reset();
+		steady_clock::time_point start = steady_clock::now();
+		steady_clock::time_point end = start + seconds(runTime);
+		steady_clock::time_point next = start;
+		steady_clock::time_point report = start + seconds(1);
+		unsigned long lastStored = 0;
+		while (steady_clock::now() < end)
+		{
+			vector<Reading *> *readings = source.generate(burst);
+			ingest.ingest(readings);
+			delete readings;
+			generated += burst;
+			size_t queued = ingest.memoryUsage();
+			if (queued > peakQueued)
+			{
+				peakQueued = queued;
+			}
+			if (rate)
+			{
+				next += duration_cast<steady_clock::duration>(duration<double>((double)burst / rate));
+				this_thread::sleep_until(next);
+			}
+			if (steady_clock::now() >= report)
+			{
+				stored = ingest.getCommitLatency(meanLatency, maxLatency);
+				fprintf(stderr, "%lu readings/s, %lu queued\n", stored - lastStored, generated - stored);
+				lastStored = stored;
+				report += seconds(1);
+			}
+		}
+
+		// Wait for the queued readings to be committed, readings discarded
+		// because the ingest memory limit was reached are never stored
+		steady_clock::time_point drained = steady_clock::now() + seconds(DRAIN_TIMEOUT);
+		while ((stored = ingest.getCommitLatency(meanLatency, maxLatency)) < generated
+				&& steady_clock::now() < drained)
+		{
+			this_thread::sleep_for(milliseconds(100));
+		}
+		elapsed = duration_cast<duration<double>>(steady_clock::now() - start).count();
+	}
+	if (storagePid)
+	{
+		storageEnd.sample(storagePid);
+	}
+	ProcessSample self;
+	self.sample(getpid());
+
+	ostringstream json;
+	json << "{ \"label\" : \"" << label << "\", \"mode\" : \"" << mode << "\"";
+	json << ", \"assets\" : " << assets << ", \"datapoints\" : " << datapoints;
+	json << ", \"shape\" : \"" << shapeName << "\", \"rate\" : " << rate;
+	json << ", \"burst\" : " << burst << ", \"duration\" : " << elapsed;
+	json << ", \"generated\" : " << generated << ", \"stored\" : " << stored;
+	json << ", \"readingsPerSecond\" : " << (elapsed > 0.0 ? stored / elapsed : 0.0);
+	json << ", \"latency\" : { \"mean\" : " << meanLatency << ", \"max\" : " << maxLatency << " }";
+	if (storagePid)
+	{
+		json << ", \"storage\" : { \"cpu\" : " << (storageEnd.cpu - storageStart.cpu) * 100.0 / elapsed;
+		json << ", \"rss\" : " << storageEnd.rss << ", \"peakRss\" : " << storageEnd.peakRss << " }";
+	}
+	json << ", \"ingest\" : { \"peakQueued\" : " << peakQueued;
+	json << ", \"peakRss\" : " << self.peakRss << " }";
+	if (AllocProfiler::isEnabled())
+	{
+		string allocations;
+		AllocProfiler::asJSON(allocations);
+		json << ", \"allocations\" : " << allocations;
+	}
+	json << " }";
+
+	if (output.empty())
+	{
+		printf("%s\n", json.str().c_str());
+	}
+	else
+	{
+		ofstream out(output);
+		out << json.str() << endl;
+	}
+	return stored == generated ? 0 : 2;
+}
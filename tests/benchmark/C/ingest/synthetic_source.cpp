@@ -0,0 +1,125 @@
+/*
+ * Fledge ingest benchmark synthetic reading source.
+ *
+ * Copyright (c) 2026 Dianomic Systems
+ *
+ * Released under the Apache 2.0 Licence
+ *
+ * Author: agent
+ */
+#include <synthetic_source.h>
+
+using namespace std;
+
+/**
+ * Construct a synthetic source
+ *
+ * @param assets	The number of assets to spread the readings over
+ * @param datapoints	The number of datapoints in each reading
+ * @param shape		The shape of each datapoint
+ * @param arraySize	The number of elements in array datapoints
+ */
+SyntheticSource::SyntheticSource(unsigned int assets, unsigned int datapoints,
+				 Shape shape, unsigned int arraySize) :
+					m_shape(shape), m_arraySize(arraySize), m_sequence(0)
+{
+	for (unsigned int i = 0; i < assets; i++)
+	{
+		m_assets.push_back("synthetic" + to_string(i + 1));
+	}
+	for (unsigned int i = 0; i < datapoints; i++)
+	{
+		m_names.push_back("dp" + to_string(i + 1));
+	}
+}
+
+/**
+ * Parse the name of a datapoint shape
+ *
+ * @param name	The name of the shape
+ * @param shape	Set to the shape
+ * @return bool	True if the name is a valid shape
+ */
+bool SyntheticSource::parseShape(const string& name, Shape& shape)
+{
+	if (name.compare("numeric") == 0)
+		shape = Numeric;
+	else if (name.compare("string") == 0)
+		shape = String;
+	else if (name.compare("array") == 0)
+		shape = Array;
+	else if (name.compare("nested") == 0)
+		shape = Nested;
+	else
+		return false;
+	return true;
+}
+
+/**
+ * Generate a block of readings. The caller takes ownership of the
+ * vector and the readings in it.
+ *
+ * @param count	The number of readings to generate
+ * @return vector	The readings
+ */
+vector<Reading *> *SyntheticSource::generate(unsigned int count)
+{
+	vector<Reading *> *readings = new vector<Reading *>;
+	readings->reserve(count);
+	for (unsigned int i = 0; i < count; i++)
+	{
+		vector<Datapoint *> values;
+		for (auto& name : m_names)
+		{
+			values.push_back(createDatapoint(name));
+		}
+		readings->push_back(new Reading(m_assets[m_sequence % m_assets.size()], values));
+		m_sequence++;
+	}
+	return readings;
+}
+
+/**
+ * Create a datapoint of the configured shape whose value depends on
+ * the sequence number of the reading
+ *
+ * @param name		The name of the datapoint
+ * @return Datapoint*	The new datapoint
+ */
+Datapoint *SyntheticSource::createDatapoint(const string& name)
+{
+	switch (m_shape)
+	{
+		case String:
+		{
+			DatapointValue value("value " + to_string(m_sequence));
+			return new Datapoint(name, value);
+		}
+		case Array:
+		{
+			vector<double> elements;
+			for (unsigned int i = 0; i < m_arraySize; i++)
+			{
+				elements.push_back((double)(m_sequence + i) / 10.0);
+			}
+			DatapointValue value(elements);
+			return new Datapoint(name, value);
+		}
+		case Nested:
+		{
+			vector<Datapoint *> *children = new vector<Datapoint *>;
+			DatapointValue integer((long)m_sequence);
+			children->push_back(new Datapoint("count", integer));
+			DatapointValue real((double)m_sequence / 100.0);
+			children->push_back(new Datapoint("value", real));
+			DatapointValue value(children, true);
+			return new Datapoint(name, value);
+		}
+		case Numeric:
+		default:
+		{
+			DatapointValue value((double)m_sequence / 100.0);
+			return new Datapoint(name, value);
+		}
+	}
+}
@@ -0,0 +1,44 @@
+#ifndef _SYNTHETIC_SOURCE_H
+#define _SYNTHETIC_SOURCE_H
+/*
+ * Fledge ingest benchmark synthetic reading source.
+ *
+ * Copyright (c) 2026 Dianomic Systems
+ *
+ * Released under the Apache 2.0 Licence
+ *
+ * Author: agent
+ */
+#include <reading.h>
+#include <string>
+#include <vector>
+
+/**
+ * A source of synthetic readings that stands in for a south plugin.
+ *
+ * The readings are spread in turn over a number of assets, each reading
+ * has the same number of datapoints and every datapoint has the same
+ * shape. The values change with every reading so that the storage
+ * plugins can not take advantage of repeated values.
+ */
+class SyntheticSource {
+	public:
+		enum Shape { Numeric, String, Array, Nested };
+
+		SyntheticSource(unsigned int assets, unsigned int datapoints,
+				Shape shape, unsigned int arraySize);
+		std::vector<Reading *>	*generate(unsigned int count);
+		static bool		parseShape(const std::string& name, Shape& shape);
+	private:
+		Datapoint		*createDatapoint(const std::string& name);
+	private:
+		std::vector<std::string>
+					m_assets;
+		std::vector<std::string>
+					m_names;
+		Shape			m_shape;
+		unsigned int		m_arraySize;
+		unsigned long		m_sequence;
+};
+
+#endif
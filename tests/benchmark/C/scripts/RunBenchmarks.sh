@@ -0,0 +1,46 @@
+#!/bin/sh
+#
+# This is the shell script wrapper for running the C benchmarks.
+# The results of each benchmark target are written as JSON to the
+# results directory, named after the directory of the target.
+#
+jobs="-j 4"
+if [ "$1" != "" ]; then
+  jobs="$1"
+fi
+
+if [ "$FLEDGE_ROOT" = "" ]; then
+	echo You must set FLEDGE_ROOT before running this script
+	exit -1
+fi
+exitstate=0
+
+cd $FLEDGE_ROOT/tests/benchmark/C
+if [ ! -d results ] ; then
+	mkdir results
+fi
+
+# The ingest benchmark needs a running Fledge and is run by RunIngestBenchmark.sh,
+# the storage plugin benchmark is run by hand against a data directory
+cmakefile=`find . -name CMakeLists.txt -not -path './ingest/*' -not -path './storage/*'`
+for f in $cmakefile; do
+	dir=`dirname $f`
+	file=`echo $dir | sed -e 's#./##' -e 's#/#_#g'`
+	echo Benchmarking $dir
+	(
+		cd $dir;
+		rm -rf build;
+		mkdir build;
+		cd build;
+		cmake -DCMAKE_BUILD_TYPE=Release .. || exit 1
+		make ${jobs} || exit 1
+		./RunBenchmarks --benchmark_out=$FLEDGE_ROOT/tests/benchmark/C/results/${file}.json \
+			--benchmark_out_format=json
+	)
+	rc=$?
+	if [ $rc != 0 ]; then
+		echo Benchmarks for $dir failed
+		exitstate=1
+	fi
+done
+exit $exitstate
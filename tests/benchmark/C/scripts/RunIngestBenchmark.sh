@@ -0,0 +1,84 @@
+#!/bin/sh
+#
+# This is the shell script wrapper for running the ingest benchmark.
+# The benchmark is run against the running Fledge for each of the
+# reading plugins in PLUGINS and each of the append modes in MODES.
+# Fledge is restarted after the reading plugin is changed. Any
+# arguments are passed to the benchmark. The results of each run are
+# written as JSON to the results directory, named after the plugin
+# and the mode.
+#
+if [ "$FLEDGE_ROOT" = "" ]; then
+	echo You must set FLEDGE_ROOT before running this script
+	exit -1
+fi
+if [ "$PLUGINS" = "" ]; then
+	PLUGINS="sqlite sqlitelb sqlitememory postgres"
+fi
+if [ "$MODES" = "" ]; then
+	MODES="rest stream shared"
+fi
+if [ "$REST_API" = "" ]; then
+	REST_API="http://localhost:8081"
+fi
+exitstate=0
+
+cd $FLEDGE_ROOT/tests/benchmark/C
+if [ ! -d results ] ; then
+	mkdir results
+fi
+
+(
+	cd ingest;
+	rm -rf build;
+	mkdir build;
+	cd build;
+	cmake -DCMAKE_BUILD_TYPE=Release .. || exit 1
+	make -j 4 || exit 1
+) || exit 1
+
+# Wait for the core to answer a ping
+wait_for_fledge() {
+	n=0
+	while [ $n -lt 60 ]; do
+		curl -s -f $REST_API/fledge/ping > /dev/null && return 0
+		sleep 1
+		n=`expr $n + 1`
+	done
+	return 1
+}
+
+for plugin in $PLUGINS; do
+	echo Benchmarking the $plugin reading plugin
+	curl -s -f -X PUT $REST_API/fledge/category/Storage/readingPlugin \
+		-d "{\"value\" : \"$plugin\"}" > /dev/null
+	if [ $? != 0 ]; then
+		echo Unable to set the reading plugin to $plugin
+		exitstate=1
+		continue
+	fi
+	$FLEDGE_ROOT/scripts/fledge stop
+	$FLEDGE_ROOT/scripts/fledge start
+	if ! wait_for_fledge; then
+		echo Fledge did not restart with the $plugin reading plugin
+		exitstate=1
+		continue
+	fi
+	port=`curl -s $REST_API/fledge/service | python3 -c '
+import json, sys
+for service in json.load(sys.stdin)["services"]:
+    if service["type"] == "Core":
+        print(service["management_port"])'`
+	pid=`pgrep -f fledge.services.storage | head -1`
+	for mode in $MODES; do
+		echo Benchmarking $mode appends
+		./ingest/build/IngestBenchmark --core-port=$port --storage-pid=$pid \
+			--mode=$mode --label=$plugin \
+			--output=results/ingest_${plugin}_${mode}.json "$@"
+		if [ $? != 0 ]; then
+			echo The ingest benchmark of $mode appends to $plugin failed
+			exitstate=1
+		fi
+	done
+done
+exit $exitstate
@@ -0,0 +1,74 @@
+#!/bin/sh
+#
+# This is the shell script wrapper for the performance check of the C code.
+# The benchmark suites are built with FLEDGE_PERF_BUILD, tuned for the host
+# with link time optimisation, the results of each suite are written as JSON
+# to the results directory and compared with the baseline of the suite in
+# the baselines directory.
+#
+# With --baseline the results are stored as the new baselines in place of
+# being compared.
+#
+jobs="-j 4"
+update=0
+for arg in "$@"; do
+	case $arg in
+		--baseline)
+			update=1
+			;;
+		*)
+			jobs="$arg"
+			;;
+	esac
+done
+
+if [ "$FLEDGE_ROOT" = "" ]; then
+	echo You must set FLEDGE_ROOT before running this script
+	exit -1
+fi
+exitstate=0
+
+cd $FLEDGE_ROOT/tests/benchmark/C
+if [ ! -d results ] ; then
+	mkdir results
+fi
+
+# The ingest benchmark needs a running Fledge and the storage plugin benchmark
+# a data directory, only the Google Benchmark suites are checked
+cmakefile=`find . -name CMakeLists.txt -not -path './ingest/*' -not -path './storage/*'`
+for f in $cmakefile; do
+	dir=`dirname $f`
+	file=`echo $dir | sed -e 's#./##' -e 's#/#_#g'`
+	echo Benchmarking $dir
+	(
+		cd $dir;
+		rm -rf build;
+		mkdir build;
+		cd build;
+		cmake -DCMAKE_BUILD_TYPE=Release -DFLEDGE_PERF_BUILD=ON .. || exit 1
+		make ${jobs} || exit 1
+		./RunBenchmarks --benchmark_out=$FLEDGE_ROOT/tests/benchmark/C/results/${file}.json \
+			--benchmark_out_format=json --benchmark_repetitions=5 \
+			--benchmark_report_aggregates_only=true
+	)
+	rc=$?
+	if [ $rc != 0 ]; then
+		echo Benchmarks for $dir failed
+		exitstate=1
+		continue
+	fi
+	if [ $update = 1 ]; then
+		cp results/${file}.json baselines/${file}.json
+		echo Stored the baseline of $dir
+	elif [ -f baselines/${file}.json ]; then
+		python3 scripts/compare_benchmarks.py --tolerances=baselines/tolerances.json \
+			baselines/${file}.json results/${file}.json
+		if [ $? != 0 ]; then
+			echo Benchmarks for $dir are slower than the baseline
+			exitstate=1
+		fi
+	else
+		echo There is no baseline for $dir, run make perf-baseline to record one
+	fi
+done
+exit $exitstate
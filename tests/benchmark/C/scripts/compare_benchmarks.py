@@ -0,0 +1,142 @@
+#!/usr/bin/env python3
+# -*- coding: utf-8 -*-
+
+# FLEDGE_BEGIN
+# See: http://fledge-iot.readthedocs.io/
+# FLEDGE_END
+
+""" Compare the results of a run of a Google Benchmark suite with a stored baseline
+
+The CPU time of each benchmark of the baseline is compared with the time of the
+same benchmark in the results. A benchmark that is slower than the baseline by
+more than its tolerance, or that is missing from the results, is a regression
+and the tool exits with a status of 1.
+
+The tolerances are read from a JSON file of the form
+
+    {
+        "default": 10,
+        "benchmarks": { "BM_ReadingSetParse/1000": 15 }
+    }
+
+where the tolerances are the percentage by which a benchmark may be slower than
+the baseline. A benchmark is matched by its full name, then by the name without
+its arguments.
+"""
+
+import argparse
+import json
+import sys
+
+__author__ = "agent"
+__copyright__ = "Copyright (c) 2026 Dianomic Systems"
+__license__ = "Apache 2.0"
+__version__ = "${VERSION}"
+
+DEFAULT_TOLERANCE = 10.0
+
+_UNITS = {"ns": 1.0, "us": 1e3, "ms": 1e6, "s": 1e9}
+
+
+def load_results(path):
+    """ Return the context and the CPU time in nanoseconds of each benchmark of a results file
+
+    Only the iterations of a benchmark are compared, the aggregates such as the mean
+    of repetitions are used in place of the iterations when they are present.
+    """
+    with open(path) as f:
+        doc = json.load(f)
+    times = {}
+    aggregates = {}
+    for bm in doc.get("benchmarks", []):
+        if "error_occurred" in bm and bm["error_occurred"]:
+            continue
+        cpu = float(bm["cpu_time"]) * _UNITS.get(bm.get("time_unit", "ns"), 1.0)
+        if bm.get("run_type") == "aggregate":
+            if bm.get("aggregate_name") == "median":
+                aggregates[bm["run_name"]] = cpu
+        else:
+            times[bm.get("run_name", bm["name"])] = cpu
+    times.update(aggregates)
+    return doc.get("context", {}), times
+
+
+def load_tolerances(path):
+    """ Return the default tolerance and the tolerances of named benchmarks """
+    if path is None:
+        return DEFAULT_TOLERANCE, {}
+    with open(path) as f:
+        doc = json.load(f)
+    return float(doc.get("default", DEFAULT_TOLERANCE)), doc.get("benchmarks", {})
+
+
+def tolerance_of(name, default, tolerances):
+    if name in tolerances:
+        return float(tolerances[name])
+    base = name.split("/")[0]
+    if base in tolerances:
+        return float(tolerances[base])
+    return default
+
+
+def check_context(baseline, results):
+    """ Warn when the results were not measured on a machine like that of the baseline """
+    warnings = []
+    for key in ("num_cpus", "mhz_per_cpu", "library_build_type"):
+        if key in baseline and key in results and baseline[key] != results[key]:
+            warnings.append("{} was {} for the baseline and is {}".format(key, baseline[key], results[key]))
+    return warnings
+
+
+def compare(baseline, results, default, tolerances):
+    """ Return the report lines and the number of regressions """
+    lines = []
+    regressions = 0
+    width = max([len(name) for name in baseline] + [9])
+    lines.append("{:<{w}}  {:>14}  {:>14}  {:>8}  {:>9}".format("Benchmark", "Baseline ns", "Result ns",
+                                                               "Change", "Tolerance", w=width))
+    for name in sorted(baseline):
+        tolerance = tolerance_of(name, default, tolerances)
+        if name not in results:
+            lines.append("{:<{w}}  {:>14.1f}  {:>14}  {:>8}  {:>8.1f}%  MISSING".format(
+                name, baseline[name], "-", "-", tolerance, w=width))
+            regressions += 1
+            continue
+        change = (results[name] - baseline[name]) * 100.0 / baseline[name] if baseline[name] > 0 else 0.0
+        status = ""
+        if change > tolerance:
+            status = "REGRESSION"
+            regressions += 1
+        elif change < -tolerance:
+            status = "faster"
+        lines.append("{:<{w}}  {:>14.1f}  {:>14.1f}  {:>+7.1f}%  {:>8.1f}%  {}".format(
+            name, baseline[name], results[name], change, tolerance, status, w=width).rstrip())
+    for name in sorted(set(results) - set(baseline)):
+        lines.append("{:<{w}}  {:>14}  {:>14.1f}  {:>8}  {:>9}  new".format(
+            name, "-", results[name], "-", "-", w=width))
+    return lines, regressions
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Compare benchmark results with a baseline")
+    parser.add_argument("baseline", help="The JSON results of the baseline")
+    parser.add_argument("results", help="The JSON results to compare with the baseline")
+    parser.add_argument("--tolerances", help="The JSON file of the tolerances of the benchmarks")
+    args = parser.parse_args()
+
+    base_context, baseline = load_results(args.baseline)
+    context, results = load_results(args.results)
+    default, tolerances = load_tolerances(args.tolerances)
+
+    for warning in check_context(base_context, context):
+        print("Warning: " + warning + ", the comparison may not be meaningful")
+    lines, regressions = compare(baseline, results, default, tolerances)
+    print("\n".join(lines))
+    if regressions:
+        print("{} benchmarks are slower than the baseline allows".format(regressions))
+        return 1
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -0,0 +1,251 @@
+/*
+ * Fledge north service OMF benchmarks.
+ *
+ * Runs the DataLoad and DataSender classes of the north service and the
+ * OMF plugin against an in process mock of the storage service, the core
+ * and an OMF endpoint.
+ *
+ * Copyright (c) 2026 Dianomic Systems
+ *
+ * Released under the Apache 2.0 Licence
+ *
+ * Author: agent
+ */
+#include <benchmark/benchmark.h>
+#include <mock_server.h>
+#include <data_load.h>
+#include <data_sender.h>
+#include <north_service.h>
+#include <north_plugin.h>
+#include <plugin_manager.h>
+#include <management_client.h>
+#include <storage_client.h>
+#include <asset_tracking.h>
+#include <config_category.h>
+#include <logger.h>
+#include <dirent.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <fstream>
+#include <sstream>
+
+#define NORTH_NAME	"OMFBenchmark"
+#define BENCH_READINGS	10000	// Readings each iteration waits to be sent
+#define BENCH_TIMEOUT	60	// Seconds to wait for the readings of an iteration
+
+using namespace std;
+
+/**
+ * A north service that is never started, it provides the name of the
+ * service and its management client to the data sender
+ */
+class BenchmarkService : public NorthService {
+	public:
+		BenchmarkService(ManagementClient *management) : NorthService(NORTH_NAME)
+		{
+			m_mgtClient = management;
+		};
+};
+
+/**
+ * The mock server and the clients connected to it are shared by all of
+ * the benchmarks
+ */
+class BenchmarkEnvironment {
+	public:
+		BenchmarkEnvironment() :
+			management("127.0.0.1", server.getPort()),
+			tracker(&management, NORTH_NAME),
+			service(&management)
+		{
+			Logger::getLogger()->setMinLevel("error");
+			setenv("FLEDGE_PLUGIN_PATH", OMF_PLUGIN_PATH, 0);
+			handle = PluginManager::getInstance()->loadPlugin("OMF", PLUGIN_TYPE_NORTH);
+		};
+		static BenchmarkEnvironment *getInstance()
+		{
+			static BenchmarkEnvironment environment;
+			return &environment;
+		};
+		MockServer		server;
+		ManagementClient	management;
+		AssetTracker		tracker;
+		BenchmarkService	service;
+		PLUGIN_HANDLE		handle;
+};
+
+/**
+ * Return the CPU seconds used by the threads of the north data path.
+ * The threads are named by the north service and threads created by
+ * the plugin inherit the name of the sending thread that created them.
+ */
+static double northCPU()
+{
+	double cpu = 0.0;
+	DIR *dir = opendir("/proc/self/task");
+	if (!dir)
+	{
+		return cpu;
+	}
+	struct dirent *entry;
+	while ((entry = readdir(dir)) != NULL)
+	{
+		if (entry->d_name[0] == '.')
+			continue;
+		string task = string("/proc/self/task/") + entry->d_name;
+		string comm;
+		ifstream commFile(task + "/comm");
+		if (!getline(commFile, comm) || comm.compare(0, 6, "north-") != 0)
+			continue;
+		ifstream statFile(task + "/stat");
+		string line;
+		if (!getline(statFile, line))
+			continue;
+		size_t pos = line.rfind(')');
+		if (pos == string::npos)
+			continue;
+		istringstream fields(line.substr(pos + 2));
+		string field;
+		unsigned long ticks = 0;
+		// utime and stime are the 12th and 13th fields after the command name
+		for (int i = 1; i <= 13 && fields >> field; i++)
+		{
+			if (i >= 12)
+				ticks += strtoul(field.c_str(), NULL, 10);
+		}
+		cpu += (double)ticks / sysconf(_SC_CLK_TCK);
+	}
+	closedir(dir);
+	return cpu;
+}
+
+/**
+ * The north data path of a service: the OMF plugin, the data loading
+ * and the sending threads
+ */
+class NorthPipeline {
+	public:
+		NorthPipeline(BenchmarkEnvironment *env, unsigned long blockSize,
+				bool compression, unsigned int threads) :
+			m_storage("127.0.0.1", env->server.getPort())
+		{
+			const PLUGIN_INFORMATION *info = PluginManager::getInstance()->getInfo(env->handle);
+			ConfigCategory config(NORTH_NAME, info->config);
+			config.setItemsValueFromDefault();
+			config.setValue("PIServerEndpoint", "Edge Data Store");
+			config.setValue("ServerPort", to_string(env->server.getPort()));
+			config.setValue("compression", compression ? "true" : "false");
+			config.setValue("OMFRetrySleepTime", "0");
+			m_plugin = new NorthPlugin(env->handle, config);
+			if (m_plugin->persistData())
+				m_plugin->startData("{}");
+			else
+				m_plugin->start();
+
+			m_load = new DataLoad(m_name, 1, &m_storage, &env->management);
+			m_load->setBlockSize(blockSize);
+			m_sender = new DataSender(m_plugin, m_load, &env->service, threads);
+		};
+		~NorthPipeline()
+		{
+			m_load->shutdown();
+			delete m_sender;
+			delete m_load;
+			if (m_plugin->persistData())
+				m_plugin->shutdownSaveData();
+			else
+				m_plugin->shutdown();
+			delete m_plugin;
+		};
+	private:
+		const string		m_name = NORTH_NAME;
+		StorageClient		m_storage;
+		NorthPlugin		*m_plugin;
+		DataLoad		*m_load;
+		DataSender		*m_sender;
+};
+
+/**
+ * Run the north data path and report the readings sent per second, the
+ * bytes sent to the OMF endpoint, the CPU time of the data path per
+ * thousand readings and the lag from fetching a block of readings to
+ * the acknowledgement of the block
+ */
+static void runNorth(benchmark::State& state, unsigned long blockSize, bool compression,
+		unsigned int threads, unsigned int latency, unsigned int errorRate,
+		size_t responseSize)
+{
+	BenchmarkEnvironment *env = BenchmarkEnvironment::getInstance();
+	MockServer& server = env->server;
+	server.setLatency(latency);
+	server.setErrorRate(errorRate);
+	server.setResponseSize(responseSize);
+
+	NorthPipeline pipeline(env, blockSize, compression, threads);
+
+	// Let the plugin create its types before measuring
+	if (!server.waitForSent(server.getLastSent() + blockSize, BENCH_TIMEOUT))
+	{
+		state.SkipWithError("No readings sent to the mock OMF endpoint");
+		return;
+	}
+	server.resetStatistics();
+	unsigned long first = server.getLastSent();
+	double cpu = northCPU();
+
+	for (auto _ : state)
+	{
+		if (!server.waitForSent(server.getLastSent() + BENCH_READINGS, BENCH_TIMEOUT))
+		{
+			state.SkipWithError("Timed out waiting for readings to be sent");
+			break;
+		}
+	}
+
+	unsigned long sent = server.getLastSent() - first;
+	cpu = northCPU() - cpu;
+	MockStatistics stats = server.getStatistics();
+	state.SetItemsProcessed(sent);
+	state.SetBytesProcessed(stats.bytes);
+	state.counters["cpu_ms_per_1k"] = sent ? cpu * 1000000.0 / sent : 0.0;
+	state.counters["lag_ms"] = stats.blocks ? stats.lagSum * 1000.0 / stats.blocks : 0.0;
+	state.counters["lag_max_ms"] = stats.lagMax * 1000.0;
+	state.counters["requests"] = stats.requests;
+	state.counters["errors"] = stats.errors;
+}
+
+/**
+ * Arguments are the block size, compression and sending threads
+ */
+static void BM_NorthOMF(benchmark::State& state)
+{
+	runNorth(state, state.range(0), state.range(1), state.range(2), 0, 0, 0);
+}
+BENCHMARK(BM_NorthOMF)
+	->ArgNames({ "block", "compress", "threads" })
+	->ArgsProduct({ { 100, 500, 2000 }, { 0, 1 }, { 1, 4 } })
+	->Unit(benchmark::kMillisecond)->UseRealTime();
+
+/**
+ * Arguments are the latency of the endpoint in milliseconds, the sending
+ * threads and the size of the responses
+ */
+static void BM_NorthOMFLatency(benchmark::State& state)
+{
+	runNorth(state, 500, true, state.range(1), state.range(0), 0, state.range(2));
+}
+BENCHMARK(BM_NorthOMFLatency)
+	->ArgNames({ "latency", "threads", "response" })
+	->ArgsProduct({ { 10, 100 }, { 1, 4, 8 }, { 0, 16384 } })
+	->Unit(benchmark::kMillisecond)->UseRealTime();
+
+/**
+ * The argument is the percentage of OMF requests that fail
+ */
+static void BM_NorthOMFErrors(benchmark::State& state)
+{
+	runNorth(state, 500, true, 1, 0, state.range(0), 0);
+}
+BENCHMARK(BM_NorthOMFErrors)
+	->ArgName("errors")->Arg(1)->Arg(10)
+	->Unit(benchmark::kMillisecond)->UseRealTime();
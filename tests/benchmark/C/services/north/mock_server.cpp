@@ -0,0 +1,299 @@
+/*
+ * Fledge north benchmark mock server.
+ *
+ * Copyright (c) 2026 Dianomic Systems
+ *
+ * Released under the Apache 2.0 Licence
+ *
+ * Author: agent
+ */
+#include <mock_server.h>
+#include <rapidjson/document.h>
+#include <future>
+#include <sstream>
+#include <stdlib.h>
+#include <sys/time.h>
+#include <time.h>
+
+#define MOCK_ASSETS	10	// Assets the synthetic readings are spread over
+
+using namespace std;
+using namespace rapidjson;
+
+/**
+ * Start the mock server on a free port
+ */
+MockServer::MockServer() : m_port(0), m_latency(0), m_errorRate(0), m_lastSent(0)
+{
+	resetStatistics();
+	setResponseSize(0);
+
+	m_server.config.port = 0;
+	m_server.config.address = "127.0.0.1";
+	m_server.config.thread_pool_size = MOCK_THREADS;
+
+	m_server.resource["^/storage/reading$"]["GET"] = [this](Response response, Request request) {
+		fetchReadings(response, request);
+	};
+	m_server.resource["^/storage/(schema/[^/]+/)?table/([^/]+)/query$"]["PUT"] = [this](Response response, Request request) {
+		queryTable(response, request);
+	};
+	m_server.resource["^/storage/(schema/[^/]+/)?table/([^/]+)$"]["PUT"] = [this](Response response, Request request) {
+		updateTable(response, request);
+	};
+	m_server.resource["^/storage/(schema/[^/]+/)?table/([^/]+)$"]["POST"] = [this](Response response, Request request) {
+		insertTable(response, request);
+	};
+	m_server.resource["^/fledge/service/category/.*$"]["GET"] = [this](Response response, Request) {
+		respond(response, "200 OK", "{ }");
+	};
+	m_server.resource["^/fledge/track.*$"]["GET"] = [this](Response response, Request) {
+		respond(response, "200 OK", "{ \"track\" : [ ] }");
+	};
+	m_server.resource["^/fledge/track$"]["POST"] = [this](Response response, Request) {
+		respond(response, "200 OK", "{ \"fledge\" : \"tracked\" }");
+	};
+	m_server.resource["^" MOCK_OMF_PATH "$"]["POST"] = [this](Response response, Request request) {
+		omfMessage(response, request);
+	};
+
+	promise<unsigned short> listening;
+	m_thread = thread([this, &listening]() {
+		m_server.start([&listening](unsigned short port) {
+			listening.set_value(port);
+		});
+	});
+	m_port = listening.get_future().get();
+}
+
+/**
+ * Stop the mock server
+ */
+MockServer::~MockServer()
+{
+	m_server.stop();
+	m_thread.join();
+}
+
+/**
+ * Set the size of the body of the responses to OMF messages
+ *
+ * @param bytes	The approximate size of the response
+ */
+void MockServer::setResponseSize(size_t bytes)
+{
+	lock_guard<mutex> guard(m_mutex);
+	m_response = "{ \"filler\" : \"" + string(bytes, 'x') + "\" }";
+}
+
+/**
+ * Return the last sent ID of the north stream
+ */
+unsigned long MockServer::getLastSent()
+{
+	lock_guard<mutex> guard(m_mutex);
+	return m_lastSent;
+}
+
+/**
+ * Wait for the last sent ID of the north stream to reach an ID
+ *
+ * @param id		The ID to wait for
+ * @param timeout	The maximum number of seconds to wait
+ * @return bool		True if the ID was reached
+ */
+bool MockServer::waitForSent(unsigned long id, unsigned int timeout)
+{
+	unique_lock<mutex> lck(m_mutex);
+	return m_sentCV.wait_for(lck, chrono::seconds(timeout), [this, id]() {
+			return m_lastSent >= id;
+		});
+}
+
+/**
+ * Reset the counters of the mock server
+ */
+void MockServer::resetStatistics()
+{
+	lock_guard<mutex> guard(m_mutex);
+	m_stats.requests = 0;
+	m_stats.dataRequests = 0;
+	m_stats.bytes = 0;
+	m_stats.errors = 0;
+	m_stats.blocks = 0;
+	m_stats.lagSum = 0.0;
+	m_stats.lagMax = 0.0;
+}
+
+/**
+ * Return the counters of the mock server
+ */
+MockStatistics MockServer::getStatistics()
+{
+	lock_guard<mutex> guard(m_mutex);
+	return m_stats;
+}
+
+/**
+ * Send a response with a JSON payload
+ */
+void MockServer::respond(Response response, const string& status, const string& payload)
+{
+	*response << "HTTP/1.1 " << status << "\r\n"
+		<< "Content-Length: " << payload.length() << "\r\n"
+		<< "Content-type: application/json\r\n\r\n"
+		<< payload;
+}
+
+/**
+ * Return a block of synthetic readings, there is no end to the readings
+ * so every fetch returns the number requested
+ */
+void MockServer::fetchReadings(Response response, Request request)
+{
+	auto query = request->parse_query_string();
+	auto id = query.find("id");
+	auto count = query.find("count");
+	unsigned long first = id == query.end() ? 1 : strtoul(id->second.c_str(), NULL, 10);
+	unsigned long n = count == query.end() ? 100 : strtoul(count->second.c_str(), NULL, 10);
+
+	struct timeval now;
+	gettimeofday(&now, NULL);
+	struct tm tm;
+	gmtime_r(&now.tv_sec, &tm);
+	char ts[80];
+	size_t len = strftime(ts, sizeof(ts), "%Y-%m-%d %H:%M:%S", &tm);
+	snprintf(ts + len, sizeof(ts) - len, ".%06ld", (long)now.tv_usec);
+
+	ostringstream payload;
+	payload << "{ \"count\" : " << n << ", \"rows\" : [ ";
+	for (unsigned long i = 0; i < n; i++)
+	{
+		unsigned long rid = first + i;
+		if (i)
+			payload << ", ";
+		payload << "{ \"id\" : " << rid
+			<< ", \"asset_code\" : \"bench" << rid % MOCK_ASSETS << "\""
+			<< ", \"reading\" : { \"temperature\" : " << (double)(rid % 1000) / 10.0
+			<< ", \"humidity\" : " << (double)(rid % 100) / 2.0
+			<< ", \"count\" : " << rid << " }"
+			<< ", \"user_ts\" : \"" << ts << "\", \"ts\" : \"" << ts << "\" }";
+	}
+	payload << " ] }";
+
+	if (n)
+	{
+		lock_guard<mutex> guard(m_mutex);
+		m_fetched.push_back(make_pair(first + n - 1, chrono::steady_clock::now()));
+	}
+	respond(response, "200 OK", payload.str());
+}
+
+/**
+ * A query of the streams table returns the stream of the benchmark,
+ * other tables have no rows
+ */
+void MockServer::queryTable(Response response, Request request)
+{
+	if (request->path_match[2].str().compare("streams") == 0)
+	{
+		ostringstream payload;
+		payload << "{ \"count\" : 1, \"rows\" : [ { \"id\" : 1, \"last_object\" : "
+			<< getLastSent() << " } ] }";
+		respond(response, "200 OK", payload.str());
+	}
+	else
+	{
+		respond(response, "200 OK", "{ \"count\" : 0, \"rows\" : [ ] }");
+	}
+}
+
+/**
+ * An update of the streams table moves the last sent ID and records the
+ * lag of the blocks it acknowledges, other updates are accepted
+ */
+void MockServer::updateTable(Response response, Request request)
+{
+	if (request->path_match[2].str().compare("streams") == 0)
+	{
+		Document doc;
+		doc.Parse(request->content.string().c_str());
+		if (!doc.HasParseError() && doc.HasMember("updates") && doc["updates"].IsArray())
+		{
+			for (auto& update : doc["updates"].GetArray())
+			{
+				if (update.HasMember("values") && update["values"].HasMember("last_object")
+						&& update["values"]["last_object"].IsNumber())
+				{
+					unsigned long id = update["values"]["last_object"].GetUint64();
+					auto now = chrono::steady_clock::now();
+					lock_guard<mutex> guard(m_mutex);
+					while (!m_fetched.empty() && m_fetched.front().first <= id)
+					{
+						double lag = chrono::duration<double>(now - m_fetched.front().second).count();
+						m_stats.blocks++;
+						m_stats.lagSum += lag;
+						if (lag > m_stats.lagMax)
+							m_stats.lagMax = lag;
+						m_fetched.pop_front();
+					}
+					if (id > m_lastSent)
+						m_lastSent = id;
+					m_sentCV.notify_all();
+				}
+			}
+		}
+	}
+	respond(response, "200 OK", "{ \"response\" : \"updated\", \"rows_affected\" : 1 }");
+}
+
+/**
+ * Inserts are accepted
+ */
+void MockServer::insertTable(Response response, Request)
+{
+	respond(response, "200 OK", "{ \"response\" : \"inserted\", \"rows_affected\" : 1 }");
+}
+
+/**
+ * Accept an OMF message after the configured latency, a proportion of
+ * the messages fail with a 503 response
+ */
+void MockServer::omfMessage(Response response, Request request)
+{
+	bool data = false;
+	auto type = request->header.find("messagetype");
+	if (type != request->header.end() && SimpleWeb::case_insensitive_equal(type->second, "data"))
+	{
+		data = true;
+	}
+	size_t bytes = request->content.size();
+
+	if (m_latency)
+	{
+		this_thread::sleep_for(chrono::milliseconds(m_latency));
+	}
+
+	string payload;
+	bool fail;
+	{
+		lock_guard<mutex> guard(m_mutex);
+		m_stats.requests++;
+		m_stats.bytes += bytes;
+		if (data)
+			m_stats.dataRequests++;
+		// Spread the failures evenly over the requests
+		fail = m_errorRate && (m_stats.requests * m_errorRate) % 100 < m_errorRate;
+		if (fail)
+			m_stats.errors++;
+		payload = m_response;
+	}
+	if (fail)
+	{
+		respond(response, "503 Service Unavailable", payload);
+	}
+	else
+	{
+		respond(response, "200 OK", payload);
+	}
+}
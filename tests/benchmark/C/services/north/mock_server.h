@@ -0,0 +1,92 @@
+#ifndef _MOCK_SERVER_H
+#define _MOCK_SERVER_H
+/*
+ * Fledge north benchmark mock server.
+ *
+ * Copyright (c) 2026 Dianomic Systems
+ *
+ * Released under the Apache 2.0 Licence
+ *
+ * Author: agent
+ */
+#include <server_http.hpp>
+#include <string>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+
+#define MOCK_THREADS	16	// Requests the mock server handles concurrently
+#define MOCK_OMF_PATH	"/api/v1/tenants/default/namespaces/default/omf"
+
+using MockHttpServer = SimpleWeb::Server<SimpleWeb::HTTP>;
+
+/**
+ * The counters of the mock server, reset at the start of each measurement
+ */
+struct MockStatistics {
+	unsigned long	requests;	// OMF requests received
+	unsigned long	dataRequests;	// OMF data messages received
+	unsigned long	bytes;		// Bytes of OMF payload received
+	unsigned long	errors;		// OMF requests failed by error injection
+	unsigned long	blocks;		// Blocks of readings acknowledged
+	double		lagSum;		// Seconds from fetch to acknowledgement of the blocks
+	double		lagMax;
+};
+
+/**
+ * An in process server that stands in for the storage service, the
+ * management API of the core and an OMF endpoint, so that the north
+ * data path can be measured without any external services.
+ *
+ * The storage service serves an endless stream of synthetic readings
+ * and records when each block is fetched, the time until the last
+ * sent ID of the stream passes the block is the lag of the block.
+ * The OMF endpoint accepts the messages of the Edge Data Store
+ * endpoint of the OMF plugin, with a configurable latency, proportion
+ * of requests that fail and size of the response.
+ */
+class MockServer {
+	public:
+		MockServer();
+		~MockServer();
+		unsigned short	getPort() const { return m_port; };
+		void		setLatency(unsigned int milliseconds) { m_latency = milliseconds; };
+		void		setErrorRate(unsigned int percent) { m_errorRate = percent; };
+		void		setResponseSize(size_t bytes);
+		unsigned long	getLastSent();
+		bool		waitForSent(unsigned long id, unsigned int timeout);
+		void		resetStatistics();
+		MockStatistics	getStatistics();
+	private:
+		typedef std::shared_ptr<MockHttpServer::Response> Response;
+		typedef std::shared_ptr<MockHttpServer::Request> Request;
+
+		void		fetchReadings(Response response, Request request);
+		void		queryTable(Response response, Request request);
+		void		updateTable(Response response, Request request);
+		void		insertTable(Response response, Request request);
+		void		omfMessage(Response response, Request request);
+		void		respond(Response response, const std::string& status,
+					const std::string& payload);
+	private:
+		MockHttpServer	m_server;
+		std::thread	m_thread;
+		unsigned short	m_port;
+		std::atomic<unsigned int>
+				m_latency;
+		std::atomic<unsigned int>
+				m_errorRate;
+		std::string	m_response;
+		std::mutex	m_mutex;
+		std::condition_variable
+				m_sentCV;
+		unsigned long	m_lastSent;
+		std::deque<std::pair<unsigned long, std::chrono::steady_clock::time_point>>
+				m_fetched;	// Last ID and time of each block fetched
+		MockStatistics	m_stats;
+};
+
+#endif
@@ -0,0 +1,97 @@
+/*
+ * Fledge storage plugin benchmark latency recorder.
+ *
+ * Copyright (c) 2026 Dianomic Systems
+ *
+ * Released under the Apache 2.0 Licence
+ *
+ * Author: agent
+ */
+#include <latency_recorder.h>
+#include <algorithm>
+#include <sstream>
+
+using namespace std;
+using namespace std::chrono;
+
+/**
+ * Record the latency of a call
+ *
+ * @param usec	The latency in microseconds
+ */
+void LatencyRecorder::record(unsigned long usec)
+{
+	m_samples.push_back(usec);
+	m_sorted = false;
+}
+
+/**
+ * Record the latency of a call that started at a given time and has
+ * just returned
+ *
+ * @param start	The time the call was made
+ */
+void LatencyRecorder::record(steady_clock::time_point start)
+{
+	record((unsigned long)duration_cast<microseconds>(steady_clock::now() - start).count());
+}
+
+/**
+ * Return a percentile of the recorded latencies, using the nearest rank
+ *
+ * @param p	The percentile, between 0 and 100
+ * @return	The latency in microseconds
+ */
+unsigned long LatencyRecorder::percentile(double p)
+{
+	if (m_samples.empty())
+	{
+		return 0;
+	}
+	if (!m_sorted)
+	{
+		sort(m_samples.begin(), m_samples.end());
+		m_sorted = true;
+	}
+	size_t rank = (size_t)(p / 100.0 * m_samples.size() + 0.5);
+	if (rank > 0)
+	{
+		rank--;
+	}
+	return m_samples[min(rank, m_samples.size() - 1)];
+}
+
+/**
+ * Return the mean of the recorded latencies in microseconds
+ */
+double LatencyRecorder::mean() const
+{
+	if (m_samples.empty())
+	{
+		return 0.0;
+	}
+	double sum = 0.0;
+	for (auto sample : m_samples)
+	{
+		sum += sample;
+	}
+	return sum / m_samples.size();
+}
+
+/**
+ * Return the count and percentiles of the latency of the operation as
+ * a JSON object member
+ */
+string LatencyRecorder::toJSON()
+{
+	ostringstream json;
+	json << "\"" << m_name << "\" : { \"count\" : " << getCount();
+	json << ", \"mean\" : " << mean();
+	json << ", \"min\" : " << percentile(0.0);
+	json << ", \"p50\" : " << percentile(50.0);
+	json << ", \"p90\" : " << percentile(90.0);
+	json << ", \"p99\" : " << percentile(99.0);
+	json << ", \"p999\" : " << percentile(99.9);
+	json << ", \"max\" : " << percentile(100.0) << " }";
+	return json.str();
+}
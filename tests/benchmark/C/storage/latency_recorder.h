@@ -0,0 +1,37 @@
+#ifndef _LATENCY_RECORDER_H
+#define _LATENCY_RECORDER_H
+/*
+ * Fledge storage plugin benchmark latency recorder.
+ *
+ * Copyright (c) 2026 Dianomic Systems
+ *
+ * Released under the Apache 2.0 Licence
+ *
+ * Author: agent
+ */
+#include <string>
+#include <vector>
+#include <chrono>
+
+/**
+ * Records the latency of every call of an operation so that exact
+ * percentiles can be reported. The histograms of the storage service
+ * estimate percentiles within fixed buckets, which is too coarse to
+ * compare two configurations of a plugin.
+ */
+class LatencyRecorder {
+	public:
+		LatencyRecorder(const std::string& name) : m_name(name), m_sorted(true) {};
+		void		record(unsigned long usec);
+		void		record(std::chrono::steady_clock::time_point start);
+		unsigned long	getCount() const { return m_samples.size(); };
+		unsigned long	percentile(double p);
+		double		mean() const;
+		std::string	toJSON();
+	private:
+		const std::string		m_name;
+		std::vector<unsigned long>	m_samples;	// Microseconds
+		bool				m_sorted;
+};
+
+#endif
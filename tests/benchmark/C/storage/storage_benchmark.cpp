@@ -0,0 +1,468 @@
+/*
+ * Fledge storage plugin benchmark.
+ *
+ * Loads a storage plugin through the same StoragePlugin interface as the
+ * storage service and runs scripted workloads against it, reporting the
+ * latency percentiles of each operation. The plugin is configured from
+ * its defaults and any items given on the command line, so that the
+ * profiles of a plugin can be compared without running Fledge.
+ *
+ * Copyright (c) 2026 Dianomic Systems
+ *
+ * Released under the Apache 2.0 Licence
+ *
+ * Author: agent
+ */
+#include <latency_recorder.h>
+#include <storage_plugin.h>
+#include <plugin_manager.h>
+#include <config_category.h>
+#include <logger.h>
+#include <rapidjson/document.h>
+#include <getopt.h>
+#include <unistd.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+#include <time.h>
+#include <sys/time.h>
+#include <fstream>
+#include <sstream>
+#include <chrono>
+
+#define BENCHMARK_KEY	"STORAGE_BENCHMARK"	// Statistics key of the common table workload
+#define QUERY_CYCLE	100			// Queries between the deletes of the history rows
+
+using namespace std;
+using namespace std::chrono;
+using namespace rapidjson;
+
+/**
+ * The parameters of the workloads
+ */
+struct Workload {
+	unsigned long	readings;	// Readings appended
+	unsigned int	burst;		// Readings in each append
+	unsigned int	assets;
+	unsigned int	datapoints;
+	unsigned int	span;		// Hours the timestamps of the readings cover
+	unsigned int	fetchBlock;	// Readings in each fetch
+	unsigned int	sweeps;		// Passes of the fetch over the readings
+	unsigned int	queries;	// Cycles of the common table workload
+	unsigned int	purgeSteps;	// Purges the readings are removed in
+};
+
+/**
+ * Format a time as a reading timestamp
+ */
+static string formatTimestamp(double seconds)
+{
+	time_t secs = (time_t)seconds;
+	struct tm tm;
+	gmtime_r(&secs, &tm);
+	char buf[80];
+	size_t len = strftime(buf, sizeof(buf), "%Y-%m-%d %H:%M:%S", &tm);
+	snprintf(buf + len, sizeof(buf) - len, ".%06ld+00:00",
+			(long)((seconds - secs) * 1000000.0));
+	return string(buf);
+}
+
+/**
+ * Append the readings in bursts. The timestamps of the readings are
+ * spread evenly over the span so that the purge by age has readings
+ * to remove.
+ *
+ * @return	The readings per second appended
+ */
+static double appendReadings(StoragePlugin *plugin, const Workload& workload, LatencyRecorder& latency)
+{
+	struct timeval now;
+	gettimeofday(&now, NULL);
+	double oldest = now.tv_sec + now.tv_usec / 1000000.0 - workload.span * 3600.0;
+	double interval = workload.span * 3600.0 / workload.readings;
+
+	double elapsed = 0.0;
+	unsigned long appended = 0;
+	while (appended < workload.readings)
+	{
+		ostringstream payload;
+		payload << "{ \"readings\" : [ ";
+		for (unsigned int i = 0; i < workload.burst && appended < workload.readings; i++, appended++)
+		{
+			if (i)
+				payload << ", ";
+			payload << "{ \"asset_code\" : \"benchmark" << appended % workload.assets << "\"";
+			payload << ", \"user_ts\" : \"" << formatTimestamp(oldest + appended * interval) << "\"";
+			payload << ", \"reading\" : { ";
+			for (unsigned int dp = 0; dp < workload.datapoints; dp++)
+			{
+				if (dp)
+					payload << ", ";
+				payload << "\"dp" << dp + 1 << "\" : " << (double)(appended + dp) / 100.0;
+			}
+			payload << " } }";
+		}
+		payload << " ] }";
+
+		string readings = payload.str();
+		steady_clock::time_point start = steady_clock::now();
+		if (plugin->readingsAppend(readings) < 0)
+		{
+			fprintf(stderr, "Append of readings failed\n");
+			break;
+		}
+		latency.record(start);
+		elapsed += duration_cast<duration<double>>(steady_clock::now() - start).count();
+	}
+	return elapsed > 0.0 ? appended / elapsed : 0.0;
+}
+
+/**
+ * Fetch blocks of readings from the first reading until there are no
+ * more, as a north service that is catching up does
+ *
+ * @return	The ID of the last reading fetched
+ */
+static unsigned long fetchReadings(StoragePlugin *plugin, const Workload& workload, LatencyRecorder& latency)
+{
+	unsigned long last = 0;
+	for (unsigned int sweep = 0; sweep < workload.sweeps; sweep++)
+	{
+		unsigned long id = 1;
+		while (true)
+		{
+			steady_clock::time_point start = steady_clock::now();
+			char *result = plugin->readingsFetch(id, workload.fetchBlock);
+			latency.record(start);
+			if (!result)
+			{
+				fprintf(stderr, "Fetch of readings from %lu failed\n", id);
+				return last;
+			}
+			Document doc;
+			doc.Parse(result);
+			plugin->release(result);
+			if (doc.HasParseError() || !doc.HasMember("rows") || !doc["rows"].IsArray()
+					|| doc["rows"].Empty())
+			{
+				break;
+			}
+			Value& rows = doc["rows"];
+			Value& row = rows[rows.Size() - 1];
+			if (!row.HasMember("id") || !row["id"].IsNumber())
+			{
+				break;
+			}
+			last = row["id"].GetUint64();
+			id = last + 1;
+		}
+	}
+	return last;
+}
+
+/**
+ * Run the mix of common table calls of the services: a query, an
+ * update of a statistic by an expression and an insert into the
+ * history of the statistics. The history rows are deleted in batches.
+ * The calls only touch rows with the key of the benchmark.
+ */
+static void queryTables(StoragePlugin *plugin, const Workload& workload, LatencyRecorder& retrieve,
+		LatencyRecorder& update, LatencyRecorder& insert, LatencyRecorder& deleteRows)
+{
+	const string where = "\"where\" : { \"column\" : \"key\", \"condition\" : \"=\", \"value\" : \"" BENCHMARK_KEY "\" }";
+	const string query = "{ " + where + " }";
+	const string increment = "{ \"updates\" : [ { " + where
+		+ ", \"expressions\" : [ { \"column\" : \"value\", \"operator\" : \"+\", \"value\" : 1 } ] } ] }";
+
+	plugin->commonDelete("statistics", query);
+	plugin->commonDelete("statistics_history", query);
+	plugin->commonInsert("statistics", "{ \"key\" : \"" BENCHMARK_KEY "\", "
+			"\"description\" : \"Storage plugin benchmark\", \"value\" : 0, \"previous_value\" : 0 }");
+
+	struct timeval now;
+	gettimeofday(&now, NULL);
+	double historyTime = now.tv_sec + now.tv_usec / 1000000.0;
+	for (unsigned int i = 0; i < workload.queries; i++)
+	{
+		steady_clock::time_point start = steady_clock::now();
+		char *result = plugin->commonRetrieve("statistics", query);
+		retrieve.record(start);
+		if (result)
+			plugin->release(result);
+
+		start = steady_clock::now();
+		plugin->commonUpdate("statistics", increment);
+		update.record(start);
+
+		// The history has a unique index on the key and the timestamp
+		ostringstream history;
+		history << "{ \"key\" : \"" BENCHMARK_KEY "\", \"value\" : " << i
+			<< ", \"history_ts\" : \"" << formatTimestamp(historyTime + i / 1000.0) << "\" }";
+		start = steady_clock::now();
+		plugin->commonInsert("statistics_history", history.str());
+		insert.record(start);
+
+		if ((i + 1) % QUERY_CYCLE == 0 || i + 1 == workload.queries)
+		{
+			start = steady_clock::now();
+			plugin->commonDelete("statistics_history", query);
+			deleteRows.record(start);
+		}
+	}
+	plugin->commonDelete("statistics", query);
+}
+
+/**
+ * Return the number of readings removed by a purge and release the result
+ */
+static unsigned long purgeResult(StoragePlugin *plugin, char *result)
+{
+	unsigned long removed = 0;
+	if (result)
+	{
+		Document doc;
+		doc.Parse(result);
+		if (!doc.HasParseError() && doc.HasMember("removed") && doc["removed"].IsNumber())
+		{
+			removed = doc["removed"].GetUint64();
+		}
+		plugin->release(result);
+	}
+	return removed;
+}
+
+/**
+ * Purge the readings by age in steps, the first step removes the oldest
+ * readings and the last step all of the readings of the span
+ *
+ * @return	The readings removed
+ */
+static unsigned long purgeByAge(StoragePlugin *plugin, const Workload& workload,
+		unsigned long sent, LatencyRecorder& latency)
+{
+	unsigned long removed = 0;
+	for (unsigned int step = 1; step <= workload.purgeSteps; step++)
+	{
+		unsigned long age = workload.span - (workload.span * step) / workload.purgeSteps;
+		steady_clock::time_point start = steady_clock::now();
+		char *result = plugin->readingsPurge(age, 0, sent);
+		latency.record(start);
+		removed += purgeResult(plugin, result);
+	}
+	return removed;
+}
+
+/**
+ * Purge the readings by the number of rows to retain in steps, the last
+ * step retains no readings
+ *
+ * @return	The readings removed
+ */
+static unsigned long purgeByRows(StoragePlugin *plugin, const Workload& workload,
+		unsigned long sent, LatencyRecorder& latency)
+{
+	unsigned long removed = 0;
+	for (unsigned int step = 1; step <= workload.purgeSteps; step++)
+	{
+		unsigned long rows = workload.readings - (workload.readings * step) / workload.purgeSteps;
+		steady_clock::time_point start = steady_clock::now();
+		char *result = plugin->readingsPurge(rows, STORAGE_PURGE_SIZE, sent);
+		latency.record(start);
+		removed += purgeResult(plugin, result);
+	}
+	return removed;
+}
+
+/**
+ * Write the configuration cache of the plugin from the defaults of the
+ * plugin and the items set on the command line. The cache is written to
+ * the working directory, which the storage plugin configuration reads
+ * in preference to the cache of the Fledge instance.
+ *
+ * @return	True if the cache was written
+ */
+static bool writeConfiguration(const string& name, PLUGIN_HANDLE handle, const vector<string>& items)
+{
+	const PLUGIN_INFORMATION *info = PluginManager::getInstance()->getInfo(handle);
+	ConfigCategory config(name, info->config);
+	config.setItemsValueFromDefault();
+	for (auto& item : items)
+	{
+		size_t pos = item.find('=');
+		if (pos == string::npos || !config.itemExists(item.substr(0, pos)))
+		{
+			fprintf(stderr, "The plugin %s has no configuration item %s\n",
+					name.c_str(), item.c_str());
+			return false;
+		}
+		config.setValue(item.substr(0, pos), item.substr(pos + 1));
+	}
+	ofstream cache(name + ".json");
+	cache << config.itemsToJSON();
+	return cache.good();
+}
+
+static void usage(const char *name)
+{
+	fprintf(stderr, "Usage: %s --plugin=NAME [options]\n", name);
+	fprintf(stderr, "  --plugin=NAME         Storage plugin to load, such as sqlite or sqlitelb\n");
+	fprintf(stderr, "  --set=ITEM=VALUE      Set a configuration item of the plugin, may be repeated\n");
+	fprintf(stderr, "  --workload=LIST       Comma separated workloads to run in order\n");
+	fprintf(stderr, "                        (append,fetch,query,purge-age,append,purge-rows)\n");
+	fprintf(stderr, "  --readings=N          Readings appended by each append workload (100000)\n");
+	fprintf(stderr, "  --burst=N             Readings in each append (100)\n");
+	fprintf(stderr, "  --assets=N            Number of assets (10)\n");
+	fprintf(stderr, "  --datapoints=N        Numeric datapoints per reading (5)\n");
+	fprintf(stderr, "  --span=N              Hours the timestamps of the readings cover (24)\n");
+	fprintf(stderr, "  --fetch-block=N       Readings in each fetch (1000)\n");
+	fprintf(stderr, "  --sweeps=N            Passes of the fetch over the readings (1)\n");
+	fprintf(stderr, "  --queries=N           Cycles of the common table workload (10000)\n");
+	fprintf(stderr, "  --purge-steps=N       Purges the readings are removed in (10)\n");
+	fprintf(stderr, "  --work-dir=DIR        Directory of the configuration cache (current directory)\n");
+	fprintf(stderr, "  --label=LABEL         Label for the results, such as the configuration profile\n");
+	fprintf(stderr, "  --output=FILE         Write the JSON results to FILE rather than stdout\n");
+}
+
+int main(int argc, char *argv[])
+{
+	string pluginName, workloads = "append,fetch,query,purge-age,append,purge-rows";
+	string workDir, label, output;
+	vector<string> items;
+	Workload workload = { 100000, 100, 10, 5, 24, 1000, 1, 10000, 10 };
+
+	static struct option options[] = {
+		{ "plugin", required_argument, 0, 'p' },
+		{ "set", required_argument, 0, 's' },
+		{ "workload", required_argument, 0, 'w' },
+		{ "readings", required_argument, 0, 'r' },
+		{ "burst", required_argument, 0, 'b' },
+		{ "assets", required_argument, 0, 'n' },
+		{ "datapoints", required_argument, 0, 'd' },
+		{ "span", required_argument, 0, 'S' },
+		{ "fetch-block", required_argument, 0, 'f' },
+		{ "sweeps", required_argument, 0, 'F' },
+		{ "queries", required_argument, 0, 'q' },
+		{ "purge-steps", required_argument, 0, 'P' },
+		{ "work-dir", required_argument, 0, 'W' },
+		{ "label", required_argument, 0, 'l' },
+		{ "output", required_argument, 0, 'o' },
+		{ 0, 0, 0, 0 }
+	};
+	int opt;
+	while ((opt = getopt_long(argc, argv, "", options, NULL)) != -1)
+	{
+		switch (opt)
+		{
+			case 'p': pluginName = optarg; break;
+			case 's': items.push_back(optarg); break;
+			case 'w': workloads = optarg; break;
+			case 'r': workload.readings = strtoul(optarg, NULL, 10); break;
+			case 'b': workload.burst = (unsigned int)atoi(optarg); break;
+			case 'n': workload.assets = (unsigned int)atoi(optarg); break;
+			case 'd': workload.datapoints = (unsigned int)atoi(optarg); break;
+			case 'S': workload.span = (unsigned int)atoi(optarg); break;
+			case 'f': workload.fetchBlock = (unsigned int)atoi(optarg); break;
+			case 'F': workload.sweeps = (unsigned int)atoi(optarg); break;
+			case 'q': workload.queries = (unsigned int)atoi(optarg); break;
+			case 'P': workload.purgeSteps = (unsigned int)atoi(optarg); break;
+			case 'W': workDir = optarg; break;
+			case 'l': label = optarg; break;
+			case 'o': output = optarg; break;
+			default:
+				usage(argv[0]);
+				return 1;
+		}
+	}
+	if (pluginName.empty() || workload.readings == 0 || workload.burst == 0 || workload.assets == 0
+			|| workload.fetchBlock == 0 || workload.purgeSteps == 0)
+	{
+		usage(argv[0]);
+		return 1;
+	}
+
+	Logger *logger = new Logger("StorageBenchmark");
+	logger->setMinLevel("warning");
+
+	if (!output.empty() && output[0] != '/')
+	{
+		char cwd[PATH_MAX];
+		if (getcwd(cwd, sizeof(cwd)))
+			output = string(cwd) + "/" + output;
+	}
+	if (!workDir.empty() && chdir(workDir.c_str()) != 0)
+	{
+		fprintf(stderr, "Unable to use the work directory %s\n", workDir.c_str());
+		return 1;
+	}
+
+	PluginManager *manager = PluginManager::getInstance();
+	PLUGIN_HANDLE handle = manager->loadPlugin(pluginName, PLUGIN_TYPE_STORAGE);
+	if (!handle)
+	{
+		fprintf(stderr, "Unable to load the storage plugin %s\n", pluginName.c_str());
+		return 1;
+	}
+	if (!writeConfiguration(pluginName, handle, items))
+	{
+		return 1;
+	}
+	StoragePlugin *plugin = new StoragePlugin(pluginName, handle);
+
+	LatencyRecorder append("append"), fetch("fetch");
+	LatencyRecorder retrieve("retrieve"), update("update"), insert("insert"), deleteRows("delete");
+	LatencyRecorder purgeAge("purge_age"), purgeRows("purge_rows");
+	double appendRate = 0.0;
+	unsigned long sent = 0, purged = 0;
+
+	steady_clock::time_point start = steady_clock::now();
+	stringstream list(workloads);
+	string name;
+	while (getline(list, name, ','))
+	{
+		fprintf(stderr, "Running the %s workload\n", name.c_str());
+		if (name.compare("append") == 0)
+			appendRate = appendReadings(plugin, workload, append);
+		else if (name.compare("fetch") == 0)
+			sent = fetchReadings(plugin, workload, fetch);
+		else if (name.compare("query") == 0)
+			queryTables(plugin, workload, retrieve, update, insert, deleteRows);
+		else if (name.compare("purge-age") == 0)
+			purged += purgeByAge(plugin, workload, sent, purgeAge);
+		else if (name.compare("purge-rows") == 0)
+			purged += purgeByRows(plugin, workload, sent, purgeRows);
+		else
+			fprintf(stderr, "Unknown workload %s ignored\n", name.c_str());
+	}
+	double elapsed = duration_cast<duration<double>>(steady_clock::now() - start).count();
+	plugin->pluginShutdown();
+
+	ostringstream json;
+	json << "{ \"label\" : \"" << label << "\", \"plugin\" : \"" << pluginName << "\"";
+	json << ", \"workload\" : \"" << workloads << "\", \"readings\" : " << workload.readings;
+	json << ", \"burst\" : " << workload.burst << ", \"fetchBlock\" : " << workload.fetchBlock;
+	json << ", \"duration\" : " << elapsed << ", \"appendRate\" : " << appendRate;
+	json << ", \"purged\" : " << purged << ", \"latency\" : { ";
+	bool first = true;
+	for (LatencyRecorder *recorder : { &append, &fetch, &retrieve, &update, &insert, &deleteRows, &purgeAge, &purgeRows })
+	{
+		if (recorder->getCount() == 0)
+			continue;
+		if (!first)
+			json << ", ";
+		json << recorder->toJSON();
+		first = false;
+	}
+	json << " } }";
+
+	if (output.empty())
+	{
+		printf("%s\n", json.str().c_str());
+	}
+	else
+	{
+		ofstream out(output);
+		out << json.str() << endl;
+	}
+	return 0;
+}
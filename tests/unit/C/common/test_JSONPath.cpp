@@ -95,3 +95,71 @@ TEST(MatchNumericJSONPath, JSON)
 	ASSERT_TRUE((*v)["item"].IsInt());
 	ASSERT_EQ(1, (*v)["item"].GetInt());
 }
+
+/**
+ * A path used against more than one document
+ */
+TEST(ReuseJSONPath, JSON)
+{
+	JSONPath jpath("/numeric[1]/child/item");
+	for (int i = 0; i < 2; i++)
+	{
+		Document doc;
+		doc.Parse(testdoc);
+		Value *v = jpath.findNode(doc);
+		ASSERT_TRUE(v->IsInt());
+		ASSERT_EQ(2, v->GetInt());
+	}
+	ASSERT_TRUE(jpath.isStreamable());
+	ASSERT_FALSE(JSONPath("/f[k==l]").isStreamable());
+
+	Document doc;
+	doc.Parse(testdoc);
+	ASSERT_THROW(JSONPath("/c[2]").findNode(doc), runtime_error);
+}
+
+/**
+ * Several paths evaluated in one pass
+ */
+TEST(SetJSONPath, JSON)
+{
+	vector<string> paths = { "/a/b", "/c[1]", "/data/child[0]/item", "/a",
+				"/f[k==l]", "/missing", "/numeric[1]/child", "/c[5]" };
+	JSONPathSet set(paths);
+	ASSERT_EQ(set.size(), paths.size());
+	Document results;
+	ASSERT_TRUE(set.evaluate(testdoc, results));
+	ASSERT_TRUE(results.IsArray());
+	ASSERT_EQ(results.Size(), paths.size());
+	ASSERT_STREQ(results[0].GetString(), "x");
+	ASSERT_STREQ(results[1].GetString(), "e");
+	ASSERT_EQ(results[2].GetInt(), 1);
+	ASSERT_TRUE(results[3].IsObject());
+	ASSERT_STREQ(results[3]["b"].GetString(), "x");
+	ASSERT_TRUE(results[4].IsObject());
+	ASSERT_STREQ(results[4]["m"].GetString(), "n");
+	ASSERT_TRUE(results[5].IsNull());
+	ASSERT_EQ(results[6]["item"].GetInt(), 2);
+	ASSERT_TRUE(results[7].IsNull());
+
+	// The set is reused for another document
+	ASSERT_TRUE(set.evaluate("{ \"a\" : { \"b\" : \"y\" }, \"c\" : [ 1, 2 ] }", results));
+	ASSERT_STREQ(results[0].GetString(), "y");
+	ASSERT_EQ(results[1].GetInt(), 2);
+	ASSERT_TRUE(results[2].IsNull());
+
+	ASSERT_FALSE(set.evaluate("{ \"a\" : ", results));
+}
+
+/**
+ * The parse stops once all the paths have been found
+ */
+TEST(SetEarlyJSONPath, JSON)
+{
+	vector<string> paths = { "/a/b", "/c" };
+	JSONPathSet set(paths);
+	Document results;
+	ASSERT_TRUE(set.evaluate("{ \"a\" : { \"b\" : true }, \"c\" : [ 1, [ 2 ] ], \"d\" : ", results));
+	ASSERT_TRUE(results[0].GetBool());
+	ASSERT_EQ(results[1][1][0].GetInt(), 2);
+}
@@ -0,0 +1,72 @@
+#include <gtest/gtest.h>
+#include <alloc_profiler.h>
+#include <rapidjson/document.h>
+#include <string>
+
+using namespace std;
+using namespace rapidjson;
+
+TEST(AllocProfilerTest, Scope)
+{
+	ASSERT_EQ(AllocProfiler::setStage(ALLOC_UNTAGGED), ALLOC_UNTAGGED);
+	{
+		AllocScope outer(ALLOC_SOUTH_INGEST);
+		{
+			AllocScope inner(ALLOC_FILTER_PIPELINE);
+			ASSERT_EQ(AllocProfiler::setStage(ALLOC_FILTER_PIPELINE), ALLOC_FILTER_PIPELINE);
+		}
+		ASSERT_EQ(AllocProfiler::setStage(ALLOC_SOUTH_INGEST), ALLOC_SOUTH_INGEST);
+	}
+	ASSERT_EQ(AllocProfiler::setStage(ALLOC_UNTAGGED), ALLOC_UNTAGGED);
+}
+
+TEST(AllocProfilerTest, Readings)
+{
+	AllocProfiler::reset();
+	AllocProfiler::readings(ALLOC_NORTH_SEND, 10);
+	AllocProfiler::readings(ALLOC_NORTH_SEND, 5);
+	ASSERT_EQ(AllocProfiler::getReadings(ALLOC_NORTH_SEND), 15UL);
+	ASSERT_EQ(AllocProfiler::getReadings(ALLOC_SOUTH_INGEST), 0UL);
+	AllocProfiler::reset();
+	ASSERT_EQ(AllocProfiler::getReadings(ALLOC_NORTH_SEND), 0UL);
+}
+
+TEST(AllocProfilerTest, Allocations)
+{
+	AllocProfiler::reset();
+	{
+		AllocScope scope(ALLOC_STORAGE_APPEND);
+		for (int i = 0; i < 10; i++)
+		{
+			delete new string(100, 'x');
+		}
+	}
+	if (AllocProfiler::isEnabled())
+	{
+		// The string and its buffer
+		ASSERT_GE(AllocProfiler::getAllocations(ALLOC_STORAGE_APPEND), 20UL);
+	}
+	else
+	{
+		ASSERT_EQ(AllocProfiler::getAllocations(ALLOC_STORAGE_APPEND), 0UL);
+	}
+	ASSERT_EQ(AllocProfiler::getAllocations(ALLOC_NORTH_SEND), 0UL);
+}
+
+TEST(AllocProfilerTest, JSON)
+{
+	AllocProfiler::reset();
+	AllocProfiler::readings(ALLOC_SOUTH_INGEST, 4);
+	string json;
+	AllocProfiler::asJSON(json);
+	Document doc;
+	doc.Parse(json.c_str());
+	ASSERT_FALSE(doc.HasParseError());
+	ASSERT_EQ(doc["enabled"].GetBool(), AllocProfiler::isEnabled());
+	const Value& stages = doc["stages"];
+	ASSERT_EQ(stages.Size(), (unsigned)ALLOC_STAGES);
+	ASSERT_STREQ(stages[ALLOC_SOUTH_INGEST]["stage"].GetString(), "southIngest");
+	ASSERT_EQ(stages[ALLOC_SOUTH_INGEST]["readings"].GetUint(), 4U);
+	ASSERT_TRUE(stages[ALLOC_SOUTH_INGEST].HasMember("allocationsPerReading"));
+	ASSERT_FALSE(stages[ALLOC_NORTH_SEND].HasMember("allocationsPerReading"));
+}
@@ -0,0 +1,35 @@
+#include <gtest/gtest.h>
+#include <asset_tracking.h>
+#include <unordered_set>
+#include <string>
+
+using namespace std;
+
+TEST(AssetTrackingTupleTest, EqualTuplesHashEqual)
+{
+	AssetTrackingTuple a("service", "plugin", "asset", "Ingest");
+	AssetTrackingTuple b("service", "plugin", "asset", "Ingest");
+	ASSERT_TRUE(a == b);
+	ASSERT_EQ(std::hash<AssetTrackingTuple>()(a), std::hash<AssetTrackingTuple>()(b));
+	ASSERT_EQ(std::hash<AssetTrackingTuple *>()(&a), a.m_hash);
+}
+
+TEST(AssetTrackingTupleTest, NamesAreNotConcatenated)
+{
+	// These tuples concatenate to the same string
+	AssetTrackingTuple a("ab", "c", "asset", "Ingest");
+	AssetTrackingTuple b("a", "bc", "asset", "Ingest");
+	ASSERT_FALSE(a == b);
+	ASSERT_NE(a.m_hash, b.m_hash);
+}
+
+TEST(AssetTrackingTupleTest, PointerSet)
+{
+	unordered_set<AssetTrackingTuple *, std::hash<AssetTrackingTuple *>, AssetTrackingTuplePtrEqual> cache;
+	AssetTrackingTuple a("service", "plugin", "asset", "Ingest");
+	AssetTrackingTuple b("service", "plugin", "asset", "Egress");
+	cache.insert(&a);
+	AssetTrackingTuple c("service", "plugin", "asset", "Ingest");
+	ASSERT_TRUE(cache.find(&c) != cache.end());
+	ASSERT_TRUE(cache.find(&b) == cache.end());
+}
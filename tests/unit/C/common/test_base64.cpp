@@ -0,0 +1,125 @@
+#include <gtest/gtest.h>
+#include <base64_codec.h>
+#include <base64databuffer.h>
+#include <base64dpimage.h>
+#include <string.h>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+/**
+ * A straightforward encoder to check the encoding against
+ */
+static string reference(const uint8_t *data, size_t length)
+{
+	static const char *alphabet = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+	string out;
+	for (size_t i = 0; i < length; i += 3)
+	{
+		uint32_t n = data[i] << 16;
+		if (i + 1 < length)
+			n |= data[i + 1] << 8;
+		if (i + 2 < length)
+			n |= data[i + 2];
+		out += alphabet[(n >> 18) & 0x3F];
+		out += alphabet[(n >> 12) & 0x3F];
+		out += i + 1 < length ? alphabet[(n >> 6) & 0x3F] : '=';
+		out += i + 2 < length ? alphabet[n & 0x3F] : '=';
+	}
+	return out;
+}
+
+TEST(Base64Test, Vectors)
+{
+	const char *plain[] = { "", "f", "fo", "foo", "foob", "fooba", "foobar" };
+	const char *encoded[] = { "", "Zg==", "Zm8=", "Zm9v", "Zm9vYg==", "Zm9vYmE=", "Zm9vYmFy" };
+	for (int i = 0; i < 7; i++)
+	{
+		string out;
+		base64Append(out, plain[i], strlen(plain[i]));
+		ASSERT_EQ(out, encoded[i]);
+		ASSERT_EQ(base64DecodedLength(encoded[i], strlen(encoded[i])), strlen(plain[i]));
+		char buf[8];
+		ASSERT_TRUE(base64Decode(encoded[i], strlen(encoded[i]), buf));
+		ASSERT_EQ(0, memcmp(buf, plain[i], strlen(plain[i])));
+	}
+}
+
+TEST(Base64Test, RoundTrip)
+{
+	// Lengths either side of the block sizes of each implementation
+	vector<uint8_t> data(1000);
+	for (size_t i = 0; i < data.size(); i++)
+		data[i] = (uint8_t)(i * 7919 + (i >> 3));
+	for (size_t length = 0; length < data.size(); length += length < 100 ? 1 : 37)
+	{
+		string out;
+		base64Append(out, data.data(), length);
+		ASSERT_EQ(out, reference(data.data(), length)) << "length " << length;
+		ASSERT_EQ(base64DecodedLength(out.data(), out.length()), length);
+		vector<uint8_t> decoded(length + 1, 0xAA);
+		ASSERT_TRUE(base64Decode(out.data(), out.length(), decoded.data())) << "length " << length;
+		ASSERT_EQ(0, memcmp(decoded.data(), data.data(), length)) << "length " << length;
+		ASSERT_EQ(decoded[length], 0xAA);
+	}
+}
+
+TEST(Base64Test, Invalid)
+{
+	vector<uint8_t> data(300, 0x5A);
+	string good;
+	base64Append(good, data.data(), data.size());
+	vector<uint8_t> decoded(data.size());
+	// An invalid character in each position of the vector and table decoders
+	for (size_t pos = 0; pos < good.length(); pos += 13)
+	{
+		for (char bad : { '*', '=', '\n', (char)0xC3 })
+		{
+			string encoded = good;
+			encoded[pos] = bad;
+			ASSERT_FALSE(base64Decode(encoded.data(), encoded.length(), decoded.data()))
+				<< "position " << pos << " character " << (int)bad;
+		}
+	}
+	ASSERT_FALSE(base64Decode("Zm9", 3, decoded.data()));
+	ASSERT_EQ(base64DecodedLength("Zm9", 3), (size_t)-1);
+}
+
+TEST(Base64Test, DataBuffer)
+{
+	DataBuffer buffer(2, 1001);
+	uint16_t *values = (uint16_t *)buffer.getData();
+	for (int i = 0; i < 1001; i++)
+		values[i] = i * 31;
+	string encoded = ((Base64DataBuffer *)&buffer)->encode();
+	ASSERT_EQ(encoded[0], '2');
+	ASSERT_EQ(encoded.length(), 1 + base64EncodedLength(2002));
+
+	// Decoded from part of a larger string
+	string json = "\"__DATABUFFER:" + encoded + "\"";
+	Base64DataBuffer decoded(json.data() + 14, encoded.length());
+	ASSERT_EQ(decoded.getItemSize(), 2);
+	ASSERT_EQ(decoded.getItemCount(), 1001);
+	ASSERT_EQ(0, memcmp(decoded.getData(), buffer.getData(), 2002));
+	ASSERT_THROW(Base64DataBuffer("2Zm9*"), runtime_error);
+}
+
+TEST(Base64Test, Image)
+{
+	uint8_t pixels[30 * 20 * 3];
+	for (size_t i = 0; i < sizeof(pixels); i++)
+		pixels[i] = (uint8_t)(i ^ (i >> 4));
+	DPImage image(30, 20, 24, pixels);
+	string encoded = ((Base64DPImage *)&image)->encode();
+	ASSERT_EQ(encoded.compare(0, 9, "30,20,24_"), 0);
+	Base64DPImage decoded(encoded);
+	ASSERT_EQ(decoded.getWidth(), 30);
+	ASSERT_EQ(decoded.getHeight(), 20);
+	ASSERT_EQ(decoded.getDepth(), 24);
+	ASSERT_EQ(0, memcmp(decoded.getData(), pixels, sizeof(pixels)));
+
+	// The encoded data must match the size of the image
+	ASSERT_THROW(Base64DPImage("30,20,24_Zm9v"), runtime_error);
+	ASSERT_THROW(Base64DPImage("Zm9v"), runtime_error);
+}
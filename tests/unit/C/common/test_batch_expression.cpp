@@ -0,0 +1,73 @@
+#include <gtest/gtest.h>
+#include <batch_expression.h>
+#include <cmath>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+TEST(BatchExpressionTest, Vectorised)
+{
+	vector<string> variables = { "a", "b" };
+	BatchExpression expression("(a + b) * 2 - -a / 4", variables);
+	ASSERT_TRUE(expression.isVectorised());
+	vector<double> a, b;
+	for (int i = 0; i < 1000; i++)
+	{
+		a.push_back(i);
+		b.push_back(i * 0.5);
+	}
+	vector<const double *> columns = { a.data(), b.data() };
+	vector<double> results(a.size());
+	expression.evaluate(columns, a.size(), results.data());
+	for (size_t i = 0; i < a.size(); i++)
+		ASSERT_DOUBLE_EQ(results[i], (a[i] + b[i]) * 2 + a[i] / 4);
+}
+
+TEST(BatchExpressionTest, Exprtk)
+{
+	vector<string> variables = { "x" };
+	BatchExpression expression("if (x > 2, sin(x), x^2)", variables);
+	ASSERT_FALSE(expression.isVectorised());
+	vector<double> x = { 1.0, 2.0, 3.0 };
+	vector<const double *> columns = { x.data() };
+	vector<double> results(x.size());
+	expression.evaluate(columns, x.size(), results.data());
+	ASSERT_DOUBLE_EQ(results[0], 1.0);
+	ASSERT_DOUBLE_EQ(results[1], 4.0);
+	ASSERT_DOUBLE_EQ(results[2], sin(3.0));
+}
+
+TEST(BatchExpressionTest, Invalid)
+{
+	vector<string> variables = { "x" };
+	ASSERT_THROW(BatchExpression("x + (", variables), runtime_error);
+}
+
+TEST(BatchExpressionTest, AssetColumns)
+{
+	vector<Reading *> readings;
+	for (int i = 0; i < 4; i++)
+	{
+		vector<Datapoint *> values;
+		DatapointValue iValue((long)i);
+		values.push_back(new Datapoint("i", iValue));
+		if (i != 2)
+		{
+			DatapointValue fValue(i * 1.5);
+			values.push_back(new Datapoint("f", fValue));
+		}
+		readings.push_back(new Reading("asset", values));
+	}
+	ColumnarReadingSet set(readings);
+	vector<string> variables = { "i", "f" };
+	BatchExpression expression("i + f", variables);
+	vector<double> results;
+	ASSERT_TRUE(expression.evaluate(*set.getAsset("asset"), results));
+	ASSERT_EQ(results.size(), 4);
+	ASSERT_DOUBLE_EQ(results[1], 2.5);
+	ASSERT_TRUE(std::isnan(results[2]));
+	ASSERT_DOUBLE_EQ(results[3], 7.5);
+	for (auto r : readings)
+		delete r;
+}
@@ -0,0 +1,27 @@
+#include <gtest/gtest.h>
+#include <bearer_token.h>
+#include <string>
+
+using namespace std;
+
+// Header {"alg":"HS256","typ":"JWT"}, payload {"aud":"Fledge","sub":"sinusoid","iss":"core","exp":1700000000}
+#define TEST_TOKEN	"eyJhbGciOiJIUzI1NiIsInR5cCI6IkpXVCJ9." \
+			"eyJhdWQiOiJGbGVkZ2UiLCJzdWIiOiJzaW51c29pZCIsImlzcyI6ImNvcmUiLCJleHAiOjE3MDAwMDAwMDB9." \
+			"c2lnbmF0dXJl"
+
+TEST(BearerTokenTest, ClaimedExpiration)
+{
+	string token = TEST_TOKEN;
+	BearerToken bearer(token);
+	ASSERT_EQ(bearer.getClaimedExpiration(), 1700000000UL);
+}
+
+TEST(BearerTokenTest, MalformedToken)
+{
+	string token = "not-a-jwt";
+	BearerToken bearer(token);
+	ASSERT_EQ(bearer.getClaimedExpiration(), 0UL);
+	string invalid = "abc.!!!.def";
+	BearerToken bad(invalid);
+	ASSERT_EQ(bad.getClaimedExpiration(), 0UL);
+}
@@ -0,0 +1,94 @@
+#include <gtest/gtest.h>
+#include <column_kernels.h>
+#include <cmath>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+TEST(ColumnKernelsTest, ScaleClamp)
+{
+	vector<double> values = { -2.0, 0.0, 1.0, 5.0 };
+	ColumnKernels::scaleOffset(values.data(), values.size(), 2.0, 1.0);
+	ASSERT_DOUBLE_EQ(values[0], -3.0);
+	ASSERT_DOUBLE_EQ(values[3], 11.0);
+	ColumnKernels::clamp(values.data(), values.size(), 0.0, 10.0);
+	ASSERT_DOUBLE_EQ(values[0], 0.0);
+	ASSERT_DOUBLE_EQ(values[1], 1.0);
+	ASSERT_DOUBLE_EQ(values[3], 10.0);
+}
+
+TEST(ColumnKernelsTest, Deadband)
+{
+	vector<double> values = { 1.0, 1.2, 1.6, 1.7, 0.5 };
+	vector<bool> pass;
+	ColumnState state;
+	ColumnKernels::deadband(values.data(), values.size(), 0.5, pass, state);
+	ASSERT_TRUE(pass[0]);
+	ASSERT_FALSE(pass[1]);
+	ASSERT_TRUE(pass[2]);
+	ASSERT_FALSE(pass[3]);
+	ASSERT_TRUE(pass[4]);
+	// The state carries over to the next block
+	vector<double> next = { 0.7 };
+	ColumnKernels::deadband(next.data(), next.size(), 0.5, pass, state);
+	ASSERT_FALSE(pass[0]);
+}
+
+TEST(ColumnKernelsTest, RateOfChange)
+{
+	vector<double> values = { 1.0, 3.0, 3.0, 7.0 };
+	vector<double> times = { 10.0, 11.0, 11.0, 13.0 };
+	vector<double> rates(values.size());
+	ColumnState state;
+	ColumnKernels::rateOfChange(values.data(), times.data(), values.size(), rates.data(), state);
+	ASSERT_TRUE(std::isnan(rates[0]));
+	ASSERT_DOUBLE_EQ(rates[1], 2.0);
+	ASSERT_TRUE(std::isnan(rates[2]));
+	ASSERT_DOUBLE_EQ(rates[3], 2.0);
+	vector<double> next = { 9.0 };
+	vector<double> nextTimes = { 14.0 };
+	ColumnKernels::rateOfChange(next.data(), nextTimes.data(), 1, rates.data(), state);
+	ASSERT_DOUBLE_EQ(rates[0], 2.0);
+}
+
+TEST(ColumnKernelsTest, Columns)
+{
+	vector<Reading *> readings;
+	for (int i = 0; i < 4; i++)
+	{
+		vector<Datapoint *> values;
+		if (i != 1)
+		{
+			DatapointValue fValue(i * 2.0);
+			values.push_back(new Datapoint("f", fValue));
+		}
+		DatapointValue iValue((long)i);
+		values.push_back(new Datapoint("i", iValue));
+		Reading *reading = new Reading("asset", values);
+		struct timeval tv = { 100 + i, 0 };
+		reading->setUserTimestamp(tv);
+		readings.push_back(reading);
+	}
+	ColumnarReadingSet set(readings);
+	AssetColumns *asset = set.getAsset("asset");
+	ReadingColumn *column = asset->getColumn("f");
+	ASSERT_TRUE(ColumnKernels::scaleOffset(*column, 0.5, 0.0));
+	ASSERT_FALSE(ColumnKernels::scaleOffset(*asset->getColumn("i"), 0.5, 0.0));
+	vector<double> rates;
+	ColumnState state;
+	ASSERT_TRUE(ColumnKernels::rateOfChange(*asset, *column, rates, state));
+	ASSERT_TRUE(std::isnan(rates[0]));
+	ASSERT_TRUE(std::isnan(rates[1]));
+	ASSERT_DOUBLE_EQ(rates[2], 1.0);
+	ASSERT_DOUBLE_EQ(rates[3], 1.0);
+	vector<bool> pass;
+	ColumnState band;
+	ASSERT_TRUE(ColumnKernels::deadband(*column, 1.5, pass, band));
+	ASSERT_TRUE(pass[0]);
+	ASSERT_FALSE(pass[1]);
+	ASSERT_TRUE(pass[2]);
+	ASSERT_FALSE(pass[3]);
+	for (auto r : readings)
+		delete r;
+}
@@ -0,0 +1,100 @@
+#include <gtest/gtest.h>
+#include <columnar_reading_set.h>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+static Reading *makeReading(const string& asset, long i, double f)
+{
+	vector<Datapoint *> values;
+	DatapointValue iValue(i);
+	values.push_back(new Datapoint("i", iValue));
+	DatapointValue fValue(f);
+	values.push_back(new Datapoint("f", fValue));
+	Reading *reading = new Reading(asset, values);
+	reading->setId(i);
+	return reading;
+}
+
+TEST(ColumnarReadingSetTest, Columns)
+{
+	vector<Reading *> readings;
+	for (int i = 0; i < 10; i++)
+		readings.push_back(makeReading(i % 2 ? "odd" : "even", i, i * 1.5));
+	ReadingSet set(&readings);
+	ColumnarReadingSet columns(set);
+	ASSERT_EQ(columns.getAssets().size(), 2);
+	AssetColumns *odd = columns.getAsset("odd");
+	ASSERT_NE(odd, (AssetColumns *)NULL);
+	ASSERT_EQ(odd->getRows(), 5);
+	ReadingColumn *col = odd->getColumn("i");
+	ASSERT_EQ(col->getType(), ReadingColumn::COL_INTEGER);
+	ASSERT_EQ(col->getIntegers()[2], 5);
+	col = odd->getColumn("f");
+	ASSERT_EQ(col->getType(), ReadingColumn::COL_FLOAT);
+	ASSERT_EQ(col->getFloats()[1], 4.5);
+	ASSERT_EQ(columns.getAsset("none"), (AssetColumns *)NULL);
+	set.removeAll();
+}
+
+TEST(ColumnarReadingSetTest, RoundTrip)
+{
+	vector<Reading *> readings;
+	for (int i = 0; i < 10; i++)
+		readings.push_back(makeReading(i % 3 ? "a" : "b", i, i * 0.25));
+	DatapointValue sValue(string("text"));
+	readings[4]->addDatapoint(new Datapoint("s", sValue));
+	ColumnarReadingSet columns(readings);
+	vector<Reading *> result;
+	columns.toReadings(result);
+	ASSERT_EQ(result.size(), readings.size());
+	for (size_t i = 0; i < readings.size(); i++)
+	{
+		ASSERT_EQ(result[i]->getAssetName(), readings[i]->getAssetName());
+		ASSERT_EQ(result[i]->getId(), readings[i]->getId());
+		ASSERT_EQ(result[i]->getDatapointsJSON(), readings[i]->getDatapointsJSON());
+		ASSERT_EQ(result[i]->getAssetDateUserTime(), readings[i]->getAssetDateUserTime());
+	}
+	for (auto r : readings)
+		delete r;
+	for (auto r : result)
+		delete r;
+}
+
+TEST(ColumnarReadingSetTest, MixedTypes)
+{
+	vector<Reading *> readings;
+	DatapointValue iValue((long)1);
+	readings.push_back(new Reading("mixed", new Datapoint("x", iValue)));
+	DatapointValue sValue(string("one"));
+	readings.push_back(new Reading("mixed", new Datapoint("x", sValue)));
+	ColumnarReadingSet columns(readings);
+	ReadingColumn *col = columns.getAsset("mixed")->getColumn("x");
+	ASSERT_EQ(col->getType(), ReadingColumn::COL_VALUE);
+	ReadingSet *set = columns.toReadingSet();
+	ASSERT_EQ(set->getCount(), 2);
+	ASSERT_EQ(set->getAllReadings()[0]->getDatapointsJSON(), "{\"x\":1}");
+	ASSERT_EQ(set->getAllReadings()[1]->getDatapointsJSON(), "{\"x\":\"one\"}");
+	set->removeAll();
+	delete set;
+	for (auto r : readings)
+		delete r;
+}
+
+TEST(ColumnarReadingSetTest, SourceReleased)
+{
+	vector<Reading *> *readings = new vector<Reading *>;
+	for (int i = 0; i < 4; i++)
+		readings->push_back(makeReading("released", i, i * 0.5));
+	ColumnarReadingSet columns(*readings);
+	vector<Reading *> owned(*readings);
+	delete readings;
+
+	// The columns are built after the vector they were created from is freed
+	ASSERT_EQ(columns.getCount(), 4);
+	ASSERT_EQ(columns.getAsset("released")->getRows(), 4);
+	ASSERT_EQ(columns.getAsset("released")->getColumn("i")->getIntegers()[3], 3);
+	for (auto r : owned)
+		delete r;
+}
@@ -458,6 +458,16 @@ TEST(CategoryTestQuoted, toJSONQuoted)
 	ASSERT_EQ(0, confCategory.toJSON().compare(json_quoted));
 }
 
+TEST(CategoryTestQuoted, toJSONEscaped)
+{
+	ConfigCategory confCategory("test", myCategory);
+	confCategory.setValue("name", "C:\\fledge\n\"data\"");
+	Document doc;
+	doc.Parse(confCategory.toJSON().c_str());
+	ASSERT_FALSE(doc.HasParseError());
+	ASSERT_STREQ("C:\\fledge\n\"data\"", doc["value"]["name"]["value"].GetString());
+}
+
 TEST(CategoryTest, bool_and_number_ok)
 {
 	ConfigCategory confCategory("test", myCategory_number_and_boolean_items);
@@ -615,3 +625,38 @@ TEST(CategoryTest, categoryValues)
         ASSERT_EQ(true, complex.getValue("plugin").compare("OMF") == 0);
         ASSERT_EQ(true, complex.getValue("OMFMaxRetry").compare("3") == 0);
 }
+
+/**
+ * Check the items are found by name once items are added and removed
+ */
+TEST(CategoryTest, itemIndex)
+{
+	ConfigCategory conf("test", myCategoryRemoveItems);
+	ConfigCategory copy(conf);
+	conf.removeItemsType(ConfigCategory::ItemType::CategoryType);
+	ASSERT_EQ(2, copy.getCount());
+	conf.addItem("added", "An added item", "string", "one", "two");
+	ASSERT_EQ(true, conf.itemExists("added"));
+	ASSERT_EQ(0, conf.getValue("added").compare("two"));
+	conf.removeItems();
+	ASSERT_EQ(false, conf.itemExists("added"));
+	conf = copy;
+	ASSERT_EQ(2, conf.getCount());
+	ASSERT_EQ(false, conf.itemExists("added"));
+}
+
+/**
+ * Check the version of a category only changes when a value changes
+ */
+TEST(CategoryTest, version)
+{
+	ConfigCategory complex("complex", bigCategory);
+	ConfigCategory same("same", complex.itemsToJSON(true));
+	ASSERT_EQ(complex.getVersion(), same.getVersion());
+	same.setDescription("A different description");
+	ASSERT_EQ(complex.getVersion(), same.getVersion());
+	same.setValue("OMFMaxRetry", "4");
+	ASSERT_NE(complex.getVersion(), same.getVersion());
+	same.setValue("OMFMaxRetry", "3");
+	ASSERT_EQ(complex.getVersion(), same.getVersion());
+}
@@ -0,0 +1,70 @@
+#include <gtest/gtest.h>
+#include <cpu_profiler.h>
+#include <atomic>
+#include <thread>
+#include <sstream>
+#include <string>
+#include <math.h>
+#include <pthread.h>
+
+using namespace std;
+
+static atomic<bool> spinning;
+
+/**
+ * Use CPU time until told to stop
+ */
+static void spin()
+{
+	pthread_setname_np(pthread_self(), "spinner");
+	volatile double x = 0;
+	while (spinning)
+	{
+		for (int i = 1; i < 10000; i++)
+			x += sqrt((double)i);
+	}
+}
+
+TEST(CpuProfilerTest, FoldedStacks)
+{
+	spinning = true;
+	thread spinner(spin);
+	string folded;
+	ASSERT_TRUE(CpuProfiler::getInstance()->profile(1, 200, folded));
+	spinning = false;
+	spinner.join();
+
+	istringstream lines(folded);
+	string line;
+	unsigned long samples = 0, spinnerSamples = 0;
+	while (getline(lines, line))
+	{
+		size_t space = line.rfind(' ');
+		ASSERT_NE(space, string::npos);
+		unsigned long count = stoul(line.substr(space + 1));
+		ASSERT_GT(count, 0UL);
+		samples += count;
+		if (line.compare(0, 8, "spinner;") == 0)
+		{
+			spinnerSamples += count;
+		}
+	}
+	// A second of CPU time at 200 samples per second
+	ASSERT_GT(spinnerSamples, 50UL);
+	ASSERT_GE(samples, spinnerSamples);
+	ASSERT_FALSE(CpuProfiler::getInstance()->isRunning());
+}
+
+TEST(CpuProfilerTest, OneAtATime)
+{
+	string first;
+	thread profile([&first] { CpuProfiler::getInstance()->profile(5, 99, first); });
+	while (!CpuProfiler::getInstance()->isRunning())
+		this_thread::yield();
+	string second;
+	ASSERT_FALSE(CpuProfiler::getInstance()->profile(1, 99, second));
+	// The running profile returns early when cancelled
+	CpuProfiler::getInstance()->cancel();
+	profile.join();
+	ASSERT_FALSE(CpuProfiler::getInstance()->isRunning());
+}
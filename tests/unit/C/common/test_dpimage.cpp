@@ -0,0 +1,62 @@
+#include <gtest/gtest.h>
+#include <dpimage.h>
+#include <string.h>
+
+using namespace std;
+
+TEST(DPImageTest, CopySharesPixels)
+{
+	unsigned char pixels[16 * 16];
+	memset(pixels, 7, sizeof(pixels));
+	DPImage image(16, 16, 8, pixels);
+	DPImage copy(image);
+	const DPImage& constCopy = copy;
+
+	ASSERT_TRUE(image.isShared());
+	ASSERT_EQ(((const DPImage&)image).getData(), constCopy.getData());
+}
+
+TEST(DPImageTest, CopyOnWrite)
+{
+	unsigned char pixels[16 * 16];
+	memset(pixels, 7, sizeof(pixels));
+	DPImage image(16, 16, 8, pixels);
+	DPImage copy(image);
+
+	unsigned char *data = (unsigned char *)copy.getData();
+	data[0] = 9;
+	ASSERT_FALSE(copy.isShared());
+	ASSERT_FALSE(image.isShared());
+	ASSERT_EQ(9, ((const unsigned char *)((const DPImage&)copy).getData())[0]);
+	ASSERT_EQ(7, ((const unsigned char *)((const DPImage&)image).getData())[0]);
+}
+
+TEST(DPImageTest, Assignment)
+{
+	unsigned char pixels[8 * 8];
+	memset(pixels, 3, sizeof(pixels));
+	DPImage image(8, 8, 8, pixels);
+	DPImage other;
+	other = image;
+
+	ASSERT_EQ(8, other.getWidth());
+	ASSERT_TRUE(other.isShared());
+	((unsigned char *)other.getData())[1] = 4;
+	ASSERT_EQ(3, ((const unsigned char *)((const DPImage&)image).getData())[1]);
+}
+
+TEST(DPImageTest, Mapped)
+{
+	DPImage::setMmapThreshold(4096);
+	DPImage image(64, 64, 16);
+	DPImage::setMmapThreshold(0);
+
+	const unsigned char *data = (const unsigned char *)((const DPImage&)image).getData();
+	for (int i = 0; i < 64 * 64 * 2; i++)
+	{
+		ASSERT_EQ(0, data[i]);
+	}
+	DPImage copy(image);
+	((unsigned char *)copy.getData())[10] = 1;
+	ASSERT_EQ(0, data[10]);
+}
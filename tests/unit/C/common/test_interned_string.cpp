@@ -0,0 +1,95 @@
+#include <gtest/gtest.h>
+#include <interned_string.h>
+#include <reading.h>
+#include <string>
+#include <unordered_map>
+
+using namespace std;
+
+TEST(InternedStringTest, Equality)
+{
+	InternedString a("pump"), b(string("pump")), c("valve");
+	ASSERT_TRUE(a == b);
+	ASSERT_TRUE(a != c);
+	ASSERT_EQ(a.id(), b.id());
+	ASSERT_NE(a.id(), c.id());
+	ASSERT_EQ(a.str(), "pump");
+	ASSERT_EQ(a.str().c_str(), b.c_str());
+}
+
+TEST(InternedStringTest, Empty)
+{
+	InternedString a, b("");
+	ASSERT_TRUE(a == b);
+	ASSERT_TRUE(a.empty());
+	ASSERT_EQ(a.length(), 0);
+}
+
+TEST(InternedStringTest, Assign)
+{
+	InternedString a("first");
+	a = string("second");
+	ASSERT_EQ(a.str(), "second");
+	a = "third";
+	ASSERT_TRUE(a == InternedString("third"));
+}
+
+TEST(InternedStringTest, HashKey)
+{
+	unordered_map<InternedString, int> counts;
+	counts[InternedString("a")]++;
+	counts[InternedString("b")]++;
+	counts[InternedString("a")]++;
+	ASSERT_EQ(counts.size(), 2);
+	ASSERT_EQ(counts[InternedString("a")], 2);
+}
+
+TEST(InternedStringTest, ReadingNames)
+{
+	DatapointValue value((long)1);
+	Reading r1(string("asset"), new Datapoint("dp", value));
+	Reading r2(string("asset"), new Datapoint("dp", value));
+	ASSERT_TRUE(r1.getInternedAssetName() == r2.getInternedAssetName());
+	ASSERT_EQ(r1.getAssetName().c_str(), r2.getAssetName().c_str());
+	ASSERT_TRUE(r1.getReadingData()[0]->getInternedName() == r2.getReadingData()[0]->getInternedName());
+	r2.setAssetName("other");
+	ASSERT_TRUE(r1.getInternedAssetName() != r2.getInternedAssetName());
+	ASSERT_EQ(r2.getAssetName(), "other");
+}
+
+TEST(InternedStringTest, TableFull)
+{
+	StringTable *table = StringTable::getInstance();
+	InternedString known("known");
+	table->setLimit(table->size());
+
+	// Names that are not in the full table are held as strings
+	InternedString a("unbounded 1"), b(string("unbounded 1")), c("unbounded 2");
+	ASSERT_FALSE(a.interned());
+	ASSERT_EQ(a.id(), 0);
+	ASSERT_TRUE(a == b);
+	ASSERT_TRUE(a != c);
+	ASSERT_TRUE(a != known);
+	ASSERT_TRUE(InternedString("known") == known);
+	ASSERT_TRUE(InternedString("known").interned());
+
+	InternedString copy(a);
+	ASSERT_TRUE(copy == a);
+	ASSERT_NE(copy.c_str(), a.c_str());
+	copy = c;
+	ASSERT_EQ(copy.str(), "unbounded 2");
+	copy = known;
+	ASSERT_TRUE(copy.interned());
+
+	unordered_map<InternedString, int> counts;
+	counts[a]++;
+	counts[b]++;
+	counts[known]++;
+	ASSERT_EQ(counts.size(), 2);
+	ASSERT_EQ(counts[InternedString("unbounded 1")], 2);
+
+	size_t size = table->size();
+	table->setLimit(STRING_TABLE_MAX);
+	ASSERT_EQ(size, table->size());
+	ASSERT_TRUE(InternedString("unbounded 3").interned());
+}
@@ -73,3 +73,50 @@ TEST(JsonToVectorString, JSONbad)
 
 	ASSERT_EQ(result, false);
 }
+
+TEST(JsonAppendEscaped, Quotes)
+{
+	string out = "x:";
+	string str = "a \"quoted\" string";
+	JSONappendEscaped(out, str.data(), str.length());
+	ASSERT_EQ(out, "x:a \\\"quoted\\\" string");
+}
+
+TEST(JsonAppendEscaped, AlreadyEscaped)
+{
+	string out;
+	string str = "\\\"one\\\\\"two";
+	JSONappendEscaped(out, str.data(), str.length());
+	// A quote after an odd number of backslashes is left alone
+	ASSERT_EQ(out, "\\\"one\\\\\\\"two");
+}
+
+TEST(JsonAppendEscaped, NoQuotes)
+{
+	string out;
+	string str(1000, 'x');
+	JSONappendEscaped(out, str.data(), str.length());
+	ASSERT_EQ(out, str);
+	JSONappendEscaped(out, "\"", 1);
+	ASSERT_EQ(out, str + "\\\"");
+}
+
+TEST(JsonWriter, Document)
+{
+	JSONWriter writer;
+	writer.append("{ \"name\" : ").appendString(string("a \"b\" \\ c\n"));
+	writer.append(", \"count\" : ").append(-42L).append(" }");
+	ASSERT_EQ(writer.str(), "{ \"name\" : \"a \\\"b\\\" \\\\ c\\n\", \"count\" : -42 }");
+	ASSERT_EQ(writer.length(), writer.str().length());
+}
+
+TEST(JsonWriter, Reuse)
+{
+	JSONWriter writer(16);
+	string value(100, 'x');
+	writer.appendString(value);
+	ASSERT_EQ(writer.str(), "\"" + value + "\"");
+	writer.clear();
+	writer.append("[").appendString("").append(",").appendString("y").append("]");
+	ASSERT_STREQ(writer.c_str(), "[\"\",\"y\"]");
+}
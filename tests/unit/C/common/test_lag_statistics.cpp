@@ -0,0 +1,134 @@
+#include <gtest/gtest.h>
+#include <lag_statistics.h>
+#include <reading.h>
+#include <rapidjson/document.h>
+#include <vector>
+#include <string.h>
+
+using namespace std;
+using namespace rapidjson;
+
+TEST(LagStatisticsTest, Empty)
+{
+	LagStatistics lag;
+	ASSERT_EQ(lag.getCount(), 0UL);
+	ASSERT_EQ(lag.percentile(99), 0UL);
+	string json;
+	lag.asJSON(json);
+	Document doc;
+	doc.Parse(json.c_str());
+	ASSERT_FALSE(doc.HasParseError());
+	ASSERT_EQ(doc["count"].GetUint(), 0U);
+	ASSERT_EQ(doc["histogram"].GetArray().Size(), (unsigned)LAG_BUCKETS);
+	ASSERT_EQ(doc["assets"].GetArray().Size(), 0U);
+}
+
+TEST(LagStatisticsTest, Histogram)
+{
+	LagStatistics lag;
+	InternedString asset("histogram");
+	lag.record(asset, 0, 1000);
+	lag.record(asset, 10, 1000);
+	lag.record(asset, 11, 1000);
+	lag.record(asset, 4000, 1000);
+	lag.record(asset, 7200000, 1000);
+	string json;
+	lag.asJSON(json);
+	Document doc;
+	doc.Parse(json.c_str());
+	ASSERT_FALSE(doc.HasParseError());
+	ASSERT_EQ(doc["count"].GetUint(), 5U);
+	const Value& histogram = doc["histogram"];
+	ASSERT_EQ(histogram[0]["le"].GetUint(), 10U);
+	ASSERT_EQ(histogram[0]["count"].GetUint(), 2U);
+	ASSERT_EQ(histogram[1]["count"].GetUint(), 1U);
+	ASSERT_EQ(histogram[7]["le"].GetUint(), 5000U);
+	ASSERT_EQ(histogram[7]["count"].GetUint(), 1U);
+	ASSERT_STREQ(histogram[LAG_BUCKETS - 1]["le"].GetString(), "inf");
+	ASSERT_EQ(histogram[LAG_BUCKETS - 1]["count"].GetUint(), 1U);
+	ASSERT_EQ(doc["max"].GetUint(), 7200000U);
+}
+
+TEST(LagStatisticsTest, Percentiles)
+{
+	LagStatistics lag;
+	InternedString asset("percentiles");
+	for (int i = 0; i < 100; i++)
+	{
+		lag.record(asset, i < 95 ? 20 : 3000, 1000);
+	}
+	unsigned long p50 = lag.percentile(50);
+	ASSERT_GT(p50, 10UL);
+	ASSERT_LE(p50, 50UL);
+	unsigned long p99 = lag.percentile(99);
+	ASSERT_GT(p99, 2500UL);
+	ASSERT_LE(p99, 3000UL);
+}
+
+TEST(LagStatisticsTest, TopAssets)
+{
+	LagStatistics lag(2);
+	lag.record(InternedString("slow"), 5000, 1000);
+	lag.record(InternedString("slow"), 1000, 1000);
+	lag.record(InternedString("fast"), 10, 1000);
+	lag.record(InternedString("medium"), 500, 1000);
+	string json;
+	lag.asJSON(json);
+	Document doc;
+	doc.Parse(json.c_str());
+	ASSERT_FALSE(doc.HasParseError());
+	const Value& assets = doc["assets"];
+	ASSERT_EQ(assets.Size(), 2U);
+	ASSERT_STREQ(assets[0]["asset"].GetString(), "slow");
+	ASSERT_EQ(assets[0]["count"].GetUint(), 2U);
+	ASSERT_EQ(assets[0]["mean"].GetUint(), 3000U);
+	ASSERT_EQ(assets[0]["max"].GetUint(), 5000U);
+	ASSERT_EQ(assets[0]["last"].GetUint(), 1000U);
+	ASSERT_STREQ(assets[1]["asset"].GetString(), "medium");
+}
+
+TEST(LagStatisticsTest, Windows)
+{
+	LagStatistics lag(LAG_TOP_ASSETS, 60);
+	lag.record(InternedString("backlog"), 600000, 1000);
+	lag.record(InternedString("current"), 100, 1070);
+	// The backlog is in the previous window
+	ASSERT_EQ(lag.percentile(100), 600000UL);
+	lag.record(InternedString("current"), 100, 1130);
+	// The backlog has left the recent windows but is still in the histogram
+	ASSERT_EQ(lag.percentile(100), 100UL);
+	ASSERT_EQ(lag.getCount(), 3UL);
+	lag.record(InternedString("current"), 200, 2000);
+	// No lag was recorded for a whole window
+	ASSERT_EQ(lag.percentile(100), 200UL);
+}
+
+TEST(LagStatisticsTest, Readings)
+{
+	vector<Reading *> readings;
+	DatapointValue value(1L);
+	readings.push_back(new Reading("old", new Datapoint("x", value)));
+	readings.push_back(new Reading("future", new Datapoint("x", value)));
+	struct timeval now;
+	gettimeofday(&now, NULL);
+	struct timeval ts = now;
+	ts.tv_sec -= 10;
+	readings[0]->setUserTimestamp(ts);
+	ts.tv_sec += 20;
+	readings[1]->setUserTimestamp(ts);
+
+	LagStatistics lag;
+	lag.record(readings.cbegin(), readings.cend(), true, now);
+	string json;
+	lag.asJSON(json);
+	Document doc;
+	doc.Parse(json.c_str());
+	ASSERT_FALSE(doc.HasParseError());
+	ASSERT_EQ(doc["count"].GetUint(), 2U);
+	ASSERT_STREQ(doc["assets"][0]["asset"].GetString(), "old");
+	ASSERT_EQ(doc["assets"][0]["max"].GetUint(), 10000U);
+	// A timestamp in the future has no lag
+	ASSERT_EQ(doc["assets"][1]["max"].GetUint(), 0U);
+	for (auto reading : readings)
+		delete reading;
+}
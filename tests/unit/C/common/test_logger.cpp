@@ -0,0 +1,65 @@
+#include <gtest/gtest.h>
+#include <logger.h>
+#include <thread>
+#include <vector>
+
+using namespace std;
+
+TEST(LoggerTest, MinLevel)
+{
+	Logger *logger = Logger::getLogger();
+	string level = logger->getMinLevel();
+	logger->setMinLevel("warning");
+	ASSERT_FALSE(logger->isDebugEnabled());
+	ASSERT_FALSE(logger->isInfoEnabled());
+	ASSERT_TRUE(logger->isEnabled(LOG_WARNING));
+	ASSERT_TRUE(logger->isEnabled(LOG_ERR));
+	logger->setMinLevel("debug");
+	ASSERT_TRUE(logger->isDebugEnabled());
+	ASSERT_TRUE(logger->isInfoEnabled());
+	logger->setMinLevel("error");
+	ASSERT_FALSE(logger->isEnabled(LOG_WARNING));
+	logger->setMinLevel("verbose");
+	ASSERT_EQ(logger->getMinLevel().compare("error"), 0);
+	ASSERT_FALSE(logger->isEnabled(LOG_WARNING));
+	logger->setMinLevel(level.empty() ? "warning" : level);
+}
+
+TEST(LoggerTest, Asynchronous)
+{
+	Logger *logger = Logger::getLogger();
+	logger->setAsynchronous(true);
+	ASSERT_TRUE(logger->isAsynchronous());
+	vector<thread> threads;
+	for (int i = 0; i < 4; i++)
+	{
+		threads.push_back(thread([logger, i]() {
+			for (int j = 0; j < 1000; j++)
+				logger->warn("Asynchronous logger test thread %d message %d", i, j);
+		}));
+	}
+	for (auto& t : threads)
+		t.join();
+	logger->setAsynchronous(false);
+	ASSERT_FALSE(logger->isAsynchronous());
+	logger->warn(string("Synchronous logger test message"));
+}
+
+TEST(LoggerTest, RateLimit)
+{
+	Logger *logger = Logger::getLogger();
+	logger->setRateLimit(3, 60);
+	unsigned long suppressed = logger->getSuppressed();
+	for (int i = 0; i < 10; i++)
+		logger->warn("Rate limited logger test message %d", i);
+	ASSERT_EQ(logger->getSuppressed() - suppressed, 7);
+	logger->warn("Another rate limited logger test message");
+	ASSERT_EQ(logger->getSuppressed() - suppressed, 7);
+	logger->error("Rate limited logger test message %d", 0);
+	ASSERT_EQ(logger->getSuppressed() - suppressed, 7);
+	logger->setRateLimit(0, 60);
+	for (int i = 0; i < 10; i++)
+		logger->warn("Rate limited logger test message %d", i);
+	ASSERT_EQ(logger->getSuppressed() - suppressed, 7);
+	logger->setRateLimit(LOGGER_RATE_MESSAGES, LOGGER_RATE_INTERVAL);
+}
@@ -0,0 +1,76 @@
+#include <gtest/gtest.h>
+#include <mpsc_queue.h>
+#include <thread>
+#include <vector>
+
+using namespace std;
+
+TEST(MPSCQueueTest, PushPop)
+{
+	MPSCQueue<int> queue(4);
+	size_t count;
+	int value;
+	ASSERT_FALSE(queue.pop(value));
+	ASSERT_TRUE(queue.push(1, count));
+	ASSERT_EQ(count, 1);
+	ASSERT_TRUE(queue.push(2, count));
+	ASSERT_EQ(count, 2);
+	ASSERT_TRUE(queue.peek(value));
+	ASSERT_EQ(value, 1);
+	ASSERT_TRUE(queue.pop(value));
+	ASSERT_EQ(value, 1);
+	ASSERT_TRUE(queue.pop(value));
+	ASSERT_EQ(value, 2);
+	ASSERT_EQ(queue.size(), 0);
+}
+
+TEST(MPSCQueueTest, Full)
+{
+	MPSCQueue<int> queue(4);
+	size_t count;
+	int value;
+	for (int i = 0; i < 4; i++)
+		ASSERT_TRUE(queue.push(i, count));
+	ASSERT_FALSE(queue.push(5, count));
+	ASSERT_TRUE(queue.pop(value));
+	ASSERT_EQ(value, 0);
+	ASSERT_TRUE(queue.push(5, count));
+	ASSERT_EQ(count, 4);
+}
+
+TEST(MPSCQueueTest, MultipleProducers)
+{
+	MPSCQueue<long> queue(256);
+	const int producers = 4, items = 1000;
+	vector<thread> threads;
+	for (int p = 0; p < producers; p++)
+	{
+		threads.push_back(thread([&queue, p, items] {
+			size_t count;
+			for (int i = 0; i < items; i++)
+			{
+				while (!queue.push((long)p * items + i, count))
+					this_thread::yield();
+			}
+		}));
+	}
+	long total = 0, value;
+	int received = 0;
+	vector<long> last(producers, -1);
+	while (received < producers * items)
+	{
+		if (queue.pop(value))
+		{
+			// Items from each producer arrive in order
+			int p = value / items;
+			ASSERT_GT(value, last[p]);
+			last[p] = value;
+			total += value;
+			received++;
+		}
+	}
+	for (auto& t : threads)
+		t.join();
+	long n = producers * items;
+	ASSERT_EQ(total, (n * (n - 1)) / 2);
+}
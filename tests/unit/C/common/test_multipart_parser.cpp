@@ -0,0 +1,98 @@
+#include <gtest/gtest.h>
+#include <multipart_parser.h>
+#include <fstream>
+#include <sstream>
+#include <unistd.h>
+
+using namespace std;
+
+static const string boundary = "------------------------d74496d66958873e";
+
+static string content(const string& file)
+{
+	string body = "--" + boundary + "\r\n";
+	body += "Content-Disposition: form-data; name=\"attributes\"\r\n\r\n";
+	body += "{\"name\": \"B1\"}\r\n";
+	body += "--" + boundary + "\r\n";
+	body += "Content-Disposition: form-data; name=\"bucket\"; filename=\"file.bin\"\r\n";
+	body += "Content-Type: application/octet-stream\r\n\r\n";
+	body += file;
+	body += "\r\n--" + boundary + "--\r\n";
+	return body;
+}
+
+static string binaryFile()
+{
+	string file;
+	for (int i = 0; i < 5000; i++)
+	{
+		file += (char)(i % 256);
+		if (i % 997 == 0)
+			file += "\r\n--" + boundary.substr(0, 20);
+	}
+	return file;
+}
+
+static string readFile(const string& name)
+{
+	ifstream ifs(name.c_str(), ios::binary);
+	stringstream ss;
+	ss << ifs.rdbuf();
+	return ss.str();
+}
+
+static void parseInPieces(size_t pieceSize)
+{
+	string file = binaryFile();
+	string body = content(file);
+	string fileName = "/tmp/test_multipart_" + to_string(getpid());
+
+	MultipartParser parser(boundary);
+	parser.saveFile("bucket", fileName);
+	for (size_t offset = 0; offset < body.length(); offset += pieceSize)
+	{
+		ASSERT_TRUE(parser.parse((const uint8_t *)body.data() + offset,
+					min(pieceSize, body.length() - offset)));
+	}
+	ASSERT_TRUE(parser.isComplete());
+	ASSERT_EQ("{\"name\": \"B1\"}", parser.getValue("attributes"));
+	ASSERT_EQ("file.bin", parser.getFilename("bucket"));
+	ASSERT_EQ(file, readFile(fileName));
+	unlink(fileName.c_str());
+}
+
+TEST(MultipartParserTest, SinglePiece)
+{
+	parseInPieces(1024 * 1024);
+}
+
+TEST(MultipartParserTest, SmallPieces)
+{
+	parseInPieces(7);
+}
+
+TEST(MultipartParserTest, BytePieces)
+{
+	parseInPieces(1);
+}
+
+TEST(MultipartParserTest, Incomplete)
+{
+	string body = content(binaryFile());
+	body.resize(body.length() / 2);
+	string fileName = "/tmp/test_multipart_" + to_string(getpid());
+	{
+		MultipartParser parser(boundary);
+		parser.saveFile("bucket", fileName);
+		ASSERT_TRUE(parser.parse((const uint8_t *)body.data(), body.length()));
+		ASSERT_FALSE(parser.isComplete());
+	}
+	ASSERT_NE(0, access(fileName.c_str(), F_OK));
+}
+
+TEST(MultipartParserTest, Invalid)
+{
+	string body = "--" + boundary + "XX\r\n";
+	MultipartParser parser(boundary);
+	ASSERT_FALSE(parser.parse((const uint8_t *)body.data(), body.length()));
+}
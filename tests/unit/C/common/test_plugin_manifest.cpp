@@ -0,0 +1,90 @@
+#include <gtest/gtest.h>
+#include <plugin_manifest.h>
+#include <fstream>
+#include <string>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <stdlib.h>
+
+using namespace std;
+
+/**
+ * A plugin directory with a single plugin library, removed at the end of the test
+ */
+class PluginManifestTest : public ::testing::Test {
+	protected:
+		void SetUp()
+		{
+			char tmpl[] = "/tmp/manifestXXXXXX";
+			m_dir = mkdtemp(tmpl);
+			m_plugin = m_dir + "/libsinusoid.so";
+			m_file = m_dir + ".json";
+			ofstream(m_plugin.c_str()) << "plugin";
+		}
+		void TearDown()
+		{
+			unlink(m_plugin.c_str());
+			unlink(m_file.c_str());
+			rmdir(m_dir.c_str());
+		}
+		string	m_dir;
+		string	m_plugin;
+		string	m_file;
+};
+
+TEST_F(PluginManifestTest, NotFound)
+{
+	PluginManifest manifest(m_file);
+	string path;
+	int impl;
+	ASSERT_FALSE(manifest.find("south", "sinusoid", path, impl));
+}
+
+TEST_F(PluginManifestTest, Persisted)
+{
+	{
+		PluginManifest manifest(m_file);
+		manifest.add("south", "sinusoid", m_plugin, 1);
+	}
+	PluginManifest manifest(m_file);
+	string path;
+	int impl = 0;
+	ASSERT_TRUE(manifest.find("south", "sinusoid", path, impl));
+	ASSERT_EQ(path, m_plugin);
+	ASSERT_EQ(impl, 1);
+	ASSERT_FALSE(manifest.find("north", "sinusoid", path, impl));
+}
+
+TEST_F(PluginManifestTest, PluginUpdated)
+{
+	PluginManifest manifest(m_file);
+	manifest.add("south", "sinusoid", m_plugin, 0);
+	struct timespec times[2] = { { 0, UTIME_OMIT }, { 1, 0 } };
+	utimensat(AT_FDCWD, m_plugin.c_str(), times, 0);
+	string path;
+	int impl;
+	ASSERT_FALSE(manifest.find("south", "sinusoid", path, impl));
+}
+
+TEST_F(PluginManifestTest, DirectoryChanged)
+{
+	PluginManifest manifest(m_file);
+	manifest.add("south", "sinusoid", m_plugin, 0);
+	struct timespec times[2] = { { 0, UTIME_OMIT }, { 1, 0 } };
+	utimensat(AT_FDCWD, m_dir.c_str(), times, 0);
+	string path;
+	int impl;
+	ASSERT_FALSE(manifest.find("south", "sinusoid", path, impl));
+}
+
+TEST_F(PluginManifestTest, InvalidFile)
+{
+	ofstream(m_file.c_str()) << "{ not json";
+	PluginManifest manifest(m_file);
+	string path;
+	int impl;
+	ASSERT_FALSE(manifest.find("south", "sinusoid", path, impl));
+	manifest.add("south", "sinusoid", m_plugin, 0);
+	ASSERT_TRUE(manifest.find("south", "sinusoid", path, impl));
+}
@@ -249,3 +249,43 @@ TEST(QueryTest, whereIn)
 	json = query.toJSON();
 	ASSERT_EQ(json.compare(expected), 0);
 }
+
+TEST(QueryTest, SortList)
+{
+Query query(new Where("c1", Equals, "10"));
+string expected("{ \"where\" : { \"column\" : \"c1\", \"condition\" : \"=\", \"value\" : \"10\" }, \"sort\" : [ { \"column\" : \"c2\", \"direction\" : \"asc\" }, { \"column\" : \"c3\", \"direction\" : \"desc\" } ], \"limit\" : 5 }");
+
+	query.sort(new Sort("c2"));
+	query.sort(new Sort("c3", true));
+	query.limit(5);
+	ASSERT_EQ(query.toJSON(), expected);
+}
+
+TEST(QueryTest, Cached)
+{
+Where *where = new Where("id", GreaterThan, "10");
+Returns *ts = new Returns("ts");
+Query query(vector<Returns *>{ new Returns("id"), ts }, where);
+
+	query.limit(100);
+	string first = query.toJSON();
+	ASSERT_TRUE(query.isCached());
+	ASSERT_EQ(query.toJSON(), first);
+
+	// The value of a condition is replaced between sends
+	where->value("20");
+	ASSERT_FALSE(query.isCached());
+	string second = query.toJSON();
+	ASSERT_NE(second.find("\"value\" : \"20\""), string::npos);
+	ASSERT_EQ(second.find("\"value\" : \"10\""), string::npos);
+
+	// Clauses modified after they were added to the query
+	Where *in = new Where("key", In, "a");
+	where->andWhere(in);
+	in->addIn("b");
+	ts->timezone("utc");
+	query.limit(50);
+	string expected("{ \"where\" : { \"column\" : \"id\", \"condition\" : \">\", \"value\" : \"20\", \"and\" : { \"column\" : \"key\", \"condition\" : \"in\", \"value\" : [\"a\", \"b\"] } }, \"limit\" : 50, \"return\" : [ \"id\", { \"column\" : \"ts\", \"timezone\" : \"utc\" } ] }");
+	ASSERT_EQ(query.toJSON(), expected);
+	ASSERT_TRUE(query.isCached());
+}
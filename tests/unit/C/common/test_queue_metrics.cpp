@@ -0,0 +1,108 @@
+#include <gtest/gtest.h>
+#include <queue_metrics.h>
+#include <rapidjson/document.h>
+#include <thread>
+#include <vector>
+#include <string.h>
+
+using namespace std;
+using namespace rapidjson;
+
+/**
+ * Return the metrics of the named queue from the registry
+ */
+static bool findQueue(Document& doc, const char *name, Value **queue)
+{
+	string json;
+	QueueMetricsRegistry::getInstance()->asJSON(json);
+	doc.Parse(json.c_str());
+	if (doc.HasParseError())
+		return false;
+	for (auto& q : doc["queues"].GetArray())
+	{
+		if (strcmp(q["name"].GetString(), name) == 0)
+		{
+			*queue = &q;
+			return true;
+		}
+	}
+	return false;
+}
+
+TEST(QueueMetricsTest, DepthAndHighWater)
+{
+	QueueMetrics metrics("test.depth", "readings");
+	metrics.enqueue(10);
+	metrics.enqueue();
+	metrics.dequeue(6);
+	ASSERT_EQ(metrics.getDepth(), 5UL);
+	ASSERT_EQ(metrics.getHighWater(), 11UL);
+	ASSERT_EQ(metrics.getEnqueued(), 11UL);
+	ASSERT_EQ(metrics.getDequeued(), 6UL);
+	metrics.dequeue(5);
+	ASSERT_EQ(metrics.getDepth(), 0UL);
+	ASSERT_EQ(metrics.getHighWater(), 11UL);
+}
+
+TEST(QueueMetricsTest, NeverNegative)
+{
+	QueueMetrics metrics("test.negative", "blocks");
+	metrics.dequeue(2);
+	ASSERT_EQ(metrics.getDepth(), 0UL);
+	metrics.enqueue(3);
+	ASSERT_EQ(metrics.getDepth(), 1UL);
+}
+
+TEST(QueueMetricsTest, Registry)
+{
+	Document doc;
+	Value *queue;
+	{
+		QueueMetrics metrics("test.registry", "payloads");
+		metrics.enqueue(4);
+		ASSERT_TRUE(findQueue(doc, "test.registry", &queue));
+		ASSERT_STREQ((*queue)["unit"].GetString(), "payloads");
+		ASSERT_EQ((*queue)["depth"].GetUint(), 4U);
+		ASSERT_EQ((*queue)["highWater"].GetUint(), 4U);
+		ASSERT_EQ((*queue)["enqueued"].GetUint(), 4U);
+		ASSERT_EQ((*queue)["dequeued"].GetUint(), 0U);
+	}
+	// The metrics are removed with the queue
+	ASSERT_FALSE(findQueue(doc, "test.registry", &queue));
+}
+
+TEST(QueueMetricsTest, Rates)
+{
+	QueueMetrics metrics("test.rates", "readings");
+	this_thread::sleep_for(chrono::milliseconds(QUEUE_RATE_INTERVAL));
+	metrics.enqueue(100);
+	metrics.dequeue(50);
+	Document doc;
+	Value *queue;
+	ASSERT_TRUE(findQueue(doc, "test.rates", &queue));
+	double rate = (*queue)["enqueueRate"].GetDouble();
+	ASSERT_GT(rate, 0.0);
+	ASSERT_LE(rate, 100.0);
+	ASSERT_NEAR((*queue)["dequeueRate"].GetDouble(), rate / 2, 0.01);
+}
+
+TEST(QueueMetricsTest, Threads)
+{
+	QueueMetrics metrics("test.threads", "readings");
+	vector<thread> threads;
+	for (int t = 0; t < 4; t++)
+	{
+		threads.push_back(thread([&metrics] {
+			for (int i = 0; i < 10000; i++)
+			{
+				metrics.enqueue();
+				metrics.dequeue();
+			}
+		}));
+	}
+	for (auto& t : threads)
+		t.join();
+	ASSERT_EQ(metrics.getDepth(), 0UL);
+	ASSERT_EQ(metrics.getEnqueued(), 40000UL);
+	ASSERT_LE(metrics.getHighWater(), 4UL);
+}
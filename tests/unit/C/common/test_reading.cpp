@@ -98,6 +98,57 @@ TEST(ReadingTest, rmDatapoint)
 	ASSERT_EQ(removed,  (Datapoint *)0);
 }
 
+TEST(ReadingTest, WideReadingLookup)
+{
+	vector<Datapoint *> values;
+	for (int i = 0; i < 200; i++)
+	{
+		values.push_back(new Datapoint("dp" + to_string(i), DatapointValue((long) i)));
+	}
+	Reading reading(string("wide"), values);
+	ASSERT_EQ(reading.getDatapoint("dp150")->getData().toInt(), 150);
+	ASSERT_EQ(reading.getDatapoint("missing"), (Datapoint *)0);
+
+	// The index follows datapoints added and removed
+	reading.addDatapoint(new Datapoint("extra", DatapointValue((long) 1000)));
+	ASSERT_EQ(reading.getDatapoint("extra")->getData().toInt(), 1000);
+	Datapoint *removed = reading.removeDatapoint("dp10");
+	ASSERT_EQ(removed->getData().toInt(), 10);
+	delete removed;
+	ASSERT_EQ(reading.getDatapoint("dp10"), (Datapoint *)0);
+	ASSERT_EQ(reading.getDatapoint("dp11")->getData().toInt(), 11);
+	ASSERT_EQ(reading.getDatapoint("dp199")->getData().toInt(), 199);
+
+	// and datapoints changed directly
+	reading.getDatapoint("dp20")->setName("renamed");
+	ASSERT_EQ(reading.getDatapoint("renamed")->getData().toInt(), 20);
+	ASSERT_EQ(reading.getDatapoint("dp20"), (Datapoint *)0);
+	reading.getReadingData().push_back(new Datapoint("pushed", DatapointValue((long) 2000)));
+	ASSERT_EQ(reading.getDatapoint("pushed")->getData().toInt(), 2000);
+	ASSERT_EQ(reading.getDatapointCount(), 201);
+}
+
+TEST(ReadingTest, WideReadingDuplicateNames)
+{
+	vector<Datapoint *> values;
+	for (int i = 0; i < 20; i++)
+	{
+		values.push_back(new Datapoint(i % 2 ? "odd" : "dp" + to_string(i), DatapointValue((long) i)));
+	}
+	Reading reading(string("wide"), values);
+	ASSERT_EQ(reading.getDatapoint("odd")->getData().toInt(), 1);
+	Datapoint *removed = reading.removeDatapoint("odd");
+	delete removed;
+	ASSERT_EQ(reading.getDatapoint("odd")->getData().toInt(), 3);
+	ASSERT_EQ(reading.getDatapoint("dp18")->getData().toInt(), 18);
+
+	Reading copy(reading);
+	ASSERT_EQ(copy.getDatapoint("odd")->getData().toInt(), 3);
+	Reading moved(std::move(copy));
+	ASSERT_EQ(moved.getDatapoint("dp18")->getData().toInt(), 18);
+	ASSERT_EQ(copy.getDatapoint("dp18"), (Datapoint *)0);
+}
+
 TEST(ReadingTest, DictDatapoint)
 {
 	DatapointValue dpv1(1.0);
@@ -170,3 +221,113 @@ TEST(ReadingTest, ISO8601MS)
 	string datetime = reading.getAssetDateUserTime(Reading::FMT_ISO8601MS);
 	ASSERT_EQ(datetime.compare("2019-01-10 10:01:03.123456 +0000"), 0);
 }
+
+TEST(ReadingTest, MemorySize)
+{
+	DatapointValue value((long) 10);
+	Reading small(string("test1"), new Datapoint("x", value));
+	ASSERT_GT(small.getMemorySize(), sizeof(Reading));
+
+	void *pixels = calloc(64 * 64, 1);
+	DPImage *image = new DPImage(64, 64, 8, pixels);
+	free(pixels);
+	DatapointValue img(image);
+	Reading large(string("test1"), new Datapoint("image", img));
+	ASSERT_GE(large.getMemorySize(), small.getMemorySize() + 64 * 64);
+
+	vector<Reading *> readings = { &small, &large };
+	ASSERT_EQ(Reading::getMemorySize(readings), small.getMemorySize() + large.getMemorySize());
+}
+
+TEST(ReadingTest, AppendJSON)
+{
+	DatapointValue str("say \"hello\"");
+	Reading reading(string("append"), new Datapoint("s", str));
+	DatapointValue dbl(2.5);
+	reading.addDatapoint(new Datapoint("d", dbl));
+	vector<Datapoint *> *values = new vector<Datapoint *>;
+	DatapointValue i((long) -42);
+	values->push_back(new Datapoint("i", i));
+	DatapointValue dict(values, true);
+	reading.addDatapoint(new Datapoint("dict", dict));
+
+	string out = "[";
+	reading.appendJSON(out);
+	ASSERT_EQ(out, "[" + reading.toJSON());
+	ASSERT_NE(out.find("\"reading\":{\"s\":\"say \\\"hello\\\"\",\"d\":2.5,\"dict\":{\"i\":-42}}}"),
+			std::string::npos);
+
+	string datapoints;
+	reading.appendDatapointsJSON(datapoints);
+	ASSERT_EQ(datapoints, reading.getDatapointsJSON());
+	ASSERT_EQ(datapoints, "{\"s\":\"say \\\"hello\\\"\",\"d\":2.5,\"dict\":{\"i\":-42}}");
+}
+
+TEST(ReadingTest, Move)
+{
+	string value = "moved";
+	DatapointValue str(std::move(value));
+	ASSERT_EQ(str.toStringValue(), "moved");
+	DatapointValue span("moved string", 5);
+	ASSERT_EQ(span.toStringValue(), "moved");
+	vector<Datapoint *> values;
+	values.push_back(new Datapoint("s", DatapointValue(std::move(str))));
+	values.push_back(new Datapoint("d", DatapointValue(1.5)));
+	Reading reading(string("move"), values);
+	Reading moved(std::move(reading));
+	ASSERT_EQ(moved.getDatapointCount(), 2);
+	ASSERT_EQ(reading.getDatapointCount(), 0);
+	ASSERT_EQ(moved.getAssetName(), "move");
+	ASSERT_EQ(moved.getDatapointsJSON(), "{\"s\":\"moved\",\"d\":1.5}");
+}
+
+TEST(ReadingTest, InlineString)
+{
+	DatapointValue shortValue(string("short"));
+	DatapointValue longValue(string("a string longer than the inline storage"));
+	ASSERT_EQ(shortValue.getStringLength(), 5);
+	ASSERT_EQ(shortValue.toStringValue(), "short");
+	ASSERT_EQ(longValue.toStringValue(), "a string longer than the inline storage");
+	ASSERT_EQ(shortValue.getMemorySize(), sizeof(DatapointValue));
+	ASSERT_GT(longValue.getMemorySize(), sizeof(DatapointValue));
+
+	DatapointValue copy(shortValue);
+	copy = longValue;
+	ASSERT_EQ(copy.toString(), "\"a string longer than the inline storage\"");
+	copy = shortValue;
+	ASSERT_EQ(copy.toString(), "\"short\"");
+	DatapointValue embedded(string("a\0b", 3));
+	ASSERT_EQ(embedded.getStringLength(), 3);
+	ASSERT_EQ(DatapointValue(embedded).toStringValue(), string("a\0b", 3));
+}
+
+TEST(ReadingTest, SharedImage)
+{
+	uint16_t data[16 * 16];
+	memset(data, 0, sizeof(data));
+	DatapointValue image(new DPImage(16, 16, 16, data));
+	vector<double> row = { 1.0, 2.0 };
+	vector<vector<double> *> rows = { &row, &row };
+	DatapointValue array(rows);
+	Reading reading(string("camera"), new Datapoint("image", image));
+	reading.addDatapoint(new Datapoint("array", array));
+
+	// The copy of the reading shares the image and array
+	Reading copy(reading);
+	const DatapointValue& original = image;
+	const DatapointValue& shared = copy.getDatapoint("image")->getData();
+	ASSERT_EQ(shared.getImage(), original.getImage());
+	ASSERT_EQ(copy.getDatapoint("image")->getData().getImage()->getWidth(), 16);
+	ASSERT_EQ(copy.toJSON(), reading.toJSON());
+
+	// Updating the image of the copy does not change the original
+	DPImage *updated = copy.getDatapoint("image")->getData().getImage();
+	ASSERT_NE(updated, reading.getDatapoint("image")->getData().getImage());
+	((uint16_t *)updated->getData())[0] = 1;
+	ASSERT_EQ(((const uint16_t *)original.getImage()->getData())[0], 0);
+
+	vector<vector<double> *> *copied = copy.getDatapoint("array")->getData().getDp2DArr();
+	(*copied)[0]->at(0) = 5.0;
+	ASSERT_EQ(reading.getDatapoint("array")->getData().toString(), "[ [1, 2], [1, 2] ]");
+	ASSERT_EQ(copy.getDatapoint("array")->getData().toString(), "[ [5, 2], [1, 2] ]");
+}
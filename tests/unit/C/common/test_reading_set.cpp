@@ -60,3 +60,119 @@ TEST(ReadingSet, NotificationIndex)
 	ASSERT_NE(json.find(string("\"readkey\" : ")), 0);
 	ASSERT_NE(json.find(string("\"user_ts\" : \"2017-09-22 14:47:18.872708\"")), 0);
 }
+
+TEST(ReadingSet, Stream)
+{
+	istringstream stream(input);
+	ReadingSet readingSet(stream);
+	ASSERT_EQ(2, readingSet.getCount());
+	ASSERT_EQ(2, readingSet.getLastId());
+	const Reading *reading = readingSet[1];
+	ASSERT_EQ(reading->getAssetName(), "luxometer");
+	ASSERT_EQ(readingSet.getAllReadings()[1]->getDatapointCount(), 1);
+}
+
+TEST(ReadingSet, StreamCountLast)
+{
+	// The format of a chunked fetch response, the count follows the rows
+	const char *chunked = "{ \"rows\" : [ "
+	    "{ \"id\": 7, \"asset_code\": \"a{b}\\\"[c]\", "
+            "\"reading\": { \"text\": \"}{][\\\\\" }, "
+            "\"user_ts\": \"2017-09-21 15:00:08.532958\", "
+            "\"ts\": \"2017-09-22 14:47:18.872708\" }"
+	    "], \"count\" : 1 }";
+	istringstream stream(chunked);
+	ReadingSet readingSet(stream);
+	ASSERT_EQ(1, readingSet.getCount());
+	ASSERT_EQ(7, readingSet.getLastId());
+	ASSERT_EQ(readingSet[0]->getAssetName(), "a{b}\"[c]");
+}
+
+TEST(ReadingSet, StreamNotification)
+{
+	istringstream stream(asset_notification);
+	ReadingSet readingSet(stream);
+	ASSERT_EQ(2, readingSet.getCount());
+}
+
+TEST(ReadingSet, StreamEmpty)
+{
+	istringstream stream("{ \"count\" : 0, \"rows\" : [] }");
+	ReadingSet readingSet(stream);
+	ASSERT_EQ(0, readingSet.getCount());
+	ASSERT_EQ(0, readingSet.getLastId());
+}
+
+TEST(ReadingSet, StreamErrors)
+{
+	istringstream missing("{ \"count\" : 0 }");
+	ASSERT_THROW(ReadingSet readingSet(missing), ReadingSetException *);
+	istringstream truncated("{ \"rows\" : [ { \"id\": 1, \"asset_code\": \"a\"");
+	ASSERT_THROW(ReadingSet readingSet(truncated), ReadingSetException *);
+	istringstream notObject("{ \"rows\" : [ 1, 2 ] }");
+	ASSERT_THROW(ReadingSet readingSet(notObject), ReadingSetException *);
+}
+
+TEST(ReadingSet, Insitu)
+{
+	string buffer = input;
+	ReadingSet readingSet(&buffer[0], buffer.length());
+	ASSERT_EQ(2, readingSet.getCount());
+	ASSERT_EQ(2, readingSet.getLastId());
+	ASSERT_EQ(readingSet[1]->getAssetName(), "luxometer");
+	// The readings do not refer to the buffer
+	buffer.assign(buffer.length(), ' ');
+	ASSERT_EQ(readingSet[0]->getAssetName(), "luxometer");
+	ASSERT_EQ(readingSet.getAllReadings()[0]->getDatapointsJSON(), "{\"lux\":76204.524}");
+}
+
+TEST(ReadingSet, Move)
+{
+	ReadingSet readingSet(input);
+	ReadingSet moved(std::move(readingSet));
+	ASSERT_EQ(2, moved.getCount());
+	ASSERT_EQ(2, moved.getLastId());
+	ASSERT_EQ(0, readingSet.getCount());
+	ASSERT_EQ(0, readingSet.getAllReadings().size());
+	ReadingSet assigned(asset_notification);
+	assigned = std::move(moved);
+	ASSERT_EQ(2, assigned.getCount());
+	ASSERT_EQ(assigned[1]->getAssetName(), "luxometer");
+	ASSERT_EQ(0, moved.getAllReadings().size());
+}
+
+TEST(ReadingSet, InsituEscapes)
+{
+	string buffer = "{ \"rows\" : [ "
+	    "{ \"id\": 7, \"asset_code\": \"a{b}\\\"[c]\", "
+            "\"reading\": { \"text\": \"}{][\\\\\" }, "
+            "\"user_ts\": \"2017-09-21 15:00:08.532958\", "
+            "\"ts\": \"2017-09-22 14:47:18.872708\" }"
+	    "], \"count\" : 1 }";
+	ReadingSet readingSet(&buffer[0], buffer.length());
+	ASSERT_EQ(1, readingSet.getCount());
+	ASSERT_EQ(7, readingSet.getLastId());
+	ASSERT_EQ(readingSet[0]->getAssetName(), "a{b}\"[c]");
+}
+
+TEST(ReadingSet, StringErrors)
+{
+	ASSERT_THROW(ReadingSet readingSet(string("{ \"count\" : 0 }")), ReadingSetException *);
+	string truncated = "{ \"rows\" : [ { \"id\": 1, \"asset_code\": \"a\"";
+	ASSERT_THROW(ReadingSet readingSet(&truncated[0], truncated.length()), ReadingSetException *);
+	ASSERT_THROW(ReadingSet readingSet(string("{ \"rows\" : [ 1, 2 ] }")), ReadingSetException *);
+}
+
+TEST(ReadingSet, JSONReadingValues)
+{
+	Document doc;
+	doc.Parse("{ \"reading\" : { \"lux\" : 45.5, \"state\" : \"on\" } }");
+	struct timeval userTs = { 1506006008, 532958 };
+	struct timeval ts = { 1506091638, 872708 };
+	JSONReading reading(42, "luxometer", doc, userTs, ts);
+	ASSERT_EQ(42, reading.getId());
+	ASSERT_EQ(reading.getAssetName(), "luxometer");
+	ASSERT_EQ(2, reading.getReadingData().size());
+	ASSERT_EQ(reading.getAssetDateUserTime(Reading::FMT_DEFAULT, true), "2017-09-21 15:00:08.532958");
+	ASSERT_EQ(reading.getAssetDateTime(Reading::FMT_DEFAULT, true), "2017-09-22 14:47:18.872708");
+}
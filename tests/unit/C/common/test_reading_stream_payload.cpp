@@ -0,0 +1,189 @@
+#include <gtest/gtest.h>
+#include <reading.h>
+#include <reading_stream_payload.h>
+#include <databuffer.h>
+#include <string.h>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+static void roundTrip(Reading& reading)
+{
+	string payload, json;
+	ReadingStreamPayload::encode(reading, payload);
+	ASSERT_TRUE(ReadingStreamPayload::toJSON(payload.data(), payload.length(), json));
+	ASSERT_EQ(json, reading.getDatapointsJSON());
+}
+
+TEST(ReadingStreamPayloadTest, IntValue)
+{
+	DatapointValue value((long) 10);
+	Reading reading(string("test1"), new Datapoint("x", value));
+	roundTrip(reading);
+}
+
+TEST(ReadingStreamPayloadTest, NegativeIntValue)
+{
+	DatapointValue value((long) -1234567890123);
+	Reading reading(string("test1"), new Datapoint("x", value));
+	roundTrip(reading);
+}
+
+TEST(ReadingStreamPayloadTest, FloatValue)
+{
+	DatapointValue value(3.1415);
+	Reading reading(string("test1"), new Datapoint("pi", value));
+	roundTrip(reading);
+}
+
+TEST(ReadingStreamPayloadTest, WholeFloatValue)
+{
+	DatapointValue value(128.0);
+	Reading reading(string("test1"), new Datapoint("f", value));
+	roundTrip(reading);
+}
+
+TEST(ReadingStreamPayloadTest, StringValue)
+{
+	DatapointValue value(string("a \"quoted\" string"));
+	Reading reading(string("test3"), new Datapoint("str", value));
+	roundTrip(reading);
+}
+
+TEST(ReadingStreamPayloadTest, FloatArray)
+{
+	std::vector<double> v {3.1415, -128, 0, -0.0021, 0.2345};
+	DatapointValue value(v);
+	Reading reading(string("test55"), new Datapoint("a", value));
+	roundTrip(reading);
+}
+
+TEST(ReadingStreamPayloadTest, DataBuffer)
+{
+	DataBuffer *buffer = new DataBuffer(sizeof(uint16_t), 10);
+	uint16_t *data = (uint16_t *)buffer->getData();
+	for (int i = 0; i < 10; i++)
+		data[i] = i * 1000;
+	DatapointValue value(buffer);
+	Reading reading(string("buffer"), new Datapoint("b", value));
+	roundTrip(reading);
+}
+
+TEST(ReadingStreamPayloadTest, MultipleDatapoints)
+{
+	vector<Datapoint *> values;
+	DatapointValue iValue((long) 42);
+	values.push_back(new Datapoint("i", iValue));
+	DatapointValue fValue(-0.5);
+	values.push_back(new Datapoint("f", fValue));
+	DatapointValue sValue(string("text"));
+	values.push_back(new Datapoint("s", sValue));
+	Reading reading(string("multi"), values);
+	roundTrip(reading);
+}
+
+TEST(ReadingStreamPayloadTest, LargeCountAndName)
+{
+	// Neither fits the 16 bit fields of the first version of the payload
+	vector<Datapoint *> values;
+	for (long i = 0; i < 70000; i++)
+	{
+		DatapointValue value(i);
+		values.push_back(new Datapoint("dp" + to_string(i), value));
+	}
+	DatapointValue value(string("long"));
+	values.push_back(new Datapoint(string(70000, 'n'), value));
+	Reading reading(string("large"), values);
+	roundTrip(reading);
+
+	string payload;
+	vector<Datapoint *> datapoints;
+	ReadingStreamPayload::encode(reading, payload);
+	ASSERT_TRUE(ReadingStreamPayload::decode(payload.data(), payload.length(), datapoints));
+	ASSERT_EQ(datapoints.size(), 70001);
+	ASSERT_EQ(datapoints[70000]->getName().length(), 70000);
+	for (auto dp : datapoints)
+		delete dp;
+}
+
+TEST(ReadingStreamPayloadTest, NestedDict)
+{
+	vector<Datapoint *> *children = new vector<Datapoint *>;
+	DatapointValue x((long) 1);
+	children->push_back(new Datapoint("x", x));
+	DatapointValue y(2.5);
+	children->push_back(new Datapoint("y", y));
+	DatapointValue dict(children, true);
+	Reading reading(string("nested"), new Datapoint("point", dict));
+	roundTrip(reading);
+}
+
+TEST(ReadingStreamPayloadTest, TruncatedPayload)
+{
+	DatapointValue value(string("just a string"));
+	Reading reading(string("test3"), new Datapoint("str", value));
+	string payload, json;
+	ReadingStreamPayload::encode(reading, payload);
+	ASSERT_FALSE(ReadingStreamPayload::toJSON(payload.data(), payload.length() - 4, json));
+}
+
+static void decodeRoundTrip(Reading& reading)
+{
+	string payload;
+	vector<Datapoint *> datapoints;
+	ReadingStreamPayload::encode(reading, payload);
+	ASSERT_TRUE(ReadingStreamPayload::decode(payload.data(), payload.length(), datapoints));
+	Reading decoded(reading.getAssetName(), datapoints);
+	ASSERT_EQ(decoded.getDatapointsJSON(), reading.getDatapointsJSON());
+}
+
+TEST(ReadingStreamPayloadTest, DecodeMultipleDatapoints)
+{
+	vector<Datapoint *> values;
+	DatapointValue iValue((long) 42);
+	values.push_back(new Datapoint("i", iValue));
+	DatapointValue fValue(-0.5);
+	values.push_back(new Datapoint("f", fValue));
+	DatapointValue sValue(string("a \"quoted\" string"));
+	values.push_back(new Datapoint("s", sValue));
+	std::vector<double> v {3.1415, -128, 0};
+	DatapointValue aValue(v);
+	values.push_back(new Datapoint("a", aValue));
+	Reading reading(string("multi"), values);
+	decodeRoundTrip(reading);
+}
+
+TEST(ReadingStreamPayloadTest, DecodeDataBuffer)
+{
+	DataBuffer *buffer = new DataBuffer(sizeof(uint16_t), 10);
+	uint16_t *data = (uint16_t *)buffer->getData();
+	for (int i = 0; i < 10; i++)
+		data[i] = i * 1000;
+	DatapointValue value(buffer);
+	Reading reading(string("buffer"), new Datapoint("b", value));
+	decodeRoundTrip(reading);
+}
+
+TEST(ReadingStreamPayloadTest, DecodeNestedDict)
+{
+	vector<Datapoint *> *children = new vector<Datapoint *>;
+	DatapointValue x((long) 1);
+	children->push_back(new Datapoint("x", x));
+	DatapointValue y(2.5);
+	children->push_back(new Datapoint("y", y));
+	DatapointValue dict(children, true);
+	Reading reading(string("nested"), new Datapoint("point", dict));
+	decodeRoundTrip(reading);
+}
+
+TEST(ReadingStreamPayloadTest, DecodeTruncatedPayload)
+{
+	DatapointValue value(string("just a string"));
+	Reading reading(string("test3"), new Datapoint("str", value));
+	string payload;
+	vector<Datapoint *> datapoints;
+	ReadingStreamPayload::encode(reading, payload);
+	ASSERT_FALSE(ReadingStreamPayload::decode(payload.data(), payload.length() - 4, datapoints));
+	ASSERT_EQ(datapoints.size(), 0);
+}
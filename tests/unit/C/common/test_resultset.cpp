@@ -260,3 +260,47 @@ string	json("{ \"count\" : 1, \"rows\" : [ { \"json\" : { \"j1\" : \"test\" }, \
 	const rapidjson::Value *v = value->getJSON();
 	ASSERT_EQ(strcmp((*v)["j1"].GetString(), "test"), 0);
 }
+
+TEST(ResultSetTest, StringColumnEscaped)
+{
+string	json("{ \"count\" : 1, \"rows\" : [ { \"s\" : \"a \\\"quoted\\\" \\\\ value\" } ] }");
+
+	ResultSet result(json);
+	ResultSet::RowIterator rowIter = result.firstRow();
+	ASSERT_STREQ((*rowIter)->getColumn("s")->getString(), "a \"quoted\" \\ value");
+}
+
+TEST(ResultSetTest, ManyRows)
+{
+string	json("{ \"count\" : 1000, \"rows\" : [ ");
+
+	for (int i = 0; i < 1000; i++)
+	{
+		if (i)
+			json += ", ";
+		json += "{ \"id\" : " + to_string(i) + ", \"name\" : \"row" + to_string(i)
+			+ "\", \"detail\" : { \"n\" : " + to_string(i) + " } }";
+	}
+	json += " ] }";
+
+	// The text is moved into the result set rather than copied
+	ResultSet result(std::move(json));
+	ASSERT_EQ(result.rowCount(), 1000);
+	int i = 0;
+	for (ResultSet::RowIterator it = result.firstRow(); ; it = result.nextRow(it), i++)
+	{
+		ASSERT_EQ((*it)->getColumn("id")->getInteger(), i);
+		ASSERT_EQ(string((*it)->getColumn("name")->getString()), "row" + to_string(i));
+		ASSERT_EQ((*(*it)->getColumn("detail")->getJSON())["n"].GetInt(), i);
+		if (result.isLastRow(it))
+			break;
+	}
+	ASSERT_EQ(i, 999);
+}
+
+TEST(ResultSetTest, ExtraColumn)
+{
+string	json("{ \"count\" : 2, \"rows\" : [ { \"c1\" : 1 }, { \"c1\" : 2, \"c2\" : 3 } ] }");
+
+	ASSERT_THROW(ResultSet result(json), ResultException *);
+}
@@ -0,0 +1,70 @@
+#include <gtest/gtest.h>
+#include <slab_allocator.h>
+#include <reading.h>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+TEST(SlabAllocatorTest, HeapWhenDisabled)
+{
+	SlabAllocator slab(64, 16);
+	void *p = slab.allocate(64);
+	ASSERT_NE(p, (void *)NULL);
+	ASSERT_EQ(slab.getSlabCount(), 0);
+	SlabAllocator::release(p);
+}
+
+TEST(SlabAllocatorTest, ReuseSlots)
+{
+	SlabAllocator slab(64, 16);
+	slab.setEnabled(true);
+	vector<void *> ptrs;
+	for (int i = 0; i < 20; i++)
+		ptrs.push_back(slab.allocate(64));
+	ASSERT_EQ(slab.getSlabCount(), 2);
+	ASSERT_EQ(slab.getFreeCount(), 12);
+	for (auto p : ptrs)
+		SlabAllocator::release(p);
+	ASSERT_EQ(slab.getFreeCount(), 32);
+	for (int i = 0; i < 20; i++)
+		ptrs[i] = slab.allocate(64);
+	ASSERT_EQ(slab.getSlabCount(), 2);
+	for (auto p : ptrs)
+		SlabAllocator::release(p);
+}
+
+TEST(SlabAllocatorTest, OversizeFromHeap)
+{
+	SlabAllocator slab(64, 16);
+	slab.setEnabled(true);
+	void *p = slab.allocate(128);
+	ASSERT_EQ(slab.getSlabCount(), 0);
+	SlabAllocator::release(p);
+}
+
+TEST(SlabAllocatorTest, ReleaseAfterDisable)
+{
+	SlabAllocator slab(64, 16);
+	slab.setEnabled(true);
+	void *p = slab.allocate(64);
+	slab.setEnabled(false);
+	SlabAllocator::release(p);
+	ASSERT_EQ(slab.getFreeCount(), 16);
+}
+
+TEST(SlabAllocatorTest, Readings)
+{
+	setReadingSlabAllocation(true);
+	vector<Reading *> readings;
+	for (int i = 0; i < 100; i++)
+	{
+		DatapointValue value((long)i);
+		readings.push_back(new Reading(string("slab"), new Datapoint("x", value)));
+	}
+	ASSERT_GE(Reading::getAllocator()->getSlabCount(), 1);
+	ASSERT_EQ(readings[99]->getDatapoint("x")->getData().toInt(), 99);
+	setReadingSlabAllocation(false);
+	for (auto r : readings)
+		delete r;
+}
@@ -216,3 +216,36 @@ TEST(TestIsRegex, AllCases)
 
 
 
+TEST(StringReplaceAllTestClass, joinedCases)
+{
+	string test = "a///b////c";
+	StringReplaceAll(test, "//", "/");
+	ASSERT_EQ(test, "a/b/c");
+
+	test = "\"quoted\" \"words\"";
+	StringReplaceAll(test, "\"", "");
+	ASSERT_EQ(test, "quoted words");
+
+	// The replacement contains the search string, a single pass is made
+	test = "a_b_c";
+	StringReplaceAll(test, "_", "__");
+	ASSERT_EQ(test, "a__b__c");
+}
+
+TEST(UrlEncodeDecode, AllCases)
+{
+	ASSERT_EQ(urlEncode("asset name/1"), "asset%20name%2F1");
+	ASSERT_EQ(urlEncode("a-b_c.d~e"), "a-b_c.d~e");
+	ASSERT_EQ(urlEncode("\xc3\xa9"), "%C3%A9");
+
+	string url = "/fledge/service/category/";
+	urlEncode("my category", url);
+	ASSERT_EQ(url, "/fledge/service/category/my%20category");
+
+	ASSERT_EQ(urlDecode("asset%20name%2F1"), "asset name/1");
+	ASSERT_EQ(urlDecode("a+b"), "a b");
+	ASSERT_EQ(urlDecode(urlEncode("sin #1 & 2%")), "sin #1 & 2%");
+	// Decoding stops at an invalid escape
+	ASSERT_EQ(urlDecode("abc%2"), "abc");
+	ASSERT_EQ(urlDecode("abc%zzdef"), "abc");
+}
@@ -0,0 +1,103 @@
+#include <gtest/gtest.h>
+#include <timestamp_formatter.h>
+#include <reading.h>
+#include <string>
+#include <time.h>
+
+using namespace std;
+
+static string formatDateTime(time_t seconds, char separator = ' ')
+{
+	char buffer[TIMESTAMP_DATE_TIME_LEN];
+	size_t len = TimestampFormatter::formatDateTime(buffer, seconds, separator);
+	return string(buffer, len);
+}
+
+static string strftimeDateTime(time_t seconds)
+{
+	char buffer[40];
+	struct tm tm;
+	gmtime_r(&seconds, &tm);
+	strftime(buffer, sizeof(buffer), "%Y-%m-%d %H:%M:%S", &tm);
+	return string(buffer);
+}
+
+TEST(TimestampFormatterTest, Epoch)
+{
+	ASSERT_EQ(formatDateTime(0), "1970-01-01 00:00:00");
+}
+
+TEST(TimestampFormatterTest, Separator)
+{
+	ASSERT_EQ(formatDateTime(1547114463), "2019-01-10 10:01:03");
+	ASSERT_EQ(formatDateTime(1547114463, 'T'), "2019-01-10T10:01:03");
+}
+
+TEST(TimestampFormatterTest, MatchesStrftime)
+{
+	// Step through leap years, month ends and century boundaries
+	for (time_t seconds = 0; seconds < 4200000000L; seconds += 86399 * 13 + 7)
+	{
+		ASSERT_EQ(formatDateTime(seconds), strftimeDateTime(seconds));
+	}
+	ASSERT_EQ(formatDateTime(951782400), "2000-02-29 00:00:00");
+	ASSERT_EQ(formatDateTime(253402300799L), "9999-12-31 23:59:59");
+}
+
+TEST(TimestampFormatterTest, OutOfRange)
+{
+	char buffer[TIMESTAMP_DATE_TIME_LEN];
+	ASSERT_EQ(TimestampFormatter::formatDateTime(buffer, -1), 0);
+	ASSERT_EQ(TimestampFormatter::formatDateTime(buffer, 253402300800L), 0);
+}
+
+TEST(TimestampFormatterTest, Microseconds)
+{
+	char buffer[TIMESTAMP_MICROSECONDS_LEN];
+	size_t len = TimestampFormatter::formatMicroseconds(buffer, 1234);
+	ASSERT_EQ(string(buffer, len), ".001234");
+}
+
+TEST(TimestampFormatterTest, Parse)
+{
+	struct timeval tv;
+	ASSERT_TRUE(TimestampFormatter::parse("2019-01-10 10:01:03.123456+00:00", &tv));
+	ASSERT_EQ(tv.tv_sec, 1547114463);
+	ASSERT_EQ(tv.tv_usec, 123456);
+	ASSERT_TRUE(TimestampFormatter::parse("2019-01-10T10:01:03Z", &tv));
+	ASSERT_EQ(tv.tv_sec, 1547114463);
+	ASSERT_EQ(tv.tv_usec, 0);
+	ASSERT_TRUE(TimestampFormatter::parse("2019-01-10 10:01:03.12 +0000", &tv));
+	ASSERT_EQ(tv.tv_usec, 120000);
+	ASSERT_TRUE(TimestampFormatter::parse("2019-01-10 10:01:03.123456789", &tv));
+	ASSERT_EQ(tv.tv_usec, 123456);
+}
+
+TEST(TimestampFormatterTest, ParseTimezone)
+{
+	struct timeval tv;
+	ASSERT_TRUE(TimestampFormatter::parse("2019-01-10 10:01:03+8:00", &tv));
+	ASSERT_EQ(tv.tv_sec, 1547114463 - 8 * 3600);
+	ASSERT_TRUE(TimestampFormatter::parse("2019-01-10 10:01:03-05:30", &tv));
+	ASSERT_EQ(tv.tv_sec, 1547114463 + 5 * 3600 + 30 * 60);
+}
+
+TEST(TimestampFormatterTest, ParseInvalid)
+{
+	struct timeval tv;
+	ASSERT_FALSE(TimestampFormatter::parse("2019-01-10", &tv));
+	ASSERT_FALSE(TimestampFormatter::parse("2019-13-10 10:01:03", &tv));
+	ASSERT_FALSE(TimestampFormatter::parse("2019-01-10 10:01:03 GMT", &tv));
+}
+
+TEST(TimestampFormatterTest, ReadingRoundTrip)
+{
+	DatapointValue value((long) 10);
+	Reading reading(string("test1"), new Datapoint("x", value));
+	reading.setUserTimestamp("2019-01-10 10:01:03.000042-1:00");
+	ASSERT_EQ(reading.getAssetDateUserTime(Reading::FMT_DEFAULT), "2019-01-10 11:01:03.000042");
+	ASSERT_EQ(reading.getAssetDateUserTime(Reading::FMT_DEFAULT, false), "2019-01-10 11:01:03");
+	ASSERT_EQ(reading.getAssetDateUserTime(Reading::FMT_STANDARD), "2019-01-10T11:01:03.000042");
+	ASSERT_EQ(reading.getAssetDateUserTime(Reading::FMT_ISO8601), "2019-01-10 11:01:03 +0000");
+	ASSERT_EQ(reading.getAssetDateUserTime(Reading::FMT_ISO8601MS), "2019-01-10 11:01:03.000042 +0000");
+}
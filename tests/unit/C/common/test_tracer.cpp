@@ -0,0 +1,134 @@
+#include <gtest/gtest.h>
+#include <tracer.h>
+#include <rapidjson/document.h>
+#include <thread>
+#include <vector>
+#include <string.h>
+
+using namespace std;
+using namespace rapidjson;
+
+/**
+ * Count the complete events of a Chrome trace with a given name
+ */
+static int countSpans(const Document& doc, const char *name)
+{
+	int count = 0;
+	for (auto& event : doc["traceEvents"].GetArray())
+	{
+		if (strcmp(event["ph"].GetString(), "X") == 0 && strcmp(event["name"].GetString(), name) == 0)
+			count++;
+	}
+	return count;
+}
+
+TEST(TracerTest, DisabledRecordsNothing)
+{
+	Tracer *tracer = Tracer::getInstance();
+	tracer->enable(true);
+	tracer->enable(false);
+	{
+		TraceSpan span("test", "disabled");
+	}
+	string json;
+	tracer->toChromeTrace(json, "test");
+	Document doc;
+	doc.Parse(json.c_str());
+	ASSERT_FALSE(doc.HasParseError());
+	ASSERT_EQ(countSpans(doc, "disabled"), 0);
+}
+
+TEST(TracerTest, ChromeTrace)
+{
+	Tracer *tracer = Tracer::getInstance();
+	tracer->enable(true);
+	{
+		TraceSpan outer("test", "outer");
+		TraceSpan inner("test", "inner");
+		this_thread::sleep_for(chrono::milliseconds(2));
+	}
+	tracer->enable(false);
+
+	string json;
+	tracer->toChromeTrace(json, "Test \"service\"");
+	Document doc;
+	doc.Parse(json.c_str());
+	ASSERT_FALSE(doc.HasParseError());
+	ASSERT_TRUE(doc["traceEvents"].IsArray());
+	ASSERT_EQ(countSpans(doc, "outer"), 1);
+	ASSERT_EQ(countSpans(doc, "inner"), 1);
+	for (auto& event : doc["traceEvents"].GetArray())
+	{
+		if (strcmp(event["name"].GetString(), "process_name") == 0)
+		{
+			ASSERT_STREQ(event["args"]["name"].GetString(), "Test \"service\"");
+		}
+		else if (strcmp(event["name"].GetString(), "outer") == 0)
+		{
+			ASSERT_STREQ(event["cat"].GetString(), "test");
+			ASSERT_GE(event["dur"].GetUint64(), 2000UL);
+		}
+	}
+}
+
+TEST(TracerTest, EnableClears)
+{
+	Tracer *tracer = Tracer::getInstance();
+	tracer->enable(true);
+	{
+		TraceSpan span("test", "cleared");
+	}
+	tracer->enable(false);
+	tracer->enable(true);
+	tracer->enable(false);
+	string json;
+	tracer->toChromeTrace(json, "test");
+	Document doc;
+	doc.Parse(json.c_str());
+	ASSERT_EQ(countSpans(doc, "cleared"), 0);
+}
+
+TEST(TracerTest, RingBufferKeepsNewest)
+{
+	Tracer *tracer = Tracer::getInstance();
+	tracer->enable(true);
+	for (int i = 0; i < TRACE_BUFFER_EVENTS + 100; i++)
+	{
+		TraceSpan span("test", i < 100 ? "old" : "new");
+	}
+	tracer->enable(false);
+	string json;
+	tracer->toChromeTrace(json, "test");
+	Document doc;
+	doc.Parse(json.c_str());
+	ASSERT_EQ(countSpans(doc, "old"), 0);
+	// The slot the thread writes next is never returned by a full buffer
+	ASSERT_EQ(countSpans(doc, "new"), TRACE_BUFFER_EVENTS - 1);
+}
+
+TEST(TracerTest, Threads)
+{
+	Tracer *tracer = Tracer::getInstance();
+	tracer->enable(true);
+	vector<thread> threads;
+	for (int t = 0; t < 4; t++)
+	{
+		threads.push_back(thread([] {
+			for (int i = 0; i < 100; i++)
+			{
+				TraceSpan span("test", "thread");
+			}
+		}));
+	}
+	// Dump while the threads are recording
+	string json;
+	tracer->toChromeTrace(json, "test");
+	for (auto& t : threads)
+		t.join();
+	tracer->enable(false);
+	tracer->toChromeTrace(json, "test");
+	Document doc;
+	doc.Parse(json.c_str());
+	ASSERT_FALSE(doc.HasParseError());
+	ASSERT_EQ(countSpans(doc, "thread"), 400);
+}
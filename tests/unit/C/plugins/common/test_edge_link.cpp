@@ -0,0 +1,85 @@
+#include <gtest/gtest.h>
+#include <edge_link.h>
+#include <reading.h>
+#include <sys/socket.h>
+#include <unistd.h>
+/*
+ * Fledge edge link unit tests
+ *
+ * Copyright (c) 2026 Dianomic Systems
+ *
+ * Released under the Apache 2.0 Licence
+ *
+ * Author: agent
+ */
+
+using namespace std;
+
+static void roundTrip(bool compress)
+{
+	int fds[2];
+	ASSERT_EQ(0, socketpair(AF_UNIX, SOCK_STREAM, 0, fds));
+	EdgeLink sender(fds[0], NULL);
+	EdgeLink receiver(fds[1], NULL);
+
+	vector<Reading *> readings;
+	for (int i = 1; i <= 10; i++)
+	{
+		vector<Datapoint *> values;
+		DatapointValue count((long)i);
+		values.push_back(new Datapoint("count", count));
+		DatapointValue level(i * 1.5);
+		values.push_back(new Datapoint("level", level));
+		DatapointValue state(string("state") + to_string(i));
+		values.push_back(new Datapoint("state", state));
+		Reading *reading = new Reading(string("asset") + to_string(i % 2), values);
+		reading->setId(100 + i);
+		readings.push_back(reading);
+	}
+
+	string block;
+	EdgeLink::encodeBlock(7, readings.cbegin() + 2, readings.cend(), compress, block);
+	ASSERT_TRUE(sender.write(block.data(), block.length()));
+
+	uint32_t blockNumber = 0;
+	vector<Reading *> received;
+	ASSERT_TRUE(receiver.readBlock(blockNumber, received));
+	ASSERT_EQ(7, blockNumber);
+	ASSERT_EQ(8, received.size());
+	for (size_t i = 0; i < received.size(); i++)
+	{
+		Reading *sent = readings[i + 2];
+		ASSERT_EQ(sent->getId(), received[i]->getId());
+		ASSERT_EQ(sent->toJSON(), received[i]->toJSON());
+	}
+
+	for (auto reading : readings)
+		delete reading;
+	for (auto reading : received)
+		delete reading;
+}
+
+TEST(EdgeLinkTest, BlockRoundTrip)
+{
+	roundTrip(false);
+}
+
+TEST(EdgeLinkTest, CompressedBlockRoundTrip)
+{
+	roundTrip(true);
+}
+
+TEST(EdgeLinkTest, InvalidBlock)
+{
+	int fds[2];
+	ASSERT_EQ(0, socketpair(AF_UNIX, SOCK_STREAM, 0, fds));
+	EdgeLink sender(fds[0], NULL);
+	EdgeLink receiver(fds[1], NULL);
+
+	RDSBlockHeader hdr = { 0x12345678, 1, 1 };
+	ASSERT_TRUE(sender.write(&hdr, sizeof(hdr)));
+	uint32_t blockNumber;
+	vector<Reading *> received;
+	ASSERT_FALSE(receiver.readBlock(blockNumber, received));
+	ASSERT_EQ(0, received.size());
+}
@@ -341,6 +341,35 @@ TEST(OMF_transation, SuperSet)
 	ASSERT_EQ(0, superSetDataPoints.size());
 }
 
+// Two readings of the same container share one data message
+TEST(OMF_transation, TemplateValues)
+{
+	OMFDataTemplate dataTemplate("dummy", "", NULL);
+	Reading first("lab", new Datapoint("id", DatapointValue((long) 3001)));
+	Reading second("lab", new Datapoint("id", DatapointValue((long) 3002)));
+	dataTemplate.addDatapoints(first);
+
+	string message = "[" + dataTemplate.header();
+	ASSERT_TRUE(OMFData::appendValue(first, dataTemplate, message));
+	message.append("}, {");
+	ASSERT_TRUE(OMFData::appendValue(second, dataTemplate, message));
+	message.append("}]}]");
+
+	Document doc;
+	doc.Parse(message.c_str());
+	ASSERT_FALSE(doc.HasParseError());
+	ASSERT_EQ(doc.Size(), 1);
+	ASSERT_STREQ("dummy", doc[0]["containerid"].GetString());
+	ASSERT_EQ(doc[0]["values"].Size(), 2);
+	ASSERT_EQ(doc[0]["values"][1]["id"].GetInt(), 3002);
+
+	// A reading with only unsupported datapoints adds nothing
+	Reading unsupported("lab", new Datapoint("list", DatapointValue(vector<double>{1.0, 2.0})));
+	size_t length = message.length();
+	ASSERT_FALSE(OMFData::appendValue(unsupported, dataTemplate, message));
+	ASSERT_EQ(length, message.length());
+}
+
 // Compare translated readings with a provided JSON value
 TEST(OMF_transation, AllReadingsWithUnsupportedTypes)
 {
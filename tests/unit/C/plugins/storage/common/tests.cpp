@@ -1,6 +1,11 @@
 #include <gtest/gtest.h>
 #include <sql_buffer.h>
+#include <payload_document.h>
+#include <storage_profile.h>
+#include <query_shape.h>
+#include <pool_autoscaler.h>
 #include <string.h>
+#include <limits.h>
 #include <string>
 
 using namespace std;
@@ -206,3 +211,409 @@ SQLBuffer	sql;
 	delete[] buf;
 }
 
+/**
+ * Test the formatting of doubles and longs matches printf
+ */
+TEST(SQLBufferTest, numberformat) {
+double		doubles[] = { 0.0, -0.0, 1.5, -2.25, 0.0000004, 0.0000005, 123456.7890125,
+			      999999.9999996, 1e6, 1e20, -1e-9, 3.141526 };
+long		longs[] = { 0, -1, 9, 10, LONG_MAX, LONG_MIN };
+char		expected[80];
+
+	for (double value : doubles)
+	{
+		SQLBuffer sql;
+		sql.append(value);
+		snprintf(expected, sizeof(expected), "%f", value);
+		ASSERT_STREQ(expected, sql.c_str());
+	}
+	for (long value : longs)
+	{
+		SQLBuffer sql;
+		sql.append(value);
+		snprintf(expected, sizeof(expected), "%ld", value);
+		ASSERT_STREQ(expected, sql.c_str());
+	}
+}
+
+/**
+ * Test a statement within the size hint or reserved size is held in a
+ * single buffer and the buffer is reused once cleared
+ */
+TEST(SQLBufferTest, reserve) {
+SQLBuffer	sql(4000);
+vector<struct iovec> vec;
+
+	for (int i = 0; i < 300; i++)
+		sql.append("1234567890");
+	sql.iov(vec);
+	ASSERT_EQ(1, vec.size());
+	ASSERT_EQ(3000, sql.length());
+
+	const char *buf = sql.c_str();
+	sql.clear();
+	ASSERT_TRUE(sql.isEmpty());
+	sql.append("abc");
+	ASSERT_EQ(buf, sql.c_str());
+
+	sql.reserve(5000);
+	for (int i = 0; i < 400; i++)
+		sql.append("1234567890");
+	sql.iov(vec);
+	ASSERT_EQ(2, vec.size());
+	ASSERT_EQ(4003, sql.length());
+}
+
+/**
+ * Test a chain of buffers is returned in place as a single string
+ */
+TEST(SQLBufferTest, cstr) {
+SQLBuffer	sql;
+vector<struct iovec> vec;
+
+	for (int i = 0; i < 10000; i++)
+		sql.append("1234567890");
+	sql.iov(vec);
+	ASSERT_LT(1, vec.size());
+	const char *buf = sql.c_str();
+	ASSERT_EQ(100000, strlen(buf));
+	sql.iov(vec);
+	ASSERT_EQ(1, vec.size());
+	ASSERT_EQ(buf, sql.c_str());
+}
+
+/**
+ * Test parsing a payload with the thread arena
+ */
+TEST(PayloadDocumentTest, parse) {
+PayloadDocument	payload;
+
+	rapidjson::Document& doc = payload.parse("{ \"asset\" : \"pump\", \"value\" : 42 }");
+	ASSERT_FALSE(doc.HasParseError());
+	ASSERT_STREQ("pump", doc["asset"].GetString());
+	ASSERT_EQ(42, doc["value"].GetInt());
+	ASSERT_EQ(&doc, &payload.get());
+}
+
+/**
+ * Test that a nested document does not disturb the enclosing document
+ */
+TEST(PayloadDocumentTest, nested) {
+PayloadDocument	outer;
+
+	rapidjson::Document& doc = outer.parse(string("{ \"name\" : \"outer\" }"));
+	{
+		PayloadDocument	inner;
+		rapidjson::Document& innerDoc = inner.parse("{ \"name\" : \"inner\" }");
+		ASSERT_STREQ("inner", innerDoc["name"].GetString());
+		ASSERT_NE(&doc, &innerDoc);
+	}
+	ASSERT_STREQ("outer", doc["name"].GetString());
+}
+
+/**
+ * Test reusing the arena for successive payloads
+ */
+TEST(PayloadDocumentTest, reuse) {
+	for (int i = 0; i < 10; i++)
+	{
+		PayloadDocument	payload;
+		string json = "{ \"values\" : [";
+		for (int j = 0; j <= i * 1000; j++)
+		{
+			if (j)
+				json += ",";
+			json += to_string(j);
+		}
+		json += "] }";
+		rapidjson::Document& doc = payload.parse(json);
+		ASSERT_FALSE(doc.HasParseError());
+		ASSERT_EQ(i * 1000 + 1, doc["values"].Size());
+	}
+	PayloadDocument	payload;
+	ASSERT_TRUE(payload.parse("{ bad").HasParseError());
+}
+
+/**
+ * Test the latency histogram of an operation
+ */
+TEST(StorageProfileTest, histogram) {
+StorageProfile	*profile = StorageProfile::getInstance();
+string		json;
+
+	profile->reset();
+	profile->operation(ProfileAppend, 50);
+	profile->operation(ProfileAppend, 2000);
+	profile->operation(ProfileFetch, 20000000);
+	profile->asJSON(json);
+
+	rapidjson::Document doc;
+	ASSERT_FALSE(doc.Parse(json.c_str()).HasParseError());
+	const rapidjson::Value& append = doc["operations"]["append"];
+	ASSERT_EQ(2, append["count"].GetInt());
+	ASSERT_EQ(1025, append["average"].GetInt());
+	ASSERT_EQ(2000, append["max"].GetInt());
+	ASSERT_EQ(1, append["histogram"]["<100"].GetInt());
+	ASSERT_EQ(1, append["histogram"]["<5000"].GetInt());
+	ASSERT_EQ(1, doc["operations"]["fetch"]["histogram"][">=10000000"].GetInt());
+	ASSERT_EQ(0, doc["operations"]["purge"]["count"].GetInt());
+}
+
+/**
+ * Test that only the slowest statements are kept
+ */
+TEST(StorageProfileTest, slowStatements) {
+StorageProfile	*profile = StorageProfile::getInstance();
+string		json;
+
+	profile->reset();
+	for (int i = 1; i <= 3 * PROFILE_SLOW_STATEMENTS; i++)
+	{
+		string sql = "SELECT \"" + to_string(i) + "\";";
+		profile->statement(sql.c_str(), i * 10);
+	}
+	profile->asJSON(json);
+
+	rapidjson::Document doc;
+	ASSERT_FALSE(doc.Parse(json.c_str()).HasParseError());
+	const rapidjson::Value& slow = doc["slowStatements"];
+	ASSERT_EQ(PROFILE_SLOW_STATEMENTS, slow.Size());
+	ASSERT_EQ(3 * PROFILE_SLOW_STATEMENTS * 10, slow[0]["duration"].GetInt());
+	string expected = "SELECT \"" + to_string(3 * PROFILE_SLOW_STATEMENTS) + "\";";
+	ASSERT_STREQ(expected.c_str(), slow[0]["sql"].GetString());
+	ASSERT_EQ((2 * PROFILE_SLOW_STATEMENTS + 1) * 10, slow[PROFILE_SLOW_STATEMENTS - 1]["duration"].GetInt());
+}
+
+/**
+ * Test the shape of queries with different literal values
+ */
+TEST(QueryShapeTest, key) {
+PayloadDocument	payload1, payload2;
+
+	rapidjson::Document& doc1 = payload1.parse("{ \"where\" : { \"column\" : \"key\", \"condition\" : \"=\", \"value\" : \"PURGE\", \"and\" : { \"column\" : \"id\", \"condition\" : \">\", \"value\" : 10 } } }");
+	QueryShape shape1(doc1);
+	shape1.extract("retrieve", "fledge.tasks");
+	rapidjson::Document& doc2 = payload2.parse("{ \"where\" : { \"column\" : \"key\", \"condition\" : \"=\", \"value\" : \"NORTH\", \"and\" : { \"column\" : \"id\", \"condition\" : \">\", \"value\" : 25 } } }");
+	QueryShape shape2(doc2);
+	shape2.extract("retrieve", "fledge.tasks");
+	ASSERT_EQ(shape1.key(), shape2.key());
+	ASSERT_EQ(2, shape2.parameters().size());
+	ASSERT_STREQ("NORTH", shape2.parameters()[0].m_string.c_str());
+	ASSERT_EQ(25, shape2.parameters()[1].m_integer);
+
+	shape2.restore();
+	ASSERT_STREQ("NORTH", doc2["where"]["value"].GetString());
+	ASSERT_EQ(25, doc2["where"]["and"]["value"].GetInt());
+}
+
+/**
+ * Test the shape of joins with different literal values
+ */
+TEST(QueryShapeTest, join) {
+PayloadDocument	payload1, payload2;
+
+	rapidjson::Document& doc1 = payload1.parse("{ \"where\" : { \"column\" : \"event\", \"condition\" : \"=\", \"value\" : \"Ingest\" }, \"join\" : { \"table\" : { \"name\" : \"services\", \"column\" : \"name\" }, \"on\" : \"service\", \"query\" : { \"where\" : { \"column\" : \"type\", \"condition\" : \"=\", \"value\" : \"Southbound\" } } } }");
+	QueryShape shape1(doc1);
+	shape1.extract("retrieve", "fledge.asset_tracker");
+	rapidjson::Document& doc2 = payload2.parse("{ \"where\" : { \"column\" : \"event\", \"condition\" : \"=\", \"value\" : \"Egress\" }, \"join\" : { \"table\" : { \"name\" : \"services\", \"column\" : \"name\" }, \"on\" : \"service\", \"query\" : { \"where\" : { \"column\" : \"type\", \"condition\" : \"=\", \"value\" : \"Northbound\" } } } }");
+	QueryShape shape2(doc2);
+	shape2.extract("retrieve", "fledge.asset_tracker");
+	ASSERT_EQ(shape1.key(), shape2.key());
+	ASSERT_EQ(2, shape2.parameters().size());
+	ASSERT_STREQ("Northbound", shape2.parameters()[1].m_string.c_str());
+
+	shape2.restore();
+	ASSERT_STREQ("Northbound", doc2["join"]["query"]["where"]["value"].GetString());
+}
+
+/**
+ * Test the values that are part of the shape
+ */
+TEST(QueryShapeTest, literals) {
+PayloadDocument	payload1, payload2;
+
+	rapidjson::Document& doc1 = payload1.parse("{ \"updates\" : [ { \"values\" : { \"ts\" : \"now()\", \"value\" : 1.5 }, \"where\" : { \"column\" : \"ts\", \"condition\" : \"older\", \"value\" : 60 } } ] }");
+	QueryShape shape1(doc1);
+	shape1.extract("update", "fledge.tasks");
+	ASSERT_EQ(0, shape1.parameters().size());
+	rapidjson::Document& doc2 = payload2.parse("{ \"updates\" : [ { \"values\" : { \"ts\" : \"now()\", \"value\" : 1.5 }, \"where\" : { \"column\" : \"ts\", \"condition\" : \"older\", \"value\" : 120 } } ] }");
+	QueryShape shape2(doc2);
+	shape2.extract("update", "fledge.tasks");
+	ASSERT_NE(shape1.key(), shape2.key());
+}
+
+/**
+ * Test the SQL template of a shape
+ */
+TEST(QueryShapeTest, statements) {
+PayloadDocument	payload;
+vector<QueryStatement>	statements;
+
+	rapidjson::Document& doc = payload.parse("{ \"updates\" : [ { \"expressions\" : [ { \"column\" : \"value\", \"operator\" : \"+\", \"value\" : 5 } ], \"where\" : { \"column\" : \"key\", \"condition\" : \"=\", \"value\" : \"it's\" } }, { \"values\" : { \"description\" : \"a;b\" }, \"where\" : { \"column\" : \"key\", \"condition\" : \"=\", \"value\" : \"B\" } } ] }");
+	QueryShape shape(doc);
+	shape.extract("update", "fledge.statistics");
+	ASSERT_EQ(4, shape.parameters().size());
+
+	string sql = "UPDATE fledge.statistics SET value = value + ";
+	sql += to_string(doc["updates"][0]["expressions"][0]["value"].GetInt());
+	sql += " WHERE key = '";
+	sql += doc["updates"][0]["where"]["value"].GetString();
+	sql += "';UPDATE fledge.statistics SET description = '";
+	sql += doc["updates"][1]["values"]["description"].GetString();
+	sql += "' WHERE key = '";
+	sql += doc["updates"][1]["where"]["value"].GetString();
+	sql += "';";
+	ASSERT_TRUE(shape.statements(sql.c_str(), QueryShape::PlaceholderDollar, statements));
+	ASSERT_EQ(2, statements.size());
+	ASSERT_STREQ("UPDATE fledge.statistics SET value = value + $1 WHERE key = $2", statements[0].m_sql.c_str());
+	ASSERT_EQ(0, statements[0].m_parameters[0]);
+	ASSERT_EQ(1, statements[0].m_parameters[1]);
+	ASSERT_STREQ("UPDATE fledge.statistics SET description = $1 WHERE key = $2", statements[1].m_sql.c_str());
+	ASSERT_EQ(2, statements[1].m_parameters[0]);
+	ASSERT_EQ(3, statements[1].m_parameters[1]);
+	ASSERT_STREQ("a;b", shape.parameters()[2].m_string.c_str());
+
+	// A marker that is not a complete literal can not be a placeholder
+	sql = "SELECT * FROM t WHERE ts > now() - INTERVAL '";
+	sql += to_string(doc["updates"][0]["expressions"][0]["value"].GetInt());
+	sql += " seconds'";
+	ASSERT_FALSE(shape.statements(sql.c_str(), QueryShape::PlaceholderQuestion, statements));
+}
+
+/**
+ * A pool of connections that are only counted
+ */
+class CountedPool : public ConnectionPool {
+	public:
+		CountedPool(unsigned int size) : m_idle(size)
+		{
+			for (unsigned int i = 0; i < size; i++)
+				m_usage.opened();
+		};
+		void		growPool(unsigned int delta)
+		{
+			lock_guard<mutex> guard(m_mutex);
+			m_idle += delta;
+			for (unsigned int i = 0; i < delta; i++)
+				m_usage.opened();
+		};
+		unsigned int	shrinkPool(unsigned int delta)
+		{
+			lock_guard<mutex> guard(m_mutex);
+			unsigned int removed = delta < m_idle ? delta : m_idle;
+			m_idle -= removed;
+			for (unsigned int i = 0; i < removed; i++)
+				m_usage.closed();
+			return removed;
+		};
+		void		poolUsage(POOL_USAGE& usage, bool reset)
+		{
+			lock_guard<mutex> guard(m_mutex);
+			m_usage.usage(usage, reset);
+		};
+		void		allocate()
+		{
+			lock_guard<mutex> guard(m_mutex);
+			if (m_idle == 0)
+			{
+				m_usage.opened();
+				m_usage.allocated(true, 1000);
+			}
+			else
+			{
+				m_idle--;
+				m_usage.allocated(false, 0);
+			}
+		};
+		void		release()
+		{
+			lock_guard<mutex> guard(m_mutex);
+			m_idle++;
+			m_usage.released();
+		};
+	private:
+		mutex		m_mutex;
+		unsigned int	m_idle;
+		PoolUsage	m_usage;
+};
+
+/**
+ * Test the accounting of the use of a pool
+ */
+TEST(PoolUsageTest, usage) {
+CountedPool	pool(2);
+POOL_USAGE	usage;
+
+	pool.allocate();
+	pool.allocate();
+	pool.allocate();
+	pool.release();
+	pool.poolUsage(usage, true);
+	ASSERT_EQ(3, usage.size);
+	ASSERT_EQ(2, usage.inUse);
+	ASSERT_EQ(3, usage.peakInUse);
+	ASSERT_EQ(3, usage.allocations);
+	ASSERT_EQ(1, usage.waits);
+	ASSERT_EQ(1000, usage.maxWait);
+
+	// A reset starts from the connections still in use
+	pool.poolUsage(usage, false);
+	ASSERT_EQ(2, usage.peakInUse);
+	ASSERT_EQ(0, usage.allocations);
+	ASSERT_EQ(0, usage.waits);
+}
+
+/**
+ * Test the growth of a pool whose allocations waited
+ */
+TEST(PoolAutoscalerTest, grow) {
+CountedPool	pool(2);
+PoolAutoscaler	autoscaler(&pool);
+POOL_USAGE	usage;
+
+	autoscaler.start(2, 6, 3600);
+	for (int i = 0; i < 4; i++)
+		pool.allocate();
+	for (int i = 0; i < 4; i++)
+		pool.release();
+	autoscaler.scale();
+
+	// The peak of 4 in use plus the headroom
+	pool.poolUsage(usage, false);
+	ASSERT_EQ(6, usage.size);
+
+	// Connections opened above the maximum are closed once idle
+	for (int i = 0; i < 8; i++)
+		pool.allocate();
+	for (int i = 0; i < 8; i++)
+		pool.release();
+	pool.poolUsage(usage, false);
+	ASSERT_EQ(8, usage.size);
+	autoscaler.scale();
+	pool.poolUsage(usage, false);
+	ASSERT_EQ(6, usage.size);
+	autoscaler.stop();
+}
+
+/**
+ * Test the shrinking of an idle pool to its minimum
+ */
+TEST(PoolAutoscalerTest, shrink) {
+CountedPool	pool(10);
+PoolAutoscaler	autoscaler(&pool);
+POOL_USAGE	usage;
+
+	autoscaler.start(3, 0, 3600);
+	autoscaler.scale();
+	pool.poolUsage(usage, false);
+	ASSERT_EQ(5, usage.size);	// Half of the excess closed
+	autoscaler.scale();
+	autoscaler.scale();
+	pool.poolUsage(usage, false);
+	ASSERT_EQ(3, usage.size);
+
+	string json;
+	autoscaler.asJSON(json);
+	ASSERT_NE(string::npos, json.find("\"shrunk\" : 7"));
+	autoscaler.stop();
+}
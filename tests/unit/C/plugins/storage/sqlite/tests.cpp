@@ -4,6 +4,8 @@
 #include <string.h>
 #include <string>
 #include <readings_catalogue.h>
+#include <readings_blobs.h>
+#include <readings_compression.h>
 
 using namespace std;
 
@@ -48,6 +50,107 @@ TEST(MultiReadings, extractDbIdFromName) {
 	ASSERT_EQ(readCat->extractDbIdFromName("reading_60_100"), 60);
 }
 
+TEST(ReadingsBlobs, findBinaryValues) {
+
+	string data(400, 'A');
+	string json = "{\"image\":\"__DPIMAGE:10,10,24_" + data + "\","
+			"\"buffer\":\"__DATABUFFER:2" + data + "\","
+			"\"small\":\"__DATABUFFER:2AAAA\","
+			"\"text\":\"a \\\"__DATABUFFER:2" + data + "\\\" b\"}";
+	vector<BinaryValue> values;
+	ReadingsBlobs::findBinaryValues(json, 256, values);
+
+	ASSERT_EQ(values.size(), 2);
+	ASSERT_EQ(json.substr(values[0].m_offset, values[0].m_prefixLength), "__DPIMAGE:10,10,24_");
+	ASSERT_EQ(json.substr(values[0].m_offset + values[0].m_prefixLength,
+				values[0].m_length - values[0].m_prefixLength), data);
+	ASSERT_EQ(json.substr(values[1].m_offset, values[1].m_prefixLength), "__DATABUFFER:2");
+	ASSERT_EQ(json[values[1].m_offset + values[1].m_length], '"');
+
+	values.clear();
+	ReadingsBlobs::findBinaryValues(json, 0, values);
+	ASSERT_EQ(values.size(), 3);
+}
+
+TEST(ReadingsBlobs, parseReference) {
+
+	unsigned long id;
+	unsigned int seq;
+	size_t length;
+
+	ASSERT_TRUE(ReadingsBlobs::parseReference("__BLOB:1234.2\"}", &id, &seq, &length));
+	ASSERT_EQ(id, 1234);
+	ASSERT_EQ(seq, 2);
+	ASSERT_EQ(length, 13);
+	ASSERT_FALSE(ReadingsBlobs::parseReference("__BLOB:1234\"", &id, &seq, &length));
+	ASSERT_FALSE(ReadingsBlobs::parseReference("__BLOB:x.1", &id, &seq, &length));
+	ASSERT_FALSE(ReadingsBlobs::parseReference("__DPIMAGE:1,1,8_AAAA", &id, &seq, &length));
+}
+
+TEST(ReadingsCompression, compress) {
+
+	ReadingsCompression *compression = ReadingsCompression::getInstance();
+	string first = "{\"motor_temperature\":20.5,\"bearing_vibration\":0.25,\"status\":\"running\"}";
+	string second = "{\"motor_temperature\":21.5,\"bearing_vibration\":0.75,\"status\":\"running\"}";
+	string compressed, reading;
+	unsigned int dictionary, other;
+
+	compression->compress("compressTest", first, compressed, dictionary);
+	ASSERT_TRUE(compression->compress("compressTest", second, compressed, other));
+	ASSERT_EQ(dictionary, other);
+	ASSERT_LT(compressed.length(), second.length() / 3);
+	ASSERT_TRUE(compression->decompress(compressed.data(), compressed.length(), reading));
+	ASSERT_EQ(reading, second);
+
+	string asset, dict;
+	ASSERT_TRUE(compression->getDictionary(dictionary, asset, dict));
+	ASSERT_EQ(asset, "compressTest");
+	ASSERT_EQ(dict, first);
+
+	ASSERT_FALSE(compression->decompress(compressed.data(), 1, reading));
+	ASSERT_FALSE(compression->compress("compressShort", "{}", compressed, other));
+}
+
+TEST(ReadingsCompression, decodeReadings) {
+
+	ASSERT_EQ(ReadingsCompression::decodeReadings(
+			" SELECT id, reading, user_ts FROM t WHERE json_type(reading, '$.reading') IS NOT NULL"),
+		" SELECT id, reading_json(reading) AS \"reading\", user_ts FROM t WHERE json_type(reading_json(reading), '$.reading') IS NOT NULL");
+	ASSERT_EQ(ReadingsCompression::decodeReadings(
+			" SELECT count(json_extract(reading, '$.x')) AS \"reading\", max(\"reading\") FROM t"),
+		" SELECT count(json_extract(reading_json(reading), '$.x')) AS \"reading\", max(reading_json(reading)) FROM t");
+
+	// The aggregates of a compressed reading are those of its JSON
+	ReadingsCompression *compression = ReadingsCompression::getInstance();
+	string first = "{\"motor_temperature\":20.5,\"bearing_vibration\":0.25,\"status\":\"running\"}";
+	string second = "{\"motor_temperature\":22.5,\"bearing_vibration\":0.75,\"status\":\"running\"}";
+	string compressed;
+	unsigned int dictionary;
+	compression->compress("decodeTest", first, compressed, dictionary);
+	ASSERT_TRUE(compression->compress("decodeTest", second, compressed, dictionary));
+
+	sqlite3 *db;
+	ASSERT_EQ(sqlite3_open(":memory:", &db), SQLITE_OK);
+	ReadingsCompression::registerFunction(db);
+	sqlite3_exec(db, "CREATE TABLE t (id INTEGER PRIMARY KEY, reading BLOB)", NULL, NULL, NULL);
+	sqlite3_stmt *stmt;
+	sqlite3_prepare_v2(db, "INSERT INTO t (reading) VALUES (?1)", -1, &stmt, NULL);
+	sqlite3_bind_text(stmt, 1, first.c_str(), -1, SQLITE_STATIC);
+	sqlite3_step(stmt);
+	sqlite3_reset(stmt);
+	sqlite3_bind_blob(stmt, 1, compressed.data(), compressed.length(), SQLITE_STATIC);
+	sqlite3_step(stmt);
+	sqlite3_finalize(stmt);
+
+	string sql = ReadingsCompression::decodeReadings(
+			"SELECT avg(json_extract(reading, '$.motor_temperature')) FROM t");
+	sqlite3_prepare_v2(db, sql.c_str(), -1, &stmt, NULL);
+	ASSERT_EQ(sqlite3_step(stmt), SQLITE_ROW);
+	ASSERT_DOUBLE_EQ(sqlite3_column_double(stmt, 0), 21.5);
+	sqlite3_finalize(stmt);
+	sqlite3_close(db);
+}
+
 class RowFormatDate  {
 	public:
 		const char *test_case;
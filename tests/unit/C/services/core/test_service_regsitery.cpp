@@ -159,3 +159,25 @@ EXPECT_EXIT({
 	exit(!(ret == true)); }, ::testing::ExitedWithCode(0), "");
 }
 
+
+TEST(ServiceRegistryTest, FindByType)
+{
+EXPECT_EXIT({
+	ServiceRecord *record1 = new ServiceRecord("typetest1", "Notification", "http", "hostname", 1234, 4321);
+	ServiceRecord *record2 = new ServiceRecord("typetest2", "Notification", "http", "hostname", 1235, 4322);
+	
+	ServiceRegistry *registry = ServiceRegistry::getInstance();
+	if (!registry->registerService(record1) || !registry->registerService(record2))
+	{
+		cerr << "registerService 'typetest' failed" << endl;
+		exit(1);
+	}
+	registry->unRegisterService(record1);
+	vector<ServiceRecord *> services;
+	registry->findServices("Notification", services);
+	if (services.size() != 1 || services[0] != record2)
+	{
+		cerr << "findServices 'Notification' did not return 'typetest2'" << endl;
+	}
+	exit(!(services.size() == 1 && services[0] == record2)); }, ::testing::ExitedWithCode(0), "");
+}
@@ -0,0 +1,217 @@
+#include <gtest/gtest.h>
+#include <retry_spool.h>
+#include <reading_set.h>
+#include <dirent.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+/**
+ * A spool directory that is removed at the end of each test
+ */
+class RetrySpoolTest : public ::testing::Test {
+	protected:
+		void SetUp()
+		{
+			char tmpl[] = "/tmp/retry_spool_XXXXXX";
+			ASSERT_NE(mkdtemp(tmpl), (char *)NULL);
+			m_directory = tmpl;
+		}
+		void TearDown()
+		{
+			for (auto& file : files())
+				unlink((m_directory + "/" + file).c_str());
+			rmdir(m_directory.c_str());
+		}
+		vector<string> files()
+		{
+			vector<string> names;
+			DIR *dir = opendir(m_directory.c_str());
+			if (!dir)
+				return names;
+			struct dirent *entry;
+			while ((entry = readdir(dir)) != NULL)
+			{
+				if (entry->d_name[0] != '.')
+					names.push_back(entry->d_name);
+			}
+			closedir(dir);
+			return names;
+		}
+		void writeFile(const string& name, const string& content)
+		{
+			int fd = open((m_directory + "/" + name).c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0640);
+			ASSERT_NE(fd, -1);
+			ASSERT_EQ(write(fd, content.data(), content.length()), (ssize_t)content.length());
+			close(fd);
+		}
+		string		m_directory;
+};
+
+/**
+ * Create a block of readings with ids from first
+ */
+static ReadingSet *block(unsigned long first, int count)
+{
+	vector<Reading *> readings;
+	for (int i = 0; i < count; i++)
+	{
+		vector<Datapoint *> values;
+		DatapointValue counter((long)(first + i));
+		values.push_back(new Datapoint("counter", counter));
+		DatapointValue level(0.25 * i);
+		values.push_back(new Datapoint("level", level));
+		DatapointValue state(string("state ") + to_string(i));
+		values.push_back(new Datapoint("state", state));
+		Reading *reading = new Reading(string("pump") + to_string(i % 2), values);
+		reading->setId(first + i);
+		struct timeval tm;
+		tm.tv_sec = 1650000000 + i;
+		tm.tv_usec = 1000 * i;
+		reading->setUserTimestamp(tm);
+		tm.tv_usec += 1;
+		reading->setTimestamp(tm);
+		readings.push_back(reading);
+	}
+	return new ReadingSet(&readings);
+}
+
+TEST_F(RetrySpoolTest, RoundTrip)
+{
+	ReadingSet *readings = block(100, 5);
+	{
+		RetrySpool spool(m_directory);
+		spool.setMaxDisk(1024 * 1024);
+		ASSERT_NE(spool.push(readings), 0);
+	}
+
+	// A new spool sends the block left by the previous one
+	RetrySpool spool(m_directory);
+	uint64_t sequence;
+	ReadingSet *taken = spool.take(sequence);
+	ASSERT_NE(taken, (ReadingSet *)NULL);
+	const vector<Reading *>& sent = readings->getAllReadings();
+	const vector<Reading *>& spooled = taken->getAllReadings();
+	ASSERT_EQ(spooled.size(), sent.size());
+	for (size_t i = 0; i < sent.size(); i++)
+	{
+		ASSERT_EQ(spooled[i]->getId(), sent[i]->getId());
+		ASSERT_EQ(spooled[i]->getAssetName(), sent[i]->getAssetName());
+		ASSERT_EQ(spooled[i]->getDatapointsJSON(), sent[i]->getDatapointsJSON());
+		struct timeval a, b;
+		spooled[i]->getUserTimestamp(&a);
+		sent[i]->getUserTimestamp(&b);
+		ASSERT_EQ(a.tv_sec, b.tv_sec);
+		ASSERT_EQ(a.tv_usec, b.tv_usec);
+		spooled[i]->getTimestamp(&a);
+		sent[i]->getTimestamp(&b);
+		ASSERT_EQ(a.tv_sec, b.tv_sec);
+		ASSERT_EQ(a.tv_usec, b.tv_usec);
+	}
+	// The block is already taken
+	uint64_t other;
+	ASSERT_EQ(spool.take(other), (ReadingSet *)NULL);
+	spool.remove(sequence);
+	ASSERT_TRUE(files().empty());
+	delete taken;
+	delete readings;
+}
+
+TEST_F(RetrySpoolTest, UpdateAfterPartialSend)
+{
+	ReadingSet *readings = block(1, 4);
+	uint64_t sequence;
+	{
+		RetrySpool spool(m_directory);
+		spool.setMaxDisk(1024 * 1024);
+		sequence = spool.push(readings);
+		ASSERT_NE(sequence, 0);
+
+		// The first three readings were sent
+		ReadingSet *remaining = block(4, 1);
+		spool.update(sequence, remaining);
+		delete remaining;
+	}
+
+	RetrySpool spool(m_directory);
+	uint64_t taken;
+	ReadingSet *unsent = spool.take(taken);
+	ASSERT_NE(unsent, (ReadingSet *)NULL);
+	ASSERT_EQ(taken, sequence);
+	ASSERT_EQ(unsent->getAllReadings().size(), 1);
+	ASSERT_EQ(unsent->getAllReadings()[0]->getId(), 4);
+	delete unsent;
+	delete readings;
+}
+
+TEST_F(RetrySpoolTest, Recovery)
+{
+	ReadingSet *readings = block(1, 3);
+	{
+		RetrySpool spool(m_directory);
+		spool.setMaxDisk(1024 * 1024);
+		ASSERT_NE(spool.push(readings), 0);
+	}
+	// A block being written and a block cut short when the service stopped
+	writeFile("block-00000000000000000007.retry.tmp", string(100, 'x'));
+	writeFile("block-00000000000000000008.retry", string(10, 'x'));
+	RetryBlockHeader header;
+	memset(&header, 0, sizeof(header));
+	header.magic = RETRY_BLOCK_MAGIC;
+	header.version = RETRY_VERSION;
+	header.count = 2;
+	header.length = 1000;
+	writeFile("block-00000000000000000009.retry", string((const char *)&header, sizeof(header)) + "short");
+
+	RetrySpool spool(m_directory);
+	ASSERT_EQ(files().size(), 3);	// The temporary file is removed
+
+	uint64_t sequence;
+	ReadingSet *taken = spool.take(sequence);
+	ASSERT_NE(taken, (ReadingSet *)NULL);
+	ASSERT_EQ(taken->getAllReadings().size(), 3);
+	spool.remove(sequence);
+	delete taken;
+
+	// The damaged blocks are discarded
+	ASSERT_EQ(spool.take(sequence), (ReadingSet *)NULL);
+	ASSERT_TRUE(files().empty());
+	string json;
+	spool.asJSON(json);
+	ASSERT_EQ(json, "{ \"blocks\" : 0, \"bytes\" : 0 }");
+
+	// New blocks follow those recovered
+	spool.setMaxDisk(1024 * 1024);
+	ASSERT_GT(spool.push(readings), 9);
+	delete readings;
+}
+
+TEST_F(RetrySpoolTest, DiskLimit)
+{
+	ReadingSet *readings = block(1, 10);
+	RetrySpool spool(m_directory);
+
+	// Nothing is spooled until the limit is set
+	ASSERT_EQ(spool.push(readings), 0);
+	ASSERT_TRUE(files().empty());
+
+	spool.setMaxDisk(1);
+	uint64_t first = spool.push(readings);
+	ASSERT_NE(first, 0);
+	// The limit has been reached
+	ASSERT_EQ(spool.push(readings), 0);
+	ASSERT_EQ(files().size(), 1);
+
+	spool.remove(first);
+	ASSERT_NE(spool.push(readings), 0);
+	string json;
+	spool.asJSON(json);
+	ASSERT_NE(json.find("\"blocks\" : 1"), string::npos);
+	delete readings;
+}
@@ -0,0 +1,184 @@
+#include <gtest/gtest.h>
+#include <ingest_queue.h>
+#include <thread>
+#include <vector>
+
+using namespace std;
+
+/**
+ * Create a reading that carries its sequence number
+ */
+static Reading *sequenced(long sequence, long producer = 0)
+{
+	vector<Datapoint *> values;
+	values.push_back(new Datapoint("sequence", *(new DatapointValue(sequence))));
+	values.push_back(new Datapoint("producer", *(new DatapointValue(producer))));
+	return new Reading("ingest", values);
+}
+
+static long sequenceOf(Reading *reading, const string& name = "sequence")
+{
+	return reading->getDatapoint(name)->getData().toInt();
+}
+
+/**
+ * Take blocks until the queue is empty, returning the readings in the
+ * order they were taken
+ */
+static vector<long> takeAll(IngestQueue& queue)
+{
+	vector<long> taken;
+	bool all = false;
+	while (!all)
+	{
+		vector<Reading *> *block = queue.take(all);
+		for (auto& reading : *block)
+		{
+			taken.push_back(sequenceOf(reading));
+			delete reading;
+		}
+		delete block;
+	}
+	return taken;
+}
+
+TEST(IngestQueueTest, RingOverflowOrder)
+{
+	IngestQueue queue(4, 3);
+	for (long i = 0; i < 20; i++)
+		queue.push(sequenced(i));
+	ASSERT_TRUE(queue.blockReady());
+	ASSERT_EQ(queue.fullBlocks(), 5);
+
+	vector<long> taken = takeAll(queue);
+	ASSERT_EQ(taken.size(), 20);
+	for (long i = 0; i < 20; i++)
+		ASSERT_EQ(taken[i], i);
+	ASSERT_EQ(queue.pending(), 0);
+	ASSERT_EQ(queue.fullBlocks(), 0);
+}
+
+TEST(IngestQueueTest, OverflowWhilstDraining)
+{
+	IngestQueue queue(4, 2);
+	long next = 0;
+	vector<long> taken;
+	// Take one block for every three readings so the ring keeps overflowing
+	for (int round = 0; round < 50; round++)
+	{
+		for (int i = 0; i < 3; i++)
+			queue.push(sequenced(next++));
+		bool all;
+		vector<Reading *> *block = queue.take(all);
+		for (auto& reading : *block)
+		{
+			taken.push_back(sequenceOf(reading));
+			delete reading;
+		}
+		delete block;
+	}
+	vector<long> rest = takeAll(queue);
+	taken.insert(taken.end(), rest.begin(), rest.end());
+	ASSERT_EQ(taken.size(), next);
+	for (long i = 0; i < next; i++)
+		ASSERT_EQ(taken[i], i);
+}
+
+TEST(IngestQueueTest, SetsAndSingleReadings)
+{
+	IngestQueue queue(16, 100);
+	queue.push(sequenced(0));
+	queue.push(sequenced(1));
+	vector<Reading *> set;
+	set.push_back(sequenced(2));
+	set.push_back(sequenced(3));
+	queue.push(set);
+	// Follows the set rather than joining the readings in the ring
+	queue.push(sequenced(4));
+
+	Reading *oldest;
+	ASSERT_TRUE(queue.oldest(oldest));
+	ASSERT_EQ(sequenceOf(oldest), 0);
+
+	vector<long> taken = takeAll(queue);
+	ASSERT_EQ(taken.size(), 5);
+	for (long i = 0; i < 5; i++)
+		ASSERT_EQ(taken[i], i);
+
+	// Once the queue is empty single readings use the ring again
+	queue.push(sequenced(5));
+	set.clear();
+	set.push_back(sequenced(6));
+	queue.push(set);
+	taken = takeAll(queue);
+	ASSERT_EQ(taken.size(), 2);
+	ASSERT_EQ(taken[0], 5);
+	ASSERT_EQ(taken[1], 6);
+	ASSERT_FALSE(queue.oldest(oldest));
+}
+
+TEST(IngestQueueTest, OldestOfFullBlock)
+{
+	IngestQueue queue(2, 2);
+	for (long i = 0; i < 6; i++)
+		queue.push(sequenced(i));
+	bool all;
+	vector<Reading *> *block = queue.take(all);
+	ASSERT_FALSE(all);
+	ASSERT_EQ(block->size(), 2);
+	for (auto& reading : *block)
+		delete reading;
+	delete block;
+
+	Reading *oldest;
+	ASSERT_TRUE(queue.oldest(oldest));
+	ASSERT_EQ(sequenceOf(oldest), 2);
+	takeAll(queue);
+}
+
+TEST(IngestQueueTest, ConcurrentProducers)
+{
+	IngestQueue queue(64, 10);
+	const int producers = 4;
+	const long items = 2000;
+	vector<thread> threads;
+	for (int p = 0; p < producers; p++)
+	{
+		threads.push_back(thread([&queue, p, items] {
+			for (long i = 0; i < items; i++)
+			{
+				if (i % 50 == 0)
+				{
+					vector<Reading *> set;
+					set.push_back(sequenced(i, p));
+					queue.push(set);
+				}
+				else
+				{
+					queue.push(sequenced(i, p));
+				}
+			}
+		}));
+	}
+
+	// The readings of each producer are taken in the order it queued them
+	vector<long> last(producers, -1);
+	long received = 0;
+	while (received < producers * items)
+	{
+		bool all;
+		vector<Reading *> *block = queue.take(all);
+		for (auto& reading : *block)
+		{
+			long producer = sequenceOf(reading, "producer");
+			long sequence = sequenceOf(reading);
+			ASSERT_EQ(sequence, last[producer] + 1);
+			last[producer] = sequence;
+			received++;
+			delete reading;
+		}
+		delete block;
+	}
+	for (auto& t : threads)
+		t.join();
+}
@@ -0,0 +1,259 @@
+#include <gtest/gtest.h>
+#include <spill_queue.h>
+#include <dirent.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+/**
+ * A spill directory that is removed at the end of each test
+ */
+class SpillQueueTest : public ::testing::Test {
+	protected:
+		void SetUp()
+		{
+			char tmpl[] = "/tmp/spill_queue_XXXXXX";
+			ASSERT_NE(mkdtemp(tmpl), (char *)NULL);
+			m_directory = tmpl;
+		}
+		void TearDown()
+		{
+			for (auto& file : files())
+				unlink(path(file).c_str());
+			rmdir(m_directory.c_str());
+		}
+		vector<string> files()
+		{
+			vector<string> names;
+			DIR *dir = opendir(m_directory.c_str());
+			if (!dir)
+				return names;
+			struct dirent *entry;
+			while ((entry = readdir(dir)) != NULL)
+			{
+				if (entry->d_name[0] != '.')
+					names.push_back(entry->d_name);
+			}
+			closedir(dir);
+			return names;
+		}
+		string path(const string& name)
+		{
+			return m_directory + "/" + name;
+		}
+		off_t fileSize(const string& name)
+		{
+			struct stat st;
+			if (stat(path(name).c_str(), &st) == -1)
+				return -1;
+			return st.st_size;
+		}
+		string		m_directory;
+};
+
+/**
+ * Create a block of readings carrying the sequence numbers from first
+ */
+static vector<Reading *> *block(long first, int count)
+{
+	vector<Reading *> *readings = new vector<Reading *>;
+	for (int i = 0; i < count; i++)
+	{
+		vector<Datapoint *> values;
+		DatapointValue sequence(first + i);
+		values.push_back(new Datapoint("sequence", sequence));
+		DatapointValue state(string("state ") + to_string(first + i));
+		values.push_back(new Datapoint("state", state));
+		Reading *reading = new Reading("spill", values);
+		struct timeval tm;
+		tm.tv_sec = 1650000000 + first + i;
+		tm.tv_usec = 1000 * i;
+		reading->setUserTimestamp(tm);
+		readings->push_back(reading);
+	}
+	return readings;
+}
+
+static void release(vector<Reading *> *readings)
+{
+	for (auto reading : *readings)
+		delete reading;
+	delete readings;
+}
+
+/**
+ * Take blocks until the queue is empty, returning the sequence numbers
+ * of the readings in the order they were taken
+ */
+static vector<long> takeAll(SpillQueue& queue)
+{
+	vector<long> taken;
+	vector<Reading *> *readings;
+	while ((readings = queue.front()) != NULL)
+	{
+		queue.pop();
+		for (auto reading : *readings)
+			taken.push_back(reading->getDatapoint("sequence")->getData().toInt());
+		release(readings);
+	}
+	return taken;
+}
+
+TEST_F(SpillQueueTest, OrderAcrossSpill)
+{
+	SpillQueue queue(m_directory, 2);
+	for (long i = 0; i < 8; i++)
+		ASSERT_TRUE(queue.push(block(i * 3, 3)));
+
+	// The blocks in memory were spilled with the block that overflowed
+	ASSERT_EQ(queue.size(), 8);
+	ASSERT_EQ(queue.inMemory(), 0);
+	ASSERT_GT(queue.diskBytes(), 0);
+	ASSERT_EQ(files().size(), 1);
+
+	// The readings are replayed as they were queued
+	vector<Reading *> *readings = queue.front();
+	ASSERT_NE(readings, (vector<Reading *> *)NULL);
+	ASSERT_EQ(readings->size(), 3);
+	ASSERT_EQ((*readings)[1]->getAssetName(), "spill");
+	ASSERT_EQ((*readings)[1]->getDatapoint("state")->getData().toStringValue(), "state 1");
+	struct timeval tm;
+	(*readings)[1]->getUserTimestamp(&tm);
+	ASSERT_EQ(tm.tv_sec, 1650000001);
+	ASSERT_EQ(tm.tv_usec, 1000);
+
+	vector<long> taken = takeAll(queue);
+	ASSERT_EQ(taken.size(), 24);
+	for (long i = 0; i < 24; i++)
+		ASSERT_EQ(taken[i], i);
+
+	// Replayed segments are removed and the memory is used again
+	ASSERT_TRUE(queue.empty());
+	ASSERT_EQ(queue.diskBytes(), 0);
+	ASSERT_TRUE(files().empty());
+	ASSERT_TRUE(queue.push(block(100, 1)));
+	ASSERT_EQ(queue.inMemory(), 1);
+	ASSERT_TRUE(files().empty());
+}
+
+TEST_F(SpillQueueTest, RecoveryAfterRestart)
+{
+	{
+		SpillQueue queue(m_directory, 2);
+		for (long i = 0; i < 5; i++)
+			ASSERT_TRUE(queue.push(block(i * 2, 2)));
+
+		// Two blocks are written to storage before the service stops
+		for (int i = 0; i < 2; i++)
+		{
+			vector<Reading *> *readings = queue.front();
+			ASSERT_NE(readings, (vector<Reading *> *)NULL);
+			queue.pop();
+			release(readings);
+		}
+		ASSERT_EQ(queue.size(), 3);
+	}
+
+	// The restarted service carries on from the first block not replayed
+	SpillQueue queue(m_directory, 2);
+	ASSERT_EQ(queue.size(), 3);
+	vector<long> taken = takeAll(queue);
+	ASSERT_EQ(taken.size(), 6);
+	for (long i = 0; i < 6; i++)
+		ASSERT_EQ(taken[i], i + 4);
+	ASSERT_TRUE(files().empty());
+}
+
+TEST_F(SpillQueueTest, FlushOnShutdown)
+{
+	{
+		SpillQueue queue(m_directory, 4);
+		for (long i = 0; i < 3; i++)
+			ASSERT_TRUE(queue.push(block(i, 1)));
+		ASSERT_EQ(queue.inMemory(), 3);
+		ASSERT_TRUE(files().empty());
+		queue.flush();
+		ASSERT_EQ(queue.inMemory(), 0);
+		ASSERT_EQ(files().size(), 1);
+	}
+
+	SpillQueue queue(m_directory, 4);
+	vector<long> taken = takeAll(queue);
+	ASSERT_EQ(taken.size(), 3);
+	for (long i = 0; i < 3; i++)
+		ASSERT_EQ(taken[i], i);
+}
+
+TEST_F(SpillQueueTest, TruncatedSegment)
+{
+	{
+		SpillQueue queue(m_directory, 1);
+		for (long i = 0; i < 4; i++)
+			ASSERT_TRUE(queue.push(block(i, 1)));
+	}
+	vector<string> segments = files();
+	ASSERT_EQ(segments.size(), 1);
+
+	// The last block was only partly written when the service stopped
+	off_t size = fileSize(segments[0]);
+	ASSERT_EQ(truncate(path(segments[0]).c_str(), size - 5), 0);
+
+	// A segment cut short in its header holds nothing to replay
+	int fd = open(path("segment-00000000000000000009.spill").c_str(), O_WRONLY | O_CREAT, 0640);
+	ASSERT_NE(fd, -1);
+	ASSERT_EQ(write(fd, "SPLS", 4), 4);
+	close(fd);
+
+	SpillQueue queue(m_directory, 1);
+	ASSERT_EQ(queue.size(), 3);
+	ASSERT_EQ(files().size(), 1);
+	ASSERT_LT(fileSize(segments[0]), size - 5);	// The partial block is removed
+
+	// New blocks are appended after those recovered
+	ASSERT_TRUE(queue.push(block(10, 1)));
+	vector<long> taken = takeAll(queue);
+	ASSERT_EQ(taken.size(), 4);
+	ASSERT_EQ(taken[0], 0);
+	ASSERT_EQ(taken[2], 2);
+	ASSERT_EQ(taken[3], 10);
+	ASSERT_TRUE(files().empty());
+}
+
+TEST_F(SpillQueueTest, DiskLimit)
+{
+	SpillQueue queue(m_directory, 1, 1024);
+	ASSERT_TRUE(queue.push(block(0, 1)));
+
+	// Blocks are spilled until the limit is reached
+	bool spilled = true;
+	long next = 1;
+	while (spilled && next < 100)
+	{
+		vector<Reading *> *readings = block(next, 1);
+		spilled = queue.push(readings);
+		if (spilled)
+			next++;
+		else
+			release(readings);	// A block that is not queued is still the caller's
+	}
+	ASSERT_FALSE(spilled);
+	ASSERT_LE(queue.diskBytes(), 1024);
+	ASSERT_EQ(queue.size(), next);
+
+	// Replaying a block makes room for another
+	vector<Reading *> *readings = queue.front();
+	queue.pop();
+	release(readings);
+	ASSERT_TRUE(queue.push(block(next, 1)));
+
+	vector<long> taken = takeAll(queue);
+	ASSERT_EQ(taken.size(), next);
+	for (long i = 0; i < next; i++)
+		ASSERT_EQ(taken[i], i + 1);
+}
@@ -1,6 +1,7 @@
 # -*- coding: utf-8 -*-
 
 import asyncio
+import json
 import pytest
 from unittest.mock import MagicMock
 
@@ -130,3 +131,26 @@ class TestAuditLogger():
         await audit.success('AUDTCODE', None)
         assert audit._storage.insert_into_tbl.called is True
         audit._storage.insert_into_tbl.reset_mock()
+
+    @pytest.mark.asyncio
+    async def test_log_entries(self, event_loop):
+        """ Test that a number of audit entries result in a single database insert """
+        storageMock = MagicMock(spec=StorageClientAsync)
+        attrs = {'insert_into_tbl.return_value': asyncio.ensure_future(mock_coro(), loop=event_loop)}
+        storageMock.configure_mock(**attrs)
+        audit = AuditLogger(storageMock)
+        await audit.log_entries([('WARNING', 'AUDTCODE', {'message': 'failure'}), ('success', 'AUDTCODE', None)])
+        assert 1 == audit._storage.insert_into_tbl.call_count
+        args, kwargs = audit._storage.insert_into_tbl.call_args
+        assert 'log' == args[0]
+        assert {"inserts": [{"code": "AUDTCODE", "level": 2, "log": {"message": "failure"}},
+                            {"code": "AUDTCODE", "level": 0}]} == json.loads(args[1])
+        audit._storage.insert_into_tbl.reset_mock()
+
+    @pytest.mark.asyncio
+    async def test_log_entries_bad_severity(self):
+        """ Test that an unknown severity is rejected """
+        audit = AuditLogger(MagicMock(spec=StorageClientAsync))
+        with pytest.raises(ValueError) as excinfo:
+            await audit.log_entries([('storage', 'AUDTCODE', None)])
+        assert 'severity type storage is not supported' in str(excinfo.value)
@@ -1,3 +1,4 @@
+import os
 import subprocess
 
 from unittest.mock import MagicMock, patch
@@ -81,3 +82,23 @@ class TestUtils:
                                    'asset': {'description': 'Asset name', 'type': 'string', 'default': 'Random'}}} == j
             patch_lib.assert_called_once_with('Random', 'south')
         patch_util.assert_called_once_with('get_plugin_info')
+
+    @patch('subprocess.Popen')
+    def test_get_plugin_info_cached(self, mock_subproc_popen, tmpdir):
+        lib = tmpdir.join('libRandom.so')
+        lib.write('plugin')
+        with patch.object(utils, '_find_c_util', return_value='plugins/utils/get_plugin_info'):
+            with patch.object(utils, '_find_c_lib', return_value=str(lib)):
+                process_mock = MagicMock()
+                attrs = {'communicate.return_value': (b'{"name": "Random", "version": "1.0.0", "type": "south", '
+                                                      b'"interface": "1.0.0", "config": {}}\n', 'error')}
+                process_mock.configure_mock(**attrs)
+                mock_subproc_popen.return_value = process_mock
+                j = utils.get_plugin_info('Random', dir='south')
+                j['version'] = '2.0.0'
+                assert '1.0.0' == utils.get_plugin_info('Random', dir='south')['version']
+                assert 1 == mock_subproc_popen.call_count
+                # An updated library is read again
+                os.utime(str(lib), ns=(0, 0))
+                utils.get_plugin_info('Random', dir='south')
+                assert 2 == mock_subproc_popen.call_count
@@ -263,3 +263,52 @@ class TestChangeCallback:
                     'Unable to notify microservice with uuid %s due to exception: %s', s_id_1, '')
             post_patch.assert_has_calls([call('http://saddress1:1/fledge/change', data='{"category": "catname1", "items": null}', headers={'content-type': 'application/json'})])
         cm_get_patch.assert_called_once_with('catname1')
+
+    @pytest.mark.asyncio
+    async def test_run_batched(self):
+        storage_client_mock = MagicMock(spec=StorageClientAsync)
+        cfg_mgr = ConfigurationManager(storage_client_mock)
+
+        with patch.object(ServiceRegistry._logger, 'info') as log_info:
+            s_id_1 = ServiceRegistry.register(
+                'sname1', 'Southbound', 'saddress1', 1, 1, 'http')
+            s_id_2 = ServiceRegistry.register(
+                'sname2', 'Southbound', 'saddress2', 2, 2, 'http')
+        assert 2 == log_info.call_count
+        i_reg = InterestRegistry(cfg_mgr)
+        i_reg.register(s_id_1, 'catname1')
+        i_reg.register(s_id_1, 'catname2')
+        i_reg.register(s_id_2, 'catname2')
+
+        # used to mock client session context manager
+        async def async_mock(return_value):
+            return return_value
+
+        class AsyncSessionContextManagerMock(MagicMock):
+            def __init__(self, *args, **kwargs):
+                super().__init__(*args, **kwargs)
+
+            async def __aenter__(self):
+                client_response_mock = MagicMock(spec=aiohttp.ClientResponse)
+                client_response_mock.text.side_effect = [async_mock(None)]
+                status_mock = Mock()
+                status_mock.side_effect = [200]
+                client_response_mock.status = status_mock()
+                return client_response_mock
+
+            async def __aexit__(self, *args):
+                return None
+
+        # Changed in version 3.8: patch() now returns an AsyncMock if the target is an async function.
+        if sys.version_info.major == 3 and sys.version_info.minor >= 8:
+            _rv = await async_mock(None)
+        else:
+            _rv = asyncio.ensure_future(async_mock(None))
+
+        with patch.object(ConfigurationManager, 'get_category_all_items', return_value=_rv) as cm_get_patch:
+            with patch.object(aiohttp.ClientSession, 'post', return_value=AsyncSessionContextManagerMock()) as post_patch:
+                await asyncio.gather(cb.run('catname1'), cb.run('catname2'), cb.run('catname1'))
+            assert 2 == post_patch.call_count
+            post_patch.assert_has_calls([call('http://saddress1:1/fledge/changes', data='{"changes": [{"category": "catname1", "items": null}, {"category": "catname2", "items": null}]}', headers={'content-type': 'application/json'}),
+                                         call('http://saddress2:2/fledge/change', data='{"category": "catname2", "items": null}', headers={'content-type': 'application/json'})])
+        assert 2 == cm_get_patch.call_count
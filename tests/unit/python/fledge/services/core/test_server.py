@@ -598,6 +598,38 @@ class TestServer:
         args, kwargs = patch_get_all_service_reg.call_args
         assert {} == kwargs
 
+    async def test_get_bootstrap(self, client):
+        Server._storage_client = MagicMock(StorageClientAsync)
+        Server._configuration_manager = ConfigurationManager(Server._storage_client)
+        categories = {'Sine': {'plugin': {'value': 'sinusoid'}}}
+        track = [{'asset': 'sinusoid', 'event': 'Ingest', 'service': 'Sine', 'plugin': 'sinusoid'}]
+        record = ServiceRecord("c6bbf3c8-f43c-4b0f-ac48-f597f510da0b", "Fledge Storage", "Storage", "http",
+                               "localhost", 8080, 1081)
+
+        async def get_category(name):
+            return categories.get(name)
+
+        async def get_track(service=None):
+            return track
+
+        with patch.object(Server._configuration_manager, 'get_category_all_items',
+                          side_effect=get_category) as patch_get_cat:
+            with patch.object(server.asset_tracker_api, 'get_asset_tracker_records',
+                              side_effect=get_track) as patch_get_track:
+                with patch.object(ServiceRegistry, 'get', return_value=[record]) as patch_get_service_reg:
+                    resp = await client.get('/fledge/service/bootstrap?service=Sine&category=Sine&category=SineAdvanced')
+                    assert 200 == resp.status
+                    r = await resp.text()
+                    json_response = json.loads(r)
+                    assert categories == json_response['categories']
+                    assert track == json_response['track']
+                    assert 1 == len(json_response['services'])
+                    assert 'Fledge Storage' == json_response['services'][0]['name']
+                    assert 8080 == json_response['services'][0]['service_port']
+                patch_get_service_reg.assert_called_once_with(s_type='Storage')
+            patch_get_track.assert_called_once_with(service='Sine')
+        assert 2 == patch_get_cat.call_count
+
     @pytest.mark.parametrize("request_data, message", [
         ({"type": "Storage", "name": "Storage Services", "address": "127.0.0.1", "service_port": "8090", "management_port": 1090}, "Service's service port can be a positive integer only"),
         ({"type": "Storage", "name": "Storage Services", "address": "127.0.0.1", "service_port": 8090, "management_port": "1090"}, "Service management port can be a positive integer only"),